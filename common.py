@@ -73,6 +73,8 @@ def get_sources(env, is_editor_build, include_tests):
         "util/noise/spot_noise_gd.cpp",
         "util/string/*.cpp",
         "util/thread/thread.cpp",
+        "util/thread/cpu_affinity.cpp",
+        "util/thread/sharded_rw_lock.cpp",
         "util/thread/spatial_lock_2d.cpp",
         "util/thread/spatial_lock_3d.cpp",
         "util/tasks/*.cpp",
@@ -93,6 +93,7 @@ def get_doc_classes():
         "VoxelToolTerrain",
         "VoxelViewer",
         "VoxelVoxLoader",
+        "VoxelWorldBaker",
         "ZN_FastNoiseLite",
         "ZN_FastNoiseLiteGradient",
         "ZN_SpotNoise",
@@ -12,8 +12,11 @@ static const float MAXIMUM_LOD_DISTANCE = 128.f;
 
 static const unsigned int MIN_BLOCK_SIZE = 16;
 static const unsigned int MAX_BLOCK_SIZE = 32;
+// Mesh blocks of VoxelLodTerrain can be bigger in LODs configured to use per-LOD sizes
+static const unsigned int MAX_LOD_MESH_BLOCK_SIZE_PO2 = 6;
 
-static const unsigned int MAX_BLOCK_COUNT_PER_REQUEST = 4 * 4 * 4;
+// Mesh blocks at most 4 times bigger than data blocks, plus one data block of neighbors on each side
+static const unsigned int MAX_BLOCK_COUNT_PER_REQUEST = 6 * 6 * 6;
 
 // 24 should be largely enough.
 // With a block size of 32 voxels, and if 1 voxel is 1m large,
@@ -58,14 +61,31 @@ static const float DEFAULT_COLLISION_MARGIN = 0.04f;
 // By default, tasks are sorted first by the value of band2.
 // When equal, they are sorted by band1, which usually depends on LOD.
 // When equal, they are sorted by band0, which depends on distance from viewer (when relevant).
-// band3 takes precedence over band2 but isn't used much for now.
+// band3 takes precedence over band2. It is offset by the task priority of volumes, so when several volumes share
+// threads, those with higher priority get their tasks done first.
 static const uint8_t TASK_PRIORITY_MESH_BAND2 = 10;
+static const uint8_t TASK_PRIORITY_EDITED_MESH_BAND2 = 11; // Before streaming, so edits show up quickly
 static const uint8_t TASK_PRIORITY_GENERATE_BAND2 = 10;
 static const uint8_t TASK_PRIORITY_LOAD_BAND2 = 10;
 static const uint8_t TASK_PRIORITY_SAVE_BAND2 = 9;
 static const uint8_t TASK_PRIORITY_DETAIL_TEXTURES_BAND2 = 8; // After meshes
+static const uint8_t TASK_PRIORITY_MESH_OPTIMIZATION_BAND2 = 7; // Meshes are already visible, only less optimized
 
 static const uint8_t TASK_PRIORITY_BAND3_DEFAULT = 10;
+// Range of task priorities volumes can have
+static const int VOLUME_TASK_PRIORITY_MIN = -10;
+static const int VOLUME_TASK_PRIORITY_MAX = 10;
+
+// Categories of tasks running in the general thread pool, which can be given thread quotas
+enum TaskCategory : uint8_t {
+	TASK_CATEGORY_DEFAULT = 0,
+	TASK_CATEGORY_STREAMING,
+	TASK_CATEGORY_GENERATION,
+	TASK_CATEGORY_MESHING,
+	TASK_CATEGORY_DETAIL_RENDERING,
+	TASK_CATEGORY_INSTANCES,
+	TASK_CATEGORY_COUNT
+};
 
 } // namespace zylann::voxel::constants
 
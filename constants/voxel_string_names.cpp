@@ -83,6 +83,7 @@ VoxelStringNames::VoxelStringNames() {
 
 	_rpc_receive_blocks = StringName("_rpc_receive_blocks");
 	_rpc_receive_area = StringName("_rpc_receive_area");
+	blocks_received = StringName("blocks_received");
 
 	unnamed = StringName("unnamed");
 	air = StringName("air");
@@ -117,6 +118,14 @@ VoxelStringNames::VoxelStringNames() {
 	_on_async_search_completed = StringName("_on_async_search_completed");
 	async_search_completed = StringName("async_search_completed");
 
+	_on_series_generated = StringName("_on_series_generated");
+	series_generated = StringName("series_generated");
+
+	async_edit_batch_completed = StringName("async_edit_batch_completed");
+	floating_chunks_separated = StringName("floating_chunks_separated");
+	pre_generate_box_progress = StringName("pre_generate_box_progress");
+	pre_generate_box_completed = StringName("pre_generate_box_completed");
+
 	file_selected = StringName("file_selected");
 
 	jitter = StringName("jitter");
@@ -79,6 +79,7 @@ public:
 
 	StringName _rpc_receive_blocks;
 	StringName _rpc_receive_area;
+	StringName blocks_received;
 
 	StringName unnamed;
 	StringName air;
@@ -105,6 +106,14 @@ public:
 	StringName _on_async_search_completed;
 	StringName async_search_completed;
 
+	StringName _on_series_generated;
+	StringName series_generated;
+
+	StringName async_edit_batch_completed;
+	StringName floating_chunks_separated;
+	StringName pre_generate_box_progress;
+	StringName pre_generate_box_completed;
+
 	StringName file_selected;
 
 	StringName jitter;
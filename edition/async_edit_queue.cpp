@@ -0,0 +1,225 @@
+#include "async_edit_queue.h"
+#include "../engine/voxel_engine.h"
+#include "../storage/voxel_data.h"
+#include "../storage/voxel_data_grid.h"
+#include "../util/math/conv.h"
+#include "../util/profiling.h"
+#include "../util/tasks/async_dependency_tracker.h"
+
+namespace zylann::voxel {
+
+namespace {
+
+// Edits closer than this distance in voxels are grouped together. Remeshing works on whole blocks anyways, so merging
+// nearby boxes rarely causes more meshes to be updated.
+const int GROUP_MARGIN = 8;
+
+// Edits are not grouped further than this, so distant edits don't end up locking and remeshing everything between them
+const uint64_t MAX_GROUP_VOLUME = 128 * 128 * 128;
+
+} // namespace
+
+uint32_t AsyncEditQueue::push(UniquePtr<IAsyncEditOp> op) {
+	ZN_ASSERT_RETURN_V(op != nullptr, _batch_id);
+	_ops.push_back(std::move(op));
+	return _batch_id;
+}
+
+uint32_t AsyncEditQueue::flush(StdVector<Group> &out_groups) {
+	ZN_PROFILE_SCOPE();
+
+	const size_t groups_begin = out_groups.size();
+
+	for (UniquePtr<IAsyncEditOp> &op : _ops) {
+		const Box3i box = op->get_box();
+		if (box.is_empty()) {
+			continue;
+		}
+
+		Group *target_group = nullptr;
+
+		for (size_t group_index = groups_begin; group_index < out_groups.size(); ++group_index) {
+			Group &group = out_groups[group_index];
+			if (!group.box.padded(GROUP_MARGIN).intersects(box)) {
+				continue;
+			}
+			Box3i merged_box = group.box;
+			merged_box.merge_with(box);
+			if (Vector3iUtil::get_volume_u64(merged_box.size) > MAX_GROUP_VOLUME) {
+				continue;
+			}
+			group.box = merged_box;
+			target_group = &group;
+			break;
+		}
+
+		if (target_group == nullptr) {
+			out_groups.push_back(Group());
+			target_group = &out_groups.back();
+			target_group->box = box;
+		}
+
+		target_group->ops.push_back(std::move(op));
+	}
+
+	_ops.clear();
+
+	const uint32_t flushed_batch_id = _batch_id;
+	++_batch_id;
+	return flushed_batch_id;
+}
+
+void AsyncEditQueue::clear() {
+	_ops.clear();
+}
+
+AsyncEditGroupTask::AsyncEditGroupTask(
+		AsyncEditQueue::Group &&group,
+		std::shared_ptr<VoxelData> data,
+		std::shared_ptr<AsyncDependencyTracker> tracker,
+		bool use_gpu
+) :
+		_group(std::move(group)), _data(data), _tracker(tracker), _use_gpu(use_gpu) {}
+
+void AsyncEditGroupTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT(_data != nullptr);
+	ZN_ASSERT(_tracker != nullptr);
+
+	if (_stage == 0) {
+		if (_use_gpu && run_gpu_task(ctx)) {
+			// Edits will be applied when the task resumes
+			return;
+		}
+	} else if (_stage == 1) {
+		run_gpu_conversion();
+	}
+
+	// Blocks can be loaded without voxels when generated ones are not cached. Edits would skip them, so generate them
+	// first, like synchronous edits do. When the GPU was used, this only leaves other LODs to generate.
+	_data->pre_generate_box(_group.box);
+
+	// TODO May want to fail if not all blocks were found
+	VoxelDataGrid grid;
+	_data->get_blocks_grid(grid, _group.box, 0);
+
+	{
+		// All edits of the group are applied under the same lock
+		VoxelDataGrid::LockWrite wlock(grid);
+		for (UniquePtr<IAsyncEditOp> &op : _group.ops) {
+			op->apply(grid);
+		}
+	}
+
+	_tracker->post_complete();
+}
+
+bool AsyncEditGroupTask::run_gpu_task(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+
+	Ref<VoxelGenerator> generator = _data->get_generator();
+	ZN_ASSERT_RETURN_V(generator.is_valid(), false);
+
+	std::shared_ptr<ComputeShader> generator_shader = generator->get_block_rendering_shader();
+	ZN_ASSERT_RETURN_V(generator_shader != nullptr, false);
+
+	const int block_size = _data->get_block_size();
+	const Vector3i block_size_v = Vector3iUtil::create(block_size);
+	const Box3i blocks_box = _group.box.downscaled(block_size);
+
+	StdVector<Vector3i> positions;
+	_data->get_blocks_to_pre_generate(blocks_box, 0, positions);
+
+	// Blocks the generator can fill without the GPU are inserted right away
+	StdVector<VoxelData::PreGeneratedBlock> broad_blocks;
+
+	for (const Vector3i block_pos : positions) {
+		std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+		voxels->create(block_size_v);
+		VoxelGenerator::VoxelQueryData query{ *voxels, block_pos * block_size, 0 };
+		if (generator->generate_broad_block(query)) {
+			broad_blocks.push_back(VoxelData::PreGeneratedBlock{ block_pos, voxels });
+		} else {
+			if (_gpu_block_positions.size() == 0) {
+				_gpu_blocks_box = Box3i(block_pos, Vector3i(1, 1, 1));
+			} else {
+				_gpu_blocks_box.merge_with(Box3i(block_pos, Vector3i(1, 1, 1)));
+			}
+			_gpu_block_positions.push_back(block_pos);
+		}
+	}
+
+	if (broad_blocks.size() > 0) {
+		_data->set_pre_generated_blocks(blocks_box, 0, to_span_const(broad_blocks));
+	}
+
+	if (_gpu_block_positions.size() == 0) {
+		return false;
+	}
+
+	// All blocks are generated by the same task, in a buffer covering them
+	GenerateBlockGPUTask *gpu_task = ZN_NEW(GenerateBlockGPUTask);
+	for (const Vector3i block_pos : _gpu_block_positions) {
+		gpu_task->boxes_to_generate.push_back(Box3i((block_pos - _gpu_blocks_box.position) * block_size, block_size_v));
+	}
+	gpu_task->generator_shader = generator_shader;
+	gpu_task->generator_shader_params = generator->get_block_rendering_shader_parameters();
+	gpu_task->generator_shader_outputs = generator->get_block_rendering_shader_outputs();
+	gpu_task->lod_index = 0;
+	gpu_task->origin_in_voxels = _gpu_blocks_box.position * block_size;
+	gpu_task->consumer_task = this;
+
+	{
+		const AABB aabb_voxels(to_vec3(gpu_task->origin_in_voxels), to_vec3(_gpu_blocks_box.size * block_size));
+		StdVector<VoxelModifier::ShaderData> modifiers_shader_data;
+		const VoxelModifierStack &modifiers = _data->get_modifiers();
+		modifiers.apply_for_gpu_rendering(modifiers_shader_data, aabb_voxels, VoxelModifier::ShaderData::TYPE_BLOCK);
+		for (const VoxelModifier::ShaderData &d : modifiers_shader_data) {
+			gpu_task->modifiers.push_back(GenerateBlockGPUTask::ModifierData{
+					d.shader_rids[VoxelModifier::ShaderData::TYPE_BLOCK], d.params });
+		}
+	}
+
+	ctx.status = ThreadedTaskContext::STATUS_TAKEN_OUT;
+
+	// Start GPU task, we'll continue after it
+	VoxelEngine::get_singleton().push_gpu_task(gpu_task);
+	return true;
+}
+
+void AsyncEditGroupTask::set_gpu_results(StdVector<GenerateBlockGPUTaskResult> &&results) {
+	_gpu_generation_results = std::move(results);
+	_stage = 1;
+}
+
+void AsyncEditGroupTask::run_gpu_conversion() {
+	ZN_PROFILE_SCOPE();
+
+	const int block_size = _data->get_block_size();
+	const Vector3i block_size_v = Vector3iUtil::create(block_size);
+
+	VoxelBuffer area_voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	area_voxels.create(_gpu_blocks_box.size * block_size);
+	GenerateBlockGPUTaskResult::convert_to_voxel_buffer(to_span(_gpu_generation_results), area_voxels);
+	// Release the downloaded data
+	_gpu_generation_results.clear();
+
+	StdVector<VoxelData::PreGeneratedBlock> blocks;
+	blocks.reserve(_gpu_block_positions.size());
+
+	for (const Vector3i block_pos : _gpu_block_positions) {
+		std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+		voxels->create(block_size_v);
+		voxels->copy_format(area_voxels);
+		const Vector3i src_min = (block_pos - _gpu_blocks_box.position) * block_size;
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			voxels->copy_channel_from(area_voxels, src_min, src_min + block_size_v, Vector3i(), channel_index);
+		}
+		voxels->compress_uniform_channels();
+		blocks.push_back(VoxelData::PreGeneratedBlock{ block_pos, voxels });
+	}
+
+	_data->set_pre_generated_blocks(_gpu_blocks_box, 0, to_span_const(blocks));
+}
+
+} // namespace zylann::voxel
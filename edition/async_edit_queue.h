@@ -0,0 +1,98 @@
+#ifndef VOXEL_ASYNC_EDIT_QUEUE_H
+#define VOXEL_ASYNC_EDIT_QUEUE_H
+
+#include "../generators/generate_block_gpu_task.h"
+#include "../util/containers/std_vector.h"
+#include "../util/math/box3i.h"
+#include "../util/memory/memory.h"
+#include "../util/tasks/threaded_task.h"
+#include <memory>
+
+namespace zylann {
+class AsyncDependencyTracker;
+}
+
+namespace zylann::voxel {
+
+class VoxelData;
+class VoxelDataGrid;
+
+// Edit that can be applied along with others in a single pass over voxel blocks
+class IAsyncEditOp {
+public:
+	virtual ~IAsyncEditOp() {}
+
+	// Area the edit modifies, in voxels
+	virtual Box3i get_box() const = 0;
+
+	// Called from a thread, with blocks covering at least the box of the edit locked for writing
+	virtual void apply(VoxelDataGrid &grid) = 0;
+};
+
+// Accumulates edits made on the main thread until the terrain flushes them. Edits close to each other are then grouped,
+// so each group is applied by one task which locks and marks its area only once, instead of once per edit.
+// All edits of a flush are part of the same batch, which completes when all its groups are applied.
+class AsyncEditQueue {
+public:
+	struct Group {
+		Box3i box;
+		StdVector<UniquePtr<IAsyncEditOp>> ops;
+	};
+
+	// Returns the ID of the batch the edit will be part of
+	uint32_t push(UniquePtr<IAsyncEditOp> op);
+
+	inline bool is_empty() const {
+		return _ops.size() == 0;
+	}
+
+	// Groups pending edits and starts a new batch. Returns the ID of the flushed batch.
+	uint32_t flush(StdVector<Group> &out_groups);
+
+	void clear();
+
+private:
+	StdVector<UniquePtr<IAsyncEditOp>> _ops;
+	uint32_t _batch_id = 1;
+};
+
+// Applies a group of edits.
+// With `use_gpu`, LOD0 blocks of the area that don't have voxels yet are first generated with a single GPU task, which
+// gets batched with other generation tasks, before the task resumes to apply edits.
+class AsyncEditGroupTask : public IGeneratingVoxelsThreadedTask {
+public:
+	AsyncEditGroupTask(
+			AsyncEditQueue::Group &&group,
+			std::shared_ptr<VoxelData> data,
+			std::shared_ptr<AsyncDependencyTracker> tracker,
+			bool use_gpu
+	);
+
+	const char *get_debug_name() const override {
+		return "AsyncEditGroup";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+
+	void set_gpu_results(StdVector<GenerateBlockGPUTaskResult> &&results) override;
+
+private:
+	// Returns true if the task was taken out to wait for the GPU
+	bool run_gpu_task(ThreadedTaskContext &ctx);
+	void run_gpu_conversion();
+
+	AsyncEditQueue::Group _group;
+	// We reference this just to keep map pointers alive
+	std::shared_ptr<VoxelData> _data;
+	std::shared_ptr<AsyncDependencyTracker> _tracker;
+	bool _use_gpu;
+	uint8_t _stage = 0;
+	// Blocks generated on the GPU, in block coordinates, and the area containing them
+	StdVector<Vector3i> _gpu_block_positions;
+	Box3i _gpu_blocks_box;
+	StdVector<GenerateBlockGPUTaskResult> _gpu_generation_results;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_ASYNC_EDIT_QUEUE_H
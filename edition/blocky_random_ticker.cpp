@@ -0,0 +1,184 @@
+#include "blocky_random_ticker.h"
+#include "../meshers/blocky/voxel_blocky_library_base.h"
+#include "../storage/voxel_data.h"
+#include "../util/godot/core/random_pcg.h"
+#include "../util/hash_funcs.h"
+#include "../util/profiling.h"
+#include "../util/thread/rw_lock.h"
+
+namespace zylann::voxel {
+
+namespace {
+
+// Blocks are grouped into jobs to amortize scheduling
+const unsigned int BLOCKS_PER_JOB = 8;
+
+bool is_tickable(Span<const uint8_t> tickable_values, uint64_t v) {
+	return v < tickable_values.size() && tickable_values[v] != 0;
+}
+
+bool may_contain_tickable_values(const VoxelBuffer &voxels, Span<const uint8_t> tickable_values) {
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	switch (voxels.get_channel_compression(channel)) {
+		case VoxelBuffer::COMPRESSION_UNIFORM:
+			return is_tickable(tickable_values, voxels.get_voxel(0, 0, 0, channel));
+
+		case VoxelBuffer::COMPRESSION_PALETTE: {
+			Span<const uint64_t> palette;
+			ZN_ASSERT_RETURN_V(voxels.get_channel_palette(channel, palette), true);
+			for (const uint64_t v : palette) {
+				if (is_tickable(tickable_values, v)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		default:
+			return true;
+	}
+}
+
+void tick_block(
+		VoxelData &data,
+		Vector3i block_pos,
+		uint64_t block_seed,
+		unsigned int voxels_per_block,
+		Span<const uint8_t> tickable_values,
+		StdVector<BlockyRandomTicker::Hit> &out_hits
+) {
+	SpatialLock3D &spatial_lock = data.get_spatial_lock(0);
+	SpatialLock3D::Read srlock(spatial_lock, BoxBounds3i::from_position(block_pos));
+
+	std::shared_ptr<VoxelBuffer> voxels_ptr = data.try_get_block_voxels(block_pos);
+	if (voxels_ptr == nullptr) {
+		return;
+	}
+	const VoxelBuffer &voxels = *voxels_ptr;
+
+	if (!may_contain_tickable_values(voxels, tickable_values)) {
+		return;
+	}
+
+	const Vector3i block_origin = data.block_to_voxel(block_pos);
+	const Vector3i size = voxels.get_size();
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	// Each block has its own generator, so results don't depend on which thread processed which block
+	RandomPCG random(block_seed);
+
+	for (unsigned int i = 0; i < voxels_per_block; ++i) {
+		const Vector3i rpos(random.rand(size.x), random.rand(size.y), random.rand(size.z));
+		const uint64_t v = voxels.get_voxel(rpos, channel);
+		if (is_tickable(tickable_values, v)) {
+			out_hits.push_back(BlockyRandomTicker::Hit{ block_origin + rpos, static_cast<uint32_t>(v) });
+		}
+	}
+}
+
+} // namespace
+
+void BlockyRandomTicker::set_seed(uint64_t seed) {
+	_seed = seed;
+}
+
+void BlockyRandomTicker::clear() {
+	_block_positions.clear();
+	_next_block_index = 0;
+	_pass_index = 0;
+}
+
+void BlockyRandomTicker::start_pass(const VoxelData &data) {
+	_block_positions.clear();
+	_next_block_index = 0;
+	++_pass_index;
+	data.for_each_block_at_lod_r(
+			[this](Vector3i bpos, const VoxelDataBlock &block) {
+				if (block.has_voxels()) {
+					_block_positions.push_back(bpos);
+				}
+			},
+			0
+	);
+}
+
+void BlockyRandomTicker::tick(
+		VoxelData &data,
+		const VoxelBlockyLibraryBase &library,
+		unsigned int block_count,
+		unsigned int voxels_per_block,
+		const ParallelJobsScheduler &scheduler,
+		StdVector<Hit> &out_hits
+) {
+	ZN_PROFILE_SCOPE();
+
+	if (block_count == 0 || voxels_per_block == 0) {
+		return;
+	}
+
+	// Looking up models is only needed to know which values are tickable
+	StdVector<uint8_t> tickable_values;
+	{
+		RWLockRead rlock(library.get_baked_data_rw_lock());
+		const VoxelBlockyLibraryBase::BakedData &lib_data = library.get_baked_data();
+		tickable_values.resize(lib_data.models.size());
+		bool any_tickable = false;
+		for (unsigned int i = 0; i < lib_data.models.size(); ++i) {
+			tickable_values[i] = lib_data.models[i].is_random_tickable ? 1 : 0;
+			any_tickable |= lib_data.models[i].is_random_tickable;
+		}
+		if (!any_tickable) {
+			return;
+		}
+	}
+
+	StdVector<Vector3i> block_positions;
+	StdVector<uint64_t> block_seeds;
+
+	while (block_positions.size() < block_count) {
+		if (_next_block_index >= _block_positions.size()) {
+			if (block_positions.size() > 0) {
+				// The next pass starts on the next call, so blocks are not visited twice in the same call
+				break;
+			}
+			start_pass(data);
+			if (_block_positions.size() == 0) {
+				break;
+			}
+		}
+
+		const unsigned int count = math::min(
+				block_count - static_cast<unsigned int>(block_positions.size()),
+				static_cast<unsigned int>(_block_positions.size()) - _next_block_index
+		);
+		for (unsigned int i = 0; i < count; ++i) {
+			const unsigned int block_index = _next_block_index + i;
+			block_positions.push_back(_block_positions[block_index]);
+			block_seeds.push_back(hash_djb2_one_64(block_index, hash_djb2_one_64(_pass_index, _seed)));
+		}
+		_next_block_index += count;
+	}
+
+	const unsigned int job_count = math::ceildiv(static_cast<unsigned int>(block_positions.size()), BLOCKS_PER_JOB);
+	StdVector<StdVector<Hit>> job_hits;
+	job_hits.resize(job_count);
+
+	run_parallel_jobs(job_count, scheduler, [&](uint32_t job_index) {
+		ZN_PROFILE_SCOPE_NAMED("Random tick job");
+		const unsigned int begin = job_index * BLOCKS_PER_JOB;
+		const unsigned int end = math::min(begin + BLOCKS_PER_JOB, static_cast<unsigned int>(block_positions.size()));
+		StdVector<Hit> &hits = job_hits[job_index];
+		Span<const uint8_t> tickable_values_s = to_span_const(tickable_values);
+		for (unsigned int i = begin; i < end; ++i) {
+			tick_block(data, block_positions[i], block_seeds[i], voxels_per_block, tickable_values_s, hits);
+		}
+	});
+
+	// Gathered in block order so results are deterministic
+	for (const StdVector<Hit> &hits : job_hits) {
+		out_hits.insert(out_hits.end(), hits.begin(), hits.end());
+	}
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,57 @@
+#ifndef VOXEL_BLOCKY_RANDOM_TICKER_H
+#define VOXEL_BLOCKY_RANDOM_TICKER_H
+
+#include "../util/containers/std_vector.h"
+#include "../util/math/vector3i.h"
+#include "../util/tasks/parallel_jobs.h"
+
+namespace zylann::voxel {
+
+class VoxelData;
+class VoxelBlockyLibraryBase;
+
+// Runs random ticks over all loaded blocks of a terrain, for slow "natural" cellular automata behavior.
+//
+// Unlike `run_blocky_random_tick`, which picks blocks at random within a box and calls a function for every hit on the
+// calling thread, this goes through loaded blocks in turn, a slice of them on each call, so the cost can be spread
+// over frames. Voxels are picked on multiple threads, and only those having a tickable model are returned.
+// Blocks that can't contain tickable voxels (uniform or palette-compressed without any tickable value) are skipped
+// without picking voxels.
+class BlockyRandomTicker {
+public:
+	struct Hit {
+		Vector3i position;
+		uint32_t value;
+	};
+
+	void set_seed(uint64_t seed);
+
+	// Picks `voxels_per_block` random voxels in each of the next `block_count` loaded blocks at LOD 0, and appends
+	// those having a tickable model to `out_hits`. When all blocks have been visited, a new pass starts with blocks
+	// loaded at that time. Blocks unloaded in the meantime are skipped.
+	// Results only depend on the seed and the order of calls, not on how many threads are used.
+	void tick(
+			VoxelData &data,
+			const VoxelBlockyLibraryBase &library,
+			unsigned int block_count,
+			unsigned int voxels_per_block,
+			const ParallelJobsScheduler &scheduler,
+			StdVector<Hit> &out_hits
+	);
+
+	// Forgets the current pass
+	void clear();
+
+private:
+	void start_pass(const VoxelData &data);
+
+	// Blocks to visit in the current pass
+	StdVector<Vector3i> _block_positions;
+	unsigned int _next_block_index = 0;
+	uint32_t _pass_index = 0;
+	uint64_t _seed = 0;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_BLOCKY_RANDOM_TICKER_H
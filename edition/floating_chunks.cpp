@@ -1,6 +1,10 @@
 #include "floating_chunks.h"
 #include "../constants/voxel_string_names.h"
+#include "../engine/voxel_engine.h"
+#include "../meshers/mesh_block_task.h"
 #include "../storage/voxel_buffer.h"
+#include "../storage/voxel_data.h"
+#include "../terrain/voxel_node.h"
 #include "../util/godot/classes/array_mesh.h"
 #include "../util/godot/classes/collision_shape_3d.h"
 #include "../util/godot/classes/convex_polygon_shape_3d.h"
@@ -10,13 +14,20 @@
 #include "../util/godot/classes/shader.h"
 #include "../util/godot/classes/shader_material.h"
 #include "../util/godot/classes/timer.h"
+#include "../util/godot/object_weak_ref.h"
+#include "../util/containers/container_funcs.h"
 #include "../util/island_finder.h"
 #include "../util/profiling.h"
+#include "../util/tasks/threaded_task.h"
+#include "../util/tasks/time_spread_task_runner.h"
 #include "voxel_tool.h"
 
 namespace zylann::voxel {
 
-void box_propagate_ccl(Span<uint8_t> cells, const Vector3i size) {
+namespace {
+
+template <typename TLabel>
+void box_propagate_ccl(Span<TLabel> cells, const Vector3i size) {
 	ZN_PROFILE_SCOPE();
 
 	// Propagate non-zero cells towards zero cells in a 3x3x3 pattern.
@@ -35,7 +46,7 @@ void box_propagate_ccl(Span<uint8_t> cells, const Vector3i size) {
 				pos.z = 2;
 				i = Vector3iUtil::get_zxy_index(pos, size);
 				for (; pos.z < size.z - 2; ++pos.z, i += dz) {
-					const uint8_t c = cells[i];
+					const TLabel c = cells[i];
 					if (c != 0) {
 						if (cells[i - dz] == 0) {
 							cells[i - dz] = c;
@@ -63,7 +74,7 @@ void box_propagate_ccl(Span<uint8_t> cells, const Vector3i size) {
 				pos.x = 2;
 				i = Vector3iUtil::get_zxy_index(pos, size);
 				for (; pos.x < size.x - 2; ++pos.x, i += dx) {
-					const uint8_t c = cells[i];
+					const TLabel c = cells[i];
 					if (c != 0) {
 						if (cells[i - dx] == 0) {
 							cells[i - dx] = c;
@@ -90,7 +101,7 @@ void box_propagate_ccl(Span<uint8_t> cells, const Vector3i size) {
 				pos.y = 2;
 				i = Vector3iUtil::get_zxy_index(pos, size);
 				for (; pos.y < size.y - 2; ++pos.y, i += dy) {
-					const uint8_t c = cells[i];
+					const TLabel c = cells[i];
 					if (c != 0) {
 						if (cells[i - dy] == 0) {
 							cells[i - dy] = c;
@@ -107,43 +118,21 @@ void box_propagate_ccl(Span<uint8_t> cells, const Vector3i size) {
 	}
 }
 
-// Turns floating chunks of voxels into rigidbodies:
-// Detects separate groups of connected voxels within a box. Each group fully contained in the box is removed from
-// the source volume, and turned into a rigidbody.
-// This is one way of doing it, I don't know if it's the best way (there is rarely a best way)
-// so there are probably other approaches that could be explored in the future, if they have better performance
-Array separate_floating_chunks(
-		VoxelTool &voxel_tool,
-		Box3i world_box,
-		Node *parent_node,
-		Transform3D terrain_transform,
-		Ref<VoxelMesher> mesher,
-		Array materials
+// Labels groups of connected solid voxels, and gets those that don't touch the border of the buffer. Labels are written
+// to `ccl_output` in ZXY order.
+void find_floating_chunks(
+		const VoxelBuffer &voxels,
+		StdVector<uint8_t> &ccl_output,
+		StdVector<FloatingChunk> &out_floating_chunks
 ) {
-	ZN_PROFILE_SCOPE();
-
-	// Checks
-	ERR_FAIL_COND_V(mesher.is_null(), Array());
-	ERR_FAIL_COND_V(parent_node == nullptr, Array());
-
-	// Copy source data
-
 	// TODO Do not assume channel, at the moment it's hardcoded for smooth terrain
-	static const int channels_mask = (1 << VoxelBuffer::CHANNEL_SDF);
 	static const VoxelBuffer::ChannelId main_channel = VoxelBuffer::CHANNEL_SDF;
 
-	VoxelBuffer source_copy_buffer(VoxelBuffer::ALLOCATOR_POOL);
-	{
-		ZN_PROFILE_SCOPE_NAMED("Copy");
-		source_copy_buffer.create(world_box.size);
-		voxel_tool.copy(world_box.position, source_copy_buffer, channels_mask);
-	}
+	const Vector3i size = voxels.get_size();
 
 	// Label distinct voxel groups
 
-	// TODO Candidate for temp allocator
-	static thread_local StdVector<uint8_t> ccl_output;
-	ccl_output.resize(Vector3iUtil::get_volume_u64(world_box.size));
+	ccl_output.resize(Vector3iUtil::get_volume_u64(size));
 
 	unsigned int label_count = 0;
 
@@ -152,10 +141,10 @@ Array separate_floating_chunks(
 		ZN_PROFILE_SCOPE_NAMED("CCL scan");
 		IslandFinder island_finder;
 		island_finder.scan_3d(
-				Box3i(Vector3i(), world_box.size),
-				[&source_copy_buffer](Vector3i pos) {
+				Box3i(Vector3i(), size),
+				[&voxels](Vector3i pos) {
 					// TODO Can be optimized further with direct access
-					return source_copy_buffer.get_voxel_f(pos.x, pos.y, pos.z, main_channel) < 0.f;
+					return voxels.get_voxel_f(pos.x, pos.y, pos.z, main_channel) < 0.f;
 				},
 				to_span(ccl_output),
 				&label_count
@@ -172,7 +161,7 @@ Array separate_floating_chunks(
 		// Propagate labels to improve SDF quality, otherwise gradients of separated chunks would cut off abruptly.
 		// Limitation: if two islands are too close to each other, one will win over the other.
 		// An alternative could be to do this on individual chunks?
-		box_propagate_ccl(to_span(ccl_output), world_box.size);
+		box_propagate_ccl(to_span(ccl_output), size);
 	}
 
 	// Compute bounds of each group
@@ -185,9 +174,9 @@ Array separate_floating_chunks(
 		bounds_per_label.resize(label_count + 1);
 
 		unsigned int ccl_index = 0;
-		for (int z = 0; z < world_box.size.z; ++z) {
-			for (int x = 0; x < world_box.size.x; ++x) {
-				for (int y = 0; y < world_box.size.y; ++y) {
+		for (int z = 0; z < size.z; ++z) {
+			for (int x = 0; x < size.x; ++x) {
+				for (int y = 0; y < size.y; ++y) {
 					CRASH_COND(ccl_index >= ccl_output.size());
 					const uint8_t label = ccl_output[ccl_index];
 					++ccl_index;
@@ -231,7 +220,7 @@ Array separate_floating_chunks(
 	// Eliminate groups that touch the box border,
 	// because that means we can't tell if they are truly hanging in the air or attached to land further away
 
-	const Vector3i lbmax = world_box.size - Vector3i(1, 1, 1);
+	const Vector3i lbmax = size - Vector3i(1, 1, 1);
 	for (unsigned int label = 1; label < bounds_per_label.size(); ++label) {
 		CRASH_COND(label >= bounds_per_label.size());
 		Bounds &local_bounds = bounds_per_label[label];
@@ -249,128 +238,244 @@ Array separate_floating_chunks(
 		}
 	}
 
-	// Create voxel buffer for each group
-
-	struct InstanceInfo {
-		VoxelBuffer voxels;
-		Vector3i world_pos;
-		unsigned int label;
-	};
-	StdVector<InstanceInfo> instances_info;
-
-	const int min_padding = 2; // mesher->get_minimum_padding();
-	const int max_padding = 2; // mesher->get_maximum_padding();
+	for (unsigned int label = 1; label < bounds_per_label.size(); ++label) {
+		const Bounds &local_bounds = bounds_per_label[label];
+		if (local_bounds.valid) {
+			out_floating_chunks.push_back(FloatingChunk{ label, local_bounds.min_pos, local_bounds.max_pos });
+		}
+	}
+}
 
-	{
-		ZN_PROFILE_SCOPE_NAMED("Extraction");
+const int FLOATING_CHUNK_MIN_PADDING = 2; // mesher->get_minimum_padding();
+const int FLOATING_CHUNK_MAX_PADDING = 2; // mesher->get_maximum_padding();
+
+// Creates a voxel buffer for each group, read from the source volume with `copy_func(world_pos, buffer)`.
+// Positions of the groups are local to the grid of labels, which must cover them.
+template <typename TLabel, typename FCopy>
+void copy_floating_chunks_voxels(
+		FCopy copy_func,
+		Vector3i labels_origin,
+		Span<const TLabel> labels,
+		Vector3i labels_size,
+		Span<const FloatingChunk> floating_chunks,
+		StdVector<FloatingChunkVoxels> &out_chunks_voxels
+) {
+	ZN_PROFILE_SCOPE_NAMED("Extraction");
 
-		for (unsigned int label = 1; label < bounds_per_label.size(); ++label) {
-			CRASH_COND(label >= bounds_per_label.size());
-			const Bounds local_bounds = bounds_per_label[label];
+	// TODO Do not assume channel, at the moment it's hardcoded for smooth terrain
+	static const VoxelBuffer::ChannelId main_channel = VoxelBuffer::CHANNEL_SDF;
 
-			if (!local_bounds.valid) {
-				continue;
-			}
+	const int min_padding = FLOATING_CHUNK_MIN_PADDING;
+	const int max_padding = FLOATING_CHUNK_MAX_PADDING;
 
-			const Vector3i world_pos = world_box.position + local_bounds.min_pos - Vector3iUtil::create(min_padding);
-			const Vector3i size =
-					local_bounds.max_pos - local_bounds.min_pos + Vector3iUtil::create(1 + max_padding + min_padding);
+	for (const FloatingChunk &local_bounds : floating_chunks) {
+		const Vector3i world_pos = labels_origin + local_bounds.min_pos - Vector3iUtil::create(min_padding);
+		const Vector3i size =
+				local_bounds.max_pos - local_bounds.min_pos + Vector3iUtil::create(1 + max_padding + min_padding);
 
-			instances_info.push_back(InstanceInfo{ VoxelBuffer(VoxelBuffer::ALLOCATOR_POOL), world_pos, label });
+		out_chunks_voxels.push_back(FloatingChunkVoxels{ VoxelBuffer(VoxelBuffer::ALLOCATOR_POOL), world_pos });
 
-			VoxelBuffer &buffer = instances_info.back().voxels;
-			buffer.create(size.x, size.y, size.z);
+		VoxelBuffer &buffer = out_chunks_voxels.back().voxels;
+		buffer.create(size.x, size.y, size.z);
 
-			// Read voxels from the source volume
-			voxel_tool.copy(world_pos, buffer, channels_mask);
+		// Read voxels from the source volume
+		copy_func(world_pos, buffer);
 
-			// Cleanup padding borders
-			const Box3i inner_box(
-					Vector3iUtil::create(min_padding),
-					buffer.get_size() - Vector3iUtil::create(min_padding + max_padding)
-			);
-			Box3i(Vector3i(), buffer.get_size()).difference(inner_box, [&buffer](Box3i box) {
-				buffer.fill_area_f(constants::SDF_FAR_OUTSIDE, box.position, box.position + box.size, main_channel);
-			});
-
-			// Filter out voxels that don't belong to this label
-			for (int z = local_bounds.min_pos.z; z <= local_bounds.max_pos.z; ++z) {
-				for (int x = local_bounds.min_pos.x; x <= local_bounds.max_pos.x; ++x) {
-					for (int y = local_bounds.min_pos.y; y <= local_bounds.max_pos.y; ++y) {
-						const unsigned int ccl_index = Vector3iUtil::get_zxy_index(Vector3i(x, y, z), world_box.size);
-						CRASH_COND(ccl_index >= ccl_output.size());
-						const uint8_t label2 = ccl_output[ccl_index];
-
-						if (label2 != 0 && label != label2) {
-							buffer.set_voxel_f(
-									constants::SDF_FAR_OUTSIDE,
-									min_padding + x - local_bounds.min_pos.x,
-									min_padding + y - local_bounds.min_pos.y,
-									min_padding + z - local_bounds.min_pos.z,
-									main_channel
-							);
-						}
+		// Cleanup padding borders
+		const Box3i inner_box(
+				Vector3iUtil::create(min_padding), buffer.get_size() - Vector3iUtil::create(min_padding + max_padding)
+		);
+		Box3i(Vector3i(), buffer.get_size()).difference(inner_box, [&buffer](Box3i box) {
+			buffer.fill_area_f(constants::SDF_FAR_OUTSIDE, box.position, box.position + box.size, main_channel);
+		});
+
+		// Filter out voxels that don't belong to this label
+		for (int z = local_bounds.min_pos.z; z <= local_bounds.max_pos.z; ++z) {
+			for (int x = local_bounds.min_pos.x; x <= local_bounds.max_pos.x; ++x) {
+				for (int y = local_bounds.min_pos.y; y <= local_bounds.max_pos.y; ++y) {
+					const unsigned int ccl_index = Vector3iUtil::get_zxy_index(Vector3i(x, y, z), labels_size);
+					CRASH_COND(ccl_index >= labels.size());
+					const TLabel label2 = labels[ccl_index];
+
+					if (label2 != 0 && local_bounds.label != label2) {
+						buffer.set_voxel_f(
+								constants::SDF_FAR_OUTSIDE,
+								min_padding + x - local_bounds.min_pos.x,
+								min_padding + y - local_bounds.min_pos.y,
+								min_padding + z - local_bounds.min_pos.z,
+								main_channel
+						);
 					}
 				}
 			}
 		}
 	}
+}
 
-	// Erase voxels from source volume.
-	// Must be done after we copied voxels from it.
-
+// Finds floating groups within `world_box` and copies their voxels, reading the source volume with
+// `copy_func(world_pos, buffer)`.
+template <typename FCopy>
+void find_and_copy_floating_chunks(
+		FCopy copy_func,
+		Box3i world_box,
+		StdVector<FloatingChunkVoxels> &out_chunks_voxels
+) {
+	VoxelBuffer source_copy_buffer(VoxelBuffer::ALLOCATOR_POOL);
 	{
-		ZN_PROFILE_SCOPE_NAMED("Erasing");
+		ZN_PROFILE_SCOPE_NAMED("Copy");
+		source_copy_buffer.create(world_box.size);
+		copy_func(world_box.position, source_copy_buffer);
+	}
 
-		voxel_tool.set_channel(main_channel);
+	// TODO Candidate for temp allocator
+	static thread_local StdVector<uint8_t> tls_ccl_output;
+	StdVector<uint8_t> &ccl_output = tls_ccl_output;
+	StdVector<FloatingChunk> floating_chunks;
+	find_floating_chunks(source_copy_buffer, ccl_output, floating_chunks);
+
+	copy_floating_chunks_voxels(
+			copy_func,
+			world_box.position,
+			to_span_const(ccl_output),
+			world_box.size,
+			to_span_const(floating_chunks),
+			out_chunks_voxels
+	);
+}
 
-		for (unsigned int instance_index = 0; instance_index < instances_info.size(); ++instance_index) {
-			CRASH_COND(instance_index >= instances_info.size());
-			const InstanceInfo &info = instances_info[instance_index];
-			voxel_tool.sdf_stamp_erase(info.voxels, info.world_pos);
+// Find out which materials contain parameters that require instancing.
+//
+// Since 7dbc458bb4f3e0cc94e5070bd33bde41d214c98d it's no longer possible to quickly check if a
+// shader has a uniform by name using Shader's parameter cache. Now it seems the only way is to get the whole list
+// of parameters and find into it, which is slow, tedious to write and different between modules and GDExtension.
+bool get_materials_to_instance_mask(const Array &materials, uint32_t &out_mask) {
+	StdVector<zylann::godot::ShaderParameterInfo> params;
+	const String u_block_local_transform = VoxelStringNames::get_singleton().u_block_local_transform;
+
+	ZN_ASSERT_RETURN_V_MSG(
+			materials.size() < 32, false, "Too many materials. If you need more, make a request or change the code."
+	);
+
+	out_mask = 0;
+
+	for (int material_index = 0; material_index < materials.size(); ++material_index) {
+		Ref<ShaderMaterial> sm = materials[material_index];
+		if (sm.is_null()) {
+			continue;
+		}
+
+		Ref<Shader> shader = sm->get_shader();
+		if (shader.is_null()) {
+			continue;
+		}
+
+		params.clear();
+		zylann::godot::get_shader_parameter_list(shader->get_rid(), params);
+
+		for (const zylann::godot::ShaderParameterInfo &param_info : params) {
+			if (param_info.name == u_block_local_transform) {
+				out_mask |= (1 << material_index);
+				break;
+			}
 		}
 	}
 
-	// Find out which materials contain parameters that require instancing.
-	//
-	// Since 7dbc458bb4f3e0cc94e5070bd33bde41d214c98d it's no longer possible to quickly check if a
-	// shader has a uniform by name using Shader's parameter cache. Now it seems the only way is to get the whole list
-	// of parameters and find into it, which is slow, tedious to write and different between modules and GDExtension.
+	return true;
+}
 
-	uint32_t materials_to_instance_mask = 0;
-	{
-		StdVector<zylann::godot::ShaderParameterInfo> params;
-		const String u_block_local_transform = VoxelStringNames::get_singleton().u_block_local_transform;
+Transform3D get_floating_chunk_local_transform(Vector3i world_pos) {
+	return Transform3D(
+			Basis(),
+			world_pos
+					// Undo min padding
+					+ Vector3i(1, 1, 1)
+	);
+}
 
-		ZN_ASSERT_RETURN_V_MSG(
-				materials.size() < 32,
-				Array(),
-				"Too many materials. If you need more, make a request or change the code."
-		);
+void instance_materials(Array &materials, uint32_t materials_to_instance_mask, const Transform3D &local_transform) {
+	for (int i = 0; i < materials.size(); ++i) {
+		if ((materials_to_instance_mask & (1 << i)) != 0) {
+			Ref<ShaderMaterial> sm = materials[i];
+			ZN_ASSERT_CONTINUE(sm.is_valid());
+			sm = sm->duplicate(false);
+			// That parameter should have a valid default value matching the local transform relative to the
+			// volume, which is usually per-instance, but in Godot 3 we have no such feature, so we have to
+			// duplicate.
+			// TODO Try using per-instance parameters for scalar uniforms (Godot 4 doesn't support textures)
+			sm->set_shader_parameter(VoxelStringNames::get_singleton().u_block_local_transform, local_transform);
+			materials[i] = sm;
+		}
+	}
+}
 
-		for (int material_index = 0; material_index < materials.size(); ++material_index) {
-			Ref<ShaderMaterial> sm = materials[material_index];
-			if (sm.is_null()) {
-				continue;
-			}
+RigidBody3D *create_floating_chunk_body(
+		Ref<Mesh> mesh,
+		Ref<Shape3D> shape,
+		Vector3i voxels_size,
+		const Transform3D &local_transform,
+		const Transform3D &terrain_transform
+) {
+	CollisionShape3D *collision_shape = memnew(CollisionShape3D);
+	collision_shape->set_shape(shape);
+	// Center the shape somewhat, because Godot is confusing node origin with center of mass
+	const Vector3 offset = -Vector3(voxels_size) * 0.5f;
+	collision_shape->set_position(offset);
+
+	RigidBody3D *rigid_body = memnew(RigidBody3D);
+	rigid_body->set_transform(terrain_transform * local_transform.translated_local(-offset));
+	rigid_body->add_child(collision_shape);
+	rigid_body->set_freeze_mode(RigidBody3D::FREEZE_MODE_KINEMATIC);
+	rigid_body->set_freeze_enabled(true);
+
+	// Switch to rigid after a short time to workaround clipping with terrain,
+	// because colliders are updated asynchronously
+	Timer *timer = memnew(Timer);
+	timer->set_wait_time(0.2);
+	timer->set_one_shot(true);
+	timer->connect("timeout", callable_mp(rigid_body, &RigidBody3D::set_freeze_enabled).bind(false));
+	// Cannot use start() here because it requires to be inside the SceneTree,
+	// and we don't know if it will be after we add to the parent.
+	timer->set_autostart(true);
+	rigid_body->add_child(timer);
+
+	MeshInstance3D *mesh_instance = memnew(MeshInstance3D);
+	mesh_instance->set_mesh(mesh);
+	mesh_instance->set_position(offset);
+	rigid_body->add_child(mesh_instance);
+
+	return rigid_body;
+}
 
-			Ref<Shader> shader = sm->get_shader();
-			if (shader.is_null()) {
-				continue;
-			}
+// Removes groups of voxels from the source volume and turns them into rigidbodies.
+Array extract_floating_chunks(
+		VoxelTool &voxel_tool,
+		Span<const FloatingChunkVoxels> chunks_voxels,
+		Node *parent_node,
+		Transform3D terrain_transform,
+		Ref<VoxelMesher> mesher,
+		Array materials
+) {
+	// TODO Do not assume channel, at the moment it's hardcoded for smooth terrain
+	static const VoxelBuffer::ChannelId main_channel = VoxelBuffer::CHANNEL_SDF;
 
-			params.clear();
-			zylann::godot::get_shader_parameter_list(shader->get_rid(), params);
+	// Erase voxels from source volume.
+	// Must be done after we copied voxels from it.
 
-			for (const zylann::godot::ShaderParameterInfo &param_info : params) {
-				if (param_info.name == u_block_local_transform) {
-					materials_to_instance_mask |= (1 << material_index);
-					break;
-				}
-			}
+	{
+		ZN_PROFILE_SCOPE_NAMED("Erasing");
+
+		voxel_tool.set_channel(main_channel);
+
+		for (const FloatingChunkVoxels &chunk_voxels : chunks_voxels) {
+			voxel_tool.sdf_stamp_erase(chunk_voxels.voxels, chunk_voxels.world_pos);
 		}
 	}
 
+	uint32_t materials_to_instance_mask = 0;
+	if (!get_materials_to_instance_mask(materials, materials_to_instance_mask)) {
+		return Array();
+	}
+
 	// Create instances
 
 	Array nodes;
@@ -378,60 +483,14 @@ Array separate_floating_chunks(
 	{
 		ZN_PROFILE_SCOPE_NAMED("Remeshing and instancing");
 
-		for (unsigned int instance_index = 0; instance_index < instances_info.size(); ++instance_index) {
-			CRASH_COND(instance_index >= instances_info.size());
-			const InstanceInfo &info = instances_info[instance_index];
-
-			CRASH_COND(info.label >= bounds_per_label.size());
-			const Bounds local_bounds = bounds_per_label[info.label];
-			ERR_CONTINUE(!local_bounds.valid);
-
-			// DEBUG
-			// print_line(String("--- Instance {0}").format(varray(instance_index)));
-			// for (int z = 0; z < info.voxels->get_size().z; ++z) {
-			// 	for (int x = 0; x < info.voxels->get_size().x; ++x) {
-			// 		String s;
-			// 		for (int y = 0; y < info.voxels->get_size().y; ++y) {
-			// 			float sdf = info.voxels->get_voxel_f(x, y, z, VoxelBuffer::CHANNEL_SDF);
-			// 			if (sdf < -0.1f) {
-			// 				s += "X ";
-			// 			} else if (sdf < 0.f) {
-			// 				s += "x ";
-			// 			} else {
-			// 				s += "- ";
-			// 			}
-			// 		}
-			// 		print_line(s);
-			// 	}
-			// 	print_line("//");
-			// }
-
-			const Transform3D local_transform(
-					Basis(),
-					info.world_pos
-							// Undo min padding
-							+ Vector3i(1, 1, 1)
-			);
+		for (const FloatingChunkVoxels &chunk_voxels : chunks_voxels) {
+			const Transform3D local_transform = get_floating_chunk_local_transform(chunk_voxels.world_pos);
 
-			for (int i = 0; i < materials.size(); ++i) {
-				if ((materials_to_instance_mask & (1 << i)) != 0) {
-					Ref<ShaderMaterial> sm = materials[i];
-					ZN_ASSERT_CONTINUE(sm.is_valid());
-					sm = sm->duplicate(false);
-					// That parameter should have a valid default value matching the local transform relative to the
-					// volume, which is usually per-instance, but in Godot 3 we have no such feature, so we have to
-					// duplicate.
-					// TODO Try using per-instance parameters for scalar uniforms (Godot 4 doesn't support textures)
-					sm->set_shader_parameter(
-							VoxelStringNames::get_singleton().u_block_local_transform, local_transform
-					);
-					materials[i] = sm;
-				}
-			}
+			instance_materials(materials, materials_to_instance_mask, local_transform);
 
 			// TODO If normalmapping is used here with the Transvoxel mesher, we need to either turn it off just for
 			// this call, or to pass the right options
-			Ref<ArrayMesh> mesh = mesher->build_mesh(info.voxels, materials, Dictionary());
+			Ref<ArrayMesh> mesh = mesher->build_mesh(chunk_voxels.voxels, materials, Dictionary());
 			// The mesh is not supposed to be null,
 			// because we build these buffers from connected groups that had negative SDF.
 			ERR_CONTINUE(mesh.is_null());
@@ -440,57 +499,15 @@ Array separate_floating_chunks(
 				continue;
 			}
 
-			// DEBUG
-			// {
-			// 	Ref<VoxelBlockSerializer> serializer;
-			// 	serializer.instance();
-			// 	Ref<StreamPeerBuffer> peer;
-			// 	peer.instance();
-			// 	serializer->serialize(peer, info.voxels, false);
-			// 	String fpath = String("debug_data/split_dump_{0}.bin").format(varray(instance_index));
-			// 	FileAccess *f = FileAccess::open(fpath, FileAccess::WRITE);
-			// 	PoolByteArray bytes = peer->get_data_array();
-			// 	PoolByteArray::Read bytes_read = bytes.read();
-			// 	f->store_buffer(bytes_read.ptr(), bytes.size());
-			// 	f->close();
-			// 	memdelete(f);
-			// }
-
 			// TODO Option to make multiple convex shapes
 			// TODO Use the fast way. This is slow because of the internal TriangleMesh thing and mesh data query.
 			// TODO Don't create a body if the mesh has no triangles
 			Ref<Shape3D> shape = mesh->create_convex_shape();
 			ERR_CONTINUE(shape.is_null());
-			CollisionShape3D *collision_shape = memnew(CollisionShape3D);
-			collision_shape->set_shape(shape);
-			// Center the shape somewhat, because Godot is confusing node origin with center of mass
-			const Vector3i size =
-					local_bounds.max_pos - local_bounds.min_pos + Vector3iUtil::create(1 + max_padding + min_padding);
-			const Vector3 offset = -Vector3(size) * 0.5f;
-			collision_shape->set_position(offset);
-
-			RigidBody3D *rigid_body = memnew(RigidBody3D);
-			rigid_body->set_transform(terrain_transform * local_transform.translated_local(-offset));
-			rigid_body->add_child(collision_shape);
-			rigid_body->set_freeze_mode(RigidBody3D::FREEZE_MODE_KINEMATIC);
-			rigid_body->set_freeze_enabled(true);
-
-			// Switch to rigid after a short time to workaround clipping with terrain,
-			// because colliders are updated asynchronously
-			Timer *timer = memnew(Timer);
-			timer->set_wait_time(0.2);
-			timer->set_one_shot(true);
-			timer->connect("timeout", callable_mp(rigid_body, &RigidBody3D::set_freeze_enabled).bind(false));
-			// Cannot use start() here because it requires to be inside the SceneTree,
-			// and we don't know if it will be after we add to the parent.
-			timer->set_autostart(true);
-			rigid_body->add_child(timer);
-
-			MeshInstance3D *mesh_instance = memnew(MeshInstance3D);
-			mesh_instance->set_mesh(mesh);
-			mesh_instance->set_position(offset);
-			rigid_body->add_child(mesh_instance);
 
+			RigidBody3D *rigid_body = create_floating_chunk_body(
+					mesh, shape, chunk_voxels.voxels.get_size(), local_transform, terrain_transform
+			);
 			parent_node->add_child(rigid_body);
 
 			nodes.append(rigid_body);
@@ -500,4 +517,720 @@ Array separate_floating_chunks(
 	return nodes;
 }
 
+} // namespace
+
+// Turns floating chunks of voxels into rigidbodies:
+// Detects separate groups of connected voxels within a box. Each group fully contained in the box is removed from
+// the source volume, and turned into a rigidbody.
+// This is one way of doing it, I don't know if it's the best way (there is rarely a best way)
+// so there are probably other approaches that could be explored in the future, if they have better performance
+Array separate_floating_chunks(
+		VoxelTool &voxel_tool,
+		Box3i world_box,
+		Node *parent_node,
+		Transform3D terrain_transform,
+		Ref<VoxelMesher> mesher,
+		Array materials
+) {
+	ZN_PROFILE_SCOPE();
+
+	// Checks
+	ERR_FAIL_COND_V(mesher.is_null(), Array());
+	ERR_FAIL_COND_V(parent_node == nullptr, Array());
+
+	StdVector<FloatingChunkVoxels> chunks_voxels;
+	find_floating_chunks_voxels(voxel_tool, world_box, chunks_voxels);
+
+	return extract_floating_chunks(
+			voxel_tool, to_span_const(chunks_voxels), parent_node, terrain_transform, mesher, materials
+	);
+}
+
+void find_floating_chunks_voxels(
+		const VoxelTool &voxel_tool,
+		Box3i world_box,
+		StdVector<FloatingChunkVoxels> &out_chunks_voxels
+) {
+	ZN_PROFILE_SCOPE();
+	// TODO Do not assume channel, at the moment it's hardcoded for smooth terrain
+	static const int channels_mask = (1 << VoxelBuffer::CHANNEL_SDF);
+	find_and_copy_floating_chunks(
+			[&voxel_tool](Vector3i pos, VoxelBuffer &dst) { voxel_tool.copy(pos, dst, channels_mask); },
+			world_box,
+			out_chunks_voxels
+	);
+}
+
+void find_floating_chunks_voxels(
+		const VoxelData &data,
+		Box3i world_box,
+		StdVector<FloatingChunkVoxels> &out_chunks_voxels
+) {
+	ZN_PROFILE_SCOPE();
+	// TODO Do not assume channel, at the moment it's hardcoded for smooth terrain
+	static const int channels_mask = (1 << VoxelBuffer::CHANNEL_SDF);
+	find_and_copy_floating_chunks(
+			[&data](Vector3i pos, VoxelBuffer &dst) { data.copy(pos, dst, channels_mask); },
+			world_box,
+			out_chunks_voxels
+	);
+}
+
+void FloatingChunksCache::clear() {
+	_region = Box3i();
+	_labels.clear();
+	_groups.clear();
+	_next_label = 1;
+	_valid = false;
+}
+
+void FloatingChunksCache::rebuild(
+		Box3i region,
+		Span<const uint8_t> solid,
+		StdVector<FloatingChunk> &out_floating_chunks
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(solid.size() == Vector3iUtil::get_volume_u64(region.size));
+
+	_region = region;
+	_labels.clear();
+	_labels.resize(solid.size(), 0);
+	_groups.clear();
+	_next_label = 1;
+	_valid = true;
+
+	label_area(Box3i(Vector3i(), region.size), solid, out_floating_chunks);
+}
+
+void FloatingChunksCache::get_labels_touching(Box3i box, StdVector<uint32_t> &out_labels) const {
+	box.for_each_cell_zxy([this, &out_labels](Vector3i pos) {
+		const uint32_t label = _labels[Vector3iUtil::get_zxy_index(pos, _region.size)];
+		if (label != 0 && !contains(to_span_const(out_labels), label)) {
+			out_labels.push_back(label);
+		}
+	});
+}
+
+Box3i FloatingChunksCache::get_update_box(Box3i edited_box) const {
+	ZN_ASSERT_RETURN_V(_valid, Box3i());
+
+	const Box3i local_region(Vector3i(), _region.size);
+	Box3i update_box = edited_box.padded(1).clipped(local_region);
+	if (update_box.is_empty()) {
+		return update_box;
+	}
+
+	// Groups touching the edited area may have been split or merged with others
+	StdVector<uint32_t> labels;
+	get_labels_touching(update_box, labels);
+
+	for (const uint32_t label : labels) {
+		auto it = _groups.find(label);
+		ZN_ASSERT_CONTINUE(it != _groups.end());
+		const Bounds &bounds = it->second;
+		update_box.merge_with(Box3i::from_min_max(bounds.min_pos, bounds.max_pos + Vector3i(1, 1, 1)));
+	}
+
+	return update_box;
+}
+
+void FloatingChunksCache::update(
+		Box3i edited_box,
+		Span<const uint8_t> solid,
+		StdVector<FloatingChunk> &out_floating_chunks
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(_valid);
+
+	const Box3i update_box = get_update_box(edited_box);
+	if (update_box.is_empty()) {
+		return;
+	}
+	ZN_ASSERT_RETURN(solid.size() == Vector3iUtil::get_volume_u64(update_box.size));
+
+	// Forget groups touching the edited area. They are entirely contained in the update box.
+	{
+		StdVector<uint32_t> labels;
+		get_labels_touching(edited_box.padded(1).clipped(Box3i(Vector3i(), _region.size)), labels);
+		for (const uint32_t label : labels) {
+			_groups.erase(label);
+		}
+
+		update_box.for_each_cell_zxy([this, &labels](Vector3i pos) {
+			uint32_t &label = _labels[Vector3iUtil::get_zxy_index(pos, _region.size)];
+			if (label != 0 && contains(to_span_const(labels), label)) {
+				label = 0;
+			}
+		});
+	}
+
+	// Only label solid voxels that don't belong to a group anymore. Others are part of groups that were not affected.
+	static thread_local StdVector<uint8_t> tls_candidates;
+	StdVector<uint8_t> &candidates = tls_candidates;
+	candidates.resize(solid.size());
+	{
+		unsigned int i = 0;
+		Vector3i pos;
+		for (pos.z = update_box.position.z; pos.z < update_box.position.z + update_box.size.z; ++pos.z) {
+			for (pos.x = update_box.position.x; pos.x < update_box.position.x + update_box.size.x; ++pos.x) {
+				pos.y = update_box.position.y;
+				unsigned int label_index = Vector3iUtil::get_zxy_index(pos, _region.size);
+				for (; pos.y < update_box.position.y + update_box.size.y; ++pos.y, ++i, ++label_index) {
+					candidates[i] = solid[i] != 0 && _labels[label_index] == 0;
+				}
+			}
+		}
+	}
+
+	label_area(update_box, to_span(candidates), out_floating_chunks);
+}
+
+void FloatingChunksCache::label_area(
+		Box3i box,
+		Span<const uint8_t> candidates,
+		StdVector<FloatingChunk> &out_floating_chunks
+) {
+	ZN_PROFILE_SCOPE();
+
+	// Two-pass connected component labelling, where equivalences between provisional labels are resolved with a
+	// union-find. Unlike `IslandFinder`, the number of groups is not limited.
+
+	static thread_local StdVector<uint32_t> tls_provisional_labels;
+	static thread_local StdVector<uint32_t> tls_parents;
+	StdVector<uint32_t> &provisional_labels = tls_provisional_labels;
+	StdVector<uint32_t> &parents = tls_parents;
+
+	provisional_labels.clear();
+	provisional_labels.resize(candidates.size(), 0);
+	parents.clear();
+	// Label 0 means empty
+	parents.push_back(0);
+
+	struct L {
+		static uint32_t find_root(StdVector<uint32_t> &parents, uint32_t label) {
+			while (parents[label] != label) {
+				// Path halving
+				parents[label] = parents[parents[label]];
+				label = parents[label];
+			}
+			return label;
+		}
+
+		static uint32_t unite(StdVector<uint32_t> &parents, uint32_t a, uint32_t b) {
+			a = find_root(parents, a);
+			b = find_root(parents, b);
+			if (a < b) {
+				parents[b] = a;
+				return a;
+			}
+			parents[a] = b;
+			return b;
+		}
+	};
+
+	const int dx = box.size.y;
+	const int dz = box.size.x * box.size.y;
+
+	{
+		ZN_PROFILE_SCOPE_NAMED("Scan");
+		unsigned int i = 0;
+		Vector3i pos;
+		for (pos.z = 0; pos.z < box.size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < box.size.x; ++pos.x) {
+				for (pos.y = 0; pos.y < box.size.y; ++pos.y, ++i) {
+					if (candidates[i] == 0) {
+						continue;
+					}
+
+					uint32_t label = 0;
+					if (pos.y > 0 && provisional_labels[i - 1] != 0) {
+						label = provisional_labels[i - 1];
+					}
+					if (pos.x > 0 && provisional_labels[i - dx] != 0) {
+						const uint32_t other = provisional_labels[i - dx];
+						label = label == 0 ? other : L::unite(parents, label, other);
+					}
+					if (pos.z > 0 && provisional_labels[i - dz] != 0) {
+						const uint32_t other = provisional_labels[i - dz];
+						label = label == 0 ? other : L::unite(parents, label, other);
+					}
+					if (label == 0) {
+						label = parents.size();
+						parents.push_back(label);
+					}
+
+					provisional_labels[i] = label;
+				}
+			}
+		}
+	}
+
+	// Assign final labels and compute bounds of new groups
+
+	static thread_local StdVector<uint32_t> tls_final_labels;
+	StdVector<uint32_t> &final_labels = tls_final_labels;
+	final_labels.clear();
+	final_labels.resize(parents.size(), 0);
+
+	const unsigned int new_groups_begin = _next_label;
+
+	{
+		ZN_PROFILE_SCOPE_NAMED("Resolve");
+		unsigned int i = 0;
+		Vector3i pos;
+		for (pos.z = 0; pos.z < box.size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < box.size.x; ++pos.x) {
+				for (pos.y = 0; pos.y < box.size.y; ++pos.y, ++i) {
+					const uint32_t provisional_label = provisional_labels[i];
+					if (provisional_label == 0) {
+						continue;
+					}
+
+					const uint32_t root = L::find_root(parents, provisional_label);
+					uint32_t &label = final_labels[root];
+
+					const Vector3i region_pos = box.position + pos;
+
+					if (label == 0) {
+						label = _next_label;
+						++_next_label;
+						_groups.insert({ label, Bounds{ region_pos, region_pos } });
+
+					} else {
+						Bounds &bounds = _groups[label];
+						bounds.min_pos = math::min(bounds.min_pos, region_pos);
+						bounds.max_pos = math::max(bounds.max_pos, region_pos);
+					}
+
+					_labels[Vector3iUtil::get_zxy_index(region_pos, _region.size)] = label;
+				}
+			}
+		}
+	}
+
+	// Groups that don't touch the border of the region are floating
+
+	const Vector3i lbmax = _region.size - Vector3i(1, 1, 1);
+
+	for (uint32_t label = new_groups_begin; label < _next_label; ++label) {
+		const Bounds &bounds = _groups[label];
+		if ( //
+				bounds.min_pos.x == 0 //
+				|| bounds.min_pos.y == 0 //
+				|| bounds.min_pos.z == 0 //
+				|| bounds.max_pos.x == lbmax.x //
+				|| bounds.max_pos.y == lbmax.y //
+				|| bounds.max_pos.z == lbmax.z) {
+			continue;
+		}
+		out_floating_chunks.push_back(FloatingChunk{ label, bounds.min_pos, bounds.max_pos });
+	}
+}
+
+void FloatingChunksCache::remove(const FloatingChunk &chunk) {
+	_groups.erase(chunk.label);
+
+	const Box3i box = Box3i::from_min_max(chunk.min_pos, chunk.max_pos + Vector3i(1, 1, 1));
+	box.clipped(Box3i(Vector3i(), _region.size)).for_each_cell_zxy([this, &chunk](Vector3i pos) {
+		uint32_t &label = _labels[Vector3iUtil::get_zxy_index(pos, _region.size)];
+		if (label == chunk.label) {
+			label = 0;
+		}
+	});
+}
+
+namespace {
+
+// Gets which voxels of a box are solid, in ZXY order
+void copy_solid_mask(VoxelTool &voxel_tool, Box3i world_box, StdVector<uint8_t> &out_solid) {
+	ZN_PROFILE_SCOPE_NAMED("Copy");
+
+	// TODO Do not assume channel, at the moment it's hardcoded for smooth terrain
+	static const int channels_mask = (1 << VoxelBuffer::CHANNEL_SDF);
+	static const VoxelBuffer::ChannelId main_channel = VoxelBuffer::CHANNEL_SDF;
+
+	VoxelBuffer buffer(VoxelBuffer::ALLOCATOR_POOL);
+	buffer.create(world_box.size);
+	voxel_tool.copy(world_box.position, buffer, channels_mask);
+
+	out_solid.resize(Vector3iUtil::get_volume_u64(world_box.size));
+
+	unsigned int i = 0;
+	Vector3i pos;
+	for (pos.z = 0; pos.z < world_box.size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < world_box.size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < world_box.size.y; ++pos.y, ++i) {
+				out_solid[i] = buffer.get_voxel_f(pos, main_channel) < 0.f;
+			}
+		}
+	}
+}
+
+} // namespace
+
+Array separate_floating_chunks_incremental(
+		VoxelTool &voxel_tool,
+		FloatingChunksCache &cache,
+		Box3i world_box,
+		Box3i edited_world_box,
+		Node *parent_node,
+		Transform3D terrain_transform,
+		Ref<VoxelMesher> mesher,
+		Array materials
+) {
+	ZN_PROFILE_SCOPE();
+
+	// Checks
+	ERR_FAIL_COND_V(mesher.is_null(), Array());
+	ERR_FAIL_COND_V(parent_node == nullptr, Array());
+
+	static thread_local StdVector<uint8_t> tls_solid;
+	StdVector<uint8_t> &solid = tls_solid;
+
+	StdVector<FloatingChunk> floating_chunks;
+	Box3i update_box;
+
+	if (!cache.is_valid() || cache.get_region() != world_box) {
+		update_box = Box3i(Vector3i(), world_box.size);
+		copy_solid_mask(voxel_tool, world_box, solid);
+		cache.rebuild(world_box, to_span(solid), floating_chunks);
+
+	} else {
+		const Box3i local_edited_box(edited_world_box.position - world_box.position, edited_world_box.size);
+		update_box = cache.get_update_box(local_edited_box);
+		if (update_box.is_empty()) {
+			return Array();
+		}
+		copy_solid_mask(voxel_tool, Box3i(world_box.position + update_box.position, update_box.size), solid);
+		cache.update(local_edited_box, to_span(solid), floating_chunks);
+	}
+
+	if (floating_chunks.size() == 0) {
+		return Array();
+	}
+
+	// Labels are propagated on a copy, the cache must only contain solid voxels.
+	// Floating groups don't touch the border of the region, so the margin is always inside it.
+	const Box3i labels_box = update_box.padded(2).clipped(Box3i(Vector3i(), world_box.size));
+
+	static thread_local StdVector<uint32_t> tls_labels;
+	StdVector<uint32_t> &labels = tls_labels;
+	labels.resize(Vector3iUtil::get_volume_u64(labels_box.size));
+	{
+		Span<const uint32_t> cache_labels = cache.get_labels();
+		unsigned int i = 0;
+		Vector3i pos;
+		for (pos.z = labels_box.position.z; pos.z < labels_box.position.z + labels_box.size.z; ++pos.z) {
+			for (pos.x = labels_box.position.x; pos.x < labels_box.position.x + labels_box.size.x; ++pos.x) {
+				pos.y = labels_box.position.y;
+				const unsigned int src_index = Vector3iUtil::get_zxy_index(pos, world_box.size);
+				for (unsigned int y = 0; y < static_cast<unsigned int>(labels_box.size.y); ++y, ++i) {
+					labels[i] = cache_labels[src_index + y];
+				}
+			}
+		}
+	}
+
+	// Propagate labels to improve SDF quality, like the non-incremental version
+	box_propagate_ccl(to_span(labels), labels_box.size);
+
+	// Convert positions and include propagated cells in bounds
+	for (FloatingChunk &chunk : floating_chunks) {
+		cache.remove(chunk);
+
+		chunk.min_pos -= labels_box.position;
+		chunk.max_pos -= labels_box.position;
+
+		Box3i chunk_box = Box3i::from_min_max(chunk.min_pos, chunk.max_pos + Vector3i(1, 1, 1));
+		chunk_box = chunk_box.padded(1).clipped(Box3i(Vector3i(), labels_box.size));
+
+		chunk_box.for_each_cell_zxy([&chunk, &labels, &labels_box](Vector3i pos) {
+			if (labels[Vector3iUtil::get_zxy_index(pos, labels_box.size)] == chunk.label) {
+				chunk.min_pos = math::min(chunk.min_pos, pos);
+				chunk.max_pos = math::max(chunk.max_pos, pos);
+			}
+		});
+	}
+
+	// TODO Do not assume channel, at the moment it's hardcoded for smooth terrain
+	static const int channels_mask = (1 << VoxelBuffer::CHANNEL_SDF);
+
+	StdVector<FloatingChunkVoxels> chunks_voxels;
+	copy_floating_chunks_voxels(
+			[&voxel_tool](Vector3i pos, VoxelBuffer &dst) { voxel_tool.copy(pos, dst, channels_mask); },
+			world_box.position + labels_box.position,
+			to_span_const(labels),
+			labels_box.size,
+			to_span_const(floating_chunks),
+			chunks_voxels
+	);
+
+	return extract_floating_chunks(
+			voxel_tool, to_span_const(chunks_voxels), parent_node, terrain_transform, mesher, materials
+	);
+}
+
+namespace {
+
+// State shared by tasks applying results of the same request on the main thread
+struct FloatingChunksApplyState {
+	uint32_t request_id = 0;
+	zylann::godot::ObjectWeakRef<VoxelNode> terrain_ref;
+	zylann::godot::ObjectWeakRef<Node> parent_ref;
+	// Only used after checking the terrain still exists
+	Ref<VoxelTool> voxel_tool;
+	Ref<VoxelMesher> mesher;
+	Array materials;
+	uint32_t materials_to_instance_mask = 0;
+	Array bodies;
+	unsigned int remaining_count = 0;
+};
+
+// Group of voxels found, extracted and meshed on a thread
+struct FloatingChunkTaskOutput {
+	FloatingChunkTaskOutput(FloatingChunkVoxels &&p_chunk_voxels) : chunk_voxels(std::move(p_chunk_voxels)) {}
+
+	FloatingChunkVoxels chunk_voxels;
+	VoxelMesher::Output mesher_output;
+	// Resources are built on the thread if the engine allows it, otherwise on the main thread
+	Ref<ArrayMesh> mesh;
+	StdVector<uint16_t> mesh_material_indices;
+	bool has_mesh_resource = false;
+	Ref<Shape3D> shape;
+	bool has_shape_resource = false;
+};
+
+// Unlike `Mesh::create_convex_shape`, this doesn't need a mesh resource. Godot computes the hull from the points.
+Ref<Shape3D> create_convex_shape(const VoxelMesher::Output &mesher_output) {
+	PackedVector3Array points;
+	for (const VoxelMesher::Output::Surface &surface : mesher_output.surfaces) {
+		if (surface.arrays.is_empty()) {
+			continue;
+		}
+		const PackedVector3Array vertices = surface.arrays[Mesh::ARRAY_VERTEX];
+		points.append_array(vertices);
+	}
+	if (points.size() == 0) {
+		return Ref<Shape3D>();
+	}
+	Ref<ConvexPolygonShape3D> shape;
+	shape.instantiate();
+	shape->set_points(points);
+	return shape;
+}
+
+// Erases a group of voxels from the terrain and creates its rigidbody, on the main thread. The last task of a request
+// emits the signal.
+class ApplyFloatingChunkTask : public ITimeSpreadTask {
+public:
+	void run(TimeSpreadTaskContext &ctx) override {
+		ZN_PROFILE_SCOPE();
+		FloatingChunksApplyState &state = *apply_state;
+
+		if (output != nullptr) {
+			apply(state, *output);
+		}
+
+		ZN_ASSERT_RETURN(state.remaining_count > 0);
+		--state.remaining_count;
+		if (state.remaining_count == 0) {
+			VoxelNode *terrain = state.terrain_ref.get();
+			if (terrain != nullptr) {
+				terrain->emit_signal(
+						VoxelStringNames::get_singleton().floating_chunks_separated, state.request_id, state.bodies
+				);
+			}
+		}
+	}
+
+	std::shared_ptr<FloatingChunksApplyState> apply_state;
+	// Null if no floating chunk was found
+	UniquePtr<FloatingChunkTaskOutput> output;
+
+private:
+	static void apply(FloatingChunksApplyState &state, FloatingChunkTaskOutput &output) {
+		VoxelNode *terrain = state.terrain_ref.get();
+		Node *parent_node = state.parent_ref.get();
+		if (terrain == nullptr || parent_node == nullptr) {
+			// Destroyed while chunks were being processed. Voxels are left in place.
+			return;
+		}
+
+		// Voxels may have been edited since they were copied by the task. Like edits, the erase takes whichever
+		// voxels are now in the area into account.
+		const FloatingChunkVoxels &chunk_voxels = output.chunk_voxels;
+		state.voxel_tool->set_channel(VoxelBuffer::CHANNEL_SDF);
+		state.voxel_tool->sdf_stamp_erase(chunk_voxels.voxels, chunk_voxels.world_pos);
+
+		if (!output.has_mesh_resource) {
+			output.mesh = build_mesh(
+					to_span_const(output.mesher_output.surfaces),
+					output.mesher_output.primitive_type,
+					output.mesher_output.mesh_flags,
+					output.mesh_material_indices
+			);
+		}
+		if (output.mesh.is_null()) {
+			// Nothing visible, but the voxels were still removed like with the synchronous version
+			return;
+		}
+
+		if (!output.has_shape_resource) {
+			output.shape = create_convex_shape(output.mesher_output);
+		}
+		ERR_FAIL_COND(output.shape.is_null());
+
+		const Transform3D local_transform = get_floating_chunk_local_transform(chunk_voxels.world_pos);
+		instance_materials(state.materials, state.materials_to_instance_mask, local_transform);
+
+		for (unsigned int surface_index = 0; surface_index < output.mesh_material_indices.size(); ++surface_index) {
+			const unsigned int material_index = output.mesh_material_indices[surface_index];
+			Ref<Material> material;
+			if (int(material_index) < state.materials.size()) {
+				material = state.materials[material_index];
+			}
+			if (material.is_null()) {
+				material = state.mesher->get_material_by_index(material_index);
+			}
+			output.mesh->surface_set_material(surface_index, material);
+		}
+
+		RigidBody3D *rigid_body = create_floating_chunk_body(
+				output.mesh,
+				output.shape,
+				chunk_voxels.voxels.get_size(),
+				local_transform,
+				terrain->get_global_transform()
+		);
+		parent_node->add_child(rigid_body);
+
+		state.bodies.append(rigid_body);
+	}
+};
+
+// Finds floating chunks, extracts and meshes them on a thread
+class SeparateFloatingChunksTask : public IThreadedTask {
+public:
+	const char *get_debug_name() const override {
+		return "SeparateFloatingChunks";
+	}
+
+	void run(ThreadedTaskContext &ctx) override {
+		ZN_PROFILE_SCOPE();
+		ZN_ASSERT(data != nullptr);
+		ZN_ASSERT(mesher.is_valid());
+
+		StdVector<FloatingChunkVoxels> chunks_voxels;
+		find_floating_chunks_voxels(*data, world_box, chunks_voxels);
+
+		const VoxelEngine &engine = VoxelEngine::get_singleton();
+		const bool build_mesh_resources = engine.is_threaded_graphics_resource_building_enabled();
+		const bool build_shape_resources = engine.is_threaded_collision_shape_building_enabled();
+
+		StdVector<ITimeSpreadTask *> apply_tasks;
+
+		for (FloatingChunkVoxels &chunk_voxels : chunks_voxels) {
+			ZN_PROFILE_SCOPE_NAMED("Meshing");
+
+			UniquePtr<FloatingChunkTaskOutput> output =
+					make_unique_instance<FloatingChunkTaskOutput>(std::move(chunk_voxels));
+
+			// TODO If normalmapping is used here with the Transvoxel mesher, we need to either turn it off just for
+			// this call, or to pass the right options
+			const VoxelMesher::Input input{ output->chunk_voxels.voxels, nullptr, Vector3i(), 0, false, false, false };
+			mesher->build(output->mesher_output, input);
+
+			if (build_mesh_resources) {
+				output->mesh = build_mesh(
+						to_span_const(output->mesher_output.surfaces),
+						output->mesher_output.primitive_type,
+						output->mesher_output.mesh_flags,
+						output->mesh_material_indices
+				);
+				output->has_mesh_resource = true;
+			}
+			if (build_shape_resources) {
+				output->shape = create_convex_shape(output->mesher_output);
+				output->has_shape_resource = true;
+			}
+
+			ApplyFloatingChunkTask *task = ZN_NEW(ApplyFloatingChunkTask);
+			task->apply_state = apply_state;
+			task->output = std::move(output);
+			apply_tasks.push_back(task);
+		}
+
+		if (apply_tasks.size() == 0) {
+			// Still report the request as completed
+			ApplyFloatingChunkTask *task = ZN_NEW(ApplyFloatingChunkTask);
+			task->apply_state = apply_state;
+			apply_tasks.push_back(task);
+		}
+
+		// Not accessed by the main thread before tasks are pushed
+		apply_state->remaining_count = apply_tasks.size();
+
+		for (ITimeSpreadTask *task : apply_tasks) {
+			VoxelEngine::get_singleton().push_main_thread_time_spread_task(task);
+		}
+	}
+
+	TaskPriority get_priority() override {
+		// Chunks usually separate because of an edit, so they should show up as quickly as edited meshes
+		return TaskPriority(0, 0, constants::TASK_PRIORITY_EDITED_MESH_BAND2, constants::TASK_PRIORITY_BAND3_DEFAULT);
+	}
+
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_MESHING;
+	}
+
+	std::shared_ptr<VoxelData> data;
+	Box3i world_box;
+	Ref<VoxelMesher> mesher;
+	std::shared_ptr<FloatingChunksApplyState> apply_state;
+};
+
+std::atomic_uint32_t g_next_floating_chunks_request_id = { 1 };
+
+} // namespace
+
+uint32_t separate_floating_chunks_async(
+		VoxelNode &terrain,
+		std::shared_ptr<VoxelData> data,
+		Box3i world_box,
+		Node *parent_node,
+		Ref<VoxelMesher> mesher,
+		Array materials
+) {
+	ZN_PROFILE_SCOPE();
+
+	// Checks
+	ERR_FAIL_COND_V(data == nullptr, 0);
+	ERR_FAIL_COND_V(mesher.is_null(), 0);
+	ERR_FAIL_COND_V(parent_node == nullptr, 0);
+
+	std::shared_ptr<FloatingChunksApplyState> apply_state = make_shared_instance<FloatingChunksApplyState>();
+
+	// Done on the main thread, because it queries shaders
+	if (!get_materials_to_instance_mask(materials, apply_state->materials_to_instance_mask)) {
+		return 0;
+	}
+
+	apply_state->request_id = g_next_floating_chunks_request_id.fetch_add(1, std::memory_order_relaxed);
+	apply_state->terrain_ref.set(&terrain);
+	apply_state->parent_ref.set(parent_node);
+	apply_state->voxel_tool = terrain.get_voxel_tool();
+	apply_state->mesher = mesher;
+	apply_state->materials = materials;
+
+	SeparateFloatingChunksTask *task = ZN_NEW(SeparateFloatingChunksTask);
+	task->data = data;
+	task->world_box = world_box;
+	task->mesher = mesher;
+	task->apply_state = apply_state;
+	VoxelEngine::get_singleton().push_async_task(task);
+
+	return apply_state->request_id;
+}
+
 } // namespace zylann::voxel
@@ -2,15 +2,22 @@
 #define VOXEL_FLOATING_CHUNKS_H
 
 #include "../meshers/voxel_mesher.h"
+#include "../storage/voxel_buffer.h"
+#include "../util/containers/span.h"
+#include "../util/containers/std_unordered_map.h"
+#include "../util/containers/std_vector.h"
 #include "../util/godot/core/array.h"
 #include "../util/math/box3i.h"
 #include "../util/math/transform_3d.h"
+#include <memory>
 
 ZN_GODOT_FORWARD_DECLARE(class Node);
 
 namespace zylann::voxel {
 
 class VoxelTool;
+class VoxelNode;
+class VoxelData;
 
 Array separate_floating_chunks(
 		VoxelTool &voxel_tool,
@@ -21,6 +28,122 @@ Array separate_floating_chunks(
 		Array materials
 );
 
+// Group of connected solid voxels. Positions are inclusive, and local to the area the group was found in.
+struct FloatingChunk {
+	uint32_t label;
+	Vector3i min_pos;
+	Vector3i max_pos;
+};
+
+// Voxels of a floating group, padded for meshing, in which voxels of other groups were removed
+struct FloatingChunkVoxels {
+	VoxelBuffer voxels;
+	Vector3i world_pos;
+};
+
+// Finds groups of voxels within `world_box` that don't touch its border, and copies each of them from the volume.
+// This is what `separate_floating_chunks` does before erasing and meshing them.
+void find_floating_chunks_voxels(
+		const VoxelTool &voxel_tool,
+		Box3i world_box,
+		StdVector<FloatingChunkVoxels> &out_chunks_voxels
+);
+
+// Same as above, but reads `data` directly. This is what `separate_floating_chunks_async` does on a thread.
+void find_floating_chunks_voxels(
+		const VoxelData &data,
+		Box3i world_box,
+		StdVector<FloatingChunkVoxels> &out_chunks_voxels
+);
+
+// Keeps labels of connected groups of solid voxels within a region, so that after an edit, only groups touching the
+// edited area have to be labelled again, instead of the whole region.
+// Groups that don't touch the border of the region are floating. They are expected to be removed from the volume as
+// soon as they are found, so all the groups remaining in the cache touch the border.
+class FloatingChunksCache {
+public:
+	inline bool is_valid() const {
+		return _valid;
+	}
+
+	inline Box3i get_region() const {
+		return _region;
+	}
+
+	void clear();
+
+	// Labels the whole region. `solid` contains a non-zero value for each solid voxel of the region, in ZXY order.
+	// Positions of floating groups are local to the region.
+	void rebuild(Box3i region, Span<const uint8_t> solid, StdVector<FloatingChunk> &out_floating_chunks);
+
+	// Gets the area to read again after voxels changed within `edited_box`: the edited box padded by one voxel, and the
+	// bounds of groups touching it. Boxes are local to the region.
+	Box3i get_update_box(Box3i edited_box) const;
+
+	// Labels again groups touching `edited_box`, where `solid` covers the box returned by `get_update_box`.
+	// Groups that became floating are returned, with positions local to the region.
+	void update(Box3i edited_box, Span<const uint8_t> solid, StdVector<FloatingChunk> &out_floating_chunks);
+
+	// Forgets a floating group after it was removed from the volume
+	void remove(const FloatingChunk &chunk);
+
+	// Labels of every voxel of the region in ZXY order, 0 meaning empty
+	inline Span<const uint32_t> get_labels() const {
+		return to_span(_labels);
+	}
+
+	inline unsigned int get_group_count() const {
+		return _groups.size();
+	}
+
+private:
+	struct Bounds {
+		Vector3i min_pos;
+		Vector3i max_pos;
+	};
+
+	void get_labels_touching(Box3i box, StdVector<uint32_t> &out_labels) const;
+
+	void label_area(
+			Box3i box,
+			Span<const uint8_t> candidates,
+			StdVector<FloatingChunk> &out_floating_chunks
+	);
+
+	Box3i _region;
+	StdVector<uint32_t> _labels;
+	StdUnorderedMap<uint32_t, Bounds> _groups;
+	uint32_t _next_label = 1;
+	bool _valid = false;
+};
+
+// Same as `separate_floating_chunks`, but uses a cache so that only groups of voxels touching `edited_world_box` are
+// checked. The edited box must include all voxels that changed within `world_box` since the last call. The cache is
+// rebuilt if `world_box` is different from the last call.
+Array separate_floating_chunks_incremental(
+		VoxelTool &voxel_tool,
+		FloatingChunksCache &cache,
+		Box3i world_box,
+		Box3i edited_world_box,
+		Node *parent_node,
+		Transform3D terrain_transform,
+		Ref<VoxelMesher> mesher,
+		Array materials
+);
+
+// Same as `separate_floating_chunks`, but groups of voxels are found, extracted and meshed in a threaded task. They are
+// then erased from the terrain and turned into rigidbodies on the main thread, spread over frames within the time
+// budget of VoxelEngine. Once all are created, the terrain emits `floating_chunks_separated` with the returned ID and
+// the bodies. Returns 0 if the request could not be made.
+uint32_t separate_floating_chunks_async(
+		VoxelNode &terrain,
+		std::shared_ptr<VoxelData> data,
+		Box3i world_box,
+		Node *parent_node,
+		Ref<VoxelMesher> mesher,
+		Array materials
+);
+
 } // namespace zylann::voxel
 
 #endif // VOXEL_FLOATING_CHUNKS_H
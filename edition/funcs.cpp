@@ -1,12 +1,20 @@
 #include "funcs.h"
+#include "../engine/voxel_engine.h"
 #include "../meshers/blocky/voxel_blocky_library_base.h"
 #include "../storage/voxel_data.h"
 #include "../util/containers/dynamic_bitset.h"
 #include "../util/containers/span.h"
 #include "../util/containers/std_vector.h"
+#include "../util/godot/core/packed_arrays.h"
 #include "../util/godot/core/random_pcg.h"
+#include "../util/godot/core/typed_array.h"
+#include "../util/math/constants.h"
+#include "../util/math/float4.h"
 #include "../util/profiling.h"
 #include "../util/string/format.h"
+#include "blocky_random_ticker.h"
+#include <algorithm>
+#include <cstring>
 
 #ifdef ZN_GODOT_EXTENSION
 using namespace godot;
@@ -285,6 +293,59 @@ void run_blocky_random_tick(
 	);
 }
 
+void run_blocky_random_tick_batched(
+		BlockyRandomTicker &ticker,
+		VoxelData &data,
+		const VoxelBlockyLibraryBase &lib,
+		int block_count,
+		int voxels_per_block,
+		const Callable &callback
+) {
+	ERR_FAIL_COND(block_count < 0);
+	ERR_FAIL_COND(voxels_per_block < 0);
+
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = [](Span<IThreadedTask *> tasks) { //
+		VoxelEngine::get_singleton().push_async_tasks(tasks);
+	};
+	const unsigned int thread_count = VoxelEngine::get_singleton().get_thread_count();
+	scheduler.max_helpers = thread_count > 0 ? thread_count - 1 : 0;
+
+	static thread_local StdVector<BlockyRandomTicker::Hit> tls_hits;
+	StdVector<BlockyRandomTicker::Hit> &hits = tls_hits;
+	hits.clear();
+
+	ticker.tick(data, lib, block_count, voxels_per_block, scheduler, hits);
+
+	if (hits.size() == 0) {
+		return;
+	}
+
+	TypedArray<Vector3i> positions;
+	positions.resize(hits.size());
+	PackedInt32Array values;
+	values.resize(hits.size());
+	int32_t *values_w = values.ptrw();
+	for (unsigned int i = 0; i < hits.size(); ++i) {
+		positions[i] = hits[i].position;
+		values_w[i] = hits[i].value;
+	}
+
+	// The callback may edit voxels, it is called after all locks were released
+#ifdef ZN_GODOT
+	const Variant positions_v = positions;
+	const Variant values_v = values;
+	const Variant *args[2] = { &positions_v, &values_v };
+	Callable::CallError error;
+	Variant retval; // We don't care about the return value, Callable API requires it
+	callback.callp(args, 2, retval, error);
+	ERR_FAIL_COND(error.error != Callable::CallError::CALL_OK);
+#elif defined(ZN_GODOT_EXTENSION)
+	// TODO GDX: No way to detect or report errors when calling a Callable. Do I need to?
+	callback.call(positions, values);
+#endif
+}
+
 bool indices_to_bitarray_u16(Span<const int32_t> indices, DynamicBitset &bitarray) {
 #ifdef DEBUG_ENABLED
 	const int32_t max_supported_value = 65535;
@@ -303,7 +364,8 @@ bool indices_to_bitarray_u16(Span<const int32_t> indices, DynamicBitset &bitarra
 		max_value = math::max(i, max_value);
 	}
 
-	bitarray.resize_no_init(indices.size() / 8);
+	bitarray.resize_no_init(max_value + 1);
+	bitarray.fill(false);
 
 	for (const int32_t i : indices) {
 		bitarray.set(i);
@@ -332,6 +394,68 @@ Box3i get_round_cone_int_bounds(Vector3f p0, Vector3f p1, float r0, float r1) {
 	return Box3i::from_min_max(to_vec3i(math::floor(minp)), to_vec3i(math::ceil(maxp)));
 }
 
+void bin_path_segments_in_blocks(
+		Span<const math::SdfRoundConePrecalc<float>> segments,
+		int margin,
+		Box3i clip_box,
+		unsigned int block_size_po2,
+		StdVector<PathBlockSegment> &out_bins
+) {
+	ZN_PROFILE_SCOPE();
+	out_bins.clear();
+
+	const int block_size = 1 << block_size_po2;
+	const float block_half_size = 0.5f * block_size;
+	// Distance from the center of a block to its corners
+	const float block_bounding_radius = block_half_size * math::SQRT3_32;
+
+	for (unsigned int segment_index = 0; segment_index < segments.size(); ++segment_index) {
+		const math::SdfRoundConePrecalc<float> &cone = segments[segment_index];
+
+		const Box3i segment_box =
+				get_round_cone_int_bounds(cone.a, cone.b, cone.r1, cone.r2).padded(margin).clipped(clip_box);
+		if (segment_box.is_empty()) {
+			continue;
+		}
+
+		// The round cone is contained in a capsule using the largest of its radii, which is cheaper to test against
+		const float max_distance = math::max(cone.r1, cone.r2) + margin + block_bounding_radius;
+		const float max_distance_sq = max_distance * max_distance;
+		const Vector3f ab = cone.b - cone.a;
+		const float ab_length_sq = math::length_squared(ab);
+
+		const Box3i blocks_box = segment_box.downscaled(block_size);
+
+		blocks_box.for_each_cell_zxy([&out_bins,
+									  &cone,
+									  ab,
+									  ab_length_sq,
+									  max_distance_sq,
+									  block_size_po2,
+									  block_half_size,
+									  segment_index](Vector3i bpos) {
+			const Vector3f block_center = to_vec3f(bpos << block_size_po2) + Vector3f(block_half_size);
+			const Vector3f ap = block_center - cone.a;
+			const float t = ab_length_sq > 0.f ? math::clamp(math::dot(ap, ab) / ab_length_sq, 0.f, 1.f) : 0.f;
+			if (math::length_squared(ap - ab * t) > max_distance_sq) {
+				return;
+			}
+			out_bins.push_back(PathBlockSegment{ bpos, segment_index });
+		});
+	}
+
+	// Group segments by block. Sorting is stable, so segments of a block remain in path order.
+	std::stable_sort(out_bins.begin(), out_bins.end(), [](const PathBlockSegment &a, const PathBlockSegment &b) {
+		if (a.block_position.z != b.block_position.z) {
+			return a.block_position.z < b.block_position.z;
+		}
+		if (a.block_position.x != b.block_position.x) {
+			return a.block_position.x < b.block_position.x;
+		}
+		return a.block_position.y < b.block_position.y;
+	});
+}
+
 #ifdef DEBUG_ENABLED
 
 // Reference implementation. Correct but very slow.
@@ -391,9 +515,14 @@ void box_blur_slow_ref(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vec
 	}
 }
 
-#endif
-
-void box_blur(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sphere_pos, float sphere_radius) {
+// Previous implementation, blurring one line at a time with ring buffers. Kept as a benchmark reference.
+void box_blur_ring_buffer_ref(
+		const VoxelBuffer &src,
+		VoxelBuffer &dst,
+		int radius,
+		Vector3f sphere_pos,
+		float sphere_radius
+) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT_RETURN(radius >= 1);
 
@@ -424,6 +553,12 @@ void box_blur(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sph
 	const unsigned int rb_mask = rb_len - 1;
 	ZN_ASSERT(static_cast<int>(ring_buffer.size()) >= box_size);
 
+	// Convert source voxels all at once, which is faster than reading them one by one
+	StdVector<float> src_sdf;
+	const Vector3i src_size = src.get_size();
+	src_sdf.resize(Vector3iUtil::get_volume_u64(src_size));
+	src.get_channel_f(VoxelBuffer::CHANNEL_SDF, to_span(src_sdf));
+
 	// Temporary buffer with extra length in two axes
 	StdVector<float> tmp;
 	const Vector3i tmp_size(dst_size.x + 2 * radius, dst_size.y, dst_size.z + 2 * radius);
@@ -438,11 +573,12 @@ void box_blur(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sph
 		for (dst_pos.z = 0; dst_pos.z < tmp_size.z; ++dst_pos.z) {
 			for (dst_pos.x = 0; dst_pos.x < tmp_size.x; ++dst_pos.x) {
 				float sd_sum = 0.f;
+				// Source values are contiguous along Y
+				const float *src_row =
+						src_sdf.data() + Vector3iUtil::get_zxy_index(Vector3i(dst_pos.x, 0, dst_pos.z), src_size);
 				// Fill window with initial samples
 				for (int y = 0; y < box_size; ++y) {
-					// TODO The fact we sample this way for the first axis makes it a lot slower than the others.
-					// Make tmp larger to fit the whole size and convert first into it?
-					const float sd = src.get_voxel_f(Vector3i(dst_pos.x, y, dst_pos.z), VoxelBuffer::CHANNEL_SDF);
+					const float sd = src_row[y];
 					ring_buffer[y] = sd;
 					sd_sum += sd;
 				}
@@ -457,9 +593,7 @@ void box_blur(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sph
 
 				for (dst_pos.y = 1; dst_pos.y < tmp_size.y; ++dst_pos.y) {
 					// Look 2*radius ahead because we sample from a buffer that's also bigger than tmp in Y
-					const float sd = src.get_voxel_f(
-							Vector3i(dst_pos.x, dst_pos.y + radius * 2, dst_pos.z), VoxelBuffer::CHANNEL_SDF
-					);
+					const float sd = src_row[dst_pos.y + radius * 2];
 					// Remove sample exiting the window
 					sd_sum -= ring_buffer[rbr];
 					// Add sample entering the window
@@ -565,18 +699,22 @@ void box_blur(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sph
 
 	{
 		ZN_PROFILE_SCOPE_NAMED("Blend");
+		// Results are converted into the destination all at once at the end
+		StdVector<float> dst_sdf;
+		dst_sdf.resize(Vector3iUtil::get_volume_u64(dst_size));
+		unsigned int dst_i = 0;
+
 		for (dst_pos.z = 0; dst_pos.z < dst_size.z; ++dst_pos.z) {
 			for (dst_pos.x = 0; dst_pos.x < dst_size.x; ++dst_pos.x) {
-				for (dst_pos.y = 0; dst_pos.y < dst_size.y; ++dst_pos.y) {
+				for (dst_pos.y = 0; dst_pos.y < dst_size.y; ++dst_pos.y, ++dst_i) {
 					//
 					const Vector3i src_pos = dst_pos + Vector3i(radius, radius, radius);
-					// TODO It might be possible to optimize this read
-					const float src_sd = src.get_voxel_f(src_pos, VoxelBuffer::CHANNEL_SDF);
+					const float src_sd = src_sdf[Vector3iUtil::get_zxy_index(src_pos, src_size)];
 
 					const float sphere_ds = math::distance_squared(sphere_pos, to_vec3f(dst_pos));
 					if (sphere_ds > sphere_radius_s) {
 						// Outside of brush
-						dst.set_voxel_f(src_sd, dst_pos, VoxelBuffer::CHANNEL_SDF);
+						dst_sdf[dst_i] = src_sd;
 						continue;
 					}
 
@@ -587,12 +725,231 @@ void box_blur(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sph
 					const unsigned int tmp_loc = Vector3iUtil::get_zxy_index(tmp_pos, tmp_size);
 					const float tmp_sd = tmp[tmp_loc];
 
-					const float sd = Math::lerp(src_sd, tmp_sd, factor);
-					dst.set_voxel_f(sd, dst_pos, VoxelBuffer::CHANNEL_SDF);
+					dst_sdf[dst_i] = Math::lerp(src_sd, tmp_sd, factor);
+				}
+			}
+		}
+
+		dst.set_channel_f(VoxelBuffer::CHANNEL_SDF, to_span(dst_sdf));
+	}
+}
+
+#endif
+
+namespace {
+
+// Helpers processing contiguous rows of floats, so they can use SIMD.
+// They do the same operations in the same order on each element as scalar code would, so results don't depend on
+// whether an element ends up in a pack or in the remainder.
+
+inline void add_row(float *sums, const float *src, const unsigned int count) {
+	unsigned int i = 0;
+	for (; i + math::Float4::SIZE <= count; i += math::Float4::SIZE) {
+		(math::Float4::load(sums + i) + math::Float4::load(src + i)).store(sums + i);
+	}
+	for (; i < count; ++i) {
+		sums[i] += src[i];
+	}
+}
+
+// Moves a running sum by one step: removes the row exiting the window, then adds the row entering it
+inline void slide_row(float *sums, const float *exiting, const float *entering, const unsigned int count) {
+	unsigned int i = 0;
+	for (; i + math::Float4::SIZE <= count; i += math::Float4::SIZE) {
+		const math::Float4 sum = math::Float4::load(sums + i) - math::Float4::load(exiting + i);
+		(sum + math::Float4::load(entering + i)).store(sums + i);
+	}
+	for (; i < count; ++i) {
+		const float sum = sums[i] - exiting[i];
+		sums[i] = sum + entering[i];
+	}
+}
+
+inline void divide_row(float *dst, const float *sums, const float divisor, const unsigned int count) {
+	unsigned int i = 0;
+	const math::Float4 divisor4(divisor);
+	for (; i + math::Float4::SIZE <= count; i += math::Float4::SIZE) {
+		(math::Float4::load(sums + i) / divisor4).store(dst + i);
+	}
+	for (; i < count; ++i) {
+		dst[i] = sums[i] / divisor;
+	}
+}
+
+// Box-blurs a buffer along an axis whose consecutive slices are `slice_length` contiguous floats. All elements of a
+// slice are independent, so they are summed with SIMD, while the window moves from slice to slice.
+// `dst` has `2 * radius` fewer slices than `src`.
+void box_blur_slices(
+		Span<const float> src,
+		Span<float> dst,
+		const unsigned int slice_length,
+		const unsigned int dst_slice_count,
+		const int radius,
+		StdVector<float> &sums
+) {
+	const unsigned int box_size = radius * 2 + 1;
+	const float box_size_f = box_size;
+
+	ZN_ASSERT(src.size() >= (dst_slice_count + 2 * radius) * slice_length);
+	ZN_ASSERT(dst.size() >= dst_slice_count * slice_length);
+
+	sums.clear();
+	sums.resize(slice_length, 0.f);
+
+	for (unsigned int i = 0; i < box_size; ++i) {
+		add_row(sums.data(), src.data() + i * slice_length, slice_length);
+	}
+	divide_row(dst.data(), sums.data(), box_size_f, slice_length);
+
+	for (unsigned int i = 1; i < dst_slice_count; ++i) {
+		slide_row(
+				sums.data(),
+				src.data() + (i - 1) * slice_length,
+				src.data() + (i - 1 + box_size) * slice_length,
+				slice_length
+		);
+		divide_row(dst.data() + i * slice_length, sums.data(), box_size_f, slice_length);
+	}
+}
+
+} // namespace
+
+void box_blur(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sphere_pos, float sphere_radius) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(radius >= 1);
+
+	const Vector3i dst_size = src.get_size() - Vector3i(radius, radius, radius) * 2;
+
+	ZN_ASSERT_RETURN(dst_size.x >= 0);
+	ZN_ASSERT_RETURN(dst_size.y >= 0);
+	ZN_ASSERT_RETURN(dst_size.z >= 0);
+
+	dst.create(dst_size);
+
+	if (Vector3iUtil::get_volume_u64(dst_size) == 0) {
+		return;
+	}
+
+	const int box_size = radius * 2 + 1;
+	const float box_size_f = box_size;
+
+	// Box blur is separable: we do a 1-dimensional blur along Y, then X, then Z, each time keeping a running sum of the
+	// window instead of summing all its samples. Buffers are in ZXY order, so Y is the contiguous axis. The X and Z
+	// passes process whole rows or slices of Y values at once, which can be done with SIMD.
+
+	// Convert source voxels all at once, which is faster than reading them one by one
+	StdVector<float> src_sdf;
+	const Vector3i src_size = src.get_size();
+	src_sdf.resize(Vector3iUtil::get_volume_u64(src_size));
+	src.get_channel_f(VoxelBuffer::CHANNEL_SDF, to_span(src_sdf));
+
+	// Y blur, result has extra length in X and Z
+	const Vector3i tmp_y_size(src_size.x, dst_size.y, src_size.z);
+	StdVector<float> tmp_y;
+	tmp_y.resize(Vector3iUtil::get_volume_u64(tmp_y_size));
+	{
+		ZN_PROFILE_SCOPE_NAMED("Y blur");
+		// The window moves along the contiguous axis, so this one is scalar
+		for (int z = 0; z < tmp_y_size.z; ++z) {
+			for (int x = 0; x < tmp_y_size.x; ++x) {
+				const float *src_row = src_sdf.data() + Vector3iUtil::get_zxy_index(Vector3i(x, 0, z), src_size);
+				float *tmp_row = tmp_y.data() + Vector3iUtil::get_zxy_index(Vector3i(x, 0, z), tmp_y_size);
+
+				float sd_sum = 0.f;
+				for (int y = 0; y < box_size; ++y) {
+					sd_sum += src_row[y];
+				}
+				tmp_row[0] = sd_sum / box_size_f;
+
+				for (int y = 1; y < tmp_y_size.y; ++y) {
+					sd_sum -= src_row[y - 1];
+					sd_sum += src_row[y - 1 + box_size];
+					tmp_row[y] = sd_sum / box_size_f;
 				}
 			}
 		}
 	}
+
+	StdVector<float> sums;
+
+	// X blur, result has extra length in Z
+	const Vector3i tmp_x_size(dst_size.x, dst_size.y, src_size.z);
+	StdVector<float> tmp_x;
+	tmp_x.resize(Vector3iUtil::get_volume_u64(tmp_x_size));
+	{
+		ZN_PROFILE_SCOPE_NAMED("X blur");
+		const unsigned int src_slice_volume = tmp_y_size.x * tmp_y_size.y;
+		const unsigned int dst_slice_volume = tmp_x_size.x * tmp_x_size.y;
+		for (int z = 0; z < tmp_x_size.z; ++z) {
+			box_blur_slices(
+					to_span_const(tmp_y).sub(z * src_slice_volume, src_slice_volume),
+					to_span(tmp_x).sub(z * dst_slice_volume, dst_slice_volume),
+					tmp_x_size.y,
+					tmp_x_size.x,
+					radius,
+					sums
+			);
+		}
+	}
+
+	// Z blur, straight into the final area
+	StdVector<float> dst_sdf;
+	dst_sdf.resize(Vector3iUtil::get_volume_u64(dst_size));
+	{
+		ZN_PROFILE_SCOPE_NAMED("Z blur");
+		box_blur_slices(to_span_const(tmp_x), to_span(dst_sdf), dst_size.x * dst_size.y, dst_size.z, radius, sums);
+	}
+
+	// Blend using shape
+
+	{
+		ZN_PROFILE_SCOPE_NAMED("Blend");
+
+		const float sphere_radius_s = sphere_radius * sphere_radius;
+
+		// Distance along Y only depends on Y, so it is computed once for all rows
+		StdVector<float> dy_squared;
+		dy_squared.resize(dst_size.y);
+		for (int y = 0; y < dst_size.y; ++y) {
+			dy_squared[y] = math::squared(static_cast<float>(y) - sphere_pos.y);
+		}
+
+		const math::Float4 sphere_radius_s4(sphere_radius_s);
+
+		for (int z = 0; z < dst_size.z; ++z) {
+			for (int x = 0; x < dst_size.x; ++x) {
+				const float *src_row = src_sdf.data() +
+						Vector3iUtil::get_zxy_index(Vector3i(x + radius, radius, z + radius), src_size);
+				float *dst_row = dst_sdf.data() + Vector3iUtil::get_zxy_index(Vector3i(x, 0, z), dst_size);
+
+				const float dxz_squared =
+						math::squared(static_cast<float>(x) - sphere_pos.x) +
+						math::squared(static_cast<float>(z) - sphere_pos.z);
+
+				if (dxz_squared > sphere_radius_s) {
+					// Whole row is outside of brush
+					memcpy(dst_row, src_row, dst_size.y * sizeof(float));
+					continue;
+				}
+
+				// Brush factor is zero outside of the sphere, which leaves source values unchanged
+				int y = 0;
+				for (; y + static_cast<int>(math::Float4::SIZE) <= dst_size.y; y += math::Float4::SIZE) {
+					const math::Float4 ds = math::Float4(dxz_squared) + math::Float4::load(dy_squared.data() + y);
+					const math::Float4 factor = math::clamp(1.f - ds / sphere_radius_s4, 0.f, 1.f);
+					math::lerp(math::Float4::load(src_row + y), math::Float4::load(dst_row + y), factor)
+							.store(dst_row + y);
+				}
+				for (; y < dst_size.y; ++y) {
+					const float ds = dxz_squared + dy_squared[y];
+					const float factor = math::clamp(1.f - ds / sphere_radius_s, 0.f, 1.f);
+					dst_row[y] = Math::lerp(src_row[y], dst_row[y], factor);
+				}
+			}
+		}
+
+		dst.set_channel_f(VoxelBuffer::CHANNEL_SDF, to_span(dst_sdf));
+	}
 }
 
 void grow_sphere(VoxelBuffer &src, float strength, Vector3f sphere_pos, float sphere_radius) {
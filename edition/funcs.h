@@ -244,6 +244,19 @@ void run_blocky_random_tick(
 		const Callable &callback
 );
 
+class BlockyRandomTicker;
+
+// Runs the next slice of random ticks over loaded blocks on the engine's threads, then calls
+// `callback(positions: Array[Vector3i], values: PackedInt32Array)` once with all hits, if there are any.
+void run_blocky_random_tick_batched(
+		BlockyRandomTicker &ticker,
+		VoxelData &data,
+		const VoxelBlockyLibraryBase &lib,
+		int block_count,
+		int voxels_per_block,
+		const Callable &callback
+);
+
 } // namespace zylann::voxel
 
 // Library of templates for executing per-voxel operations.
@@ -433,6 +446,44 @@ struct SdfRoundCone {
 	}
 };
 
+// Union of round cones, such as the segments of a path
+struct SdfRoundConeUnion {
+	Span<const math::SdfRoundConePrecalc<float>> cones;
+	float sdf_scale;
+
+	inline float operator()(Vector3f pos) const {
+		float sd = cones[0](pos);
+		for (unsigned int i = 1; i < cones.size(); ++i) {
+			sd = math::min(sd, cones[i](pos));
+		}
+		return sdf_scale * sd;
+	}
+
+	inline bool is_inside(Vector3f pos) const {
+		for (const math::SdfRoundConePrecalc<float> &cone : cones) {
+			if (cone(pos) < 0.f) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+struct PathBlockSegment {
+	Vector3i block_position;
+	uint32_t segment_index;
+};
+
+// Finds which blocks each segment of a path can affect, sorted by block. Blocks inside the bounding box of a segment
+// but further than `margin` from it are left out, which avoids going through most of the box of diagonal segments.
+void bin_path_segments_in_blocks(
+		Span<const math::SdfRoundConePrecalc<float>> segments,
+		int margin,
+		Box3i clip_box,
+		unsigned int block_size_po2,
+		StdVector<PathBlockSegment> &out_bins
+);
+
 struct TextureParams {
 	float opacity = 1.f;
 	float sharpness = 2.f;
@@ -717,6 +768,87 @@ struct DoShapeChunked {
 	}
 };
 
+// Executes an operation along a path of round cones in a chunked voxel storage. Each block the path goes through is
+// processed once, with only the segments that can affect it, instead of processing the bounding box of every segment.
+template <typename TBlockAccess>
+struct DoPathChunked {
+	Span<const Vector3> positions;
+	Span<const float> radii;
+	float sdf_scale;
+	Mode mode;
+	// VoxelBuffer *get_block(Vector3i bpos)
+	// unsigned int get_block_size_po2()
+	TBlockAccess block_access;
+	// Voxels outside of this box are not modified
+	Box3i clip_box;
+	int margin;
+	VoxelBuffer::ChannelId channel;
+	TextureParams texture_params;
+	uint32_t blocky_value;
+	float strength;
+
+	void operator()() {
+		ZN_PROFILE_SCOPE();
+		ZN_ASSERT_RETURN(positions.size() >= 2);
+		ZN_ASSERT_RETURN(positions.size() == radii.size());
+
+		static thread_local StdVector<math::SdfRoundConePrecalc<float>> tls_segments;
+		static thread_local StdVector<math::SdfRoundConePrecalc<float>> tls_block_segments;
+		static thread_local StdVector<PathBlockSegment> tls_bins;
+
+		StdVector<math::SdfRoundConePrecalc<float>> &segments = tls_segments;
+		segments.clear();
+		for (unsigned int point_index = 1; point_index < positions.size(); ++point_index) {
+			// TODO Could run this in local space so we dont need doubles
+			math::SdfRoundConePrecalc<float> cone;
+			cone.a = to_vec3f(positions[point_index - 1]);
+			cone.b = to_vec3f(positions[point_index]);
+			cone.r1 = radii[point_index - 1];
+			cone.r2 = radii[point_index];
+			cone.update();
+			segments.push_back(cone);
+		}
+
+		const unsigned int block_size_po2 = block_access.get_block_size_po2();
+
+		StdVector<PathBlockSegment> &bins = tls_bins;
+		bin_path_segments_in_blocks(to_span(segments), margin, clip_box, block_size_po2, bins);
+
+		StdVector<math::SdfRoundConePrecalc<float>> &block_segments = tls_block_segments;
+
+		unsigned int bin_index = 0;
+		while (bin_index < bins.size()) {
+			const Vector3i bpos = bins[bin_index].block_position;
+
+			block_segments.clear();
+			Box3i box;
+
+			for (; bin_index < bins.size() && bins[bin_index].block_position == bpos; ++bin_index) {
+				const math::SdfRoundConePrecalc<float> &cone = segments[bins[bin_index].segment_index];
+				const Box3i segment_box = get_round_cone_int_bounds(cone.a, cone.b, cone.r1, cone.r2).padded(margin);
+				box = block_segments.size() == 0 ? segment_box : Box3i::get_bounding_box(box, segment_box);
+				block_segments.push_back(cone);
+			}
+
+			DoShapeChunked<SdfRoundConeUnion, TBlockAccess> op;
+			op.shape.cones = to_span(block_segments);
+			op.shape.sdf_scale = sdf_scale;
+			op.block_access = block_access;
+			op.box = box.clipped(Box3i(bpos << block_size_po2, Vector3iUtil::create(1 << block_size_po2)))
+							 .clipped(clip_box);
+			op.mode = mode;
+			op.texture_params = texture_params;
+			op.blocky_value = blocky_value;
+			op.channel = channel;
+			op.strength = strength;
+
+			if (!op.box.is_empty()) {
+				op();
+			}
+		}
+	}
+};
+
 template <typename TShape>
 struct DoShapeSingleBuffer {
 	TShape shape;
@@ -783,6 +915,13 @@ struct DoShapeSingleBuffer {
 
 #ifdef DEBUG_ENABLED
 void box_blur_slow_ref(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sphere_pos, float sphere_radius);
+void box_blur_ring_buffer_ref(
+		const VoxelBuffer &src,
+		VoxelBuffer &dst,
+		int radius,
+		Vector3f sphere_pos,
+		float sphere_radius
+);
 #endif
 
 void box_blur(const VoxelBuffer &src, VoxelBuffer &dst, int radius, Vector3f sphere_pos, float sphere_radius);
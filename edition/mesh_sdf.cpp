@@ -1,10 +1,13 @@
 #include "mesh_sdf.h"
+#include "../util/containers/fixed_array.h"
 #include "../util/math/box3i.h"
 #include "../util/math/conv.h"
+#include "../util/math/float4.h"
 #include "../util/math/triangle.h"
 #include "../util/math/vector3d.h"
 #include "../util/profiling.h"
 #include "../util/string/format.h" // Debug
+#include "../util/tasks/parallel_jobs.h"
 #include "../util/voxel_raycast.h"
 
 // Debug
@@ -640,6 +643,27 @@ unsigned int get_closest_triangle_precalc(const Vector3f pos, Span<const Triangl
 	return closest_tri_index;
 }
 
+float get_signed_distance_from_closest_triangle(
+		const Vector3f pos,
+		const Triangle &closest_triangle,
+		const float distance_squared
+) {
+	const float d = Math::sqrt(distance_squared);
+
+	// if (p_dir == CLOCKWISE) {
+	// const Vector3f plane_normal = (ct.v1 - ct.v3).cross(ct.v1 - ct.v2).normalized();
+	const Vector3f plane_normal = get_normal(closest_triangle);
+	//} else {
+	//	normal = (p_point1 - p_point2).cross(p_point1 - p_point3);
+	//}
+	const float plane_d = math::dot(plane_normal, closest_triangle.v1);
+
+	if (math::dot(plane_normal, pos) > plane_d) {
+		return d;
+	}
+	return -d;
+}
+
 float get_mesh_signed_distance_at(const Vector3f pos, Span<const Triangle> triangles /*, bool debug = false*/) {
 	float min_distance_squared = 9999999.f;
 	size_t closest_tri_index = 0;
@@ -678,31 +702,21 @@ float get_mesh_signed_distance_at(const Vector3f pos, Span<const Triangle> trian
 		}
 	}
 
-	const Triangle &ct = triangles[closest_tri_index];
-	const float d = Math::sqrt(min_distance_squared);
-
-	// if (p_dir == CLOCKWISE) {
-	// const Vector3f plane_normal = (ct.v1 - ct.v3).cross(ct.v1 - ct.v2).normalized();
-	const Vector3f plane_normal = get_normal(ct);
-	//} else {
-	//	normal = (p_point1 - p_point2).cross(p_point1 - p_point3);
-	//}
-	const float plane_d = math::dot(plane_normal, ct.v1);
+	return get_signed_distance_from_closest_triangle(pos, triangles[closest_tri_index], min_distance_squared);
+}
 
-	if (math::dot(plane_normal, pos) > plane_d) {
-		return d;
-	}
-	return -d;
+inline unsigned int get_chunk_index(const Vector3f pos, const ChunkGrid &chunk_grid) {
+	const Vector3i chunk_pos = to_vec3i(math::floor((pos - chunk_grid.min_pos) / chunk_grid.chunk_size));
+	const unsigned int chunk_index = Vector3iUtil::get_zxy_index(chunk_pos, chunk_grid.size);
+	ZN_ASSERT(chunk_index < chunk_grid.chunks.size());
+	return chunk_index;
 }
 
 float get_mesh_signed_distance_at(const Vector3f pos, const ChunkGrid &chunk_grid) {
 	float min_distance_squared = 9999999.f;
 	const Triangle *closest_tri = nullptr;
 
-	const Vector3i chunk_pos = to_vec3i(math::floor((pos - chunk_grid.min_pos) / chunk_grid.chunk_size));
-	const unsigned chunk_index = Vector3iUtil::get_zxy_index(chunk_pos, chunk_grid.size);
-	ZN_ASSERT(chunk_index < chunk_grid.chunks.size());
-	const Chunk &chunk = chunk_grid.chunks[chunk_index];
+	const Chunk &chunk = chunk_grid.chunks[get_chunk_index(pos, chunk_grid)];
 
 	for (auto near_chunk_it = chunk.near_chunks.begin(); near_chunk_it != chunk.near_chunks.end(); ++near_chunk_it) {
 		const Chunk &near_chunk = **near_chunk_it;
@@ -726,21 +740,138 @@ float get_mesh_signed_distance_at(const Vector3f pos, const ChunkGrid &chunk_gri
 		}
 	}
 
-	const float d = Math::sqrt(min_distance_squared);
 	ZN_ASSERT(closest_tri != nullptr);
+	return get_signed_distance_from_closest_triangle(pos, *closest_tri, min_distance_squared);
+}
 
-	// if (p_dir == CLOCKWISE) {
-	// const Vector3f plane_normal = (ct.v1 - ct.v3).cross(ct.v1 - ct.v2).normalized();
-	const Vector3f plane_normal = get_normal(*closest_tri);
-	//} else {
-	//	normal = (p_point1 - p_point2).cross(p_point1 - p_point3);
-	//}
-	const float plane_d = math::dot(plane_normal, closest_tri->v1);
+// Finds the closest triangles to 4 points at once, processing each triangle with SIMD.
+// Gives the same results as doing it for each point separately.
+class ClosestTrianglesX4 {
+public:
+	ClosestTrianglesX4(const Vector3f p0, const Vector3f p1, const Vector3f p2, const Vector3f p3) {
+		_positions[0] = p0;
+		_positions[1] = p1;
+		_positions[2] = p2;
+		_positions[3] = p3;
+		_x = math::Float4::load(make_lane_array(p0.x, p1.x, p2.x, p3.x).data());
+		_y = math::Float4::load(make_lane_array(p0.y, p1.y, p2.y, p3.y).data());
+		_z = math::Float4::load(make_lane_array(p0.z, p1.z, p2.z, p3.z).data());
+		_min_distances_squared.fill(9999999.f);
+		_closest_triangles.fill(nullptr);
+	}
 
-	if (math::dot(plane_normal, pos) > plane_d) {
-		return d;
+	inline void add_triangle(const Triangle &t) {
+		const math::Float4 sqd = get_distance_to_triangle_squared_precalc(t);
+		FixedArray<float, math::Float4::SIZE> sqd_array;
+		sqd.store(sqd_array.data());
+		for (unsigned int i = 0; i < sqd_array.size(); ++i) {
+			if (sqd_array[i] < _min_distances_squared[i]) {
+				_min_distances_squared[i] = sqd_array[i];
+				_closest_triangles[i] = &t;
+			}
+		}
 	}
-	return -d;
+
+	void get_signed_distances(float *out_sd) const {
+		for (unsigned int i = 0; i < _positions.size(); ++i) {
+			ZN_ASSERT(_closest_triangles[i] != nullptr);
+			out_sd[i] = get_signed_distance_from_closest_triangle(
+					_positions[i], *_closest_triangles[i], _min_distances_squared[i]
+			);
+		}
+	}
+
+private:
+	static inline FixedArray<float, math::Float4::SIZE> make_lane_array(float a, float b, float c, float d) {
+		FixedArray<float, math::Float4::SIZE> lanes;
+		lanes[0] = a;
+		lanes[1] = b;
+		lanes[2] = c;
+		lanes[3] = d;
+		return lanes;
+	}
+
+	// Same as `dot(v, p - origin)`, with `p` being the 4 points
+	inline math::Float4 dot_relative(const Vector3f v, const Vector3f origin) const {
+		return (_x - origin.x) * v.x + (_y - origin.y) * v.y + (_z - origin.z) * v.z;
+	}
+
+	// Same as `length_squared(v * k - (p - origin))`, with `p` being the 4 points
+	inline math::Float4 edge_distance_squared(const Vector3f v, const math::Float4 k, const Vector3f origin) const {
+		const math::Float4 dx = k * v.x - (_x - origin.x);
+		const math::Float4 dy = k * v.y - (_y - origin.y);
+		const math::Float4 dz = k * v.z - (_z - origin.z);
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	// Same as the scalar version, written with the same operations in the same order so results are identical
+	inline math::Float4 get_distance_to_triangle_squared_precalc(const Triangle &t) const {
+		using namespace math;
+
+		const Float4 det = //
+				sign_nonzero(dot_relative(t.v21_cross_nor, t.v1)) + //
+				sign_nonzero(dot_relative(t.v32_cross_nor, t.v2)) + //
+				sign_nonzero(dot_relative(t.v13_cross_nor, t.v3));
+
+		// Outside of the prism: get distance to closest edge
+		const Float4 edges_sqd = min(
+				min( //
+						edge_distance_squared(
+								t.v21, clamp(dot_relative(t.v21, t.v1) * t.inv_v21_length_squared, 0.f, 1.f), t.v1
+						),
+						edge_distance_squared(
+								t.v32, clamp(dot_relative(t.v32, t.v2) * t.inv_v32_length_squared, 0.f, 1.f), t.v2
+						)
+				),
+				edge_distance_squared(
+						t.v13, clamp(dot_relative(t.v13, t.v3) * t.inv_v13_length_squared, 0.f, 1.f), t.v3
+				)
+		);
+
+		// Inside the prism: get distance to plane
+		const Float4 plane_d = dot_relative(t.nor, t.v1);
+		const Float4 plane_sqd = plane_d * plane_d * t.inv_nor_length_squared;
+
+		return select_less(det, 2.f, edges_sqd, plane_sqd);
+	}
+
+	FixedArray<Vector3f, math::Float4::SIZE> _positions;
+	math::Float4 _x;
+	math::Float4 _y;
+	math::Float4 _z;
+	FixedArray<float, math::Float4::SIZE> _min_distances_squared;
+	FixedArray<const Triangle *, math::Float4::SIZE> _closest_triangles;
+};
+
+void get_mesh_signed_distances_x4(const Vector3f *positions, Span<const Triangle> triangles, float *out_sd) {
+	ClosestTrianglesX4 closest(positions[0], positions[1], positions[2], positions[3]);
+	for (const Triangle &t : triangles) {
+		closest.add_triangle(t);
+	}
+	closest.get_signed_distances(out_sd);
+}
+
+void get_mesh_signed_distances_x4(const Vector3f *positions, const ChunkGrid &chunk_grid, float *out_sd) {
+	const unsigned int chunk_index = get_chunk_index(positions[0], chunk_grid);
+
+	// Positions are aligned along an axis, so if the first and last are in the same chunk, all of them are
+	if (chunk_index != get_chunk_index(positions[3], chunk_grid)) {
+		for (unsigned int i = 0; i < math::Float4::SIZE; ++i) {
+			out_sd[i] = get_mesh_signed_distance_at(positions[i], chunk_grid);
+		}
+		return;
+	}
+
+	const Chunk &chunk = chunk_grid.chunks[chunk_index];
+	ClosestTrianglesX4 closest(positions[0], positions[1], positions[2], positions[3]);
+
+	for (const Chunk *near_chunk : chunk.near_chunks) {
+		for (const Triangle *t : near_chunk->triangles) {
+			closest.add_triangle(*t);
+		}
+	}
+
+	closest.get_signed_distances(out_sd);
 }
 
 struct GridToSpaceConverter {
@@ -766,6 +897,17 @@ struct GridToSpaceConverter {
 	}
 };
 
+inline FixedArray<Vector3f, 4> get_positions_y_x4(
+		const GridToSpaceConverter &grid_to_space,
+		const Vector3i grid_pos
+) {
+	FixedArray<Vector3f, 4> positions;
+	for (unsigned int i = 0; i < positions.size(); ++i) {
+		positions[i] = grid_to_space(grid_pos + Vector3i(0, i, 0));
+	}
+	return positions;
+}
+
 struct Evaluator {
 	Span<const Triangle> triangles;
 	const GridToSpaceConverter grid_to_space;
@@ -773,6 +915,12 @@ struct Evaluator {
 	inline float operator()(const Vector3i grid_pos) const {
 		return get_mesh_signed_distance_at(grid_to_space(grid_pos), triangles);
 	}
+
+	// Evaluates 4 consecutive cells along the Y axis
+	inline void eval_y_x4(const Vector3i grid_pos, float *out_sd) const {
+		const FixedArray<Vector3f, 4> positions = get_positions_y_x4(grid_to_space, grid_pos);
+		get_mesh_signed_distances_x4(positions.data(), triangles, out_sd);
+	}
 };
 
 struct EvaluatorCG {
@@ -782,8 +930,45 @@ struct EvaluatorCG {
 	inline float operator()(const Vector3i grid_pos) const {
 		return get_mesh_signed_distance_at(grid_to_space(grid_pos), chunk_grid);
 	}
+
+	// Evaluates 4 consecutive cells along the Y axis
+	inline void eval_y_x4(const Vector3i grid_pos, float *out_sd) const {
+		const FixedArray<Vector3f, 4> positions = get_positions_y_x4(grid_to_space, grid_pos);
+		get_mesh_signed_distances_x4(positions.data(), chunk_grid, out_sd);
+	}
 };
 
+// Fills cells of a sub-box of the grid. The Y axis is contiguous in memory, so cells are evaluated 4 at a time along
+// it.
+template <typename TEvaluator>
+void generate_mesh_sdf_sub_box(
+		Span<float> sdf_grid,
+		const Vector3i res,
+		const Box3i sub_box,
+		const TEvaluator &eval
+) {
+	const Vector3i sub_box_end = sub_box.position + sub_box.size;
+
+	Vector3i grid_pos;
+	for (grid_pos.z = sub_box.position.z; grid_pos.z < sub_box_end.z; ++grid_pos.z) {
+		for (grid_pos.x = sub_box.position.x; grid_pos.x < sub_box_end.x; ++grid_pos.x) {
+			grid_pos.y = sub_box.position.y;
+			size_t grid_index = Vector3iUtil::get_zxy_index(grid_pos, res);
+
+			for (; grid_pos.y + 4 <= sub_box_end.y; grid_pos.y += 4) {
+				eval.eval_y_x4(grid_pos, &sdf_grid[grid_index]);
+				grid_index += 4;
+			}
+
+			for (; grid_pos.y < sub_box_end.y; ++grid_pos.y) {
+				ZN_ASSERT(grid_index < sdf_grid.size());
+				sdf_grid[grid_index] = eval(grid_pos);
+				++grid_index;
+			}
+		}
+	}
+}
+
 void generate_mesh_sdf_approx_interp(
 		Span<float> sdf_grid,
 		const Vector3i res,
@@ -929,25 +1114,7 @@ void generate_mesh_sdf_naive(
 	const Vector3f cell_size = mesh_size / Vector3f(res.x, res.y, res.z);
 	const Evaluator eval{ triangles, GridToSpaceConverter(res, min_pos, mesh_size, cell_size * 0.5f) };
 
-	Vector3i grid_pos;
-
-	const Vector3i sub_box_end = sub_box.position + sub_box.size;
-
-	for (grid_pos.z = sub_box.position.z; grid_pos.z < sub_box_end.z; ++grid_pos.z) {
-		for (grid_pos.x = sub_box.position.x; grid_pos.x < sub_box_end.x; ++grid_pos.x) {
-			grid_pos.y = sub_box.position.y;
-			size_t grid_index = Vector3iUtil::get_zxy_index(grid_pos, res);
-
-			for (; grid_pos.y < sub_box_end.y; ++grid_pos.y) {
-				const float sd = eval(grid_pos);
-
-				ZN_ASSERT(grid_index < sdf_grid.size());
-				sdf_grid[grid_index] = sd;
-
-				++grid_index;
-			}
-		}
-	}
+	generate_mesh_sdf_sub_box(sdf_grid, res, sub_box, eval);
 
 	// const uint64_t usec = profiling_clock.restart();
 	// println(format("Spent {} usec", usec));
@@ -969,24 +1136,7 @@ void generate_mesh_sdf_partitioned(
 	const Vector3f cell_size = mesh_size / Vector3f(res.x, res.y, res.z);
 	const EvaluatorCG eval{ chunk_grid, GridToSpaceConverter(res, min_pos, mesh_size, cell_size * 0.5f) };
 
-	const Vector3i sub_box_end = sub_box.position + sub_box.size;
-
-	Vector3i grid_pos;
-	for (grid_pos.z = sub_box.position.z; grid_pos.z < sub_box_end.z; ++grid_pos.z) {
-		for (grid_pos.x = sub_box.position.x; grid_pos.x < sub_box_end.x; ++grid_pos.x) {
-			grid_pos.y = sub_box.position.y;
-			size_t grid_index = Vector3iUtil::get_zxy_index(grid_pos, res);
-
-			for (; grid_pos.y < sub_box_end.y; ++grid_pos.y) {
-				const float sd = eval(grid_pos);
-
-				ZN_ASSERT(grid_index < sdf_grid.size());
-				sdf_grid[grid_index] = sd;
-
-				++grid_index;
-			}
-		}
-	}
+	generate_mesh_sdf_sub_box(sdf_grid, res, sub_box, eval);
 }
 
 void generate_mesh_sdf_partitioned(
@@ -995,13 +1145,22 @@ void generate_mesh_sdf_partitioned(
 		Span<const Triangle> triangles,
 		const Vector3f min_pos,
 		const Vector3f max_pos,
-		int subdiv
+		int subdiv,
+		const ParallelJobsScheduler &scheduler
 ) {
+	ZN_PROFILE_SCOPE();
+
 	// TODO Make this thread-local?
 	ChunkGrid chunk_grid;
 	partition_triangles(subdiv, triangles, min_pos, max_pos, chunk_grid);
 	compute_near_chunks(chunk_grid);
-	generate_mesh_sdf_partitioned(sdf_grid, res, Box3i(Vector3i(), res), min_pos, max_pos, chunk_grid);
+
+	// Indexing is ZXY so each job accesses a contiguous part of memory
+	run_parallel_jobs(res.z, scheduler, [sdf_grid, res, min_pos, max_pos, &chunk_grid](uint32_t z) {
+		generate_mesh_sdf_partitioned(
+				sdf_grid, res, Box3i(Vector3i(0, 0, z), Vector3i(res.x, res.y, 1)), min_pos, max_pos, chunk_grid
+		);
+	});
 }
 
 CheckResult check_sdf(
@@ -1098,9 +1257,14 @@ void generate_mesh_sdf_naive(
 		const Vector3i res,
 		Span<const Triangle> triangles,
 		const Vector3f min_pos,
-		const Vector3f max_pos
+		const Vector3f max_pos,
+		const ParallelJobsScheduler &scheduler
 ) {
-	generate_mesh_sdf_naive(sdf_grid, res, Box3i(Vector3i(), res), triangles, min_pos, max_pos);
+	run_parallel_jobs(res.z, scheduler, [sdf_grid, res, triangles, min_pos, max_pos](uint32_t z) {
+		generate_mesh_sdf_naive(
+				sdf_grid, res, Box3i(Vector3i(0, 0, z), Vector3i(res.x, res.y, 1)), triangles, min_pos, max_pos
+		);
+	});
 }
 
 bool prepare_triangles(
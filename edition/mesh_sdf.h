@@ -6,6 +6,7 @@
 #include "../util/containers/std_vector.h"
 #include "../util/math/vector3f.h"
 #include "../util/math/vector3i.h"
+#include "../util/tasks/parallel_jobs.h"
 #include "../util/tasks/threaded_task.h"
 
 #include <atomic>
@@ -103,24 +104,28 @@ void compute_near_chunks(ChunkGrid &chunk_grid);
 // A naive method to get a sampled SDF from a mesh, by checking every triangle at every cell. It's accurate, but much
 // slower than other techniques, but could be used as a CPU-based alternative, for less
 // realtime-intensive tasks. The mesh must be closed, otherwise the SDF will contain errors.
+// If a valid scheduler is given, Z slices of the grid are processed in parallel.
 void generate_mesh_sdf_naive(
 		Span<float> sdf_grid,
 		const Vector3i res,
 		Span<const Triangle> triangles,
 		const Vector3f min_pos,
-		const Vector3f max_pos
+		const Vector3f max_pos,
+		const ParallelJobsScheduler &scheduler = ParallelJobsScheduler()
 );
 
 // Compute the SDF faster by partitionning triangles, while retaining the same accuracy as if all triangles
 // were checked. With Suzanne mesh subdivided once with 3900 triangles and `subdiv = 32`, it's about 8 times fasterthan
 // checking every triangle on every cell.
+// If a valid scheduler is given, Z slices of the grid are processed in parallel.
 void generate_mesh_sdf_partitioned(
 		Span<float> sdf_grid,
 		const Vector3i res,
 		Span<const Triangle> triangles,
 		const Vector3f min_pos,
 		const Vector3f max_pos,
-		int subdiv
+		int subdiv,
+		const ParallelJobsScheduler &scheduler = ParallelJobsScheduler()
 );
 
 // Generates an approximation.
@@ -0,0 +1,247 @@
+#include "mesh_sdf_gpu_task.h"
+#include "../engine/gpu/compute_shader.h"
+#include "../engine/voxel_engine.h"
+#include "../util/dstack.h"
+#include "../util/godot/core/packed_arrays.h"
+#include "../util/math/conv.h"
+#include "../util/math/funcs.h"
+#include "../util/math/vector4f.h"
+#include "../util/profiling.h"
+
+#include "../util/godot/classes/rd_uniform.h"
+#include "../util/godot/classes/rendering_device.h"
+
+#include <cstring>
+
+using namespace zylann::godot;
+
+namespace zylann::voxel::mesh_sdf {
+
+namespace {
+
+// Must match the `Params` buffer in `mesh_sdf.glsl`
+struct Params {
+	Vector3f grid_translation;
+	uint32_t output_start;
+	Vector3f grid_scale;
+	float chunk_size;
+	Vector3i resolution;
+	int32_t _pad0;
+	Vector3f chunk_grid_min_pos;
+	int32_t _pad1;
+	Vector3i chunk_grid_size;
+	int32_t _pad2;
+};
+
+static_assert(sizeof(Params) == 80);
+
+// Must match `TRIANGLE_STRIDE` in `mesh_sdf.glsl`
+const unsigned int VECTORS_PER_TRIANGLE = 10;
+
+const int LOCAL_GROUP_SIZE = 4;
+
+Ref<RDUniform> make_storage_buffer_uniform(RID rid, int binding) {
+	Ref<RDUniform> uniform;
+	uniform.instantiate();
+	uniform->set_uniform_type(RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER);
+	uniform->add_id(rid);
+	uniform->set_binding(binding);
+	return uniform;
+}
+
+void pack_triangles(Span<const Triangle> triangles, StdVector<Vector4f> &out_data) {
+	out_data.reserve(triangles.size() * VECTORS_PER_TRIANGLE);
+	for (const Triangle &t : triangles) {
+		out_data.push_back(Vector4f(t.v1.x, t.v1.y, t.v1.z, t.inv_v21_length_squared));
+		out_data.push_back(Vector4f(t.v2.x, t.v2.y, t.v2.z, t.inv_v32_length_squared));
+		out_data.push_back(Vector4f(t.v3.x, t.v3.y, t.v3.z, t.inv_v13_length_squared));
+		out_data.push_back(Vector4f(t.v21.x, t.v21.y, t.v21.z, t.inv_nor_length_squared));
+		out_data.push_back(Vector4f(t.v32.x, t.v32.y, t.v32.z, 0.f));
+		out_data.push_back(Vector4f(t.v13.x, t.v13.y, t.v13.z, 0.f));
+		out_data.push_back(Vector4f(t.nor.x, t.nor.y, t.nor.z, 0.f));
+		out_data.push_back(Vector4f(t.v21_cross_nor.x, t.v21_cross_nor.y, t.v21_cross_nor.z, 0.f));
+		out_data.push_back(Vector4f(t.v32_cross_nor.x, t.v32_cross_nor.y, t.v32_cross_nor.z, 0.f));
+		out_data.push_back(Vector4f(t.v13_cross_nor.x, t.v13_cross_nor.y, t.v13_cross_nor.z, 0.f));
+	}
+}
+
+// Flattens the chunk grid into 4 integers per chunk, referring to lists of near chunks and triangles stored in
+// `out_indices`.
+void pack_chunk_grid(
+		const ChunkGrid &chunk_grid,
+		Span<const Triangle> triangles,
+		StdVector<uint32_t> &out_chunks,
+		StdVector<uint32_t> &out_indices
+) {
+	out_chunks.reserve(chunk_grid.chunks.size() * 4);
+
+	for (const Chunk &chunk : chunk_grid.chunks) {
+		out_chunks.push_back(out_indices.size());
+		out_chunks.push_back(chunk.near_chunks.size());
+		for (const Chunk *near_chunk : chunk.near_chunks) {
+			out_indices.push_back(near_chunk - chunk_grid.chunks.data());
+		}
+
+		out_chunks.push_back(out_indices.size());
+		out_chunks.push_back(chunk.triangles.size());
+		for (const Triangle *t : chunk.triangles) {
+			out_indices.push_back(t - triangles.data());
+		}
+	}
+}
+
+} // namespace
+
+unsigned int GenMeshSDFGPUTask::get_required_shared_output_buffer_size() const {
+	ZN_ASSERT(shared_data != nullptr);
+	return static_cast<unsigned int>(Vector3iUtil::get_volume_u64(shared_data->buffer.get_size()) * sizeof(float));
+}
+
+void GenMeshSDFGPUTask::prepare(GPUTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_DSTACK();
+	ZN_ASSERT(shared_data != nullptr);
+
+	const ComputeShader &shader = VoxelEngine::get_singleton().get_mesh_sdf_compute_shader();
+	ERR_FAIL_COND(!shader.is_valid());
+
+	const ChunkGrid &chunk_grid = shared_data->chunk_grid;
+	ERR_FAIL_COND(chunk_grid.chunks.size() == 0);
+	ERR_FAIL_COND(shared_data->triangles.size() == 0);
+
+	RenderingDevice &rd = ctx.rendering_device;
+	GPUStorageBufferPool &storage_buffer_pool = ctx.storage_buffer_pool;
+
+	// Triangles
+
+	StdVector<Vector4f> triangles_data;
+	pack_triangles(to_span(shared_data->triangles), triangles_data);
+
+	PackedByteArray triangles_pba;
+	copy_bytes_to<Vector4f>(triangles_pba, to_span(triangles_data));
+	_triangles_sb = storage_buffer_pool.allocate(triangles_pba);
+	ERR_FAIL_COND(_triangles_sb.is_null());
+
+	// Partitioning
+
+	StdVector<uint32_t> chunks_data;
+	StdVector<uint32_t> indices_data;
+	pack_chunk_grid(chunk_grid, to_span(shared_data->triangles), chunks_data, indices_data);
+
+	PackedByteArray chunks_pba;
+	copy_bytes_to<uint32_t>(chunks_pba, to_span(chunks_data));
+	_chunks_sb = storage_buffer_pool.allocate(chunks_pba);
+	ERR_FAIL_COND(_chunks_sb.is_null());
+
+	PackedByteArray indices_pba;
+	copy_bytes_to<uint32_t>(indices_pba, to_span(indices_data));
+	_indices_sb = storage_buffer_pool.allocate(indices_pba);
+	ERR_FAIL_COND(_indices_sb.is_null());
+
+	// Params
+
+	// Same transform as the CPU version
+	const Vector3i res = shared_data->buffer.get_size();
+	const Vector3f mesh_size = shared_data->max_pos - shared_data->min_pos;
+	const Vector3f cell_size = mesh_size / to_vec3f(res);
+
+	Params params;
+	params.grid_translation = shared_data->min_pos + cell_size * 0.5f;
+	params.output_start = ctx.shared_output_buffer_begin / sizeof(float);
+	params.grid_scale = cell_size;
+	params.chunk_size = chunk_grid.chunk_size;
+	params.resolution = res;
+	params._pad0 = 0;
+	params.chunk_grid_min_pos = chunk_grid.min_pos;
+	params._pad1 = 0;
+	params.chunk_grid_size = chunk_grid.size;
+	params._pad2 = 0;
+
+	PackedByteArray params_pba;
+	copy_bytes_to(params_pba, params);
+	_params_sb = storage_buffer_pool.allocate(params_pba);
+	ERR_FAIL_COND(_params_sb.is_null());
+
+	// Uniforms
+
+	Array uniforms;
+	uniforms.resize(5);
+	uniforms[0] = make_storage_buffer_uniform(_triangles_sb.rid, 0);
+	uniforms[1] = make_storage_buffer_uniform(_chunks_sb.rid, 1);
+	uniforms[2] = make_storage_buffer_uniform(_indices_sb.rid, 2);
+	uniforms[3] = make_storage_buffer_uniform(_params_sb.rid, 3);
+	uniforms[4] = make_storage_buffer_uniform(ctx.shared_output_buffer_rid, 4);
+
+	const RID shader_rid = shader.get_rid();
+	const RID uniform_set_rid = uniform_set_create(rd, uniforms, shader_rid, 0);
+
+	_pipeline_rid = rd.compute_pipeline_create(shader_rid);
+	ERR_FAIL_COND(!_pipeline_rid.is_valid());
+
+	// Dispatch
+
+	const Vector3i group_count = math::ceildiv(res, LOCAL_GROUP_SIZE);
+
+	const int compute_list_id = rd.compute_list_begin();
+	rd.compute_list_bind_compute_pipeline(compute_list_id, _pipeline_rid);
+	rd.compute_list_bind_uniform_set(compute_list_id, uniform_set_rid, 0);
+	rd.compute_list_dispatch(compute_list_id, group_count.x, group_count.y, group_count.z);
+	rd.compute_list_end();
+}
+
+void GenMeshSDFGPUTask::collect(GPUTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_DSTACK();
+
+	RenderingDevice &rd = ctx.rendering_device;
+	GPUStorageBufferPool &storage_buffer_pool = ctx.storage_buffer_pool;
+
+	// The pipeline is only created once everything else succeeded, otherwise the output contains garbage
+	if (_pipeline_rid.is_valid()) {
+		_output_data = ctx.downloaded_shared_output_data;
+		_output_begin = ctx.shared_output_buffer_begin;
+		_output_size = ctx.shared_output_buffer_size;
+
+		free_rendering_device_rid(rd, _pipeline_rid);
+	}
+
+	if (_triangles_sb.is_valid()) {
+		storage_buffer_pool.recycle(_triangles_sb);
+	}
+	if (_chunks_sb.is_valid()) {
+		storage_buffer_pool.recycle(_chunks_sb);
+	}
+	if (_indices_sb.is_valid()) {
+		storage_buffer_pool.recycle(_indices_sb);
+	}
+	if (_params_sb.is_valid()) {
+		storage_buffer_pool.recycle(_params_sb);
+	}
+}
+
+void GenMeshSDFGPUTask::finish() {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT(shared_data != nullptr);
+
+	VoxelBuffer &buffer = shared_data->buffer;
+	Span<float> sdf_grid;
+	ZN_ASSERT(buffer.get_channel_data(VoxelBuffer::CHANNEL_SDF, sdf_grid));
+
+	if (_output_size != sdf_grid.size() * sizeof(float)) {
+		ZN_PRINT_ERROR("Mesh SDF compute shader did not run");
+		on_complete(false);
+		return;
+	}
+
+	Span<const uint8_t> output = to_span(_output_data).sub(_output_begin, _output_size);
+	memcpy(sdf_grid.data(), output.data(), output.size());
+	_output_data = PackedByteArray();
+
+	if (shared_data->boundary_sign_fix) {
+		fix_sdf_sign_from_boundary(sdf_grid, buffer.get_size(), shared_data->min_pos, shared_data->max_pos);
+	}
+
+	on_complete(true);
+}
+
+} // namespace zylann::voxel::mesh_sdf
@@ -0,0 +1,46 @@
+#ifndef VOXEL_MESH_SDF_GPU_TASK_H
+#define VOXEL_MESH_SDF_GPU_TASK_H
+
+#include "../engine/gpu/gpu_storage_buffer_pool.h"
+#include "../engine/gpu/gpu_task_runner.h"
+#include "../util/godot/core/packed_byte_array.h"
+#include "mesh_sdf.h"
+
+#include <memory>
+
+namespace zylann::voxel::mesh_sdf {
+
+// Bakes a mesh SDF with a compute shader, using the same partitioning as `generate_mesh_sdf_partitioned`.
+// Distances are downloaded with the shared output buffer of the GPU task runner, then copied into the buffer of the
+// shared data.
+class GenMeshSDFGPUTask : public IGPUTask {
+public:
+	// Triangles must have been partitioned into the chunk grid, with near chunks computed
+	std::shared_ptr<GenMeshSDFSubBoxTask::SharedData> shared_data;
+
+	unsigned int get_required_shared_output_buffer_size() const override;
+
+	void prepare(GPUTaskContext &ctx) override;
+	void collect(GPUTaskContext &ctx) override;
+	void finish() override;
+
+	// Called from the GPU task runner's thread at the end of `finish`. If `success` is false, the buffer of the
+	// shared data is not filled.
+	virtual void on_complete(bool success) {}
+
+private:
+	GPUStorageBuffer _triangles_sb;
+	GPUStorageBuffer _chunks_sb;
+	GPUStorageBuffer _indices_sb;
+	GPUStorageBuffer _params_sb;
+	RID _pipeline_rid;
+
+	// Downloaded results, shared with other tasks of the same batch
+	PackedByteArray _output_data;
+	unsigned int _output_begin = 0;
+	unsigned int _output_size = 0;
+};
+
+} // namespace zylann::voxel::mesh_sdf
+
+#endif // VOXEL_MESH_SDF_GPU_TASK_H
@@ -1,16 +1,129 @@
 #include "raycast.h"
+#include "../engine/voxel_engine.h"
 #include "../meshers/blocky/voxel_mesher_blocky.h"
 #include "../meshers/cubes/voxel_mesher_cubes.h"
 #include "../storage/voxel_buffer.h"
 #include "../storage/voxel_data.h"
 #include "../terrain/voxel_node.h"
 #include "../util/godot/classes/ref_counted.h"
+#include "../util/math/conv.h"
+#include "../util/profiling.h"
+#include "../util/tasks/parallel_jobs.h"
 #include "../util/voxel_raycast.h"
 #include "funcs.h"
 #include "voxel_raycast_result.h"
 
+#include <algorithm>
+
 namespace zylann::voxel {
 
+namespace {
+
+// Reads voxels of one channel along a raycast. Consecutive voxels are mostly in the same block, so the block is looked
+// up and locked only when the ray enters a new one. Blocks that can't contain a hit are skipped without reading their
+// voxels, such as uniform blocks of air, or blocks the generator tells are air.
+// `TIsEmpty` is a function `bool(VoxelSingleValue)` telling if a voxel value can't be a hit.
+template <typename TIsEmpty>
+class RaycastBlockReader {
+public:
+	RaycastBlockReader(const VoxelData &data, unsigned int channel, VoxelSingleValue defval, TIsEmpty is_empty) :
+			_data(data), _channel(channel), _defval(defval), _is_empty(is_empty) {}
+
+	// Returns false if the voxel is in a block that can't contain any hit
+	bool try_get_voxel(Vector3i pos, VoxelSingleValue &out_value) {
+		if (!_access.is_valid() || !_access.get_voxel_box().contains(pos)) {
+			_data.acquire_block_read_access(pos, _access);
+			_skip_block = can_skip_block();
+		}
+		if (_skip_block) {
+			return false;
+		}
+		out_value = _access.get_voxel(pos, _channel, _defval);
+		return true;
+	}
+
+	void release() {
+		_access.release();
+	}
+
+private:
+	bool can_skip_block() const {
+		switch (_access.get_state()) {
+			case VoxelData::BlockReadAccess::STATE_NOT_LOADED:
+				return _is_empty(_defval);
+
+			case VoxelData::BlockReadAccess::STATE_STORED: {
+				const VoxelBuffer &voxels = *_access.get_voxels();
+				// Only check compression, looking at every voxel would cost more than reading those along the ray
+				if (voxels.get_channel_compression(_channel) != VoxelBuffer::COMPRESSION_UNIFORM) {
+					return false;
+				}
+				return _is_empty(get_uniform_value(voxels)) && is_out_of_bounds_empty();
+			}
+
+			case VoxelData::BlockReadAccess::STATE_GENERATED:
+				return is_generated_block_empty() && is_out_of_bounds_empty();
+
+			default:
+				return false;
+		}
+	}
+
+	// Voxels of the block lying outside the bounds of the volume read as the default value
+	bool is_out_of_bounds_empty() const {
+		return _data.get_bounds().contains(_access.get_voxel_box()) || _is_empty(_defval);
+	}
+
+	bool is_generated_block_empty() const {
+		ZN_PROFILE_SCOPE();
+
+		const Box3i voxel_box = _access.get_voxel_box();
+
+		if (_channel == VoxelBuffer::CHANNEL_SDF) {
+			// Modifiers are not part of the generator's broad phase
+			const AABB aabb(to_vec3(voxel_box.position), to_vec3(voxel_box.size));
+			if (_data.get_modifiers().has_modifiers_in_aabb(aabb)) {
+				return false;
+			}
+		}
+
+		Ref<VoxelGenerator> generator = _data.get_generator();
+		if (generator.is_null()) {
+			return false;
+		}
+
+		VoxelBuffer broad_voxels(VoxelBuffer::ALLOCATOR_POOL);
+		broad_voxels.create(Vector3iUtil::create(_data.get_block_size()));
+		VoxelGenerator::VoxelQueryData query{ broad_voxels, voxel_box.position, _access.get_lod_index() };
+		if (!generator->generate_broad_block(query)) {
+			return false;
+		}
+		if (!broad_voxels.is_uniform(_channel)) {
+			return false;
+		}
+		return _is_empty(get_uniform_value(broad_voxels));
+	}
+
+	VoxelSingleValue get_uniform_value(const VoxelBuffer &voxels) const {
+		VoxelSingleValue v;
+		if (_channel == VoxelBuffer::CHANNEL_SDF) {
+			v.f = voxels.get_voxel_f(Vector3i(), _channel);
+		} else {
+			v.i = voxels.get_voxel(Vector3i(), _channel);
+		}
+		return v;
+	}
+
+	const VoxelData &_data;
+	const unsigned int _channel;
+	const VoxelSingleValue _defval;
+	TIsEmpty _is_empty;
+	VoxelData::BlockReadAccess _access;
+	bool _skip_block = false;
+};
+
+} // namespace
+
 // Binary search can be more accurate than linear regression because the SDF can be inaccurate in the first place.
 // An alternative would be to polygonize a tiny area around the middle-phase hit position.
 // `d1` is how far from `pos0` along `dir` the binary search will take place.
@@ -62,37 +175,48 @@ float approximate_distance_to_isosurface_binary_search(
 	}
 }
 
-Ref<VoxelRaycastResult> raycast_sdf(
+namespace {
+
+struct SdfIsEmpty {
+	inline bool operator()(VoxelSingleValue v) const {
+		return v.f >= 0.f;
+	}
+};
+
+VoxelSingleValue get_sdf_raycast_default_value() {
+	VoxelSingleValue defval;
+	defval.f = constants::SDF_FAR_OUTSIDE;
+	return defval;
+}
+
+bool raycast_sdf_with_reader(
+		RaycastBlockReader<SdfIsEmpty> &reader,
 		const VoxelData &voxel_data,
 		const Vector3 ray_origin,
 		const Vector3 ray_dir,
 		const float max_distance,
-		const uint8_t binary_search_iterations
+		const uint8_t binary_search_iterations,
+		RaycastHit &out_hit
 ) {
 	// TODO Implement reverse raycast? (going from inside ground to air, could be useful for undigging)
 
-	// TODO Optimization: voxel raycast uses `get_voxel` which is the slowest, but could be made faster.
-	// Instead, do a broad-phase on blocks. If a block's voxels need to be parsed, get all positions the ray could go
-	// through in that block, then query them all at once (better for bulk processing without going again through
-	// locking and data structures, and allows SIMD). Then check results in order.
-	// If no hit is found, carry on with next blocks.
+	// TODO Optimization: if a block's voxels need to be parsed, get all positions the ray could go through in that
+	// block, then query them all at once (better for bulk processing, and allows SIMD). Then check results in order.
 
 	struct RaycastPredicate {
-		const VoxelData &data;
+		RaycastBlockReader<SdfIsEmpty> &reader;
 
 		bool operator()(const VoxelRaycastState &rs) {
-			// This is not particularly optimized, but runs fast enough for player raycasts
-			VoxelSingleValue defval;
-			defval.f = constants::SDF_FAR_OUTSIDE;
-			const VoxelSingleValue v = data.get_voxel(rs.hit_position, VoxelBuffer::CHANNEL_SDF, defval);
+			VoxelSingleValue v;
+			if (!reader.try_get_voxel(rs.hit_position, v)) {
+				return false;
+			}
 			return v.f < 0;
 		}
 	};
 
-	Ref<VoxelRaycastResult> res;
-
 	// We use grid-raycast as a middle-phase to roughly detect where the hit will be
-	RaycastPredicate predicate = { voxel_data };
+	RaycastPredicate predicate = { reader };
 	Vector3i hit_pos;
 	Vector3i prev_pos;
 	float hit_distance;
@@ -113,7 +237,7 @@ Ref<VoxelRaycastResult> raycast_sdf(
 	// `voxel_raycast` operates on a discrete grid of cubic voxels, so to account for the smooth interpolation,
 	// we may offset the ray so that cubes act as if they were centered on the filtered result.
 	const Vector3 offset(0.5, 0.5, 0.5);
-	if (voxel_raycast(
+	if (!voxel_raycast(
 				ray_origin + offset,
 				ray_dir,
 				predicate,
@@ -123,62 +247,87 @@ Ref<VoxelRaycastResult> raycast_sdf(
 				hit_distance,
 				hit_distance_prev
 		)) {
-		// Approximate surface
+		return false;
+	}
 
-		float d = hit_distance;
+	// Approximate surface
 
-		if (binary_search_iterations > 0) {
-			// This is not particularly optimized, but runs fast enough for player raycasts
-			struct VolumeSampler {
-				const VoxelData &data;
+	float d = hit_distance;
 
-				inline float operator()(const Vector3i &pos) const {
-					VoxelSingleValue defval;
-					defval.f = constants::SDF_FAR_OUTSIDE;
-					const VoxelSingleValue value = data.get_voxel(pos, VoxelBuffer::CHANNEL_SDF, defval);
-					return value.f;
-				}
-			};
-
-			VolumeSampler sampler{ voxel_data };
-			d = hit_distance_prev +
-					approximate_distance_to_isosurface_binary_search(
-							sampler,
-							ray_origin + ray_dir * hit_distance_prev,
-							ray_dir,
-							hit_distance - hit_distance_prev,
-							binary_search_iterations
-					);
-		}
+	if (binary_search_iterations > 0) {
+		// The binary search reads voxels around the hit, which may be in other blocks
+		reader.release();
 
-		res.instantiate();
-		res->position = hit_pos;
-		res->previous_position = prev_pos;
-		res->distance_along_ray = d;
+		// This is not particularly optimized, but runs fast enough for player raycasts
+		struct VolumeSampler {
+			const VoxelData &data;
+
+			inline float operator()(const Vector3i &pos) const {
+				const VoxelSingleValue value =
+						data.get_voxel(pos, VoxelBuffer::CHANNEL_SDF, get_sdf_raycast_default_value());
+				return value.f;
+			}
+		};
+
+		VolumeSampler sampler{ voxel_data };
+		d = hit_distance_prev +
+				approximate_distance_to_isosurface_binary_search(
+						sampler,
+						ray_origin + ray_dir * hit_distance_prev,
+						ray_dir,
+						hit_distance - hit_distance_prev,
+						binary_search_iterations
+				);
 	}
 
-	return res;
+	out_hit.position = hit_pos;
+	out_hit.previous_position = prev_pos;
+	out_hit.distance_along_ray = d;
+	return true;
 }
 
-Ref<VoxelRaycastResult> raycast_blocky(
-		const VoxelData &voxel_data,
-		const VoxelMesherBlocky &mesher,
+struct BlockyIsEmpty {
+	const VoxelBlockyLibraryBase::BakedData &baked_data;
+	const uint32_t collision_mask;
+
+	inline bool operator()(VoxelSingleValue v) const {
+		const uint32_t id = v.i;
+		if (baked_data.has_model(id) == false) {
+			return true;
+		}
+		const VoxelBlockyModel::BakedData &model = baked_data.models[id];
+		return (model.box_collision_mask & collision_mask) == 0 || model.box_collision_aabbs.size() == 0;
+	}
+};
+
+VoxelSingleValue get_integer_raycast_default_value() {
+	VoxelSingleValue defval;
+	defval.i = 0;
+	return defval;
+}
+
+bool raycast_blocky_with_reader(
+		RaycastBlockReader<BlockyIsEmpty> &reader,
+		const VoxelBlockyLibraryBase::BakedData &baked_data,
 		const Vector3 ray_origin,
 		const Vector3 ray_dir,
 		const float max_distance,
-		const uint32_t p_collision_mask
+		const uint32_t p_collision_mask,
+		RaycastHit &out_hit
 ) {
 	struct RaycastPredicateBlocky {
-		const VoxelData &data;
+		RaycastBlockReader<BlockyIsEmpty> &reader;
 		const VoxelBlockyLibraryBase::BakedData &baked_data;
 		const uint32_t collision_mask;
 		const Vector3 p_from;
 		const Vector3 p_to;
 
 		bool operator()(const VoxelRaycastState &rs) const {
-			VoxelSingleValue defval;
-			defval.i = 0;
-			const int v = data.get_voxel(rs.hit_position, VoxelBuffer::CHANNEL_TYPE, defval).i;
+			VoxelSingleValue sv;
+			if (!reader.try_get_voxel(rs.hit_position, sv)) {
+				return false;
+			}
+			const int v = sv.i;
 
 			if (baked_data.has_model(v) == false) {
 				return false;
@@ -199,76 +348,178 @@ Ref<VoxelRaycastResult> raycast_blocky(
 		}
 	};
 
-	Ref<VoxelRaycastResult> res;
-
-	Ref<VoxelBlockyLibraryBase> library_ref = mesher.get_library();
-	if (library_ref.is_null()) {
-		return res;
-	}
-
 	RaycastPredicateBlocky predicate{
-		voxel_data, //
-		library_ref->get_baked_data(), //
+		reader, //
+		baked_data, //
 		p_collision_mask, //
 		ray_origin, //
 		ray_origin + ray_dir * max_distance //
 	};
 
-	float hit_distance;
 	float hit_distance_prev;
-	Vector3i hit_pos;
-	Vector3i prev_pos;
 
-	if (zylann::voxel_raycast(
-				ray_origin, ray_dir, predicate, max_distance, hit_pos, prev_pos, hit_distance, hit_distance_prev
-		)) {
-		res.instantiate();
-		res->position = hit_pos;
-		res->previous_position = prev_pos;
-		res->distance_along_ray = hit_distance;
-	}
-
-	return res;
+	return zylann::voxel_raycast(
+			ray_origin,
+			ray_dir,
+			predicate,
+			max_distance,
+			out_hit.position,
+			out_hit.previous_position,
+			out_hit.distance_along_ray,
+			hit_distance_prev
+	);
 }
 
-Ref<VoxelRaycastResult> raycast_nonzero(
-		const VoxelData &voxel_data,
+struct NonZeroIsEmpty {
+	inline bool operator()(VoxelSingleValue v) const {
+		return v.i == 0;
+	}
+};
+
+bool raycast_nonzero_with_reader(
+		RaycastBlockReader<NonZeroIsEmpty> &reader,
 		const Vector3 ray_origin,
 		const Vector3 ray_dir,
 		const float max_distance,
-		const uint8_t p_channel
+		RaycastHit &out_hit
 ) {
 	struct RaycastPredicateColor {
-		const VoxelData &data;
-		const uint8_t channel;
+		RaycastBlockReader<NonZeroIsEmpty> &reader;
 
 		bool operator()(const VoxelRaycastState &rs) const {
-			VoxelSingleValue defval;
-			defval.i = 0;
-			const uint64_t v = data.get_voxel(rs.hit_position, channel, defval).i;
-			return v != 0;
+			VoxelSingleValue v;
+			if (!reader.try_get_voxel(rs.hit_position, v)) {
+				return false;
+			}
+			return v.i != 0;
 		}
 	};
 
+	RaycastPredicateColor predicate{ reader };
+
+	float hit_distance_prev;
+
+	return zylann::voxel_raycast(
+			ray_origin,
+			ray_dir,
+			predicate,
+			max_distance,
+			out_hit.position,
+			out_hit.previous_position,
+			out_hit.distance_along_ray,
+			hit_distance_prev
+	);
+}
+
+Ref<VoxelRaycastResult> make_raycast_result(const RaycastHit &hit) {
 	Ref<VoxelRaycastResult> res;
+	res.instantiate();
+	res->position = hit.position;
+	res->previous_position = hit.previous_position;
+	res->distance_along_ray = hit.distance_along_ray;
+	return res;
+}
 
-	RaycastPredicateColor predicate{ voxel_data, p_channel };
+// Ray in the local space of a volume
+struct LocalRay {
+	Vector3 origin;
+	Vector3 dir;
+	float max_distance;
+	// Converts distances along the local ray into distances along the world ray
+	float to_world_scale;
+};
+
+bool get_local_ray(
+		const Transform3D &to_local,
+		const Vector3 ray_origin_world,
+		const Vector3 ray_dir_world,
+		const float max_distance_world,
+		LocalRay &out_ray
+) {
+	// TODO Switch to "from/to" parameters instead of "from/dir/distance"
 
-	float hit_distance;
-	float hit_distance_prev;
-	Vector3i hit_pos;
-	Vector3i prev_pos;
+	const Vector3 ray_end_world = ray_origin_world + ray_dir_world * max_distance_world;
+
+	const Vector3 pos0_local = to_local.xform(ray_origin_world);
+	const Vector3 pos1_local = to_local.xform(ray_end_world);
+
+	const float max_distance_local_sq = pos0_local.distance_squared_to(pos1_local);
+	if (max_distance_local_sq < 0.000001f) {
+		return false;
+	}
+	const float max_distance_local = Math::sqrt(max_distance_local_sq);
 
-	if (zylann::voxel_raycast(
-				ray_origin, ray_dir, predicate, max_distance, hit_pos, prev_pos, hit_distance, hit_distance_prev
+	out_ray.origin = pos0_local;
+	out_ray.dir = (pos1_local - pos0_local) / max_distance_local;
+	out_ray.max_distance = max_distance_local;
+	out_ray.to_world_scale = ray_origin_world.distance_to(ray_end_world) / max_distance_local;
+	return true;
+}
+
+} // namespace
+
+Ref<VoxelRaycastResult> raycast_sdf(
+		const VoxelData &voxel_data,
+		const Vector3 ray_origin,
+		const Vector3 ray_dir,
+		const float max_distance,
+		const uint8_t binary_search_iterations
+) {
+	RaycastBlockReader<SdfIsEmpty> reader(
+			voxel_data, VoxelBuffer::CHANNEL_SDF, get_sdf_raycast_default_value(), SdfIsEmpty()
+	);
+	RaycastHit hit;
+	if (raycast_sdf_with_reader(
+				reader, voxel_data, ray_origin, ray_dir, max_distance, binary_search_iterations, hit
 		)) {
-		res.instantiate();
-		res->position = hit_pos;
-		res->previous_position = prev_pos;
-		res->distance_along_ray = hit_distance;
+		return make_raycast_result(hit);
 	}
+	return Ref<VoxelRaycastResult>();
+}
 
-	return res;
+Ref<VoxelRaycastResult> raycast_blocky(
+		const VoxelData &voxel_data,
+		const VoxelMesherBlocky &mesher,
+		const Vector3 ray_origin,
+		const Vector3 ray_dir,
+		const float max_distance,
+		const uint32_t p_collision_mask
+) {
+	Ref<VoxelBlockyLibraryBase> library_ref = mesher.get_library();
+	if (library_ref.is_null()) {
+		return Ref<VoxelRaycastResult>();
+	}
+
+	const VoxelBlockyLibraryBase::BakedData &baked_data = library_ref->get_baked_data();
+
+	RaycastBlockReader<BlockyIsEmpty> reader(
+			voxel_data,
+			VoxelBuffer::CHANNEL_TYPE,
+			get_integer_raycast_default_value(),
+			BlockyIsEmpty{ baked_data, p_collision_mask }
+	);
+	RaycastHit hit;
+	if (raycast_blocky_with_reader(reader, baked_data, ray_origin, ray_dir, max_distance, p_collision_mask, hit)) {
+		return make_raycast_result(hit);
+	}
+	return Ref<VoxelRaycastResult>();
+}
+
+Ref<VoxelRaycastResult> raycast_nonzero(
+		const VoxelData &voxel_data,
+		const Vector3 ray_origin,
+		const Vector3 ray_dir,
+		const float max_distance,
+		const uint8_t p_channel
+) {
+	RaycastBlockReader<NonZeroIsEmpty> reader(
+			voxel_data, p_channel, get_integer_raycast_default_value(), NonZeroIsEmpty()
+	);
+	RaycastHit hit;
+	if (raycast_nonzero_with_reader(reader, ray_origin, ray_dir, max_distance, hit)) {
+		return make_raycast_result(hit);
+	}
+	return Ref<VoxelRaycastResult>();
 }
 
 Ref<VoxelRaycastResult> raycast_generic(
@@ -294,7 +545,7 @@ Ref<VoxelRaycastResult> raycast_generic(
 		res = raycast_nonzero(voxel_data, ray_origin, ray_dir, max_distance, VoxelBuffer::CHANNEL_COLOR);
 
 	} else {
-		res = raycast_sdf(voxel_data, ray_origin, ray_dir, max_distance, 0);
+		res = raycast_sdf(voxel_data, ray_origin, ray_dir, max_distance, binary_search_iterations);
 	}
 
 	return res;
@@ -310,38 +561,163 @@ Ref<VoxelRaycastResult> raycast_generic_world(
 		const uint32_t p_collision_mask,
 		const uint8_t binary_search_iterations
 ) {
-	// TODO Implement broad-phase on blocks to minimize locking and increase performance
+	LocalRay ray;
+	if (!get_local_ray(to_world.affine_inverse(), ray_origin_world, ray_dir_world, max_distance_world, ray)) {
+		return Ref<VoxelRaycastResult>();
+	}
 
-	// TODO Optimization: voxel raycast uses `get_voxel` which is the slowest, but could be made faster.
-	// See `VoxelToolLodTerrain` for information about how to implement improvements.
+	Ref<VoxelRaycastResult> res = raycast_generic(
+			voxel_data, mesher, ray.origin, ray.dir, ray.max_distance, p_collision_mask, binary_search_iterations
+	);
 
-	// TODO Switch to "from/to" parameters instead of "from/dir/distance"
+	if (res.is_valid()) {
+		res->distance_along_ray = res->distance_along_ray * ray.to_world_scale;
+	}
 
-	const Vector3 ray_end_world = ray_origin_world + ray_dir_world * max_distance_world;
+	return res;
+}
 
-	const Transform3D to_local = to_world.affine_inverse();
+void raycast_generic_world_batch(
+		const VoxelData &voxel_data,
+		const Ref<VoxelMesher> mesher,
+		const Transform3D &to_world,
+		Span<const Vector3> ray_origins_world,
+		Span<const Vector3> ray_dirs_world,
+		const float max_distance_world,
+		const uint32_t p_collision_mask,
+		const uint8_t binary_search_iterations,
+		Span<RaycastHit> out_hits
+) {
+	using namespace zylann::godot;
 
-	const Vector3 pos0_local = to_local.xform(ray_origin_world);
-	const Vector3 pos1_local = to_local.xform(ray_end_world);
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(ray_dirs_world.size() == ray_origins_world.size());
+	ZN_ASSERT_RETURN(out_hits.size() == ray_origins_world.size());
 
-	const float max_distance_local_sq = pos0_local.distance_squared_to(pos1_local);
-	if (max_distance_local_sq < 0.000001f) {
-		return Ref<VoxelRaycastResult>();
+	struct BatchRay {
+		LocalRay ray;
+		// Block containing the origin of the ray, used to sort rays
+		Vector3i block_position;
+		uint32_t index;
+	};
+
+	// Rays are sorted by the block their origin is in, so consecutive rays are likely to go through the same blocks.
+	// That way they can continue using the block the previous ray left locked, instead of looking it up again.
+	StdVector<BatchRay> rays;
+	{
+		ZN_PROFILE_SCOPE_NAMED("Sort");
+		rays.reserve(ray_origins_world.size());
+
+		const Transform3D to_local = to_world.affine_inverse();
+		const unsigned int block_size_po2 = voxel_data.get_block_size_po2();
+
+		for (unsigned int i = 0; i < ray_origins_world.size(); ++i) {
+			RaycastHit &hit = out_hits[i];
+			hit.distance_along_ray = -1.f;
+
+			BatchRay batch_ray;
+			if (!get_local_ray(to_local, ray_origins_world[i], ray_dirs_world[i], max_distance_world, batch_ray.ray)) {
+				continue;
+			}
+			batch_ray.block_position = math::floor_to_int(batch_ray.ray.origin) >> block_size_po2;
+			batch_ray.index = i;
+			rays.push_back(batch_ray);
+		}
+
+		std::sort(rays.begin(), rays.end(), [](const BatchRay &a, const BatchRay &b) {
+			return a.block_position < b.block_position;
+		});
 	}
-	const float max_distance_local = Math::sqrt(max_distance_local_sq);
-	const Vector3 dir_local = (pos1_local - pos0_local) / max_distance_local;
 
-	Ref<VoxelRaycastResult> res =
-			raycast_generic(voxel_data, mesher, pos0_local, dir_local, max_distance_local, p_collision_mask, 0);
+	Ref<VoxelMesherBlocky> mesher_blocky;
+	Ref<VoxelMesherCubes> mesher_cubes;
+	Ref<VoxelBlockyLibraryBase> library;
 
-	if (res.is_valid()) {
-		const float max_distance_world_sq = ray_origin_world.distance_squared_to(ray_end_world);
-		const float to_world_scale = max_distance_world_sq / max_distance_local_sq;
+	if (try_get_as(mesher, mesher_blocky)) {
+		library = mesher_blocky->get_library();
+		if (library.is_null()) {
+			return;
+		}
+	} else {
+		try_get_as(mesher, mesher_cubes);
+	}
 
-		res->distance_along_ray = res->distance_along_ray * to_world_scale;
+	// Rays are split in jobs that may run on other threads. Each job keeps its own block access.
+	const unsigned int RAYS_PER_JOB = 64;
+	const unsigned int job_count = math::ceildiv(static_cast<unsigned int>(rays.size()), RAYS_PER_JOB);
+
+	ParallelJobsScheduler scheduler;
+	if (job_count > 1) {
+		scheduler.schedule_tasks = [](Span<IThreadedTask *> tasks) { //
+			VoxelEngine::get_singleton().push_async_tasks(tasks);
+		};
+		const unsigned int thread_count = VoxelEngine::get_singleton().get_thread_count();
+		scheduler.max_helpers = thread_count > 0 ? thread_count - 1 : 0;
 	}
 
-	return res;
+	const auto run_job = [&](const uint32_t job_index) {
+		ZN_PROFILE_SCOPE_NAMED("Raycast job");
+
+		const unsigned int begin = job_index * RAYS_PER_JOB;
+		const unsigned int end = math::min(begin + RAYS_PER_JOB, static_cast<unsigned int>(rays.size()));
+
+		const auto store_hit = [&out_hits](const BatchRay &batch_ray, RaycastHit hit) {
+			hit.distance_along_ray *= batch_ray.ray.to_world_scale;
+			out_hits[batch_ray.index] = hit;
+		};
+
+		RaycastHit hit;
+
+		if (library.is_valid()) {
+			const VoxelBlockyLibraryBase::BakedData &baked_data = library->get_baked_data();
+			RaycastBlockReader<BlockyIsEmpty> reader(
+					voxel_data,
+					VoxelBuffer::CHANNEL_TYPE,
+					get_integer_raycast_default_value(),
+					BlockyIsEmpty{ baked_data, p_collision_mask }
+			);
+			for (unsigned int i = begin; i < end; ++i) {
+				const LocalRay &ray = rays[i].ray;
+				if (raycast_blocky_with_reader(
+							reader, baked_data, ray.origin, ray.dir, ray.max_distance, p_collision_mask, hit
+					)) {
+					store_hit(rays[i], hit);
+				}
+			}
+
+		} else if (mesher_cubes.is_valid()) {
+			RaycastBlockReader<NonZeroIsEmpty> reader(
+					voxel_data, VoxelBuffer::CHANNEL_COLOR, get_integer_raycast_default_value(), NonZeroIsEmpty()
+			);
+			for (unsigned int i = begin; i < end; ++i) {
+				const LocalRay &ray = rays[i].ray;
+				if (raycast_nonzero_with_reader(reader, ray.origin, ray.dir, ray.max_distance, hit)) {
+					store_hit(rays[i], hit);
+				}
+			}
+
+		} else {
+			RaycastBlockReader<SdfIsEmpty> reader(
+					voxel_data, VoxelBuffer::CHANNEL_SDF, get_sdf_raycast_default_value(), SdfIsEmpty()
+			);
+			for (unsigned int i = begin; i < end; ++i) {
+				const LocalRay &ray = rays[i].ray;
+				if (raycast_sdf_with_reader(
+							reader, voxel_data, ray.origin, ray.dir, ray.max_distance, binary_search_iterations, hit
+					)) {
+					store_hit(rays[i], hit);
+				}
+			}
+		}
+	};
+
+	if (library.is_valid()) {
+		// Don't let the library change while rays read it from multiple threads
+		RWLockRead baked_data_rlock(library->get_baked_data_rw_lock());
+		run_parallel_jobs(job_count, scheduler, run_job);
+	} else {
+		run_parallel_jobs(job_count, scheduler, run_job);
+	}
 }
 
 } // namespace zylann::voxel
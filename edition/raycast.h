@@ -2,6 +2,7 @@
 #define VOXEL_RAYCAST_FUNCS_H
 
 #include "../meshers/voxel_mesher.h"
+#include "../util/containers/span.h"
 #include "../util/math/transform_3d.h"
 #include "../util/math/vector3.h"
 #include "voxel_raycast_result.h"
@@ -57,6 +58,20 @@ Ref<VoxelRaycastResult> raycast_generic_world(
 		const uint8_t binary_search_iterations
 );
 
+// Casts many rays at once, which is faster than casting them one by one. Rays without hit get a negative distance in
+// `out_hits`, which must have the same size as the input spans.
+void raycast_generic_world_batch(
+		const VoxelData &voxel_data,
+		const Ref<VoxelMesher> mesher,
+		const Transform3D &to_world,
+		Span<const Vector3> ray_origins_world,
+		Span<const Vector3> ray_dirs_world,
+		const float max_distance_world,
+		const uint32_t p_collision_mask,
+		const uint8_t binary_search_iterations,
+		Span<RaycastHit> out_hits
+);
+
 } // namespace zylann::voxel
 
 #endif // VOXEL_RAYCAST_FUNCS_H
@@ -11,6 +11,7 @@
 #include "../util/profiling.h"
 #include "../util/string/format.h"
 #include "mesh_sdf.h"
+#include "mesh_sdf_gpu_task.h"
 // Necessary when compiling with GodotCpp because it is used in a registered method argument, and the type must be
 // defined
 #include "../util/godot/classes/scene_tree.h"
@@ -20,6 +21,21 @@ using namespace zylann::godot;
 namespace zylann::voxel {
 
 namespace {
+ParallelJobsScheduler get_engine_scheduler() {
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = [](Span<IThreadedTask *> tasks) { //
+		VoxelEngine::get_singleton().push_async_tasks(tasks);
+	};
+	const unsigned int thread_count = VoxelEngine::get_singleton().get_thread_count();
+	scheduler.max_helpers = thread_count > 0 ? thread_count - 1 : 0;
+	return scheduler;
+}
+
+bool can_bake_on_gpu() {
+	const VoxelEngine &engine = VoxelEngine::get_singleton();
+	return engine.has_rendering_device() && engine.get_mesh_sdf_compute_shader().is_valid();
+}
+
 bool prepare_triangles(
 		Mesh &mesh,
 		StdVector<mesh_sdf::Triangle> &triangles,
@@ -135,11 +151,21 @@ void VoxelMeshSDF::bake() {
 
 	switch (_bake_mode) {
 		case BAKE_MODE_ACCURATE_NAIVE:
-			mesh_sdf::generate_mesh_sdf_naive(sdf_grid, res, to_span(triangles), box_min_pos, box_max_pos);
+			mesh_sdf::generate_mesh_sdf_naive(
+					sdf_grid, res, to_span(triangles), box_min_pos, box_max_pos, get_engine_scheduler()
+			);
 			break;
 		case BAKE_MODE_ACCURATE_PARTITIONED:
+		// Synchronous baking can't wait for the GPU task runner, so it gives the same result on the CPU instead
+		case BAKE_MODE_ACCURATE_PARTITIONED_GPU:
 			mesh_sdf::generate_mesh_sdf_partitioned(
-					sdf_grid, res, to_span(triangles), box_min_pos, box_max_pos, _partition_subdiv
+					sdf_grid,
+					res,
+					to_span(triangles),
+					box_min_pos,
+					box_max_pos,
+					_partition_subdiv,
+					get_engine_scheduler()
 			);
 			break;
 		case BAKE_MODE_APPROX_INTERP:
@@ -198,6 +224,22 @@ void VoxelMeshSDF::bake_async(SceneTree *scene_tree) {
 		}
 	};
 
+	class GenMeshSDFGPUTaskGD : public mesh_sdf::GenMeshSDFGPUTask {
+	public:
+		Ref<VoxelMeshSDF> obj_to_notify;
+
+		void on_complete(bool success) override {
+			ZN_ASSERT(obj_to_notify.is_valid());
+			if (success) {
+				L::notify_on_complete(**obj_to_notify, *shared_data);
+			} else {
+				obj_to_notify->call_deferred(
+						"_on_bake_async_completed", Ref<godot::VoxelBuffer>(), Vector3(), Vector3()
+				);
+			}
+		}
+	};
+
 	class GenMeshSDFFirstPassTask : public IThreadedTask {
 	public:
 		float margin_ratio;
@@ -247,6 +289,28 @@ void VoxelMeshSDF::bake_async(SceneTree *scene_tree) {
 			shared_data->min_pos = box_min_pos;
 			shared_data->max_pos = box_max_pos;
 
+			if (bake_mode == BAKE_MODE_ACCURATE_PARTITIONED_GPU) {
+				if (can_bake_on_gpu()) {
+					mesh_sdf::partition_triangles(
+							partition_subdiv,
+							to_span(shared_data->triangles),
+							shared_data->min_pos,
+							shared_data->max_pos,
+							shared_data->chunk_grid
+					);
+					mesh_sdf::compute_near_chunks(shared_data->chunk_grid);
+					shared_data->boundary_sign_fix = boundary_sign_fix;
+
+					GenMeshSDFGPUTaskGD *task = ZN_NEW(GenMeshSDFGPUTaskGD);
+					task->shared_data = shared_data;
+					task->obj_to_notify = obj_to_notify;
+					VoxelEngine::get_singleton().push_gpu_task(task);
+					return;
+				}
+				// Same result on the CPU
+				bake_mode = BAKE_MODE_ACCURATE_PARTITIONED;
+			}
+
 			switch (bake_mode) {
 				case BAKE_MODE_ACCURATE_NAIVE:
 				case BAKE_MODE_ACCURATE_PARTITIONED: {
@@ -559,7 +623,7 @@ void VoxelMeshSDF::_bind_methods() {
 					Variant::INT,
 					"bake_mode",
 					PROPERTY_HINT_ENUM,
-					"AccurateNaive,AccuratePartitioned,ApproxInterp,FloodFill"
+					"AccurateNaive,AccuratePartitioned,ApproxInterp,FloodFill,AccuratePartitionedGPU"
 			),
 			"set_bake_mode",
 			"get_bake_mode"
@@ -595,6 +659,7 @@ void VoxelMeshSDF::_bind_methods() {
 	BIND_ENUM_CONSTANT(BAKE_MODE_ACCURATE_PARTITIONED);
 	BIND_ENUM_CONSTANT(BAKE_MODE_APPROX_INTERP);
 	BIND_ENUM_CONSTANT(BAKE_MODE_APPROX_FLOODFILL);
+	BIND_ENUM_CONSTANT(BAKE_MODE_ACCURATE_PARTITIONED_GPU);
 	BIND_ENUM_CONSTANT(BAKE_MODE_COUNT);
 }
 
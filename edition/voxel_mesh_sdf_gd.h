@@ -21,6 +21,7 @@ public:
 		BAKE_MODE_ACCURATE_PARTITIONED,
 		BAKE_MODE_APPROX_INTERP,
 		BAKE_MODE_APPROX_FLOODFILL,
+		BAKE_MODE_ACCURATE_PARTITIONED_GPU,
 		BAKE_MODE_COUNT
 	};
 
@@ -6,6 +6,13 @@
 
 namespace zylann::voxel {
 
+struct RaycastHit {
+	Vector3i position;
+	Vector3i previous_position;
+	// Negative if nothing was hit
+	float distance_along_ray = -1.f;
+};
+
 // This class exists only to make the script API nicer.
 class VoxelRaycastResult : public RefCounted {
 	GDCLASS(VoxelRaycastResult, RefCounted)
@@ -91,6 +91,30 @@ Ref<VoxelRaycastResult> VoxelTool::raycast(Vector3 pos, Vector3 dir, float max_d
 	// See derived classes for implementations
 }
 
+void VoxelTool::raycast_batch(
+		Span<const Vector3> origins,
+		Span<const Vector3> directions,
+		float max_distance,
+		uint32_t collision_mask,
+		Span<RaycastHit> out_hits
+) {
+	ZN_ASSERT_RETURN(directions.size() == origins.size());
+	ZN_ASSERT_RETURN(out_hits.size() == origins.size());
+
+	// Derived classes may implement a faster version
+	for (unsigned int i = 0; i < origins.size(); ++i) {
+		RaycastHit &hit = out_hits[i];
+		Ref<VoxelRaycastResult> res = raycast(origins[i], directions[i], max_distance, collision_mask);
+		if (res.is_valid()) {
+			hit.position = res->position;
+			hit.previous_position = res->previous_position;
+			hit.distance_along_ray = res->distance_along_ray;
+		} else {
+			hit.distance_along_ray = -1.f;
+		}
+	}
+}
+
 uint64_t VoxelTool::get_voxel(Vector3i pos) const {
 	return _get_voxel(pos);
 }
@@ -291,6 +315,23 @@ void VoxelTool::paste_masked(
 	// Implemented in derived classes
 }
 
+void VoxelTool::copy_to_clipboard(Vector3i pos, Vector3i size, VoxelClipboard &dst, uint8_t channels_mask) const {
+	ERR_PRINT("Not implemented");
+	// Implemented in derived classes
+}
+
+void VoxelTool::paste_clipboard(
+		Vector3i pos,
+		const VoxelClipboard &src,
+		uint8_t channels_mask,
+		bool use_mask,
+		uint8_t mask_channel,
+		uint64_t mask_value
+) {
+	ERR_PRINT("Not implemented");
+	// Implemented in derived classes
+}
+
 void VoxelTool::paste_masked_writable_list(
 		Vector3i pos,
 		Ref<godot::VoxelBuffer> p_voxels,
@@ -416,6 +457,45 @@ Ref<VoxelRaycastResult> VoxelTool::_b_raycast(Vector3 pos, Vector3 dir, float ma
 	return raycast(pos, dir, max_distance, collision_mask);
 }
 
+Dictionary VoxelTool::_b_raycast_batch(
+		PackedVector3Array origins,
+		PackedVector3Array directions,
+		float max_distance,
+		uint32_t collision_mask
+) {
+	ERR_FAIL_COND_V_MSG(
+			origins.size() != directions.size(), Dictionary(), "Origins and directions must have the same size"
+	);
+
+	StdVector<RaycastHit> hits;
+	hits.resize(origins.size());
+	raycast_batch(to_span(origins), to_span(directions), max_distance, collision_mask, to_span(hits));
+
+	PackedVector3Array positions;
+	PackedVector3Array previous_positions;
+	PackedFloat32Array distances;
+	positions.resize(hits.size());
+	previous_positions.resize(hits.size());
+	distances.resize(hits.size());
+	{
+		Vector3 *positions_w = positions.ptrw();
+		Vector3 *previous_positions_w = previous_positions.ptrw();
+		float *distances_w = distances.ptrw();
+		for (unsigned int i = 0; i < hits.size(); ++i) {
+			const RaycastHit &hit = hits[i];
+			positions_w[i] = to_vec3(hit.position);
+			previous_positions_w[i] = to_vec3(hit.previous_position);
+			distances_w[i] = hit.distance_along_ray;
+		}
+	}
+
+	Dictionary d;
+	d["positions"] = positions;
+	d["previous_positions"] = previous_positions;
+	d["distances"] = distances;
+	return d;
+}
+
 void VoxelTool::_b_do_point(Vector3i pos) {
 	do_point(pos);
 }
@@ -450,6 +530,31 @@ void VoxelTool::_b_paste_masked(
 	paste_masked(pos, voxels, channels_mask, mask_channel, mask_value);
 }
 
+Ref<godot::VoxelClipboard> VoxelTool::_b_copy_to_clipboard(Vector3i pos, Vector3i size, int channels_mask) const {
+	ERR_FAIL_COND_V(Vector3iUtil::is_empty_size(size), Ref<godot::VoxelClipboard>());
+	Ref<godot::VoxelClipboard> clipboard;
+	clipboard.instantiate();
+	copy_to_clipboard(pos, size, clipboard->get_clipboard(), channels_mask);
+	return clipboard;
+}
+
+void VoxelTool::_b_paste_clipboard(Vector3i pos, Ref<godot::VoxelClipboard> clipboard, int channels_mask) {
+	ERR_FAIL_COND(clipboard.is_null());
+	paste_clipboard(pos, clipboard->get_clipboard(), channels_mask, false, 0, 0);
+}
+
+void VoxelTool::_b_paste_clipboard_masked(
+		Vector3i pos,
+		Ref<godot::VoxelClipboard> clipboard,
+		int channels_mask,
+		int mask_channel,
+		int64_t mask_value
+) {
+	ERR_FAIL_COND(clipboard.is_null());
+	ERR_FAIL_INDEX(mask_channel, VoxelBuffer::MAX_CHANNELS);
+	paste_clipboard(pos, clipboard->get_clipboard(), channels_mask, true, mask_channel, mask_value);
+}
+
 Variant VoxelTool::_b_get_voxel_metadata(Vector3i pos) const {
 	return get_voxel_metadata(pos);
 }
@@ -569,6 +674,16 @@ void VoxelTool::_bind_methods() {
 			),
 			&VoxelTool::paste_masked_writable_list
 	);
+	ClassDB::bind_method(
+			D_METHOD("copy_to_clipboard", "src_pos", "size", "channels_mask"), &VoxelTool::_b_copy_to_clipboard
+	);
+	ClassDB::bind_method(
+			D_METHOD("paste_clipboard", "dst_pos", "clipboard", "channels_mask"), &VoxelTool::_b_paste_clipboard
+	);
+	ClassDB::bind_method(
+			D_METHOD("paste_clipboard_masked", "dst_pos", "clipboard", "channels_mask", "mask_channel", "mask_value"),
+			&VoxelTool::_b_paste_clipboard_masked
+	);
 
 	ClassDB::bind_method(
 			D_METHOD("raycast", "origin", "direction", "max_distance", "collision_mask"),
@@ -577,6 +692,13 @@ void VoxelTool::_bind_methods() {
 			DEFVAL(0xffffffff)
 	);
 
+	ClassDB::bind_method(
+			D_METHOD("raycast_batch", "origins", "directions", "max_distance", "collision_mask"),
+			&VoxelTool::_b_raycast_batch,
+			DEFVAL(10.0),
+			DEFVAL(0xffffffff)
+	);
+
 	ClassDB::bind_method(D_METHOD("is_area_editable", "box"), &VoxelTool::_b_is_area_editable);
 
 	// Encoding helpers
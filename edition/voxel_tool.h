@@ -3,6 +3,8 @@
 
 #include "../storage/funcs.h"
 #include "../storage/voxel_buffer_gd.h"
+#include "../storage/voxel_clipboard_gd.h"
+#include "../util/godot/core/dictionary.h"
 #include "../util/math/box3i.h"
 #include "../util/math/sdf.h"
 #include "funcs.h"
@@ -97,11 +99,34 @@ public:
 			PackedInt32Array dst_writable_list
 	);
 
+	// Copies an area into chunks following blocks of the volume, which keep their compression. This is faster and uses
+	// less memory than `copy` for large areas.
+	virtual void copy_to_clipboard(Vector3i pos, Vector3i size, VoxelClipboard &dst, uint8_t channels_mask) const;
+
+	virtual void paste_clipboard(
+			Vector3i pos,
+			const VoxelClipboard &src,
+			uint8_t channels_mask,
+			bool use_mask,
+			uint8_t mask_channel,
+			uint64_t mask_value
+	);
+
 	void smooth_sphere(Vector3 sphere_center, float sphere_radius, int blur_radius);
 	void grow_sphere(Vector3 sphere_center, float sphere_radius, float strength);
 
 	virtual Ref<VoxelRaycastResult> raycast(Vector3 pos, Vector3 dir, float max_distance, uint32_t collision_mask);
 
+	// Casts many rays at once. `out_hits` must have the same size as `origins` and `directions`. Rays without hit get a
+	// negative distance.
+	virtual void raycast_batch(
+			Span<const Vector3> origins,
+			Span<const Vector3> directions,
+			float max_distance,
+			uint32_t collision_mask,
+			Span<RaycastHit> out_hits
+	);
+
 	// Checks if an edit affecting the given box can be applied, fully or partially
 	virtual bool is_area_editable(const Box3i &box) const;
 
@@ -128,6 +153,12 @@ private:
 	void _b_set_voxel(Vector3i pos, uint64_t v);
 	void _b_set_voxel_f(Vector3i pos, float v);
 	Ref<VoxelRaycastResult> _b_raycast(Vector3 pos, Vector3 dir, float max_distance, uint32_t collision_mask);
+	Dictionary _b_raycast_batch(
+			PackedVector3Array origins,
+			PackedVector3Array directions,
+			float max_distance,
+			uint32_t collision_mask
+	);
 	void _b_do_point(Vector3i pos);
 	void _b_do_sphere(Vector3 pos, float radius);
 	void _b_do_box(Vector3i begin, Vector3i end);
@@ -141,6 +172,15 @@ private:
 			int mask_channel,
 			int64_t mask_value
 	);
+	Ref<godot::VoxelClipboard> _b_copy_to_clipboard(Vector3i pos, Vector3i size, int channels_mask) const;
+	void _b_paste_clipboard(Vector3i pos, Ref<godot::VoxelClipboard> clipboard, int channels_mask);
+	void _b_paste_clipboard_masked(
+			Vector3i pos,
+			Ref<godot::VoxelClipboard> clipboard,
+			int channels_mask,
+			int mask_channel,
+			int64_t mask_value
+	);
 	Variant _b_get_voxel_metadata(Vector3i pos) const;
 	void _b_set_voxel_metadata(Vector3i pos, Variant meta);
 	bool _b_is_area_editable(AABB box) const;
@@ -121,6 +121,22 @@ Variant VoxelToolBuffer::get_voxel_metadata(Vector3i pos) const {
 	return _buffer->get_voxel_metadata(pos);
 }
 
+void VoxelToolBuffer::copy(Vector3i pos, VoxelBuffer &dst, uint8_t channels_mask) const {
+	ERR_FAIL_COND(_buffer.is_null());
+
+	const VoxelBuffer &src = _buffer->get_buffer();
+
+	if (channels_mask == 0) {
+		channels_mask = (1 << get_channel());
+	}
+
+	// Parts of `dst` outside of the buffer are left untouched
+	const SmallVector<uint8_t, VoxelBuffer::MAX_CHANNELS> channels = VoxelBuffer::mask_to_channels_list(channels_mask);
+	for (const uint8_t channel_index : channels) {
+		dst.copy_channel_from(src, pos, pos + dst.get_size(), Vector3i(), channel_index);
+	}
+}
+
 void VoxelToolBuffer::paste(Vector3i p_pos, const VoxelBuffer &src, uint8_t channels_mask) {
 	ERR_FAIL_COND(_buffer.is_null());
 
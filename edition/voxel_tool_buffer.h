@@ -12,6 +12,7 @@ public:
 	VoxelToolBuffer(Ref<godot::VoxelBuffer> vb);
 
 	bool is_area_editable(const Box3i &box) const override;
+	void copy(Vector3i pos, VoxelBuffer &dst, uint8_t channels_mask) const override;
 	void paste(Vector3i p_pos, const VoxelBuffer &src, uint8_t channels_mask) override;
 	void paste_masked(
 			Vector3i p_pos,
@@ -10,8 +10,8 @@
 #include "../util/island_finder.h"
 #include "../util/math/conv.h"
 #include "../util/string/format.h"
-#include "../util/tasks/async_dependency_tracker.h"
 #include "../util/voxel_raycast.h"
+#include "async_edit_queue.h"
 #include "floating_chunks.h"
 #include "funcs.h"
 #include "raycast.h"
@@ -48,6 +48,27 @@ Ref<VoxelRaycastResult> VoxelToolLodTerrain::raycast(
 	);
 }
 
+void VoxelToolLodTerrain::raycast_batch(
+		Span<const Vector3> origins,
+		Span<const Vector3> directions,
+		float max_distance,
+		uint32_t collision_mask,
+		Span<RaycastHit> out_hits
+) {
+	ERR_FAIL_COND(_terrain == nullptr);
+	raycast_generic_world_batch(
+			_terrain->get_storage(),
+			_terrain->get_mesher(),
+			_terrain->get_global_transform(),
+			origins,
+			directions,
+			max_distance,
+			collision_mask,
+			_raycast_binary_search_iterations,
+			out_hits
+	);
+}
+
 void VoxelToolLodTerrain::do_box(Vector3i begin, Vector3i end) {
 	ZN_PROFILE_SCOPE();
 	ERR_FAIL_COND(_terrain == nullptr);
@@ -161,42 +182,83 @@ void VoxelToolLodTerrain::do_hemisphere(Vector3 center, float radius, Vector3 fl
 	_post_edit(op.box);
 }
 
-template <typename Op_T>
-class VoxelToolAsyncEdit : public IThreadedTask {
+namespace {
+
+// Applies a shape with the same operations as synchronous edits
+template <typename TShape>
+class AsyncShapeEditOp : public IAsyncEditOp {
 public:
-	VoxelToolAsyncEdit(Op_T op, std::shared_ptr<VoxelData> data) : _op(op), _data(data) {
-		_tracker = make_shared_instance<AsyncDependencyTracker>(1);
+	ops::DoShapeChunked<TShape, ops::VoxelDataGridAccess> op;
+
+	Box3i get_box() const override {
+		return op.box;
 	}
 
-	const char *get_debug_name() const override {
-		return "VoxelToolAsyncEdit";
+	void apply(VoxelDataGrid &grid) override {
+		op.block_access.grid = &grid;
+		op();
 	}
+};
 
-	void run(ThreadedTaskContext &ctx) override {
-		ZN_PROFILE_SCOPE();
-		ZN_ASSERT(_data != nullptr);
-		// TODO May want to fail if not all blocks were found
-		// TODO Need to apply modifiers
-		_data->get_blocks_grid(_op.blocks, _op.box, 0);
-		_op();
-		_tracker->post_complete();
+// Spheres have a dedicated texture painting operation, like `ops::DoSphere`
+class AsyncSphereEditOp : public AsyncShapeEditOp<ops::SdfSphere> {
+public:
+	void apply(VoxelDataGrid &grid) override {
+		if (op.channel == VoxelBuffer::CHANNEL_SDF && op.mode == ops::MODE_TEXTURE_PAINT) {
+			ops::VoxelDataGridAccess block_access;
+			block_access.grid = &grid;
+			ops::write_box_in_chunked_storage_2_channels(
+					ops::TextureBlendSphereOp(op.shape.center, op.shape.radius, op.texture_params),
+					block_access,
+					op.box,
+					VoxelBuffer::CHANNEL_INDICES,
+					VoxelBuffer::CHANNEL_WEIGHTS
+			);
+		} else {
+			AsyncShapeEditOp<ops::SdfSphere>::apply(grid);
+		}
 	}
+};
+
+class AsyncPasteEditOp : public IAsyncEditOp {
+public:
+	Vector3i position;
+	// Copied, because the source buffer may change before the edit runs
+	VoxelBuffer src;
+	uint8_t channels_mask = 0;
 
-	std::shared_ptr<AsyncDependencyTracker> get_tracker() {
-		return _tracker;
+	AsyncPasteEditOp() : src(VoxelBuffer::ALLOCATOR_POOL) {}
+
+	Box3i get_box() const override {
+		return Box3i(position, src.get_size());
 	}
 
-private:
-	Op_T _op;
-	// We reference this just to keep map pointers alive
-	std::shared_ptr<VoxelData> _data;
-	std::shared_ptr<AsyncDependencyTracker> _tracker;
+	void apply(VoxelDataGrid &grid) override {
+		ZN_PROFILE_SCOPE();
+		ops::VoxelDataGridAccess block_access;
+		block_access.grid = &grid;
+		ops::process_chunked_storage(
+				get_box(),
+				block_access,
+				[this](VoxelBuffer &vb, const Box3i local_box, Vector3i origin) {
+					const Vector3i src_min = local_box.position + origin - position;
+					for (unsigned int channel = 0; channel < VoxelBuffer::MAX_CHANNELS; ++channel) {
+						if ((channels_mask & (1 << channel)) != 0) {
+							vb.copy_channel_from(src, src_min, src_min + local_box.size, local_box.position, channel);
+						}
+					}
+				}
+		);
+	}
 };
 
-void VoxelToolLodTerrain::do_sphere_async(Vector3 center, float radius) {
-	ERR_FAIL_COND(_terrain == nullptr);
+} // namespace
 
-	ops::DoSphere op;
+int VoxelToolLodTerrain::do_sphere_async(Vector3 center, float radius) {
+	ERR_FAIL_COND_V(_terrain == nullptr, 0);
+
+	UniquePtr<AsyncSphereEditOp> edit = make_unique_instance<AsyncSphereEditOp>();
+	ops::DoShapeChunked<ops::SdfSphere, ops::VoxelDataGridAccess> &op = edit->op;
 	op.shape.center = to_vec3f(center);
 	op.shape.radius = radius;
 	op.shape.sdf_scale = get_sdf_scale();
@@ -209,13 +271,79 @@ void VoxelToolLodTerrain::do_sphere_async(Vector3 center, float radius) {
 
 	if (!is_area_editable(op.box)) {
 		ZN_PRINT_WARNING("Area not editable");
-		return;
+		return 0;
+	}
+
+	return _terrain->push_async_edit_op(std::move(edit));
+}
+
+int VoxelToolLodTerrain::do_box_async(Vector3i begin, Vector3i end) {
+	ERR_FAIL_COND_V(_terrain == nullptr, 0);
+
+	UniquePtr<AsyncShapeEditOp<ops::SdfAxisAlignedBox>> edit =
+			make_unique_instance<AsyncShapeEditOp<ops::SdfAxisAlignedBox>>();
+	ops::DoShapeChunked<ops::SdfAxisAlignedBox, ops::VoxelDataGridAccess> &op = edit->op;
+	op.shape.center = to_vec3f(begin + end) * 0.5f;
+	op.shape.half_size = to_vec3f(end - begin) * 0.5f;
+	op.shape.sdf_scale = get_sdf_scale();
+	op.box = op.shape.get_box().clipped(_terrain->get_voxel_bounds());
+	op.mode = ops::Mode(get_mode());
+	op.texture_params = _texture_params;
+	op.blocky_value = _value;
+	op.channel = get_channel();
+	op.strength = get_sdf_strength();
+
+	if (!is_area_editable(op.box)) {
+		ZN_PRINT_WARNING("Area not editable");
+		return 0;
 	}
 
-	std::shared_ptr<VoxelData> data = _terrain->get_storage_shared();
+	return _terrain->push_async_edit_op(std::move(edit));
+}
+
+int VoxelToolLodTerrain::do_hemisphere_async(Vector3 center, float radius, Vector3 flat_direction, float smoothness) {
+	ERR_FAIL_COND_V(_terrain == nullptr, 0);
 
-	VoxelToolAsyncEdit<ops::DoSphere> *task = ZN_NEW(VoxelToolAsyncEdit<ops::DoSphere>(op, data));
-	_terrain->push_async_edit(task, op.box, task->get_tracker());
+	UniquePtr<AsyncShapeEditOp<ops::SdfHemisphere>> edit = make_unique_instance<AsyncShapeEditOp<ops::SdfHemisphere>>();
+	ops::DoShapeChunked<ops::SdfHemisphere, ops::VoxelDataGridAccess> &op = edit->op;
+	op.shape.center = to_vec3f(center);
+	op.shape.radius = radius;
+	op.shape.flat_direction = to_vec3f(flat_direction);
+	op.shape.plane_d = flat_direction.dot(center);
+	op.shape.smoothness = smoothness;
+	op.shape.sdf_scale = get_sdf_scale();
+	op.box = op.shape.get_box().clipped(_terrain->get_voxel_bounds());
+	op.mode = ops::Mode(get_mode());
+	op.texture_params = _texture_params;
+	op.blocky_value = _value;
+	op.channel = get_channel();
+	op.strength = get_sdf_strength();
+
+	if (!is_area_editable(op.box)) {
+		ZN_PRINT_WARNING("Area not editable");
+		return 0;
+	}
+
+	return _terrain->push_async_edit_op(std::move(edit));
+}
+
+int VoxelToolLodTerrain::paste_async(Vector3i pos, const VoxelBuffer &src, uint8_t channels_mask) {
+	ERR_FAIL_COND_V(_terrain == nullptr, 0);
+	if (channels_mask == 0) {
+		channels_mask = (1 << _channel);
+	}
+	const Box3i box(pos, src.get_size());
+	if (!is_area_editable(box)) {
+		ZN_PRINT_WARNING("Area not editable");
+		return 0;
+	}
+
+	UniquePtr<AsyncPasteEditOp> edit = make_unique_instance<AsyncPasteEditOp>();
+	edit->position = pos;
+	src.copy_to(edit->src, false);
+	edit->channels_mask = channels_mask;
+
+	return _terrain->push_async_edit_op(std::move(edit));
 }
 
 void VoxelToolLodTerrain::copy(Vector3i pos, VoxelBuffer &dst, uint8_t channels_mask) const {
@@ -246,6 +374,46 @@ void VoxelToolLodTerrain::paste(Vector3i pos, const VoxelBuffer &src, uint8_t ch
 	_post_edit(box);
 }
 
+void VoxelToolLodTerrain::copy_to_clipboard(
+		Vector3i pos,
+		Vector3i size,
+		VoxelClipboard &dst,
+		uint8_t channels_mask
+) const {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND(_terrain == nullptr);
+	if (channels_mask == 0) {
+		channels_mask = (1 << _channel);
+	}
+	_terrain->get_storage().copy_to_clipboard(Box3i(pos, size), dst, channels_mask);
+}
+
+void VoxelToolLodTerrain::paste_clipboard(
+		Vector3i pos,
+		const VoxelClipboard &src,
+		uint8_t channels_mask,
+		bool use_mask,
+		uint8_t mask_channel,
+		uint64_t mask_value
+) {
+	ERR_FAIL_COND(_terrain == nullptr);
+	if (channels_mask == 0) {
+		channels_mask = (1 << _channel);
+	}
+	const Box3i box(pos, src.size);
+	if (!is_area_editable(box)) {
+		ZN_PRINT_WARNING("Area not editable");
+		return;
+	}
+
+	VoxelData &data = _terrain->get_storage();
+
+	data.pre_generate_box(box);
+	data.paste_clipboard(pos, src, channels_mask, use_mask, mask_channel, mask_value, false);
+
+	_post_edit(box);
+}
+
 float VoxelToolLodTerrain::get_voxel_f_interpolated(Vector3 position) const {
 	ZN_PROFILE_SCOPE();
 	ERR_FAIL_COND_V(_terrain == nullptr, 0);
@@ -320,6 +488,52 @@ Array VoxelToolLodTerrain::separate_floating_chunks(AABB world_box, Object *pare
 	);
 }
 
+#if defined(ZN_GODOT)
+Array VoxelToolLodTerrain::separate_floating_chunks_incremental(AABB world_box, AABB edited_box, Node *parent_node) {
+#elif defined(ZN_GODOT_EXTENSION)
+Array VoxelToolLodTerrain::separate_floating_chunks_incremental(
+		AABB world_box,
+		AABB edited_box,
+		Object *parent_node_o
+) {
+	Node *parent_node = Object::cast_to<Node>(parent_node_o);
+#endif
+	ERR_FAIL_COND_V(_terrain == nullptr, Array());
+	ERR_FAIL_COND_V(!math::is_valid_size(world_box.size), Array());
+	Ref<VoxelMesher> mesher = _terrain->get_mesher();
+	Array materials;
+	materials.append(_terrain->get_material());
+	const Box3i int_world_box(math::floor_to_int(world_box.position), math::ceil_to_int(world_box.size));
+	const Box3i int_edited_box(math::floor_to_int(edited_box.position), math::ceil_to_int(edited_box.size));
+	return zylann::voxel::separate_floating_chunks_incremental(
+			*this,
+			_floating_chunks_cache,
+			int_world_box,
+			int_edited_box,
+			parent_node,
+			_terrain->get_global_transform(),
+			mesher,
+			materials
+	);
+}
+
+#if defined(ZN_GODOT)
+int VoxelToolLodTerrain::separate_floating_chunks_async(AABB world_box, Node *parent_node) {
+#elif defined(ZN_GODOT_EXTENSION)
+int VoxelToolLodTerrain::separate_floating_chunks_async(AABB world_box, Object *parent_node_o) {
+	Node *parent_node = Object::cast_to<Node>(parent_node_o);
+#endif
+	ERR_FAIL_COND_V(_terrain == nullptr, 0);
+	ERR_FAIL_COND_V(!math::is_valid_size(world_box.size), 0);
+	Ref<VoxelMesher> mesher = _terrain->get_mesher();
+	Array materials;
+	materials.append(_terrain->get_material());
+	const Box3i int_world_box(math::floor_to_int(world_box.position), math::ceil_to_int(world_box.size));
+	return zylann::voxel::separate_floating_chunks_async(
+			*_terrain, _terrain->get_storage_shared(), int_world_box, parent_node, mesher, materials
+	);
+}
+
 // Combines a precalculated SDF with the terrain at a specific position, rotation and scale.
 //
 // `transform` is where the buffer should be applied on the terrain.
@@ -550,6 +764,37 @@ void VoxelToolLodTerrain::run_blocky_random_tick(
 	);
 }
 
+void VoxelToolLodTerrain::run_blocky_random_tick_batched(
+		const int block_count,
+		const int voxels_per_block,
+		const Callable &callback
+) {
+	ZN_PROFILE_SCOPE();
+
+	ZN_ASSERT_RETURN(_terrain != nullptr);
+
+	Ref<VoxelMesherBlocky> mesher = _terrain->get_mesher();
+	ZN_ASSERT_RETURN_MSG(
+			mesher.is_valid(),
+			format("This function requires a volume using {} with a valid library", ZN_CLASS_NAME_C(VoxelMesherBlocky))
+	);
+	Ref<VoxelBlockyLibraryBase> library = mesher->get_library();
+	ZN_ASSERT_RETURN_MSG(library.is_valid(), format("{} has no library assigned", ZN_CLASS_NAME_C(VoxelMesherBlocky)));
+
+	ZN_ASSERT_RETURN(callback.is_valid());
+	ZN_ASSERT_RETURN(block_count >= 0);
+	ZN_ASSERT_RETURN(voxels_per_block >= 0);
+
+	zylann::voxel::run_blocky_random_tick_batched(
+			_random_ticker, _terrain->get_storage(), **library, block_count, voxels_per_block, callback
+	);
+}
+
+int VoxelToolLodTerrain::_b_paste_async(Vector3i pos, Ref<godot::VoxelBuffer> voxels, int channels_mask) {
+	ERR_FAIL_COND_V(voxels.is_null(), 0);
+	return paste_async(pos, voxels->get_buffer(), channels_mask);
+}
+
 void VoxelToolLodTerrain::_bind_methods() {
 	using Self = VoxelToolLodTerrain;
 
@@ -559,7 +804,23 @@ void VoxelToolLodTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_raycast_binary_search_iterations"), &Self::get_raycast_binary_search_iterations);
 	ClassDB::bind_method(D_METHOD("get_voxel_f_interpolated", "position"), &Self::get_voxel_f_interpolated);
 	ClassDB::bind_method(D_METHOD("separate_floating_chunks", "box", "parent_node"), &Self::separate_floating_chunks);
+	ClassDB::bind_method(
+			D_METHOD("separate_floating_chunks_incremental", "box", "edited_box", "parent_node"),
+			&Self::separate_floating_chunks_incremental
+	);
+	ClassDB::bind_method(
+			D_METHOD("separate_floating_chunks_async", "box", "parent_node"), &Self::separate_floating_chunks_async
+	);
 	ClassDB::bind_method(D_METHOD("do_sphere_async", "center", "radius"), &Self::do_sphere_async);
+	ClassDB::bind_method(D_METHOD("do_box_async", "begin", "end"), &Self::do_box_async);
+	ClassDB::bind_method(
+			D_METHOD("do_hemisphere_async", "center", "radius", "flat_direction", "smoothness"),
+			&Self::do_hemisphere_async,
+			DEFVAL(0.0)
+	);
+	ClassDB::bind_method(
+			D_METHOD("paste_async", "dst_pos", "src_buffer", "channels_mask"), &Self::_b_paste_async
+	);
 	ClassDB::bind_method(D_METHOD("stamp_sdf", "mesh_sdf", "transform", "isolevel", "sdf_scale"), &Self::stamp_sdf);
 	ClassDB::bind_method(D_METHOD("do_graph", "graph", "transform", "area_size"), &Self::do_graph);
 	ClassDB::bind_method(
@@ -572,6 +833,10 @@ void VoxelToolLodTerrain::_bind_methods() {
 			&Self::run_blocky_random_tick,
 			DEFVAL(16)
 	);
+	ClassDB::bind_method(
+			D_METHOD("run_blocky_random_tick_batched", "block_count", "voxels_per_block", "callback"),
+			&Self::run_blocky_random_tick_batched
+	);
 }
 
 } // namespace zylann::voxel
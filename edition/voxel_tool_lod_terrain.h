@@ -3,6 +3,8 @@
 
 #include "../util/godot/core/random_pcg.h"
 #include "../util/macros.h"
+#include "blocky_random_ticker.h"
+#include "floating_chunks.h"
 #include "voxel_tool.h"
 
 ZN_GODOT_FORWARD_DECLARE(class Node);
@@ -22,17 +24,40 @@ public:
 
 	bool is_area_editable(const Box3i &box) const override;
 	Ref<VoxelRaycastResult> raycast(Vector3 pos, Vector3 dir, float max_distance, uint32_t collision_mask) override;
+	void raycast_batch(
+			Span<const Vector3> origins,
+			Span<const Vector3> directions,
+			float max_distance,
+			uint32_t collision_mask,
+			Span<RaycastHit> out_hits
+	) override;
 	void do_box(Vector3i begin, Vector3i end) override;
 	void do_sphere(Vector3 center, float radius) override;
 	void copy(Vector3i pos, VoxelBuffer &dst, uint8_t channels_mask) const override;
 	void paste(Vector3i pos, const VoxelBuffer &src, uint8_t channels_mask) override;
+	void copy_to_clipboard(Vector3i pos, Vector3i size, VoxelClipboard &dst, uint8_t channels_mask) const override;
+	void paste_clipboard(
+			Vector3i pos,
+			const VoxelClipboard &src,
+			uint8_t channels_mask,
+			bool use_mask,
+			uint8_t mask_channel,
+			uint64_t mask_value
+	) override;
 
 	// Specialized API
 
 	int get_raycast_binary_search_iterations() const;
 	void set_raycast_binary_search_iterations(int iterations);
-	void do_sphere_async(Vector3 center, float radius);
 	void do_hemisphere(Vector3 center, float radius, Vector3 flat_direction, float smoothness);
+
+	// Async edits are queued and applied on threads along with other edits made during the same frame. They return the
+	// ID of the batch they are part of, which is passed to `VoxelLodTerrain.async_edit_batch_completed` once applied.
+	int do_sphere_async(Vector3 center, float radius);
+	int do_box_async(Vector3i begin, Vector3i end);
+	int do_hemisphere_async(Vector3 center, float radius, Vector3 flat_direction, float smoothness);
+	int paste_async(Vector3i pos, const VoxelBuffer &src, uint8_t channels_mask);
+
 	float get_voxel_f_interpolated(Vector3 position) const;
 
 	// TODO GDX: it seems binding a method taking a `Node*` fails to compile. It is supposed to be working.
@@ -42,6 +67,22 @@ public:
 	Array separate_floating_chunks(AABB world_box, Object *parent_node_o);
 #endif
 
+	// Same as `separate_floating_chunks`, but only checks voxels connected to `edited_box`, using labels cached from
+	// previous calls with the same box.
+#if defined(ZN_GODOT)
+	Array separate_floating_chunks_incremental(AABB world_box, AABB edited_box, Node *parent_node);
+#elif defined(ZN_GODOT_EXTENSION)
+	Array separate_floating_chunks_incremental(AABB world_box, AABB edited_box, Object *parent_node_o);
+#endif
+
+	// Same as `separate_floating_chunks`, but most of the work is done on threads. Returns an ID which is passed to
+	// `VoxelLodTerrain.floating_chunks_separated` along with created bodies.
+#if defined(ZN_GODOT)
+	int separate_floating_chunks_async(AABB world_box, Node *parent_node);
+#elif defined(ZN_GODOT_EXTENSION)
+	int separate_floating_chunks_async(AABB world_box, Object *parent_node_o);
+#endif
+
 	void stamp_sdf(Ref<VoxelMeshSDF> mesh_sdf, Transform3D transform, float isolevel, float sdf_scale);
 	void do_graph(Ref<VoxelGeneratorGraph> graph, Transform3D transform, Vector3 area_size);
 
@@ -52,6 +93,10 @@ public:
 			const int block_batch_count
 	);
 
+	// Picks random voxels in the next slice of loaded blocks, and calls the callback once with all tickable hits.
+	// Successive calls go through all loaded blocks.
+	void run_blocky_random_tick_batched(int block_count, int voxels_per_block, const Callable &callback);
+
 protected:
 	uint64_t _get_voxel(Vector3i pos) const override;
 	float _get_voxel_f(Vector3i pos) const override;
@@ -60,11 +105,15 @@ protected:
 	void _post_edit(const Box3i &box) override;
 
 private:
+	int _b_paste_async(Vector3i pos, Ref<godot::VoxelBuffer> voxels, int channels_mask);
+
 	static void _bind_methods();
 
 	VoxelLodTerrain *_terrain = nullptr;
 	int _raycast_binary_search_iterations = 0;
 	RandomPCG _random;
+	BlockyRandomTicker _random_ticker;
+	FloatingChunksCache _floating_chunks_cache;
 };
 
 } // namespace zylann::voxel
@@ -49,6 +49,27 @@ Ref<VoxelRaycastResult> VoxelToolTerrain::raycast(
 	);
 }
 
+void VoxelToolTerrain::raycast_batch(
+		Span<const Vector3> origins,
+		Span<const Vector3> directions,
+		float max_distance,
+		uint32_t collision_mask,
+		Span<RaycastHit> out_hits
+) {
+	ERR_FAIL_COND(_terrain == nullptr);
+	raycast_generic_world_batch(
+			_terrain->get_storage(),
+			_terrain->get_mesher(),
+			_terrain->get_global_transform(),
+			origins,
+			directions,
+			max_distance,
+			collision_mask,
+			0,
+			out_hits
+	);
+}
+
 void VoxelToolTerrain::copy(Vector3i pos, VoxelBuffer &dst, uint8_t channels_mask) const {
 	ERR_FAIL_COND(_terrain == nullptr);
 	if (channels_mask == 0) {
@@ -109,6 +130,35 @@ void VoxelToolTerrain::paste_masked_writable_list( //
 	_post_edit(Box3i(pos, p_voxels->get_buffer().get_size()));
 }
 
+void VoxelToolTerrain::copy_to_clipboard(
+		Vector3i pos,
+		Vector3i size,
+		VoxelClipboard &dst,
+		uint8_t channels_mask
+) const {
+	ERR_FAIL_COND(_terrain == nullptr);
+	if (channels_mask == 0) {
+		channels_mask = (1 << _channel);
+	}
+	_terrain->get_storage().copy_to_clipboard(Box3i(pos, size), dst, channels_mask);
+}
+
+void VoxelToolTerrain::paste_clipboard(
+		Vector3i pos,
+		const VoxelClipboard &src,
+		uint8_t channels_mask,
+		bool use_mask,
+		uint8_t mask_channel,
+		uint64_t mask_value
+) {
+	ERR_FAIL_COND(_terrain == nullptr);
+	if (channels_mask == 0) {
+		channels_mask = (1 << _channel);
+	}
+	_terrain->get_storage().paste_clipboard(pos, src, channels_mask, use_mask, mask_channel, mask_value, false);
+	_post_edit(Box3i(pos, src.size));
+}
+
 void VoxelToolTerrain::do_box(Vector3i begin, Vector3i end) {
 	ZN_PROFILE_SCOPE();
 	ERR_FAIL_COND(_terrain == nullptr);
@@ -298,6 +348,25 @@ void VoxelToolTerrain::run_blocky_random_tick(
 	zylann::voxel::run_blocky_random_tick(data, voxel_area, lib, _random, voxel_count, batch_count, callback);
 }
 
+void VoxelToolTerrain::run_blocky_random_tick_batched(int block_count, int voxels_per_block, const Callable &callback) {
+	ZN_PROFILE_SCOPE();
+
+	ERR_FAIL_COND(_terrain == nullptr);
+	ERR_FAIL_COND_MSG(
+			get_voxel_library(*_terrain).is_null(),
+			String("This function requires a volume using {0} with a valid library")
+					.format(varray(VoxelMesherBlocky::get_class_static()))
+	);
+	ERR_FAIL_COND(callback.is_null());
+	ERR_FAIL_COND(block_count < 0);
+	ERR_FAIL_COND(voxels_per_block < 0);
+
+	const VoxelBlockyLibraryBase &lib = **get_voxel_library(*_terrain);
+	VoxelData &data = _terrain->get_storage();
+
+	zylann::voxel::run_blocky_random_tick_batched(_random_ticker, data, lib, block_count, voxels_per_block, callback);
+}
+
 void VoxelToolTerrain::for_each_voxel_metadata_in_area(AABB voxel_area, const Callable &callback) {
 	ERR_FAIL_COND(_terrain == nullptr);
 	ERR_FAIL_COND(callback.is_null());
@@ -371,54 +440,22 @@ void VoxelToolTerrain::do_path(Span<const Vector3> positions, Span<const float>
 		VoxelDataGrid::LockWrite wlock(grid);
 
 		// Rasterize
+		// TODO Apply terrain scale
+
+		ops::DoPathChunked<ops::VoxelDataGridAccess> op;
+		op.positions = positions;
+		op.radii = radii;
+		op.sdf_scale = get_sdf_scale();
+		op.block_access.grid = &grid;
+		op.clip_box = total_voxel_box;
+		op.margin = margin;
+		op.mode = ops::Mode(get_mode());
+		op.texture_params = _texture_params;
+		op.blocky_value = _value;
+		op.channel = get_channel();
+		op.strength = get_sdf_strength();
 
-		for (unsigned int point_index = 1; point_index < positions.size(); ++point_index) {
-			// TODO Could run this in local space so we dont need doubles
-			// TODO Apply terrain scale
-			const Vector3f p0 = to_vec3f(positions[point_index - 1]);
-			const Vector3f p1 = to_vec3f(positions[point_index]);
-
-			const float r0 = radii[point_index - 1];
-			const float r1 = radii[point_index];
-
-			ops::DoShapeChunked<ops::SdfRoundCone, ops::VoxelDataGridAccess> op;
-			op.block_access.grid = &grid;
-			op.shape.cone.a = p0;
-			op.shape.cone.b = p1;
-			op.shape.cone.r1 = r0;
-			op.shape.cone.r2 = r1;
-			op.shape.cone.update();
-			op.shape.sdf_scale = get_sdf_scale();
-			op.box = op.shape.get_box().padded(margin);
-			op.mode = ops::Mode(get_mode());
-			op.texture_params = _texture_params;
-			op.blocky_value = _value;
-			op.channel = get_channel();
-			op.strength = get_sdf_strength();
-
-			op();
-
-			// Experimented with drawing a 100-point path, the cost of everything outside cone calculation was:
-			// - Non-template: 2.55 ms
-			// - Template: 1.00 ms
-			// With cone calculation:
-			// - Non-template: 5.7 ms
-			// - Template: 4.5 ms
-			// So the template version is faster, but not that much.
-			//
-			// math::SdfRoundConePrecalc cone;
-			// cone.a = p0;
-			// cone.b = p1;
-			// cone.r1 = r0;
-			// cone.r2 = r1;
-			// cone.update();
-			// uint64_t value = _value;
-			// segment_box.for_each_cell_zxy([&grid, &cone, value](Vector3i pos) {
-			// 	if (cone(pos) < 0.f) {
-			// 		grid.set_voxel_no_lock(pos, value, VoxelBuffer::CHANNEL_TYPE);
-			// 	}
-			// });
-		}
+		op();
 	}
 
 	_post_edit(total_voxel_box);
@@ -430,6 +467,10 @@ void VoxelToolTerrain::_bind_methods() {
 			&VoxelToolTerrain::run_blocky_random_tick,
 			DEFVAL(16)
 	);
+	ClassDB::bind_method(
+			D_METHOD("run_blocky_random_tick_batched", "block_count", "voxels_per_block", "callback"),
+			&VoxelToolTerrain::run_blocky_random_tick_batched
+	);
 	ClassDB::bind_method(
 			D_METHOD("for_each_voxel_metadata_in_area", "voxel_area", "callback"),
 			&VoxelToolTerrain::for_each_voxel_metadata_in_area
@@ -2,6 +2,7 @@
 #define VOXEL_TOOL_TERRAIN_H
 
 #include "../util/godot/core/random_pcg.h"
+#include "blocky_random_ticker.h"
 #include "voxel_tool.h"
 
 namespace zylann::voxel {
@@ -19,6 +20,13 @@ public:
 	bool is_area_editable(const Box3i &box) const override;
 	Ref<VoxelRaycastResult> raycast(Vector3 p_pos, Vector3 p_dir, float p_max_distance, uint32_t p_collision_mask)
 			override;
+	void raycast_batch(
+			Span<const Vector3> origins,
+			Span<const Vector3> directions,
+			float max_distance,
+			uint32_t collision_mask,
+			Span<RaycastHit> out_hits
+	) override;
 
 	void set_voxel_metadata(Vector3i pos, Variant meta) override;
 	Variant get_voxel_metadata(Vector3i pos) const override;
@@ -43,6 +51,16 @@ public:
 			PackedInt32Array dst_writable_list //
 	) override;
 
+	void copy_to_clipboard(Vector3i pos, Vector3i size, VoxelClipboard &dst, uint8_t channels_mask) const override;
+	void paste_clipboard(
+			Vector3i pos,
+			const VoxelClipboard &src,
+			uint8_t channels_mask,
+			bool use_mask,
+			uint8_t mask_channel,
+			uint64_t mask_value
+	) override;
+
 	void do_box(Vector3i begin, Vector3i end) override;
 	void do_sphere(Vector3 center, float radius) override;
 	void do_path(Span<const Vector3> positions, Span<const float> radii) override;
@@ -53,6 +71,10 @@ public:
 
 	void run_blocky_random_tick(AABB voxel_area, int voxel_count, const Callable &callback, int block_batch_count);
 
+	// Picks random voxels in the next slice of loaded blocks, and calls the callback once with all tickable hits.
+	// Successive calls go through all loaded blocks.
+	void run_blocky_random_tick_batched(int block_count, int voxels_per_block, const Callable &callback);
+
 	void for_each_voxel_metadata_in_area(AABB voxel_area, const Callable &callback);
 
 protected:
@@ -67,6 +89,7 @@ private:
 
 	VoxelTerrain *_terrain = nullptr;
 	RandomPCG _random;
+	BlockyRandomTicker _random_ticker;
 };
 
 } // namespace zylann::voxel
@@ -22,7 +22,7 @@ static const Node g_data[COUNT] = {
     {"Distance2D", "Vector", "Returns the distance between two 2D points [code](x0, y0)[/code] and [code](x1, y1)[/code]."},
     {"Distance3D", "Vector", "Returns the distance between two 3D points [code](x0, y0, z0)[/code] and [code](x1, y1, z1)[/code]."},
     {"Divide", "Ops", "Returns the result of [code]a / b[/code].\nNote: dividing by zero outputs NaN. It should not cause crashes, but will likely mess up results. Consider using Multiply when possible."},
-    {"Expression", "Math", "Evaluates a math expression. Variable names can be written as inputs of the node. Some functions can be used, but they must be supported graph nodes in the first place, as the expression will be converted to nodes internally.\nAvailable functions:\n[code]\nsin(x)\nfloor(x)\nabs(x)\nsqrt(x)\nfract(x)\nstepify(x, step)\nwrap(x, length)\nmin(a, b)\nmax(a, b)\nclamp(x, min, max)\nlerp(a, b, ratio)\n[/code]"},
+    {"Expression", "Math", "Evaluates a math expression. Variable names can be written as inputs of the node. Some functions can be used, but they must be supported graph nodes in the first place. Expressions made of several operations are compiled into a single operation running them as bytecode, while simpler ones are converted to nodes internally. Variables left unconnected use the default value of their input.\nAvailable functions:\n[code]\nsin(x)\nfloor(x)\nabs(x)\nsqrt(x)\nfract(x)\nstepify(x, step)\nwrap(x, length)\nmin(a, b)\nmax(a, b)\nclamp(x, min, max)\nlerp(a, b, ratio)\n[/code]"},
     {"FastNoise2D", "Noise", "Returns computation of 2D noise at coordinates [code](x, y)[/code] using the FastNoiseLite library. The [code]noise[/code] parameter is specified with an instance of the [url=ZN_FastNoiseLite]ZN_FastNoiseLite[/url] resource.\nNote: this node might be a little faster than [code]Noise2D[/code]."},
     {"FastNoise2_2D", "Noise", "Returns computation of 2D SIMD noise at coordinates [code](x, y)[/code] using the FastNoise2 library. The `noise` parameter is specified with an instance of the [url=FastNoise2]FastNoise2[/url] resource. This is the fastest noise currently supported."},
     {"FastNoise2_3D", "Noise", "Returns computation of 3D SIMD noise at coordinates [code](x, y, z)[/code] using the FastNoise2 library. The [code]noise[/code] parameter is specified with an instance of the [url=FastNoise2]FastNoise2[/url] resource. This is the fastest noise currently supported."},
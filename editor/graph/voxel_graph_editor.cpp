@@ -1238,11 +1238,24 @@ void VoxelGraphEditor::profile() {
 
 	StdVector<VoxelGeneratorGraph::NodeProfilingInfo> nodes_profiling_info;
 	const float us = _generator->debug_measure_microseconds_per_voxel(false, &nodes_profiling_info);
-	_profile_label->set_text(String("{0} microseconds per voxel").format(varray(us)));
+	String profile_text = String("{0} microseconds per voxel").format(varray(us));
+
+	// Report what range analysis saved in blocks generated since the last time we profiled
+	const VoxelGeneratorGraph::RangeAnalysisStats ra_stats = _generator->get_range_analysis_stats();
+	_generator->reset_range_analysis_stats();
+	const uint64_t total_voxels = ra_stats.clipped_voxels + ra_stats.computed_voxels;
+	if (total_voxels > 0) {
+		const float skipped_percent = 100.f * float(ra_stats.clipped_voxels) / float(total_voxels);
+		profile_text += String(", {0}% of voxels skipped by range analysis ({1} areas analyzed)")
+								.format(varray(skipped_percent, int64_t(ra_stats.analyzed_boxes)));
+	}
+
+	_profile_label->set_text(profile_text);
 
 	struct NodeRatio {
 		uint32_t node_id;
 		float ratio;
+		float nanoseconds_per_sample;
 	};
 
 	StdVector<NodeRatio> node_ratios;
@@ -1257,9 +1270,10 @@ void VoxelGraphEditor::profile() {
 			}
 		}
 		if (i == node_ratios.size()) {
-			node_ratios.push_back(NodeRatio{ info.node_id, float(info.microseconds) });
+			node_ratios.push_back(NodeRatio{ info.node_id, float(info.microseconds), info.nanoseconds_per_sample });
 		} else {
 			node_ratios[i].ratio += info.microseconds;
+			node_ratios[i].nanoseconds_per_sample += info.nanoseconds_per_sample;
 		}
 		max_individual_time = math::max(max_individual_time, float(info.microseconds));
 	}
@@ -1285,6 +1299,7 @@ void VoxelGraphEditor::profile() {
 		ERR_CONTINUE(node_view == nullptr);
 		node_view->set_profiling_ratio_visible(true);
 		node_view->set_profiling_ratio(nr.ratio);
+		node_view->set_profiling_time_per_sample(nr.nanoseconds_per_sample);
 	}
 }
 
@@ -333,6 +333,9 @@ void VoxelGraphEditorNode::set_profiling_ratio_visible(bool p_visible) {
 		return;
 	}
 	_profiling_ratio_enabled = p_visible;
+	if (!p_visible) {
+		set_tooltip_text("");
+	}
 	queue_redraw();
 }
 
@@ -344,6 +347,10 @@ void VoxelGraphEditorNode::set_profiling_ratio(float ratio) {
 	queue_redraw();
 }
 
+void VoxelGraphEditorNode::set_profiling_time_per_sample(float nanoseconds) {
+	set_tooltip_text(String("{0} ns/sample").format(varray(nanoseconds)));
+}
+
 void VoxelGraphEditorNode::_notification(int p_what) {
 	using namespace zylann::godot;
 
@@ -45,6 +45,8 @@ public:
 
 	void set_profiling_ratio_visible(bool p_visible);
 	void set_profiling_ratio(float ratio);
+	// Shown in the tooltip of the node
+	void set_profiling_time_per_sample(float nanoseconds);
 
 private:
 	void update_title(const pg::VoxelGraphFunction &graph, uint32_t node_id);
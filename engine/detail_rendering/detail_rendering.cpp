@@ -1,10 +1,12 @@
 #include "detail_rendering.h"
+#include "detail_texture_tile_cache.h"
 #include "../../edition/funcs.h"
 #include "../../generators/voxel_generator.h"
 #include "../../storage/voxel_data.h"
 #include "../../storage/voxel_data_grid.h"
 #include "../../util/godot/classes/image.h"
 #include "../../util/godot/classes/image_texture.h"
+#include "../../util/hash_funcs.h"
 #include "../../util/math/basis3f.h"
 #include "../../util/math/conv.h"
 #include "../../util/math/triangle.h"
@@ -103,6 +105,49 @@ DetailTextureData::Tile compute_tile_info(
 	return tile;
 }
 
+// Identifies what a tile without edits is rendered from: triangles of the cell, the generator and settings.
+// Modifiers are not included, the cache gets invalidated where they change.
+uint64_t get_tile_source_hash(
+		const CurrentCellInfo &cell_info,
+		Span<const Vector3f> mesh_vertices,
+		Span<const Vector3f> mesh_normals,
+		Span<const int> mesh_indices,
+		Vector3f cell_origin_mesh,
+		unsigned int tile_resolution,
+		bool octahedral_encoding,
+		float max_deviation_radians,
+		const VoxelGenerator &generator
+) {
+	static thread_local StdVector<float> tls_data;
+	tls_data.clear();
+
+	tls_data.push_back(tile_resolution);
+	tls_data.push_back(octahedral_encoding ? 1.f : 0.f);
+	tls_data.push_back(max_deviation_radians);
+
+	for (unsigned int triangle_index = 0; triangle_index < cell_info.triangle_count; ++triangle_index) {
+		const unsigned int ii0 = cell_info.triangle_begin_indices[triangle_index];
+		for (unsigned int i = 0; i < 3; ++i) {
+			const unsigned int vi = mesh_indices[ii0 + i];
+			// Relative to the cell, so results don't depend on where the cell is in the mesh
+			const Vector3f v = mesh_vertices[vi] - cell_origin_mesh;
+			const Vector3f n = mesh_normals[vi];
+			tls_data.push_back(v.x);
+			tls_data.push_back(v.y);
+			tls_data.push_back(v.z);
+			tls_data.push_back(n.x);
+			tls_data.push_back(n.y);
+			tls_data.push_back(n.z);
+		}
+	}
+
+	uint64_t hash[2];
+	hash_murmur3_128(
+			to_span_const(tls_data).reinterpret_cast_to<const uint8_t>(), reinterpret_cast<uintptr_t>(&generator), hash
+	);
+	return hash[0];
+}
+
 void get_axis_indices(math::Axis axis, unsigned int &ax, unsigned int &ay, unsigned int &az) {
 	switch (axis) {
 		case math::AXIS_X:
@@ -393,6 +438,289 @@ inline void query_sdf(
 #endif
 }
 
+// Positions where SDF is sampled to compute normals, along with the results
+struct NormalSampleBuffers {
+	StdVector<float> x;
+	StdVector<float> y;
+	StdVector<float> z;
+	StdVector<float> sdf;
+	Vector3f min_pos;
+	Vector3f max_pos;
+
+	void clear() {
+		x.clear();
+		y.clear();
+		z.clear();
+		sdf.clear();
+	}
+
+	inline size_t size() const {
+		return x.size();
+	}
+
+	uint32_t add(Vector3f pos) {
+		if (x.size() == 0) {
+			min_pos = pos;
+			max_pos = pos;
+		} else {
+			min_pos = Vector3f(math::min(min_pos.x, pos.x), math::min(min_pos.y, pos.y), math::min(min_pos.z, pos.z));
+			max_pos = Vector3f(math::max(max_pos.x, pos.x), math::max(max_pos.y, pos.y), math::max(max_pos.z, pos.z));
+		}
+		x.push_back(pos.x);
+		y.push_back(pos.y);
+		z.push_back(pos.z);
+		return x.size() - 1;
+	}
+
+	inline Vector3f get_position(uint32_t i) const {
+		return Vector3f(x[i], y[i], z[i]);
+	}
+};
+
+// Samples used to compute the normal of a pixel with forward differences
+struct PixelSamples {
+	uint32_t i000;
+	uint32_t i100;
+	uint32_t i010;
+	uint32_t i001;
+	uint32_t normal_index;
+	uint8_t triangle_index;
+};
+
+// Tile whose normals get computed once its samples are queried
+struct PendingTile {
+	uint32_t normals_begin;
+	uint32_t pixels_begin;
+	uint32_t pixels_end;
+	FixedArray<Vector3f, CurrentCellInfo::MAX_TRIANGLES> triangle_normals;
+	bool use_tile_cache;
+	Vector3i cell_position_in_lod;
+	uint64_t tile_source_hash;
+};
+
+// Tiles without edits are queried together, up to this amount of samples, so the generator can process them in bulk
+const unsigned int MAX_NORMAL_SAMPLE_BATCH_SIZE = 16384;
+
+// Projects pixels of a tile onto triangles of its cell, and adds positions to sample around each hit.
+// Samples offset along the axes of the tile land exactly where the next pixels start, so they are shared with them
+// when both hit at the same depth, which is common on flat areas.
+void gather_tile_samples(
+		const CellTriangles &baked_triangles,
+		unsigned int triangle_count,
+		Vector3f quad_origin_world,
+		Vector3f origin_in_voxels,
+		unsigned int ax,
+		unsigned int ay,
+		unsigned int az,
+		float step,
+		unsigned int cell_size,
+		unsigned int tile_resolution,
+		NormalSampleBuffers &samples,
+		StdVector<PixelSamples> &pixels
+) {
+	ZN_PROFILE_SCOPE_NAMED("Compute positions");
+
+	Vector3f direction;
+	direction[az] = 1.f;
+
+	const unsigned int pixel_count = math::squared(tile_resolution);
+
+	// Triangle hit by each pixel, or `triangle_count` if none
+	static thread_local StdVector<uint8_t> tls_hit_triangles;
+	static thread_local StdVector<float> tls_hit_depths;
+	static thread_local StdVector<uint32_t> tls_origin_samples;
+	tls_hit_triangles.resize(pixel_count);
+	tls_hit_depths.resize(pixel_count);
+	tls_origin_samples.resize(pixel_count);
+
+	for (unsigned int yi = 0; yi < tile_resolution; ++yi) {
+		for (unsigned int xi = 0; xi < tile_resolution; ++xi) {
+			const unsigned int pi = xi + yi * tile_resolution;
+
+			// TODO Add bias to center differences when calculating the normals?
+			Vector3f pos000 = quad_origin_world;
+			// Casting to `int` here because even if the target is float, temporaries can be negative uints
+			pos000[ax] += int(xi) * step;
+			pos000[ay] += int(yi) * step;
+
+			// Project to triangles
+			const Vector3f ray_origin_world = pos000 - direction * cell_size;
+			const Vector3f ray_origin_mesh = ray_origin_world - origin_in_voxels;
+			float nearest_hit_distance = 999999.f;
+			unsigned int hit_triangle_index = triangle_count;
+			for (unsigned int ti = 0; ti < triangle_count; ++ti) {
+				const math::TriangleIntersectionResult result =
+						baked_triangles[ti].intersect(ray_origin_mesh, direction);
+				if (result.case_id == math::TriangleIntersectionResult::INTERSECTION &&
+					result.distance < nearest_hit_distance) {
+					nearest_hit_distance = result.distance;
+					hit_triangle_index = ti;
+				}
+			}
+
+			tls_hit_triangles[pi] = hit_triangle_index;
+			if (hit_triangle_index == triangle_count) {
+				// Don't query if there is no triangle
+				continue;
+			}
+
+			pos000 = ray_origin_world + direction * nearest_hit_distance;
+			tls_hit_depths[pi] = pos000[az];
+			tls_origin_samples[pi] = samples.add(pos000);
+		}
+	}
+
+	auto hits_at_depth = [triangle_count](unsigned int pi, float depth) {
+		return tls_hit_triangles[pi] != triangle_count && tls_hit_depths[pi] == depth;
+	};
+
+	for (unsigned int yi = 0; yi < tile_resolution; ++yi) {
+		for (unsigned int xi = 0; xi < tile_resolution; ++xi) {
+			const unsigned int pi = xi + yi * tile_resolution;
+			if (tls_hit_triangles[pi] == triangle_count) {
+				continue;
+			}
+
+			const uint32_t i000 = tls_origin_samples[pi];
+			const Vector3f pos000 = samples.get_position(i000);
+			const float depth = pos000[az];
+
+			// Indexed by world axis
+			FixedArray<uint32_t, 3> offset_samples;
+
+			const unsigned int next_x = pi + 1;
+			if (xi + 1 < tile_resolution && hits_at_depth(next_x, depth)) {
+				offset_samples[ax] = tls_origin_samples[next_x];
+			} else {
+				Vector3f pos = pos000;
+				pos[ax] = quad_origin_world[ax] + int(xi + 1) * step;
+				offset_samples[ax] = samples.add(pos);
+			}
+
+			const unsigned int next_y = pi + tile_resolution;
+			if (yi + 1 < tile_resolution && hits_at_depth(next_y, depth)) {
+				offset_samples[ay] = tls_origin_samples[next_y];
+			} else {
+				Vector3f pos = pos000;
+				pos[ay] = quad_origin_world[ay] + int(yi + 1) * step;
+				offset_samples[ay] = samples.add(pos);
+			}
+
+			Vector3f pos = pos000;
+			pos[az] += step;
+			offset_samples[az] = samples.add(pos);
+
+			PixelSamples pixel;
+			pixel.i000 = i000;
+			pixel.i100 = offset_samples[0];
+			pixel.i010 = offset_samples[1];
+			pixel.i001 = offset_samples[2];
+			pixel.normal_index = pi;
+			pixel.triangle_index = tls_hit_triangles[pi];
+			pixels.push_back(pixel);
+		}
+	}
+}
+
+// Computes normals of a tile from its queried samples, and encodes them where the tile was reserved in the normalmap
+void finish_tile(
+		const PendingTile &tile,
+		Span<const PixelSamples> pixels,
+		Span<const float> sdf,
+		unsigned int tile_resolution,
+		bool octahedral_encoding,
+		float max_deviation_cosine,
+		float max_deviation_sine,
+		DetailTextureData &normal_map_data,
+		DetailTextureTileCache *tile_cache,
+		uint32_t tile_cache_version,
+		unsigned int lod_index
+) {
+	static thread_local StdVector<Vector3f> tls_tile_normals;
+	tls_tile_normals.clear();
+	tls_tile_normals.resize(math::squared(tile_resolution));
+
+	// Compute normals from SDF results
+	{
+		ZN_PROFILE_SCOPE_NAMED("Compute normals");
+
+		for (const PixelSamples &pixel : pixels) {
+			// TODO I wish this was solved https://github.com/godotengine/godot/issues/31608
+#ifdef DEBUG_ENABLED
+			ZN_ASSERT(pixel.i000 < sdf.size());
+			ZN_ASSERT(pixel.i100 < sdf.size());
+			ZN_ASSERT(pixel.i010 < sdf.size());
+			ZN_ASSERT(pixel.i001 < sdf.size());
+#endif
+			const float sd000 = sdf[pixel.i000];
+			const float sd100 = sdf[pixel.i100];
+			const float sd010 = sdf[pixel.i010];
+			const float sd001 = sdf[pixel.i001];
+
+			Vector3f normal = math::normalized(Vector3f(sd100 - sd000, sd010 - sd000, sd001 - sd000));
+
+			// Clamp normals if their dot product with triangle normal is higher than a threshold.
+			// This helps avoiding flipped normals on very low LODs because bias is very high. In the
+			// SolarSystem demo it can pick up caves from the surface which results in black spots.
+			const Vector3f &tri_normal = tile.triangle_normals[pixel.triangle_index];
+			const float tdot = math::dot(normal, tri_normal);
+			if (tdot < max_deviation_cosine) {
+				if (tdot < -0.999) {
+					normal = tri_normal;
+				} else {
+					const Vector3f axis = math::normalized(math::cross(tri_normal, normal));
+					normal = math::rotated(tri_normal, axis, max_deviation_cosine, max_deviation_sine);
+				}
+			}
+
+#ifdef DEBUG_ENABLED
+			ZN_ASSERT(pixel.normal_index < tls_tile_normals.size());
+#endif
+			tls_tile_normals[pixel.normal_index] = normal;
+		}
+	}
+
+	for (unsigned int dilation_steps = 0; dilation_steps < 2; ++dilation_steps) {
+		// Fill up some pixels around triangle borders, to give some margin when sampling near them in shader
+		dilate_normalmap(to_span(tls_tile_normals), Vector2i(tile_resolution, tile_resolution));
+	}
+
+	const unsigned int encoded_normal_size = octahedral_encoding ? 2 : 3;
+	const unsigned int tile_begin = tile.normals_begin;
+
+	// Encode normals
+	if (octahedral_encoding) {
+		for (unsigned int i = 0; i < tls_tile_normals.size(); ++i) {
+			const unsigned int offset = tile_begin + i * encoded_normal_size;
+			ZN_ASSERT(offset + encoded_normal_size <= normal_map_data.normals.size());
+			const Vector2f n = encode_normal_octahedron(tls_tile_normals[i]);
+			normal_map_data.normals[offset + 0] = unorm_to_u8(n.x);
+			normal_map_data.normals[offset + 1] = unorm_to_u8(n.y);
+		}
+	} else {
+		for (unsigned int i = 0; i < tls_tile_normals.size(); ++i) {
+			const unsigned int offset = tile_begin + i * encoded_normal_size; //
+			ZN_ASSERT(offset + encoded_normal_size <= normal_map_data.normals.size());
+			const Vector3f n = encode_normal_xyz(tls_tile_normals[i]);
+			normal_map_data.normals[offset + 0] = unorm_to_u8(n.x);
+			normal_map_data.normals[offset + 1] = unorm_to_u8(n.y);
+			normal_map_data.normals[offset + 2] = unorm_to_u8(n.z);
+		}
+	}
+
+	if (tile.use_tile_cache) {
+		tile_cache->store_tile(
+				tile.cell_position_in_lod,
+				lod_index,
+				tile.tile_source_hash,
+				tile_cache_version,
+				to_span_from_position_and_size(
+						normal_map_data.normals, tile_begin, math::squared(tile_resolution) * encoded_normal_size
+				)
+		);
+	}
+}
+
 // For each non-empty cell of the mesh, choose an axis-aligned projection based on triangle normals in the cell.
 // Sample voxels inside the cell to compute a tile of world space normals from the SDF.
 void compute_detail_texture_data(
@@ -409,7 +737,8 @@ void compute_detail_texture_data(
 		unsigned int lod_index,
 		bool octahedral_encoding,
 		float max_deviation_radians,
-		bool edited_tiles_only
+		bool edited_tiles_only,
+		DetailTextureTileCache *tile_cache
 ) {
 	ZN_PROFILE_SCOPE();
 
@@ -439,8 +768,66 @@ void compute_detail_texture_data(
 		}
 	}
 
+	// Obtained before sampling anything, so tiles don't get cached if sources change in the meantime
+	const uint32_t tile_cache_version = tile_cache != nullptr ? tile_cache->get_version() : 0;
+
 	uint32_t skipped_count_due_to_high_volume = 0;
 
+	const VoxelModifierStack *modifiers = voxel_data != nullptr ? &voxel_data->get_modifiers() : nullptr;
+
+	// Samples of tiles without edits, queried with a single call for many tiles
+	static thread_local NormalSampleBuffers tls_batch_samples;
+	static thread_local StdVector<PixelSamples> tls_batch_pixels;
+	static thread_local StdVector<PendingTile> tls_batch_tiles;
+	tls_batch_samples.clear();
+	tls_batch_pixels.clear();
+	tls_batch_tiles.clear();
+
+	auto flush_batch = [&]() {
+		if (tls_batch_tiles.size() == 0) {
+			return;
+		}
+
+		tls_batch_samples.sdf.resize(tls_batch_samples.size());
+		if (tls_batch_samples.size() > 0) {
+			query_sdf(
+					generator,
+					nullptr,
+					modifiers,
+					to_span(tls_batch_samples.x),
+					to_span(tls_batch_samples.y),
+					to_span(tls_batch_samples.z),
+					to_span(tls_batch_samples.sdf),
+					tls_batch_samples.min_pos,
+					tls_batch_samples.max_pos
+			);
+		}
+
+		for (const PendingTile &pending_tile : tls_batch_tiles) {
+			finish_tile(
+					pending_tile,
+					to_span_from_position_and_size(
+							tls_batch_pixels,
+							pending_tile.pixels_begin,
+							pending_tile.pixels_end - pending_tile.pixels_begin
+					),
+					to_span(tls_batch_samples.sdf),
+					tile_resolution,
+					octahedral_encoding,
+					max_deviation_cosine,
+					max_deviation_sine,
+					normal_map_data,
+					tile_cache,
+					tile_cache_version,
+					lod_index
+			);
+		}
+
+		tls_batch_samples.clear();
+		tls_batch_pixels.clear();
+		tls_batch_tiles.clear();
+	};
+
 	CurrentCellInfo cell_info;
 	for (unsigned int cell_index = 0; cell_iterator.next(cell_info); ++cell_index) {
 		// Re-use memory because it will be used a lot
@@ -466,6 +853,27 @@ void compute_detail_texture_data(
 		const DetailTextureData::Tile tile = compute_tile_info(cell_info, mesh_normals, mesh_indices);
 		normal_map_data.tiles.push_back(tile);
 
+		// Tiles with edits are not cached, edits can change without changing triangles of the cell
+		const bool use_tile_cache = tile_cache != nullptr && !cell_has_edits;
+		const Vector3i cell_position_in_lod = (origin_in_voxels >> lod_index) + cell_info.position;
+		uint64_t tile_source_hash = 0;
+		if (use_tile_cache) {
+			tile_source_hash = get_tile_source_hash(
+					cell_info,
+					mesh_vertices,
+					mesh_normals,
+					mesh_indices,
+					to_vec3f(cell_info.position * cell_size),
+					tile_resolution,
+					octahedral_encoding,
+					max_deviation_radians,
+					generator
+			);
+			if (tile_cache->try_get_tile(cell_position_in_lod, lod_index, tile_source_hash, normal_map_data.normals)) {
+				continue;
+			}
+		}
+
 		unsigned int ax;
 		unsigned int ay;
 		unsigned int az;
@@ -477,33 +885,10 @@ void compute_detail_texture_data(
 		Vector3f direction;
 		direction[az] = 1.f;
 
-		static thread_local StdVector<Vector2i> tls_tile_sample_positions;
-		tls_tile_sample_positions.clear();
-		tls_tile_sample_positions.reserve(math::squared(tile_resolution));
-
-		static thread_local StdVector<uint8_t> tls_tile_sample_triangle_index;
-		tls_tile_sample_triangle_index.clear();
-		tls_tile_sample_triangle_index.reserve(math::squared(tile_resolution));
-
-		// Each normal needs 4 samples:
-		// (x,   y,   z  )
-		// (x+s, y,   z  )
-		// (x,   y+s, z  )
-		// (x,   y,   z+s)
-		const unsigned int max_buffer_size = math::squared(tile_resolution) * 4;
-
-		static thread_local StdVector<float> tls_sdf_buffer;
-		static thread_local StdVector<float> tls_x_buffer;
-		static thread_local StdVector<float> tls_y_buffer;
-		static thread_local StdVector<float> tls_z_buffer;
-		tls_sdf_buffer.clear();
-		tls_x_buffer.clear();
-		tls_y_buffer.clear();
-		tls_z_buffer.clear();
-		tls_sdf_buffer.reserve(max_buffer_size);
-		tls_x_buffer.reserve(max_buffer_size);
-		tls_y_buffer.reserve(max_buffer_size);
-		tls_z_buffer.reserve(max_buffer_size);
+		PendingTile pending_tile;
+		pending_tile.use_tile_cache = use_tile_cache;
+		pending_tile.cell_position_in_lod = cell_position_in_lod;
+		pending_tile.tile_source_hash = tile_source_hash;
 
 		// Optimize triangles
 		CellTriangles baked_triangles;
@@ -511,181 +896,101 @@ void compute_detail_texture_data(
 				prepare_triangles(cell_info, direction, baked_triangles, mesh_vertices, mesh_indices);
 
 		// Compute triangle normals
-		FixedArray<Vector3f, CurrentCellInfo::MAX_TRIANGLES> triangle_normals;
 		for (unsigned int i = 0; i < triangle_count; ++i) {
 			const math::BakedIntersectionTriangleForFixedDirection &tri = baked_triangles[i];
 			const Vector3f tri_normal = math::normalized(math::cross(tri.e2, tri.e1));
-			triangle_normals[i] = tri_normal;
+			pending_tile.triangle_normals[i] = tri_normal;
 		}
 
-		// Fill query buffers
-		{
-			ZN_PROFILE_SCOPE_NAMED("Compute positions");
-			for (unsigned int yi = 0; yi < tile_resolution; ++yi) {
-				for (unsigned int xi = 0; xi < tile_resolution; ++xi) {
-					// TODO Add bias to center differences when calculating the normals?
-					Vector3f pos000 = quad_origin_world;
-					// Casting to `int` here because even if the target is float, temporaries can be negative uints
-					pos000[ax] += int(xi) * step;
-					pos000[ay] += int(yi) * step;
-
-					// Project to triangles
-					const Vector3f ray_origin_world = pos000 - direction * cell_size;
-					const Vector3f ray_origin_mesh = ray_origin_world - to_vec3f(origin_in_voxels);
-					float nearest_hit_distance = 999999.f;
-					unsigned int hit_triangle_index = triangle_count;
-					for (unsigned int ti = 0; ti < triangle_count; ++ti) {
-						const math::TriangleIntersectionResult result =
-								baked_triangles[ti].intersect(ray_origin_mesh, direction);
-						if (result.case_id == math::TriangleIntersectionResult::INTERSECTION &&
-							result.distance < nearest_hit_distance) {
-							nearest_hit_distance = result.distance;
-							hit_triangle_index = ti;
-						}
-					}
+		// Reserve the tile in the normalmap, since tiles don't get finished in order. Resizing as we go, because
+		// depending on settings we may have to skip some cells.
+		pending_tile.normals_begin = normal_map_data.normals.size();
+		normal_map_data.normals.resize(
+				normal_map_data.normals.size() + math::squared(tile_resolution) * encoded_normal_size
+		);
 
-					if (hit_triangle_index == triangle_count) {
-						// Don't query if there is no triangle
-						continue;
-					}
+		if (cell_has_edits) {
+			// Edits are only gathered for the current cell, so its samples are queried right away
+			static thread_local NormalSampleBuffers tls_edited_samples;
+			static thread_local StdVector<PixelSamples> tls_edited_pixels;
+			tls_edited_samples.clear();
+			tls_edited_pixels.clear();
+
+			gather_tile_samples(
+					baked_triangles,
+					triangle_count,
+					quad_origin_world,
+					to_vec3f(origin_in_voxels),
+					ax,
+					ay,
+					az,
+					step,
+					cell_size,
+					tile_resolution,
+					tls_edited_samples,
+					tls_edited_pixels
+			);
 
-					pos000 = ray_origin_world + direction * nearest_hit_distance;
-					tls_tile_sample_positions.push_back(Vector2i(xi, yi));
-					tls_tile_sample_triangle_index.push_back(hit_triangle_index);
-
-					tls_x_buffer.push_back(pos000.x);
-					tls_y_buffer.push_back(pos000.y);
-					tls_z_buffer.push_back(pos000.z);
-
-					Vector3f pos100 = pos000;
-					pos100.x += step;
-					tls_x_buffer.push_back(pos100.x);
-					tls_y_buffer.push_back(pos100.y);
-					tls_z_buffer.push_back(pos100.z);
-
-					Vector3f pos010 = pos000;
-					pos010.y += step;
-					tls_x_buffer.push_back(pos010.x);
-					tls_y_buffer.push_back(pos010.y);
-					tls_z_buffer.push_back(pos010.z);
-
-					Vector3f pos001 = pos000;
-					pos001.z += step;
-					tls_x_buffer.push_back(pos001.x);
-					tls_y_buffer.push_back(pos001.y);
-					tls_z_buffer.push_back(pos001.z);
-				}
+			tls_edited_samples.sdf.resize(tls_edited_samples.size());
+			if (tls_edited_samples.size() > 0) {
+				query_sdf(
+						generator,
+						&tls_voxel_data_grid,
+						modifiers,
+						to_span(tls_edited_samples.x),
+						to_span(tls_edited_samples.y),
+						to_span(tls_edited_samples.z),
+						to_span(tls_edited_samples.sdf),
+						tls_edited_samples.min_pos,
+						tls_edited_samples.max_pos
+				);
 			}
-		}
-
-		tls_sdf_buffer.resize(tls_x_buffer.size());
-
-		{
-			const VoxelDataGrid *edits_grid = cell_has_edits ? &tls_voxel_data_grid : nullptr;
-			const VoxelModifierStack *modifiers = voxel_data != nullptr ? &voxel_data->get_modifiers() : nullptr;
 
-			// Query voxel data
-			query_sdf(
-					generator,
-					edits_grid,
-					modifiers,
-					to_span(tls_x_buffer),
-					to_span(tls_y_buffer),
-					to_span(tls_z_buffer),
-					to_span(tls_sdf_buffer),
-					cell_origin_world,
-					cell_origin_world + Vector3f(cell_size)
+			pending_tile.pixels_begin = 0;
+			pending_tile.pixels_end = tls_edited_pixels.size();
+			finish_tile(
+					pending_tile,
+					to_span(tls_edited_pixels),
+					to_span(tls_edited_samples.sdf),
+					tile_resolution,
+					octahedral_encoding,
+					max_deviation_cosine,
+					max_deviation_sine,
+					normal_map_data,
+					tile_cache,
+					tile_cache_version,
+					lod_index
 			);
-		}
-
-		static thread_local StdVector<Vector3f> tls_tile_normals;
-		tls_tile_normals.clear();
-		tls_tile_normals.resize(math::squared(tile_resolution));
 
-		// Compute normals from SDF results
-		{
-			ZN_PROFILE_SCOPE_NAMED("Compute normals");
-			ZN_ASSERT(tls_tile_sample_positions.size() == tls_tile_sample_triangle_index.size());
-
-			unsigned int bi = 0;
-
-			for (unsigned int si = 0; si < tls_tile_sample_positions.size(); ++si) {
-				const Vector2i sample_position = tls_tile_sample_positions[si];
-				const uint8_t sample_tri_index = tls_tile_sample_triangle_index[si];
-
-				const unsigned int bi000 = bi;
-				const unsigned int bi100 = bi + 1;
-				const unsigned int bi010 = bi + 2;
-				const unsigned int bi001 = bi + 3;
-				bi += 4;
-				// TODO I wish this was solved https://github.com/godotengine/godot/issues/31608
-#ifdef DEBUG_ENABLED
-				ZN_ASSERT(bi000 < tls_sdf_buffer.size());
-				ZN_ASSERT(bi100 < tls_sdf_buffer.size());
-				ZN_ASSERT(bi010 < tls_sdf_buffer.size());
-				ZN_ASSERT(bi001 < tls_sdf_buffer.size());
-#endif
-				const float sd000 = tls_sdf_buffer[bi000];
-				const float sd100 = tls_sdf_buffer[bi100];
-				const float sd010 = tls_sdf_buffer[bi010];
-				const float sd001 = tls_sdf_buffer[bi001];
-
-				Vector3f normal = math::normalized(Vector3f(sd100 - sd000, sd010 - sd000, sd001 - sd000));
-
-				// Clamp normals if their dot product with triangle normal is higher than a threshold.
-				// This helps avoiding flipped normals on very low LODs because bias is very high. In the
-				// SolarSystem demo it can pick up caves from the surface which results in black spots.
-				const Vector3f &tri_normal = triangle_normals[sample_tri_index];
-				const float tdot = math::dot(normal, tri_normal);
-				if (tdot < max_deviation_cosine) {
-					if (tdot < -0.999) {
-						normal = tri_normal;
-					} else {
-						const Vector3f axis = math::normalized(math::cross(tri_normal, normal));
-						normal = math::rotated(tri_normal, axis, max_deviation_cosine, max_deviation_sine);
-					}
-				}
-
-				const unsigned int normal_index = sample_position.x + sample_position.y * tile_resolution;
-#ifdef DEBUG_ENABLED
-				ZN_ASSERT(normal_index < tls_tile_normals.size());
-#endif
-				tls_tile_normals[normal_index] = normal;
-			}
-		}
-
-		for (unsigned int dilation_steps = 0; dilation_steps < 2; ++dilation_steps) {
-			// Fill up some pixels around triangle borders, to give some margin when sampling near them in shader
-			dilate_normalmap(to_span(tls_tile_normals), Vector2i(tile_resolution, tile_resolution));
-		}
+		} else {
+			pending_tile.pixels_begin = tls_batch_pixels.size();
+
+			gather_tile_samples(
+					baked_triangles,
+					triangle_count,
+					quad_origin_world,
+					to_vec3f(origin_in_voxels),
+					ax,
+					ay,
+					az,
+					step,
+					cell_size,
+					tile_resolution,
+					tls_batch_samples,
+					tls_batch_pixels
+			);
 
-		// Resizing as we go, because depending on settings we may have to skip some cells
-		const unsigned int tile_begin = normal_map_data.normals.size();
-		normal_map_data.normals.resize(
-				normal_map_data.normals.size() + math::squared(tile_resolution) * encoded_normal_size
-		);
+			pending_tile.pixels_end = tls_batch_pixels.size();
+			tls_batch_tiles.push_back(pending_tile);
 
-		// Encode normals
-		if (octahedral_encoding) {
-			for (unsigned int i = 0; i < tls_tile_normals.size(); ++i) {
-				const unsigned int offset = tile_begin + i * encoded_normal_size;
-				ZN_ASSERT(offset + encoded_normal_size <= normal_map_data.normals.size());
-				const Vector2f n = encode_normal_octahedron(tls_tile_normals[i]);
-				normal_map_data.normals[offset + 0] = unorm_to_u8(n.x);
-				normal_map_data.normals[offset + 1] = unorm_to_u8(n.y);
-			}
-		} else {
-			for (unsigned int i = 0; i < tls_tile_normals.size(); ++i) {
-				const unsigned int offset = tile_begin + i * encoded_normal_size; //
-				ZN_ASSERT(offset + encoded_normal_size <= normal_map_data.normals.size());
-				const Vector3f n = encode_normal_xyz(tls_tile_normals[i]);
-				normal_map_data.normals[offset + 0] = unorm_to_u8(n.x);
-				normal_map_data.normals[offset + 1] = unorm_to_u8(n.y);
-				normal_map_data.normals[offset + 2] = unorm_to_u8(n.z);
+			if (tls_batch_samples.size() >= MAX_NORMAL_SAMPLE_BATCH_SIZE) {
+				flush_batch();
 			}
 		}
 	}
 
+	flush_batch();
+
 	if (skipped_count_due_to_high_volume > 0) {
 		// Logging here to reduce spam
 		ZN_PRINT_VERBOSE(format(
@@ -736,13 +1041,101 @@ Ref<Image> store_lookup_to_image(const StdVector<DetailTextureData::Tile> &tiles
 	return image;
 }
 
+namespace {
+
+// Encodes 16 values into a BC4 block, using the 8-values mode with the min and max as endpoints. It is not the most
+// accurate choice of endpoints, but it is fast and good enough for smooth data such as normals.
+void encode_bc4_block(const FixedArray<uint8_t, 16> &values, uint8_t *dst) {
+	uint8_t min_value = values[0];
+	uint8_t max_value = values[0];
+	for (const uint8_t v : values) {
+		min_value = math::min(min_value, v);
+		max_value = math::max(max_value, v);
+	}
+
+	dst[0] = max_value;
+	dst[1] = min_value;
+
+	uint64_t indices = 0;
+	const unsigned int range = max_value - min_value;
+	if (range != 0) {
+		for (unsigned int i = 0; i < values.size(); ++i) {
+			// Position of the value between min and max, in 7 steps
+			const unsigned int step = ((values[i] - min_value) * 14 + range) / (2 * range);
+			// Index 0 is the max endpoint, index 1 is the min endpoint, and indices 2 to 7 are interpolated from max
+			// to min
+			const uint64_t index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+			indices |= index << (i * 3);
+		}
+	}
+
+	for (unsigned int i = 0; i < 6; ++i) {
+		dst[2 + i] = (indices >> (i * 8)) & 0xff;
+	}
+}
+
+} // namespace
+
+void compress_rg8_to_bc5(Span<const uint8_t> src, Vector2i size, Span<uint8_t> dst) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(size.x >= 0 && size.y >= 0);
+	ZN_ASSERT_RETURN((size.x % 4) == 0 && (size.y % 4) == 0);
+	ZN_ASSERT_RETURN(src.size() == static_cast<size_t>(size.x * size.y * 2));
+	ZN_ASSERT_RETURN(dst.size() == static_cast<size_t>(size.x * size.y));
+
+	FixedArray<uint8_t, 16> red;
+	FixedArray<uint8_t, 16> green;
+	uint8_t *dst_p = dst.data();
+
+	for (int block_y = 0; block_y < size.y; block_y += 4) {
+		for (int block_x = 0; block_x < size.x; block_x += 4) {
+			for (unsigned int y = 0; y < 4; ++y) {
+				const uint8_t *src_row = src.data() + ((block_y + y) * size.x + block_x) * 2;
+				for (unsigned int x = 0; x < 4; ++x) {
+					red[y * 4 + x] = src_row[x * 2];
+					green[y * 4 + x] = src_row[x * 2 + 1];
+				}
+			}
+			encode_bc4_block(red, dst_p);
+			encode_bc4_block(green, dst_p + 8);
+			dst_p += 16;
+		}
+	}
+}
+
+namespace {
+
+Ref<Image> create_atlas_image(
+		unsigned int width,
+		unsigned int height,
+		Image::Format format,
+		const PackedByteArray &bytes,
+		bool bc5_compression
+) {
+	if (bc5_compression) {
+		ZN_ASSERT_RETURN_V(format == Image::FORMAT_RG8, Ref<Image>());
+		PackedByteArray compressed_bytes;
+		compressed_bytes.resize(width * height);
+		compress_rg8_to_bc5(
+				Span<const uint8_t>(bytes.ptr(), bytes.size()),
+				Vector2i(width, height),
+				Span<uint8_t>(compressed_bytes.ptrw(), compressed_bytes.size())
+		);
+		return Image::create_from_data(width, height, false, Image::FORMAT_RGTC_RG, compressed_bytes);
+	}
+	return Image::create_from_data(width, height, false, format, bytes);
+}
+
+} // namespace
+
 #ifdef VOXEL_VIRTUAL_TEXTURE_USE_TEXTURE_ARRAY
 
 Vector<Ref<Image>> store_atlas_to_image_array(
 		const StdVector<uint8_t> &normals,
 		unsigned int tile_resolution,
 		unsigned int tile_count,
-		bool octahedral_encoding
+		bool octahedral_encoding,
+		bool bc5_compression
 ) {
 	ZN_PROFILE_SCOPE();
 
@@ -761,7 +1154,7 @@ Vector<Ref<Image>> store_atlas_to_image_array(
 			memcpy(bytes.ptrw(), normals.data() + tile_index * tile_size_in_bytes, tile_size_in_bytes);
 		}
 
-		Ref<Image> image = Image::create_from_data(tile_resolution, tile_resolution, false, format, bytes);
+		Ref<Image> image = create_atlas_image(tile_resolution, tile_resolution, format, bytes, bc5_compression);
 
 		tile_images.write[tile_index] = image;
 		// image->save_png(String("debug_atlas_{0}.png").format(varray(tile_index)));
@@ -776,7 +1169,8 @@ Ref<Image> store_atlas_to_image(
 		const StdVector<uint8_t> &normals,
 		unsigned int tile_resolution,
 		unsigned int tile_count,
-		bool octahedral_encoding
+		bool octahedral_encoding,
+		bool bc5_compression
 ) {
 	ZN_PROFILE_SCOPE();
 
@@ -807,7 +1201,7 @@ Ref<Image> store_atlas_to_image(
 		);
 	}
 
-	Ref<Image> atlas = Image::create_from_data(pixels_across, pixels_across, false, format, bytes);
+	Ref<Image> atlas = create_atlas_image(pixels_across, pixels_across, format, bytes, bc5_compression);
 	return atlas;
 }
 
@@ -815,15 +1209,23 @@ DetailImages store_normalmap_data_to_images(
 		const DetailTextureData &data,
 		unsigned int tile_resolution,
 		Vector3i block_size,
-		bool octahedral_encoding
+		bool octahedral_encoding,
+		bool bc5_compression
 ) {
 	ZN_PROFILE_SCOPE();
 
+	bc5_compression =
+			is_detail_texture_bc5_compression_applicable(octahedral_encoding, bc5_compression, tile_resolution);
+
 	DetailImages images;
 #ifdef VOXEL_VIRTUAL_TEXTURE_USE_TEXTURE_ARRAY
-	images.atlas = store_atlas_to_image_array(data.normals, tile_resolution, data.tiles.size(), octahedral_encoding);
+	images.atlas = store_atlas_to_image_array(
+			data.normals, tile_resolution, data.tiles.size(), octahedral_encoding, bc5_compression
+	);
 #else
-	images.atlas = store_atlas_to_image(data.normals, tile_resolution, data.tiles.size(), octahedral_encoding);
+	images.atlas = store_atlas_to_image(
+			data.normals, tile_resolution, data.tiles.size(), octahedral_encoding, bc5_compression
+	);
 #endif
 	images.lookup = store_lookup_to_image(data.tiles, block_size);
 	return images;
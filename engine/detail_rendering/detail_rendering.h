@@ -21,6 +21,7 @@ namespace zylann::voxel {
 
 class VoxelGenerator;
 class VoxelData;
+class DetailTextureTileCache;
 
 // TODO This system could be extended to more than just normals
 // - Texturing data
@@ -47,6 +48,9 @@ struct DetailRenderingSettings {
 	// If enabled, encodes normalmaps using octahedral compression, which trades a bit of quality for
 	// significantly reduced memory usage (using 2 bytes per pixel instead of 3).
 	bool octahedral_encoding_enabled = false;
+	// If enabled along with octahedral encoding, atlases are block-compressed to the BC5 format, halving their size
+	// again. Only applies to tile resolutions multiple of 4, so that compressed blocks don't straddle tiles.
+	bool bc5_compression_enabled = false;
 
 	static constexpr uint8_t MIN_DEVIATION_DEGREES = 1;
 	static constexpr uint8_t MAX_DEVIATION_DEGREES = 179;
@@ -99,6 +103,8 @@ public:
 // If the angle between the triangle and the computed normal is larger than `max_deviation_radians`,
 // the normal's direction will be clamped.
 // If `out_edited_tiles` is provided, only tiles containing edited voxels will be processed.
+// If `tile_cache` is provided, tiles without edits are reused from it when their sources did not change, and stored
+// into it otherwise.
 void compute_detail_texture_data(
 		ICellIterator &cell_iterator,
 		Span<const Vector3f> mesh_vertices,
@@ -113,7 +119,8 @@ void compute_detail_texture_data(
 		unsigned int lod_index,
 		bool octahedral_encoding,
 		float max_deviation_radians,
-		bool edited_tiles_only
+		bool edited_tiles_only,
+		DetailTextureTileCache *tile_cache
 );
 
 struct DetailImages {
@@ -136,11 +143,25 @@ struct DetailTextures {
 
 Ref<Image> store_lookup_to_image(const StdVector<DetailTextureData::Tile> &tiles, Vector3i block_size);
 
+// Tells if atlases of the given tile resolution will be compressed to BC5 with the given settings.
+inline bool is_detail_texture_bc5_compression_applicable(
+		bool octahedral_encoding,
+		bool bc5_compression,
+		unsigned int tile_resolution
+) {
+	return octahedral_encoding && bc5_compression && (tile_resolution % 4) == 0;
+}
+
+// Compresses RG8 pixels into BC5 blocks (one BC4 block per channel for each 4x4 pixels), laid out like Godot's
+// `Image::FORMAT_RGTC_RG`. Width and height must be multiples of 4. The destination takes 1 byte per pixel.
+void compress_rg8_to_bc5(Span<const uint8_t> src, Vector2i size, Span<uint8_t> dst);
+
 DetailImages store_normalmap_data_to_images(
 		const DetailTextureData &data,
 		unsigned int tile_resolution,
 		Vector3i block_size,
-		bool octahedral_encoding
+		bool octahedral_encoding,
+		bool bc5_compression
 );
 
 // Converts normalmap data into textures. They can be used in a shader to apply normals and obtain extra visual details.
@@ -0,0 +1,92 @@
+#include "detail_texture_tile_cache.h"
+#include "../../util/profiling.h"
+
+namespace zylann::voxel {
+
+uint32_t DetailTextureTileCache::get_version() const {
+	MutexLock mlock(_mutex);
+	return _version;
+}
+
+bool DetailTextureTileCache::try_get_tile(
+		Vector3i cell_position,
+		unsigned int lod_index,
+		uint64_t source_hash,
+		StdVector<uint8_t> &out_normals
+) const {
+	ZN_ASSERT_RETURN_V(lod_index < _lods.size(), false);
+	MutexLock mlock(_mutex);
+	const StdUnorderedMap<Vector3i, CachedTile> &tiles = _lods[lod_index];
+	auto it = tiles.find(cell_position);
+	if (it == tiles.end()) {
+		return false;
+	}
+	const CachedTile &cached_tile = it->second;
+	if (cached_tile.source_hash != source_hash) {
+		return false;
+	}
+	out_normals.insert(out_normals.end(), cached_tile.normals.begin(), cached_tile.normals.end());
+	return true;
+}
+
+void DetailTextureTileCache::store_tile(
+		Vector3i cell_position,
+		unsigned int lod_index,
+		uint64_t source_hash,
+		uint32_t version,
+		Span<const uint8_t> normals
+) {
+	ZN_ASSERT_RETURN(lod_index < _lods.size());
+	MutexLock mlock(_mutex);
+	if (version != _version) {
+		// Sources changed while the tile was rendering
+		return;
+	}
+
+	CachedTile &cached_tile = _lods[lod_index][cell_position];
+	_memory_usage -= cached_tile.normals.size();
+	cached_tile.source_hash = source_hash;
+	cached_tile.normals.assign(normals.data(), normals.data() + normals.size());
+	_memory_usage += cached_tile.normals.size();
+
+	if (_memory_usage > MAX_MEMORY_USAGE) {
+		for (StdUnorderedMap<Vector3i, CachedTile> &tiles : _lods) {
+			tiles.clear();
+		}
+		_memory_usage = 0;
+	}
+}
+
+void DetailTextureTileCache::invalidate_area(Box3i voxel_box) {
+	ZN_PROFILE_SCOPE();
+	MutexLock mlock(_mutex);
+	++_version;
+
+	for (unsigned int lod_index = 0; lod_index < _lods.size(); ++lod_index) {
+		StdUnorderedMap<Vector3i, CachedTile> &tiles = _lods[lod_index];
+		if (tiles.size() == 0) {
+			continue;
+		}
+		// Tiles sample a bit beyond their cell
+		const Box3i cells_box = voxel_box.padded(1).downscaled(1 << lod_index);
+		for (auto it = tiles.begin(); it != tiles.end();) {
+			if (cells_box.contains(Box3i(it->first, Vector3i(1, 1, 1)))) {
+				_memory_usage -= it->second.normals.size();
+				it = tiles.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+}
+
+void DetailTextureTileCache::clear() {
+	MutexLock mlock(_mutex);
+	++_version;
+	for (StdUnorderedMap<Vector3i, CachedTile> &tiles : _lods) {
+		tiles.clear();
+	}
+	_memory_usage = 0;
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,67 @@
+#ifndef VOXEL_DETAIL_TEXTURE_TILE_CACHE_H
+#define VOXEL_DETAIL_TEXTURE_TILE_CACHE_H
+
+#include "../../constants/voxel_constants.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/box3i.h"
+#include "../../util/thread/mutex.h"
+
+namespace zylann::voxel {
+
+// Keeps detail texture tiles rendered previously, so they can be reused when a mesh block is remeshed while some of its
+// cells did not change. This happens after edits, which remesh whole blocks while only touching a few of their cells,
+// and when transition masks change.
+// A tile is only reused if it was rendered from the same triangles with the same settings, and if the generator and
+// modifiers did not change in its area since then. Tiles containing edited voxels are never cached.
+class DetailTextureTileCache {
+public:
+	// Incremented every time cached tiles get invalidated. Tasks must get it before rendering tiles, and pass it when
+	// storing them, so tiles rendered from outdated sources are dropped.
+	uint32_t get_version() const;
+
+	// Gets encoded normals of a tile previously rendered at the given position from the same sources. They are
+	// appended to `out_normals`.
+	bool try_get_tile(
+			Vector3i cell_position,
+			unsigned int lod_index,
+			uint64_t source_hash,
+			StdVector<uint8_t> &out_normals
+	) const;
+
+	void store_tile(
+			Vector3i cell_position,
+			unsigned int lod_index,
+			uint64_t source_hash,
+			uint32_t version,
+			Span<const uint8_t> normals
+	);
+
+	// Removes tiles touching an area where the generator or modifiers changed
+	void invalidate_area(Box3i voxel_box);
+
+	// Removes all tiles, when the generator or settings change
+	void clear();
+
+private:
+	struct CachedTile {
+		uint64_t source_hash;
+		StdVector<uint8_t> normals;
+	};
+
+	// When exceeded, all tiles are dropped. Tiles are small and cheap to render again, so this is simpler than tracking
+	// which ones were used least recently.
+	static constexpr size_t MAX_MEMORY_USAGE = 32 * 1024 * 1024;
+
+	// Indexed by LOD, then by cell position in cells of that LOD
+	FixedArray<StdUnorderedMap<Vector3i, CachedTile>, constants::MAX_LOD> _lods;
+	size_t _memory_usage = 0;
+	uint32_t _version = 0;
+	mutable Mutex _mutex;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_DETAIL_TEXTURE_TILE_CACHE_H
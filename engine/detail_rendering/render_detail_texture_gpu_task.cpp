@@ -19,13 +19,60 @@ using namespace zylann::godot;
 
 namespace zylann::voxel {
 
+const void *RenderDetailTextureGPUTask::get_batch_key() const {
+	return shader.get();
+}
+
+bool RenderDetailTextureGPUTask::can_batch_with(const IGPUTask &other) const {
+	// It has the same batch key, so it is the same type of task
+	const RenderDetailTextureGPUTask &other_task = static_cast<const RenderDetailTextureGPUTask &>(other);
+
+	if (other_task.shader != shader || other_task.shader_params != shader_params) {
+		return false;
+	}
+
+	// Tiles of all blocks are laid out in the same atlas and processed by the same dispatches. Blocks of different LODs
+	// can be batched as long as their tiles have the same resolution.
+	if (other_task.params.tile_size_pixels != params.tile_size_pixels ||
+		other_task.params.max_deviation_cosine != params.max_deviation_cosine ||
+		other_task.params.max_deviation_sine != params.max_deviation_sine) {
+		return false;
+	}
+
+	// Modifiers are dispatched on all tiles of the batch, so they must be the same
+	if (other_task.modifiers.size() != modifiers.size()) {
+		return false;
+	}
+	for (unsigned int i = 0; i < modifiers.size(); ++i) {
+		const ModifierData &a = modifiers[i];
+		const ModifierData &b = other_task.modifiers[i];
+		if (a.shader_rid != b.shader_rid || a.params != b.params) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
+	IGPUTask *task = this;
+	prepare_batch(
+			ctx, Span<IGPUTask *const>(&task, 1), Span<const unsigned int>(&ctx.shared_output_buffer_begin, 1)
+	);
+}
+
+void RenderDetailTextureGPUTask::prepare_batch(
+		GPUTaskContext &ctx,
+		Span<IGPUTask *const> tasks,
+		Span<const unsigned int> output_buffer_begins
+) {
 	ZN_PROFILE_SCOPE();
 	ZN_DSTACK();
 
-	ERR_FAIL_COND(mesh_vertices.size() == 0);
-	ERR_FAIL_COND(mesh_indices.size() == 0);
-	ERR_FAIL_COND(cell_triangles.size() == 0);
+	ZN_ASSERT_RETURN(tasks.size() > 0);
+	ZN_ASSERT_RETURN(tasks[0] == this);
+	// Block indices are stored on 8 bits in tile data
+	ZN_ASSERT_RETURN(tasks.size() <= 256);
 
 	ERR_FAIL_COND(shader == nullptr);
 	ERR_FAIL_COND(!shader->is_valid());
@@ -33,11 +80,103 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 	RenderingDevice &rd = ctx.rendering_device;
 	GPUStorageBufferPool &storage_buffer_pool = ctx.storage_buffer_pool;
 
+	// Layout must match the `Params` buffer of the gather hits shader. With std430, the table of blocks is aligned to
+	// 16 bytes because they contain a `vec3`.
+
+	struct GatherHitsParamsHeader {
+		int32_t tile_size_pixels;
+		int32_t padding[3];
+	};
+
+	struct GatherHitsBlockParams {
+		Vector3f block_origin_world;
+		float pixel_world_step;
+	};
+
+	static_assert(sizeof(GatherHitsParamsHeader) == 16);
+	static_assert(sizeof(GatherHitsBlockParams) == 16);
+
+	// Merge inputs of all tasks into a single table of tiles. Meshes are concatenated, so indices get offset to point
+	// into the merged arrays.
+
+	StdVector<Vector4f> batch_vertices;
+	StdVector<int32_t> batch_indices;
+	StdVector<int32_t> batch_cell_triangles;
+	StdVector<TileData> batch_tiles;
+	StdVector<GatherHitsBlockParams> blocks_params;
+	// Signed distances are sampled with a step that depends on the LOD of each tile
+	StdVector<float> tile_pixel_world_steps;
+
+	_batch_tasks.clear();
+
+	for (unsigned int task_index = 0; task_index < tasks.size(); ++task_index) {
+		RenderDetailTextureGPUTask &task = static_cast<RenderDetailTextureGPUTask &>(*tasks[task_index]);
+
+		ERR_FAIL_COND(task.mesh_vertices.size() == 0);
+		ERR_FAIL_COND(task.mesh_indices.size() == 0);
+		ERR_FAIL_COND(task.cell_triangles.size() == 0);
+
+		const int32_t vertex_base = batch_vertices.size();
+		const int32_t triangle_base = batch_indices.size() / 3;
+		const uint32_t cell_triangles_base = batch_cell_triangles.size();
+
+		batch_vertices.insert(batch_vertices.end(), task.mesh_vertices.begin(), task.mesh_vertices.end());
+
+		for (const int32_t i : task.mesh_indices) {
+			batch_indices.push_back(vertex_base + i);
+		}
+
+		for (const int32_t triangle_index : task.cell_triangles) {
+			batch_cell_triangles.push_back(triangle_base + triangle_index);
+		}
+
+		task._batch_first_tile_index = batch_tiles.size();
+
+		for (const TileData &src_tile : task.tile_data) {
+			TileData tile = src_tile;
+			tile.block_index = task_index;
+			tile.data += cell_triangles_base << 8;
+			batch_tiles.push_back(tile);
+			tile_pixel_world_steps.push_back(task.params.pixel_world_step);
+		}
+
+		blocks_params.push_back(GatherHitsBlockParams{ task.params.block_origin_world, task.params.pixel_world_step });
+
+		_batch_tasks.push_back(&task);
+	}
+
+	// Tile data stores indices into cell triangles on 24 bits
+	ERR_FAIL_COND_MSG(batch_cell_triangles.size() >= (1 << 24), "Too many triangles to render in a single batch");
+
+	const int32_t tile_count = batch_tiles.size();
+
+	// Tiles of all tasks are rendered into the same atlas. A task rendered alone uses its own layout, so the atlas can
+	// be used as-is.
+	unsigned int atlas_tiles_x;
+	unsigned int atlas_width;
+	unsigned int atlas_height;
+	if (tasks.size() == 1) {
+		atlas_tiles_x = params.tiles_x;
+		atlas_width = texture_width;
+		atlas_height = texture_height;
+	} else {
+		atlas_tiles_x = get_square_grid_size_from_item_count(tile_count);
+		atlas_width = atlas_tiles_x * params.tile_size_pixels;
+		atlas_height = math::ceildiv(static_cast<unsigned int>(tile_count), atlas_tiles_x) * params.tile_size_pixels;
+	}
+	// Limit commonly supported by devices
+	ERR_FAIL_COND_MSG(atlas_width > 16384 || atlas_height > 16384, "Detail texture atlas of the batch is too large");
+
+	for (RenderDetailTextureGPUTask *task : _batch_tasks) {
+		task->_batch_atlas_width = atlas_width;
+		task->_batch_atlas_tiles_x = atlas_tiles_x;
+	}
+
 	// Size can vary each time so we have to recreate the format...
 	Ref<RDTextureFormat> texture_format;
 	texture_format.instantiate();
-	texture_format->set_width(texture_width);
-	texture_format->set_height(texture_height);
+	texture_format->set_width(atlas_width);
+	texture_format->set_height(atlas_height);
 	texture_format->set_format(RenderingDevice::DATA_FORMAT_R8G8B8A8_UINT);
 	texture_format->set_usage_bits(
 			RenderingDevice::TEXTURE_USAGE_STORAGE_BIT |
@@ -93,7 +232,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 	// Mesh vertices
 
 	PackedByteArray mesh_vertices_pba;
-	copy_bytes_to<Vector4f>(mesh_vertices_pba, to_span(mesh_vertices));
+	copy_bytes_to<Vector4f>(mesh_vertices_pba, to_span(batch_vertices));
 
 	_mesh_vertices_sb = storage_buffer_pool.allocate(mesh_vertices_pba);
 	ERR_FAIL_COND(_mesh_vertices_sb.is_null());
@@ -106,7 +245,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 	// Mesh indices
 
 	PackedByteArray mesh_indices_pba;
-	copy_bytes_to<int32_t>(mesh_indices_pba, to_span(mesh_indices));
+	copy_bytes_to<int32_t>(mesh_indices_pba, to_span(batch_indices));
 
 	_mesh_indices_sb = storage_buffer_pool.allocate(mesh_indices_pba);
 	ERR_FAIL_COND(_mesh_indices_sb.is_null());
@@ -119,7 +258,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 	// Cell tris
 
 	PackedByteArray cell_triangles_pba;
-	copy_bytes_to<int32_t>(cell_triangles_pba, to_span(cell_triangles));
+	copy_bytes_to<int32_t>(cell_triangles_pba, to_span(batch_cell_triangles));
 
 	_cell_triangles_sb = storage_buffer_pool.allocate(cell_triangles_pba);
 	ERR_FAIL_COND(_cell_triangles_sb.is_null());
@@ -132,7 +271,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 	// Tiles data
 
 	PackedByteArray tile_data_pba;
-	copy_bytes_to<TileData>(tile_data_pba, to_span(tile_data));
+	copy_bytes_to<TileData>(tile_data_pba, to_span(batch_tiles));
 
 	_tile_data_sb = storage_buffer_pool.allocate(tile_data_pba);
 	ERR_FAIL_COND(_tile_data_sb.is_null());
@@ -144,17 +283,23 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 
 	// Gather hits params
 
-	struct GatherHitsParams {
-		Vector3f block_origin_world;
-		float pixel_world_step;
-		int32_t tile_size_pixels;
-	};
-
 	PackedByteArray gather_hits_params_pba;
-	copy_bytes_to(
-			gather_hits_params_pba,
-			GatherHitsParams{ params.block_origin_world, params.pixel_world_step, params.tile_size_pixels }
-	);
+	{
+		GatherHitsParamsHeader header;
+		header.tile_size_pixels = params.tile_size_pixels;
+		header.padding[0] = 0;
+		header.padding[1] = 0;
+		header.padding[2] = 0;
+
+		gather_hits_params_pba.resize(
+				sizeof(GatherHitsParamsHeader) + blocks_params.size() * sizeof(GatherHitsBlockParams)
+		);
+		uint8_t *params_w = gather_hits_params_pba.ptrw();
+		memcpy(params_w, &header, sizeof(GatherHitsParamsHeader));
+		memcpy(params_w + sizeof(GatherHitsParamsHeader),
+			   blocks_params.data(),
+			   blocks_params.size() * sizeof(GatherHitsBlockParams));
+	}
 
 	// TODO Might be better to use a Uniform Buffer for this. They might be faster for small amounts of data, but need
 	// to care more about alignment
@@ -169,7 +314,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 	// Hit buffer
 
 	const unsigned int hit_positions_buffer_size_bytes =
-			tile_data.size() * math::squared(params.tile_size_pixels) * sizeof(float) * 4;
+			tile_count * math::squared(params.tile_size_pixels) * sizeof(float) * 4;
 	_hit_positions_buffer_sb = storage_buffer_pool.allocate(hit_positions_buffer_size_bytes);
 
 	Ref<RDUniform> hit_positions_uniform;
@@ -178,14 +323,19 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 	hit_positions_uniform->add_id(_hit_positions_buffer_sb.rid);
 
 	// Generator params
-
-	struct GeneratorParams {
-		int32_t tile_size_pixels;
-		float pxiel_world_step;
-	};
+	// Layout must match the `Params` buffer of detail generator and modifier shaders: the tile size followed by the
+	// step of each tile.
 
 	PackedByteArray generator_params_pba;
-	copy_bytes_to(generator_params_pba, GeneratorParams{ params.tile_size_pixels, params.pixel_world_step });
+	{
+		const int32_t tile_size_pixels = params.tile_size_pixels;
+		generator_params_pba.resize(sizeof(int32_t) + tile_pixel_world_steps.size() * sizeof(float));
+		uint8_t *params_w = generator_params_pba.ptrw();
+		memcpy(params_w, &tile_size_pixels, sizeof(int32_t));
+		memcpy(params_w + sizeof(int32_t),
+			   tile_pixel_world_steps.data(),
+			   tile_pixel_world_steps.size() * sizeof(float));
+	}
 
 	_generator_params_sb = storage_buffer_pool.allocate(generator_params_pba);
 
@@ -198,7 +348,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 
 	// TODO Maybe using half-precision would work well enough?
 	const unsigned int sd_buffer_size_bytes =
-			tile_data.size() * math::squared(params.tile_size_pixels) * 4 * sizeof(float);
+			tile_count * math::squared(params.tile_size_pixels) * 4 * sizeof(float);
 
 	_sd_buffer0_sb = storage_buffer_pool.allocate(sd_buffer_size_bytes);
 
@@ -229,7 +379,10 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 	copy_bytes_to(
 			normalmap_params_pba,
 			NormalmapParams{
-					params.tile_size_pixels, params.tiles_x, params.max_deviation_cosine, params.max_deviation_sine }
+					params.tile_size_pixels,
+					static_cast<int32_t>(atlas_tiles_x),
+					params.max_deviation_cosine,
+					params.max_deviation_sine }
 	);
 
 	_normalmap_params_sb = storage_buffer_pool.allocate(normalmap_params_pba);
@@ -321,7 +474,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 				compute_list_id, //
 				math::ceildiv(params.tile_size_pixels, local_group_size_x),
 				math::ceildiv(params.tile_size_pixels, local_group_size_y),
-				math::ceildiv(static_cast<int32_t>(tile_data.size()), local_group_size_z)
+				math::ceildiv(tile_count, local_group_size_z)
 		);
 	}
 
@@ -359,7 +512,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 				compute_list_id,
 				math::ceildiv(params.tile_size_pixels, local_group_size_x),
 				math::ceildiv(params.tile_size_pixels, local_group_size_y),
-				math::ceildiv(static_cast<int32_t>(tile_data.size()), local_group_size_z)
+				math::ceildiv(tile_count, local_group_size_z)
 		);
 	}
 
@@ -408,7 +561,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 				compute_list_id,
 				math::ceildiv(params.tile_size_pixels, local_group_size_x),
 				math::ceildiv(params.tile_size_pixels, local_group_size_y),
-				math::ceildiv(static_cast<int32_t>(tile_data.size()), local_group_size_z)
+				math::ceildiv(tile_count, local_group_size_z)
 		);
 
 		rd.compute_list_add_barrier(compute_list_id);
@@ -445,7 +598,7 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 				compute_list_id,
 				math::ceildiv(params.tile_size_pixels, local_group_size_x),
 				math::ceildiv(params.tile_size_pixels, local_group_size_y),
-				math::ceildiv(static_cast<int32_t>(tile_data.size()), local_group_size_z)
+				math::ceildiv(tile_count, local_group_size_z)
 		);
 	}
 
@@ -473,11 +626,8 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 		const unsigned int local_group_size_z = 1;
 		rd.compute_list_dispatch(
 				compute_list_id,
-				// Had to cast explicitely because even though both arguments are unsigned, MSVC is too dumb to
-				// realize it can just use the unsigned version of this function. Also, if both are uint16_t, it
-				// somehow decides to use the SIGNED version.
-				math::ceildiv(static_cast<unsigned int>(texture_width), local_group_size_x),
-				math::ceildiv(static_cast<unsigned int>(texture_height), local_group_size_y),
+				math::ceildiv(atlas_width, local_group_size_x),
+				math::ceildiv(atlas_height, local_group_size_y),
 				local_group_size_z
 		);
 	}
@@ -508,8 +658,8 @@ void RenderDetailTextureGPUTask::prepare(GPUTaskContext &ctx) {
 		const unsigned int local_group_size_z = 1;
 		rd.compute_list_dispatch(
 				compute_list_id,
-				math::ceildiv(static_cast<unsigned int>(texture_width), local_group_size_x),
-				math::ceildiv(static_cast<unsigned int>(texture_height), local_group_size_y),
+				math::ceildiv(atlas_width, local_group_size_x),
+				math::ceildiv(atlas_height, local_group_size_y),
 				local_group_size_z
 		);
 	}
@@ -528,7 +678,10 @@ PackedByteArray RenderDetailTextureGPUTask::collect_texture_and_cleanup(
 	// TODO This is incredibly slow and should not happen in the first place.
 	// But due to how Godot is designed right now, it is not possible to create a texture from the output of a compute
 	// shader without first downloading it back to RAM...
-	PackedByteArray texture_data = rd.texture_get_data(_normalmap_texture0_rid, 0);
+	PackedByteArray texture_data;
+	if (_normalmap_texture0_rid.is_valid()) {
+		texture_data = rd.texture_get_data(_normalmap_texture0_rid, 0);
+	}
 
 	{
 		ZN_PROFILE_SCOPE_NAMED("Cleanup");
@@ -572,30 +725,94 @@ void RenderDetailTextureGPUTask::collect(GPUTaskContext &ctx) {
 	ZN_PROFILE_SCOPE();
 	ZN_DSTACK();
 
-	PackedByteArray texture_data = collect_texture_and_cleanup(ctx.rendering_device, ctx.storage_buffer_pool);
+	// Only the first task of a batch owns resources. Other tasks of the batch are collected after it.
+	if (_batch_tasks.size() > 0) {
+		// Splitting the atlas is left to `finish`. The downloaded atlas is shared with other tasks of the batch, so we
+		// only keep a reference to it.
+		const PackedByteArray atlas_data = collect_texture_and_cleanup(ctx.rendering_device, ctx.storage_buffer_pool);
+		for (RenderDetailTextureGPUTask *task : _batch_tasks) {
+			task->_batch_atlas_data = atlas_data;
+		}
+		_batch_tasks.clear();
+	}
+}
 
-	{
-		StdVector<DetailTextureData::Tile> tile_data2;
-		tile_data2.reserve(tile_data.size());
-		for (const TileData &td : tile_data) {
-			tile_data2.push_back(DetailTextureData::Tile{ td.cell_x, td.cell_y, td.cell_z, uint8_t(td.data & 0x3) });
+PackedByteArray RenderDetailTextureGPUTask::extract_atlas_from_batch() const {
+	ZN_PROFILE_SCOPE();
+
+	const unsigned int pixel_size = 4;
+	const unsigned int tile_size_pixels = params.tile_size_pixels;
+
+	if (_batch_first_tile_index == 0 && _batch_atlas_tiles_x == static_cast<unsigned int>(params.tiles_x) &&
+		_batch_atlas_data.size() == texture_width * texture_height * pixel_size) {
+		// The task was rendered alone
+		return _batch_atlas_data;
+	}
+
+	const unsigned int batch_atlas_height = _batch_atlas_data.size() / (_batch_atlas_width * pixel_size);
+	const unsigned int last_tile_index = _batch_first_tile_index + tile_data.size();
+	ERR_FAIL_COND_V(
+			math::ceildiv(last_tile_index, _batch_atlas_tiles_x) * tile_size_pixels > batch_atlas_height,
+			PackedByteArray()
+	);
+
+	PackedByteArray atlas_data;
+	atlas_data.resize(texture_width * texture_height * pixel_size);
+	uint8_t *dst = atlas_data.ptrw();
+	// Pixels that aren't covered by tiles are not used, but we still don't want garbage in them
+	memset(dst, 0, atlas_data.size());
+	const uint8_t *src = _batch_atlas_data.ptr();
+
+	const unsigned int row_size = tile_size_pixels * pixel_size;
+
+	for (unsigned int tile_index = 0; tile_index < tile_data.size(); ++tile_index) {
+		const unsigned int src_tile_index = _batch_first_tile_index + tile_index;
+		const unsigned int src_x = (src_tile_index % _batch_atlas_tiles_x) * tile_size_pixels;
+		const unsigned int src_y = (src_tile_index / _batch_atlas_tiles_x) * tile_size_pixels;
+		const unsigned int dst_x = (tile_index % params.tiles_x) * tile_size_pixels;
+		const unsigned int dst_y = (tile_index / params.tiles_x) * tile_size_pixels;
+
+		for (unsigned int y = 0; y < tile_size_pixels; ++y) {
+			memcpy(dst + ((dst_y + y) * texture_width + dst_x) * pixel_size,
+				   src + ((src_y + y) * _batch_atlas_width + src_x) * pixel_size,
+				   row_size);
 		}
+	}
+
+	return atlas_data;
+}
 
-		RenderDetailTexturePass2Task *task = ZN_NEW(RenderDetailTexturePass2Task);
-		task->atlas_data = texture_data;
-		task->tile_data = std::move(tile_data2);
-		task->edited_tiles_texture_data = std::move(edited_tiles_texture_data);
-		task->output_textures = output;
-		task->volume_id = volume_id;
-		task->mesh_block_position = block_position;
-		task->mesh_block_size = block_size;
-		task->atlas_width = texture_width;
-		task->atlas_height = texture_height;
-		task->lod_index = lod_index;
-		task->tile_size_pixels = params.tile_size_pixels;
-
-		VoxelEngine::get_singleton().push_async_task(task);
+void RenderDetailTextureGPUTask::finish() {
+	ZN_PROFILE_SCOPE();
+
+	// Can happen if preparing the batch failed
+	ERR_FAIL_COND(_batch_atlas_data.size() == 0);
+
+	PackedByteArray atlas_data = extract_atlas_from_batch();
+	// Drop our reference early, the batch atlas can be big
+	_batch_atlas_data = PackedByteArray();
+	ERR_FAIL_COND(atlas_data.size() == 0);
+
+	StdVector<DetailTextureData::Tile> tile_data2;
+	tile_data2.reserve(tile_data.size());
+	for (const TileData &td : tile_data) {
+		tile_data2.push_back(DetailTextureData::Tile{ td.cell_x, td.cell_y, td.cell_z, uint8_t(td.data & 0x3) });
 	}
+
+	RenderDetailTexturePass2Task *task = ZN_NEW(RenderDetailTexturePass2Task);
+	task->atlas_data = std::move(atlas_data);
+	task->tile_data = std::move(tile_data2);
+	task->edited_tiles_texture_data = std::move(edited_tiles_texture_data);
+	task->output_textures = output;
+	task->volume_id = volume_id;
+	task->mesh_block_position = block_position;
+	task->mesh_block_size = block_size;
+	task->atlas_width = texture_width;
+	task->atlas_height = texture_height;
+	task->lod_index = lod_index;
+	task->tile_size_pixels = params.tile_size_pixels;
+
+	VoxelEngine::get_singleton().push_async_task(task);
 }
 
 } // namespace zylann::voxel
@@ -1,6 +1,7 @@
 #ifndef VOXEL_RENDER_DETAIL_TEXTURE_GPU_TASK_H
 #define VOXEL_RENDER_DETAIL_TEXTURE_GPU_TASK_H
 
+#include "../../util/containers/span.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/math/vector3f.h"
 #include "../../util/math/vector4f.h"
@@ -29,7 +30,8 @@ public:
 		uint8_t cell_x = 0;
 		uint8_t cell_y = 0;
 		uint8_t cell_z = 0;
-		uint8_t _pad = 0;
+		// Index of the block within the batch it gets rendered with. Assigned when preparing.
+		uint8_t block_index = 0;
 		// aaaaaaaa aaaaaaaa aaaaaaaa 0bbb00cc
 		// a: 24-bit index into `u_cell_tris.data` array.
 		// b: 3-bit number of triangles.
@@ -70,13 +72,30 @@ public:
 	VolumeID volume_id;
 	uint8_t lod_index;
 
+	const void *get_batch_key() const override;
+	bool can_batch_with(const IGPUTask &other) const override;
+
 	void prepare(GPUTaskContext &ctx) override;
+	void prepare_batch(
+			GPUTaskContext &ctx,
+			Span<IGPUTask *const> tasks,
+			Span<const unsigned int> output_buffer_begins
+	) override;
 	void collect(GPUTaskContext &ctx) override;
+	void finish() override;
 
-	// Exposed for testing
+	// Exposed for testing. Returns the atlas of the whole batch, which is the same as the atlas of the task if it was
+	// prepared alone.
 	PackedByteArray collect_texture_and_cleanup(RenderingDevice &rd, GPUStorageBufferPool &storage_buffer_pool);
 
 private:
+	// Gets the part of the batch atlas containing tiles of this task, laid out like if the task was rendered alone
+	PackedByteArray extract_atlas_from_batch() const;
+
+	// Resources used by the whole batch. Only the first task of a batch has them.
+	// Tiles of all tasks are rendered into a shared atlas, which is then split back into each task's atlas.
+	StdVector<RenderDetailTextureGPUTask *> _batch_tasks;
+
 	RID _normalmap_texture0_rid;
 	RID _normalmap_texture1_rid;
 
@@ -97,6 +116,12 @@ private:
 	GPUStorageBuffer _sd_buffer0_sb;
 	GPUStorageBuffer _sd_buffer1_sb;
 	GPUStorageBuffer _normalmap_params_sb;
+
+	// Where tiles of this task are in the atlas of its batch
+	PackedByteArray _batch_atlas_data;
+	unsigned int _batch_atlas_width = 0;
+	unsigned int _batch_atlas_tiles_x = 0;
+	unsigned int _batch_first_tile_index = 0;
 };
 
 } // namespace zylann::voxel
@@ -81,11 +81,16 @@ void RenderDetailTextureTask::run_on_cpu() {
 			lod_index,
 			detail_texture_settings.octahedral_encoding_enabled,
 			math::deg_to_rad(float(detail_texture_settings.max_deviation_degrees)),
-			false
+			false,
+			tile_cache.get()
 	);
 
 	DetailImages images = store_normalmap_data_to_images(
-			normalmap_data, tile_resolution, mesh_block_size, detail_texture_settings.octahedral_encoding_enabled
+			normalmap_data,
+			tile_resolution,
+			mesh_block_size,
+			detail_texture_settings.octahedral_encoding_enabled,
+			detail_texture_settings.bc5_compression_enabled
 	);
 
 	// Debug
@@ -235,7 +240,9 @@ RenderDetailTextureGPUTask *RenderDetailTextureTask::make_gpu_task() {
 			lod_index,
 			false, /*detail_texture_settings.octahedral_encoding_enabled*/
 			math::deg_to_rad(float(detail_texture_settings.max_deviation_degrees)),
-			true
+			true,
+			// Only edited tiles are computed here, they are never cached
+			nullptr
 	);
 
 	const unsigned int tile_count = cell_iterator->get_count();
@@ -1,6 +1,7 @@
 #ifndef VOXEL_RENDER_DETAIL_TEXTURE_TASK_H
 #define VOXEL_RENDER_DETAIL_TEXTURE_TASK_H
 
+#include "../../constants/voxel_constants.h"
 #include "../../generators/voxel_generator.h"
 #include "../../meshers/voxel_mesher.h"
 #include "../../util/containers/std_vector.h"
@@ -9,6 +10,7 @@
 #include "../ids.h"
 #include "../priority_dependency.h"
 #include "detail_rendering.h"
+#include "detail_texture_tile_cache.h"
 
 namespace zylann::voxel {
 
@@ -33,6 +35,8 @@ public:
 	uint8_t lod_index;
 	bool use_gpu = false;
 	DetailRenderingSettings detail_texture_settings;
+	// Optional, allows to reuse tiles rendered by previous tasks
+	std::shared_ptr<DetailTextureTileCache> tile_cache;
 
 	// Output (to be assigned so it can be populated)
 	std::shared_ptr<DetailTextureOutput> output_textures;
@@ -46,6 +50,10 @@ public:
 		return "RenderDetailTexture";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_DETAIL_RENDERING;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 	void apply_result() override;
 	TaskPriority get_priority() override;
@@ -78,6 +86,10 @@ public:
 		return "RenderDetailTexturePass2";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_DETAIL_RENDERING;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 	void apply_result() override;
 };
@@ -3,6 +3,7 @@
 #include "../../util/godot/classes/rendering_server.h"
 #include "../../util/godot/core/array.h" // for `varray` in GDExtension builds
 #include "../../util/godot/core/print_string.h"
+#include "../../util/io/log.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "../voxel_engine.h"
@@ -72,6 +73,21 @@ void ComputeShader::load_from_glsl(String source_text, String name) {
 	RenderingDevice &rd = VoxelEngine::get_singleton().get_rendering_device();
 	// MutexLock mlock(VoxelEngine::get_singleton().get_rendering_device_mutex());
 
+	ComputeShaderCache &cache = VoxelEngine::get_singleton().get_compute_shader_cache();
+
+	{
+		Ref<RDShaderSPIRV> cached_spirv = cache.try_load(source_text);
+		if (cached_spirv.is_valid()) {
+			const RID shader_rid = zylann::godot::shader_create_from_spirv(rd, **cached_spirv, name);
+			if (shader_rid.is_valid()) {
+				_rid = shader_rid;
+				return;
+			}
+			// Could happen if the file was corrupted somehow. Compile again, which will overwrite it.
+			ZN_PRINT_VERBOSE(format("Cached compute shader \"{}\" could not be used, compiling it", name));
+		}
+	}
+
 	Ref<RDShaderSPIRV> shader_spirv = zylann::godot::shader_compile_spirv_from_source(rd, **shader_source, false);
 	ERR_FAIL_COND(shader_spirv.is_null());
 
@@ -92,6 +108,8 @@ void ComputeShader::load_from_glsl(String source_text, String name) {
 	const RID shader_rid = zylann::godot::shader_create_from_spirv(rd, **shader_spirv, name);
 	ERR_FAIL_COND(!shader_rid.is_valid());
 
+	cache.save(source_text, **shader_spirv);
+
 	_rid = shader_rid;
 }
 
@@ -0,0 +1,147 @@
+#include "compute_shader_cache.h"
+#include "../../util/containers/span.h"
+#include "../../util/godot/classes/directory.h"
+#include "../../util/godot/classes/file_access.h"
+#include "../../util/godot/classes/rendering_device.h"
+#include "../../util/godot/core/packed_arrays.h"
+#include "../../util/godot/file_utils.h"
+#include "../../util/hash_funcs.h"
+#include "../../util/io/log.h"
+#include "../../util/profiling.h"
+#include <cstring>
+
+namespace zylann::voxel {
+
+namespace {
+
+const uint8_t FILE_MAGIC[4] = { 'V', 'X', 'S', 'C' };
+const uint8_t FILE_VERSION = 1;
+// Above that, the file is considered corrupted
+const uint32_t MAX_BYTECODE_SIZE = 64 * 1024 * 1024;
+
+String to_hex(uint64_t v) {
+	static const char *digits = "0123456789abcdef";
+	char chars[17];
+	for (int i = 15; i >= 0; --i) {
+		chars[i] = digits[v & 0xf];
+		v >>= 4;
+	}
+	chars[16] = '\0';
+	return String(chars);
+}
+
+} // namespace
+
+void ComputeShaderCache::set_directory(const String &directory, const String &device_info) {
+	MutexLock mlock(_mutex);
+	_directory = directory;
+	_device_info = device_info;
+}
+
+bool ComputeShaderCache::is_enabled() const {
+	MutexLock mlock(_mutex);
+	return !_directory.is_empty();
+}
+
+String ComputeShaderCache::get_file_path(const String &source_text) const {
+	// The device is part of the hashed text, so changing GPU or drivers doesn't load incompatible shaders
+	const CharString key_utf8 = (_device_info + "\n" + source_text).utf8();
+	const Span<const uint8_t> key_bytes(reinterpret_cast<const uint8_t *>(key_utf8.get_data()), key_utf8.length());
+	uint64_t hash[2];
+	hash_murmur3_128(key_bytes, 0, hash);
+	return _directory.path_join(to_hex(hash[0]) + to_hex(hash[1]) + ".spv");
+}
+
+Ref<RDShaderSPIRV> ComputeShaderCache::try_load(const String &source_text) {
+	ZN_PROFILE_SCOPE();
+	MutexLock mlock(_mutex);
+
+	if (_directory.is_empty()) {
+		return Ref<RDShaderSPIRV>();
+	}
+
+	const String file_path = get_file_path(source_text);
+
+	Error err;
+	Ref<FileAccess> f = zylann::godot::open_file(file_path, FileAccess::READ, err);
+	if (f.is_null()) {
+		_cache_stats.add_miss();
+		return Ref<RDShaderSPIRV>();
+	}
+
+	uint8_t magic[4];
+	zylann::godot::get_buffer(**f, Span<uint8_t>(magic, 4));
+	const uint8_t version = f->get_8();
+	const uint32_t bytecode_size = f->get_32();
+
+	if (memcmp(magic, FILE_MAGIC, 4) != 0 || version != FILE_VERSION || bytecode_size == 0 ||
+		bytecode_size > MAX_BYTECODE_SIZE || f->get_length() - f->get_position() != bytecode_size) {
+		ZN_PRINT_WARNING(format("Ignoring invalid compute shader cache file {}", file_path));
+		_cache_stats.add_miss();
+		return Ref<RDShaderSPIRV>();
+	}
+
+	PackedByteArray bytecode;
+	bytecode.resize(bytecode_size);
+	const uint64_t read_size = zylann::godot::get_buffer(**f, Span<uint8_t>(bytecode.ptrw(), bytecode.size()));
+	if (read_size != bytecode_size) {
+		_cache_stats.add_miss();
+		return Ref<RDShaderSPIRV>();
+	}
+
+	Ref<RDShaderSPIRV> spirv;
+	spirv.instantiate();
+	spirv->set_stage_bytecode(RenderingDevice::SHADER_STAGE_COMPUTE, bytecode);
+	_cache_stats.add_hit();
+	return spirv;
+}
+
+void ComputeShaderCache::save(const String &source_text, const RDShaderSPIRV &spirv) {
+	ZN_PROFILE_SCOPE();
+	MutexLock mlock(_mutex);
+
+	if (_directory.is_empty()) {
+		return;
+	}
+
+	const PackedByteArray bytecode = spirv.get_stage_bytecode(RenderingDevice::SHADER_STAGE_COMPUTE);
+	ZN_ASSERT_RETURN(bytecode.size() > 0);
+
+	if (zylann::godot::check_directory_created(_directory) != OK) {
+		ZN_PRINT_ERROR(format("Could not create compute shader cache directory {}", _directory));
+		return;
+	}
+
+	// Written to a temporary file first, so a file with the final name is always complete
+	const String file_path = get_file_path(source_text);
+	const String temp_file_path = file_path + ".tmp";
+	{
+		Error err;
+		Ref<FileAccess> f = zylann::godot::open_file(temp_file_path, FileAccess::WRITE, err);
+		if (f.is_null()) {
+			ZN_PRINT_ERROR(format("Could not write compute shader cache file {}", temp_file_path));
+			return;
+		}
+		zylann::godot::store_buffer(**f, Span<const uint8_t>(FILE_MAGIC, 4));
+		f->store_8(FILE_VERSION);
+		f->store_32(bytecode.size());
+		zylann::godot::store_buffer(**f, Span<const uint8_t>(bytecode.ptr(), bytecode.size()));
+	}
+
+	Ref<DirAccess> dir = zylann::godot::open_directory(_directory);
+	ZN_ASSERT_RETURN(dir.is_valid());
+	if (dir->rename(temp_file_path, file_path) != OK) {
+		ZN_PRINT_ERROR(format("Could not rename compute shader cache file {}", temp_file_path));
+		dir->remove(temp_file_path);
+	}
+}
+
+ComputeShaderCache::Stats ComputeShaderCache::get_stats() const {
+	Stats stats;
+	const CacheStats::Snapshot cache_stats = _cache_stats.get_snapshot();
+	stats.hits = cache_stats.hits;
+	stats.misses = cache_stats.misses;
+	return stats;
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,49 @@
+#ifndef VOXEL_COMPUTE_SHADER_CACHE_H
+#define VOXEL_COMPUTE_SHADER_CACHE_H
+
+#include "../../util/cache_stats.h"
+#include "../../util/godot/classes/rd_shader_spirv.h"
+#include "../../util/godot/core/string.h"
+#include "../../util/thread/mutex.h"
+
+namespace zylann::voxel {
+
+// Keeps SPIR-V compiled from GLSL in files, so the same shaders don't have to be compiled again the next time the
+// application runs. Compiling shaders of large generators can take seconds.
+// Entries are identified by a hash of their source code, the Godot version and the graphics device. Editing a graph
+// changes its generated source, so it just gets a new entry.
+// Thread-safe.
+class ComputeShaderCache {
+public:
+	static constexpr const char *DEFAULT_DIRECTORY = "user://voxel_shader_cache";
+
+	struct Stats {
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+	};
+
+	// An empty path disables the cache. `device_info` should change when compiled shaders would be different.
+	void set_directory(const String &directory, const String &device_info);
+
+	bool is_enabled() const;
+
+	// Returns null if the shader is not in the cache
+	Ref<RDShaderSPIRV> try_load(const String &source_text);
+
+	// Stores the compute stage of a successfully compiled shader
+	void save(const String &source_text, const RDShaderSPIRV &spirv);
+
+	Stats get_stats() const;
+
+private:
+	String get_file_path(const String &source_text) const;
+
+	String _directory;
+	String _device_info;
+	Mutex _mutex;
+	CacheStats _cache_stats{ "compute_shader_cache" };
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_COMPUTE_SHADER_CACHE_H
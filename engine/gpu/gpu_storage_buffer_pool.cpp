@@ -34,6 +34,19 @@ void GPUStorageBufferPool::clear() {
 	ZN_ASSERT_RETURN(_rendering_device != nullptr);
 	ZN_DSTACK();
 	RenderingDevice &rd = *_rendering_device;
+
+	for (const GPUStorageBuffer &b : _transient_fallbacks) {
+		recycle(b);
+	}
+	_transient_fallbacks.clear();
+
+	for (const RID rid : _transient_buffers) {
+		godot::free_rendering_device_rid(rd, rid);
+	}
+	_transient_buffers.clear();
+	_transient_buffer_index = 0;
+	_transient_buffer_position = 0;
+
 	unsigned int pool_index = 0;
 	for (Pool &pool : _pools) {
 		if (pool.used_buffers > 0) {
@@ -145,6 +158,75 @@ void GPUStorageBufferPool::recycle(GPUStorageBuffer b) {
 	pool.buffers.push_back(b);
 }
 
+GPUStorageBufferRange GPUStorageBufferPool::allocate_transient(const PackedByteArray &pba, uint32_t alignment) {
+	ZN_PROFILE_SCOPE();
+	const uint32_t size = pba.size();
+	ZN_ASSERT_RETURN_V(size > 0, GPUStorageBufferRange());
+	ZN_ASSERT_RETURN_V(alignment > 0 && TRANSIENT_BUFFER_SIZE % alignment == 0, GPUStorageBufferRange());
+
+	ZN_ASSERT_RETURN_V(_rendering_device != nullptr, GPUStorageBufferRange());
+	RenderingDevice &rd = *_rendering_device;
+
+	GPUStorageBufferRange range;
+
+	if (size <= TRANSIENT_BUFFER_SIZE) {
+		uint32_t position = math::ceildiv(_transient_buffer_position, alignment) * alignment;
+
+		if (position + size > TRANSIENT_BUFFER_SIZE) {
+			// Continue in the next buffer
+			++_transient_buffer_index;
+			position = 0;
+		}
+
+		if (_transient_buffer_index == _transient_buffers.size() && _transient_buffers.size() < MAX_TRANSIENT_BUFFERS) {
+			const RID rid = rd.storage_buffer_create(TRANSIENT_BUFFER_SIZE);
+			ZN_ASSERT_RETURN_V(rid.is_valid(), GPUStorageBufferRange());
+			_transient_buffers.push_back(rid);
+		}
+
+		if (_transient_buffer_index < _transient_buffers.size()) {
+			range.rid = _transient_buffers[_transient_buffer_index];
+			range.offset = position;
+			range.size = size;
+			_transient_buffer_position = position + size;
+		}
+	}
+
+	if (range.is_valid()) {
+		godot::update_storage_buffer(rd, range.rid, range.offset, size, pba);
+
+		++_transient_stats.allocations;
+		_transient_stats.allocated_bytes += size;
+		_transient_stats.frame_bytes += size;
+
+	} else {
+		const GPUStorageBuffer b = allocate(size, &pba);
+		ZN_ASSERT_RETURN_V(b.is_valid(), GPUStorageBufferRange());
+		_transient_fallbacks.push_back(b);
+		range.rid = b.rid;
+		range.size = size;
+
+		++_transient_stats.fallbacks;
+		_transient_stats.fallback_bytes += size;
+	}
+
+	return range;
+}
+
+void GPUStorageBufferPool::begin_frame() {
+	for (const GPUStorageBuffer &b : _transient_fallbacks) {
+		recycle(b);
+	}
+	_transient_fallbacks.clear();
+
+	_transient_buffer_index = 0;
+	_transient_buffer_position = 0;
+
+	++_transient_stats.frames;
+	_transient_stats.peak_frame_bytes = math::max(_transient_stats.peak_frame_bytes, _transient_stats.frame_bytes);
+	_transient_stats.frame_bytes = 0;
+}
+
 void GPUStorageBufferPool::debug_print() const {
 	StdStringStream ss;
 	ss << "---- GPUStorageBufferPool ----\n";
@@ -157,6 +239,15 @@ void GPUStorageBufferPool::debug_print() const {
 		ss << "Pool[" << i << "] block size: " << block_size << ", pooled buffers: " << pool.buffers.size()
 		   << ", capacity: " << pool.buffers.capacity() << "\n";
 	}
+
+	const TransientStats &ts = _transient_stats;
+	const uint64_t transient_capacity = _transient_buffers.size() * TRANSIENT_BUFFER_SIZE;
+	ss << "Transient buffers: " << _transient_buffers.size() << ", peak bytes per frame: " << ts.peak_frame_bytes;
+	if (transient_capacity > 0) {
+		ss << " (" << (100 * ts.peak_frame_bytes / transient_capacity) << "% of capacity)";
+	}
+	ss << ", frames: " << ts.frames << ", allocations: " << ts.allocations << " (" << ts.allocated_bytes
+	   << " bytes), fallbacks: " << ts.fallbacks << " (" << ts.fallback_bytes << " bytes)\n";
 	ss << "----";
 	print_line(ss.str());
 }
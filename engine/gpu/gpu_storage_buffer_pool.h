@@ -22,7 +22,25 @@ struct GPUStorageBuffer {
 	}
 };
 
+// Part of a storage buffer. Godot binds whole buffers, so shaders must be told where the range begins.
+struct GPUStorageBufferRange {
+	RID rid;
+	// In bytes
+	uint32_t offset = 0;
+	uint32_t size = 0;
+
+	inline bool is_null() const {
+		return !rid.is_valid();
+	}
+
+	inline bool is_valid() const {
+		return rid.is_valid();
+	}
+};
+
 // Pools storage buffers of specific sizes so they can be re-used.
+// Small short-lived data can also be suballocated from a few large buffers that persist for the lifetime of the pool,
+// which avoids creating or binding a separate buffer for each of them.
 // Not thread-safe.
 class GPUStorageBufferPool {
 public:
@@ -34,6 +52,14 @@ public:
 	GPUStorageBuffer allocate(const PackedByteArray &pba);
 	GPUStorageBuffer allocate(uint32_t p_size);
 	void recycle(GPUStorageBuffer b);
+
+	// Allocates a range in one of the transient buffers and uploads data to it. `alignment` is in bytes, and must
+	// divide the size of transient buffers. If there is no space left, a separate buffer is allocated from the pools
+	// instead. Either way, the range must not be recycled: it is valid until the next call to `begin_frame`.
+	GPUStorageBufferRange allocate_transient(const PackedByteArray &pba, uint32_t alignment);
+	// Makes all transient ranges available again. Must be called when the device no longer uses them.
+	void begin_frame();
+
 	void debug_print() const;
 
 private:
@@ -52,6 +78,28 @@ private:
 	std::array<uint32_t, POOL_COUNT> _pool_sizes;
 	FixedArray<Pool, POOL_COUNT> _pools;
 	RenderingDevice *_rendering_device = nullptr;
+
+	static const uint32_t TRANSIENT_BUFFER_SIZE = 1 << 20;
+	static const unsigned int MAX_TRANSIENT_BUFFERS = 4;
+
+	// Created when needed. Filled one after the other during a frame.
+	StdVector<RID> _transient_buffers;
+	unsigned int _transient_buffer_index = 0;
+	uint32_t _transient_buffer_position = 0;
+	// Used when transient buffers were full, recycled at the beginning of the next frame
+	StdVector<GPUStorageBuffer> _transient_fallbacks;
+
+	struct TransientStats {
+		uint64_t frames = 0;
+		uint64_t allocations = 0;
+		uint64_t allocated_bytes = 0;
+		uint64_t fallbacks = 0;
+		uint64_t fallback_bytes = 0;
+		uint32_t frame_bytes = 0;
+		uint32_t peak_frame_bytes = 0;
+	};
+
+	TransientStats _transient_stats;
 };
 
 } // namespace zylann::voxel
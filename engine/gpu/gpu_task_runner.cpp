@@ -1,10 +1,12 @@
 #include "gpu_task_runner.h"
+#include "gpu_storage_buffer_pool.h"
 #include "../../util/dstack.h"
 #include "../../util/errors.h"
 #include "../../util/godot/classes/rendering_device.h"
 #include "../../util/math/funcs.h"
 #include "../../util/memory/memory.h"
 #include "../../util/profiling.h"
+#include "../../util/profiling_clock.h"
 
 namespace zylann::voxel {
 
@@ -56,11 +58,33 @@ unsigned int GPUTaskRunner::get_pending_task_count() const {
 	return _pending_count;
 }
 
+GPUTaskRunner::Stats GPUTaskRunner::get_stats() const {
+	Stats stats;
+	stats.batches = _completed_batches.load(std::memory_order_relaxed);
+	stats.completed_tasks = _completed_tasks.load(std::memory_order_relaxed);
+	stats.device_time_usec = _device_time_usec.load(std::memory_order_relaxed);
+	return stats;
+}
+
 void GPUTaskRunner::thread_func() {
 	ZN_PROFILE_SET_THREAD_NAME("Voxel GPU tasks");
 	ZN_DSTACK();
 
 	StdVector<IGPUTask *> tasks;
+	// Tasks of the last batch, which got collected but not finished yet. They get finished after the next batch is
+	// submitted, so that work overlaps with the device.
+	StdVector<IGPUTask *> collected_tasks;
+
+	auto finish_collected_tasks = [this, &collected_tasks]() {
+		for (IGPUTask *task : collected_tasks) {
+			ZN_PROFILE_SCOPE_NAMED("GPU Task Finish");
+			task->finish();
+			ZN_DELETE(task);
+			--_pending_count;
+		}
+		_completed_tasks.fetch_add(collected_tasks.size(), std::memory_order_relaxed);
+		collected_tasks.clear();
+	};
 
 	// We use a common output buffer for tasks that need to download results back to the CPU,
 	// because a single call to `buffer_get_data` is cheaper than multiple ones, due to Godot's API being synchronous.
@@ -72,6 +96,14 @@ void GPUTaskRunner::thread_func() {
 	};
 	StdVector<SBRange> shared_output_storage_buffer_segments;
 
+	// Compatible tasks are prepared together. Each group is a contiguous range of tasks.
+	struct TaskGroup {
+		size_t begin;
+		size_t end;
+	};
+	StdVector<TaskGroup> task_groups;
+	StdVector<unsigned int> task_group_output_begins;
+
 	// Godot does not support async compute, so in order to get results from a compute shader, the only way is to sync
 	// with the device, waiting for everything to complete. So instead of running one shader at a time, we run a few of
 	// them.
@@ -86,6 +118,8 @@ void GPUTaskRunner::thread_func() {
 			tasks = std::move(_shared_tasks);
 		}
 		if (tasks.size() == 0) {
+			// No batch to overlap with
+			finish_collected_tasks();
 			_semaphore.wait();
 			continue;
 		}
@@ -98,6 +132,26 @@ void GPUTaskRunner::thread_func() {
 
 			const size_t end_index = math::min(begin_index + batch_count, tasks.size());
 
+			// Group compatible tasks by moving them next to each other. The order doesn't matter within a batch, since
+			// all its tasks complete at the same time.
+			task_groups.clear();
+			for (size_t group_begin = begin_index; group_begin < end_index;) {
+				const IGPUTask *first_task = tasks[group_begin];
+				const void *batch_key = first_task->get_batch_key();
+				size_t group_end = group_begin + 1;
+				if (batch_key != nullptr) {
+					for (size_t i = group_end; i < end_index; ++i) {
+						IGPUTask *task = tasks[i];
+						if (task->get_batch_key() == batch_key && first_task->can_batch_with(*task)) {
+							std::swap(tasks[i], tasks[group_end]);
+							++group_end;
+						}
+					}
+				}
+				task_groups.push_back(TaskGroup{ group_begin, group_end });
+				group_begin = group_end;
+			}
+
 			unsigned int required_shared_output_buffer_size = 0;
 			shared_output_storage_buffer_segments.clear();
 
@@ -125,23 +179,52 @@ void GPUTaskRunner::thread_func() {
 
 			ctx.shared_output_buffer_rid = shared_output_storage_buffer_rid;
 
+			// The device is done with the previous batch, so its transient buffer ranges can be reused
+			ctx.storage_buffer_pool.begin_frame();
+
 			// Prepare tasks
-			for (size_t i = begin_index; i < end_index; ++i) {
+			for (const TaskGroup &group : task_groups) {
 				ZN_PROFILE_SCOPE_NAMED("GPU Task Prepare");
 
-				const SBRange range = shared_output_storage_buffer_segments[i - begin_index];
-				ctx.shared_output_buffer_begin = range.position;
-				ctx.shared_output_buffer_size = range.size;
+				IGPUTask *task = tasks[group.begin];
 
-				IGPUTask *task = tasks[i];
-				task->prepare(ctx);
+				if (group.end - group.begin == 1) {
+					const SBRange range = shared_output_storage_buffer_segments[group.begin - begin_index];
+					ctx.shared_output_buffer_begin = range.position;
+					ctx.shared_output_buffer_size = range.size;
+
+					task->prepare(ctx);
+
+				} else {
+					task_group_output_begins.clear();
+					for (size_t i = group.begin; i < group.end; ++i) {
+						const SBRange range = shared_output_storage_buffer_segments[i - begin_index];
+						task_group_output_begins.push_back(range.position);
+					}
+
+					task->prepare_batch(
+							ctx,
+							to_span(tasks).sub(group.begin, group.end - group.begin),
+							to_span(task_group_output_begins)
+					);
+				}
 			}
 
+			ProfilingClock device_clock;
+
 			// Submit work and wait for completion
 			{
 				ZN_PROFILE_SCOPE_NAMED("RD Submit");
 				ctx.rendering_device.submit();
 			}
+
+			uint64_t device_time_usec = device_clock.get_elapsed_microseconds();
+
+			// Godot only allows one submission at a time, so the device will idle once it's done with this batch,
+			// until we get its results and submit the next one. So meanwhile, we finish the previous batch.
+			finish_collected_tasks();
+
+			device_clock.restart();
 			{
 				ZN_PROFILE_SCOPE_NAMED("RD Sync");
 				ctx.rendering_device.sync();
@@ -157,7 +240,10 @@ void GPUTaskRunner::thread_func() {
 				);
 			}
 
-			// Collect results and complete tasks
+			device_time_usec += device_clock.get_elapsed_microseconds();
+			_device_time_usec.fetch_add(device_time_usec, std::memory_order_relaxed);
+
+			// Collect results
 			for (size_t i = begin_index; i < end_index; ++i) {
 				ZN_PROFILE_SCOPE_NAMED("GPU Task Collect");
 
@@ -167,16 +253,19 @@ void GPUTaskRunner::thread_func() {
 
 				IGPUTask *task = tasks[i];
 				task->collect(ctx);
-				ZN_DELETE(task);
-				--_pending_count;
+				collected_tasks.push_back(task);
 			}
 
+			++_completed_batches;
+
 			ctx.downloaded_shared_output_data = PackedByteArray();
 		}
 
 		tasks.clear();
 	}
 
+	finish_collected_tasks();
+
 	if (shared_output_storage_buffer_rid.is_valid()) {
 		godot::free_rendering_device_rid(*_rendering_device, shared_output_storage_buffer_rid);
 	}
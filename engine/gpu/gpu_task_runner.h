@@ -6,6 +6,7 @@
 #include "../../util/godot/core/packed_byte_array.h"
 #include "../../util/godot/core/rid.h"
 #include "../../util/godot/macros.h"
+#include "../../util/io/log.h"
 #include "../../util/macros.h"
 #include "../../util/thread/mutex.h"
 #include "../../util/thread/semaphore.h"
@@ -45,8 +46,35 @@ public:
 		return 0;
 	}
 
+	// Tasks doing similar work can be prepared together, so they can share resources and dispatches instead of each
+	// recording their own. Tasks returning the same non-null key are then checked with `can_batch_with`. The key must
+	// be unique to the type of task, so that implementations can assume `other` has the same type.
+	virtual const void *get_batch_key() const {
+		return nullptr;
+	}
+
+	virtual bool can_batch_with(const IGPUTask &other) const {
+		return false;
+	}
+
 	virtual void prepare(GPUTaskContext &ctx) = 0;
+
+	// Prepares a group of compatible tasks, the first one being the task this is called on.
+	// `output_buffer_begins` are the positions in bytes each task has in the shared output buffer.
+	virtual void prepare_batch(
+			GPUTaskContext &ctx,
+			Span<IGPUTask *const> tasks,
+			Span<const unsigned int> output_buffer_begins
+	) {
+		ZN_PRINT_ERROR("Not implemented");
+	}
+
+	// Called once the device completed the work of the task. Results must be read from the device here.
 	virtual void collect(GPUTaskContext &ctx) = 0;
+
+	// Called after `collect`, usually while the device is busy with the next batch, so it must not use the device.
+	// Work passing results to the CPU should be done here, so the device doesn't wait for it.
+	virtual void finish() {}
 };
 
 // Runs tasks that schedules compute shaders and collects their results.
@@ -60,6 +88,17 @@ public:
 	void push(IGPUTask *task);
 	unsigned int get_pending_task_count() const;
 
+	struct Stats {
+		// Times tasks were submitted to the device and waited for
+		uint64_t batches = 0;
+		// Tasks that were collected and finished
+		uint64_t completed_tasks = 0;
+		// Time spent submitting, waiting for the device and downloading results
+		uint64_t device_time_usec = 0;
+	};
+
+	Stats get_stats() const;
+
 private:
 	void thread_func();
 
@@ -74,6 +113,9 @@ private:
 	Thread _thread;
 	bool _running = false;
 	std::atomic_uint32_t _pending_count = 0;
+	std::atomic_uint64_t _completed_batches = { 0 };
+	std::atomic_uint64_t _completed_tasks = { 0 };
+	std::atomic_uint64_t _device_time_usec = { 0 };
 };
 
 } // namespace zylann::voxel
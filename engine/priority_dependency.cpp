@@ -1,39 +1,252 @@
 #include "priority_dependency.h"
 #include "../constants/voxel_constants.h"
+#include "../util/math/float4.h"
 #include "../util/math/funcs.h"
 
 namespace zylann::voxel {
 
+namespace {
+
+// Positions of padding in groups of `ViewersGrid`. Far enough to never be the closest, but squaring it stays finite.
+constexpr float FAR_POSITION = 1e12f;
+
+struct ClosestViewerQuery {
+	Vector3f position;
+	// Actual distance to the closest viewer
+	float distance_sq = 99999.f;
+	// Distance to the closest viewer after being scaled by how much the block is in view
+	float view_distance = 99999.f;
+
+	// View cones can only make distances larger, so viewers further than the closest view distance found so far can't
+	// lower it. That spares computing a square root for most of them.
+	inline float get_bound_sq() const {
+		return math::max(distance_sq, math::squared(view_distance));
+	}
+
+	inline void check_viewer(
+			const float d_sq,
+			const Vector3f viewer_position,
+			const PriorityDependency::ViewCone *view_cone
+	) {
+		if (d_sq < distance_sq) {
+			distance_sq = d_sq;
+		}
+		if (d_sq >= math::squared(view_distance)) {
+			return;
+		}
+		// The square root is needed because the LOD modifier was not working with squared distances, which led blocks
+		// to subdivide too much compared to their neighbors, making cracks more likely to happen
+		float vd = Math::sqrt(d_sq);
+		if (view_cone != nullptr && view_cone->is_enabled()) {
+			vd *= PriorityDependency::get_view_cone_distance_factor(*view_cone, viewer_position, position, vd);
+		}
+		if (vd < view_distance) {
+			view_distance = vd;
+		}
+	}
+
+	void check_viewers(
+			const PriorityDependency::ViewersData &data,
+			const PriorityDependency::ViewersGrid &grid,
+			const unsigned int begin,
+			const unsigned int end
+	) {
+		const math::Float4 px(position.x);
+		const math::Float4 py(position.y);
+		const math::Float4 pz(position.z);
+
+		for (unsigned int i = begin; i < end; i += math::Float4::SIZE) {
+			const math::Float4 dx = math::Float4::load(&grid.xs[i]) - px;
+			const math::Float4 dy = math::Float4::load(&grid.ys[i]) - py;
+			const math::Float4 dz = math::Float4::load(&grid.zs[i]) - pz;
+			float d_sqs[math::Float4::SIZE];
+			(dx * dx + dy * dy + dz * dz).store(d_sqs);
+
+			for (unsigned int lane = 0; lane < math::Float4::SIZE; ++lane) {
+				const float d_sq = d_sqs[lane];
+				if (d_sq >= get_bound_sq()) {
+					continue;
+				}
+				const unsigned int gi = i + lane;
+				const unsigned int viewer_index = grid.viewer_indices[gi];
+				// The grid can be rebuilt while we read it, so the index is checked even though it should be valid
+				const PriorityDependency::ViewCone *view_cone =
+						viewer_index < data.view_cones.size() ? &data.view_cones[viewer_index] : nullptr;
+				check_viewer(d_sq, Vector3f(grid.xs[gi], grid.ys[gi], grid.zs[gi]), view_cone);
+			}
+		}
+	}
+
+	inline void check_bucket(
+			const PriorityDependency::ViewersData &data,
+			const PriorityDependency::ViewersGrid &grid,
+			const unsigned int bucket_index
+	) {
+		check_viewers(data, grid, grid.bucket_begins[bucket_index], grid.bucket_begins[bucket_index + 1]);
+	}
+
+	void search_grid(const PriorityDependency::ViewersData &data, const PriorityDependency::ViewersGrid &grid) {
+		using ViewersGrid = PriorityDependency::ViewersGrid;
+		static_assert(ViewersGrid::BUCKET_COUNT <= 64, "Visited buckets are stored in a 64-bit mask");
+
+		const int cell_x = math::arithmetic_rshift(static_cast<int32_t>(Math::floor(position.x)), grid.cell_size_po2);
+		const int cell_z = math::arithmetic_rshift(static_cast<int32_t>(Math::floor(position.z)), grid.cell_size_po2);
+		const float cell_size = static_cast<float>(1 << grid.cell_size_po2);
+
+		// Cells far apart can share the same bucket, they only need to be checked once
+		uint64_t visited_buckets = 0;
+
+		auto check_cell = [this, &data, &grid, &visited_buckets](int x, int z) {
+			const unsigned int bucket_index = ViewersGrid::get_bucket_index(x, z);
+			const uint64_t bucket_bit = uint64_t(1) << bucket_index;
+			if ((visited_buckets & bucket_bit) == 0) {
+				visited_buckets |= bucket_bit;
+				check_bucket(data, grid, bucket_index);
+			}
+		};
+
+		check_cell(cell_x, cell_z);
+
+		for (int ring = 1; ring <= ViewersGrid::MAX_SEARCH_RINGS; ++ring) {
+			// Viewers in cells of this ring are at least that far away
+			if (view_distance <= static_cast<float>(ring - 1) * cell_size) {
+				return;
+			}
+			for (int i = -ring; i <= ring; ++i) {
+				check_cell(cell_x + i, cell_z - ring);
+				check_cell(cell_x + i, cell_z + ring);
+			}
+			for (int i = -ring + 1; i < ring; ++i) {
+				check_cell(cell_x - ring, cell_z + i);
+				check_cell(cell_x + ring, cell_z + i);
+			}
+		}
+
+		if (view_distance <= static_cast<float>(ViewersGrid::MAX_SEARCH_RINGS) * cell_size) {
+			return;
+		}
+
+		// The closest viewer is further away, check all remaining viewers
+		for (unsigned int bucket_index = 0; bucket_index < ViewersGrid::BUCKET_COUNT; ++bucket_index) {
+			if ((visited_buckets & (uint64_t(1) << bucket_index)) == 0) {
+				check_bucket(data, grid, bucket_index);
+			}
+		}
+	}
+};
+
+} // namespace
+
+PriorityDependency::ViewersGrid::ViewersGrid() {
+	fill(bucket_begins, 0u);
+}
+
+void PriorityDependency::ViewersGrid::set_capacity(unsigned int viewer_capacity) {
+	// Each group can have up to 3 positions of padding
+	const unsigned int capacity = math::ceildiv(viewer_capacity, 4u) * 4 + BUCKET_COUNT * 4;
+	xs.resize(capacity, FAR_POSITION);
+	ys.resize(capacity, FAR_POSITION);
+	zs.resize(capacity, FAR_POSITION);
+	viewer_indices.resize(capacity, 0);
+}
+
+void PriorityDependency::ViewersGrid::build(Span<const Vector3f> positions, uint8_t p_cell_size_po2) {
+	cell_size_po2 = p_cell_size_po2;
+
+	auto get_position_bucket_index = [this](const Vector3f pos) {
+		return get_bucket_index(
+				math::arithmetic_rshift(static_cast<int32_t>(Math::floor(pos.x)), cell_size_po2),
+				math::arithmetic_rshift(static_cast<int32_t>(Math::floor(pos.z)), cell_size_po2)
+		);
+	};
+
+	FixedArray<uint32_t, BUCKET_COUNT> counts;
+	fill(counts, 0u);
+	for (const Vector3f pos : positions) {
+		++counts[get_position_bucket_index(pos)];
+	}
+
+	FixedArray<uint32_t, BUCKET_COUNT> next_indices;
+	uint32_t begin = 0;
+	for (unsigned int bucket_index = 0; bucket_index < BUCKET_COUNT; ++bucket_index) {
+		bucket_begins[bucket_index] = begin;
+		next_indices[bucket_index] = begin;
+		begin += math::ceildiv(counts[bucket_index], 4u) * 4;
+	}
+	ZN_ASSERT_RETURN_MSG(begin <= xs.size(), "Capacity of the grid is too small");
+	bucket_begins[BUCKET_COUNT] = begin;
+
+	for (unsigned int i = 0; i < begin; ++i) {
+		xs[i] = FAR_POSITION;
+		ys[i] = FAR_POSITION;
+		zs[i] = FAR_POSITION;
+		viewer_indices[i] = 0;
+	}
+
+	for (unsigned int viewer_index = 0; viewer_index < positions.size(); ++viewer_index) {
+		const Vector3f pos = positions[viewer_index];
+		const unsigned int i = next_indices[get_position_bucket_index(pos)]++;
+		xs[i] = pos.x;
+		ys[i] = pos.y;
+		zs[i] = pos.z;
+		viewer_indices[i] = viewer_index;
+	}
+
+	viewer_count = positions.size();
+}
+
+void PriorityDependency::ViewersData::set_capacity(unsigned int viewer_capacity) {
+	viewers.resize(viewer_capacity);
+	view_cones.resize(viewer_capacity);
+	for (ViewersGrid &grid : grids) {
+		grid.set_capacity(viewer_capacity);
+	}
+}
+
 TaskPriority PriorityDependency::evaluate(uint8_t lod_index, uint8_t band2_priority, float *out_closest_distance_sq) {
 	TaskPriority priority;
 	ZN_ASSERT_RETURN_V(shared != nullptr, priority);
 
-	const StdVector<Vector3f> &viewer_positions = shared->viewers;
-	const unsigned int viewer_count = shared->viewers_count;
+	const ViewersData &data = *shared;
+	const StdVector<Vector3f> &viewer_positions = data.viewers;
+	const StdVector<ViewCone> &view_cones = data.view_cones;
+	const unsigned int viewer_count = data.viewers_count;
+	const ViewersGrid &grid = data.grids[data.current_grid_index.load(std::memory_order_acquire) & 1];
 
-	const Vector3f block_position = world_position;
+	ClosestViewerQuery query;
+	query.position = world_position;
 
-	float closest_distance_sq = 99999.f;
 	if (viewer_positions.size() == 0) {
 		// Assume origin
-		closest_distance_sq = math::length_squared(block_position);
+		query.distance_sq = math::length_squared(query.position);
+		query.view_distance = Math::sqrt(query.distance_sq);
+
+	} else if (grid.viewer_count == viewer_count && viewer_count > 0) {
+		if (viewer_count < ViewersGrid::MIN_VIEWERS_FOR_SEARCH) {
+			query.check_viewers(data, grid, 0, grid.bucket_begins[ViewersGrid::BUCKET_COUNT]);
+		} else {
+			query.search_grid(data, grid);
+		}
+
 	} else {
+		// The grid was not built for these viewers
 		for (unsigned int i = 0; i < viewer_count; ++i) {
-			const float d = math::distance_squared(viewer_positions[i], block_position);
-			if (d < closest_distance_sq) {
-				closest_distance_sq = d;
+			const Vector3f viewer_position = viewer_positions[i];
+			const float d_sq = math::distance_squared(viewer_position, query.position);
+			if (d_sq < query.get_bound_sq()) {
+				query.check_viewer(d_sq, viewer_position, i < view_cones.size() ? &view_cones[i] : nullptr);
 			}
 		}
 	}
 
+	const float closest_distance_sq = query.distance_sq;
+	const float closest_view_distance = query.view_distance;
+
 	if (out_closest_distance_sq != nullptr) {
 		*out_closest_distance_sq = closest_distance_sq;
 	}
 
-	// TODO Any way to optimize out the sqrt? Maybe with a fast integer version?
-	// I added it because the LOD modifier was not working with squared distances,
-	// which led blocks to subdivide too much compared to their neighbors, making cracks more likely to happen
-	const int distance = static_cast<int>(Math::sqrt(closest_distance_sq));
+	const int distance = static_cast<int>(closest_view_distance);
 
 	// TODO Prioritizing LOD makes generation slower... but not prioritizing makes cracks more likely to appear...
 	// This could be fixed by allowing the volume to preemptively request blocks of the next LOD?
@@ -50,9 +263,40 @@ TaskPriority PriorityDependency::evaluate(uint8_t lod_index, uint8_t band2_prior
 	// changed it back. Will see later if that really causes any issue.
 	priority.band1 = constants::MAX_LOD - lod_index;
 	priority.band2 = band2_priority;
-	priority.band3 = constants::TASK_PRIORITY_BAND3_DEFAULT;
+	priority.band3 = band3;
 
 	return priority;
 }
 
+float PriorityDependency::get_view_cone_distance_factor(
+		const ViewCone &cone,
+		const Vector3f viewer_position,
+		const Vector3f block_position,
+		const float distance
+) {
+	// Blocks surrounding the viewer are needed regardless of where it looks, for collisions and fast turns.
+	// Also, blocks are large, so their center can be out of view while some of their voxels are not.
+	const float near_distance = 32.f;
+	if (distance < near_distance) {
+		return 1.f;
+	}
+
+	const Vector3f to_block = block_position - viewer_position;
+
+	// 0 inside the cone, 1 right behind the viewer
+	const float cos_angle = math::dot(cone.direction, to_block) / distance;
+	const float out_of_view = math::clamp((cone.cos_half_angle - cos_angle) / (cone.cos_half_angle + 1.f), 0.f, 1.f);
+	float factor = 1.f + out_of_view;
+
+	// We don't know where the ground is, but viewers are usually above it. Blocks lying steeply below the viewer are
+	// likely hidden under thick ground, even when it looks down.
+	const float depth = -to_block.y;
+	const float horizontal_distance_sq = math::squared(to_block.x) + math::squared(to_block.z);
+	if (depth > 2.f * near_distance && math::squared(depth) > 4.f * horizontal_distance_sq) {
+		factor += 0.5f;
+	}
+
+	return factor;
+}
+
 } // namespace zylann::voxel
@@ -1,7 +1,11 @@
 #ifndef PRIORITY_DEPENDENCY_H
 #define PRIORITY_DEPENDENCY_H
 
+#include "../constants/voxel_constants.h"
+#include "../util/containers/fixed_array.h"
+#include "../util/containers/span.h"
 #include "../util/containers/std_vector.h"
+#include "../util/math/funcs.h"
 #include "../util/math/vector3f.h"
 #include "../util/tasks/task_priority.h"
 #include <atomic>
@@ -11,6 +15,55 @@ namespace zylann::voxel {
 
 // Information to calculate the priority of a voxel task having a specific location
 struct PriorityDependency {
+	// Optional information about where a viewer is looking, so tasks in view can run before those behind or under it.
+	struct ViewCone {
+		// Normalized. Zero if the viewer doesn't publish a direction, in which case only distance is used.
+		Vector3f direction;
+		// Cosine of half the angle of the cone
+		float cos_half_angle = -1.f;
+
+		inline bool is_enabled() const {
+			return direction != Vector3f();
+		}
+	};
+
+	// Positions of viewers sorted into a coarse grid on the XZ plane, so finding the closest viewer of a task only
+	// needs to check viewers in a few cells around it, instead of all of them.
+	struct ViewersGrid {
+		// Cells are hashed into this many buckets. Cells far apart can share a bucket, which only costs checking a few
+		// more viewers.
+		static constexpr unsigned int BUCKET_COUNT = 64;
+		// Rings of cells searched around a task before checking all remaining buckets. 7x7 cells is less than the
+		// number of buckets, so searching further wouldn't be cheaper.
+		static constexpr int MAX_SEARCH_RINGS = 3;
+		// Below this amount of viewers, checking all of them is cheaper than searching cells
+		static constexpr unsigned int MIN_VIEWERS_FOR_SEARCH = 8;
+
+		// Coordinates of viewers grouped by bucket, in separate arrays so distances can be computed 4 viewers at a
+		// time. Each group starts at a multiple of 4 and is padded with positions far away.
+		StdVector<float> xs;
+		StdVector<float> ys;
+		StdVector<float> zs;
+		// Index of each position in `ViewersData::viewers`
+		StdVector<uint32_t> viewer_indices;
+		// Start of the group of each bucket. The last one is the end of the last group.
+		FixedArray<uint32_t, BUCKET_COUNT + 1> bucket_begins;
+		unsigned int viewer_count = 0;
+		uint8_t cell_size_po2 = 8;
+
+		ViewersGrid();
+
+		// Allocates enough room for the given amount of viewers. Arrays are not resized after that, so threads can
+		// read them while they are rebuilt without going out of bounds.
+		void set_capacity(unsigned int viewer_capacity);
+		void build(Span<const Vector3f> positions, uint8_t p_cell_size_po2);
+
+		static inline unsigned int get_bucket_index(int cell_x, int cell_z) {
+			return ((static_cast<uint32_t>(cell_x) * 73856093u) ^ (static_cast<uint32_t>(cell_z) * 19349663u)) &
+					(BUCKET_COUNT - 1);
+		}
+	};
+
 	struct ViewersData {
 		// These positions are written by the main thread and read by block processing threads.
 		// Order doesn't matter.
@@ -19,9 +72,17 @@ struct PriorityDependency {
 		// This vector is never resized after the instance is created. It is just big enough to have room for all
 		// viewers.
 		StdVector<Vector3f> viewers;
+		// Where each viewer is looking, at the same indices as `viewers` and with the same size.
+		StdVector<ViewCone> view_cones;
 		// Use this count instead of `viewers.size()`. Can change, but will always be <= `viewers.size()`
 		std::atomic_uint32_t viewers_count;
 		float highest_view_distance = 999999;
+		// Same positions indexed by cells, used when it matches `viewers_count`. There are two of them so the main
+		// thread can rebuild one while other threads may still be reading the other.
+		FixedArray<ViewersGrid, 2> grids;
+		std::atomic_uint8_t current_grid_index;
+
+		void set_capacity(unsigned int viewer_capacity);
 	};
 
 	// TODO If viewers are created at the same time as the first terrain for the first time in a session, loading tasks
@@ -45,7 +106,30 @@ struct PriorityDependency {
 	// it's not always reliable and requires to handle "task drops" which is annoying
 	float drop_distance_squared;
 
+	// Priority over tasks of other volumes. See `set_volume_task_priority`.
+	uint8_t band3 = constants::TASK_PRIORITY_BAND3_DEFAULT;
+
+	// Offsets band3 by the task priority of the volume the task comes from, so all tasks of a volume having a higher
+	// priority run before those of volumes with lower priority, regardless of distance.
+	inline void set_volume_task_priority(int volume_task_priority) {
+		band3 = math::clamp(
+				static_cast<int>(constants::TASK_PRIORITY_BAND3_DEFAULT) + volume_task_priority,
+				0,
+				static_cast<int>(TaskPriority::BAND_MAX)
+		);
+	}
+
+	// `out_closest_distance_sq` is the actual distance to the closest viewer, not accounting for view cones
 	TaskPriority evaluate(uint8_t lod_index, uint8_t band2_priority, float *out_closest_distance_sq);
+
+	// Factor applied to the distance between a viewer and a task when calculating priority. It is 1 in front of the
+	// viewer, and grows up to 2 behind it. Blocks deep below the viewer are assumed to be hidden by ground.
+	static float get_view_cone_distance_factor(
+			const ViewCone &cone,
+			const Vector3f viewer_position,
+			const Vector3f block_position,
+			const float distance
+	);
 };
 
 } // namespace zylann::voxel
@@ -2,8 +2,11 @@
 #define VOXEL_STREAMING_DEPENDENCY_H
 
 #include "../generators/voxel_generator.h"
+#include "../streams/block_load_batcher.h"
 #include "../streams/voxel_stream.h"
 
+#include <atomic>
+
 namespace zylann::voxel {
 
 // Shared dependency needed by some asynchronous tasks.
@@ -11,10 +14,22 @@ namespace zylann::voxel {
 // Pointers inside should not change. If they do, a new instance will be made and old ones will be marked invalid,
 // rather than risking a bad pointer read or having to use (many) mutexes.
 struct StreamingDependency {
+	// Beyond this amount, I/O threads stop loading and general-purpose threads stop encoding, until tasks holding
+	// encoded voxels between the two steps have made progress
+	static constexpr uint64_t MAX_ENCODED_BYTES_IN_FLIGHT = 64 * 1024 * 1024;
+
 	Ref<VoxelStream> stream;
 	Ref<VoxelGenerator> generator;
+	// Blocks waiting to be loaded from the stream, so they can be loaded in batches
+	BlockLoadBatcher load_batcher;
+	// Encoded voxels held by tasks waiting to be written or decoded, when the stream supports encoded blocks
+	std::atomic_uint64_t encoded_bytes_in_flight = { 0 };
 	bool valid = true;
 
+	inline bool is_encoded_bytes_budget_exceeded() const {
+		return encoded_bytes_in_flight.load(std::memory_order_relaxed) >= MAX_ENCODED_BYTES_IN_FLIGHT;
+	}
+
 	static void reset(
 			std::shared_ptr<StreamingDependency> &ref,
 			Ref<VoxelStream> stream,
@@ -1,20 +1,28 @@
 #include "voxel_engine.h"
 #include "../constants/voxel_constants.h"
+#include "../generators/generate_block_gpu_task.h"
 #include "../generators/generate_block_task.h"
 #include "../meshers/mesh_block_task.h"
 #include "../shaders/shaders.h"
+#include "../storage/compact_voxel_data_task.h"
+#include "../storage/voxel_data.h"
+#include "../storage/voxel_memory_pool.h"
 #include "../streams/load_all_blocks_data_task.h"
 #include "../streams/load_block_data_task.h"
 #include "../streams/save_block_data_task.h"
 #include "../util/godot/classes/rd_sampler_state.h"
 #include "../util/godot/classes/rendering_device.h"
 #include "../util/godot/classes/rendering_server.h"
+#include "../util/godot/core/version.h"
 #include "../util/io/log.h"
 #include "../util/macros.h"
 #include "../util/math/conv.h"
 #include "../util/profiling.h"
 #include "../util/string/format.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace zylann::voxel {
 
 VoxelEngine *g_voxel_engine = nullptr;
@@ -37,7 +45,42 @@ void VoxelEngine::destroy_singleton() {
 	g_voxel_engine = nullptr;
 }
 
+namespace {
+
+bool is_default_quota(const VoxelEngine::Config::TaskCategoryQuota &quota) {
+	return quota.min_threads == 0 && quota.max_thread_ratio >= 1.f;
+}
+
+// Servers don't build visuals, so meshing is much cheaper and detail rendering never happens. Threads are better spent
+// on generation and streaming. Quotas set explicitly are left as they are.
+void tune_task_category_quotas_for_server(
+		FixedArray<VoxelEngine::Config::TaskCategoryQuota, constants::TASK_CATEGORY_COUNT> &quotas
+) {
+	VoxelEngine::Config::TaskCategoryQuota &generation = quotas[constants::TASK_CATEGORY_GENERATION];
+	if (is_default_quota(generation)) {
+		generation.min_threads = 1;
+	}
+	VoxelEngine::Config::TaskCategoryQuota &streaming = quotas[constants::TASK_CATEGORY_STREAMING];
+	if (is_default_quota(streaming)) {
+		streaming.min_threads = 1;
+	}
+	VoxelEngine::Config::TaskCategoryQuota &meshing = quotas[constants::TASK_CATEGORY_MESHING];
+	if (is_default_quota(meshing)) {
+		meshing.max_thread_ratio = 0.25f;
+	}
+	VoxelEngine::Config::TaskCategoryQuota &detail_rendering = quotas[constants::TASK_CATEGORY_DETAIL_RENDERING];
+	if (is_default_quota(detail_rendering)) {
+		// Gets clamped to one thread
+		detail_rendering.max_thread_ratio = 0.f;
+	}
+}
+
+} // namespace
+
 VoxelEngine::VoxelEngine(Config config) {
+	// Done before threads start, voxel data must not have been allocated yet
+	VoxelMemoryPool::get_singleton().set_arena_enabled(config.memory_arena_enabled);
+
 	const int hw_threads_hint = Thread::get_hardware_concurrency();
 	ZN_PRINT_VERBOSE(format("Voxel: HW threads hint: {}", hw_threads_hint));
 
@@ -59,19 +102,56 @@ VoxelEngine::VoxelEngine(Config config) {
 	}
 
 	_general_thread_pool.set_name("Voxel general");
+	_general_thread_pool.set_numa_affinity_enabled(config.numa_affinity_enabled);
 	_general_thread_pool.set_thread_count(thread_count);
 	_general_thread_pool.set_priority_update_period(200);
+	// Task priorities mostly depend on viewer positions, so we tell the pool when they changed
+	_general_thread_pool.set_lazy_priority_updates(true);
+
+	_server_mode = config.server_mode;
+	_server_simplified_collision = config.server_simplified_collision;
+	_threaded_collision_shape_building_enabled = config.threaded_collision_shape_building_enabled;
+
+	if (_server_mode) {
+		ZN_PRINT_VERBOSE("Voxel: server mode enabled");
+		tune_task_category_quotas_for_server(config.task_category_quotas);
+	}
+
+	static_assert(constants::TASK_CATEGORY_COUNT <= ThreadedTaskRunner::MAX_CATEGORIES);
+	unsigned int reserved_thread_count = 0;
+	for (unsigned int category = 0; category < config.task_category_quotas.size(); ++category) {
+		const Config::TaskCategoryQuota &quota = config.task_category_quotas[category];
+		if (quota.min_threads == 0 && quota.max_thread_ratio >= 1.f) {
+			continue;
+		}
+		// At least one thread, otherwise tasks of that category would never run
+		const unsigned int max_threads =
+				math::clamp(int(Math::ceil(quota.max_thread_ratio * thread_count)), 1, thread_count);
+		const unsigned int min_threads = math::min(quota.min_threads, max_threads);
+		reserved_thread_count += min_threads;
+		_general_thread_pool.set_category_quota(category, min_threads, max_threads);
+	}
+	if (reserved_thread_count >= static_cast<unsigned int>(thread_count)) {
+		ZN_PRINT_WARNING(format(
+				"Task categories reserve {} threads, leaving none for other tasks out of {}",
+				reserved_thread_count,
+				thread_count
+		));
+	}
 
 	// Init world
 	_world.shared_priority_dependency = make_shared_instance<PriorityDependency::ViewersData>();
 	// Give initial capacity to make invalidation less likely
-	_world.shared_priority_dependency->viewers.resize(64);
+	_world.shared_priority_dependency->set_capacity(64);
 
 	ZN_PRINT_VERBOSE(format("Size of LoadBlockDataTask: {}", sizeof(LoadBlockDataTask)));
 	ZN_PRINT_VERBOSE(format("Size of SaveBlockDataTask: {}", sizeof(SaveBlockDataTask)));
 	ZN_PRINT_VERBOSE(format("Size of MeshBlockTask: {}", sizeof(MeshBlockTask)));
 
-	if (RenderingServer::get_singleton() != nullptr) {
+	if (_server_mode) {
+		// Nothing gets rendered, compute shaders are only used for detail textures and GPU generation
+		ZN_PRINT_VERBOSE("Not creating local RenderingDevice in server mode, GPU functionality won't be supported.");
+	} else if (RenderingServer::get_singleton() != nullptr) {
 		_rendering_device = RenderingServer::get_singleton()->create_local_rendering_device();
 	} else {
 		// Sadly, that happens. This is a problem in GDExtension...
@@ -93,11 +173,23 @@ VoxelEngine::VoxelEngine(Config config) {
 
 		_gpu_task_runner.start(_rendering_device, &_gpu_storage_buffer_pool);
 
+		if (config.compute_shader_cache_enabled) {
+			// Compiled shaders depend on the compiler shipped with Godot and may depend on the device
+			const String device_info = String::num_int64(GODOT_VERSION_MAJOR) + "." +
+					String::num_int64(GODOT_VERSION_MINOR) + " " + _rendering_device->get_device_vendor_name() + " " +
+					_rendering_device->get_device_name();
+			_compute_shader_cache.set_directory(ComputeShaderCache::DEFAULT_DIRECTORY, device_info);
+		}
+
 	} else {
 		ZN_PRINT_VERBOSE("Could not create local RenderingDevice, GPU functionality won't be supported.");
 	}
 
 	set_main_thread_time_budget_usec(config.main_thread_budget_usec);
+	set_main_thread_target_fps(config.main_thread_target_fps);
+	_compaction_blocks_per_frame = config.compaction_blocks_per_frame;
+	_cold_block_compression_delay_msec = config.cold_block_compression_delay_msec;
+	_backlog_governor.set_max_pending_tasks(config.backlog_max_pending_tasks);
 }
 
 void VoxelEngine::load_shaders() {
@@ -133,6 +225,9 @@ void VoxelEngine::load_shaders() {
 						String(g_block_modifier_shader_template_1),
 				"zylann.voxel.block_modifier_mesh_shader"
 		);
+
+		_instance_scatter_shader.load_from_glsl(g_instance_scatter_shader, "zylann.voxel.instance_scatter");
+		_mesh_sdf_shader.load_from_glsl(g_mesh_sdf_shader, "zylann.voxel.mesh_sdf");
 	}
 }
 
@@ -155,6 +250,8 @@ VoxelEngine::~VoxelEngine() {
 		_detail_modifier_mesh_shader.clear();
 		_block_modifier_sphere_shader.clear();
 		_block_modifier_mesh_shader.clear();
+		_instance_scatter_shader.clear();
+		_mesh_sdf_shader.clear();
 
 		zylann::godot::free_rendering_device_rid(*_rendering_device, _filtering_sampler_rid);
 		_filtering_sampler_rid = RID();
@@ -210,8 +307,91 @@ bool VoxelEngine::is_volume_valid(VolumeID volume_id) const {
 	return _world.volumes.exists(volume_id);
 }
 
+void VoxelEngine::push_volume_mesh_output(VolumeID volume_id, BlockMeshOutput &output) {
+	Volume &volume = _world.volumes.get(volume_id);
+	if (volume.callbacks.mesh_outputs_callback != nullptr) {
+		volume.pending_mesh_outputs.push_back(std::move(output));
+	} else {
+		// Copied because the callback could add or remove volumes
+		const VolumeCallbacks callbacks = volume.callbacks;
+		ZN_ASSERT_RETURN(callbacks.mesh_output_callback != nullptr);
+		callbacks.mesh_output_callback(callbacks.data, output);
+	}
+}
+
+void VoxelEngine::push_volume_data_output(VolumeID volume_id, BlockDataOutput &output) {
+	Volume &volume = _world.volumes.get(volume_id);
+	if (volume.callbacks.data_outputs_callback != nullptr) {
+		volume.pending_data_outputs.push_back(std::move(output));
+	} else {
+		const VolumeCallbacks callbacks = volume.callbacks;
+		ZN_ASSERT_RETURN(callbacks.data_output_callback != nullptr);
+		callbacks.data_output_callback(callbacks.data, output);
+	}
+}
+
+void VoxelEngine::flush_volume_outputs() {
+	ZN_PROFILE_SCOPE();
+
+	StdVector<VolumeID> volume_ids;
+	_world.volumes.for_each_key_value([&volume_ids](VolumeID id, const Volume &volume) {
+		if (volume.pending_mesh_outputs.size() > 0 || volume.pending_data_outputs.size() > 0) {
+			volume_ids.push_back(id);
+		}
+	});
+
+	for (const VolumeID volume_id : volume_ids) {
+		// A previous callback could have removed the volume
+		if (!_world.volumes.exists(volume_id)) {
+			continue;
+		}
+		// Data comes first, because meshes can depend on it
+		{
+			Volume &volume = _world.volumes.get(volume_id);
+			const VolumeCallbacks callbacks = volume.callbacks;
+			// Swapping keeps the capacity of both vectors
+			std::swap(volume.pending_data_outputs, _flushed_data_outputs);
+			StdVector<BlockDataOutput> &outputs = _flushed_data_outputs;
+			if (outputs.size() > 0) {
+				std::stable_sort(
+						outputs.begin(),
+						outputs.end(),
+						[](const BlockDataOutput &a, const BlockDataOutput &b) { return a.lod_index < b.lod_index; }
+				);
+				callbacks.data_outputs_callback(callbacks.data, to_span(outputs));
+				outputs.clear();
+			}
+		}
+		if (!_world.volumes.exists(volume_id)) {
+			continue;
+		}
+		{
+			Volume &volume = _world.volumes.get(volume_id);
+			const VolumeCallbacks callbacks = volume.callbacks;
+			std::swap(volume.pending_mesh_outputs, _flushed_mesh_outputs);
+			StdVector<BlockMeshOutput> &outputs = _flushed_mesh_outputs;
+			if (outputs.size() > 0) {
+				std::stable_sort(
+						outputs.begin(),
+						outputs.end(),
+						[](const BlockMeshOutput &a, const BlockMeshOutput &b) { return a.lod < b.lod; }
+				);
+				callbacks.mesh_outputs_callback(callbacks.data, to_span(outputs));
+				outputs.clear();
+			}
+		}
+	}
+}
+
+void VoxelEngine::set_volume_voxel_data(VolumeID volume_id, std::shared_ptr<VoxelData> data) {
+	Volume &volume = _world.volumes.get(volume_id);
+	volume.voxel_data = data;
+}
+
 ViewerID VoxelEngine::add_viewer() {
-	return _world.viewers.add(Viewer());
+	Viewer viewer;
+	viewer.require_visuals = !_server_mode;
+	return _world.viewers.add(viewer);
 }
 
 void VoxelEngine::remove_viewer(ViewerID viewer_id) {
@@ -223,6 +403,27 @@ void VoxelEngine::set_viewer_position(ViewerID viewer_id, Vector3 position) {
 	viewer.world_position = position;
 }
 
+void VoxelEngine::teleport_viewer(ViewerID viewer_id, Vector3 position) {
+	Viewer &viewer = _world.viewers.get(viewer_id);
+	viewer.world_position = position;
+	// Prefetching must not extrapolate the jump
+	viewer.previous_world_position = position;
+	viewer.world_velocity = Vector3();
+	// Tasks read viewer positions when their priority gets updated, so they must not wait for the next engine update
+	sync_viewers_task_priority_data();
+	_general_thread_pool.force_priority_update();
+}
+
+void VoxelEngine::set_viewer_direction(ViewerID viewer_id, Vector3 direction) {
+	Viewer &viewer = _world.viewers.get(viewer_id);
+	viewer.world_direction = direction.normalized();
+}
+
+void VoxelEngine::set_viewer_priority_view_angle(ViewerID viewer_id, float degrees) {
+	Viewer &viewer = _world.viewers.get(viewer_id);
+	viewer.priority_view_angle_degrees = math::clamp(degrees, 0.f, Viewer::MAX_PRIORITY_VIEW_ANGLE_DEGREES);
+}
+
 void VoxelEngine::set_viewer_distances(ViewerID viewer_id, Viewer::Distances distances) {
 	Viewer &viewer = _world.viewers.get(viewer_id);
 	viewer.view_distances = distances;
@@ -233,9 +434,20 @@ VoxelEngine::Viewer::Distances VoxelEngine::get_viewer_distances(ViewerID viewer
 	return viewer.view_distances;
 }
 
+Vector3 VoxelEngine::get_viewer_velocity(ViewerID viewer_id) const {
+	const Viewer &viewer = _world.viewers.get(viewer_id);
+	return viewer.world_velocity;
+}
+
+void VoxelEngine::set_viewer_prefetch_time(ViewerID viewer_id, float seconds) {
+	Viewer &viewer = _world.viewers.get(viewer_id);
+	viewer.prefetch_time = math::max(seconds, 0.f);
+}
+
 void VoxelEngine::set_viewer_requires_visuals(ViewerID viewer_id, bool enabled) {
 	Viewer &viewer = _world.viewers.get(viewer_id);
-	viewer.require_visuals = enabled;
+	// Visuals are never built in server mode
+	viewer.require_visuals = enabled && !_server_mode;
 }
 
 bool VoxelEngine::is_viewer_requiring_visuals(ViewerID viewer_id) const {
@@ -289,11 +501,24 @@ void VoxelEngine::push_main_thread_progressive_task(zylann::IProgressiveTask *ta
 }
 
 int VoxelEngine::get_main_thread_time_budget_usec() const {
-	return _main_thread_time_budget_usec;
+	return _main_thread_time_budget.get_budget_usec();
 }
 
 void VoxelEngine::set_main_thread_time_budget_usec(unsigned int usec) {
-	_main_thread_time_budget_usec = usec;
+	_main_thread_time_budget.set_max_budget_usec(usec);
+}
+
+void VoxelEngine::set_main_thread_target_fps(unsigned int fps) {
+	_main_thread_time_budget.set_target_fps(fps);
+}
+
+float VoxelEngine::get_closest_viewer_distance_squared(Vector3 world_position) const {
+	float closest_distance_squared = std::numeric_limits<float>::max();
+	_world.viewers.for_each_value([&closest_distance_squared, world_position](const Viewer &viewer) {
+		closest_distance_squared =
+				math::min(closest_distance_squared, viewer.world_position.distance_squared_to(world_position));
+	});
+	return closest_distance_squared;
 }
 
 void VoxelEngine::set_threaded_graphics_resource_building_enabled(bool enable) {
@@ -304,6 +529,14 @@ bool VoxelEngine::is_threaded_graphics_resource_building_enabled() const {
 	return _threaded_graphics_resource_building_enabled;
 }
 
+void VoxelEngine::set_threaded_collision_shape_building_enabled(bool enable) {
+	_threaded_collision_shape_building_enabled = enable;
+}
+
+bool VoxelEngine::is_threaded_collision_shape_building_enabled() const {
+	return _threaded_collision_shape_building_enabled;
+}
+
 void VoxelEngine::push_async_task(zylann::IThreadedTask *task) {
 	_general_thread_pool.enqueue(task, false);
 }
@@ -327,6 +560,13 @@ void VoxelEngine::push_gpu_task(IGPUTask *task) {
 
 void VoxelEngine::process() {
 	ZN_PROFILE_SCOPE();
+
+	const uint64_t process_time_usec = OS::get_singleton()->get_ticks_usec();
+	if (_last_process_time_usec != 0 && process_time_usec > _last_process_time_usec) {
+		_main_thread_time_budget.update(process_time_usec - _last_process_time_usec);
+	}
+	_last_process_time_usec = process_time_usec;
+
 	ZN_PROFILE_PLOT("Static memory usage", int64_t(OS::get_singleton()->get_static_memory_usage()));
 	ZN_PROFILE_PLOT("TimeSpread tasks", int64_t(_time_spread_task_runner.get_pending_count()));
 	ZN_PROFILE_PLOT("Progressive tasks", int64_t(_progressive_task_runner.get_pending_count()));
@@ -338,23 +578,151 @@ void VoxelEngine::process() {
 	);
 
 	// Receive generation and meshing results
-	_general_thread_pool.dequeue_completed_tasks([](zylann::IThreadedTask *task) {
+	_general_thread_pool.dequeue_completed_tasks([this](zylann::IThreadedTask *task) {
+		const uint64_t begin_time_usec = OS::get_singleton()->get_ticks_usec();
 		task->apply_result();
+		_main_thread_apply_times.add(OS::get_singleton()->get_ticks_usec() - begin_time_usec);
 		ZN_DELETE(task);
 	});
+	flush_volume_outputs();
+
+#ifdef ZN_PROFILER_ENABLED
+	plot_latencies();
+	CacheStats::plot_all();
+#endif
 
 	// Run this after dequeueing threaded tasks, because they can add some to this runner,
 	// which could in turn complete right away (we avoid 1-frame delays this way).
-	_time_spread_task_runner.process(_main_thread_time_budget_usec);
+	const uint32_t budget_usec = _main_thread_time_budget.get_budget_usec();
+	const uint64_t time_spent_usec = _time_spread_task_runner.process(budget_usec);
+	if (time_spent_usec > budget_usec) {
+		// At least one task runs each frame, so it can take longer than the budget on its own
+		++_main_thread_budget_overruns;
+		_main_thread_max_overrun_usec = math::max(_main_thread_max_overrun_usec, time_spent_usec - budget_usec);
+	}
+	ZN_PROFILE_PLOT("Main thread budget (us)", int64_t(budget_usec));
+	ZN_PROFILE_PLOT("Main thread time spent (us)", int64_t(time_spent_usec));
 
 	_progressive_task_runner.process();
 
+	schedule_compaction_task();
+
 	// Update viewer dependencies
+	update_viewers_velocity();
 	sync_viewers_task_priority_data();
 
+	update_backlog_governor();
+
 	ZN_PROFILE_PLOT("Pending GPU tasks", int64_t(_gpu_task_runner.get_pending_task_count()));
 }
 
+#ifdef ZN_PROFILER_ENABLED
+
+void VoxelEngine::plot_latencies() {
+	// Percentiles since the last reset, plot names must be static
+	LatencyHistogram::Snapshot wait_times;
+	LatencyHistogram::Snapshot run_times;
+
+	_general_thread_pool.get_category_latencies(constants::TASK_CATEGORY_STREAMING, wait_times, run_times);
+	ZN_PROFILE_PLOT("Streaming wait p90 (us)", int64_t(wait_times.get_percentile_usec(0.9f)));
+
+	_general_thread_pool.get_category_latencies(constants::TASK_CATEGORY_GENERATION, wait_times, run_times);
+	ZN_PROFILE_PLOT("Generation wait p90 (us)", int64_t(wait_times.get_percentile_usec(0.9f)));
+	ZN_PROFILE_PLOT("Generation run p90 (us)", int64_t(run_times.get_percentile_usec(0.9f)));
+
+	_general_thread_pool.get_category_latencies(constants::TASK_CATEGORY_MESHING, wait_times, run_times);
+	ZN_PROFILE_PLOT("Meshing wait p90 (us)", int64_t(wait_times.get_percentile_usec(0.9f)));
+	ZN_PROFILE_PLOT("Meshing run p90 (us)", int64_t(run_times.get_percentile_usec(0.9f)));
+
+	LatencyHistogram::Snapshot apply_times;
+	_main_thread_apply_times.get_snapshot(apply_times);
+	ZN_PROFILE_PLOT("Main thread apply p99 (us)", int64_t(apply_times.get_percentile_usec(0.99f)));
+}
+
+#endif
+
+void VoxelEngine::schedule_compaction_task() {
+	// Only one task runs at a time, so the amount of blocks visited per frame stays within budget
+	if (_compaction_blocks_per_frame == 0 || CompactVoxelDataTask::get_running_count() > 0) {
+		return;
+	}
+
+	const unsigned int volume_count = _world.volumes.count();
+	if (volume_count == 0) {
+		return;
+	}
+
+	const unsigned int target_index = _compaction_next_volume_index % volume_count;
+	++_compaction_next_volume_index;
+
+	std::shared_ptr<VoxelData> data;
+	unsigned int volume_index = 0;
+	_world.volumes.for_each_value([&data, &volume_index, target_index](const Volume &volume) {
+		if (volume_index == target_index) {
+			data = volume.voxel_data.lock();
+		}
+		++volume_index;
+	});
+
+	if (data == nullptr) {
+		return;
+	}
+
+	push_async_task(
+			ZN_NEW(CompactVoxelDataTask(data, _compaction_blocks_per_frame, _cold_block_compression_delay_msec))
+	);
+}
+
+void VoxelEngine::update_backlog_governor() {
+	if (_backlog_governor.get_max_pending_tasks() == 0) {
+		return;
+	}
+	// Only tasks whose amount depends on streaming distances
+	const uint32_t pending_tasks =
+			_general_thread_pool.get_category_stats(constants::TASK_CATEGORY_STREAMING).pending_tasks +
+			_general_thread_pool.get_category_stats(constants::TASK_CATEGORY_GENERATION).pending_tasks +
+			_general_thread_pool.get_category_stats(constants::TASK_CATEGORY_MESHING).pending_tasks;
+	_backlog_governor.update(pending_tasks, OS::get_singleton()->get_ticks_msec());
+	ZN_PROFILE_PLOT("LOD distance scale", double(_backlog_governor.get_scale()));
+}
+
+void VoxelEngine::update_viewers_velocity() {
+	const uint64_t now_usec = OS::get_singleton()->get_ticks_usec();
+	const uint64_t previous_usec = _last_viewers_velocity_update_usec;
+	_last_viewers_velocity_update_usec = now_usec;
+
+	if (previous_usec == 0 || now_usec <= previous_usec) {
+		_world.viewers.for_each_value([](Viewer &viewer) {
+			viewer.previous_world_position = viewer.world_position;
+			viewer.has_previous_world_position = true;
+		});
+		return;
+	}
+
+	const float delta = static_cast<float>(now_usec - previous_usec) / 1000000.f;
+
+	_world.viewers.for_each_value([delta](Viewer &viewer) {
+		const Vector3 displacement = viewer.world_position - viewer.previous_world_position;
+		viewer.previous_world_position = viewer.world_position;
+
+		if (!viewer.has_previous_world_position) {
+			// New viewer
+			viewer.has_previous_world_position = true;
+			return;
+		}
+
+		if (displacement.length_squared() > math::squared(static_cast<real_t>(viewer.view_distances.max()))) {
+			// Moved further than it can see in a single update, that's a teleport rather than a motion
+			viewer.world_velocity = Vector3();
+			return;
+		}
+
+		// Smoothed so prefetching doesn't jitter with frame times. It still follows turns within a few frames.
+		const Vector3 instant_velocity = displacement / delta;
+		viewer.world_velocity = viewer.world_velocity.lerp(instant_velocity, 0.5f);
+	});
+}
+
 void VoxelEngine::sync_viewers_task_priority_data() {
 	const unsigned int viewer_count = _world.viewers.count();
 
@@ -370,21 +738,73 @@ void VoxelEngine::sync_viewers_task_priority_data() {
 
 		// TODO We can avoid the invalidation by using an atomic size or memory barrier?
 		_world.shared_priority_dependency = make_shared_instance<PriorityDependency::ViewersData>();
-		_world.shared_priority_dependency->viewers.resize(viewer_count);
+		_world.shared_priority_dependency->set_capacity(viewer_count);
 	}
 
 	PriorityDependency::ViewersData &dep = *_world.shared_priority_dependency;
 
+	// Distance priority of tasks is quantized by 16 units at LOD0, so smaller motions barely change anything.
+	// Positions are compared to the last invalidation rather than the last frame so slow motions still add up.
+	const float priority_invalidation_distance_sq = math::squared(16.f);
+	// Same for viewers turning around, by more than about 20 degrees
+	const float priority_invalidation_cos_angle = 0.94f;
+	bool priorities_changed = false;
+
 	size_t i = 0;
 	unsigned int max_distance = 0;
 	_world.viewers.for_each_value([&i, &max_distance, &dep](Viewer &viewer) {
 		dep.viewers[i] = to_vec3f(viewer.world_position);
-		max_distance = math::max(max_distance, viewer.view_distances.max());
+		PriorityDependency::ViewCone &view_cone = dep.view_cones[i];
+		if (viewer.priority_view_angle_degrees > 0.f) {
+			view_cone.direction = to_vec3f(viewer.world_direction);
+			view_cone.cos_half_angle = Math::cos(math::deg_to_rad(0.5f * viewer.priority_view_angle_degrees));
+		} else {
+			view_cone = PriorityDependency::ViewCone();
+		}
+		// Prefetched blocks are further away than the view distance, they must not get cancelled as too far
+		const unsigned int prefetch_distance = static_cast<unsigned int>(viewer.get_prefetch_offset().length());
+		max_distance = math::max(max_distance, viewer.view_distances.max() + prefetch_distance);
 		++i;
 	});
 
 	dep.viewers_count = viewer_count;
 
+	{
+		// Cells as large as the furthest viewers can see, so the closest viewer of most tasks is in the cells
+		// immediately around them
+		const uint8_t cell_size_po2 = math::clamp(math::get_next_power_of_two_32_shift(max_distance), 4u, 20u);
+		const unsigned int next_grid_index = (dep.current_grid_index.load(std::memory_order_relaxed) + 1) & 1;
+		dep.grids[next_grid_index].build(to_span_from_position_and_size(dep.viewers, 0, viewer_count), cell_size_po2);
+		dep.current_grid_index.store(next_grid_index, std::memory_order_release);
+	}
+
+	if (_last_priority_viewer_positions.size() != viewer_count) {
+		priorities_changed = true;
+	} else {
+		for (unsigned int vi = 0; vi < viewer_count; ++vi) {
+			if (math::distance_squared(_last_priority_viewer_positions[vi], dep.viewers[vi]) >
+				priority_invalidation_distance_sq) {
+				priorities_changed = true;
+				break;
+			}
+			const Vector3f last_direction = _last_priority_viewer_directions[vi];
+			const Vector3f direction = dep.view_cones[vi].direction;
+			if (last_direction != direction && math::dot(last_direction, direction) < priority_invalidation_cos_angle) {
+				priorities_changed = true;
+				break;
+			}
+		}
+	}
+	if (priorities_changed) {
+		_last_priority_viewer_positions.resize(viewer_count);
+		_last_priority_viewer_directions.resize(viewer_count);
+		for (unsigned int vi = 0; vi < viewer_count; ++vi) {
+			_last_priority_viewer_positions[vi] = dep.viewers[vi];
+			_last_priority_viewer_directions[vi] = dep.view_cones[vi].direction;
+		}
+		_general_thread_pool.invalidate_priorities();
+	}
+
 	// Cancel distance is increased because of two reasons:
 	// - Some volumes use a cubic area which has higher distances on their corners
 	// - Hysteresis is needed to reduce ping-pong
@@ -410,11 +830,15 @@ VoxelEngine::Stats::ThreadPoolStats debug_get_pool_stats(const zylann::ThreadedT
 	d.active_threads = debug_get_active_thread_count(pool);
 	d.thread_count = pool.get_thread_count();
 
-	fill(d.active_task_names, (const char *)nullptr);
+	d.active_task_names.resize(d.thread_count, nullptr);
 	for (unsigned int i = 0; i < d.thread_count; ++i) {
 		d.active_task_names[i] = pool.get_thread_debug_task_name(i);
 	}
 
+	for (unsigned int i = 0; i < d.categories.size(); ++i) {
+		d.categories[i] = pool.get_category_stats(i);
+	}
+
 	return d;
 }
 
@@ -427,7 +851,54 @@ VoxelEngine::Stats VoxelEngine::get_stats() const {
 	s.meshing_tasks = MeshBlockTask::debug_get_running_count();
 	s.streaming_tasks = LoadBlockDataTask::debug_get_running_count() + SaveBlockDataTask::debug_get_running_count();
 	s.main_thread_tasks = _time_spread_task_runner.get_pending_count() + _progressive_task_runner.get_pending_count();
+	s.compaction_reclaimed_bytes = CompactVoxelDataTask::get_total_reclaimed_bytes();
+	s.cold_block_compressions = VoxelDataBlock::get_total_voxels_compressions();
+	s.cold_block_decompressions = VoxelDataBlock::get_total_voxels_decompressions();
+	s.removed_unchanged_blocks = SaveBlockDataTask::get_total_removed_unchanged_blocks();
+	s.removed_unchanged_bytes = SaveBlockDataTask::get_total_removed_unchanged_bytes();
+	s.superseded_meshing_tasks = MeshBlockTask::get_total_superseded_count();
+	_world.volumes.for_each_value([&s](const Volume &volume) {
+		std::shared_ptr<VoxelData> data = volume.voxel_data.lock();
+		if (data != nullptr) {
+			s.data_map_locks.add(data->get_map_lock_stats());
+			s.data_spatial_locks.add(data->get_spatial_lock_stats());
+		}
+	});
+	s.file_locks = _file_locker.get_stats();
+	for (unsigned int category = 0; category < s.task_latencies.size(); ++category) {
+		Stats::TaskLatencyStats &latencies = s.task_latencies[category];
+		_general_thread_pool.get_category_latencies(category, latencies.wait_times, latencies.run_times);
+	}
+	_main_thread_apply_times.get_snapshot(s.main_thread_apply_times);
+	s.main_thread_budget_usec = _main_thread_time_budget.get_budget_usec();
+	s.main_thread_budget_overruns = _main_thread_budget_overruns;
+	s.main_thread_max_overrun_usec = _main_thread_max_overrun_usec;
+	s.lod_distance_scale = _backlog_governor.get_scale();
+	s.gpu.tasks = _gpu_task_runner.get_stats();
+	const GenerateBlockGPUTask::Stats gpu_generation_stats = GenerateBlockGPUTask::get_stats();
+	s.gpu.generated_blocks = gpu_generation_stats.generated_blocks;
+	s.gpu.generation_dispatches = gpu_generation_stats.dispatches;
+	s.gpu.generation_dispatched_invocations = gpu_generation_stats.dispatched_invocations;
+	s.gpu.generation_useful_invocations = gpu_generation_stats.useful_invocations;
+	s.gpu.shader_cache = _compute_shader_cache.get_stats();
+	CacheStats::get_all_snapshots(s.caches);
 	return s;
 }
 
+void VoxelEngine::get_volumes_voxel_data(StdVector<std::shared_ptr<VoxelData>> &out_data) const {
+	_world.volumes.for_each_value([&out_data](const Volume &volume) {
+		std::shared_ptr<VoxelData> data = volume.voxel_data.lock();
+		if (data != nullptr) {
+			out_data.push_back(data);
+		}
+	});
+}
+
+void VoxelEngine::reset_latency_stats() {
+	_general_thread_pool.reset_category_latencies();
+	_main_thread_apply_times.reset();
+	_main_thread_budget_overruns = 0;
+	_main_thread_max_overrun_usec = 0;
+}
+
 } // namespace zylann::voxel
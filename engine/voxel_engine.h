@@ -1,19 +1,30 @@
 #ifndef VOXEL_ENGINE_H
 #define VOXEL_ENGINE_H
 
+#include "../constants/voxel_constants.h"
 #include "../meshers/voxel_mesher.h"
 #include "../streams/instance_data.h"
+#include "../util/cache_stats.h"
+#include "../util/containers/fixed_array.h"
 #include "../util/containers/slot_map.h"
+#include "../util/containers/span.h"
 #include "../util/containers/std_vector.h"
 #include "../util/godot/classes/rendering_device.h"
+#include "../util/godot/classes/shape_3d.h"
 #include "../util/io/file_locker.h"
+#include "../util/latency_histogram.h"
 #include "../util/memory/memory.h"
 #include "../util/string/std_string.h"
+#include "../util/tasks/adaptive_time_budget.h"
+#include "../util/tasks/backlog_governor.h"
 #include "../util/tasks/progressive_task_runner.h"
 #include "../util/tasks/threaded_task_runner.h"
 #include "../util/tasks/time_spread_task_runner.h"
+#include "../util/thread/sharded_rw_lock.h"
+#include "../util/thread/spatial_lock_3d.h"
 #include "detail_rendering/detail_rendering.h"
 #include "gpu/compute_shader.h"
+#include "gpu/compute_shader_cache.h"
 #include "gpu/gpu_storage_buffer_pool.h"
 #include "gpu/gpu_task_runner.h"
 #include "ids.h"
@@ -26,6 +37,8 @@ using namespace godot;
 
 namespace zylann::voxel {
 
+class VoxelData;
+
 // Singleton for common things, notably the task system and shared viewers list.
 // In Godot terminology this used to be called a "server", but I don't really agree with the term here, and it can be
 // confused with networking features.
@@ -56,6 +69,11 @@ public:
 		bool has_mesh_resource;
 		// Tells if the meshing task was required to build a rendering mesh if possible.
 		bool visual_was_required;
+		// Only used if `has_collision_shape_resource` is true (when collision shapes are allowed to be built in
+		// threads). Otherwise, collision data will be in `surfaces` and the shape has to be built on the main thread.
+		// Can be null if there was nothing to collide with.
+		Ref<Shape3D> collision_shape;
+		bool has_collision_shape_resource = false;
 		// Can be null. Attached to meshing output so it is tracked more easily, because it is baked asynchronously
 		// starting from the mesh task, and it might complete earlier or later than the mesh.
 		std::shared_ptr<DetailTextureOutput> detail_textures;
@@ -95,11 +113,15 @@ public:
 		void (*mesh_output_callback)(void *, BlockMeshOutput &) = nullptr;
 		void (*data_output_callback)(void *, BlockDataOutput &) = nullptr;
 		void (*detail_texture_output_callback)(void *, BlockDetailTextureOutput &) = nullptr;
+		// Batched variants. When set, they are used instead of the callbacks above: outputs are buffered and
+		// delivered once per engine update, sorted by increasing LOD index. Outputs can be moved out of the span.
+		void (*mesh_outputs_callback)(void *, Span<BlockMeshOutput>) = nullptr;
+		void (*data_outputs_callback)(void *, Span<BlockDataOutput>) = nullptr;
 		void *data = nullptr;
 
 		inline bool check_callbacks() const {
-			ZN_ASSERT_RETURN_V(mesh_output_callback != nullptr, false);
-			ZN_ASSERT_RETURN_V(data_output_callback != nullptr, false);
+			ZN_ASSERT_RETURN_V(mesh_output_callback != nullptr || mesh_outputs_callback != nullptr, false);
+			ZN_ASSERT_RETURN_V(data_output_callback != nullptr || data_outputs_callback != nullptr, false);
 			// ZN_ASSERT_RETURN_V(normalmap_output_callback != nullptr, false);
 			ZN_ASSERT_RETURN_V(data != nullptr, false);
 			return true;
@@ -122,14 +144,32 @@ public:
 		// 	FLAGS_COUNT = 3
 		// };
 		Vector3 world_position;
+		// Estimated from position changes between engine updates, in world units per second
+		Vector3 world_velocity;
+		Vector3 previous_world_position;
+		bool has_previous_world_position = false;
+		// Normalized direction the viewer is looking at
+		Vector3 world_direction;
+		// When greater than 0, tasks within this angle around `world_direction` get higher priority
+		float priority_view_angle_degrees = 0.f;
 		Distances view_distances;
+		// How many seconds of movement ahead of the viewer should be loaded in advance. 0 disables prefetching.
+		float prefetch_time = 0.f;
 		bool require_collisions = true;
 		bool require_visuals = true;
 		bool requires_data_block_notifications = false;
 		int network_peer_id = -1;
+
+		static constexpr float MAX_PRIORITY_VIEW_ANGLE_DEGREES = 179.f;
+
+		// Predicted displacement of the viewer, limited to its view distance so prefetching stays bounded
+		inline Vector3 get_prefetch_offset() const {
+			return (world_velocity * prefetch_time).limit_length(view_distances.max());
+		}
 	};
 
 	static constexpr unsigned int DEFAULT_MAIN_THREAD_BUDGET_USEC = 8000;
+	static constexpr unsigned int DEFAULT_COMPACTION_BLOCKS_PER_FRAME = 64;
 
 	struct Config {
 		int thread_count_minimum = 1;
@@ -138,6 +178,39 @@ public:
 		// Portion of available CPU threads to attempt using
 		float thread_count_ratio_over_max = 0.5;
 		unsigned int main_thread_budget_usec = DEFAULT_MAIN_THREAD_BUDGET_USEC;
+		// When not 0, the main thread budget adapts to measured frame durations to keep this rate
+		unsigned int main_thread_target_fps = 0;
+		// How many loaded blocks can be re-compressed in the background each frame. 0 disables it.
+		unsigned int compaction_blocks_per_frame = DEFAULT_COMPACTION_BLOCKS_PER_FRAME;
+		// Blocks not accessed for this long get compressed in memory by compaction, until accessed again. 0 disables
+		// it.
+		unsigned int cold_block_compression_delay_msec = 0;
+		// When more streaming, generation and meshing tasks than this are pending, LOD distances of terrains are
+		// temporarily reduced. 0 disables it.
+		unsigned int backlog_max_pending_tasks = 0;
+		// Allocate voxel data from large page-aligned slabs (see `VoxelMemoryPool`)
+		bool memory_arena_enabled = false;
+		// Spread threads of the general pool across NUMA nodes and pin them there
+		bool numa_affinity_enabled = false;
+		// Keep compiled compute shaders in files so they don't have to be compiled again on the next run
+		bool compute_shader_cache_enabled = true;
+		// For dedicated servers. Terrains only stream voxels and build collisions: no GPU resources are created, and
+		// viewers never require visuals.
+		bool server_mode = false;
+		// In server mode, lets meshers build simplified collision surfaces when they support it
+		bool server_simplified_collision = true;
+		// Build collision shapes in meshing tasks instead of the main thread
+		bool threaded_collision_shape_building_enabled = false;
+
+		struct TaskCategoryQuota {
+			// Threads kept available for tasks of the category
+			unsigned int min_threads = 0;
+			// Portion of threads tasks of the category can use at most
+			float max_thread_ratio = 1.f;
+		};
+
+		// Indexed by `constants::TaskCategory`
+		FixedArray<TaskCategoryQuota, constants::TASK_CATEGORY_COUNT> task_category_quotas;
 	};
 
 	static VoxelEngine &get_singleton();
@@ -150,6 +223,14 @@ public:
 	void remove_volume(VolumeID volume_id);
 	bool is_volume_valid(VolumeID volume_id) const;
 
+	// Delivers results of tasks to a volume. If it has batched callbacks, outputs are buffered until all completed
+	// tasks have been applied in the current `process`, otherwise they are delivered immediately.
+	void push_volume_mesh_output(VolumeID volume_id, BlockMeshOutput &output);
+	void push_volume_data_output(VolumeID volume_id, BlockDataOutput &output);
+
+	// Lets the engine compact voxel data of the volume in the background. Only a weak reference is kept.
+	void set_volume_voxel_data(VolumeID volume_id, std::shared_ptr<VoxelData> data);
+
 	std::shared_ptr<PriorityDependency::ViewersData> get_shared_viewers_data_from_default_world() const {
 		return _world.shared_priority_dependency;
 	}
@@ -157,8 +238,15 @@ public:
 	ViewerID add_viewer();
 	void remove_viewer(ViewerID viewer_id);
 	void set_viewer_position(ViewerID viewer_id, Vector3 position);
+	// Moves a viewer instantly to a far away location. Unlike `set_viewer_position`, it is not seen as a motion, and
+	// pending tasks that became too far from viewers are dropped right away instead of when threads get to them.
+	void teleport_viewer(ViewerID viewer_id, Vector3 position);
+	void set_viewer_direction(ViewerID viewer_id, Vector3 direction);
+	void set_viewer_priority_view_angle(ViewerID viewer_id, float degrees);
 	void set_viewer_distances(ViewerID viewer_id, Viewer::Distances distances);
 	Viewer::Distances get_viewer_distances(ViewerID viewer_id) const;
+	Vector3 get_viewer_velocity(ViewerID viewer_id) const;
+	void set_viewer_prefetch_time(ViewerID viewer_id, float seconds);
 	void set_viewer_requires_visuals(ViewerID viewer_id, bool enabled);
 	bool is_viewer_requiring_visuals(ViewerID viewer_id) const;
 	void set_viewer_requires_collisions(ViewerID viewer_id, bool enabled);
@@ -169,6 +257,7 @@ public:
 	int get_viewer_network_peer_id(ViewerID viewer_id) const;
 	bool viewer_exists(ViewerID viewer_id) const;
 	void sync_viewers_task_priority_data();
+	void update_viewers_velocity();
 
 	template <typename F>
 	inline void for_each_viewer(F f) const {
@@ -181,6 +270,17 @@ public:
 	);
 	int get_main_thread_time_budget_usec() const;
 	void set_main_thread_time_budget_usec(unsigned int usec);
+	// 0 uses a fixed budget
+	void set_main_thread_target_fps(unsigned int fps);
+
+	// Scale terrains should apply to their LOD distances. Goes below 1 while threads can't keep up with tasks.
+	inline float get_lod_distance_scale() const {
+		return _backlog_governor.get_scale();
+	}
+
+	// Squared distance from the given position to the closest viewer, or a large value if there are no viewers.
+	// Can be used to process things closer to players first.
+	float get_closest_viewer_distance_squared(Vector3 world_position) const;
 
 	// Allows/disallows building Mesh and Texture resources from inside threads.
 	// Depends on Godot's efficiency at doing so, and which renderer is used.
@@ -189,6 +289,23 @@ public:
 	// This should be fast and safe to access from multiple threads.
 	bool is_threaded_graphics_resource_building_enabled() const;
 
+	// Allows/disallows building collision shapes from inside threads. Doing so moves the construction of their
+	// acceleration structures off the main thread. Depends on the physics server being able to create shapes from
+	// multiple threads.
+	void set_threaded_collision_shape_building_enabled(bool enable);
+	// This should be fast and safe to access from multiple threads.
+	bool is_threaded_collision_shape_building_enabled() const;
+
+	// In server mode, nothing visual is built, only voxels and collisions.
+	// This is set at startup and never changes, so it is safe to access from multiple threads.
+	inline bool is_server_mode() const {
+		return _server_mode;
+	}
+
+	inline bool is_server_simplified_collision_enabled() const {
+		return _server_mode && _server_simplified_collision;
+	}
+
 	void push_main_thread_progressive_task(IProgressiveTask *task);
 
 	// Thread-safe.
@@ -204,6 +321,11 @@ public:
 	void process();
 	void wait_and_clear_all_tasks(bool warn);
 
+	// Thread-safe.
+	inline unsigned int get_thread_count() const {
+		return _general_thread_pool.get_thread_count();
+	}
+
 	inline FileLocker &get_file_locker() {
 		return _file_locker;
 	}
@@ -220,7 +342,9 @@ public:
 			unsigned int thread_count;
 			unsigned int active_threads;
 			unsigned int tasks;
-			FixedArray<const char *, ThreadedTaskRunner::MAX_THREADS> active_task_names;
+			StdVector<const char *> active_task_names;
+			// Indexed by `constants::TaskCategory`
+			FixedArray<ThreadedTaskRunner::CategoryStats, constants::TASK_CATEGORY_COUNT> categories;
 		};
 
 		ThreadPoolStats general;
@@ -228,10 +352,64 @@ public:
 		int streaming_tasks;
 		int meshing_tasks;
 		int main_thread_tasks;
+		uint64_t compaction_reclaimed_bytes;
+		// How many times voxels of blocks were compressed in memory for not being accessed, and decompressed on access
+		uint64_t cold_block_compressions;
+		uint64_t cold_block_decompressions;
+		// Blocks deleted from streams instead of being saved, see `VoxelStream::set_unchanged_block_removal_enabled`
+		uint64_t removed_unchanged_blocks;
+		uint64_t removed_unchanged_bytes;
+		// Meshing tasks dropped or discarded because a more recent one was sent for the same block
+		uint64_t superseded_meshing_tasks;
+		// Summed over the voxel data of all volumes
+		ShardedRWLock::Stats data_map_locks;
+		SpatialLock3D::Stats data_spatial_locks;
+		FileLocker::Stats file_locks;
+
+		struct TaskLatencyStats {
+			// Time between scheduling and running
+			LatencyHistogram::Snapshot wait_times;
+			LatencyHistogram::Snapshot run_times;
+		};
+
+		// Indexed by `constants::TaskCategory`
+		FixedArray<TaskLatencyStats, constants::TASK_CATEGORY_COUNT> task_latencies;
+		// Time taken by results of threaded tasks to be applied on the main thread
+		LatencyHistogram::Snapshot main_thread_apply_times;
+
+		// Budget given to time-spread main thread tasks in the last frame
+		uint32_t main_thread_budget_usec;
+		// Frames in which tasks went over budget, and by how much at most
+		uint32_t main_thread_budget_overruns;
+		uint64_t main_thread_max_overrun_usec;
+
+		// See `get_lod_distance_scale`
+		float lod_distance_scale;
+
+		struct GPUStats {
+			GPUTaskRunner::Stats tasks;
+			// Block generation, see `GenerateBlockGPUTask::Stats`
+			uint64_t generated_blocks;
+			uint64_t generation_dispatches;
+			uint64_t generation_dispatched_invocations;
+			uint64_t generation_useful_invocations;
+			ComputeShaderCache::Stats shader_cache;
+		};
+
+		GPUStats gpu;
+
+		// Summed by name over all instances of caches registered with `CacheStats`
+		StdVector<CacheStats::Snapshot> caches;
 	};
 
 	Stats get_stats() const;
 
+	// Gets voxel data of all volumes having some, to measure what they hold
+	void get_volumes_voxel_data(StdVector<std::shared_ptr<VoxelData>> &out_data) const;
+
+	// Clears latency distributions and budget overruns reported in stats, so they can be sampled over periods of time
+	void reset_latency_stats();
+
 	bool has_rendering_device() const {
 		return _rendering_device != nullptr;
 	}
@@ -241,6 +419,10 @@ public:
 		return *_rendering_device;
 	}
 
+	ComputeShaderCache &get_compute_shader_cache() {
+		return _compute_shader_cache;
+	}
+
 	const ComputeShader &get_dilate_normalmap_compute_shader() const {
 		return _dilate_normalmap_shader;
 	}
@@ -269,6 +451,14 @@ public:
 		return _block_modifier_mesh_shader;
 	}
 
+	const ComputeShader &get_instance_scatter_compute_shader() const {
+		return _instance_scatter_shader;
+	}
+
+	const ComputeShader &get_mesh_sdf_compute_shader() const {
+		return _mesh_sdf_shader;
+	}
+
 	RID get_filtering_sampler() const {
 		return _filtering_sampler_rid;
 	}
@@ -301,6 +491,12 @@ private:
 	VoxelEngine(Config config);
 
 	void load_shaders();
+	void schedule_compaction_task();
+	void update_backlog_governor();
+	void flush_volume_outputs();
+#ifdef ZN_PROFILER_ENABLED
+	void plot_latencies();
+#endif
 
 	// Since we are going to send data to tasks running in multiple threads, a few strategies are in place:
 	//
@@ -316,6 +512,10 @@ private:
 
 	struct Volume {
 		VolumeCallbacks callbacks;
+		std::weak_ptr<VoxelData> voxel_data;
+		// Outputs waiting to be delivered to batched callbacks
+		StdVector<BlockMeshOutput> pending_mesh_outputs;
+		StdVector<BlockDataOutput> pending_data_outputs;
 	};
 
 	struct World {
@@ -332,12 +532,34 @@ private:
 	ThreadedTaskRunner _general_thread_pool;
 	// For tasks that can only run on the main thread and be spread out over frames
 	TimeSpreadTaskRunner _time_spread_task_runner;
-	unsigned int _main_thread_time_budget_usec = DEFAULT_MAIN_THREAD_BUDGET_USEC;
+	AdaptiveTimeBudget _main_thread_time_budget;
+	BacklogGovernor _backlog_governor;
+	uint64_t _last_process_time_usec = 0;
+	uint32_t _main_thread_budget_overruns = 0;
+	uint64_t _main_thread_max_overrun_usec = 0;
 	ProgressiveTaskRunner _progressive_task_runner;
+	LatencyHistogram _main_thread_apply_times;
+	// Outputs are moved here before being delivered, so callbacks can't invalidate them by adding or removing volumes.
+	// Kept to reuse their capacity.
+	StdVector<BlockMeshOutput> _flushed_mesh_outputs;
+	StdVector<BlockDataOutput> _flushed_data_outputs;
+
+	unsigned int _compaction_blocks_per_frame = DEFAULT_COMPACTION_BLOCKS_PER_FRAME;
+	unsigned int _cold_block_compression_delay_msec = 0;
+	// Volumes take turns being compacted, this tells which one is next
+	unsigned int _compaction_next_volume_index = 0;
 
 	FileLocker _file_locker;
 
+	uint64_t _last_viewers_velocity_update_usec = 0;
+	// Viewer positions when task priorities were last invalidated
+	StdVector<Vector3f> _last_priority_viewer_positions;
+	StdVector<Vector3f> _last_priority_viewer_directions;
+
 	bool _threaded_graphics_resource_building_enabled = false;
+	bool _threaded_collision_shape_building_enabled = false;
+	bool _server_mode = false;
+	bool _server_simplified_collision = false;
 
 	// Rendering device used for compute shaders. May not be available depending on the chosen renderer.
 	RenderingDevice *_rendering_device = nullptr;
@@ -347,6 +569,7 @@ private:
 	Mutex _rendering_device_mutex;
 	GPUTaskRunner _gpu_task_runner;
 	GPUStorageBufferPool _gpu_storage_buffer_pool;
+	ComputeShaderCache _compute_shader_cache;
 
 	// TODO I don't know yet where to store these resource, at some point we may find a more dedicated place
 	ComputeShader _dilate_normalmap_shader;
@@ -356,33 +579,43 @@ private:
 	ComputeShader _detail_modifier_mesh_shader;
 	ComputeShader _block_modifier_sphere_shader;
 	ComputeShader _block_modifier_mesh_shader;
+	ComputeShader _instance_scatter_shader;
+	ComputeShader _mesh_sdf_shader;
 
 	// There can be multiple types of generation tasks, so we count them with a common counter.
 	std::atomic_int _debug_generate_block_task_count = { 0 };
 };
 
 struct VoxelFileLockerRead {
-	VoxelFileLockerRead(const StdString &path) : _path(path) {
-		VoxelEngine::get_singleton().get_file_locker().lock_read(path);
+	VoxelFileLockerRead(const StdString &path) :
+			VoxelFileLockerRead(VoxelEngine::get_singleton().get_file_locker().get_file(path)) {}
+
+	// Faster variant when the lock of the file was obtained earlier
+	VoxelFileLockerRead(FileLocker::File &file) : _file(file) {
+		VoxelEngine::get_singleton().get_file_locker().lock_read(_file);
 	}
 
 	~VoxelFileLockerRead() {
-		VoxelEngine::get_singleton().get_file_locker().unlock(_path);
+		VoxelEngine::get_singleton().get_file_locker().unlock(_file);
 	}
 
-	StdString _path;
+	FileLocker::File &_file;
 };
 
 struct VoxelFileLockerWrite {
-	VoxelFileLockerWrite(const StdString &path) : _path(path) {
-		VoxelEngine::get_singleton().get_file_locker().lock_write(path);
+	VoxelFileLockerWrite(const StdString &path) :
+			VoxelFileLockerWrite(VoxelEngine::get_singleton().get_file_locker().get_file(path)) {}
+
+	// Faster variant when the lock of the file was obtained earlier
+	VoxelFileLockerWrite(FileLocker::File &file) : _file(file) {
+		VoxelEngine::get_singleton().get_file_locker().lock_write(_file);
 	}
 
 	~VoxelFileLockerWrite() {
-		VoxelEngine::get_singleton().get_file_locker().unlock(_path);
+		VoxelEngine::get_singleton().get_file_locker().unlock(_file);
 	}
 
-	StdString _path;
+	FileLocker::File &_file;
 };
 
 } // namespace zylann::voxel
@@ -1,12 +1,17 @@
 #include "voxel_engine_gd.h"
 #include "../constants/version.gen.h"
 #include "../constants/voxel_string_names.h"
+#include "../storage/voxel_data.h"
 #include "../storage/voxel_memory_pool.h"
+#include "../util/godot/classes/file_access.h"
 #include "../util/godot/classes/project_settings.h"
 #include "../util/godot/classes/rendering_server.h"
+#include "../util/godot/core/array.h"
 #include "../util/godot/core/packed_arrays.h"
 #include "../util/macros.h"
 #include "../util/profiling.h"
+#include "../util/profiling_tracer.h"
+#include "../util/string/format.h"
 #include "../util/tasks/godot/threaded_task_gd.h"
 #include "voxel_engine.h"
 
@@ -15,6 +20,20 @@ using namespace zylann::godot;
 namespace zylann::voxel::godot {
 VoxelEngine *g_voxel_engine = nullptr;
 
+namespace {
+
+// Indexed by `constants::TaskCategory`. Used in project settings and stats.
+const char *g_task_category_names[constants::TASK_CATEGORY_COUNT] = {
+	"default", //
+	"streaming", //
+	"generation", //
+	"meshing", //
+	"detail_rendering", //
+	"instances", //
+};
+
+} // namespace
+
 VoxelEngine *VoxelEngine::get_singleton() {
 	CRASH_COND_MSG(g_voxel_engine == nullptr, "Accessing singleton while it's null");
 	return g_voxel_engine;
@@ -39,9 +58,9 @@ VoxelEngine::Config VoxelEngine::get_config_from_godot() {
 
 	// Compute thread count for general pool.
 
-	add_custom_project_setting(Variant::INT, "voxel/threads/count/minimum", PROPERTY_HINT_RANGE, "1,64", 1, true);
+	add_custom_project_setting(Variant::INT, "voxel/threads/count/minimum", PROPERTY_HINT_RANGE, "1,256", 1, true);
 	add_custom_project_setting(
-			Variant::INT, "voxel/threads/count/margin_below_max", PROPERTY_HINT_RANGE, "1,64", 1, true
+			Variant::INT, "voxel/threads/count/margin_below_max", PROPERTY_HINT_RANGE, "1,256", 1, true
 	);
 	add_custom_project_setting(
 			Variant::FLOAT, "voxel/threads/count/ratio_over_max", PROPERTY_HINT_RANGE, "0,1,0.1", 0.5f, true
@@ -49,10 +68,87 @@ VoxelEngine::Config VoxelEngine::get_config_from_godot() {
 	add_custom_project_setting(
 			Variant::INT, "voxel/threads/main/time_budget_ms", PROPERTY_HINT_RANGE, "0,1000", 8, true
 	);
+	add_custom_project_setting(
+			Variant::INT, "voxel/threads/main/target_fps", PROPERTY_HINT_RANGE, "0,1000", 0, true
+	);
+	add_custom_project_setting(
+			Variant::BOOL, "voxel/threads/numa_affinity_enabled", PROPERTY_HINT_NONE, "", false, true
+	);
+
+	add_custom_project_setting(
+			Variant::INT,
+			"voxel/memory/compaction_blocks_per_frame",
+			PROPERTY_HINT_RANGE,
+			"0,4096",
+			zylann::voxel::VoxelEngine::DEFAULT_COMPACTION_BLOCKS_PER_FRAME,
+			true
+	);
+	add_custom_project_setting(
+			Variant::FLOAT,
+			"voxel/memory/cold_block_compression_delay_sec",
+			PROPERTY_HINT_RANGE,
+			"0,3600,0.1,or_greater",
+			0.f,
+			true
+	);
+
+	add_custom_project_setting(
+			Variant::INT, "voxel/threads/backlog_max_pending_tasks", PROPERTY_HINT_RANGE, "0,100000", 0, true
+	);
+
+	add_custom_project_setting(
+			Variant::BOOL, "voxel/memory/arena_allocation_enabled", PROPERTY_HINT_NONE, "", false, true
+	);
 
 	add_custom_project_setting(Variant::BOOL, "voxel/ownership_checks", PROPERTY_HINT_NONE, "", true, true);
 
+	add_custom_project_setting(Variant::BOOL, "voxel/gpu/shader_cache_enabled", PROPERTY_HINT_NONE, "", true, true);
+
+	add_custom_project_setting(Variant::BOOL, "voxel/server_mode/enabled", PROPERTY_HINT_NONE, "", false, true);
+
+	add_custom_project_setting(
+			Variant::BOOL, "voxel/physics/threaded_shape_building_enabled", PROPERTY_HINT_NONE, "", true, true
+	);
+	add_custom_project_setting(
+			Variant::BOOL, "voxel/server_mode/simplified_collision", PROPERTY_HINT_NONE, "", true, true
+	);
+
+	// The default category has no specific tasks to give quotas to
+	for (unsigned int category = 1; category < constants::TASK_CATEGORY_COUNT; ++category) {
+		const char *name = g_task_category_names[category];
+		const StdString min_path = format("voxel/threads/quotas/{}_min_threads", name);
+		const StdString max_path = format("voxel/threads/quotas/{}_max_ratio", name);
+		add_custom_project_setting(Variant::INT, min_path.c_str(), PROPERTY_HINT_RANGE, "0,256", 0, true);
+		add_custom_project_setting(Variant::FLOAT, max_path.c_str(), PROPERTY_HINT_RANGE, "0,1,0.05", 1.f, true);
+		zylann::voxel::VoxelEngine::Config::TaskCategoryQuota &quota = config.inner.task_category_quotas[category];
+		quota.min_threads = math::max(0, int(ps.get(min_path.c_str())));
+		quota.max_thread_ratio = math::clamp(float(ps.get(max_path.c_str())), 0.f, 1.f);
+	}
+
 	config.inner.main_thread_budget_usec = 1000 * int(ps.get("voxel/threads/main/time_budget_ms"));
+	config.inner.main_thread_target_fps = math::max(0, int(ps.get("voxel/threads/main/target_fps")));
+
+	config.inner.compaction_blocks_per_frame = math::max(0, int(ps.get("voxel/memory/compaction_blocks_per_frame")));
+	config.inner.cold_block_compression_delay_msec =
+			math::max(0, int(1000.f * float(ps.get("voxel/memory/cold_block_compression_delay_sec"))));
+
+	config.inner.backlog_max_pending_tasks = math::max(0, int(ps.get("voxel/threads/backlog_max_pending_tasks")));
+
+	config.inner.memory_arena_enabled = ps.get("voxel/memory/arena_allocation_enabled");
+
+	config.inner.numa_affinity_enabled = ps.get("voxel/threads/numa_affinity_enabled");
+
+	config.inner.compute_shader_cache_enabled = ps.get("voxel/gpu/shader_cache_enabled");
+
+	config.inner.server_mode = ps.get("voxel/server_mode/enabled");
+	config.inner.server_simplified_collision = ps.get("voxel/server_mode/simplified_collision");
+
+	// Shapes can be built from threads when the physics server runs on the main thread: they are only shared through
+	// its RID owner, which is thread-safe. When it runs on a separate thread, calls get forwarded to that thread
+	// anyways, so there is nothing to gain.
+	config.inner.threaded_collision_shape_building_enabled =
+			bool(ps.get("voxel/physics/threaded_shape_building_enabled")) &&
+			!bool(ps.get("physics/3d/run_on_separate_thread"));
 
 	config.inner.thread_count_minimum = math::max(1, int(ps.get("voxel/threads/count/minimum")));
 
@@ -90,6 +186,10 @@ int VoxelEngine::get_version_patch() const {
 	return VOXEL_VERSION_PATCH;
 }
 
+bool VoxelEngine::is_server_mode() const {
+	return zylann::voxel::VoxelEngine::get_singleton().is_server_mode();
+}
+
 Dictionary to_dict(const zylann::voxel::VoxelEngine::Stats::ThreadPoolStats &stats) {
 	Dictionary d;
 	d["tasks"] = stats.tasks;
@@ -110,6 +210,56 @@ Dictionary to_dict(const zylann::voxel::VoxelEngine::Stats::ThreadPoolStats &sta
 
 	d["task_names"] = task_names;
 
+	Dictionary categories;
+	for (unsigned int i = 0; i < stats.categories.size(); ++i) {
+		const ThreadedTaskRunner::CategoryStats &category_stats = stats.categories[i];
+		Dictionary category_dict;
+		category_dict["pending"] = category_stats.pending_tasks;
+		category_dict["running"] = category_stats.running_tasks;
+		categories[g_task_category_names[i]] = category_dict;
+	}
+	d["categories"] = categories;
+
+	return d;
+}
+
+Dictionary to_dict(const LatencyHistogram::Snapshot &latencies) {
+	Dictionary d;
+	d["count"] = ZN_SIZE_T_TO_VARIANT(latencies.count);
+	d["mean_usec"] = ZN_SIZE_T_TO_VARIANT(latencies.get_mean_usec());
+	d["p50_usec"] = ZN_SIZE_T_TO_VARIANT(latencies.get_percentile_usec(0.5f));
+	d["p90_usec"] = ZN_SIZE_T_TO_VARIANT(latencies.get_percentile_usec(0.9f));
+	d["p99_usec"] = ZN_SIZE_T_TO_VARIANT(latencies.get_percentile_usec(0.99f));
+	d["max_usec"] = ZN_SIZE_T_TO_VARIANT(latencies.max_usec);
+	return d;
+}
+
+// Indexed by `VoxelBuffer::ChannelId`
+const char *g_channel_names[zylann::voxel::VoxelBuffer::MAX_CHANNELS] = {
+	"type", //
+	"sdf", //
+	"color", //
+	"indices", //
+	"weights", //
+	"data5", //
+	"data6", //
+	"data7", //
+};
+
+Dictionary to_dict(const VoxelData::MemoryUsage &usage) {
+	Dictionary channels;
+	uint64_t total = 0;
+	for (unsigned int channel_index = 0; channel_index < usage.channel_bytes.size(); ++channel_index) {
+		channels[g_channel_names[channel_index]] = ZN_SIZE_T_TO_VARIANT(usage.channel_bytes[channel_index]);
+		total += usage.channel_bytes[channel_index];
+	}
+	Dictionary d;
+	d["channels"] = channels;
+	d["total"] = ZN_SIZE_T_TO_VARIANT(total);
+	d["blocks"] = usage.block_count;
+	d["blocks_with_voxels"] = usage.blocks_with_voxels;
+	d["compressed_blocks"] = usage.compressed_blocks;
+	d["compressed_bytes"] = ZN_SIZE_T_TO_VARIANT(usage.compressed_bytes);
 	return d;
 }
 
@@ -122,12 +272,26 @@ Dictionary to_dict(const zylann::voxel::VoxelEngine::Stats &stats) {
 	tasks["generation"] = stats.generation_tasks;
 	tasks["meshing"] = stats.meshing_tasks;
 	tasks["main_thread"] = stats.main_thread_tasks;
+	tasks["lod_distance_scale"] = stats.lod_distance_scale;
+	tasks["removed_unchanged_blocks"] = ZN_SIZE_T_TO_VARIANT(stats.removed_unchanged_blocks);
+	tasks["removed_unchanged_bytes"] = ZN_SIZE_T_TO_VARIANT(stats.removed_unchanged_bytes);
+	tasks["superseded_meshing_tasks"] = ZN_SIZE_T_TO_VARIANT(stats.superseded_meshing_tasks);
 
 	// This part is additional for scripts because VoxelMemoryPool is not exposed
 	Dictionary mem;
 	mem["voxel_total"] = ZN_SIZE_T_TO_VARIANT(VoxelMemoryPool::get_singleton().debug_get_total_memory());
 	mem["voxel_used"] = ZN_SIZE_T_TO_VARIANT(VoxelMemoryPool::get_singleton().debug_get_used_memory());
 	mem["block_count"] = VoxelMemoryPool::get_singleton().debug_get_used_blocks();
+	mem["compaction_reclaimed"] = ZN_SIZE_T_TO_VARIANT(stats.compaction_reclaimed_bytes);
+	mem["cold_block_compressions"] = ZN_SIZE_T_TO_VARIANT(stats.cold_block_compressions);
+	mem["cold_block_decompressions"] = ZN_SIZE_T_TO_VARIANT(stats.cold_block_decompressions);
+	const VoxelMemoryPool::ArenaStats arena_stats = VoxelMemoryPool::get_singleton().get_arena_stats();
+	mem["arena_slabs"] = arena_stats.slab_count;
+	mem["arena_large_page_slabs"] = arena_stats.large_page_slab_count;
+	mem["arena_partial_slabs"] = arena_stats.partial_slab_count;
+	mem["arena_empty_slabs"] = arena_stats.empty_slab_count;
+	mem["arena_reserved"] = ZN_SIZE_T_TO_VARIANT(arena_stats.reserved_bytes);
+	mem["arena_used"] = ZN_SIZE_T_TO_VARIANT(arena_stats.used_bytes);
 #ifdef DEBUG_ENABLED
 	const uint64_t std_allocated = static_cast<int64_t>(StdDefaultAllocatorCounters::g_allocated);
 	const uint64_t std_deallocated = static_cast<int64_t>(StdDefaultAllocatorCounters::g_deallocated);
@@ -140,10 +304,80 @@ Dictionary to_dict(const zylann::voxel::VoxelEngine::Stats &stats) {
 	mem["std_current"] = -1;
 #endif
 
+	Dictionary locks;
+	locks["data_map_reads"] = ZN_SIZE_T_TO_VARIANT(stats.data_map_locks.read_locks);
+	locks["data_map_writes"] = ZN_SIZE_T_TO_VARIANT(stats.data_map_locks.write_locks);
+	locks["data_map_contended"] = ZN_SIZE_T_TO_VARIANT(stats.data_map_locks.contended_locks);
+	locks["data_map_wait_usec"] = ZN_SIZE_T_TO_VARIANT(stats.data_map_locks.wait_time_usec);
+	locks["data_spatial_reads"] = ZN_SIZE_T_TO_VARIANT(stats.data_spatial_locks.read_locks);
+	locks["data_spatial_writes"] = ZN_SIZE_T_TO_VARIANT(stats.data_spatial_locks.write_locks);
+	locks["data_spatial_contended"] = ZN_SIZE_T_TO_VARIANT(stats.data_spatial_locks.contended_locks);
+	locks["data_spatial_wait_usec"] = ZN_SIZE_T_TO_VARIANT(stats.data_spatial_locks.wait_time_usec);
+	locks["data_spatial_wakeups"] = ZN_SIZE_T_TO_VARIANT(stats.data_spatial_locks.wakeups);
+	locks["data_spatial_timeouts"] = ZN_SIZE_T_TO_VARIANT(stats.data_spatial_locks.timeouts);
+	locks["file_lookups"] = ZN_SIZE_T_TO_VARIANT(stats.file_locks.lookups);
+	locks["file_contended_lookups"] = ZN_SIZE_T_TO_VARIANT(stats.file_locks.contended_lookups);
+	locks["file_contended_locks"] = ZN_SIZE_T_TO_VARIANT(stats.file_locks.contended_locks);
+
+	Dictionary latencies;
+	for (unsigned int i = 0; i < stats.task_latencies.size(); ++i) {
+		const zylann::voxel::VoxelEngine::Stats::TaskLatencyStats &category_latencies = stats.task_latencies[i];
+		Dictionary category_dict;
+		category_dict["wait"] = to_dict(category_latencies.wait_times);
+		category_dict["run"] = to_dict(category_latencies.run_times);
+		latencies[g_task_category_names[i]] = category_dict;
+	}
+	latencies["main_thread_apply"] = to_dict(stats.main_thread_apply_times);
+
+	Dictionary main_thread_budget;
+	main_thread_budget["budget_usec"] = stats.main_thread_budget_usec;
+	main_thread_budget["overruns"] = stats.main_thread_budget_overruns;
+	main_thread_budget["max_overrun_usec"] = ZN_SIZE_T_TO_VARIANT(stats.main_thread_max_overrun_usec);
+	latencies["main_thread_budget"] = main_thread_budget;
+
+	const zylann::voxel::VoxelEngine::Stats::GPUStats &gpu_stats = stats.gpu;
+	Dictionary gpu;
+	gpu["batches"] = ZN_SIZE_T_TO_VARIANT(gpu_stats.tasks.batches);
+	gpu["tasks"] = ZN_SIZE_T_TO_VARIANT(gpu_stats.tasks.completed_tasks);
+	gpu["device_time_usec"] = ZN_SIZE_T_TO_VARIANT(gpu_stats.tasks.device_time_usec);
+	gpu["generated_blocks"] = ZN_SIZE_T_TO_VARIANT(gpu_stats.generated_blocks);
+	gpu["generation_dispatches"] = ZN_SIZE_T_TO_VARIANT(gpu_stats.generation_dispatches);
+	double generation_occupancy = 0.0;
+	if (gpu_stats.generation_dispatched_invocations > 0) {
+		generation_occupancy = double(gpu_stats.generation_useful_invocations) /
+				double(gpu_stats.generation_dispatched_invocations);
+	}
+	gpu["generation_occupancy"] = generation_occupancy;
+	double generated_blocks_per_second = 0.0;
+	if (gpu_stats.tasks.device_time_usec > 0) {
+		generated_blocks_per_second =
+				1000000.0 * double(gpu_stats.generated_blocks) / double(gpu_stats.tasks.device_time_usec);
+	}
+	gpu["generated_blocks_per_second"] = generated_blocks_per_second;
+	gpu["shader_cache_hits"] = gpu_stats.shader_cache.hits;
+	gpu["shader_cache_misses"] = gpu_stats.shader_cache.misses;
+
+	Dictionary caches;
+	for (const zylann::CacheStats::Snapshot &cache_stats : stats.caches) {
+		Dictionary cache_dict;
+		cache_dict["instances"] = cache_stats.instance_count;
+		cache_dict["hits"] = ZN_SIZE_T_TO_VARIANT(cache_stats.hits);
+		cache_dict["misses"] = ZN_SIZE_T_TO_VARIANT(cache_stats.misses);
+		cache_dict["hit_rate"] = cache_stats.get_hit_rate();
+		cache_dict["evictions"] = ZN_SIZE_T_TO_VARIANT(cache_stats.evictions);
+		cache_dict["entries"] = cache_stats.entries;
+		cache_dict["memory_usage"] = cache_stats.memory_usage;
+		caches[cache_stats.name] = cache_dict;
+	}
+
 	Dictionary d;
 	d["thread_pools"] = pools;
 	d["tasks"] = tasks;
 	d["memory_pools"] = mem;
+	d["locks"] = locks;
+	d["latencies"] = latencies;
+	d["gpu"] = gpu;
+	d["caches"] = caches;
 	return d;
 }
 
@@ -152,6 +386,77 @@ Dictionary VoxelEngine::get_stats() const {
 	return to_dict(zylann::voxel::VoxelEngine::get_singleton().get_stats());
 }
 
+void VoxelEngine::reset_latency_stats() {
+	zylann::voxel::VoxelEngine::get_singleton().reset_latency_stats();
+}
+
+Dictionary VoxelEngine::get_memory_breakdown() const {
+	ZN_PROFILE_SCOPE();
+
+	StdVector<std::shared_ptr<VoxelData>> volumes_data;
+	zylann::voxel::VoxelEngine::get_singleton().get_volumes_voxel_data(volumes_data);
+
+	Array volumes;
+	VoxelData::MemoryUsage total_usage;
+	for (const std::shared_ptr<VoxelData> &data : volumes_data) {
+		const VoxelData::MemoryUsage usage = data->get_memory_usage();
+		total_usage.add(usage);
+		volumes.append(to_dict(usage));
+	}
+
+	const VoxelMemoryPool &pool = VoxelMemoryPool::get_singleton();
+	Dictionary pool_dict;
+	pool_dict["used"] = ZN_SIZE_T_TO_VARIANT(pool.debug_get_used_memory());
+	pool_dict["total"] = ZN_SIZE_T_TO_VARIANT(pool.debug_get_total_memory());
+	pool_dict["arena_reserved"] = ZN_SIZE_T_TO_VARIANT(pool.get_arena_stats().reserved_bytes);
+
+	Dictionary d;
+	d["voxel_data"] = to_dict(total_usage);
+	d["volumes"] = volumes;
+	d["voxel_memory_pool"] = pool_dict;
+#ifdef DEBUG_ENABLED
+	d["std_containers"] = static_cast<int64_t>(
+			StdDefaultAllocatorCounters::g_allocated - StdDefaultAllocatorCounters::g_deallocated
+	);
+#else
+	d["std_containers"] = -1;
+#endif
+	return d;
+}
+
+Dictionary get_voxel_data_memory_breakdown(const VoxelData &data) {
+	return to_dict(data.get_memory_usage());
+}
+
+void VoxelEngine::set_timeline_recording_enabled(bool enabled) {
+#ifdef ZN_PROFILER_ENABLED
+	// Scopes are sent to the profiler instead
+	ZN_PRINT_WARNING("Timeline recording is not available in builds using a profiler");
+#endif
+	zylann::profiling_tracer::set_enabled(enabled);
+}
+
+bool VoxelEngine::is_timeline_recording_enabled() const {
+	return zylann::profiling_tracer::is_enabled();
+}
+
+void VoxelEngine::clear_timeline() {
+	zylann::profiling_tracer::clear();
+}
+
+Error VoxelEngine::save_timeline(String fpath) const {
+	ZN_PROFILE_SCOPE();
+	const StdString json = zylann::profiling_tracer::get_chrome_trace_json();
+
+	Error err;
+	Ref<FileAccess> f = open_file(fpath, FileAccess::WRITE, err);
+	ERR_FAIL_COND_V_MSG(
+			f.is_null(), err, String("Could not open {0} to save the timeline, error: {1}").format(varray(fpath, err))
+	);
+	store_buffer(**f, Span<const uint8_t>(reinterpret_cast<const uint8_t *>(json.data()), json.size()));
+	return OK;
+}
+
 void VoxelEngine::schedule_task(Ref<ZN_ThreadedTask> task) {
 	ERR_FAIL_COND(task.is_null());
 	ERR_FAIL_COND_MSG(task->is_scheduled(), "Cannot schedule again a task that is already scheduled");
@@ -186,6 +491,16 @@ void VoxelEngine::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_version_minor"), &VoxelEngine::get_version_minor);
 	ClassDB::bind_method(D_METHOD("get_version_patch"), &VoxelEngine::get_version_patch);
 	ClassDB::bind_method(D_METHOD("get_stats"), &VoxelEngine::get_stats);
+	ClassDB::bind_method(D_METHOD("is_server_mode"), &VoxelEngine::is_server_mode);
+	ClassDB::bind_method(D_METHOD("reset_latency_stats"), &VoxelEngine::reset_latency_stats);
+	ClassDB::bind_method(D_METHOD("get_memory_breakdown"), &VoxelEngine::get_memory_breakdown);
+
+	ClassDB::bind_method(
+			D_METHOD("set_timeline_recording_enabled", "enabled"), &VoxelEngine::set_timeline_recording_enabled
+	);
+	ClassDB::bind_method(D_METHOD("is_timeline_recording_enabled"), &VoxelEngine::is_timeline_recording_enabled);
+	ClassDB::bind_method(D_METHOD("clear_timeline"), &VoxelEngine::clear_timeline);
+	ClassDB::bind_method(D_METHOD("save_timeline", "path"), &VoxelEngine::save_timeline);
 }
 
 } // namespace zylann::voxel::godot
@@ -31,7 +31,16 @@ public:
 	int get_version_minor() const;
 	int get_version_patch() const;
 
+	bool is_server_mode() const;
+
 	Dictionary get_stats() const;
+	void reset_latency_stats();
+	Dictionary get_memory_breakdown() const;
+
+	void set_timeline_recording_enabled(bool enabled);
+	bool is_timeline_recording_enabled() const;
+	void clear_timeline();
+	Error save_timeline(String fpath) const;
 	void schedule_task(Ref<ZN_ThreadedTask> task);
 
 #ifdef TOOLS_ENABLED
@@ -51,6 +60,10 @@ private:
 #endif
 };
 
+// Gets how much memory is used by voxels of each channel, in the format returned by `get_memory_breakdown` functions.
+// This visits all blocks, so it is meant for debugging and profiling.
+Dictionary get_voxel_data_memory_breakdown(const VoxelData &data);
+
 } // namespace zylann::voxel::godot
 
 #endif // VOXEL_ENGINE_GD_H
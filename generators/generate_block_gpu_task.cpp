@@ -10,6 +10,7 @@
 #include "../util/math/conv.h"
 #include "../util/profiling.h"
 #include "../util/string/format.h"
+#include <atomic>
 
 #include "../util/godot/classes/rendering_device.h"
 
@@ -34,7 +35,65 @@ unsigned int GenerateBlockGPUTask::get_required_shared_output_buffer_size() cons
 	return generator_shader_outputs->outputs.size() * volume * sizeof(float);
 }
 
+namespace {
+
+std::atomic_uint64_t g_generated_blocks = { 0 };
+std::atomic_uint64_t g_dispatches = { 0 };
+std::atomic_uint64_t g_dispatched_invocations = { 0 };
+std::atomic_uint64_t g_useful_invocations = { 0 };
+
+} // namespace
+
+GenerateBlockGPUTask::Stats GenerateBlockGPUTask::get_stats() {
+	Stats stats;
+	stats.generated_blocks = g_generated_blocks.load(std::memory_order_relaxed);
+	stats.dispatches = g_dispatches.load(std::memory_order_relaxed);
+	stats.dispatched_invocations = g_dispatched_invocations.load(std::memory_order_relaxed);
+	stats.useful_invocations = g_useful_invocations.load(std::memory_order_relaxed);
+	return stats;
+}
+
+const void *GenerateBlockGPUTask::get_batch_key() const {
+	return generator_shader.get();
+}
+
+bool GenerateBlockGPUTask::can_batch_with(const IGPUTask &other) const {
+	// It has the same batch key, so it is the same type of task
+	const GenerateBlockGPUTask &other_task = static_cast<const GenerateBlockGPUTask &>(other);
+
+	if (other_task.generator_shader != generator_shader ||
+		other_task.generator_shader_params != generator_shader_params ||
+		other_task.generator_shader_outputs != generator_shader_outputs) {
+		return false;
+	}
+
+	// Modifiers are dispatched on all blocks of the batch, so they must be the same
+	if (other_task.modifiers.size() != modifiers.size()) {
+		return false;
+	}
+	for (unsigned int i = 0; i < modifiers.size(); ++i) {
+		const ModifierData &a = modifiers[i];
+		const ModifierData &b = other_task.modifiers[i];
+		if (a.shader_rid != b.shader_rid || a.params != b.params) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 void GenerateBlockGPUTask::prepare(GPUTaskContext &ctx) {
+	IGPUTask *task = this;
+	prepare_batch(
+			ctx, Span<IGPUTask *const>(&task, 1), Span<const unsigned int>(&ctx.shared_output_buffer_begin, 1)
+	);
+}
+
+void GenerateBlockGPUTask::prepare_batch(
+		GPUTaskContext &ctx,
+		Span<IGPUTask *const> tasks,
+		Span<const unsigned int> output_buffer_begins
+) {
 	ZN_PROFILE_SCOPE();
 	ZN_DSTACK();
 
@@ -45,9 +104,9 @@ void GenerateBlockGPUTask::prepare(GPUTaskContext &ctx) {
 	ZN_ASSERT_RETURN(generator_shader_outputs != nullptr);
 	ZN_ASSERT_RETURN(generator_shader_outputs->outputs.size() > 0);
 
-	ZN_ASSERT(consumer_task != nullptr);
-
-	ERR_FAIL_COND(boxes_to_generate.size() == 0);
+	ZN_ASSERT_RETURN(tasks.size() > 0);
+	ZN_ASSERT_RETURN(tasks[0] == this);
+	ZN_ASSERT_RETURN(tasks.size() == output_buffer_begins.size());
 
 	RenderingDevice &rd = ctx.rendering_device;
 	GPUStorageBufferPool &storage_buffer_pool = ctx.storage_buffer_pool;
@@ -65,50 +124,94 @@ void GenerateBlockGPUTask::prepare(GPUTaskContext &ctx) {
 		}
 	}
 
-	_boxes_data.resize(boxes_to_generate.size());
+	// Params
+	// Layout must match the `Params` buffer and push constants in block shaders. With std430, the table of blocks is
+	// aligned to 16 bytes because they contain a `vec3`.
+
+	struct PushConstants {
+		int block_groups_z;
+		// Index of the first block in the `Params` buffer, which can contain tables of other batches
+		int blocks_offset;
+		int padding[2];
+	};
 
-	unsigned int out_offset_elements = 0;
+	struct BlockParams {
+		Vector3f origin_in_voxels;
+		float voxel_size;
+		Vector3i block_size;
+		int output_buffer_start;
+	};
 
-	for (unsigned int i = 0; i < _boxes_data.size(); ++i) {
-		BoxData &bd = _boxes_data[i];
-		const Box3i box = boxes_to_generate[i];
-		const Vector3i buffer_resolution = box.size;
-		const unsigned int buffer_volume = Vector3iUtil::get_volume_u64(buffer_resolution);
+	static_assert(sizeof(PushConstants) == 16);
+	static_assert(sizeof(BlockParams) == 32);
 
-		// Params
+	const Vector3i group_size(4, 4, 4);
 
-		struct Params {
-			Vector3f origin_in_voxels;
-			float voxel_size;
-			Vector3i block_size;
-			int output_buffer_start;
-		};
+	StdVector<BlockParams> blocks_params;
+	Vector3i max_block_groups;
+	uint64_t useful_invocations = 0;
 
-		Params params;
-		params.origin_in_voxels = to_vec3f((box.position << lod_index) + origin_in_voxels);
-		params.voxel_size = 1 << lod_index;
-		params.block_size = buffer_resolution;
-		params.output_buffer_start = (ctx.shared_output_buffer_begin / sizeof(float)) + out_offset_elements;
+	for (unsigned int task_index = 0; task_index < tasks.size(); ++task_index) {
+		const GenerateBlockGPUTask &task = static_cast<const GenerateBlockGPUTask &>(*tasks[task_index]);
 
-		out_offset_elements += buffer_volume * generator_shader_outputs->outputs.size();
+		ZN_ASSERT(task.consumer_task != nullptr);
+		ERR_FAIL_COND(task.boxes_to_generate.size() == 0);
 
-		PackedByteArray params_pba;
-		zylann::godot::copy_bytes_to(params_pba, params);
+		unsigned int out_offset_elements = output_buffer_begins[task_index] / sizeof(float);
 
-		bd.params_sb = storage_buffer_pool.allocate(params_pba);
-		ERR_FAIL_COND(bd.params_sb.is_null());
+		for (const Box3i &box : task.boxes_to_generate) {
+			const unsigned int buffer_volume = Vector3iUtil::get_volume_u64(box.size);
 
-		bd.params_uniform.instantiate();
-		bd.params_uniform->set_uniform_type(RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER);
-		bd.params_uniform->add_id(bd.params_sb.rid);
+			BlockParams params;
+			params.origin_in_voxels = to_vec3f((box.position << task.lod_index) + task.origin_in_voxels);
+			params.voxel_size = 1 << task.lod_index;
+			params.block_size = box.size;
+			params.output_buffer_start = out_offset_elements;
+			blocks_params.push_back(params);
 
-		// Output
+			out_offset_elements += buffer_volume * generator_shader_outputs->outputs.size();
 
-		bd.output_uniform.instantiate();
-		bd.output_uniform->set_uniform_type(RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER);
-		bd.output_uniform->add_id(ctx.shared_output_buffer_rid);
+			max_block_groups = math::max(max_block_groups, math::ceildiv(box.size, group_size));
+			useful_invocations += buffer_volume;
+		}
 	}
 
+	// Blocks are stacked along Z, and each spans enough groups to fit the largest one. The shader avoids writing out of
+	// bounds with blocks that are smaller, or not a multiple of the group size.
+	const Vector3i groups(max_block_groups.x, max_block_groups.y, max_block_groups.z * blocks_params.size());
+	// Vulkan guarantees at least this amount of groups
+	ERR_FAIL_COND_MSG(groups.z > 65535, "Too many blocks to generate in a single dispatch");
+
+	PackedByteArray params_pba;
+	copy_bytes_to<BlockParams>(params_pba, to_span(blocks_params));
+
+	// The table is suballocated in a buffer shared with other batches, so we don't create and upload a new buffer
+	// every time. It remains valid until the next batch.
+	const GPUStorageBufferRange params_range = storage_buffer_pool.allocate_transient(params_pba, sizeof(BlockParams));
+	ERR_FAIL_COND(params_range.is_null());
+
+	PushConstants push_constants;
+	push_constants.block_groups_z = max_block_groups.z;
+	push_constants.blocks_offset = params_range.offset / sizeof(BlockParams);
+	push_constants.padding[0] = 0;
+	push_constants.padding[1] = 0;
+	const Span<const uint8_t> push_constants_bytes =
+			Span<const PushConstants>(&push_constants, 1).reinterpret_cast_to<const uint8_t>();
+
+	Ref<RDUniform> params_uniform;
+	params_uniform.instantiate();
+	params_uniform->set_uniform_type(RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER);
+	params_uniform->add_id(params_range.rid);
+	params_uniform->set_binding(0);
+
+	// Output
+
+	Ref<RDUniform> output_uniform;
+	output_uniform.instantiate();
+	output_uniform->set_uniform_type(RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER);
+	output_uniform->add_id(ctx.shared_output_buffer_rid);
+	output_uniform->set_binding(1);
+
 	// Pipelines
 	// Not sure what a pipeline is required for in compute shaders, it seems to be required "just because"
 
@@ -127,21 +230,18 @@ void GenerateBlockGPUTask::prepare(GPUTaskContext &ctx) {
 
 	const int compute_list_id = rd.compute_list_begin();
 
-	// Generate
-
-	for (unsigned int box_index = 0; box_index < _boxes_data.size(); ++box_index) {
-		BoxData &bd = _boxes_data[box_index];
+	unsigned int dispatch_count = 0;
 
-		bd.params_uniform->set_binding(0); // Base params
-		bd.output_uniform->set_binding(1);
+	// Generate
 
+	{
 		Array generator_uniforms;
 		generator_uniforms.resize(2);
-		generator_uniforms[0] = bd.params_uniform;
-		generator_uniforms[1] = bd.output_uniform;
+		generator_uniforms[0] = params_uniform;
+		generator_uniforms[1] = output_uniform;
 
 		// Additional params
-		if (generator_shader_params != nullptr && generator_shader_params->params.size() > 0) {
+		if (generator_shader_params->params.size() > 0) {
 			add_uniform_params(generator_shader_params->params, generator_uniforms);
 		}
 
@@ -159,65 +259,55 @@ void GenerateBlockGPUTask::prepare(GPUTaskContext &ctx) {
 			ZN_PROFILE_SCOPE_NAMED("compute_list_bind_uniform_set");
 			rd.compute_list_bind_uniform_set(compute_list_id, generator_uniform_set, 0);
 		}
-
-		const Box3i &box = boxes_to_generate[box_index];
-
-		// Note, the output buffer might not be a multiple of group size, so the shader should avoid writing out of
-		// bounds in some invocations.
-		const Vector3i groups = math::ceildiv(box.size, Vector3i(4, 4, 4));
+		zylann::godot::compute_list_set_push_constant(rd, compute_list_id, push_constants_bytes);
 		{
 			ZN_PROFILE_SCOPE_NAMED("compute_list_dispatch");
 			rd.compute_list_dispatch(compute_list_id, groups.x, groups.y, groups.z);
 		}
+		++dispatch_count;
 	}
 
-	// TODO We could reduce barriers by dispatching all generators in the batch (instead of just this task), then we do
-	// the barrier?
 	rd.compute_list_add_barrier(compute_list_id);
 
 	// Apply modifiers in-place
 
 	if (sd_output_index != -1) {
-		for (unsigned int box_index = 0; box_index < _boxes_data.size(); ++box_index) {
-			BoxData &bd = _boxes_data[box_index];
-
-			const Box3i &box = boxes_to_generate[box_index];
-			const Vector3i groups = math::ceildiv(box.size, Vector3i(4, 4, 4));
-
-			Ref<RDUniform> sd_buffer0_uniform = bd.output_uniform;
-
-			for (unsigned int modifier_index = 0; modifier_index < modifiers.size(); ++modifier_index) {
-				const ModifierData &modifier_data = modifiers[modifier_index];
-				ZN_ASSERT_CONTINUE(modifier_data.shader_rid.is_valid());
-
-				bd.params_uniform->set_binding(0);
-				sd_buffer0_uniform->set_binding(1);
-
-				Array modifier_uniforms;
-				modifier_uniforms.resize(2);
-				modifier_uniforms[0] = bd.params_uniform;
-				modifier_uniforms[1] = sd_buffer0_uniform;
-
-				// Extra params
-				if (modifier_data.params != nullptr) {
-					add_uniform_params(modifier_data.params->params, modifier_uniforms);
-				}
+		for (unsigned int modifier_index = 0; modifier_index < modifiers.size(); ++modifier_index) {
+			const ModifierData &modifier_data = modifiers[modifier_index];
+			ZN_ASSERT_CONTINUE(modifier_data.shader_rid.is_valid());
+
+			Array modifier_uniforms;
+			modifier_uniforms.resize(2);
+			modifier_uniforms[0] = params_uniform;
+			modifier_uniforms[1] = output_uniform;
+
+			// Extra params
+			if (modifier_data.params != nullptr) {
+				add_uniform_params(modifier_data.params->params, modifier_uniforms);
+			}
 
-				const RID modifier_uniform_set =
-						zylann::godot::uniform_set_create(rd, modifier_uniforms, modifier_data.shader_rid, 0);
+			const RID modifier_uniform_set =
+					zylann::godot::uniform_set_create(rd, modifier_uniforms, modifier_data.shader_rid, 0);
 
-				const RID pipeline_rid = _modifier_pipelines[modifier_index];
-				rd.compute_list_bind_compute_pipeline(compute_list_id, pipeline_rid);
-				rd.compute_list_bind_uniform_set(compute_list_id, modifier_uniform_set, 0);
+			const RID pipeline_rid = _modifier_pipelines[modifier_index];
+			rd.compute_list_bind_compute_pipeline(compute_list_id, pipeline_rid);
+			rd.compute_list_bind_uniform_set(compute_list_id, modifier_uniform_set, 0);
+			zylann::godot::compute_list_set_push_constant(rd, compute_list_id, push_constants_bytes);
 
-				rd.compute_list_dispatch(compute_list_id, groups.x, groups.y, groups.z);
+			rd.compute_list_dispatch(compute_list_id, groups.x, groups.y, groups.z);
+			++dispatch_count;
 
-				rd.compute_list_add_barrier(compute_list_id);
-			}
+			rd.compute_list_add_barrier(compute_list_id);
 		}
 	}
 
 	rd.compute_list_end();
+
+	const uint64_t invocations_per_dispatch = Vector3iUtil::get_volume_u64(groups * group_size);
+	g_generated_blocks.fetch_add(tasks.size(), std::memory_order_relaxed);
+	g_dispatches.fetch_add(dispatch_count, std::memory_order_relaxed);
+	g_dispatched_invocations.fetch_add(dispatch_count * invocations_per_dispatch, std::memory_order_relaxed);
+	g_useful_invocations.fetch_add(dispatch_count * useful_invocations, std::memory_order_relaxed);
 }
 
 namespace {
@@ -418,10 +508,10 @@ void GenerateBlockGPUTask::collect(GPUTaskContext &ctx) {
 	ZN_DSTACK();
 
 	RenderingDevice &rd = ctx.rendering_device;
-	GPUStorageBufferPool &storage_buffer_pool = ctx.storage_buffer_pool;
 
-	StdVector<GenerateBlockGPUTaskResult> results;
-	results.reserve(_boxes_data.size());
+	StdVector<GenerateBlockGPUTaskResult> &results = _results;
+	results.clear();
+	results.reserve(boxes_to_generate.size() * generator_shader_outputs->outputs.size());
 
 	// Get span for that specific task
 	Span<const uint8_t> outputs_bytes = to_span(ctx.downloaded_shared_output_data)
@@ -429,10 +519,7 @@ void GenerateBlockGPUTask::collect(GPUTaskContext &ctx) {
 
 	unsigned int box_offset = 0;
 
-	for (unsigned int box_index = 0; box_index < _boxes_data.size(); ++box_index) {
-		BoxData &bd = _boxes_data[box_index];
-		const Box3i box = boxes_to_generate[box_index];
-
+	for (const Box3i &box : boxes_to_generate) {
 		// Every output is the same size for now
 		const unsigned int size_per_output = Vector3iUtil::get_volume_u64(box.size) * sizeof(float);
 
@@ -452,19 +539,24 @@ void GenerateBlockGPUTask::collect(GPUTaskContext &ctx) {
 		}
 
 		box_offset += size_per_output * generator_shader_outputs->outputs.size();
-
-		storage_buffer_pool.recycle(bd.params_sb);
 	}
 
-	zylann::godot::free_rendering_device_rid(rd, _generator_pipeline_rid);
+	// Batch resources are only owned by the first task of the batch
+	if (_generator_pipeline_rid.is_valid()) {
+		zylann::godot::free_rendering_device_rid(rd, _generator_pipeline_rid);
+	}
 
 	for (RID rid : _modifier_pipelines) {
 		zylann::godot::free_rendering_device_rid(rd, rid);
 	}
+}
+
+void GenerateBlockGPUTask::finish() {
+	ZN_PROFILE_SCOPE();
 
 	// We leave conversion to the CPU task, because we have only one thread for GPU work and it only exists for waiting
 	// blocking functions, not doing work
-	consumer_task->set_gpu_results(std::move(results));
+	consumer_task->set_gpu_results(std::move(_results));
 
 	// Resume meshing task, pass ownership back to the task runner.
 	VoxelEngine::get_singleton().push_async_task(consumer_task);
@@ -46,14 +46,36 @@ public:
 
 // Generates a block of voxels on the GPU. Must be scheduled from a threaded task, which will be resumed when this one
 // finishes.
+// Tasks using the same generator and modifiers are batched, so all their boxes are generated with a single dispatch
+// per shader, instead of one per box.
 class GenerateBlockGPUTask : public IGPUTask {
 public:
 	~GenerateBlockGPUTask();
 
 	unsigned int get_required_shared_output_buffer_size() const override;
 
+	const void *get_batch_key() const override;
+	bool can_batch_with(const IGPUTask &other) const override;
+
 	void prepare(GPUTaskContext &ctx) override;
+	void prepare_batch(
+			GPUTaskContext &ctx,
+			Span<IGPUTask *const> tasks,
+			Span<const unsigned int> output_buffer_begins
+	) override;
 	void collect(GPUTaskContext &ctx) override;
+	void finish() override;
+
+	struct Stats {
+		uint64_t generated_blocks = 0;
+		uint64_t dispatches = 0;
+		// Invocations run by dispatches, and how many of them had a voxel to process. Some are wasted when boxes
+		// generated together have different sizes, or sizes that are not multiples of the work group size.
+		uint64_t dispatched_invocations = 0;
+		uint64_t useful_invocations = 0;
+	};
+
+	static Stats get_stats();
 
 	// TODO Not sure if it's worth dealing with sub-boxes. That's only in case of partially-edited meshing blocks...
 	// this case doesn't sound common enough.
@@ -78,15 +100,11 @@ public:
 	StdVector<ModifierData> modifiers;
 
 private:
-	struct BoxData {
-		GPUStorageBuffer params_sb;
-		Ref<RDUniform> params_uniform;
-		Ref<RDUniform> output_uniform;
-	};
-
-	StdVector<BoxData> _boxes_data;
+	// Resources used by the whole batch. Only the first task of a batch has them.
 	RID _generator_pipeline_rid;
 	StdVector<RID> _modifier_pipelines;
+
+	StdVector<GenerateBlockGPUTaskResult> _results;
 };
 
 } // namespace zylann::voxel
@@ -128,15 +128,11 @@ void GenerateBlockTask::run_cpu_generation() {
 	Ref<VoxelGenerator> generator = _stream_dependency->generator;
 
 	VoxelGenerator::VoxelQueryData query_data{ *_voxels, origin_in_voxels, _lod_index };
-	const VoxelGenerator::Result result = generator->generate_block(query_data);
+	query_data.min_feature_size = VoxelGenerator::get_min_feature_size_for_lod(_lod_index);
+	const VoxelGenerator::Result result = _data != nullptr
+			? generator->generate_block_with_modifiers(query_data, _data->get_modifiers())
+			: generator->generate_block(query_data);
 	_max_lod_hint = result.max_lod_hint;
-
-	if (_data != nullptr) {
-		_data->get_modifiers().apply(
-				query_data.voxel_buffer,
-				AABB(query_data.origin_in_voxels, query_data.voxel_buffer.get_size() << _lod_index)
-		);
-	}
 }
 
 void GenerateBlockTask::run_stream_saving_and_finish() {
@@ -212,9 +208,7 @@ void GenerateBlockTask::apply_result() {
 			o.max_lod_hint = _max_lod_hint;
 			o.initial_load = false;
 
-			VoxelEngine::VolumeCallbacks callbacks = VoxelEngine::get_singleton().get_volume_callbacks(_volume_id);
-			ERR_FAIL_COND(callbacks.data_output_callback == nullptr);
-			callbacks.data_output_callback(callbacks.data, o);
+			VoxelEngine::get_singleton().push_volume_data_output(_volume_id, o);
 
 			aborted = !_has_run;
 		}
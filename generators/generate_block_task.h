@@ -1,6 +1,7 @@
 #ifndef GENERATE_BLOCK_TASK_H
 #define GENERATE_BLOCK_TASK_H
 
+#include "../constants/voxel_constants.h"
 #include "../engine/ids.h"
 #include "../engine/priority_dependency.h"
 #include "../engine/streaming_dependency.h"
@@ -26,6 +27,10 @@ public:
 		return "GenerateBlock";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_GENERATION;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 	TaskPriority get_priority() override;
 	bool is_cancelled() override;
@@ -0,0 +1,79 @@
+#include "generate_series_task.h"
+#include "../constants/voxel_string_names.h"
+#include "../engine/voxel_engine.h"
+#include "../util/godot/core/packed_arrays.h"
+#include "../util/math/funcs.h"
+#include "../util/profiling.h"
+
+namespace zylann::voxel {
+
+void generate_series_in_chunks(
+		VoxelGenerator &generator,
+		Span<const float> positions_x,
+		Span<const float> positions_y,
+		Span<const float> positions_z,
+		unsigned int channel,
+		Span<float> out_values,
+		const ParallelJobsScheduler &scheduler
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(positions_x.size() == positions_y.size());
+	ZN_ASSERT_RETURN(positions_x.size() == positions_z.size());
+	ZN_ASSERT_RETURN(positions_x.size() == out_values.size());
+
+	const unsigned int count = positions_x.size();
+	const unsigned int chunk_count = math::ceildiv(count, GENERATE_SERIES_CHUNK_SIZE);
+
+	run_parallel_jobs(chunk_count, scheduler, [&](uint32_t chunk_index) {
+		ZN_PROFILE_SCOPE_NAMED("Series chunk");
+
+		const unsigned int begin = chunk_index * GENERATE_SERIES_CHUNK_SIZE;
+		const unsigned int size = math::min(GENERATE_SERIES_CHUNK_SIZE, count - begin);
+
+		Span<const float> chunk_x = positions_x.sub(begin, size);
+		Span<const float> chunk_y = positions_y.sub(begin, size);
+		Span<const float> chunk_z = positions_z.sub(begin, size);
+
+		// Bounds may be used by generators to optimize their work
+		Vector3f min_pos(chunk_x[0], chunk_y[0], chunk_z[0]);
+		Vector3f max_pos = min_pos;
+		for (unsigned int i = 1; i < size; ++i) {
+			const Vector3f pos(chunk_x[i], chunk_y[i], chunk_z[i]);
+			min_pos = math::min(min_pos, pos);
+			max_pos = math::max(max_pos, pos);
+		}
+
+		generator.generate_series(chunk_x, chunk_y, chunk_z, channel, out_values.sub(begin, size), min_pos, max_pos);
+	});
+}
+
+void GenerateSeriesTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(generator.is_valid());
+
+	VoxelEngine &engine = VoxelEngine::get_singleton();
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = [](Span<IThreadedTask *> tasks) { //
+		VoxelEngine::get_singleton().push_async_tasks(tasks);
+	};
+	const unsigned int thread_count = engine.get_thread_count();
+	scheduler.max_helpers = thread_count > 0 ? thread_count - 1 : 0;
+
+	PackedFloat32Array values;
+	values.resize(positions_x.size());
+	Span<float> values_s(values.ptrw(), values.size());
+
+	generate_series_in_chunks(
+			**generator,
+			to_span_const(positions_x),
+			to_span_const(positions_y),
+			to_span_const(positions_z),
+			channel,
+			values_s,
+			scheduler
+	);
+
+	generator->call_deferred(VoxelStringNames::get_singleton()._on_series_generated, request_id, values);
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,53 @@
+#ifndef VOXEL_GENERATE_SERIES_TASK_H
+#define VOXEL_GENERATE_SERIES_TASK_H
+
+#include "../constants/voxel_constants.h"
+#include "../util/containers/span.h"
+#include "../util/containers/std_vector.h"
+#include "../util/tasks/parallel_jobs.h"
+#include "../util/tasks/threaded_task.h"
+#include "voxel_generator.h"
+
+namespace zylann::voxel {
+
+// Series are generated in chunks of this many positions. Besides allowing to spread work over threads, it bounds the
+// memory generators need when they process a whole series at once.
+static const unsigned int GENERATE_SERIES_CHUNK_SIZE = 4096;
+
+// Generates values of a large series of positions in chunks, which can run on multiple threads if a scheduler is
+// provided. Returns when all values are generated. The generator must support series generation.
+void generate_series_in_chunks(
+		VoxelGenerator &generator,
+		Span<const float> positions_x,
+		Span<const float> positions_y,
+		Span<const float> positions_z,
+		unsigned int channel,
+		Span<float> out_values,
+		const ParallelJobsScheduler &scheduler
+);
+
+// Generates a series using the thread pool, then passes results to the generator on the main thread.
+class GenerateSeriesTask : public IThreadedTask {
+public:
+	Ref<VoxelGenerator> generator;
+	StdVector<float> positions_x;
+	StdVector<float> positions_y;
+	StdVector<float> positions_z;
+	unsigned int channel = 0;
+	// Identifies the request when results are received
+	int request_id = 0;
+
+	const char *get_debug_name() const override {
+		return "GenerateSeries";
+	}
+
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_GENERATION;
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_GENERATE_SERIES_TASK_H
@@ -0,0 +1,544 @@
+#include "expression_bytecode.h"
+#include "../../util/errors.h"
+#include "../../util/math/float4.h"
+#include "../../util/math/funcs.h"
+#include "nodes/util.h"
+#include "voxel_graph_function.h"
+
+namespace zylann::voxel::pg {
+
+namespace {
+
+typedef ExpressionBytecode::Opcode Opcode;
+
+unsigned int get_argument_count(Opcode opcode) {
+	switch (opcode) {
+		case ExpressionBytecode::OP_POWI:
+		case ExpressionBytecode::OP_SIN:
+		case ExpressionBytecode::OP_FLOOR:
+		case ExpressionBytecode::OP_ABS:
+		case ExpressionBytecode::OP_SQRT:
+		case ExpressionBytecode::OP_FRACT:
+			return 1;
+		case ExpressionBytecode::OP_CLAMP:
+		case ExpressionBytecode::OP_MIX:
+			return 3;
+		default:
+			return 2;
+	}
+}
+
+// Scalar version of instructions. Results must be the same as the nodes the expression would be expanded into.
+inline float evaluate(Opcode opcode, float a, float b, float c, unsigned int power) {
+	switch (opcode) {
+		case ExpressionBytecode::OP_ADD:
+			return a + b;
+		case ExpressionBytecode::OP_SUBTRACT:
+			return a - b;
+		case ExpressionBytecode::OP_MULTIPLY:
+			return a * b;
+		case ExpressionBytecode::OP_DIVIDE:
+			return b == 0.f ? 0.f : a / b;
+		case ExpressionBytecode::OP_POW:
+			return Math::pow(a, b);
+		case ExpressionBytecode::OP_POWI: {
+			float v = 1.f;
+			for (unsigned int p = 0; p < power; ++p) {
+				v *= a;
+			}
+			return v;
+		}
+		case ExpressionBytecode::OP_SIN:
+			return Math::sin(a);
+		case ExpressionBytecode::OP_FLOOR:
+			return Math::floor(a);
+		case ExpressionBytecode::OP_ABS:
+			return Math::abs(a);
+		case ExpressionBytecode::OP_SQRT:
+			return Math::sqrt(math::max(a, 0.f));
+		case ExpressionBytecode::OP_FRACT:
+			return a - Math::floor(a);
+		case ExpressionBytecode::OP_STEPIFY:
+			return math::snappedf(a, b);
+		case ExpressionBytecode::OP_WRAP:
+			return math::wrapf(a, b);
+		case ExpressionBytecode::OP_MIN:
+			return math::min(a, b);
+		case ExpressionBytecode::OP_MAX:
+			return math::max(a, b);
+		case ExpressionBytecode::OP_CLAMP:
+			return math::clamp(a, b, c);
+		case ExpressionBytecode::OP_MIX:
+			return Math::lerp(a, b, c);
+		default:
+			ZN_CRASH();
+			return 0.f;
+	}
+}
+
+void run_instruction(
+		const ExpressionBytecode::Instruction &instruction,
+		Span<const float *const> sources,
+		float *dst,
+		const unsigned int size
+) {
+	const float *a = sources[instruction.args[0]];
+	const unsigned int argument_count = get_argument_count(instruction.opcode);
+	const float *b = argument_count > 1 ? sources[instruction.args[1]] : nullptr;
+	const float *c = argument_count > 2 ? sources[instruction.args[2]] : nullptr;
+
+	switch (instruction.opcode) {
+		case ExpressionBytecode::OP_ADD:
+			transform_float4(dst, a, b, size, [](auto x, auto y) { return x + y; });
+			break;
+		case ExpressionBytecode::OP_SUBTRACT:
+			transform_float4(dst, a, b, size, [](auto x, auto y) { return x - y; });
+			break;
+		case ExpressionBytecode::OP_MULTIPLY:
+			transform_float4(dst, a, b, size, [](auto x, auto y) { return x * y; });
+			break;
+		case ExpressionBytecode::OP_MIN:
+			transform_float4(dst, a, b, size, [](auto x, auto y) { return math::min(x, y); });
+			break;
+		case ExpressionBytecode::OP_MAX:
+			transform_float4(dst, a, b, size, [](auto x, auto y) { return math::max(x, y); });
+			break;
+		case ExpressionBytecode::OP_CLAMP:
+			transform_float4(dst, a, b, c, size, [](auto x, auto lo, auto hi) { return math::clamp(x, lo, hi); });
+			break;
+		case ExpressionBytecode::OP_MIX:
+			transform_float4(dst, a, b, c, size, [](auto x, auto y, auto t) { return math::lerp(x, y, t); });
+			break;
+		default:
+			// No vectorized version
+			for (unsigned int i = 0; i < size; ++i) {
+				dst[i] = evaluate(
+						instruction.opcode,
+						a[i],
+						b != nullptr ? b[i] : 0.f,
+						c != nullptr ? c[i] : 0.f,
+						instruction.power
+				);
+			}
+			break;
+	}
+}
+
+math::Interval analyze_instruction_range(
+		const ExpressionBytecode::Instruction &instruction,
+		Span<const math::Interval> ranges
+) {
+	using namespace math;
+
+	const Interval a = ranges[instruction.args[0]];
+	const unsigned int argument_count = get_argument_count(instruction.opcode);
+	const Interval b = argument_count > 1 ? ranges[instruction.args[1]] : Interval();
+	const Interval c = argument_count > 2 ? ranges[instruction.args[2]] : Interval();
+
+	switch (instruction.opcode) {
+		case ExpressionBytecode::OP_ADD:
+			return a + b;
+		case ExpressionBytecode::OP_SUBTRACT:
+			return a - b;
+		case ExpressionBytecode::OP_MULTIPLY:
+			if (instruction.args[0] == instruction.args[1]) {
+				// Same operand on both sides, the result can't be negative
+				return squared(a);
+			}
+			return a * b;
+		case ExpressionBytecode::OP_DIVIDE:
+			return a / b;
+		case ExpressionBytecode::OP_POW:
+			return pow(a, b);
+		case ExpressionBytecode::OP_POWI:
+			return powi(a, instruction.power);
+		case ExpressionBytecode::OP_SIN:
+			return sin(a);
+		case ExpressionBytecode::OP_FLOOR:
+			return floor(a);
+		case ExpressionBytecode::OP_ABS:
+			return abs(a);
+		case ExpressionBytecode::OP_SQRT:
+			return sqrt(a);
+		case ExpressionBytecode::OP_FRACT:
+			return a - floor(a);
+		case ExpressionBytecode::OP_STEPIFY:
+			return snapped(a, b);
+		case ExpressionBytecode::OP_WRAP:
+			return wrapf(a, b);
+		case ExpressionBytecode::OP_MIN:
+			return min_interval(a, b);
+		case ExpressionBytecode::OP_MAX:
+			return max_interval(a, b);
+		case ExpressionBytecode::OP_CLAMP:
+			return clamp(a, b, c);
+		case ExpressionBytecode::OP_MIX:
+			return lerp(a, b, c);
+		default:
+			ZN_CRASH();
+			return Interval();
+	}
+}
+
+bool try_get_opcode_from_function_id(unsigned int function_id, Opcode &out_opcode) {
+	switch (function_id) {
+		case VoxelGraphFunction::NODE_SIN:
+			out_opcode = ExpressionBytecode::OP_SIN;
+			return true;
+		case VoxelGraphFunction::NODE_FLOOR:
+			out_opcode = ExpressionBytecode::OP_FLOOR;
+			return true;
+		case VoxelGraphFunction::NODE_ABS:
+			out_opcode = ExpressionBytecode::OP_ABS;
+			return true;
+		case VoxelGraphFunction::NODE_SQRT:
+			out_opcode = ExpressionBytecode::OP_SQRT;
+			return true;
+		case VoxelGraphFunction::NODE_FRACT:
+			out_opcode = ExpressionBytecode::OP_FRACT;
+			return true;
+		case VoxelGraphFunction::NODE_STEPIFY:
+			out_opcode = ExpressionBytecode::OP_STEPIFY;
+			return true;
+		case VoxelGraphFunction::NODE_WRAP:
+			out_opcode = ExpressionBytecode::OP_WRAP;
+			return true;
+		case VoxelGraphFunction::NODE_MIN:
+			out_opcode = ExpressionBytecode::OP_MIN;
+			return true;
+		case VoxelGraphFunction::NODE_MAX:
+			out_opcode = ExpressionBytecode::OP_MAX;
+			return true;
+		case VoxelGraphFunction::NODE_CLAMP:
+			out_opcode = ExpressionBytecode::OP_CLAMP;
+			return true;
+		case VoxelGraphFunction::NODE_MIX:
+			out_opcode = ExpressionBytecode::OP_MIX;
+			return true;
+		default:
+			return false;
+	}
+}
+
+class ExpressionBytecodeCompiler {
+public:
+	ExpressionBytecodeCompiler(Span<const std::string_view> input_names) : _input_names(input_names) {}
+
+	bool compile(const ExpressionParser::Node &root, ExpressionBytecode &bytecode) {
+		Operand result;
+		if (!compile_node(root, result)) {
+			return false;
+		}
+		if (result.kind == Operand::CONSTANT) {
+			// The whole expression is a number
+			result = Operand::from_constant_index(add_constant(result.value));
+		}
+
+		const unsigned int constants_begin = _input_names.size();
+		const unsigned int temporaries_begin = constants_begin + _constants.size();
+		if (temporaries_begin + _temporaries_count > ExpressionBytecode::MAX_REGISTERS) {
+			return false;
+		}
+
+		bytecode.inputs_count = _input_names.size();
+		bytecode.constants = _constants;
+		bytecode.constant_chunks.resize(_constants.size() * ExpressionBytecode::CHUNK_SIZE);
+		for (unsigned int i = 0; i < _constants.size(); ++i) {
+			for (unsigned int j = 0; j < ExpressionBytecode::CHUNK_SIZE; ++j) {
+				bytecode.constant_chunks[i * ExpressionBytecode::CHUNK_SIZE + j] = _constants[i];
+			}
+		}
+		bytecode.temporaries_count = _temporaries_count;
+
+		bytecode.instructions.clear();
+		bytecode.instructions.reserve(_instructions.size());
+		for (const PendingInstruction &pi : _instructions) {
+			ExpressionBytecode::Instruction instruction;
+			instruction.opcode = pi.opcode;
+			instruction.dst = temporaries_begin + pi.dst;
+			instruction.power = pi.power;
+			for (unsigned int i = 0; i < instruction.args.size(); ++i) {
+				instruction.args[i] = get_register(pi.args[i], constants_begin, temporaries_begin);
+			}
+			bytecode.instructions.push_back(instruction);
+		}
+
+		bytecode.result_register = get_register(result, constants_begin, temporaries_begin);
+		return true;
+	}
+
+private:
+	struct Operand {
+		enum Kind : uint8_t { INPUT, CONSTANT, TEMPORARY };
+
+		Kind kind = CONSTANT;
+		// Index within inputs, constants or temporaries. Not assigned for constants until an instruction uses them.
+		uint8_t index = 0;
+		float value = 0.f;
+
+		static Operand from_value(float v) {
+			Operand o;
+			o.kind = CONSTANT;
+			o.value = v;
+			return o;
+		}
+
+		static Operand from_constant_index(uint8_t i) {
+			Operand o;
+			o.kind = CONSTANT;
+			o.index = i;
+			return o;
+		}
+
+		static Operand from_index(Kind kind, uint8_t i) {
+			Operand o;
+			o.kind = kind;
+			o.index = i;
+			return o;
+		}
+	};
+
+	// Instruction whose registers are not numbered yet, because we only know how many constants there are at the end
+	struct PendingInstruction {
+		Opcode opcode;
+		uint8_t dst;
+		uint8_t power;
+		FixedArray<Operand, 3> args;
+	};
+
+	static uint8_t get_register(const Operand &o, unsigned int constants_begin, unsigned int temporaries_begin) {
+		switch (o.kind) {
+			case Operand::INPUT:
+				return o.index;
+			case Operand::CONSTANT:
+				return constants_begin + o.index;
+			case Operand::TEMPORARY:
+				return temporaries_begin + o.index;
+			default:
+				ZN_CRASH();
+				return 0;
+		}
+	}
+
+	uint8_t add_constant(float v) {
+		for (unsigned int i = 0; i < _constants.size(); ++i) {
+			if (_constants[i] == v) {
+				return i;
+			}
+		}
+		_constants.push_back(v);
+		return _constants.size() - 1;
+	}
+
+	bool compile_node(const ExpressionParser::Node &node, Operand &out_operand) {
+		switch (node.type) {
+			case ExpressionParser::Node::NUMBER: {
+				const ExpressionParser::NumberNode &nn = static_cast<const ExpressionParser::NumberNode &>(node);
+				out_operand = Operand::from_value(nn.value);
+				return true;
+			}
+
+			case ExpressionParser::Node::VARIABLE: {
+				const ExpressionParser::VariableNode &vn = static_cast<const ExpressionParser::VariableNode &>(node);
+				for (unsigned int i = 0; i < _input_names.size(); ++i) {
+					if (_input_names[i] == vn.name) {
+						out_operand = Operand::from_index(Operand::INPUT, i);
+						return true;
+					}
+				}
+				return false;
+			}
+
+			case ExpressionParser::Node::OPERATOR: {
+				const ExpressionParser::OperatorNode &on = static_cast<const ExpressionParser::OperatorNode &>(node);
+				ZN_ASSERT_RETURN_V(on.n0 != nullptr, false);
+				ZN_ASSERT_RETURN_V(on.n1 != nullptr, false);
+
+				FixedArray<Operand, 3> args;
+				if (!compile_node(*on.n0, args[0]) || !compile_node(*on.n1, args[1])) {
+					return false;
+				}
+
+				switch (on.op) {
+					case ExpressionParser::OperatorNode::ADD:
+						return emit(ExpressionBytecode::OP_ADD, args, 0, out_operand);
+					case ExpressionParser::OperatorNode::SUBTRACT:
+						return emit(ExpressionBytecode::OP_SUBTRACT, args, 0, out_operand);
+					case ExpressionParser::OperatorNode::MULTIPLY:
+						return emit(ExpressionBytecode::OP_MULTIPLY, args, 0, out_operand);
+					case ExpressionParser::OperatorNode::DIVIDE:
+						return emit(ExpressionBytecode::OP_DIVIDE, args, 0, out_operand);
+					case ExpressionParser::OperatorNode::POWER:
+						if (args[1].kind == Operand::CONSTANT) {
+							// Same as expansion, use a cheaper instruction if the power is a small positive integer
+							const int pi = int(args[1].value);
+							if (Math::is_equal_approx(args[1].value, pi) && pi >= 0 && pi <= 255) {
+								return emit(ExpressionBytecode::OP_POWI, args, pi, out_operand);
+							}
+						}
+						return emit(ExpressionBytecode::OP_POW, args, 0, out_operand);
+					default:
+						return false;
+				}
+			}
+
+			case ExpressionParser::Node::FUNCTION: {
+				const ExpressionParser::FunctionNode &fn = static_cast<const ExpressionParser::FunctionNode &>(node);
+				Opcode opcode;
+				if (!try_get_opcode_from_function_id(fn.function_id, opcode)) {
+					return false;
+				}
+				FixedArray<Operand, 3> args;
+				const unsigned int argument_count = get_argument_count(opcode);
+				for (unsigned int i = 0; i < argument_count; ++i) {
+					const ExpressionParser::Node *arg = fn.args[i].get();
+					ZN_ASSERT_RETURN_V(arg != nullptr, false);
+					if (!compile_node(*arg, args[i])) {
+						return false;
+					}
+				}
+				return emit(opcode, args, 0, out_operand);
+			}
+
+			default:
+				return false;
+		}
+	}
+
+	bool emit(Opcode opcode, FixedArray<Operand, 3> args, unsigned int power, Operand &out_operand) {
+		const unsigned int argument_count = get_argument_count(opcode);
+
+		bool all_constant = true;
+		for (unsigned int i = 0; i < argument_count; ++i) {
+			if (args[i].kind != Operand::CONSTANT) {
+				all_constant = false;
+				break;
+			}
+		}
+		if (all_constant) {
+			out_operand = Operand::from_value(evaluate(opcode, args[0].value, args[1].value, args[2].value, power));
+			return true;
+		}
+
+		PendingInstruction instruction;
+		instruction.opcode = opcode;
+		instruction.power = power;
+
+		for (unsigned int i = 0; i < instruction.args.size(); ++i) {
+			Operand &arg = args[i];
+			if (i >= argument_count) {
+				// Unused, point at a valid register anyways
+				arg = args[0];
+			}
+			if (arg.kind == Operand::CONSTANT) {
+				arg = Operand::from_constant_index(add_constant(arg.value));
+			}
+			instruction.args[i] = arg;
+		}
+
+		// Expressions are trees, so temporaries are read only once and can be re-used right away
+		for (unsigned int i = 0; i < argument_count; ++i) {
+			const Operand &arg = args[i];
+			if (arg.kind == Operand::TEMPORARY) {
+				_free_temporaries.push_back(arg.index);
+			}
+		}
+		if (_free_temporaries.size() > 0) {
+			instruction.dst = _free_temporaries.back();
+			_free_temporaries.pop_back();
+		} else {
+			if (_temporaries_count == ExpressionBytecode::MAX_TEMPORARIES) {
+				return false;
+			}
+			instruction.dst = _temporaries_count;
+			++_temporaries_count;
+		}
+
+		_instructions.push_back(instruction);
+		out_operand = Operand::from_index(Operand::TEMPORARY, instruction.dst);
+		return true;
+	}
+
+	Span<const std::string_view> _input_names;
+	StdVector<float> _constants;
+	StdVector<PendingInstruction> _instructions;
+	StdVector<uint8_t> _free_temporaries;
+	unsigned int _temporaries_count = 0;
+};
+
+} // namespace
+
+void ExpressionBytecode::run(Span<const float *const> inputs, float *output, const unsigned int size) const {
+	ZN_ASSERT_RETURN(inputs.size() == inputs_count);
+	ZN_ASSERT_RETURN(temporaries_count <= MAX_TEMPORARIES);
+
+	FixedArray<float, MAX_TEMPORARIES * CHUNK_SIZE> temporaries;
+	// Where each register reads its values from in the current chunk
+	FixedArray<const float *, MAX_REGISTERS> sources;
+
+	const unsigned int constants_begin = inputs_count;
+	const unsigned int temporaries_begin = inputs_count + constants.size();
+	for (unsigned int i = 0; i < constants.size(); ++i) {
+		sources[constants_begin + i] = &constant_chunks[i * CHUNK_SIZE];
+	}
+	for (unsigned int i = 0; i < temporaries_count; ++i) {
+		sources[temporaries_begin + i] = &temporaries[i * CHUNK_SIZE];
+	}
+	const Span<const float *const> sources_span(sources.data(), get_register_count());
+
+	for (unsigned int chunk_begin = 0; chunk_begin < size; chunk_begin += CHUNK_SIZE) {
+		const unsigned int chunk_size = math::min(size - chunk_begin, CHUNK_SIZE);
+		float *chunk_output = output + chunk_begin;
+
+		for (unsigned int i = 0; i < inputs_count; ++i) {
+			sources[i] = inputs[i] + chunk_begin;
+		}
+
+		if (instructions.size() == 0) {
+			const float *src = sources[result_register];
+			for (unsigned int i = 0; i < chunk_size; ++i) {
+				chunk_output[i] = src[i];
+			}
+			continue;
+		}
+
+		for (unsigned int instruction_index = 0; instruction_index < instructions.size(); ++instruction_index) {
+			const Instruction &instruction = instructions[instruction_index];
+			// The last instruction gives the result, so it writes directly to the output
+			float *dst = instruction_index + 1 == instructions.size()
+					? chunk_output
+					: &temporaries[(instruction.dst - temporaries_begin) * CHUNK_SIZE];
+			run_instruction(instruction, sources_span, dst, chunk_size);
+		}
+	}
+}
+
+math::Interval ExpressionBytecode::analyze_range(Span<const math::Interval> inputs) const {
+	ZN_ASSERT_RETURN_V(inputs.size() == inputs_count, math::Interval::from_infinity());
+
+	FixedArray<math::Interval, MAX_REGISTERS> ranges;
+	for (unsigned int i = 0; i < inputs_count; ++i) {
+		ranges[i] = inputs[i];
+	}
+	for (unsigned int i = 0; i < constants.size(); ++i) {
+		ranges[inputs_count + i] = math::Interval::from_single_value(constants[i]);
+	}
+	const Span<const math::Interval> ranges_span(ranges.data(), get_register_count());
+
+	for (const Instruction &instruction : instructions) {
+		ranges[instruction.dst] = analyze_instruction_range(instruction, ranges_span);
+	}
+
+	return ranges[result_register];
+}
+
+bool compile_expression_bytecode(
+		const ExpressionParser::Node &root,
+		Span<const std::string_view> input_names,
+		ExpressionBytecode &out_bytecode
+) {
+	ExpressionBytecodeCompiler compiler(input_names);
+	return compiler.compile(root, out_bytecode);
+}
+
+} // namespace zylann::voxel::pg
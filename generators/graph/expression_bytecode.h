@@ -0,0 +1,86 @@
+#ifndef VOXEL_GRAPH_EXPRESSION_BYTECODE_H
+#define VOXEL_GRAPH_EXPRESSION_BYTECODE_H
+
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/interval.h"
+#include "../../util/string/expression_parser.h"
+#include <string_view>
+
+namespace zylann::voxel::pg {
+
+// Expression compiled into a short list of instructions working on registers, so it can run as a single operation of
+// the graph runtime. Sub-expressions don't need their own buffer and dispatch, and values are processed by small
+// chunks so intermediate results stay in cache.
+struct ExpressionBytecode {
+	enum Opcode : uint8_t {
+		OP_ADD,
+		OP_SUBTRACT,
+		OP_MULTIPLY,
+		OP_DIVIDE,
+		OP_POW,
+		OP_POWI,
+		OP_SIN,
+		OP_FLOOR,
+		OP_ABS,
+		OP_SQRT,
+		OP_FRACT,
+		OP_STEPIFY,
+		OP_WRAP,
+		OP_MIN,
+		OP_MAX,
+		OP_CLAMP,
+		OP_MIX,
+		OP_COUNT
+	};
+
+	struct Instruction {
+		Opcode opcode;
+		// Register receiving the result. Always a temporary.
+		uint8_t dst;
+		// Exponent, only used by `OP_POWI`
+		uint8_t power;
+		// Registers of arguments. Only the first ones are used, depending on the opcode.
+		FixedArray<uint8_t, 3> args;
+	};
+
+	// Registers are numbered with inputs first, then constants, then temporaries
+	static constexpr unsigned int MAX_REGISTERS = 256;
+	// Temporaries are re-used as soon as their value was consumed, so few are needed even for long expressions
+	static constexpr unsigned int MAX_TEMPORARIES = 16;
+	// Values are processed by chunks of this size, so temporaries can be allocated on the stack
+	static constexpr unsigned int CHUNK_SIZE = 32;
+
+	unsigned int inputs_count = 0;
+	StdVector<float> constants;
+	// Each constant repeated to fill a chunk, so instructions can read them like any other register
+	StdVector<float> constant_chunks;
+	unsigned int temporaries_count = 0;
+	StdVector<Instruction> instructions;
+	// Register holding the result once all instructions ran
+	uint8_t result_register = 0;
+
+	inline unsigned int get_register_count() const {
+		return inputs_count + constants.size() + temporaries_count;
+	}
+
+	// Evaluates the expression for `size` values. `inputs` has one pointer per input, each to `size` values.
+	void run(Span<const float *const> inputs, float *output, unsigned int size) const;
+
+	// Gets the range of values the expression can output, given the range of each input
+	math::Interval analyze_range(Span<const math::Interval> inputs) const;
+};
+
+// Compiles the tree of a parsed expression. Variables are mapped to inputs in the same order as `input_names`.
+// Sub-expressions made only of numbers are folded. Returns false if the expression can't be represented, for example if
+// it uses an unknown variable or function, or needs too many registers.
+bool compile_expression_bytecode(
+		const ExpressionParser::Node &root,
+		Span<const std::string_view> input_names,
+		ExpressionBytecode &out_bytecode
+);
+
+} // namespace zylann::voxel::pg
+
+#endif // VOXEL_GRAPH_EXPRESSION_BYTECODE_H
@@ -81,6 +81,9 @@ struct NodeType {
 	bool debug_only = false;
 	// Pseudo nodes are replaced during compilation with one or multiple real nodes, they have no logic on their own
 	bool is_pseudo_node = false;
+	// If true, `inputs` is not used. Instead, each node of this type has its own inputs, and their count is stored in
+	// the program before the addresses of inputs.
+	bool has_dynamic_inputs = false;
 	Category category;
 	StdVector<Port> inputs;
 	StdVector<Port> outputs;
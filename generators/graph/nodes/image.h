@@ -3,6 +3,8 @@
 #include "../../../util/profiling.h"
 #include "../image_range_grid.h"
 #include "../node_type_db.h"
+#include "../tiled_image.h"
+#include <limits>
 
 namespace zylann::voxel::pg {
 
@@ -28,6 +30,24 @@ inline float get_pixel_repeat_linear(const Image &im, float x, float y, int im_w
 	return h;
 }
 
+// Estimates how far apart samples are, as the smallest non-zero distance between consecutive coordinates. Series of
+// coordinates usually come from grids, where consecutive samples are neighbors except when moving to the next row.
+// Distorted coordinates give a smaller step, which is the conservative choice.
+inline float get_min_sample_step(Span<const float> x, Span<const float> y) {
+	float min_step = std::numeric_limits<float>::max();
+	for (unsigned int i = 1; i < x.size(); ++i) {
+		const float step = math::max(Math::abs(x[i] - x[i - 1]), Math::abs(y[i] - y[i - 1]));
+		if (step > 0.f && step < min_step) {
+			min_step = step;
+		}
+	}
+	if (min_step == std::numeric_limits<float>::max()) {
+		// All samples are at the same place
+		return 1.f;
+	}
+	return min_step;
+}
+
 inline float skew3(float x) {
 	return (x * x * x + x) * 0.5f;
 }
@@ -120,7 +140,7 @@ void register_image_nodes(Span<NodeType> types) {
 	{
 		enum Filter : uint32_t { FILTER_NEAREST = 0, FILTER_BILINEAR };
 		struct Params {
-			const Image *image;
+			const TiledImage *tiled_image;
 			const ImageRangeGrid *image_range_grid;
 			Filter filter;
 		};
@@ -155,11 +175,21 @@ void register_image_nodes(Span<NodeType> types) {
 			ImageRangeGrid *im_range = ZN_NEW(ImageRangeGrid);
 			im_range->generate(**image);
 			Params p;
-			p.image = *image;
 			p.image_range_grid = im_range;
 			p.filter = static_cast<Filter>(static_cast<int>(ctx.get_param(1)));
+			// Pixels are copied into a layout faster to sample. Nearest filtering samples exact pixels, so it doesn't
+			// use mipmaps.
+			TiledImage *tiled_image = ZN_NEW(TiledImage);
+			tiled_image->generate(
+					**image,
+					p.filter == FILTER_BILINEAR,
+					TiledImage::DEFAULT_MEMORY_MAPPING_THRESHOLD,
+					TiledImage::DEFAULT_TEMP_DIRECTORY
+			);
+			p.tiled_image = tiled_image;
 			ctx.set_params(p);
 			ctx.add_delete_cleanup(im_range);
+			ctx.add_delete_cleanup(tiled_image);
 		};
 		t.process_buffer_func = [](Runtime::ProcessBufferContext &ctx) {
 			ZN_PROFILE_SCOPE_NAMED("NODE_IMAGE_2D");
@@ -167,25 +197,24 @@ void register_image_nodes(Span<NodeType> types) {
 			const Runtime::Buffer &y = ctx.get_input(1);
 			Runtime::Buffer &out = ctx.get_output(0);
 			const Params p = ctx.get_params<Params>();
-			const Image &im = *p.image;
-			// Cache image size to reduce API calls in GDExtension
-			const int w = im.get_width();
-			const int h = im.get_height();
+			const TiledImage &im = *p.tiled_image;
 #ifdef DEBUG_ENABLED
-			if (w == 0 || h == 0) {
+			if (im.get_mip_count() == 0) {
 				ZN_PRINT_ERROR_ONCE("Image is empty");
 				return;
 			}
 #endif
-			// TODO Optimized path for most used formats, `get_pixel` is kinda slow
 			if (p.filter == FILTER_NEAREST) {
 				for (uint32_t i = 0; i < out.size; ++i) {
-					out.data[i] = get_pixel_repeat(im, x.data[i], y.data[i], w, h);
+					out.data[i] = im.get_pixel_repeat(0, int(x.data[i]), int(y.data[i]));
 				}
 			} else {
-				for (uint32_t i = 0; i < out.size; ++i) {
-					out.data[i] = get_pixel_repeat_linear(im, x.data[i], y.data[i], w, h);
-				}
+				const Span<const float> xs(x.data, out.size);
+				const Span<const float> ys(y.data, out.size);
+				// Far from viewers, samples are spaced by several pixels. Sampling mipmaps then gives a smoother
+				// result and accesses much less memory.
+				const unsigned int mip_index = im.get_mip_for_step(get_min_sample_step(xs, ys));
+				im.get_pixels_repeat_linear(mip_index, xs, ys, Span<float>(out.data, out.size));
 			}
 		};
 		t.range_analysis_func = [](Runtime::RangeAnalysisContext &ctx) {
@@ -185,7 +185,7 @@ void register_math_func_nodes(Span<NodeType> types) {
 		t.inputs.push_back(NodeType::Port("b", 0.f, VoxelGraphFunction::AUTO_CONNECT_NONE, false));
 		t.outputs.push_back(NodeType::Port("out"));
 		t.process_buffer_func = [](ProcessBufferContext &ctx) {
-			do_binop(ctx, [](float a, float b) { return min(a, b); });
+			do_binop_float4(ctx, [](auto a, auto b) { return min(a, b); });
 		};
 		t.range_analysis_func = [](RangeAnalysisContext &ctx) {
 			const Interval a = ctx.get_input(0);
@@ -208,7 +208,7 @@ void register_math_func_nodes(Span<NodeType> types) {
 		t.inputs.push_back(NodeType::Port("b", 0.f, VoxelGraphFunction::AUTO_CONNECT_NONE, false));
 		t.outputs.push_back(NodeType::Port("out"));
 		t.process_buffer_func = [](ProcessBufferContext &ctx) {
-			do_binop(ctx, [](float a, float b) { return max(a, b); });
+			do_binop_float4(ctx, [](auto a, auto b) { return max(a, b); });
 		};
 		t.range_analysis_func = [](RangeAnalysisContext &ctx) {
 			const Interval a = ctx.get_input(0);
@@ -236,9 +236,9 @@ void register_math_func_nodes(Span<NodeType> types) {
 			const Runtime::Buffer &minv = ctx.get_input(1);
 			const Runtime::Buffer &maxv = ctx.get_input(2);
 			Runtime::Buffer &out = ctx.get_output(0);
-			for (uint32_t i = 0; i < out.size; ++i) {
-				out.data[i] = clamp(a.data[i], minv.data[i], maxv.data[i]);
-			}
+			transform_float4(out.data, a.data, minv.data, maxv.data, out.size, [](auto x, auto lo, auto hi) { //
+				return clamp(x, lo, hi);
+			});
 		};
 		t.range_analysis_func = [](RangeAnalysisContext &ctx) {
 			const Interval a = ctx.get_input(0);
@@ -282,9 +282,10 @@ void register_math_func_nodes(Span<NodeType> types) {
 			const Runtime::Buffer &a = ctx.get_input(0);
 			Runtime::Buffer &out = ctx.get_output(0);
 			const Params p = ctx.get_params<Params>();
-			for (uint32_t i = 0; i < out.size; ++i) {
-				out.data[i] = clamp(a.data[i], p.min, p.max);
-			}
+			transform_float4(out.data, a.data, out.size, [&p](auto x) {
+				typedef decltype(x) T;
+				return clamp(x, T(p.min), T(p.max));
+			});
 		};
 		t.range_analysis_func = [](RangeAnalysisContext &ctx) {
 			const Interval a = ctx.get_input(0);
@@ -324,18 +325,20 @@ void register_math_func_nodes(Span<NodeType> types) {
 				const float ca = a.constant_value;
 				if (b.is_constant) {
 					const float cb = b.constant_value;
-					for (uint32_t i = 0; i < buffer_size; ++i) {
-						out.data[i] = Math::lerp(ca, cb, r.data[i]);
-					}
+					transform_float4(out.data, r.data, buffer_size, [ca, cb](auto t) {
+						typedef decltype(t) T;
+						return lerp(T(ca), T(cb), t);
+					});
 				} else {
 					if (b_ignored) {
 						for (uint32_t i = 0; i < buffer_size; ++i) {
 							out.data[i] = ca;
 						}
 					} else {
-						for (uint32_t i = 0; i < buffer_size; ++i) {
-							out.data[i] = Math::lerp(ca, b.data[i], r.data[i]);
-						}
+						transform_float4(out.data, b.data, r.data, buffer_size, [ca](auto vb, auto t) {
+							typedef decltype(t) T;
+							return lerp(T(ca), vb, t);
+						});
 					}
 				}
 			} else if (b.is_constant) {
@@ -345,9 +348,10 @@ void register_math_func_nodes(Span<NodeType> types) {
 						out.data[i] = cb;
 					}
 				} else {
-					for (uint32_t i = 0; i < buffer_size; ++i) {
-						out.data[i] = Math::lerp(a.data[i], cb, r.data[i]);
-					}
+					transform_float4(out.data, a.data, r.data, buffer_size, [cb](auto va, auto t) {
+						typedef decltype(t) T;
+						return lerp(va, T(cb), t);
+					});
 				}
 			} else {
 				if (a_ignored) {
@@ -359,9 +363,9 @@ void register_math_func_nodes(Span<NodeType> types) {
 						out.data[i] = a.data[i];
 					}
 				} else {
-					for (uint32_t i = 0; i < buffer_size; ++i) {
-						out.data[i] = Math::lerp(a.data[i], b.data[i], r.data[i]);
-					}
+					transform_float4(out.data, a.data, b.data, r.data, buffer_size, [](auto va, auto vb, auto t) { //
+						return lerp(va, vb, t);
+					});
 				}
 			}
 		};
@@ -429,9 +433,10 @@ void register_math_func_nodes(Span<NodeType> types) {
 			const Runtime::Buffer &x = ctx.get_input(0);
 			Runtime::Buffer &out = ctx.get_output(0);
 			const Params p = ctx.get_params<Params>();
-			for (uint32_t i = 0; i < out.size; ++i) {
-				out.data[i] = p.a * x.data[i] + p.b;
-			}
+			transform_float4(out.data, x.data, out.size, [&p](auto v) {
+				typedef decltype(v) T;
+				return T(p.a) * v + T(p.b);
+			});
 		};
 		t.range_analysis_func = [](RangeAnalysisContext &ctx) {
 			const Interval x = ctx.get_input(0);
@@ -467,9 +472,18 @@ void register_math_func_nodes(Span<NodeType> types) {
 			const Runtime::Buffer &a = ctx.get_input(0);
 			Runtime::Buffer &out = ctx.get_output(0);
 			const Params p = ctx.get_params<Params>();
-			for (uint32_t i = 0; i < out.size; ++i) {
-				out.data[i] = smoothstep(p.edge0, p.edge1, a.data[i]);
+			if (Math::is_equal_approx(p.edge0, p.edge1)) {
+				// Same special case as `math::smoothstep`
+				for (uint32_t i = 0; i < out.size; ++i) {
+					out.data[i] = p.edge0;
+				}
+				return;
 			}
+			transform_float4(out.data, a.data, out.size, [&p](auto w) {
+				typedef decltype(w) T;
+				const T x = clamp((w - T(p.edge0)) / (T(p.edge1) - T(p.edge0)), T(0.f), T(1.f));
+				return x * x * (T(3.f) - T(2.f) * x);
+			});
 		};
 		t.range_analysis_func = [](RangeAnalysisContext &ctx) {
 			const Interval a = ctx.get_input(0);
@@ -526,9 +540,10 @@ void register_math_func_nodes(Span<NodeType> types) {
 					break;
 				default:
 					for (unsigned int i = 0; i < out.size; ++i) {
-						float v = x.data[i];
+						const float b = x.data[i];
+						float v = b;
 						for (unsigned int p = 1; p < power; ++p) {
-							v *= v;
+							v *= b;
 						}
 						out.data[i] = v;
 					}
@@ -1,3 +1,4 @@
+#include "../expression_bytecode.h"
 #include "../node_type_db.h"
 
 namespace zylann::voxel::pg {
@@ -132,6 +133,9 @@ void register_misc_nodes(Span<NodeType> types) {
 		};
 	}
 	{
+		struct Params {
+			const ExpressionBytecode *bytecode;
+		};
 		NodeType &t = types[VoxelGraphFunction::NODE_EXPRESSION];
 		t.name = "Expression";
 		t.category = CATEGORY_MATH;
@@ -139,10 +143,51 @@ void register_misc_nodes(Span<NodeType> types) {
 		expression_param.multiline = false;
 		t.params.push_back(expression_param);
 		t.outputs.push_back(NodeType::Port("out"));
+		// Inputs are named after the variables of the expression
+		t.has_dynamic_inputs = true;
+		// Short expressions are expanded into nodes before compilation. Others remain, and run as a single operation.
 		t.compile_func = [](CompileContext &ctx) {
-			ctx.make_error(ZN_TTR("Internal error, expression wasn't expanded"));
+			const String code = ctx.get_param(0);
+			const CharString code_utf8 = code.utf8();
+			const ExpressionParser::Result parse_result = ExpressionParser::parse(
+					code_utf8.get_data(), NodeTypeDB::get_singleton().get_expression_parser_functions()
+			);
+			if (parse_result.error.id != ExpressionParser::ERROR_NONE || parse_result.root == nullptr) {
+				ctx.make_error(ZN_TTR("Internal error, invalid expression wasn't expanded"));
+				return;
+			}
+			StdVector<std::string_view> input_names;
+			for (unsigned int i = 0; i < ctx.get_input_count(); ++i) {
+				input_names.push_back(ctx.get_dynamic_input_name(i));
+			}
+			ExpressionBytecode *bytecode = ZN_NEW(ExpressionBytecode);
+			if (!compile_expression_bytecode(*parse_result.root, to_span(input_names), *bytecode)) {
+				ZN_DELETE(bytecode);
+				ctx.make_error(ZN_TTR("Internal error, expression can't be compiled into bytecode"));
+				return;
+			}
+			Params p;
+			p.bytecode = bytecode;
+			ctx.set_params(p);
+			ctx.add_delete_cleanup(bytecode);
+		};
+		t.process_buffer_func = [](Runtime::ProcessBufferContext &ctx) {
+			const ExpressionBytecode &bytecode = *ctx.get_params<Params>().bytecode;
+			FixedArray<const float *, ExpressionBytecode::MAX_REGISTERS> inputs;
+			for (unsigned int i = 0; i < bytecode.inputs_count; ++i) {
+				inputs[i] = ctx.get_input(i).data;
+			}
+			Runtime::Buffer &out = ctx.get_output(0);
+			bytecode.run(Span<const float *const>(inputs.data(), bytecode.inputs_count), out.data, out.size);
+		};
+		t.range_analysis_func = [](Runtime::RangeAnalysisContext &ctx) {
+			const ExpressionBytecode &bytecode = *ctx.get_params<Params>().bytecode;
+			FixedArray<Interval, ExpressionBytecode::MAX_REGISTERS> inputs;
+			for (unsigned int i = 0; i < bytecode.inputs_count; ++i) {
+				inputs[i] = ctx.get_input(i);
+			}
+			ctx.set_output(0, bytecode.analyze_range(Span<const Interval>(inputs.data(), bytecode.inputs_count)));
 		};
-		t.is_pseudo_node = true;
 	}
 }
 
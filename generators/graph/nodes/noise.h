@@ -1,4 +1,5 @@
 #include "../../../shaders/fast_noise_lite_shader.h"
+#include "../../../util/containers/std_vector.h"
 #include "../../../util/godot/classes/fast_noise_lite.h"
 #include "../../../util/noise/fast_noise_lite/fast_noise_lite.h"
 #include "../../../util/noise/fast_noise_lite/fast_noise_lite_range.h"
@@ -93,6 +94,160 @@ void add_fast_noise_lite_gradient_state_config(ShaderGenContext &ctx, const ZN_F
 	);
 }
 
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+
+// Keeps a FastNoise2 instance alive for as long as the compiled program. It can't be deleted as a heap resource
+// directly, because it is an Object.
+struct FastNoise2Holder {
+	Ref<FastNoise2> noise;
+};
+
+// The resource given to a node can be edited while threads are still running the previous program, and updating it
+// replaces its node tree. So each program runs its own copy, which is never modified after compilation and can be
+// shared by all threads. FastNoise2 picks the best SIMD level supported by the CPU when the node tree is created.
+const FastNoise2 *create_fast_noise_2_copy(CompileContext &ctx, const FastNoise2 &src) {
+	Ref<FastNoise2> noise = src.duplicate();
+	ZN_ASSERT_RETURN_V(noise.is_valid(), nullptr);
+	noise->update_generator();
+	if (!noise->is_valid()) {
+		return nullptr;
+	}
+	FastNoise2Holder *holder = ZN_NEW(FastNoise2Holder);
+	holder->noise = noise;
+	ctx.add_delete_cleanup(holder);
+	return *noise;
+}
+
+// Converts FastNoiseLite settings to an equivalent FastNoise2 instance when they are supported by both, so the node
+// can process whole buffers at once with SIMD instead of one sample at a time. Results are close, but not identical,
+// because the two libraries don't implement noises and fractals exactly the same way.
+// Returns null if the settings can't be converted.
+const FastNoise2 *create_fast_noise_2_from_lite(CompileContext &ctx, const ZN_FastNoiseLite &fnl, bool is_3d) {
+	Ref<FastNoise2> noise;
+	noise.instantiate();
+
+	switch (fnl.get_noise_type()) {
+		case ZN_FastNoiseLite::TYPE_OPEN_SIMPLEX_2:
+			noise->set_noise_type(FastNoise2::TYPE_OPEN_SIMPLEX_2);
+			break;
+		case ZN_FastNoiseLite::TYPE_PERLIN:
+			noise->set_noise_type(FastNoise2::TYPE_PERLIN);
+			break;
+		case ZN_FastNoiseLite::TYPE_VALUE:
+			noise->set_noise_type(FastNoise2::TYPE_VALUE);
+			break;
+		default:
+			return nullptr;
+	}
+
+	if (fnl.get_warp_noise().is_valid() || fnl.get_fractal_weighted_strength() != 0.f ||
+		(is_3d && fnl.get_rotation_type_3d() != ZN_FastNoiseLite::ROTATION_3D_NONE)) {
+		return nullptr;
+	}
+
+	switch (fnl.get_fractal_type()) {
+		case ZN_FastNoiseLite::FRACTAL_NONE:
+			noise->set_fractal_type(FastNoise2::FRACTAL_NONE);
+			break;
+		case ZN_FastNoiseLite::FRACTAL_FBM:
+			noise->set_fractal_type(FastNoise2::FRACTAL_FBM);
+			break;
+		case ZN_FastNoiseLite::FRACTAL_RIDGED:
+			noise->set_fractal_type(FastNoise2::FRACTAL_RIDGED);
+			break;
+		case ZN_FastNoiseLite::FRACTAL_PING_PONG:
+			noise->set_fractal_type(FastNoise2::FRACTAL_PING_PONG);
+			break;
+		default:
+			return nullptr;
+	}
+
+	noise->set_seed(fnl.get_seed());
+	noise->set_period(fnl.get_period());
+	noise->set_fractal_octaves(fnl.get_fractal_octaves());
+	noise->set_fractal_lacunarity(fnl.get_fractal_lacunarity());
+	noise->set_fractal_gain(fnl.get_fractal_gain());
+	noise->set_fractal_ping_pong_strength(fnl.get_fractal_ping_pong_strength());
+
+	noise->update_generator();
+	if (!noise->is_valid()) {
+		return nullptr;
+	}
+	FastNoise2Holder *holder = ZN_NEW(FastNoise2Holder);
+	holder->noise = noise;
+	ctx.add_delete_cleanup(holder);
+	return *noise;
+}
+
+#endif // VOXEL_ENABLE_FAST_NOISE_2
+
+// Copies of a fractal FastNoiseLite with fewer octaves, so octaves finer than what queried voxels can represent can be
+// skipped. They keep the fractal bounding of the original, so remaining octaves have the same amplitude, and the result
+// only lacks the finest details. Like the FastNoise2 conversion, settings are captured when the graph is compiled.
+struct FastNoiseLiteOctaveVariants {
+	// Index is the number of octaves minus one. There is no variant with all octaves, the original is used instead.
+	StdVector<::fast_noise_lite::FastNoiseLite> variants;
+	const ZN_FastNoiseLiteGradient *warp_noise = nullptr;
+	float period = 1.f;
+	float lacunarity = 2.f;
+
+	// Returns null if all octaves are needed
+	const ::fast_noise_lite::FastNoiseLite *find(float min_feature_size) const {
+		if (min_feature_size <= 0.f) {
+			return nullptr;
+		}
+		// Octave `i` has a period of `period / lacunarity^i`
+		unsigned int octave_count = 1;
+		float octave_period = period / lacunarity;
+		while (octave_count <= variants.size() && octave_period >= min_feature_size) {
+			++octave_count;
+			octave_period /= lacunarity;
+		}
+		if (octave_count > variants.size()) {
+			return nullptr;
+		}
+		return &variants[octave_count - 1];
+	}
+
+	inline float get_noise_2d(const ::fast_noise_lite::FastNoiseLite &fn, real_t x, real_t y) const {
+		if (warp_noise != nullptr) {
+			warp_noise->warp_2d(x, y);
+		}
+		return fn.GetNoise(x, y);
+	}
+
+	inline float get_noise_3d(const ::fast_noise_lite::FastNoiseLite &fn, real_t x, real_t y, real_t z) const {
+		if (warp_noise != nullptr) {
+			warp_noise->warp_3d(x, y, z);
+		}
+		return fn.GetNoise(x, y, z);
+	}
+};
+
+// Returns null if the noise has no octaves to skip
+const FastNoiseLiteOctaveVariants *create_fast_noise_lite_octave_variants(
+		CompileContext &ctx,
+		const ZN_FastNoiseLite &fnl
+) {
+	const int octave_count = fnl.get_fractal_octaves();
+	// Octaves must get finer, otherwise none can be skipped
+	if (fnl.get_fractal_type() == ZN_FastNoiseLite::FRACTAL_NONE || octave_count <= 1 ||
+		fnl.get_fractal_lacunarity() <= 1.f || fnl.get_period() <= 0.f) {
+		return nullptr;
+	}
+	FastNoiseLiteOctaveVariants *ov = ZN_NEW(FastNoiseLiteOctaveVariants);
+	ov->warp_noise = fnl.get_warp_noise().ptr();
+	ov->period = fnl.get_period();
+	ov->lacunarity = fnl.get_fractal_lacunarity();
+	ov->variants.resize(octave_count - 1, fnl.get_noise_internal());
+	for (int i = 0; i < octave_count - 1; ++i) {
+		// Not using `SetFractalOctaves`, because it would also change the fractal bounding
+		ov->variants[i].mOctaves = i + 1;
+	}
+	ctx.add_delete_cleanup(ov);
+	return ov;
+}
+
 void register_noise_nodes(Span<NodeType> types) {
 	using namespace math;
 
@@ -252,6 +407,12 @@ void register_noise_nodes(Span<NodeType> types) {
 	{
 		struct Params {
 			const ZN_FastNoiseLite *noise;
+			// Not null if octaves can be skipped
+			const FastNoiseLiteOctaveVariants *octave_variants;
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+			// Not null if the noise was converted
+			const FastNoise2 *noise2;
+#endif
 		};
 
 		NodeType &t = types[VoxelGraphFunction::NODE_FAST_NOISE_2D];
@@ -264,6 +425,7 @@ void register_noise_nodes(Span<NodeType> types) {
 								   Param("noise",
 										 ZN_FastNoiseLite::get_class_static(),
 										 &create_resource_to_variant<ZN_FastNoiseLite>));
+		t.params.push_back(NodeType::Param("convert_to_fast_noise_2", Variant::BOOL, false));
 
 		t.compile_func = [](CompileContext &ctx) {
 			Ref<ZN_FastNoiseLite> noise = ctx.get_param(0);
@@ -275,6 +437,22 @@ void register_noise_nodes(Span<NodeType> types) {
 			}
 			Params p;
 			p.noise = *noise;
+			p.octave_variants = create_fast_noise_lite_octave_variants(ctx, **noise);
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+			p.noise2 = nullptr;
+			if (ctx.get_param(1).operator bool()) {
+				p.noise2 = create_fast_noise_2_from_lite(ctx, **noise, false);
+				if (p.noise2 == nullptr) {
+					ctx.make_error(ZN_TTR("Noise settings can't be converted to FastNoise2"));
+					return;
+				}
+			}
+#else
+			if (ctx.get_param(1).operator bool()) {
+				ctx.make_error(ZN_TTR("FastNoise2 is not available in this build"));
+				return;
+			}
+#endif
 			ctx.set_params(p);
 		};
 
@@ -284,6 +462,24 @@ void register_noise_nodes(Span<NodeType> types) {
 			const Runtime::Buffer &y = ctx.get_input(1);
 			Runtime::Buffer &out = ctx.get_output(0);
 			const Params p = ctx.get_params<Params>();
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+			if (p.noise2 != nullptr) {
+				p.noise2->get_noise_2d_series(
+						Span<const float>(x.data, x.size),
+						Span<const float>(y.data, y.size),
+						Span<float>(out.data, out.size)
+				);
+				return;
+			}
+#endif
+			const ::fast_noise_lite::FastNoiseLite *pruned_noise =
+					p.octave_variants != nullptr ? p.octave_variants->find(ctx.get_min_feature_size()) : nullptr;
+			if (pruned_noise != nullptr) {
+				for (uint32_t i = 0; i < out.size; ++i) {
+					out.data[i] = p.octave_variants->get_noise_2d(*pruned_noise, x.data[i], y.data[i]);
+				}
+				return;
+			}
 			for (uint32_t i = 0; i < out.size; ++i) {
 				out.data[i] = p.noise->get_noise_2d(x.data[i], y.data[i]);
 			}
@@ -293,6 +489,12 @@ void register_noise_nodes(Span<NodeType> types) {
 			const Interval x = ctx.get_input(0);
 			const Interval y = ctx.get_input(1);
 			const Params p = ctx.get_params<Params>();
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+			if (p.noise2 != nullptr) {
+				ctx.set_output(0, p.noise2->get_estimated_output_range());
+				return;
+			}
+#endif
 			// Shouldn't be null, it is checked when the graph is compiled
 			ctx.set_output(0, get_fnl_range_2d(*p.noise, x, y));
 		};
@@ -305,6 +507,11 @@ void register_noise_nodes(Span<NodeType> types) {
 				);
 				return;
 			}
+			if (ctx.get_param(1).operator bool()) {
+				// The GPU would still run FastNoiseLite, which would give different results
+				ctx.make_error(ZN_TTR("Noise converted to FastNoise2 is not supported on the GPU"));
+				return;
+			}
 			ctx.require_lib_code("vg_fnl", g_fast_noise_lite_shader);
 			add_fast_noise_lite_state_config(ctx, **noise);
 			ctx.add_format(
@@ -318,6 +525,12 @@ void register_noise_nodes(Span<NodeType> types) {
 	{
 		struct Params {
 			const ZN_FastNoiseLite *noise;
+			// Not null if octaves can be skipped
+			const FastNoiseLiteOctaveVariants *octave_variants;
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+			// Not null if the noise was converted
+			const FastNoise2 *noise2;
+#endif
 		};
 
 		NodeType &t = types[VoxelGraphFunction::NODE_FAST_NOISE_3D];
@@ -331,6 +544,7 @@ void register_noise_nodes(Span<NodeType> types) {
 								   Param("noise",
 										 ZN_FastNoiseLite::get_class_static(),
 										 &create_resource_to_variant<ZN_FastNoiseLite>));
+		t.params.push_back(NodeType::Param("convert_to_fast_noise_2", Variant::BOOL, false));
 
 		t.compile_func = [](CompileContext &ctx) {
 			Ref<ZN_FastNoiseLite> noise = ctx.get_param(0);
@@ -342,6 +556,22 @@ void register_noise_nodes(Span<NodeType> types) {
 			}
 			Params p;
 			p.noise = *noise;
+			p.octave_variants = create_fast_noise_lite_octave_variants(ctx, **noise);
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+			p.noise2 = nullptr;
+			if (ctx.get_param(1).operator bool()) {
+				p.noise2 = create_fast_noise_2_from_lite(ctx, **noise, true);
+				if (p.noise2 == nullptr) {
+					ctx.make_error(ZN_TTR("Noise settings can't be converted to FastNoise2"));
+					return;
+				}
+			}
+#else
+			if (ctx.get_param(1).operator bool()) {
+				ctx.make_error(ZN_TTR("FastNoise2 is not available in this build"));
+				return;
+			}
+#endif
 			ctx.set_params(p);
 		};
 
@@ -352,6 +582,25 @@ void register_noise_nodes(Span<NodeType> types) {
 			const Runtime::Buffer &z = ctx.get_input(2);
 			Runtime::Buffer &out = ctx.get_output(0);
 			const Params p = ctx.get_params<Params>();
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+			if (p.noise2 != nullptr) {
+				p.noise2->get_noise_3d_series(
+						Span<const float>(x.data, x.size),
+						Span<const float>(y.data, y.size),
+						Span<const float>(z.data, z.size),
+						Span<float>(out.data, out.size)
+				);
+				return;
+			}
+#endif
+			const ::fast_noise_lite::FastNoiseLite *pruned_noise =
+					p.octave_variants != nullptr ? p.octave_variants->find(ctx.get_min_feature_size()) : nullptr;
+			if (pruned_noise != nullptr) {
+				for (uint32_t i = 0; i < out.size; ++i) {
+					out.data[i] = p.octave_variants->get_noise_3d(*pruned_noise, x.data[i], y.data[i], z.data[i]);
+				}
+				return;
+			}
 			for (uint32_t i = 0; i < out.size; ++i) {
 				out.data[i] = p.noise->get_noise_3d(x.data[i], y.data[i], z.data[i]);
 			}
@@ -362,6 +611,12 @@ void register_noise_nodes(Span<NodeType> types) {
 			const Interval y = ctx.get_input(1);
 			const Interval z = ctx.get_input(2);
 			const Params p = ctx.get_params<Params>();
+#ifdef VOXEL_ENABLE_FAST_NOISE_2
+			if (p.noise2 != nullptr) {
+				ctx.set_output(0, p.noise2->get_estimated_output_range());
+				return;
+			}
+#endif
 			// Shouldn't be null, it is checked when the graph is compiled
 			ctx.set_output(0, get_fnl_range_3d(*p.noise, x, y, z));
 		};
@@ -374,6 +629,11 @@ void register_noise_nodes(Span<NodeType> types) {
 				);
 				return;
 			}
+			if (ctx.get_param(1).operator bool()) {
+				// The GPU would still run FastNoiseLite, which would give different results
+				ctx.make_error(ZN_TTR("Noise converted to FastNoise2 is not supported on the GPU"));
+				return;
+			}
 			ctx.require_lib_code("vg_fnl", g_fast_noise_lite_shader);
 			add_fast_noise_lite_state_config(ctx, **noise);
 			ctx.add_format(
@@ -573,13 +833,12 @@ void register_noise_nodes(Span<NodeType> types) {
 				ctx.make_error(String(ZN_TTR("{0} instance is null")).format(varray(FastNoise2::get_class_static())));
 				return;
 			}
-			noise->update_generator();
-			if (!noise->is_valid()) {
+			Params p;
+			p.noise = create_fast_noise_2_copy(ctx, **noise);
+			if (p.noise == nullptr) {
 				ctx.make_error(String(ZN_TTR("{0} setup is invalid")).format(varray(FastNoise2::get_class_static())));
 				return;
 			}
-			Params p;
-			p.noise = *noise;
 			ctx.set_params(p);
 		};
 
@@ -626,13 +885,12 @@ void register_noise_nodes(Span<NodeType> types) {
 				ctx.make_error(String(ZN_TTR("{0} instance is null")).format(varray(FastNoise2::get_class_static())));
 				return;
 			}
-			noise->update_generator();
-			if (!noise->is_valid()) {
+			Params p;
+			p.noise = create_fast_noise_2_copy(ctx, **noise);
+			if (p.noise == nullptr) {
 				ctx.make_error(String(ZN_TTR("{0} setup is invalid")).format(varray(FastNoise2::get_class_static())));
 				return;
 			}
-			Params p;
-			p.noise = *noise;
 			ctx.set_params(p);
 		};
 
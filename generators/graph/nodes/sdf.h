@@ -228,9 +228,11 @@ void register_sdf_nodes(Span<NodeType> types) {
 					out.data[i] = a.data[i];
 				}
 			} else if (params.smoothness > 0.0001f) {
-				for (uint32_t i = 0; i < out.size; ++i) {
-					out.data[i] = math::sdf_smooth_union(a.data[i], b.data[i], params.smoothness);
-				}
+				const float s = params.smoothness;
+				transform_float4(out.data, a.data, b.data, out.size, [s](auto va, auto vb) {
+					typedef decltype(va) T;
+					return math::sdf_smooth_union(va, vb, T(s));
+				});
 			} else {
 				// Fallback on hard-union, smooth union does not support zero smoothness
 				for (uint32_t i = 0; i < out.size; ++i) {
@@ -1,6 +1,7 @@
 #ifndef VOXEL_GRAPH_NODES_UTIL_H
 #define VOXEL_GRAPH_NODES_UTIL_H
 
+#include "../../../util/math/float4.h"
 #include "../voxel_graph_runtime.h"
 
 namespace zylann::voxel::pg {
@@ -59,6 +60,72 @@ inline void do_binop(pg::Runtime::ProcessBufferContext &ctx, F f) {
 	}
 }
 
+// Computes `out[i] = f(a[i])`, using `math::Float4` to process 4 values at once, and `float` for remaining ones.
+// `f` must give the same results with both types, which is the case when it only uses operators and functions available
+// for `math::Float4`.
+template <typename F>
+inline void transform_float4(float *out, const float *a, const uint32_t size, F f) {
+	uint32_t i = 0;
+	for (; i + math::Float4::SIZE <= size; i += math::Float4::SIZE) {
+		f(math::Float4::load(a + i)).store(out + i);
+	}
+	for (; i < size; ++i) {
+		out[i] = f(a[i]);
+	}
+}
+
+template <typename F>
+inline void transform_float4(float *out, const float *a, const float *b, const uint32_t size, F f) {
+	uint32_t i = 0;
+	for (; i + math::Float4::SIZE <= size; i += math::Float4::SIZE) {
+		f(math::Float4::load(a + i), math::Float4::load(b + i)).store(out + i);
+	}
+	for (; i < size; ++i) {
+		out[i] = f(a[i], b[i]);
+	}
+}
+
+template <typename F>
+inline void transform_float4(float *out, const float *a, const float *b, const float *c, const uint32_t size, F f) {
+	uint32_t i = 0;
+	for (; i + math::Float4::SIZE <= size; i += math::Float4::SIZE) {
+		f(math::Float4::load(a + i), math::Float4::load(b + i), math::Float4::load(c + i)).store(out + i);
+	}
+	for (; i < size; ++i) {
+		out[i] = f(a[i], b[i], c[i]);
+	}
+}
+
+// Same as `do_binop`, but vectorized. See `transform_float4` for requirements on `f`.
+template <typename F>
+inline void do_binop_float4(pg::Runtime::ProcessBufferContext &ctx, F f) {
+	const Runtime::Buffer &a = ctx.get_input(0);
+	const Runtime::Buffer &b = ctx.get_input(1);
+	Runtime::Buffer &out = ctx.get_output(0);
+	const uint32_t buffer_size = out.size;
+
+	if (a.is_constant || b.is_constant) {
+		if (!b.is_constant) {
+			const float c = a.constant_value;
+			transform_float4(out.data, b.data, buffer_size, [c, &f](auto v) { return f(decltype(v)(c), v); });
+
+		} else if (!a.is_constant) {
+			const float c = b.constant_value;
+			transform_float4(out.data, a.data, buffer_size, [c, &f](auto v) { return f(v, decltype(v)(c)); });
+
+		} else {
+			// Normally this case should have been optimized out at compile-time
+			const float c = f(a.constant_value, b.constant_value);
+			for (uint32_t i = 0; i < buffer_size; ++i) {
+				out.data[i] = c;
+			}
+		}
+
+	} else {
+		transform_float4(out.data, a.data, b.data, buffer_size, f);
+	}
+}
+
 } // namespace zylann::voxel::pg
 
 #endif // VOXEL_GRAPH_NODES_UTIL_H
@@ -0,0 +1,245 @@
+#include "tiled_image.h"
+#include "../../util/godot/classes/directory.h"
+#include "../../util/godot/classes/file_access.h"
+#include "../../util/godot/classes/image.h"
+#include "../../util/godot/classes/os.h"
+#include "../../util/godot/classes/project_settings.h"
+#include "../../util/godot/file_utils.h"
+#include "../../util/io/log.h"
+#include "../../util/math/float4.h"
+#include "../../util/profiling.h"
+#include "../../util/string/format.h"
+#include <atomic>
+
+namespace zylann {
+
+TiledImage::~TiledImage() {
+	clear();
+}
+
+void TiledImage::clear() {
+	_mip_count = 0;
+	_pixels_ptr = nullptr;
+	_pixels.clear();
+	_pixels.shrink_to_fit();
+
+	if (_mapped_file.is_open()) {
+		_mapped_file.close();
+	}
+	if (!_mapped_file_path.is_empty()) {
+		Ref<DirAccess> dir = zylann::godot::open_directory(_mapped_file_path.get_base_dir());
+		if (dir.is_valid()) {
+			dir->remove(_mapped_file_path);
+		}
+		_mapped_file_path = String();
+	}
+}
+
+void TiledImage::generate(
+		const Image &im,
+		bool mipmaps,
+		uint64_t memory_mapping_threshold,
+		const String &temp_directory
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_MSG(!im.is_compressed(), format("Image format not supported: {}", im.get_format()));
+
+	clear();
+
+	if (im.is_empty()) {
+		return;
+	}
+
+	const int image_size_x = im.get_width();
+	const int image_size_y = im.get_height();
+
+	// Layout
+	size_t pixel_count = 0;
+	while (_mip_count < MAX_MIPS) {
+		Mip &mip = _mips[_mip_count];
+		mip.size_x = math::max(image_size_x >> _mip_count, 1);
+		mip.size_y = math::max(image_size_y >> _mip_count, 1);
+		mip.tiles_x = math::ceildiv(mip.size_x, int(TILE_SIZE));
+		const int tiles_y = math::ceildiv(mip.size_y, int(TILE_SIZE));
+		mip.offset = pixel_count;
+		mip.scale_x = float(image_size_x) / float(mip.size_x);
+		mip.scale_y = float(image_size_y) / float(mip.size_y);
+		pixel_count += size_t(mip.tiles_x) * size_t(tiles_y) * TILE_SIZE * TILE_SIZE;
+		++_mip_count;
+
+		if (!mipmaps || (mip.size_x == 1 && mip.size_y == 1)) {
+			break;
+		}
+	}
+
+	_pixels.resize(pixel_count, 0.f);
+
+	{
+		ZN_PROFILE_SCOPE_NAMED("Tile pixels");
+		const Mip &mip = _mips[0];
+		for (int y = 0; y < mip.size_y; ++y) {
+			for (int x = 0; x < mip.size_x; ++x) {
+				set_pixel_unchecked(mip, x, y, im.get_pixel(x, y).r);
+			}
+		}
+	}
+
+	_pixels_ptr = _pixels.data();
+
+	for (unsigned int mip_index = 1; mip_index < _mip_count; ++mip_index) {
+		ZN_PROFILE_SCOPE_NAMED("Mip");
+		const Mip &src = _mips[mip_index - 1];
+		const Mip &dst = _mips[mip_index];
+		for (int y = 0; y < dst.size_y; ++y) {
+			const int sy0 = math::wrap(2 * y, src.size_y);
+			const int sy1 = math::wrap(2 * y + 1, src.size_y);
+			for (int x = 0; x < dst.size_x; ++x) {
+				const int sx0 = math::wrap(2 * x, src.size_x);
+				const int sx1 = math::wrap(2 * x + 1, src.size_x);
+				const float sum = get_pixel_unchecked(src, sx0, sy0) + get_pixel_unchecked(src, sx1, sy0) +
+						get_pixel_unchecked(src, sx0, sy1) + get_pixel_unchecked(src, sx1, sy1);
+				set_pixel_unchecked(dst, x, y, 0.25f * sum);
+			}
+		}
+	}
+
+	if (pixel_count * sizeof(float) > memory_mapping_threshold && !temp_directory.is_empty() &&
+		MemoryMappedFile::is_supported()) {
+		map_to_temp_file(temp_directory);
+	}
+}
+
+void TiledImage::map_to_temp_file(const String &temp_directory) {
+	ZN_PROFILE_SCOPE();
+
+	if (zylann::godot::check_directory_created(temp_directory) != OK) {
+		ZN_PRINT_ERROR(format("Could not create image cache directory {}", temp_directory));
+		return;
+	}
+
+	// Several images can be cached at once, by several instances of the application
+	static std::atomic_uint32_t s_file_counter = { 0 };
+	const String file_path = temp_directory.path_join(
+			String::num_int64(OS::get_singleton()->get_process_id()) + "_" +
+			String::num_int64(s_file_counter.fetch_add(1)) + ".tiles"
+	);
+
+	{
+		Error err;
+		Ref<FileAccess> f = zylann::godot::open_file(file_path, FileAccess::WRITE, err);
+		if (f.is_null()) {
+			ZN_PRINT_ERROR(format("Could not write image cache file {}", file_path));
+			return;
+		}
+		zylann::godot::store_buffer(
+				**f,
+				Span<const uint8_t>(reinterpret_cast<const uint8_t *>(_pixels.data()), _pixels.size() * sizeof(float))
+		);
+	}
+
+	// Remembered before mapping, so the file gets removed even if mapping fails
+	_mapped_file_path = file_path;
+
+	const String os_path = ProjectSettings::get_singleton()->globalize_path(file_path);
+	if (!_mapped_file.open(zylann::godot::to_std_string(os_path).c_str()) ||
+		_mapped_file.get_data().size() != _pixels.size() * sizeof(float)) {
+		ZN_PRINT_WARNING(format("Could not map image cache file {}, keeping it in memory", file_path));
+		_mapped_file.close();
+		Ref<DirAccess> dir = zylann::godot::open_directory(temp_directory);
+		if (dir.is_valid()) {
+			dir->remove(file_path);
+		}
+		_mapped_file_path = String();
+		return;
+	}
+
+	_pixels_ptr = reinterpret_cast<const float *>(_mapped_file.get_data().data());
+	_pixels.clear();
+	_pixels.shrink_to_fit();
+}
+
+unsigned int TiledImage::get_mip_for_step(float step) const {
+	unsigned int mip_index = 0;
+	while (mip_index + 1 < _mip_count) {
+		const Mip &next_mip = _mips[mip_index + 1];
+		if (math::max(next_mip.scale_x, next_mip.scale_y) > step) {
+			break;
+		}
+		++mip_index;
+	}
+	return mip_index;
+}
+
+float TiledImage::get_pixel_repeat_linear(unsigned int mip_index, float x, float y) const {
+	const Mip &mip = _mips[mip_index];
+	const LinearSample s = get_linear_sample(mip, x, y);
+
+	const int x0 = math::wrap(s.x0, mip.size_x);
+	const int y0 = math::wrap(s.y0, mip.size_y);
+	const int x1 = x0 + 1 == mip.size_x ? 0 : x0 + 1;
+	const int y1 = y0 + 1 == mip.size_y ? 0 : y0 + 1;
+
+	const float h00 = get_pixel_unchecked(mip, x0, y0);
+	const float h10 = get_pixel_unchecked(mip, x1, y0);
+	const float h01 = get_pixel_unchecked(mip, x0, y1);
+	const float h11 = get_pixel_unchecked(mip, x1, y1);
+
+	// Bilinear filter
+	return Math::lerp(Math::lerp(h00, h10, s.xf), Math::lerp(h01, h11, s.xf), s.yf);
+}
+
+void TiledImage::get_pixels_repeat_linear(
+		unsigned int mip_index,
+		Span<const float> x,
+		Span<const float> y,
+		Span<float> dst
+) const {
+	ZN_ASSERT_RETURN(x.size() == dst.size() && y.size() == dst.size());
+
+	using namespace math;
+
+	const Mip &mip = _mips[mip_index];
+	const unsigned int count = dst.size();
+
+	unsigned int i = 0;
+
+	// Fetching pixels has to be done one by one, but interpolation can be done on several samples at once
+	for (; i + Float4::SIZE <= count; i += Float4::SIZE) {
+		float h00[Float4::SIZE];
+		float h10[Float4::SIZE];
+		float h01[Float4::SIZE];
+		float h11[Float4::SIZE];
+		float xf[Float4::SIZE];
+		float yf[Float4::SIZE];
+
+		for (unsigned int j = 0; j < Float4::SIZE; ++j) {
+			const LinearSample s = get_linear_sample(mip, x[i + j], y[i + j]);
+
+			const int x0 = math::wrap(s.x0, mip.size_x);
+			const int y0 = math::wrap(s.y0, mip.size_y);
+			const int x1 = x0 + 1 == mip.size_x ? 0 : x0 + 1;
+			const int y1 = y0 + 1 == mip.size_y ? 0 : y0 + 1;
+
+			h00[j] = get_pixel_unchecked(mip, x0, y0);
+			h10[j] = get_pixel_unchecked(mip, x1, y0);
+			h01[j] = get_pixel_unchecked(mip, x0, y1);
+			h11[j] = get_pixel_unchecked(mip, x1, y1);
+			xf[j] = s.xf;
+			yf[j] = s.yf;
+		}
+
+		const Float4 vxf = Float4::load(xf);
+		const Float4 h = lerp(
+				lerp(Float4::load(h00), Float4::load(h10), vxf),
+				lerp(Float4::load(h01), Float4::load(h11), vxf),
+				Float4::load(yf)
+		);
+		h.store(&dst[i]);
+	}
+
+	for (; i < count; ++i) {
+		dst[i] = get_pixel_repeat_linear(mip_index, x[i], y[i]);
+	}
+}
+
+} // namespace zylann
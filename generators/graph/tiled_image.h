@@ -0,0 +1,139 @@
+#ifndef TILED_IMAGE_H
+#define TILED_IMAGE_H
+
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/string.h"
+#include "../../util/godot/macros.h"
+#include "../../util/io/memory_mapped_file.h"
+#include "../../util/math/funcs.h"
+
+ZN_GODOT_FORWARD_DECLARE(class Image)
+
+namespace zylann {
+
+// Copy of the red channel of an image as floats, with mipmaps, stored in small square tiles so that pixels close to
+// each other in 2D are also close in memory.
+// Sampling a large image row by row (Godot's layout) over an area accesses as many distant rows, while most pixels of
+// tiles are reused by neighbor samples. At low levels of detail, sampling mipmaps avoids skipping most pixels, which
+// would both alias and miss the CPU cache.
+// Mipmaps are the average of 2x2 pixels of the previous level, wrapping around if the size is odd.
+// It can be read from multiple threads once generated.
+class TiledImage {
+public:
+	static const unsigned int TILE_SIZE_PO2 = 3;
+	static const unsigned int TILE_SIZE = 1 << TILE_SIZE_PO2;
+	static const unsigned int MAX_MIPS = 16;
+
+	// Above this amount of pixel data, tiles are written to a temporary file mapped in memory, so pages only get
+	// loaded from disk when they are accessed, and the OS can drop them under memory pressure.
+	static const uint64_t DEFAULT_MEMORY_MAPPING_THRESHOLD = 256 * 1024 * 1024;
+	static constexpr const char *DEFAULT_TEMP_DIRECTORY = "user://voxel_image_cache";
+
+	TiledImage() {}
+	~TiledImage();
+
+	TiledImage(const TiledImage &) = delete;
+	TiledImage &operator=(const TiledImage &) = delete;
+
+	// `temp_directory` is where files are written when the memory mapping threshold is exceeded. If empty, or if
+	// memory mapping is not supported or fails, pixels remain in regular memory.
+	void generate(
+			const Image &im,
+			bool mipmaps,
+			uint64_t memory_mapping_threshold = DEFAULT_MEMORY_MAPPING_THRESHOLD,
+			const String &temp_directory = String()
+	);
+
+	void clear();
+
+	inline unsigned int get_mip_count() const {
+		return _mip_count;
+	}
+
+	inline bool is_memory_mapped() const {
+		return _mapped_file.is_open();
+	}
+
+	// Gets which mip to sample when consecutive samples are `step` pixels apart in the original image. It is the
+	// largest mip whose pixels are not larger than that step.
+	unsigned int get_mip_for_step(float step) const;
+
+	// Coordinates are in pixels of the mip. Out of bounds coordinates repeat the image.
+	inline float get_pixel_repeat(unsigned int mip_index, int x, int y) const {
+		const Mip &mip = _mips[mip_index];
+		return get_pixel_unchecked(mip, math::wrap(x, mip.size_x), math::wrap(y, mip.size_y));
+	}
+
+	// Coordinates are in pixels of the original image. Pixels are considered to be at integer coordinates, so
+	// sampling mip 0 at integer coordinates gives the exact value of pixels.
+	float get_pixel_repeat_linear(unsigned int mip_index, float x, float y) const;
+
+	// Same as `get_pixel_repeat_linear` for series of coordinates, interpolating several samples at once.
+	void get_pixels_repeat_linear(unsigned int mip_index, Span<const float> x, Span<const float> y, Span<float> dst)
+			const;
+
+private:
+	struct Mip {
+		// In pixels
+		int size_x = 0;
+		int size_y = 0;
+		// In tiles
+		int tiles_x = 0;
+		// Index of the first pixel in `_pixels`
+		size_t offset = 0;
+		// Size of the original image divided by the size of this mip
+		float scale_x = 1.f;
+		float scale_y = 1.f;
+	};
+
+	inline float get_pixel_unchecked(const Mip &mip, int x, int y) const {
+		const unsigned int tile_x = x >> TILE_SIZE_PO2;
+		const unsigned int tile_y = y >> TILE_SIZE_PO2;
+		const unsigned int mask = TILE_SIZE - 1;
+		const size_t tile_index = tile_x + tile_y * mip.tiles_x;
+		return _pixels_ptr
+				[mip.offset + (tile_index << (2 * TILE_SIZE_PO2)) + ((y & mask) << TILE_SIZE_PO2) + (x & mask)];
+	}
+
+	inline void set_pixel_unchecked(const Mip &mip, int x, int y, float v) {
+		const unsigned int tile_x = x >> TILE_SIZE_PO2;
+		const unsigned int tile_y = y >> TILE_SIZE_PO2;
+		const unsigned int mask = TILE_SIZE - 1;
+		const size_t tile_index = tile_x + tile_y * mip.tiles_x;
+		_pixels[mip.offset + (tile_index << (2 * TILE_SIZE_PO2)) + ((y & mask) << TILE_SIZE_PO2) + (x & mask)] = v;
+	}
+
+	struct LinearSample {
+		int x0;
+		int y0;
+		float xf;
+		float yf;
+	};
+
+	inline LinearSample get_linear_sample(const Mip &mip, float x, float y) const {
+		// Pixels of a mip are centered on the pixels of the original image they cover
+		const float mx = (x - 0.5f * (mip.scale_x - 1.f)) / mip.scale_x;
+		const float my = (y - 0.5f * (mip.scale_y - 1.f)) / mip.scale_y;
+		const float fx = Math::floor(mx);
+		const float fy = Math::floor(my);
+		return LinearSample{ int(fx), int(fy), mx - fx, my - fy };
+	}
+
+	void map_to_temp_file(const String &temp_directory);
+
+	FixedArray<Mip, MAX_MIPS> _mips;
+	unsigned int _mip_count = 0;
+
+	StdVector<float> _pixels;
+	// Points either to `_pixels` or to the mapped file
+	const float *_pixels_ptr = nullptr;
+
+	MemoryMappedFile _mapped_file;
+	String _mapped_file_path;
+};
+
+} // namespace zylann
+
+#endif // TILED_IMAGE_H
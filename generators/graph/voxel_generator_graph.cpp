@@ -1,8 +1,10 @@
 #include "voxel_generator_graph.h"
 #include "../../constants/voxel_string_names.h"
+#include "../../modifiers/voxel_modifier_stack.h"
 #include "../../storage/materials_4i4w.h"
 #include "../../storage/voxel_buffer.h"
 #include "../../util/containers/container_funcs.h"
+#include "../../util/containers/std_map.h"
 #include "../../util/godot/classes/engine.h"
 #include "../../util/godot/classes/image.h"
 #include "../../util/godot/classes/object.h"
@@ -12,6 +14,7 @@
 #include "../../util/io/log.h"
 #include "../../util/macros.h"
 #include "../../util/math/conv.h"
+#include "../../util/math/funcs.h"
 #include "../../util/profiling.h"
 #include "../../util/profiling_clock.h"
 #include "../../util/string/expression_parser.h"
@@ -109,6 +112,14 @@ int VoxelGeneratorGraph::get_subdivision_size() const {
 	return _subdivision_size;
 }
 
+void VoxelGeneratorGraph::set_use_adaptive_subdivision(bool use) {
+	_use_adaptive_subdivision = use;
+}
+
+bool VoxelGeneratorGraph::is_using_adaptive_subdivision() const {
+	return _use_adaptive_subdivision;
+}
+
 void VoxelGeneratorGraph::set_debug_clipped_blocks(bool enabled) {
 	_debug_clipped_blocks = enabled;
 }
@@ -125,6 +136,142 @@ bool VoxelGeneratorGraph::is_using_xz_caching() const {
 	return _use_xz_caching;
 }
 
+void VoxelGeneratorGraph::set_xz_cache_size(int entry_count) {
+	ERR_FAIL_COND(entry_count < 0);
+	_xz_cache_size = entry_count;
+	RWLockRead rlock(_runtime_lock);
+	if (_runtime != nullptr) {
+		_runtime->xz_cache.set_max_entries(entry_count);
+	}
+}
+
+int VoxelGeneratorGraph::get_xz_cache_size() const {
+	return _xz_cache_size;
+}
+
+void VoxelGeneratorGraph::set_use_lod_detail_pruning(bool enabled) {
+	if (enabled == _use_lod_detail_pruning) {
+		return;
+	}
+	_use_lod_detail_pruning = enabled;
+	// Cached results were computed with the previous setting
+	RWLockRead rlock(_runtime_lock);
+	if (_runtime != nullptr) {
+		_runtime->xz_cache.clear();
+	}
+}
+
+bool VoxelGeneratorGraph::is_using_lod_detail_pruning() const {
+	return _use_lod_detail_pruning;
+}
+
+pg::XZCache::Stats VoxelGeneratorGraph::get_xz_cache_stats() const {
+	RWLockRead rlock(_runtime_lock);
+	if (_runtime == nullptr) {
+		return pg::XZCache::Stats();
+	}
+	return _runtime->xz_cache.get_stats();
+}
+
+VoxelGeneratorGraph::RangeAnalysisStats VoxelGeneratorGraph::get_range_analysis_stats() const {
+	RangeAnalysisStats stats;
+	stats.analyzed_boxes = _stats_analyzed_boxes.load(std::memory_order_relaxed);
+	stats.clipped_voxels = _stats_clipped_voxels.load(std::memory_order_relaxed);
+	stats.computed_voxels = _stats_computed_voxels.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void VoxelGeneratorGraph::reset_range_analysis_stats() {
+	_stats_analyzed_boxes.store(0, std::memory_order_relaxed);
+	_stats_clipped_voxels.store(0, std::memory_order_relaxed);
+	_stats_computed_voxels.store(0, std::memory_order_relaxed);
+}
+
+void VoxelGeneratorGraph::set_profiling_sample_rate(float rate) {
+	_profiling_sample_rate = math::clamp(rate, 0.f, 1.f);
+}
+
+float VoxelGeneratorGraph::get_profiling_sample_rate() const {
+	return _profiling_sample_rate;
+}
+
+bool VoxelGeneratorGraph::pick_profiling_sample() {
+	const double rate = _profiling_sample_rate;
+	if (rate <= 0.0) {
+		return false;
+	}
+	// Samples are spread evenly over calls, a call is picked each time the count multiplied by the rate reaches the
+	// next integer
+	const uint64_t n = _profiling_call_counter.fetch_add(1, std::memory_order_relaxed);
+	return static_cast<uint64_t>(n * rate) != static_cast<uint64_t>((n + 1) * rate);
+}
+
+void VoxelGeneratorGraph::accumulate_sampled_profiling(
+		const pg::Runtime::State &state,
+		const pg::Runtime::ExecutionMap &execution_map,
+		Span<std::atomic_uint64_t> totals
+) {
+	for (unsigned int i = 0; i < execution_map.operations.size(); ++i) {
+		const uint32_t time = state.get_execution_time(i);
+		if (time != 0) {
+			totals[execution_map.operations[i].decoded_index].fetch_add(time, std::memory_order_relaxed);
+		}
+	}
+}
+
+Dictionary VoxelGeneratorGraph::get_sampled_profiling_results() const {
+	std::shared_ptr<const Runtime> runtime_ptr;
+	{
+		RWLockRead rlock(_runtime_lock);
+		runtime_ptr = _runtime;
+	}
+	Dictionary d;
+	ERR_FAIL_COND_V_MSG(runtime_ptr == nullptr, d, "The graph hasn't been compiled yet");
+
+	// A node can compile into more than one operation
+	StdMap<uint32_t, uint64_t> node_times;
+	const pg::Runtime::ExecutionMap &execution_map = runtime_ptr->runtime.get_default_execution_map();
+	for (unsigned int i = 0; i < execution_map.operations.size(); ++i) {
+		const uint32_t node_id = execution_map.debug_nodes[i];
+		const unsigned int operation_index = execution_map.operations[i].decoded_index;
+		node_times[node_id] += runtime_ptr->sampled_operation_times[operation_index].load(std::memory_order_relaxed);
+	}
+
+	const uint64_t sampled_voxels = runtime_ptr->sampled_voxels.load(std::memory_order_relaxed);
+
+	Array nodes;
+	for (auto it = node_times.begin(); it != node_times.end(); ++it) {
+		const uint64_t microseconds = it->second;
+		Dictionary node_d;
+		node_d["node_id"] = it->first;
+		node_d["microseconds"] = static_cast<int64_t>(microseconds);
+		node_d["nanoseconds_per_voxel"] =
+				sampled_voxels > 0 ? 1000.0 * double(microseconds) / double(sampled_voxels) : 0.0;
+		nodes.append(node_d);
+	}
+
+	d["sampled_blocks"] = static_cast<int64_t>(runtime_ptr->sampled_blocks.load(std::memory_order_relaxed));
+	d["sampled_voxels"] = static_cast<int64_t>(sampled_voxels);
+	d["nodes"] = nodes;
+	return d;
+}
+
+void VoxelGeneratorGraph::reset_sampled_profiling_results() {
+	std::shared_ptr<Runtime> runtime_ptr;
+	{
+		RWLockRead rlock(_runtime_lock);
+		runtime_ptr = _runtime;
+	}
+	if (runtime_ptr == nullptr) {
+		return;
+	}
+	for (std::atomic_uint64_t &time : runtime_ptr->sampled_operation_times) {
+		time.store(0, std::memory_order_relaxed);
+	}
+	runtime_ptr->sampled_blocks.store(0, std::memory_order_relaxed);
+	runtime_ptr->sampled_voxels.store(0, std::memory_order_relaxed);
+}
+
 // TODO Optimization: generating indices and weights on every voxel of a block might be avoidable
 // Instead, we could only generate them near zero-crossings, because this is where materials will be seen.
 // The problem is that it's harder to manage at the moment, to support edited blocks and LOD...
@@ -334,103 +481,18 @@ void gather_indices_and_weights_from_single_texture(
 	}
 }
 
-template <typename F, typename Data_T>
-void fill_zx_sdf_slice(
-		Span<Data_T> channel_data,
-		float sdf_scale,
-		Vector3i rmin,
-		Vector3i rmax,
-		int ry,
-		int x_stride,
-		const float *src_data,
-		Vector3i buffer_size,
-		F convert_func
-) {
-	unsigned int src_i = 0;
-	for (int rz = rmin.z; rz < rmax.z; ++rz) {
-		unsigned int dst_i = Vector3iUtil::get_zxy_index(Vector3i(rmin.x, ry, rz), buffer_size);
-		for (int rx = rmin.x; rx < rmax.x; ++rx) {
-			channel_data[dst_i] = convert_func(sdf_scale * src_data[src_i]);
-			++src_i;
-			dst_i += x_stride;
-		}
-	}
-}
-
 void fill_zx_sdf_slice(
-		const pg::Runtime::Buffer &sdf_buffer,
+		Span<const float> sdf_slice,
 		VoxelBuffer &out_buffer,
 		unsigned int channel,
-		VoxelBuffer::Depth channel_depth,
-		float sdf_scale,
 		Vector3i rmin,
 		Vector3i rmax,
 		int ry
 ) {
 	ZN_PROFILE_SCOPE_NAMED("Copy SDF to block");
-
-	if (out_buffer.get_channel_compression(channel) != VoxelBuffer::COMPRESSION_NONE) {
-		out_buffer.decompress_channel(channel);
-	}
-	Span<uint8_t> channel_bytes;
-	ERR_FAIL_COND(!out_buffer.get_channel_as_bytes(channel, channel_bytes));
-	const Vector3i buffer_size = out_buffer.get_size();
-	const unsigned int x_stride = Vector3iUtil::get_zxy_index(Vector3i(1, 0, 0), buffer_size) -
-			Vector3iUtil::get_zxy_index(Vector3i(0, 0, 0), buffer_size);
-
-	switch (channel_depth) {
-		case VoxelBuffer::DEPTH_8_BIT:
-			fill_zx_sdf_slice(
-					channel_bytes, sdf_scale, rmin, rmax, ry, x_stride, sdf_buffer.data, buffer_size, snorm_to_s8
-			);
-			break;
-
-		case VoxelBuffer::DEPTH_16_BIT:
-			fill_zx_sdf_slice(
-					channel_bytes.reinterpret_cast_to<uint16_t>(),
-					sdf_scale,
-					rmin,
-					rmax,
-					ry,
-					x_stride,
-					sdf_buffer.data,
-					buffer_size,
-					snorm_to_s16
-			);
-			break;
-
-		case VoxelBuffer::DEPTH_32_BIT:
-			fill_zx_sdf_slice(
-					channel_bytes.reinterpret_cast_to<float>(),
-					sdf_scale,
-					rmin,
-					rmax,
-					ry,
-					x_stride,
-					sdf_buffer.data,
-					buffer_size,
-					[](float v) { return v; }
-			);
-			break;
-
-		case VoxelBuffer::DEPTH_64_BIT:
-			fill_zx_sdf_slice(
-					channel_bytes.reinterpret_cast_to<double>(),
-					sdf_scale,
-					rmin,
-					rmax,
-					ry,
-					x_stride,
-					sdf_buffer.data,
-					buffer_size,
-					[](double v) { return v; }
-			);
-			break;
-
-		default:
-			ZN_PRINT_ERROR(format("Unknown depth {}", channel_depth));
-			break;
-	}
+	// Values get scaled depending on the depth of the channel, to make better use of the offered resolution
+	const Box3i box(Vector3i(rmin.x, ry, rmin.z), Vector3i(rmax.x - rmin.x, 1, rmax.z - rmin.z));
+	out_buffer.set_box_f(box, channel, sdf_slice.sub(0, Vector3iUtil::get_volume_u64(box.size)));
 }
 
 template <typename F, typename Data_T>
@@ -521,6 +583,50 @@ void fill_zx_integer_slice(
 	}
 }
 
+void save_outer_group_results(const pg::Runtime &runtime, const pg::Runtime::State &state, Span<float> dst) {
+	const unsigned int buffer_size = state.get_buffer_size();
+	unsigned int i = 0;
+	for (const uint16_t address : runtime.get_outer_group_output_addresses()) {
+		const pg::Runtime::Buffer &buffer = state.get_buffer(address);
+		Span<const float>(buffer.data, buffer_size).copy_to(dst.sub(i, buffer_size));
+		i += buffer_size;
+	}
+}
+
+void restore_outer_group_results(const pg::Runtime &runtime, pg::Runtime::State &state, Span<const float> src) {
+	const unsigned int buffer_size = state.get_buffer_size();
+	unsigned int i = 0;
+	for (const uint16_t address : runtime.get_outer_group_output_addresses()) {
+		const pg::Runtime::Buffer &buffer = state.get_buffer(address);
+		src.sub(i, buffer_size).copy_to(Span<float>(buffer.data, buffer_size));
+		i += buffer_size;
+	}
+}
+
+// Areas smaller than this are not subdivided further. Below that, range analysis and bookkeeping cost too much compared
+// to what clipping would save.
+constexpr int MIN_ADAPTIVE_SUBDIVISION_SIZE = 4;
+
+inline bool can_subdivide_adaptively(Vector3i size) {
+	return size.x == size.y && size.y == size.z && size.x % 2 == 0 && size.x / 2 >= MIN_ADAPTIVE_SUBDIVISION_SIZE;
+}
+
+inline Box3i get_octant(const Box3i &box, unsigned int octant_index) {
+	const Vector3i half_size = box.size >> 1;
+	const Vector3i offset( //
+			(octant_index & 1) != 0 ? half_size.x : 0,
+			(octant_index & 2) != 0 ? half_size.y : 0,
+			(octant_index & 4) != 0 ? half_size.z : 0
+	);
+	return Box3i(box.position + offset, half_size);
+}
+
+void push_octants(StdVector<Box3i> &boxes, const Box3i &box) {
+	for (unsigned int octant_index = 0; octant_index < 8; ++octant_index) {
+		boxes.push_back(get_octant(box, octant_index));
+	}
+}
+
 } // namespace
 
 VoxelGenerator::Result VoxelGeneratorGraph::generate_block(VoxelGenerator::VoxelQueryData input) {
@@ -542,12 +648,6 @@ VoxelGenerator::Result VoxelGeneratorGraph::generate_block(VoxelGenerator::Voxel
 	const VoxelBuffer::ChannelId sdf_channel = VoxelBuffer::CHANNEL_SDF;
 	const Vector3i origin = input.origin_in_voxels;
 
-	// TODO This may be shared across the module
-	// Storing voxels is lossy on some depth configurations. They use normalized SDF,
-	// so we must scale the values to make better use of the offered resolution
-	const VoxelBuffer::Depth sdf_channel_depth = out_buffer.get_channel_depth(sdf_channel);
-	const float sdf_scale = VoxelBuffer::get_sdf_quantization_scale(sdf_channel_depth);
-
 	const VoxelBuffer::ChannelId type_channel = VoxelBuffer::CHANNEL_TYPE;
 	const VoxelBuffer::Depth type_channel_depth = out_buffer.get_channel_depth(type_channel);
 
@@ -571,16 +671,19 @@ VoxelGenerator::Result VoxelGeneratorGraph::generate_block(VoxelGenerator::Voxel
 	// Slice is on the Y axis
 	const unsigned int slice_buffer_size = section_size.x * section_size.z;
 	pg::Runtime &runtime = runtime_ptr->runtime;
-	runtime.prepare_state(cache.state, slice_buffer_size, false);
+	const bool profile = pick_profiling_sample();
+	runtime.prepare_state(cache.state, slice_buffer_size, profile);
+	Span<std::atomic_uint64_t> sampled_operation_times = to_span(runtime_ptr->sampled_operation_times);
+
+	// Voxels of this LOD can't show smaller details anyways. The XZ cache doesn't store this size, which is fine as
+	// long as it only depends on the LOD index.
+	const float min_feature_size = _use_lod_detail_pruning ? input.min_feature_size : 0.f;
+	cache.state.set_min_feature_size(min_feature_size);
 
 	cache.x_cache.resize(slice_buffer_size);
 	cache.y_cache.resize(slice_buffer_size);
 	cache.z_cache.resize(slice_buffer_size);
 
-	Span<float> x_cache = to_span(cache.x_cache);
-	Span<float> y_cache = to_span(cache.y_cache);
-	Span<float> z_cache = to_span(cache.z_cache);
-
 	const float air_sdf = _debug_clipped_blocks ? constants::SDF_FAR_INSIDE : constants::SDF_FAR_OUTSIDE;
 	const float matter_sdf = _debug_clipped_blocks ? constants::SDF_FAR_OUTSIDE : constants::SDF_FAR_INSIDE;
 
@@ -591,13 +694,19 @@ VoxelGenerator::Result VoxelGeneratorGraph::generate_block(VoxelGenerator::Voxel
 	bool all_sdf_is_air = (sdf_output_buffer_index != -1) && (type_output_buffer_index == -1);
 	bool all_sdf_is_matter = all_sdf_is_air;
 
+	// Modifiers are applied to slices of SDF while they are still floats, so they only get quantized once
+	const VoxelModifierStack *modifiers = nullptr;
+	if (input.modifiers != nullptr && sdf_output_buffer_index != -1) {
+		modifiers = input.modifiers;
+		cache.modified_sdf_slice.resize(slice_buffer_size);
+		result.modifiers_applied = true;
+	}
+
 	math::Interval sdf_input_range;
 	Span<float> input_sdf_full_cache;
-	Span<float> input_sdf_slice_cache;
 	if (runtime_ptr->sdf_input_index != -1) {
 		ZN_PROFILE_SCOPE();
 		cache.input_sdf_slice_cache.resize(slice_buffer_size);
-		input_sdf_slice_cache = to_span(cache.input_sdf_slice_cache);
 
 		const size_t volume = Vector3iUtil::get_volume_u64(bs);
 		cache.input_sdf_full_cache.resize(volume);
@@ -612,202 +721,347 @@ VoxelGenerator::Result VoxelGeneratorGraph::generate_block(VoxelGenerator::Voxel
 		}
 	}
 
-	// For each subdivision of the block
-	for (int sz = 0; sz < bs.z; sz += section_size.z) {
-		for (int sy = 0; sy < bs.y; sy += section_size.y) {
-			for (int sx = 0; sx < bs.x; sx += section_size.x) {
-				ZN_PROFILE_SCOPE_NAMED("Section");
-
-				const Vector3i rmin(sx, sy, sz);
-				const Vector3i rmax = rmin + Vector3i(section_size);
-				const Vector3i gmin = origin + (rmin << input.lod);
-				const Vector3i gmax = origin + (rmax << input.lod);
-
-				// Do a quick analysis of the area. We'll only compute voxels if necessary.
-				{
-					QueryInputs<math::Interval> range_inputs(
-							*runtime_ptr,
-							math::Interval(gmin.x, gmax.x),
-							math::Interval(gmin.y, gmax.y),
-							math::Interval(gmin.z, gmax.z),
-							sdf_input_range
-					);
-					runtime.analyze_range(cache.state, range_inputs.get());
+	const unsigned int outer_group_values_count =
+			runtime.get_outer_group_output_addresses().size() * slice_buffer_size;
+	const bool use_xz_cache =
+			_use_xz_caching && outer_group_values_count > 0 && runtime_ptr->xz_cache.get_max_entries() > 0;
+	if (use_xz_cache) {
+		cache.xz_cache_values.resize(outer_group_values_count);
+	}
+
+	// Areas of the block to generate. They are processed depth-first, and get subdivided when they are larger than
+	// sections, or when range analysis finds that parts of them can be clipped.
+	const bool use_adaptive_subdivision = _use_subdivision && _use_adaptive_subdivision;
+	StdVector<Box3i> &boxes = cache.boxes;
+	boxes.clear();
+	if (use_adaptive_subdivision && section_size != bs && bs.x == bs.y && bs.y == bs.z &&
+		math::is_power_of_two(bs.x / section_size.x)) {
+		// Start with the whole block, so large areas can be clipped with a single analysis
+		boxes.push_back(Box3i(Vector3i(), bs));
+	} else {
+		for (int sz = 0; sz < bs.z; sz += section_size.z) {
+			for (int sy = 0; sy < bs.y; sy += section_size.y) {
+				for (int sx = 0; sx < bs.x; sx += section_size.x) {
+					boxes.push_back(Box3i(Vector3i(sx, sy, sz), section_size));
 				}
+			}
+		}
+	}
 
-				SmallVector<unsigned int, pg::Runtime::MAX_OUTPUTS> required_outputs;
+	auto analyze_box = [&runtime, &cache, &runtime_ptr, origin, &input, sdf_input_range](const Box3i box) {
+		const Vector3i gmin = origin + (box.position << input.lod);
+		const Vector3i gmax = origin + ((box.position + box.size) << input.lod);
+		QueryInputs<math::Interval> range_inputs(
+				*runtime_ptr,
+				math::Interval(gmin.x, gmax.x),
+				math::Interval(gmin.y, gmax.y),
+				math::Interval(gmin.z, gmax.z),
+				sdf_input_range
+		);
+		runtime.analyze_range(cache.state, range_inputs.get());
+	};
 
-				bool sdf_is_air = true;
-				bool sdf_is_uniform = true;
-				if (sdf_output_buffer_index != -1) {
-					const math::Interval sdf_range = cache.state.get_range(sdf_output_buffer_index);
-					bool sdf_is_matter = false;
+	auto is_sdf_clipped = [clip_threshold](const math::Interval sdf_range) {
+		return sdf_range.min > clip_threshold || sdf_range.max < -clip_threshold;
+	};
 
-					if (sdf_range.min > clip_threshold && sdf_range.max > clip_threshold) {
-						out_buffer.fill_area_f(air_sdf, rmin, rmax, sdf_channel);
-						sdf_is_air = true;
+	unsigned int prepared_buffer_size = slice_buffer_size;
+	RangeAnalysisStats stats;
 
-					} else if (sdf_range.min < -clip_threshold && sdf_range.max < -clip_threshold) {
-						out_buffer.fill_area_f(matter_sdf, rmin, rmax, sdf_channel);
-						sdf_is_air = false;
-						sdf_is_matter = true;
+	while (boxes.size() > 0) {
+		ZN_PROFILE_SCOPE_NAMED("Section");
 
-					} else if (sdf_range.is_single_value()) {
-						out_buffer.fill_area_f(sdf_range.min, rmin, rmax, sdf_channel);
-						sdf_is_air = sdf_range.min > 0.f;
-						sdf_is_matter = !sdf_is_air;
+		const Box3i box = boxes.back();
+		boxes.pop_back();
 
-					} else {
-						// SDF is not uniform, we'll need to compute it per voxel
-						required_outputs.push_back(runtime_ptr->sdf_output_index);
-						sdf_is_air = false;
-						sdf_is_uniform = false;
-					}
+		const Vector3i rmin = box.position;
+		const Vector3i rmax = box.position + box.size;
+		const Vector3i gmin = origin + (rmin << input.lod);
 
-					all_sdf_is_air = all_sdf_is_air && sdf_is_air;
-					all_sdf_is_matter = all_sdf_is_matter && sdf_is_matter;
-				}
+		// Do a quick analysis of the area. We'll only compute voxels if necessary.
+		analyze_box(box);
+		++stats.analyzed_boxes;
 
-				bool type_is_uniform = false;
-				if (type_output_buffer_index != -1) {
-					const math::Interval type_range = cache.state.get_range(type_output_buffer_index);
-					if (type_range.is_single_value()) {
-						out_buffer.fill_area(int(type_range.min), rmin, rmax, type_channel);
-						type_is_uniform = true;
-					} else {
-						// Types are not uniform, we'll need to compute them per voxel
-						required_outputs.push_back(runtime_ptr->type_output_index);
-					}
-				}
+		const bool box_has_modifiers =
+				modifiers != nullptr && modifiers->has_modifiers_in_aabb(AABB(gmin, box.size << input.lod));
 
-				if (runtime_ptr->weight_outputs_count > 0 && !sdf_is_air) {
-					// We can skip this when SDF is air because there won't be any matter to give a texture to
-					// TODO Range analysis on that?
-					// Not easy to do that from here, they would have to ALL be locally constant in order to use a
-					// short-circuit...
-					for (unsigned int i = 0; i < runtime_ptr->weight_outputs_count; ++i) {
-						required_outputs.push_back(runtime_ptr->weight_output_indices[i]);
-					}
-				}
+		SmallVector<unsigned int, pg::Runtime::MAX_OUTPUTS> required_outputs;
 
-				// TODO Instead of filling this ourselves, can we leave this to the graph runtime?
-				// Because currently our logic seems redundant and more complicated, since we also have to not request
-				// those outputs later if any other output isn't uniform. Instead, the graph runtime can figure out
-				// that stuff is constant.
-				bool single_texture_is_uniform = false;
-				if (runtime_ptr->single_texture_output_index != -1 && !sdf_is_air) {
-					const math::Interval index_range =
-							cache.state.get_range(runtime_ptr->single_texture_output_buffer_index);
-					if (index_range.is_single_value()) {
-						// Make sure other indices are different so the weights associated with them don't override the
-						// first index's weight
-						const int index = static_cast<int>(index_range.min);
-						const uint16_t encoded_indices = make_encoded_indices_for_single_texture(index);
-						const uint16_t encoded_weights = make_encoded_weights_for_single_texture();
-						out_buffer.fill_area(encoded_indices, rmin, rmax, VoxelBuffer::CHANNEL_INDICES);
-						out_buffer.fill_area(encoded_weights, rmin, rmax, VoxelBuffer::CHANNEL_WEIGHTS);
-						single_texture_is_uniform = true;
-					} else {
-						required_outputs.push_back(runtime_ptr->single_texture_output_index);
-					}
-				}
+		bool sdf_is_air = true;
+		bool sdf_is_matter = false;
+		bool sdf_is_uniform = true;
+		if (sdf_output_buffer_index != -1) {
+			const math::Interval sdf_range = cache.state.get_range(sdf_output_buffer_index);
+
+			if (box_has_modifiers) {
+				// Range analysis doesn't account for modifiers, which can change SDF anywhere in the box
+				required_outputs.push_back(runtime_ptr->sdf_output_index);
+				sdf_is_air = false;
+				sdf_is_uniform = false;
 
-				if (required_outputs.size() == 0) {
-					// We found all we need with range analysis, no need to calculate per voxel.
+			} else if (sdf_range.min > clip_threshold && sdf_range.max > clip_threshold) {
+				out_buffer.fill_area_f(air_sdf, rmin, rmax, sdf_channel);
+				sdf_is_air = true;
+
+			} else if (sdf_range.min < -clip_threshold && sdf_range.max < -clip_threshold) {
+				out_buffer.fill_area_f(matter_sdf, rmin, rmax, sdf_channel);
+				sdf_is_air = false;
+				sdf_is_matter = true;
+
+			} else if (sdf_range.is_single_value()) {
+				out_buffer.fill_area_f(sdf_range.min, rmin, rmax, sdf_channel);
+				sdf_is_air = sdf_range.min > 0.f;
+				sdf_is_matter = !sdf_is_air;
+
+			} else {
+				// SDF is not uniform, we'll need to compute it per voxel
+				required_outputs.push_back(runtime_ptr->sdf_output_index);
+				sdf_is_air = false;
+				sdf_is_uniform = false;
+			}
+		}
+
+		bool type_is_uniform = false;
+		if (type_output_buffer_index != -1) {
+			const math::Interval type_range = cache.state.get_range(type_output_buffer_index);
+			if (type_range.is_single_value()) {
+				out_buffer.fill_area(int(type_range.min), rmin, rmax, type_channel);
+				type_is_uniform = true;
+			} else {
+				// Types are not uniform, we'll need to compute them per voxel
+				required_outputs.push_back(runtime_ptr->type_output_index);
+			}
+		}
+
+		if (runtime_ptr->weight_outputs_count > 0 && !sdf_is_air) {
+			// We can skip this when SDF is air because there won't be any matter to give a texture to
+			// TODO Range analysis on that?
+			// Not easy to do that from here, they would have to ALL be locally constant in order to use a
+			// short-circuit...
+			for (unsigned int i = 0; i < runtime_ptr->weight_outputs_count; ++i) {
+				required_outputs.push_back(runtime_ptr->weight_output_indices[i]);
+			}
+		}
+
+		// TODO Instead of filling this ourselves, can we leave this to the graph runtime?
+		// Because currently our logic seems redundant and more complicated, since we also have to not request
+		// those outputs later if any other output isn't uniform. Instead, the graph runtime can figure out
+		// that stuff is constant.
+		bool single_texture_is_uniform = false;
+		if (runtime_ptr->single_texture_output_index != -1 && !sdf_is_air) {
+			const math::Interval index_range = cache.state.get_range(runtime_ptr->single_texture_output_buffer_index);
+			if (index_range.is_single_value()) {
+				// Make sure other indices are different so the weights associated with them don't override the
+				// first index's weight
+				const int index = static_cast<int>(index_range.min);
+				const uint16_t encoded_indices = make_encoded_indices_for_single_texture(index);
+				const uint16_t encoded_weights = make_encoded_weights_for_single_texture();
+				out_buffer.fill_area(encoded_indices, rmin, rmax, VoxelBuffer::CHANNEL_INDICES);
+				out_buffer.fill_area(encoded_weights, rmin, rmax, VoxelBuffer::CHANNEL_WEIGHTS);
+				single_texture_is_uniform = true;
+			} else {
+				required_outputs.push_back(runtime_ptr->single_texture_output_index);
+			}
+		}
+
+		if (required_outputs.size() > 0) {
+			if (box.size.x > section_size.x) {
+				// Too large to be computed per voxel, since buffers are sized for sections
+				push_octants(boxes, box);
+				continue;
+			}
+
+			if (!sdf_is_uniform && use_adaptive_subdivision && can_subdivide_adaptively(box.size)) {
+				// SDF can't be clipped in the whole area, but maybe it can in some parts of it. Subdividing is only
+				// worth it if at least one of them can, otherwise the area is computed as a whole.
+				bool subdivide = false;
+				for (unsigned int octant_index = 0; octant_index < 8 && !subdivide; ++octant_index) {
+					analyze_box(get_octant(box, octant_index));
+					++stats.analyzed_boxes;
+					subdivide = is_sdf_clipped(cache.state.get_range(sdf_output_buffer_index));
+				}
+				if (subdivide) {
+					push_octants(boxes, box);
 					continue;
 				}
+				// Results of the whole area are needed to compute it
+				analyze_box(box);
+			}
+		}
 
-				// At least one channel needs per-voxel computation.
+		if (sdf_output_buffer_index != -1) {
+			all_sdf_is_air = all_sdf_is_air && sdf_is_air;
+			all_sdf_is_matter = all_sdf_is_matter && sdf_is_matter;
+		}
 
-				if (_use_optimized_execution_map) {
-					runtime.generate_optimized_execution_map(
-							cache.state, cache.optimized_execution_map, to_span(required_outputs), false
-					);
-				}
+		const uint64_t box_volume = Vector3iUtil::get_volume_u64(box.size);
 
-				{
-					unsigned int i = 0;
-					for (int rz = rmin.z, gz = gmin.z; rz < rmax.z; ++rz, gz += stride) {
-						for (int rx = rmin.x, gx = gmin.x; rx < rmax.x; ++rx, gx += stride) {
-							x_cache[i] = gx;
-							z_cache[i] = gz;
-							++i;
-						}
-					}
+		if (required_outputs.size() == 0) {
+			// We found all we need with range analysis, no need to calculate per voxel.
+			stats.clipped_voxels += box_volume;
+			continue;
+		}
+
+		// At least one channel needs per-voxel computation.
+		stats.computed_voxels += box_volume;
+
+		// Boxes can be smaller than sections when subdivided adaptively
+		const unsigned int box_buffer_size = box.size.x * box.size.z;
+		if (box_buffer_size != prepared_buffer_size) {
+			runtime.prepare_state(cache.state, box_buffer_size, profile);
+			cache.state.set_min_feature_size(min_feature_size);
+			prepared_buffer_size = box_buffer_size;
+		}
+		Span<float> x_cache = to_span(cache.x_cache).sub(0, box_buffer_size);
+		Span<float> y_cache = to_span(cache.y_cache).sub(0, box_buffer_size);
+		Span<float> z_cache = to_span(cache.z_cache).sub(0, box_buffer_size);
+		Span<float> input_sdf_slice_cache;
+		if (input_sdf_full_cache.size() != 0) {
+			input_sdf_slice_cache = to_span(cache.input_sdf_slice_cache).sub(0, box_buffer_size);
+		}
+
+		if (_use_optimized_execution_map) {
+			runtime.generate_optimized_execution_map(
+					cache.state, cache.optimized_execution_map, to_span(required_outputs), false
+			);
+		}
+
+		{
+			unsigned int i = 0;
+			for (int rz = rmin.z, gz = gmin.z; rz < rmax.z; ++rz, gz += stride) {
+				for (int rx = rmin.x, gx = gmin.x; rx < rmax.x; ++rx, gx += stride) {
+					x_cache[i] = gx;
+					z_cache[i] = gz;
+					++i;
 				}
+			}
+		}
 
-				for (int ry = rmin.y, gy = gmin.y; ry < rmax.y; ++ry, gy += stride) {
-					ZN_PROFILE_SCOPE_NAMED("Full slice");
-
-					y_cache.fill(gy);
-
-					if (input_sdf_full_cache.size() != 0) {
-						// Copy input SDF using expected coordinate convention.
-						// VoxelBuffer is ZXY, but the graph runs in YXZ.
-						unsigned int i = 0;
-						for (int rz = rmin.z; rz < rmax.z; ++rz) {
-							for (int rx = rmin.x; rx < rmax.x; ++rx) {
-								const unsigned int loc = Vector3iUtil::get_zxy_index(rx, ry, rz, bs.x, bs.y);
-								input_sdf_slice_cache[i] = input_sdf_full_cache[loc];
-								++i;
-							}
-						}
-					}
+		// Results of the outer group may have been computed already by a block above or below
+		bool outer_group_ready = false;
+		if (use_xz_cache) {
+			const Vector2i xz_origin(gmin.x, gmin.z);
+			const Vector2i xz_size(box.size.x, box.size.z);
+			const unsigned int values_count = runtime.get_outer_group_output_addresses().size() * box_buffer_size;
+			Span<float> values = to_span(cache.xz_cache_values).sub(0, values_count);
+			if (runtime_ptr->xz_cache.try_load(xz_origin, input.lod, xz_size, values)) {
+				restore_outer_group_results(runtime, cache.state, values);
+			} else {
+				y_cache.fill(gmin.y);
+				QueryInputs query_inputs(*runtime_ptr, x_cache, y_cache, z_cache, input_sdf_slice_cache);
+				runtime.generate_outer_group(cache.state, query_inputs.get());
+				save_outer_group_results(runtime, cache.state, values);
+				runtime_ptr->xz_cache.save(xz_origin, input.lod, xz_size, values);
+
+				if (profile) {
+					// Times are recorded by index in the execution map, which is not the same for the next queries
+					accumulate_sampled_profiling(
+							cache.state, runtime.get_default_execution_map(), sampled_operation_times
+					);
+					cache.state.reset_execution_times();
+				}
+			}
+			outer_group_ready = true;
+		}
 
-					// Full query (unless using execution map)
-					{
-						QueryInputs query_inputs(*runtime_ptr, x_cache, y_cache, z_cache, input_sdf_slice_cache);
-						runtime.generate_set(
-								cache.state,
-								query_inputs.get(),
-								_use_xz_caching && ry != rmin.y,
-								_use_optimized_execution_map ? &cache.optimized_execution_map : nullptr
-						);
-					}
+		for (int ry = rmin.y, gy = gmin.y; ry < rmax.y; ++ry, gy += stride) {
+			ZN_PROFILE_SCOPE_NAMED("Full slice");
 
-					if (sdf_output_buffer_index != -1
-						// If SDF was found uniform, we already filled the results, and we did not require it in the
-						// query. But if another output exists, a query might still run (so we end up at this
-						// `if`), and we should not gather SDF results. Otherwise it would overwrite the slice with
-						// garbage since SDF was skipped.
-						// The same logic goes for other outputs: if they aren't in the query, we must not fill
-						// them.
-						&& !sdf_is_uniform) {
-						const pg::Runtime::Buffer &sdf_buffer = cache.state.get_buffer(sdf_output_buffer_index);
-						fill_zx_sdf_slice(
-								sdf_buffer, out_buffer, sdf_channel, sdf_channel_depth, sdf_scale, rmin, rmax, ry
-						);
-					}
+			y_cache.fill(gy);
 
-					if (type_output_buffer_index != -1 && !type_is_uniform) {
-						const pg::Runtime::Buffer &type_buffer = cache.state.get_buffer(type_output_buffer_index);
-						fill_zx_integer_slice(
-								type_buffer, out_buffer, type_channel, type_channel_depth, rmin, rmax, ry
-						);
+			if (input_sdf_full_cache.size() != 0) {
+				// Copy input SDF using expected coordinate convention.
+				// VoxelBuffer is ZXY, but the graph runs in YXZ.
+				unsigned int i = 0;
+				for (int rz = rmin.z; rz < rmax.z; ++rz) {
+					for (int rx = rmin.x; rx < rmax.x; ++rx) {
+						const unsigned int loc = Vector3iUtil::get_zxy_index(rx, ry, rz, bs.x, bs.y);
+						input_sdf_slice_cache[i] = input_sdf_full_cache[loc];
+						++i;
 					}
+				}
+			}
 
-					if (runtime_ptr->single_texture_output_index != -1 && !single_texture_is_uniform) {
-						gather_indices_and_weights_from_single_texture(
-								runtime_ptr->single_texture_output_buffer_index, cache.state, rmin, rmax, ry, out_buffer
-						);
-					}
+			// Full query (unless using execution map)
+			{
+				QueryInputs query_inputs(*runtime_ptr, x_cache, y_cache, z_cache, input_sdf_slice_cache);
+				runtime.generate_set(
+						cache.state,
+						query_inputs.get(),
+						outer_group_ready || (_use_xz_caching && ry != rmin.y),
+						_use_optimized_execution_map ? &cache.optimized_execution_map : nullptr
+				);
+			}
 
-					if (runtime_ptr->weight_outputs_count > 0) {
-						gather_indices_and_weights(
-								to_span_const(runtime_ptr->weight_outputs, runtime_ptr->weight_outputs_count),
-								cache.state,
-								rmin,
-								rmax,
-								ry,
-								out_buffer,
-								spare_texture_indices
-						);
-					}
+			if (sdf_output_buffer_index != -1
+				// If SDF was found uniform, we already filled the results, and we did not require it in the
+				// query. But if another output exists, a query might still run (so we end up at this
+				// `if`), and we should not gather SDF results. Otherwise it would overwrite the slice with
+				// garbage since SDF was skipped.
+				// The same logic goes for other outputs: if they aren't in the query, we must not fill
+				// them.
+				&& !sdf_is_uniform) {
+				const pg::Runtime::Buffer &sdf_buffer = cache.state.get_buffer(sdf_output_buffer_index);
+				Span<const float> sdf_slice(sdf_buffer.data, box_buffer_size);
+				if (box_has_modifiers) {
+					// Modified in a copy, because the output buffer may be re-used by the next slices when it comes
+					// from the XZ outer group
+					Span<float> modified_sdf_slice = to_span(cache.modified_sdf_slice).sub(0, box_buffer_size);
+					sdf_slice.copy_to(modified_sdf_slice);
+					modifiers->apply_to_grid(
+							modified_sdf_slice,
+							(origin >> input.lod) + Vector3i(rmin.x, ry, rmin.z),
+							Vector3i(box.size.x, 1, box.size.z),
+							input.lod
+					);
+					sdf_slice = modified_sdf_slice;
 				}
+				fill_zx_sdf_slice(sdf_slice, out_buffer, sdf_channel, rmin, rmax, ry);
 			}
+
+			if (type_output_buffer_index != -1 && !type_is_uniform) {
+				const pg::Runtime::Buffer &type_buffer = cache.state.get_buffer(type_output_buffer_index);
+				fill_zx_integer_slice(type_buffer, out_buffer, type_channel, type_channel_depth, rmin, rmax, ry);
+			}
+
+			if (runtime_ptr->single_texture_output_index != -1 && !single_texture_is_uniform) {
+				gather_indices_and_weights_from_single_texture(
+						runtime_ptr->single_texture_output_buffer_index, cache.state, rmin, rmax, ry, out_buffer
+				);
+			}
+
+			if (runtime_ptr->weight_outputs_count > 0) {
+				gather_indices_and_weights(
+						to_span_const(runtime_ptr->weight_outputs, runtime_ptr->weight_outputs_count),
+						cache.state,
+						rmin,
+						rmax,
+						ry,
+						out_buffer,
+						spare_texture_indices
+				);
+			}
+		}
+
+		if (profile) {
+			accumulate_sampled_profiling(
+					cache.state,
+					_use_optimized_execution_map ? cache.optimized_execution_map : runtime.get_default_execution_map(),
+					sampled_operation_times
+			);
+			cache.state.reset_execution_times();
 		}
 	}
 
+	if (profile) {
+		runtime_ptr->sampled_blocks.fetch_add(1, std::memory_order_relaxed);
+		runtime_ptr->sampled_voxels.fetch_add(stats.computed_voxels, std::memory_order_relaxed);
+	}
+
+	_stats_analyzed_boxes.fetch_add(stats.analyzed_boxes, std::memory_order_relaxed);
+	_stats_clipped_voxels.fetch_add(stats.clipped_voxels, std::memory_order_relaxed);
+	_stats_computed_voxels.fetch_add(stats.computed_voxels, std::memory_order_relaxed);
+
 	out_buffer.compress_uniform_channels();
 
 	// This is different from finding out that the buffer is uniform.
@@ -1164,6 +1418,10 @@ pg::CompilationResult VoxelGeneratorGraph::compile(bool debug) {
 		r->spare_texture_indices = spare_indices;
 	}
 
+	r->xz_cache.set_max_entries(_xz_cache_size);
+	r->sampled_operation_times =
+			StdVector<std::atomic_uint64_t>(runtime.get_default_execution_map().operations.size());
+
 	// Store valid result
 	RWLockWrite wlock(_runtime_lock);
 	_runtime = r;
@@ -1949,10 +2207,12 @@ float VoxelGeneratorGraph::debug_measure_microseconds_per_voxel(
 		if (per_node_profiling) {
 			const pg::Runtime::ExecutionMap &execution_map = runtime.get_default_execution_map();
 			node_profiling_info->resize(execution_map.debug_nodes.size());
+			const uint64_t sample_count = uint64_t(cube_count) * cube_size * cube_volume;
 			for (unsigned int i = 0; i < node_profiling_info->size(); ++i) {
 				NodeProfilingInfo &info = (*node_profiling_info)[i];
 				info.node_id = execution_map.debug_nodes[i];
 				info.microseconds = cache.state.get_execution_time(i);
+				info.nanoseconds_per_sample = 1000.0 * double(info.microseconds) / double(sample_count);
 			}
 		}
 	}
@@ -2077,7 +2337,10 @@ Dictionary VoxelGeneratorGraph::_b_compile() {
 	pg::CompilationResult res = compile(false);
 	Dictionary d;
 	d["success"] = res.success;
-	if (!res.success) {
+	if (res.success) {
+		d["operation_count_before_optimization"] = res.operation_count_before_optimization;
+		d["operation_count"] = res.operation_count;
+	} else {
 		d["message"] = res.message;
 		d["node_id"] = res.node_id;
 	}
@@ -2124,12 +2387,27 @@ void VoxelGeneratorGraph::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_subdivision_size", "size"), &Self::set_subdivision_size);
 	ClassDB::bind_method(D_METHOD("get_subdivision_size"), &Self::get_subdivision_size);
 
+	ClassDB::bind_method(D_METHOD("set_use_adaptive_subdivision", "use"), &Self::set_use_adaptive_subdivision);
+	ClassDB::bind_method(D_METHOD("is_using_adaptive_subdivision"), &Self::is_using_adaptive_subdivision);
+
 	ClassDB::bind_method(D_METHOD("set_debug_clipped_blocks", "enabled"), &Self::set_debug_clipped_blocks);
 	ClassDB::bind_method(D_METHOD("is_debug_clipped_blocks"), &Self::is_debug_clipped_blocks);
 
 	ClassDB::bind_method(D_METHOD("set_use_xz_caching", "enabled"), &Self::set_use_xz_caching);
 	ClassDB::bind_method(D_METHOD("is_using_xz_caching"), &Self::is_using_xz_caching);
 
+	ClassDB::bind_method(D_METHOD("set_xz_cache_size", "entry_count"), &Self::set_xz_cache_size);
+	ClassDB::bind_method(D_METHOD("get_xz_cache_size"), &Self::get_xz_cache_size);
+
+	ClassDB::bind_method(D_METHOD("set_use_lod_detail_pruning", "enabled"), &Self::set_use_lod_detail_pruning);
+	ClassDB::bind_method(D_METHOD("is_using_lod_detail_pruning"), &Self::is_using_lod_detail_pruning);
+
+	ClassDB::bind_method(D_METHOD("set_profiling_sample_rate", "rate"), &Self::set_profiling_sample_rate);
+	ClassDB::bind_method(D_METHOD("get_profiling_sample_rate"), &Self::get_profiling_sample_rate);
+
+	ClassDB::bind_method(D_METHOD("get_sampled_profiling_results"), &Self::get_sampled_profiling_results);
+	ClassDB::bind_method(D_METHOD("reset_sampled_profiling_results"), &Self::reset_sampled_profiling_results);
+
 	ClassDB::bind_method(D_METHOD("compile"), &Self::_b_compile);
 
 	// ClassDB::bind_method(D_METHOD("generate_single"), &Self::_b_generate_single);
@@ -2180,10 +2458,26 @@ void VoxelGeneratorGraph::_bind_methods() {
 	);
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_subdivision"), "set_use_subdivision", "is_using_subdivision");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "subdivision_size"), "set_subdivision_size", "get_subdivision_size");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "use_adaptive_subdivision"),
+			"set_use_adaptive_subdivision",
+			"is_using_adaptive_subdivision"
+	);
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_xz_caching"), "set_use_xz_caching", "is_using_xz_caching");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "xz_cache_size"), "set_xz_cache_size", "get_xz_cache_size");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "use_lod_detail_pruning"),
+			"set_use_lod_detail_pruning",
+			"is_using_lod_detail_pruning"
+	);
 	ADD_PROPERTY(
 			PropertyInfo(Variant::BOOL, "debug_block_clipping"), "set_debug_clipped_blocks", "is_debug_clipped_blocks"
 	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::FLOAT, "profiling_sample_rate", PROPERTY_HINT_RANGE, "0.0,1.0,0.001"),
+			"set_profiling_sample_rate",
+			"get_profiling_sample_rate"
+	);
 
 	ADD_SIGNAL(MethodInfo(SIGNAL_NODE_NAME_CHANGED, PropertyInfo(Variant::INT, "node_id")));
 }
@@ -6,6 +6,7 @@
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/core/dictionary.h"
 #include "../../util/macros.h"
+#include "../../util/math/box3i.h"
 #include "../../util/math/vector2.h"
 #include "../../util/math/vector3.h"
 #include "../../util/math/vector3f.h"
@@ -15,7 +16,9 @@
 #include "program_graph.h"
 #include "voxel_graph_function.h"
 #include "voxel_graph_runtime.h"
+#include "xz_cache.h"
 
+#include <atomic>
 #include <memory>
 
 ZN_GODOT_FORWARD_DECLARE(class Image)
@@ -52,12 +55,46 @@ public:
 	void set_subdivision_size(int size);
 	int get_subdivision_size() const;
 
+	void set_use_adaptive_subdivision(bool use);
+	bool is_using_adaptive_subdivision() const;
+
 	void set_debug_clipped_blocks(bool enabled);
 	bool is_debug_clipped_blocks() const;
 
 	void set_use_xz_caching(bool enabled);
 	bool is_using_xz_caching() const;
 
+	void set_xz_cache_size(int entry_count);
+	int get_xz_cache_size() const;
+
+	void set_use_lod_detail_pruning(bool enabled);
+	bool is_using_lod_detail_pruning() const;
+
+	pg::XZCache::Stats get_xz_cache_stats() const;
+
+	// Counts how much work range analysis saved in `generate_block`, accumulated across all threads
+	struct RangeAnalysisStats {
+		// Amount of areas on which range analysis ran
+		uint64_t analyzed_boxes = 0;
+		// Voxels that were filled from range analysis results only
+		uint64_t clipped_voxels = 0;
+		// Voxels that had to be computed one by one
+		uint64_t computed_voxels = 0;
+	};
+
+	RangeAnalysisStats get_range_analysis_stats() const;
+	void reset_range_analysis_stats();
+
+	// Fraction of `generate_block` calls in which the time spent by each node is measured. It is meant to be low enough
+	// to be left on in exported games. 0 turns it off.
+	void set_profiling_sample_rate(float rate);
+	float get_profiling_sample_rate() const;
+
+	// Time spent by each node in sampled calls, accumulated across all threads since the graph was compiled or since
+	// the last reset
+	Dictionary get_sampled_profiling_results() const;
+	void reset_sampled_profiling_results();
+
 	// VoxelGenerator implementation
 
 	int get_used_channels_mask() const override;
@@ -121,6 +158,8 @@ public:
 	struct NodeProfilingInfo {
 		uint32_t node_id;
 		uint32_t microseconds;
+		// Average time the node took to process one sample, which is easier to compare between nodes and graphs
+		float nanoseconds_per_sample;
 	};
 
 	float debug_measure_microseconds_per_voxel(bool singular, StdVector<NodeProfilingInfo> *node_profiling_info);
@@ -179,6 +218,10 @@ private:
 	// Blocks size must be a multiple of the subdivision size.
 	bool _use_subdivision = true;
 	int _subdivision_size = 16;
+	// When subdivision is used, areas where range analysis cannot clip SDF are further split in octants, down to 4x4x4
+	// voxels, as long as some of them can be clipped. Blocks larger than the subdivision size are also analyzed as a
+	// whole first.
+	bool _use_adaptive_subdivision = true;
 	// When enabled, the generator will attempt to optimize out nodes that don't need to run in specific areas,
 	// if their output range is considered to not affect the final result.
 	bool _use_optimized_execution_map = true;
@@ -186,9 +229,23 @@ private:
 	// This prevents recalculating values that would otherwise be the same on each slice.
 	// It helps a lot when part of the graph is generating a heightmap for example.
 	bool _use_xz_caching = true;
+	// When XZ caching is enabled, results of nodes only depending on X and Z are also kept for this many areas of the
+	// XZ plane, so blocks above or below each other can reuse them. 0 only caches within each block.
+	int _xz_cache_size = 256;
+	// When enabled, blocks of LOD above 0 are generated without details smaller than their voxels can represent, such
+	// as the finest octaves of fractal noises. It is faster, but surfaces can differ slightly from one LOD to the next.
+	bool _use_lod_detail_pruning = false;
 	// If true, inverts clipped blocks so they create visual artifacts making the clipped area visible.
 	bool _debug_clipped_blocks = false;
 
+	std::atomic_uint64_t _stats_analyzed_boxes = { 0 };
+	std::atomic_uint64_t _stats_clipped_voxels = { 0 };
+	std::atomic_uint64_t _stats_computed_voxels = { 0 };
+
+	float _profiling_sample_rate = 0.f;
+	// Counts calls to `generate_block` to decide which ones are profiled
+	std::atomic_uint64_t _profiling_call_counter = { 0 };
+
 	// Only compiling and generation methods are thread-safe.
 
 	// Wrapper around the runtime with extra information specialized for the use case
@@ -218,6 +275,16 @@ private:
 		// List of indices to feed queries. The order doesn't matter, can be different from `weight_outputs`.
 		FixedArray<unsigned int, 16> weight_output_indices;
 		unsigned int weight_outputs_count = 0;
+
+		// Results of the outer group shared between blocks
+		pg::XZCache xz_cache;
+
+		// Microseconds spent in each operation during sampled calls to `generate_block`, indexed like
+		// `Program::decoded_operations`
+		StdVector<std::atomic_uint64_t> sampled_operation_times;
+		std::atomic_uint64_t sampled_blocks = { 0 };
+		// Voxels that were computed one by one in sampled blocks, excluding those clipped by range analysis
+		std::atomic_uint64_t sampled_voxels = { 0 };
 	};
 
 	// Helper to setup inputs for runtime queries
@@ -259,9 +326,19 @@ private:
 		// TODO Use the runtime and state from `VoxelGraphFunction`
 		pg::Runtime::State state;
 		pg::Runtime::ExecutionMap optimized_execution_map;
+		StdVector<float> xz_cache_values;
+		StdVector<Box3i> boxes;
+		StdVector<float> modified_sdf_slice;
 	};
 
 	static Cache &get_tls_cache();
+
+	bool pick_profiling_sample();
+	static void accumulate_sampled_profiling(
+			const pg::Runtime::State &state,
+			const pg::Runtime::ExecutionMap &execution_map,
+			Span<std::atomic_uint64_t> totals
+	);
 };
 
 } // namespace zylann::voxel
@@ -7,9 +7,12 @@
 #include "../../util/profiling.h"
 #include "../../util/string/expression_parser.h"
 #include "../../util/string/format.h"
+#include "expression_bytecode.h"
 #include "node_type_db.h"
 #include "voxel_graph_function.h"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 
 namespace zylann::voxel::pg {
@@ -393,20 +396,52 @@ CompilationResult expand_expression_node(
 	return result;
 }
 
+// Tells if an expression node can run as a single operation, and has enough sub-expressions to be worth it compared to
+// expanding it into nodes. Invalid expressions are not fused, so they get reported when expanded.
+bool is_expression_node_worth_fusing(const ProgramGraph::Node &node, const NodeTypeDB &type_db) {
+	ZN_ASSERT(node.params.size() != 0);
+	const String code = node.params[0];
+	const CharString code_utf8 = code.utf8();
+
+	const ExpressionParser::Result parse_result =
+			ExpressionParser::parse(code_utf8.get_data(), type_db.get_expression_parser_functions());
+	if (parse_result.error.id != ExpressionParser::ERROR_NONE || parse_result.root == nullptr) {
+		return false;
+	}
+
+	StdVector<std::string_view> input_names;
+	for (const ProgramGraph::Port &port : node.inputs) {
+		input_names.push_back(port.dynamic_name);
+	}
+
+	ExpressionBytecode bytecode;
+	if (!compile_expression_bytecode(*parse_result.root, to_span(input_names), bytecode)) {
+		return false;
+	}
+	// A single instruction is the same work as a single node, which benefits more from graph optimizations
+	return bytecode.instructions.size() >= 2;
+}
+
 CompilationResult expand_expression_nodes(
 		ProgramGraph &graph,
 		const NodeTypeDB &type_db,
-		GraphRemappingInfo *remap_info
+		GraphRemappingInfo *remap_info,
+		bool fuse_expressions
 ) {
 	ZN_PROFILE_SCOPE();
 	const unsigned int initial_node_count = graph.get_nodes_count();
 
 	// Gather expression node IDs first, as expansion could invalidate the iterator
 	StdVector<uint32_t> expression_node_ids;
-	graph.for_each_node([&expression_node_ids](ProgramGraph::Node &node) {
-		if (node.type_id == VoxelGraphFunction::NODE_EXPRESSION) {
-			expression_node_ids.push_back(node.id);
+	graph.for_each_node([&expression_node_ids, &type_db, fuse_expressions](ProgramGraph::Node &node) {
+		if (node.type_id != VoxelGraphFunction::NODE_EXPRESSION) {
+			return;
+		}
+		if (fuse_expressions && is_expression_node_worth_fusing(node, type_db)) {
+			// Kept as a single operation
+			return;
 		}
+		expression_node_ids.push_back(node.id);
 	});
 
 	StdVector<uint32_t> expanded_node_ids;
@@ -1178,6 +1213,175 @@ CompilationResult combine_inputs(
 	return CompilationResult::make_success();
 }
 
+// Gets the value of an input if it is known at compile time, either from its default value or from a constant node.
+bool try_get_constant_input(
+		const ProgramGraph &graph,
+		const ProgramGraph::Node &node,
+		unsigned int input_index,
+		float &out_value
+) {
+	const ProgramGraph::Port &port = node.inputs[input_index];
+	if (port.connections.size() == 0) {
+		ZN_ASSERT(input_index < node.default_inputs.size());
+		out_value = node.default_inputs[input_index];
+		return true;
+	}
+	const ProgramGraph::Node &src_node = graph.get_node(port.connections[0].node_id);
+	if (src_node.type_id != VoxelGraphFunction::NODE_CONSTANT) {
+		return false;
+	}
+	ZN_ASSERT(src_node.params.size() == 1);
+	out_value = src_node.params[0];
+	return true;
+}
+
+// Computes the result of a node from constant inputs. Only pure math nodes with a single output are supported, and
+// they must give the same result as when they run in the program.
+bool try_evaluate_node(
+		const ProgramGraph::Node &node,
+		const NodeType &type,
+		Span<const float> inputs,
+		float &out_value
+) {
+	switch (node.type_id) {
+		case VoxelGraphFunction::NODE_ADD:
+			out_value = inputs[0] + inputs[1];
+			return true;
+		case VoxelGraphFunction::NODE_SUBTRACT:
+			out_value = inputs[0] - inputs[1];
+			return true;
+		case VoxelGraphFunction::NODE_MULTIPLY:
+			out_value = inputs[0] * inputs[1];
+			return true;
+		case VoxelGraphFunction::NODE_DIVIDE:
+			// Same convention as the runtime
+			out_value = inputs[1] == 0.f ? 0.f : inputs[0] / inputs[1];
+			return true;
+		default:
+			break;
+	}
+	// Nodes usable in expressions have an equivalent function taking their inputs as arguments
+	if (type.expression_func != nullptr && node.params.size() == 0 && node.outputs.size() == 1) {
+		out_value = type.expression_func(inputs);
+		return true;
+	}
+	return false;
+}
+
+// Replaces nodes whose inputs are all constant with constant nodes, then moves constants into default inputs of the
+// nodes using them. After function expansion, this propagates constants passed to function inputs through the
+// function's nodes, and lets `merge_equivalences` find identical nodes whether their inputs were connected to constant
+// nodes or had the same default values.
+void fold_constants(ProgramGraph &graph, const NodeTypeDB &type_db) {
+	ZN_PROFILE_SCOPE();
+
+	// Nodes are visited again when one of their inputs gets folded, so folding propagates along chains
+	StdVector<uint32_t> to_visit;
+	graph.get_node_ids(to_visit);
+
+	FixedArray<float, Runtime::MAX_INPUTS> input_values;
+
+	while (to_visit.size() > 0) {
+		const uint32_t node_id = to_visit.back();
+		to_visit.pop_back();
+
+		ProgramGraph::Node &node = graph.get_node(node_id);
+		if (node.type_id == VoxelGraphFunction::NODE_CONSTANT || node.inputs.size() > input_values.size()) {
+			continue;
+		}
+		const NodeType &type = type_db.get_type(node.type_id);
+		if (type.category != pg::CATEGORY_MATH && type.category != pg::CATEGORY_CONVERT) {
+			continue;
+		}
+
+		bool all_inputs_constant = true;
+		for (unsigned int input_index = 0; input_index < node.inputs.size(); ++input_index) {
+			if (!try_get_constant_input(graph, node, input_index, input_values[input_index])) {
+				all_inputs_constant = false;
+				break;
+			}
+		}
+		if (!all_inputs_constant) {
+			continue;
+		}
+
+		float value;
+		if (!try_evaluate_node(node, type, to_span(input_values, node.inputs.size()), value)) {
+			continue;
+		}
+
+		// Turn the node into a constant in place, so its ID and output port remain valid in remapping info
+		for (unsigned int input_index = 0; input_index < node.inputs.size(); ++input_index) {
+			const ProgramGraph::Port &port = node.inputs[input_index];
+			if (port.connections.size() > 0) {
+				graph.disconnect(port.connections[0], ProgramGraph::PortLocation{ node_id, input_index });
+			}
+		}
+		node.type_id = VoxelGraphFunction::NODE_CONSTANT;
+		node.inputs.clear();
+		node.default_inputs.clear();
+		node.params.clear();
+		node.params.push_back(value);
+		node.autoconnect_default_inputs = false;
+
+		for (const ProgramGraph::PortLocation dst : node.outputs[0].connections) {
+			to_visit.push_back(dst.node_id);
+		}
+	}
+
+	// Move constants into default inputs. Constant nodes still connected to outputs or debug nodes are kept.
+	StdVector<uint32_t> constant_node_ids;
+	graph.for_each_node_const([&constant_node_ids](const ProgramGraph::Node &node) {
+		if (node.type_id == VoxelGraphFunction::NODE_CONSTANT) {
+			constant_node_ids.push_back(node.id);
+		}
+	});
+
+	for (const uint32_t node_id : constant_node_ids) {
+		const ProgramGraph::Node &node = graph.get_node(node_id);
+		ZN_ASSERT(node.params.size() == 1);
+		const float value = node.params[0];
+		// Copy because connections get modified while iterating
+		const StdVector<ProgramGraph::PortLocation> dsts = node.outputs[0].connections;
+		for (const ProgramGraph::PortLocation dst : dsts) {
+			ProgramGraph::Node &dst_node = graph.get_node(dst.node_id);
+			const NodeType &dst_type = type_db.get_type(dst_node.type_id);
+			if (dst_type.category == pg::CATEGORY_OUTPUT || dst_type.debug_only) {
+				continue;
+			}
+			graph.disconnect(ProgramGraph::PortLocation{ node_id, 0 }, dst);
+			ZN_ASSERT(dst.port_index < dst_node.default_inputs.size());
+			dst_node.default_inputs[dst.port_index] = value;
+		}
+		if (node.outputs[0].connections.size() == 0) {
+			graph.remove_node(node_id);
+		}
+	}
+}
+
+// Counts nodes that will turn into operations of the program, ignoring those that don't contribute to any output.
+unsigned int get_operation_count(const ProgramGraph &graph, const NodeTypeDB &type_db) {
+	StdVector<uint32_t> terminal_nodes;
+	graph.for_each_node_const([&terminal_nodes, &type_db](const ProgramGraph::Node &node) {
+		const NodeType &type = type_db.get_type(node.type_id);
+		if (type.category == pg::CATEGORY_OUTPUT && !type.debug_only) {
+			terminal_nodes.push_back(node.id);
+		}
+	});
+
+	StdVector<uint32_t> order;
+	graph.find_dependencies(to_span(terminal_nodes), order);
+
+	unsigned int count = 0;
+	for (const uint32_t node_id : order) {
+		const NodeType &type = type_db.get_type(graph.get_node(node_id).type_id);
+		if (type.category != pg::CATEGORY_INPUT && type.category != pg::CATEGORY_CONSTANT) {
+			++count;
+		}
+	}
+	return count;
+}
+
 } // namespace
 
 CompilationResult expand_graph(
@@ -1186,7 +1390,8 @@ CompilationResult expand_graph(
 		Span<const VoxelGraphFunction::Port> input_defs,
 		StdVector<uint32_t> *input_node_ids,
 		const NodeTypeDB &type_db,
-		GraphRemappingInfo *remap_info
+		GraphRemappingInfo *remap_info,
+		bool fuse_expressions
 ) {
 	ZN_PROFILE_SCOPE();
 	// First make a copy of the graph which we'll modify
@@ -1201,11 +1406,15 @@ CompilationResult expand_graph(
 
 	remove_relays(expanded_graph, remap_info);
 
-	const CompilationResult expr_expand_result = expand_expression_nodes(expanded_graph, type_db, remap_info);
+	CompilationResult expr_expand_result =
+			expand_expression_nodes(expanded_graph, type_db, remap_info, fuse_expressions);
 	if (!expr_expand_result.success) {
 		return expr_expand_result;
 	}
 
+	const unsigned int operation_count_before_optimization = get_operation_count(expanded_graph, type_db);
+
+	fold_constants(expanded_graph, type_db);
 	merge_equivalences(expanded_graph, remap_info);
 	replace_simplifiable_nodes(expanded_graph, type_db, remap_info);
 	const CompilationResult input_combining_result =
@@ -1214,6 +1423,8 @@ CompilationResult expand_graph(
 		return input_combining_result;
 	}
 
+	expr_expand_result.operation_count_before_optimization = operation_count_before_optimization;
+	expr_expand_result.operation_count = get_operation_count(expanded_graph, type_db);
 	return expr_expand_result;
 }
 
@@ -1226,8 +1437,9 @@ CompilationResult Runtime::compile(const VoxelGraphFunction &function, bool debu
 	ProgramGraph expanded_graph;
 	StdVector<uint32_t> input_node_ids;
 	Span<const VoxelGraphFunction::Port> input_defs = function.get_input_definitions();
-	CompilationResult expand_result =
-			expand_graph(function.get_graph(), expanded_graph, input_defs, &input_node_ids, type_db, &remap_info);
+	CompilationResult expand_result = expand_graph(
+			function.get_graph(), expanded_graph, input_defs, &input_node_ids, type_db, &remap_info, true
+	);
 	if (!expand_result.success) {
 		expand_result.node_id = get_original_node_id(remap_info, expand_result.node_id);
 		return expand_result;
@@ -1259,6 +1471,8 @@ CompilationResult Runtime::compile(const VoxelGraphFunction &function, bool debu
 	// debug_print_operations();
 
 	result.expanded_nodes_count = expanded_graph.get_nodes_count();
+	result.operation_count_before_optimization = expand_result.operation_count_before_optimization;
+	result.operation_count = expand_result.operation_count;
 	return result;
 }
 
@@ -1438,6 +1652,7 @@ CompilationResult Runtime::compile_preprocessed_graph(
 		DependencyGraph::Node &dg_node = program.dependency_graph.nodes.back();
 		dg_node.is_input = true;
 		dg_node.op_address = 0;
+		dg_node.op_decoded_index = 0;
 		dg_node.first_dependency = 0;
 		dg_node.end_dependency = 0;
 		dg_node.debug_node_id = node_id;
@@ -1450,7 +1665,7 @@ CompilationResult Runtime::compile_preprocessed_graph(
 		const ProgramGraph::Node &node = graph.get_node(node_id);
 		const NodeType &type = type_db.get_type(node.type_id);
 
-		ZN_ASSERT(node.inputs.size() == type.inputs.size());
+		ZN_ASSERT(type.has_dynamic_inputs || node.inputs.size() == type.inputs.size());
 		ZN_ASSERT(node.outputs.size() == type.outputs.size());
 
 		if (order_index == inner_group_start_index) {
@@ -1462,6 +1677,8 @@ CompilationResult Runtime::compile_preprocessed_graph(
 		DependencyGraph::Node &dg_node = program.dependency_graph.nodes.back();
 		dg_node.is_input = false;
 		dg_node.op_address = operations.size();
+		// Only relevant if the node turns out to be an operation, which is added to the default map below
+		dg_node.op_decoded_index = program.default_execution_map.operations.size();
 		dg_node.first_dependency = program.dependency_graph.dependencies.size();
 		dg_node.end_dependency = dg_node.first_dependency;
 		dg_node.debug_node_id = node_id;
@@ -1520,11 +1737,8 @@ CompilationResult Runtime::compile_preprocessed_graph(
 
 		ZN_ASSERT(node.type_id <= std::numeric_limits<uint16_t>::max());
 
-		if (order_index == inner_group_start_index) {
-			program.default_execution_map.inner_group_start_index = program.default_execution_map.operations.size();
-		}
-		program.default_execution_map.operations.push_back(ExecutionMap::OperationInfo{ uint16_t(operations.size()), 0 }
-		);
+		program.default_execution_map.operations.push_back(ExecutionMap::OperationInfo{
+				uint16_t(operations.size()), 0, uint16_t(program.default_execution_map.operations.size()) });
 		if (debug) {
 			// Will be remapped later if the node is an expanded one
 			program.default_execution_map.debug_nodes.push_back(node_id);
@@ -1535,16 +1749,24 @@ CompilationResult Runtime::compile_preprocessed_graph(
 		// Inputs and outputs use a convention so we can have generic code for them.
 		// Parameters are more specific, and may be affected by alignment so better just do them by hand
 
+		if (type.has_dynamic_inputs) {
+			// The count of inputs can't be deduced from the type
+			ZN_ASSERT(node.inputs.size() <= std::numeric_limits<uint8_t>::max());
+			operations.push_back(node.inputs.size());
+		}
+
 		// Add inputs
-		for (size_t j = 0; j < type.inputs.size(); ++j) {
-			const NodeType::Port &port = type.inputs[j];
+		for (size_t j = 0; j < node.inputs.size(); ++j) {
 			uint16_t a;
 
 			if (node.inputs[j].connections.size() == 0) {
 				// No input, default it
 				ZN_ASSERT(j < node.default_inputs.size());
 				float defval = node.default_inputs[j];
-				a = mem.add_constant(defval, port.require_input_buffer_when_constant);
+				// Dynamic inputs always get a buffer
+				const bool require_buffer =
+						type.has_dynamic_inputs || type.inputs[j].require_input_buffer_when_constant;
+				a = mem.add_constant(defval, require_buffer);
 
 			} else {
 				const ProgramGraph::PortLocation src_port = node.inputs[j].connections[0];
@@ -1618,7 +1840,7 @@ CompilationResult Runtime::compile_preprocessed_graph(
 		}
 
 		if (type.compile_func != nullptr) {
-			CompileContext ctx(/**node,*/ operations, program.heap_resources, params_copy);
+			CompileContext ctx(node, operations, program.heap_resources, params_copy);
 			type.compile_func(ctx);
 			if (ctx.has_error()) {
 				CompilationResult result;
@@ -1676,6 +1898,20 @@ CompilationResult Runtime::compile_preprocessed_graph(
 
 	program.buffer_count = mem.next_address;
 
+	decode_operations(program);
+
+	// Not assigned while adding operations, because the node starting the inner group might not be an operation (like
+	// the Y input)
+	if (inner_group_start_index < order.size()) {
+		ExecutionMap &execution_map = program.default_execution_map;
+		for (const ExecutionMap::OperationInfo &op_info : execution_map.operations) {
+			if (op_info.address >= program.inner_group_start_op_index) {
+				break;
+			}
+			++execution_map.inner_group_start_index;
+		}
+	}
+
 	// Pin buffers from the outer group that are read by operations of the inner group.
 	// Buffer data coming from the outer group must be pinned if it is read by the inner group,
 	// because it is re-used across multiple executions.
@@ -1711,139 +1947,206 @@ CompilationResult Runtime::compile_preprocessed_graph(
 				ZN_ASSERT(address_it != program.output_port_addresses.end());
 				BufferSpec &src_buffer_spec = buffer_specs[address_it->second];
 				src_buffer_spec.is_pinned = true;
+				if (!contains(program.outer_group_output_addresses, address_it->second)) {
+					program.outer_group_output_addresses.push_back(address_it->second);
+				}
 			}
 		}
-	}
 
-	// Assign buffer datas
-	{
-		struct DataHelper {
-			StdVector<uint16_t> free_indices;
-			struct Data {
-				uint16_t usages;
-				bool pinned;
-			};
-			StdVector<Data> datas;
-
-			uint16_t allocate(uint16_t users, bool pinned) {
-				ZN_ASSERT(users > 0);
-				// Note, pinned buffers must have unique data, so we may not re-use a previous buffer for them
-				if (free_indices.size() == 0 || pinned) {
-					const uint16_t i = datas.size();
-					datas.push_back(Data{ users, pinned });
-					return i;
-				} else {
-					const uint16_t i = free_indices[free_indices.size() - 1];
-					free_indices.pop_back();
-					ZN_ASSERT(i < datas.size());
-					Data &d = datas[i];
-					// Must not re-use a pinned buffer
-					ZN_ASSERT(!d.pinned);
-					d.usages = users;
-					return i;
+		// Outputs of the graph can also be in the outer group
+		if (program.outer_group_output_addresses.size() > 0) {
+			for (unsigned int order_index = 0; order_index < inner_group_start_index; ++order_index) {
+				const uint32_t node_id = order[order_index];
+				const ProgramGraph::Node &node = graph.get_node(node_id);
+				const NodeType &type = type_db.get_type(node.type_id);
+				if (type.category != pg::CATEGORY_OUTPUT) {
+					continue;
 				}
+				auto address_it = program.output_port_addresses.find(ProgramGraph::PortLocation{ node_id, 0 });
+				ZN_ASSERT(address_it != program.output_port_addresses.end());
+				buffer_specs[address_it->second].is_pinned = true;
+				program.outer_group_output_addresses.push_back(address_it->second);
 			}
+		}
+	}
 
-			void unref(uint16_t i) {
-				ZN_ASSERT(i < datas.size());
-				Data &d = datas[i];
-				ZN_ASSERT(!d.pinned);
-				ZN_ASSERT(d.usages > 0);
-				--d.usages;
-				if (d.usages == 0) {
-					free_indices.push_back(i);
-				}
+	// Assign buffer datas
+	if (debug) {
+		// In debug, there is no buffer data re-use optimization, so intermediate results can be inspected
+		unsigned int data_count = 0;
+		for (BufferSpec &buffer_spec : program.buffer_specs) {
+			if (!buffer_spec.is_binding) {
+				buffer_spec.data_index = data_count;
+				buffer_spec.has_data = true;
+				++data_count;
 			}
+		}
+		program.buffer_data_count = data_count;
+
+	} else {
+		Span<BufferSpec> buffer_specs = to_span(program.buffer_specs);
+
+		// Compute the lifetime of each buffer from the execution order, like a register allocator would. A buffer is
+		// live from the node writing it, until the last node reading it has run. Buffers that are live at the same time
+		// need different datas, others can share them.
+		struct Lifetime {
+			uint32_t begin = 0;
+			uint32_t end = 0;
+			// How many reads were found from nodes in the execution order
+			uint16_t reads = 0;
+			bool released = false;
 		};
+		const uint32_t LIFETIME_NEVER_ENDS = std::numeric_limits<uint32_t>::max();
+		StdVector<Lifetime> lifetimes;
+		lifetimes.resize(buffer_specs.size());
 
-		DataHelper data_helper;
+		for (unsigned int order_index = 0; order_index < order.size(); ++order_index) {
+			const uint32_t node_id = order[order_index];
+			const ProgramGraph::Node &node = graph.get_node(node_id);
+			const NodeType &type = type_db.get_type(node.type_id);
 
-		if (debug) {
-			// In debug, there is no buffer data re-use optimization
-			for (BufferSpec &buffer_spec : program.buffer_specs) {
-				if (!buffer_spec.is_binding) {
-					// Hardcode all uses to 1 in DataHelper, we are not going to track them at all.
-					buffer_spec.data_index = data_helper.allocate(1, true);
-					buffer_spec.has_data = true;
+			for (unsigned int output_index = 0; output_index < type.outputs.size(); ++output_index) {
+				const ProgramGraph::PortLocation dst_port{ node_id, output_index };
+				auto address_it = program.output_port_addresses.find(dst_port);
+				ZN_ASSERT(address_it != program.output_port_addresses.end());
+				Lifetime &lifetime = lifetimes[address_it->second];
+				lifetime.begin = order_index;
+				lifetime.end = order_index;
+			}
+
+			for (const ProgramGraph::Port &input : node.inputs) {
+				if (input.connections.size() == 0) {
+					continue;
 				}
+				auto address_it = program.output_port_addresses.find(input.connections[0]);
+				ZN_ASSERT(address_it != program.output_port_addresses.end());
+				Lifetime &lifetime = lifetimes[address_it->second];
+				lifetime.end = order_index;
+				++lifetime.reads;
 			}
+		}
 
-		} else {
-			Span<BufferSpec> buffer_specs = to_span(program.buffer_specs);
+		for (const BufferSpec &buffer_spec : buffer_specs) {
+			Lifetime &lifetime = lifetimes[buffer_spec.address];
+			// Pinned buffers must keep their results across runs. Buffers with more users than reads have fake users
+			// (like outputs of the graph), which are read after the program has run.
+			if (buffer_spec.is_pinned || lifetime.reads < buffer_spec.users_count) {
+				lifetime.end = LIFETIME_NEVER_ENDS;
+			}
+		}
+
+		// Released datas are handed out again starting from the most recent one, which is more likely to still be in
+		// cache
+		StdVector<uint16_t> free_data_indices;
+		unsigned int data_count = 0;
 
-			// Allocate unique buffers (this is used notably for compile-time constants requiring a buffer)
-			for (BufferSpec &buffer_spec : program.buffer_specs) {
-				if (!buffer_spec.is_binding && buffer_spec.is_pinned) {
-					buffer_spec.data_index = data_helper.allocate(1, true);
-					buffer_spec.has_data = true;
+		auto allocate_data = [&free_data_indices, &data_count]() -> uint16_t {
+			if (free_data_indices.size() > 0) {
+				const uint16_t i = free_data_indices.back();
+				free_data_indices.pop_back();
+				return i;
+			}
+			ZN_ASSERT(data_count < std::numeric_limits<uint16_t>::max());
+			const uint16_t i = data_count;
+			++data_count;
+			return i;
+		};
+
+		// Constants requiring a buffer (like constant nodes) are filled when preparing the state and are never written
+		// by operations, so those with the same value can share their data. They are compared by bits so values like
+		// 0 and -0 remain distinct.
+		{
+			struct ConstantData {
+				uint32_t value_bits;
+				uint16_t data_index;
+			};
+			StdVector<ConstantData> constant_datas;
+
+			for (BufferSpec &buffer_spec : buffer_specs) {
+				if (buffer_spec.is_binding || !buffer_spec.is_constant || !buffer_spec.is_pinned) {
+					continue;
 				}
+				uint32_t value_bits;
+				memcpy(&value_bits, &buffer_spec.constant_value, sizeof(value_bits));
+				auto it = std::find_if(
+						constant_datas.begin(),
+						constant_datas.end(),
+						[value_bits](const ConstantData &cd) { return cd.value_bits == value_bits; }
+				);
+				if (it == constant_datas.end()) {
+					constant_datas.push_back(ConstantData{ value_bits, allocate_data() });
+					it = constant_datas.end() - 1;
+				}
+				buffer_spec.data_index = it->data_index;
+				buffer_spec.has_data = true;
 			}
+		}
 
-			// Allocate re-usable buffers.
-			// Run through every node in execution order, allocating buffers when they are needed using pooling logic,
-			// so we can precompute which buffers will actually be needed in total, ahead of running the generator.
-			// This results in less memory usage than giving every buffer unique data.
-			for (unsigned int order_index = 0; order_index < order.size(); ++order_index) {
-				const uint32_t node_id = order[order_index];
-				const ProgramGraph::Node &node = graph.get_node(node_id);
-				const NodeType &type = type_db.get_type(node.type_id);
+		// Run through every node in execution order, giving data to buffers when they start being live and releasing it
+		// once they are no longer, so we can precompute which buffers will actually be needed in total, ahead of
+		// running the generator.
+		for (unsigned int order_index = 0; order_index < order.size(); ++order_index) {
+			const uint32_t node_id = order[order_index];
+			const ProgramGraph::Node &node = graph.get_node(node_id);
+			const NodeType &type = type_db.get_type(node.type_id);
 
-				uint16_t throwaway_data_index = 0;
-				bool has_throwaway_data = false;
+			uint16_t throwaway_data_index = 0;
+			bool has_throwaway_data = false;
 
-				// Allocate data to store outputs.
-				// Note, we don't allocate for inputs. The only way to allocate them is to pin them.
-				for (unsigned int output_index = 0; output_index < type.outputs.size(); ++output_index) {
-					const ProgramGraph::PortLocation dst_port{ node_id, output_index };
-					auto address_it = program.output_port_addresses.find(dst_port);
-					ZN_ASSERT(address_it != program.output_port_addresses.end());
-					BufferSpec &buffer_spec = buffer_specs[address_it->second];
+			// Allocate data to store outputs.
+			// Outputs are allocated before inputs are released, so operations never write into the buffers they read.
+			for (unsigned int output_index = 0; output_index < type.outputs.size(); ++output_index) {
+				const ProgramGraph::PortLocation dst_port{ node_id, output_index };
+				auto address_it = program.output_port_addresses.find(dst_port);
+				ZN_ASSERT(address_it != program.output_port_addresses.end());
+				BufferSpec &buffer_spec = buffer_specs[address_it->second];
 
-					if (buffer_spec.is_binding || buffer_spec.is_pinned) {
-						continue;
-					}
-					if (buffer_spec.users_count > 0) {
-						buffer_spec.data_index = data_helper.allocate(buffer_spec.users_count, false);
-					} else {
-						// The node will be run, but has an unused output. We'll have to allocate a throw-away buffer.
-						// We should be able to use the same buffer if more outputs are unused on the same node, but not
-						// the same as buffers that are used.
-						if (!has_throwaway_data) {
-							has_throwaway_data = true;
-							throwaway_data_index = data_helper.allocate(1, false);
-						}
-						buffer_spec.data_index = throwaway_data_index;
+				if (buffer_spec.is_binding || buffer_spec.is_constant) {
+					continue;
+				}
+				if (lifetimes[buffer_spec.address].end == order_index) {
+					// The node will be run, but has an unused output. We'll have to allocate a throw-away buffer.
+					// We should be able to use the same buffer if more outputs are unused on the same node, but not
+					// the same as buffers that are used.
+					if (!has_throwaway_data) {
+						has_throwaway_data = true;
+						throwaway_data_index = allocate_data();
 					}
-					buffer_spec.has_data = true;
+					buffer_spec.data_index = throwaway_data_index;
+				} else {
+					buffer_spec.data_index = allocate_data();
 				}
+				buffer_spec.has_data = true;
+			}
 
-				if (has_throwaway_data) {
-					// Make this buffer available again once this node has run
-					data_helper.unref(throwaway_data_index);
-				}
+			if (has_throwaway_data) {
+				// Make this buffer available again once this node has run
+				free_data_indices.push_back(throwaway_data_index);
+			}
 
-				// Release references on input datas, so they can be re-used by later operations
-				for (const ProgramGraph::Port &input : node.inputs) {
-					if (input.connections.size() == 0) {
-						continue;
-					}
-					const ProgramGraph::PortLocation src_port = input.connections[0];
-					auto address_it = program.output_port_addresses.find(src_port);
-					ZN_ASSERT(address_it != program.output_port_addresses.end());
-					const BufferSpec &buffer_spec = buffer_specs[address_it->second];
-
-					// Bindings are user-provided.
-					// Pinned buffers are never re-used.
-					if (buffer_spec.is_binding || buffer_spec.is_pinned) {
-						continue;
-					}
+			// Release datas of inputs this node is the last to read, so they can be re-used by later operations
+			for (const ProgramGraph::Port &input : node.inputs) {
+				if (input.connections.size() == 0) {
+					continue;
+				}
+				auto address_it = program.output_port_addresses.find(input.connections[0]);
+				ZN_ASSERT(address_it != program.output_port_addresses.end());
+				const BufferSpec &buffer_spec = buffer_specs[address_it->second];
+				Lifetime &lifetime = lifetimes[buffer_spec.address];
 
-					data_helper.unref(buffer_spec.data_index);
+				// Bindings are user-provided.
+				// A node can read the same buffer from several inputs, but it must be released only once.
+				if (buffer_spec.is_binding || buffer_spec.is_constant || lifetime.end != order_index ||
+					lifetime.released) {
+					continue;
 				}
+
+				free_data_indices.push_back(buffer_spec.data_index);
+				lifetime.released = true;
 			}
 		}
 
-		program.buffer_data_count = data_helper.datas.size();
+		program.buffer_data_count = data_count;
 	}
 
 	ZN_PRINT_VERBOSE(
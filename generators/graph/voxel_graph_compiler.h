@@ -4,6 +4,7 @@
 #include "../../util/containers/std_vector.h"
 #include "voxel_graph_function.h"
 #include "voxel_graph_runtime.h"
+#include <string_view>
 #include <type_traits>
 
 namespace zylann::voxel::pg {
@@ -28,30 +29,44 @@ struct GraphRemappingInfo {
 
 // Pre-processes the graph and applies some optimizations before doing the main compilation pass.
 // This can involve some nodes getting removed or replaced with new ones.
+// If `fuse_expressions` is true, expression nodes made of several operations are kept so they can run as bytecode.
+// Otherwise they are all expanded into nodes.
 CompilationResult expand_graph(
 		const ProgramGraph &graph,
 		ProgramGraph &expanded_graph,
 		Span<const VoxelGraphFunction::Port> input_defs,
 		StdVector<uint32_t> *input_node_ids,
 		const NodeTypeDB &type_db,
-		GraphRemappingInfo *remap_info
+		GraphRemappingInfo *remap_info,
+		bool fuse_expressions
 );
 
 // Functions usable by node implementations during the compilation stage
 class CompileContext {
 public:
 	CompileContext(
-			/*const ProgramGraph::Node &node,*/ StdVector<uint16_t> &program,
+			const ProgramGraph::Node &node,
+			StdVector<uint16_t> &program,
 			StdVector<Runtime::HeapResource> &heap_resources,
 			StdVector<Variant> &params
 	) :
-			/*_node(node),*/ _program(program), _heap_resources(heap_resources), _params(params) {}
+			_node(node), _program(program), _heap_resources(heap_resources), _params(params) {}
 
 	Variant get_param(size_t i) const {
 		CRASH_COND(i > _params.size());
 		return _params[i];
 	}
 
+	unsigned int get_input_count() const {
+		return _node.inputs.size();
+	}
+
+	// Only relevant for node types with dynamic inputs
+	std::string_view get_dynamic_input_name(unsigned int i) const {
+		CRASH_COND(i >= _node.inputs.size());
+		return _node.inputs[i].dynamic_name;
+	}
+
 	// Stores compile-time parameters the node will need. T must be a POD struct.
 	template <typename T>
 	void set_params(T params) {
@@ -119,7 +134,7 @@ public:
 	}
 
 private:
-	// const ProgramGraph::Node &_node;
+	const ProgramGraph::Node &_node;
 	StdVector<uint16_t> &_program;
 	StdVector<Runtime::HeapResource> &_heap_resources;
 	StdVector<Variant> &_params;
@@ -34,15 +34,26 @@ void Runtime::clear() {
 
 namespace {
 
+// Gets how many inputs the operation at `pc` has, and moves `pc` to the first input
+inline uint32_t read_inputs_count(Span<const uint16_t> operations, const NodeType &node_type, uint32_t &pc) {
+	if (node_type.has_dynamic_inputs) {
+		const uint32_t inputs_count = operations[pc];
+		++pc;
+		return inputs_count;
+	}
+	return node_type.inputs.size();
+}
+
 Span<const uint16_t> get_outputs_from_op_address(Span<const uint16_t> operations, uint16_t op_address) {
 	const uint16_t opid = operations[op_address];
 	const NodeType &node_type = NodeTypeDB::get_singleton().get_type(opid);
 
-	const uint32_t inputs_count = node_type.inputs.size();
+	// The +1 is for `opid`
+	uint32_t pc = op_address + 1;
+	const uint32_t inputs_count = read_inputs_count(operations, node_type, pc);
 	const uint32_t outputs_count = node_type.outputs.size();
 
-	// The +1 is for `opid`
-	return operations.sub(op_address + 1 + inputs_count, outputs_count);
+	return operations.sub(pc + inputs_count, outputs_count);
 }
 
 } // namespace
@@ -234,8 +245,8 @@ void Runtime::generate_optimized_execution_map(
 					inner_group_start_not_assigned = false;
 				}
 
-				execution_map.operations.push_back(
-						ExecutionMap::OperationInfo{ node.op_address, uint16_t(tls_constant_fills.size()) });
+				execution_map.operations.push_back(ExecutionMap::OperationInfo{
+						node.op_address, uint16_t(tls_constant_fills.size()), node.op_decoded_index });
 
 				// TODO Only do constant fills that actually get used
 				// The following approach isn't optimal. If 50% of a graph gets skipped and the remaining nodes don't
@@ -319,6 +330,7 @@ void Runtime::prepare_state(State &state, unsigned int buffer_size, bool with_pr
 	Span<math::Interval> ranges = to_span(state.ranges);
 
 	state.buffer_size = buffer_size;
+	state.min_feature_size = 0.f;
 
 	for (const BufferSpec &buffer_spec : _program.buffer_specs) {
 		Buffer &buffer = buffers[buffer_spec.address];
@@ -402,8 +414,60 @@ inline Span<const uint8_t> read_params(Span<const uint16_t> operations, unsigned
 
 } // namespace
 
+void Runtime::decode_operations(Program &program) {
+	const Span<const uint16_t> operations = to_span_const(program.operations);
+	program.decoded_operations.clear();
+
+	unsigned int pc = 0;
+	while (pc < operations.size()) {
+		const uint16_t opid = operations[pc++];
+		const NodeType &node_type = NodeTypeDB::get_singleton().get_type(opid);
+
+		Program::DecodedOperation op;
+		op.process_buffer_func = node_type.process_buffer_func;
+		op.inputs_count = read_inputs_count(operations, node_type, pc);
+		op.inputs_address = pc;
+		op.outputs_count = node_type.outputs.size();
+		pc += op.inputs_count + op.outputs_count;
+
+		op.params_size_in_words = operations[pc];
+		read_params(operations, pc);
+		// Params end where the next operation starts
+		op.params_address = pc - op.params_size_in_words;
+
+		program.decoded_operations.push_back(op);
+
+#ifdef VOXEL_DEBUG_GRAPH_PROG_SENTINEL
+		++pc;
+#endif
+	}
+
+	// Execution maps refer to operations by their index in this list
+	ZN_ASSERT(program.decoded_operations.size() == program.default_execution_map.operations.size());
+}
+
 void Runtime::generate_set(
 		State &state, Span<Span<float>> p_inputs, bool skip_outer_group, const ExecutionMap *p_execution_map) const {
+	const ExecutionMap &execution_map = p_execution_map != nullptr ? *p_execution_map : _program.default_execution_map;
+	const unsigned int begin_index = skip_outer_group ? execution_map.inner_group_start_index : 0;
+	execute_operations(
+			state, p_inputs, execution_map, begin_index, execution_map.operations.size(), p_execution_map != nullptr
+	);
+}
+
+void Runtime::generate_outer_group(State &state, Span<Span<float>> p_inputs) const {
+	const ExecutionMap &execution_map = _program.default_execution_map;
+	execute_operations(state, p_inputs, execution_map, 0, execution_map.inner_group_start_index, false);
+}
+
+void Runtime::execute_operations(
+		State &state,
+		Span<Span<float>> p_inputs,
+		const ExecutionMap &execution_map,
+		unsigned int begin_index,
+		unsigned int end_index,
+		bool using_execution_map
+) const {
 	// I don't like putting private helper functions in headers.
 	struct L {
 		static inline void bind_buffer(Span<Buffer> buffers, int a, Span<float> d) {
@@ -460,24 +524,23 @@ void Runtime::generate_set(
 	}
 
 	const Span<const uint16_t> operations(_program.operations.data(), 0, _program.operations.size());
+	const Span<const Program::DecodedOperation> decoded_operations = to_span_const(_program.decoded_operations);
 
-	const ExecutionMap &execution_map = p_execution_map != nullptr ? *p_execution_map : _program.default_execution_map;
-	Span<const ExecutionMap::OperationInfo> operation_infos = to_span(execution_map.operations);
+	const Span<const ExecutionMap::OperationInfo> operation_infos = to_span(execution_map.operations);
 	const Span<const ExecutionMap::ConstantFill> constant_fills = to_span(execution_map.constant_fills);
+	ZN_ASSERT_RETURN(begin_index <= end_index && end_index <= operation_infos.size());
 
-	if (skip_outer_group && operation_infos.size() > 0) {
-		const unsigned int offset = execution_map.inner_group_start_index;
-		operation_infos = operation_infos.sub(offset);
-	}
-
-#ifdef TOOLS_ENABLED
+	// Profiling is also available in exported games, where `VoxelGeneratorGraph` may sample generation calls
 	ProfilingClock profiling_clock;
-	const bool profile = state.debug_profiler_times.size() > 0;
-#endif
+	const bool profile = state.is_profiling();
 
+	// Constant fills of skipped operations are skipped too
 	unsigned int constant_fill_index = 0;
+	for (unsigned int i = 0; i < begin_index; ++i) {
+		constant_fill_index += operation_infos[i].constant_fill_count;
+	}
 
-	for (unsigned int execution_map_index = 0; execution_map_index < operation_infos.size(); ++execution_map_index) {
+	for (unsigned int execution_map_index = begin_index; execution_map_index < end_index; ++execution_map_index) {
 		const ExecutionMap::OperationInfo op_info = operation_infos[execution_map_index];
 
 		for (unsigned int i = 0; i < op_info.constant_fill_count; ++i) {
@@ -489,33 +552,28 @@ void Runtime::generate_set(
 			++constant_fill_index;
 		}
 
-		unsigned int pc = op_info.address;
-
-		const uint16_t opid = operations[pc++];
-		const NodeType &node_type = NodeTypeDB::get_singleton().get_type(opid);
-
-		const uint32_t inputs_count = node_type.inputs.size();
-		const uint32_t outputs_count = node_type.outputs.size();
-
-		const Span<const uint16_t> op_inputs = operations.sub(pc, inputs_count);
-		pc += inputs_count;
-		const Span<const uint16_t> op_outputs = operations.sub(pc, outputs_count);
-		pc += outputs_count;
+		const Program::DecodedOperation &op = decoded_operations[op_info.decoded_index];
+#ifdef DEBUG_ENABLED
+		ZN_ASSERT(op.inputs_address == op_info.address + 1);
+#endif
 
-		Span<const uint8_t> op_params = read_params(operations, pc);
+		const Span<const uint16_t> op_inputs = operations.sub(op.inputs_address, op.inputs_count);
+		const Span<const uint16_t> op_outputs = operations.sub(op.inputs_address + op.inputs_count, op.outputs_count);
+		const Span<const uint8_t> op_params =
+				operations.sub(op.params_address, op.params_size_in_words).reinterpret_cast_to<const uint8_t>();
 
 		// TODO Buffers will stay bound if this error occurs!
-		ZN_ASSERT_RETURN(node_type.process_buffer_func != nullptr);
-		ProcessBufferContext ctx(op_inputs, op_outputs, op_params, buffers, p_execution_map != nullptr);
-		node_type.process_buffer_func(ctx);
+		ZN_ASSERT_RETURN(op.process_buffer_func != nullptr);
+		ProcessBufferContext ctx(
+				op_inputs, op_outputs, op_params, buffers, using_execution_map, state.min_feature_size
+		);
+		op.process_buffer_func(ctx);
 
-#ifdef TOOLS_ENABLED
 		if (profile) {
 			const uint32_t elapsed_microseconds = profiling_clock.get_elapsed_microseconds();
 			state.add_execution_time(execution_map_index, elapsed_microseconds);
 			profiling_clock.restart();
 		}
-#endif
 	}
 
 	// Unbind buffers
@@ -555,7 +613,7 @@ void Runtime::analyze_range(State &state, Span<math::Interval> p_inputs) const {
 		const uint16_t opid = operations[pc++];
 		const NodeType &node_type = NodeTypeDB::get_singleton().get_type(opid);
 
-		const uint32_t inputs_count = node_type.inputs.size();
+		const uint32_t inputs_count = read_inputs_count(operations, node_type, pc);
 		const uint32_t outputs_count = node_type.outputs.size();
 
 		const Span<const uint16_t> op_inputs = operations.sub(pc, inputs_count);
@@ -588,7 +646,7 @@ void Runtime::debug_print_operations() {
 		const uint16_t opid = operations[pc++];
 		const NodeType &node_type = NodeTypeDB::get_singleton().get_type(opid);
 
-		const uint32_t inputs_count = node_type.inputs.size();
+		const uint32_t inputs_count = read_inputs_count(operations, node_type, pc);
 		const uint32_t outputs_count = node_type.outputs.size();
 
 		const Span<const uint16_t> inputs = operations.sub(pc, inputs_count);
@@ -624,6 +682,16 @@ void Runtime::debug_print_operations() {
 		++op_index;
 	}
 
+	// Without re-use, every buffer that isn't a binding would have its own data
+	unsigned int buffers_with_data_count = 0;
+	for (const BufferSpec &buffer_spec : _program.buffer_specs) {
+		if (buffer_spec.has_data) {
+			++buffers_with_data_count;
+		}
+	}
+	ss << "Buffers: " << _program.buffer_count << ", requiring data: " << buffers_with_data_count
+	   << ", buffer datas after re-use: " << _program.buffer_data_count << "\n";
+
 	print_line(ss.str());
 }
 
@@ -20,6 +20,10 @@ struct CompilationResult {
 	bool success = false;
 	int node_id = -1;
 	int expanded_nodes_count = 0; // For testing and debugging
+	// Operations contributing to outputs after expanding functions and expressions, before and after optimizations
+	// like constant folding and merging of equivalent nodes. For testing and debugging.
+	int operation_count_before_optimization = 0;
+	int operation_count = 0;
 	String message;
 
 	static CompilationResult make_success() {
@@ -83,6 +87,8 @@ public:
 			uint16_t address = 0;
 			// How many constant fills to execute before this operation.
 			uint16_t constant_fill_count = 0;
+			// Index of the operation in `Program::decoded_operations`
+			uint16_t decoded_index = 0;
 		};
 
 		StdVector<OperationInfo> operations;
@@ -173,6 +179,27 @@ public:
 			return debug_profiler_times[execution_map_index];
 		}
 
+		inline bool is_profiling() const {
+			return debug_profiler_times.size() > 0;
+		}
+
+		// Sets all execution times back to zero, so the state can be profiled again with another execution map
+		void reset_execution_times() {
+			for (uint32_t &t : debug_profiler_times) {
+				t = 0;
+			}
+		}
+
+		// Nodes may skip details smaller than this size, in voxels. For example, fractal noises may skip their finest
+		// octaves. This is reset to 0 (all details) when the state is prepared.
+		inline void set_min_feature_size(float size) {
+			min_feature_size = size;
+		}
+
+		inline float get_min_feature_size() const {
+			return min_feature_size;
+		}
+
 	private:
 		friend class Runtime; // TODO Why is friend needed? This class is nested inside
 
@@ -184,6 +211,7 @@ public:
 
 		unsigned int buffer_size = 0;
 		unsigned int buffer_capacity = 0;
+		float min_feature_size = 0.f;
 	};
 
 	struct InputInfo {
@@ -223,6 +251,17 @@ public:
 			const ExecutionMap *p_execution_map
 	) const;
 
+	// Runs all operations of the outer group, which only depend on X and Z, ignoring range analysis results.
+	// Their results can then be saved from buffers listed by `get_outer_group_output_addresses`, and restored later
+	// instead of running the outer group again.
+	void generate_outer_group(State &state, Span<Span<float>> p_inputs) const;
+
+	// Buffers written by operations of the outer group and read by later operations or outputs. Once they hold the
+	// right values, `generate_set` can be called with `skip_outer_group`.
+	inline Span<const uint16_t> get_outer_group_output_addresses() const {
+		return to_span(_program.outer_group_output_addresses);
+	}
+
 #ifdef DEBUG_ENABLED
 	void debug_print_operations();
 #endif
@@ -237,6 +276,16 @@ public:
 		return _program.outputs_count;
 	}
 
+	// Buffers are assigned to each port of the program
+	inline unsigned int get_buffer_count() const {
+		return _program.buffer_count;
+	}
+
+	// Buffers whose lifetimes don't overlap share the same data, so there are usually less datas than buffers
+	inline unsigned int get_buffer_data_count() const {
+		return _program.buffer_data_count;
+	}
+
 	inline const OutputInfo &get_output_info(unsigned int i) const {
 		return _program.outputs[i];
 	}
@@ -311,11 +360,13 @@ public:
 				const Span<const uint16_t> outputs,
 				const Span<const uint8_t> params,
 				Span<Buffer> buffers,
-				bool using_execution_map
+				bool using_execution_map,
+				float min_feature_size
 		) :
 				_ProcessContext(inputs, outputs, params),
 				_buffers(buffers),
-				_using_execution_map(using_execution_map) {}
+				_using_execution_map(using_execution_map),
+				_min_feature_size(min_feature_size) {}
 
 		inline const Buffer &get_input(uint32_t i) const {
 			const uint32_t address = get_input_address(i);
@@ -347,9 +398,16 @@ public:
 			return b;
 		}
 
+		// Details smaller than this size (in voxels) may be skipped, because they can't be represented by the
+		// queried voxels. 0 means all details are requested.
+		inline float get_min_feature_size() const {
+			return _min_feature_size;
+		}
+
 	private:
 		Span<Buffer> _buffers;
 		bool _using_execution_map;
+		float _min_feature_size;
 	};
 
 	// Functions usable by node implementations during range analysis
@@ -391,6 +449,8 @@ public:
 private:
 	struct Program;
 
+	static void decode_operations(Program &program);
+
 	static CompilationResult compile_preprocessed_graph(
 			Program &program,
 			const ProgramGraph &graph,
@@ -402,6 +462,15 @@ private:
 
 	bool is_operation_constant(const State &state, uint16_t op_address) const;
 
+	void execute_operations(
+			State &state,
+			Span<Span<float>> p_inputs,
+			const ExecutionMap &execution_map,
+			unsigned int begin_index,
+			unsigned int end_index,
+			bool using_execution_map
+	) const;
+
 	struct BufferSpec {
 		// Index the buffer should be stored at
 		uint16_t address = 0;
@@ -419,9 +488,9 @@ private:
 		// Will be `true` only if `data_index` actually refers to something.
 		// Buffers without data are bindings or constants not requiring buffers.
 		bool has_data = false;
-		// If true, the port will be assigned unique buffer data.
-		// If false, the port might share the same buffer data with other ports.
-		// TODO Rename `has_unique_data`?
+		// If true, the data of the port must keep its contents across runs of the program. Constants may still share
+		// data with other constants having the same value.
+		// If false, the port might share the same buffer data with other ports whose lifetime doesn't overlap.
 		bool is_pinned = false;
 	};
 
@@ -431,6 +500,8 @@ private:
 			uint16_t first_dependency;
 			uint16_t end_dependency;
 			uint16_t op_address;
+			// Index of the operation in `Program::decoded_operations`, if the node is not an input
+			uint16_t op_decoded_index;
 			bool is_input;
 			// Node ID from the expanded ProgramGraph (non user-provided, so may need remap)
 			uint32_t debug_node_id;
@@ -454,6 +525,7 @@ private:
 		// They come up as series of:
 		//
 		// - uint16 opid
+		// - uint16 inputs_count // only if the node type has dynamic inputs
 		// - uint16 inputs[0..*]
 		// - uint16 outputs[0..*]
 		// - uint16 parameters_size
@@ -466,6 +538,21 @@ private:
 		// It's better to have it ordered because memory access will be more predictable.
 		StdVector<uint16_t> operations;
 
+		// Operations parsed ahead of time, in the same order as `operations`. Running them this way doesn't require
+		// looking up node types and parsing `operations` each time, which is significant when buffers are small
+		// (like slices of blocks).
+		// Positions are stored instead of spans, so they remain valid if the program is copied.
+		struct DecodedOperation {
+			ProcessBufferFunc process_buffer_func;
+			uint16_t inputs_address;
+			uint16_t params_address;
+			uint16_t params_size_in_words;
+			uint8_t inputs_count;
+			uint8_t outputs_count;
+		};
+
+		StdVector<DecodedOperation> decoded_operations;
+
 		// Describes dependencies between operations. It is generated at compile time.
 		// It is used to perform dynamic optimization in case some operations can be predicted as constant.
 		DependencyGraph dependency_graph;
@@ -491,6 +578,9 @@ private:
 		// cases.
 		uint32_t inner_group_start_op_index;
 
+		// See `get_outer_group_output_addresses`. These buffers are pinned.
+		StdVector<uint16_t> outer_group_output_addresses;
+
 		StdVector<InputInfo> inputs;
 
 		FixedArray<OutputInfo, MAX_OUTPUTS> outputs;
@@ -518,8 +608,10 @@ private:
 
 		void clear() {
 			operations.clear();
+			decoded_operations.clear();
 			buffer_specs.clear();
 			inner_group_start_op_index = 0;
+			outer_group_output_addresses.clear();
 			default_execution_map.clear();
 			output_port_addresses.clear();
 			user_port_to_expanded_port.clear();
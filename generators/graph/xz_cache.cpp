@@ -0,0 +1,92 @@
+#include "xz_cache.h"
+#include "../../util/profiling.h"
+
+namespace zylann::voxel::pg {
+
+bool XZCache::try_load(Vector2i origin, uint8_t lod_index, Vector2i size, Span<float> dst) {
+	ZN_PROFILE_SCOPE();
+	if (_max_entries.load(std::memory_order_relaxed) == 0) {
+		return false;
+	}
+	MutexLock mlock(_mutex);
+	auto it = _entries.find(Vector3i(origin.x, origin.y, lod_index));
+	if (it == _entries.end() || it->second.size != size || it->second.values.size() != dst.size()) {
+		_cache_stats.add_miss();
+		return false;
+	}
+	Entry &entry = it->second;
+	++_access_time;
+	entry.last_access = _access_time;
+	to_span_const(entry.values).copy_to(dst);
+	_cache_stats.add_hit();
+	return true;
+}
+
+void XZCache::save(Vector2i origin, uint8_t lod_index, Vector2i size, Span<const float> src) {
+	ZN_PROFILE_SCOPE();
+	const unsigned int max_entries = _max_entries.load(std::memory_order_relaxed);
+	if (max_entries == 0) {
+		return;
+	}
+	MutexLock mlock(_mutex);
+	const Vector3i key(origin.x, origin.y, lod_index);
+	if (_entries.find(key) == _entries.end()) {
+		while (_entries.size() >= max_entries) {
+			evict_one_entry_no_lock();
+		}
+	}
+	Entry &entry = _entries[key];
+	_cache_stats.set_entries(_entries.size());
+	entry.size = size;
+	++_access_time;
+	entry.last_access = _access_time;
+	entry.values.resize(src.size());
+	src.copy_to(to_span(entry.values));
+}
+
+void XZCache::evict_one_entry_no_lock() {
+	// Linear search, but the cache is expected to be small and this only happens when saving a new entry
+	auto oldest_it = _entries.begin();
+	for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+		if (it->second.last_access < oldest_it->second.last_access) {
+			oldest_it = it;
+		}
+	}
+	if (oldest_it != _entries.end()) {
+		_entries.erase(oldest_it);
+		_cache_stats.add_evictions(1);
+		_cache_stats.set_entries(_entries.size());
+	}
+}
+
+void XZCache::set_max_entries(unsigned int count) {
+	MutexLock mlock(_mutex);
+	_max_entries.store(count, std::memory_order_relaxed);
+	while (_entries.size() > count) {
+		evict_one_entry_no_lock();
+	}
+}
+
+unsigned int XZCache::get_max_entries() const {
+	return _max_entries.load(std::memory_order_relaxed);
+}
+
+void XZCache::clear() {
+	MutexLock mlock(_mutex);
+	_entries.clear();
+	_cache_stats.set_entries(0);
+}
+
+XZCache::Stats XZCache::get_stats() const {
+	Stats stats;
+	const CacheStats::Snapshot cache_stats = _cache_stats.get_snapshot();
+	stats.hits = cache_stats.hits;
+	stats.misses = cache_stats.misses;
+	{
+		MutexLock mlock(_mutex);
+		stats.entry_count = _entries.size();
+	}
+	return stats;
+}
+
+} // namespace zylann::voxel::pg
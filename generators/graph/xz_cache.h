@@ -0,0 +1,63 @@
+#ifndef VOXEL_GRAPH_XZ_CACHE_H
+#define VOXEL_GRAPH_XZ_CACHE_H
+
+#include "../../util/cache_stats.h"
+#include "../../util/containers/span.h"
+#include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/vector2i.h"
+#include "../../util/math/vector3i.h"
+#include "../../util/thread/mutex.h"
+#include <atomic>
+
+namespace zylann::voxel::pg {
+
+// Keeps results of the part of a graph that only depends on X and Z (the "outer group"), for areas of the XZ plane.
+// Blocks stacked vertically in the same column cover the same area, so they can reuse these results instead of
+// computing them again. This is typical of graphs computing a heightmap.
+// It can be used from multiple threads. When full, the least recently used entries are evicted.
+class XZCache {
+public:
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		unsigned int entry_count = 0;
+	};
+
+	// Entries are identified by the origin of the area in voxels and its LOD index.
+	// Values are stored as consecutive buffers of the area's size, their count depends on the graph.
+
+	// Copies cached values into `dst` if found. Returns false if not found or if the area had a different size.
+	bool try_load(Vector2i origin, uint8_t lod_index, Vector2i size, Span<float> dst);
+
+	// Stores a copy of the given values, evicting old entries if the cache is full.
+	void save(Vector2i origin, uint8_t lod_index, Vector2i size, Span<const float> src);
+
+	// 0 disables the cache and removes all entries
+	void set_max_entries(unsigned int count);
+	unsigned int get_max_entries() const;
+
+	void clear();
+
+	Stats get_stats() const;
+
+private:
+	struct Entry {
+		Vector2i size;
+		uint32_t last_access = 0;
+		StdVector<float> values;
+	};
+
+	void evict_one_entry_no_lock();
+
+	// Using Vector3i as key, with Z being the LOD index
+	StdUnorderedMap<Vector3i, Entry> _entries;
+	Mutex _mutex;
+	uint32_t _access_time = 0;
+	std::atomic_uint32_t _max_entries = { 0 };
+	CacheStats _cache_stats{ "graph_xz_cache" };
+};
+
+} // namespace zylann::voxel::pg
+
+#endif // VOXEL_GRAPH_XZ_CACHE_H
@@ -258,9 +258,7 @@ void GenerateBlockMultipassCBTask::apply_result() {
 			o.max_lod_hint = false;
 			o.initial_load = false;
 
-			VoxelEngine::VolumeCallbacks callbacks = VoxelEngine::get_singleton().get_volume_callbacks(_volume_id);
-			ERR_FAIL_COND(callbacks.data_output_callback == nullptr);
-			callbacks.data_output_callback(callbacks.data, o);
+			VoxelEngine::get_singleton().push_volume_data_output(_volume_id, o);
 
 			aborted = !_has_run;
 		}
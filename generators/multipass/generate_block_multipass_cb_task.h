@@ -1,6 +1,7 @@
 #ifndef VOXEL_GENERATE_BLOCK_MULTIPASS_CB_TASK_H
 #define VOXEL_GENERATE_BLOCK_MULTIPASS_CB_TASK_H
 
+#include "../../constants/voxel_constants.h"
 #include "../../engine/ids.h"
 #include "../../engine/priority_dependency.h"
 #include "../../engine/streaming_dependency.h"
@@ -24,6 +25,10 @@ public:
 		return "GenerateBlockMultipassCBTask";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_GENERATION;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 	TaskPriority get_priority() override;
 	bool is_cancelled() override;
@@ -23,6 +23,16 @@ const char *g_profiling_task_names[VoxelGeneratorMultipassCB::MAX_SUBPASSES] = {
 };
 #endif
 
+// Dependencies run slightly before the tasks needing them at a similar distance. Lower subpasses then tend to complete
+// over whole areas first, so more columns become ready to run their next subpass in parallel, instead of threads
+// picking tasks that only find their dependencies missing and have to spawn or wait again.
+TaskPriority get_dependency_priority(TaskPriority priority) {
+	if (priority.band0 < TaskPriority::BAND_MAX) {
+		++priority.band0;
+	}
+	return priority;
+}
+
 } // namespace
 
 using namespace VoxelGeneratorMultipassCBStructs;
@@ -104,6 +114,7 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 				// Unregister task from the column
 				Column &column = column_it->second;
 				column.pending_subpass_tasks_mask &= ~(1 << _subpass_index);
+				schedule_subpass_waiting_tasks(column, task_scheduler);
 
 				if (_subpass_index == final_subpass_index) {
 					// Schedule pending block requests to make them handle cancellation
@@ -148,6 +159,7 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 		// SpatialLock3D::Write swlock(map->spatial_lock, neighbors_box);
 		if (!map.spatial_lock.try_lock_write(neighbors_box)) {
 			// Try later
+			++_generator_internal->stats.postponed_subpasses;
 			ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
 			return;
 		}
@@ -180,6 +192,8 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 
 		bool spawned_subtasks = false;
 		bool postpone = false;
+		// Column on which another task is working on a dependency
+		Column *waited_column = nullptr;
 
 		// Check loading levels
 		{
@@ -198,6 +212,7 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 
 					if (main_column != nullptr) {
 						main_column->pending_subpass_tasks_mask &= ~(1 << _subpass_index);
+						schedule_subpass_waiting_tasks(*main_column, task_scheduler);
 
 						if (_subpass_index == final_subpass_index) {
 							// Schedule pending block requests to make them handle cancellation
@@ -226,18 +241,19 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 
 						if (column->loading) {
 							// A task is pending to work on the dependency, so we wait.
-							// TODO Ideally we should subscribe to the completion of that task.
+							// TODO Ideally we should subscribe to the completion of that task, but loading is not
+							// implemented yet.
 							// println(format("O {} {} {} {} {}", int(_subpass_index), _column_position.x, 0,
 							// 		_column_position.y, Time::get_singleton()->get_ticks_usec()));
 							postpone = true;
 
 						} else if ((column->pending_subpass_tasks_mask & (1 << prev_subpass_index)) != 0) {
-							// A task is pending to work on the dependency, so we wait.
-							// TODO Ideally we should subscribe to the completion of that task.
-							// We can do that
+							// A task is pending to work on the dependency, so we wait for it to finish.
 							// println(format("O {} {} {} {} {}", int(_subpass_index), _column_position.x, 0,
 							// 		_column_position.y, Time::get_singleton()->get_ticks_usec()));
-							postpone = true;
+							if (waited_column == nullptr) {
+								waited_column = column;
+							}
 
 						} else {
 							// No task is pending to work on the dependency, spawn one.
@@ -253,7 +269,7 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 									prev_subpass_index,
 									_generator_internal,
 									_generator,
-									_priority,
+									get_dependency_priority(_priority),
 									this,
 									dependency_counter
 							));
@@ -285,6 +301,13 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 			ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
 			return;
 
+		} else if (waited_column != nullptr) {
+			// Wait on one of the columns. We hold a lock on it, so the task working on it can't finish before we are
+			// registered. Once resumed, other dependencies are checked again, and we may wait on another column.
+			waited_column->subpass_waiting_tasks.push_back(this);
+			ctx.status = ThreadedTaskContext::STATUS_TAKEN_OUT;
+			return;
+
 		} else {
 			ZN_PROFILE_SCOPE_NAMED("Run pass");
 			// We can run the pass
@@ -292,6 +315,10 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 			ZN_ASSERT(main_column != nullptr);
 
 			if (main_column->subpass_index == prev_subpass_index) {
+				Stats &stats = _generator_internal->stats;
+				++stats.executed_subpasses;
+				stats.subpass_wait_time_usec += _wait_clock.get_elapsed_microseconds();
+
 				const int column_height_blocks = _generator_internal->column_height_blocks;
 
 				if (_subpass_index == 0) {
@@ -353,6 +380,7 @@ void GenerateColumnMultipassTask::run(ThreadedTaskContext &ctx) {
 			}
 
 			main_column->pending_subpass_tasks_mask &= ~(1 << _subpass_index);
+			schedule_subpass_waiting_tasks(*main_column, task_scheduler);
 
 			if (main_column->subpass_index == final_subpass_index) {
 				// All tasks that were waiting for this column to be complete (and did not spawn column subtasks
@@ -379,6 +407,17 @@ void GenerateColumnMultipassTask::schedule_final_block_tasks(Column &column, Buf
 	}
 }
 
+void GenerateColumnMultipassTask::schedule_subpass_waiting_tasks(
+		Column &column,
+		BufferedTaskScheduler &task_scheduler
+) {
+	// They get their priority evaluated again when scheduled
+	for (IThreadedTask *task : column.subpass_waiting_tasks) {
+		task_scheduler.push_main_task(task);
+	}
+	column.subpass_waiting_tasks.clear();
+}
+
 void GenerateColumnMultipassTask::return_to_caller(bool success) {
 	ZN_ASSERT(_caller_task != nullptr);
 	ZN_ASSERT(_caller_task_dependency_counter != nullptr);
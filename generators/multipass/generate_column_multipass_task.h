@@ -1,6 +1,8 @@
 #ifndef VOXEL_GENERATE_COLUMN_MULTIPASS_TASK_H
 #define VOXEL_GENERATE_COLUMN_MULTIPASS_TASK_H
 
+#include "../../constants/voxel_constants.h"
+#include "../../util/profiling_clock.h"
 #include "../../util/tasks/threaded_task.h"
 #include "voxel_generator_multipass_cb.h"
 
@@ -13,7 +15,8 @@ class BufferedTaskScheduler;
 // If at least one column isn't found in the map, the task is cancelled, and so should be all its callers.
 // Otherwise:
 // If a column doesn't fulfills dependency requirements:
-//     - If another task is working on that column, the current task is postponed to run later.
+//     - If another task is working on that column, the current task waits on that column, and will be scheduled again
+//       when that task finishes.
 //     - Otherwise, a subtask is spawned to work on the dependency.
 //       The current task is queued after every subtask spawned this way.
 // Otherwise, the task runs the pass, re-schedules its caller, and returns.
@@ -42,6 +45,10 @@ public:
 		return "GenerateColumnMultipassTask";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_GENERATION;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 
 	TaskPriority get_priority() override {
@@ -57,6 +64,10 @@ private:
 			VoxelGeneratorMultipassCBStructs::Column &column,
 			BufferedTaskScheduler &task_scheduler
 	);
+	static void schedule_subpass_waiting_tasks(
+			VoxelGeneratorMultipassCBStructs::Column &column,
+			BufferedTaskScheduler &task_scheduler
+	);
 	void return_to_caller(bool success);
 
 	Vector2i _column_position;
@@ -73,6 +84,8 @@ private:
 	// processed".
 	std::shared_ptr<std::atomic_int> _caller_task_dependency_counter;
 	GenerateColumnMultipassTask *_caller_mp_task = nullptr;
+	// Started when the task is created, to measure how long it waits before running its subpass
+	ProfilingClock _wait_clock;
 };
 
 } // namespace zylann::voxel
@@ -9,6 +9,8 @@
 #include "../../util/string/format.h"
 #include "generate_block_multipass_cb_task.h"
 
+#include <algorithm>
+
 namespace zylann::voxel {
 
 using namespace VoxelGeneratorMultipassCBStructs;
@@ -190,6 +192,60 @@ Box2i to_box2i_in_height_range(Box3i box3, int min_y, int height) {
 	return Box2i(to_vec2i_xz(box3.position), to_vec2i_xz(box3.size));
 }
 
+// Removes least recently released columns until the cache fits in the given budget
+void evict_cached_columns(Map &map, uint64_t budget, Stats &stats) {
+	ZN_PROFILE_SCOPE();
+
+	MutexLock mlock(map.mutex);
+
+	if (map.cached_columns_memory_usage <= budget) {
+		return;
+	}
+
+	struct Candidate {
+		Vector2i position;
+		uint32_t cached_time;
+	};
+
+	StdVector<Candidate> candidates;
+	candidates.reserve(map.cached_column_count);
+	for (auto it = map.columns.begin(); it != map.columns.end(); ++it) {
+		const Column &column = it->second;
+		if (column.cached) {
+			candidates.push_back(Candidate{ it->first, column.cached_time });
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+		return a.cached_time < b.cached_time;
+	});
+
+	for (const Candidate &candidate : candidates) {
+		if (map.cached_columns_memory_usage <= budget) {
+			break;
+		}
+
+		// Neighbor tasks may still be reading the column. Don't wait for them, it can be evicted next time.
+		const BoxBounds2i bounds = BoxBounds2i::from_position(candidate.position);
+		if (!map.spatial_lock.try_lock_write(bounds)) {
+			continue;
+		}
+		SpatialLock2D::UnlockWriteOnScopeExit swlock(map.spatial_lock, bounds);
+
+		auto it = map.columns.find(candidate.position);
+		ZN_ASSERT_CONTINUE(it != map.columns.end());
+		Column &column = it->second;
+		if (column.pending_subpass_tasks_mask != 0 || column.subpass_waiting_tasks.size() > 0) {
+			continue;
+		}
+
+		map.cached_columns_memory_usage -= column.cached_memory_usage;
+		--map.cached_column_count;
+		map.columns.erase(it);
+		++stats.column_cache_evictions;
+	}
+}
+
 } // namespace
 
 void VoxelGeneratorMultipassCB::generate_pass(PassInput input) {
@@ -223,12 +279,15 @@ void VoxelGeneratorMultipassCB::re_initialize_column_refcounts() {
 	// This should only be called following a map reset
 	ZN_ASSERT_RETURN_MSG(get_internal()->map.columns.size() == 0, "Bug!");
 
+	MutexLock mlock(_paired_viewers_mutex);
 	for (PairedViewer &pv : _paired_viewers) {
 		process_viewer_diff_internal(pv.request_box, Box3i());
 	}
 }
 
 void VoxelGeneratorMultipassCB::process_viewer_diff(ViewerID id, Box3i p_requested_box, Box3i p_prev_requested_box) {
+	MutexLock mlock(_paired_viewers_mutex);
+
 	PairedViewer *paired_viewer = nullptr;
 	for (PairedViewer &pv : _paired_viewers) {
 		if (pv.id == id) {
@@ -251,10 +310,8 @@ void VoxelGeneratorMultipassCB::process_viewer_diff(ViewerID id, Box3i p_request
 void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_box, Box3i p_prev_requested_box) {
 	ZN_DSTACK();
 	ZN_PROFILE_SCOPE();
-	// TODO Could run as a task similarly to threaded update of VLT
-	// However if we do that we need to make sure block requests dont end up cancelled due to no block being found
-	// to load... the easiest way I can think of, is to just run this in the same thread that triggers the requests,
-	// and that means moving VoxelTerrain's process to a thread as well.
+	// This runs in the same thread that triggers block requests, so they don't end up cancelled due to no block being
+	// found to load. When VoxelTerrain has threaded update enabled, that is its update task.
 
 	std::shared_ptr<Internal> internal = get_internal();
 
@@ -285,17 +342,27 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 
 	// Blocks to view
 	const int column_height = internal->column_height_blocks;
-	load_requested_box.difference(prev_load_requested_box, [&map, column_height](Box2i new_box) {
+	Stats &stats = internal->stats;
+	load_requested_box.difference(prev_load_requested_box, [&map, column_height, &stats](Box2i new_box) {
 		{
 			ZN_PROFILE_SCOPE_NAMED("Enter box");
 
 			SpatialLock2D::Write swlock(map.spatial_lock, new_box);
 			MutexLock mlock(map.mutex);
 
-			new_box.for_each_cell_yx([&map, column_height](Vector2i bpos) {
+			new_box.for_each_cell_yx([&map, column_height, &stats](Vector2i bpos) {
 				Column &column = map.columns[bpos];
 				if (column.blocks.size() == 0) {
 					column.blocks.resize(column_height);
+					++stats.column_cache_misses;
+
+				} else if (column.cached) {
+					// Fully generated column released earlier, no need to run passes again
+					column.cached = false;
+					map.cached_columns_memory_usage -= column.cached_memory_usage;
+					--map.cached_column_count;
+					column.cached_memory_usage = 0;
+					++stats.column_cache_hits;
 				}
 				// if (block == nullptr) {
 				// 	block = make_unique_instance<Block>();
@@ -309,7 +376,15 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 	});
 
 	// Blocks to unview
-	prev_load_requested_box.difference(load_requested_box, [&map, &task_scheduler](Box2i old_box) {
+	struct CacheParams {
+		int final_subpass_index;
+		uint64_t memory_budget;
+	};
+	CacheParams cache;
+	cache.final_subpass_index = get_subpass_count_from_pass_count(internal->passes.size()) - 1;
+	cache.memory_budget = _column_cache_memory_budget;
+
+	prev_load_requested_box.difference(load_requested_box, [&map, &task_scheduler, &cache](Box2i old_box) {
 		ZN_PROFILE_SCOPE_NAMED("Leave box (locking)");
 
 		// TODO This can be a bottleneck if the generator is slow and a player teleports far away while columns are
@@ -323,7 +398,7 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 		{
 			ZN_PROFILE_SCOPE_NAMED("Leave box");
 
-			old_box.for_each_cell_yx([&map, &task_scheduler](Vector2i cpos) {
+			old_box.for_each_cell_yx([&map, &task_scheduler, &cache](Vector2i cpos) {
 				auto it = map.columns.find(cpos);
 
 				// The block must be found because last time the block was in the loading area of the viewer.
@@ -332,6 +407,23 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 
 				column.viewers.remove();
 				if (column.viewers.get() == 0) {
+					if (cache.memory_budget > 0 && column.subpass_index == cache.final_subpass_index &&
+						column.pending_subpass_tasks_mask == 0) {
+						// Keep the column, as viewers often come back to places they just left. If the cache
+						// exceeds its budget, the oldest columns are evicted after this.
+						uint64_t memory_usage = 0;
+						for (const Block &block : column.blocks) {
+							memory_usage += block.voxels.get_channels_memory_usage();
+						}
+						column.cached = true;
+						column.cached_memory_usage = memory_usage;
+						++map.cache_time;
+						column.cached_time = map.cache_time;
+						map.cached_columns_memory_usage += memory_usage;
+						++map.cached_column_count;
+						return;
+					}
+
 					for (Block &block : column.blocks) {
 						if (block.final_pending_task != nullptr) {
 							// There was a pending generate task, resume it, but it should basically return a drop.
@@ -341,6 +433,11 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 							block.final_pending_task = nullptr;
 						}
 					}
+					// Same for tasks waiting on the column, they will find it missing and cancel
+					for (IThreadedTask *task : column.subpass_waiting_tasks) {
+						task_scheduler.push_main_task(task);
+					}
+					column.subpass_waiting_tasks.clear();
 
 					// TODO Implement saving tasks
 					// We remove immediately for now
@@ -353,6 +450,8 @@ void VoxelGeneratorMultipassCB::process_viewer_diff_internal(Box3i p_requested_b
 	});
 
 	task_scheduler.flush();
+
+	evict_cached_columns(map, cache.memory_budget, stats);
 }
 
 void VoxelGeneratorMultipassCB::clear_cache() {
@@ -385,6 +484,40 @@ void VoxelGeneratorMultipassCB::clear_cache() {
 	*/
 }
 
+int VoxelGeneratorMultipassCB::get_column_cache_memory_budget_mb() const {
+	return _column_cache_memory_budget / (1024 * 1024);
+}
+
+void VoxelGeneratorMultipassCB::set_column_cache_memory_budget_mb(int mb) {
+	ERR_FAIL_COND(mb < 0);
+	_column_cache_memory_budget = uint64_t(mb) * 1024 * 1024;
+
+	std::shared_ptr<Internal> internal = get_internal();
+	evict_cached_columns(internal->map, _column_cache_memory_budget, internal->stats);
+}
+
+Dictionary VoxelGeneratorMultipassCB::get_statistics() const {
+	std::shared_ptr<Internal> internal = get_internal();
+	const Stats &stats = internal->stats;
+
+	Dictionary d;
+	d["executed_subpasses"] = stats.executed_subpasses.load(std::memory_order_relaxed);
+	d["subpass_wait_time_usec"] = stats.subpass_wait_time_usec.load(std::memory_order_relaxed);
+	d["postponed_subpasses"] = stats.postponed_subpasses.load(std::memory_order_relaxed);
+	d["column_cache_hits"] = stats.column_cache_hits.load(std::memory_order_relaxed);
+	d["column_cache_misses"] = stats.column_cache_misses.load(std::memory_order_relaxed);
+	d["column_cache_evictions"] = stats.column_cache_evictions.load(std::memory_order_relaxed);
+
+	{
+		MutexLock mlock(internal->map.mutex);
+		d["column_count"] = int64_t(internal->map.columns.size());
+		d["cached_column_count"] = internal->map.cached_column_count;
+		d["cached_columns_memory_usage"] = internal->map.cached_columns_memory_usage;
+	}
+
+	return d;
+}
+
 bool VoxelGeneratorMultipassCB::debug_try_get_column_states(StdVector<DebugColumnState> &out_states) {
 	ZN_PROFILE_SCOPE();
 
@@ -641,6 +774,16 @@ void VoxelGeneratorMultipassCB::_bind_methods() {
 			D_METHOD("set_column_height_blocks", "y"), &VoxelGeneratorMultipassCB::set_column_height_blocks
 	);
 
+	ClassDB::bind_method(
+			D_METHOD("get_column_cache_memory_budget_mb"), &VoxelGeneratorMultipassCB::get_column_cache_memory_budget_mb
+	);
+	ClassDB::bind_method(
+			D_METHOD("set_column_cache_memory_budget_mb", "mb"),
+			&VoxelGeneratorMultipassCB::set_column_cache_memory_budget_mb
+	);
+
+	ClassDB::bind_method(D_METHOD("get_statistics"), &VoxelGeneratorMultipassCB::get_statistics);
+
 	ClassDB::bind_method(
 			D_METHOD("debug_generate_test_column", "column_position_blocks"),
 			&VoxelGeneratorMultipassCB::debug_generate_test_column
@@ -669,6 +812,12 @@ void VoxelGeneratorMultipassCB::_bind_methods() {
 			"get_pass_count"
 	);
 
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "column_cache_memory_budget_mb", PROPERTY_HINT_RANGE, "0,65536,1,or_greater"),
+			"set_column_cache_memory_budget_mb",
+			"get_column_cache_memory_budget_mb"
+	);
+
 	BIND_CONSTANT(MAX_PASSES);
 	BIND_CONSTANT(MAX_PASS_EXTENT);
 }
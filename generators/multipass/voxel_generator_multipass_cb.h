@@ -84,6 +84,13 @@ public:
 	int get_pass_extent_blocks(int pass_index) const;
 	void set_pass_extent_blocks(int pass_index, int new_extent);
 
+	// Memory allowed for fully generated columns no viewer needs anymore, so they don't have to be generated again
+	// when a viewer comes back. 0 disables the cache.
+	int get_column_cache_memory_budget_mb() const;
+	void set_column_cache_memory_budget_mb(int mb);
+
+	Dictionary get_statistics() const;
+
 	// Run the generator to get a particular column from scratch, using a single thread for better script debugging
 	// (since Godot 4 still doesn't support debugging scripts in different threads, at time of writing). This doesn't
 	// use the internal cache and can be extremely slow.
@@ -178,6 +185,8 @@ private:
 	// terrain, moving around will start causing failed generation requests in a loop because the cache of
 	// partially-generated columns won't be in the right state...
 	StdVector<PairedViewer> _paired_viewers;
+	// VoxelTerrain can send viewer changes from its update task, while properties are changed on the main thread
+	BinaryMutex _paired_viewers_mutex;
 
 	// Threads can be very busy working on this data structure. Yet in the editor, users can modify its parameters
 	// anytime, which could break everything. So when any parameter changes, a copy of this structure is made, and the
@@ -186,6 +195,10 @@ private:
 	// never in the middle of gameplay.
 	std::shared_ptr<VoxelGeneratorMultipassCBStructs::Internal> _internal;
 	Mutex _internal_mutex;
+
+	// Not part of `Internal` since it doesn't change the structure of the cache.
+	// Only accessed from the main thread.
+	uint64_t _column_cache_memory_budget = 0;
 };
 
 } // namespace voxel
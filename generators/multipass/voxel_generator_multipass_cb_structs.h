@@ -12,6 +12,7 @@
 #include "../../util/thread/mutex.h"
 #include "../../util/thread/spatial_lock_2d.h"
 
+#include <atomic>
 #include <utility>
 
 // Data structures used internally in multipass generation.
@@ -73,10 +74,22 @@ struct Column {
 	int8_t subpass_index = -1;
 	bool saving = false;
 	bool loading = false;
+	// Set when no viewer needs the column anymore, but it was kept in the map because it was fully generated, so
+	// it can be reused if a viewer comes back. See `Map::cached_columns_memory_usage`.
+	bool cached = false;
+	// When the column got cached, used to evict the least recently released columns first
+	uint32_t cached_time = 0;
+	// Memory used by voxels of the column when it got cached
+	uint64_t cached_memory_usage = 0;
 
 	// Each bit is set to 1 when a task is pending to process this block at a given subpass.
 	uint8_t pending_subpass_tasks_mask = 0;
 
+	// Column tasks waiting for a pending subpass task of this column to finish, because they depend on it.
+	// They are scheduled again when that task finishes or cancels, or when the column gets unloaded, instead of
+	// polling. Like `Block::final_pending_task`, they are owned by the column while they are here.
+	StdVector<IThreadedTask *> subpass_waiting_tasks;
+
 	// Currently unused, because if chunks get removed from the cache or don't get saved for any reason,
 	// it can become out of sync and we wouldn't know. It would be a nice optimization tho...
 	//
@@ -102,6 +115,11 @@ struct Map {
 	// Protects columns
 	mutable SpatialLock2D spatial_lock;
 
+	// Columns without viewers kept in the map. Protected by `mutex`.
+	unsigned int cached_column_count = 0;
+	uint64_t cached_columns_memory_usage = 0;
+	uint32_t cache_time = 0;
+
 	~Map() {
 		// If the map gets destroyed then we know the last reference to it was removed, which means only one thread had
 		// access to it, so we can get away not locking anything if cleanup is needed.
@@ -124,6 +142,19 @@ struct Pass {
 	int8_t dependency_extents = 0;
 };
 
+struct Stats {
+	// Subpasses executed by column tasks, and time spent between the creation of these tasks and the execution of
+	// their subpass, which includes waiting for dependencies, locks or threads.
+	std::atomic_uint64_t executed_subpasses = { 0 };
+	std::atomic_uint64_t subpass_wait_time_usec = { 0 };
+	// Times a column task had to be postponed because its area was locked by other tasks
+	std::atomic_uint64_t postponed_subpasses = { 0 };
+	// Columns entering the area of a viewer, either found complete in the cache or created
+	std::atomic_uint64_t column_cache_hits = { 0 };
+	std::atomic_uint64_t column_cache_misses = { 0 };
+	std::atomic_uint64_t column_cache_evictions = { 0 };
+};
+
 // Internal state of the generator.
 struct Internal {
 	// Map used solely for generation purposes. It acts like a cache so we don't recompute the same passes many
@@ -143,6 +174,8 @@ struct Internal {
 	// tasks can end faster if they check this boolean.
 	bool expired = false;
 
+	Stats stats;
+
 	Internal() {
 		// 1 pass minimum
 		passes.push_back(Pass());
@@ -245,39 +245,23 @@ void VoxelToolMultipassGenerator::do_path(Span<const Vector3> positions, Span<co
 	const Box3i clipped_voxel_box = total_voxel_box.clipped(_editable_voxel_box);
 
 	// Rasterize
-
-	for (unsigned int point_index = 1; point_index < positions.size(); ++point_index) {
-		// TODO Could run this in local space so we dont need doubles
-		// TODO Apply terrain scale
-		const Vector3 p0 = positions[point_index - 1];
-		const Vector3 p1 = positions[point_index];
-
-		const float r0 = radii[point_index - 1];
-		const float r1 = radii[point_index];
-
-		ops::DoShapeChunked<ops::SdfRoundCone, GridAccess> op;
-		op.shape.cone.a = to_vec3f(p0);
-		op.shape.cone.b = to_vec3f(p1);
-		op.shape.cone.r1 = r0;
-		op.shape.cone.r2 = r1;
-		op.box = op.shape.get_box().padded(margin);
-
-		if (!op.box.intersects(clipped_voxel_box)) {
-			continue;
-		}
-
-		op.shape.cone.update();
-		op.shape.sdf_scale = get_sdf_scale();
-		op.block_access.pass_input = &_pass_input;
-		op.block_access.block_size_po2 = _block_size_po2;
-		op.mode = ops::Mode(get_mode());
-		op.texture_params = _texture_params;
-		op.blocky_value = _value;
-		op.channel = get_channel();
-		op.strength = get_sdf_strength();
-
-		op();
-	}
+	// TODO Apply terrain scale
+
+	ops::DoPathChunked<GridAccess> op;
+	op.positions = positions;
+	op.radii = radii;
+	op.sdf_scale = get_sdf_scale();
+	op.block_access.pass_input = &_pass_input;
+	op.block_access.block_size_po2 = _block_size_po2;
+	op.clip_box = clipped_voxel_box;
+	op.margin = margin;
+	op.mode = ops::Mode(get_mode());
+	op.texture_params = _texture_params;
+	op.blocky_value = _value;
+	op.channel = get_channel();
+	op.strength = get_sdf_strength();
+
+	op();
 }
 
 void VoxelToolMultipassGenerator::_bind_methods() {
@@ -1,10 +1,20 @@
 #include "voxel_generator_heightmap.h"
 #include "../../util/containers/fixed_array.h"
 #include "../../util/containers/span.h"
+#include "../../util/profiling.h"
 
 namespace zylann::voxel {
 
-VoxelGeneratorHeightmap::VoxelGeneratorHeightmap() {}
+namespace {
+// Same default as `VoxelGeneratorGraph`. Voxels closer to the surface than this must keep their actual distance, so
+// meshes of neighbor blocks connect properly.
+const float SDF_CLIP_THRESHOLD = 1.5f;
+const unsigned int HEIGHT_CACHE_MAX_ENTRIES = 256;
+} // namespace
+
+VoxelGeneratorHeightmap::VoxelGeneratorHeightmap() {
+	_height_cache.set_max_entries(HEIGHT_CACHE_MAX_ENTRIES);
+}
 
 VoxelGeneratorHeightmap::~VoxelGeneratorHeightmap() {}
 
@@ -63,6 +73,109 @@ float VoxelGeneratorHeightmap::get_iso_scale() const {
 	return _parameters.iso_scale;
 }
 
+void VoxelGeneratorHeightmap::clear_height_cache() {
+	_height_cache.clear();
+}
+
+StdVector<float> &VoxelGeneratorHeightmap::get_tls_heights() {
+	static thread_local StdVector<float> tls_heights;
+	return tls_heights;
+}
+
+VoxelGenerator::Result VoxelGeneratorHeightmap::generate_from_heights(
+		VoxelBuffer &out_buffer,
+		Span<const float> heights,
+		Vector3i origin,
+		int lod,
+		const Parameters &params
+) {
+	ZN_PROFILE_SCOPE();
+
+	const int channel = params.channel;
+	const Vector3i bs = out_buffer.get_size();
+	const bool use_sdf = channel == VoxelBuffer::CHANNEL_SDF;
+	const int stride = 1 << lod;
+
+	ZN_ASSERT_RETURN_V(heights.size() == static_cast<size_t>(bs.x * bs.z), Result());
+
+	float min_height = params.range.xform(heights[0]);
+	float max_height = min_height;
+	for (unsigned int i = 1; i < heights.size(); ++i) {
+		const float h = params.range.xform(heights[i]);
+		min_height = math::min(min_height, h);
+		max_height = math::max(max_height, h);
+	}
+
+	if (use_sdf) {
+		const float clip_threshold = SDF_CLIP_THRESHOLD * stride;
+		const int top_y = origin.y + (bs.y - 1) * stride;
+
+		// Heights were only sampled at the resolution of this LOD, so unlike with the height range, this doesn't tell
+		// that blocks of lower LODs are uniform too
+		if (params.iso_scale * (origin.y - max_height) > clip_threshold) {
+			// The whole block is far enough above ground in this column (default is air)
+			return Result();
+		}
+		if (params.iso_scale * (top_y - min_height) < -clip_threshold) {
+			out_buffer.clear_channel_f(channel, constants::SDF_FAR_INSIDE);
+			return Result();
+		}
+
+		// Distances are computed for the whole block in ZXY order first, which the compiler can vectorize along Y,
+		// then they are converted to the format of the channel all at once
+		static thread_local StdVector<float> tls_sdf;
+		StdVector<float> &sdf_values = tls_sdf;
+		sdf_values.resize(Vector3iUtil::get_volume_u64(bs));
+
+		unsigned int dst_i = 0;
+		unsigned int src_i = 0;
+		for (int z = 0; z < bs.z; ++z) {
+			for (int x = 0; x < bs.x; ++x) {
+				const float h = params.range.xform(heights[src_i]);
+				++src_i;
+				for (int y = 0; y < bs.y; ++y) {
+					const int gy = origin.y + y * stride;
+					sdf_values[dst_i + y] = params.iso_scale * (gy - h);
+				}
+				dst_i += bs.y;
+			}
+		}
+
+		out_buffer.set_box_f(Box3i(Vector3i(), bs), channel, to_span_const(sdf_values));
+
+	} else {
+		// Blocky
+
+		if (math::arithmetic_rshift(int(max_height - origin.y), lod) <= 0) {
+			// No ground in this block (default is air)
+			return Result();
+		}
+		if (math::arithmetic_rshift(int(min_height - origin.y), lod) >= bs.y) {
+			out_buffer.clear_channel(channel, params.matter_type);
+			return Result();
+		}
+
+		unsigned int i = 0;
+		for (int z = 0; z < bs.z; ++z) {
+			for (int x = 0; x < bs.x; ++x) {
+				// Output is blocky, so we can go for just one sample
+				float h = params.range.xform(heights[i]);
+				++i;
+				h -= origin.y;
+				int ih = math::arithmetic_rshift(int(h), lod);
+				if (ih > 0) {
+					if (ih > bs.y) {
+						ih = bs.y;
+					}
+					out_buffer.fill_area(params.matter_type, Vector3i(x, 0, z), Vector3i(x + 1, ih, z + 1), channel);
+				}
+			}
+		}
+	}
+
+	return Result();
+}
+
 void VoxelGeneratorHeightmap::_b_set_channel(godot::VoxelBuffer::ChannelId p_channel) {
 	set_channel(VoxelBuffer::ChannelId(p_channel));
 }
@@ -5,10 +5,13 @@
 #include "../../storage/voxel_buffer.h"
 #include "../../storage/voxel_buffer_gd.h"
 #include "../../util/containers/span.h"
+#include "../../util/containers/std_vector.h"
 #include "../../util/math/funcs.h"
+#include "../../util/math/vector2i.h"
 #include "../../util/math/vector3f.h"
 #include "../../util/math/vector3i.h"
 #include "../../util/thread/rw_lock.h"
+#include "../graph/xz_cache.h"
 #include "../voxel_generator.h"
 
 namespace zylann::voxel {
@@ -47,17 +50,16 @@ protected:
 			params = _parameters;
 		}
 
-		const int channel = params.channel;
 		const Vector3i bs = out_buffer.get_size();
-		const bool use_sdf = channel == VoxelBuffer::CHANNEL_SDF;
+		const bool use_sdf = params.channel == VoxelBuffer::CHANNEL_SDF;
 
-		if (origin.y > get_height_start() + get_height_range()) {
+		if (origin.y > params.range.start + params.range.height) {
 			// The bottom of the block is above the highest ground can go (default is air)
 			Result result;
 			result.max_lod_hint = true;
 			return result;
 		}
-		if (origin.y + (bs.y << lod) < get_height_start()) {
+		if (origin.y + (bs.y << lod) < params.range.start) {
 			// The top of the block is below the lowest ground can go
 			out_buffer.clear_channel(params.channel, use_sdf ? 0 : params.matter_type);
 			Result result;
@@ -65,54 +67,35 @@ protected:
 			return result;
 		}
 
-		const int stride = 1 << lod;
+		// Blocks stacked in the same column use the same heights, so they are cached
+		StdVector<float> &heights = get_tls_heights();
+		heights.resize(bs.x * bs.z);
+		const Vector2i xz_origin(origin.x, origin.z);
+		const Vector2i xz_size(bs.x, bs.z);
 
-		if (use_sdf) {
+		if (!_height_cache.try_load(xz_origin, lod, xz_size, to_span(heights))) {
+			const int stride = 1 << lod;
+			unsigned int i = 0;
 			int gz = origin.z;
 
 			for (int z = 0; z < bs.z; ++z, gz += stride) {
 				int gx = origin.x;
 
 				for (int x = 0; x < bs.x; ++x, gx += stride) {
-					float h = params.range.xform(height_func(gx, gz));
-					int gy = origin.y;
-					for (int y = 0; y < bs.y; ++y, gy += stride) {
-						const float sdf = params.iso_scale * (gy - h);
-						out_buffer.set_voxel_f(sdf, x, y, z, channel);
-					}
-
-				} // for x
-			} // for z
-
-		} else {
-			// Blocky
-
-			int gz = origin.z;
+					heights[i] = height_func(gx, gz);
+					++i;
+				}
+			}
 
-			for (int z = 0; z < bs.z; ++z, gz += stride) {
-				int gx = origin.x;
+			_height_cache.save(xz_origin, lod, xz_size, to_span_const(heights));
+		}
 
-				for (int x = 0; x < bs.x; ++x, gx += stride) {
-					// Output is blocky, so we can go for just one sample
-					float h = params.range.xform(height_func(gx, gz));
-					h -= origin.y;
-					int ih = math::arithmetic_rshift(int(h), lod);
-					if (ih > 0) {
-						if (ih > bs.y) {
-							ih = bs.y;
-						}
-						out_buffer.fill_area(
-								params.matter_type, Vector3i(x, 0, z), Vector3i(x + 1, ih, z + 1), channel
-						);
-					}
-
-				} // for x
-			} // for z
-		} // use_sdf
-
-		return Result();
+		return generate_from_heights(out_buffer, to_span_const(heights), origin, lod, params);
 	}
 
+	// Must be called when the function giving heights changes
+	void clear_height_cache();
+
 	// float height_func(x, y)
 	template <typename Height_F>
 	void generate_series_template(
@@ -169,8 +152,22 @@ private:
 		float iso_scale = 1.f;
 	};
 
+	// Heights are in ZX order, as returned by the height function, before `Range` is applied
+	static Result generate_from_heights(
+			VoxelBuffer &out_buffer,
+			Span<const float> heights,
+			Vector3i origin,
+			int lod,
+			const Parameters &params
+	);
+
+	static StdVector<float> &get_tls_heights();
+
 	RWLock _parameters_lock;
 	Parameters _parameters;
+
+	// Heights of areas of the XZ plane, shared by blocks of the same column
+	pg::XZCache _height_cache;
 };
 
 } // namespace zylann::voxel
@@ -38,8 +38,11 @@ void VoxelGeneratorImage::set_image(Ref<Image> im) {
 	if (im.is_valid()) {
 		copy = im->duplicate();
 	}
-	RWLockWrite wlock(_parameters_lock);
-	_parameters.image = copy;
+	{
+		RWLockWrite wlock(_parameters_lock);
+		_parameters.image = copy;
+	}
+	clear_height_cache();
 }
 
 Ref<Image> VoxelGeneratorImage::get_image() const {
@@ -47,8 +50,11 @@ Ref<Image> VoxelGeneratorImage::get_image() const {
 }
 
 void VoxelGeneratorImage::set_blur_enabled(bool enable) {
-	RWLockWrite wlock(_parameters_lock);
-	_parameters.blur_enabled = enable;
+	{
+		RWLockWrite wlock(_parameters_lock);
+		_parameters.blur_enabled = enable;
+	}
+	clear_height_cache();
 }
 
 bool VoxelGeneratorImage::is_blur_enabled() const {
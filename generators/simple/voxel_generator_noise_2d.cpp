@@ -28,8 +28,11 @@ void VoxelGeneratorNoise2D::set_noise(Ref<Noise> noise) {
 		// The OpenSimplexNoise resource is not thread-safe so we make a copy of it for use in threads
 		copy = _noise->duplicate();
 	}
-	RWLockWrite wlock(_parameters_lock);
-	_parameters.noise = copy;
+	{
+		RWLockWrite wlock(_parameters_lock);
+		_parameters.noise = copy;
+	}
+	clear_height_cache();
 }
 
 Ref<Noise> VoxelGeneratorNoise2D::get_noise() const {
@@ -46,17 +49,21 @@ void VoxelGeneratorNoise2D::set_curve(Ref<Curve> curve) {
 		);
 	}
 	_curve = curve;
-	RWLockWrite wlock(_parameters_lock);
-	if (_curve.is_valid()) {
-		_curve->connect(
-				VoxelStringNames::get_singleton().changed, callable_mp(this, &VoxelGeneratorNoise2D::_on_curve_changed)
-		);
-		// The Curve resource is not thread-safe so we make a copy of it for use in threads
-		_parameters.curve = _curve->duplicate();
-		_parameters.curve->bake();
-	} else {
-		_parameters.curve.unref();
+	{
+		RWLockWrite wlock(_parameters_lock);
+		if (_curve.is_valid()) {
+			_curve->connect(
+					VoxelStringNames::get_singleton().changed,
+					callable_mp(this, &VoxelGeneratorNoise2D::_on_curve_changed)
+			);
+			// The Curve resource is not thread-safe so we make a copy of it for use in threads
+			_parameters.curve = _curve->duplicate();
+			_parameters.curve->bake();
+		} else {
+			_parameters.curve.unref();
+		}
 	}
+	clear_height_cache();
 }
 
 Ref<Curve> VoxelGeneratorNoise2D::get_curve() const {
@@ -148,15 +155,21 @@ void VoxelGeneratorNoise2D::generate_series(
 
 void VoxelGeneratorNoise2D::_on_noise_changed() {
 	ERR_FAIL_COND(_noise.is_null());
-	RWLockWrite wlock(_parameters_lock);
-	_parameters.noise = _noise->duplicate();
+	{
+		RWLockWrite wlock(_parameters_lock);
+		_parameters.noise = _noise->duplicate();
+	}
+	clear_height_cache();
 }
 
 void VoxelGeneratorNoise2D::_on_curve_changed() {
 	ERR_FAIL_COND(_curve.is_null());
-	RWLockWrite wlock(_parameters_lock);
-	_parameters.curve = _curve->duplicate();
-	_parameters.curve->bake();
+	{
+		RWLockWrite wlock(_parameters_lock);
+		_parameters.curve = _curve->duplicate();
+		_parameters.curve->bake();
+	}
+	clear_height_cache();
 }
 
 void VoxelGeneratorNoise2D::_bind_methods() {
@@ -41,10 +41,13 @@ Vector2 VoxelGeneratorWaves::get_pattern_size() const {
 }
 
 void VoxelGeneratorWaves::set_pattern_size(Vector2 size) {
-	RWLockWrite wlock(_parameters_lock);
 	size.x = math::maxf(size.x, 0);
 	size.y = math::maxf(size.y, 0);
-	_parameters.pattern_size = size;
+	{
+		RWLockWrite wlock(_parameters_lock);
+		_parameters.pattern_size = size;
+	}
+	clear_height_cache();
 }
 
 Vector2 VoxelGeneratorWaves::get_pattern_offset() const {
@@ -53,8 +56,11 @@ Vector2 VoxelGeneratorWaves::get_pattern_offset() const {
 }
 
 void VoxelGeneratorWaves::set_pattern_offset(Vector2 offset) {
-	RWLockWrite wlock(_parameters_lock);
-	_parameters.pattern_offset = offset;
+	{
+		RWLockWrite wlock(_parameters_lock);
+		_parameters.pattern_offset = offset;
+	}
+	clear_height_cache();
 }
 
 void VoxelGeneratorWaves::_bind_methods() {
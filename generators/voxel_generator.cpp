@@ -2,11 +2,14 @@
 #include "../constants/voxel_string_names.h"
 #include "../engine/gpu/compute_shader.h"
 #include "../engine/gpu/compute_shader_parameters.h"
+#include "../engine/voxel_engine.h"
+#include "../modifiers/voxel_modifier_stack.h"
 #include "../shaders/shaders.h"
 #include "../storage/voxel_buffer_gd.h"
 #include "../util/godot/core/array.h" // for `varray` in GDExtension builds
 #include "../util/profiling.h"
 #include "generate_block_task.h"
+#include "generate_series_task.h"
 
 namespace zylann::voxel {
 
@@ -16,6 +19,18 @@ VoxelGenerator::Result VoxelGenerator::generate_block(VoxelQueryData input) {
 	return Result();
 }
 
+VoxelGenerator::Result VoxelGenerator::generate_block_with_modifiers(
+		VoxelQueryData input,
+		const VoxelModifierStack &modifiers
+) {
+	input.modifiers = &modifiers;
+	const Result result = generate_block(input);
+	if (!result.modifiers_applied) {
+		modifiers.apply(input.voxel_buffer, AABB(input.origin_in_voxels, input.voxel_buffer.get_size() << input.lod));
+	}
+	return result;
+}
+
 IThreadedTask *VoxelGenerator::create_block_task(const BlockTaskParams &params) const {
 	// Default generic task
 	return ZN_NEW(GenerateBlockTask(params));
@@ -57,6 +72,39 @@ void VoxelGenerator::generate_series(
 	ZN_PRINT_ERROR("Not implemented");
 }
 
+int VoxelGenerator::generate_series_async(const PackedVector3Array &positions, int channel) {
+	ERR_FAIL_COND_V_MSG(
+			!supports_series_generation(),
+			-1,
+			String("The generator {0} does not support series generation").format(varray(get_class()))
+	);
+	ERR_FAIL_INDEX_V(channel, VoxelBuffer::MAX_CHANNELS, -1);
+
+	const int request_id = _next_series_request_id.fetch_add(1, std::memory_order_relaxed);
+
+	GenerateSeriesTask *task = ZN_NEW(GenerateSeriesTask);
+	task->generator = Ref<VoxelGenerator>(this);
+	task->channel = channel;
+	task->request_id = request_id;
+	task->positions_x.resize(positions.size());
+	task->positions_y.resize(positions.size());
+	task->positions_z.resize(positions.size());
+	for (int i = 0; i < positions.size(); ++i) {
+		const Vector3 pos = positions[i];
+		task->positions_x[i] = pos.x;
+		task->positions_y[i] = pos.y;
+		task->positions_z[i] = pos.z;
+	}
+
+	VoxelEngine::get_singleton().push_async_task(task);
+	return request_id;
+}
+
+// Intermediate method to enforce the signal to be emitted on the main thread
+void VoxelGenerator::_b_on_series_generated(int request_id, PackedFloat32Array values) {
+	emit_signal(VoxelStringNames::get_singleton().series_generated, request_id, values);
+}
+
 void VoxelGenerator::_b_generate_block(Ref<godot::VoxelBuffer> out_buffer, Vector3 origin_in_voxels, int lod) {
 	ERR_FAIL_COND(lod < 0);
 	ERR_FAIL_COND(lod >= int(constants::MAX_LOD));
@@ -312,6 +360,20 @@ void VoxelGenerator::_bind_methods() {
 	ClassDB::bind_method(
 			D_METHOD("generate_block", "out_buffer", "origin_in_voxels", "lod"), &VoxelGenerator::_b_generate_block
 	);
+	ClassDB::bind_method(
+			D_METHOD("generate_series_async", "positions", "channel"), &VoxelGenerator::generate_series_async
+	);
+
+	// Internal
+	ClassDB::bind_method(
+			D_METHOD("_on_series_generated", "request_id", "values"), &VoxelGenerator::_b_on_series_generated
+	);
+
+	ADD_SIGNAL(MethodInfo(
+			"series_generated",
+			PropertyInfo(Variant::INT, "request_id"),
+			PropertyInfo(Variant::PACKED_FLOAT32_ARRAY, "values")
+	));
 }
 
 } // namespace zylann::voxel
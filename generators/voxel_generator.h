@@ -12,6 +12,7 @@
 #include "../util/tasks/cancellation_token.h"
 #include "../util/thread/mutex.h"
 
+#include <atomic>
 #include <memory>
 
 namespace zylann {
@@ -26,6 +27,7 @@ class ComputeShader;
 struct ComputeShaderParameters;
 struct StreamingDependency;
 class VoxelData;
+class VoxelModifierStack;
 
 namespace godot {
 class VoxelBuffer;
@@ -51,16 +53,34 @@ public:
 		// If `true`, any block below this LOD are considered to not bring more details or will be the same.
 		// This allows to reduce the number of blocks to load when LOD is used.
 		bool max_lod_hint = false;
+		// Set by generators that applied `VoxelQueryData::modifiers` themselves.
+		bool modifiers_applied = false;
 	};
 
 	struct VoxelQueryData {
 		VoxelBuffer &voxel_buffer;
 		Vector3i origin_in_voxels;
 		uint32_t lod;
+		// Details smaller than this size (in voxels) can't be represented by the queried voxels and may be skipped by
+		// generators supporting it. 0 means details of all sizes are requested.
+		float min_feature_size = 0.f;
+		// Modifiers to apply to the generated SDF. Generators supporting it can apply them before SDF is quantized into
+		// the block, which saves another pass converting the block's SDF back and forth. Others can ignore it.
+		const VoxelModifierStack *modifiers = nullptr;
 	};
 
+	// Smallest size of details that voxels of the given LOD can represent without aliasing. LOD 0 returns 0, so
+	// full-resolution voxels always get all details.
+	static inline float get_min_feature_size_for_lod(uint32_t lod_index) {
+		return lod_index == 0 ? 0.f : static_cast<float>(2 << lod_index);
+	}
+
 	virtual Result generate_block(VoxelQueryData input);
 
+	// Generates a block with modifiers applied. Modifiers are applied after generation if the generator doesn't apply
+	// them itself.
+	Result generate_block_with_modifiers(VoxelQueryData input, const VoxelModifierStack &modifiers);
+
 	struct BlockTaskParams {
 		Vector3i block_position;
 		VolumeID volume_id;
@@ -105,6 +125,11 @@ public:
 			Vector3f max_pos
 	);
 
+	// Generates values at many positions using the thread pool, spreading chunks of them over multiple threads.
+	// Results are passed to the `series_generated` signal on the main thread, with the returned ID to tell requests
+	// apart. The generator must support series generation.
+	int generate_series_async(const PackedVector3Array &positions, int channel);
+
 	// Declares the channels this generator will use
 	virtual int get_used_channels_mask() const;
 
@@ -185,6 +210,7 @@ protected:
 	static void _bind_methods();
 
 	void _b_generate_block(Ref<godot::VoxelBuffer> out_buffer, Vector3 origin_in_voxels, int lod);
+	void _b_on_series_generated(int request_id, PackedFloat32Array values);
 
 	std::shared_ptr<ComputeShader> _detail_rendering_shader;
 	std::shared_ptr<ComputeShaderParameters> _detail_rendering_shader_parameters;
@@ -192,6 +218,8 @@ protected:
 	std::shared_ptr<ComputeShaderParameters> _block_rendering_shader_parameters;
 	std::shared_ptr<ShaderOutputs> _block_rendering_shader_outputs;
 	Mutex _shader_mutex;
+
+	std::atomic_int _next_series_request_id = { 0 };
 };
 
 } // namespace voxel
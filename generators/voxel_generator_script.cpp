@@ -1,7 +1,11 @@
 #include "voxel_generator_script.h"
 #include "../constants/voxel_string_names.h"
+#include "../engine/voxel_engine.h"
 #include "../storage/voxel_buffer_gd.h"
 #include "../util/godot/check_ref_ownership.h"
+#include "../util/godot/core/packed_arrays.h"
+#include "../util/math/conv.h"
+#include "../util/profiling.h"
 
 namespace zylann::voxel {
 
@@ -10,6 +14,15 @@ VoxelGeneratorScript::VoxelGeneratorScript() {}
 VoxelGenerator::Result VoxelGeneratorScript::generate_block(VoxelGenerator::VoxelQueryData input) {
 	Result result;
 
+	if (_batch_support != BATCH_UNSUPPORTED) {
+		BlockRequest request{ &input, false };
+		_batch_combiner.process(request, [this](Span<BlockRequest *> requests) { generate_block_batch(requests); });
+		if (request.generated) {
+			return result;
+		}
+		// The script doesn't implement batches, fallback on single blocks
+	}
+
 	// Create a temporary wrapper so Godot can pass it to scripts
 	Ref<godot::VoxelBuffer> buffer_wrapper(
 			memnew(godot::VoxelBuffer(static_cast<godot::VoxelBuffer::Allocator>(input.voxel_buffer.get_allocator())))
@@ -37,6 +50,55 @@ VoxelGenerator::Result VoxelGeneratorScript::generate_block(VoxelGenerator::Voxe
 	return result;
 }
 
+void VoxelGeneratorScript::generate_block_batch(Span<BlockRequest *> requests) {
+	ZN_PROFILE_SCOPE();
+
+	TypedArray<godot::VoxelBuffer> buffer_wrappers;
+	PackedVector3Array origins;
+	PackedInt32Array lods;
+	buffer_wrappers.resize(requests.size());
+	origins.resize(requests.size());
+	lods.resize(requests.size());
+
+	for (unsigned int i = 0; i < requests.size(); ++i) {
+		const VoxelGenerator::VoxelQueryData &input = *requests[i]->input;
+		// Create temporary wrappers so Godot can pass them to scripts
+		Ref<godot::VoxelBuffer> buffer_wrapper(memnew(
+				godot::VoxelBuffer(static_cast<godot::VoxelBuffer::Allocator>(input.voxel_buffer.get_allocator()))
+		));
+		buffer_wrapper->get_buffer().copy_format(input.voxel_buffer);
+		buffer_wrapper->get_buffer().create(input.voxel_buffer.get_size());
+		buffer_wrappers[i] = buffer_wrapper;
+		origins.set(i, to_vec3(input.origin_in_voxels));
+		lods.set(i, input.lod);
+	}
+
+	if (!GDVIRTUAL_CALL(_generate_blocks, buffer_wrappers, origins, lods)) {
+		// Requests are left for their threads to generate one by one
+		_batch_support = BATCH_UNSUPPORTED;
+		return;
+	}
+
+	if (_batch_support == BATCH_SUPPORT_UNKNOWN) {
+		_batch_support = BATCH_SUPPORTED;
+		bool thread_safe = false;
+		if (GDVIRTUAL_CALL(_is_thread_safe, thread_safe) && thread_safe) {
+			// Batches can run at the same time, but not on every thread, so requests still get combined
+			const unsigned int thread_count = VoxelEngine::get_singleton().get_thread_count();
+			_batch_combiner.set_max_concurrent_batches(math::max(thread_count / 2, 1u));
+		}
+	}
+
+	for (unsigned int i = 0; i < requests.size(); ++i) {
+		BlockRequest &request = *requests[i];
+		Ref<godot::VoxelBuffer> buffer_wrapper = buffer_wrappers[i];
+		ERR_CONTINUE(buffer_wrapper.is_null());
+		// The wrapper is discarded. The thread owning the request is waiting for it, so we can write to its buffer.
+		buffer_wrapper->get_buffer().move_to(request.input->voxel_buffer);
+		request.generated = true;
+	}
+}
+
 int VoxelGeneratorScript::get_used_channels_mask() const {
 	int mask = 0;
 	if (!GDVIRTUAL_CALL(_get_used_channels_mask, mask)) {
@@ -47,6 +109,8 @@ int VoxelGeneratorScript::get_used_channels_mask() const {
 
 void VoxelGeneratorScript::_bind_methods() {
 	GDVIRTUAL_BIND(_generate_block, "out_buffer", "origin_in_voxels", "lod");
+	GDVIRTUAL_BIND(_generate_blocks, "out_buffers", "origins_in_voxels", "lods");
+	GDVIRTUAL_BIND(_is_thread_safe);
 	GDVIRTUAL_BIND(_get_used_channels_mask);
 }
 
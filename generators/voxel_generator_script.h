@@ -2,7 +2,10 @@
 #define VOXEL_GENERATOR_SCRIPT_H
 
 #include "../util/godot/core/gdvirtual.h"
+#include "../util/godot/core/typed_array.h"
+#include "../util/thread/request_combiner.h"
 #include "voxel_generator.h"
+#include <atomic>
 
 #ifdef ZN_GODOT_EXTENSION
 // GodotCpp wants the full definition of the class in GDVIRTUAL
@@ -13,6 +16,8 @@ namespace zylann::voxel {
 
 // Generator based on a script, like GDScript, C# or NativeScript.
 // The script is expected to properly handle multithreading.
+// If the script implements `_generate_blocks`, blocks requested by concurrent threads are combined into batches, so
+// the cost of calling the script is amortized, and implementations can use their own parallelism.
 class VoxelGeneratorScript : public VoxelGenerator {
 	GDCLASS(VoxelGeneratorScript, VoxelGenerator)
 public:
@@ -23,10 +28,28 @@ public:
 
 protected:
 	GDVIRTUAL3(_generate_block, Ref<godot::VoxelBuffer>, Vector3i, int)
+	GDVIRTUAL3(_generate_blocks, TypedArray<godot::VoxelBuffer>, PackedVector3Array, PackedInt32Array)
+	GDVIRTUAL0RC(bool, _is_thread_safe)
 	GDVIRTUAL0RC(int, _get_used_channels_mask) // I think `C` means `const`?
 
 private:
+	struct BlockRequest {
+		VoxelGenerator::VoxelQueryData *input;
+		bool generated;
+	};
+
+	void generate_block_batch(Span<BlockRequest *> requests);
+
 	static void _bind_methods();
+
+	enum BatchSupport : uint8_t { //
+		BATCH_SUPPORT_UNKNOWN,
+		BATCH_SUPPORTED,
+		BATCH_UNSUPPORTED
+	};
+
+	std::atomic<BatchSupport> _batch_support{ BATCH_SUPPORT_UNKNOWN };
+	RequestCombiner<BlockRequest> _batch_combiner;
 };
 
 } // namespace zylann::voxel
@@ -41,20 +41,19 @@ void VoxelBlockyTypeLibrary::load_default() {
 void VoxelBlockyTypeLibrary::bake() {
 	ZN_PROFILE_SCOPE();
 
-	RWLockWrite lock(_baked_data_rw_lock);
-
 	const uint64_t time_before = Time::get_singleton()->get_ticks_usec();
 
-	// This is the only place we modify the data.
+	// Baking is done in a separate copy, so meshing threads keep using the previous data in the meantime, and are
+	// only blocked while it gets swapped.
 
-	_indexed_materials.clear();
-	_baked_data.models.clear();
+	BakedData baked_data;
+	StdVector<Ref<Material>> indexed_materials;
 
 	StdVector<VoxelBlockyModel::BakedData> baked_models;
 	StdVector<VoxelBlockyType::VariantKey> keys;
-	VoxelBlockyModel::MaterialIndexer material_indexer{ _indexed_materials };
+	VoxelBlockyModel::MaterialIndexer material_indexer{ indexed_materials };
 
-	_baked_data.models.resize(_id_map.size());
+	baked_data.models.resize(_id_map.size());
 
 	for (size_t i = 0; i < _types.size(); ++i) {
 		Ref<VoxelBlockyType> type = _types[i];
@@ -67,7 +66,7 @@ void VoxelBlockyTypeLibrary::bake() {
 
 		unsigned int rel_key_index = 0;
 		for (VoxelBlockyModel::BakedData &baked_model : baked_models) {
-			// _baked_data.models.push_back(std::move(baked_model));
+			// baked_data.models.push_back(std::move(baked_model));
 			id.variant_key = keys[rel_key_index];
 
 			size_t model_index;
@@ -77,13 +76,13 @@ void VoxelBlockyTypeLibrary::bake() {
 				// If not found, pick an empty slot if any
 				if (!find(to_span_const(_id_map), VoxelID(), model_index)) {
 					// If not found, allocate a new index at the end
-					model_index = _baked_data.models.size();
-					_baked_data.models.push_back(VoxelBlockyModel::BakedData());
+					model_index = baked_data.models.size();
+					baked_data.models.push_back(VoxelBlockyModel::BakedData());
 					_id_map.push_back(id);
 				}
 			}
 
-			_baked_data.models[model_index] = std::move(baked_model);
+			baked_data.models[model_index] = std::move(baked_model);
 
 			++rel_key_index;
 		}
@@ -92,17 +91,25 @@ void VoxelBlockyTypeLibrary::bake() {
 		keys.clear();
 	}
 
-	if (_baked_data.models.size() > MAX_MODELS) {
-		const int extra = _baked_data.models.size() - MAX_MODELS;
+	if (baked_data.models.size() > MAX_MODELS) {
+		const int extra = baked_data.models.size() - MAX_MODELS;
 		ZN_PRINT_ERROR(
 				format("Reached maximum supported models {}. {} extra models will not be used.", MAX_MODELS, extra)
 		);
-		_baked_data.models.resize(MAX_MODELS);
+		baked_data.models.resize(MAX_MODELS);
 	}
 
-	_baked_data.indexed_materials_count = _indexed_materials.size();
+	baked_data.indexed_materials_count = indexed_materials.size();
+
+	generate_side_culling_matrix(baked_data);
+	update_cubes_only_flag(baked_data);
 
-	generate_side_culling_matrix(_baked_data);
+	{
+		// This is the only place we modify the data.
+		RWLockWrite lock(_baked_data_rw_lock);
+		_baked_data = std::move(baked_data);
+		_indexed_materials = std::move(indexed_materials);
+	}
 
 	const uint64_t time_spent = Time::get_singleton()->get_ticks_usec() - time_before;
 	ZN_PRINT_VERBOSE(
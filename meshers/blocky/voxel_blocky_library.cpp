@@ -47,28 +47,36 @@ void VoxelBlockyLibrary::load_default() {
 void VoxelBlockyLibrary::bake() {
 	ZN_PROFILE_SCOPE();
 
-	RWLockWrite lock(_baked_data_rw_lock);
-
 	const uint64_t time_before = Time::get_singleton()->get_ticks_usec();
 
-	// This is the only place we modify the data.
+	// Baking is done in a separate copy, so meshing threads keep using the previous data in the meantime, and are
+	// only blocked while it gets swapped.
 
-	_indexed_materials.clear();
-	VoxelBlockyModel::MaterialIndexer materials{ _indexed_materials };
+	StdVector<Ref<Material>> indexed_materials;
+	VoxelBlockyModel::MaterialIndexer materials{ indexed_materials };
 
-	_baked_data.models.resize(_voxel_models.size());
+	BakedData baked_data;
+	baked_data.models.resize(_voxel_models.size());
 	for (size_t i = 0; i < _voxel_models.size(); ++i) {
 		Ref<VoxelBlockyModel> config = _voxel_models[i];
 		if (config.is_valid()) {
-			config->bake(_baked_data.models[i], _bake_tangents, materials);
+			config->bake(baked_data.models[i], _bake_tangents, materials);
 		} else {
-			_baked_data.models[i].clear();
+			baked_data.models[i].clear();
 		}
 	}
 
-	_baked_data.indexed_materials_count = _indexed_materials.size();
+	baked_data.indexed_materials_count = indexed_materials.size();
 
-	generate_side_culling_matrix(_baked_data);
+	generate_side_culling_matrix(baked_data);
+	update_cubes_only_flag(baked_data);
+
+	{
+		// This is the only place we modify the data.
+		RWLockWrite lock(_baked_data_rw_lock);
+		_baked_data = std::move(baked_data);
+		_indexed_materials = std::move(indexed_materials);
+	}
 
 	uint64_t time_spent = Time::get_singleton()->get_ticks_usec() - time_before;
 	ZN_PRINT_VERBOSE(
@@ -78,6 +86,40 @@ void VoxelBlockyLibrary::bake() {
 	_needs_baking = false;
 }
 
+void VoxelBlockyLibrary::bake_model(int model_index) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(model_index >= 0 && model_index < static_cast<int>(_voxel_models.size()));
+
+	if (_needs_baking || _baked_data.models.size() != _voxel_models.size()) {
+		// Other models have to be baked too
+		bake();
+		return;
+	}
+
+	// Materials of other models keep their index. New ones are added at the end, and those no longer used remain
+	// until the next full bake.
+	StdVector<Ref<Material>> indexed_materials = _indexed_materials;
+	VoxelBlockyModel::MaterialIndexer materials{ indexed_materials };
+
+	// Value-initialized, like models in `bake`
+	VoxelBlockyModel::BakedData baked_model = VoxelBlockyModel::BakedData();
+	Ref<VoxelBlockyModel> config = _voxel_models[model_index];
+	if (config.is_valid()) {
+		config->bake(baked_model, _bake_tangents, materials);
+	}
+
+	RWLockWrite lock(_baked_data_rw_lock);
+
+	_baked_data.models[model_index] = std::move(baked_model);
+	_indexed_materials = std::move(indexed_materials);
+	_baked_data.indexed_materials_count = _indexed_materials.size();
+
+	// Side patterns are shared by all models, so they have to be found again. That's much cheaper than baking every
+	// model, but it modifies all of them, so it is done under the lock.
+	generate_side_culling_matrix(_baked_data);
+	update_cubes_only_flag(_baked_data);
+}
+
 int VoxelBlockyLibrary::get_model_index_from_resource_name(String resource_name) const {
 	for (unsigned int i = 0; i < _voxel_models.size(); ++i) {
 		const Ref<VoxelBlockyModel> &model = _voxel_models[i];
@@ -233,6 +275,7 @@ void VoxelBlockyLibrary::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_models"), &VoxelBlockyLibrary::_b_set_models);
 
 	ClassDB::bind_method(D_METHOD("add_model", "model"), &VoxelBlockyLibrary::add_model);
+	ClassDB::bind_method(D_METHOD("bake_model", "index"), &VoxelBlockyLibrary::bake_model);
 
 	ClassDB::bind_method(D_METHOD("get_model", "index"), &VoxelBlockyLibrary::_b_get_model);
 	ClassDB::bind_method(
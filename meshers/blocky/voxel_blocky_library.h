@@ -24,6 +24,10 @@ public:
 
 	void bake() override;
 
+	// Bakes again a single model after it was modified, which is faster than baking the whole library. Falls back
+	// to `bake` if the library was never baked, or if models were added or removed since.
+	void bake_model(int model_index);
+
 	int get_model_index_from_resource_name(String resource_name) const;
 
 	// Convenience method that returns the index of the added model
@@ -337,4 +337,15 @@ void generate_side_culling_matrix(VoxelBlockyLibraryBase::BakedData &baked_data)
 	print_line("");*/
 }
 
+void update_cubes_only_flag(VoxelBlockyLibraryBase::BakedData &baked_data) {
+	baked_data.cubes_only = true;
+	for (const VoxelBlockyModel::BakedData &model_data : baked_data.models) {
+		// Empty models never produce geometry
+		if (!model_data.empty && !model_data.model.quad_sides_only) {
+			baked_data.cubes_only = false;
+			break;
+		}
+	}
+}
+
 } // namespace zylann::voxel
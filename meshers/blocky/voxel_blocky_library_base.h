@@ -46,6 +46,9 @@ public:
 
 		unsigned int indexed_materials_count = 0;
 
+		// All non-empty models have `quad_sides_only`, so a faster meshing path can be used
+		bool cubes_only = false;
+
 		inline bool has_model(uint32_t i) const {
 			return i < models.size();
 		}
@@ -110,6 +113,7 @@ protected:
 };
 
 void generate_side_culling_matrix(VoxelBlockyLibraryBase::BakedData &baked_data);
+void update_cubes_only_flag(VoxelBlockyLibraryBase::BakedData &baked_data);
 
 } // namespace zylann::voxel
 
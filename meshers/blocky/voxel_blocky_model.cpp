@@ -271,6 +271,26 @@ void VoxelBlockyModel::bake(BakedData &baked_data, bool bake_tangents, MaterialI
 		}
 	}
 
+	model.quad_sides_only = model.surface_count == 1 && model.surfaces[0].positions.size() == 0;
+	for (unsigned int side = 0; side < Cube::SIDE_COUNT && model.quad_sides_only; ++side) {
+		const BakedData::SideSurface &side_surface = model.surfaces[0].sides[side];
+		if (side_surface.indices.size() == 0) {
+			continue;
+		}
+		if (side_surface.positions.size() != 4 || side_surface.uvs.size() != 4 || side_surface.indices.size() != 6) {
+			model.quad_sides_only = false;
+			break;
+		}
+		for (unsigned int vertex_index = 0; vertex_index < 4; ++vertex_index) {
+			for (unsigned int i = 0; i < 4; ++i) {
+				// Same weighting as the general occlusion path of the mesher
+				const Vector3f corner_position = Cube::g_corner_position[Cube::g_side_corners[side][i]];
+				const float k = 1.f - math::distance_squared(corner_position, side_surface.positions[vertex_index]);
+				model.quad_side_occlusion_weights[side][vertex_index][i] = math::max(k, 0.f);
+			}
+		}
+	}
+
 	// Assign material overrides if any
 	for (unsigned int surface_index = 0; surface_index < model.surface_count; ++surface_index) {
 		if (surface_index < _surface_count) {
@@ -88,6 +88,15 @@ public:
 			// Tells what is the "shape" of each side in order to cull them quickly when in contact with neighbors.
 			// Side patterns are still determined based on a combination of all surfaces.
 			FixedArray<uint32_t, Cube::SIDE_COUNT> side_pattern_indices;
+			// Sides are single unit quads whose texture covers the whole UV range, so sides of neighbor voxels
+			// using the same model can be merged into larger quads repeating the texture.
+			bool tileable_sides = false;
+			// Each non-empty side is a single quad, and there is no geometry inside, like cubes. Sides of such models
+			// can be meshed with fixed-size copies.
+			bool quad_sides_only = false;
+			// Only set if `quad_sides_only` is true. For each side and each vertex of its quad, how much baked
+			// occlusion of each corner of the side applies, in the order of `Cube::g_side_corners`.
+			FixedArray<FixedArray<FixedArray<float, 4>, 4>, Cube::SIDE_COUNT> quad_side_occlusion_weights;
 			// Side culling is all or nothing.
 			// If we want to support partial culling with baked models (needed if you do fluids with "staircase"
 			// models), we would need another lookup table that given two side patterns, outputs alternate geometry data
@@ -99,6 +108,8 @@ public:
 				for (unsigned int i = 0; i < surfaces.size(); ++i) {
 					surfaces[i].clear();
 				}
+				tileable_sides = false;
+				quad_sides_only = false;
 			}
 		};
 
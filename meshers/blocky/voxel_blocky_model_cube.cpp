@@ -240,6 +240,9 @@ void bake_cube_geometry(
 		rotate_ortho(surface.sides, config.get_mesh_ortho_rotation_index());
 	}
 
+	// With an atlas of a single tile, the texture can repeat over several voxels
+	baked_data.model.tileable_sides = p_atlas_size == Vector2i(1, 1) && height >= 1.f;
+
 	baked_data.empty = false;
 }
 
@@ -2,6 +2,7 @@
 #include "../../constants/cube_tables.h"
 #include "../../storage/voxel_buffer.h"
 #include "../../util/containers/span.h"
+#include "../../util/godot/classes/mesh.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/godot/core/packed_arrays.h"
 #include "../../util/macros.h"
@@ -59,21 +60,576 @@ StdVector<int> &get_tls_index_offsets() {
 	return tls_index_offsets;
 }
 
-} // namespace
+// Bitmasks of voxels along the Y axis of each column of a padded block, stored as words of 64 voxels. They allow to
+// find voxels that may have visible sides for many voxels at once, instead of checking each side of each voxel.
+struct BlockyColumnMasks {
+	enum MaskID {
+		// Voxels having a model
+		MASK_PRESENT = 0,
+		// Voxels whose model has geometry that isn't on its sides
+		MASK_INSIDE,
+		// Voxels having a full side which hides any side of neighbors touching it. One mask per side.
+		MASK_OCCLUDING_SIDES,
+		MASK_COUNT = MASK_OCCLUDING_SIDES + Cube::SIDE_COUNT
+	};
+
+	static const unsigned int WORD_SIZE = 64;
+
+	StdVector<uint64_t> words;
+	// Voxels that are not part of the padding
+	StdVector<uint64_t> inner_words;
+	unsigned int words_per_mask = 0;
+
+	inline uint64_t get_word(unsigned int column, unsigned int mask_id, unsigned int word_index) const {
+		return words[(column * MASK_COUNT + mask_id) * words_per_mask + word_index];
+	}
+
+	inline uint64_t &get_word(unsigned int column, unsigned int mask_id, unsigned int word_index) {
+		return words[(column * MASK_COUNT + mask_id) * words_per_mask + word_index];
+	}
+};
+
+BlockyColumnMasks &get_tls_column_masks() {
+	static thread_local BlockyColumnMasks tls_column_masks;
+	return tls_column_masks;
+}
+
+inline unsigned int get_first_bit(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(v);
+#else
+	unsigned int i = 0;
+	while ((v & 1) == 0) {
+		v >>= 1;
+		++i;
+	}
+	return i;
+#endif
+}
 
 template <typename Type_T>
+void compute_column_masks(
+		BlockyColumnMasks &masks,
+		Span<const Type_T> type_buffer,
+		const Vector3i block_size,
+		const VoxelBlockyLibraryBase::BakedData &library
+) {
+	ZN_PROFILE_SCOPE();
+
+	masks.words_per_mask = math::ceildiv(block_size.y, int(BlockyColumnMasks::WORD_SIZE));
+	const unsigned int column_count = block_size.x * block_size.z;
+	masks.words.clear();
+	masks.words.resize(column_count * BlockyColumnMasks::MASK_COUNT * masks.words_per_mask, 0);
+
+	masks.inner_words.clear();
+	masks.inner_words.resize(masks.words_per_mask, 0);
+	for (int y = VoxelMesherBlocky::PADDING; y < block_size.y - VoxelMesherBlocky::PADDING; ++y) {
+		masks.inner_words[y / BlockyColumnMasks::WORD_SIZE] |= uint64_t(1) << (y % BlockyColumnMasks::WORD_SIZE);
+	}
+
+	const int row_size = block_size.y;
+	const int deck_size = block_size.x * row_size;
+
+	for (int z = 0; z < block_size.z; ++z) {
+		for (int x = 0; x < block_size.x; ++x) {
+			const unsigned int column = x + z * block_size.x;
+			const int column_index = x * row_size + z * deck_size;
+
+			for (int y = 0; y < block_size.y; ++y) {
+				const uint32_t voxel_id = type_buffer[column_index + y];
+				if (voxel_id == VoxelBlockyModel::AIR_ID || !library.has_model(voxel_id)) {
+					continue;
+				}
+				const VoxelBlockyModel::BakedData &voxel = library.models[voxel_id];
+				const VoxelBlockyModel::BakedData::Model &model = voxel.model;
+
+				const unsigned int word_index = y / BlockyColumnMasks::WORD_SIZE;
+				const uint64_t bit = uint64_t(1) << (y % BlockyColumnMasks::WORD_SIZE);
+
+				masks.get_word(column, BlockyColumnMasks::MASK_PRESENT, word_index) |= bit;
+
+				for (unsigned int surface_index = 0; surface_index < model.surface_count; ++surface_index) {
+					if (model.surfaces[surface_index].positions.size() > 0) {
+						masks.get_word(column, BlockyColumnMasks::MASK_INSIDE, word_index) |= bit;
+						break;
+					}
+				}
+
+				// Same conditions as `is_face_visible` returning false for any side touching this one
+				if (!voxel.empty && voxel.culls_neighbors && voxel.transparency_index == 0) {
+					for (unsigned int side = 0; side < Cube::SIDE_COUNT; ++side) {
+						if ((model.full_sides_mask & (1 << side)) != 0) {
+							masks.get_word(column, BlockyColumnMasks::MASK_OCCLUDING_SIDES + side, word_index) |= bit;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Gets which sides of voxels in a word of a column are not hidden by a full side of an opaque neighbor. They still
+// have to be checked with `is_face_visible`, but most sides of dense blocks are excluded with a few bitwise
+// operations. Returns voxels that need to be visited.
+inline uint64_t get_candidate_sides(
+		const BlockyColumnMasks &masks,
+		const unsigned int column,
+		const unsigned int word_index,
+		const FixedArray<int, Cube::SIDE_COUNT> &side_neighbor_column_offsets,
+		FixedArray<uint64_t, Cube::SIDE_COUNT> &out_sides
+) {
+	const uint64_t present = masks.get_word(column, BlockyColumnMasks::MASK_PRESENT, word_index) &
+			masks.inner_words[word_index];
+	if (present == 0) {
+		return 0;
+	}
+
+	uint64_t visit = masks.get_word(column, BlockyColumnMasks::MASK_INSIDE, word_index);
+
+	// To carry bits over to the next word
+	const unsigned int carry_shift = BlockyColumnMasks::WORD_SIZE - 1;
+
+	for (unsigned int side = 0; side < Cube::SIDE_COUNT; ++side) {
+		const unsigned int neighbor_mask_id = BlockyColumnMasks::MASK_OCCLUDING_SIDES + g_opposite_side[side];
+		uint64_t occluded;
+
+		if (side == Cube::SIDE_TOP) {
+			// Neighbors are one voxel above
+			occluded = masks.get_word(column, neighbor_mask_id, word_index) >> 1;
+			if (word_index + 1 < masks.words_per_mask) {
+				occluded |= masks.get_word(column, neighbor_mask_id, word_index + 1) << carry_shift;
+			}
+
+		} else if (side == Cube::SIDE_BOTTOM) {
+			// Neighbors are one voxel below
+			occluded = masks.get_word(column, neighbor_mask_id, word_index) << 1;
+			if (word_index > 0) {
+				occluded |= masks.get_word(column, neighbor_mask_id, word_index - 1) >> carry_shift;
+			}
+
+		} else {
+			occluded = masks.get_word(column + side_neighbor_column_offsets[side], neighbor_mask_id, word_index);
+		}
+
+		out_sides[side] = present & ~occluded;
+		visit |= out_sides[side];
+	}
+
+	return visit & present;
+}
+
+// For each side, which visible faces of the block can be merged into larger quads.
+// Cells are indexed in unpadded XYZ order, and contain `make_greedy_key()`, or 0 if there is no mergeable face.
+StdVector<uint32_t> &get_tls_greedy_masks() {
+	static thread_local StdVector<uint32_t> tls_greedy_masks;
+	return tls_greedy_masks;
+}
+
+// Same as greedy masks, for sides merged only in the collision surface. Cells are 1 if there is a face, or 0.
+StdVector<uint32_t> &get_tls_collision_greedy_masks() {
+	static thread_local StdVector<uint32_t> tls_collision_greedy_masks;
+	return tls_collision_greedy_masks;
+}
+
+// Tells if collision geometry of a side covers it entirely, so it can be merged with neighbors regardless of how the
+// side looks
+inline bool is_side_collision_full(const VoxelBlockyModel::BakedData::Model &model, const unsigned int side) {
+	if ((model.full_sides_mask & (1 << side)) == 0) {
+		return false;
+	}
+	for (unsigned int surface_index = 0; surface_index < model.surface_count; ++surface_index) {
+		const VoxelBlockyModel::BakedData::Surface &surface = model.surfaces[surface_index];
+		if (!surface.collision_enabled && surface.sides[side].indices.size() > 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Faces can only be merged if they come from the same model and have the same occlusion on all corners
+inline uint32_t make_greedy_key(uint32_t voxel_id, uint32_t ao) {
+	return ((ao << 16) | voxel_id) + 1;
+}
+
+void append_greedy_quad(
+		StdVector<VoxelMesherBlocky::Arrays> &out_arrays_per_material,
+		StdVector<int> &index_offsets,
+		VoxelMesher::Output::CollisionSurface *collision_surface,
+		int &collision_surface_index_offset,
+		const VoxelBlockyLibraryBase::BakedData &library,
+		const uint32_t key,
+		const unsigned int side,
+		const Vector3i origin,
+		const unsigned int u_axis,
+		const unsigned int v_axis,
+		const int size_u,
+		const int size_v,
+		bool bake_occlusion,
+		float baked_occlusion_darkness
+) {
+	const uint32_t voxel_id = (key - 1) & 0xffff;
+	const uint32_t ao = (key - 1) >> 16;
+
+	const VoxelBlockyModel::BakedData &voxel = library.models[voxel_id];
+	// Tileable models only have one surface made of one quad per side
+	const VoxelBlockyModel::BakedData::Surface &surface = voxel.model.surfaces[0];
+	const VoxelBlockyModel::BakedData::SideSurface &side_surface = surface.sides[side];
+	ZN_ASSERT_RETURN(side_surface.positions.size() == 4 && side_surface.uvs.size() == 4);
+
+	VoxelMesherBlocky::Arrays &arrays = out_arrays_per_material[surface.material_id];
+	ZN_ASSERT(surface.material_id >= 0 && surface.material_id < index_offsets.size());
+	int &index_offset = index_offsets[surface.material_id];
+
+	// Find how UVs change along the quad, so they can be extended to repeat the texture. They are snapped to whole
+	// units, which also removes the small margin models have to avoid bleeding with neighbor tiles of atlases.
+	Vector2f uv_origin;
+	Vector2f uv_du;
+	Vector2f uv_dv;
+	for (unsigned int i = 0; i < 4; ++i) {
+		const Vector3f p = side_surface.positions[i];
+		const Vector2f uv = side_surface.uvs[i];
+		const bool at_u = p[u_axis] > 0.5f;
+		const bool at_v = p[v_axis] > 0.5f;
+		if (!at_u && !at_v) {
+			uv_origin = uv;
+		}
+	}
+	for (unsigned int i = 0; i < 4; ++i) {
+		const Vector3f p = side_surface.positions[i];
+		const Vector2f uv = side_surface.uvs[i];
+		const bool at_u = p[u_axis] > 0.5f;
+		const bool at_v = p[v_axis] > 0.5f;
+		if (at_u && !at_v) {
+			uv_du = uv - uv_origin;
+		} else if (!at_u && at_v) {
+			uv_dv = uv - uv_origin;
+		}
+	}
+	uv_origin = math::round(uv_origin);
+	uv_du = math::round(uv_du);
+	uv_dv = math::round(uv_dv);
+
+	const Vector3f pos = to_vec3f(origin);
+	const Vector3f normal = to_vec3f(Cube::g_side_normals[side]);
+	Color color = voxel.color;
+	if (bake_occlusion) {
+		const float gs = 1.f - baked_occlusion_darkness * static_cast<float>(ao);
+		color = Color(gs, gs, gs) * voxel.color;
+	}
+
+	FixedArray<Vector3f, 4> positions;
+	for (unsigned int i = 0; i < 4; ++i) {
+		Vector3f p = side_surface.positions[i];
+		const bool at_u = p[u_axis] > 0.5f;
+		const bool at_v = p[v_axis] > 0.5f;
+		p[u_axis] *= size_u;
+		p[v_axis] *= size_v;
+		positions[i] = p + pos;
+
+		arrays.positions.push_back(positions[i]);
+		arrays.normals.push_back(normal);
+		arrays.colors.push_back(color);
+		arrays.uvs.push_back(
+				uv_origin + uv_du * static_cast<float>(at_u ? size_u : 0) +
+				uv_dv * static_cast<float>(at_v ? size_v : 0)
+		);
+	}
+
+	const StdVector<float> &side_tangents = side_surface.tangents;
+	if (side_tangents.size() > 0) {
+		const unsigned int append_index = arrays.tangents.size();
+		arrays.tangents.resize(arrays.tangents.size() + side_tangents.size());
+		memcpy(arrays.tangents.data() + append_index, side_tangents.data(), side_tangents.size() * sizeof(float));
+	}
+
+	const StdVector<int> &side_indices = side_surface.indices;
+	for (const int i : side_indices) {
+		arrays.indices.push_back(index_offset + i);
+	}
+	index_offset += 4;
+
+	if (collision_surface != nullptr && surface.collision_enabled) {
+		for (const Vector3f &p : positions) {
+			collision_surface->positions.push_back(p);
+		}
+		for (const int i : side_indices) {
+			collision_surface->indices.push_back(collision_surface_index_offset + i);
+		}
+		collision_surface_index_offset += 4;
+	}
+}
+
+// Merges faces recorded in greedy masks into the largest rectangles it can find, clearing them from the masks.
+// See https://0fps.net/2012/06/30/meshing-in-a-minecraft-game/
+template <typename FRectangle>
+void find_greedy_rectangles(Span<uint32_t> masks, const Vector3i size, FRectangle rectangle_func) {
+	const unsigned int volume = Vector3iUtil::get_volume_u64(size);
+	ZN_ASSERT_RETURN(masks.size() == volume * Cube::SIDE_COUNT);
+
+	for (unsigned int side = 0; side < Cube::SIDE_COUNT; ++side) {
+		Span<uint32_t> mask = masks.sub(side * volume, volume);
+
+		const Vector3i normal = Cube::g_side_normals[side];
+		// Axis perpendicular to faces of this side, and axes along which they are merged
+		const unsigned int w_axis =
+				normal.x != 0 ? Vector3i::AXIS_X : (normal.y != 0 ? Vector3i::AXIS_Y : Vector3i::AXIS_Z);
+		const unsigned int u_axis = (w_axis + 1) % 3;
+		const unsigned int v_axis = (w_axis + 2) % 3;
+
+		FixedArray<int, 3> strides;
+		strides[Vector3i::AXIS_X] = 1;
+		strides[Vector3i::AXIS_Y] = size.x;
+		strides[Vector3i::AXIS_Z] = size.x * size.y;
+		const int u_stride = strides[u_axis];
+		const int v_stride = strides[v_axis];
+
+		Vector3i pos;
+		for (pos[w_axis] = 0; pos[w_axis] < size[w_axis]; ++pos[w_axis]) {
+			for (pos[v_axis] = 0; pos[v_axis] < size[v_axis]; ++pos[v_axis]) {
+				for (pos[u_axis] = 0; pos[u_axis] < size[u_axis]; ++pos[u_axis]) {
+					const unsigned int loc = pos.x + size.x * (pos.y + size.y * pos.z);
+					const uint32_t key = mask[loc];
+					if (key == 0) {
+						continue;
+					}
+
+					// Grow along U as long as faces are the same
+					int size_u = 1;
+					while (pos[u_axis] + size_u < size[u_axis] && mask[loc + size_u * u_stride] == key) {
+						++size_u;
+					}
+
+					// Grow along V as long as whole rows are the same
+					int size_v = 1;
+					while (pos[v_axis] + size_v < size[v_axis]) {
+						const unsigned int row_loc = loc + size_v * v_stride;
+						bool same_row = true;
+						for (int i = 0; i < size_u; ++i) {
+							if (mask[row_loc + i * u_stride] != key) {
+								same_row = false;
+								break;
+							}
+						}
+						if (!same_row) {
+							break;
+						}
+						++size_v;
+					}
+
+					for (int j = 0; j < size_v; ++j) {
+						for (int i = 0; i < size_u; ++i) {
+							mask[loc + i * u_stride + j * v_stride] = 0;
+						}
+					}
+
+					rectangle_func(key, side, pos, u_axis, v_axis, size_u, size_v);
+				}
+			}
+		}
+	}
+}
+
+void append_greedy_quads(
+		StdVector<VoxelMesherBlocky::Arrays> &out_arrays_per_material,
+		StdVector<int> &index_offsets,
+		VoxelMesher::Output::CollisionSurface *collision_surface,
+		int &collision_surface_index_offset,
+		Span<uint32_t> masks,
+		const Vector3i size,
+		const VoxelBlockyLibraryBase::BakedData &library,
+		bool bake_occlusion,
+		float baked_occlusion_darkness
+) {
+	ZN_PROFILE_SCOPE();
+
+	find_greedy_rectangles(
+			masks,
+			size,
+			[&](
+					const uint32_t key,
+					const unsigned int side,
+					const Vector3i pos,
+					const unsigned int u_axis,
+					const unsigned int v_axis,
+					const int size_u,
+					const int size_v
+			) {
+				append_greedy_quad(
+						out_arrays_per_material,
+						index_offsets,
+						collision_surface,
+						collision_surface_index_offset,
+						library,
+						key,
+						side,
+						pos,
+						u_axis,
+						v_axis,
+						size_u,
+						size_v,
+						bake_occlusion,
+						baked_occlusion_darkness
+				);
+			}
+	);
+}
+
+// Collision doesn't need textures, materials or occlusion, so full sides can be merged more than visual ones
+void append_greedy_collision_quads(
+		VoxelMesher::Output::CollisionSurface &collision_surface,
+		int &collision_surface_index_offset,
+		Span<uint32_t> masks,
+		const Vector3i size
+) {
+	ZN_PROFILE_SCOPE();
+
+	find_greedy_rectangles(
+			masks,
+			size,
+			[&collision_surface, &collision_surface_index_offset](
+					const uint32_t /*key*/,
+					const unsigned int side,
+					const Vector3i pos,
+					const unsigned int u_axis,
+					const unsigned int v_axis,
+					const int size_u,
+					const int size_v
+			) {
+				const Vector3f origin = to_vec3f(pos);
+				for (unsigned int i = 0; i < 4; ++i) {
+					Vector3f p = Cube::g_corner_position[Cube::g_side_corners[side][i]];
+					p[u_axis] *= size_u;
+					p[v_axis] *= size_v;
+					collision_surface.positions.push_back(p + origin);
+				}
+				for (const int i : Cube::g_side_quad_triangles[side]) {
+					collision_surface.indices.push_back(collision_surface_index_offset + i);
+				}
+				collision_surface_index_offset += 4;
+			}
+	);
+}
+
+} // namespace
+
+// Appends a side of a model having `quad_sides_only`. Vertex and index counts are known, and occlusion weights are
+// precomputed.
+template <bool TBakeOcclusion>
+inline void append_quad_side(
+		VoxelMesherBlocky::Arrays &arrays,
+		int &index_offset,
+		VoxelMesher::Output::CollisionSurface *collision_surface,
+		int &collision_surface_index_offset,
+		const VoxelBlockyModel::BakedData &voxel,
+		const unsigned int side,
+		const Vector3f pos,
+		const int *shaded_corner,
+		const float baked_occlusion_darkness,
+		const bool collision_merged
+) {
+	static constexpr unsigned int vertex_count = 4;
+	static constexpr unsigned int index_count = 6;
+
+	const VoxelBlockyModel::BakedData::Surface &surface = voxel.model.surfaces[0];
+	const VoxelBlockyModel::BakedData::SideSurface &side_surface = surface.sides[side];
+
+	const unsigned int vertex_begin = arrays.positions.size();
+	arrays.positions.resize(vertex_begin + vertex_count);
+	arrays.normals.resize(vertex_begin + vertex_count);
+	arrays.uvs.resize(vertex_begin + vertex_count);
+	arrays.colors.resize(vertex_begin + vertex_count);
+
+	Vector3f *positions = arrays.positions.data() + vertex_begin;
+	Vector3f *normals = arrays.normals.data() + vertex_begin;
+	Vector2f *uvs = arrays.uvs.data() + vertex_begin;
+	Color *colors = arrays.colors.data() + vertex_begin;
+
+	const Vector3f normal = to_vec3f(Cube::g_side_normals[side]);
+
+	for (unsigned int i = 0; i < vertex_count; ++i) {
+		positions[i] = side_surface.positions[i] + pos;
+		normals[i] = normal;
+		uvs[i] = side_surface.uvs[i];
+	}
+
+	if (TBakeOcclusion) {
+		FixedArray<float, 4> corner_shades;
+		for (unsigned int j = 0; j < 4; ++j) {
+			corner_shades[j] =
+					baked_occlusion_darkness * static_cast<float>(shaded_corner[Cube::g_side_corners[side][j]]);
+		}
+		const FixedArray<FixedArray<float, 4>, 4> &weights = voxel.model.quad_side_occlusion_weights[side];
+		for (unsigned int i = 0; i < vertex_count; ++i) {
+			float shade = 0;
+			for (unsigned int j = 0; j < 4; ++j) {
+				const float s = corner_shades[j] * weights[i][j];
+				if (s > shade) {
+					shade = s;
+				}
+			}
+			const float gs = 1.0 - shade;
+			colors[i] = Color(gs, gs, gs) * voxel.color;
+		}
+	} else {
+		for (unsigned int i = 0; i < vertex_count; ++i) {
+			colors[i] = voxel.color;
+		}
+	}
+
+	if (side_surface.tangents.size() > 0) {
+		const unsigned int append_index = arrays.tangents.size();
+		arrays.tangents.resize(append_index + vertex_count * 4);
+		memcpy(arrays.tangents.data() + append_index, side_surface.tangents.data(), vertex_count * 4 * sizeof(float));
+	}
+
+	{
+		const unsigned int append_index = arrays.indices.size();
+		arrays.indices.resize(append_index + index_count);
+		int *w = arrays.indices.data() + append_index;
+		for (unsigned int i = 0; i < index_count; ++i) {
+			w[i] = index_offset + side_surface.indices[i];
+		}
+	}
+
+	if (collision_surface != nullptr && surface.collision_enabled && !collision_merged) {
+		StdVector<Vector3f> &dst_positions = collision_surface->positions;
+		StdVector<int> &dst_indices = collision_surface->indices;
+
+		const unsigned int positions_begin = dst_positions.size();
+		dst_positions.resize(positions_begin + vertex_count);
+		for (unsigned int i = 0; i < vertex_count; ++i) {
+			dst_positions[positions_begin + i] = positions[i];
+		}
+
+		const unsigned int indices_begin = dst_indices.size();
+		dst_indices.resize(indices_begin + index_count);
+		for (unsigned int i = 0; i < index_count; ++i) {
+			dst_indices[indices_begin + i] = collision_surface_index_offset + side_surface.indices[i];
+		}
+
+		collision_surface_index_offset += vertex_count;
+	}
+
+	index_offset += vertex_count;
+}
+
+template <typename Type_T, bool TCubesOnly, bool TBakeOcclusion>
 void generate_blocky_mesh( //
 		StdVector<VoxelMesherBlocky::Arrays> &out_arrays_per_material, //
 		VoxelMesher::Output::CollisionSurface *collision_surface, //
 		const Span<const Type_T> type_buffer, //
 		const Vector3i block_size, //
 		const VoxelBlockyLibraryBase::BakedData &library, //
-		bool bake_occlusion, //
-		float baked_occlusion_darkness //
+		float baked_occlusion_darkness, //
+		bool greedy_meshing, //
+		bool collision_greedy_meshing //
 ) {
 	// TODO Optimization: not sure if this mandates a template function. There is so much more happening in this
 	// function other than reading voxels, although reading is on the hottest path. It needs to be profiled. If
 	// changing makes no difference, we could use a function pointer or switch inside instead to reduce executable size.
+	//
+	// `TCubesOnly` can be true if the library has `cubes_only`, then sides are appended with fixed-size copies and
+	// there is no inner geometry to check. Occlusion is a template parameter so cubes don't branch on it per vertex.
 
 	ERR_FAIL_COND(
 			block_size.x < static_cast<int>(2 * VoxelMesherBlocky::PADDING) ||
@@ -97,6 +653,22 @@ void generate_blocky_mesh( //
 
 	int collision_surface_index_offset = 0;
 
+	const Vector3i inner_size = max - min;
+	const unsigned int inner_volume = Vector3iUtil::get_volume_u64(inner_size);
+	StdVector<uint32_t> &greedy_masks = get_tls_greedy_masks();
+	if (greedy_meshing) {
+		greedy_masks.clear();
+		greedy_masks.resize(inner_volume * Cube::SIDE_COUNT, 0);
+	}
+	StdVector<uint32_t> &collision_greedy_masks = get_tls_collision_greedy_masks();
+	if (collision_surface == nullptr) {
+		collision_greedy_meshing = false;
+	}
+	if (collision_greedy_meshing) {
+		collision_greedy_masks.clear();
+		collision_greedy_masks.resize(inner_volume * Cube::SIDE_COUNT, 0);
+	}
+
 	FixedArray<int, Cube::SIDE_COUNT> side_neighbor_lut;
 	side_neighbor_lut[Cube::SIDE_LEFT] = row_size;
 	side_neighbor_lut[Cube::SIDE_RIGHT] = -row_size;
@@ -150,278 +722,414 @@ void generate_blocky_mesh( //
 	corner_neighbor_lut[Cube::CORNER_TOP_FRONT_LEFT] = side_neighbor_lut[Cube::SIDE_TOP] +
 			side_neighbor_lut[Cube::SIDE_FRONT] + side_neighbor_lut[Cube::SIDE_LEFT];
 
+	// Offsets to neighbor columns of each side, in column masks
+	FixedArray<int, Cube::SIDE_COUNT> side_neighbor_column_offsets;
+	for (unsigned int side = 0; side < Cube::SIDE_COUNT; ++side) {
+		// Zero for top and bottom sides, they are in the same column
+		side_neighbor_column_offsets[side] = side_neighbor_lut[side] / row_size;
+	}
+
+	BlockyColumnMasks &column_masks = get_tls_column_masks();
+	compute_column_masks(column_masks, type_buffer, block_size, library);
+
 	// uint64_t time_prep = Time::get_singleton()->get_ticks_usec() - time_before;
 	// time_before = Time::get_singleton()->get_ticks_usec();
 
 	for (unsigned int z = min.z; z < (unsigned int)max.z; ++z) {
 		for (unsigned int x = min.x; x < (unsigned int)max.x; ++x) {
-			for (unsigned int y = min.y; y < (unsigned int)max.y; ++y) {
-				// min and max are chosen such that you can visit 1 neighbor away from the current voxel without size
-				// check
+			const unsigned int column = x + z * block_size.x;
 
-				const int voxel_index = y + x * row_size + z * deck_size;
-				const int voxel_id = type_buffer[voxel_index];
+			for (unsigned int word_index = 0; word_index < column_masks.words_per_mask; ++word_index) {
+				FixedArray<uint64_t, Cube::SIDE_COUNT> candidate_sides;
+				uint64_t voxels_to_visit = get_candidate_sides(
+						column_masks, column, word_index, side_neighbor_column_offsets, candidate_sides
+				);
 
-				if (voxel_id == VoxelBlockyModel::AIR_ID || !library.has_model(voxel_id)) {
-					continue;
-				}
+				while (voxels_to_visit != 0) {
+					const unsigned int bit_index = get_first_bit(voxels_to_visit);
+					const uint64_t bit = uint64_t(1) << bit_index;
+					voxels_to_visit &= ~bit;
+					const unsigned int y = word_index * BlockyColumnMasks::WORD_SIZE + bit_index;
 
-				const VoxelBlockyModel::BakedData &voxel = library.models[voxel_id];
-				const VoxelBlockyModel::BakedData::Model &model = voxel.model;
+					// min and max are chosen such that you can visit 1 neighbor away from the current voxel without
+					// size check
 
-				// Hybrid approach: extract cube faces and decimate those that aren't visible,
-				// and still allow voxels to have geometry that is not a cube.
+					const int voxel_index = y + x * row_size + z * deck_size;
+					const int voxel_id = type_buffer[voxel_index];
 
-				// Sides
-				for (unsigned int side = 0; side < Cube::SIDE_COUNT; ++side) {
-					if ((model.empty_sides_mask & (1 << side)) != 0) {
-						// This side is empty
-						continue;
-					}
+					const VoxelBlockyModel::BakedData &voxel = library.models[voxel_id];
+					const VoxelBlockyModel::BakedData::Model &model = voxel.model;
 
-					const uint32_t neighbor_voxel_id = type_buffer[voxel_index + side_neighbor_lut[side]];
+					// Hybrid approach: extract cube faces and decimate those that aren't visible,
+					// and still allow voxels to have geometry that is not a cube.
 
-					if (!is_face_visible(library, voxel, neighbor_voxel_id, side)) {
-						continue;
-					}
+					// Sides
+					for (unsigned int side = 0; side < Cube::SIDE_COUNT; ++side) {
+						if ((model.empty_sides_mask & (1 << side)) != 0) {
+							// This side is empty
+							continue;
+						}
 
-					// The face is visible
-
-					int shaded_corner[8] = { 0 };
-
-					if (bake_occlusion) {
-						// Combinatory solution for
-						// https://0fps.net/2013/07/03/ambient-occlusion-for-minecraft-like-worlds/ (inverted)
-						//	function vertexAO(side1, side2, corner) {
-						//	  if(side1 && side2) {
-						//		return 0
-						//	  }
-						//	  return 3 - (side1 + side2 + corner)
-						//	}
-
-						for (unsigned int j = 0; j < 4; ++j) {
-							const unsigned int edge = Cube::g_side_edges[side][j];
-							const int edge_neighbor_id = type_buffer[voxel_index + edge_neighbor_lut[edge]];
-							if (contributes_to_ao(library, edge_neighbor_id)) {
-								++shaded_corner[Cube::g_edge_corners[edge][0]];
-								++shaded_corner[Cube::g_edge_corners[edge][1]];
-							}
+						if ((candidate_sides[side] & bit) == 0) {
+							// Hidden by a full side of an opaque neighbor
+							continue;
 						}
-						for (unsigned int j = 0; j < 4; ++j) {
-							const unsigned int corner = Cube::g_side_corners[side][j];
-							if (shaded_corner[corner] == 2) {
-								shaded_corner[corner] = 3;
-							} else {
-								const int corner_neigbor_id = type_buffer[voxel_index + corner_neighbor_lut[corner]];
-								if (contributes_to_ao(library, corner_neigbor_id)) {
-									++shaded_corner[corner];
+
+						const uint32_t neighbor_voxel_id = type_buffer[voxel_index + side_neighbor_lut[side]];
+
+						if (!is_face_visible(library, voxel, neighbor_voxel_id, side)) {
+							continue;
+						}
+
+						// The face is visible
+
+						// Index of the face in greedy masks
+						const unsigned int greedy_loc = side * inner_volume + (x - min.x) +
+								inner_size.x * ((y - min.y) + inner_size.y * (z - min.z));
+
+						bool collision_merged = false;
+						if (collision_greedy_meshing && is_side_collision_full(model, side)) {
+							// Emitted later, merged with neighbor faces
+							collision_greedy_masks[greedy_loc] = 1;
+							collision_merged = true;
+						}
+
+						int shaded_corner[8] = { 0 };
+
+						if (TBakeOcclusion) {
+							// Combinatory solution for
+							// https://0fps.net/2013/07/03/ambient-occlusion-for-minecraft-like-worlds/ (inverted)
+							//	function vertexAO(side1, side2, corner) {
+							//	  if(side1 && side2) {
+							//		return 0
+							//	  }
+							//	  return 3 - (side1 + side2 + corner)
+							//	}
+
+							for (unsigned int j = 0; j < 4; ++j) {
+								const unsigned int edge = Cube::g_side_edges[side][j];
+								const int edge_neighbor_id = type_buffer[voxel_index + edge_neighbor_lut[edge]];
+								if (contributes_to_ao(library, edge_neighbor_id)) {
+									++shaded_corner[Cube::g_edge_corners[edge][0]];
+									++shaded_corner[Cube::g_edge_corners[edge][1]];
+								}
+							}
+							for (unsigned int j = 0; j < 4; ++j) {
+								const unsigned int corner = Cube::g_side_corners[side][j];
+								if (shaded_corner[corner] == 2) {
+									shaded_corner[corner] = 3;
+								} else {
+									const int corner_neigbor_id =
+											type_buffer[voxel_index + corner_neighbor_lut[corner]];
+									if (contributes_to_ao(library, corner_neigbor_id)) {
+										++shaded_corner[corner];
+									}
 								}
 							}
 						}
-					}
 
-					// Subtracting 1 because the data is padded
-					const Vector3f pos(x - 1, y - 1, z - 1);
+						if (greedy_meshing && model.tileable_sides) {
+							const int ao = shaded_corner[Cube::g_side_corners[side][0]];
+							if (shaded_corner[Cube::g_side_corners[side][1]] == ao &&
+								shaded_corner[Cube::g_side_corners[side][2]] == ao &&
+								shaded_corner[Cube::g_side_corners[side][3]] == ao) {
+								// Emitted later, merged with similar neighbor faces
+								greedy_masks[greedy_loc] = make_greedy_key(voxel_id, ao);
+								continue;
+							}
+						}
 
-					for (unsigned int surface_index = 0; surface_index < model.surface_count; ++surface_index) {
-						const VoxelBlockyModel::BakedData::Surface &surface = model.surfaces[surface_index];
+						// Subtracting 1 because the data is padded
+						const Vector3f pos(x - 1, y - 1, z - 1);
+
+						if (TCubesOnly) {
+							const uint32_t material_id = model.surfaces[0].material_id;
+							append_quad_side<TBakeOcclusion>(
+									out_arrays_per_material[material_id],
+									index_offsets[material_id],
+									collision_surface,
+									collision_surface_index_offset,
+									voxel,
+									side,
+									pos,
+									shaded_corner,
+									baked_occlusion_darkness,
+									collision_merged
+							);
+							continue;
+						}
 
-						VoxelMesherBlocky::Arrays &arrays = out_arrays_per_material[surface.material_id];
+						for (unsigned int surface_index = 0; surface_index < model.surface_count; ++surface_index) {
+							const VoxelBlockyModel::BakedData::Surface &surface = model.surfaces[surface_index];
 
-						ZN_ASSERT(surface.material_id >= 0 && surface.material_id < index_offsets.size());
-						int &index_offset = index_offsets[surface.material_id];
-
-						const VoxelBlockyModel::BakedData::SideSurface &side_surface = surface.sides[side];
+							VoxelMesherBlocky::Arrays &arrays = out_arrays_per_material[surface.material_id];
 
-						const StdVector<Vector3f> &side_positions = side_surface.positions;
-						const unsigned int vertex_count = side_surface.positions.size();
+							ZN_ASSERT(surface.material_id >= 0 && surface.material_id < index_offsets.size());
+							int &index_offset = index_offsets[surface.material_id];
 
-						const StdVector<Vector2f> &side_uvs = side_surface.uvs;
-						const StdVector<float> &side_tangents = side_surface.tangents;
+							const VoxelBlockyModel::BakedData::SideSurface &side_surface = surface.sides[side];
 
-						// Append vertices of the faces in one go, don't use push_back
+							const StdVector<Vector3f> &side_positions = side_surface.positions;
+							const unsigned int vertex_count = side_surface.positions.size();
 
-						{
-							const int append_index = arrays.positions.size();
-							arrays.positions.resize(arrays.positions.size() + vertex_count);
-							Vector3f *w = arrays.positions.data() + append_index;
-							for (unsigned int i = 0; i < vertex_count; ++i) {
-								w[i] = side_positions[i] + pos;
-							}
-						}
+							const StdVector<Vector2f> &side_uvs = side_surface.uvs;
+							const StdVector<float> &side_tangents = side_surface.tangents;
 
-						{
-							const int append_index = arrays.uvs.size();
-							arrays.uvs.resize(arrays.uvs.size() + vertex_count);
-							memcpy(arrays.uvs.data() + append_index, side_uvs.data(), vertex_count * sizeof(Vector2f));
-						}
+							// Append vertices of the faces in one go, don't use push_back
 
-						if (side_tangents.size() > 0) {
-							const int append_index = arrays.tangents.size();
-							arrays.tangents.resize(arrays.tangents.size() + vertex_count * 4);
-							memcpy(arrays.tangents.data() + append_index,
-								   side_tangents.data(),
-								   (vertex_count * 4) * sizeof(float));
-						}
+							{
+								const int append_index = arrays.positions.size();
+								arrays.positions.resize(arrays.positions.size() + vertex_count);
+								Vector3f *w = arrays.positions.data() + append_index;
+								for (unsigned int i = 0; i < vertex_count; ++i) {
+									w[i] = side_positions[i] + pos;
+								}
+							}
 
-						{
-							const int append_index = arrays.normals.size();
-							arrays.normals.resize(arrays.normals.size() + vertex_count);
-							Vector3f *w = arrays.normals.data() + append_index;
-							for (unsigned int i = 0; i < vertex_count; ++i) {
-								w[i] = to_vec3f(Cube::g_side_normals[side]);
+							{
+								const int append_index = arrays.uvs.size();
+								arrays.uvs.resize(arrays.uvs.size() + vertex_count);
+								memcpy(arrays.uvs.data() + append_index,
+									   side_uvs.data(),
+									   vertex_count * sizeof(Vector2f));
 							}
-						}
 
-						{
-							const int append_index = arrays.colors.size();
-							arrays.colors.resize(arrays.colors.size() + vertex_count);
-							Color *w = arrays.colors.data() + append_index;
-							const Color modulate_color = voxel.color;
+							if (side_tangents.size() > 0) {
+								const int append_index = arrays.tangents.size();
+								arrays.tangents.resize(arrays.tangents.size() + vertex_count * 4);
+								memcpy(arrays.tangents.data() + append_index,
+									   side_tangents.data(),
+									   (vertex_count * 4) * sizeof(float));
+							}
 
-							if (bake_occlusion) {
+							{
+								const int append_index = arrays.normals.size();
+								arrays.normals.resize(arrays.normals.size() + vertex_count);
+								Vector3f *w = arrays.normals.data() + append_index;
 								for (unsigned int i = 0; i < vertex_count; ++i) {
-									const Vector3f vertex_pos = side_positions[i];
-
-									// General purpose occlusion colouring.
-									// TODO Optimize for cubes
-									// TODO Fix occlusion inconsistency caused by triangles orientation? Not sure if
-									// worth it
-									float shade = 0;
-									for (unsigned int j = 0; j < 4; ++j) {
-										unsigned int corner = Cube::g_side_corners[side][j];
-										if (shaded_corner[corner]) {
-											float s = baked_occlusion_darkness *
-													static_cast<float>(shaded_corner[corner]);
-											// float k = 1.f - Cube::g_corner_position[corner].distance_to(v);
-											float k = 1.f -
-													math::distance_squared(Cube::g_corner_position[corner], vertex_pos);
-											if (k < 0.0) {
-												k = 0.0;
-											}
-											s *= k;
-											if (s > shade) {
-												shade = s;
+									w[i] = to_vec3f(Cube::g_side_normals[side]);
+								}
+							}
+
+							{
+								const int append_index = arrays.colors.size();
+								arrays.colors.resize(arrays.colors.size() + vertex_count);
+								Color *w = arrays.colors.data() + append_index;
+								const Color modulate_color = voxel.color;
+
+								if (TBakeOcclusion) {
+									for (unsigned int i = 0; i < vertex_count; ++i) {
+										const Vector3f vertex_pos = side_positions[i];
+
+										// General purpose occlusion colouring. Models with only quad sides use
+										// weights precomputed at bake time instead, see `append_quad_side`.
+										// TODO Fix occlusion inconsistency caused by triangles orientation? Not sure if
+										// worth it
+										float shade = 0;
+										for (unsigned int j = 0; j < 4; ++j) {
+											unsigned int corner = Cube::g_side_corners[side][j];
+											if (shaded_corner[corner]) {
+												float s = baked_occlusion_darkness *
+														static_cast<float>(shaded_corner[corner]);
+												// float k = 1.f - Cube::g_corner_position[corner].distance_to(v);
+												float k = 1.f -
+														math::distance_squared(
+																Cube::g_corner_position[corner], vertex_pos
+														);
+												if (k < 0.0) {
+													k = 0.0;
+												}
+												s *= k;
+												if (s > shade) {
+													shade = s;
+												}
 											}
 										}
+										const float gs = 1.0 - shade;
+										w[i] = Color(gs, gs, gs) * modulate_color;
 									}
-									const float gs = 1.0 - shade;
-									w[i] = Color(gs, gs, gs) * modulate_color;
-								}
 
-							} else {
-								for (unsigned int i = 0; i < vertex_count; ++i) {
-									w[i] = modulate_color;
+								} else {
+									for (unsigned int i = 0; i < vertex_count; ++i) {
+										w[i] = modulate_color;
+									}
 								}
 							}
-						}
 
-						const StdVector<int> &side_indices = side_surface.indices;
-						const unsigned int index_count = side_indices.size();
+							const StdVector<int> &side_indices = side_surface.indices;
+							const unsigned int index_count = side_indices.size();
 
-						{
-							int i = arrays.indices.size();
-							arrays.indices.resize(arrays.indices.size() + index_count);
-							int *w = arrays.indices.data();
-							for (unsigned int j = 0; j < index_count; ++j) {
-								w[i++] = index_offset + side_indices[j];
+							{
+								int i = arrays.indices.size();
+								arrays.indices.resize(arrays.indices.size() + index_count);
+								int *w = arrays.indices.data();
+								for (unsigned int j = 0; j < index_count; ++j) {
+									w[i++] = index_offset + side_indices[j];
+								}
 							}
-						}
 
-						if (collision_surface != nullptr && surface.collision_enabled) {
-							StdVector<Vector3f> &dst_positions = collision_surface->positions;
-							StdVector<int> &dst_indices = collision_surface->indices;
+							if (collision_surface != nullptr && surface.collision_enabled && !collision_merged) {
+								StdVector<Vector3f> &dst_positions = collision_surface->positions;
+								StdVector<int> &dst_indices = collision_surface->indices;
 
-							{
-								const unsigned int append_index = dst_positions.size();
-								dst_positions.resize(dst_positions.size() + vertex_count);
-								Vector3f *w = dst_positions.data() + append_index;
-								for (unsigned int i = 0; i < vertex_count; ++i) {
-									w[i] = side_positions[i] + pos;
+								{
+									const unsigned int append_index = dst_positions.size();
+									dst_positions.resize(dst_positions.size() + vertex_count);
+									Vector3f *w = dst_positions.data() + append_index;
+									for (unsigned int i = 0; i < vertex_count; ++i) {
+										w[i] = side_positions[i] + pos;
+									}
 								}
-							}
 
-							{
-								int i = dst_indices.size();
-								dst_indices.resize(dst_indices.size() + index_count);
-								int *w = dst_indices.data();
-								for (unsigned int j = 0; j < index_count; ++j) {
-									w[i++] = collision_surface_index_offset + side_indices[j];
+								{
+									int i = dst_indices.size();
+									dst_indices.resize(dst_indices.size() + index_count);
+									int *w = dst_indices.data();
+									for (unsigned int j = 0; j < index_count; ++j) {
+										w[i++] = collision_surface_index_offset + side_indices[j];
+									}
 								}
+
+								collision_surface_index_offset += vertex_count;
 							}
 
-							collision_surface_index_offset += vertex_count;
+							index_offset += vertex_count;
 						}
-
-						index_offset += vertex_count;
 					}
-				}
 
-				// Inside
-				for (unsigned int surface_index = 0; surface_index < model.surface_count; ++surface_index) {
-					const VoxelBlockyModel::BakedData::Surface &surface = model.surfaces[surface_index];
-					if (surface.positions.size() == 0) {
+					if (TCubesOnly) {
+						// No geometry inside
 						continue;
 					}
-					// TODO Get rid of push_backs
-
-					VoxelMesherBlocky::Arrays &arrays = out_arrays_per_material[surface.material_id];
 
-					ZN_ASSERT(surface.material_id >= 0 && surface.material_id < index_offsets.size());
-					int &index_offset = index_offsets[surface.material_id];
+					// Inside
+					for (unsigned int surface_index = 0; surface_index < model.surface_count; ++surface_index) {
+						const VoxelBlockyModel::BakedData::Surface &surface = model.surfaces[surface_index];
+						if (surface.positions.size() == 0) {
+							continue;
+						}
+						// TODO Get rid of push_backs
 
-					const StdVector<Vector3f> &positions = surface.positions;
-					const unsigned int vertex_count = positions.size();
-					const Color modulate_color = voxel.color;
+						VoxelMesherBlocky::Arrays &arrays = out_arrays_per_material[surface.material_id];
 
-					const StdVector<Vector3f> &normals = surface.normals;
-					const StdVector<Vector2f> &uvs = surface.uvs;
-					const StdVector<float> &tangents = surface.tangents;
+						ZN_ASSERT(surface.material_id >= 0 && surface.material_id < index_offsets.size());
+						int &index_offset = index_offsets[surface.material_id];
 
-					const Vector3f pos(x - 1, y - 1, z - 1);
+						const StdVector<Vector3f> &positions = surface.positions;
+						const unsigned int vertex_count = positions.size();
+						const Color modulate_color = voxel.color;
 
-					if (tangents.size() > 0) {
-						const int append_index = arrays.tangents.size();
-						arrays.tangents.resize(arrays.tangents.size() + vertex_count * 4);
-						memcpy(arrays.tangents.data() + append_index,
-							   tangents.data(),
-							   (vertex_count * 4) * sizeof(float));
-					}
+						const StdVector<Vector3f> &normals = surface.normals;
+						const StdVector<Vector2f> &uvs = surface.uvs;
+						const StdVector<float> &tangents = surface.tangents;
 
-					for (unsigned int i = 0; i < vertex_count; ++i) {
-						arrays.normals.push_back(normals[i]);
-						arrays.uvs.push_back(uvs[i]);
-						arrays.positions.push_back(positions[i] + pos);
-						// TODO handle ambient occlusion on inner parts
-						arrays.colors.push_back(modulate_color);
-					}
+						const Vector3f pos(x - 1, y - 1, z - 1);
 
-					const StdVector<int> &indices = surface.indices;
-					const unsigned int index_count = indices.size();
-
-					for (unsigned int i = 0; i < index_count; ++i) {
-						arrays.indices.push_back(index_offset + indices[i]);
-					}
-
-					if (collision_surface != nullptr && surface.collision_enabled) {
-						StdVector<Vector3f> &dst_positions = collision_surface->positions;
-						StdVector<int> &dst_indices = collision_surface->indices;
+						if (tangents.size() > 0) {
+							const int append_index = arrays.tangents.size();
+							arrays.tangents.resize(arrays.tangents.size() + vertex_count * 4);
+							memcpy(arrays.tangents.data() + append_index,
+								   tangents.data(),
+								   (vertex_count * 4) * sizeof(float));
+						}
 
 						for (unsigned int i = 0; i < vertex_count; ++i) {
-							dst_positions.push_back(positions[i] + pos);
+							arrays.normals.push_back(normals[i]);
+							arrays.uvs.push_back(uvs[i]);
+							arrays.positions.push_back(positions[i] + pos);
+							// TODO handle ambient occlusion on inner parts
+							arrays.colors.push_back(modulate_color);
 						}
+
+						const StdVector<int> &indices = surface.indices;
+						const unsigned int index_count = indices.size();
+
 						for (unsigned int i = 0; i < index_count; ++i) {
-							dst_indices.push_back(collision_surface_index_offset + indices[i]);
+							arrays.indices.push_back(index_offset + indices[i]);
 						}
 
-						collision_surface_index_offset += vertex_count;
-					}
+						if (collision_surface != nullptr && surface.collision_enabled) {
+							StdVector<Vector3f> &dst_positions = collision_surface->positions;
+							StdVector<int> &dst_indices = collision_surface->indices;
+
+							for (unsigned int i = 0; i < vertex_count; ++i) {
+								dst_positions.push_back(positions[i] + pos);
+							}
+							for (unsigned int i = 0; i < index_count; ++i) {
+								dst_indices.push_back(collision_surface_index_offset + indices[i]);
+							}
 
-					index_offset += vertex_count;
+							collision_surface_index_offset += vertex_count;
+						}
+
+						index_offset += vertex_count;
+					}
 				}
 			}
 		}
 	}
+
+	if (greedy_meshing) {
+		append_greedy_quads(
+				out_arrays_per_material,
+				index_offsets,
+				// Collision of these faces is already in collision masks
+				collision_greedy_meshing ? nullptr : collision_surface,
+				collision_surface_index_offset,
+				to_span(greedy_masks),
+				inner_size,
+				library,
+				TBakeOcclusion,
+				baked_occlusion_darkness
+		);
+	}
+
+	if (collision_greedy_meshing) {
+		append_greedy_collision_quads(
+				*collision_surface, collision_surface_index_offset, to_span(collision_greedy_masks), inner_size
+		);
+	}
+}
+
+template <typename Type_T>
+void generate_blocky_mesh_dispatch( //
+		StdVector<VoxelMesherBlocky::Arrays> &out_arrays_per_material, //
+		VoxelMesher::Output::CollisionSurface *collision_surface, //
+		const Span<const Type_T> type_buffer, //
+		const Vector3i block_size, //
+		const VoxelBlockyLibraryBase::BakedData &library, //
+		bool bake_occlusion, //
+		float baked_occlusion_darkness, //
+		bool greedy_meshing, //
+		bool collision_greedy_meshing //
+) {
+#define ZN_GENERATE_BLOCKY_MESH(m_cubes_only, m_bake_occlusion)                                                        \
+	generate_blocky_mesh<Type_T, m_cubes_only, m_bake_occlusion>(                                                      \
+			out_arrays_per_material,                                                                                   \
+			collision_surface,                                                                                         \
+			type_buffer,                                                                                               \
+			block_size,                                                                                                \
+			library,                                                                                                   \
+			baked_occlusion_darkness,                                                                                  \
+			greedy_meshing,                                                                                            \
+			collision_greedy_meshing                                                                                   \
+	)
+
+	if (library.cubes_only) {
+		if (bake_occlusion) {
+			ZN_GENERATE_BLOCKY_MESH(true, true);
+		} else {
+			ZN_GENERATE_BLOCKY_MESH(true, false);
+		}
+	} else {
+		if (bake_occlusion) {
+			ZN_GENERATE_BLOCKY_MESH(false, true);
+		} else {
+			ZN_GENERATE_BLOCKY_MESH(false, false);
+		}
+	}
+
+#undef ZN_GENERATE_BLOCKY_MESH
 }
 
 struct OccluderArrays {
@@ -827,6 +1535,68 @@ void generate_shadow_occluders(
 	);
 }
 
+// Voxels through which nothing can be seen
+inline bool is_opaque_for_culling(const uint32_t model_id, const VoxelBlockyLibraryBase::BakedData &baked_data) {
+	if (model_id >= baked_data.models.size()) {
+		return false;
+	}
+	const VoxelBlockyModel::BakedData &model = baked_data.models[model_id];
+	return !model.empty && model.transparency_index == 0 && model.model.full_sides_mask == 0b111111;
+}
+
+template <typename TModelID>
+uint16_t compute_side_connectivity(
+		Span<const TModelID> id_buffer,
+		const Vector3i block_size,
+		const VoxelBlockyLibraryBase::BakedData &baked_data
+) {
+	// Data must be padded, hence the off-by-one
+	const Vector3i min = Vector3iUtil::create(VoxelMesherBlocky::PADDING);
+	const Vector3i inner_size = block_size - 2 * min;
+
+	static thread_local StdVector<uint8_t> tls_opaque_voxels;
+	StdVector<uint8_t> &opaque_voxels = tls_opaque_voxels;
+	opaque_voxels.resize(Vector3iUtil::get_volume_u64(inner_size));
+
+	unsigned int dst_index = 0;
+	Vector3i pos;
+	for (pos.z = 0; pos.z < inner_size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < inner_size.x; ++pos.x) {
+			unsigned int src_index = Vector3iUtil::get_zxy_index(pos + min, block_size);
+			for (pos.y = 0; pos.y < inner_size.y; ++pos.y) {
+				opaque_voxels[dst_index] = is_opaque_for_culling(id_buffer[src_index], baked_data);
+				++src_index;
+				++dst_index;
+			}
+		}
+	}
+
+	return occlusion_culling::compute_side_connectivity(to_span(opaque_voxels), inner_size);
+}
+
+uint16_t compute_side_connectivity(
+		const Span<const uint8_t> id_buffer_raw,
+		const VoxelBuffer::Depth depth,
+		const Vector3i block_size,
+		const VoxelBlockyLibraryBase::BakedData &baked_data
+) {
+	ZN_PROFILE_SCOPE();
+
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			return compute_side_connectivity(id_buffer_raw, block_size, baked_data);
+
+		case VoxelBuffer::DEPTH_16_BIT:
+			return compute_side_connectivity(
+					id_buffer_raw.reinterpret_cast_to<const uint16_t>(), block_size, baked_data
+			);
+
+		default:
+			ERR_PRINT("Unsupported voxel depth");
+			return occlusion_culling::SIDE_CONNECTIVITY_ALL;
+	}
+}
+
 bool is_empty(const StdVector<VoxelMesherBlocky::Arrays> &arrays_per_material) {
 	for (const VoxelMesherBlocky::Arrays &arrays : arrays_per_material) {
 		if (arrays.indices.size() > 0) {
@@ -1090,6 +1860,36 @@ bool VoxelMesherBlocky::get_occlusion_enabled() const {
 	return _parameters.bake_occlusion;
 }
 
+void VoxelMesherBlocky::set_greedy_meshing_enabled(bool enable) {
+	RWLockWrite wlock(_parameters_lock);
+	_parameters.greedy_meshing = enable;
+}
+
+bool VoxelMesherBlocky::is_greedy_meshing_enabled() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.greedy_meshing;
+}
+
+void VoxelMesherBlocky::set_collision_greedy_meshing_enabled(bool enable) {
+	RWLockWrite wlock(_parameters_lock);
+	_parameters.collision_greedy_meshing = enable;
+}
+
+bool VoxelMesherBlocky::is_collision_greedy_meshing_enabled() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.collision_greedy_meshing;
+}
+
+void VoxelMesherBlocky::set_vertex_compression_enabled(bool enable) {
+	RWLockWrite wlock(_parameters_lock);
+	_parameters.vertex_compression = enable;
+}
+
+bool VoxelMesherBlocky::is_vertex_compression_enabled() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.vertex_compression;
+}
+
 void VoxelMesherBlocky::set_shadow_occluder_side(Side side, bool enabled) {
 	RWLockWrite wlock(_parameters_lock);
 	if (enabled) {
@@ -1138,12 +1938,12 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 	}
 
 	// The technique is Culled faces.
-	// Could be improved with greedy meshing: https://0fps.net/2012/06/30/meshing-in-a-minecraft-game/
-	// However I don't feel it's worth it yet:
+	// Optionally, sides of cubes whose texture can repeat are merged with greedy meshing:
+	// https://0fps.net/2012/06/30/meshing-in-a-minecraft-game/
+	// It is not the default:
 	// - Not so much gain for organic worlds with lots of texture variations
 	// - Works well with cubes but not with any shape
 	// - Slower
-	// => Could be implemented in a separate class?
 
 	const VoxelBuffer &voxels = input.voxels;
 
@@ -1160,6 +1960,11 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 		// TODO Handle edge case of uniform block with non-cubic voxels!
 		// If the type of voxel still produces geometry in this situation (which is an absurd use case but not an
 		// error), decompress into a backing array to still allow the use of the same algorithm.
+		const uint32_t model_id = voxels.get_voxel(Vector3i(), channel);
+		RWLockRead lock(params.library->get_baked_data_rw_lock());
+		if (is_opaque_for_culling(model_id, params.library->get_baked_data())) {
+			output.side_connectivity = 0;
+		}
 		return;
 
 	} else if (voxels.get_channel_compression(channel) != VoxelBuffer::COMPRESSION_NONE) {
@@ -1182,6 +1987,11 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 	if (input.collision_hint) {
 		collision_surface = &output.collision_surface;
 	}
+	// Merged collision faces are only worth it when nothing else relies on them matching the visual mesh
+	const bool collision_greedy_meshing = params.collision_greedy_meshing || input.simplified_collision_hint;
+	// Distant blocks are seen from far away, so faces are merged regardless of settings to reduce vertex count.
+	// It doesn't change how textures repeat, since merged quads keep UVs spanning one unit per voxel.
+	const bool greedy_meshing = params.greedy_meshing || input.lod_index > 0;
 
 	unsigned int material_count = 0;
 	{
@@ -1197,14 +2007,16 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 
 		switch (channel_depth) {
 			case VoxelBuffer::DEPTH_8_BIT:
-				generate_blocky_mesh(
+				generate_blocky_mesh_dispatch(
 						arrays_per_material,
 						collision_surface,
 						raw_channel,
 						block_size,
 						library_baked_data,
 						params.bake_occlusion,
-						baked_occlusion_darkness
+						baked_occlusion_darkness,
+						greedy_meshing,
+						collision_greedy_meshing
 				);
 				if (input.lod_index > 0) {
 					append_skirts(raw_channel, block_size, arrays_per_material, library_baked_data);
@@ -1213,14 +2025,16 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 
 			case VoxelBuffer::DEPTH_16_BIT: {
 				Span<const uint16_t> model_ids = raw_channel.reinterpret_cast_to<const uint16_t>();
-				generate_blocky_mesh(
+				generate_blocky_mesh_dispatch(
 						arrays_per_material,
 						collision_surface,
 						model_ids,
 						block_size,
 						library_baked_data,
 						params.bake_occlusion,
-						baked_occlusion_darkness
+						baked_occlusion_darkness,
+						greedy_meshing,
+						collision_greedy_meshing
 				);
 				if (input.lod_index > 0) {
 					append_skirts(model_ids, block_size, arrays_per_material, library_baked_data);
@@ -1231,6 +2045,9 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 				ERR_PRINT("Unsupported voxel depth");
 				return;
 		}
+
+		output.side_connectivity =
+				compute_side_connectivity(raw_channel, channel_depth, block_size, library_baked_data);
 	}
 
 	if (input.lod_index > 0) {
@@ -1342,6 +2159,10 @@ void VoxelMesherBlocky::build(VoxelMesher::Output &output, const VoxelMesher::In
 	}
 
 	output.primitive_type = Mesh::PRIMITIVE_TRIANGLES;
+
+	if (params.vertex_compression) {
+		output.mesh_flags |= get_compressed_attributes_mesh_flag();
+	}
 }
 
 Ref<Resource> VoxelMesherBlocky::duplicate(bool p_subresources) const {
@@ -1419,6 +2240,26 @@ void VoxelMesherBlocky::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_occlusion_darkness", "value"), &VoxelMesherBlocky::set_occlusion_darkness);
 	ClassDB::bind_method(D_METHOD("get_occlusion_darkness"), &VoxelMesherBlocky::get_occlusion_darkness);
 
+	ClassDB::bind_method(
+			D_METHOD("set_greedy_meshing_enabled", "enable"), &VoxelMesherBlocky::set_greedy_meshing_enabled
+	);
+	ClassDB::bind_method(D_METHOD("is_greedy_meshing_enabled"), &VoxelMesherBlocky::is_greedy_meshing_enabled);
+
+	ClassDB::bind_method(
+			D_METHOD("set_collision_greedy_meshing_enabled", "enable"),
+			&VoxelMesherBlocky::set_collision_greedy_meshing_enabled
+	);
+	ClassDB::bind_method(
+			D_METHOD("is_collision_greedy_meshing_enabled"), &VoxelMesherBlocky::is_collision_greedy_meshing_enabled
+	);
+
+	ClassDB::bind_method(
+			D_METHOD("set_vertex_compression_enabled", "enable"), &VoxelMesherBlocky::set_vertex_compression_enabled
+	);
+	ClassDB::bind_method(
+			D_METHOD("is_vertex_compression_enabled"), &VoxelMesherBlocky::is_vertex_compression_enabled
+	);
+
 	ClassDB::bind_method(
 			D_METHOD("set_shadow_occluder_side", "side", "enabled"), &VoxelMesherBlocky::set_shadow_occluder_side
 	);
@@ -1444,6 +2285,21 @@ void VoxelMesherBlocky::_bind_methods() {
 			"set_occlusion_darkness",
 			"get_occlusion_darkness"
 	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "greedy_meshing_enabled"),
+			"set_greedy_meshing_enabled",
+			"is_greedy_meshing_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "collision_greedy_meshing_enabled"),
+			"set_collision_greedy_meshing_enabled",
+			"is_collision_greedy_meshing_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "vertex_compression_enabled"),
+			"set_vertex_compression_enabled",
+			"is_vertex_compression_enabled"
+	);
 
 	ADD_GROUP("Shadow Occluders", "shadow_occluder_");
 
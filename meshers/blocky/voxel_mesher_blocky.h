@@ -30,6 +30,15 @@ public:
 	void set_occlusion_enabled(bool enable);
 	bool get_occlusion_enabled() const;
 
+	void set_greedy_meshing_enabled(bool enable);
+	bool is_greedy_meshing_enabled() const;
+
+	void set_collision_greedy_meshing_enabled(bool enable);
+	bool is_collision_greedy_meshing_enabled() const;
+
+	void set_vertex_compression_enabled(bool enable);
+	bool is_vertex_compression_enabled() const;
+
 	enum Side {
 		SIDE_NEGATIVE_X = 0,
 		SIDE_POSITIVE_X,
@@ -57,7 +66,7 @@ public:
 	int get_used_channels_mask() const override;
 
 	bool supports_lod() const override {
-		return false;
+		return true;
 	}
 
 	Ref<Material> get_material_by_index(unsigned int index) const override;
@@ -98,6 +107,9 @@ private:
 	struct Parameters {
 		float baked_occlusion_darkness = 0.8;
 		bool bake_occlusion = true;
+		bool greedy_meshing = false;
+		bool collision_greedy_meshing = false;
+		bool vertex_compression = false;
 		uint8_t shadow_occluders_mask = 0;
 		Ref<VoxelBlockyLibraryBase> library;
 	};
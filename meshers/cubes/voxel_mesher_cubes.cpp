@@ -2,12 +2,13 @@
 #include "../../storage/voxel_buffer.h"
 #include "../../util/godot/classes/array_mesh.h"
 #include "../../util/godot/classes/base_material_3d.h"
-#include "../../util/godot/classes/geometry_2d.h"
 #include "../../util/godot/classes/image.h"
 #include "../../util/godot/classes/shader_material.h"
 #include "../../util/godot/core/packed_arrays.h"
 #include "../../util/godot/core/string.h"
+#include "../../util/hash_funcs.h"
 #include "../../util/math/conv.h"
+#include "../../util/math/rect_packing.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 
@@ -648,27 +649,84 @@ void build_voxel_mesh_as_greedy_cubes_atlased(
 	}
 }
 
+// Packs rectangles of the atlas, or gets the result of a previous packing if the same rectangles were packed recently
+void pack_greedy_atlas(
+		const VoxelMesherCubes::GreedyAtlasData &atlas_data,
+		VoxelMesherCubes::AtlasPackingCache &cache,
+		StdVector<Vector2i> &out_positions,
+		Vector2i &out_size
+) {
+	ZN_PROFILE_SCOPE();
+
+	uint64_t hash = hash_djb2_one_64(atlas_data.images.size());
+	for (const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im : atlas_data.images) {
+		hash = hash_djb2_one_64(im.size_x, hash);
+		hash = hash_djb2_one_64(im.size_y, hash);
+	}
+
+	++cache.time;
+
+	struct L {
+		static bool has_same_sizes(
+				const VoxelMesherCubes::AtlasPackingCache::Entry &entry,
+				const VoxelMesherCubes::GreedyAtlasData &atlas_data
+		) {
+			if (entry.sizes.size() != atlas_data.images.size()) {
+				return false;
+			}
+			for (unsigned int i = 0; i < entry.sizes.size(); ++i) {
+				const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
+				if (entry.sizes[i] != Vector2i(im.size_x, im.size_y)) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	VoxelMesherCubes::AtlasPackingCache::Entry *oldest_entry = &cache.entries[0];
+
+	for (VoxelMesherCubes::AtlasPackingCache::Entry &entry : cache.entries) {
+		if (entry.hash == hash && L::has_same_sizes(entry, atlas_data)) {
+			entry.last_used_time = cache.time;
+			out_positions = entry.positions;
+			out_size = entry.atlas_size;
+			return;
+		}
+		if (entry.last_used_time < oldest_entry->last_used_time) {
+			oldest_entry = &entry;
+		}
+	}
+
+	VoxelMesherCubes::AtlasPackingCache::Entry &entry = *oldest_entry;
+	entry.hash = hash;
+	entry.last_used_time = cache.time;
+	entry.sizes.resize(atlas_data.images.size());
+	for (unsigned int i = 0; i < atlas_data.images.size(); ++i) {
+		const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
+		entry.sizes[i] = Vector2i(im.size_x, im.size_y);
+	}
+
+	math::pack_rectangles_skyline(to_span(entry.sizes), entry.positions, entry.atlas_size);
+
+	out_positions = entry.positions;
+	out_size = entry.atlas_size;
+}
+
 Ref<Image> make_greedy_atlas(
 		const VoxelMesherCubes::GreedyAtlasData &atlas_data,
-		Span<VoxelMesherCubes::Arrays> surfaces
+		Span<VoxelMesherCubes::Arrays> surfaces,
+		VoxelMesherCubes::AtlasPackingCache &packing_cache
 ) {
 	//
 	ERR_FAIL_COND_V(atlas_data.images.size() == 0, Ref<Image>());
 	ZN_PROFILE_SCOPE();
 
 	// Pack rectangles
-	StdVector<Vector2i> result_points;
+	static thread_local StdVector<Vector2i> tls_result_points;
+	StdVector<Vector2i> &result_points = tls_result_points;
 	Vector2i result_size;
-	{
-		ZN_PROFILE_SCOPE_NAMED("Packing");
-		StdVector<Vector2i> sizes;
-		sizes.resize(atlas_data.images.size());
-		for (unsigned int i = 0; i < atlas_data.images.size(); ++i) {
-			const VoxelMesherCubes::GreedyAtlasData::ImageInfo &im = atlas_data.images[i];
-			sizes[i] = Vector2i(im.size_x, im.size_y);
-		}
-		zylann::godot::geometry_2d_make_atlas(to_span(sizes), result_points, result_size);
-	}
+	pack_greedy_atlas(atlas_data, packing_cache, result_points, result_size);
 
 	// DEBUG
 	// Ref<Image> debug_im;
@@ -883,8 +941,11 @@ void VoxelMesherCubes::build(VoxelMesher::Output &output, const VoxelMesher::Inp
 									cache.mask_memory_pool,
 									get_color_from_palette
 							);
-							atlas_image =
-									make_greedy_atlas(cache.greedy_atlas_data, to_span(cache.arrays_per_material));
+							atlas_image = make_greedy_atlas(
+									cache.greedy_atlas_data,
+									to_span(cache.arrays_per_material),
+									cache.atlas_packing_cache
+							);
 						} else {
 							build_voxel_mesh_as_greedy_cubes(
 									cache.arrays_per_material,
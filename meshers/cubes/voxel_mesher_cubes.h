@@ -1,7 +1,9 @@
 #ifndef VOXEL_MESHER_CUBES_H
 #define VOXEL_MESHER_CUBES_H
 
+#include "../../util/containers/fixed_array.h"
 #include "../../util/math/vector2f.h"
+#include "../../util/math/vector2i.h"
 #include "../../util/math/vector3f.h"
 #include "../../util/thread/rw_lock.h"
 #include "../voxel_mesher.h"
@@ -111,6 +113,20 @@ public:
 		}
 	};
 
+	// Results of previous atlas packings, reused when a block has the same layout of quads again, which happens a lot
+	// when only colors change
+	struct AtlasPackingCache {
+		struct Entry {
+			uint64_t hash = 0;
+			StdVector<Vector2i> sizes;
+			StdVector<Vector2i> positions;
+			Vector2i atlas_size;
+			uint32_t last_used_time = 0;
+		};
+		FixedArray<Entry, 8> entries;
+		uint32_t time = 0;
+	};
+
 private:
 	void _b_set_opaque_material(Ref<Material> material);
 	Ref<Material> _b_get_opaque_material() const;
@@ -131,6 +147,7 @@ private:
 		FixedArray<Arrays, MATERIAL_COUNT> arrays_per_material;
 		StdVector<uint8_t> mask_memory_pool;
 		GreedyAtlasData greedy_atlas_data;
+		AtlasPackingCache atlas_packing_cache;
 	};
 
 	// Parameters
@@ -4,9 +4,12 @@
 #include "../storage/voxel_data.h"
 #include "../terrain/voxel_mesh_block.h"
 #include "../util/dstack.h"
+#include "../util/godot/classes/array_mesh.h"
+#include "../util/godot/classes/concave_polygon_shape_3d.h"
 #include "../util/godot/classes/mesh.h"
 #include "../util/io/log.h"
 #include "../util/math/conv.h"
+#include "../util/memory/linear_allocator.h"
 #include "../util/profiling.h"
 // #include "../util/string/format.h" // Debug
 #include "../engine/voxel_engine.h"
@@ -28,7 +31,8 @@ struct CubicAreaInfo {
 };
 
 CubicAreaInfo get_cubic_area_info_from_size(unsigned int size) {
-	// Determine size of the cube of blocks
+	// Determine size of the cube of blocks. Mesh blocks can be 1, 2 or 4 times bigger than data blocks, with one block
+	// of neighbors on each side.
 	int edge_size;
 	int mesh_block_size_factor;
 	switch (size) {
@@ -40,6 +44,10 @@ CubicAreaInfo get_cubic_area_info_from_size(unsigned int size) {
 			edge_size = 4;
 			mesh_block_size_factor = 2;
 			break;
+		case 6 * 6 * 6:
+			edge_size = 6;
+			mesh_block_size_factor = 4;
+			break;
 		default:
 			ZN_PRINT_ERROR("Unsupported block count");
 			return CubicAreaInfo{ 0, 0, 0 };
@@ -65,7 +73,8 @@ void copy_block_and_neighbors(
 		uint8_t lod_index,
 		Vector3i mesh_block_pos,
 		StdVector<Box3i> *out_boxes_to_generate,
-		Vector3i *out_origin_in_voxels
+		Vector3i *out_origin_in_voxels,
+		LinearAllocator &temp_allocator
 ) {
 	ZN_DSTACK();
 	ZN_PROFILE_SCOPE();
@@ -119,8 +128,7 @@ void copy_block_and_neighbors(
 	const Vector3i origin_in_voxels_lod0 = origin_in_voxels << lod_index;
 
 	// These boxes are initially relative to the minimum corner of the minimum chunk.
-	// TODO Candidate for temp allocator (or SmallVector?)
-	StdVector<Box3i> boxes_to_generate;
+	StdVector<Box3i, StdLinearAllocator<Box3i>> boxes_to_generate(temp_allocator);
 	const Box3i mesh_data_box = Box3i::from_min_max(min_pos, max_pos);
 	if (contains(blocks.to_const(), std::shared_ptr<VoxelBuffer>())) {
 		const Box3i bounds_local(bounds_in_voxels.position - origin_in_voxels_without_padding, bounds_in_voxels.size);
@@ -134,13 +142,8 @@ void copy_block_and_neighbors(
 		// TODO The following logic might as well be simplified and moved to VoxelData.
 		// We are just sampling or generating data in a given area.
 
-		const Vector3i data_block_pos0 = mesh_block_pos * area_info.mesh_block_size_factor;
-		SpatialLock3D::Read srlock(
-				voxel_data.get_spatial_lock(lod_index),
-				BoxBounds3i(
-						data_block_pos0 - Vector3i(1, 1, 1), data_block_pos0 + Vector3iUtil::create(area_info.edge_size)
-				)
-		);
+		// No spatial lock is needed while copying. Voxel data in maps is copy-on-write, and since we hold references
+		// to these buffers, any edit happening in the meantime will be done on a copy, leaving ours unchanged.
 
 		// Using ZXY as convention to reconstruct positions with thread locking consistency
 		unsigned int block_index = 0;
@@ -218,11 +221,13 @@ void copy_block_and_neighbors(
 			VoxelGenerator::VoxelQueryData q{ generated_voxels,
 											  (box.position << lod_index) + origin_in_voxels_lod0,
 											  lod_index };
+			q.min_feature_size = VoxelGenerator::get_min_feature_size_for_lod(lod_index);
 
 			if (generator.is_valid()) {
-				generator->generate_block(q);
+				generator->generate_block_with_modifiers(q, modifiers);
+			} else {
+				modifiers.apply(q.voxel_buffer, AABB(q.origin_in_voxels, q.voxel_buffer.get_size() << lod_index));
 			}
-			modifiers.apply(q.voxel_buffer, AABB(q.origin_in_voxels, q.voxel_buffer.get_size() << lod_index));
 
 			for (const uint8_t channel_index : channels) {
 				dst.copy_channel_from(
@@ -265,9 +270,7 @@ Ref<ArrayMesh> build_mesh(
 			mesh.instantiate();
 		}
 
-		// TODO Use `add_surface`, it's about 20% faster after measuring in Tracy (though we may see if Godot 4 expects
-		// the same)
-		mesh->add_surface_from_arrays(primitive, arrays, Array(), Dictionary(), flags);
+		zylann::godot::add_surface_from_arrays(**mesh, primitive, arrays, flags);
 
 		mesh_material_indices.push_back(surface.material_index);
 	}
@@ -307,6 +310,7 @@ Ref<ArrayMesh> build_mesh(Array surface) {
 
 namespace {
 std::atomic_int g_debug_mesh_tasks_count = { 0 };
+std::atomic_uint64_t g_superseded_mesh_tasks_count = { 0 };
 } // namespace
 
 MeshBlockTask::MeshBlockTask() : _voxels(VoxelBuffer::ALLOCATOR_POOL) {
@@ -321,6 +325,25 @@ int MeshBlockTask::debug_get_running_count() {
 	return g_debug_mesh_tasks_count;
 }
 
+uint64_t MeshBlockTask::get_total_superseded_count() {
+	return g_superseded_mesh_tasks_count;
+}
+
+void MeshBlockTask::supersede_previous_tasks(std::shared_ptr<std::atomic_uint32_t> &block_version) {
+	if (block_version == nullptr) {
+		block_version = make_shared_instance<std::atomic_uint32_t>(0);
+	}
+	_version = block_version->fetch_add(1, std::memory_order_relaxed) + 1;
+	_block_version = block_version;
+}
+
+bool MeshBlockTask::is_superseded() const {
+	// Tasks updating detail textures are not superseded, because the terrain doesn't request them again until they
+	// are received
+	return _block_version != nullptr && !require_detail_texture &&
+			_block_version->load(std::memory_order_relaxed) != _version;
+}
+
 void MeshBlockTask::run(zylann::ThreadedTaskContext &ctx) {
 	ZN_DSTACK();
 	ZN_PROFILE_SCOPE();
@@ -354,7 +377,7 @@ void MeshBlockTask::run(zylann::ThreadedTaskContext &ctx) {
 			build_mesh();
 		}
 	} else {
-		gather_voxels_cpu();
+		gather_voxels_cpu(ctx);
 		build_mesh();
 	}
 }
@@ -381,7 +404,8 @@ void MeshBlockTask::gather_voxels_gpu(zylann::ThreadedTaskContext &ctx) {
 			lod_index,
 			mesh_block_position,
 			&boxes_to_generate,
-			&origin_in_voxels
+			&origin_in_voxels,
+			ctx.temp_allocator
 	);
 
 	if (boxes_to_generate.size() == 0) {
@@ -430,7 +454,7 @@ void MeshBlockTask::set_gpu_results(StdVector<GenerateBlockGPUTaskResult> &&resu
 	_stage = 1;
 }
 
-void MeshBlockTask::gather_voxels_cpu() {
+void MeshBlockTask::gather_voxels_cpu(zylann::ThreadedTaskContext &ctx) {
 	ZN_ASSERT(meshing_dependency != nullptr);
 	ZN_ASSERT(data != nullptr);
 
@@ -438,52 +462,77 @@ void MeshBlockTask::gather_voxels_cpu() {
 	const unsigned int min_padding = mesher->get_minimum_padding();
 	const unsigned int max_padding = mesher->get_maximum_padding();
 
+	// When generated blocks are cached, all channels are gathered so they can be stored as the generator produced them
+	const int channels_mask =
+			cache_generated_blocks ? VoxelBuffer::ALL_CHANNELS_MASK : mesher->get_used_channels_mask();
+
 	copy_block_and_neighbors(
 			to_span(blocks, blocks_count),
 			_voxels,
 			min_padding,
 			max_padding,
-			mesher->get_used_channels_mask(),
+			channels_mask,
 			meshing_dependency->generator,
 			*data,
 			lod_index,
 			mesh_block_position,
 			nullptr,
-			nullptr
+			nullptr,
+			ctx.temp_allocator
 	);
 
-	// Could cache generator data from here if it was safe to write into the map
-	/*if (data != nullptr && cache_generated_blocks) {
-		const CubicAreaInfo area_info = get_cubic_area_info_from_size(blocks.size());
-		ERR_FAIL_COND(!area_info.is_valid());
-
-		VoxelDataLodMap::Lod &lod = data->lods[lod_index];
-
-		// Note, this box does not include neighbors!
-		const Vector3i min_bpos = position * area_info.mesh_block_size_factor;
-		const Vector3i max_bpos = min_bpos + Vector3iUtil::create(area_info.edge_size - 2);
-
-		Vector3i bpos;
-		for (bpos.z = min_bpos.z; bpos.z < max_bpos.z; ++bpos.z) {
-			for (bpos.x = min_bpos.x; bpos.x < max_bpos.x; ++bpos.x) {
-				for (bpos.y = min_bpos.y; bpos.y < max_bpos.y; ++bpos.y) {
-					// {
-					// 	RWLockRead rlock(lod.map_lock);
-					// 	VoxelDataBlock *block = lod.map.get_block(bpos);
-					// 	if (block != nullptr && (block->is_edited() || block->is_modified())) {
-					// 		continue;
-					// 	}
-					// }
-					std::shared_ptr<VoxelBuffer> &cache_buffer = make_shared_instance<VoxelBuffer>();
-					cache_buffer->copy_format(voxels);
-					const Vector3i min_src_pos =
-							(bpos - min_bpos) * data_block_size + Vector3iUtil::create(min_padding);
-					cache_buffer->copy_from(voxels, min_src_pos, min_src_pos + cache_buffer->get_size(), Vector3i());
-					// TODO Where to put voxels? Can't safely write to data at the moment.
+	if (cache_generated_blocks) {
+		cache_generated_voxels(min_padding);
+	}
+}
+
+// Blocks that had no voxels were generated directly into the padded meshing buffer. Instead of requesting them
+// separately, the central ones are stored back into the map, as if they had been generated by `GenerateBlockTask`.
+void MeshBlockTask::cache_generated_voxels(const unsigned int min_padding) {
+	ZN_PROFILE_SCOPE();
+
+	const CubicAreaInfo area_info = get_cubic_area_info_from_size(blocks_count);
+	ZN_ASSERT_RETURN(area_info.is_valid());
+
+	const int data_block_size = data->get_block_size();
+	const Box3i bounds_in_voxels_lod0 = data->get_bounds();
+	const Box3i bounds_in_voxels(bounds_in_voxels_lod0.position >> lod_index, bounds_in_voxels_lod0.size >> lod_index);
+
+	const Vector3i min_bpos = mesh_block_position * area_info.mesh_block_size_factor;
+
+	// Same ZXY convention as the input grid, skipping neighbors
+	Vector3i rpos;
+	for (rpos.z = 0; rpos.z < area_info.mesh_block_size_factor; ++rpos.z) {
+		for (rpos.x = 0; rpos.x < area_info.mesh_block_size_factor; ++rpos.x) {
+			for (rpos.y = 0; rpos.y < area_info.mesh_block_size_factor; ++rpos.y) {
+				const unsigned int block_index =
+						((rpos.z + 1) * area_info.edge_size + (rpos.x + 1)) * area_info.edge_size + rpos.y + 1;
+				if (blocks[block_index] != nullptr) {
+					// Not generated
+					continue;
+				}
+
+				const Vector3i bpos = min_bpos + rpos;
+				const Box3i block_box(bpos * data_block_size, Vector3iUtil::create(data_block_size));
+				if (!bounds_in_voxels.contains(block_box)) {
+					// Partially generated
+					continue;
+				}
+
+				std::shared_ptr<VoxelBuffer> cache_buffer =
+						make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+				cache_buffer->create(Vector3iUtil::create(data_block_size));
+				cache_buffer->copy_format(_voxels);
+				const Vector3i min_src_pos = rpos * data_block_size + Vector3iUtil::create(min_padding);
+				const Vector3i max_src_pos = min_src_pos + cache_buffer->get_size();
+				for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+					cache_buffer->copy_channel_from(_voxels, min_src_pos, max_src_pos, Vector3i(), channel_index);
 				}
+
+				data->try_attach_generated_block_voxels(bpos, lod_index, cache_buffer);
 			}
 		}
-	}*/
+	}
 }
 
 void MeshBlockTask::build_mesh() {
@@ -493,6 +542,10 @@ void MeshBlockTask::build_mesh() {
 
 	const Vector3i origin_in_voxels = mesh_block_position * (mesh_block_size << lod_index);
 
+	// In server mode nothing but collision is used, so it doesn't have to match rendering
+	const bool simplified_collision_hint =
+			collision_hint && !require_visual && VoxelEngine::get_singleton().is_server_simplified_collision_enabled();
+
 	const VoxelMesher::Input input{
 		_voxels,
 		meshing_dependency->generator.ptr(),
@@ -501,7 +554,9 @@ void MeshBlockTask::build_mesh() {
 		collision_hint,
 		lod_hint,
 		// TODO Gathering detail texture information is not always necessary
-		true // detail_texture_hint
+		true, // detail_texture_hint
+		simplified_collision_hint,
+		defer_optimization
 	};
 	mesher->build(_surfaces_output, input);
 
@@ -554,6 +609,7 @@ void MeshBlockTask::build_mesh() {
 		nm_task->volume_id = volume_id;
 		nm_task->output_textures = detail_textures;
 		nm_task->detail_texture_settings = detail_texture_settings;
+		nm_task->tile_cache = detail_texture_tile_cache;
 		nm_task->priority_dependency = priority_dependency;
 		nm_task->use_gpu =
 				(detail_texture_use_gpu && nm_task->generator.is_valid() && nm_task->generator->supports_shaders());
@@ -581,18 +637,37 @@ void MeshBlockTask::build_mesh() {
 		_has_mesh_resource = false;
 	}
 
+	if (collision_hint && VoxelEngine::get_singleton().is_threaded_collision_shape_building_enabled()) {
+		// Building the shape also builds its acceleration structure, which can take a while with large meshes
+		ZN_PROFILE_SCOPE_NAMED("Build collision shape");
+		_collision_shape = make_collision_shape_from_mesher_output(_surfaces_output, **mesher);
+		_has_collision_shape_resource = true;
+
+	} else {
+		_has_collision_shape_resource = false;
+	}
+
 	_has_run = true;
 }
 
 TaskPriority MeshBlockTask::get_priority() {
+	uint8_t band2 = constants::TASK_PRIORITY_MESH_BAND2;
+	if (edited) {
+		band2 = constants::TASK_PRIORITY_EDITED_MESH_BAND2;
+	} else if (optimization_pass) {
+		band2 = constants::TASK_PRIORITY_MESH_OPTIMIZATION_BAND2;
+	}
 	float closest_viewer_distance_sq;
-	const TaskPriority p =
-			priority_dependency.evaluate(lod_index, constants::TASK_PRIORITY_MESH_BAND2, &closest_viewer_distance_sq);
+	const TaskPriority p = priority_dependency.evaluate(lod_index, band2, &closest_viewer_distance_sq);
 	_too_far = closest_viewer_distance_sq > priority_dependency.drop_distance_squared;
 	return p;
 }
 
 bool MeshBlockTask::is_cancelled() {
+	if (is_superseded()) {
+		// The result would be replaced by the one of a more recent task
+		return true;
+	}
 	if (cancellation_token.is_valid()) {
 		return cancellation_token.is_cancelled();
 	}
@@ -605,7 +680,11 @@ void MeshBlockTask::apply_result() {
 		// If it doesn't match, we are no longer interested in the result.
 		// It is assumed that if a dependency is changed, a new copy of it is made and the old one is marked
 		// invalid.
-		if (meshing_dependency->valid) {
+		if (is_superseded()) {
+			// A more recent task was sent for the same block, the terrain is waiting for that one instead
+			++g_superseded_mesh_tasks_count;
+
+		} else if (meshing_dependency->valid) {
 			VoxelEngine::BlockMeshOutput o;
 			// TODO Check for invalidation due to property changes
 
@@ -623,12 +702,11 @@ void MeshBlockTask::apply_result() {
 			o.mesh_material_indices = std::move(_mesh_material_indices);
 			o.has_mesh_resource = _has_mesh_resource;
 			o.visual_was_required = require_visual;
+			o.collision_shape = _collision_shape;
+			o.has_collision_shape_resource = _has_collision_shape_resource;
 			o.detail_textures = _detail_textures;
 
-			VoxelEngine::VolumeCallbacks callbacks = VoxelEngine::get_singleton().get_volume_callbacks(volume_id);
-			ERR_FAIL_COND(callbacks.mesh_output_callback == nullptr);
-			ERR_FAIL_COND(callbacks.data == nullptr);
-			callbacks.mesh_output_callback(callbacks.data, o);
+			VoxelEngine::get_singleton().push_volume_mesh_output(volume_id, o);
 		}
 
 	} else {
@@ -10,12 +10,16 @@
 #include "../storage/voxel_buffer.h"
 #include "../util/containers/std_vector.h"
 #include "../util/godot/classes/array_mesh.h"
+#include "../util/godot/classes/shape_3d.h"
 #include "../util/tasks/cancellation_token.h"
 #include "../util/tasks/threaded_task.h"
 
+#include <atomic>
+
 namespace zylann::voxel {
 
 class VoxelData;
+class DetailTextureTileCache;
 
 // Asynchronous task generating a mesh from voxel blocks and their neighbors, in a particular volume
 class MeshBlockTask : public IGeneratingVoxelsThreadedTask {
@@ -27,6 +31,10 @@ public:
 		return "MeshBlock";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_MESHING;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 	TaskPriority get_priority() override;
 	bool is_cancelled() override;
@@ -35,8 +43,15 @@ public:
 	void set_gpu_results(StdVector<GenerateBlockGPUTaskResult> &&results) override;
 
 	static int debug_get_running_count();
+	// Tasks that were dropped or whose result was discarded because a more recent task was sent for the same block
+	static uint64_t get_total_superseded_count();
+
+	// Makes this task the most recent one for its mesh block, using a version counter shared by all tasks sent for
+	// that block. The counter is created if null. Previous tasks then become superseded: they won't run if they are
+	// still queued, and their result will be discarded if they already ran.
+	void supersede_previous_tasks(std::shared_ptr<std::atomic_uint32_t> &block_version);
 
-	// 3x3x3 or 4x4x4 grid of voxel blocks.
+	// 3x3x3, 4x4x4 or 6x6x6 grid of voxel blocks.
 	FixedArray<std::shared_ptr<VoxelBuffer>, constants::MAX_BLOCK_COUNT_PER_REQUEST> blocks;
 	// TODO Need to provide format
 	// FixedArray<uint8_t, VoxelBuffer::MAX_CHANNELS> channel_depths;
@@ -51,35 +66,54 @@ public:
 	// If true, the mesh will be used in a context with LOD, which might require a few extra things in the way it is
 	// built
 	bool lod_hint = false;
+	// If true, the mesh is updated because voxels were edited. It runs before tasks of blocks being streamed, which
+	// can be numerous when viewers move fast, so edits don't take as long to show up.
+	bool edited = false;
+	// If true, the mesher may skip costly optimizations so the mesh shows up sooner. See
+	// `VoxelMesher::Input::deferred_optimization_hint`.
+	bool defer_optimization = false;
+	// If true, the mesh is updated to get an optimized version of it, after being built without optimizations. This
+	// runs after all other meshing tasks.
+	bool optimization_pass = false;
 	// Detail textures might be enabled, but we don't always want to update them in every mesh update.
 	// So this boolean is also checked to know if they should be computed.
 	bool require_detail_texture = false;
 	uint8_t detail_texture_generator_override_begin_lod_index = 0;
 	bool detail_texture_use_gpu = false;
 	bool block_generation_use_gpu = false;
+	// If true, data blocks which had no voxels and got generated to build the mesh will be stored into `data`.
+	// Only supported with CPU generation.
+	bool cache_generated_blocks = false;
 	PriorityDependency priority_dependency;
 	std::shared_ptr<MeshingDependency> meshing_dependency;
 	std::shared_ptr<VoxelData> data;
 	DetailRenderingSettings detail_texture_settings;
 	Ref<VoxelGenerator> detail_texture_generator_override;
+	std::shared_ptr<DetailTextureTileCache> detail_texture_tile_cache;
 	TaskCancellationToken cancellation_token;
 
 private:
 	void gather_voxels_gpu(zylann::ThreadedTaskContext &ctx);
-	void gather_voxels_cpu();
+	void gather_voxels_cpu(zylann::ThreadedTaskContext &ctx);
+	void cache_generated_voxels(const unsigned int min_padding);
 	void build_mesh();
+	bool is_superseded() const;
 
 	bool _has_run = false;
 	bool _too_far = false;
 	bool _has_mesh_resource = false;
+	bool _has_collision_shape_resource = false;
 	uint8_t _stage = 0;
 	VoxelBuffer _voxels;
 	VoxelMesher::Output _surfaces_output;
 	Ref<Mesh> _mesh;
 	Ref<Mesh> _shadow_occluder_mesh;
+	Ref<Shape3D> _collision_shape;
 	StdVector<uint16_t> _mesh_material_indices; // Indexed by mesh surface
 	std::shared_ptr<DetailTextureOutput> _detail_textures;
 	StdVector<GenerateBlockGPUTaskResult> _gpu_generation_results;
+	std::shared_ptr<std::atomic_uint32_t> _block_version;
+	uint32_t _version = 0;
 };
 
 // Builds a mesh resource from multiple surfaces data, and returns a mapping of where materials specified in the input
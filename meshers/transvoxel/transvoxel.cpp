@@ -3,6 +3,7 @@
 #include "../../storage/materials_4i4w.h"
 #include "../../util/godot/core/sort_array.h"
 #include "../../util/math/conv.h"
+#include "../../util/math/float4.h"
 #include "../../util/math/funcs.h"
 #include "../../util/profiling.h"
 #include "transvoxel_materials_mixel4.h"
@@ -193,8 +194,238 @@ struct MaterialProcessorNull {
 	}
 };
 
-// This function is template so we avoid branches and checks when sampling voxels
-template <typename TSdf, typename TMaterialProcessor>
+// Cells are processed in rows along Y of up to this size, so the signs of their corners fit in a 64-bit mask
+static const unsigned int CELL_ROW_SIZE = 32;
+static_assert((CELL_ROW_SIZE % (1 << SURFACE_BRICK_SIZE_PO2)) == 0, "Rows of cells must start at brick boundaries");
+
+inline unsigned int get_first_bit(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(v);
+#else
+	unsigned int i = 0;
+	while ((v & 1) == 0) {
+		v >>= 1;
+		++i;
+	}
+	return i;
+#endif
+}
+
+// Gets one bit per sample telling if it is above the isolevel, for up to 64 consecutive samples.
+// The chosen comparison here is very important. This relates to case selections where 4 samples are equal to the
+// isolevel and 4 others are above or below:
+// In one of these two cases, there has to be a surface to extract, otherwise no surface will be allowed to appear if
+// it happens to line up with integer coordinates.
+// If we used `<` instead of `>`, it would appear to work, but would break those edge cases.
+// `>` is chosen because it must match the comparison we do with case selection (in Transvoxel it is inverted).
+template <typename TSdf>
+inline uint64_t get_above_isolevel_mask(const TSdf *src, const unsigned int count, const TSdf isolevel) {
+	uint64_t mask = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		mask |= uint64_t(src[i] > isolevel) << i;
+	}
+	return mask;
+}
+
+#ifdef ZN_FLOAT4_SSE2
+
+template <>
+inline uint64_t get_above_isolevel_mask<int8_t>(const int8_t *src, const unsigned int count, const int8_t isolevel) {
+	const __m128i viso = _mm_set1_epi8(isolevel);
+	uint64_t mask = 0;
+	unsigned int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		mask |= uint64_t(_mm_movemask_epi8(_mm_cmpgt_epi8(v, viso))) << i;
+	}
+	for (; i < count; ++i) {
+		mask |= uint64_t(src[i] > isolevel) << i;
+	}
+	return mask;
+}
+
+template <>
+inline uint64_t get_above_isolevel_mask<int16_t>(const int16_t *src, const unsigned int count, const int16_t isolevel) {
+	const __m128i viso = _mm_set1_epi16(isolevel);
+	uint64_t mask = 0;
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		const __m128i c = _mm_cmpgt_epi16(v, viso);
+		// Narrow 16-bit lanes to bytes so their signs can be gathered in 8 bits
+		mask |= uint64_t(_mm_movemask_epi8(_mm_packs_epi16(c, c)) & 0xff) << i;
+	}
+	for (; i < count; ++i) {
+		mask |= uint64_t(src[i] > isolevel) << i;
+	}
+	return mask;
+}
+
+template <>
+inline uint64_t get_above_isolevel_mask<float>(const float *src, const unsigned int count, const float isolevel) {
+	const __m128 viso = _mm_set1_ps(isolevel);
+	uint64_t mask = 0;
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		mask |= uint64_t(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(src + i), viso))) << i;
+	}
+	for (; i < count; ++i) {
+		mask |= uint64_t(src[i] > isolevel) << i;
+	}
+	return mask;
+}
+
+#endif
+
+// Cells are grouped in regions of 2x2x2 bricks, which are checked first, so bricks of regions entirely above or below
+// the isolevel don't need to be checked one by one
+static const unsigned int SURFACE_REGION_SIZE_PO2 = SURFACE_BRICK_SIZE_PO2 + 1;
+
+// Finds which bricks of cells have corners on both sides of the isolevel. Other bricks cannot produce geometry, and
+// because smooth terrain is usually above or below the isolevel except in a thin band around the surface, skipping
+// them saves a lot of per-cell checks.
+template <typename TSdf>
+void find_surface_bricks(
+		Span<const TSdf> sdf_data,
+		const Vector3i block_size_with_padding,
+		const Vector3i min_pos,
+		const Vector3i max_pos,
+		const Vector3i bricks_size,
+		const TSdf isolevel,
+		StdVector<uint8_t> &surface_bricks
+) {
+	ZN_PROFILE_SCOPE();
+
+	surface_bricks.clear();
+	surface_bricks.resize(Vector3iUtil::get_volume_u64(bricks_size), 0);
+
+	constexpr int region_size = 1 << SURFACE_REGION_SIZE_PO2;
+	constexpr int brick_size = 1 << SURFACE_BRICK_SIZE_PO2;
+	// Cells read one voxel further along positive axes
+	constexpr int region_corners_size = region_size + 1;
+	constexpr int brick_corners_size = brick_size + 1;
+	const Vector3i regions_size = math::ceildiv(max_pos - min_pos, region_size);
+
+	// Signs of the corners of each column of a region along Y, one bit per corner
+	FixedArray<uint32_t, region_corners_size * region_corners_size> column_masks;
+
+	Vector3i rpos;
+	for (rpos.z = 0; rpos.z < regions_size.z; ++rpos.z) {
+		for (rpos.y = 0; rpos.y < regions_size.y; ++rpos.y) {
+			for (rpos.x = 0; rpos.x < regions_size.x; ++rpos.x) {
+				const Vector3i cells_min = min_pos + (rpos << SURFACE_REGION_SIZE_PO2);
+				const Vector3i cells_max = math::min(cells_min + Vector3iUtil::create(region_size), max_pos);
+				const Vector3i corners_size = cells_max + Vector3i(1, 1, 1) - cells_min;
+
+				// Gather signs of the whole region once, reading contiguous voxels along Y
+				uint32_t any_above = 0;
+				uint32_t all_above = (uint32_t(1) << corners_size.y) - 1;
+				for (int z = 0; z < corners_size.z; ++z) {
+					for (int x = 0; x < corners_size.x; ++x) {
+						const unsigned int data_index = Vector3iUtil::get_zxy_index(
+								Vector3i(cells_min.x + x, cells_min.y, cells_min.z + z), block_size_with_padding
+						);
+						const uint32_t mask = get_above_isolevel_mask(&sdf_data[data_index], corners_size.y, isolevel);
+						column_masks[x + z * region_corners_size] = mask;
+						any_above |= mask;
+						all_above &= mask;
+					}
+				}
+
+				if (any_above == 0 || all_above == (uint32_t(1) << corners_size.y) - 1) {
+					// The whole region is on one side of the isolevel, none of its bricks can have a surface
+					continue;
+				}
+
+				// Check bricks of the region from the signs gathered above
+				const Vector3i bricks_min = rpos << 1;
+				const Vector3i bricks_max = math::min(bricks_min + Vector3i(2, 2, 2), bricks_size);
+				Vector3i bpos;
+				for (bpos.z = bricks_min.z; bpos.z < bricks_max.z; ++bpos.z) {
+					for (bpos.y = bricks_min.y; bpos.y < bricks_max.y; ++bpos.y) {
+						for (bpos.x = bricks_min.x; bpos.x < bricks_max.x; ++bpos.x) {
+							// Bricks start at multiples of the brick size within the region
+							const Vector3i corners_min = (bpos - bricks_min) * brick_size;
+							const Vector3i brick_corners_max =
+									math::min(corners_min + Vector3iUtil::create(brick_corners_size), corners_size);
+
+							const uint32_t brick_bits =
+									((uint32_t(1) << (brick_corners_max.y - corners_min.y)) - 1) << corners_min.y;
+
+							uint32_t brick_any_above = 0;
+							uint32_t brick_all_above = brick_bits;
+							for (int z = corners_min.z; z < brick_corners_max.z; ++z) {
+								for (int x = corners_min.x; x < brick_corners_max.x; ++x) {
+									const uint32_t mask = column_masks[x + z * region_corners_size] & brick_bits;
+									brick_any_above |= mask;
+									brick_all_above &= mask;
+								}
+							}
+
+							const unsigned int brick_index = Vector3iUtil::get_zyx_index(bpos, bricks_size);
+							surface_bricks[brick_index] = brick_any_above != 0 && brick_all_above != brick_bits;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Gets which cells of a row along Y have corners on both sides of the isolevel. `row` points at the minimum corner of
+// the first cell. Other cells cannot produce geometry.
+template <typename TSdf>
+inline uint64_t get_isolevel_crossing_cells_mask(
+		const TSdf *row,
+		const unsigned int cell_count,
+		const unsigned int n100,
+		const unsigned int n001,
+		const TSdf isolevel
+) {
+	// Cells have one more corner than their count along the row
+	const unsigned int corner_count = cell_count + 1;
+
+	// Bit `i` is the sign of the corners of cell `i` at its minimum Y, bit `i + 1` at its maximum Y
+	const uint64_t m00 = get_above_isolevel_mask(row, corner_count, isolevel);
+	const uint64_t m10 = get_above_isolevel_mask(row + n100, corner_count, isolevel);
+	const uint64_t m01 = get_above_isolevel_mask(row + n001, corner_count, isolevel);
+	const uint64_t m11 = get_above_isolevel_mask(row + n100 + n001, corner_count, isolevel);
+
+	const uint64_t all_above = m00 & m10 & m01 & m11;
+	const uint64_t any_above = m00 | m10 | m01 | m11;
+
+	const uint64_t cells_all_above = all_above & (all_above >> 1);
+	const uint64_t cells_none_above = ~any_above & ~(any_above >> 1);
+
+	const uint64_t cells = (uint64_t(1) << cell_count) - 1;
+	return ~(cells_all_above | cells_none_above) & cells;
+}
+
+// Gets which cells of a row along Y belong to bricks that may contain the isosurface.
+// `row_min_y` is relative to the first cell of the block, and must be at a brick boundary.
+inline uint64_t get_surface_bricks_row_mask(
+		Span<const uint8_t> surface_bricks,
+		const unsigned int bricks_column_index,
+		const unsigned int bricks_size_x,
+		const unsigned int row_min_y,
+		const unsigned int cell_count
+) {
+	const unsigned int brick_size = 1 << SURFACE_BRICK_SIZE_PO2;
+	const uint64_t brick_cells = (uint64_t(1) << brick_size) - 1;
+	uint64_t mask = 0;
+	for (unsigned int i = 0; i < cell_count; i += brick_size) {
+		const unsigned int brick_y = (row_min_y + i) >> SURFACE_BRICK_SIZE_PO2;
+		if (surface_bricks[bricks_column_index + brick_y * bricks_size_x] != 0) {
+			mask |= brick_cells << i;
+		}
+	}
+	return mask & ((uint64_t(1) << cell_count) - 1);
+}
+
+// This function is template so we avoid branches and checks when sampling voxels.
+// `TLodAttributes` tells if secondary positions and border masks must be computed, which are only needed when
+// transition meshes are used.
+template <typename TSdf, typename TMaterialProcessor, bool TLodAttributes>
 void build_regular_mesh(
 		Span<const TSdf> sdf_data,
 		TMaterialProcessor material_processor,
@@ -234,381 +465,401 @@ void build_regular_mesh(
 	// Get direct representation of the isolevel (not always zero since we are not using signed integers yet)
 	const TSdf isolevel = get_isolevel<TSdf>();
 
-	// Iterate all cells with padding (expected to be neighbors)
+	const unsigned int brick_size = 1 << SURFACE_BRICK_SIZE_PO2;
+	const Vector3i bricks_size = math::ceildiv(max_pos - min_pos, int(brick_size));
+	StdVector<uint8_t> &surface_bricks = cache.get_surface_bricks();
+	find_surface_bricks(sdf_data, block_size_with_padding, min_pos, max_pos, bricks_size, isolevel, surface_bricks);
+
+	// Cells are visited in the same order as voxels are laid out in memory (ZXY, Y innermost), so rows of cells along Y
+	// read contiguous voxels. Vertex reuse only looks at preceding cells along negative axes, which are still visited
+	// first.
 	Vector3i pos;
 	for (pos.z = min_pos.z; pos.z < max_pos.z; ++pos.z) {
-		for (pos.y = min_pos.y; pos.y < max_pos.y; ++pos.y) {
-			// TODO Optimization: change iteration to be ZXY? (Data is laid out with Y as deepest coordinate)
-			unsigned int data_index =
-					Vector3iUtil::get_zxy_index(Vector3i(min_pos.x, pos.y, pos.z), block_size_with_padding);
-
-			for (pos.x = min_pos.x; pos.x < max_pos.x; ++pos.x, data_index += block_size_with_padding.y) {
-				{
-					// The chosen comparison here is very important. This relates to case selections where 4 samples
-					// are equal to the isolevel and 4 others are above or below:
-					// In one of these two cases, there has to be a surface to extract, otherwise no surface will be
-					// allowed to appear if it happens to line up with integer coordinates.
-					// If we used `<` instead of `>`, it would appear to work, but would break those edge cases.
-					// `>` is chosen because it must match the comparison we do with case selection (in Transvoxel
-					// it is inverted).
-					const bool s = sdf_data[data_index] > isolevel;
-
-					if ( //
-							(sdf_data[data_index + n010] > isolevel) == s &&
-							(sdf_data[data_index + n100] > isolevel) == s &&
-							(sdf_data[data_index + n110] > isolevel) == s &&
-							(sdf_data[data_index + n001] > isolevel) == s &&
-							(sdf_data[data_index + n011] > isolevel) == s &&
-							(sdf_data[data_index + n101] > isolevel) == s &&
-							(sdf_data[data_index + n111] > isolevel) == s) {
-						// Not crossing the isolevel, this cell won't produce any geometry.
-						// We must figure this out as fast as possible, because it will happen a lot.
-						continue;
-					}
-				}
-
-				//    6-------7
-				//   /|      /|
-				//  / |     / |  Corners
-				// 4-------5  |
-				// |  2----|--3
-				// | /     | /   z y
-				// |/      |/    |/
-				// 0-------1     o--x
-
-				FixedArray<unsigned int, 8> corner_data_indices;
-				corner_data_indices[0] = data_index;
-				corner_data_indices[1] = data_index + n100;
-				corner_data_indices[2] = data_index + n010;
-				corner_data_indices[3] = data_index + n110;
-				corner_data_indices[4] = data_index + n001;
-				corner_data_indices[5] = data_index + n101;
-				corner_data_indices[6] = data_index + n011;
-				corner_data_indices[7] = data_index + n111;
-
-				FixedArray<float, 8> cell_samples_sdf;
-				for (unsigned int i = 0; i < corner_data_indices.size(); ++i) {
-					cell_samples_sdf[i] = sdf_as_float(sdf_data[corner_data_indices[i]]);
-				}
-
-				// Concatenate the sign of cell values to obtain the case code.
-				// Index 0 is the less significant bit, and index 7 is the most significant bit.
-				uint8_t case_code = sign_f(cell_samples_sdf[0]);
-				case_code |= (sign_f(cell_samples_sdf[1]) << 1);
-				case_code |= (sign_f(cell_samples_sdf[2]) << 2);
-				case_code |= (sign_f(cell_samples_sdf[3]) << 3);
-				case_code |= (sign_f(cell_samples_sdf[4]) << 4);
-				case_code |= (sign_f(cell_samples_sdf[5]) << 5);
-				case_code |= (sign_f(cell_samples_sdf[6]) << 6);
-				case_code |= (sign_f(cell_samples_sdf[7]) << 7);
-
-				// TODO Is this really needed now that we check isolevel earlier?
-				if (case_code == 0 || case_code == 255) {
-					// If the case_code is 0 or 255, there is no triangulation to do.
+		for (pos.x = min_pos.x; pos.x < max_pos.x; ++pos.x) {
+			const unsigned int column_data_index =
+					Vector3iUtil::get_zxy_index(Vector3i(pos.x, min_pos.y, pos.z), block_size_with_padding);
+
+			const unsigned int bricks_column_index = ((pos.x - min_pos.x) >> SURFACE_BRICK_SIZE_PO2) +
+					bricks_size.x * bricks_size.y * ((pos.z - min_pos.z) >> SURFACE_BRICK_SIZE_PO2);
+
+			for (int row_min_y = min_pos.y; row_min_y < max_pos.y; row_min_y += CELL_ROW_SIZE) {
+				const unsigned int row_cell_count = math::min(max_pos.y - row_min_y, int(CELL_ROW_SIZE));
+
+				uint64_t cells_mask = get_surface_bricks_row_mask(
+						to_span(surface_bricks),
+						bricks_column_index,
+						bricks_size.x,
+						row_min_y - min_pos.y,
+						row_cell_count
+				);
+				if (cells_mask == 0) {
+					// No cell of this row can produce geometry
 					continue;
 				}
 
-				ReuseCell &current_reuse_cell = cache.get_reuse_cell(pos);
-
-#if DEBUG_ENABLED
-				ZN_ASSERT(case_code <= 255);
-#endif
+				// Not crossing the isolevel, cells won't produce any geometry. We must figure this out as fast as
+				// possible, because it will happen a lot, so it is done for the whole row at once.
+				cells_mask &= get_isolevel_crossing_cells_mask(
+						sdf_data.data() + column_data_index + (row_min_y - min_pos.y),
+						row_cell_count,
+						n100,
+						n001,
+						isolevel
+				);
 
-				FixedArray<Vector3i, 8> padded_corner_positions;
-				padded_corner_positions[0] = Vector3i(pos.x, pos.y, pos.z);
-				padded_corner_positions[1] = Vector3i(pos.x + 1, pos.y, pos.z);
-				padded_corner_positions[2] = Vector3i(pos.x, pos.y + 1, pos.z);
-				padded_corner_positions[3] = Vector3i(pos.x + 1, pos.y + 1, pos.z);
-				padded_corner_positions[4] = Vector3i(pos.x, pos.y, pos.z + 1);
-				padded_corner_positions[5] = Vector3i(pos.x + 1, pos.y, pos.z + 1);
-				padded_corner_positions[6] = Vector3i(pos.x, pos.y + 1, pos.z + 1);
-				padded_corner_positions[7] = Vector3i(pos.x + 1, pos.y + 1, pos.z + 1);
-
-				current_reuse_cell.packed_texture_indices = material_processor.on_cell(corner_data_indices, case_code);
-
-				FixedArray<Vector3i, 8> corner_positions;
-				for (unsigned int i = 0; i < padded_corner_positions.size(); ++i) {
-					const Vector3i p = padded_corner_positions[i];
-					// Undo padding here. From this point, corner positions are actual positions.
-					corner_positions[i] = (p - min_pos) << lod_index;
-				}
+				while (cells_mask != 0) {
+					const unsigned int row_y = get_first_bit(cells_mask);
+					cells_mask &= cells_mask - 1;
+
+					pos.y = row_min_y + row_y;
+					const unsigned int data_index = column_data_index + (pos.y - min_pos.y);
+
+					//    6-------7
+					//   /|      /|
+					//  / |     / |  Corners
+					// 4-------5  |
+					// |  2----|--3
+					// | /     | /   z y
+					// |/      |/    |/
+					// 0-------1     o--x
+
+					FixedArray<unsigned int, 8> corner_data_indices;
+					corner_data_indices[0] = data_index;
+					corner_data_indices[1] = data_index + n100;
+					corner_data_indices[2] = data_index + n010;
+					corner_data_indices[3] = data_index + n110;
+					corner_data_indices[4] = data_index + n001;
+					corner_data_indices[5] = data_index + n101;
+					corner_data_indices[6] = data_index + n011;
+					corner_data_indices[7] = data_index + n111;
+
+					FixedArray<float, 8> cell_samples_sdf;
+					for (unsigned int i = 0; i < corner_data_indices.size(); ++i) {
+						cell_samples_sdf[i] = sdf_as_float(sdf_data[corner_data_indices[i]]);
+					}
 
-				// For cells occurring along the minimal boundaries of a block,
-				// the preceding cells needed for vertex reuse may not exist.
-				// In these cases, we allow new vertex creation on additional edges of a cell.
-				// While iterating through the cells in a block, a 3-bit mask is maintained whose bits indicate
-				// whether corresponding bits in a direction code are valid
-				const uint8_t direction_validity_mask = (pos.x > min_pos.x ? 1 : 0) |
-						((pos.y > min_pos.y ? 1 : 0) << 1) | ((pos.z > min_pos.z ? 1 : 0) << 2);
-
-				const uint8_t regular_cell_class_index = tables::get_regular_cell_class(case_code);
-				const tables::RegularCellData &regular_cell_data =
-						tables::get_regular_cell_data(regular_cell_class_index);
-				const uint8_t triangle_count = regular_cell_data.geometryCounts & 0x0f;
-				const uint8_t vertex_count = (regular_cell_data.geometryCounts & 0xf0) >> 4;
-
-				FixedArray<int, 12> cell_vertex_indices;
-				fill(cell_vertex_indices, -1);
-
-				// TODO When not using LOD, this is not necessary
-				const uint8_t cell_border_mask = get_border_mask(pos - min_pos, block_size - Vector3i(1, 1, 1));
-
-				// For each vertex in the case
-				for (unsigned int vertex_index = 0; vertex_index < vertex_count; ++vertex_index) {
-					// The case index maps to a list of 16-bit codes providing information about the edges on which the
-					// vertices lie. The low byte of each 16-bit code contains the corner indexes of the edge’s
-					// endpoints in one nibble each, and the high byte contains the mapping code shown in Figure 3.8(b)
-					const unsigned short rvd = tables::get_regular_vertex_data(case_code, vertex_index);
-					const uint8_t edge_code_low = rvd & 0xff;
-					const uint8_t edge_code_high = (rvd >> 8) & 0xff;
-
-					// Get corner indexes in the low nibble (always ordered so the higher comes last)
-					const uint8_t v0 = (edge_code_low >> 4) & 0xf;
-					const uint8_t v1 = edge_code_low & 0xf;
-
-#ifdef DEBUG_ENABLED
-					ZN_ASSERT_RETURN(v1 > v0);
-#endif
+					// Concatenate the sign of cell values to obtain the case code.
+					// Index 0 is the less significant bit, and index 7 is the most significant bit.
+					uint8_t case_code = sign_f(cell_samples_sdf[0]);
+					case_code |= (sign_f(cell_samples_sdf[1]) << 1);
+					case_code |= (sign_f(cell_samples_sdf[2]) << 2);
+					case_code |= (sign_f(cell_samples_sdf[3]) << 3);
+					case_code |= (sign_f(cell_samples_sdf[4]) << 4);
+					case_code |= (sign_f(cell_samples_sdf[5]) << 5);
+					case_code |= (sign_f(cell_samples_sdf[6]) << 6);
+					case_code |= (sign_f(cell_samples_sdf[7]) << 7);
+
+					// TODO Is this really needed now that we check isolevel earlier?
+					if (case_code == 0 || case_code == 255) {
+						// If the case_code is 0 or 255, there is no triangulation to do.
+						continue;
+					}
 
-					// Get voxel values at the corners
-					const float sample0 = cell_samples_sdf[v0]; // called d0 in the paper
-					const float sample1 = cell_samples_sdf[v1]; // called d1 in the paper
+					ReuseCell &current_reuse_cell = cache.get_reuse_cell(pos);
+
+	#if DEBUG_ENABLED
+					ZN_ASSERT(case_code <= 255);
+	#endif
+
+					FixedArray<Vector3i, 8> padded_corner_positions;
+					padded_corner_positions[0] = Vector3i(pos.x, pos.y, pos.z);
+					padded_corner_positions[1] = Vector3i(pos.x + 1, pos.y, pos.z);
+					padded_corner_positions[2] = Vector3i(pos.x, pos.y + 1, pos.z);
+					padded_corner_positions[3] = Vector3i(pos.x + 1, pos.y + 1, pos.z);
+					padded_corner_positions[4] = Vector3i(pos.x, pos.y, pos.z + 1);
+					padded_corner_positions[5] = Vector3i(pos.x + 1, pos.y, pos.z + 1);
+					padded_corner_positions[6] = Vector3i(pos.x, pos.y + 1, pos.z + 1);
+					padded_corner_positions[7] = Vector3i(pos.x + 1, pos.y + 1, pos.z + 1);
+
+					current_reuse_cell.packed_texture_indices =
+							material_processor.on_cell(corner_data_indices, case_code);
+
+					FixedArray<Vector3i, 8> corner_positions;
+					for (unsigned int i = 0; i < padded_corner_positions.size(); ++i) {
+						const Vector3i p = padded_corner_positions[i];
+						// Undo padding here. From this point, corner positions are actual positions.
+						corner_positions[i] = (p - min_pos) << lod_index;
+					}
 
-#ifdef DEBUG_ENABLED
-					// TODO Zero-division is not mentionned in the paper?? (never happens tho)
-					ZN_ASSERT_RETURN(sample1 != sample0);
-					ZN_ASSERT_RETURN(sample1 != 0 || sample0 != 0);
-#endif
+					// For cells occurring along the minimal boundaries of a block,
+					// the preceding cells needed for vertex reuse may not exist.
+					// In these cases, we allow new vertex creation on additional edges of a cell.
+					// While iterating through the cells in a block, a 3-bit mask is maintained whose bits indicate
+					// whether corresponding bits in a direction code are valid
+					const uint8_t direction_validity_mask = (pos.x > min_pos.x ? 1 : 0) |
+							((pos.y > min_pos.y ? 1 : 0) << 1) | ((pos.z > min_pos.z ? 1 : 0) << 2);
+
+					const uint8_t regular_cell_class_index = tables::get_regular_cell_class(case_code);
+					const tables::RegularCellData &regular_cell_data =
+							tables::get_regular_cell_data(regular_cell_class_index);
+					const uint8_t triangle_count = regular_cell_data.geometryCounts & 0x0f;
+					const uint8_t vertex_count = (regular_cell_data.geometryCounts & 0xf0) >> 4;
+
+					FixedArray<int, 12> cell_vertex_indices;
+					fill(cell_vertex_indices, -1);
+
+					// When LOD attributes are not needed, this is a constant so the compiler can remove code depending
+					// on it
+					const uint8_t cell_border_mask =
+							TLodAttributes ? get_border_mask(pos - min_pos, block_size - Vector3i(1, 1, 1)) : 0;
+
+					// For each vertex in the case
+					for (unsigned int vertex_index = 0; vertex_index < vertex_count; ++vertex_index) {
+						// The case index maps to a list of 16-bit codes providing information about the edges on which
+						// the vertices lie. The low byte of each 16-bit code contains the corner indexes of the edge’s
+						// endpoints in one nibble each, and the high byte contains the mapping code shown in Figure
+						// 3.8(b)
+						const unsigned short rvd = tables::get_regular_vertex_data(case_code, vertex_index);
+						const uint8_t edge_code_low = rvd & 0xff;
+						const uint8_t edge_code_high = (rvd >> 8) & 0xff;
+
+						// Get corner indexes in the low nibble (always ordered so the higher comes last)
+						const uint8_t v0 = (edge_code_low >> 4) & 0xf;
+						const uint8_t v1 = edge_code_low & 0xf;
+
+	#ifdef DEBUG_ENABLED
+						ZN_ASSERT_RETURN(v1 > v0);
+	#endif
+
+						// Get voxel values at the corners
+						const float sample0 = cell_samples_sdf[v0]; // called d0 in the paper
+						const float sample1 = cell_samples_sdf[v1]; // called d1 in the paper
+
+	#ifdef DEBUG_ENABLED
+						// TODO Zero-division is not mentionned in the paper?? (never happens tho)
+						ZN_ASSERT_RETURN(sample1 != sample0);
+						ZN_ASSERT_RETURN(sample1 != 0 || sample0 != 0);
+	#endif
+
+						// Get interpolation position
+						// We use an 8-bit fraction, allowing the new vertex to be located at one of 257 possible
+						// positions  along  the  edge  when  both  endpoints  are included.
+						// const int t = (sample1 << 8) / (sample1 - sample0);
+						const float t =
+								math::clamp(sample1 / (sample1 - sample0), edge_clamp_margin, edge_clamp_margin_max);
+
+						const Vector3i p0 = corner_positions[v0];
+						const Vector3i p1 = corner_positions[v1];
+
+						if (t > 0.f && t < 1.f) {
+							// Vertex is between p0 and p1 (inside the edge)
+
+							// Each edge of a cell is assigned an 8-bit code, as shown in Figure 3.8(b), that provides a
+							// mapping to a preceding cell and the coincident edge on that preceding cell for which new
+							// vertex creation  was  allowed. The high nibble of this code indicates which direction to
+							// go in order to reach the correct preceding cell. The bit values 1, 2, and 4 in this
+							// nibble indicate that we must subtract one from the x, y, and/or z coordinate,
+							// respectively.
+							const uint8_t reuse_dir = (edge_code_high >> 4) & 0xf;
+							const uint8_t reuse_vertex_index = edge_code_high & 0xf;
+
+							// TODO Some re-use opportunities are missed on negative sides of the block,
+							// but I don't really know how to fix it...
+							// You can check by "shaking" every vertex randomly in a shader based on its index,
+							// you will see vertices touching the -X, -Y or -Z sides of the block aren't connected
+
+							const bool present = (reuse_dir & direction_validity_mask) == reuse_dir;
+
+							if (present) {
+								const Vector3i cache_pos = pos + dir_to_prev_vec(reuse_dir);
+								const ReuseCell &prev_cell = cache.get_reuse_cell(cache_pos);
+								if (prev_cell.packed_texture_indices == current_reuse_cell.packed_texture_indices) {
+									// Will reuse a previous vertice
+									cell_vertex_indices[vertex_index] = prev_cell.vertices[reuse_vertex_index];
+								}
+							}
 
-					// Get interpolation position
-					// We use an 8-bit fraction, allowing the new vertex to be located at one of 257 possible
-					// positions  along  the  edge  when  both  endpoints  are included.
-					// const int t = (sample1 << 8) / (sample1 - sample0);
-					const float t =
-							math::clamp(sample1 / (sample1 - sample0), edge_clamp_margin, edge_clamp_margin_max);
-
-					const Vector3i p0 = corner_positions[v0];
-					const Vector3i p1 = corner_positions[v1];
-
-					if (t > 0.f && t < 1.f) {
-						// Vertex is between p0 and p1 (inside the edge)
-
-						// Each edge of a cell is assigned an 8-bit code, as shown in Figure 3.8(b),
-						// that provides a mapping to a preceding cell and the coincident edge on that preceding cell
-						// for which new vertex creation  was  allowed.
-						// The high nibble of this code indicates which direction to go in order to reach the correct
-						// preceding cell. The bit values 1, 2, and 4 in this nibble indicate that we must subtract one
-						// from the x, y, and/or z coordinate, respectively.
-						const uint8_t reuse_dir = (edge_code_high >> 4) & 0xf;
-						const uint8_t reuse_vertex_index = edge_code_high & 0xf;
-
-						// TODO Some re-use opportunities are missed on negative sides of the block,
-						// but I don't really know how to fix it...
-						// You can check by "shaking" every vertex randomly in a shader based on its index,
-						// you will see vertices touching the -X, -Y or -Z sides of the block aren't connected
-
-						const bool present = (reuse_dir & direction_validity_mask) == reuse_dir;
-
-						if (present) {
-							const Vector3i cache_pos = pos + dir_to_prev_vec(reuse_dir);
-							const ReuseCell &prev_cell = cache.get_reuse_cell(cache_pos);
-							if (prev_cell.packed_texture_indices == current_reuse_cell.packed_texture_indices) {
-								// Will reuse a previous vertice
-								cell_vertex_indices[vertex_index] = prev_cell.vertices[reuse_vertex_index];
+							if (!present || cell_vertex_indices[vertex_index] == -1) {
+								// Create new vertex
+
+								const float t0 = t; // static_cast<float>(t) / 256.f;
+								const float t1 = 1.f - t; // static_cast<float>(0x100 - t) / 256.f;
+								// const int ti0 = t;
+								// const int ti1 = 0x100 - t;
+								// const Vector3i primary = p0 * ti0 + p1 * ti1;
+
+								const Vector3f primaryf = to_vec3f(p0) * t0 + to_vec3f(p1) * t1;
+								// TODO Binary search gives better positional results, but does not improve normals. I'm
+								// not sure how to overcome this because if we sample low-detail normals, we get a
+								// "blocky" result due to SDF clipping. If we sample high-detail gradients, we get
+								// details, but if details are bumpy, we also get noisy results.
+								const Vector3f cg0 = get_corner_gradient<TSdf>(
+										corner_data_indices[v0], sdf_data, block_size_with_padding
+								);
+								const Vector3f cg1 = get_corner_gradient<TSdf>(
+										corner_data_indices[v1], sdf_data, block_size_with_padding
+								);
+								const Vector3f normal = normalized_not_null(cg0 * t0 + cg1 * t1);
+
+								Vector3f secondary;
+
+								uint8_t vertex_border_mask = 0;
+								if (cell_border_mask > 0) {
+									secondary = get_secondary_position(primaryf, normal, lod_index, block_size);
+									vertex_border_mask = (get_border_mask(p0, block_size_scaled) &
+											get_border_mask(p1, block_size_scaled));
+								}
+
+								cell_vertex_indices[vertex_index] = output.add_vertex(
+										primaryf, normal, cell_border_mask, vertex_border_mask, 0, secondary
+								);
+
+								material_processor.on_vertex(v0, v1, t1);
+
+								if (reuse_dir & 8) {
+									// Store the generated vertex so that other cells can reuse it.
+									current_reuse_cell.vertices[reuse_vertex_index] = cell_vertex_indices[vertex_index];
+								}
 							}
-						}
 
-						if (!present || cell_vertex_indices[vertex_index] == -1) {
-							// Create new vertex
-
-							const float t0 = t; // static_cast<float>(t) / 256.f;
-							const float t1 = 1.f - t; // static_cast<float>(0x100 - t) / 256.f;
-							// const int ti0 = t;
-							// const int ti1 = 0x100 - t;
-							// const Vector3i primary = p0 * ti0 + p1 * ti1;
-
-							const Vector3f primaryf = to_vec3f(p0) * t0 + to_vec3f(p1) * t1;
-							// TODO Binary search gives better positional results, but does not improve normals.
-							// I'm not sure how to overcome this because if we sample low-detail normals, we get a
-							// "blocky" result due to SDF clipping. If we sample high-detail gradients, we get details,
-							// but if details are bumpy, we also get noisy results.
-							const Vector3f cg0 = get_corner_gradient<TSdf>(
-									corner_data_indices[v0], sdf_data, block_size_with_padding
-							);
+						} else if (t == 0 && v1 == 7) {
+							// t == 0: the vertex is on p1
+							// v1 == 7: p1 on the max corner of the cell
+							// This cell owns the vertex, so it should be created.
+
+							const Vector3i primary = p1;
+							const Vector3f primaryf = to_vec3f(primary);
 							const Vector3f cg1 = get_corner_gradient<TSdf>(
 									corner_data_indices[v1], sdf_data, block_size_with_padding
 							);
-							const Vector3f normal = normalized_not_null(cg0 * t0 + cg1 * t1);
+							const Vector3f normal = normalized_not_null(cg1);
 
 							Vector3f secondary;
 
 							uint8_t vertex_border_mask = 0;
 							if (cell_border_mask > 0) {
 								secondary = get_secondary_position(primaryf, normal, lod_index, block_size);
-								vertex_border_mask =
-										(get_border_mask(p0, block_size_scaled) & get_border_mask(p1, block_size_scaled)
-										);
+								vertex_border_mask = get_border_mask(p1, block_size_scaled);
 							}
 
 							cell_vertex_indices[vertex_index] = output.add_vertex(
 									primaryf, normal, cell_border_mask, vertex_border_mask, 0, secondary
 							);
 
-							material_processor.on_vertex(v0, v1, t1);
+							material_processor.on_vertex(v0, v1, 1.f);
 
-							if (reuse_dir & 8) {
-								// Store the generated vertex so that other cells can reuse it.
-								current_reuse_cell.vertices[reuse_vertex_index] = cell_vertex_indices[vertex_index];
+							current_reuse_cell.vertices[0] = cell_vertex_indices[vertex_index];
+
+						} else {
+							// The vertex is either on p0 or p1.
+							// The original Transvoxel tries to reuse previous vertices in these cases,
+							// however here we don't do it because of ambiguous cases that makes artifacts appear.
+							// It's not a common case so it shouldn't be too bad
+							// (unless you do a lot of grid-aligned shapes?).
+
+							// What do we do if the vertex we would re-use is on a cell that had no triangulation?
+							// The previous cell might have had all corners of the same sign, except one being 0.
+							// Forcing `present=false` seems to fix cases of holes that would be caused by that.
+							// Resetting the cache before processing each deck also works, but is slightly slower.
+							// Otherwise the code would try to re-use a vertex that hasn't been written as re-usable,
+							// so it picks up some garbage from earlier decks.
+	#ifdef VOXEL_TRANSVOXEL_REUSE_VERTEX_ON_COINCIDENT_CASES
+							// A 3-bit direction code leading to the proper cell can easily be obtained by
+							// inverting the 3-bit corner index (bitwise, by exclusive ORing with the number 7).
+							// The corner index depends on the value of t, t = 0 means that we're at the higher
+							// numbered endpoint.
+							const uint8_t reuse_dir = (t == 0 ? v1 ^ 7 : v0 ^ 7);
+							const bool present = (reuse_dir & direction_validity_mask) == reuse_dir;
+
+							// Note: the only difference with similar code above is that we take vertice 0 in the `else`
+							if (present) {
+								const Vector3i cache_pos = pos + dir_to_prev_vec(reuse_dir);
+								const ReuseCell &prev_cell = cache.get_reuse_cell(cache_pos);
+								cell_vertex_indices[vertex_index] = prev_cell.vertices[0];
 							}
-						}
 
-					} else if (t == 0 && v1 == 7) {
-						// t == 0: the vertex is on p1
-						// v1 == 7: p1 on the max corner of the cell
-						// This cell owns the vertex, so it should be created.
+							if (!present || cell_vertex_indices[vertex_index] == -1)
+	#endif
+							{
+								// Create new vertex
 
-						const Vector3i primary = p1;
-						const Vector3f primaryf = to_vec3f(primary);
-						const Vector3f cg1 =
-								get_corner_gradient<TSdf>(corner_data_indices[v1], sdf_data, block_size_with_padding);
-						const Vector3f normal = normalized_not_null(cg1);
+								const unsigned int vi = t == 0 ? v1 : v0;
 
-						Vector3f secondary;
+								const Vector3i primary = t == 0 ? p1 : p0;
+								const Vector3f primaryf = to_vec3f(primary);
+								const Vector3f cg = get_corner_gradient<TSdf>(
+										corner_data_indices[vi], sdf_data, block_size_with_padding
+								);
+								const Vector3f normal = normalized_not_null(cg);
 
-						uint8_t vertex_border_mask = 0;
-						if (cell_border_mask > 0) {
-							secondary = get_secondary_position(primaryf, normal, lod_index, block_size);
-							vertex_border_mask = get_border_mask(p1, block_size_scaled);
-						}
+								// TODO This bit of code is repeated several times, factor it?
+								Vector3f secondary;
 
-						cell_vertex_indices[vertex_index] =
-								output.add_vertex(primaryf, normal, cell_border_mask, vertex_border_mask, 0, secondary);
-
-						material_processor.on_vertex(v0, v1, 1.f);
-
-						current_reuse_cell.vertices[0] = cell_vertex_indices[vertex_index];
-
-					} else {
-						// The vertex is either on p0 or p1.
-						// The original Transvoxel tries to reuse previous vertices in these cases,
-						// however here we don't do it because of ambiguous cases that makes artifacts appear.
-						// It's not a common case so it shouldn't be too bad
-						// (unless you do a lot of grid-aligned shapes?).
-
-						// What do we do if the vertex we would re-use is on a cell that had no triangulation?
-						// The previous cell might have had all corners of the same sign, except one being 0.
-						// Forcing `present=false` seems to fix cases of holes that would be caused by that.
-						// Resetting the cache before processing each deck also works, but is slightly slower.
-						// Otherwise the code would try to re-use a vertex that hasn't been written as re-usable,
-						// so it picks up some garbage from earlier decks.
-#ifdef VOXEL_TRANSVOXEL_REUSE_VERTEX_ON_COINCIDENT_CASES
-						// A 3-bit direction code leading to the proper cell can easily be obtained by
-						// inverting the 3-bit corner index (bitwise, by exclusive ORing with the number 7).
-						// The corner index depends on the value of t, t = 0 means that we're at the higher
-						// numbered endpoint.
-						const uint8_t reuse_dir = (t == 0 ? v1 ^ 7 : v0 ^ 7);
-						const bool present = (reuse_dir & direction_validity_mask) == reuse_dir;
-
-						// Note: the only difference with similar code above is that we take vertice 0 in the `else`
-						if (present) {
-							const Vector3i cache_pos = pos + dir_to_prev_vec(reuse_dir);
-							const ReuseCell &prev_cell = cache.get_reuse_cell(cache_pos);
-							cell_vertex_indices[vertex_index] = prev_cell.vertices[0];
-						}
+								uint8_t vertex_border_mask = 0;
+								if (cell_border_mask > 0) {
+									secondary = get_secondary_position(primaryf, normal, lod_index, block_size);
+									vertex_border_mask = get_border_mask(primary, block_size_scaled);
+								}
 
-						if (!present || cell_vertex_indices[vertex_index] == -1)
-#endif
-						{
-							// Create new vertex
+								cell_vertex_indices[vertex_index] = output.add_vertex(
+										primaryf, normal, cell_border_mask, vertex_border_mask, 0, secondary
+								);
 
-							const unsigned int vi = t == 0 ? v1 : v0;
+								material_processor.on_vertex(v0, v1, 1.f - t);
+							}
+						}
 
-							const Vector3i primary = t == 0 ? p1 : p0;
-							const Vector3f primaryf = to_vec3f(primary);
-							const Vector3f cg = get_corner_gradient<TSdf>(
-									corner_data_indices[vi], sdf_data, block_size_with_padding
-							);
-							const Vector3f normal = normalized_not_null(cg);
+					} // for each cell vertex
 
-							// TODO This bit of code is repeated several times, factor it?
-							Vector3f secondary;
+					const uint32_t effective_triangle_count = triangle_count;
 
-							uint8_t vertex_border_mask = 0;
-							if (cell_border_mask > 0) {
-								secondary = get_secondary_position(primaryf, normal, lod_index, block_size);
-								vertex_border_mask = get_border_mask(primary, block_size_scaled);
-							}
+					for (int t = 0; t < triangle_count; ++t) {
+						const int t0 = t * 3;
 
-							cell_vertex_indices[vertex_index] = output.add_vertex(
-									primaryf, normal, cell_border_mask, vertex_border_mask, 0, secondary
-							);
+						const int i0 = cell_vertex_indices[regular_cell_data.get_vertex_index(t0)];
+						const int i1 = cell_vertex_indices[regular_cell_data.get_vertex_index(t0 + 1)];
+						const int i2 = cell_vertex_indices[regular_cell_data.get_vertex_index(t0 + 2)];
 
-							material_processor.on_vertex(v0, v1, 1.f - t);
+						{
+							// Transvoxel paper: It is possible to generate triangles having zero area when one or more
+							// of the corner sample values for a cell is zero. For example, when we triangulate a cell
+							// for which one corner sample value is zero and the seven remaining corner sample values
+							// are negative, then we generate the single triangle of equivalence class #1 (see Table
+							// 3.2). However, all three vertices lie exactly at the corner having zero sample value.
+							// Such triangles are eliminated after a simple area calculation indicates that they are
+							// degenerate.
+							//
+							// Not fixing this used to work fine actually, but Jolt physics integration makes this
+							// problematic. Jolt checks for degenerate triangles, but instead of just skipping them, it
+							// throws errors. Also, the fact Godot enforces passing a de-indexed mesh through the
+							// Physics3DServer requires Jolt to re-index it. This is not only a waste of time, but also,
+							// Jolt eliminates vertices at the same location or below a hardcoded threshold in the
+							// process. This in turn causes further issues, as degenerate or microscopic triangles cause
+							// the same errors, instead of just being ignored. So a workaround is to actively remove
+							// those triangles here, at the cost of extra CPU work.
+							//
+							// Note, this workaround means there can be unused vertices in the final mesh.
+							// Another workaround could have been to alter the SDF to never have 0, but that would not
+							// cover the case of triangles that are too thin.
+							//
+							// Profiling results, in average time per chunk (16^3). With it: 75 us Without it: 65 us So
+							// fixing the 0.5% of meshes with at least 1 degenerate/superthin triangle isn't negligible
+							// unfortunately.
+							//
+							// About Jolt re-indexing meshes, see PR (abandoned?):
+							// https://github.com/godotengine/godot/pull/72868
+							//
+							// const Vector3f p0 = output.vertices[i0];
+							// const Vector3f p1 = output.vertices[i1];
+							// const Vector3f p2 = output.vertices[i2];
+							// if (math::is_triangle_degenerate_approx(p0, p1, p2, 0.000001f)) {
+							// 	--effective_triangle_count;
+							// 	continue;
+							// }
 						}
-					}
 
-				} // for each cell vertex
-
-				const uint32_t effective_triangle_count = triangle_count;
-
-				for (int t = 0; t < triangle_count; ++t) {
-					const int t0 = t * 3;
-
-					const int i0 = cell_vertex_indices[regular_cell_data.get_vertex_index(t0)];
-					const int i1 = cell_vertex_indices[regular_cell_data.get_vertex_index(t0 + 1)];
-					const int i2 = cell_vertex_indices[regular_cell_data.get_vertex_index(t0 + 2)];
-
-					{
-						// Transvoxel paper:
-						// It is possible to generate triangles having zero area when one or more of the corner sample
-						// values for a cell is zero. For example, when we triangulate a cell for which one corner
-						// sample value is zero and the seven remaining corner sample values are negative, then we
-						// generate the single triangle of equivalence class #1 (see Table 3.2). However, all three
-						// vertices lie exactly at the corner having zero sample value. Such triangles are eliminated
-						// after a simple area calculation indicates that they are degenerate.
-						//
-						// Not fixing this used to work fine actually, but Jolt physics integration makes this
-						// problematic. Jolt checks for degenerate triangles, but instead of just skipping them, it
-						// throws errors. Also, the fact Godot enforces passing a de-indexed mesh through the
-						// Physics3DServer requires Jolt to re-index it. This is not only a waste of time, but also,
-						// Jolt eliminates vertices at the same location or below a hardcoded threshold in the process.
-						// This in turn causes further issues, as degenerate or microscopic triangles cause the
-						// same errors, instead of just being ignored. So a workaround is to actively remove those
-						// triangles here, at the cost of extra CPU work.
-						//
-						// Note, this workaround means there can be unused vertices in the final mesh.
-						// Another workaround could have been to alter the SDF to never have 0, but that would not
-						// cover the case of triangles that are too thin.
-						//
-						// Profiling results, in average time per chunk (16^3).
-						// With it: 75 us
-						// Without it: 65 us
-						// So fixing the 0.5% of meshes with at least 1 degenerate/superthin triangle isn't negligible
-						// unfortunately.
-						//
-						// About Jolt re-indexing meshes, see PR (abandoned?):
-						// https://github.com/godotengine/godot/pull/72868
-						//
-						// const Vector3f p0 = output.vertices[i0];
-						// const Vector3f p1 = output.vertices[i1];
-						// const Vector3f p2 = output.vertices[i2];
-						// if (math::is_triangle_degenerate_approx(p0, p1, p2, 0.000001f)) {
-						// 	--effective_triangle_count;
-						// 	continue;
-						// }
+						output.indices.push_back(i0);
+						output.indices.push_back(i1);
+						output.indices.push_back(i2);
 					}
 
-					output.indices.push_back(i0);
-					output.indices.push_back(i1);
-					output.indices.push_back(i2);
-				}
-
-				if (cell_info != nullptr) {
-					cell_info->push_back(CellInfo{ pos - min_pos, static_cast<uint8_t>(effective_triangle_count) });
-				}
+					if (cell_info != nullptr) {
+						cell_info->push_back(CellInfo{ pos - min_pos, static_cast<uint8_t>(effective_triangle_count) });
+					}
 
-			} // x
-		} // y
+				} // y
+			} // row
+		} // x
 	} // z
 }
 
@@ -1117,6 +1368,13 @@ Span<const T> get_or_decompress_channel(const VoxelBuffer &voxels, StdVector<T>
 		}
 		return to_span_const(backing_buffer);
 
+	} else if (voxels.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE) {
+		backing_buffer.resize(Vector3iUtil::get_volume_u64(voxels.get_size()));
+		voxels.copy_channel_to(
+				to_span(backing_buffer), voxels.get_size(), Vector3i(), Vector3i(), voxels.get_size(), channel
+		);
+		return to_span_const(backing_buffer);
+
 	} else {
 		Span<const uint8_t> data_bytes;
 		ZN_ASSERT(voxels.get_channel_as_bytes_read_only(channel, data_bytes) == true);
@@ -1169,7 +1427,12 @@ StdVector<uint16_t> &get_tls_weights_backing_buffer_u16() {
 	return tls_weights_backing_buffer_u16;
 }
 
-template <typename TMaterialProcessor>
+StdVector<uint16_t> &get_tls_indices_backing_buffer_u16() {
+	thread_local StdVector<uint16_t> tls_indices_backing_buffer_u16;
+	return tls_indices_backing_buffer_u16;
+}
+
+template <typename TMaterialProcessor, bool TLodAttributes>
 inline void build_regular_mesh_dispatch_sd(
 		const VoxelBuffer &voxels,
 		const unsigned int sdf_channel,
@@ -1188,7 +1451,7 @@ inline void build_regular_mesh_dispatch_sd(
 	switch (voxels.get_channel_depth(sdf_channel)) {
 		case VoxelBuffer::DEPTH_8_BIT: {
 			Span<const int8_t> sdf_data = sdf_data_raw.reinterpret_cast_to<const int8_t>();
-			build_regular_mesh<int8_t>(
+			build_regular_mesh<int8_t, TMaterialProcessor, TLodAttributes>(
 					sdf_data,
 					material_processor,
 					voxels.get_size(),
@@ -1202,7 +1465,7 @@ inline void build_regular_mesh_dispatch_sd(
 
 		case VoxelBuffer::DEPTH_16_BIT: {
 			Span<const int16_t> sdf_data = sdf_data_raw.reinterpret_cast_to<const int16_t>();
-			build_regular_mesh<int16_t>(
+			build_regular_mesh<int16_t, TMaterialProcessor, TLodAttributes>(
 					sdf_data,
 					material_processor,
 					voxels.get_size(),
@@ -1219,7 +1482,7 @@ inline void build_regular_mesh_dispatch_sd(
 		// (the optimized obj size for just transvoxel.cpp is 1.2 Mb on Windows)
 		case VoxelBuffer::DEPTH_32_BIT: {
 			Span<const float> sdf_data = sdf_data_raw.reinterpret_cast_to<const float>();
-			build_regular_mesh<float>(
+			build_regular_mesh<float, TMaterialProcessor, TLodAttributes>(
 					sdf_data,
 					material_processor,
 					voxels.get_size(),
@@ -1246,10 +1509,35 @@ inline void build_regular_mesh_dispatch_sd(
 	}
 }
 
+// Selects the instantiation of the mesh builder once per block, so per-cell loops don't have to branch on settings
+template <typename TMaterialProcessor>
+inline void build_regular_mesh_dispatch(
+		const VoxelBuffer &voxels,
+		const unsigned int sdf_channel,
+		TMaterialProcessor material_processor,
+		const uint32_t lod_index,
+		const bool lod_attributes,
+		Cache &cache,
+		MeshArrays &output,
+		StdVector<CellInfo> *cell_infos,
+		const float edge_clamp_margin
+) {
+	if (lod_attributes) {
+		build_regular_mesh_dispatch_sd<TMaterialProcessor, true>(
+				voxels, sdf_channel, material_processor, lod_index, cache, output, cell_infos, edge_clamp_margin
+		);
+	} else {
+		build_regular_mesh_dispatch_sd<TMaterialProcessor, false>(
+				voxels, sdf_channel, material_processor, lod_index, cache, output, cell_infos, edge_clamp_margin
+		);
+	}
+}
+
 DefaultTextureIndicesData build_regular_mesh(
 		const VoxelBuffer &voxels,
 		const unsigned int sdf_channel,
 		const uint32_t lod_index,
+		const bool lod_attributes,
 		const TexturingMode texturing_mode,
 		Cache &cache,
 		MeshArrays &output,
@@ -1269,11 +1557,12 @@ DefaultTextureIndicesData build_regular_mesh(
 
 	switch (texturing_mode) {
 		case TEXTURES_NONE:
-			build_regular_mesh_dispatch_sd(
+			build_regular_mesh_dispatch(
 					voxels,
 					sdf_channel,
 					MaterialProcessorNull{},
 					lod_index,
+					lod_attributes,
 					cache,
 					output,
 					cell_infos,
@@ -1289,28 +1578,46 @@ DefaultTextureIndicesData build_regular_mesh(
 
 				// From this point we know SDF is not uniform so it has an allocated buffer,
 				// but it might have uniform indices or weights so we need to ensure there is a backing buffer.
-				voxel_material_indices =
-						get_texture_indices_data(voxels, VoxelBuffer::CHANNEL_INDICES, default_texture_indices);
+				voxel_material_indices = get_texture_indices_data(
+						voxels,
+						VoxelBuffer::CHANNEL_INDICES,
+						default_texture_indices,
+						get_tls_indices_backing_buffer_u16()
+				);
 				voxel_material_weights.u16_data = get_or_decompress_channel(
 						voxels, get_tls_weights_backing_buffer_u16(), VoxelBuffer::CHANNEL_WEIGHTS
 				);
 				ZN_ASSERT_RETURN_V(voxel_material_weights.u16_data.size() == voxels_count, default_texture_indices);
 			}
-			build_regular_mesh_dispatch_sd(
-					voxels,
-					sdf_channel,
-					MaterialProcessorMixel4<8>(
-							voxel_material_indices,
-							voxel_material_weights,
-							output.texturing_data,
-							textures_ignore_air_voxels
-					),
-					lod_index,
-					cache,
-					output,
-					cell_infos,
-					edge_clamp_margin
-			);
+			if (textures_ignore_air_voxels) {
+				build_regular_mesh_dispatch(
+						voxels,
+						sdf_channel,
+						MaterialProcessorMixel4<8, true>(
+								voxel_material_indices, voxel_material_weights, output.texturing_data
+						),
+						lod_index,
+						lod_attributes,
+						cache,
+						output,
+						cell_infos,
+						edge_clamp_margin
+				);
+			} else {
+				build_regular_mesh_dispatch(
+						voxels,
+						sdf_channel,
+						MaterialProcessorMixel4<8, false>(
+								voxel_material_indices, voxel_material_weights, output.texturing_data
+						),
+						lod_index,
+						lod_attributes,
+						cache,
+						output,
+						cell_infos,
+						edge_clamp_margin
+				);
+			}
 		} break;
 
 		default:
@@ -1425,26 +1732,41 @@ void build_transition_mesh(
 				// From this point we know SDF is not uniform so it has an allocated buffer,
 				// but it might have uniform indices or weights so we need to ensure there is a backing buffer.
 				// TODO Is it worth doing conditionnals instead during meshing?
-				indices_data =
-						get_texture_indices_data(voxels, VoxelBuffer::CHANNEL_INDICES, default_texture_indices_data);
+				indices_data = get_texture_indices_data(
+						voxels,
+						VoxelBuffer::CHANNEL_INDICES,
+						default_texture_indices_data,
+						get_tls_indices_backing_buffer_u16()
+				);
 			}
 			weights_data.u16_data = get_or_decompress_channel(
 					voxels, get_tls_weights_backing_buffer_u16(), VoxelBuffer::CHANNEL_WEIGHTS
 			);
 			ZN_ASSERT_RETURN(weights_data.u16_data.size() == voxels_count);
 
-			build_transition_mesh_dispatch_sd(
-					voxels,
-					sdf_channel,
-					MaterialProcessorMixel4<13>(
-							indices_data, weights_data, output.texturing_data, textures_ignore_air_voxels
-					),
-					direction,
-					lod_index,
-					cache,
-					output,
-					edge_clamp_margin
-			);
+			if (textures_ignore_air_voxels) {
+				build_transition_mesh_dispatch_sd(
+						voxels,
+						sdf_channel,
+						MaterialProcessorMixel4<13, true>(indices_data, weights_data, output.texturing_data),
+						direction,
+						lod_index,
+						cache,
+						output,
+						edge_clamp_margin
+				);
+			} else {
+				build_transition_mesh_dispatch_sd(
+						voxels,
+						sdf_channel,
+						MaterialProcessorMixel4<13, false>(indices_data, weights_data, output.texturing_data),
+						direction,
+						lod_index,
+						cache,
+						output,
+						edge_clamp_margin
+				);
+			}
 		} break;
 
 		default:
@@ -22,6 +22,9 @@ static const unsigned int MAX_TEXTURES = 16;
 static const unsigned int MAX_TEXTURE_BLENDS = 4;
 // Transvoxel guarantees a maximum number of triangle generated for each 2x2x2 cell of voxels.
 static const unsigned int MAX_TRIANGLES_PER_CELL = 5;
+// Cells are grouped in bricks of this size (as a power of two), in order to quickly skip areas where no isosurface
+// can be found
+static const unsigned int SURFACE_BRICK_SIZE_PO2 = 2;
 
 enum TexturingMode {
 	TEXTURES_NONE,
@@ -140,9 +143,15 @@ public:
 		return _cache_2d[j][i];
 	}
 
+	// One boolean per brick of cells, in ZYX order, telling if the brick may contain the isosurface
+	StdVector<uint8_t> &get_surface_bricks() {
+		return _surface_bricks;
+	}
+
 private:
 	FixedArray<StdVector<ReuseCell>, 2> _cache;
 	FixedArray<StdVector<ReuseTransitionCell>, 2> _cache_2d;
+	StdVector<uint8_t> _surface_bricks;
 	Vector3i _block_size;
 };
 
@@ -159,10 +168,13 @@ struct CellInfo {
 	uint32_t triangle_count;
 };
 
+// If `lod_attributes` is false, secondary positions and border masks are left empty. They are only needed when
+// transition meshes are used.
 DefaultTextureIndicesData build_regular_mesh(
 		const VoxelBuffer &voxels,
 		const unsigned int sdf_channel,
 		const uint32_t lod_index,
+		const bool lod_attributes,
 		const TexturingMode texturing_mode,
 		Cache &cache,
 		MeshArrays &output,
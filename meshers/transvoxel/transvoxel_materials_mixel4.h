@@ -202,23 +202,21 @@ inline uint16_t reorder_transition_case_code(const uint16_t case_code) {
 	return alt_case_code;
 }
 
-template <unsigned int NVoxels>
+// `TSkipAirVoxels` is a template parameter so cell processing doesn't branch on it
+template <unsigned int NVoxels, bool TSkipAirVoxels>
 struct MaterialProcessorMixel4 {
 	const TextureIndicesData voxel_material_indices;
 	const WeightSamplerPackedU16 voxel_material_weights;
-	const bool textures_skip_air_voxels;
 	CellTextureDatas<NVoxels> cell_textures;
 	StdVector<Vector2f> &output_mesh_material_data;
 
 	MaterialProcessorMixel4(
 			const TextureIndicesData p_voxel_material_indices,
 			const WeightSamplerPackedU16 p_voxel_material_weights,
-			StdVector<Vector2f> &p_output_mesh_material_data,
-			const bool p_textures_skip_air_voxels
+			StdVector<Vector2f> &p_output_mesh_material_data
 	) :
 			voxel_material_indices(p_voxel_material_indices),
 			voxel_material_weights(p_voxel_material_weights),
-			textures_skip_air_voxels(p_textures_skip_air_voxels),
 			output_mesh_material_data(p_output_mesh_material_data) {}
 
 	inline uint32_t on_cell(const FixedArray<uint32_t, NVoxels> &corner_voxel_indices, const uint8_t case_code) {
@@ -227,14 +225,14 @@ struct MaterialProcessorMixel4 {
 				voxel_material_indices,
 				corner_voxel_indices,
 				voxel_material_weights,
-				textures_skip_air_voxels ? case_code : 0
+				TSkipAirVoxels ? case_code : 0
 		);
 
 		return cell_textures.packed_indices;
 	}
 
 	inline uint32_t on_transition_cell(const FixedArray<uint32_t, 9> &corner_voxel_indices, const uint8_t case_code) {
-		const uint16_t alt_case_code = textures_skip_air_voxels ? reorder_transition_case_code(case_code) : 0;
+		const uint16_t alt_case_code = TSkipAirVoxels ? reorder_transition_case_code(case_code) : 0;
 
 		// Get values from 9 significant corners
 		CellTextureDatas<9> cell_textures_partial;
@@ -274,10 +272,12 @@ struct MaterialProcessorMixel4 {
 	}
 };
 
+// `backing_buffer` is used to decode indices when the channel uses a palette. It must outlive the returned data.
 TextureIndicesData get_texture_indices_data(
 		const VoxelBuffer &voxels,
 		unsigned int channel,
-		DefaultTextureIndicesData &out_default_texture_indices_data
+		DefaultTextureIndicesData &out_default_texture_indices_data,
+		StdVector<uint16_t> &backing_buffer
 ) {
 	ZN_ASSERT_RETURN_V(voxels.get_channel_depth(channel) == VoxelBuffer::DEPTH_16_BIT, TextureIndicesData());
 
@@ -292,6 +292,16 @@ TextureIndicesData get_texture_indices_data(
 		out_default_texture_indices_data.packed_indices = data.packed_default_indices;
 		out_default_texture_indices_data.use = true;
 
+	} else if (voxels.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE) {
+		// Palette indices can't be aliased as raw values
+		backing_buffer.resize(Vector3iUtil::get_volume_u64(voxels.get_size()));
+		voxels.copy_channel_to(
+				to_span(backing_buffer), voxels.get_size(), Vector3i(), Vector3i(), voxels.get_size(), channel
+		);
+		data.buffer = to_span_const(backing_buffer);
+
+		out_default_texture_indices_data.use = false;
+
 	} else {
 		Span<const uint8_t> data_bytes;
 		ZN_ASSERT(voxels.get_channel_as_bytes_read_only(channel, data_bytes) == true);
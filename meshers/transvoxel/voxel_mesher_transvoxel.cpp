@@ -6,6 +6,7 @@
 #include "../../storage/voxel_data.h"
 #include "../../thirdparty/meshoptimizer/meshoptimizer.h"
 #include "../../util/godot/classes/array_mesh.h"
+#include "../../util/godot/classes/mesh.h"
 #include "../../util/godot/classes/rendering_server.h"
 #include "../../util/godot/classes/shader.h"
 #include "../../util/godot/classes/shader_material.h"
@@ -233,10 +234,14 @@ void VoxelMesherTransvoxel::build(VoxelMesher::Output &output, const VoxelMesher
 		cell_infos = &transvoxel::get_tls_cell_infos();
 	}
 
+	// Secondary positions only make room for transition meshes, so they are not computed when there won't be any
+	const bool transitions = _transitions_enabled && input.lod_hint;
+
 	default_texture_indices_data = transvoxel::build_regular_mesh(
 			voxels,
 			sdf_channel,
 			input.lod_index,
+			transitions,
 			static_cast<transvoxel::TexturingMode>(_texture_mode),
 			tls_cache,
 			mesh_arrays,
@@ -255,7 +260,12 @@ void VoxelMesherTransvoxel::build(VoxelMesher::Output &output, const VoxelMesher
 	}
 
 	transvoxel::MeshArrays *combined_mesh_arrays = &mesh_arrays;
-	if (_mesh_optimization_params.enabled) {
+	if (_mesh_optimization_params.enabled && _mesh_optimization_params.deferred && input.deferred_optimization_hint) {
+		// Simplifying takes a lot longer than meshing, the terrain will ask again when the mesh is less likely to
+		// change
+		output.optimization_deferred = true;
+
+	} else if (_mesh_optimization_params.enabled) {
 		// TODO When voxel texturing is enabled, this will decrease quality a lot.
 		// There is no support yet for taking textures into account when simplifying.
 		// See https://github.com/zeux/meshoptimizer/issues/158
@@ -272,7 +282,7 @@ void VoxelMesherTransvoxel::build(VoxelMesher::Output &output, const VoxelMesher
 	output.collision_surface.submesh_vertex_end = combined_mesh_arrays->vertices.size();
 	output.collision_surface.submesh_index_end = combined_mesh_arrays->indices.size();
 
-	if (_transitions_enabled && input.lod_hint) {
+	if (transitions) {
 		// We combine transition meshes with the regular mesh, because it results in less draw calls than if they were
 		// separate. This only requires a vertex shader trick to discard them when neighbors change.
 		ZN_ASSERT(combined_mesh_arrays != nullptr);
@@ -309,6 +319,12 @@ void VoxelMesherTransvoxel::build(VoxelMesher::Output &output, const VoxelMesher
 	if (_texture_mode == TEXTURES_BLEND_4_OVER_16) {
 		output.mesh_flags |= (RenderingServer::ARRAY_CUSTOM_RG_FLOAT << Mesh::ARRAY_FORMAT_CUSTOM1_SHIFT);
 	}
+
+	if (_vertex_compression_enabled) {
+		// Custom attributes used for transitions and texturing are left as they are. Secondary positions are absolute
+		// and their last component holds bits, which would not survive conversion to smaller formats.
+		output.mesh_flags |= get_compressed_attributes_mesh_flag();
+	}
 }
 
 // Only exists for testing
@@ -398,6 +414,14 @@ float VoxelMesherTransvoxel::get_mesh_optimization_target_ratio() const {
 	return _mesh_optimization_params.target_ratio;
 }
 
+void VoxelMesherTransvoxel::set_mesh_optimization_deferred(bool deferred) {
+	_mesh_optimization_params.deferred = deferred;
+}
+
+bool VoxelMesherTransvoxel::is_mesh_optimization_deferred() const {
+	return _mesh_optimization_params.deferred;
+}
+
 void VoxelMesherTransvoxel::set_transitions_enabled(bool enable) {
 	_transitions_enabled = enable;
 }
@@ -418,6 +442,14 @@ float VoxelMesherTransvoxel::get_edge_clamp_margin() const {
 	return _edge_clamp_margin;
 }
 
+void VoxelMesherTransvoxel::set_vertex_compression_enabled(bool enabled) {
+	_vertex_compression_enabled = enabled;
+}
+
+bool VoxelMesherTransvoxel::is_vertex_compression_enabled() const {
+	return _vertex_compression_enabled;
+}
+
 void VoxelMesherTransvoxel::_bind_methods() {
 	using Self = VoxelMesherTransvoxel;
 
@@ -444,12 +476,20 @@ void VoxelMesherTransvoxel::_bind_methods() {
 	);
 	ClassDB::bind_method(D_METHOD("get_mesh_optimization_target_ratio"), &Self::get_mesh_optimization_target_ratio);
 
+	ClassDB::bind_method(D_METHOD("set_mesh_optimization_deferred", "deferred"), &Self::set_mesh_optimization_deferred);
+	ClassDB::bind_method(D_METHOD("is_mesh_optimization_deferred"), &Self::is_mesh_optimization_deferred);
+
 	ClassDB::bind_method(D_METHOD("set_transitions_enabled", "enabled"), &Self::set_transitions_enabled);
 	ClassDB::bind_method(D_METHOD("get_transitions_enabled"), &Self::get_transitions_enabled);
 
 	ClassDB::bind_method(D_METHOD("get_edge_clamp_margin"), &Self::get_edge_clamp_margin);
 	ClassDB::bind_method(D_METHOD("set_edge_clamp_margin", "margin"), &Self::set_edge_clamp_margin);
 
+	ClassDB::bind_method(
+			D_METHOD("set_vertex_compression_enabled", "enabled"), &Self::set_vertex_compression_enabled
+	);
+	ClassDB::bind_method(D_METHOD("is_vertex_compression_enabled"), &Self::is_vertex_compression_enabled);
+
 	ADD_GROUP("Materials", "");
 
 	ADD_PROPERTY(
@@ -481,6 +521,11 @@ void VoxelMesherTransvoxel::_bind_methods() {
 			"set_mesh_optimization_target_ratio",
 			"get_mesh_optimization_target_ratio"
 	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "mesh_optimization_deferred"),
+			"set_mesh_optimization_deferred",
+			"is_mesh_optimization_deferred"
+	);
 
 	ADD_GROUP("Advanced", "");
 
@@ -490,6 +535,12 @@ void VoxelMesherTransvoxel::_bind_methods() {
 
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "edge_clamp_margin"), "set_edge_clamp_margin", "get_edge_clamp_margin");
 
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "vertex_compression_enabled"),
+			"set_vertex_compression_enabled",
+			"is_vertex_compression_enabled"
+	);
+
 	BIND_ENUM_CONSTANT(TEXTURES_NONE);
 	// TODO Rename MIXEL
 	BIND_ENUM_CONSTANT(TEXTURES_BLEND_4_OVER_16);
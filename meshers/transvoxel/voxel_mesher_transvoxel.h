@@ -48,12 +48,18 @@ public:
 	void set_mesh_optimization_target_ratio(float ratio);
 	float get_mesh_optimization_target_ratio() const;
 
+	void set_mesh_optimization_deferred(bool deferred);
+	bool is_mesh_optimization_deferred() const;
+
 	void set_transitions_enabled(bool enable);
 	bool get_transitions_enabled() const;
 
 	void set_edge_clamp_margin(float margin);
 	float get_edge_clamp_margin() const;
 
+	void set_vertex_compression_enabled(bool enabled);
+	bool is_vertex_compression_enabled() const;
+
 	Ref<ShaderMaterial> get_default_lod_material() const override;
 
 	// Internal
@@ -87,6 +93,8 @@ private:
 		bool enabled = false;
 		float error_threshold = 0.005;
 		float target_ratio = 0.0;
+		// Terrains supporting it first get unoptimized meshes, and optimized ones later
+		bool deferred = false;
 	};
 
 	MeshOptimizationParams _mesh_optimization_params;
@@ -100,6 +108,9 @@ private:
 	bool _transitions_enabled = true;
 
 	bool _textures_ignore_air_voxels = false;
+
+	// Positions and normals of meshes are stored in 16-bit formats on the GPU instead of floats
+	bool _vertex_compression_enabled = false;
 };
 
 } // namespace zylann::voxel
@@ -35,6 +35,8 @@ Ref<Mesh> VoxelMesher::build_mesh(
 		detail_texture_settings.enabled = additional_data.get("normalmap_enabled", false);
 		detail_texture_settings.octahedral_encoding_enabled =
 				additional_data.get("octahedral_normal_encoding_enabled", false);
+		detail_texture_settings.bc5_compression_enabled =
+				additional_data.get("normalmap_bc5_compression_enabled", false);
 		detail_texture_settings.tile_resolution_min = int(additional_data.get("normalmap_tile_resolution", 16));
 		detail_texture_settings.tile_resolution_max = detail_texture_settings.tile_resolution_min;
 		detail_texture_settings.max_deviation_degrees = math::clamp(
@@ -76,7 +78,7 @@ Ref<Mesh> VoxelMesher::build_mesh(
 			material = get_material_by_index(surface.material_index);
 		}
 
-		mesh->add_surface_from_arrays(output.primitive_type, arrays, Array(), Dictionary(), output.mesh_flags);
+		add_surface_from_arrays(**mesh, output.primitive_type, arrays, output.mesh_flags);
 		mesh->surface_set_material(gd_surface_index, material);
 		++gd_surface_index;
 	}
@@ -104,7 +106,8 @@ Ref<Mesh> VoxelMesher::build_mesh(
 					input.lod_index,
 					detail_texture_settings.octahedral_encoding_enabled,
 					math::deg_to_rad(float(detail_texture_settings.max_deviation_degrees)),
-					false
+					false,
+					nullptr
 			);
 
 			const Vector3i block_size =
@@ -114,7 +117,8 @@ Ref<Mesh> VoxelMesher::build_mesh(
 					nm_data,
 					detail_texture_settings.tile_resolution_min,
 					block_size,
-					detail_texture_settings.octahedral_encoding_enabled
+					detail_texture_settings.octahedral_encoding_enabled,
+					detail_texture_settings.bc5_compression_enabled
 			);
 
 			const DetailTextures textures = store_normalmap_data_to_textures(images);
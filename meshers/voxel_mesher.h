@@ -2,6 +2,7 @@
 #define VOXEL_MESHER_H
 
 #include "../constants/cube_tables.h"
+#include "../terrain/occlusion_culling.h"
 #include "../util/containers/fixed_array.h"
 #include "../util/containers/span.h"
 #include "../util/containers/std_vector.h"
@@ -45,6 +46,12 @@ public:
 		// If true, the mesher can collect some extra information which can be useful to speed up detail texture
 		// baking. Depends on the mesher.
 		bool detail_texture_hint = false;
+		// If true, only collisions will be used, so the mesher may build a simpler collision surface that doesn't
+		// follow the rendering mesh closely. Depends on the mesher.
+		bool simplified_collision_hint = false;
+		// If true, the mesher may skip costly optimizations so the mesh is available sooner, and set
+		// `optimization_deferred` in the output. The caller can then build the mesh again later without this hint.
+		bool deferred_optimization_hint = false;
 	};
 
 	struct Output {
@@ -71,6 +78,13 @@ public:
 
 		Array shadow_occluder;
 
+		// Which pairs of sides of the block can see each other through the voxels, used for occlusion culling (see
+		// `occlusion_culling.h`). Meshers that don't calculate it leave all sides connected.
+		uint16_t side_connectivity = occlusion_culling::SIDE_CONNECTIVITY_ALL;
+
+		// True if optimizations were skipped due to `deferred_optimization_hint`
+		bool optimization_deferred = false;
+
 		// May be used to store extra information needed in shader to render the mesh properly
 		// (currently used only by the cubes mesher when baking colors)
 		Ref<Image> atlas_image;
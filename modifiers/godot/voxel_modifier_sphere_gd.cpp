@@ -20,6 +20,7 @@ void VoxelModifierSphere::set_radius(float r) {
 	ZN_ASSERT_RETURN(sphere != nullptr);
 	const AABB prev_aabb = sphere->get_aabb();
 	sphere->set_radius(r);
+	update_modifier_aabb(*_volume, _modifier_id);
 	const AABB new_aabb = sphere->get_aabb();
 	post_edit_modifier(*_volume, prev_aabb);
 	post_edit_modifier(*_volume, new_aabb);
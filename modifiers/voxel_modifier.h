@@ -5,6 +5,7 @@
 #include "../util/containers/fixed_array.h"
 #include "../util/math/transform_3d.h"
 #include "../util/math/vector3f.h"
+#include "../util/math/vector3i.h"
 #include "../util/thread/rw_lock.h"
 
 namespace zylann::voxel {
@@ -12,6 +13,13 @@ namespace zylann::voxel {
 struct VoxelModifierContext {
 	Span<float> sdf; // Signed distance values to modify
 	Span<const Vector3f> positions; // Positions associated to each signed distance
+
+	// When positions are voxels of a block in ZXY order, this is the LOD of the block, so modifiers can use data they
+	// cached for that LOD instead of sampling each position. -1 if positions are arbitrary.
+	int lod_index = -1;
+	// Position of the first voxel and size of the grid, in voxels of the LOD
+	Vector3i grid_origin;
+	Vector3i grid_size;
 };
 
 class VoxelModifier {
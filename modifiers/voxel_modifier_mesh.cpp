@@ -3,10 +3,23 @@
 #include "../engine/voxel_engine.h"
 #include "../util/godot/core/packed_arrays.h"
 #include "../util/math/conv.h"
+#include "../util/memory/memory.h"
 #include "../util/profiling.h"
 
 namespace zylann::voxel {
 
+namespace {
+
+// Above this amount of voxels, the shape is sampled directly instead of cached
+const unsigned int MAX_LOD_CACHE_VOLUME = 128 * 128 * 128;
+
+StdVector<float> &get_tls_shape_sdf() {
+	thread_local StdVector<float> tls_shape_sdf;
+	return tls_shape_sdf;
+}
+
+} // namespace
+
 void VoxelModifierMesh::set_mesh_sdf(Ref<VoxelMeshSDF> mesh_sdf) {
 	// ZN_ASSERT_RETURN(buffer != nullptr);
 	RWLockWrite wlock(_rwlock);
@@ -21,6 +34,7 @@ void VoxelModifierMesh::set_isolevel(float isolevel) {
 		return;
 	}
 	_isolevel = isolevel;
+	clear_lod_caches();
 }
 
 inline float get_largest_coord(Vector3 v) {
@@ -62,18 +76,48 @@ void VoxelModifierMesh::apply(VoxelModifierContext ctx) const {
 	shape.sdf_scale = get_largest_coord(model_to_world.get_basis().get_scale());
 	shape.world_to_buffer = buffer_to_world.affine_inverse();
 
+	StdVector<float> &shape_sdf = get_tls_shape_sdf();
+	shape_sdf.resize(ctx.sdf.size());
+
+	std::shared_ptr<const LodCache> cache;
+	if (ctx.lod_index >= 0) {
+		cache = get_or_create_lod_cache(ctx.lod_index, shape);
+	}
+
+	const Box3i grid_box(ctx.grid_origin, ctx.grid_size);
+
+	if (cache != nullptr && cache->box.contains(grid_box) &&
+		Vector3iUtil::get_volume_u64(grid_box.size) == ctx.sdf.size()) {
+		// Copy rows of cached values
+		const Vector3i cache_origin = cache->box.position;
+		const Vector3i cache_size = cache->box.size;
+		unsigned int i = 0;
+		Vector3i pos;
+		for (pos.z = 0; pos.z < grid_box.size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < grid_box.size.x; ++pos.x) {
+				const unsigned int cache_index =
+						Vector3iUtil::get_zxy_index(grid_box.position + pos - cache_origin, cache_size);
+				memcpy(&shape_sdf[i], &cache->sdf[cache_index], grid_box.size.y * sizeof(float));
+				i += grid_box.size.y;
+			}
+		}
+
+	} else {
+		for (unsigned int i = 0; i < ctx.sdf.size(); ++i) {
+			shape_sdf[i] = shape(ctx.positions[i]);
+		}
+	}
+
 	switch (get_operation()) {
 		case OP_ADD:
 			for (unsigned int i = 0; i < ctx.sdf.size(); ++i) {
-				const float sd = shape(ctx.positions[i]);
-				ctx.sdf[i] = math::sdf_smooth_union(ctx.sdf[i], sd, smoothness);
+				ctx.sdf[i] = math::sdf_smooth_union(ctx.sdf[i], shape_sdf[i], smoothness);
 			}
 			break;
 
 		case OP_SUBTRACT:
 			for (unsigned int i = 0; i < ctx.sdf.size(); ++i) {
-				const float sd = shape(ctx.positions[i]);
-				ctx.sdf[i] = math::sdf_smooth_subtract(ctx.sdf[i], sd, smoothness);
+				ctx.sdf[i] = math::sdf_smooth_subtract(ctx.sdf[i], shape_sdf[i], smoothness);
 			}
 			break;
 
@@ -82,8 +126,66 @@ void VoxelModifierMesh::apply(VoxelModifierContext ctx) const {
 	}
 }
 
+std::shared_ptr<const VoxelModifierMesh::LodCache> VoxelModifierMesh::get_or_create_lod_cache(
+		unsigned int lod_index,
+		const ops::SdfBufferShape &shape
+) const {
+	ZN_ASSERT_RETURN_V(lod_index < _lod_caches.size(), nullptr);
+	{
+		MutexLock mlock(_lod_caches_mutex);
+		const std::shared_ptr<const LodCache> &cache = _lod_caches[lod_index];
+		if (cache != nullptr) {
+			return cache;
+		}
+	}
+
+	// Cover the AABB with voxels of the LOD
+	const int step = 1 << lod_index;
+	const Vector3i min_pos = math::floor_to_int(_aabb.position / step);
+	const Vector3i max_pos = math::ceil_to_int((_aabb.position + _aabb.size) / step) + Vector3i(1, 1, 1);
+	const Box3i box = Box3i::from_min_max(min_pos, max_pos);
+	if (Vector3iUtil::get_volume_u64(box.size) > MAX_LOD_CACHE_VOLUME) {
+		return nullptr;
+	}
+
+	ZN_PROFILE_SCOPE_NAMED("Create mesh modifier cache");
+
+	std::shared_ptr<LodCache> cache = make_shared_instance<LodCache>();
+	cache->box = box;
+	cache->sdf.resize(Vector3iUtil::get_volume_u64(box.size));
+
+	// Positions of voxels of generated blocks
+	unsigned int i = 0;
+	Vector3i pos;
+	for (pos.z = box.position.z; pos.z < box.position.z + box.size.z; ++pos.z) {
+		for (pos.x = box.position.x; pos.x < box.position.x + box.size.x; ++pos.x) {
+			for (pos.y = box.position.y; pos.y < box.position.y + box.size.y; ++pos.y) {
+				cache->sdf[i] = shape(to_vec3f(pos * step));
+				++i;
+			}
+		}
+	}
+
+	MutexLock mlock(_lod_caches_mutex);
+	std::shared_ptr<const LodCache> &cache_slot = _lod_caches[lod_index];
+	// Another thread may have created it in the meantime
+	if (cache_slot == nullptr) {
+		cache_slot = cache;
+	}
+	return cache_slot;
+}
+
+void VoxelModifierMesh::clear_lod_caches() {
+	MutexLock mlock(_lod_caches_mutex);
+	for (std::shared_ptr<const LodCache> &cache : _lod_caches) {
+		cache.reset();
+	}
+}
+
 void VoxelModifierMesh::update_aabb() {
 	// ZN_ASSERT_RETURN(_mesh_sdf.is_valid());
+	// Transform or shape changed
+	clear_lod_caches();
 	if (_mesh_sdf.is_null()) {
 		return;
 	}
@@ -1,11 +1,21 @@
 #ifndef VOXEL_MODIFIER_MESH_H
 #define VOXEL_MODIFIER_MESH_H
 
+#include "../constants/voxel_constants.h"
 #include "../edition/voxel_mesh_sdf_gd.h"
+#include "../util/containers/fixed_array.h"
+#include "../util/containers/std_vector.h"
+#include "../util/math/box3i.h"
+#include "../util/thread/mutex.h"
 #include "voxel_modifier_sdf.h"
+#include <memory>
 
 namespace zylann::voxel {
 
+namespace ops {
+struct SdfBufferShape;
+}
+
 class VoxelModifierMesh : public VoxelModifierSdf {
 public:
 	Type get_type() const override {
@@ -22,10 +32,31 @@ protected:
 	void update_aabb() override;
 
 private:
+	// Signed distances of the shape resampled at every voxel of a LOD, so blocks generated again at that LOD don't
+	// have to transform and interpolate the mesh SDF for each of their voxels
+	struct LodCache {
+		// Area covered by the cache, in voxels of the LOD
+		Box3i box;
+		// Values in ZXY order, including isolevel
+		StdVector<float> sdf;
+	};
+
+	std::shared_ptr<const LodCache> get_or_create_lod_cache(
+			unsigned int lod_index,
+			const ops::SdfBufferShape &shape
+	) const;
+
+	void clear_lod_caches();
+
 	// Originally I wanted to keep the core of modifiers separate from Godot stuff, but in order to also support
 	// GPU resources, putting this here was easier.
 	Ref<VoxelMeshSDF> _mesh_sdf;
 	float _isolevel;
+
+	// Caches are created by threads applying the modifier, and cleared when the shape changes, which happens with
+	// `_rwlock` locked for writing.
+	mutable FixedArray<std::shared_ptr<const LodCache>, constants::MAX_LOD> _lod_caches;
+	Mutex _lod_caches_mutex;
 };
 
 } // namespace zylann::voxel
@@ -2,6 +2,7 @@
 #include "../edition/funcs.h"
 #include "../util/dstack.h"
 #include "../util/profiling.h"
+#include <algorithm>
 
 namespace zylann::voxel {
 
@@ -17,6 +18,11 @@ StdVector<Vector3f> &get_tls_positions() {
 	return tls_positions;
 }
 
+StdVector<VoxelModifier *> &get_tls_modifiers() {
+	thread_local StdVector<VoxelModifier *> tls_modifiers;
+	return tls_modifiers;
+}
+
 void get_positions_buffer(Vector3i buffer_size, Vector3f origin, Vector3f size, StdVector<Vector3f> &positions) {
 	positions.resize(Vector3iUtil::get_volume_u64(buffer_size));
 
@@ -102,6 +108,12 @@ void decompress_sdf_to_buffer(VoxelBuffer &voxels, StdVector<float> &sdf) {
 			}
 		} break;
 
+		case VoxelBuffer::DEPTH_1_BIT:
+		case VoxelBuffer::DEPTH_2_BIT:
+		case VoxelBuffer::DEPTH_4_BIT:
+			voxels.get_channel_f(channel, to_span(sdf));
+			break;
+
 		default:
 			ZN_CRASH();
 	}
@@ -112,6 +124,77 @@ void decompress_sdf_to_buffer(VoxelBuffer &voxels, StdVector<float> &sdf) {
 	}
 }
 
+// Applies modifiers to the area of the grid intersecting each of them. `v_to_w` is the size of a voxel in world space.
+void apply_modifiers_to_grid(
+		Span<const VoxelModifier *const> modifiers,
+		Span<float> grid_sdf,
+		Vector3i grid_origin,
+		Vector3i grid_size,
+		Vector3 v_to_w,
+		int lod_index
+) {
+	StdVector<float> &area_sdf = get_tls_sdf();
+	StdVector<Vector3f> &area_positions = get_tls_positions();
+
+	const Vector3 w_to_v = Vector3(1, 1, 1) / v_to_w;
+	const AABB aabb(v_to_w * Vector3(grid_origin), v_to_w * Vector3(grid_size));
+
+	VoxelModifierContext ctx;
+	ctx.lod_index = lod_index;
+
+	for (const VoxelModifier *modifier : modifiers) {
+		ZN_ASSERT(modifier != nullptr);
+
+		const AABB modifier_aabb = modifier->get_aabb();
+		if (!modifier_aabb.intersects(aabb)) {
+			continue;
+		}
+		ZN_PROFILE_SCOPE_NAMED("Intersecting modifier");
+
+		// Get modifier bounds in voxels
+		Box3i modifier_box(math::floor(modifier_aabb.position * w_to_v), math::ceil(modifier_aabb.size * w_to_v));
+		modifier_box.clip(Box3i(grid_origin, grid_size));
+		const Vector3i local_origin_in_voxels = modifier_box.position - grid_origin;
+
+		const size_t volume = Vector3iUtil::get_volume_u64(modifier_box.size);
+		area_sdf.resize(volume);
+		copy_3d_region_zxy(
+				to_span(area_sdf),
+				modifier_box.size,
+				Vector3i(),
+				Span<const float>(grid_sdf),
+				grid_size,
+				local_origin_in_voxels,
+				local_origin_in_voxels + modifier_box.size
+		);
+
+		get_positions_buffer(
+				modifier_box.size,
+				to_vec3f(v_to_w * modifier_box.position),
+				to_vec3f(v_to_w * modifier_box.size),
+				area_positions
+		);
+
+		ctx.positions = to_span(area_positions);
+		ctx.sdf = to_span(area_sdf);
+		ctx.grid_origin = modifier_box.position;
+		ctx.grid_size = modifier_box.size;
+		modifier->apply(ctx);
+
+		// Write modifications back to the full grid
+		// TODO Maybe use an unchecked version for a bit more speed?
+		copy_3d_region_zxy(
+				grid_sdf,
+				grid_size,
+				local_origin_in_voxels,
+				Span<const float>(ctx.sdf),
+				modifier_box.size,
+				Vector3i(),
+				modifier_box.size
+		);
+	}
+}
+
 } // namespace
 
 VoxelModifierStack::VoxelModifierStack() {}
@@ -132,8 +215,12 @@ void VoxelModifierStack::move_from_noclear(VoxelModifierStack &other) {
 		RWLockRead rlock(other._stack_lock);
 		_modifiers = std::move(other._modifiers);
 		_stack = std::move(other._stack);
+		_tree = std::move(other._tree);
+		// The moved tree would otherwise keep its root
+		other._tree.clear();
 	}
 	_next_id = other._next_id;
+	_next_order = other._next_order;
 }
 
 uint32_t VoxelModifierStack::allocate_id() {
@@ -146,7 +233,8 @@ void VoxelModifierStack::remove_modifier(uint32_t id) {
 	auto map_it = _modifiers.find(id);
 	ZN_ASSERT_RETURN(map_it != _modifiers.end());
 
-	const VoxelModifier *ptr = map_it->second.get();
+	const VoxelModifier *ptr = map_it->second.modifier.get();
+	_tree.remove(map_it->second.tree_leaf_id);
 	for (auto stack_it = _stack.begin(); stack_it != _stack.end(); ++stack_it) {
 		if (*stack_it == ptr) {
 			_stack.erase(stack_it);
@@ -164,11 +252,49 @@ bool VoxelModifierStack::has_modifier(uint32_t id) const {
 VoxelModifier *VoxelModifierStack::get_modifier(uint32_t id) const {
 	auto it = _modifiers.find(id);
 	if (it != _modifiers.end()) {
-		return it->second.get();
+		return it->second.modifier.get();
 	}
 	return nullptr;
 }
 
+void VoxelModifierStack::update_modifier_aabb(uint32_t id) {
+	RWLockWrite lock(_stack_lock);
+	auto it = _modifiers.find(id);
+	ZN_ASSERT_RETURN(it != _modifiers.end());
+	const ModifierInfo &info = it->second;
+	_tree.update(info.tree_leaf_id, info.modifier->get_aabb());
+}
+
+bool VoxelModifierStack::has_modifiers_in_aabb(AABB aabb) const {
+	RWLockRead lock(_stack_lock);
+	bool found = false;
+	_tree.query(aabb, [&found](uint32_t id) { found = true; });
+	return found;
+}
+
+void VoxelModifierStack::get_modifiers_in_aabb(AABB aabb, StdVector<VoxelModifier *> &out_modifiers) const {
+	// Must be called while holding the stack lock
+
+	static thread_local StdVector<std::pair<uint32_t, VoxelModifier *>> tls_found;
+	StdVector<std::pair<uint32_t, VoxelModifier *>> &found = tls_found;
+	found.clear();
+
+	_tree.query(aabb, [this, &found](uint32_t id) {
+		auto it = _modifiers.find(id);
+		ZN_ASSERT_RETURN(it != _modifiers.end());
+		const ModifierInfo &info = it->second;
+		found.push_back({ info.order, info.modifier.get() });
+	});
+
+	// The tree doesn't preserve order
+	std::sort(found.begin(), found.end());
+
+	out_modifiers.clear();
+	for (const std::pair<uint32_t, VoxelModifier *> &item : found) {
+		out_modifiers.push_back(item.second);
+	}
+}
+
 void VoxelModifierStack::apply(VoxelBuffer &voxels, AABB aabb) const {
 	ZN_PROFILE_SCOPE();
 	RWLockRead lock(_stack_lock);
@@ -177,8 +303,20 @@ void VoxelModifierStack::apply(VoxelBuffer &voxels, AABB aabb) const {
 		return;
 	}
 
-	VoxelModifierContext ctx;
+	StdVector<VoxelModifier *> &modifiers = get_tls_modifiers();
+	get_modifiers_in_aabb(aabb, modifiers);
+
 	bool any_intersection = false;
+	for (const VoxelModifier *modifier : modifiers) {
+		ZN_ASSERT(modifier != nullptr);
+		if (modifier->get_aabb().intersects(aabb)) {
+			any_intersection = true;
+			break;
+		}
+	}
+	if (!any_intersection) {
+		return;
+	}
 
 	// This version can be slower because we are trying to workaround a side-effect of fixed-point compression.
 	// Processing through the whole block is easier, but it can introduce artifacts because scaling and applying
@@ -191,78 +329,58 @@ void VoxelModifierStack::apply(VoxelBuffer &voxels, AABB aabb) const {
 	thread_local StdVector<float> tls_block_sdf_initial;
 	thread_local StdVector<float> tls_block_sdf;
 
-	StdVector<float> &area_sdf = get_tls_sdf();
-	StdVector<Vector3f> &area_positions = get_tls_positions();
-
 	const Vector3 v_to_w = aabb.size / Vector3(voxels.get_size());
 	const Vector3 w_to_v = Vector3(voxels.get_size()) / aabb.size;
 	const Vector3i origin_voxels = Vector3i(math::floor(aabb.position * w_to_v));
 
-	for (unsigned int i = 0; i < _stack.size(); ++i) {
-		const VoxelModifier *modifier = _stack[i];
-		ZN_ASSERT(modifier != nullptr);
+	// Blocks are sampled with a power-of-two step depending on their LOD
+	int lod_index = -1;
+	const int step = static_cast<int>(v_to_w.x);
+	if (step >= 1 && Vector3(step, step, step) == v_to_w && math::is_power_of_two(step)) {
+		const unsigned int step_po2 = math::get_shift_from_power_of_two_32(step);
+		if (step_po2 < constants::MAX_LOD) {
+			lod_index = step_po2;
+		}
+	}
 
-		const AABB modifier_aabb = modifier->get_aabb();
-		if (modifier_aabb.intersects(aabb)) {
-			ZN_PROFILE_SCOPE_NAMED("Intersecting modifier");
+	{
+		ZN_PROFILE_SCOPE_NAMED("Read block");
+		decompress_sdf_to_buffer(voxels, tls_block_sdf_initial);
 
-			if (any_intersection == false) {
-				ZN_PROFILE_SCOPE_NAMED("Read block");
-				any_intersection = true;
+		tls_block_sdf.resize(tls_block_sdf_initial.size());
+		memcpy(tls_block_sdf.data(), tls_block_sdf_initial.data(), tls_block_sdf.size() * sizeof(float));
+	}
 
-				decompress_sdf_to_buffer(voxels, tls_block_sdf_initial);
+	apply_modifiers_to_grid(
+			to_span(modifiers), to_span(tls_block_sdf), origin_voxels, voxels.get_size(), v_to_w, lod_index
+	);
 
-				tls_block_sdf.resize(tls_block_sdf_initial.size());
-				memcpy(tls_block_sdf.data(), tls_block_sdf_initial.data(), tls_block_sdf.size() * sizeof(float));
-			}
+	// scale_and_store_sdf(voxels, to_span(tls_block_sdf));
+	scale_and_store_sdf_if_modified(voxels, to_span(tls_block_sdf), to_span(tls_block_sdf_initial));
+	voxels.compress_uniform_channels();
+}
 
-			// Get modifier bounds in voxels
-			Box3i modifier_box(math::floor(modifier_aabb.position * w_to_v), math::ceil(modifier_aabb.size * w_to_v));
-			modifier_box.clip(Box3i(origin_voxels, voxels.get_size()));
-			const Vector3i local_origin_in_voxels = modifier_box.position - origin_voxels;
-
-			const size_t volume = Vector3iUtil::get_volume_u64(modifier_box.size);
-			area_sdf.resize(volume);
-			copy_3d_region_zxy(
-					to_span(area_sdf),
-					modifier_box.size,
-					Vector3i(),
-					to_span_const(tls_block_sdf),
-					voxels.get_size(),
-					local_origin_in_voxels,
-					local_origin_in_voxels + modifier_box.size
-			);
-
-			get_positions_buffer(
-					modifier_box.size,
-					to_vec3f(v_to_w * modifier_box.position),
-					to_vec3f(v_to_w * modifier_box.size),
-					area_positions
-			);
-
-			ctx.positions = to_span(area_positions);
-			ctx.sdf = to_span(area_sdf);
-			modifier->apply(ctx);
+void VoxelModifierStack::apply_to_grid(
+		Span<float> sdf,
+		Vector3i grid_origin,
+		Vector3i grid_size,
+		unsigned int lod_index
+) const {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(Vector3iUtil::get_volume_u64(grid_size) == sdf.size());
+	RWLockRead lock(_stack_lock);
 
-			// Write modifications back to the full-block decompressed buffer
-			// TODO Maybe use an unchecked version for a bit more speed?
-			copy_3d_region_zxy(
-					to_span(tls_block_sdf),
-					voxels.get_size(),
-					local_origin_in_voxels,
-					Span<const float>(ctx.sdf),
-					modifier_box.size,
-					Vector3i(),
-					modifier_box.size
-			);
-		}
+	if (_stack.size() == 0) {
+		return;
 	}
 
-	if (any_intersection) {
-		// scale_and_store_sdf(voxels, to_span(tls_block_sdf));
-		scale_and_store_sdf_if_modified(voxels, to_span(tls_block_sdf), to_span(tls_block_sdf_initial));
-		voxels.compress_uniform_channels();
-	}
+	const int step = 1 << lod_index;
+	const AABB aabb(Vector3(grid_origin * step), Vector3(grid_size * step));
+
+	StdVector<VoxelModifier *> &modifiers = get_tls_modifiers();
+	get_modifiers_in_aabb(aabb, modifiers);
+
+	apply_modifiers_to_grid(to_span(modifiers), sdf, grid_origin, grid_size, Vector3(step, step, step), lod_index);
 }
 
 void VoxelModifierStack::apply(float &sdf, Vector3f position) const {
@@ -279,8 +397,10 @@ void VoxelModifierStack::apply(float &sdf, Vector3f position) const {
 
 	const AABB aabb(to_vec3(position), Vector3(1, 1, 1));
 
-	for (unsigned int i = 0; i < _stack.size(); ++i) {
-		const VoxelModifier *modifier = _stack[i];
+	StdVector<VoxelModifier *> &modifiers = get_tls_modifiers();
+	get_modifiers_in_aabb(aabb, modifiers);
+
+	for (const VoxelModifier *modifier : modifiers) {
 		ZN_ASSERT(modifier != nullptr);
 
 		if (modifier->get_aabb().intersects(aabb)) {
@@ -310,8 +430,10 @@ void VoxelModifierStack::apply(
 
 	const AABB aabb(to_vec3(min_pos), to_vec3(max_pos - min_pos));
 
-	for (unsigned int i = 0; i < _stack.size(); ++i) {
-		const VoxelModifier *modifier = _stack[i];
+	StdVector<VoxelModifier *> &modifiers = get_tls_modifiers();
+	get_modifiers_in_aabb(aabb, modifiers);
+
+	for (const VoxelModifier *modifier : modifiers) {
 		ZN_ASSERT(modifier != nullptr);
 
 		if (modifier->get_aabb().intersects(aabb)) {
@@ -332,8 +454,10 @@ void VoxelModifierStack::apply_for_gpu_rendering(
 		return;
 	}
 
-	for (unsigned int i = 0; i < _stack.size(); ++i) {
-		VoxelModifier *modifier = _stack[i];
+	StdVector<VoxelModifier *> &modifiers = get_tls_modifiers();
+	get_modifiers_in_aabb(aabb, modifiers);
+
+	for (VoxelModifier *modifier : modifiers) {
 		ZN_ASSERT(modifier != nullptr);
 
 		if (modifier->get_aabb().intersects(aabb)) {
@@ -349,6 +473,7 @@ void VoxelModifierStack::apply_for_gpu_rendering(
 void VoxelModifierStack::clear() {
 	RWLockWrite lock(_stack_lock);
 	_stack.clear();
+	_tree.clear();
 	_modifiers.clear();
 }
 
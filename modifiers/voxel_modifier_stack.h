@@ -3,6 +3,7 @@
 
 #include "../util/containers/std_unordered_map.h"
 #include "../util/containers/std_vector.h"
+#include "../util/math/aabb_tree.h"
 #include "../util/math/vector3f.h"
 #include "../util/memory/memory.h"
 #include "voxel_modifier.h"
@@ -23,10 +24,14 @@ public:
 	template <typename T>
 	T *add_modifier(uint32_t id) {
 		ZN_ASSERT(!has_modifier(id));
-		UniquePtr<VoxelModifier> &uptr = _modifiers[id];
-		uptr = make_unique_instance<T>();
-		VoxelModifier *ptr = uptr.get();
+		// Queries look up modifiers from threads
 		RWLockWrite lock(_stack_lock);
+		ModifierInfo &info = _modifiers[id];
+		info.modifier = make_unique_instance<T>();
+		VoxelModifier *ptr = info.modifier.get();
+		info.order = _next_order;
+		++_next_order;
+		info.tree_leaf_id = _tree.add(ptr->get_aabb(), id);
 		_stack.push_back(ptr);
 		return static_cast<T *>(ptr);
 	}
@@ -34,9 +39,19 @@ public:
 	void remove_modifier(uint32_t id);
 	bool has_modifier(uint32_t id) const;
 	VoxelModifier *get_modifier(uint32_t id) const;
+
+	// Must be called after changing a property of a modifier that changes its AABB, so it can be found by queries.
+	void update_modifier_aabb(uint32_t id);
+
+	// Tells if at least one modifier intersects the given box
+	bool has_modifiers_in_aabb(AABB aabb) const;
 	void apply(VoxelBuffer &voxels, AABB aabb) const;
 	void apply(float &sdf, Vector3f position) const;
 
+	// Applies modifiers to unscaled SDF values of a grid of voxels in ZXY order. `grid_origin` is in voxels of the
+	// given LOD. This lets generators apply modifiers before SDF gets quantized into a block.
+	void apply_to_grid(Span<float> sdf, Vector3i grid_origin, Vector3i grid_size, unsigned int lod_index) const;
+
 	void apply(
 			Span<const float> x_buffer,
 			Span<const float> y_buffer,
@@ -65,10 +80,23 @@ public:
 private:
 	void move_from_noclear(VoxelModifierStack &other);
 
-	StdUnorderedMap<uint32_t, UniquePtr<VoxelModifier>> _modifiers;
+	struct ModifierInfo {
+		UniquePtr<VoxelModifier> modifier;
+		// Modifiers are applied in the order they were added
+		uint32_t order = 0;
+		uint32_t tree_leaf_id = AABBTree::NULL_NODE;
+	};
+
+	// Gets modifiers intersecting a box, in the order they must be applied
+	void get_modifiers_in_aabb(AABB aabb, StdVector<VoxelModifier *> &out_modifiers) const;
+
+	StdUnorderedMap<uint32_t, ModifierInfo> _modifiers;
 	uint32_t _next_id = 1;
-	// TODO Later, replace this with a spatial acceleration structure based on AABBs, like BVH
+	uint32_t _next_order = 0;
 	StdVector<VoxelModifier *> _stack;
+	// Spatial index over modifiers, where leaves store modifier IDs. Levels can contain thousands of modifiers, so
+	// finding those affecting a block must not be linear.
+	AABBTree _tree;
 	RWLock _stack_lock;
 };
 
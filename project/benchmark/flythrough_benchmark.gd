@@ -0,0 +1,337 @@
+# Replays a viewer path over terrains generated with a fixed seed, and writes measurements to a JSON report, so
+# changes to the engine can be compared on the same workload. Run it from the command line:
+#
+#   godot --path project --fixed-fps 60 --script res://benchmark/flythrough_benchmark.gd -- [options]
+#
+# Options:
+#   --scenarios=smooth,blocky_stream  Scenarios to run, separated with commas. Runs all of them by default.
+#   --path=user://viewer_path.json    Path recorded with `viewer_path_recorder.gd`. Uses a built-in path otherwise.
+#   --output=user://report.json       Where to write the report. Defaults to `user://flythrough_report.json`.
+#   --speed=2.0                       Plays the path faster or slower.
+#   --reset-streams                   Deletes databases of stream scenarios before running them.
+#
+# `--fixed-fps` makes the viewer visit the same positions at each frame regardless of how long frames take.
+# Each scenario waits until terrain around the start of the path is fully loaded, flies along the path, then waits
+# until loading settles again. Stream scenarios save generated blocks to a database kept between runs, so the first
+# run mostly measures saving, and following runs measure loading.
+extends SceneTree
+
+const ViewerPath = preload("res://benchmark/viewer_path.gd")
+
+const SCENARIO_NAMES = ["smooth", "smooth_stream", "blocky", "blocky_stream"]
+const WORLD_SEED = 1337
+const SMOOTH_VIEW_DISTANCE = 1024
+const BLOCKY_VIEW_DISTANCE = 256
+# Frames without pending voxel tasks after which terrain is considered loaded
+const IDLE_FRAMES = 10
+# Stops waiting for terrain to load after this time
+const LOAD_TIMEOUT_MSEC = 120000
+
+enum {
+	STATE_LOADING,
+	STATE_FLYING,
+	STATE_SETTLING
+}
+
+var _scenario_names := []
+var _path := ViewerPath.new()
+var _path_name := "default"
+var _output_path := "user://flythrough_report.json"
+var _speed := 1.0
+var _reset_streams := false
+
+var _scenario_index := -1
+var _terrain : VoxelNode
+var _viewer : VoxelViewer
+var _state := STATE_LOADING
+var _state_start_msec := 0
+var _idle_frames := 0
+var _flight_time := 0.0
+var _report := {}
+var _frame_times_usec := PackedInt64Array()
+var _process_times_usec := PackedInt64Array()
+var _voxel_memory_peak := 0
+var _static_memory_peak := 0
+var _scenario_reports := []
+
+
+func _initialize():
+	if not _parse_arguments():
+		quit(1)
+		return
+	_start_next_scenario()
+
+
+func _parse_arguments() -> bool:
+	_scenario_names = SCENARIO_NAMES.duplicate()
+	for arg in OS.get_cmdline_user_args():
+		if arg.begins_with("--scenarios="):
+			_scenario_names = arg.trim_prefix("--scenarios=").split(",", false)
+			for scenario_name in _scenario_names:
+				if not SCENARIO_NAMES.has(scenario_name):
+					push_error("Unknown scenario {0}, available ones are {1}".format([scenario_name, SCENARIO_NAMES]))
+					return false
+		elif arg.begins_with("--path="):
+			_path_name = arg.trim_prefix("--path=")
+			var err := _path.load_json(_path_name)
+			if err != OK:
+				push_error("Could not load viewer path {0}, error {1}".format([_path_name, err]))
+				return false
+		elif arg.begins_with("--output="):
+			_output_path = arg.trim_prefix("--output=")
+		elif arg.begins_with("--speed="):
+			_speed = arg.trim_prefix("--speed=").to_float()
+		elif arg == "--reset-streams":
+			_reset_streams = true
+		else:
+			push_error("Unknown argument " + arg)
+			return false
+	if len(_path.times) == 0:
+		_create_default_path(_path)
+	return true
+
+
+# Flies low over the terrain, turns around, then climbs and goes back faster, so lower LODs get loaded too
+static func _create_default_path(path: ViewerPath):
+	var time := 0.0
+	while time <= 50.0:
+		var position : Vector3
+		if time < 20.0:
+			position = Vector3(time * 20.0, 40.0, 0.0)
+		elif time < 30.0:
+			var angle := PI * (time - 20.0) / 10.0
+			position = Vector3(400.0 + 100.0 * sin(angle), 60.0, 100.0 - 100.0 * cos(angle))
+		else:
+			var k := (time - 30.0) / 20.0
+			position = Vector3(400.0 - k * 1200.0, lerpf(60.0, 200.0, k), 200.0)
+		path.add_sample(time, position)
+		time += 0.5
+
+
+func _start_next_scenario():
+	if _terrain != null:
+		root.remove_child(_terrain)
+		_terrain.free()
+		_terrain = null
+	if _viewer != null:
+		root.remove_child(_viewer)
+		_viewer.free()
+		_viewer = null
+
+	_scenario_index += 1
+	if _scenario_index >= len(_scenario_names):
+		_save_report()
+		quit()
+		return
+
+	var scenario_name : String = _scenario_names[_scenario_index]
+	print("Running scenario ", scenario_name)
+
+	_report = { "name": scenario_name }
+	_frame_times_usec.clear()
+	_process_times_usec.clear()
+	_voxel_memory_peak = 0
+	_static_memory_peak = 0
+	_flight_time = 0.0
+
+	_terrain = _create_terrain(scenario_name)
+	_viewer = VoxelViewer.new()
+	_viewer.view_distance = BLOCKY_VIEW_DISTANCE if _terrain is VoxelTerrain else SMOOTH_VIEW_DISTANCE
+	_viewer.position = _path.get_position(0.0)
+	root.add_child(_terrain)
+	root.add_child(_viewer)
+
+	VoxelEngine.reset_latency_stats()
+	_set_state(STATE_LOADING)
+
+
+func _create_terrain(scenario_name: String) -> VoxelNode:
+	var stream : VoxelStream = null
+	if scenario_name.ends_with("_stream"):
+		var db_path := "user://flythrough_benchmark_{0}.sqlite".format([scenario_name])
+		if _reset_streams and FileAccess.file_exists(db_path):
+			DirAccess.remove_absolute(ProjectSettings.globalize_path(db_path))
+		_report["stream_prefilled"] = FileAccess.file_exists(db_path)
+		var sqlite := VoxelStreamSQLite.new()
+		sqlite.database_path = ProjectSettings.globalize_path(db_path)
+		sqlite.save_generator_output = true
+		stream = sqlite
+
+	if scenario_name.begins_with("smooth"):
+		var terrain := VoxelLodTerrain.new()
+		terrain.generator = _create_graph_generator()
+		terrain.mesher = VoxelMesherTransvoxel.new()
+		terrain.view_distance = SMOOTH_VIEW_DISTANCE
+		terrain.lod_count = 6
+		terrain.stream = stream
+		return terrain
+
+	var terrain := VoxelTerrain.new()
+	terrain.generator = _create_blocky_generator()
+	terrain.mesher = _create_blocky_mesher()
+	terrain.max_view_distance = BLOCKY_VIEW_DISTANCE
+	terrain.stream = stream
+	return terrain
+
+
+# Rolling hills, using a graph so its runtime gets measured
+static func _create_graph_generator() -> VoxelGeneratorGraph:
+	var noise := ZN_FastNoiseLite.new()
+	noise.seed = WORLD_SEED
+	noise.period = 300.0
+	noise.fractal_octaves = 5
+
+	var generator := VoxelGeneratorGraph.new()
+	var graph := generator.get_main_function()
+	var in_x := graph.create_node(VoxelGraphFunction.NODE_INPUT_X, Vector2(0, 0))
+	var in_y := graph.create_node(VoxelGraphFunction.NODE_INPUT_Y, Vector2(0, 100))
+	var in_z := graph.create_node(VoxelGraphFunction.NODE_INPUT_Z, Vector2(0, 200))
+	var noise_2d := graph.create_node(VoxelGraphFunction.NODE_FAST_NOISE_2D, Vector2(200, 100))
+	graph.set_node_param(noise_2d, 0, noise)
+	var height := graph.create_node(VoxelGraphFunction.NODE_MULTIPLY, Vector2(400, 100))
+	graph.set_node_default_input(height, 1, 60.0)
+	var sdf := graph.create_node(VoxelGraphFunction.NODE_SUBTRACT, Vector2(600, 0))
+	var out_sdf := graph.create_node(VoxelGraphFunction.NODE_OUTPUT_SDF, Vector2(800, 0))
+	graph.add_connection(in_x, 0, noise_2d, 0)
+	graph.add_connection(in_z, 0, noise_2d, 1)
+	graph.add_connection(noise_2d, 0, height, 0)
+	graph.add_connection(in_y, 0, sdf, 0)
+	graph.add_connection(height, 0, sdf, 1)
+	graph.add_connection(sdf, 0, out_sdf, 0)
+
+	var result := generator.compile()
+	if not result["success"]:
+		push_error("Could not compile benchmark graph: " + str(result))
+	return generator
+
+
+static func _create_blocky_generator() -> VoxelGeneratorNoise2D:
+	var noise := FastNoiseLite.new()
+	noise.seed = WORLD_SEED
+	noise.frequency = 1.0 / 200.0
+	noise.fractal_octaves = 4
+
+	var generator := VoxelGeneratorNoise2D.new()
+	generator.channel = VoxelBuffer.CHANNEL_TYPE
+	generator.noise = noise
+	generator.height_start = -20.0
+	generator.height_range = 60.0
+	return generator
+
+
+static func _create_blocky_mesher() -> VoxelMesherBlocky:
+	var library := VoxelBlockyLibrary.new()
+	library.add_model(VoxelBlockyModelEmpty.new())
+	library.add_model(VoxelBlockyModelCube.new())
+	library.bake()
+
+	var mesher := VoxelMesherBlocky.new()
+	mesher.library = library
+	return mesher
+
+
+func _set_state(state: int):
+	_state = state
+	_state_start_msec = Time.get_ticks_msec()
+	_idle_frames = 0
+
+
+# Must be called once per frame
+func _update_idle_frames(stats: Dictionary) -> bool:
+	var tasks : Dictionary = stats["tasks"]
+	var pending : int = tasks["streaming"] + tasks["generation"] + tasks["meshing"] + tasks["main_thread"]
+	if pending == 0:
+		_idle_frames += 1
+	else:
+		_idle_frames = 0
+	return _idle_frames >= IDLE_FRAMES
+
+
+func _process(delta: float) -> bool:
+	if _terrain == null:
+		return false
+
+	var stats := VoxelEngine.get_stats()
+	_voxel_memory_peak = maxi(_voxel_memory_peak, stats["memory_pools"]["voxel_used"])
+	_static_memory_peak = maxi(_static_memory_peak, int(Performance.get_monitor(Performance.MEMORY_STATIC)))
+	var idle := _update_idle_frames(stats)
+	var state_time_msec := Time.get_ticks_msec() - _state_start_msec
+
+	match _state:
+		STATE_LOADING:
+			if idle or state_time_msec > LOAD_TIMEOUT_MSEC:
+				_report["time_to_loaded_msec"] = state_time_msec
+				_report["loading_timed_out"] = not idle
+				_report["loading_latencies"] = stats["latencies"]
+				VoxelEngine.reset_latency_stats()
+				_set_state(STATE_FLYING)
+
+		STATE_FLYING:
+			_frame_times_usec.append(int(delta * 1000000.0))
+			_process_times_usec.append(int(Performance.get_monitor(Performance.TIME_PROCESS) * 1000000.0))
+			_flight_time += delta * _speed
+			_viewer.position = _path.get_position(_flight_time)
+			if _flight_time >= _path.get_duration():
+				_report["flight_msec"] = state_time_msec
+				_report["flight_latencies"] = stats["latencies"]
+				_set_state(STATE_SETTLING)
+
+		STATE_SETTLING:
+			if idle or state_time_msec > LOAD_TIMEOUT_MSEC:
+				_report["time_to_settled_msec"] = state_time_msec
+				_finish_scenario(stats)
+				_start_next_scenario()
+
+	return false
+
+
+func _finish_scenario(stats: Dictionary):
+	_report["frames"] = len(_frame_times_usec)
+	_report["frame_time_usec"] = _get_distribution(_frame_times_usec)
+	_report["process_time_usec"] = _get_distribution(_process_times_usec)
+	_report["main_thread_budget"] = stats["latencies"]["main_thread_budget"]
+	_report["memory"] = {
+		"voxel_used_peak": _voxel_memory_peak,
+		"static_peak": _static_memory_peak,
+		"terrain": _terrain.get_memory_breakdown(),
+		"engine": VoxelEngine.get_memory_breakdown()
+	}
+	_scenario_reports.append(_report)
+	print("Scenario ", _report["name"], " done: ", JSON.stringify(_report))
+
+
+static func _get_distribution(values: PackedInt64Array) -> Dictionary:
+	if len(values) == 0:
+		return {}
+	var sorted_values := values.duplicate()
+	sorted_values.sort()
+	var sum := 0
+	for v in sorted_values:
+		sum += v
+	var count := len(sorted_values)
+	return {
+		"mean": sum / count,
+		"p50": sorted_values[count / 2],
+		"p90": sorted_values[(count * 9) / 10],
+		"p99": sorted_values[(count * 99) / 100],
+		"max": sorted_values[count - 1]
+	}
+
+
+func _save_report():
+	var report := {
+		"voxel_version": "{0}.{1}.{2}".format([
+			VoxelEngine.get_version_major(), VoxelEngine.get_version_minor(), VoxelEngine.get_version_patch()
+		]),
+		"godot_version": Engine.get_version_info()["string"],
+		"processor_count": OS.get_processor_count(),
+		"path": _path_name,
+		"speed": _speed,
+		"scenarios": _scenario_reports
+	}
+	var f := FileAccess.open(_output_path, FileAccess.WRITE)
+	if f == null:
+		push_error("Could not save report to {0}, error {1}".format([_output_path, FileAccess.get_open_error()]))
+		return
+	f.store_string(JSON.stringify(report, "\t"))
+	print("Saved report to ", ProjectSettings.globalize_path(_output_path))
@@ -0,0 +1,61 @@
+# Positions of a viewer over time, which can be saved as JSON so benchmarks replay the same path.
+# Files contain `{ "samples": [ { "time": float, "position": [x, y, z] }, ... ] }`, with times in seconds.
+extends RefCounted
+
+var times := PackedFloat64Array()
+var positions := PackedVector3Array()
+
+
+# Samples must be added in order of time
+func add_sample(time: float, position: Vector3):
+	times.append(time)
+	positions.append(position)
+
+
+func get_duration() -> float:
+	if len(times) == 0:
+		return 0.0
+	return times[-1]
+
+
+# Gets the position at a given time, interpolating between samples
+func get_position(time: float) -> Vector3:
+	if len(times) == 0:
+		return Vector3()
+	if time <= times[0]:
+		return positions[0]
+	# Index of the first sample at or after `time`
+	var i := times.bsearch(time)
+	if i >= len(times):
+		return positions[-1]
+	var t0 := times[i - 1]
+	var t1 := times[i]
+	var k := 0.0 if t1 == t0 else (time - t0) / (t1 - t0)
+	return positions[i - 1].lerp(positions[i], k)
+
+
+func save_json(fpath: String) -> Error:
+	var samples := []
+	for i in len(times):
+		var p := positions[i]
+		samples.append({ "time": times[i], "position": [p.x, p.y, p.z] })
+	var f := FileAccess.open(fpath, FileAccess.WRITE)
+	if f == null:
+		return FileAccess.get_open_error()
+	f.store_string(JSON.stringify({ "samples": samples }, "\t"))
+	return OK
+
+
+func load_json(fpath: String) -> Error:
+	var f := FileAccess.open(fpath, FileAccess.READ)
+	if f == null:
+		return FileAccess.get_open_error()
+	var data = JSON.parse_string(f.get_as_text())
+	if typeof(data) != TYPE_DICTIONARY or not data.has("samples"):
+		return ERR_PARSE_ERROR
+	times.clear()
+	positions.clear()
+	for sample in data["samples"]:
+		var p = sample["position"]
+		add_sample(sample["time"], Vector3(p[0], p[1], p[2]))
+	return OK
@@ -0,0 +1,35 @@
+# Records the path of a node moved by a player (like a camera), so it can be replayed by `flythrough_benchmark.gd`.
+# Add it as a child of that node, or set `target`. The path is saved when the recorder leaves the tree.
+extends Node
+
+const ViewerPath = preload("res://benchmark/viewer_path.gd")
+
+@export var output_path := "user://viewer_path.json"
+# Time between samples, in seconds. Positions are interpolated between them when replaying.
+@export var sample_interval := 0.25
+# Node whose position is recorded. Uses the parent if not set.
+@export var target : Node3D
+
+var _path := ViewerPath.new()
+var _time := 0.0
+var _next_sample_time := 0.0
+
+
+func _process(delta: float):
+	var node := target
+	if node == null:
+		node = get_parent() as Node3D
+	if node == null:
+		return
+	if _time >= _next_sample_time:
+		_path.add_sample(_time, node.global_position)
+		_next_sample_time += sample_interval
+	_time += delta
+
+
+func _exit_tree():
+	var err := _path.save_json(output_path)
+	if err != OK:
+		push_error("Could not save viewer path to {0}, error {1}".format([output_path, err]))
+		return
+	print("Saved viewer path to ", ProjectSettings.globalize_path(output_path))
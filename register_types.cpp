@@ -38,6 +38,7 @@
 #include "storage/metadata/voxel_metadata_factory.h"
 #include "storage/metadata/voxel_metadata_variant.h"
 #include "storage/voxel_buffer_gd.h"
+#include "storage/voxel_clipboard_gd.h"
 #include "storage/voxel_memory_pool.h"
 #include "streams/region/voxel_stream_region_files.h"
 #include "streams/sqlite/voxel_stream_sqlite.h"
@@ -45,6 +46,7 @@
 #include "streams/voxel_block_serializer_gd.h"
 #include "streams/voxel_stream_memory.h"
 #include "streams/voxel_stream_script.h"
+#include "streams/voxel_world_baker.h"
 #include "terrain/fixed_lod/voxel_box_mover.h"
 #include "terrain/fixed_lod/voxel_terrain.h"
 #include "terrain/fixed_lod/voxel_terrain_multiplayer_synchronizer.h"
@@ -242,6 +244,7 @@ void initialize_voxel_module(ModuleInitializationLevel p_level) {
 
 		// Storage
 		ClassDB::register_class<zylann::voxel::godot::VoxelBuffer>();
+		ClassDB::register_class<zylann::voxel::godot::VoxelClipboard>();
 
 		// Nodes
 		ClassDB::register_abstract_class<VoxelNode>();
@@ -262,6 +265,7 @@ void initialize_voxel_module(ModuleInitializationLevel p_level) {
 		ClassDB::register_class<VoxelStreamScript>();
 		ClassDB::register_class<VoxelStreamSQLite>();
 		ClassDB::register_class<VoxelStreamMemory>();
+		ClassDB::register_class<VoxelWorldBaker>();
 
 		// Generators
 		ClassDB::register_abstract_class<VoxelGenerator>();
@@ -376,12 +380,14 @@ void initialize_voxel_module(ModuleInitializationLevel p_level) {
 #ifdef VOXEL_TESTS
 		const PackedStringArray command_line_arguments = zylann::godot::get_command_line_arguments();
 		const String tests_cmd = "--run_voxel_tests";
+		const String perf_tests_cmd = "--run_voxel_perf_tests";
 
 		for (int i = 0; i < command_line_arguments.size(); ++i) {
 			const String arg = command_line_arguments[i];
 			if (arg == tests_cmd) {
 				zylann::voxel::tests::run_voxel_tests();
-				break;
+			} else if (arg == perf_tests_cmd) {
+				zylann::voxel::tests::run_voxel_perf_tests();
 			}
 		}
 #endif
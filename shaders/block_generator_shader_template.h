@@ -6,15 +6,30 @@ const char *g_block_generator_shader_template_0 =
 "\n"
 "layout (local_size_x = 4, local_size_y = 4, local_size_z = 4) in;\n"
 "\n"
-"layout (set = 0, binding = 0, std430) restrict readonly buffer Params {\n"
+"struct BlockParams {\n"
 "	vec3 origin_in_voxels;\n"
 "	float voxel_size;\n"
 "	ivec3 block_size;\n"
 "	int buffer_offset;\n"
+"};\n"
+"\n"
+"// Multiple blocks can be processed in a single dispatch, with their work groups stacked along Z.\n"
+"// The buffer may also contain blocks of other dispatches.\n"
+"layout (set = 0, binding = 0, std430) restrict readonly buffer Params {\n"
+"	BlockParams blocks[];\n"
 "} u_params;\n"
 "\n"
+"layout (push_constant, std430) uniform PushConstants {\n"
+"	// How many work groups each block spans along Z\n"
+"	int block_groups_z;\n"
+"	// Index of the first block of this dispatch in `u_params`\n"
+"	int blocks_offset;\n"
+"	int padding0;\n"
+"	int padding1;\n"
+"} u_push_constants;\n"
+"\n"
 "// Contains all outputs, each laid out in contiguous chunks of the same size.\n"
-"// It must be indexed starting from `u_params.buffer_offset`.\n"
+"// Each block must index it starting from its `buffer_offset`.\n"
 "layout (set = 0, binding = 1, std430) restrict writeonly buffer OutBuffer {\n"
 "	float values[];\n"
 "} u_out;\n"
@@ -33,19 +48,22 @@ const char *g_block_generator_shader_template_1 =
 "}\n"
 "\n"
 "void main() {\n"
-"	const ivec3 rpos = ivec3(gl_GlobalInvocationID.xyz);\n"
+"	const int block_index = int(gl_WorkGroupID.z) / u_push_constants.block_groups_z;\n"
+"	const BlockParams block = u_params.blocks[u_push_constants.blocks_offset + block_index];\n"
+"	const int block_begin_z = block_index * u_push_constants.block_groups_z * int(gl_WorkGroupSize.z);\n"
+"	const ivec3 rpos = ivec3(gl_GlobalInvocationID.xyz) - ivec3(0, 0, block_begin_z);\n"
 "	// The output buffer might not have a 3D size multiple of our group size.\n"
 "	// Some of the parallel executions will not do anything.\n"
-"	if (rpos.x >= u_params.block_size.x || rpos.y >= u_params.block_size.y || rpos.z >= u_params.block_size.z) {\n"
+"	if (rpos.x >= block.block_size.x || rpos.y >= block.block_size.y || rpos.z >= block.block_size.z) {\n"
 "		return;\n"
 "	}\n"
 "\n"
-"	const int out_index = get_zxy_index(rpos, u_params.block_size) + u_params.buffer_offset;\n"
+"	const int out_index = get_zxy_index(rpos, block.block_size) + block.buffer_offset;\n"
 "\n"
 "	// May be used by generated code for generators that have more than one output\n"
-"	const int volume = get_volume(u_params.block_size);\n"
+"	const int volume = get_volume(block.block_size);\n"
 "\n"
-"	const vec3 wpos = u_params.origin_in_voxels + vec3(rpos) * u_params.voxel_size;\n"
+"	const vec3 wpos = block.origin_in_voxels + vec3(rpos) * block.voxel_size;\n"
 "	// float sd = get_sd(wpos);\n"
 "	// u_out_sd.values[out_index] = sd;\n"
 "\n";
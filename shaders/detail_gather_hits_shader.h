@@ -31,7 +31,7 @@ const char *g_detail_gather_hits_shader =
 "layout (set = 0, binding = 3, std430) restrict readonly buffer AtlasInfo {\n"
 "	// [tile index] => cell info\n"
 "	// X:\n"
-"	// Packed 8-bit coordinates of the cell.\n"
+"	// Packed 8-bit coordinates of the cell, followed by the 8-bit index of the block it belongs to.\n"
 "	// Y:\n"
 "	// aaaaaaaa aaaaaaaa aaaaaaaa 0bbb00cc\n"
 "	// a: 24-bit index into `u_cell_tris.data` array.\n"
@@ -41,11 +41,17 @@ const char *g_detail_gather_hits_shader =
 "	ivec2 data[];\n"
 "} u_tile_data;\n"
 "\n"
-"layout (set = 0, binding = 4, std430) restrict readonly buffer Params {\n"
-"	vec3 block_origin_world;\n"
+"struct BlockParams {\n"
+"	vec3 origin_world;\n"
 "	// How big is a pixel of the atlas in world space\n"
 "	float pixel_world_step;\n"
+"};\n"
+"\n"
+"layout (set = 0, binding = 4, std430) restrict readonly buffer Params {\n"
 "	int tile_size_pixels;\n"
+"	// Tiles of multiple blocks can be processed in the same dispatch, even if they have different LODs.\n"
+"	// [block index] => block params\n"
+"	BlockParams blocks[];\n"
 "} u_params;\n"
 "\n"
 "layout (set = 0, binding = 5, std430) restrict writeonly buffer HitBuffer {\n"
@@ -125,7 +131,9 @@ const char *g_detail_gather_hits_shader =
 "		(packed_cell_pos >> 8) & 0xff,\n"
 "		(packed_cell_pos >> 16) & 0xff\n"
 "	);\n"
-"	const float cell_size_world = u_params.pixel_world_step * float(u_params.tile_size_pixels);\n"
+"	const int block_index = (packed_cell_pos >> 24) & 0xff;\n"
+"	const float pixel_world_step = u_params.blocks[block_index].pixel_world_step;\n"
+"	const float cell_size_world = pixel_world_step * float(u_params.tile_size_pixels);\n"
 "	const vec3 cell_origin_mesh = cell_size_world * cell_pos_cells;\n"
 "\n"
 "	// Choose a basis where Z is the axis we cast the ray. X and Y are lateral axes of the tile.\n"
@@ -133,7 +141,7 @@ const char *g_detail_gather_hits_shader =
 "	const vec3 dx = vec3(float(projection == 1 || projection == 2), 0.0, float(projection == 0));\n"
 "	const vec3 dy = vec3(0.0, float(projection == 0 || projection == 2), float(projection == 1));\n"
 "\n"
-"	const vec2 pos_in_tile = u_params.pixel_world_step * vec2(pixel_pos_in_tile);\n"
+"	const vec2 pos_in_tile = pixel_world_step * vec2(pixel_pos_in_tile);\n"
 "	const vec3 ray_origin_mesh = cell_origin_mesh\n"
 "		 - 1.01 * ray_dir * cell_size_world\n"
 "		 + pos_in_tile.x * dx + pos_in_tile.y * dy;\n"
@@ -167,7 +175,8 @@ const char *g_detail_gather_hits_shader =
 "		+ tile_index * u_params.tile_size_pixels * u_params.tile_size_pixels;\n"
 "\n"
 "	if (nearest_hit_tri_index != -1) {\n"
-"		const vec3 hit_pos_world = ray_origin_mesh + ray_dir * nearest_hit_distance + u_params.block_origin_world;\n"
+"		const vec3 hit_pos_world =\n"
+"			ray_origin_mesh + ray_dir * nearest_hit_distance + u_params.blocks[block_index].origin_world;\n"
 "		u_hits.positions[index] = vec4(hit_pos_world, nearest_hit_tri_index);\n"
 "	} else {\n"
 "		u_hits.positions[index] = vec4(0.0, 0.0, 0.0, -1.0);\n"
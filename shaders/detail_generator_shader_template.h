@@ -19,7 +19,9 @@ const char *g_detail_generator_shader_template_0 =
 "\n"
 "layout (set = 0, binding = 1, std430) restrict readonly buffer Params {\n"
 "	int tile_size_pixels;\n"
-"	float pixel_world_step;\n"
+"	// [tile index] => How big is a pixel of the tile in world space. Differs when tiles of multiple LODs are processed\n"
+"	// in the same dispatch.\n"
+"	float tile_pixel_world_steps[];\n"
 "} u_params;\n"
 "\n"
 "layout (set = 0, binding = 2, std430) restrict writeonly buffer OutSDBuffer {\n"
@@ -43,10 +45,12 @@ const char *g_detail_generator_shader_template_1 =
 "		return;\n"
 "	}\n"
 "\n"
+"	const float pixel_world_step = u_params.tile_pixel_world_steps[tile_index];\n"
+"\n"
 "	const vec3 pos0 = u_positions.values[index].xyz;\n"
-"	const vec3 pos1 = pos0 + vec3(u_params.pixel_world_step, 0.0, 0.0);\n"
-"	const vec3 pos2 = pos0 + vec3(0.0, u_params.pixel_world_step, 0.0);\n"
-"	const vec3 pos3 = pos0 + vec3(0.0, 0.0, u_params.pixel_world_step);\n"
+"	const vec3 pos1 = pos0 + vec3(pixel_world_step, 0.0, 0.0);\n"
+"	const vec3 pos2 = pos0 + vec3(0.0, pixel_world_step, 0.0);\n"
+"	const vec3 pos3 = pos0 + vec3(0.0, 0.0, pixel_world_step);\n"
 "\n"
 "	const int sdi = index * 4;\n"
 "\n"
@@ -1,7 +1,7 @@
 // Generated file
 
 // clang-format off
-const char *g_detail_modifier_shader_template_0 = 
+const char *g_detail_modifier_shader_template_0 =
 "#version 450\n"
 "\n"
 "// Takes a list of positions and evaluates a signed distance field in 4 locations around them.\n"
@@ -20,7 +20,8 @@ const char *g_detail_modifier_shader_template_0 =
 "\n"
 "layout (set = 0, binding = 1, std430) restrict readonly buffer DetailParams {\n"
 "	int tile_size_pixels;\n"
-"	float pixel_world_step;\n"
+"	// [tile index] => How big is a pixel of the tile in world space\n"
+"	float tile_pixel_world_steps[];\n"
 "} u_detail_params;\n"
 "\n"
 "layout (set = 0, binding = 2, std430) restrict readonly buffer InSDBuffer {\n"
@@ -44,7 +45,7 @@ const char *g_detail_modifier_shader_template_0 =
 // clang-format on
 
 // clang-format off
-const char *g_detail_modifier_shader_template_1 = 
+const char *g_detail_modifier_shader_template_1 =
 "\n"
 "float sd_smooth_union(float a, float b, float s) {\n"
 "	const float h = clamp(0.5 + 0.5 * (b - a) / s, 0.0, 1.0);\n"
@@ -68,10 +69,12 @@ const char *g_detail_modifier_shader_template_1 =
 "		return;\n"
 "	}\n"
 "\n"
+"	const float pixel_world_step = u_detail_params.tile_pixel_world_steps[tile_index];\n"
+"\n"
 "	vec3 pos0 = u_positions.values[index].xyz;\n"
-"	vec3 pos1 = pos0 + vec3(u_detail_params.pixel_world_step, 0.0, 0.0);\n"
-"	vec3 pos2 = pos0 + vec3(0.0, u_detail_params.pixel_world_step, 0.0);\n"
-"	vec3 pos3 = pos0 + vec3(0.0, 0.0, u_detail_params.pixel_world_step);\n"
+"	vec3 pos1 = pos0 + vec3(pixel_world_step, 0.0, 0.0);\n"
+"	vec3 pos2 = pos0 + vec3(0.0, pixel_world_step, 0.0);\n"
+"	vec3 pos3 = pos0 + vec3(0.0, 0.0, pixel_world_step);\n"
 "\n"
 "	pos0 = (u_base_modifier_params.world_to_model * vec4(pos0, 1.0)).xyz;\n"
 "	pos1 = (u_base_modifier_params.world_to_model * vec4(pos1, 1.0)).xyz;\n"
@@ -113,6 +116,5 @@ const char *g_detail_modifier_shader_template_1 =
 "	u_out_sd.values[sdi + 1] = sd1;\n"
 "	u_out_sd.values[sdi + 2] = sd2;\n"
 "	u_out_sd.values[sdi + 3] = sd3;\n"
-"}\n"
-"\n";
+"}\n";
 // clang-format on
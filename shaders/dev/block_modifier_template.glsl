@@ -3,13 +3,28 @@
 
 layout (local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
 
-layout (set = 0, binding = 0, std430) restrict readonly buffer Params {
+struct BlockParams {
 	vec3 origin_in_voxels;
 	float voxel_size;
 	ivec3 block_size;
 	int buffer_offset;
+};
+
+// Multiple blocks can be processed in a single dispatch, with their work groups stacked along Z.
+// The buffer may also contain blocks of other dispatches.
+layout (set = 0, binding = 0, std430) restrict readonly buffer Params {
+	BlockParams blocks[];
 } u_params;
 
+layout (push_constant, std430) uniform PushConstants {
+	// How many work groups each block spans along Z
+	int block_groups_z;
+	// Index of the first block of this dispatch in `u_params`
+	int blocks_offset;
+	int padding0;
+	int padding1;
+} u_push_constants;
+
 // SDF is modified in-place
 layout (set = 0, binding = 1, std430) restrict buffer InSDBuffer {
 	float values[];
@@ -46,19 +61,22 @@ int get_zxy_index(ivec3 pos, ivec3 size) {
 }
 
 void main() {
-	const ivec3 rpos = ivec3(gl_GlobalInvocationID.xyz);
+	const int block_index = int(gl_WorkGroupID.z) / u_push_constants.block_groups_z;
+	const BlockParams block = u_params.blocks[u_push_constants.blocks_offset + block_index];
+	const int block_begin_z = block_index * u_push_constants.block_groups_z * int(gl_WorkGroupSize.z);
+	const ivec3 rpos = ivec3(gl_GlobalInvocationID.xyz) - ivec3(0, 0, block_begin_z);
 
 	// The output buffer might not have a 3D size multiple of our group size.
 	// Some of the parallel executions will not do anything.
-	if (rpos.x >= u_params.block_size.x || rpos.y >= u_params.block_size.y || rpos.z >= u_params.block_size.z) {
+	if (rpos.x >= block.block_size.x || rpos.y >= block.block_size.y || rpos.z >= block.block_size.z) {
 		return;
 	}
 
-	vec3 pos = u_params.origin_in_voxels + vec3(rpos) * u_params.voxel_size;
+	vec3 pos = block.origin_in_voxels + vec3(rpos) * block.voxel_size;
 
 	pos = (u_base_modifier_params.world_to_model * vec4(pos, 1.0)).xyz;
 
-	const int index = get_zxy_index(rpos, u_params.block_size) + u_params.buffer_offset;
+	const int index = get_zxy_index(rpos, block.block_size) + block.buffer_offset;
 
 	float sd = u_inout_sd.values[index];
 
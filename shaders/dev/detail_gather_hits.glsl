@@ -28,7 +28,7 @@ layout (set = 0, binding = 2, std430) restrict readonly buffer CellTris {
 layout (set = 0, binding = 3, std430) restrict readonly buffer AtlasInfo {
 	// [tile index] => cell info
 	// X:
-	// Packed 8-bit coordinates of the cell.
+	// Packed 8-bit coordinates of the cell, followed by the 8-bit index of the block it belongs to.
 	// Y:
 	// aaaaaaaa aaaaaaaa aaaaaaaa 0bbb00cc
 	// a: 24-bit index into `u_cell_tris.data` array.
@@ -38,11 +38,17 @@ layout (set = 0, binding = 3, std430) restrict readonly buffer AtlasInfo {
 	ivec2 data[];
 } u_tile_data;
 
-layout (set = 0, binding = 4, std430) restrict readonly buffer Params {
-	vec3 block_origin_world;
+struct BlockParams {
+	vec3 origin_world;
 	// How big is a pixel of the atlas in world space
 	float pixel_world_step;
+};
+
+layout (set = 0, binding = 4, std430) restrict readonly buffer Params {
 	int tile_size_pixels;
+	// Tiles of multiple blocks can be processed in the same dispatch, even if they have different LODs.
+	// [block index] => block params
+	BlockParams blocks[];
 } u_params;
 
 layout (set = 0, binding = 5, std430) restrict writeonly buffer HitBuffer {
@@ -122,7 +128,9 @@ void main() {
 		(packed_cell_pos >> 8) & 0xff,
 		(packed_cell_pos >> 16) & 0xff
 	);
-	const float cell_size_world = u_params.pixel_world_step * float(u_params.tile_size_pixels);
+	const int block_index = (packed_cell_pos >> 24) & 0xff;
+	const float pixel_world_step = u_params.blocks[block_index].pixel_world_step;
+	const float cell_size_world = pixel_world_step * float(u_params.tile_size_pixels);
 	const vec3 cell_origin_mesh = cell_size_world * cell_pos_cells;
 
 	// Choose a basis where Z is the axis we cast the ray. X and Y are lateral axes of the tile.
@@ -130,7 +138,7 @@ void main() {
 	const vec3 dx = vec3(float(projection == 1 || projection == 2), 0.0, float(projection == 0));
 	const vec3 dy = vec3(0.0, float(projection == 0 || projection == 2), float(projection == 1));
 
-	const vec2 pos_in_tile = u_params.pixel_world_step * vec2(pixel_pos_in_tile);
+	const vec2 pos_in_tile = pixel_world_step * vec2(pixel_pos_in_tile);
 	const vec3 ray_origin_mesh = cell_origin_mesh
 		 - 1.01 * ray_dir * cell_size_world
 		 + pos_in_tile.x * dx + pos_in_tile.y * dy;
@@ -164,7 +172,8 @@ void main() {
 		+ tile_index * u_params.tile_size_pixels * u_params.tile_size_pixels;
 
 	if (nearest_hit_tri_index != -1) {
-		const vec3 hit_pos_world = ray_origin_mesh + ray_dir * nearest_hit_distance + u_params.block_origin_world;
+		const vec3 hit_pos_world =
+			ray_origin_mesh + ray_dir * nearest_hit_distance + u_params.blocks[block_index].origin_world;
 		u_hits.positions[index] = vec4(hit_pos_world, nearest_hit_tri_index);
 	} else {
 		u_hits.positions[index] = vec4(0.0, 0.0, 0.0, -1.0);
@@ -16,7 +16,9 @@ layout (set = 0, binding = 0, std430) restrict readonly buffer PositionBuffer {
 
 layout (set = 0, binding = 1, std430) restrict readonly buffer Params {
 	int tile_size_pixels;
-	float pixel_world_step;
+	// [tile index] => How big is a pixel of the tile in world space. Differs when tiles of multiple LODs are processed
+	// in the same dispatch.
+	float tile_pixel_world_steps[];
 } u_params;
 
 layout (set = 0, binding = 2, std430) restrict writeonly buffer OutSDBuffer {
@@ -41,10 +43,12 @@ void main() {
 		return;
 	}
 
+	const float pixel_world_step = u_params.tile_pixel_world_steps[tile_index];
+
 	const vec3 pos0 = u_positions.values[index].xyz;
-	const vec3 pos1 = pos0 + vec3(u_params.pixel_world_step, 0.0, 0.0);
-	const vec3 pos2 = pos0 + vec3(0.0, u_params.pixel_world_step, 0.0);
-	const vec3 pos3 = pos0 + vec3(0.0, 0.0, u_params.pixel_world_step);
+	const vec3 pos1 = pos0 + vec3(pixel_world_step, 0.0, 0.0);
+	const vec3 pos2 = pos0 + vec3(0.0, pixel_world_step, 0.0);
+	const vec3 pos3 = pos0 + vec3(0.0, 0.0, pixel_world_step);
 
 	const int sdi = index * 4;
 
@@ -17,7 +17,8 @@ layout (set = 0, binding = 0, std430) restrict readonly buffer PositionBuffer {
 
 layout (set = 0, binding = 1, std430) restrict readonly buffer DetailParams {
 	int tile_size_pixels;
-	float pixel_world_step;
+	// [tile index] => How big is a pixel of the tile in world space
+	float tile_pixel_world_steps[];
 } u_detail_params;
 
 layout (set = 0, binding = 2, std430) restrict readonly buffer InSDBuffer {
@@ -66,10 +67,12 @@ void main() {
 		return;
 	}
 
+	const float pixel_world_step = u_detail_params.tile_pixel_world_steps[tile_index];
+
 	vec3 pos0 = u_positions.values[index].xyz;
-	vec3 pos1 = pos0 + vec3(u_detail_params.pixel_world_step, 0.0, 0.0);
-	vec3 pos2 = pos0 + vec3(0.0, u_detail_params.pixel_world_step, 0.0);
-	vec3 pos3 = pos0 + vec3(0.0, 0.0, u_detail_params.pixel_world_step);
+	vec3 pos1 = pos0 + vec3(pixel_world_step, 0.0, 0.0);
+	vec3 pos2 = pos0 + vec3(0.0, pixel_world_step, 0.0);
+	vec3 pos3 = pos0 + vec3(0.0, 0.0, pixel_world_step);
 
 	pos0 = (u_base_modifier_params.world_to_model * vec4(pos0, 1.0)).xyz;
 	pos1 = (u_base_modifier_params.world_to_model * vec4(pos1, 1.0)).xyz;
@@ -0,0 +1,287 @@
+#[compute]
+#version 450
+
+// Scatters instances on the surface of a mesh block, similarly to `VoxelInstanceGenerator::generate_transforms`.
+// Each invocation processes one candidate (a vertex or a triangle of the mesh, depending on the emit mode), and writes
+// its transform in the output buffer. Candidates that get filtered out are marked as such, so the CPU can skip them.
+// Random numbers are obtained by hashing the index of the candidate, so results don't depend on execution order, but
+// they differ from the CPU implementation.
+
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+layout (set = 0, binding = 0, std430) restrict readonly buffer MeshVertices {
+	vec3 data[];
+} u_vertices;
+
+layout (set = 0, binding = 1, std430) restrict readonly buffer MeshNormals {
+	vec3 data[];
+} u_normals;
+
+layout (set = 0, binding = 2, std430) restrict readonly buffer MeshIndices {
+	int data[];
+} u_indices;
+
+layout (set = 0, binding = 3, std430) restrict readonly buffer Params {
+	// Position of the block relative to the instancer
+	vec3 block_origin;
+	// Size of the block in world space
+	float block_size;
+	int emit_mode;
+	uint candidate_count;
+	uint triangle_count;
+	uint seed;
+	uint octant_mask;
+	// Probability of a vertex to be picked when emitting from vertices, from 0 to 0xffffffff
+	uint vertex_density;
+	float jitter;
+	float triangle_area_threshold;
+	float vertical_alignment;
+	float offset_along_normal;
+	float min_scale;
+	float scale_range;
+	int scale_distribution;
+	uint flags;
+	float normal_min_y;
+	float normal_max_y;
+	float min_height;
+	float max_height;
+	// Where results of this block start in the output buffer, in floats
+	uint output_start;
+	int up_mode;
+} u_params;
+
+layout (set = 0, binding = 4, std430) restrict writeonly buffer OutputBuffer {
+	// 16 floats per candidate. The first 12 are a transform laid out like in a MultiMesh buffer, the next one is 1 if
+	// the instance was kept, 0 otherwise.
+	float data[];
+} u_output;
+
+// Must match `VoxelInstanceGenerator::EmitMode`
+const int EMIT_FROM_VERTICES = 0;
+const int EMIT_FROM_FACES_FAST = 1;
+const int EMIT_ONE_PER_TRIANGLE = 3;
+
+// Must match `VoxelInstanceGenerator::Distribution`
+const int DISTRIBUTION_QUADRATIC = 1;
+const int DISTRIBUTION_CUBIC = 2;
+const int DISTRIBUTION_QUINTIC = 3;
+
+// Must match `UpMode`
+const int UP_MODE_SPHERE = 1;
+
+const uint FLAG_RANDOM_VERTICAL_FLIP = 1;
+const uint FLAG_RANDOM_ROTATION = 2;
+const uint FLAG_SLOPE_FILTER = 4;
+const uint FLAG_HEIGHT_FILTER = 8;
+
+const uint FLOATS_PER_CANDIDATE = 16;
+const uint VALID_OFFSET = 12;
+
+// PCG hash, see https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+uint hash_u32(uint x) {
+	const uint state = x * 747796405u + 2891336453u;
+	const uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+uint rand_u32(inout uint state) {
+	state = hash_u32(state);
+	return state;
+}
+
+// Returns a number between 0 and 1
+float rand_f(inout uint state) {
+	return float(rand_u32(state) >> 8u) / 16777216.0;
+}
+
+float get_triangle_area(vec3 a, vec3 b, vec3 c) {
+	return 0.5 * length(cross(b - a, c - a));
+}
+
+void reject(uint output_index) {
+	u_output.data[output_index + VALID_OFFSET] = 0.0;
+}
+
+void main() {
+	const uint candidate_index = gl_GlobalInvocationID.x;
+	if (candidate_index >= u_params.candidate_count) {
+		return;
+	}
+
+	const uint output_index = u_params.output_start + candidate_index * FLOATS_PER_CANDIDATE;
+	uint rng = hash_u32(u_params.seed ^ hash_u32(candidate_index));
+
+	vec3 position;
+	vec3 normal;
+
+	if (u_params.emit_mode == EMIT_FROM_VERTICES) {
+		if (rand_u32(rng) >= u_params.vertex_density) {
+			reject(output_index);
+			return;
+		}
+		position = u_vertices.data[candidate_index];
+		normal = u_normals.data[candidate_index];
+		// Ignore vertices located on the positive faces of the block. They are usually shared with the neighbor
+		// block, which causes a density bias and overlapping instances
+		const float margin = u_params.block_size - u_params.block_size * 0.01;
+		if (position.x > margin || position.y > margin || position.z > margin) {
+			reject(output_index);
+			return;
+		}
+
+	} else {
+		uint ii;
+		if (u_params.emit_mode == EMIT_FROM_FACES_FAST) {
+			// Pick a random triangle
+			ii = (rand_u32(rng) % u_params.triangle_count) * 3;
+		} else {
+			ii = candidate_index * 3;
+		}
+
+		const int ia = u_indices.data[ii];
+		const int ib = u_indices.data[ii + 1];
+		const int ic = u_indices.data[ii + 2];
+
+		const vec3 pa = u_vertices.data[ia];
+		const vec3 pb = u_vertices.data[ib];
+		const vec3 pc = u_vertices.data[ic];
+
+		const vec3 na = u_normals.data[ia];
+		const vec3 nb = u_normals.data[ib];
+		const vec3 nc = u_normals.data[ic];
+
+		if (u_params.emit_mode == EMIT_FROM_FACES_FAST) {
+			const float t0 = rand_f(rng);
+			const float t1 = rand_f(rng);
+			// This is an approximation of a uniform distribution
+			position = mix(mix(pa, pb, t0), pc, t1);
+			normal = mix(mix(na, nb, t0), nc, t1);
+
+		} else {
+			if (u_params.triangle_area_threshold > 0.0 &&
+				get_triangle_area(pa, pb, pc) < u_params.triangle_area_threshold) {
+				reject(output_index);
+				return;
+			}
+
+			position = (pa + pb + pc) / 3.0;
+			normal = (na + nb + nc) / 3.0;
+
+			if (u_params.jitter != 0.0) {
+				const float t0 = rand_f(rng);
+				const float t1 = rand_f(rng);
+				const vec3 rp = mix(mix(pa, pb, t0), pc, t1);
+				const vec3 rn = mix(mix(na, nb, t0), nc, t1);
+				position = mix(position, rp, u_params.jitter);
+				normal = mix(normal, rn, u_params.jitter);
+			}
+		}
+	}
+
+	// Filter out by octants
+	{
+		const float h = u_params.block_size * 0.5;
+		const uint octant_index = uint(position.x > h) | (uint(position.y > h) << 1) | (uint(position.z > h) << 2);
+		if ((u_params.octant_mask & (1u << octant_index)) == 0) {
+			reject(output_index);
+			return;
+		}
+	}
+
+	const vec3 world_position = u_params.block_origin + position;
+	vec3 global_up = vec3(0.0, 1.0, 0.0);
+	if (u_params.up_mode == UP_MODE_SPHERE) {
+		global_up = normalize(world_position);
+	}
+
+	// Mesh normals are not always normalized
+	const vec3 surface_normal = normalize(normal);
+
+	if ((u_params.flags & FLAG_SLOPE_FILTER) != 0) {
+		const float ny = u_params.up_mode == UP_MODE_SPHERE ? dot(surface_normal, global_up) : surface_normal.y;
+		if (ny < u_params.normal_min_y || ny > u_params.normal_max_y) {
+			reject(output_index);
+			return;
+		}
+	}
+
+	if ((u_params.flags & FLAG_HEIGHT_FILTER) != 0) {
+		const float y = u_params.up_mode == UP_MODE_SPHERE ? length(world_position) : world_position.y;
+		if (y < u_params.min_height || y > u_params.max_height) {
+			reject(output_index);
+			return;
+		}
+	}
+
+	vec3 axis_y;
+	if (u_params.vertical_alignment == 0.0) {
+		axis_y = surface_normal;
+	} else if (u_params.vertical_alignment < 1.0) {
+		axis_y = normalize(mix(normal, global_up, u_params.vertical_alignment));
+	} else {
+		axis_y = global_up;
+	}
+
+	position += u_params.offset_along_normal * axis_y;
+
+	// Allows to use two faces of a single rock to create variety in the same layer
+	if ((u_params.flags & FLAG_RANDOM_VERTICAL_FLIP) != 0 && (rand_u32(rng) & 1u) == 1u) {
+		axis_y = -axis_y;
+	}
+
+	// If the surface is aligned with the look axis, we pick a different one to avoid a broken basis
+	const vec3 fixed_look_axis = u_params.up_mode == UP_MODE_SPHERE ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+	const vec3 fixed_look_axis_alternative =
+			u_params.up_mode == UP_MODE_SPHERE ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+
+	vec3 dir = fixed_look_axis;
+	if ((u_params.flags & FLAG_RANDOM_ROTATION) != 0) {
+		// Bounded number of attempts, we fall back to a fixed axis if all of them are too close to the up axis
+		for (int attempt = 0; attempt < 4; ++attempt) {
+			const vec3 rdir = vec3(rand_f(rng) - 0.5, rand_f(rng) - 0.5, rand_f(rng) - 0.5);
+			const float rdir_len = length(rdir);
+			if (rdir_len > 0.0001 && abs(dot(rdir / rdir_len, axis_y)) <= 0.9999) {
+				dir = rdir / rdir_len;
+				break;
+			}
+		}
+	}
+	if (abs(dot(dir, axis_y)) > 0.9999) {
+		dir = fixed_look_axis_alternative;
+	}
+
+	vec3 axis_x = normalize(cross(axis_y, dir));
+	vec3 axis_z = cross(axis_x, axis_y);
+
+	float scale = u_params.min_scale;
+	if (u_params.scale_range > 0.0) {
+		float r = rand_f(rng);
+		if (u_params.scale_distribution == DISTRIBUTION_QUADRATIC) {
+			r = r * r;
+		} else if (u_params.scale_distribution == DISTRIBUTION_CUBIC) {
+			r = r * r * r;
+		} else if (u_params.scale_distribution == DISTRIBUTION_QUINTIC) {
+			r = r * r * r * r * r;
+		}
+		scale = u_params.min_scale + u_params.scale_range * r;
+	}
+
+	axis_x *= scale;
+	axis_y *= scale;
+	axis_z *= scale;
+
+	// Rows of the basis followed by the origin component, like a MultiMesh buffer
+	u_output.data[output_index + 0] = axis_x.x;
+	u_output.data[output_index + 1] = axis_y.x;
+	u_output.data[output_index + 2] = axis_z.x;
+	u_output.data[output_index + 3] = position.x;
+	u_output.data[output_index + 4] = axis_x.y;
+	u_output.data[output_index + 5] = axis_y.y;
+	u_output.data[output_index + 6] = axis_z.y;
+	u_output.data[output_index + 7] = position.y;
+	u_output.data[output_index + 8] = axis_x.z;
+	u_output.data[output_index + 9] = axis_y.z;
+	u_output.data[output_index + 10] = axis_z.z;
+	u_output.data[output_index + 11] = position.z;
+	u_output.data[output_index + VALID_OFFSET] = 1.0;
+}
@@ -0,0 +1,162 @@
+#[compute]
+#version 450
+
+// Bakes a signed distance field from a triangle mesh, with the same algorithm as
+// `mesh_sdf::generate_mesh_sdf_partitioned`. Each invocation computes one cell of the grid, by finding the closest
+// triangle among those overlapping chunks near the chunk containing the cell. Distances are exact, and signs have the
+// same ambiguities as the CPU version, so they may be fixed afterwards the same way.
+
+layout (local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+layout (set = 0, binding = 0, std430) restrict readonly buffer Triangles {
+	// 10 vectors per triangle, see `TRIANGLE_STRIDE`
+	vec4 data[];
+} u_triangles;
+
+layout (set = 0, binding = 1, std430) restrict readonly buffer Chunks {
+	// One per chunk of the partition grid, in ZXY order.
+	// x: position of the list of near chunks in the indices buffer
+	// y: number of near chunks
+	// z: position of the list of triangles in the indices buffer
+	// w: number of triangles
+	uvec4 data[];
+} u_chunks;
+
+layout (set = 0, binding = 2, std430) restrict readonly buffer Indices {
+	uint data[];
+} u_indices;
+
+layout (set = 0, binding = 3, std430) restrict readonly buffer Params {
+	// Transforms cell positions into mesh space
+	vec3 grid_translation;
+	// Where results start in the output buffer, in floats
+	uint output_start;
+	vec3 grid_scale;
+	float chunk_size;
+	ivec3 resolution;
+	vec3 chunk_grid_min_pos;
+	ivec3 chunk_grid_size;
+} u_params;
+
+layout (set = 0, binding = 4, std430) restrict writeonly buffer OutputBuffer {
+	// Signed distances in ZXY order
+	float data[];
+} u_output;
+
+// Must match the layout written by `GenMeshSDFGPUTask`
+const uint TRIANGLE_STRIDE = 10;
+// Vertices, with inverse squared lengths of edges in W
+const uint TRIANGLE_V1_INV_V21_LENGTH_SQUARED = 0;
+const uint TRIANGLE_V2_INV_V32_LENGTH_SQUARED = 1;
+const uint TRIANGLE_V3_INV_V13_LENGTH_SQUARED = 2;
+// Edge, with inverse squared length of the normal in W
+const uint TRIANGLE_V21_INV_NOR_LENGTH_SQUARED = 3;
+const uint TRIANGLE_V32 = 4;
+const uint TRIANGLE_V13 = 5;
+const uint TRIANGLE_NOR = 6;
+const uint TRIANGLE_V21_CROSS_NOR = 7;
+const uint TRIANGLE_V32_CROSS_NOR = 8;
+const uint TRIANGLE_V13_CROSS_NOR = 9;
+
+const float FAR_DISTANCE_SQUARED = 9999999.0;
+
+float sign_nonzero(float x) {
+	return x < 0.0 ? -1.0 : 1.0;
+}
+
+float length_squared(vec3 v) {
+	return dot(v, v);
+}
+
+vec4 get_triangle_data(uint triangle_index, uint field) {
+	return u_triangles.data[triangle_index * TRIANGLE_STRIDE + field];
+}
+
+// Same as `mesh_sdf::get_distance_to_triangle_squared_precalc`
+// https://iquilezles.org/articles/triangledistance/
+float get_distance_to_triangle_squared(uint ti, vec3 p) {
+	const vec4 v1 = get_triangle_data(ti, TRIANGLE_V1_INV_V21_LENGTH_SQUARED);
+	const vec4 v2 = get_triangle_data(ti, TRIANGLE_V2_INV_V32_LENGTH_SQUARED);
+	const vec4 v3 = get_triangle_data(ti, TRIANGLE_V3_INV_V13_LENGTH_SQUARED);
+
+	const vec3 p1 = p - v1.xyz;
+	const vec3 p2 = p - v2.xyz;
+	const vec3 p3 = p - v3.xyz;
+
+	const float det = //
+			sign_nonzero(dot(get_triangle_data(ti, TRIANGLE_V21_CROSS_NOR).xyz, p1)) + //
+			sign_nonzero(dot(get_triangle_data(ti, TRIANGLE_V32_CROSS_NOR).xyz, p2)) + //
+			sign_nonzero(dot(get_triangle_data(ti, TRIANGLE_V13_CROSS_NOR).xyz, p3));
+
+	const vec4 v21 = get_triangle_data(ti, TRIANGLE_V21_INV_NOR_LENGTH_SQUARED);
+
+	if (det < 2.0) {
+		// Outside of the prism: get distance to closest edge
+		const vec3 v32 = get_triangle_data(ti, TRIANGLE_V32).xyz;
+		const vec3 v13 = get_triangle_data(ti, TRIANGLE_V13).xyz;
+		return min(
+				min(
+						length_squared(v21.xyz * clamp(dot(v21.xyz, p1) * v1.w, 0.0, 1.0) - p1),
+						length_squared(v32 * clamp(dot(v32, p2) * v2.w, 0.0, 1.0) - p2)
+				),
+				length_squared(v13 * clamp(dot(v13, p3) * v3.w, 0.0, 1.0) - p3)
+		);
+	} else {
+		// Inside the prism: get distance to plane
+		const float d = dot(get_triangle_data(ti, TRIANGLE_NOR).xyz, p1);
+		return d * d * v21.w;
+	}
+}
+
+uint get_zxy_index(ivec3 pos, ivec3 size) {
+	return pos.y + size.y * (pos.x + size.x * pos.z);
+}
+
+void main() {
+	const ivec3 cell_pos = ivec3(gl_GlobalInvocationID);
+	if (any(greaterThanEqual(cell_pos, u_params.resolution))) {
+		return;
+	}
+
+	const vec3 pos = u_params.grid_translation + u_params.grid_scale * vec3(cell_pos);
+
+	ivec3 chunk_pos = ivec3(floor((pos - u_params.chunk_grid_min_pos) / u_params.chunk_size));
+	chunk_pos = clamp(chunk_pos, ivec3(0), u_params.chunk_grid_size - ivec3(1));
+	const uvec4 chunk = u_chunks.data[get_zxy_index(chunk_pos, u_params.chunk_grid_size)];
+
+	float min_distance_squared = FAR_DISTANCE_SQUARED;
+	uint closest_triangle_index = 0xffffffff;
+
+	for (uint i = 0; i < chunk.y; ++i) {
+		const uvec4 near_chunk = u_chunks.data[u_indices.data[chunk.x + i]];
+
+		for (uint j = 0; j < near_chunk.w; ++j) {
+			const uint triangle_index = u_indices.data[near_chunk.z + j];
+			const float sqd = get_distance_to_triangle_squared(triangle_index, pos);
+
+			if (sqd < min_distance_squared) {
+				min_distance_squared = sqd;
+				closest_triangle_index = triangle_index;
+			}
+		}
+	}
+
+	float sd = sqrt(FAR_DISTANCE_SQUARED);
+
+	if (closest_triangle_index != 0xffffffff) {
+		const vec3 v1 = get_triangle_data(closest_triangle_index, TRIANGLE_V1_INV_V21_LENGTH_SQUARED).xyz;
+		const vec3 v2 = get_triangle_data(closest_triangle_index, TRIANGLE_V2_INV_V32_LENGTH_SQUARED).xyz;
+		const vec3 v13 = get_triangle_data(closest_triangle_index, TRIANGLE_V13).xyz;
+
+		// Same as `mesh_sdf::get_normal`
+		const vec3 plane_normal = cross(v13, normalize(v1 - v2));
+		const float plane_d = dot(plane_normal, v1);
+
+		sd = sqrt(min_distance_squared);
+		if (dot(plane_normal, pos) <= plane_d) {
+			sd = -sd;
+		}
+	}
+
+	u_output.data[u_params.output_start + get_zxy_index(cell_pos, u_params.resolution)] = sd;
+}
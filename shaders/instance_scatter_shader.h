@@ -0,0 +1,291 @@
+// Generated file
+
+// clang-format off
+const char *g_instance_scatter_shader =
+"#version 450\n"
+"\n"
+"// Scatters instances on the surface of a mesh block, similarly to `VoxelInstanceGenerator::generate_transforms`.\n"
+"// Each invocation processes one candidate (a vertex or a triangle of the mesh, depending on the emit mode), and writes\n"
+"// its transform in the output buffer. Candidates that get filtered out are marked as such, so the CPU can skip them.\n"
+"// Random numbers are obtained by hashing the index of the candidate, so results don't depend on execution order, but\n"
+"// they differ from the CPU implementation.\n"
+"\n"
+"layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;\n"
+"\n"
+"layout (set = 0, binding = 0, std430) restrict readonly buffer MeshVertices {\n"
+"	vec3 data[];\n"
+"} u_vertices;\n"
+"\n"
+"layout (set = 0, binding = 1, std430) restrict readonly buffer MeshNormals {\n"
+"	vec3 data[];\n"
+"} u_normals;\n"
+"\n"
+"layout (set = 0, binding = 2, std430) restrict readonly buffer MeshIndices {\n"
+"	int data[];\n"
+"} u_indices;\n"
+"\n"
+"layout (set = 0, binding = 3, std430) restrict readonly buffer Params {\n"
+"	// Position of the block relative to the instancer\n"
+"	vec3 block_origin;\n"
+"	// Size of the block in world space\n"
+"	float block_size;\n"
+"	int emit_mode;\n"
+"	uint candidate_count;\n"
+"	uint triangle_count;\n"
+"	uint seed;\n"
+"	uint octant_mask;\n"
+"	// Probability of a vertex to be picked when emitting from vertices, from 0 to 0xffffffff\n"
+"	uint vertex_density;\n"
+"	float jitter;\n"
+"	float triangle_area_threshold;\n"
+"	float vertical_alignment;\n"
+"	float offset_along_normal;\n"
+"	float min_scale;\n"
+"	float scale_range;\n"
+"	int scale_distribution;\n"
+"	uint flags;\n"
+"	float normal_min_y;\n"
+"	float normal_max_y;\n"
+"	float min_height;\n"
+"	float max_height;\n"
+"	// Where results of this block start in the output buffer, in floats\n"
+"	uint output_start;\n"
+"	int up_mode;\n"
+"} u_params;\n"
+"\n"
+"layout (set = 0, binding = 4, std430) restrict writeonly buffer OutputBuffer {\n"
+"	// 16 floats per candidate. The first 12 are a transform laid out like in a MultiMesh buffer, the next one is 1 if\n"
+"	// the instance was kept, 0 otherwise.\n"
+"	float data[];\n"
+"} u_output;\n"
+"\n"
+"// Must match `VoxelInstanceGenerator::EmitMode`\n"
+"const int EMIT_FROM_VERTICES = 0;\n"
+"const int EMIT_FROM_FACES_FAST = 1;\n"
+"const int EMIT_ONE_PER_TRIANGLE = 3;\n"
+"\n"
+"// Must match `VoxelInstanceGenerator::Distribution`\n"
+"const int DISTRIBUTION_QUADRATIC = 1;\n"
+"const int DISTRIBUTION_CUBIC = 2;\n"
+"const int DISTRIBUTION_QUINTIC = 3;\n"
+"\n"
+"// Must match `UpMode`\n"
+"const int UP_MODE_SPHERE = 1;\n"
+"\n"
+"const uint FLAG_RANDOM_VERTICAL_FLIP = 1;\n"
+"const uint FLAG_RANDOM_ROTATION = 2;\n"
+"const uint FLAG_SLOPE_FILTER = 4;\n"
+"const uint FLAG_HEIGHT_FILTER = 8;\n"
+"\n"
+"const uint FLOATS_PER_CANDIDATE = 16;\n"
+"const uint VALID_OFFSET = 12;\n"
+"\n"
+"// PCG hash, see https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/\n"
+"uint hash_u32(uint x) {\n"
+"	const uint state = x * 747796405u + 2891336453u;\n"
+"	const uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;\n"
+"	return (word >> 22u) ^ word;\n"
+"}\n"
+"\n"
+"uint rand_u32(inout uint state) {\n"
+"	state = hash_u32(state);\n"
+"	return state;\n"
+"}\n"
+"\n"
+"// Returns a number between 0 and 1\n"
+"float rand_f(inout uint state) {\n"
+"	return float(rand_u32(state) >> 8u) / 16777216.0;\n"
+"}\n"
+"\n"
+"float get_triangle_area(vec3 a, vec3 b, vec3 c) {\n"
+"	return 0.5 * length(cross(b - a, c - a));\n"
+"}\n"
+"\n"
+"void reject(uint output_index) {\n"
+"	u_output.data[output_index + VALID_OFFSET] = 0.0;\n"
+"}\n"
+"\n"
+"void main() {\n"
+"	const uint candidate_index = gl_GlobalInvocationID.x;\n"
+"	if (candidate_index >= u_params.candidate_count) {\n"
+"		return;\n"
+"	}\n"
+"\n"
+"	const uint output_index = u_params.output_start + candidate_index * FLOATS_PER_CANDIDATE;\n"
+"	uint rng = hash_u32(u_params.seed ^ hash_u32(candidate_index));\n"
+"\n"
+"	vec3 position;\n"
+"	vec3 normal;\n"
+"\n"
+"	if (u_params.emit_mode == EMIT_FROM_VERTICES) {\n"
+"		if (rand_u32(rng) >= u_params.vertex_density) {\n"
+"			reject(output_index);\n"
+"			return;\n"
+"		}\n"
+"		position = u_vertices.data[candidate_index];\n"
+"		normal = u_normals.data[candidate_index];\n"
+"		// Ignore vertices located on the positive faces of the block. They are usually shared with the neighbor\n"
+"		// block, which causes a density bias and overlapping instances\n"
+"		const float margin = u_params.block_size - u_params.block_size * 0.01;\n"
+"		if (position.x > margin || position.y > margin || position.z > margin) {\n"
+"			reject(output_index);\n"
+"			return;\n"
+"		}\n"
+"\n"
+"	} else {\n"
+"		uint ii;\n"
+"		if (u_params.emit_mode == EMIT_FROM_FACES_FAST) {\n"
+"			// Pick a random triangle\n"
+"			ii = (rand_u32(rng) % u_params.triangle_count) * 3;\n"
+"		} else {\n"
+"			ii = candidate_index * 3;\n"
+"		}\n"
+"\n"
+"		const int ia = u_indices.data[ii];\n"
+"		const int ib = u_indices.data[ii + 1];\n"
+"		const int ic = u_indices.data[ii + 2];\n"
+"\n"
+"		const vec3 pa = u_vertices.data[ia];\n"
+"		const vec3 pb = u_vertices.data[ib];\n"
+"		const vec3 pc = u_vertices.data[ic];\n"
+"\n"
+"		const vec3 na = u_normals.data[ia];\n"
+"		const vec3 nb = u_normals.data[ib];\n"
+"		const vec3 nc = u_normals.data[ic];\n"
+"\n"
+"		if (u_params.emit_mode == EMIT_FROM_FACES_FAST) {\n"
+"			const float t0 = rand_f(rng);\n"
+"			const float t1 = rand_f(rng);\n"
+"			// This is an approximation of a uniform distribution\n"
+"			position = mix(mix(pa, pb, t0), pc, t1);\n"
+"			normal = mix(mix(na, nb, t0), nc, t1);\n"
+"\n"
+"		} else {\n"
+"			if (u_params.triangle_area_threshold > 0.0 &&\n"
+"				get_triangle_area(pa, pb, pc) < u_params.triangle_area_threshold) {\n"
+"				reject(output_index);\n"
+"				return;\n"
+"			}\n"
+"\n"
+"			position = (pa + pb + pc) / 3.0;\n"
+"			normal = (na + nb + nc) / 3.0;\n"
+"\n"
+"			if (u_params.jitter != 0.0) {\n"
+"				const float t0 = rand_f(rng);\n"
+"				const float t1 = rand_f(rng);\n"
+"				const vec3 rp = mix(mix(pa, pb, t0), pc, t1);\n"
+"				const vec3 rn = mix(mix(na, nb, t0), nc, t1);\n"
+"				position = mix(position, rp, u_params.jitter);\n"
+"				normal = mix(normal, rn, u_params.jitter);\n"
+"			}\n"
+"		}\n"
+"	}\n"
+"\n"
+"	// Filter out by octants\n"
+"	{\n"
+"		const float h = u_params.block_size * 0.5;\n"
+"		const uint octant_index = uint(position.x > h) | (uint(position.y > h) << 1) | (uint(position.z > h) << 2);\n"
+"		if ((u_params.octant_mask & (1u << octant_index)) == 0) {\n"
+"			reject(output_index);\n"
+"			return;\n"
+"		}\n"
+"	}\n"
+"\n"
+"	const vec3 world_position = u_params.block_origin + position;\n"
+"	vec3 global_up = vec3(0.0, 1.0, 0.0);\n"
+"	if (u_params.up_mode == UP_MODE_SPHERE) {\n"
+"		global_up = normalize(world_position);\n"
+"	}\n"
+"\n"
+"	// Mesh normals are not always normalized\n"
+"	const vec3 surface_normal = normalize(normal);\n"
+"\n"
+"	if ((u_params.flags & FLAG_SLOPE_FILTER) != 0) {\n"
+"		const float ny = u_params.up_mode == UP_MODE_SPHERE ? dot(surface_normal, global_up) : surface_normal.y;\n"
+"		if (ny < u_params.normal_min_y || ny > u_params.normal_max_y) {\n"
+"			reject(output_index);\n"
+"			return;\n"
+"		}\n"
+"	}\n"
+"\n"
+"	if ((u_params.flags & FLAG_HEIGHT_FILTER) != 0) {\n"
+"		const float y = u_params.up_mode == UP_MODE_SPHERE ? length(world_position) : world_position.y;\n"
+"		if (y < u_params.min_height || y > u_params.max_height) {\n"
+"			reject(output_index);\n"
+"			return;\n"
+"		}\n"
+"	}\n"
+"\n"
+"	vec3 axis_y;\n"
+"	if (u_params.vertical_alignment == 0.0) {\n"
+"		axis_y = surface_normal;\n"
+"	} else if (u_params.vertical_alignment < 1.0) {\n"
+"		axis_y = normalize(mix(normal, global_up, u_params.vertical_alignment));\n"
+"	} else {\n"
+"		axis_y = global_up;\n"
+"	}\n"
+"\n"
+"	position += u_params.offset_along_normal * axis_y;\n"
+"\n"
+"	// Allows to use two faces of a single rock to create variety in the same layer\n"
+"	if ((u_params.flags & FLAG_RANDOM_VERTICAL_FLIP) != 0 && (rand_u32(rng) & 1u) == 1u) {\n"
+"		axis_y = -axis_y;\n"
+"	}\n"
+"\n"
+"	// If the surface is aligned with the look axis, we pick a different one to avoid a broken basis\n"
+"	const vec3 fixed_look_axis = u_params.up_mode == UP_MODE_SPHERE ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);\n"
+"	const vec3 fixed_look_axis_alternative =\n"
+"			u_params.up_mode == UP_MODE_SPHERE ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);\n"
+"\n"
+"	vec3 dir = fixed_look_axis;\n"
+"	if ((u_params.flags & FLAG_RANDOM_ROTATION) != 0) {\n"
+"		// Bounded number of attempts, we fall back to a fixed axis if all of them are too close to the up axis\n"
+"		for (int attempt = 0; attempt < 4; ++attempt) {\n"
+"			const vec3 rdir = vec3(rand_f(rng) - 0.5, rand_f(rng) - 0.5, rand_f(rng) - 0.5);\n"
+"			const float rdir_len = length(rdir);\n"
+"			if (rdir_len > 0.0001 && abs(dot(rdir / rdir_len, axis_y)) <= 0.9999) {\n"
+"				dir = rdir / rdir_len;\n"
+"				break;\n"
+"			}\n"
+"		}\n"
+"	}\n"
+"	if (abs(dot(dir, axis_y)) > 0.9999) {\n"
+"		dir = fixed_look_axis_alternative;\n"
+"	}\n"
+"\n"
+"	vec3 axis_x = normalize(cross(axis_y, dir));\n"
+"	vec3 axis_z = cross(axis_x, axis_y);\n"
+"\n"
+"	float scale = u_params.min_scale;\n"
+"	if (u_params.scale_range > 0.0) {\n"
+"		float r = rand_f(rng);\n"
+"		if (u_params.scale_distribution == DISTRIBUTION_QUADRATIC) {\n"
+"			r = r * r;\n"
+"		} else if (u_params.scale_distribution == DISTRIBUTION_CUBIC) {\n"
+"			r = r * r * r;\n"
+"		} else if (u_params.scale_distribution == DISTRIBUTION_QUINTIC) {\n"
+"			r = r * r * r * r * r;\n"
+"		}\n"
+"		scale = u_params.min_scale + u_params.scale_range * r;\n"
+"	}\n"
+"\n"
+"	axis_x *= scale;\n"
+"	axis_y *= scale;\n"
+"	axis_z *= scale;\n"
+"\n"
+"	// Rows of the basis followed by the origin component, like a MultiMesh buffer\n"
+"	u_output.data[output_index + 0] = axis_x.x;\n"
+"	u_output.data[output_index + 1] = axis_y.x;\n"
+"	u_output.data[output_index + 2] = axis_z.x;\n"
+"	u_output.data[output_index + 3] = position.x;\n"
+"	u_output.data[output_index + 4] = axis_x.y;\n"
+"	u_output.data[output_index + 5] = axis_y.y;\n"
+"	u_output.data[output_index + 6] = axis_z.y;\n"
+"	u_output.data[output_index + 7] = position.y;\n"
+"	u_output.data[output_index + 8] = axis_x.z;\n"
+"	u_output.data[output_index + 9] = axis_y.z;\n"
+"	u_output.data[output_index + 10] = axis_z.z;\n"
+"	u_output.data[output_index + 11] = position.z;\n"
+"	u_output.data[output_index + VALID_OFFSET] = 1.0;\n"
+"}\n";
+// clang-format on
@@ -0,0 +1,166 @@
+// Generated file
+
+// clang-format off
+const char *g_mesh_sdf_shader =
+"#version 450\n"
+"\n"
+"// Bakes a signed distance field from a triangle mesh, with the same algorithm as\n"
+"// `mesh_sdf::generate_mesh_sdf_partitioned`. Each invocation computes one cell of the grid, by finding the closest\n"
+"// triangle among those overlapping chunks near the chunk containing the cell. Distances are exact, and signs have the\n"
+"// same ambiguities as the CPU version, so they may be fixed afterwards the same way.\n"
+"\n"
+"layout (local_size_x = 4, local_size_y = 4, local_size_z = 4) in;\n"
+"\n"
+"layout (set = 0, binding = 0, std430) restrict readonly buffer Triangles {\n"
+"	// 10 vectors per triangle, see `TRIANGLE_STRIDE`\n"
+"	vec4 data[];\n"
+"} u_triangles;\n"
+"\n"
+"layout (set = 0, binding = 1, std430) restrict readonly buffer Chunks {\n"
+"	// One per chunk of the partition grid, in ZXY order.\n"
+"	// x: position of the list of near chunks in the indices buffer\n"
+"	// y: number of near chunks\n"
+"	// z: position of the list of triangles in the indices buffer\n"
+"	// w: number of triangles\n"
+"	uvec4 data[];\n"
+"} u_chunks;\n"
+"\n"
+"layout (set = 0, binding = 2, std430) restrict readonly buffer Indices {\n"
+"	uint data[];\n"
+"} u_indices;\n"
+"\n"
+"layout (set = 0, binding = 3, std430) restrict readonly buffer Params {\n"
+"	// Transforms cell positions into mesh space\n"
+"	vec3 grid_translation;\n"
+"	// Where results start in the output buffer, in floats\n"
+"	uint output_start;\n"
+"	vec3 grid_scale;\n"
+"	float chunk_size;\n"
+"	ivec3 resolution;\n"
+"	vec3 chunk_grid_min_pos;\n"
+"	ivec3 chunk_grid_size;\n"
+"} u_params;\n"
+"\n"
+"layout (set = 0, binding = 4, std430) restrict writeonly buffer OutputBuffer {\n"
+"	// Signed distances in ZXY order\n"
+"	float data[];\n"
+"} u_output;\n"
+"\n"
+"// Must match the layout written by `GenMeshSDFGPUTask`\n"
+"const uint TRIANGLE_STRIDE = 10;\n"
+"// Vertices, with inverse squared lengths of edges in W\n"
+"const uint TRIANGLE_V1_INV_V21_LENGTH_SQUARED = 0;\n"
+"const uint TRIANGLE_V2_INV_V32_LENGTH_SQUARED = 1;\n"
+"const uint TRIANGLE_V3_INV_V13_LENGTH_SQUARED = 2;\n"
+"// Edge, with inverse squared length of the normal in W\n"
+"const uint TRIANGLE_V21_INV_NOR_LENGTH_SQUARED = 3;\n"
+"const uint TRIANGLE_V32 = 4;\n"
+"const uint TRIANGLE_V13 = 5;\n"
+"const uint TRIANGLE_NOR = 6;\n"
+"const uint TRIANGLE_V21_CROSS_NOR = 7;\n"
+"const uint TRIANGLE_V32_CROSS_NOR = 8;\n"
+"const uint TRIANGLE_V13_CROSS_NOR = 9;\n"
+"\n"
+"const float FAR_DISTANCE_SQUARED = 9999999.0;\n"
+"\n"
+"float sign_nonzero(float x) {\n"
+"	return x < 0.0 ? -1.0 : 1.0;\n"
+"}\n"
+"\n"
+"float length_squared(vec3 v) {\n"
+"	return dot(v, v);\n"
+"}\n"
+"\n"
+"vec4 get_triangle_data(uint triangle_index, uint field) {\n"
+"	return u_triangles.data[triangle_index * TRIANGLE_STRIDE + field];\n"
+"}\n"
+"\n"
+"// Same as `mesh_sdf::get_distance_to_triangle_squared_precalc`\n"
+"// https://iquilezles.org/articles/triangledistance/\n"
+"float get_distance_to_triangle_squared(uint ti, vec3 p) {\n"
+"	const vec4 v1 = get_triangle_data(ti, TRIANGLE_V1_INV_V21_LENGTH_SQUARED);\n"
+"	const vec4 v2 = get_triangle_data(ti, TRIANGLE_V2_INV_V32_LENGTH_SQUARED);\n"
+"	const vec4 v3 = get_triangle_data(ti, TRIANGLE_V3_INV_V13_LENGTH_SQUARED);\n"
+"\n"
+"	const vec3 p1 = p - v1.xyz;\n"
+"	const vec3 p2 = p - v2.xyz;\n"
+"	const vec3 p3 = p - v3.xyz;\n"
+"\n"
+"	const float det = //\n"
+"			sign_nonzero(dot(get_triangle_data(ti, TRIANGLE_V21_CROSS_NOR).xyz, p1)) + //\n"
+"			sign_nonzero(dot(get_triangle_data(ti, TRIANGLE_V32_CROSS_NOR).xyz, p2)) + //\n"
+"			sign_nonzero(dot(get_triangle_data(ti, TRIANGLE_V13_CROSS_NOR).xyz, p3));\n"
+"\n"
+"	const vec4 v21 = get_triangle_data(ti, TRIANGLE_V21_INV_NOR_LENGTH_SQUARED);\n"
+"\n"
+"	if (det < 2.0) {\n"
+"		// Outside of the prism: get distance to closest edge\n"
+"		const vec3 v32 = get_triangle_data(ti, TRIANGLE_V32).xyz;\n"
+"		const vec3 v13 = get_triangle_data(ti, TRIANGLE_V13).xyz;\n"
+"		return min(\n"
+"				min(\n"
+"						length_squared(v21.xyz * clamp(dot(v21.xyz, p1) * v1.w, 0.0, 1.0) - p1),\n"
+"						length_squared(v32 * clamp(dot(v32, p2) * v2.w, 0.0, 1.0) - p2)\n"
+"				),\n"
+"				length_squared(v13 * clamp(dot(v13, p3) * v3.w, 0.0, 1.0) - p3)\n"
+"		);\n"
+"	} else {\n"
+"		// Inside the prism: get distance to plane\n"
+"		const float d = dot(get_triangle_data(ti, TRIANGLE_NOR).xyz, p1);\n"
+"		return d * d * v21.w;\n"
+"	}\n"
+"}\n"
+"\n"
+"uint get_zxy_index(ivec3 pos, ivec3 size) {\n"
+"	return pos.y + size.y * (pos.x + size.x * pos.z);\n"
+"}\n"
+"\n"
+"void main() {\n"
+"	const ivec3 cell_pos = ivec3(gl_GlobalInvocationID);\n"
+"	if (any(greaterThanEqual(cell_pos, u_params.resolution))) {\n"
+"		return;\n"
+"	}\n"
+"\n"
+"	const vec3 pos = u_params.grid_translation + u_params.grid_scale * vec3(cell_pos);\n"
+"\n"
+"	ivec3 chunk_pos = ivec3(floor((pos - u_params.chunk_grid_min_pos) / u_params.chunk_size));\n"
+"	chunk_pos = clamp(chunk_pos, ivec3(0), u_params.chunk_grid_size - ivec3(1));\n"
+"	const uvec4 chunk = u_chunks.data[get_zxy_index(chunk_pos, u_params.chunk_grid_size)];\n"
+"\n"
+"	float min_distance_squared = FAR_DISTANCE_SQUARED;\n"
+"	uint closest_triangle_index = 0xffffffff;\n"
+"\n"
+"	for (uint i = 0; i < chunk.y; ++i) {\n"
+"		const uvec4 near_chunk = u_chunks.data[u_indices.data[chunk.x + i]];\n"
+"\n"
+"		for (uint j = 0; j < near_chunk.w; ++j) {\n"
+"			const uint triangle_index = u_indices.data[near_chunk.z + j];\n"
+"			const float sqd = get_distance_to_triangle_squared(triangle_index, pos);\n"
+"\n"
+"			if (sqd < min_distance_squared) {\n"
+"				min_distance_squared = sqd;\n"
+"				closest_triangle_index = triangle_index;\n"
+"			}\n"
+"		}\n"
+"	}\n"
+"\n"
+"	float sd = sqrt(FAR_DISTANCE_SQUARED);\n"
+"\n"
+"	if (closest_triangle_index != 0xffffffff) {\n"
+"		const vec3 v1 = get_triangle_data(closest_triangle_index, TRIANGLE_V1_INV_V21_LENGTH_SQUARED).xyz;\n"
+"		const vec3 v2 = get_triangle_data(closest_triangle_index, TRIANGLE_V2_INV_V32_LENGTH_SQUARED).xyz;\n"
+"		const vec3 v13 = get_triangle_data(closest_triangle_index, TRIANGLE_V13).xyz;\n"
+"\n"
+"		// Same as `mesh_sdf::get_normal`\n"
+"		const vec3 plane_normal = cross(v13, normalize(v1 - v2));\n"
+"		const float plane_d = dot(plane_normal, v1);\n"
+"\n"
+"		sd = sqrt(min_distance_squared);\n"
+"		if (dot(plane_normal, pos) <= plane_d) {\n"
+"			sd = -sd;\n"
+"		}\n"
+"	}\n"
+"\n"
+"	u_output.data[u_params.output_start + get_zxy_index(cell_pos, u_params.resolution)] = sd;\n"
+"}\n";
+// clang-format on
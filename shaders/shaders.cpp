@@ -10,6 +10,8 @@ namespace zylann::voxel {
 #include "detail_normalmap_shader.h"
 #include "dilate_normalmap_shader.h"
 #include "fast_noise_lite_shader.h"
+#include "instance_scatter_shader.h"
+#include "mesh_sdf_shader.h"
 #include "modifier_mesh_shader_snippet.h"
 #include "modifier_sphere_shader_snippet.h"
 
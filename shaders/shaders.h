@@ -15,6 +15,8 @@ extern const char *g_detail_modifier_shader_template_0;
 extern const char *g_detail_modifier_shader_template_1;
 extern const char *g_detail_normalmap_shader;
 extern const char *g_dilate_normalmap_shader;
+extern const char *g_instance_scatter_shader;
+extern const char *g_mesh_sdf_shader;
 extern const char *g_modifier_sphere_shader_snippet;
 extern const char *g_modifier_mesh_shader_snippet;
 extern const char *g_fast_noise_lite_shader[];
@@ -176,8 +176,11 @@ if __name__ == '__main__':
 	process_file("dev/block_modifier_template.glsl",                  "block_modifier_shader_template.h")
 	process_file("dev/detail_gather_hits.glsl",                       "detail_gather_hits_shader.h")
 	process_file("dev/detail_generator_template.glsl",                "detail_generator_shader_template.h")
+	process_file("dev/detail_modifier_template.glsl",                 "detail_modifier_shader_template.h")
 	process_file("dev/detail_normalmap.glsl",                         "detail_normalmap_shader.h")
 	process_file("dev/dilate.glsl",                                   "dilate_normalmap_shader.h")
+	process_file("dev/instance_scatter.glsl",                         "instance_scatter_shader.h")
+	process_file("dev/mesh_sdf.glsl",                                 "mesh_sdf_shader.h")
 	process_file("dev/modifier_mesh_snippet.glsl",                    "modifier_mesh_shader_snippet.h")
 	process_file("dev/modifier_sphere_snippet.glsl",                  "modifier_sphere_shader_snippet.h")
 	process_file("dev/transvoxel_minimal.gdshader",                   "transvoxel_minimal_shader.h")
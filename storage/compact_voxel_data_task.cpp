@@ -0,0 +1,54 @@
+#include "compact_voxel_data_task.h"
+#include "../util/errors.h"
+#include "../util/godot/classes/time.h"
+#include "../util/profiling.h"
+#include "voxel_data.h"
+
+#include <atomic>
+
+namespace zylann::voxel {
+
+namespace {
+std::atomic_int g_running_compact_tasks_count = { 0 };
+std::atomic_uint64_t g_compaction_reclaimed_bytes = { 0 };
+} // namespace
+
+CompactVoxelDataTask::CompactVoxelDataTask(
+		std::shared_ptr<VoxelData> p_data,
+		unsigned int p_block_budget,
+		unsigned int p_cold_delay_msec
+) :
+		_data(p_data), _block_budget(p_block_budget), _cold_delay_msec(p_cold_delay_msec) {
+	++g_running_compact_tasks_count;
+}
+
+CompactVoxelDataTask::~CompactVoxelDataTask() {
+	--g_running_compact_tasks_count;
+}
+
+int CompactVoxelDataTask::get_running_count() {
+	return g_running_compact_tasks_count;
+}
+
+uint64_t CompactVoxelDataTask::get_total_reclaimed_bytes() {
+	return g_compaction_reclaimed_bytes;
+}
+
+void CompactVoxelDataTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(_data != nullptr);
+
+	const uint64_t now_msec = _cold_delay_msec > 0 ? Time::get_singleton()->get_ticks_msec() : 0;
+	const VoxelData::CompactionResult result = _data->compact_blocks(_block_budget, _cold_delay_msec, now_msec);
+
+	if (result.reclaimed_bytes > 0) {
+		g_compaction_reclaimed_bytes += result.reclaimed_bytes;
+	}
+}
+
+TaskPriority CompactVoxelDataTask::get_priority() {
+	// Nothing waits on this, so it should only take threads that have nothing else to do
+	return TaskPriority::min();
+}
+
+} // namespace zylann::voxel
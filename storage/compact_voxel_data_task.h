@@ -0,0 +1,44 @@
+#ifndef VOXEL_COMPACT_VOXEL_DATA_TASK_H
+#define VOXEL_COMPACT_VOXEL_DATA_TASK_H
+
+#include "../util/tasks/threaded_task.h"
+#include <cstdint>
+#include <memory>
+
+namespace zylann::voxel {
+
+class VoxelData;
+
+// Low-priority background task re-compressing a limited amount of loaded blocks of a volume. Edits can leave blocks
+// with channels that could be stored in a cheaper form, and this gets it back over time without stalling edits.
+class CompactVoxelDataTask : public IThreadedTask {
+public:
+	CompactVoxelDataTask(
+			std::shared_ptr<VoxelData> p_data,
+			unsigned int p_block_budget,
+			unsigned int p_cold_delay_msec
+	);
+	~CompactVoxelDataTask();
+
+	const char *get_debug_name() const override {
+		return "CompactVoxelData";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+	TaskPriority get_priority() override;
+
+	// How many of these tasks exist at the moment
+	static int get_running_count();
+	// Total memory reclaimed by these tasks since the engine started
+	static uint64_t get_total_reclaimed_bytes();
+
+private:
+	std::shared_ptr<VoxelData> _data;
+	unsigned int _block_budget;
+	// See `VoxelData::compact_blocks`
+	unsigned int _cold_delay_msec;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_COMPACT_VOXEL_DATA_TASK_H
@@ -3,6 +3,7 @@
 
 #include "../constants/voxel_constants.h"
 #include "../util/containers/span.h"
+#include "../util/math/morton.h"
 #include "../util/math/vector3i.h"
 #include <cstdint>
 
@@ -79,6 +80,44 @@ inline void copy_3d_region_zxy(
 	);
 }
 
+// Reorders a cubic grid between ZXY and Morton order (see `math::encode_morton_3d`).
+// Morton order only covers grids with a power of two size without gaps.
+template <typename T>
+void copy_zxy_to_morton(Span<const T> src, Span<T> dst, unsigned int size_po2) {
+	const int size = 1 << size_po2;
+	ZN_ASSERT_RETURN(size_po2 <= 10);
+	ZN_ASSERT_RETURN(src.size() == dst.size());
+	ZN_ASSERT_RETURN(src.size() == Vector3iUtil::get_volume_u64(Vector3iUtil::create(size)));
+	unsigned int src_i = 0;
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size; ++pos.z) {
+		for (pos.x = 0; pos.x < size; ++pos.x) {
+			for (pos.y = 0; pos.y < size; ++pos.y) {
+				dst[math::encode_morton_3d(pos)] = src[src_i];
+				++src_i;
+			}
+		}
+	}
+}
+
+template <typename T>
+void copy_morton_to_zxy(Span<const T> src, Span<T> dst, unsigned int size_po2) {
+	const int size = 1 << size_po2;
+	ZN_ASSERT_RETURN(size_po2 <= 10);
+	ZN_ASSERT_RETURN(src.size() == dst.size());
+	ZN_ASSERT_RETURN(src.size() == Vector3iUtil::get_volume_u64(Vector3iUtil::create(size)));
+	unsigned int dst_i = 0;
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size; ++pos.z) {
+		for (pos.x = 0; pos.x < size; ++pos.x) {
+			for (pos.y = 0; pos.y < size; ++pos.y) {
+				dst[dst_i] = src[math::encode_morton_3d(pos)];
+				++dst_i;
+			}
+		}
+	}
+}
+
 template <typename T>
 void fill_3d_region_zxy(Span<T> dst, Vector3i dst_size, Vector3i dst_min, Vector3i dst_max, const T value) {
 	using namespace math;
@@ -2,6 +2,7 @@
 #define VOXEL_CUSTOM_METADATA_H
 
 #include "../../util/containers/span.h"
+#include "../../util/containers/std_vector.h"
 
 namespace zylann::voxel {
 
@@ -17,6 +18,17 @@ public:
 	// `get_serialized_size()`. Returns how many bytes were written.
 	virtual size_t serialize(Span<uint8_t> dst) const = 0;
 
+	// Appends serialized bytes at the end of `dst`. This is what block serialization uses. The default implementation
+	// goes through `get_serialized_size()` and `serialize()`, types that can write their bytes directly may override it
+	// to skip the size pass.
+	virtual void serialize_append(StdVector<uint8_t> &dst) const {
+		const size_t begin = dst.size();
+		dst.resize(begin + get_serialized_size());
+		const size_t written_size = serialize(to_span(dst).sub(begin));
+		ZN_ASSERT(begin + written_size <= dst.size());
+		dst.resize(begin + written_size);
+	}
+
 	// Deserializes this metadata from the given bytes.
 	// Returns `true` on success, `false` otherwise. `out_read_size` must be assigned to the number of bytes read.
 	virtual bool deserialize(Span<const uint8_t> src, uint64_t &out_read_size) = 0;
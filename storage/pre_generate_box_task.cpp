@@ -0,0 +1,107 @@
+#include "pre_generate_box_task.h"
+#include "../streams/voxel_stream.h"
+#include "../util/errors.h"
+#include "../util/profiling.h"
+#include "voxel_data.h"
+
+namespace zylann::voxel {
+
+namespace {
+// Blocks are grouped into tasks to amortize scheduling, while keeping enough tasks for all threads to be busy
+const int BLOCKS_PER_TASK_AXIS = 4;
+} // namespace
+
+PreGenerateBoxTask::PreGenerateBoxTask(
+		std::shared_ptr<VoxelData> p_data,
+		Box3i p_block_box,
+		uint8_t p_lod_index,
+		bool p_save_to_stream,
+		std::shared_ptr<Progress> p_progress
+) :
+		_data(p_data),
+		_block_box(p_block_box),
+		_lod_index(p_lod_index),
+		_save_to_stream(p_save_to_stream),
+		_progress(p_progress) {}
+
+PreGenerateBoxTask::~PreGenerateBoxTask() {
+	++_progress->finished_task_count;
+}
+
+void PreGenerateBoxTask::create_tasks(
+		std::shared_ptr<VoxelData> data,
+		Box3i voxel_box,
+		bool save_to_stream,
+		std::shared_ptr<Progress> progress,
+		StdVector<IThreadedTask *> &out_tasks
+) {
+	ZN_ASSERT_RETURN(data != nullptr);
+	ZN_ASSERT_RETURN(progress != nullptr);
+
+	const size_t first_task_index = out_tasks.size();
+
+	voxel_box.clip(data->get_bounds());
+	const unsigned int data_block_size = data->get_block_size();
+	const unsigned int lod_count = data->get_lod_count();
+
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		const Box3i lod_block_box = voxel_box.downscaled(data_block_size << lod_index);
+		const Box3i chunk_box = lod_block_box.downscaled(BLOCKS_PER_TASK_AXIS);
+
+		chunk_box.for_each_cell_zxy([&](Vector3i chunk_pos) {
+			const Box3i block_box =
+					Box3i(chunk_pos * BLOCKS_PER_TASK_AXIS, Vector3iUtil::create(BLOCKS_PER_TASK_AXIS))
+							.clipped(lod_block_box);
+			if (block_box.is_empty()) {
+				return;
+			}
+			out_tasks.push_back(ZN_NEW(PreGenerateBoxTask(data, block_box, lod_index, save_to_stream, progress)));
+		});
+	}
+
+	progress->task_count = static_cast<uint32_t>(out_tasks.size() - first_task_index);
+}
+
+void PreGenerateBoxTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(_data != nullptr);
+
+	StdVector<VoxelData::PreGeneratedBlock> generated_blocks;
+	_data->pre_generate_blocks(_block_box, _lod_index, &generated_blocks);
+
+	if (generated_blocks.size() == 0) {
+		return;
+	}
+
+	if (_save_to_stream) {
+		Ref<VoxelStream> stream = _data->get_stream();
+
+		if (stream.is_valid()) {
+			ZN_PROFILE_SCOPE_NAMED("Save");
+
+			StdVector<VoxelStream::VoxelQueryData> queries;
+			queries.reserve(generated_blocks.size());
+			for (const VoxelData::PreGeneratedBlock &block : generated_blocks) {
+				VoxelStream::VoxelQueryData q{ *block.voxels, block.position, _lod_index, VoxelStream::RESULT_ERROR };
+				queries.push_back(q);
+			}
+
+			// Blocks are in the map already, so they could be edited while we save them
+			SpatialLock3D::Read srlock(_data->get_spatial_lock(_lod_index), _block_box);
+			stream->save_voxel_blocks(to_span(queries));
+		}
+	}
+
+	_progress->generated_block_count += generated_blocks.size();
+}
+
+TaskPriority PreGenerateBoxTask::get_priority() {
+	// Lower than tasks viewers are waiting on, but higher than background maintenance
+	return TaskPriority(0, 0, 1, 0);
+}
+
+bool PreGenerateBoxTask::is_cancelled() {
+	return _progress->cancellation_token.is_cancelled();
+}
+
+} // namespace zylann::voxel
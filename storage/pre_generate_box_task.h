@@ -0,0 +1,70 @@
+#ifndef VOXEL_PRE_GENERATE_BOX_TASK_H
+#define VOXEL_PRE_GENERATE_BOX_TASK_H
+
+#include "../util/containers/std_vector.h"
+#include "../util/math/box3i.h"
+#include "../util/tasks/cancellation_token.h"
+#include "../util/tasks/threaded_task.h"
+#include <atomic>
+#include <memory>
+
+namespace zylann::voxel {
+
+class VoxelData;
+
+// Generates missing blocks of one chunk of a box, at one LOD. A large box is split into many of these so they run in
+// parallel, and so the caller can follow progress and cancel the remaining work.
+class PreGenerateBoxTask : public IThreadedTask {
+public:
+	// Shared between all the tasks of the same request, and the requester
+	struct Progress {
+		TaskCancellationToken cancellation_token;
+		// Set before scheduling tasks
+		uint32_t task_count = 0;
+		// Tasks count as finished when they are destroyed, which also happens when they are cancelled
+		std::atomic_uint32_t finished_task_count = { 0 };
+		std::atomic_uint32_t generated_block_count = { 0 };
+
+		inline bool is_complete() const {
+			return finished_task_count == task_count;
+		}
+	};
+
+	PreGenerateBoxTask(
+			std::shared_ptr<VoxelData> p_data,
+			Box3i p_block_box,
+			uint8_t p_lod_index,
+			bool p_save_to_stream,
+			std::shared_ptr<Progress> p_progress
+	);
+
+	~PreGenerateBoxTask();
+
+	const char *get_debug_name() const override {
+		return "PreGenerateBox";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+	TaskPriority get_priority() override;
+	bool is_cancelled() override;
+
+	// Splits a box in voxels into tasks, appending them to `out_tasks`. Sets the task count of `progress`.
+	static void create_tasks(
+			std::shared_ptr<VoxelData> data,
+			Box3i voxel_box,
+			bool save_to_stream,
+			std::shared_ptr<Progress> progress,
+			StdVector<IThreadedTask *> &out_tasks
+	);
+
+private:
+	std::shared_ptr<VoxelData> _data;
+	Box3i _block_box;
+	uint8_t _lod_index;
+	bool _save_to_stream;
+	std::shared_ptr<Progress> _progress;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_PRE_GENERATE_BOX_TASK_H
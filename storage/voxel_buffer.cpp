@@ -88,6 +88,13 @@ inline uint64_t real_to_raw_voxel(real_t value, VoxelBuffer::Depth depth) {
 			m.d = value;
 			return m.l;
 		}
+		case VoxelBuffer::DEPTH_1_BIT:
+		case VoxelBuffer::DEPTH_2_BIT:
+		case VoxelBuffer::DEPTH_4_BIT: {
+			// Bit-packed depths store small unsigned integers
+			const real_t max_value = (1 << VoxelBuffer::get_depth_bit_count(depth)) - 1;
+			return static_cast<uint64_t>(math::clamp(value, real_t(0), max_value) + real_t(0.5));
+		}
 		default:
 			CRASH_NOW();
 			return 0;
@@ -115,13 +122,347 @@ inline real_t raw_voxel_to_real(uint64_t value, VoxelBuffer::Depth depth) {
 			return m.d;
 		}
 
+		case VoxelBuffer::DEPTH_1_BIT:
+		case VoxelBuffer::DEPTH_2_BIT:
+		case VoxelBuffer::DEPTH_4_BIT:
+			return value;
+
 		default:
 			CRASH_NOW();
 			return 0;
 	}
 }
 
+inline uint64_t get_raw_voxel(const uint8_t *data, size_t i, VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			return data[i];
+		case VoxelBuffer::DEPTH_16_BIT:
+			return reinterpret_cast<const uint16_t *>(data)[i];
+		case VoxelBuffer::DEPTH_32_BIT:
+			return reinterpret_cast<const uint32_t *>(data)[i];
+		case VoxelBuffer::DEPTH_64_BIT:
+			return reinterpret_cast<const uint64_t *>(data)[i];
+		case VoxelBuffer::DEPTH_1_BIT:
+			return VoxelBuffer::get_packed_voxel(data, i, 1);
+		case VoxelBuffer::DEPTH_2_BIT:
+			return VoxelBuffer::get_packed_voxel(data, i, 2);
+		case VoxelBuffer::DEPTH_4_BIT:
+			return VoxelBuffer::get_packed_voxel(data, i, 4);
+		default:
+			ZN_CRASH();
+			return 0;
+	}
+}
+
+inline void set_raw_voxel(uint8_t *data, size_t i, uint64_t value, VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			data[i] = value;
+			break;
+		case VoxelBuffer::DEPTH_16_BIT:
+			reinterpret_cast<uint16_t *>(data)[i] = value;
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			reinterpret_cast<uint32_t *>(data)[i] = value;
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			reinterpret_cast<uint64_t *>(data)[i] = value;
+			break;
+		case VoxelBuffer::DEPTH_1_BIT:
+			VoxelBuffer::set_packed_voxel(data, i, 1, value);
+			break;
+		case VoxelBuffer::DEPTH_2_BIT:
+			VoxelBuffer::set_packed_voxel(data, i, 2, value);
+			break;
+		case VoxelBuffer::DEPTH_4_BIT:
+			VoxelBuffer::set_packed_voxel(data, i, 4, value);
+			break;
+		default:
+			ZN_CRASH();
+	}
+}
+
+// Replicates a bit-packed value over a whole byte
+inline uint8_t get_packed_byte_pattern(uint64_t value, unsigned int bits) {
+	uint8_t pattern = value & ((1 << bits) - 1);
+	for (unsigned int i = bits; i < 8; i <<= 1) {
+		pattern |= pattern << i;
+	}
+	return pattern;
+}
+
+// Sets `count` consecutive bit-packed voxels starting from `begin`. Whole bytes in the middle are set at once.
+inline void fill_packed_voxels(uint8_t *data, size_t begin, size_t count, unsigned int bits, uint64_t value) {
+	const unsigned int voxels_per_byte = 8 / bits;
+	const size_t end = begin + count;
+	size_t i = begin;
+	// Leading voxels sharing their byte with voxels outside of the range
+	for (; i < end && (i % voxels_per_byte) != 0; ++i) {
+		VoxelBuffer::set_packed_voxel(data, i, bits, value);
+	}
+	const size_t whole_bytes = (end - i) / voxels_per_byte;
+	memset(data + i / voxels_per_byte, get_packed_byte_pattern(value, bits), whole_bytes);
+	i += whole_bytes * voxels_per_byte;
+	for (; i < end; ++i) {
+		VoxelBuffer::set_packed_voxel(data, i, bits, value);
+	}
+}
+
+// Bits after the last voxel of a bit-packed channel are padding. They are not guaranteed to be zero (for example when
+// data was set from raw bytes), so they are excluded from comparisons.
+inline uint8_t get_packed_tail_mask(size_t volume, unsigned int bits) {
+	const unsigned int tail_bits = (volume * bits) & 7;
+	return (1 << tail_bits) - 1;
+}
+
+inline bool is_packed_uniform(const uint8_t *data, size_t volume, unsigned int bits) {
+	const uint8_t pattern = get_packed_byte_pattern(VoxelBuffer::get_packed_voxel(data, 0, bits), bits);
+	const size_t whole_bytes = (volume * bits) >> 3;
+	// Compare 8 bytes at a time, many voxels at once
+	const uint64_t pattern64 = pattern * 0x0101010101010101ull;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= whole_bytes; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(uint64_t));
+		if (word != pattern64) {
+			return false;
+		}
+	}
+	for (; i < whole_bytes; ++i) {
+		if (data[i] != pattern) {
+			return false;
+		}
+	}
+	const uint8_t tail_mask = get_packed_tail_mask(volume, bits);
+	return tail_mask == 0 || ((data[whole_bytes] ^ pattern) & tail_mask) == 0;
+}
+
+inline bool packed_voxels_equal(const uint8_t *a, const uint8_t *b, size_t volume, unsigned int bits) {
+	const size_t whole_bytes = (volume * bits) >> 3;
+	if (memcmp(a, b, whole_bytes) != 0) {
+		return false;
+	}
+	const uint8_t tail_mask = get_packed_tail_mask(volume, bits);
+	return tail_mask == 0 || ((a[whole_bytes] ^ b[whole_bytes]) & tail_mask) == 0;
+}
+
+inline size_t get_palette_size_in_bytes(uint64_t volume, unsigned int index_bits) {
+	return sizeof(VoxelBuffer::PaletteHeader) + (sizeof(uint64_t) << index_bits) + ((volume * index_bits + 7) >> 3);
+}
+
+// Smallest index width able to address `count` palette entries
+inline unsigned int get_palette_index_bits(unsigned int count) {
+	unsigned int bits = 1;
+	while ((1u << bits) < count) {
+		bits <<= 1;
+	}
+	return bits;
+}
+
+// A palette is only worth it if it takes less space than raw voxels
+inline bool is_palette_worth_it(uint64_t volume, unsigned int index_bits, VoxelBuffer::Depth depth) {
+	return index_bits <= VoxelBuffer::MAX_PALETTE_INDEX_BITS &&
+			get_palette_size_in_bytes(volume, index_bits) <
+			VoxelBuffer::get_size_in_bytes_for_volume(Vector3i(volume, 1, 1), depth);
+}
+
+// Bulk conversions between raw channel values and floats, giving the same results as `raw_voxel_to_real` and
+// `real_to_raw_voxel`. `stride` is the distance between raw values. Loops are kept simple and branchless so compilers
+// can vectorize them.
+
+inline float decode_raw_value_f(int8_t v) {
+	return s8_to_snorm(v) * constants::QUANTIZED_SDF_8_BITS_SCALE_INV;
+}
+
+inline float decode_raw_value_f(int16_t v) {
+	return s16_to_snorm(v) * constants::QUANTIZED_SDF_16_BITS_SCALE_INV;
+}
+
+inline float decode_raw_value_f(float v) {
+	return v;
+}
+
+inline float decode_raw_value_f(double v) {
+	return v;
+}
+
+template <typename T>
+inline T encode_raw_value_f(float v);
+
+template <>
+inline int8_t encode_raw_value_f<int8_t>(float v) {
+	return snorm_to_s8(v * constants::QUANTIZED_SDF_8_BITS_SCALE);
+}
+
+template <>
+inline int16_t encode_raw_value_f<int16_t>(float v) {
+	return snorm_to_s16(v * constants::QUANTIZED_SDF_16_BITS_SCALE);
+}
+
+template <>
+inline float encode_raw_value_f<float>(float v) {
+	return v;
+}
+
+template <>
+inline double encode_raw_value_f<double>(float v) {
+	return v;
+}
+
+template <typename T>
+inline void decode_raw_values_f(const T *src, size_t stride, float *dst, size_t count) {
+	if (stride == 1) {
+		for (size_t i = 0; i < count; ++i) {
+			dst[i] = decode_raw_value_f(src[i]);
+		}
+	} else {
+		for (size_t i = 0; i < count; ++i) {
+			dst[i] = decode_raw_value_f(src[i * stride]);
+		}
+	}
+}
+
+template <typename T>
+inline void encode_raw_values_f(const float *src, T *dst, size_t stride, size_t count) {
+	if (stride == 1) {
+		for (size_t i = 0; i < count; ++i) {
+			dst[i] = encode_raw_value_f<T>(src[i]);
+		}
+	} else {
+		for (size_t i = 0; i < count; ++i) {
+			dst[i * stride] = encode_raw_value_f<T>(src[i]);
+		}
+	}
+}
+
+// Iterates a box of a buffer by rows of voxels that are contiguous in the values we convert from or to (ZXY order).
+// Rows go along Y, unless the box is a single voxel high, like slices do, in which case rows go along X.
+// `f(size_t buffer_index, size_t buffer_stride, size_t row_length)`
+template <typename F>
+void for_each_row_in_box(Vector3i buffer_size, Box3i box, F f) {
+	if (box.position == Vector3i() && box.size == buffer_size) {
+		f(0, 1, Vector3iUtil::get_volume_u64(box.size));
+		return;
+	}
+	const Vector3i box_max = box.position + box.size;
+	if (box.size.y == 1) {
+		for (int z = box.position.z; z < box_max.z; ++z) {
+			const size_t i = Vector3iUtil::get_zxy_index(Vector3i(box.position.x, box.position.y, z), buffer_size);
+			f(i, buffer_size.y, box.size.x);
+		}
+	} else {
+		for (int z = box.position.z; z < box_max.z; ++z) {
+			for (int x = box.position.x; x < box_max.x; ++x) {
+				const size_t i = Vector3iUtil::get_zxy_index(Vector3i(x, box.position.y, z), buffer_size);
+				f(i, 1, box.size.y);
+			}
+		}
+	}
+}
+
+template <typename T>
+void decode_box_f(const uint8_t *channel_data, Vector3i buffer_size, Box3i box, float *dst) {
+	const T *src = reinterpret_cast<const T *>(channel_data);
+	for_each_row_in_box(buffer_size, box, [src, &dst](size_t src_i, size_t stride, size_t row_length) {
+		decode_raw_values_f(src + src_i, stride, dst, row_length);
+		dst += row_length;
+	});
+}
+
+template <typename T>
+void encode_box_f(uint8_t *channel_data, Vector3i buffer_size, Box3i box, const float *src) {
+	T *dst = reinterpret_cast<T *>(channel_data);
+	for_each_row_in_box(buffer_size, box, [dst, &src](size_t dst_i, size_t stride, size_t row_length) {
+		encode_raw_values_f(src, dst + dst_i, stride, row_length);
+		src += row_length;
+	});
+}
+
+// Integer versions, giving the same results as `get_voxel` and `set_voxel` truncated to 32 bits
+
+template <typename T>
+inline void decode_raw_values_i(const T *src, size_t stride, int32_t *dst, size_t count) {
+	if (stride == 1) {
+		for (size_t i = 0; i < count; ++i) {
+			dst[i] = static_cast<int32_t>(src[i]);
+		}
+	} else {
+		for (size_t i = 0; i < count; ++i) {
+			dst[i] = static_cast<int32_t>(src[i * stride]);
+		}
+	}
+}
+
+template <typename T>
+inline void encode_raw_values_i(const int32_t *src, T *dst, size_t stride, size_t count) {
+	if (stride == 1) {
+		for (size_t i = 0; i < count; ++i) {
+			dst[i] = static_cast<T>(src[i]);
+		}
+	} else {
+		for (size_t i = 0; i < count; ++i) {
+			dst[i * stride] = static_cast<T>(src[i]);
+		}
+	}
+}
+
+template <typename T>
+void decode_box_i(const uint8_t *channel_data, Vector3i buffer_size, Box3i box, int32_t *dst) {
+	const T *src = reinterpret_cast<const T *>(channel_data);
+	for_each_row_in_box(buffer_size, box, [src, &dst](size_t src_i, size_t stride, size_t row_length) {
+		decode_raw_values_i(src + src_i, stride, dst, row_length);
+		dst += row_length;
+	});
+}
+
+template <typename T>
+void encode_box_i(uint8_t *channel_data, Vector3i buffer_size, Box3i box, const int32_t *src) {
+	T *dst = reinterpret_cast<T *>(channel_data);
+	for_each_row_in_box(buffer_size, box, [dst, &src](size_t dst_i, size_t stride, size_t row_length) {
+		encode_raw_values_i(src, dst + dst_i, stride, row_length);
+		src += row_length;
+	});
+}
+
 namespace {
+
+// Collects distinct values of a channel, mapping each of them to a palette index
+struct PaletteBuilder {
+	static const unsigned int CAPACITY = 1 << VoxelBuffer::MAX_PALETTE_INDEX_BITS;
+	static const unsigned int TABLE_SIZE = CAPACITY * 2;
+
+	FixedArray<uint64_t, TABLE_SIZE> table_keys;
+	FixedArray<int16_t, TABLE_SIZE> table_indices;
+	FixedArray<uint64_t, CAPACITY> values;
+	unsigned int count = 0;
+
+	PaletteBuilder() {
+		for (unsigned int i = 0; i < TABLE_SIZE; ++i) {
+			table_indices[i] = -1;
+		}
+	}
+
+	// Returns -1 if the value is new and the palette is full
+	int get_or_add(uint64_t value) {
+		unsigned int h = (value * 0x9E3779B97F4A7C15ull) >> (64 - 9);
+		static_assert(TABLE_SIZE == (1 << 9));
+		while (table_indices[h] != -1) {
+			if (table_keys[h] == value) {
+				return table_indices[h];
+			}
+			h = (h + 1) & (TABLE_SIZE - 1);
+		}
+		if (count == CAPACITY) {
+			return -1;
+		}
+		table_keys[h] = value;
+		table_indices[h] = count;
+		values[count] = value;
+		return count++;
+	}
+};
+
 const uint64_t g_default_values[VoxelBuffer::MAX_CHANNELS] = {
 	0, // TYPE
 
@@ -274,6 +615,10 @@ uint64_t VoxelBuffer::get_voxel(int x, int y, int z, unsigned int channel_index)
 #endif
 		const uint32_t i = get_index(x, y, z);
 
+		if (channel.compression == COMPRESSION_PALETTE) {
+			return get_palette_value(channel, i);
+		}
+
 		switch (channel.depth) {
 			case DEPTH_8_BIT:
 				return channel.data[i];
@@ -287,6 +632,11 @@ uint64_t VoxelBuffer::get_voxel(int x, int y, int z, unsigned int channel_index)
 			case DEPTH_64_BIT:
 				return reinterpret_cast<uint64_t *>(channel.data)[i];
 
+			case DEPTH_1_BIT:
+			case DEPTH_2_BIT:
+			case DEPTH_4_BIT:
+				return get_packed_voxel(channel.data, i, get_depth_bit_count(channel.depth));
+
 			default:
 				CRASH_NOW();
 				return 0;
@@ -319,6 +669,16 @@ void VoxelBuffer::set_voxel(uint64_t value, int x, int y, int z, unsigned int ch
 
 		const uint32_t i = get_index(x, y, z);
 
+		if (channel.compression == COMPRESSION_PALETTE) {
+			unsigned int palette_index;
+			if (try_get_or_add_palette_entry(channel, value, palette_index)) {
+				set_palette_index(channel, i, palette_index);
+				return;
+			}
+			// Too many different values
+			decompress_palette_channel(channel);
+		}
+
 		switch (channel.depth) {
 			case DEPTH_8_BIT:
 				// Note, if the value is negative, it may be in the range supported by int8_t.
@@ -339,6 +699,12 @@ void VoxelBuffer::set_voxel(uint64_t value, int x, int y, int z, unsigned int ch
 				reinterpret_cast<uint64_t *>(channel.data)[i] = value;
 				break;
 
+			case DEPTH_1_BIT:
+			case DEPTH_2_BIT:
+			case DEPTH_4_BIT:
+				set_packed_voxel(channel.data, i, get_depth_bit_count(channel.depth), value);
+				break;
+
 			default:
 				CRASH_NOW();
 				break;
@@ -356,6 +722,220 @@ void VoxelBuffer::set_voxel_f(real_t value, int x, int y, int z, unsigned int ch
 	set_voxel(real_to_raw_voxel(value, _channels[channel_index].depth), x, y, z, channel_index);
 }
 
+void VoxelBuffer::get_box_f(Box3i box, unsigned int channel_index, Span<float> dst) const {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(channel_index < MAX_CHANNELS);
+	ZN_ASSERT_RETURN(Box3i(Vector3i(), _size).contains(box));
+	ZN_ASSERT_RETURN(dst.size() == Vector3iUtil::get_volume_u64(box.size));
+
+	const Channel &channel = _channels[channel_index];
+
+	if (channel.compression == COMPRESSION_UNIFORM) {
+		dst.fill(raw_voxel_to_real(channel.defval, channel.depth));
+		return;
+	}
+
+	if (channel.compression == COMPRESSION_PALETTE) {
+		// Palettes are small, so convert their entries once and only do lookups per voxel
+		const Span<const uint64_t> entries = get_palette_entries(channel);
+		FixedArray<float, 1 << MAX_PALETTE_INDEX_BITS> decoded_entries;
+		for (unsigned int i = 0; i < entries.size(); ++i) {
+			decoded_entries[i] = raw_voxel_to_real(entries[i], channel.depth);
+		}
+		const Vector3i box_max = box.position + box.size;
+		unsigned int dst_i = 0;
+		Vector3i pos;
+		for (pos.z = box.position.z; pos.z < box_max.z; ++pos.z) {
+			for (pos.x = box.position.x; pos.x < box_max.x; ++pos.x) {
+				size_t src_i = get_index(pos.x, box.position.y, pos.z);
+				for (pos.y = box.position.y; pos.y < box_max.y; ++pos.y) {
+					dst[dst_i] = decoded_entries[get_palette_index(channel, src_i)];
+					++src_i;
+					++dst_i;
+				}
+			}
+		}
+		return;
+	}
+
+	switch (channel.depth) {
+		case DEPTH_8_BIT:
+			decode_box_f<int8_t>(channel.data, _size, box, dst.data());
+			break;
+		case DEPTH_16_BIT:
+			decode_box_f<int16_t>(channel.data, _size, box, dst.data());
+			break;
+		case DEPTH_32_BIT:
+			decode_box_f<float>(channel.data, _size, box, dst.data());
+			break;
+		case DEPTH_64_BIT:
+			decode_box_f<double>(channel.data, _size, box, dst.data());
+			break;
+		case DEPTH_1_BIT:
+		case DEPTH_2_BIT:
+		case DEPTH_4_BIT: {
+			const unsigned int bits = get_depth_bit_count(channel.depth);
+			const uint8_t *data = channel.data;
+			for_each_row_in_box(_size, box, [data, bits, &dst](size_t src_i, size_t stride, size_t row_length) {
+				for (size_t i = 0; i < row_length; ++i) {
+					dst[i] = get_packed_voxel(data, src_i + i * stride, bits);
+				}
+				dst = dst.sub(row_length);
+			});
+		} break;
+		default:
+			ZN_CRASH();
+	}
+}
+
+void VoxelBuffer::set_box_f(Box3i box, unsigned int channel_index, Span<const float> src) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(channel_index < MAX_CHANNELS);
+	ZN_ASSERT_RETURN(Box3i(Vector3i(), _size).contains(box));
+	ZN_ASSERT_RETURN(src.size() == Vector3iUtil::get_volume_u64(box.size));
+
+	decompress_channel(channel_index);
+	Channel &channel = _channels[channel_index];
+
+	switch (channel.depth) {
+		case DEPTH_8_BIT:
+			encode_box_f<int8_t>(channel.data, _size, box, src.data());
+			break;
+		case DEPTH_16_BIT:
+			encode_box_f<int16_t>(channel.data, _size, box, src.data());
+			break;
+		case DEPTH_32_BIT:
+			encode_box_f<float>(channel.data, _size, box, src.data());
+			break;
+		case DEPTH_64_BIT:
+			encode_box_f<double>(channel.data, _size, box, src.data());
+			break;
+		case DEPTH_1_BIT:
+		case DEPTH_2_BIT:
+		case DEPTH_4_BIT: {
+			const Depth depth = channel.depth;
+			const unsigned int bits = get_depth_bit_count(depth);
+			uint8_t *data = channel.data;
+			for_each_row_in_box(_size, box, [data, bits, depth, &src](size_t dst_i, size_t stride, size_t row_length) {
+				for (size_t i = 0; i < row_length; ++i) {
+					set_packed_voxel(data, dst_i + i * stride, bits, real_to_raw_voxel(src[i], depth));
+				}
+				src = src.sub(row_length);
+			});
+		} break;
+		default:
+			ZN_CRASH();
+	}
+}
+
+void VoxelBuffer::get_box(Box3i box, unsigned int channel_index, Span<int32_t> dst) const {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(channel_index < MAX_CHANNELS);
+	ZN_ASSERT_RETURN(Box3i(Vector3i(), _size).contains(box));
+	ZN_ASSERT_RETURN(dst.size() == Vector3iUtil::get_volume_u64(box.size));
+
+	const Channel &channel = _channels[channel_index];
+
+	if (channel.compression == COMPRESSION_UNIFORM) {
+		dst.fill(static_cast<int32_t>(channel.defval));
+		return;
+	}
+
+	if (channel.compression == COMPRESSION_PALETTE) {
+		const Span<const uint64_t> entries = get_palette_entries(channel);
+		const Vector3i box_max = box.position + box.size;
+		unsigned int dst_i = 0;
+		Vector3i pos;
+		for (pos.z = box.position.z; pos.z < box_max.z; ++pos.z) {
+			for (pos.x = box.position.x; pos.x < box_max.x; ++pos.x) {
+				size_t src_i = get_index(pos.x, box.position.y, pos.z);
+				for (pos.y = box.position.y; pos.y < box_max.y; ++pos.y) {
+					dst[dst_i] = static_cast<int32_t>(entries[get_palette_index(channel, src_i)]);
+					++src_i;
+					++dst_i;
+				}
+			}
+		}
+		return;
+	}
+
+	switch (channel.depth) {
+		case DEPTH_8_BIT:
+			decode_box_i<uint8_t>(channel.data, _size, box, dst.data());
+			break;
+		case DEPTH_16_BIT:
+			decode_box_i<uint16_t>(channel.data, _size, box, dst.data());
+			break;
+		case DEPTH_32_BIT:
+			decode_box_i<uint32_t>(channel.data, _size, box, dst.data());
+			break;
+		case DEPTH_64_BIT:
+			decode_box_i<uint64_t>(channel.data, _size, box, dst.data());
+			break;
+		case DEPTH_1_BIT:
+		case DEPTH_2_BIT:
+		case DEPTH_4_BIT: {
+			const unsigned int bits = get_depth_bit_count(channel.depth);
+			const uint8_t *data = channel.data;
+			for_each_row_in_box(_size, box, [data, bits, &dst](size_t src_i, size_t stride, size_t row_length) {
+				for (size_t i = 0; i < row_length; ++i) {
+					dst[i] = get_packed_voxel(data, src_i + i * stride, bits);
+				}
+				dst = dst.sub(row_length);
+			});
+		} break;
+		default:
+			ZN_CRASH();
+	}
+}
+
+void VoxelBuffer::set_box(Box3i box, unsigned int channel_index, Span<const int32_t> src) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(channel_index < MAX_CHANNELS);
+	ZN_ASSERT_RETURN(Box3i(Vector3i(), _size).contains(box));
+	ZN_ASSERT_RETURN(src.size() == Vector3iUtil::get_volume_u64(box.size));
+
+	decompress_channel(channel_index);
+	Channel &channel = _channels[channel_index];
+
+	switch (channel.depth) {
+		case DEPTH_8_BIT:
+			encode_box_i<uint8_t>(channel.data, _size, box, src.data());
+			break;
+		case DEPTH_16_BIT:
+			encode_box_i<uint16_t>(channel.data, _size, box, src.data());
+			break;
+		case DEPTH_32_BIT:
+			encode_box_i<uint32_t>(channel.data, _size, box, src.data());
+			break;
+		case DEPTH_64_BIT:
+			encode_box_i<uint64_t>(channel.data, _size, box, src.data());
+			break;
+		case DEPTH_1_BIT:
+		case DEPTH_2_BIT:
+		case DEPTH_4_BIT: {
+			const unsigned int bits = get_depth_bit_count(channel.depth);
+			uint8_t *data = channel.data;
+			for_each_row_in_box(_size, box, [data, bits, &src](size_t dst_i, size_t stride, size_t row_length) {
+				for (size_t i = 0; i < row_length; ++i) {
+					set_packed_voxel(data, dst_i + i * stride, bits, static_cast<uint32_t>(src[i]));
+				}
+				src = src.sub(row_length);
+			});
+		} break;
+		default:
+			ZN_CRASH();
+	}
+}
+
+void VoxelBuffer::get_channel_f(unsigned int channel_index, Span<float> dst) const {
+	get_box_f(Box3i(Vector3i(), _size), channel_index, dst);
+}
+
+void VoxelBuffer::set_channel_f(unsigned int channel_index, Span<const float> src) {
+	set_box_f(Box3i(Vector3i(), _size), channel_index, src);
+}
+
 void VoxelBuffer::fill(uint64_t defval, unsigned int channel_index) {
 	ZN_ASSERT_RETURN(channel_index < MAX_CHANNELS);
 
@@ -372,6 +952,11 @@ void VoxelBuffer::fill(uint64_t defval, unsigned int channel_index) {
 		return;
 	}
 
+	if (channel.compression == COMPRESSION_PALETTE) {
+		clear_channel(channel, defval, _allocator);
+		return;
+	}
+
 	const size_t volume = get_volume();
 #ifdef DEBUG_ENABLED
 	ZN_ASSERT(channel.size_in_bytes == get_size_in_bytes_for_volume(_size, channel.depth));
@@ -403,6 +988,14 @@ void VoxelBuffer::fill(uint64_t defval, unsigned int channel_index) {
 			}
 			break;
 
+		case DEPTH_1_BIT:
+		case DEPTH_2_BIT:
+		case DEPTH_4_BIT:
+			memset(channel.data,
+				   get_packed_byte_pattern(defval, get_depth_bit_count(channel.depth)),
+				   channel.size_in_bytes);
+			break;
+
 		default:
 			CRASH_NOW();
 			break;
@@ -438,6 +1031,23 @@ void VoxelBuffer::fill_area(uint64_t defval, Vector3i min, Vector3i max, unsigne
 	Vector3i pos;
 	const size_t volume = get_volume();
 
+	if (channel.compression == COMPRESSION_PALETTE) {
+		unsigned int palette_index;
+		if (try_get_or_add_palette_entry(channel, defval, palette_index)) {
+			for (pos.z = min.z; pos.z < max.z; ++pos.z) {
+				for (pos.x = min.x; pos.x < max.x; ++pos.x) {
+					const size_t dst_ri = get_index(pos.x, min.y, pos.z);
+					for (int i = 0; i < area_size.y; ++i) {
+						set_palette_index(channel, dst_ri + i, palette_index);
+					}
+				}
+			}
+			return;
+		}
+		// Too many different values
+		decompress_palette_channel(channel);
+	}
+
 	for (pos.z = min.z; pos.z < max.z; ++pos.z) {
 		for (pos.x = min.x; pos.x < max.x; ++pos.x) {
 			const size_t dst_ri = get_index(pos.x, pos.y + min.y, pos.z);
@@ -467,6 +1077,12 @@ void VoxelBuffer::fill_area(uint64_t defval, Vector3i min, Vector3i max, unsigne
 					}
 					break;
 
+				case DEPTH_1_BIT:
+				case DEPTH_2_BIT:
+				case DEPTH_4_BIT:
+					fill_packed_voxels(channel.data, dst_ri, area_size.y, get_depth_bit_count(channel.depth), defval);
+					break;
+
 				default:
 					CRASH_NOW();
 					break;
@@ -497,12 +1113,28 @@ bool VoxelBuffer::is_uniform(unsigned int channel_index) const {
 	return is_uniform(channel);
 }
 
-bool VoxelBuffer::is_uniform(const Channel &channel) {
+bool VoxelBuffer::is_uniform(const Channel &channel) const {
 	if (channel.compression == COMPRESSION_UNIFORM) {
 		// Channel has been optimized
 		return true;
 	}
 
+	if (channel.compression == COMPRESSION_PALETTE) {
+		const PaletteHeader *header = reinterpret_cast<const PaletteHeader *>(channel.data);
+		if (header->size <= 1) {
+			return true;
+		}
+		// Entries are not removed when no longer used, so look at indices
+		const size_t volume = header->volume;
+		const unsigned int first_index = get_palette_index(channel, 0);
+		for (size_t i = 1; i < volume; ++i) {
+			if (get_palette_index(channel, i) != first_index) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	// Channel isn't optimized, so must look at each voxel
 	switch (channel.depth) {
 		case DEPTH_8_BIT:
@@ -513,6 +1145,12 @@ bool VoxelBuffer::is_uniform(const Channel &channel) {
 			return is_uniform_b<uint32_t>(channel.data, channel.size_in_bytes / 4);
 		case DEPTH_64_BIT:
 			return is_uniform_b<uint64_t>(channel.data, channel.size_in_bytes / 8);
+		case DEPTH_1_BIT:
+		case DEPTH_2_BIT:
+		case DEPTH_4_BIT: {
+			const unsigned int bits = get_depth_bit_count(channel.depth);
+			return is_packed_uniform(channel.data, get_volume(), bits);
+		}
 		default:
 			CRASH_NOW();
 			break;
@@ -521,43 +1159,240 @@ bool VoxelBuffer::is_uniform(const Channel &channel) {
 	return true;
 }
 
-uint64_t get_first_voxel(const VoxelBuffer::Channel &channel) {
-	ZN_ASSERT(channel.compression != VoxelBuffer::COMPRESSION_UNIFORM);
-#ifdef DEV_ENABLED
-	ZN_ASSERT(channel.data != nullptr);
-#endif
+uint64_t get_first_voxel(const VoxelBuffer::Channel &channel) {
+	ZN_ASSERT(channel.compression != VoxelBuffer::COMPRESSION_UNIFORM);
+#ifdef DEV_ENABLED
+	ZN_ASSERT(channel.data != nullptr);
+#endif
+
+	switch (channel.depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			return channel.data[0];
+
+		case VoxelBuffer::DEPTH_16_BIT:
+			return reinterpret_cast<uint16_t *>(channel.data)[0];
+
+		case VoxelBuffer::DEPTH_32_BIT:
+			return reinterpret_cast<uint32_t *>(channel.data)[0];
+
+		case VoxelBuffer::DEPTH_64_BIT:
+			return reinterpret_cast<uint64_t *>(channel.data)[0];
+
+		case VoxelBuffer::DEPTH_1_BIT:
+		case VoxelBuffer::DEPTH_2_BIT:
+		case VoxelBuffer::DEPTH_4_BIT:
+			return VoxelBuffer::get_packed_voxel(channel.data, 0, VoxelBuffer::get_depth_bit_count(channel.depth));
+
+		default:
+			ZN_CRASH_MSG("Unexpected depth");
+			return 0;
+	}
+}
+
+void VoxelBuffer::compress_uniform_channels() {
+	for (unsigned int i = 0; i < MAX_CHANNELS; ++i) {
+		Channel &channel = _channels[i];
+		compress_if_uniform(channel);
+	}
+}
+
+void VoxelBuffer::compress_if_uniform(Channel &channel) {
+	if (channel.compression != COMPRESSION_UNIFORM && is_uniform(channel)) {
+		const uint64_t v =
+				channel.compression == COMPRESSION_PALETTE ? get_palette_value(channel, 0) : get_first_voxel(channel);
+		clear_channel(channel, v, _allocator);
+	}
+}
+
+void VoxelBuffer::compress_palette_channels() {
+	for (unsigned int i = 0; i < MAX_CHANNELS; ++i) {
+		compress_palette_channel(i);
+	}
+}
+
+void VoxelBuffer::compress_palette_channel(unsigned int channel_index) {
+	ZN_DSTACK();
+	ZN_ASSERT_RETURN(channel_index < MAX_CHANNELS);
+	Channel &channel = _channels[channel_index];
+
+	if (channel.compression == COMPRESSION_UNIFORM) {
+		return;
+	}
+
+	if (is_bit_packed_depth(channel.depth)) {
+		// Packed voxels are already smaller than palette indices would be
+		compress_if_uniform(channel);
+		return;
+	}
+
+#ifdef DEV_ENABLED
+	ZN_ASSERT(channel.data != nullptr);
+#endif
+
+	const size_t volume = get_volume();
+
+	// Gather distinct values. Palette entries may no longer all be in use, so go through voxels in both cases.
+	PaletteBuilder builder;
+	if (channel.compression == COMPRESSION_PALETTE) {
+		for (size_t i = 0; i < volume; ++i) {
+			builder.get_or_add(get_palette_value(channel, i));
+		}
+	} else {
+		for (size_t i = 0; i < volume; ++i) {
+			if (builder.get_or_add(get_raw_voxel(channel.data, i, channel.depth)) == -1) {
+				// Too many different values
+				return;
+			}
+		}
+	}
+
+	if (builder.count == 1) {
+		clear_channel(channel, builder.values[0], _allocator);
+		return;
+	}
+
+	const unsigned int index_bits = get_palette_index_bits(builder.count);
+
+	if (!is_palette_worth_it(volume, index_bits, channel.depth)) {
+		if (channel.compression == COMPRESSION_PALETTE) {
+			decompress_palette_channel(channel);
+		}
+		return;
+	}
+
+	if (channel.compression == COMPRESSION_PALETTE) {
+		const PaletteHeader *header = reinterpret_cast<const PaletteHeader *>(channel.data);
+		if (header->size == builder.count) {
+			// All entries are in use, nothing to gain
+			return;
+		}
+	}
+
+	Channel new_channel = channel;
+	new_channel.compression = COMPRESSION_UNIFORM;
+	ZN_ASSERT_RETURN(create_palette_channel(new_channel, index_bits));
+
+	PaletteHeader *header = reinterpret_cast<PaletteHeader *>(new_channel.data);
+	header->size = builder.count;
+	uint64_t *entries = reinterpret_cast<uint64_t *>(new_channel.data + sizeof(PaletteHeader));
+	for (unsigned int i = 0; i < builder.count; ++i) {
+		entries[i] = builder.values[i];
+	}
+
+	if (channel.compression == COMPRESSION_PALETTE) {
+		for (size_t i = 0; i < volume; ++i) {
+			set_palette_index(new_channel, i, builder.get_or_add(get_palette_value(channel, i)));
+		}
+	} else {
+		for (size_t i = 0; i < volume; ++i) {
+			set_palette_index(new_channel, i, builder.get_or_add(get_raw_voxel(channel.data, i, channel.depth)));
+		}
+	}
+
+	delete_channel(channel, _allocator);
+	channel = new_channel;
+}
+
+bool VoxelBuffer::create_palette_channel(Channel &channel, unsigned int index_bits) {
+	ZN_ASSERT(channel.compression == COMPRESSION_UNIFORM); // The channel must not already be allocated
+	const size_t volume = get_volume();
+	const size_t size_in_bytes = get_palette_size_in_bytes(volume, index_bits);
+	ZN_ASSERT_RETURN_V_MSG(size_in_bytes <= Channel::MAX_SIZE_IN_BYTES, false, "Buffer is too big");
+	channel.data = allocate_channel_data(size_in_bytes, _allocator);
+	ZN_ASSERT_RETURN_V(channel.data != nullptr, false); // Bad alloc?
+	// Indices start all zero
+	memset(channel.data, 0, size_in_bytes);
+	PaletteHeader *header = reinterpret_cast<PaletteHeader *>(channel.data);
+	header->size = 0;
+	header->index_bits = index_bits;
+	header->volume = volume;
+	channel.compression = COMPRESSION_PALETTE;
+	channel.size_in_bytes = size_in_bytes;
+	return true;
+}
+
+bool VoxelBuffer::try_get_or_add_palette_entry(Channel &channel, uint64_t value, unsigned int &out_index) {
+	const PaletteHeader *header = reinterpret_cast<const PaletteHeader *>(channel.data);
+	const uint64_t *entries = reinterpret_cast<const uint64_t *>(channel.data + sizeof(PaletteHeader));
 
-	switch (channel.depth) {
-		case VoxelBuffer::DEPTH_8_BIT:
-			return channel.data[0];
+	// Palettes are small, so a linear search is fine
+	for (unsigned int i = 0; i < header->size; ++i) {
+		if (entries[i] == value) {
+			out_index = i;
+			return true;
+		}
+	}
 
-		case VoxelBuffer::DEPTH_16_BIT:
-			return reinterpret_cast<uint16_t *>(channel.data)[0];
+	const unsigned int index_bits = header->index_bits;
+	const unsigned int palette_size = header->size;
 
-		case VoxelBuffer::DEPTH_32_BIT:
-			return reinterpret_cast<uint32_t *>(channel.data)[0];
+	if (palette_size < (1u << index_bits)) {
+		PaletteHeader *header_w = reinterpret_cast<PaletteHeader *>(channel.data);
+		uint64_t *entries_w = reinterpret_cast<uint64_t *>(channel.data + sizeof(PaletteHeader));
+		entries_w[palette_size] = value;
+		header_w->size = palette_size + 1;
+		out_index = palette_size;
+		return true;
+	}
 
-		case VoxelBuffer::DEPTH_64_BIT:
-			return reinterpret_cast<uint64_t *>(channel.data)[0];
+	// Palette is full, indices must get wider
+	const unsigned int new_index_bits = index_bits << 1;
+	const size_t volume = get_volume();
+	if (!is_palette_worth_it(volume, new_index_bits, channel.depth)) {
+		return false;
+	}
 
-		default:
-			ZN_CRASH_MSG("Unexpected depth");
-			return 0;
+	Channel new_channel = channel;
+	new_channel.compression = COMPRESSION_UNIFORM;
+	ZN_ASSERT_RETURN_V(create_palette_channel(new_channel, new_index_bits), false);
+
+	PaletteHeader *new_header = reinterpret_cast<PaletteHeader *>(new_channel.data);
+	uint64_t *new_entries = reinterpret_cast<uint64_t *>(new_channel.data + sizeof(PaletteHeader));
+	for (unsigned int i = 0; i < palette_size; ++i) {
+		new_entries[i] = entries[i];
 	}
-}
+	new_entries[palette_size] = value;
+	new_header->size = palette_size + 1;
 
-void VoxelBuffer::compress_uniform_channels() {
-	for (unsigned int i = 0; i < MAX_CHANNELS; ++i) {
-		Channel &channel = _channels[i];
-		compress_if_uniform(channel);
+	for (size_t i = 0; i < volume; ++i) {
+		set_palette_index(new_channel, i, get_palette_index(channel, i));
 	}
+
+	delete_channel(channel, _allocator);
+	channel = new_channel;
+
+	out_index = palette_size;
+	return true;
 }
 
-void VoxelBuffer::compress_if_uniform(Channel &channel) {
-	if (channel.compression != COMPRESSION_UNIFORM && is_uniform(channel)) {
-		const uint64_t v = get_first_voxel(channel);
-		clear_channel(channel, v, _allocator);
+void VoxelBuffer::set_palette_index(Channel &channel, size_t voxel_index, unsigned int palette_index) {
+	const unsigned int bits = reinterpret_cast<const PaletteHeader *>(channel.data)->index_bits;
+	uint8_t *indices = channel.data + sizeof(PaletteHeader) + (sizeof(uint64_t) << bits);
+	const size_t bit_offset = voxel_index * bits;
+	const unsigned int shift = bit_offset & 7;
+	const uint8_t mask = ((1 << bits) - 1) << shift;
+	uint8_t &b = indices[bit_offset >> 3];
+	b = (b & ~mask) | ((palette_index << shift) & mask);
+}
+
+void VoxelBuffer::decompress_palette_channel(Channel &channel) {
+	ZN_DSTACK();
+	ZN_ASSERT_RETURN(channel.compression == COMPRESSION_PALETTE);
+
+	const size_t volume = get_volume();
+	const size_t size_in_bytes = get_size_in_bytes_for_volume(_size, channel.depth);
+	ZN_ASSERT_RETURN_MSG(size_in_bytes <= Channel::MAX_SIZE_IN_BYTES, "Buffer is too big");
+	uint8_t *data = allocate_channel_data(size_in_bytes, _allocator);
+	ZN_ASSERT_RETURN(data != nullptr); // Bad alloc?
+
+	for (size_t i = 0; i < volume; ++i) {
+		set_raw_voxel(data, i, get_palette_value(channel, i), channel.depth);
 	}
+
+	delete_channel(channel, _allocator);
+	channel.data = data;
+	channel.compression = COMPRESSION_NONE;
+	channel.size_in_bytes = size_in_bytes;
 }
 
 void VoxelBuffer::decompress_channel(unsigned int channel_index) {
@@ -567,6 +1402,8 @@ void VoxelBuffer::decompress_channel(unsigned int channel_index) {
 	Channel &channel = _channels[channel_index];
 	if (channel.compression == COMPRESSION_UNIFORM) {
 		ZN_ASSERT_RETURN(create_channel(channel_index, channel.defval));
+	} else if (channel.compression == COMPRESSION_PALETTE) {
+		decompress_palette_channel(channel);
 	}
 }
 
@@ -576,6 +1413,16 @@ VoxelBuffer::Compression VoxelBuffer::get_channel_compression(unsigned int chann
 	return channel.compression;
 }
 
+bool VoxelBuffer::get_channel_palette(unsigned int channel_index, Span<const uint64_t> &out_entries) const {
+	ZN_ASSERT_RETURN_V(channel_index < MAX_CHANNELS, false);
+	const Channel &channel = _channels[channel_index];
+	if (channel.compression != COMPRESSION_PALETTE) {
+		return false;
+	}
+	out_entries = get_palette_entries(channel);
+	return true;
+}
+
 void VoxelBuffer::copy_format(const VoxelBuffer &other) {
 	for (unsigned int i = 0; i < MAX_CHANNELS; ++i) {
 		set_channel_depth(i, other.get_channel_depth(i));
@@ -600,9 +1447,17 @@ void VoxelBuffer::copy_channel_from(const VoxelBuffer &other, unsigned int chann
 	ZN_ASSERT_RETURN(other_channel.depth == channel.depth);
 
 	if (other_channel.compression != COMPRESSION_UNIFORM) {
-		// Other is not uniform, make sure we allocate our channel
+		// Other is not uniform, make sure we allocate our channel with the same layout
+		if (channel.compression != COMPRESSION_UNIFORM &&
+			(channel.compression != other_channel.compression ||
+			 channel.size_in_bytes != other_channel.size_in_bytes)) {
+			delete_channel(channel_index);
+		}
 		if (channel.compression == COMPRESSION_UNIFORM) {
-			ZN_ASSERT_RETURN(create_channel_noinit(channel_index, _size));
+			channel.data = allocate_channel_data(other_channel.size_in_bytes, _allocator);
+			ZN_ASSERT_RETURN(channel.data != nullptr); // Bad alloc?
+			channel.compression = other_channel.compression;
+			channel.size_in_bytes = other_channel.size_in_bytes;
 		}
 		ZN_ASSERT(channel.size_in_bytes == other_channel.size_in_bytes);
 #ifdef DEV_ENABLED
@@ -655,11 +1510,50 @@ void VoxelBuffer::copy_channel_from(
 			// Note, we do this even if the pasted data happens to be all the same value as our current channel.
 			// We assume that this case is not frequent enough to bother, and compression can happen later
 			ZN_ASSERT_RETURN(create_channel(channel_index, channel.defval));
+		} else if (channel.compression == COMPRESSION_PALETTE) {
+			decompress_palette_channel(channel);
 		}
 #ifdef DEV_ENABLED
 		ZN_ASSERT(channel.data != nullptr);
 		ZN_ASSERT(other_channel.data != nullptr);
 #endif
+		if (other_channel.compression == COMPRESSION_PALETTE) {
+			Vector3iUtil::sort_min_max(src_min, src_max);
+			clip_copy_region(src_min, src_max, other._size, dst_min, _size);
+			Vector3i src_pos;
+			for (src_pos.z = src_min.z; src_pos.z < src_max.z; ++src_pos.z) {
+				for (src_pos.x = src_min.x; src_pos.x < src_max.x; ++src_pos.x) {
+					size_t src_i = other.get_index(src_pos.x, src_min.y, src_pos.z);
+					const Vector3i dst_pos = dst_min + Vector3i(src_pos.x, src_min.y, src_pos.z) - src_min;
+					size_t dst_i = get_index(dst_pos.x, dst_pos.y, dst_pos.z);
+					for (src_pos.y = src_min.y; src_pos.y < src_max.y; ++src_pos.y) {
+						set_raw_voxel(channel.data, dst_i, get_palette_value(other_channel, src_i), channel.depth);
+						++src_i;
+						++dst_i;
+					}
+				}
+			}
+			return;
+		}
+		if (is_bit_packed_depth(channel.depth)) {
+			Vector3iUtil::sort_min_max(src_min, src_max);
+			clip_copy_region(src_min, src_max, other._size, dst_min, _size);
+			const unsigned int bits = get_depth_bit_count(channel.depth);
+			Vector3i src_pos;
+			for (src_pos.z = src_min.z; src_pos.z < src_max.z; ++src_pos.z) {
+				for (src_pos.x = src_min.x; src_pos.x < src_max.x; ++src_pos.x) {
+					size_t src_i = other.get_index(src_pos.x, src_min.y, src_pos.z);
+					const Vector3i dst_pos = dst_min + Vector3i(src_pos.x, src_min.y, src_pos.z) - src_min;
+					size_t dst_i = get_index(dst_pos.x, dst_pos.y, dst_pos.z);
+					for (src_pos.y = src_min.y; src_pos.y < src_max.y; ++src_pos.y) {
+						set_packed_voxel(channel.data, dst_i, bits, get_packed_voxel(other_channel.data, src_i, bits));
+						++src_i;
+						++dst_i;
+					}
+				}
+			}
+			return;
+		}
 		const unsigned int item_size = get_depth_byte_count(channel.depth);
 		Span<const uint8_t> src(other_channel.data, other_channel.size_in_bytes);
 		Span<uint8_t> dst(channel.data, channel.size_in_bytes);
@@ -717,7 +1611,11 @@ void VoxelBuffer::move_to(VoxelBuffer &dst) {
 }
 
 bool VoxelBuffer::get_channel_as_bytes(unsigned int channel_index, Span<uint8_t> &slice) {
-	const Channel &channel = _channels[channel_index];
+	Channel &channel = _channels[channel_index];
+	if (channel.compression == COMPRESSION_PALETTE) {
+		// Callers expect raw voxels they can modify
+		decompress_palette_channel(channel);
+	}
 	if (channel.compression != COMPRESSION_UNIFORM) {
 #ifdef DEV_ENABLED
 		ZN_ASSERT(channel.data != nullptr);
@@ -732,7 +1630,7 @@ bool VoxelBuffer::get_channel_as_bytes(unsigned int channel_index, Span<uint8_t>
 
 bool VoxelBuffer::get_channel_as_bytes_read_only(unsigned int channel_index, Span<const uint8_t> &slice) const {
 	const Channel &channel = _channels[channel_index];
-	if (channel.compression != COMPRESSION_UNIFORM) {
+	if (channel.compression == COMPRESSION_NONE) {
 #ifdef DEV_ENABLED
 		ZN_ASSERT(channel.data != nullptr);
 #endif
@@ -744,8 +1642,43 @@ bool VoxelBuffer::get_channel_as_bytes_read_only(unsigned int channel_index, Spa
 	return false;
 }
 
-void VoxelBuffer::set_channel_from_bytes(const unsigned int channel_index, Span<const uint8_t> src) {
+bool VoxelBuffer::get_channel_decompressed(unsigned int channel_index, Span<uint8_t> dst) const {
+	ZN_ASSERT_RETURN_V(channel_index < MAX_CHANNELS, false);
 	const Channel &channel = _channels[channel_index];
+	ZN_ASSERT_RETURN_V(dst.size() == get_size_in_bytes_for_volume(_size, channel.depth), false);
+
+	switch (channel.compression) {
+		case COMPRESSION_NONE:
+			memcpy(dst.data(), channel.data, dst.size());
+			break;
+
+		case COMPRESSION_UNIFORM: {
+			const size_t volume = get_volume();
+			for (size_t i = 0; i < volume; ++i) {
+				set_raw_voxel(dst.data(), i, channel.defval, channel.depth);
+			}
+		} break;
+
+		case COMPRESSION_PALETTE: {
+			const size_t volume = get_volume();
+			for (size_t i = 0; i < volume; ++i) {
+				set_raw_voxel(dst.data(), i, get_palette_value(channel, i), channel.depth);
+			}
+		} break;
+
+		default:
+			ZN_PRINT_ERROR("Unhandled compression");
+			return false;
+	}
+
+	return true;
+}
+
+void VoxelBuffer::set_channel_from_bytes(const unsigned int channel_index, Span<const uint8_t> src) {
+	Channel &channel = _channels[channel_index];
+	if (channel.compression == COMPRESSION_PALETTE) {
+		delete_channel(channel, _allocator);
+	}
 	if (channel.compression == COMPRESSION_UNIFORM) {
 		// We don't init channel data to nullptr in the constructor so can't do that check
 		// #ifdef DEV_ENABLED
@@ -772,10 +1705,27 @@ size_t VoxelBuffer::get_size_in_bytes_for_volume(Vector3i size, Depth depth) {
 	// Calculate appropriate size based on bit depth
 	const size_t volume = size.x * size.y * size.z;
 	const size_t bits = volume * get_depth_bit_count(depth);
-	const size_t size_in_bytes = (bits >> 3);
+	// Rounded up, in case bit-packed voxels don't fill the last byte
+	const size_t size_in_bytes = (bits + 7) >> 3;
 	return size_in_bytes;
 }
 
+size_t VoxelBuffer::get_channels_memory_usage() const {
+	size_t size = 0;
+	for (const Channel &channel : _channels) {
+		if (channel.compression != COMPRESSION_UNIFORM) {
+			size += channel.size_in_bytes;
+		}
+	}
+	return size;
+}
+
+size_t VoxelBuffer::get_channel_memory_usage(unsigned int channel_index) const {
+	ZN_ASSERT_RETURN_V(channel_index < MAX_CHANNELS, 0);
+	const Channel &channel = _channels[channel_index];
+	return channel.compression == COMPRESSION_UNIFORM ? 0 : channel.size_in_bytes;
+}
+
 bool VoxelBuffer::create_channel_noinit(int i, Vector3i size) {
 	ZN_DSTACK();
 	Channel &channel = _channels[i];
@@ -804,6 +1754,31 @@ void VoxelBuffer::delete_channel(Channel &channel, Allocator allocator) {
 	channel.size_in_bytes = 0;
 }
 
+namespace {
+
+// Returns the most frequent of the given values. In case of a tie, non-zero values are preferred, so thin layers of
+// solid voxels (typically with air as zero) don't disappear at lower levels of detail.
+uint64_t get_majority_value(const FixedArray<uint64_t, 8> &values, const unsigned int count) {
+	uint64_t best_value = values[0];
+	unsigned int best_count = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		const uint64_t v = values[i];
+		unsigned int v_count = 0;
+		for (unsigned int j = 0; j < count; ++j) {
+			if (values[j] == v) {
+				++v_count;
+			}
+		}
+		if (v_count > best_count || (v_count == best_count && best_value == 0 && v != 0)) {
+			best_value = v;
+			best_count = v_count;
+		}
+	}
+	return best_value;
+}
+
+} // namespace
+
 void VoxelBuffer::downscale_to(VoxelBuffer &dst, Vector3i src_min, Vector3i src_max, Vector3i dst_min) const {
 	// TODO Align input to multiple of two
 
@@ -826,6 +1801,33 @@ void VoxelBuffer::downscale_to(VoxelBuffer &dst, Vector3i src_min, Vector3i src_
 			continue;
 		}
 
+		if (channel_index == CHANNEL_TYPE && src_channel.compression != COMPRESSION_UNIFORM) {
+			// Types can't be interpolated, and picking one voxel out of 8 makes structures flicker or vanish at lower
+			// levels of detail. Use the most frequent type instead.
+			Vector3i pos;
+			for (pos.z = dst_min.z; pos.z < dst_max.z; ++pos.z) {
+				for (pos.x = dst_min.x; pos.x < dst_max.x; ++pos.x) {
+					for (pos.y = dst_min.y; pos.y < dst_max.y; ++pos.y) {
+						const Vector3i src_pos0 = src_min + ((pos - dst_min) << 1);
+
+						FixedArray<uint64_t, 8> values;
+						unsigned int value_count = 0;
+						for (unsigned int i = 0; i < 8; ++i) {
+							const Vector3i src_pos = src_pos0 + Vector3i(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+							// Odd sizes have incomplete cells on their upper border
+							if (src_pos.x < src_max.x && src_pos.y < src_max.y && src_pos.z < src_max.z) {
+								values[value_count] = get_voxel(src_pos, channel_index);
+								++value_count;
+							}
+						}
+
+						dst.set_voxel(get_majority_value(values, value_count), pos, channel_index);
+					}
+				}
+			}
+			continue;
+		}
+
 		// Nearest-neighbor downscaling
 
 		Vector3i pos;
@@ -862,13 +1864,35 @@ bool VoxelBuffer::equals(const VoxelBuffer &p_other) const {
 		const Channel &channel = _channels[channel_index];
 		const Channel &other_channel = p_other._channels[channel_index];
 
+		if (channel.depth != other_channel.depth) {
+			return false;
+		}
+
+		if ((channel.compression == COMPRESSION_PALETTE) != (other_channel.compression == COMPRESSION_PALETTE)) {
+			// Palettes can have different layouts for the same voxels, so compare values
+			const size_t volume = get_volume();
+			for (size_t i = 0; i < volume; ++i) {
+				const Vector3i pos = Vector3iUtil::from_zxy_index(i, _size);
+				if (get_voxel(pos, channel_index) != p_other.get_voxel(pos, channel_index)) {
+					return false;
+				}
+			}
+			continue;
+		}
+
 		if (channel.compression != other_channel.compression) {
 			// Note: they could still logically be equal if one channel contains uniform voxel memory.
 			return false;
 		}
 
-		if (channel.depth != other_channel.depth) {
-			return false;
+		if (channel.compression == COMPRESSION_PALETTE) {
+			const size_t volume = get_volume();
+			for (size_t i = 0; i < volume; ++i) {
+				if (get_palette_value(channel, i) != get_palette_value(other_channel, i)) {
+					return false;
+				}
+			}
+			continue;
 		}
 
 		if (channel.compression == COMPRESSION_UNIFORM) {
@@ -882,6 +1906,14 @@ bool VoxelBuffer::equals(const VoxelBuffer &p_other) const {
 			ZN_ASSERT(channel.data != nullptr);
 			ZN_ASSERT(other_channel.data != nullptr);
 #endif
+			if (is_bit_packed_depth(channel.depth)) {
+				if (!packed_voxels_equal(
+							channel.data, other_channel.data, get_volume(), get_depth_bit_count(channel.depth)
+					)) {
+					return false;
+				}
+				continue;
+			}
 			for (size_t i = 0; i < channel.size_in_bytes; ++i) {
 				if (channel.data[i] != other_channel.data[i]) {
 					return false;
@@ -943,6 +1975,19 @@ void VoxelBuffer::get_range_f(float &out_min, float &out_max, ChannelId channel_
 	ZN_ASSERT(channel.data != nullptr);
 #endif
 
+	if (channel.compression == COMPRESSION_PALETTE) {
+		// Entries no longer in use may widen the range, which is fine since it is used as a conservative estimate
+		Span<const uint64_t> entries = get_palette_entries(channel);
+		for (unsigned int i = 0; i < entries.size(); ++i) {
+			const float v = raw_voxel_to_real(entries[i], channel.depth);
+			min_value = math::min(v, min_value);
+			max_value = math::max(v, max_value);
+		}
+		out_min = min_value;
+		out_max = max_value;
+		return;
+	}
+
 	switch (channel.depth) {
 		case DEPTH_8_BIT:
 			for (unsigned int i = 0; i < volume; ++i) {
@@ -975,6 +2020,16 @@ void VoxelBuffer::get_range_f(float &out_min, float &out_max, ChannelId channel_
 				max_value = math::max(v, double(max_value));
 			}
 		} break;
+		case DEPTH_1_BIT:
+		case DEPTH_2_BIT:
+		case DEPTH_4_BIT: {
+			const unsigned int bits = get_depth_bit_count(channel.depth);
+			for (unsigned int i = 0; i < volume; ++i) {
+				const float v = get_packed_voxel(channel.data, i, bits);
+				min_value = math::min(v, min_value);
+				max_value = math::max(v, max_value);
+			}
+		} break;
 		default:
 			CRASH_NOW();
 	}
@@ -1063,8 +2118,8 @@ void VoxelBuffer::clear_voxel_metadata() {
 }
 
 void VoxelBuffer::clear_voxel_metadata_in_area(Box3i box) {
-	_voxel_metadata.remove_if([&box](const FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair &p) { //
-		return box.contains(p.key);
+	_voxel_metadata.remove_if([&box](const Vector3i &pos, const VoxelMetadata &meta) { //
+		return box.contains(pos);
 	});
 }
 
@@ -1074,17 +2129,16 @@ void VoxelBuffer::copy_voxel_metadata_in_area(const VoxelBuffer &src_buffer, Box
 	const Box3i clipped_src_box = src_box.clipped(Box3i(src_box.position - dst_origin, _size));
 	const Vector3i clipped_dst_offset = dst_origin + clipped_src_box.position - src_box.position;
 
-	for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator src_it = src_buffer._voxel_metadata.begin();
-		 src_it != src_buffer._voxel_metadata.end();
-		 ++src_it) {
-		if (src_box.contains(src_it->key)) {
-			const Vector3i dst_pos = src_it->key + clipped_dst_offset;
-			ZN_ASSERT(is_position_valid(dst_pos));
+	src_buffer.for_each_voxel_metadata_in_area(
+			src_box,
+			[this, clipped_dst_offset](Vector3i src_pos, const VoxelMetadata &src_meta) {
+				const Vector3i dst_pos = src_pos + clipped_dst_offset;
+				ZN_ASSERT(is_position_valid(dst_pos));
 
-			VoxelMetadata &meta = _voxel_metadata.insert_or_assign(dst_pos, VoxelMetadata());
-			meta.copy_from(src_it->value);
-		}
-	}
+				VoxelMetadata &meta = _voxel_metadata.insert_or_assign(dst_pos, VoxelMetadata());
+				meta.copy_from(src_meta);
+			}
+	);
 }
 
 void VoxelBuffer::copy_voxel_metadata(const VoxelBuffer &src_buffer) {
@@ -1101,107 +2155,12 @@ void VoxelBuffer::copy_voxel_metadata(const VoxelBuffer &src_buffer) {
 }
 
 void get_unscaled_sdf(const VoxelBuffer &voxels, Span<float> sdf) {
-	ZN_PROFILE_SCOPE();
 	ZN_DSTACK();
-	const uint64_t volume = Vector3iUtil::get_volume_u64(voxels.get_size());
-	ZN_ASSERT_RETURN(volume == sdf.size());
-
-	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_SDF;
-	const VoxelBuffer::Depth depth = voxels.get_channel_depth(channel);
-
-	if (voxels.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_UNIFORM) {
-		const float uniform_value = voxels.get_voxel_f(0, 0, 0, channel);
-		sdf.fill(uniform_value);
-		return;
-	}
-
-	switch (depth) {
-		case VoxelBuffer::DEPTH_8_BIT: {
-			Span<const int8_t> raw;
-			ZN_ASSERT(voxels.get_channel_data_read_only(channel, raw));
-			for (unsigned int i = 0; i < sdf.size(); ++i) {
-				sdf[i] = s8_to_snorm(raw[i]);
-			}
-		} break;
-
-		case VoxelBuffer::DEPTH_16_BIT: {
-			Span<const int16_t> raw;
-			ZN_ASSERT(voxels.get_channel_data_read_only(channel, raw));
-			for (unsigned int i = 0; i < sdf.size(); ++i) {
-				sdf[i] = s16_to_snorm(raw[i]);
-			}
-		} break;
-
-		case VoxelBuffer::DEPTH_32_BIT: {
-			Span<const float> raw;
-			ZN_ASSERT(voxels.get_channel_data_read_only(channel, raw));
-			memcpy(sdf.data(), raw.data(), sizeof(float) * sdf.size());
-		} break;
-
-		case VoxelBuffer::DEPTH_64_BIT: {
-			Span<const double> raw;
-			ZN_ASSERT(voxels.get_channel_data_read_only(channel, raw));
-			for (unsigned int i = 0; i < sdf.size(); ++i) {
-				sdf[i] = raw[i];
-			}
-		} break;
-
-		default:
-			ZN_CRASH();
-	}
-
-	const float inv_scale = 1.f / VoxelBuffer::get_sdf_quantization_scale(depth);
-
-	for (float &sd : sdf) {
-		sd *= inv_scale;
-	}
+	voxels.get_channel_f(VoxelBuffer::CHANNEL_SDF, sdf);
 }
 
 void scale_and_store_sdf(VoxelBuffer &voxels, Span<float> sdf) {
-	ZN_PROFILE_SCOPE();
-	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_SDF;
-	const VoxelBuffer::Depth depth = voxels.get_channel_depth(channel);
-	ZN_ASSERT_RETURN(voxels.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
-
-	const float scale = VoxelBuffer::get_sdf_quantization_scale(depth);
-	for (unsigned int i = 0; i < sdf.size(); ++i) {
-		sdf[i] *= scale;
-	}
-
-	switch (depth) {
-		case VoxelBuffer::DEPTH_8_BIT: {
-			Span<int8_t> raw;
-			ZN_ASSERT(voxels.get_channel_data(channel, raw));
-			for (unsigned int i = 0; i < sdf.size(); ++i) {
-				raw[i] = snorm_to_s8(sdf[i]);
-			}
-		} break;
-
-		case VoxelBuffer::DEPTH_16_BIT: {
-			Span<int16_t> raw;
-			ZN_ASSERT(voxels.get_channel_data(channel, raw));
-			for (unsigned int i = 0; i < sdf.size(); ++i) {
-				raw[i] = snorm_to_s16(sdf[i]);
-			}
-		} break;
-
-		case VoxelBuffer::DEPTH_32_BIT: {
-			Span<float> raw;
-			ZN_ASSERT(voxels.get_channel_data(channel, raw));
-			memcpy(raw.data(), sdf.data(), sizeof(float) * sdf.size());
-		} break;
-
-		case VoxelBuffer::DEPTH_64_BIT: {
-			Span<double> raw;
-			ZN_ASSERT(voxels.get_channel_data(channel, raw));
-			for (unsigned int i = 0; i < sdf.size(); ++i) {
-				raw[i] = sdf[i];
-			}
-		} break;
-
-		default:
-			ZN_CRASH();
-	}
+	voxels.set_channel_f(VoxelBuffer::CHANNEL_SDF, sdf);
 }
 
 void scale_and_store_sdf_if_modified(VoxelBuffer &voxels, Span<float> sdf, Span<const float> comparand) {
@@ -1252,6 +2211,20 @@ void scale_and_store_sdf_if_modified(VoxelBuffer &voxels, Span<float> sdf, Span<
 			}
 		} break;
 
+		case VoxelBuffer::DEPTH_1_BIT:
+		case VoxelBuffer::DEPTH_2_BIT:
+		case VoxelBuffer::DEPTH_4_BIT: {
+			// Not meant for SDF, but still supported
+			Span<uint8_t> raw;
+			ZN_ASSERT(voxels.get_channel_as_bytes(channel, raw));
+			const unsigned int bits = VoxelBuffer::get_depth_bit_count(depth);
+			for (unsigned int i = 0; i < sdf.size(); ++i) {
+				if (comparand[i] != sdf[i]) {
+					VoxelBuffer::set_packed_voxel(raw.data(), i, bits, real_to_raw_voxel(sdf[i], depth));
+				}
+			}
+		} break;
+
 		default:
 			ZN_CRASH();
 	}
@@ -1319,9 +2292,9 @@ void paste_src_masked(
 
 	if (with_metadata) {
 		dst_buffer.erase_voxel_metadata_if([dst_box, &src_buffer, src_mask_channel, src_mask_value](
-												   const FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair &p
+												   const Vector3i &pos, const VoxelMetadata &meta
 										   ) {
-			return dst_box.contains(p.key) && src_buffer.get_voxel(p.key, src_mask_channel) != src_mask_value;
+			return dst_box.contains(pos) && src_buffer.get_voxel(pos, src_mask_channel) != src_mask_value;
 		});
 
 		const Box3i src_box(dst_box.position - dst_base_pos, dst_box.size);
@@ -1410,12 +2383,12 @@ void paste_src_masked_dst_predicate(
 	if (with_metadata) {
 		dst_buffer.erase_voxel_metadata_if(
 				[&src_buffer, src_mask_channel, src_mask_value, dst_box, &dst_buffer, dst_mask_channel, &dst_predicate](
-						const FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair &p
+						const Vector3i &pos, const VoxelMetadata &meta
 				) {
 					//
-					return dst_box.contains(p.key) //
-							&& src_buffer.get_voxel(p.key, src_mask_channel) != src_mask_value //
-							&& dst_predicate(dst_buffer.get_voxel(p.key, dst_mask_channel));
+					return dst_box.contains(pos) //
+							&& src_buffer.get_voxel(pos, src_mask_channel) != src_mask_value //
+							&& dst_predicate(dst_buffer.get_voxel(pos, dst_mask_channel));
 				}
 		);
 
@@ -8,6 +8,7 @@
 #include "funcs.h"
 #include "metadata/voxel_metadata.h"
 
+#include <cstring>
 #include <limits>
 
 namespace zylann {
@@ -39,6 +40,10 @@ public:
 	enum Compression : uint8_t {
 		COMPRESSION_NONE = 0,
 		COMPRESSION_UNIFORM, // aka "no voxels allocated"
+		// Voxels are stored as bit-packed indices into a small list of distinct values. Index width grows as new
+		// values are added, up to a limit beyond which the channel falls back to `COMPRESSION_NONE`.
+		// This is an in-memory format only, it is expanded when serialized.
+		COMPRESSION_PALETTE,
 		COMPRESSION_COUNT
 	};
 
@@ -47,6 +52,11 @@ public:
 		DEPTH_16_BIT,
 		DEPTH_32_BIT,
 		DEPTH_64_BIT,
+		// Depths below 8 bits are bit-packed, for small integer values such as flags. They come after the others so
+		// values of existing depths remain the same in saved data.
+		DEPTH_1_BIT,
+		DEPTH_2_BIT,
+		DEPTH_4_BIT,
 		DEPTH_COUNT
 	};
 
@@ -59,14 +69,19 @@ public:
 		ALLOCATOR_COUNT
 	};
 
-	static inline uint32_t get_depth_byte_count(VoxelBuffer::Depth d) {
-		ZN_ASSERT(d >= 0 && d < VoxelBuffer::DEPTH_COUNT);
-		return 1 << d;
+	static inline bool is_bit_packed_depth(Depth d) {
+		return d >= DEPTH_1_BIT && d < DEPTH_COUNT;
 	}
 
 	static inline uint32_t get_depth_bit_count(Depth d) {
-		// CRASH_COND(d < 0 || d >= VoxelBuffer::DEPTH_COUNT);
-		return get_depth_byte_count(d) << 3;
+		ZN_ASSERT(d >= 0 && d < VoxelBuffer::DEPTH_COUNT);
+		static const uint8_t s_bit_counts[DEPTH_COUNT] = { 8, 16, 32, 64, 1, 2, 4 };
+		return s_bit_counts[d];
+	}
+
+	// Gets how many bytes a single voxel takes. Returns 0 for bit-packed depths, as voxels don't take whole bytes.
+	static inline uint32_t get_depth_byte_count(VoxelBuffer::Depth d) {
+		return get_depth_bit_count(d) >> 3;
 	}
 
 	static inline Depth get_depth_from_size(size_t size) {
@@ -115,6 +130,36 @@ public:
 		static const size_t MAX_SIZE_IN_BYTES = std::numeric_limits<uint32_t>::max();
 	};
 
+	// Layout of channel data when using `COMPRESSION_PALETTE`:
+	// [PaletteHeader][uint64_t entries[1 << index_bits]][packed indices, `index_bits` per voxel, in ZXY order]
+	// Index widths are always a power of two below 8 bits, so an index never straddles two bytes.
+	struct PaletteHeader {
+		// How many entries are in use
+		uint16_t size;
+		// 1, 2, 4 or 8
+		uint8_t index_bits;
+		uint8_t _unused;
+		// Number of packed indices
+		uint32_t volume;
+	};
+
+	static const unsigned int MAX_PALETTE_INDEX_BITS = 8;
+
+	// Access to voxels of bit-packed depths. Voxels are packed from the lowest bits of each byte, in ZXY order.
+	// `bits` is 1, 2 or 4, so a voxel never straddles two bytes.
+	static inline unsigned int get_packed_voxel(const uint8_t *data, size_t voxel_index, unsigned int bits) {
+		const size_t bit_offset = voxel_index * bits;
+		return (data[bit_offset >> 3] >> (bit_offset & 7)) & ((1 << bits) - 1);
+	}
+
+	static inline void set_packed_voxel(uint8_t *data, size_t voxel_index, unsigned int bits, uint64_t value) {
+		const size_t bit_offset = voxel_index * bits;
+		const unsigned int shift = bit_offset & 7;
+		const uint8_t mask = ((1 << bits) - 1) << shift;
+		uint8_t &b = data[bit_offset >> 3];
+		b = (b & ~mask) | ((value << shift) & mask);
+	}
+
 	// VoxelBuffer();
 	VoxelBuffer(Allocator allocator);
 	VoxelBuffer(VoxelBuffer &&src);
@@ -154,6 +199,19 @@ public:
 		set_voxel_f(value, pos.x, pos.y, pos.z, channel_index);
 	}
 
+	// Bulk versions of `get_voxel_f` and `set_voxel_f`, converting all voxels of a box at once, which is much faster
+	// than doing it voxel by voxel. Values are in ZXY order and their count must match the volume of the box. The box
+	// must be inside the buffer. Setting values decompresses the channel.
+	void get_box_f(Box3i box, unsigned int channel_index, Span<float> dst) const;
+	void set_box_f(Box3i box, unsigned int channel_index, Span<const float> src);
+	void get_channel_f(unsigned int channel_index, Span<float> dst) const;
+	void set_channel_f(unsigned int channel_index, Span<const float> src);
+
+	// Bulk versions of `get_voxel` and `set_voxel`, with the same conventions as `get_box_f`. Values of 32-bit channels
+	// are reinterpreted as signed, and 64-bit values are truncated to their lowest 32 bits.
+	void get_box(Box3i box, unsigned int channel_index, Span<int32_t> dst) const;
+	void set_box(Box3i box, unsigned int channel_index, Span<const int32_t> src);
+
 	inline uint64_t get_voxel(const Vector3i pos, unsigned int channel_index) const {
 		return get_voxel(pos.x, pos.y, pos.z, channel_index);
 	}
@@ -169,11 +227,21 @@ public:
 	bool is_uniform(unsigned int channel_index) const;
 
 	void compress_uniform_channels();
+	// Converts channels to `COMPRESSION_PALETTE` when they contain few enough distinct values for it to use less
+	// memory. Channels already using a palette get it rebuilt, dropping values no longer in use. Uniform channels are
+	// also detected.
+	void compress_palette_channels();
+	void compress_palette_channel(unsigned int channel_index);
 	void decompress_channel(unsigned int channel_index);
 	Compression get_channel_compression(unsigned int channel_index) const;
 
 	static size_t get_size_in_bytes_for_volume(Vector3i size, Depth depth);
 
+	// Gets how many bytes are allocated to store channels. Metadata is not included.
+	size_t get_channels_memory_usage() const;
+	// Gets how many bytes are allocated to store one channel. Uniform channels have none.
+	size_t get_channel_memory_usage(unsigned int channel_index) const;
+
 	void copy_format(const VoxelBuffer &other);
 
 	// Specialized copy functions.
@@ -245,8 +313,27 @@ public:
 
 		if (channel.compression == COMPRESSION_UNIFORM) {
 			fill_3d_region_zxy<T>(dst, dst_size, dst_min, dst_min + (src_max - src_min), channel.defval);
+
+		} else if (channel.compression == COMPRESSION_PALETTE) {
+			Vector3iUtil::sort_min_max(src_min, src_max);
+			clip_copy_region(src_min, src_max, _size, dst_min, dst_size);
+			Vector3i src_pos;
+			for (src_pos.z = src_min.z; src_pos.z < src_max.z; ++src_pos.z) {
+				for (src_pos.x = src_min.x; src_pos.x < src_max.x; ++src_pos.x) {
+					size_t src_i = get_index(src_pos.x, src_min.y, src_pos.z);
+					size_t dst_i = Vector3iUtil::get_zxy_index(
+							dst_min + Vector3i(src_pos.x, src_min.y, src_pos.z) - src_min, dst_size
+					);
+					for (src_pos.y = src_min.y; src_pos.y < src_max.y; ++src_pos.y) {
+						dst[dst_i] = raw_voxel_as<T>(get_palette_value(channel, src_i));
+						++src_i;
+						++dst_i;
+					}
+				}
+			}
+
 		} else {
-			Span<const T> src(static_cast<const T *>(channel.data), channel.size_in_bytes / sizeof(T));
+			Span<const T> src(reinterpret_cast<const T *>(channel.data), channel.size_in_bytes / sizeof(T));
 			copy_3d_region_zxy<T>(dst, dst_size, dst_min, src, _size, src_min, src_max);
 		}
 	}
@@ -368,12 +455,35 @@ public:
 			case DEPTH_64_BIT:
 				write_box_template<F, uint64_t>(box, channel_index, action_func, offset);
 				break;
+			case DEPTH_1_BIT:
+			case DEPTH_2_BIT:
+			case DEPTH_4_BIT:
+				write_box_packed(box, channel_index, action_func, offset);
+				break;
 			default:
 				ZN_PRINT_ERROR("Unknown channel");
 				break;
 		}
 	}
 
+	// uint8_t action_func(Vector3i pos, uint8_t in_v)
+	template <typename F>
+	void write_box_packed(const Box3i &box, unsigned int channel_index, F action_func, Vector3i offset) {
+		decompress_channel(channel_index);
+		Channel &channel = _channels[channel_index];
+#ifdef DEBUG_ENABLED
+		ZN_ASSERT_RETURN(Box3i(Vector3i(), _size).contains(box));
+		ZN_ASSERT_RETURN(is_bit_packed_depth(channel.depth));
+#endif
+		uint8_t *data = channel.data;
+		const unsigned int bits = get_depth_bit_count(channel.depth);
+		for_each_index_and_pos(box, [data, bits, action_func, offset](size_t i, Vector3i pos) {
+			const uint8_t v = get_packed_voxel(data, i, bits);
+			set_packed_voxel(data, i, bits, action_func(pos + offset, v));
+		});
+		compress_if_uniform(channel);
+	}
+
 	/*template <typename F>
 	void write_box_2(const Box3i &box, unsigned int channel_index0, unsigned int channel_index1, F action_func,
 			Vector3i offset) {
@@ -438,9 +548,14 @@ public:
 	// Gets a slice aliasing the channel's data
 	bool get_channel_as_bytes(unsigned int channel_index, Span<uint8_t> &slice);
 
-	// Gets a read-only slice aliasing the channel's data
+	// Gets a read-only slice aliasing the channel's data.
+	// Returns false if the channel is not `COMPRESSION_NONE`, in which case `get_channel_decompressed` may be used.
 	bool get_channel_as_bytes_read_only(unsigned int channel_index, Span<const uint8_t> &slice) const;
 
+	// Writes the raw contents of a channel into `dst`, regardless of how it is compressed.
+	// `dst` must have the size returned by `get_size_in_bytes_for_volume`.
+	bool get_channel_decompressed(unsigned int channel_index, Span<uint8_t> dst) const;
+
 	// Gets a slice aliasing the channel's data, reinterpreted to a specific type
 	template <typename T>
 	bool get_channel_data(unsigned int channel_index, Span<T> &dst) {
@@ -459,6 +574,10 @@ public:
 		return true;
 	}
 
+	// Gets the values a channel using `COMPRESSION_PALETTE` may contain. Some of them might not be in use.
+	// Returns false if the channel uses a different compression.
+	bool get_channel_palette(unsigned int channel_index, Span<const uint64_t> &out_entries) const;
+
 	// Overwrites contents of a channel with raw data. This skips default initialization of the channel, so it
 	// can be a little bit faster than using `decompress_channel`. The input data must have the right size.
 	void set_channel_from_bytes(const unsigned int channel_index, Span<const uint8_t> src);
@@ -493,19 +612,42 @@ public:
 
 	void clear_and_set_voxel_metadata(Span<FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair> pairs);
 
+	// `void callback(Vector3i pos, const VoxelMetadata &meta)`
 	template <typename F>
 	void for_each_voxel_metadata_in_area(Box3i box, F callback) const {
-		// TODO For `find`s and this kind of iteration, we may want to separate keys and values in FlatMap's internal
-		// storage, to reduce cache misses
-		for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator it = _voxel_metadata.begin();
-			 it != _voxel_metadata.end();
-			 ++it) {
-			if (box.contains(it->key)) {
-				callback(it->key, it->value);
+		// Keys are sorted by X, then Y, then Z. Instead of testing every item, whenever one is found outside of the
+		// box, we search for the next position that could be inside of it, which skips whole rows and slices.
+		const Vector3i min_pos = box.position;
+		const Vector3i max_pos = box.position + box.size;
+		const size_t count = _voxel_metadata.size();
+
+		size_t i = _voxel_metadata.lower_bound_index(min_pos);
+
+		while (i < count) {
+			const Vector3i pos = _voxel_metadata.get_key(i);
+			if (pos.x >= max_pos.x) {
+				break;
 			}
+			Vector3i next_pos;
+			if (pos.y < min_pos.y) {
+				next_pos = Vector3i(pos.x, min_pos.y, min_pos.z);
+			} else if (pos.y >= max_pos.y) {
+				next_pos = Vector3i(pos.x + 1, min_pos.y, min_pos.z);
+			} else if (pos.z < min_pos.z) {
+				next_pos = Vector3i(pos.x, pos.y, min_pos.z);
+			} else if (pos.z >= max_pos.z) {
+				next_pos = Vector3i(pos.x, pos.y + 1, min_pos.z);
+			} else {
+				callback(pos, _voxel_metadata.get_value(i));
+				++i;
+				continue;
+			}
+			// `next_pos` always comes after `pos`, so we keep moving forward
+			i = _voxel_metadata.lower_bound_index(next_pos, i + 1);
 		}
 	}
 
+	// `bool predicate(const Vector3i &pos, const VoxelMetadata &meta)`
 	template <typename F>
 	inline void erase_voxel_metadata_if(F predicate) {
 		_voxel_metadata.remove_if(predicate);
@@ -527,6 +669,45 @@ public:
 	}
 
 private:
+	static inline Span<const uint64_t> get_palette_entries(const Channel &channel) {
+		const PaletteHeader *header = reinterpret_cast<const PaletteHeader *>(channel.data);
+		return Span<const uint64_t>(
+				reinterpret_cast<const uint64_t *>(channel.data + sizeof(PaletteHeader)), header->size
+		);
+	}
+
+	static inline unsigned int get_palette_index(const Channel &channel, size_t voxel_index) {
+		const unsigned int bits = reinterpret_cast<const PaletteHeader *>(channel.data)->index_bits;
+		const uint8_t *indices = channel.data + sizeof(PaletteHeader) + (sizeof(uint64_t) << bits);
+		const size_t bit_offset = voxel_index * bits;
+		return (indices[bit_offset >> 3] >> (bit_offset & 7)) & ((1 << bits) - 1);
+	}
+
+	static inline uint64_t get_palette_value(const Channel &channel, size_t voxel_index) {
+		const uint64_t *entries = reinterpret_cast<const uint64_t *>(channel.data + sizeof(PaletteHeader));
+		return entries[get_palette_index(channel, voxel_index)];
+	}
+
+	// Reinterprets the lower bits of an encoded value, the same way they would be stored in a channel of that size
+	template <typename T>
+	static inline T raw_voxel_as(uint64_t raw) {
+		T v;
+		if constexpr (sizeof(T) == 1) {
+			const uint8_t u = raw;
+			memcpy(&v, &u, sizeof(T));
+		} else if constexpr (sizeof(T) == 2) {
+			const uint16_t u = raw;
+			memcpy(&v, &u, sizeof(T));
+		} else if constexpr (sizeof(T) == 4) {
+			const uint32_t u = raw;
+			memcpy(&v, &u, sizeof(T));
+		} else {
+			static_assert(sizeof(T) == 8);
+			memcpy(&v, &raw, sizeof(T));
+		}
+		return v;
+	}
+
 	void init_channel_defaults();
 	bool create_channel_noinit(int i, Vector3i size);
 	bool create_channel(int i, uint64_t defval);
@@ -534,7 +715,11 @@ private:
 	void compress_if_uniform(Channel &channel);
 	static void delete_channel(Channel &channel, Allocator allocator);
 	static void clear_channel(Channel &channel, uint64_t clear_value, Allocator allocator);
-	static bool is_uniform(const Channel &channel);
+	bool is_uniform(const Channel &channel) const;
+	bool create_palette_channel(Channel &channel, unsigned int index_bits);
+	bool try_get_or_add_palette_entry(Channel &channel, uint64_t value, unsigned int &out_index);
+	void set_palette_index(Channel &channel, size_t voxel_index, unsigned int palette_index);
+	void decompress_palette_channel(Channel &channel);
 
 private:
 	// Each channel can store arbitrary data.
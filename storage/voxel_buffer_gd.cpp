@@ -11,6 +11,23 @@
 
 namespace zylann::voxel {
 
+// Some operations need raw access to a channel they can't modify. Palettes don't provide that, in which case the
+// channel is expanded into `tmp`, and `tmp` is returned instead.
+const VoxelBuffer &get_buffer_with_raw_channel(
+		const VoxelBuffer &src,
+		const VoxelBuffer::ChannelId channel,
+		VoxelBuffer &tmp
+) {
+	if (src.get_channel_compression(channel) != VoxelBuffer::COMPRESSION_PALETTE) {
+		return src;
+	}
+	tmp.create(src.get_size());
+	tmp.set_channel_depth(channel, src.get_channel_depth(channel));
+	tmp.copy_channel_from(src, channel);
+	tmp.decompress_channel(channel);
+	return tmp;
+}
+
 template <typename F>
 void op_buffer_value_f(
 		VoxelBuffer &dst,
@@ -52,6 +69,9 @@ void op_buffer_value_f(
 		} break;
 
 		case VoxelBuffer::DEPTH_64_BIT:
+		case VoxelBuffer::DEPTH_1_BIT:
+		case VoxelBuffer::DEPTH_2_BIT:
+		case VoxelBuffer::DEPTH_4_BIT:
 			ZN_PRINT_ERROR("Unsupported depth for operation");
 			break;
 
@@ -74,6 +94,12 @@ void op_buffer_buffer_f(
 		return;
 	}
 
+	if (src.get_channel_compression(channel) == zylann::voxel::VoxelBuffer::COMPRESSION_PALETTE) {
+		VoxelBuffer tmp(VoxelBuffer::ALLOCATOR_POOL);
+		op_buffer_buffer_f(dst, get_buffer_with_raw_channel(src, channel, tmp), channel, f);
+		return;
+	}
+
 	if (dst.get_channel_compression(channel) == zylann::voxel::VoxelBuffer::COMPRESSION_UNIFORM) {
 		dst.decompress_channel(channel);
 	}
@@ -114,6 +140,9 @@ void op_buffer_buffer_f(
 		} break;
 
 		case VoxelBuffer::DEPTH_64_BIT:
+		case VoxelBuffer::DEPTH_1_BIT:
+		case VoxelBuffer::DEPTH_2_BIT:
+		case VoxelBuffer::DEPTH_4_BIT:
 			ZN_PRINT_ERROR("Non-implemented depth for operation");
 			break;
 
@@ -131,6 +160,12 @@ TypedArray<Image> sdf_to_3d_texture_data_zxy(const VoxelBuffer &vb, const Image:
 	ZN_PROFILE_SCOPE();
 
 	const VoxelBuffer::ChannelId channel = zylann::voxel::VoxelBuffer::CHANNEL_SDF;
+
+	if (vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE) {
+		VoxelBuffer tmp(VoxelBuffer::ALLOCATOR_POOL);
+		return sdf_to_3d_texture_data_zxy(get_buffer_with_raw_channel(vb, channel, tmp), output_format);
+	}
+
 	const VoxelBuffer::Depth depth = vb.get_channel_depth(channel);
 	const uint64_t xy_area = vb.get_size().x * vb.get_size().y;
 	const VoxelBuffer::Compression channel_compression = vb.get_channel_compression(channel);
@@ -271,6 +306,19 @@ PackedByteArray get_channel_as_byte_array(const VoxelBuffer &vb, const VoxelBuff
 					pba_s.fill(v);
 				} break;
 
+				case VoxelBuffer::DEPTH_1_BIT:
+				case VoxelBuffer::DEPTH_2_BIT:
+				case VoxelBuffer::DEPTH_4_BIT: {
+					pba.resize(VoxelBuffer::get_size_in_bytes_for_volume(res, depth));
+					const unsigned int bits = VoxelBuffer::get_depth_bit_count(depth);
+					const uint8_t v = vb.get_voxel(Vector3i(0, 0, 0), channel);
+					uint8_t pattern = 0;
+					for (unsigned int i = 0; i < 8; i += bits) {
+						pattern |= v << i;
+					}
+					pba.fill(pattern);
+				} break;
+
 				default:
 					ZN_PRINT_ERROR("Unhandled channel depth");
 					break;
@@ -280,10 +328,16 @@ PackedByteArray get_channel_as_byte_array(const VoxelBuffer &vb, const VoxelBuff
 		case VoxelBuffer::COMPRESSION_NONE: {
 			Span<const uint8_t> src;
 			ZN_ASSERT_RETURN_V(vb.get_channel_as_bytes_read_only(channel, src), pba);
-			Span<uint8_t> pba_s(pba.ptrw(), volume);
+			pba.resize(src.size());
+			Span<uint8_t> pba_s(pba.ptrw(), src.size());
 			src.copy_to(pba_s);
 		} break;
 
+		case VoxelBuffer::COMPRESSION_PALETTE: {
+			pba.resize(VoxelBuffer::get_size_in_bytes_for_volume(res, depth));
+			ZN_ASSERT_RETURN_V(vb.get_channel_decompressed(channel, Span<uint8_t>(pba.ptrw(), pba.size())), pba);
+		} break;
+
 		default:
 			ZN_PRINT_ERROR("Unhandled compression");
 			break;
@@ -393,6 +447,10 @@ void VoxelBuffer::compress_uniform_channels() {
 	_buffer->compress_uniform_channels();
 }
 
+void VoxelBuffer::compress_palette_channels() {
+	_buffer->compress_palette_channels();
+}
+
 VoxelBuffer::Compression VoxelBuffer::get_channel_compression(int channel_index) const {
 	ERR_FAIL_INDEX_V(channel_index, MAX_CHANNELS, VoxelBuffer::COMPRESSION_NONE);
 	return VoxelBuffer::Compression(_buffer->get_channel_compression(channel_index));
@@ -468,6 +526,21 @@ void VoxelBuffer::remap_values(unsigned int channel_index, PackedInt32Array map)
 			}
 		} break;
 
+		case zylann::voxel::VoxelBuffer::DEPTH_1_BIT:
+		case zylann::voxel::VoxelBuffer::DEPTH_2_BIT:
+		case zylann::voxel::VoxelBuffer::DEPTH_4_BIT: {
+			Span<uint8_t> bytes;
+			ZN_ASSERT_RETURN(_buffer->get_channel_as_bytes(channel_index, bytes));
+			const unsigned int bits = zylann::voxel::VoxelBuffer::get_depth_bit_count(depth);
+			const uint64_t volume = Vector3iUtil::get_volume_u64(_buffer->get_size());
+			for (uint64_t i = 0; i < volume; ++i) {
+				const uint64_t v = zylann::voxel::VoxelBuffer::get_packed_voxel(bytes.data(), i, bits);
+				if (v < map_r.size()) {
+					zylann::voxel::VoxelBuffer::set_packed_voxel(bytes.data(), i, bits, map_r[v]);
+				}
+			}
+		} break;
+
 		default:
 			ZN_PRINT_ERROR("Remapping channel values is not implemented for depths greater than 16 bits.");
 			break;
@@ -571,7 +644,8 @@ void VoxelBuffer::op_select_less_src_f_dst_i_values(
 	ZN_ASSERT_RETURN(dst_channel >= 0 && dst_channel < VoxelBuffer::MAX_CHANNELS);
 	ZN_ASSERT_RETURN(get_size() == src_ref->get_size());
 
-	const zylann::voxel::VoxelBuffer &src = src_ref->get_buffer();
+	zylann::voxel::VoxelBuffer src_tmp(zylann::voxel::VoxelBuffer::ALLOCATOR_POOL);
+	const zylann::voxel::VoxelBuffer &src = get_buffer_with_raw_channel(src_ref->get_buffer(), src_channel, src_tmp);
 	zylann::voxel::VoxelBuffer &dst = *_buffer;
 
 	// Optimizable, but a bit too many combinations of formats than it's worth.
@@ -741,6 +815,68 @@ void VoxelBuffer::set_channel_from_byte_array(const ChannelId channel, const Pac
 	_buffer->set_channel_from_bytes(channel, to_span(pba));
 }
 
+PackedFloat32Array VoxelBuffer::get_area_as_float32_array(Vector3i min, Vector3i max, const ChannelId channel) const {
+	ZN_ASSERT_RETURN_V(channel >= 0 && channel < MAX_CHANNELS, PackedFloat32Array());
+	const Box3i box = Box3i::from_min_max(min, max);
+	ZN_ASSERT_RETURN_V(Box3i(Vector3i(), get_size()).contains(box), PackedFloat32Array());
+	PackedFloat32Array values;
+	values.resize(Vector3iUtil::get_volume_u64(box.size));
+	_buffer->get_box_f(box, channel, Span<float>(values.ptrw(), values.size()));
+	return values;
+}
+
+void VoxelBuffer::set_area_from_float32_array(
+		PackedFloat32Array values,
+		Vector3i min,
+		Vector3i max,
+		const ChannelId channel
+) {
+	ZN_DSTACK();
+	ZN_ASSERT_RETURN(channel >= 0 && channel < MAX_CHANNELS);
+	const Box3i box = Box3i::from_min_max(min, max);
+	ZN_ASSERT_RETURN(Box3i(Vector3i(), get_size()).contains(box));
+	ZN_ASSERT_RETURN_MSG(
+			static_cast<uint64_t>(values.size()) == Vector3iUtil::get_volume_u64(box.size),
+			"Number of values doesn't match the volume of the area"
+	);
+	_buffer->set_box_f(box, channel, Span<const float>(values.ptr(), values.size()));
+}
+
+PackedInt32Array VoxelBuffer::get_area_as_int32_array(Vector3i min, Vector3i max, const ChannelId channel) const {
+	ZN_ASSERT_RETURN_V(channel >= 0 && channel < MAX_CHANNELS, PackedInt32Array());
+	const Box3i box = Box3i::from_min_max(min, max);
+	ZN_ASSERT_RETURN_V(Box3i(Vector3i(), get_size()).contains(box), PackedInt32Array());
+	PackedInt32Array values;
+	values.resize(Vector3iUtil::get_volume_u64(box.size));
+	_buffer->get_box(box, channel, Span<int32_t>(values.ptrw(), values.size()));
+	return values;
+}
+
+void VoxelBuffer::set_area_from_int32_array(
+		PackedInt32Array values,
+		Vector3i min,
+		Vector3i max,
+		const ChannelId channel
+) {
+	ZN_DSTACK();
+	ZN_ASSERT_RETURN(channel >= 0 && channel < MAX_CHANNELS);
+	const Box3i box = Box3i::from_min_max(min, max);
+	ZN_ASSERT_RETURN(Box3i(Vector3i(), get_size()).contains(box));
+	ZN_ASSERT_RETURN_MSG(
+			static_cast<uint64_t>(values.size()) == Vector3iUtil::get_volume_u64(box.size),
+			"Number of values doesn't match the volume of the area"
+	);
+	_buffer->set_box(box, channel, Span<const int32_t>(values.ptr(), values.size()));
+}
+
+int64_t VoxelBuffer::get_channel_raw_address(const ChannelId channel) {
+	ZN_ASSERT_RETURN_V(channel >= 0 && channel < MAX_CHANNELS, 0);
+	_buffer->decompress_channel(channel);
+	Span<uint8_t> data;
+	ZN_ASSERT_RETURN_V(_buffer->get_channel_as_bytes(channel, data), 0);
+	return reinterpret_cast<int64_t>(data.data());
+}
+
 Ref<Image> VoxelBuffer::debug_print_sdf_to_image_top_down() {
 	return debug_print_sdf_to_image_top_down(*_buffer);
 }
@@ -865,6 +1001,7 @@ void VoxelBuffer::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD("is_uniform", "channel"), &VoxelBuffer::is_uniform);
 	ClassDB::bind_method(D_METHOD("compress_uniform_channels"), &VoxelBuffer::compress_uniform_channels);
+	ClassDB::bind_method(D_METHOD("compress_palette_channels"), &VoxelBuffer::compress_palette_channels);
 	ClassDB::bind_method(D_METHOD("get_channel_compression", "channel"), &VoxelBuffer::get_channel_compression);
 	ClassDB::bind_method(D_METHOD("decompress_channel", "channel"), &VoxelBuffer::decompress_channel);
 
@@ -918,6 +1055,23 @@ void VoxelBuffer::_bind_methods() {
 	ClassDB::bind_method(
 			D_METHOD("set_channel_from_byte_array", "channel_index", "data"), &VoxelBuffer::set_channel_from_byte_array
 	);
+	ClassDB::bind_method(
+			D_METHOD("get_area_as_float32_array", "min", "max", "channel"), &VoxelBuffer::get_area_as_float32_array
+	);
+	ClassDB::bind_method(
+			D_METHOD("set_area_from_float32_array", "values", "min", "max", "channel"),
+			&VoxelBuffer::set_area_from_float32_array
+	);
+	ClassDB::bind_method(
+			D_METHOD("get_area_as_int32_array", "min", "max", "channel"), &VoxelBuffer::get_area_as_int32_array
+	);
+	ClassDB::bind_method(
+			D_METHOD("set_area_from_int32_array", "values", "min", "max", "channel"),
+			&VoxelBuffer::set_area_from_int32_array
+	);
+	ClassDB::bind_method(
+			D_METHOD("get_channel_raw_address", "channel_index"), &VoxelBuffer::get_channel_raw_address
+	);
 	ClassDB::bind_method(
 			D_METHOD("debug_print_sdf_y_slices", "scale"), &VoxelBuffer::debug_print_sdf_y_slices, DEFVAL(1.0)
 	);
@@ -936,10 +1090,14 @@ void VoxelBuffer::_bind_methods() {
 	BIND_ENUM_CONSTANT(DEPTH_16_BIT);
 	BIND_ENUM_CONSTANT(DEPTH_32_BIT);
 	BIND_ENUM_CONSTANT(DEPTH_64_BIT);
+	BIND_ENUM_CONSTANT(DEPTH_1_BIT);
+	BIND_ENUM_CONSTANT(DEPTH_2_BIT);
+	BIND_ENUM_CONSTANT(DEPTH_4_BIT);
 	BIND_ENUM_CONSTANT(DEPTH_COUNT);
 
 	BIND_ENUM_CONSTANT(COMPRESSION_NONE);
 	BIND_ENUM_CONSTANT(COMPRESSION_UNIFORM);
+	BIND_ENUM_CONSTANT(COMPRESSION_PALETTE);
 	BIND_ENUM_CONSTANT(COMPRESSION_COUNT);
 
 	BIND_ENUM_CONSTANT(ALLOCATOR_DEFAULT);
@@ -46,6 +46,7 @@ public:
 	enum Compression {
 		COMPRESSION_NONE = zylann::voxel::VoxelBuffer::COMPRESSION_NONE,
 		COMPRESSION_UNIFORM = zylann::voxel::VoxelBuffer::COMPRESSION_UNIFORM,
+		COMPRESSION_PALETTE = zylann::voxel::VoxelBuffer::COMPRESSION_PALETTE,
 		// COMPRESSION_RLE,
 		COMPRESSION_COUNT = zylann::voxel::VoxelBuffer::COMPRESSION_COUNT
 	};
@@ -55,6 +56,9 @@ public:
 		DEPTH_16_BIT = zylann::voxel::VoxelBuffer::DEPTH_16_BIT,
 		DEPTH_32_BIT = zylann::voxel::VoxelBuffer::DEPTH_32_BIT,
 		DEPTH_64_BIT = zylann::voxel::VoxelBuffer::DEPTH_64_BIT,
+		DEPTH_1_BIT = zylann::voxel::VoxelBuffer::DEPTH_1_BIT,
+		DEPTH_2_BIT = zylann::voxel::VoxelBuffer::DEPTH_2_BIT,
+		DEPTH_4_BIT = zylann::voxel::VoxelBuffer::DEPTH_4_BIT,
 		DEPTH_COUNT = zylann::voxel::VoxelBuffer::DEPTH_COUNT
 	};
 
@@ -142,6 +146,7 @@ public:
 	bool is_uniform(int channel_index) const;
 
 	void compress_uniform_channels();
+	void compress_palette_channels();
 	Compression get_channel_compression(int channel_index) const;
 	void decompress_channel(int channel_index);
 
@@ -166,6 +171,18 @@ public:
 	PackedByteArray get_channel_as_byte_array(const ChannelId channel) const;
 	void set_channel_from_byte_array(const ChannelId channel, const PackedByteArray &pba);
 
+	// Bulk access to voxels of an area, converted natively all at once, which avoids calling into the API for every
+	// voxel. Values are in ZXY order.
+	PackedFloat32Array get_area_as_float32_array(Vector3i min, Vector3i max, const ChannelId channel) const;
+	void set_area_from_float32_array(PackedFloat32Array values, Vector3i min, Vector3i max, const ChannelId channel);
+	PackedInt32Array get_area_as_int32_array(Vector3i min, Vector3i max, const ChannelId channel) const;
+	void set_area_from_int32_array(PackedInt32Array values, Vector3i min, Vector3i max, const ChannelId channel);
+
+	// Decompresses a channel and returns the address of its raw memory, so native code (like other extensions or C#)
+	// can access it without copying. It remains valid until the channel gets compressed, changes depth, or the buffer
+	// is resized or freed.
+	int64_t get_channel_raw_address(const ChannelId channel);
+
 	Ref<ImageTexture3D> create_3d_texture_from_sdf_zxy(const Image::Format output_format) const;
 	void update_3d_texture_from_sdf_zxy(Ref<ImageTexture3D> texture) const;
 
@@ -0,0 +1,39 @@
+#ifndef VOXEL_CLIPBOARD_H
+#define VOXEL_CLIPBOARD_H
+
+#include "../util/containers/std_vector.h"
+#include "../util/math/vector3i.h"
+#include "voxel_buffer.h"
+#include <cstdint>
+
+namespace zylann::voxel {
+
+// Copy of an area of voxels, split into chunks following the blocks it was copied from instead of being a single
+// buffer. Chunks covering a whole block keep its compression (uniform or palette), so copying large areas doesn't
+// require to allocate all their voxels, and pasting them where they line up with blocks can copy them whole.
+struct VoxelClipboard {
+	struct Chunk {
+		// Position of the chunk relative to the origin of the copied area
+		Vector3i position;
+		// Size of a block, unless the chunk is at the edge of the copied area
+		VoxelBuffer voxels;
+
+		Chunk() : voxels(VoxelBuffer::ALLOCATOR_DEFAULT) {}
+	};
+
+	// Size of the copied area
+	Vector3i size;
+	// Bits telling which channels were copied
+	uint8_t channels_mask = 0;
+	StdVector<Chunk> chunks;
+
+	void clear() {
+		size = Vector3i();
+		channels_mask = 0;
+		chunks.clear();
+	}
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_CLIPBOARD_H
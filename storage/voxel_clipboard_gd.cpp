@@ -0,0 +1,23 @@
+#include "voxel_clipboard_gd.h"
+
+namespace zylann::voxel::godot {
+
+Vector3i VoxelClipboard::get_size() const {
+	return _clipboard.size;
+}
+
+int VoxelClipboard::get_chunk_count() const {
+	return _clipboard.chunks.size();
+}
+
+void VoxelClipboard::clear() {
+	_clipboard.clear();
+}
+
+void VoxelClipboard::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_size"), &VoxelClipboard::get_size);
+	ClassDB::bind_method(D_METHOD("get_chunk_count"), &VoxelClipboard::get_chunk_count);
+	ClassDB::bind_method(D_METHOD("clear"), &VoxelClipboard::clear);
+}
+
+} // namespace zylann::voxel::godot
@@ -0,0 +1,33 @@
+#ifndef VOXEL_CLIPBOARD_GD_H
+#define VOXEL_CLIPBOARD_GD_H
+
+#include "../util/godot/classes/ref_counted.h"
+#include "voxel_clipboard.h"
+
+namespace zylann::voxel::godot {
+
+// Scripts-facing wrapper around VoxelClipboard, obtained from VoxelTool
+class VoxelClipboard : public RefCounted {
+	GDCLASS(VoxelClipboard, RefCounted)
+public:
+	zylann::voxel::VoxelClipboard &get_clipboard() {
+		return _clipboard;
+	}
+
+	const zylann::voxel::VoxelClipboard &get_clipboard() const {
+		return _clipboard;
+	}
+
+	Vector3i get_size() const;
+	int get_chunk_count() const;
+	void clear();
+
+private:
+	static void _bind_methods();
+
+	zylann::voxel::VoxelClipboard _clipboard;
+};
+
+} // namespace zylann::voxel::godot
+
+#endif // VOXEL_CLIPBOARD_GD_H
@@ -1,12 +1,17 @@
 #include "voxel_data.h"
+#include "../util/containers/std_unordered_map.h"
 #include "../util/containers/std_vector.h"
 #include "../util/dstack.h"
 #include "../util/math/conv.h"
+#include "../util/profiling.h"
 #include "../util/string/format.h"
 #include "../util/thread/mutex.h"
 #include "metadata/voxel_metadata_variant.h"
+#include "voxel_clipboard.h"
 #include "voxel_data_grid.h"
 
+#include <algorithm>
+
 namespace zylann::voxel {
 
 namespace {
@@ -24,6 +29,9 @@ struct BeforeUnloadSaveAction {
 			if (block.has_voxels()) {
 				// No copy is necessary because the block will be removed anyways
 				b.voxels = block.get_voxels_shared();
+				// Saving null voxels would remove the block from the stream. If its compressed data is unreadable, we
+				// can't save it, but leaving the previous version in the stream is better than deleting it.
+				ZN_ASSERT_RETURN_MSG(b.voxels != nullptr, "Can't save block, its voxels could not be decompressed");
 			}
 			to_save->push_back(b);
 		}
@@ -33,7 +41,6 @@ struct BeforeUnloadSaveAction {
 struct ScheduleSaveAction {
 	StdVector<VoxelData::BlockToSave> &blocks_to_save;
 	uint8_t lod_index;
-	bool with_copy;
 
 	void operator()(const Vector3i &bpos, VoxelDataBlock &block) {
 		if (block.is_modified()) {
@@ -41,12 +48,11 @@ struct ScheduleSaveAction {
 			VoxelData::BlockToSave b;
 			// If a modified block has no voxels, it is equivalent to removing the block from the stream
 			if (block.has_voxels()) {
-				if (with_copy) {
-					b.voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
-					block.get_voxels_const().copy_to(*b.voxels, true);
-				} else {
-					b.voxels = block.get_voxels_shared();
-				}
+				// No copy is necessary, voxel data is copy-on-write
+				b.voxels = block.get_voxels_shared();
+				// Not saving null voxels since it would remove the block from the stream. It stays modified, so saving
+				// is attempted again next time.
+				ZN_ASSERT_RETURN_MSG(b.voxels != nullptr, "Can't save block, its voxels could not be decompressed");
 			}
 			b.position = bpos;
 			b.lod_index = lod_index;
@@ -55,6 +61,34 @@ struct ScheduleSaveAction {
 		}
 	}
 };
+
+struct EvictionCandidate {
+	Vector3i position;
+	uint32_t lod_index;
+	uint32_t last_access;
+	size_t memory_usage;
+};
+
+struct GatherEvictionCandidatesAction {
+	StdVector<EvictionCandidate> &candidates;
+	uint64_t &cache_memory_usage;
+	uint32_t lod_index;
+	// Blocks accessed at this time or later are not candidates
+	uint32_t min_kept_access;
+
+	void operator()(const Vector3i &bpos, const VoxelDataBlock &block) {
+		if (!block.has_voxels() || block.is_edited()) {
+			return;
+		}
+		// Doesn't decompress cold blocks
+		const size_t memory_usage = block.get_voxels_memory_usage();
+		cache_memory_usage += memory_usage;
+		const uint32_t last_access = block.get_last_access();
+		if (last_access < min_kept_access) {
+			candidates.push_back(EvictionCandidate{ bpos, lod_index, last_access, memory_usage });
+		}
+	}
+};
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -94,7 +128,7 @@ void VoxelData::reset_maps_no_settings_lock() {
 		// That means not having any other thread holding a pointer to blocks in the map.
 		SpatialLock3D::Write swlock(data_lod.spatial_lock, BoxBounds3i::from_everywhere());
 
-		RWLockWrite wlock(data_lod.map_lock);
+		ShardedRWLockWrite wlock(data_lod.map_lock);
 
 		// Instance new maps if we have more lods, or clear them otherwise
 		if (lod_index < _lod_count) {
@@ -124,9 +158,22 @@ void VoxelData::set_streaming_enabled(bool enabled) {
 	_streaming_enabled = enabled;
 }
 
+void VoxelData::set_palette_compression_enabled(bool enabled) {
+	_palette_compression_enabled = enabled;
+}
+
+void VoxelData::set_cache_memory_budget(uint64_t bytes) {
+	_cache_memory_budget = bytes;
+}
+
 void VoxelData::set_full_load_completed(bool complete) {
 	// Can be set by other threads
 	_full_load_completed = complete;
+	_full_load_progress = complete ? 1.f : 0.f;
+}
+
+void VoxelData::set_full_load_progress(float progress) {
+	_full_load_progress = math::clamp(progress, 0.f, 1.f);
 }
 
 inline VoxelSingleValue get_voxel_sv(VoxelBuffer &vb, Vector3i pos, unsigned int channel) {
@@ -227,6 +274,130 @@ VoxelSingleValue VoxelData::get_voxel(Vector3i pos, unsigned int channel_index,
 	}
 }
 
+void VoxelData::acquire_block_read_access(Vector3i pos, BlockReadAccess &access) const {
+	access.release();
+
+	access._data = this;
+	access._state = BlockReadAccess::STATE_NOT_LOADED;
+	access._lod_index = 0;
+	access._bounds_in_voxels = get_bounds();
+
+	const unsigned int block_size_po2 = get_block_size_po2();
+	Vector3i block_pos = pos >> block_size_po2;
+	access._block_position = block_pos;
+	access._voxel_box = Box3i(block_pos << block_size_po2, Vector3iUtil::create(1 << block_size_po2));
+
+	if (!access._bounds_in_voxels.contains(pos)) {
+		return;
+	}
+
+	Ref<VoxelGenerator> generator = get_generator();
+	bool generate = false;
+
+	if (!_streaming_enabled) {
+		const Lod &data_lod0 = _lods[0];
+
+		data_lod0.spatial_lock.lock_read(BoxBounds3i::from_position(block_pos));
+		std::shared_ptr<VoxelBuffer> voxels = try_get_voxel_buffer_with_lock(data_lod0, block_pos, generate);
+
+		if (voxels == nullptr) {
+			data_lod0.spatial_lock.unlock_read(BoxBounds3i::from_position(block_pos));
+			// We know everything is loaded when data streaming is not used
+			if (generator.is_valid()) {
+				access._state = BlockReadAccess::STATE_GENERATED;
+				access._generator = generator;
+			}
+		} else {
+			access._state = BlockReadAccess::STATE_STORED;
+			access._voxels = voxels;
+			access._locked = true;
+		}
+
+	} else {
+		const unsigned int lod_count = get_lod_count();
+
+		// Check all LODs until we find a loaded location
+		for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+			const Lod &data_lod = _lods[lod_index];
+
+			data_lod.spatial_lock.lock_read(BoxBounds3i::from_position(block_pos));
+			std::shared_ptr<VoxelBuffer> voxels = try_get_voxel_buffer_with_lock(data_lod, block_pos, generate);
+
+			if (voxels != nullptr || generate) {
+				const unsigned int lod_block_size_po2 = block_size_po2 + lod_index;
+				access._lod_index = lod_index;
+				access._block_position = block_pos;
+				access._voxel_box =
+						Box3i(block_pos << lod_block_size_po2, Vector3iUtil::create(1 << lod_block_size_po2));
+			}
+
+			if (voxels != nullptr) {
+				access._state = BlockReadAccess::STATE_STORED;
+				access._voxels = voxels;
+				access._locked = true;
+				return;
+			}
+
+			data_lod.spatial_lock.unlock_read(BoxBounds3i::from_position(block_pos));
+
+			if (generate) {
+				if (generator.is_valid()) {
+					access._state = BlockReadAccess::STATE_GENERATED;
+					access._generator = generator;
+				}
+				return;
+			}
+
+			// Fallback on lower LOD
+			block_pos = block_pos >> 1;
+		}
+	}
+}
+
+void VoxelData::BlockReadAccess::release() {
+	if (_locked) {
+		_data->_lods[_lod_index].spatial_lock.unlock_read(BoxBounds3i::from_position(_block_position));
+		_locked = false;
+	}
+	_data = nullptr;
+	_voxels.reset();
+	_generator.unref();
+}
+
+VoxelSingleValue VoxelData::BlockReadAccess::get_voxel(
+		Vector3i pos,
+		unsigned int channel_index,
+		VoxelSingleValue defval
+) const {
+#ifdef DEBUG_ENABLED
+	ZN_ASSERT_RETURN_V(_voxel_box.contains(pos), defval);
+#endif
+
+	if (!_bounds_in_voxels.contains(pos)) {
+		return defval;
+	}
+
+	switch (_state) {
+		case STATE_STORED: {
+			const Vector3i rpos = _data->_lods[_lod_index].map.to_local(pos >> _lod_index);
+			return get_voxel_sv(*_voxels, rpos, channel_index);
+		}
+
+		case STATE_GENERATED: {
+			VoxelSingleValue value = _generator->generate_single(pos, channel_index);
+			if (channel_index == VoxelBuffer::CHANNEL_SDF) {
+				float sdf = value.f;
+				_data->_modifiers.apply(sdf, to_vec3f(pos));
+				value.f = sdf;
+			}
+			return value;
+		}
+
+		default:
+			return defval;
+	}
+}
+
 // TODO Piggyback on `paste`? The implementation is quite complex, and it's not supposed to be an efficient use case
 bool VoxelData::try_set_voxel(uint64_t value, Vector3i pos, unsigned int channel_index) {
 	Lod &data_lod0 = _lods[0];
@@ -244,6 +415,11 @@ bool VoxelData::try_set_voxel(uint64_t value, Vector3i pos, unsigned int channel
 			// We don't know what's actually in the block, it's not loaded. Can't edit.
 			return false;
 		}
+		if (!can_generate) {
+			ShardedRWLockRead rlock(data_lod0.map_lock);
+			// The block is present but its voxels failed to decompress. They may contain edits, so don't replace them.
+			ZN_ASSERT_RETURN_V(data_lod0.map.get_block(block_pos_lod0) == nullptr, false);
+		}
 		// The block is either loaded, or streaming is off (everything is loaded), so either way the block we want to
 		// edit is known
 
@@ -253,18 +429,26 @@ bool VoxelData::try_set_voxel(uint64_t value, Vector3i pos, unsigned int channel
 		Ref<VoxelGenerator> generator = get_generator();
 		if (generator.is_valid()) {
 			VoxelGenerator::VoxelQueryData q{ *voxels, block_pos_lod0 << get_block_size_po2(), 0 };
-			generator->generate_block(q);
-
-			_modifiers.apply(q.voxel_buffer, AABB(q.origin_in_voxels, q.voxel_buffer.get_size()));
+			generator->generate_block_with_modifiers(q, _modifiers);
 		}
 
-		RWLockWrite wlock(data_lod0.map_lock);
+		ShardedRWLockWrite wlock(data_lod0.map_lock);
 		// No other thread can modify this area while we were generating, since we hold a spatial lock.
 
 		data_lod0.map.set_block_buffer(block_pos_lod0, voxels, true);
 	}
 
-	voxels->set_voxel(value, data_lod0.map.to_local(pos), channel_index);
+	// Release our reference before writing, otherwise the block would always clone its voxels on write
+	voxels.reset();
+	{
+		ShardedRWLockRead rlock(data_lod0.map_lock);
+		VoxelDataBlock *block = data_lod0.map.get_block(block_pos_lod0);
+		ZN_ASSERT_RETURN_V(block != nullptr && block->has_voxels(), false);
+		// Don't overwrite edits that may be in compressed data
+		ZN_ASSERT_RETURN_V_MSG(block->decompress_voxels_if_needed(), false, "Block voxels could not be decompressed");
+		// Writing through the block so voxels are copied if tasks are still holding a snapshot of them
+		block->get_voxels().set_voxel(value, data_lod0.map.to_local(pos), channel_index);
+	}
 	// We don't update mips, this must be done by the caller
 	return true;
 }
@@ -280,6 +464,30 @@ bool VoxelData::try_set_voxel_f(real_t value, Vector3i pos, unsigned int channel
 	return try_set_voxel(snorm_to_s16(value), pos, channel_index);
 }
 
+namespace {
+
+struct CopyGenContext {
+	VoxelGenerator &generator;
+	const VoxelModifierStack &modifiers;
+	Box3i voxel_bounds;
+};
+
+// Generates on the fly in areas where blocks aren't edited
+void generate_for_copy(void *callback_data, VoxelBuffer &voxels, Vector3i pos) {
+	CopyGenContext *gctx = reinterpret_cast<CopyGenContext *>(callback_data);
+	if (!gctx->voxel_bounds.contains(pos)) {
+		// Out of bounds, produce empty voxels?
+		// Note: due to how `copy` works, we expect `pos` to be within a specific chunk and not copying
+		// across multiple chunks, so we don't have to check for every intersecting chunk
+		return;
+	}
+	ZN_PROFILE_SCOPE_NAMED("Generate");
+	VoxelGenerator::VoxelQueryData q{ voxels, pos, 0 };
+	gctx->generator.generate_block_with_modifiers(q, gctx->modifiers);
+}
+
+} // namespace
+
 void VoxelData::copy(Vector3i min_pos, VoxelBuffer &dst_buffer, unsigned int channels_mask) const {
 	ZN_PROFILE_SCOPE();
 
@@ -299,47 +507,40 @@ void VoxelData::copy(Vector3i min_pos, VoxelBuffer &dst_buffer, unsigned int cha
 	SpatialLock3D::Read srlock(data_lod0.spatial_lock, BoxBounds3i(blocks_box));
 
 	if (generator.is_null()) {
-		RWLockRead rlock(data_lod0.map_lock);
+		ShardedRWLockRead rlock(data_lod0.map_lock);
 		// Only gets blocks we have voxel data of. Other blocks will be air.
 		// TODO Modifiers?
 		data_lod0.map.copy(min_pos, dst_buffer, channels_mask);
 
 	} else {
-		struct GenContext {
-			VoxelGenerator &generator;
-			const VoxelModifierStack &modifiers;
-			Box3i voxel_bounds;
-		};
-
-		GenContext gctx{ **generator, modifiers, _bounds_in_voxels };
+		CopyGenContext gctx{ **generator, modifiers, _bounds_in_voxels };
 
 		// Note, when streaming is enabled and this intersects non-loaded areas, they will fallback on the generator.
 		// That's technically not correct as we don't really know what these areas should contain, they could have been
 		// edited. It may be useful for the caller to check first if the area is loaded. It would be better if all this
 		// could be done in a single transaction? Might need a proper transaction API eventually
 
-		RWLockRead rlock(data_lod0.map_lock);
-		data_lod0.map.copy(
-				min_pos,
-				dst_buffer,
-				channels_mask,
-				&gctx,
-				// Generate on the fly in areas where blocks aren't edited
-				[](void *callback_data, VoxelBuffer &voxels, Vector3i pos) {
-					// Suffixed with `2` because GCC warns it shadows a previous local...
-					GenContext *gctx2 = reinterpret_cast<GenContext *>(callback_data);
-					if (!gctx2->voxel_bounds.contains(pos)) {
-						// Out of bounds, produce empty voxels?
-						// Note: due to how `copy` works, we expect `pos` to be within a specific chunk and not copying
-						// across multiple chunks, so we don't have to check for every intersecting chunk
-						return;
-					}
-					ZN_PROFILE_SCOPE_NAMED("Generate");
-					VoxelGenerator::VoxelQueryData q{ voxels, pos, 0 };
-					gctx2->generator.generate_block(q);
-					gctx2->modifiers.apply(voxels, AABB(pos, voxels.get_size()));
-				}
-		);
+		ShardedRWLockRead rlock(data_lod0.map_lock);
+		data_lod0.map.copy(min_pos, dst_buffer, channels_mask, &gctx, generate_for_copy);
+	}
+}
+
+void VoxelData::copy_to_clipboard(Box3i box, VoxelClipboard &dst, unsigned int channels_mask) const {
+	ZN_PROFILE_SCOPE();
+
+	const Lod &data_lod0 = _lods[0];
+	Ref<VoxelGenerator> generator = get_generator();
+
+	const Box3i blocks_box = box.downscaled(data_lod0.map.get_block_size());
+	SpatialLock3D::Read srlock(data_lod0.spatial_lock, BoxBounds3i(blocks_box));
+	ShardedRWLockRead rlock(data_lod0.map_lock);
+
+	if (generator.is_null()) {
+		data_lod0.map.copy_to_clipboard(box, dst, channels_mask, nullptr, nullptr);
+	} else {
+		// Same caveat as `copy` regarding non-loaded areas
+		CopyGenContext gctx{ **generator, _modifiers, _bounds_in_voxels };
+		data_lod0.map.copy_to_clipboard(box, dst, channels_mask, &gctx, generate_for_copy);
 	}
 }
 
@@ -358,15 +559,46 @@ void VoxelData::paste(
 
 	if (create_new_blocks) {
 		// We will modify the hashmap so no other threads can perform lookups while we do that
-		RWLockWrite wlock(data_lod0.map_lock);
+		ShardedRWLockWrite wlock(data_lod0.map_lock);
 		data_lod0.map.paste(min_pos, src_buffer, channels_mask, create_new_blocks);
 	} else {
 		// We won't modify the hashmap so other threads can still perform lookups in different areas
-		RWLockRead rlock(data_lod0.map_lock);
+		ShardedRWLockRead rlock(data_lod0.map_lock);
 		data_lod0.map.paste(min_pos, src_buffer, channels_mask, create_new_blocks);
 	}
 }
 
+void VoxelData::paste_clipboard(
+		Vector3i min_pos,
+		const VoxelClipboard &src,
+		unsigned int channels_mask,
+		bool use_mask,
+		uint8_t mask_channel,
+		uint64_t mask_value,
+		bool create_new_blocks
+) {
+	ZN_PROFILE_SCOPE();
+
+	Lod &data_lod0 = _lods[0];
+
+	const Box3i blocks_box = Box3i(min_pos, src.size).downscaled(data_lod0.map.get_block_size());
+	SpatialLock3D::Write swlock(data_lod0.spatial_lock, BoxBounds3i(blocks_box));
+
+	if (create_new_blocks) {
+		// We will modify the hashmap so no other threads can perform lookups while we do that
+		ShardedRWLockWrite wlock(data_lod0.map_lock);
+		data_lod0.map.paste_clipboard(
+				min_pos, src, channels_mask, use_mask, mask_channel, mask_value, create_new_blocks
+		);
+	} else {
+		// We won't modify the hashmap so other threads can still perform lookups in different areas
+		ShardedRWLockRead rlock(data_lod0.map_lock);
+		data_lod0.map.paste_clipboard(
+				min_pos, src, channels_mask, use_mask, mask_channel, mask_value, create_new_blocks
+		);
+	}
+}
+
 void VoxelData::paste_masked(
 		Vector3i min_pos,
 		const VoxelBuffer &src_buffer,
@@ -384,7 +616,7 @@ void VoxelData::paste_masked(
 
 	if (create_new_blocks) {
 		// We will modify the hashmap so no other threads can perform lookups while we do that
-		RWLockWrite wlock(data_lod0.map_lock);
+		ShardedRWLockWrite wlock(data_lod0.map_lock);
 		data_lod0.map.paste_masked( //
 				min_pos, //
 				src_buffer, //
@@ -399,7 +631,7 @@ void VoxelData::paste_masked(
 		);
 	} else {
 		// We won't modify the hashmap so other threads can still perform lookups in different areas
-		RWLockRead rlock(data_lod0.map_lock);
+		ShardedRWLockRead rlock(data_lod0.map_lock);
 		data_lod0.map.paste_masked( //
 				min_pos, //
 				src_buffer, //
@@ -432,7 +664,7 @@ void VoxelData::paste_masked_writable_list( //
 
 	if (create_new_blocks) {
 		// We will modify the hashmap so no other threads can perform lookups while we do that
-		RWLockWrite wlock(data_lod0.map_lock);
+		ShardedRWLockWrite wlock(data_lod0.map_lock);
 		data_lod0.map.paste_masked( //
 				min_pos, //
 				src_buffer, //
@@ -447,7 +679,7 @@ void VoxelData::paste_masked_writable_list( //
 		);
 	} else {
 		// We won't modify the hashmap so other threads can still perform lookups in different areas
-		RWLockRead rlock(data_lod0.map_lock);
+		ShardedRWLockRead rlock(data_lod0.map_lock);
 		data_lod0.map.paste_masked( //
 				min_pos, //
 				src_buffer, //
@@ -473,7 +705,7 @@ bool VoxelData::is_area_loaded(const Box3i p_voxels_box) const {
 	{
 		SpatialLock3D::Read srlock(data_lod0.spatial_lock, block_box);
 
-		RWLockRead rlock(data_lod0.map_lock);
+		ShardedRWLockRead rlock(data_lod0.map_lock);
 
 		const bool all_blocks_present = block_box.all_cells_match([&data_lod0](Vector3i pos) { //
 			return data_lod0.map.has_block(pos);
@@ -485,122 +717,130 @@ bool VoxelData::is_area_loaded(const Box3i p_voxels_box) const {
 	}
 }
 
-void VoxelData::pre_generate_box(
-		Box3i voxel_box,
-		Span<Lod> lods,
+void VoxelData::find_blocks_to_pre_generate(
+		const Lod &data_lod,
+		Box3i block_box,
+		bool streaming,
+		StdVector<Vector3i> &out_positions
+) {
+	SpatialLock3D::Read srlock(data_lod.spatial_lock, block_box);
+
+	ShardedRWLockRead rlock(data_lod.map_lock);
+
+	block_box.for_each_cell([&data_lod, &out_positions, streaming](Vector3i block_pos) {
+		// We don't check "loading blocks", because this function wants to complete the task right now.
+		const VoxelDataBlock *block = data_lod.map.get_block(block_pos);
+		if (streaming) {
+			// Non-loaded blocks must not be touched because we don't know what's in them.
+			// We can generate caches if loaded ones have no voxel data.
+			if (block != nullptr && !block->has_voxels()) {
+				out_positions.push_back(block_pos);
+			}
+		} else {
+			// We can generate anywhere voxel data is not in memory
+			if (block == nullptr || !block->has_voxels()) {
+				out_positions.push_back(block_pos);
+			}
+		}
+	});
+}
+
+void VoxelData::insert_pre_generated_blocks(
+		Lod &data_lod,
+		Box3i block_box,
+		Span<const PreGeneratedBlock> blocks,
+		StdVector<PreGeneratedBlock> *out_generated_blocks
+) {
+	SpatialLock3D::Write swlock(data_lod.spatial_lock, block_box);
+
+	ShardedRWLockWrite wlock(data_lod.map_lock);
+
+	for (const PreGeneratedBlock &block : blocks) {
+		const VoxelDataBlock *prev_block = data_lod.map.get_block(block.position);
+		if (prev_block != nullptr && prev_block->has_voxels()) {
+			// Sorry, that block has been set in the meantime by another thread.
+			// We'll assume the block we just generated is redundant and discard it.
+			continue;
+		}
+		data_lod.map.set_block_buffer(block.position, block.voxels, true);
+		if (out_generated_blocks != nullptr) {
+			out_generated_blocks->push_back(block);
+		}
+	}
+}
+
+void VoxelData::pre_generate_blocks_at_lod(
+		Box3i block_box,
+		Lod &data_lod,
+		unsigned int lod_index,
 		unsigned int data_block_size,
 		bool streaming,
-		unsigned int lod_count,
 		Ref<VoxelGenerator> generator,
-		VoxelModifierStack &modifiers
+		VoxelModifierStack &modifiers,
+		StdVector<PreGeneratedBlock> *out_generated_blocks
 ) {
-	// This is mostly used by VoxelLodTerrain, in cases non-edited blocks aren't cached.
-
 	ZN_PROFILE_SCOPE();
-	// ERR_FAIL_COND_MSG(_full_load_mode == false, nullptr, "This function can only be used in full load mode");
-
-	struct Task {
-		Vector3i block_pos;
-		uint32_t lod_index;
-		std::shared_ptr<VoxelBuffer> voxels;
-	};
 
 	// TODO Optimize: thread_local pooling?
-	StdVector<Task> todo;
-	// We'll pack tasks per LOD so we'll have less locking to do
-	FixedArray<unsigned int, constants::MAX_LOD> count_per_lod;
-	fill(count_per_lod, 0u);
-
-	// We could have locked all LODs for writing during the whole process.
-	// But in order to reduce the amount of locking and time being locked, we only lock them one by one for reading
-	// first to figure out which blocks we need to generate. Then, we generate voxels separately without holding locks.
-	// Finally, we lock LODs one by one again to insert newly generated blocks.
+	StdVector<Vector3i> positions;
+
+	// We could have locked the LOD for writing during the whole process.
+	// But in order to reduce the amount of locking and time being locked, we only lock it for reading first to figure
+	// out which blocks we need to generate. Then, we generate voxels separately without holding locks.
+	// Finally, we lock again to insert newly generated blocks.
 	// One downside is that the state of some blocks can change in the meantime. If they do, we skip insertion.
 
 	// Find empty slots
-	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
-		const Box3i block_box = voxel_box.downscaled(data_block_size << lod_index);
-
-		// ZN_PRINT_VERBOSE(format("Preloading box {} at lod {} synchronously", block_box, lod_index));
-
-		Lod &data_lod = lods[lod_index];
-		const unsigned int prev_size = todo.size();
-
-		{
-			SpatialLock3D::Read srlock(data_lod.spatial_lock, block_box);
-
-			RWLockRead rlock(data_lod.map_lock);
-
-			block_box.for_each_cell([&data_lod, lod_index, &todo, streaming](Vector3i block_pos) {
-				// We don't check "loading blocks", because this function wants to complete the task right now.
-				const VoxelDataBlock *block = data_lod.map.get_block(block_pos);
-				if (streaming) {
-					// Non-loaded blocks must not be touched because we don't know what's in them.
-					// We can generate caches if loaded ones have no voxel data.
-					if (block != nullptr && !block->has_voxels()) {
-						todo.push_back(Task{ block_pos, lod_index, nullptr });
-					}
-				} else {
-					// We can generate anywhere voxel data is not in memory
-					if (block == nullptr || !block->has_voxels()) {
-						todo.push_back(Task{ block_pos, lod_index, nullptr });
-					}
-				}
-			});
-		}
+	find_blocks_to_pre_generate(data_lod, block_box, streaming, positions);
 
-		count_per_lod[lod_index] = todo.size() - prev_size;
+	if (positions.size() == 0) {
+		return;
 	}
 
 	const Vector3i block_size = Vector3iUtil::create(data_block_size);
 
 	// Generate
-	for (unsigned int i = 0; i < todo.size(); ++i) {
-		Task &task = todo[i];
-		task.voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
-		task.voxels->create(block_size);
+	StdVector<PreGeneratedBlock> todo;
+	todo.reserve(positions.size());
+	for (const Vector3i block_pos : positions) {
+		std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+		voxels->create(block_size);
 		// TODO Format?
 		if (generator.is_valid()) {
 			ZN_PROFILE_SCOPE_NAMED("Generate");
 			VoxelGenerator::VoxelQueryData q{ //
-											  *task.voxels,
-											  task.block_pos * (data_block_size << task.lod_index),
-											  task.lod_index
+											  *voxels,
+											  block_pos * (data_block_size << lod_index),
+											  lod_index
 			};
-			generator->generate_block(q);
-			modifiers.apply(q.voxel_buffer, AABB(q.origin_in_voxels, q.voxel_buffer.get_size() << q.lod));
+			generator->generate_block_with_modifiers(q, modifiers);
 		}
+		todo.push_back(PreGeneratedBlock{ block_pos, voxels });
 	}
 
 	// Populate slots
-	unsigned int task_index = 0;
-	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
-		ZN_ASSERT(lod_index < count_per_lod.size());
-		const unsigned int count = count_per_lod[lod_index];
-
-		if (count > 0) {
-			const unsigned int end_task_index = task_index + count;
-
-			Lod &data_lod = lods[lod_index];
+	insert_pre_generated_blocks(data_lod, block_box, to_span_const(todo), out_generated_blocks);
+}
 
-			const Box3i block_box = voxel_box.downscaled(data_block_size << lod_index);
-			SpatialLock3D::Write swlock(data_lod.spatial_lock, block_box);
+void VoxelData::pre_generate_box(
+		Box3i voxel_box,
+		Span<Lod> lods,
+		unsigned int data_block_size,
+		bool streaming,
+		unsigned int lod_count,
+		Ref<VoxelGenerator> generator,
+		VoxelModifierStack &modifiers
+) {
+	// This is mostly used by VoxelLodTerrain, in cases non-edited blocks aren't cached.
 
-			RWLockWrite wlock(data_lod.map_lock);
+	ZN_PROFILE_SCOPE();
+	// ERR_FAIL_COND_MSG(_full_load_mode == false, nullptr, "This function can only be used in full load mode");
 
-			// Tasks are grouped by LOD so we can get all tasks for a given LOD in contiguous range
-			for (; task_index < end_task_index; ++task_index) {
-				Task &task = todo[task_index];
-				ZN_ASSERT(task.lod_index == lod_index);
-				const VoxelDataBlock *prev_block = data_lod.map.get_block(task.block_pos);
-				if (prev_block != nullptr && prev_block->has_voxels()) {
-					// Sorry, that block has been set in the meantime by another thread.
-					// We'll assume the block we just generated is redundant and discard it.
-					continue;
-				}
-				data_lod.map.set_block_buffer(task.block_pos, task.voxels, true);
-			}
-		}
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		const Box3i block_box = voxel_box.downscaled(data_block_size << lod_index);
+		pre_generate_blocks_at_lod(
+				block_box, lods[lod_index], lod_index, data_block_size, streaming, generator, modifiers, nullptr
+		);
 	}
 }
 
@@ -611,6 +851,43 @@ void VoxelData::pre_generate_box(Box3i voxel_box) {
 	pre_generate_box(voxel_box, to_span(_lods), data_block_size, streaming, lod_count, get_generator(), _modifiers);
 }
 
+void VoxelData::pre_generate_blocks(
+		Box3i block_box,
+		unsigned int lod_index,
+		StdVector<PreGeneratedBlock> *out_generated_blocks
+) {
+	ZN_ASSERT_RETURN(lod_index < get_lod_count());
+	pre_generate_blocks_at_lod(
+			block_box,
+			_lods[lod_index],
+			lod_index,
+			get_block_size(),
+			is_streaming_enabled(),
+			get_generator(),
+			_modifiers,
+			out_generated_blocks
+	);
+}
+
+void VoxelData::get_blocks_to_pre_generate(
+		Box3i block_box,
+		unsigned int lod_index,
+		StdVector<Vector3i> &out_positions
+) const {
+	ZN_ASSERT_RETURN(lod_index < get_lod_count());
+	find_blocks_to_pre_generate(_lods[lod_index], block_box, is_streaming_enabled(), out_positions);
+}
+
+void VoxelData::set_pre_generated_blocks(
+		Box3i block_box,
+		unsigned int lod_index,
+		Span<const PreGeneratedBlock> blocks
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(lod_index < get_lod_count());
+	insert_pre_generated_blocks(_lods[lod_index], block_box, blocks, nullptr);
+}
+
 void VoxelData::clear_cached_blocks_in_voxel_area(Box3i p_voxel_box) {
 	const unsigned int lod_count = get_lod_count();
 
@@ -622,7 +899,7 @@ void VoxelData::clear_cached_blocks_in_voxel_area(Box3i p_voxel_box) {
 		SpatialLock3D::Write swlock(lod.spatial_lock, blocks_box);
 
 		// Locking map for read because we won't add or remove blocks
-		RWLockRead rlock(lod.map_lock);
+		ShardedRWLockRead rlock(lod.map_lock);
 
 		blocks_box.for_each_cell_zxy([&lod](const Vector3i bpos) {
 			VoxelDataBlock *block = lod.map.get_block(bpos);
@@ -649,7 +926,7 @@ void VoxelData::mark_area_modified(
 		SpatialLock3D::Write swlock(data_lod0.spatial_lock, bbox);
 
 		// Locking map for read because we won't add or remove blocks
-		RWLockRead rlock(data_lod0.map_lock);
+		ShardedRWLockRead rlock(data_lod0.map_lock);
 
 		bbox.for_each_cell([&data_lod0, lod0_new_blocks_to_lod, require_lod_updates](Vector3i block_pos_lod0) {
 			VoxelDataBlock *block = data_lod0.map.get_block(block_pos_lod0);
@@ -681,6 +958,71 @@ void VoxelData::mark_area_modified(
 	}
 }
 
+void VoxelData::mark_lod0_blocks_with_missing_mips(StdVector<Vector3i> &out_positions) {
+	ZN_PROFILE_SCOPE();
+	const unsigned int lod_count = get_lod_count();
+	if (lod_count <= 1) {
+		return;
+	}
+
+	StdVector<Vector3i> edited_positions;
+	{
+		const Lod &data_lod0 = _lods[0];
+		ShardedRWLockRead rlock(data_lod0.map_lock);
+		data_lod0.map.for_each_block([&edited_positions](Vector3i bpos, const VoxelDataBlock &block) {
+			if (block.is_edited() && block.has_voxels()) {
+				edited_positions.push_back(bpos);
+			}
+		});
+	}
+
+	// Children of a missing parent are missing mips too. Parents are shared by many children, so each LOD is looked
+	// up once per parent, and one LOD is locked at a time.
+	StdVector<bool> missing_mips;
+	missing_mips.resize(edited_positions.size(), false);
+	StdUnorderedMap<Vector3i, bool> parent_is_missing;
+
+	for (unsigned int lod_index = 1; lod_index < lod_count; ++lod_index) {
+		const Lod &data_lod = _lods[lod_index];
+		ShardedRWLockRead rlock(data_lod.map_lock);
+		parent_is_missing.clear();
+
+		for (unsigned int i = 0; i < edited_positions.size(); ++i) {
+			if (missing_mips[i]) {
+				continue;
+			}
+			const Vector3i parent_pos = edited_positions[i] >> lod_index;
+			auto it = parent_is_missing.find(parent_pos);
+			if (it == parent_is_missing.end()) {
+				const VoxelDataBlock *parent = data_lod.map.get_block(parent_pos);
+				const bool missing = parent == nullptr || !parent->has_voxels();
+				it = parent_is_missing.insert({ parent_pos, missing }).first;
+			}
+			missing_mips[i] = it->second;
+		}
+	}
+
+	Lod &data_lod0 = _lods[0];
+	ShardedRWLockRead rlock(data_lod0.map_lock);
+
+	for (unsigned int i = 0; i < edited_positions.size(); ++i) {
+		if (!missing_mips[i]) {
+			continue;
+		}
+		const Vector3i bpos = edited_positions[i];
+		VoxelDataBlock *block = data_lod0.map.get_block(bpos);
+		if (block == nullptr) {
+			// Unloaded in the meantime
+			continue;
+		}
+		// TODO Threading: this is set without spatial lock, like in `mark_area_modified`
+		if (!block->get_needs_lodding()) {
+			block->set_needs_lodding(true);
+			out_positions.push_back(bpos);
+		}
+	}
+}
+
 bool VoxelData::try_set_block(Vector3i block_position, const VoxelDataBlock &block) {
 	bool inserted = true;
 	try_set_block(block_position, block, [&inserted](VoxelDataBlock &existing, const VoxelDataBlock &incoming) {
@@ -691,7 +1033,7 @@ bool VoxelData::try_set_block(Vector3i block_position, const VoxelDataBlock &blo
 
 bool VoxelData::has_block(Vector3i bpos, unsigned int lod_index) const {
 	const Lod &data_lod = _lods[lod_index];
-	RWLockRead rlock(data_lod.map_lock);
+	ShardedRWLockRead rlock(data_lod.map_lock);
 	return data_lod.map.has_block(bpos);
 }
 
@@ -708,7 +1050,7 @@ bool VoxelData::has_all_blocks_in_area(Box3i data_blocks_box, unsigned int lod_i
 bool VoxelData::has_all_blocks_in_area_unbound(Box3i data_blocks_box, unsigned int lod_index) const {
 	// ZN_PROFILE_SCOPE();
 	const Lod &data_lod = _lods[lod_index];
-	RWLockRead rlock(data_lod.map_lock);
+	ShardedRWLockRead rlock(data_lod.map_lock);
 
 	return data_blocks_box.all_cells_match([&data_lod](Vector3i bpos) { //
 		return data_lod.map.has_block(bpos);
@@ -720,13 +1062,62 @@ unsigned int VoxelData::get_block_count() const {
 	const unsigned int lod_count = get_lod_count();
 	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 		const Lod &lod = _lods[lod_index];
-		RWLockRead rlock(lod.map_lock);
+		ShardedRWLockRead rlock(lod.map_lock);
 		sum += lod.map.get_block_count();
 	}
 	return sum;
 }
 
-void VoxelData::update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector<BlockLocation> *out_updated_blocks) {
+VoxelData::MemoryUsage VoxelData::get_memory_usage() const {
+	MemoryUsage usage;
+	const unsigned int lod_count = get_lod_count();
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		for_each_block_at_lod_r(
+				[&usage](const Vector3i bpos, const VoxelDataBlock &block) {
+					++usage.block_count;
+					if (!block.has_voxels()) {
+						return;
+					}
+					++usage.blocks_with_voxels;
+					if (block.is_voxels_compressed()) {
+						usage.compressed_bytes += block.get_voxels_memory_usage();
+						++usage.compressed_blocks;
+						return;
+					}
+					const VoxelBuffer &voxels = block.get_voxels_const();
+					for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+						usage.channel_bytes[channel_index] += voxels.get_channel_memory_usage(channel_index);
+					}
+				},
+				lod_index
+		);
+	}
+	return usage;
+}
+
+ShardedRWLock::Stats VoxelData::get_map_lock_stats() const {
+	ShardedRWLock::Stats stats;
+	const unsigned int lod_count = get_lod_count();
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		stats.add(_lods[lod_index].map_lock.get_stats());
+	}
+	return stats;
+}
+
+SpatialLock3D::Stats VoxelData::get_spatial_lock_stats() const {
+	SpatialLock3D::Stats stats;
+	const unsigned int lod_count = get_lod_count();
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		stats.add(_lods[lod_index].spatial_lock.get_stats());
+	}
+	return stats;
+}
+
+void VoxelData::update_lods(
+		Span<const Vector3i> modified_lod0_blocks,
+		StdVector<BlockLocation> *out_updated_blocks,
+		const ParallelJobsScheduler &scheduler
+) {
 	ZN_DSTACK();
 	ZN_PROFILE_SCOPE();
 	// Propagates edits performed so far to other LODs.
@@ -753,7 +1144,7 @@ void VoxelData::update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector
 	}
 	{
 		Lod &data_lod0 = _lods[0];
-		RWLockRead rlock(data_lod0.map_lock);
+		ShardedRWLockRead rlock(data_lod0.map_lock);
 
 		StdVector<Vector3i> &blocks_pending_lodding_lod0 = tls_blocks_to_process_per_lod[0];
 
@@ -771,77 +1162,132 @@ void VoxelData::update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector
 
 	const int half_bs = data_block_size >> 1;
 
+	struct L {
+		static std::shared_ptr<VoxelBuffer> generate_voxels(
+				Vector3i dst_bpos,
+				uint8_t dst_lod_index,
+				int data_block_size,
+				int data_block_size_po2,
+				Ref<VoxelGenerator> generator,
+				const VoxelModifierStack &modifiers
+		) {
+			//
+			std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+			voxels->create(Vector3iUtil::create(data_block_size));
+			VoxelGenerator::VoxelQueryData q{ //
+											  *voxels, //
+											  dst_bpos << (dst_lod_index + data_block_size_po2), //
+											  dst_lod_index
+			};
+			if (generator.is_valid()) {
+				ZN_PROFILE_SCOPE_NAMED("Generate");
+				generator->generate_block_with_modifiers(q, modifiers);
+			} else {
+				modifiers.apply(q.voxel_buffer, AABB(q.origin_in_voxels, q.voxel_buffer.get_size() << dst_lod_index));
+			}
+
+			return voxels;
+		}
+	};
+
+	// A parent block to update from some of its 8 children
+	struct ParentUpdate {
+		Vector3i position;
+		// Which children were modified. Bits are ordered like `get_zxy_index` within a 2x2x2 area.
+		uint8_t octants_mask;
+		bool updated;
+		bool needs_lodding;
+	};
+
+	static thread_local StdVector<ParentUpdate> tls_parent_updates;
+
 	// Process downscales upwards in pairs of consecutive LODs.
 	// This ensures we don't process multiple times the same blocks.
-	// Only LOD0 is editable at the moment, so we'll downscale from there
+	// Only LOD0 is editable at the moment, so we'll downscale from there.
+	// Parent blocks of a given LOD are independent of each other, so they are processed in parallel. A LOD depends on
+	// the previous one, so each waits for the previous one to be complete.
 	for (uint8_t dst_lod_index = 1; dst_lod_index < lod_count; ++dst_lod_index) {
 		const uint8_t src_lod_index = dst_lod_index - 1;
 		StdVector<Vector3i> &src_lod_blocks_to_process = tls_blocks_to_process_per_lod[src_lod_index];
 		StdVector<Vector3i> &dst_lod_blocks_to_process = tls_blocks_to_process_per_lod[dst_lod_index];
 
-		// VoxelLodTerrainUpdateData::Lod &dst_lod = state.lods[dst_lod_index];
+		Lod &src_data_lod = _lods[src_lod_index];
+		Lod &dst_data_lod = _lods[dst_lod_index];
+
+		// Group modified blocks by parent
+		StdVector<ParentUpdate> &parent_updates = tls_parent_updates;
+		parent_updates.clear();
+		std::sort(src_lod_blocks_to_process.begin(), src_lod_blocks_to_process.end(), [](Vector3i a, Vector3i b) {
+			const Vector3i pa = a >> 1;
+			const Vector3i pb = b >> 1;
+			if (pa.z != pb.z) {
+				return pa.z < pb.z;
+			}
+			if (pa.x != pb.x) {
+				return pa.x < pb.x;
+			}
+			return pa.y < pb.y;
+		});
+		for (const Vector3i src_bpos : src_lod_blocks_to_process) {
+			const Vector3i dst_bpos = src_bpos >> 1;
+			const Vector3i rel = src_bpos - (dst_bpos << 1);
+			const uint8_t octant_bit = 1 << Vector3iUtil::get_zxy_index(rel, Vector3i(2, 2, 2));
+			if (parent_updates.size() > 0 && parent_updates.back().position == dst_bpos) {
+				parent_updates.back().octants_mask |= octant_bit;
+			} else {
+				parent_updates.push_back(ParentUpdate{ dst_bpos, octant_bit, false, false });
+			}
+		}
 
-		for (unsigned int i = 0; i < src_lod_blocks_to_process.size(); ++i) {
-			Lod &src_data_lod = _lods[src_lod_index];
-			Lod &dst_data_lod = _lods[dst_lod_index];
+		const bool is_last_lod = dst_lod_index == lod_count - 1;
 
-			const Vector3i src_bpos = src_lod_blocks_to_process[i];
-			const Vector3i dst_bpos = src_bpos >> 1;
+		run_parallel_jobs(parent_updates.size(), scheduler, [&](const uint32_t job_index) {
+			ParentUpdate &parent_update = parent_updates[job_index];
+			const Vector3i dst_bpos = parent_update.position;
+			const Vector3i src_bpos0 = dst_bpos << 1;
 
 			// TODO Investigate better locking strategy.
 			// Maps have to be locked after the spatial lock to prevent deadlocks. They have to stay locked because
 			// data blocks are not shared pointers. It would be nice to have the spatial lock after the potential
 			// generation... perhaps data blocks need to be shared instead of voxel buffers
-			SpatialLock3D::Read srlock(src_data_lod.spatial_lock, BoxBounds3i::from_position(src_bpos));
+			SpatialLock3D::Read srlock(
+					src_data_lod.spatial_lock, BoxBounds3i::from_position_size(src_bpos0, Vector3i(2, 2, 2))
+			);
 
 			// TODO Could take long locking this, we may generate things first and assign to the map at the end.
 			// Besides, in per-block streaming mode, it is not needed because blocks are supposed to be present
 			SpatialLock3D::Write swlock(dst_data_lod.spatial_lock, BoxBounds3i::from_position(dst_bpos));
 
-			VoxelDataBlock *src_block;
-			VoxelDataBlock *dst_block;
+			FixedArray<VoxelDataBlock *, 8> src_blocks;
 			{
-				RWLockRead rlock(src_data_lod.map_lock);
-				src_block = src_data_lod.map.get_block(src_bpos);
+				ShardedRWLockRead rlock(src_data_lod.map_lock);
+				for (unsigned int octant_index = 0; octant_index < 8; ++octant_index) {
+					if ((parent_update.octants_mask & (1 << octant_index)) == 0) {
+						src_blocks[octant_index] = nullptr;
+						continue;
+					}
+					const Vector3i rel = Vector3iUtil::from_zxy_index(octant_index, Vector3i(2, 2, 2));
+					VoxelDataBlock *src_block = src_data_lod.map.get_block(src_bpos0 + rel);
+					ZN_ASSERT(src_block != nullptr);
+					src_block->set_needs_lodding(false);
+					// The block should have voxels if it has been edited or mipped.
+					ZN_ASSERT(src_block->has_voxels());
+					if (!src_block->decompress_voxels_if_needed()) {
+						// Skipped. Lodding will happen again the next time the block is edited
+						ZN_PRINT_ERROR("Can't downscale block, its voxels could not be decompressed");
+						src_blocks[octant_index] = nullptr;
+						continue;
+					}
+					src_blocks[octant_index] = src_block;
+				}
 			}
+
+			VoxelDataBlock *dst_block;
 			{
-				RWLockRead rlock(dst_data_lod.map_lock);
+				ShardedRWLockRead rlock(dst_data_lod.map_lock);
 				dst_block = dst_data_lod.map.get_block(dst_bpos);
 			}
 
-			ZN_ASSERT(src_block != nullptr);
-			src_block->set_needs_lodding(false);
-
-			struct L {
-				static std::shared_ptr<VoxelBuffer> generate_voxels(
-						Vector3i dst_bpos,
-						uint8_t dst_lod_index,
-						int data_block_size,
-						int data_block_size_po2,
-						Ref<VoxelGenerator> generator,
-						const VoxelModifierStack &modifiers
-				) {
-					//
-					std::shared_ptr<VoxelBuffer> voxels =
-							make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
-					voxels->create(Vector3iUtil::create(data_block_size));
-					VoxelGenerator::VoxelQueryData q{ //
-													  *voxels, //
-													  dst_bpos << (dst_lod_index + data_block_size_po2), //
-													  dst_lod_index
-					};
-					if (generator.is_valid()) {
-						ZN_PROFILE_SCOPE_NAMED("Generate");
-						generator->generate_block(q);
-					}
-					modifiers.apply(
-							q.voxel_buffer, AABB(q.origin_in_voxels, q.voxel_buffer.get_size() << dst_lod_index)
-					);
-
-					return voxels;
-				}
-			};
-
 			if (dst_block == nullptr) {
 				if (!streaming_enabled) {
 					// TODO Doing this on the main thread can be very demanding and cause a stall.
@@ -851,7 +1297,7 @@ void VoxelData::update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector
 					);
 
 					{
-						RWLockWrite wlock(dst_data_lod.map_lock);
+						ShardedRWLockWrite wlock(dst_data_lod.map_lock);
 						dst_block = dst_data_lod.map.set_block_buffer(dst_bpos, voxels, true);
 					}
 
@@ -861,21 +1307,26 @@ void VoxelData::update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector
 								   dst_bpos,
 								   static_cast<int>(dst_lod_index))
 					);
-					continue;
+					return;
 				}
 			}
 
 			// The block and its lower LOD indices are expected to be available.
 			// Otherwise it means the function was called too late?
 			ZN_ASSERT(dst_block != nullptr);
-			// ZN_ASSERT(dst_block != nullptr);
-			// The block should have voxels if it has been edited or mipped.
-			ZN_ASSERT(src_block->has_voxels());
 
-			if (out_updated_blocks != nullptr) {
-				out_updated_blocks->push_back(BlockLocation{ dst_bpos, dst_lod_index });
+			// Don't overwrite edits that may be in compressed data
+			if (!dst_block->decompress_voxels_if_needed()) {
+				ZN_PRINT_ERROR(
+						format("Can't update block {} on LOD {}, its voxels could not be decompressed",
+							   dst_bpos,
+							   static_cast<int>(dst_lod_index))
+				);
+				return;
 			}
 
+			parent_update.updated = true;
+
 			if (!dst_block->has_voxels()) {
 				// The destination block is loaded but wasn't caching voxels. We'll need to generate them in order to
 				// update it.
@@ -887,25 +1338,41 @@ void VoxelData::update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector
 
 			dst_block->set_modified(true);
 
-			if (dst_lod_index != lod_count - 1 && !dst_block->get_needs_lodding()) {
+			if (!is_last_lod && !dst_block->get_needs_lodding()) {
 				dst_block->set_needs_lodding(true);
-				dst_lod_blocks_to_process.push_back(dst_bpos);
+				parent_update.needs_lodding = true;
 			}
 
-			const Vector3i rel = src_bpos - (dst_bpos << 1);
-
 			// Update lower LOD
 			// This must always be done after an edit before it gets saved, otherwise LODs won't match and it will look
 			// ugly.
+			// Only octants of modified children are recomputed.
 			// TODO Optimization: try to narrow to edited region instead of taking whole block
 			{
 				ZN_PROFILE_SCOPE_NAMED("Downscale");
-				// TODO The destination block should be locked!
-				// Maybe it hasn't been done so far because nothing else accesses higher LOD indices yet, or because we
-				// are holding a lock on the map that contains it
-				src_block->get_voxels().downscale_to(
-						dst_block->get_voxels(), Vector3i(), src_block->get_voxels_const().get_size(), rel * half_bs
-				);
+				VoxelBuffer &dst_voxels = dst_block->get_voxels();
+
+				for (unsigned int octant_index = 0; octant_index < 8; ++octant_index) {
+					const VoxelDataBlock *src_block = src_blocks[octant_index];
+					if (src_block == nullptr) {
+						continue;
+					}
+					const Vector3i rel = Vector3iUtil::from_zxy_index(octant_index, Vector3i(2, 2, 2));
+					const VoxelBuffer &src_voxels = src_block->get_voxels_const();
+					src_voxels.downscale_to(dst_voxels, Vector3i(), src_voxels.get_size(), rel * half_bs);
+				}
+			}
+		});
+
+		for (const ParentUpdate &parent_update : parent_updates) {
+			if (!parent_update.updated) {
+				continue;
+			}
+			if (out_updated_blocks != nullptr) {
+				out_updated_blocks->push_back(BlockLocation{ parent_update.position, dst_lod_index });
+			}
+			if (parent_update.needs_lodding) {
+				dst_lod_blocks_to_process.push_back(parent_update.position);
 			}
 		}
 
@@ -922,7 +1389,7 @@ void VoxelData::update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector
 void VoxelData::unload_blocks(Box3i bbox, unsigned int lod_index, StdVector<BlockToSave> *to_save) {
 	Lod &lod = _lods[lod_index];
 	SpatialLock3D::Write swlock(lod.spatial_lock, bbox);
-	RWLockWrite wlock(lod.map_lock);
+	ShardedRWLockWrite wlock(lod.map_lock);
 	if (to_save == nullptr) {
 		bbox.for_each_cell_zxy([&lod](Vector3i bpos) { //
 			lod.map.remove_block(bpos, VoxelDataMap::NoAction());
@@ -937,7 +1404,7 @@ void VoxelData::unload_blocks(Box3i bbox, unsigned int lod_index, StdVector<Bloc
 // void VoxelData::unload_blocks(Span<const Vector3i> positions, StdVector<BlockToSave> *to_save) {
 // 	// Not efficient! We would have to also lock the spatial lock at every position to unload...
 // 	Lod &lod = _lods[0];
-// 	RWLockWrite wlock(lod.map_lock);
+// 	ShardedRWLockWrite wlock(lod.map_lock);
 // 	if (to_save == nullptr) {
 // 		for (Vector3i bpos : positions) {
 // 			lod.map.remove_block(bpos, VoxelDataMap::NoAction());
@@ -957,7 +1424,7 @@ bool VoxelData::consume_block_modifications(Vector3i bpos, VoxelData::BlockToSav
 	SpatialLock3D::Write swlock(lod.spatial_lock, BoxBounds3i::from_position(bpos));
 
 	// Locking for read because we won't add or remove blocks to the map
-	RWLockRead rlock(lod.map_lock);
+	ShardedRWLockRead rlock(lod.map_lock);
 
 	VoxelDataBlock *block = lod.map.get_block(bpos);
 	if (block == nullptr) {
@@ -965,8 +1432,12 @@ bool VoxelData::consume_block_modifications(Vector3i bpos, VoxelData::BlockToSav
 	}
 	if (block->is_modified()) {
 		if (block->has_voxels()) {
-			out_to_save.voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
-			block->get_voxels_const().copy_to(*out_to_save.voxels, true);
+			// No copy is necessary, voxel data is copy-on-write
+			out_to_save.voxels = block->get_voxels_shared();
+			// Null voxels would remove the block from the stream. It stays modified so saving can be attempted again.
+			ZN_ASSERT_RETURN_V_MSG(
+					out_to_save.voxels != nullptr, false, "Can't save block, its voxels could not be decompressed"
+			);
 		}
 		out_to_save.position = bpos;
 		out_to_save.lod_index = 0;
@@ -976,7 +1447,7 @@ bool VoxelData::consume_block_modifications(Vector3i bpos, VoxelData::BlockToSav
 	return false;
 }
 
-void VoxelData::consume_all_modifications(StdVector<BlockToSave> &to_save, bool with_copy) {
+void VoxelData::consume_all_modifications(StdVector<BlockToSave> &to_save) {
 	const unsigned int lod_count = get_lod_count();
 	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 		Lod &lod = _lods[lod_index];
@@ -986,19 +1457,214 @@ void VoxelData::consume_all_modifications(StdVector<BlockToSave> &to_save, bool
 		SpatialLock3D::Write srlock(lod.spatial_lock, BoxBounds3i::from_everywhere());
 
 		// Locking for read because we won't add or remove blocks to the map
-		RWLockRead rlock(lod.map_lock);
+		ShardedRWLockRead rlock(lod.map_lock);
 
-		lod.map.for_each_block(ScheduleSaveAction{ to_save, uint8_t(lod_index), with_copy });
+		lod.map.for_each_block(ScheduleSaveAction{ to_save, uint8_t(lod_index) });
 	}
 }
 
+unsigned int VoxelData::evict_cached_blocks(StdVector<BlockToSave> *to_save) {
+	ZN_PROFILE_SCOPE();
+
+	// Blocks accessed from now on will be considered more recent than all others
+	const uint32_t access_time = _access_time.fetch_add(1, std::memory_order_relaxed) + 1;
+	const uint32_t previous_time = _eviction_access_time.exchange(access_time, std::memory_order_relaxed);
+
+	const uint64_t budget = _cache_memory_budget;
+	if (budget == 0) {
+		return 0;
+	}
+
+	static thread_local StdVector<EvictionCandidate> tls_candidates;
+	StdVector<EvictionCandidate> &candidates = tls_candidates;
+	candidates.clear();
+
+	uint64_t cache_memory_usage = 0;
+
+	const unsigned int lod_count = get_lod_count();
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		const Lod &lod = _lods[lod_index];
+
+		// Reading channel sizes of blocks requires them to not be modified at the same time
+		SpatialLock3D::Read srlock(lod.spatial_lock, BoxBounds3i::from_everywhere());
+		ShardedRWLockRead rlock(lod.map_lock);
+
+		lod.map.for_each_block(
+				GatherEvictionCandidatesAction{ candidates, cache_memory_usage, lod_index, previous_time }
+		);
+	}
+
+	if (cache_memory_usage <= budget) {
+		_cache_stats.set_memory_usage(cache_memory_usage);
+		return 0;
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const EvictionCandidate &a, const EvictionCandidate &b) {
+		return a.last_access < b.last_access;
+	});
+
+	unsigned int evicted_count = 0;
+
+	for (const EvictionCandidate &candidate : candidates) {
+		if (cache_memory_usage <= budget) {
+			break;
+		}
+
+		Lod &lod = _lods[candidate.lod_index];
+		const BoxBounds3i bbox = BoxBounds3i::from_position(candidate.position);
+
+		// Blocks currently in use are not worth evicting, and we don't want to wait for them
+		if (!lod.spatial_lock.try_lock_write(bbox)) {
+			continue;
+		}
+		{
+			ShardedRWLockRead rlock(lod.map_lock);
+
+			VoxelDataBlock *block = lod.map.get_block(candidate.position);
+			// The block could have changed since we looked it up.
+			// Modified blocks that fail to decompress can't be saved, so they are kept.
+			if (block != nullptr && block->has_voxels() && !block->is_edited() &&
+				block->get_last_access() == candidate.last_access && (to_save != nullptr || !block->is_modified()) &&
+				(!block->is_modified() || block->decompress_voxels_if_needed())) {
+				if (block->is_modified()) {
+					// No copy is necessary because the block will no longer reference the data
+					to_save->push_back(
+							BlockToSave{ block->get_voxels_shared(), candidate.position, candidate.lod_index }
+					);
+					block->set_modified(false);
+				}
+				block->clear_voxels();
+				cache_memory_usage -= candidate.memory_usage;
+				++evicted_count;
+			}
+		}
+		lod.spatial_lock.unlock_write(bbox);
+	}
+
+	_cache_stats.add_evictions(evicted_count);
+	_cache_stats.set_memory_usage(cache_memory_usage);
+
+	return evicted_count;
+}
+
+VoxelData::CompactionResult VoxelData::compact_blocks(
+		unsigned int max_blocks,
+		uint32_t cold_delay_msec,
+		uint64_t now_msec
+) {
+	ZN_PROFILE_SCOPE();
+
+	MutexLock mlock(_compaction_mutex);
+
+	CompactionResult result;
+	const unsigned int lod_count = get_lod_count();
+	const bool palette_compression = _palette_compression_enabled;
+
+	while (result.visited_blocks < max_blocks) {
+		if (_compaction_pending_blocks.size() == 0) {
+			if (_compaction_next_lod_index >= lod_count) {
+				_compaction_next_lod_index = 0;
+				result.pass_completed = true;
+				break;
+			}
+			if (_compaction_next_lod_index == 0) {
+				update_compaction_cold_access_time(cold_delay_msec, now_msec);
+			}
+			const Lod &lod = _lods[_compaction_next_lod_index];
+			ShardedRWLockRead rlock(lod.map_lock);
+			lod.map.for_each_block_position([this](Vector3i bpos) { //
+				_compaction_pending_blocks.push_back(bpos);
+			});
+			++_compaction_next_lod_index;
+			continue;
+		}
+
+		const Vector3i bpos = _compaction_pending_blocks.back();
+		_compaction_pending_blocks.pop_back();
+		++result.visited_blocks;
+
+		Lod &lod = _lods[_compaction_next_lod_index - 1];
+		const BoxBounds3i bbox = BoxBounds3i::from_position(bpos);
+
+		// This is background work, it should not wait for blocks in use
+		if (!lod.spatial_lock.try_lock_write(bbox)) {
+			continue;
+		}
+		{
+			ShardedRWLockRead rlock(lod.map_lock);
+
+			VoxelDataBlock *block = lod.map.get_block(bpos);
+			// Shared data is a snapshot held by a task at the moment. Compressing it would need a copy first, which
+			// is the opposite of what we want.
+			if (block != nullptr && block->has_voxels() && !block->is_voxels_shared() &&
+				!block->is_voxels_compressed()) {
+				VoxelBuffer &voxels = block->get_voxels();
+				const size_t usage_before = voxels.get_channels_memory_usage();
+
+				voxels.compress_uniform_channels();
+				if (palette_compression) {
+					voxels.compress_palette_channels();
+				}
+
+				const size_t usage_after = voxels.get_channels_memory_usage();
+				if (usage_after < usage_before) {
+					result.reclaimed_bytes += usage_before - usage_after;
+					++result.compacted_blocks;
+				}
+
+				if (block->get_last_access() < _compaction_cold_access_time) {
+					const size_t saved_bytes = block->compress_voxels();
+					if (saved_bytes > 0) {
+						result.reclaimed_bytes += saved_bytes;
+						++result.cold_compressed_blocks;
+					}
+				}
+			}
+		}
+		lod.spatial_lock.unlock_write(bbox);
+	}
+
+	return result;
+}
+
+void VoxelData::update_compaction_cold_access_time(uint32_t cold_delay_msec, uint64_t now_msec) {
+	_compaction_cold_access_time = 0;
+
+	if (cold_delay_msec == 0) {
+		_compaction_access_time_samples.clear();
+		return;
+	}
+
+	// Blocks accessed from now on will be considered more recent than this sample
+	const uint32_t access_time = _access_time.fetch_add(1, std::memory_order_relaxed) + 1;
+	_compaction_access_time_samples.push_back(AccessTimeSample{ access_time, now_msec });
+
+	// Find the most recent sample taken at least `cold_delay_msec` ago. Blocks not accessed since are cold.
+	unsigned int cold_sample_count = 0;
+	for (const AccessTimeSample &sample : _compaction_access_time_samples) {
+		if (sample.time_msec + cold_delay_msec > now_msec) {
+			break;
+		}
+		++cold_sample_count;
+	}
+	if (cold_sample_count == 0) {
+		return;
+	}
+	_compaction_cold_access_time = _compaction_access_time_samples[cold_sample_count - 1].access_time;
+	// Older samples won't be needed again
+	_compaction_access_time_samples.erase(
+			_compaction_access_time_samples.begin(),
+			_compaction_access_time_samples.begin() + (cold_sample_count - 1)
+	);
+}
+
 void VoxelData::get_missing_blocks(
 		Span<const Vector3i> block_positions,
 		unsigned int lod_index,
 		StdVector<Vector3i> &out_missing
 ) const {
 	const Lod &lod = _lods[lod_index];
-	RWLockRead rlock(lod.map_lock);
+	ShardedRWLockRead rlock(lod.map_lock);
 	for (const Vector3i &pos : block_positions) {
 		if (!lod.map.has_block(pos)) {
 			out_missing.push_back(pos);
@@ -1012,7 +1678,7 @@ void VoxelData::get_missing_blocks(Box3i p_blocks_box, unsigned int lod_index, S
 	const Box3i bounds_in_blocks = get_bounds().downscaled(get_block_size());
 	const Box3i blocks_box = p_blocks_box.clipped(bounds_in_blocks);
 
-	RWLockRead rlock(data_lod.map_lock);
+	ShardedRWLockRead rlock(data_lod.map_lock);
 
 	blocks_box.for_each_cell_zxy([&data_lod, &out_missing](Vector3i bpos) {
 		if (!data_lod.map.has_block(bpos)) {
@@ -1035,16 +1701,19 @@ void VoxelData::get_blocks_with_voxel_data(
 	// changed by another thread (in theory)
 	SpatialLock3D::Read srlock(data_lod.spatial_lock, p_blocks_box);
 
-	RWLockRead rlock(data_lod.map_lock);
+	ShardedRWLockRead rlock(data_lod.map_lock);
 
 	unsigned int index = 0;
 
-	p_blocks_box.for_each_cell_zxy([&index, &data_lod, &out_blocks](Vector3i data_block_pos) {
+	const uint32_t access_time = _access_time.load(std::memory_order_relaxed);
+
+	p_blocks_box.for_each_cell_zxy([&index, &data_lod, &out_blocks, access_time](Vector3i data_block_pos) {
 		const VoxelDataBlock *nblock = data_lod.map.get_block(data_block_pos);
 		// The block can actually be null on some occasions. Not sure yet if it's that bad
 		// CRASH_COND(nblock == nullptr);
 		if (nblock != nullptr && nblock->has_voxels()) {
 			out_blocks[index] = nblock->get_voxels_shared();
+			nblock->set_last_access(access_time);
 		}
 		++index;
 	});
@@ -1081,7 +1750,7 @@ bool VoxelData::has_blocks_with_voxels_in_area_broad_mip_test(Box3i box_in_voxel
 
 		SpatialLock3D::Read srlock(mip_data_lod.spatial_lock, mip_blocks_box);
 
-		RWLockRead rlock(mip_data_lod.map_lock);
+		ShardedRWLockRead rlock(mip_data_lod.map_lock);
 
 		const VoxelDataMap &map = mip_data_lod.map;
 		const bool no_blocks_found = mip_blocks_box.all_cells_match([&map](const Vector3i pos) {
@@ -1119,7 +1788,7 @@ void VoxelData::view_area(
 	SpatialLock3D::Write swlock(lod.spatial_lock, blocks_box);
 
 	// Locking for read because we don't add or remove blocks.
-	RWLockRead rlock(lod.map_lock);
+	ShardedRWLockRead rlock(lod.map_lock);
 
 	blocks_box.for_each_cell_zxy([&lod, found_blocks_positions, found_blocks, &missing_blocks](Vector3i bpos) {
 		VoxelDataBlock *block = lod.map.get_block(bpos);
@@ -1158,7 +1827,7 @@ void VoxelData::unview_area(
 	SpatialLock3D::Write swlock(lod.spatial_lock, blocks_box);
 
 	// Locking for write because we are potentially going to remove blocks from the map.
-	RWLockWrite wlock(lod.map_lock);
+	ShardedRWLockWrite wlock(lod.map_lock);
 
 	blocks_box.for_each_cell_zxy([&lod, missing_blocks, removed_blocks, to_save, lod_index](Vector3i bpos) {
 		VoxelDataBlock *block = lod.map.get_block(bpos);
@@ -1180,19 +1849,54 @@ void VoxelData::unview_area(
 	});
 }
 
+bool VoxelData::try_attach_generated_block_voxels(
+		Vector3i bpos,
+		unsigned int lod_index,
+		std::shared_ptr<VoxelBuffer> voxels
+) {
+	ZN_ASSERT_RETURN_V(voxels != nullptr, false);
+	ZN_ASSERT_RETURN_V(voxels->get_size() == Vector3iUtil::create(get_block_size()), false);
+
+	if (_palette_compression_enabled) {
+		// Done before locking, the buffer is not accessible from the map yet
+		voxels->compress_palette_channels();
+	}
+
+	Lod &lod = _lods[lod_index];
+
+	// Edits may generate voxels of empty blocks on the fly, so we must not race with them
+	SpatialLock3D::Write swlock(lod.spatial_lock, BoxBounds3i::from_position(bpos));
+	ShardedRWLockWrite wlock(lod.map_lock);
+
+	VoxelDataBlock *block = lod.map.get_block(bpos);
+	if (block == nullptr || block->has_voxels()) {
+		return false;
+	}
+	block->set_voxels(voxels);
+	block->set_last_access(_access_time.load(std::memory_order_relaxed));
+	return true;
+}
+
 std::shared_ptr<VoxelBuffer> VoxelData::try_get_block_voxels(Vector3i bpos) {
+	bool edited;
+	return try_get_block_voxels(bpos, edited);
+}
+
+std::shared_ptr<VoxelBuffer> VoxelData::try_get_block_voxels(Vector3i bpos, bool &out_edited) {
 	Lod &lod = _lods[0];
 
 	// The caller must lock the spatial lock and keep it locked until done accessing blocks
 	// SpatialLock3D::Read srlock(lod.spatial_lock, BoxBounds3i::from_position(bpos));
 
-	RWLockRead rlock(lod.map_lock);
+	ShardedRWLockRead rlock(lod.map_lock);
 
 	VoxelDataBlock *block = lod.map.get_block(bpos);
 	if (block == nullptr) {
 		return nullptr;
 	}
 	if (block->has_voxels()) {
+		block->set_last_access(_access_time.load(std::memory_order_relaxed));
+		out_edited = block->is_edited();
 		return block->get_voxels_shared();
 	}
 	return nullptr;
@@ -1204,13 +1908,14 @@ void VoxelData::set_voxel_metadata(Vector3i pos, Variant meta) {
 	const Vector3i bpos = lod.map.voxel_to_block(pos);
 
 	SpatialLock3D::Write swlock(lod.spatial_lock, BoxBounds3i::from_position(bpos));
-	RWLockRead rlock(lod.map_lock);
+	ShardedRWLockRead rlock(lod.map_lock);
 
 	VoxelDataBlock *block = lod.map.get_block(bpos);
 	ZN_ASSERT_RETURN_MSG(block != nullptr, "Area not editable");
 	// TODO Ability to have metadata in areas where voxels have not been allocated?
 	// Otherwise we have to generate the block, because that's where it is stored at the moment.
 	ZN_ASSERT_RETURN_MSG(block->has_voxels(), "Area not cached");
+	ZN_ASSERT_RETURN_MSG(block->decompress_voxels_if_needed(), "Block voxels could not be decompressed");
 	VoxelMetadata *meta_storage = block->get_voxels().get_or_create_voxel_metadata(lod.map.to_local(pos));
 	ZN_ASSERT_RETURN(meta_storage != nullptr);
 	godot::set_as_variant(*meta_storage, meta);
@@ -1222,11 +1927,12 @@ Variant VoxelData::get_voxel_metadata(Vector3i pos) {
 	const Vector3i bpos = lod.map.voxel_to_block(pos);
 
 	SpatialLock3D::Read srlock(lod.spatial_lock, BoxBounds3i::from_position(bpos));
-	RWLockRead rlock(lod.map_lock);
+	ShardedRWLockRead rlock(lod.map_lock);
 
 	VoxelDataBlock *block = lod.map.get_block(bpos);
 	ZN_ASSERT_RETURN_V_MSG(block != nullptr, Variant(), "Area not editable");
 	ZN_ASSERT_RETURN_V_MSG(block->has_voxels(), Variant(), "Area not cached");
+	ZN_ASSERT_RETURN_V_MSG(block->decompress_voxels_if_needed(), Variant(), "Block voxels could not be decompressed");
 	const VoxelMetadata *meta = block->get_voxels_const().get_voxel_metadata(lod.map.to_local(pos));
 	if (meta == nullptr) {
 		return Variant();
@@ -4,13 +4,19 @@
 #include "../generators/voxel_generator.h"
 #include "../modifiers/voxel_modifier_stack.h"
 #include "../streams/voxel_stream.h"
+#include "../util/cache_stats.h"
+#include "../util/tasks/parallel_jobs.h"
 #include "../util/thread/mutex.h"
+#include "../util/thread/sharded_rw_lock.h"
 #include "../util/thread/spatial_lock_3d.h"
 #include "voxel_data_map.h"
 
+#include <atomic>
+
 namespace zylann::voxel {
 
 class VoxelDataGrid;
+struct VoxelClipboard;
 
 // Generic storage containing everything needed to access voxel data.
 // Contains edits, procedural sources and file stream so voxels not physically stored in memory can be obtained.
@@ -89,10 +95,32 @@ public:
 
 	void set_full_load_completed(bool complete);
 
+	void set_palette_compression_enabled(bool enabled);
+
+	inline bool is_palette_compression_enabled() const {
+		return _palette_compression_enabled;
+	}
+
+	// Sets how many bytes can be used by voxel data that is only a cache of generators, before the least recently used
+	// blocks get their cache cleared. 0 means no limit. This is enforced when calling `evict_cached_blocks`.
+	void set_cache_memory_budget(uint64_t bytes);
+
+	inline uint64_t get_cache_memory_budget() const {
+		return _cache_memory_budget;
+	}
+
 	inline bool is_full_load_completed() const {
 		return _full_load_completed;
 	}
 
+	// How much of the stream was loaded so far when streaming is disabled, from 0 to 1. Estimated from parts the stream
+	// was split into, so it doesn't advance smoothly.
+	void set_full_load_progress(float progress);
+
+	inline float get_full_load_progress() const {
+		return _full_load_progress;
+	}
+
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Voxel queries.
 	// When not specified, the used LOD index is 0.
@@ -103,6 +131,72 @@ public:
 	float get_voxel_f(Vector3i pos, unsigned int channel_index) const;
 	bool try_set_voxel_f(real_t value, Vector3i pos, unsigned int channel_index);
 
+	// Read access to the block containing a voxel, found the same way as `get_voxel` does. The block stays locked for
+	// reading until the access is released or destroyed, so queries reading many voxels of the same block, like
+	// raycasts, don't have to look it up and lock it for each voxel. Voxels must not be modified while holding it.
+	class BlockReadAccess {
+	public:
+		enum State {
+			// Voxels of the block are unknown, reading them returns the default value
+			STATE_NOT_LOADED,
+			// The block has no voxels in memory, reading them uses the generator and modifiers
+			STATE_GENERATED,
+			// Voxels of the block are in memory
+			STATE_STORED
+		};
+
+		BlockReadAccess() {}
+		BlockReadAccess(const BlockReadAccess &) = delete;
+		BlockReadAccess &operator=(const BlockReadAccess &) = delete;
+
+		~BlockReadAccess() {
+			release();
+		}
+
+		void release();
+
+		inline bool is_valid() const {
+			return _data != nullptr;
+		}
+
+		inline State get_state() const {
+			return _state;
+		}
+
+		inline unsigned int get_lod_index() const {
+			return _lod_index;
+		}
+
+		// Area covered by the block, in voxels of LOD0. May extend beyond the bounds of the volume.
+		inline Box3i get_voxel_box() const {
+			return _voxel_box;
+		}
+
+		// Only available in `STATE_STORED`
+		inline const VoxelBuffer *get_voxels() const {
+			return _voxels.get();
+		}
+
+		// Same as `VoxelData::get_voxel`, for a position within the box of the block
+		VoxelSingleValue get_voxel(Vector3i pos, unsigned int channel_index, VoxelSingleValue defval) const;
+
+	private:
+		friend class VoxelData;
+
+		const VoxelData *_data = nullptr;
+		State _state = STATE_NOT_LOADED;
+		unsigned int _lod_index = 0;
+		bool _locked = false;
+		Vector3i _block_position;
+		Box3i _voxel_box;
+		Box3i _bounds_in_voxels;
+		std::shared_ptr<VoxelBuffer> _voxels;
+		Ref<VoxelGenerator> _generator;
+	};
+
+	// Releases `access` if it was in use, then acquires the block containing `pos`
+	void acquire_block_read_access(Vector3i pos, BlockReadAccess &access) const;
+
 	// Copies voxel data in a box from LOD0.
 	// `channels_mask` bits tell which channel is read.
 	void copy(Vector3i min_pos, VoxelBuffer &dst_buffer, unsigned int channels_mask) const;
@@ -133,6 +227,21 @@ public:
 			bool create_new_blocks //
 	);
 
+	// Copies voxel data in a box from LOD0, keeping the layout and compression of blocks.
+	void copy_to_clipboard(Box3i box, VoxelClipboard &dst, unsigned int channels_mask) const;
+
+	// Pastes a clipboard at LOD0, with its origin at `min_pos`.
+	// If `use_mask` is true, will only write voxels of the clipboard that are not equal to `mask_value`.
+	void paste_clipboard(
+			Vector3i min_pos,
+			const VoxelClipboard &src,
+			unsigned int channels_mask,
+			bool use_mask,
+			uint8_t mask_channel,
+			uint64_t mask_value,
+			bool create_new_blocks
+	);
+
 	// Tests if the given area is loaded at LOD0.
 	// This is necessary for editing destructively.
 	bool is_area_loaded(const Box3i p_voxels_box) const;
@@ -145,6 +254,25 @@ public:
 	// WARNING: this does not check if the area is editable.
 	void pre_generate_box(Box3i voxel_box);
 
+	// Same as `pre_generate_box`, for a box in block coordinates at a single LOD. This allows to split large boxes
+	// into several tasks. Blocks that got generated are appended to `out_generated_blocks` if not null.
+	struct PreGeneratedBlock {
+		Vector3i position;
+		// Shared with the block in the map, so the spatial lock must be held to access it
+		std::shared_ptr<VoxelBuffer> voxels;
+	};
+	void pre_generate_blocks(
+			Box3i block_box,
+			unsigned int lod_index,
+			StdVector<PreGeneratedBlock> *out_generated_blocks
+	);
+
+	// Split version of `pre_generate_blocks`, for when voxels are generated by other means, like on the GPU.
+	// First gets positions of blocks `pre_generate_blocks` would generate, in block coordinates.
+	void get_blocks_to_pre_generate(Box3i block_box, unsigned int lod_index, StdVector<Vector3i> &out_positions) const;
+	// Then inserts the generated blocks. Blocks that got voxels in the meantime are left untouched.
+	void set_pre_generated_blocks(Box3i block_box, unsigned int lod_index, Span<const PreGeneratedBlock> blocks);
+
 	// Clears voxel data from blocks that are pure results of generators and modifiers.
 	// WARNING: this does not check if the area is editable.
 	// TODO Rename `clear_cached_voxel_data_in_area`
@@ -155,6 +283,12 @@ public:
 	// Optionally, returns a list of affected block positions which did not require LOD updates before.
 	void mark_area_modified(Box3i p_voxel_box, StdVector<Vector3i> *lod0_new_blocks_to_lod, bool require_lod_updates);
 
+	// Finds edited blocks of LOD0 of which a parent is missing in other LODs, or has no voxels. Mips are saved along
+	// with LOD0, so this only happens with streams written without them (by other tools, or interrupted saves), which
+	// would otherwise show generated voxels at these LODs. Found blocks are marked as requiring LOD updates, and
+	// appended to `out_positions` if they didn't require them already.
+	void mark_lod0_blocks_with_missing_mips(StdVector<Vector3i> &out_positions);
+
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Block-aware API
 
@@ -168,21 +302,28 @@ public:
 	// `void action_when_exists(VoxelDataBlock &existing_block, const VoxelDataBlock &incoming_block)`
 	template <typename F>
 	bool try_set_block(Vector3i block_position, const VoxelDataBlock &block, F action_when_exists) {
-		Lod &lod = _lods[block.get_lod_index()];
 #ifdef DEBUG_ENABLED
 		if (block.has_voxels()) {
 			ZN_ASSERT(block.get_voxels_const().get_size() == Vector3iUtil::create(get_block_size()));
 		}
 #endif
-		RWLockWrite wlock(lod.map_lock);
-		VoxelDataBlock *existing_block = lod.map.get_block(block_position);
-		if (existing_block != nullptr) {
-			action_when_exists(*existing_block, block);
-			return false;
-		} else {
-			lod.map.set_block(block_position, block);
-			return true;
+		if (_palette_compression_enabled && block.has_voxels()) {
+			// Done before locking, incoming blocks are not accessible from the map yet
+			std::shared_ptr<VoxelBuffer> voxels = block.get_voxels_shared();
+			if (voxels.use_count() > 2) {
+				// Voxels are still referenced outside of the block (by the caller, a stream cache or a task...), they
+				// must not change while being read. Store a compressed copy instead.
+				std::shared_ptr<VoxelBuffer> compressed_voxels =
+						make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+				voxels->copy_to(*compressed_voxels, true);
+				compressed_voxels->compress_palette_channels();
+				VoxelDataBlock compressed_block(block);
+				compressed_block.set_voxels(compressed_voxels);
+				return try_set_block_no_compression(block_position, compressed_block, action_when_exists);
+			}
+			voxels->compress_palette_channels();
 		}
+		return try_set_block_no_compression(block_position, block, action_when_exists);
 	}
 
 	template <typename F>
@@ -190,7 +331,7 @@ public:
 		const unsigned int lod_count = get_lod_count();
 		for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 			const Lod &lod = _lods[lod_index];
-			RWLockRead rlock(lod.map_lock);
+			ShardedRWLockRead rlock(lod.map_lock);
 			lod.map.for_each_block_position(op);
 		}
 	}
@@ -202,7 +343,7 @@ public:
 	// 	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 	// 		const Lod &lod = _lods[lod_index];
 	// 		SpatialLock3D::Read srlock(lod.spatial_lock, BoxBounds3i::from_everywhere());
-	// 		RWLockRead rlock(lod.map_lock);
+	// 		ShardedRWLockRead rlock(lod.map_lock);
 	// 		lod.map.for_each_block(op);
 	// 	}
 	// }
@@ -212,7 +353,7 @@ public:
 	void for_each_block_at_lod_r(F op, unsigned int lod_index) const {
 		const Lod &lod = _lods[lod_index];
 		SpatialLock3D::Read srlock(lod.spatial_lock, BoxBounds3i::from_everywhere());
-		RWLockRead rlock(lod.map_lock);
+		ShardedRWLockRead rlock(lod.map_lock);
 		lod.map.for_each_block(op);
 	}
 
@@ -231,6 +372,39 @@ public:
 	// Gets the total amount of allocated blocks. This includes blocks having no voxel data.
 	unsigned int get_block_count() const;
 
+	struct MemoryUsage {
+		// Bytes allocated by each channel of voxel buffers
+		FixedArray<uint64_t, VoxelBuffer::MAX_CHANNELS> channel_bytes;
+		unsigned int block_count = 0;
+		unsigned int blocks_with_voxels = 0;
+		// Voxels of blocks kept compressed because they were not accessed in a while. They are not included in
+		// `channel_bytes`.
+		uint64_t compressed_bytes = 0;
+		unsigned int compressed_blocks = 0;
+
+		MemoryUsage() {
+			fill(channel_bytes, uint64_t(0));
+		}
+
+		void add(const MemoryUsage &other) {
+			for (unsigned int i = 0; i < channel_bytes.size(); ++i) {
+				channel_bytes[i] += other.channel_bytes[i];
+			}
+			block_count += other.block_count;
+			blocks_with_voxels += other.blocks_with_voxels;
+			compressed_bytes += other.compressed_bytes;
+			compressed_blocks += other.compressed_blocks;
+		}
+	};
+
+	// Gets how much memory voxels of all LODs use. This visits all blocks, so it is meant for debugging and profiling.
+	MemoryUsage get_memory_usage() const;
+
+	// Gets how block maps of all LODs were locked so far, for profiling.
+	ShardedRWLock::Stats get_map_lock_stats() const;
+	// Gets how areas of all LODs were locked so far, for profiling.
+	SpatialLock3D::Stats get_spatial_lock_stats() const;
+
 	struct BlockLocation {
 		Vector3i position;
 		uint32_t lod_index;
@@ -238,12 +412,19 @@ public:
 
 	// Updates the LODs of all blocks at given positions, and resets their flags telling that they need LOD updates.
 	// Optionally, returns a list of affected block positions.
-	void update_lods(Span<const Vector3i> modified_lod0_blocks, StdVector<BlockLocation> *out_updated_blocks);
+	// If a scheduler is provided, parent blocks of each LOD are updated in parallel with the help of a thread pool.
+	void update_lods(
+			Span<const Vector3i> modified_lod0_blocks,
+			StdVector<BlockLocation> *out_updated_blocks,
+			const ParallelJobsScheduler &scheduler = ParallelJobsScheduler()
+	);
 
 	struct BlockToSave {
 		std::shared_ptr<VoxelBuffer> voxels;
 		Vector3i position;
 		uint32_t lod_index;
+		// Optional, blocks with a higher value get written before other saves
+		uint8_t save_priority = 0;
 	};
 
 	// Unloads data blocks in the specified area. If some of them were modified and `to_save` is not null, their data
@@ -254,13 +435,40 @@ public:
 	// their data will be returned for the caller to save.
 	// void unload_blocks(Span<const Vector3i> positions, StdVector<BlockToSave> *to_save);
 
-	// If the block at the specified LOD0 position exists and is modified, marks it as non-modified and returns a copy
-	// of its data to save. Returns true if there is something to save.
+	// If the block at the specified LOD0 position exists and is modified, marks it as non-modified and returns its data
+	// to save. Returns true if there is something to save.
 	bool consume_block_modifications(Vector3i bpos, BlockToSave &out_to_save);
 
-	// Marks all modified blocks as unmodified and returns their data to save. if `with_copy` is true, the returned data
-	// will be a copy, otherwise it will reference voxel data. Prefer using references when about to quit for example.
-	void consume_all_modifications(StdVector<BlockToSave> &to_save, bool with_copy);
+	// Marks all modified blocks as unmodified and returns their data to save.
+	// Returned data references voxels of blocks instead of copying them. Voxel data is copy-on-write, so blocks edited
+	// before saving completes get cloned at that point, and memory used by a save only grows with edits made during it.
+	void consume_all_modifications(StdVector<BlockToSave> &to_save);
+
+	// If voxel data caching generator output uses more memory than the budget, clears it from least recently accessed
+	// blocks until it fits. Blocks accessed since the previous call are not evicted, so this should be called
+	// periodically. Edited blocks are never evicted. If a cached block has unsaved modifications, its data is returned
+	// in `to_save` before being cleared, or it is not evicted if `to_save` is null.
+	// Returns how many blocks were evicted.
+	unsigned int evict_cached_blocks(StdVector<BlockToSave> *to_save);
+
+	struct CompactionResult {
+		unsigned int visited_blocks = 0;
+		unsigned int compacted_blocks = 0;
+		// Blocks that got compressed because they were not accessed in a while. Included in `reclaimed_bytes`.
+		unsigned int cold_compressed_blocks = 0;
+		uint64_t reclaimed_bytes = 0;
+		// True when the call reached the end of all LODs. The next call starts over.
+		bool pass_completed = false;
+	};
+
+	// Re-compresses voxel data of up to `max_blocks` loaded blocks, so memory taken by channels that became uniform
+	// (or fit a palette, if enabled) after edits returns to the memory pool. Each call resumes where the previous one
+	// stopped, so all blocks get visited over multiple calls. Blocks that are locked or referenced by tasks at the
+	// time are skipped until the next pass.
+	// If `cold_delay_msec` is not 0, blocks that were not accessed for at least that long are also compressed in
+	// memory (see `VoxelDataBlock::compress_voxels`), and decompressed when accessed again. Access times are measured
+	// at the start of each pass, so the delay is rounded up to passes. `now_msec` is the current time.
+	CompactionResult compact_blocks(unsigned int max_blocks, uint32_t cold_delay_msec = 0, uint64_t now_msec = 0);
 
 	// Gets missing blocks out of the given block positions.
 	// WARNING: positions outside bounds will be considered missing too.
@@ -301,10 +509,17 @@ public:
 
 	bool has_blocks_with_voxels_in_area_broad_mip_test(Box3i box_in_voxels) const;
 
+	// Attaches generated voxels to a block that is present in the map but has no voxels yet (not loaded from a stream,
+	// not edited). This allows tasks that generated the area anyways to cache it without going through a separate
+	// request. Returns false if the block doesn't exist or already has voxels, in which case nothing is changed.
+	bool try_attach_generated_block_voxels(Vector3i bpos, unsigned int lod_index, std::shared_ptr<VoxelBuffer> voxels);
+
 	// Access voxels of a specific block.
 	// WARNING: you must hold the spatial lock before calling this, and until you're done working on such blocks.
 	// Can return null.
 	std::shared_ptr<VoxelBuffer> try_get_block_voxels(Vector3i bpos);
+	// Also tells if the block was edited. If not, its voxels are what the generator produces.
+	std::shared_ptr<VoxelBuffer> try_get_block_voxels(Vector3i bpos, bool &out_edited);
 
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Reference-counted API (LOD0 only)
@@ -347,6 +562,24 @@ public:
 private:
 	void reset_maps_no_settings_lock();
 
+	template <typename F>
+	bool try_set_block_no_compression(Vector3i block_position, const VoxelDataBlock &block, F action_when_exists) {
+		Lod &lod = _lods[block.get_lod_index()];
+		block.set_last_access(_access_time.load(std::memory_order_relaxed));
+		ShardedRWLockWrite wlock(lod.map_lock);
+		VoxelDataBlock *existing_block = lod.map.get_block(block_position);
+		if (existing_block != nullptr) {
+			action_when_exists(*existing_block, block);
+			return false;
+		} else {
+			lod.map.set_block(block_position, block);
+			return true;
+		}
+	}
+
+	// Called at the start of compaction passes, with `_compaction_mutex` locked
+	void update_compaction_cold_access_time(uint32_t cold_delay_msec, uint64_t now_msec);
+
 	struct Lod {
 		// Storage for edited and cached voxels.
 		VoxelDataMap map;
@@ -361,12 +594,39 @@ private:
 		// This lock should be locked in write mode only when the map gets modified (adding or removing blocks).
 		// Otherwise it may be locked in read mode.
 		// It is possible to unlock it after we are done querying the map.
-		mutable RWLock map_lock;
+		// Lookups are far more frequent than modifications and happen from many threads at once, so the lock counts
+		// readers per thread slot to avoid contention on a single reader count.
+		mutable ShardedRWLock map_lock;
 		// This should be used when reading or writing voxels/metadata in blocks. It uses block coordinates as
 		// spatial unit.
 		mutable SpatialLock3D spatial_lock;
 	};
 
+	static void pre_generate_blocks_at_lod(
+			Box3i block_box,
+			Lod &data_lod,
+			unsigned int lod_index,
+			unsigned int data_block_size,
+			bool streaming,
+			Ref<VoxelGenerator> generator,
+			VoxelModifierStack &modifiers,
+			StdVector<PreGeneratedBlock> *out_generated_blocks
+	);
+
+	static void find_blocks_to_pre_generate(
+			const Lod &data_lod,
+			Box3i block_box,
+			bool streaming,
+			StdVector<Vector3i> &out_positions
+	);
+
+	static void insert_pre_generated_blocks(
+			Lod &data_lod,
+			Box3i block_box,
+			Span<const PreGeneratedBlock> blocks,
+			StdVector<PreGeneratedBlock> *out_generated_blocks
+	);
+
 	static void pre_generate_box(
 			Box3i voxel_box,
 			Span<Lod> lods,
@@ -382,7 +642,7 @@ private:
 			Vector3i block_pos,
 			bool &out_generate
 	) {
-		RWLockRead rlock(data_lod.map_lock);
+		ShardedRWLockRead rlock(data_lod.map_lock);
 		const VoxelDataBlock *block = data_lod.map.get_block(block_pos);
 		if (block == nullptr) {
 			// The block is not there, so unless streaming is not enabled, we don't know if it has edits or not.
@@ -399,6 +659,7 @@ private:
 			out_generate = true;
 			return nullptr;
 		}
+		// Null without requesting generation if voxels failed to decompress, since they may contain edits
 		return block->get_voxels_shared();
 	}
 
@@ -407,8 +668,8 @@ private:
 	// A fixed array is used because max lod count is small, and it doesn't require locking by threads.
 	// Note that these LODs do not automatically update, it is up to users of the class to trigger it.
 	//
-	// TODO Optimize: (low priority) this takes more than 5Kb in the object, even when not using LODs.
-	// Each LOD contains an RWLock, which is 242 bytes, so *24 it adds up quickly.
+	// TODO Optimize: (low priority) this takes more than 24Kb in the object, even when not using LODs.
+	// Each LOD contains a ShardedRWLock, which is about 1Kb, so *24 it adds up quickly.
 	// A solution would be to allocate LODs dynamically in the constructor (the potential presence of LODs doesn't
 	// need to change after being constructed, there is no use case for that so far).
 	FixedArray<Lod, constants::MAX_LOD> _lods;
@@ -430,6 +691,36 @@ private:
 	// This is because *everything* will load, we can't tell in advance what is loaded and what isn't by looking at
 	// individual blocks.
 	bool _full_load_completed = false;
+	std::atomic<float> _full_load_progress = { 0.f };
+
+	// If enabled, blocks set with `try_set_block` get their channels palette-compressed when it saves memory.
+	// Edits going through raw voxel access will decompress them again.
+	bool _palette_compression_enabled = false;
+
+	// Bytes of cached voxel data above which `evict_cached_blocks` clears least recently accessed blocks. 0 means no
+	// limit.
+	uint64_t _cache_memory_budget = 0;
+
+	// Increases every time `evict_cached_blocks` runs. Accessed blocks record it, so we can find which ones haven't
+	// been used in a while.
+	std::atomic_uint32_t _access_time = { 0 };
+	// Access time right after the previous call to `evict_cached_blocks`. Other functions may advance access time too.
+	std::atomic_uint32_t _eviction_access_time = { 0 };
+	// Reports evictions and memory used by cached voxel data, as measured by `evict_cached_blocks`
+	CacheStats _cache_stats{ "voxel_data_cached_blocks" };
+
+	// Progress of `compact_blocks`. Positions are snapshotted one LOD at a time, and consumed from the back.
+	StdVector<Vector3i> _compaction_pending_blocks;
+	unsigned int _compaction_next_lod_index = 0;
+	// Blocks last accessed before this access time are compressed by the current compaction pass. 0 means none.
+	uint32_t _compaction_cold_access_time = 0;
+	struct AccessTimeSample {
+		uint32_t access_time;
+		uint64_t time_msec;
+	};
+	// Taken at the start of compaction passes, oldest first, to tell which access time was current some time ago
+	StdVector<AccessTimeSample> _compaction_access_time_samples;
+	Mutex _compaction_mutex;
 
 	// Procedural generation stack
 	VoxelModifierStack _modifiers;
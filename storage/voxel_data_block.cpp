@@ -1,9 +1,17 @@
 #include "voxel_data_block.h"
+#include "../streams/voxel_block_serializer.h"
 #include "../util/io/log.h"
+#include "../util/profiling.h"
 #include "../util/string/format.h"
+#include "voxel_buffer.h"
 
 namespace zylann::voxel {
 
+namespace {
+std::atomic_uint64_t g_voxels_compression_count = { 0 };
+std::atomic_uint64_t g_voxels_decompression_count = { 0 };
+} // namespace
+
 void VoxelDataBlock::set_modified(bool modified) {
 	// #ifdef TOOLS_ENABLED
 	// 	if (_modified == false && modified) {
@@ -13,4 +21,78 @@ void VoxelDataBlock::set_modified(bool modified) {
 	_modified = modified;
 }
 
+void VoxelDataBlock::make_voxels_unique() {
+	ZN_PROFILE_SCOPE();
+	std::shared_ptr<VoxelBuffer> copy = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+	_voxels->copy_to(*copy, true);
+	_voxels = std::move(copy);
+}
+
+size_t VoxelDataBlock::compress_voxels() {
+	ZN_PROFILE_SCOPE();
+	// Shared data is a snapshot held by a task at the moment, the block wouldn't be the only one to keep it alive
+	if (_voxels == nullptr || is_voxels_compressed() || _voxels.use_count() > 1) {
+		return 0;
+	}
+	const size_t usage_before = _voxels->get_channels_memory_usage();
+	if (usage_before == 0) {
+		// Only uniform channels
+		return 0;
+	}
+	BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(*_voxels);
+	ZN_ASSERT_RETURN_V(res.success, 0);
+	if (res.data.size() >= usage_before) {
+		return 0;
+	}
+	// Copied, because results are reused by the next serialization in this thread
+	_compressed_voxels = res.data;
+	_voxels = nullptr;
+	_voxels_compressed.store(true, std::memory_order_release);
+	++g_voxels_compression_count;
+	return usage_before - _compressed_voxels.size();
+}
+
+bool VoxelDataBlock::decompress_voxels() const {
+	ZN_PROFILE_SCOPE();
+	ShortLockScope slock(_decompression_lock);
+	// Another thread could have done it while we were waiting
+	if (!_voxels_compressed.load(std::memory_order_relaxed)) {
+		return true;
+	}
+	std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+	if (!BlockSerializer::decompress_and_deserialize(to_span_const(_compressed_voxels), *voxels)) {
+		// Compressed data stays, so edits it contains are not replaced by an empty buffer. The next access tries again.
+		ZN_PRINT_ERROR("Failed to decompress voxels of a block");
+		return false;
+	}
+	_voxels = std::move(voxels);
+	StdVector<uint8_t>().swap(_compressed_voxels);
+	++g_voxels_decompression_count;
+	// Readers checking the flag without locking may access voxels from now on
+	_voxels_compressed.store(false, std::memory_order_release);
+	return true;
+}
+
+size_t VoxelDataBlock::get_voxels_memory_usage() const {
+	if (is_voxels_compressed()) {
+		// Another reader could be decompressing them
+		ShortLockScope slock(_decompression_lock);
+		if (is_voxels_compressed()) {
+			return _compressed_voxels.size();
+		}
+	}
+	if (_voxels == nullptr) {
+		return 0;
+	}
+	return _voxels->get_channels_memory_usage();
+}
+
+uint64_t VoxelDataBlock::get_total_voxels_compressions() {
+	return g_voxels_compression_count;
+}
+
+uint64_t VoxelDataBlock::get_total_voxels_decompressions() {
+	return g_voxels_decompression_count;
+}
+
 } // namespace zylann::voxel
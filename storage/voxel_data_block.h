@@ -1,7 +1,10 @@
 #ifndef VOXEL_DATA_BLOCK_H
 #define VOXEL_DATA_BLOCK_H
 
+#include "../util/containers/std_vector.h"
 #include "../util/ref_count.h"
+#include "../util/thread/short_lock.h"
+#include <atomic>
 #include <memory>
 
 namespace zylann::voxel {
@@ -12,6 +15,8 @@ class VoxelBuffer;
 // Voxel data can be present, or not. If not present, it means we know the block contains no edits, and voxels can be
 // obtained by querying generators.
 // Voxel data can also be present as a cache of generators, for cheaper repeated queries.
+// Voxel data that wasn't accessed in a while can be kept compressed in memory (see `compress_voxels`), and gets
+// decompressed transparently the next time it is accessed.
 class VoxelDataBlock {
 public:
 	RefCount viewers;
@@ -26,26 +31,35 @@ public:
 	VoxelDataBlock(VoxelDataBlock &&src) :
 			viewers(src.viewers),
 			_voxels(std::move(src._voxels)),
+			_compressed_voxels(std::move(src._compressed_voxels)),
+			_voxels_compressed(src._voxels_compressed.exchange(false, std::memory_order_relaxed)),
 			_lod_index(src._lod_index),
 			_needs_lodding(src._needs_lodding),
 			_modified(src._modified),
-			_edited(src._edited) {}
+			_edited(src._edited),
+			_last_access(src.get_last_access()) {}
 
 	VoxelDataBlock(const VoxelDataBlock &src) :
 			viewers(src.viewers),
 			_voxels(src._voxels),
+			_compressed_voxels(src._compressed_voxels),
+			_voxels_compressed(src.is_voxels_compressed()),
 			_lod_index(src._lod_index),
 			_needs_lodding(src._needs_lodding),
 			_modified(src._modified),
-			_edited(src._edited) {}
+			_edited(src._edited),
+			_last_access(src.get_last_access()) {}
 
 	VoxelDataBlock &operator=(VoxelDataBlock &&src) {
 		viewers = src.viewers;
 		_lod_index = src._lod_index;
 		_voxels = std::move(src._voxels);
+		_compressed_voxels = std::move(src._compressed_voxels);
+		_voxels_compressed.store(src._voxels_compressed.exchange(false, std::memory_order_relaxed));
 		_needs_lodding = src._needs_lodding;
 		_modified = src._modified;
 		_edited = src._edited;
+		set_last_access(src.get_last_access());
 		return *this;
 	}
 
@@ -53,9 +67,12 @@ public:
 		viewers = src.viewers;
 		_lod_index = src._lod_index;
 		_voxels = src._voxels;
+		_compressed_voxels = src._compressed_voxels;
+		_voxels_compressed.store(src.is_voxels_compressed());
 		_needs_lodding = src._needs_lodding;
 		_modified = src._modified;
 		_edited = src._edited;
+		set_last_access(src.get_last_access());
 		return *this;
 	}
 
@@ -67,43 +84,88 @@ public:
 	// If false, it means the block has no edits and does not contain cached generated data,
 	// so we may fallback on procedural generators on the fly or request a cache.
 	inline bool has_voxels() const {
-		return _voxels != nullptr;
+		// The flag is checked first, because another reader could be decompressing voxels at the same time
+		return is_voxels_compressed() || _voxels != nullptr;
 	}
 
-	// Get voxels, expecting them to be present
+	// Get voxels for modification, expecting them to be present and decompressable (see
+	// `decompress_voxels_if_needed`).
+	// Voxel data is copy-on-write: if other owners still reference the buffer (such as meshing or saving tasks), it
+	// gets cloned first so they keep an unchanged snapshot. This must be called with the block's area spatially
+	// locked for writing, and the returned reference must not be held after the lock is released.
 	VoxelBuffer &get_voxels() {
+		decompress_voxels_if_needed();
 #ifdef DEBUG_ENABLED
 		ZN_ASSERT(_voxels != nullptr);
 #endif
+		if (_voxels.use_count() > 1) {
+			make_voxels_unique();
+		}
 		return *_voxels;
 	}
 
-	// Get voxels, expecting them to be present
+	// Get voxels, expecting them to be present and decompressable
 	const VoxelBuffer &get_voxels_const() const {
+		decompress_voxels_if_needed();
 #ifdef DEBUG_ENABLED
 		ZN_ASSERT(_voxels != nullptr);
 #endif
 		return *_voxels;
 	}
 
-	// Get voxels, expecting them to be present
+	// Get voxels, expecting them to be present. Returns null if they failed to decompress.
 	std::shared_ptr<VoxelBuffer> get_voxels_shared() const {
+		decompress_voxels_if_needed();
 #ifdef DEBUG_ENABLED
-		ZN_ASSERT(_voxels != nullptr);
+		ZN_ASSERT(_voxels != nullptr || is_voxels_compressed());
 #endif
 		return _voxels;
 	}
 
+	// Tests if voxel data is also referenced outside of the block, in which case modifying it would make a copy
+	inline bool is_voxels_shared() const {
+		return _voxels.use_count() > 1;
+	}
+
 	void set_voxels(const std::shared_ptr<VoxelBuffer> &buffer) {
 		ZN_ASSERT_RETURN(buffer != nullptr);
 		_voxels = buffer;
+		clear_compressed_voxels();
 	}
 
 	void clear_voxels() {
 		_voxels = nullptr;
+		clear_compressed_voxels();
 		_edited = false;
 	}
 
+	// Tells if voxels are currently stored compressed. Accessing them will decompress them.
+	inline bool is_voxels_compressed() const {
+		return _voxels_compressed.load(std::memory_order_acquire);
+	}
+
+	// Decompresses voxels if they are stored compressed. Returns false if that failed, in which case compressed data
+	// is kept and voxels can't be accessed. The block must then be skipped rather than considered empty, since it may
+	// contain edits. Other accessors of voxels expect this to have succeeded.
+	inline bool decompress_voxels_if_needed() const {
+		if (is_voxels_compressed()) {
+			return decompress_voxels();
+		}
+		return true;
+	}
+
+	// Compresses voxels in place, to save memory while they are not used. Must be called with the block's area
+	// spatially locked for writing. Voxels are left as they are if they are absent, shared, or if compressing them
+	// would not save memory. Returns how many bytes were saved.
+	size_t compress_voxels();
+
+	// Gets how much memory voxel channels of the block take, in compressed form if they are. Does not decompress them.
+	size_t get_voxels_memory_usage() const;
+
+	// Totals over all blocks since the engine started, for profiling
+	static uint64_t get_total_voxels_compressions();
+	static uint64_t get_total_voxels_decompressions();
+
 	void set_modified(bool modified);
 
 	inline bool is_modified() const {
@@ -126,9 +188,39 @@ public:
 		return _edited;
 	}
 
+	// Records when the block was last used, in an arbitrary increasing unit (see `VoxelData`). This is used to find
+	// least recently used blocks. It can be updated while the block is only accessed for reading.
+	inline void set_last_access(uint32_t time) const {
+		_last_access.store(time, std::memory_order_relaxed);
+	}
+
+	inline uint32_t get_last_access() const {
+		return _last_access.load(std::memory_order_relaxed);
+	}
+
 private:
-	// Voxel data. If null, it means the data may be obtained with procedural generation.
-	std::shared_ptr<VoxelBuffer> _voxels;
+	void make_voxels_unique();
+
+	bool decompress_voxels() const;
+
+	inline void clear_compressed_voxels() {
+		if (is_voxels_compressed()) {
+			// Releases memory, which `clear()` would not do
+			StdVector<uint8_t>().swap(_compressed_voxels);
+			_voxels_compressed.store(false, std::memory_order_release);
+		}
+	}
+
+	// Voxel data. If null and not compressed, it means the data may be obtained with procedural generation.
+	// Mutable because reading compressed voxels decompresses them.
+	mutable std::shared_ptr<VoxelBuffer> _voxels;
+
+	// Voxel data serialized and compressed with `BlockSerializer`, when `_voxels_compressed` is true.
+	mutable StdVector<uint8_t> _compressed_voxels;
+	mutable std::atomic_bool _voxels_compressed = { false };
+	// Taken when decompressing, since that can happen while the block is only accessed for reading, by more than one
+	// thread at once
+	mutable ShortLock _decompression_lock;
 
 	// TODO Storing lod index here might not be necessary, it is known since we have to get the map first.
 	// For now it can remain here since in practice it doesn't cost space, due to other stored flags and alignment.
@@ -145,6 +237,8 @@ private:
 	// Once it becomes `true`, it usually never comes back to `false` unless reverted.
 	bool _edited = false;
 
+	mutable std::atomic_uint32_t _last_access = { 0 };
+
 	// TODO Optimization: design a proper way to implement client-side caching for multiplayer
 	//
 	// Represents how many times the block was edited.
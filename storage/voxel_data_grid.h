@@ -2,7 +2,7 @@
 #define VOXEL_DATA_GRID_H
 
 #include "../storage/voxel_buffer.h"
-#include "../util/thread/rw_lock.h"
+#include "../util/thread/sharded_rw_lock.h"
 #include "../util/thread/spatial_lock_3d.h"
 #include "voxel_data_map.h"
 
@@ -24,7 +24,7 @@ public:
 	// TODO This API is a bit risky, it should just be encapsulated into VoxelData maybe
 	inline void reference_area_block_coords(
 			const VoxelDataMap &map,
-			RWLock &map_lock,
+			ShardedRWLock &map_lock,
 			const Box3i blocks_box,
 			// Will be referenced for operations, assuming its lifetime is equal or greater than the grid
 			SpatialLock3D &spatial_lock
@@ -39,12 +39,13 @@ public:
 		spatial_lock.lock_read(blocks_box);
 
 		{
-			RWLockRead rlock(map_lock);
+			ShardedRWLockRead rlock(map_lock);
 			blocks_box.for_each_cell_zxy([&map, this](const Vector3i pos) {
 				const VoxelDataBlock *block = map.get_block(pos);
 				// TODO Might need to invoke the generator at some level for present blocks without voxels,
 				// or make sure all blocks contain voxel data
 				if (block != nullptr && block->has_voxels()) {
+					// Null if they failed to decompress, so the block is skipped
 					set_block(pos, block->get_voxels_shared());
 				} else {
 					set_block(pos, nullptr);
@@ -55,6 +56,9 @@ public:
 		spatial_lock.unlock_read(blocks_box);
 
 		_spatial_lock = &spatial_lock;
+		// Kept so blocks can be fetched again when locking for writing
+		_map = &map;
+		_map_lock = &map_lock;
 	}
 
 	inline bool has_any_block() const {
@@ -107,6 +111,7 @@ public:
 		ZN_ASSERT(!_locked);
 		_spatial_lock->lock_write(BoxBounds3i::from_position_size(_offset_in_blocks, _size_in_blocks));
 		_locked = true;
+		reference_blocks_for_writing();
 	}
 
 	inline void unlock_write() {
@@ -192,6 +197,8 @@ public:
 		_blocks.clear();
 		_size_in_blocks = Vector3i();
 		_spatial_lock = nullptr;
+		_map = nullptr;
+		_map_lock = nullptr;
 	}
 
 	inline VoxelBuffer *get_block_no_lock(Vector3i position) {
@@ -247,6 +254,31 @@ private:
 		}
 	}
 
+	// Voxel data in maps is copy-on-write, and blocks we referenced earlier may be snapshots held by other tasks.
+	// Writing into them directly would modify data those tasks expect to be unchanged, so instead we get voxels from
+	// the map again, which clones them if necessary. Must be called while the area is spatially locked for writing.
+	inline void reference_blocks_for_writing() {
+		ZN_PROFILE_SCOPE();
+		if (_map == nullptr) {
+			return;
+		}
+		// Blocks are modified but the map itself isn't, and the spatial lock prevents other accesses to these blocks
+		VoxelDataMap &map = const_cast<VoxelDataMap &>(*_map);
+		ShardedRWLockRead rlock(*_map_lock);
+		const Box3i blocks_box(_offset_in_blocks, _size_in_blocks);
+		blocks_box.for_each_cell_zxy([this, &map](const Vector3i pos) {
+			const unsigned int index = Vector3iUtil::get_zxy_index(pos - _offset_in_blocks, _size_in_blocks);
+			std::shared_ptr<VoxelBuffer> &ref = _blocks[index];
+			// Release our own reference first so it doesn't count as another owner
+			ref.reset();
+			VoxelDataBlock *block = map.get_block(pos);
+			if (block != nullptr && block->has_voxels() && block->decompress_voxels_if_needed()) {
+				block->get_voxels();
+				ref = block->get_voxels_shared();
+			}
+		});
+	}
+
 	inline void create(Vector3i size, unsigned int block_size) {
 		ZN_PROFILE_SCOPE();
 		_blocks.clear();
@@ -299,6 +331,9 @@ private:
 	// For protecting voxel data against multithreaded accesses. Not owned. Lifetime must be guaranteed by the user, for
 	// example by having a std::shared_ptr<VoxelData> holding the spatial lock.
 	SpatialLock3D *_spatial_lock = nullptr;
+	// Map the blocks were referenced from. Not owned, same lifetime requirements as the spatial lock.
+	const VoxelDataMap *_map = nullptr;
+	ShardedRWLock *_map_lock = nullptr;
 	mutable bool _locked = false;
 };
 
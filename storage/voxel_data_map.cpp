@@ -6,6 +6,7 @@
 #include "../util/macros.h"
 #include "../util/memory/memory.h"
 #include "../util/string/format.h"
+#include "voxel_clipboard.h"
 
 #include <limits>
 
@@ -50,7 +51,7 @@ unsigned int VoxelDataMap::get_lod_index() const {
 int VoxelDataMap::get_voxel(Vector3i pos, unsigned int c) const {
 	Vector3i bpos = voxel_to_block(pos);
 	const VoxelDataBlock *block = get_block(bpos);
-	if (block == nullptr || !block->has_voxels()) {
+	if (block == nullptr || !block->has_voxels() || !block->decompress_voxels_if_needed()) {
 		return VoxelBuffer::get_default_value_static(c);
 	}
 	return block->get_voxels_const().get_voxel(to_local(pos), c);
@@ -79,6 +80,7 @@ VoxelDataBlock *VoxelDataMap::get_or_create_block_at_voxel_pos(Vector3i pos) {
 
 void VoxelDataMap::set_voxel(int value, Vector3i pos, unsigned int c) {
 	VoxelDataBlock *block = get_or_create_block_at_voxel_pos(pos);
+	ZN_ASSERT_RETURN_MSG(block->decompress_voxels_if_needed(), "Block voxels could not be decompressed");
 	// TODO If it turns out to be a problem, use CoW
 	VoxelBuffer &voxels = block->get_voxels();
 	voxels.set_voxel(value, to_local(pos), c);
@@ -88,7 +90,7 @@ float VoxelDataMap::get_voxel_f(Vector3i pos, unsigned int c) const {
 	Vector3i bpos = voxel_to_block(pos);
 	const VoxelDataBlock *block = get_block(bpos);
 	// TODO The generator needs to be invoked if the block has no voxels
-	if (block == nullptr || !block->has_voxels()) {
+	if (block == nullptr || !block->has_voxels() || !block->decompress_voxels_if_needed()) {
 		// TODO Not valid for a float return value
 		return VoxelBuffer::get_default_value_static(c);
 	}
@@ -101,24 +103,17 @@ void VoxelDataMap::set_voxel_f(real_t value, Vector3i pos, unsigned int c) {
 	Vector3i lpos = to_local(pos);
 	// TODO In this situation, the generator must be invoked to fill the block
 	ZN_ASSERT_RETURN_MSG(block->has_voxels(), "Block not cached");
+	ZN_ASSERT_RETURN_MSG(block->decompress_voxels_if_needed(), "Block voxels could not be decompressed");
 	VoxelBuffer &voxels = block->get_voxels();
 	voxels.set_voxel_f(value, lpos.x, lpos.y, lpos.z, c);
 }
 
 VoxelDataBlock *VoxelDataMap::get_block(Vector3i bpos) {
-	auto it = _blocks_map.find(bpos);
-	if (it != _blocks_map.end()) {
-		return &it->second;
-	}
-	return nullptr;
+	return _blocks_map.find(bpos);
 }
 
 const VoxelDataBlock *VoxelDataMap::get_block(Vector3i bpos) const {
-	auto it = _blocks_map.find(bpos);
-	if (it != _blocks_map.end()) {
-		return &it->second;
-	}
-	return nullptr;
+	return _blocks_map.find(bpos);
 }
 
 VoxelDataBlock *VoxelDataMap::set_block_buffer(Vector3i bpos, std::shared_ptr<VoxelBuffer> &buffer, bool overwrite) {
@@ -173,7 +168,7 @@ VoxelDataBlock *VoxelDataMap::set_empty_block(Vector3i bpos, bool overwrite) {
 }
 
 bool VoxelDataMap::has_block(Vector3i pos) const {
-	return _blocks_map.find(pos) != _blocks_map.end();
+	return _blocks_map.has(pos);
 }
 
 bool VoxelDataMap::is_block_surrounded(Vector3i pos) const {
@@ -213,7 +208,7 @@ void VoxelDataMap::copy(
 				const VoxelDataBlock *block = get_block(bpos);
 				const Vector3i src_block_origin = block_to_voxel(bpos);
 
-				if (block != nullptr && block->has_voxels()) {
+				if (block != nullptr && block->has_voxels() && block->decompress_voxels_if_needed()) {
 					const VoxelBuffer &src_buffer = block->get_voxels_const();
 
 					for (const uint8_t channel : channels) {
@@ -294,7 +289,7 @@ void VoxelDataMap::paste_masked( //
 			VoxelBuffer::mask_to_channels_list(channels_mask);
 
 	DynamicBitset bitarray;
-	if (dst_writable_values.size() == 1) {
+	if (dst_writable_values.size() > 1) {
 		ZN_ASSERT_RETURN(indices_to_bitarray_u16(dst_writable_values, bitarray));
 	}
 
@@ -316,6 +311,8 @@ void VoxelDataMap::paste_masked( //
 
 				// TODO In this situation, the generator has to be invoked to fill the blanks
 				ZN_ASSERT_CONTINUE_MSG(block->has_voxels(), "Area not cached");
+				// Don't overwrite edits that may be in compressed data
+				ZN_ASSERT_CONTINUE_MSG(block->decompress_voxels_if_needed(), "Block voxels could not be decompressed");
 
 				const Vector3i dst_block_origin = block_to_voxel(bpos);
 
@@ -371,6 +368,155 @@ void VoxelDataMap::paste_masked( //
 	}
 }
 
+void VoxelDataMap::copy_to_clipboard(
+		Box3i box,
+		VoxelClipboard &dst,
+		unsigned int channels_mask,
+		void *callback_data,
+		void (*gen_func)(void *, VoxelBuffer &, Vector3i)
+) const {
+	ZN_PROFILE_SCOPE();
+	dst.clear();
+	ZN_ASSERT_RETURN_MSG(Vector3iUtil::get_volume_u64(box.size) > 0, "The area to copy is empty");
+
+	dst.size = box.size;
+	dst.channels_mask = channels_mask;
+
+	const Vector3i block_size_v(get_block_size(), get_block_size(), get_block_size());
+	const Box3i blocks_box = box.downscaled(get_block_size());
+	dst.chunks.reserve(Vector3iUtil::get_volume_u64(blocks_box.size));
+
+	const SmallVector<uint8_t, VoxelBuffer::MAX_CHANNELS> channels = VoxelBuffer::mask_to_channels_list(channels_mask);
+
+	blocks_box.for_each_cell_zxy([this, &box, &dst, &channels, block_size_v, callback_data, gen_func](Vector3i bpos) {
+		const Vector3i block_origin = block_to_voxel(bpos);
+		const Box3i chunk_box = Box3i(block_origin, block_size_v).clipped(box);
+
+		dst.chunks.push_back(VoxelClipboard::Chunk());
+		VoxelClipboard::Chunk &chunk = dst.chunks.back();
+		chunk.position = chunk_box.position - box.position;
+		VoxelBuffer &chunk_voxels = chunk.voxels;
+		chunk_voxels.create(chunk_box.size);
+
+		const VoxelDataBlock *block = get_block(bpos);
+
+		if (block != nullptr && block->has_voxels() && block->decompress_voxels_if_needed()) {
+			const VoxelBuffer &src_buffer = block->get_voxels_const();
+			const Box3i src_box(chunk_box.position - block_origin, chunk_box.size);
+
+			if (chunk_box.size == src_buffer.get_size()) {
+				// Whole block, copy channels as they are
+				for (const uint8_t channel : channels) {
+					chunk_voxels.set_channel_depth(channel, src_buffer.get_channel_depth(channel));
+					chunk_voxels.copy_channel_from(src_buffer, channel);
+				}
+			} else {
+				for (const uint8_t channel : channels) {
+					chunk_voxels.set_channel_depth(channel, src_buffer.get_channel_depth(channel));
+					chunk_voxels.copy_channel_from(
+							src_buffer, src_box.position, src_box.position + src_box.size, Vector3i(), channel
+					);
+				}
+				chunk_voxels.compress_uniform_channels();
+			}
+
+			chunk_voxels.copy_voxel_metadata_in_area(src_buffer, src_box, Vector3i());
+
+		} else if (gen_func != nullptr) {
+			gen_func(callback_data, chunk_voxels, chunk_box.position);
+			chunk_voxels.compress_uniform_channels();
+		}
+		// Otherwise inexistent blocks default to "empty space", like in `copy`
+	});
+}
+
+void VoxelDataMap::paste_clipboard(
+		Vector3i min_pos,
+		const VoxelClipboard &src,
+		unsigned int channels_mask,
+		bool use_src_mask,
+		uint8_t src_mask_channel,
+		uint64_t src_mask_value,
+		bool create_new_blocks
+) {
+	ZN_PROFILE_SCOPE();
+
+	const SmallVector<uint8_t, VoxelBuffer::MAX_CHANNELS> channel_indices =
+			VoxelBuffer::mask_to_channels_list(channels_mask);
+
+	const bool with_metadata = true;
+
+	for (const VoxelClipboard::Chunk &chunk : src.chunks) {
+		const VoxelBuffer &chunk_voxels = chunk.voxels;
+
+		bool chunk_masked = use_src_mask;
+		if (use_src_mask && chunk_voxels.is_uniform(src_mask_channel)) {
+			// The mask is the same for the whole chunk, so there is no need to test every voxel
+			if (chunk_voxels.get_voxel(Vector3i(), src_mask_channel) == src_mask_value) {
+				continue;
+			}
+			chunk_masked = false;
+		}
+
+		const Box3i chunk_box(min_pos + chunk.position, chunk_voxels.get_size());
+		const Box3i blocks_box = chunk_box.downscaled(get_block_size());
+
+		blocks_box.for_each_cell_zxy([this,
+									  &chunk_box,
+									  &chunk_voxels,
+									  &channel_indices,
+									  chunk_masked,
+									  src_mask_channel,
+									  src_mask_value,
+									  with_metadata,
+									  create_new_blocks](Vector3i bpos) {
+			VoxelDataBlock *block = get_block(bpos);
+
+			if (block == nullptr) {
+				if (create_new_blocks) {
+					block = create_default_block(bpos);
+				} else {
+					return;
+				}
+			}
+
+			// TODO In this situation, the generator has to be invoked to fill the blanks
+			ZN_ASSERT_RETURN_MSG(block->has_voxels(), "Area not cached");
+			// Don't overwrite edits that may be in compressed data
+			ZN_ASSERT_RETURN_MSG(block->decompress_voxels_if_needed(), "Block voxels could not be decompressed");
+
+			VoxelBuffer &dst_buffer = block->get_voxels();
+			const Vector3i dst_base_pos = chunk_box.position - block_to_voxel(bpos);
+
+			if (chunk_masked) {
+				zylann::voxel::paste_src_masked(
+						to_span(channel_indices),
+						chunk_voxels,
+						src_mask_channel,
+						src_mask_value,
+						dst_buffer,
+						dst_base_pos,
+						with_metadata
+				);
+
+			} else if (dst_base_pos == Vector3i() && chunk_voxels.get_size() == dst_buffer.get_size()) {
+				// The chunk lines up with the block and covers it entirely, copy channels as they are
+				for (const uint8_t channel : channel_indices) {
+					dst_buffer.copy_channel_from(chunk_voxels, channel);
+				}
+				if (with_metadata) {
+					const Box3i box(Vector3i(), dst_buffer.get_size());
+					dst_buffer.clear_voxel_metadata_in_area(box);
+					dst_buffer.copy_voxel_metadata_in_area(chunk_voxels, box, Vector3i());
+				}
+
+			} else {
+				zylann::voxel::paste(to_span(channel_indices), chunk_voxels, dst_buffer, dst_base_pos, with_metadata);
+			}
+		});
+	}
+}
+
 void VoxelDataMap::clear() {
 	_blocks_map.clear();
 }
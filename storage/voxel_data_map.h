@@ -4,7 +4,7 @@
 #include "../constants/voxel_constants.h"
 #include "../util/containers/fixed_array.h"
 #include "../util/containers/span.h"
-#include "../util/containers/std_unordered_map.h"
+#include "../util/containers/vector3i_hash_map.h"
 #include "../util/math/box3i.h"
 #include "../util/profiling.h"
 #include "voxel_buffer.h" // Used in template methods
@@ -13,6 +13,7 @@
 namespace zylann::voxel {
 
 class VoxelGenerator;
+struct VoxelClipboard;
 
 // Sparse voxel storage by means of cubic chunks, within a constant LOD.
 //
@@ -100,6 +101,29 @@ public:
 			bool create_new_blocks //
 	);
 
+	// Same as `copy`, but keeps the layout and compression of blocks instead of copying to a single buffer.
+	// Voxel metadata is copied too.
+	void copy_to_clipboard(
+			Box3i box,
+			VoxelClipboard &dst,
+			unsigned int channels_mask,
+			void *callback_data,
+			void (*gen_func)(void *, VoxelBuffer &, Vector3i)
+	) const;
+
+	// Pastes a clipboard with its origin at `min_pos`. Chunks lining up with blocks and covering them entirely are
+	// copied whole, keeping their compression. If `use_src_mask` is true, voxels of the clipboard equal to
+	// `src_mask_value` in `src_mask_channel` are not pasted.
+	void paste_clipboard(
+			Vector3i min_pos,
+			const VoxelClipboard &src,
+			unsigned int channels_mask,
+			bool use_src_mask,
+			uint8_t src_mask_channel,
+			uint64_t src_mask_value,
+			bool create_new_blocks
+	);
+
 	// Moves the given buffer into a block of the map. The buffer is referenced, no copy is made.
 	VoxelDataBlock *set_block_buffer(Vector3i bpos, std::shared_ptr<VoxelBuffer> &buffer, bool overwrite);
 	VoxelDataBlock *set_empty_block(Vector3i bpos, bool overwrite);
@@ -111,10 +135,10 @@ public:
 
 	template <typename Action_T>
 	void remove_block(Vector3i bpos, Action_T pre_delete) {
-		auto it = _blocks_map.find(bpos);
-		if (it != _blocks_map.end()) {
-			pre_delete(it->second);
-			_blocks_map.erase(it);
+		VoxelDataBlock *block = _blocks_map.find(bpos);
+		if (block != nullptr) {
+			pre_delete(*block);
+			_blocks_map.erase(bpos);
 		}
 	}
 
@@ -131,25 +155,19 @@ public:
 	// op(Vector3i bpos)
 	template <typename Op_T>
 	inline void for_each_block_position(Op_T op) const {
-		for (auto it = _blocks_map.begin(); it != _blocks_map.end(); ++it) {
-			op(it->first);
-		}
+		_blocks_map.for_each([&op](const Vector3i bpos, const VoxelDataBlock &block) { op(bpos); });
 	}
 
 	// op(Vector3i bpos, VoxelDataBlock &block)
 	template <typename Op_T>
 	inline void for_each_block(Op_T op) {
-		for (auto it = _blocks_map.begin(); it != _blocks_map.end(); ++it) {
-			op(it->first, it->second);
-		}
+		_blocks_map.for_each(op);
 	}
 
 	// void op(Vector3i bpos, const VoxelDataBlock &block)
 	template <typename Op_T>
 	inline void for_each_block(Op_T op) const {
-		for (auto it = _blocks_map.begin(); it != _blocks_map.end(); ++it) {
-			op(it->first, it->second);
-		}
+		_blocks_map.for_each(op);
 	}
 
 	bool is_area_fully_loaded(const Box3i voxels_box) const;
@@ -171,6 +189,8 @@ public:
 				block = create_default_block(block_pos);
 				gen_func(block->get_voxels(), block_pos << get_block_size_pow2());
 			}
+			// Don't overwrite edits that may be in compressed data
+			ZN_ASSERT_RETURN_MSG(block->decompress_voxels_if_needed(), "Block voxels could not be decompressed");
 			const Vector3i block_origin = block_to_voxel(block_pos);
 			Box3i local_box(voxel_box.position - block_origin, voxel_box.size);
 			local_box.clip(Box3i(Vector3i(), block_size));
@@ -195,6 +215,9 @@ public:
 						block = create_default_block(block_pos);
 						gen_func(block->get_voxels(), block_pos << get_block_size_pow2());
 					}
+					ZN_ASSERT_RETURN_MSG(
+							block->decompress_voxels_if_needed(), "Block voxels could not be decompressed"
+					);
 					const Vector3i block_origin = block_to_voxel(block_pos);
 					Box3i local_box(voxel_box.position - block_origin, voxel_box.size);
 					local_box.clip(Box3i(Vector3i(), block_size));
@@ -216,9 +239,10 @@ private:
 	// Blocks stored with a spatial hash in all 3D directions.
 	// Before I used Godot 3's HashMap with RELATIONSHIP = 2 because that delivers better performance compared to
 	// defaults, but it sometimes has very long stalls on removal, which std::unordered_map doesn't seem to have
-	// (not as badly). Also overall performance is slightly better.
-	// Note: pointers to elements remain valid when inserting or removing others (only iterators may be invalidated)
-	StdUnorderedMap<Vector3i, VoxelDataBlock> _blocks_map;
+	// (not as badly). Then std::unordered_map was used, which allocates a node per block. Now an open-addressing map
+	// is used, which keeps lookups local in memory and has no stall on removal.
+	// Note: pointers to elements remain valid when inserting or removing others
+	Vector3iHashMap<VoxelDataBlock> _blocks_map;
 
 	// This was a possible optimization in a single-threaded scenario, but it's not in multithread.
 	// We want to be able to do shared read-accesses but this is a mutable variable.
@@ -5,6 +5,8 @@
 #include "../util/string/format.h"
 #include "../util/string/std_string.h"
 
+#include <cstring>
+
 namespace zylann::voxel {
 
 namespace {
@@ -69,8 +71,8 @@ void VoxelMemoryPool::debug_print_used_blocks(unsigned int max_count) {
 	};
 
 	unsigned int count = 0;
-	for (unsigned int pool_index = 0; pool_index < _pot_pools.size(); ++pool_index) {
-		const Pool &pool = _pot_pools[pool_index];
+	for (unsigned int pool_index = 0; pool_index < _pools.size(); ++pool_index) {
+		const Pool &pool = _pools[pool_index];
 		L::debug_print_used_blocks(pool.debug_used_blocks, count, max_count, get_size_from_pool_index(pool_index));
 	}
 	L::debug_print_used_blocks(_debug_nonpooled_used_blocks, count, max_count, 0);
@@ -106,7 +108,7 @@ uint8_t *VoxelMemoryPool::allocate(size_t size) {
 	ZN_ASSERT_RETURN_V(size != 0, nullptr);
 
 	uint8_t *block = nullptr;
-	// Not calculating `pot` immediately because the function we use to calculate it uses 32 bits,
+	// Not calculating `pool_index` immediately because the function we use to calculate it uses 32 bits,
 	// while `size_t` can be larger than that.
 	if (size > get_highest_supported_size()) {
 		// Sorry, memory is not pooled past this size
@@ -118,30 +120,43 @@ uint8_t *VoxelMemoryPool::allocate(size_t size) {
 		}
 #endif
 	} else {
-		const unsigned int pot = get_pool_index_from_size(size);
-		Pool &pool = _pot_pools[pot];
-		pool.mutex.lock();
-		if (pool.blocks.size() > 0) {
-			block = pool.blocks.back();
-			pool.blocks.pop_back();
-			pool.mutex.unlock();
+		const unsigned int pool_index = get_pool_index_from_size(size);
+		Pool &pool = _pools[pool_index];
+		const unsigned int cache_capacity = get_thread_cache_capacity(pool_index);
+		ThreadCache *cache = cache_capacity > 0 ? get_thread_cache() : nullptr;
+
+		if (cache != nullptr) {
+			ThreadCache::Magazine &magazine = cache->magazines[pool_index];
+			if (magazine.count == 0) {
+				refill_magazine(pool_index, magazine, cache_capacity);
+			}
+			if (magazine.count > 0) {
+				--magazine.count;
+				block = magazine.blocks[magazine.count];
+			}
 		} else {
-			pool.mutex.unlock();
+			MutexLock lock(pool.mutex);
+			block = pop_free_block(pool, pool_index);
+		}
+
+		if (block == nullptr) {
 			ZN_PROFILE_SCOPE_NAMED("new alloc");
 			// All allocations done in this pool have the same size,
 			// which must be greater or equal to `size`
-			const size_t capacity = get_size_from_pool_index(pot);
+			const size_t capacity = get_size_from_pool_index(pool_index);
 #ifdef DEBUG_ENABLED
 			ZN_ASSERT(capacity >= size);
 #endif
 			block = (uint8_t *)ZN_ALLOC(capacity * sizeof(uint8_t));
-			_total_memory += size;
+			_total_memory += capacity;
 		}
-#ifdef DEBUG_ENABLED
 		if (block != nullptr) {
+			++pool.used_block_count;
+			pool.used_requested_bytes += size;
+#ifdef DEBUG_ENABLED
 			pool.debug_used_blocks.add(block);
-		}
 #endif
+		}
 	}
 	if (block == nullptr) {
 		ZN_PRINT_ERROR("Out of memory");
@@ -159,7 +174,7 @@ void VoxelMemoryPool::recycle(uint8_t *block, size_t size) {
 	}
 	ZN_ASSERT(size != 0);
 	ZN_ASSERT(block != nullptr);
-	// Not calculating `pot` immediately because the function we use to calculate it uses 32 bits,
+	// Not calculating `pool_index` immediately because the function we use to calculate it uses 32 bits,
 	// while `size_t` can be larger than that.
 	if (size > get_highest_supported_size()) {
 #ifdef DEBUG_ENABLED
@@ -169,53 +184,414 @@ void VoxelMemoryPool::recycle(uint8_t *block, size_t size) {
 		ZN_FREE(block);
 		_total_memory -= size;
 	} else {
-		const unsigned int pot = get_pool_index_from_size(size);
-		Pool &pool = _pot_pools[pot];
+		const unsigned int pool_index = get_pool_index_from_size(size);
+		Pool &pool = _pools[pool_index];
 #ifdef DEBUG_ENABLED
 		// Make sure this allocation was done by this pool in this scenario
 		pool.debug_used_blocks.remove(block);
 #endif
-		MutexLock lock(pool.mutex);
-		pool.blocks.push_back(block);
+		--pool.used_block_count;
+		pool.used_requested_bytes -= size;
+
+		const unsigned int cache_capacity = get_thread_cache_capacity(pool_index);
+		ThreadCache *cache = cache_capacity > 0 ? get_thread_cache() : nullptr;
+
+		if (cache != nullptr) {
+			ThreadCache::Magazine &magazine = cache->magazines[pool_index];
+			if (magazine.count == cache_capacity) {
+				// Keep half, so alternating allocations and recycles don't hit the shared pool every time
+				flush_magazine(pool_index, magazine, cache_capacity / 2);
+			}
+			magazine.blocks[magazine.count] = block;
+			++magazine.count;
+		} else {
+			MutexLock lock(pool.mutex);
+			push_free_block(pool, pool_index, block);
+		}
 	}
 	--_used_blocks;
 	_used_memory -= size;
 }
 
+VoxelMemoryPool::ThreadCache *VoxelMemoryPool::get_thread_cache() {
+	static thread_local ThreadCache tls_cache;
+	if (tls_cache.owner != this) {
+		if (tls_cache.owner != nullptr) {
+			// Already used by another pool
+			return nullptr;
+		}
+		register_thread_cache(tls_cache);
+	}
+	return &tls_cache;
+}
+
+void VoxelMemoryPool::register_thread_cache(ThreadCache &cache) {
+	MutexLock lock(_thread_caches_mutex);
+	ZN_ASSERT(cache.owner == nullptr);
+	cache.owner = this;
+	_thread_caches.push_back(&cache);
+}
+
+void VoxelMemoryPool::unregister_thread_cache(ThreadCache &cache) {
+	MutexLock lock(_thread_caches_mutex);
+	ZN_ASSERT(cache.owner == this);
+	for (unsigned int pool_index = 0; pool_index < cache.magazines.size(); ++pool_index) {
+		flush_magazine(pool_index, cache.magazines[pool_index], 0);
+	}
+	for (unsigned int i = 0; i < _thread_caches.size(); ++i) {
+		if (_thread_caches[i] == &cache) {
+			_thread_caches[i] = _thread_caches.back();
+			_thread_caches.pop_back();
+			break;
+		}
+	}
+	cache.owner = nullptr;
+}
+
+void VoxelMemoryPool::refill_magazine(unsigned int pool_index, ThreadCache::Magazine &magazine, unsigned int capacity) {
+	// Take a batch, so we don't lock the shared pool at every allocation
+	const unsigned int target_count = math::max(capacity / 2, 1u);
+	Pool &pool = _pools[pool_index];
+	MutexLock lock(pool.mutex);
+	while (magazine.count < target_count) {
+		uint8_t *block = pop_free_block(pool, pool_index);
+		if (block == nullptr) {
+			break;
+		}
+		magazine.blocks[magazine.count] = block;
+		++magazine.count;
+	}
+}
+
+void VoxelMemoryPool::flush_magazine(
+		unsigned int pool_index,
+		ThreadCache::Magazine &magazine,
+		unsigned int keep_count
+) {
+	if (magazine.count <= keep_count) {
+		return;
+	}
+	Pool &pool = _pools[pool_index];
+	MutexLock lock(pool.mutex);
+	// Give back the oldest blocks
+	const unsigned int flush_count = magazine.count - keep_count;
+	for (unsigned int i = 0; i < flush_count; ++i) {
+		push_free_block(pool, pool_index, magazine.blocks[i]);
+	}
+	for (unsigned int i = 0; i < keep_count; ++i) {
+		magazine.blocks[i] = magazine.blocks[flush_count + i];
+	}
+	magazine.count = keep_count;
+}
+
+uint8_t *VoxelMemoryPool::pop_free_block(Pool &pool, unsigned int pool_index) {
+	if (is_arena_pool(pool_index)) {
+		return arena_allocate(pool, pool_index);
+	}
+	if (pool.blocks.size() == 0) {
+		return nullptr;
+	}
+	uint8_t *block = pool.blocks.back();
+	pool.blocks.pop_back();
+	return block;
+}
+
+void VoxelMemoryPool::push_free_block(Pool &pool, unsigned int pool_index, uint8_t *block) {
+	if (is_arena_pool(pool_index)) {
+		arena_recycle(pool, pool_index, block);
+	} else {
+		pool.blocks.push_back(block);
+	}
+}
+
+uint8_t *VoxelMemoryPool::arena_allocate(Pool &pool, unsigned int pool_index) {
+	ArenaSlab *slab = nullptr;
+	if (pool.arena_partial_slabs.size() > 0) {
+		slab = pool.arena_partial_slabs.back();
+	} else {
+		slab = arena_create_slab(pool);
+		if (slab == nullptr) {
+			// Regular allocation will be used instead
+			return nullptr;
+		}
+	}
+
+	const size_t block_size = get_size_from_pool_index(pool_index);
+	const unsigned int slab_capacity = ARENA_SLAB_SIZE / block_size;
+
+	uint8_t *block;
+	if (slab->free_list != nullptr) {
+		block = slab->free_list;
+		memcpy(&slab->free_list, block, sizeof(uint8_t *));
+	} else {
+#ifdef DEBUG_ENABLED
+		ZN_ASSERT(slab->bump_index < slab_capacity);
+#endif
+		// Pages are only touched once blocks get used
+		block = slab->base + slab->bump_index * block_size;
+		++slab->bump_index;
+	}
+
+	if (slab->used_count == 0) {
+		--pool.arena_empty_slab_count;
+	}
+	++slab->used_count;
+
+	if (slab->used_count == slab_capacity) {
+		// Full, remove from partial slabs
+		ArenaSlab *last = pool.arena_partial_slabs.back();
+		last->partial_index = slab->partial_index;
+		pool.arena_partial_slabs[slab->partial_index] = last;
+		pool.arena_partial_slabs.pop_back();
+	}
+
+	return block;
+}
+
+void VoxelMemoryPool::arena_recycle(Pool &pool, unsigned int pool_index, uint8_t *block) {
+	const size_t block_size = get_size_from_pool_index(pool_index);
+
+	// Slabs are aligned to their size
+	const uintptr_t base = reinterpret_cast<uintptr_t>(block) & ~uintptr_t(ARENA_SLAB_SIZE - 1);
+	auto it = pool.arena_slabs.find(base);
+	if (it == pool.arena_slabs.end()) {
+		// Allocated on the heap, because slabs could not be obtained at the time
+		ZN_FREE(block);
+		_total_memory -= block_size;
+		return;
+	}
+
+	ArenaSlab *slab = it->second;
+	const unsigned int slab_capacity = ARENA_SLAB_SIZE / block_size;
+#ifdef DEBUG_ENABLED
+	ZN_ASSERT(slab->used_count > 0);
+#endif
+
+	memcpy(block, &slab->free_list, sizeof(uint8_t *));
+	slab->free_list = block;
+
+	if (slab->used_count == slab_capacity) {
+		slab->partial_index = pool.arena_partial_slabs.size();
+		pool.arena_partial_slabs.push_back(slab);
+	}
+	--slab->used_count;
+
+	if (slab->used_count == 0) {
+		if (pool.arena_empty_slab_count > 0) {
+			arena_release_slab(pool, slab);
+		} else {
+			++pool.arena_empty_slab_count;
+		}
+	}
+}
+
+VoxelMemoryPool::ArenaSlab *VoxelMemoryPool::arena_create_slab(Pool &pool) {
+	ZN_PROFILE_SCOPE();
+	bool large_pages = false;
+	uint8_t *base = static_cast<uint8_t *>(
+			virtual_memory::allocate_aligned_pages(ARENA_SLAB_SIZE, ARENA_SLAB_SIZE, large_pages)
+	);
+	if (base == nullptr) {
+		ZN_PRINT_ERROR_ONCE("Could not allocate memory slab, falling back on regular allocations");
+		return nullptr;
+	}
+	_total_memory += ARENA_SLAB_SIZE;
+
+	ArenaSlab *slab = ZN_NEW(ArenaSlab);
+	slab->base = base;
+	slab->large_pages = large_pages;
+	slab->partial_index = pool.arena_partial_slabs.size();
+	pool.arena_partial_slabs.push_back(slab);
+	pool.arena_slabs.insert({ reinterpret_cast<uintptr_t>(base), slab });
+	++pool.arena_empty_slab_count;
+	return slab;
+}
+
+void VoxelMemoryPool::arena_release_slab(Pool &pool, ArenaSlab *slab) {
+#ifdef DEBUG_ENABLED
+	ZN_ASSERT(slab->used_count == 0);
+#endif
+	// Empty slabs always have free blocks
+	ArenaSlab *last = pool.arena_partial_slabs.back();
+	last->partial_index = slab->partial_index;
+	pool.arena_partial_slabs[slab->partial_index] = last;
+	pool.arena_partial_slabs.pop_back();
+
+	pool.arena_slabs.erase(reinterpret_cast<uintptr_t>(slab->base));
+	virtual_memory::free_aligned_pages(slab->base, ARENA_SLAB_SIZE);
+	_total_memory -= ARENA_SLAB_SIZE;
+	ZN_DELETE(slab);
+}
+
+void VoxelMemoryPool::arena_clear(Pool &pool) {
+	for (auto it = pool.arena_slabs.begin(); it != pool.arena_slabs.end(); ++it) {
+		ArenaSlab *slab = it->second;
+		virtual_memory::free_aligned_pages(slab->base, ARENA_SLAB_SIZE);
+		ZN_DELETE(slab);
+	}
+	pool.arena_slabs.clear();
+	pool.arena_partial_slabs.clear();
+	pool.arena_empty_slab_count = 0;
+}
+
+void VoxelMemoryPool::set_arena_enabled(bool enabled) {
+	if (enabled == _arena_enabled) {
+		return;
+	}
+	ZN_ASSERT_RETURN_MSG(_used_blocks == 0, "Can't change allocation mode while memory blocks are in use");
+	if (enabled && !virtual_memory::is_supported()) {
+		ZN_PRINT_WARNING("Arena allocation is not supported on this platform");
+		return;
+	}
+	// Free blocks were obtained with the previous mode
+	clear();
+	_arena_enabled = enabled;
+}
+
+VoxelMemoryPool::ArenaStats VoxelMemoryPool::get_arena_stats() const {
+	ArenaStats stats;
+	for (unsigned int pool_index = 0; pool_index < _pools.size(); ++pool_index) {
+		const Pool &pool = _pools[pool_index];
+		MutexLock lock(pool.mutex);
+		const size_t block_size = get_size_from_pool_index(pool_index);
+		const unsigned int slab_capacity = ARENA_SLAB_SIZE / block_size;
+		for (auto it = pool.arena_slabs.begin(); it != pool.arena_slabs.end(); ++it) {
+			const ArenaSlab *slab = it->second;
+			++stats.slab_count;
+			if (slab->large_pages) {
+				++stats.large_page_slab_count;
+			}
+			if (slab->used_count == 0) {
+				++stats.empty_slab_count;
+			} else if (slab->used_count < slab_capacity) {
+				++stats.partial_slab_count;
+			}
+			stats.used_bytes += slab->used_count * block_size;
+		}
+	}
+	stats.reserved_bytes = stats.slab_count * ARENA_SLAB_SIZE;
+	return stats;
+}
+
 void VoxelMemoryPool::clear_unused_blocks() {
-	for (unsigned int pot = 0; pot < _pot_pools.size(); ++pot) {
-		Pool &pool = _pot_pools[pot];
+	// Caches of other threads can't be accessed safely while they run, but they are small
+	ThreadCache *cache = get_thread_cache();
+	if (cache != nullptr) {
+		for (unsigned int pool_index = 0; pool_index < cache->magazines.size(); ++pool_index) {
+			flush_magazine(pool_index, cache->magazines[pool_index], 0);
+		}
+	}
+
+	for (unsigned int pool_index = 0; pool_index < _pools.size(); ++pool_index) {
+		Pool &pool = _pools[pool_index];
 		MutexLock lock(pool.mutex);
 		for (unsigned int i = 0; i < pool.blocks.size(); ++i) {
 			void *block = pool.blocks[i];
 			ZN_FREE(block);
 		}
-		_total_memory -= get_size_from_pool_index(pot) * pool.blocks.size();
+		_total_memory -= get_size_from_pool_index(pool_index) * pool.blocks.size();
 		pool.blocks.clear();
+
+		for (unsigned int i = 0; i < pool.arena_partial_slabs.size();) {
+			ArenaSlab *slab = pool.arena_partial_slabs[i];
+			if (slab->used_count == 0) {
+				// Replaced by the last slab, so `i` is not incremented
+				arena_release_slab(pool, slab);
+			} else {
+				++i;
+			}
+		}
+		pool.arena_empty_slab_count = 0;
 	}
 }
 
 void VoxelMemoryPool::clear() {
-	for (unsigned int pot = 0; pot < _pot_pools.size(); ++pot) {
-		Pool &pool = _pot_pools[pot];
+	{
+		MutexLock lock(_thread_caches_mutex);
+		for (ThreadCache *cache : _thread_caches) {
+			for (unsigned int pool_index = 0; pool_index < cache->magazines.size(); ++pool_index) {
+				ThreadCache::Magazine &magazine = cache->magazines[pool_index];
+				Pool &pool = _pools[pool_index];
+				MutexLock pool_lock(pool.mutex);
+				for (unsigned int i = 0; i < magazine.count; ++i) {
+					// Blocks from slabs are freed along with them below
+					push_free_block(pool, pool_index, magazine.blocks[i]);
+				}
+				magazine.count = 0;
+			}
+			cache->owner = nullptr;
+		}
+		_thread_caches.clear();
+	}
+	for (unsigned int pool_index = 0; pool_index < _pools.size(); ++pool_index) {
+		Pool &pool = _pools[pool_index];
 		MutexLock lock(pool.mutex);
 		for (unsigned int i = 0; i < pool.blocks.size(); ++i) {
 			void *block = pool.blocks[i];
 			ZN_FREE(block);
 		}
 		pool.blocks.clear();
+		arena_clear(pool);
+		pool.used_block_count = 0;
+		pool.used_requested_bytes = 0;
 	}
 	_used_memory = 0;
 	_total_memory = 0;
 	_used_blocks = 0;
 }
 
+size_t VoxelMemoryPool::get_pooled_block_size(size_t size) {
+	if (size == 0 || size > get_highest_supported_size()) {
+		return size;
+	}
+	return get_size_from_pool_index(get_pool_index_from_size(size));
+}
+
 void VoxelMemoryPool::debug_print() {
 	print_line("-------- VoxelMemoryPool ----------");
-	for (unsigned int pot = 0; pot < _pot_pools.size(); ++pot) {
-		Pool &pool = _pot_pools[pot];
+	uint64_t total_wasted_bytes = 0;
+	for (unsigned int pool_index = 0; pool_index < _pools.size(); ++pool_index) {
+		Pool &pool = _pools[pool_index];
+		const size_t block_size = get_size_from_pool_index(pool_index);
+		const unsigned int used_block_count = pool.used_block_count;
+		const uint64_t used_bytes = uint64_t(used_block_count) * block_size;
+		const uint64_t requested_bytes = pool.used_requested_bytes;
+		// Unused bytes at the end of blocks in use, due to rounding up requested sizes to the class size.
+		// Counters are not read at once, so they could briefly not match if other threads are allocating.
+		const uint64_t wasted_bytes = used_bytes > requested_bytes ? used_bytes - requested_bytes : 0;
+		total_wasted_bytes += wasted_bytes;
 		MutexLock lock(pool.mutex);
-		print_line(format("Pool {}: {} blocks (capacity {})", pot, pool.blocks.size(), pool.blocks.capacity()));
+		if (used_block_count == 0 && pool.blocks.size() == 0 && pool.arena_slabs.size() == 0) {
+			continue;
+		}
+		print_line(
+				format("Pool {} ({} bytes): {} used blocks wasting {} bytes, {} free blocks (capacity {})",
+					   pool_index,
+					   block_size,
+					   used_block_count,
+					   wasted_bytes,
+					   pool.blocks.size(),
+					   pool.blocks.capacity())
+		);
+	}
+	print_line(format("Wasted in used blocks: {} bytes", total_wasted_bytes));
+	{
+		MutexLock lock(_thread_caches_mutex);
+		print_line(format("Thread caches: {}", _thread_caches.size()));
+	}
+	if (_arena_enabled) {
+		const ArenaStats stats = get_arena_stats();
+		const float occupancy = stats.reserved_bytes > 0 ? double(stats.used_bytes) / stats.reserved_bytes : 0.0;
+		print_line(
+				format("Arena: {} slabs ({} with large pages, {} partial, {} empty), {} bytes reserved, "
+					   "occupancy {}%",
+					   stats.slab_count,
+					   stats.large_page_slab_count,
+					   stats.partial_slab_count,
+					   stats.empty_slab_count,
+					   stats.reserved_bytes,
+					   int(occupancy * 100.f))
+		);
 	}
 }
 
@@ -2,12 +2,11 @@
 #define VOXEL_MEMORY_POOL_H
 
 #include "../util/containers/fixed_array.h"
-#ifdef DEBUG_ENABLED
 #include "../util/containers/std_unordered_map.h"
-#endif
 #include "../util/containers/std_vector.h"
 #include "../util/dstack.h"
 #include "../util/math/funcs.h"
+#include "../util/memory/virtual_memory.h"
 #include "../util/thread/mutex.h"
 
 #include <atomic>
@@ -16,12 +15,37 @@
 namespace zylann::voxel {
 
 // Pool based on a scenario where allocated blocks are often the same size.
-// A pool of blocks is assigned for each power of two.
-// The majority of VoxelBuffers use powers of two so most of the time
-// we won't waste memory. Sometimes non-power-of-two buffers are created,
-// but they are often temporary and less numerous.
+// A pool of blocks is assigned for each size class. Small sizes are rounded up to powers of two. Larger ones are
+// split in 4 classes per doubling, so buffers with padding (like 18^3 or 34^3 voxels used for meshing) don't waste up
+// to half of their block like they would with powers of two.
+// Each thread also keeps a small cache of free blocks per size class, which is refilled from and flushed to the
+// shared pools in batches. That way most allocations and recycles don't lock anything when threads are busy.
+// Optionally, blocks can be carved from large slabs obtained directly from the OS (arena mode). Each slab only holds
+// blocks of one size, and is aligned so it can be backed by large pages. Voxel data then ends up packed together
+// instead of scattered around the heap, which reduces TLB misses when many blocks are accessed at once.
 class VoxelMemoryPool {
 private:
+	// Sizes up to this power of two get one class each. Above it, classes are multiples of 16 bytes, which keeps blocks
+	// carved from slabs aligned.
+	static const unsigned int MAX_POT_CLASS_SHIFT = 6;
+	static const unsigned int CLASSES_PER_DOUBLING_SHIFT = 2;
+	static const unsigned int CLASSES_PER_DOUBLING = 1 << CLASSES_PER_DOUBLING_SHIFT;
+	// We handle allocations with up to 2^20 = 1,048,576 bytes.
+	// This is chosen based on practical needs.
+	static const unsigned int MAX_POOLED_SIZE_SHIFT = 20;
+	static const unsigned int POOL_COUNT =
+			MAX_POT_CLASS_SHIFT + 1 + (MAX_POOLED_SIZE_SHIFT - MAX_POT_CLASS_SHIFT) * CLASSES_PER_DOUBLING;
+	// How many blocks a thread can cache for one size, at most
+	static const unsigned int MAX_THREAD_CACHE_BLOCKS = 32;
+	// Bounds how much memory a thread can cache for one size, so large blocks don't get stuck in idle threads
+	static const unsigned int MAX_THREAD_CACHE_BYTES_PER_POOL = 256 * 1024;
+
+	static const size_t ARENA_SLAB_SIZE = virtual_memory::LARGE_PAGE_SIZE;
+	// Free blocks in slabs store a pointer to the next free block, so they must be able to hold one
+	static const size_t MIN_ARENA_BLOCK_SIZE = 8;
+	// Larger blocks would leave too few per slab, making it unlikely for slabs to ever become empty
+	static const size_t MAX_ARENA_BLOCK_SIZE = 256 * 1024;
+
 #ifdef DEBUG_ENABLED
 	struct DebugUsedBlocks {
 		Mutex mutex;
@@ -45,16 +69,71 @@ private:
 	};
 #endif
 
+	struct ArenaSlab {
+		uint8_t *base = nullptr;
+		// Recycled blocks. Each of them stores a pointer to the next one.
+		uint8_t *free_list = nullptr;
+		// Blocks from this index onwards have never been handed out
+		unsigned int bump_index = 0;
+		// Blocks handed out, either in use or cached by threads
+		unsigned int used_count = 0;
+		// Position in the pool's list of slabs having free blocks
+		unsigned int partial_index = 0;
+		bool large_pages = false;
+	};
+
 	struct Pool {
 		Mutex mutex;
 		// Would a linked list be better?
 		StdVector<uint8_t *> blocks;
+		// Arena mode: all slabs, by base address. `blocks` isn't used by arena pools.
+		StdUnorderedMap<uintptr_t, ArenaSlab *> arena_slabs;
+		StdVector<ArenaSlab *> arena_partial_slabs;
+		// One empty slab is kept, so allocations going up and down around a slab's capacity don't keep requesting
+		// memory from the OS
+		unsigned int arena_empty_slab_count = 0;
+		// Blocks in use and the sum of the sizes requested for them, to measure how much memory classes waste.
+		// Updated without locking the pool.
+		std::atomic_uint32_t used_block_count = { 0 };
+		std::atomic_uint64_t used_requested_bytes = { 0 };
 #ifdef DEBUG_ENABLED
 		DebugUsedBlocks debug_used_blocks;
 #endif
 	};
 
+	struct ThreadCache {
+		struct Magazine {
+			FixedArray<uint8_t *, MAX_THREAD_CACHE_BLOCKS> blocks;
+			unsigned int count = 0;
+		};
+
+		FixedArray<Magazine, POOL_COUNT> magazines;
+		// Pool this cache is registered to
+		VoxelMemoryPool *owner = nullptr;
+
+		// Called when the thread exits
+		~ThreadCache() {
+			if (owner != nullptr) {
+				owner->unregister_thread_cache(*this);
+			}
+		}
+	};
+
 public:
+	struct ArenaStats {
+		unsigned int slab_count = 0;
+		// Slabs the OS accepted to back with large pages. It doesn't guarantee large pages are in use: on Linux,
+		// transparent huge pages are assembled by the kernel in the background.
+		unsigned int large_page_slab_count = 0;
+		// Slabs with no block in use
+		unsigned int empty_slab_count = 0;
+		// Slabs with some blocks in use and some free blocks
+		unsigned int partial_slab_count = 0;
+		size_t reserved_bytes = 0;
+		// Memory occupied by blocks in use or cached by threads
+		size_t used_bytes = 0;
+	};
+
 	static void create_singleton();
 	static void destroy_singleton();
 	static VoxelMemoryPool &get_singleton();
@@ -65,8 +144,23 @@ public:
 	uint8_t *allocate(size_t size);
 	void recycle(uint8_t *block, size_t size);
 
+	// Frees blocks that are not in use. Blocks cached by threads other than the caller are not freed.
+	// In arena mode, only slabs containing no used blocks are given back to the OS.
 	void clear_unused_blocks();
 
+	// Must be set before any block is allocated and before other threads use the pool.
+	// Falls back to regular allocations if the platform doesn't support it.
+	void set_arena_enabled(bool enabled);
+
+	bool is_arena_enabled() const {
+		return _arena_enabled;
+	}
+
+	ArenaStats get_arena_stats() const;
+
+	// Gets the size of the blocks actually allocated for a requested size, if it is pooled
+	static size_t get_pooled_block_size(size_t size);
+
 	void debug_print();
 	unsigned int debug_get_used_blocks() const;
 	size_t debug_get_used_memory() const;
@@ -75,35 +169,82 @@ public:
 private:
 	void clear();
 
-	inline size_t get_highest_supported_size() const {
-		return size_t(1) << (_pot_pools.size() - 1);
+	static inline size_t get_highest_supported_size() {
+		return size_t(1) << MAX_POOLED_SIZE_SHIFT;
 	}
 
-	inline unsigned int get_pool_index_from_size(size_t size) const {
+	static inline unsigned int get_pool_index_from_size(size_t size) {
 #ifdef DEBUG_ENABLED
-		// `get_next_power_of_two_32` takes unsigned int
+		// `get_next_power_of_two_32_shift` takes unsigned int
 		ZN_ASSERT(size <= std::numeric_limits<unsigned int>::max());
 #endif
-		return math::get_shift_from_power_of_two_32(math::get_next_power_of_two_32(size));
+		const unsigned int size_shift = math::get_next_power_of_two_32_shift(size);
+		if (size_shift <= MAX_POT_CLASS_SHIFT) {
+			return size_shift;
+		}
+		// `size` is in `(2^lower_shift, 2^(lower_shift + 1)]`, which is split in equal steps
+		const unsigned int lower_shift = size_shift - 1;
+		const unsigned int step_shift = lower_shift - CLASSES_PER_DOUBLING_SHIFT;
+		const unsigned int step_index = ((size - (size_t(1) << lower_shift) - 1) >> step_shift) + 1;
+		return MAX_POT_CLASS_SHIFT + (lower_shift - MAX_POT_CLASS_SHIFT) * CLASSES_PER_DOUBLING + step_index;
 	}
 
 	static inline size_t get_size_from_pool_index(unsigned int i) {
-		return size_t(1) << i;
+		if (i <= MAX_POT_CLASS_SHIFT) {
+			return size_t(1) << i;
+		}
+		const unsigned int j = i - MAX_POT_CLASS_SHIFT - 1;
+		const unsigned int lower_shift = MAX_POT_CLASS_SHIFT + j / CLASSES_PER_DOUBLING;
+		const unsigned int step_index = j % CLASSES_PER_DOUBLING + 1;
+		return (size_t(1) << lower_shift) + (size_t(step_index) << (lower_shift - CLASSES_PER_DOUBLING_SHIFT));
+	}
+
+	static inline unsigned int get_thread_cache_capacity(unsigned int pool_index) {
+		return math::min<size_t>(
+				MAX_THREAD_CACHE_BLOCKS, MAX_THREAD_CACHE_BYTES_PER_POOL / get_size_from_pool_index(pool_index)
+		);
+	}
+
+	inline bool is_arena_pool(unsigned int pool_index) const {
+		if (!_arena_enabled) {
+			return false;
+		}
+		const size_t block_size = get_size_from_pool_index(pool_index);
+		return block_size >= MIN_ARENA_BLOCK_SIZE && block_size <= MAX_ARENA_BLOCK_SIZE;
 	}
 
+	// These must be called with the pool locked
+	uint8_t *pop_free_block(Pool &pool, unsigned int pool_index);
+	void push_free_block(Pool &pool, unsigned int pool_index, uint8_t *block);
+	uint8_t *arena_allocate(Pool &pool, unsigned int pool_index);
+	void arena_recycle(Pool &pool, unsigned int pool_index, uint8_t *block);
+	ArenaSlab *arena_create_slab(Pool &pool);
+	void arena_release_slab(Pool &pool, ArenaSlab *slab);
+	void arena_clear(Pool &pool);
+
+	ThreadCache *get_thread_cache();
+	void register_thread_cache(ThreadCache &cache);
+	void unregister_thread_cache(ThreadCache &cache);
+	void refill_magazine(unsigned int pool_index, ThreadCache::Magazine &magazine, unsigned int capacity);
+	void flush_magazine(unsigned int pool_index, ThreadCache::Magazine &magazine, unsigned int keep_count);
+
 #ifdef DEBUG_ENABLED
 	void debug_print_used_blocks(unsigned int max_amount);
 #endif
 
-	// We handle allocations with up to 2^20 = 1,048,576 bytes.
-	// This is chosen based on practical needs.
-	// Each slot in this array corresponds to allocations
-	// that contain 2^index bytes in them.
-	FixedArray<Pool, 21> _pot_pools;
+	// Each slot in this array corresponds to allocations of one size class, see `get_size_from_pool_index`.
+	FixedArray<Pool, POOL_COUNT> _pools;
 #ifdef DEBUG_ENABLED
 	DebugUsedBlocks _debug_nonpooled_used_blocks;
 #endif
 
+	// Threads must no longer use the pool when it gets destroyed
+	StdVector<ThreadCache *> _thread_caches;
+	Mutex _thread_caches_mutex;
+
+	// Not changed while the pool is in use, so it doesn't need to be atomic
+	bool _arena_enabled = false;
+
 	std::atomic_uint32_t _used_blocks = { 0 };
 	std::atomic_uint64_t _used_memory = { 0 };
 	std::atomic_uint64_t _total_memory = { 0 };
@@ -0,0 +1,206 @@
+#include "block_load_batcher.h"
+#include "../storage/voxel_buffer.h"
+#include "../util/io/log.h"
+#include "../util/memory/memory.h"
+#include "../util/profiling.h"
+
+#include <algorithm>
+
+namespace zylann::voxel {
+
+namespace {
+
+inline int64_t get_distance_squared(const Vector3i a, const Vector3i b) {
+	const Vector3i d = a - b;
+	return static_cast<int64_t>(d.x) * d.x + static_cast<int64_t>(d.y) * d.y + static_cast<int64_t>(d.z) * d.z;
+}
+
+struct BatchItem {
+	uint32_t request_id;
+	Vector3i position;
+	int64_t distance_squared;
+};
+
+} // namespace
+
+uint32_t BlockLoadBatcher::add_request(Vector3i position, uint8_t lod_index, uint8_t block_size) {
+	MutexLock lock(_mutex);
+	const uint32_t request_id = _next_request_id;
+	++_next_request_id;
+	_pending_requests.insert({ request_id, Request{ position, lod_index, block_size } });
+	return request_id;
+}
+
+void BlockLoadBatcher::remove_request(uint32_t request_id) {
+	MutexLock lock(_mutex);
+	_pending_requests.erase(request_id);
+	_loading_requests.erase(request_id);
+	_loaded_blocks.erase(request_id);
+}
+
+std::shared_ptr<VoxelBuffer> BlockLoadBatcher::load(
+		VoxelStream &stream,
+		uint32_t request_id,
+		VoxelStream::ResultCode &out_result,
+		StdVector<uint8_t> *out_encoded_voxels
+) {
+	ZN_PROFILE_SCOPE();
+
+	static thread_local StdVector<BatchItem> tls_batch;
+	StdVector<BatchItem> &batch = tls_batch;
+	batch.clear();
+
+	if (out_encoded_voxels != nullptr) {
+		out_encoded_voxels->clear();
+	}
+
+	Request request;
+	LoadedBlock loaded_block;
+	bool already_loaded = false;
+	{
+		MutexLock lock(_mutex);
+
+		auto loaded_it = _loaded_blocks.find(request_id);
+		if (loaded_it != _loaded_blocks.end()) {
+			loaded_block = std::move(loaded_it->second);
+			_loaded_blocks.erase(loaded_it);
+			already_loaded = true;
+		}
+	}
+
+	if (already_loaded) {
+		out_result = loaded_block.result;
+		if (loaded_block.encoded_voxels.size() > 0) {
+			if (out_encoded_voxels != nullptr) {
+				std::swap(*out_encoded_voxels, loaded_block.encoded_voxels);
+			} else if (!stream.decode_voxel_block(to_span_const(loaded_block.encoded_voxels), *loaded_block.voxels)) {
+				out_result = VoxelStream::RESULT_ERROR;
+			}
+		}
+		return loaded_block.voxels;
+	}
+
+	{
+		MutexLock lock(_mutex);
+
+		auto request_it = _pending_requests.find(request_id);
+		if (request_it == _pending_requests.end()) {
+			auto loading_it = _loading_requests.find(request_id);
+			if (loading_it == _loading_requests.end()) {
+				ZN_PRINT_ERROR("Block load request not found");
+				out_result = VoxelStream::RESULT_ERROR;
+				return nullptr;
+			}
+			// Another task is loading it at the moment. That only happens if tasks run in parallel, so it's not worth
+			// waiting for it. It will be loaded again on its own.
+			request = loading_it->second;
+
+		} else {
+			request = request_it->second;
+			_pending_requests.erase(request_it);
+
+			// Take pending blocks closest to this one. They are likely close in files too, and their tasks likely have
+			// similar priority.
+			for (auto it = _pending_requests.begin(); it != _pending_requests.end(); ++it) {
+				const Request &other = it->second;
+				if (other.lod_index == request.lod_index && other.block_size == request.block_size) {
+					const int64_t distance_squared = get_distance_squared(request.position, other.position);
+					batch.push_back(BatchItem{ it->first, other.position, distance_squared });
+				}
+			}
+			if (batch.size() > MAX_BATCH_SIZE - 1) {
+				std::nth_element(
+						batch.begin(),
+						batch.begin() + (MAX_BATCH_SIZE - 1),
+						batch.end(),
+						[](const BatchItem &a, const BatchItem &b) { return a.distance_squared < b.distance_squared; }
+				);
+				batch.resize(MAX_BATCH_SIZE - 1);
+			}
+			for (const BatchItem &item : batch) {
+				auto it = _pending_requests.find(item.request_id);
+				_loading_requests.insert({ item.request_id, it->second });
+				_pending_requests.erase(it);
+			}
+		}
+	}
+
+	// The first buffer is for the block of the calling task
+	static thread_local StdVector<std::shared_ptr<VoxelBuffer>> tls_buffers;
+	StdVector<std::shared_ptr<VoxelBuffer>> &buffers = tls_buffers;
+	buffers.resize(batch.size() + 1);
+
+	static thread_local StdVector<VoxelStream::VoxelQueryData> tls_queries;
+	StdVector<VoxelStream::VoxelQueryData> &queries = tls_queries;
+	queries.clear();
+
+	static thread_local StdVector<VoxelStream::EncodedVoxelQueryData> tls_encoded_queries;
+	StdVector<VoxelStream::EncodedVoxelQueryData> &encoded_queries = tls_encoded_queries;
+	encoded_queries.clear();
+
+	static thread_local StdVector<StdVector<uint8_t>> tls_encoded_voxels;
+	StdVector<StdVector<uint8_t>> &encoded_voxels = tls_encoded_voxels;
+
+	// Decoding can then be done by the caller, outside of I/O threads
+	const bool encoded = out_encoded_voxels != nullptr && stream.supports_encoded_voxel_blocks();
+	if (encoded) {
+		encoded_voxels.resize(buffers.size());
+	}
+
+	for (unsigned int i = 0; i < buffers.size(); ++i) {
+		std::shared_ptr<VoxelBuffer> &voxels = buffers[i];
+		voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+		voxels->create(Vector3iUtil::create(request.block_size));
+		const Vector3i position = i == 0 ? request.position : batch[i - 1].position;
+		if (encoded) {
+			encoded_queries.push_back(VoxelStream::EncodedVoxelQueryData{
+					encoded_voxels[i], voxels.get(), position, request.lod_index, VoxelStream::RESULT_ERROR });
+		} else {
+			queries.push_back(
+					VoxelStream::VoxelQueryData{ *voxels, position, request.lod_index, VoxelStream::RESULT_ERROR }
+			);
+		}
+	}
+
+	if (encoded) {
+		stream.load_encoded_voxel_blocks(to_span(encoded_queries));
+	} else {
+		stream.load_voxel_blocks(to_span(queries));
+	}
+
+	const auto get_result = [encoded, &queries, &encoded_queries](unsigned int i) {
+		return encoded ? encoded_queries[i].result : queries[i].result;
+	};
+
+	std::shared_ptr<VoxelBuffer> voxels = std::move(buffers[0]);
+	out_result = get_result(0);
+	if (encoded) {
+		std::swap(*out_encoded_voxels, encoded_voxels[0]);
+	}
+
+	if (batch.size() > 0) {
+		MutexLock lock(_mutex);
+		for (unsigned int i = 0; i < batch.size(); ++i) {
+			const uint32_t other_request_id = batch[i].request_id;
+			// The request may have been removed while loading, if its task got cancelled
+			if (_loading_requests.erase(other_request_id) != 0) {
+				LoadedBlock loaded_block;
+				loaded_block.voxels = buffers[i + 1];
+				loaded_block.result = get_result(i + 1);
+				if (encoded) {
+					std::swap(loaded_block.encoded_voxels, encoded_voxels[i + 1]);
+				}
+				_loaded_blocks.insert({ other_request_id, std::move(loaded_block) });
+			}
+		}
+	}
+
+	queries.clear();
+	encoded_queries.clear();
+	encoded_voxels.clear();
+	buffers.clear();
+
+	return voxels;
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,67 @@
+#ifndef VOXEL_BLOCK_LOAD_BATCHER_H
+#define VOXEL_BLOCK_LOAD_BATCHER_H
+
+#include "../util/containers/std_unordered_map.h"
+#include "../util/containers/std_vector.h"
+#include "../util/thread/mutex.h"
+#include "voxel_stream.h"
+
+#include <memory>
+
+namespace zylann::voxel {
+
+class VoxelBuffer;
+
+// Keeps track of blocks waiting to be loaded from a stream by separate tasks, so when one of these tasks runs, it can
+// load other pending blocks close to it with a single call to `VoxelStream::load_voxel_blocks`. Streams can then
+// sort them by file and offset, which reduces seeks and calls to the OS, especially on hard drives and network
+// storage. Blocks loaded on behalf of other tasks are kept until these tasks run.
+// Thread-safe.
+class BlockLoadBatcher {
+public:
+	static constexpr unsigned int MAX_BATCH_SIZE = 16;
+
+	// Registers a block to load. Returns an ID to use in other calls.
+	uint32_t add_request(Vector3i position, uint8_t lod_index, uint8_t block_size);
+
+	// Must be called when the request is no longer needed, whether it was loaded or not.
+	void remove_request(uint32_t request_id);
+
+	// Loads the requested block, along with pending blocks of the same LOD closest to it, unless it was already loaded
+	// as part of a previous batch. Returns null if the request is not registered.
+	// If `out_encoded_voxels` is provided and the stream supports it, voxels may be returned encoded in it instead,
+	// leaving decoding to the caller (into the returned buffer).
+	std::shared_ptr<VoxelBuffer> load(
+			VoxelStream &stream,
+			uint32_t request_id,
+			VoxelStream::ResultCode &out_result,
+			StdVector<uint8_t> *out_encoded_voxels = nullptr
+	);
+
+private:
+	struct Request {
+		Vector3i position;
+		uint8_t lod_index;
+		uint8_t block_size;
+	};
+
+	struct LoadedBlock {
+		std::shared_ptr<VoxelBuffer> voxels;
+		// If not empty, voxels have yet to be decoded from these bytes
+		StdVector<uint8_t> encoded_voxels;
+		VoxelStream::ResultCode result;
+	};
+
+	// Requests waiting for their own task or another one to load them
+	StdUnorderedMap<uint32_t, Request> _pending_requests;
+	// Requests being loaded by another task
+	StdUnorderedMap<uint32_t, Request> _loading_requests;
+	// Blocks loaded by another task, waiting for their own task to run
+	StdUnorderedMap<uint32_t, LoadedBlock> _loaded_blocks;
+	uint32_t _next_request_id = 0;
+	Mutex _mutex;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_BLOCK_LOAD_BATCHER_H
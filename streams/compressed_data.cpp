@@ -1,13 +1,209 @@
 #include "compressed_data.h"
 #include "../thirdparty/lz4/lz4.h"
+#include "../util/hash_funcs.h"
 #include "../util/io/serialization.h"
+#include "../util/memory/memory.h"
 #include "../util/profiling.h"
 #include "../util/string/format.h"
 
+#include <algorithm>
 #include <limits>
 
+#ifdef VOXEL_ZSTD_ENABLED
+#include <zstd.h>
+#endif
+
 namespace zylann::voxel::CompressedData {
 
+bool is_zstd_supported() {
+#ifdef VOXEL_ZSTD_ENABLED
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint32_t ZstdDictionary::compute_id(Span<const uint8_t> content) {
+	uint32_t h = hash_murmur3_one_32(content.size());
+	for (const uint8_t b : content) {
+		h = hash_murmur3_one_32(b, h);
+	}
+	h = hash_fmix32(h);
+	// 0 means "no dictionary"
+	return h == 0 ? 1 : h;
+}
+
+ZstdDictionary::ZstdDictionary(Span<const uint8_t> content) {
+	_content.resize(content.size());
+	if (content.size() > 0) {
+		memcpy(_content.data(), content.data(), content.size());
+	}
+	_id = compute_id(content);
+#ifdef VOXEL_ZSTD_ENABLED
+	_ddict = ZSTD_createDDict(_content.data(), _content.size());
+	ZN_ASSERT(_ddict != nullptr);
+#endif
+}
+
+ZstdDictionary::~ZstdDictionary() {
+#ifdef VOXEL_ZSTD_ENABLED
+	ZSTD_freeDDict(_ddict);
+	for (const std::pair<int, ZSTD_CDict *> &p : _cdicts) {
+		ZSTD_freeCDict(p.second);
+	}
+#endif
+}
+
+std::shared_ptr<ZstdDictionary> ZstdDictionary::create_from_samples(
+		Span<const StdVector<uint8_t>> samples,
+		unsigned int max_size
+) {
+	ZN_PROFILE_SCOPE();
+
+	StdVector<uint8_t> content;
+	StdVector<uint32_t> sample_hashes;
+
+	for (const StdVector<uint8_t> &sample : samples) {
+		if (content.size() + sample.size() > max_size) {
+			continue;
+		}
+		// Lots of blocks are identical (all air, all ground...), they would just waste space
+		const uint32_t h = compute_id(to_span(sample));
+		if (std::find(sample_hashes.begin(), sample_hashes.end(), h) != sample_hashes.end()) {
+			continue;
+		}
+		sample_hashes.push_back(h);
+		content.insert(content.end(), sample.begin(), sample.end());
+	}
+
+	ZN_ASSERT_RETURN_V_MSG(content.size() > 0, nullptr, "No samples could be used to create a dictionary");
+
+	return make_shared_instance<ZstdDictionary>(to_span(content));
+}
+
+const ZSTD_CDict_s *ZstdDictionary::get_compression_dictionary(int level) const {
+#ifdef VOXEL_ZSTD_ENABLED
+	MutexLock mlock(_cdicts_mutex);
+	for (const std::pair<int, ZSTD_CDict *> &p : _cdicts) {
+		if (p.first == level) {
+			return p.second;
+		}
+	}
+	ZSTD_CDict *cdict = ZSTD_createCDict(_content.data(), _content.size(), level);
+	ZN_ASSERT_RETURN_V(cdict != nullptr, nullptr);
+	_cdicts.push_back(std::make_pair(level, cdict));
+	return cdict;
+#else
+	return nullptr;
+#endif
+}
+
+const ZSTD_DDict_s *ZstdDictionary::get_decompression_dictionary() const {
+	return _ddict;
+}
+
+#ifdef VOXEL_ZSTD_ENABLED
+
+namespace {
+
+// Contexts are expensive to create, so each thread keeps its own
+struct ZstdContexts {
+	ZSTD_CCtx *cctx = nullptr;
+	ZSTD_DCtx *dctx = nullptr;
+
+	~ZstdContexts() {
+		ZSTD_freeCCtx(cctx);
+		ZSTD_freeDCtx(dctx);
+	}
+};
+
+ZstdContexts &get_tls_zstd_contexts() {
+	thread_local ZstdContexts tls_contexts;
+	return tls_contexts;
+}
+
+} // namespace
+
+#endif
+
+bool decompress_zstd(
+		MemoryReader &f,
+		Span<const uint8_t> src,
+		StdVector<uint8_t> &dst,
+		Span<const std::shared_ptr<ZstdDictionary>> dictionaries
+) {
+#ifdef VOXEL_ZSTD_ENABLED
+	const uint32_t dictionary_id = f.get_32();
+
+	const ZstdDictionary *dictionary = nullptr;
+	if (dictionary_id != 0) {
+		for (const std::shared_ptr<ZstdDictionary> &d : dictionaries) {
+			if (d != nullptr && d->get_id() == dictionary_id) {
+				dictionary = d.get();
+				break;
+			}
+		}
+		ZN_ASSERT_RETURN_V_MSG(
+				dictionary != nullptr,
+				false,
+				format("Zstd dictionary {} required to decompress is missing", dictionary_id)
+		);
+	}
+
+	const size_t header_size = sizeof(uint8_t) + sizeof(uint32_t);
+	ZN_ASSERT_RETURN_V(src.size() >= header_size, false);
+	const Span<const uint8_t> frame = src.sub(header_size);
+
+	const unsigned long long decompressed_size = ZSTD_getFrameContentSize(frame.data(), frame.size());
+	ZN_ASSERT_RETURN_V_MSG(
+			decompressed_size != ZSTD_CONTENTSIZE_UNKNOWN && decompressed_size != ZSTD_CONTENTSIZE_ERROR,
+			false,
+			"Invalid Zstd frame"
+	);
+	ZN_ASSERT_RETURN_V(decompressed_size <= std::numeric_limits<uint32_t>::max(), false);
+
+	dst.resize(decompressed_size);
+
+	ZstdContexts &contexts = get_tls_zstd_contexts();
+	if (contexts.dctx == nullptr) {
+		contexts.dctx = ZSTD_createDCtx();
+		ZN_ASSERT_RETURN_V(contexts.dctx != nullptr, false);
+	}
+
+	size_t actually_decompressed_size;
+	if (dictionary != nullptr) {
+		actually_decompressed_size = ZSTD_decompress_usingDDict(
+				contexts.dctx,
+				dst.data(),
+				dst.size(),
+				frame.data(),
+				frame.size(),
+				dictionary->get_decompression_dictionary()
+		);
+	} else {
+		actually_decompressed_size =
+				ZSTD_decompressDCtx(contexts.dctx, dst.data(), dst.size(), frame.data(), frame.size());
+	}
+
+	ZN_ASSERT_RETURN_V_MSG(
+			!ZSTD_isError(actually_decompressed_size),
+			false,
+			format("Zstd decompression error: {}", ZSTD_getErrorName(actually_decompressed_size))
+	);
+
+	ZN_ASSERT_RETURN_V_MSG(
+			actually_decompressed_size == decompressed_size,
+			false,
+			format("Expected {} bytes, obtained {}", decompressed_size, actually_decompressed_size)
+	);
+
+	return true;
+#else
+	ZN_PRINT_ERROR("Zstd decompression is not available in this build");
+	return false;
+#endif
+}
+
 bool decompress_lz4(MemoryReader &f, Span<const uint8_t> src, StdVector<uint8_t> &dst) {
 	const int decompressed_size = f.get_32();
 	ZN_ASSERT_RETURN_V(decompressed_size >= 0, false);
@@ -28,7 +224,11 @@ bool decompress_lz4(MemoryReader &f, Span<const uint8_t> src, StdVector<uint8_t>
 	return true;
 }
 
-bool decompress(Span<const uint8_t> src, StdVector<uint8_t> &dst) {
+bool decompress(
+		Span<const uint8_t> src,
+		StdVector<uint8_t> &dst,
+		Span<const std::shared_ptr<ZstdDictionary>> zstd_dictionaries
+) {
 	ZN_PROFILE_SCOPE();
 
 	MemoryReader f(src, ENDIANNESS_LITTLE_ENDIAN);
@@ -54,6 +254,10 @@ bool decompress(Span<const uint8_t> src, StdVector<uint8_t> &dst) {
 			ZN_ASSERT_RETURN_V(decompress_lz4(f, src, dst), false);
 			break;
 
+		case COMPRESSION_ZSTD:
+			ZN_ASSERT_RETURN_V(decompress_zstd(f, src, dst, zstd_dictionaries), false);
+			break;
+
 		default:
 			ZN_PRINT_ERROR("Invalid compression header");
 			return false;
@@ -81,9 +285,67 @@ bool compress_lz4(MemoryWriter &f, Span<const uint8_t> src, StdVector<uint8_t> &
 	return true;
 }
 
+bool compress_zstd(
+		MemoryWriter &f,
+		Span<const uint8_t> src,
+		StdVector<uint8_t> &dst,
+		int level,
+		const ZstdDictionary *dictionary
+) {
+#ifdef VOXEL_ZSTD_ENABLED
+	ZN_ASSERT_RETURN_V(src.size() <= std::numeric_limits<uint32_t>::max(), false);
+	ZN_ASSERT_RETURN_V(level >= ZSTD_MIN_LEVEL && level <= ZSTD_MAX_LEVEL, false);
+
+	f.store_32(dictionary != nullptr ? dictionary->get_id() : 0);
+
+	const size_t header_size = sizeof(uint8_t) + sizeof(uint32_t);
+	dst.resize(header_size + ZSTD_compressBound(src.size()));
+
+	ZstdContexts &contexts = get_tls_zstd_contexts();
+	if (contexts.cctx == nullptr) {
+		contexts.cctx = ZSTD_createCCtx();
+		ZN_ASSERT_RETURN_V(contexts.cctx != nullptr, false);
+	}
+
+	size_t compressed_size;
+	if (dictionary != nullptr) {
+		const ZSTD_CDict *cdict = dictionary->get_compression_dictionary(level);
+		ZN_ASSERT_RETURN_V(cdict != nullptr, false);
+		compressed_size = ZSTD_compress_usingCDict(
+				contexts.cctx, dst.data() + header_size, dst.size() - header_size, src.data(), src.size(), cdict
+		);
+	} else {
+		compressed_size = ZSTD_compressCCtx(
+				contexts.cctx, dst.data() + header_size, dst.size() - header_size, src.data(), src.size(), level
+		);
+	}
+
+	ZN_ASSERT_RETURN_V_MSG(
+			!ZSTD_isError(compressed_size),
+			false,
+			format("Zstd compression error: {}", ZSTD_getErrorName(compressed_size))
+	);
+
+	dst.resize(header_size + compressed_size);
+
+	return true;
+#else
+	ZN_PRINT_ERROR("Zstd compression is not available in this build");
+	return false;
+#endif
+}
+
 bool compress(Span<const uint8_t> src, StdVector<uint8_t> &dst, Compression comp) {
+	CompressionParams params;
+	params.compression = comp;
+	return compress(src, dst, params);
+}
+
+bool compress(Span<const uint8_t> src, StdVector<uint8_t> &dst, const CompressionParams &params) {
 	ZN_PROFILE_SCOPE();
 
+	const Compression comp = params.compression;
+
 	switch (comp) {
 		case COMPRESSION_NONE: {
 			dst.resize(src.size() + 1);
@@ -108,6 +370,13 @@ bool compress(Span<const uint8_t> src, StdVector<uint8_t> &dst, Compression comp
 			compress_lz4(f, src, dst);
 		} break;
 
+		case COMPRESSION_ZSTD: {
+			dst.clear();
+			MemoryWriter f(dst, ENDIANNESS_LITTLE_ENDIAN);
+			f.store_8(comp);
+			ZN_ASSERT_RETURN_V(compress_zstd(f, src, dst, params.zstd_level, params.zstd_dictionary.get()), false);
+		} break;
+
 		default:
 			ZN_PRINT_ERROR("Invalid compression header");
 			return false;
@@ -3,7 +3,12 @@
 
 #include "../util/containers/span.h"
 #include "../util/containers/std_vector.h"
+#include "../util/thread/mutex.h"
 #include <cstdint>
+#include <memory>
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
 
 namespace zylann::voxel::CompressedData {
 
@@ -23,11 +28,81 @@ enum Compression {
 	// All following bytes are compressed data using LZ4 defaults.
 	// This is the fastest compression format.
 	COMPRESSION_LZ4 = 2,
-	COMPRESSION_COUNT = 3
+	// The next uint32_t is the ID of the dictionary that was used (little endian), or 0 if none was used.
+	// All following bytes are a Zstandard frame, which embeds the size of decompressed data.
+	// Slower than LZ4, but compresses much better, especially small blocks when using a dictionary.
+	COMPRESSION_ZSTD = 3,
+	COMPRESSION_COUNT = 4
+};
+
+static const int ZSTD_MIN_LEVEL = 1;
+static const int ZSTD_MAX_LEVEL = 22;
+static const int ZSTD_DEFAULT_LEVEL = 3;
+
+// Zstandard is only available when the module is compiled with Godot, which already bundles it.
+bool is_zstd_supported();
+
+// Content that Zstandard can refer to when compressing many small pieces of data that are similar to each other.
+// Data compressed with a dictionary can only be decompressed with the same dictionary. Immutable once created, so it
+// can be shared between threads.
+class ZstdDictionary {
+public:
+	ZstdDictionary(Span<const uint8_t> content);
+	~ZstdDictionary();
+
+	ZstdDictionary(const ZstdDictionary &) = delete;
+	ZstdDictionary &operator=(const ZstdDictionary &) = delete;
+
+	// Builds a dictionary by concatenating the given samples (usually uncompressed serialized blocks), until
+	// `max_size` bytes are reached. Duplicate samples are skipped.
+	// Zstandard's proper dictionary trainer isn't part of the sources Godot bundles, so this is a "raw content"
+	// dictionary. It works well for voxel blocks, which often repeat exact byte sequences.
+	static std::shared_ptr<ZstdDictionary> create_from_samples(
+			Span<const StdVector<uint8_t>> samples,
+			unsigned int max_size
+	);
+
+	// Never 0. Stored in compressed data, so it can be checked when decompressing.
+	inline uint32_t get_id() const {
+		return _id;
+	}
+
+	inline Span<const uint8_t> get_content() const {
+		return to_span(_content);
+	}
+
+	static uint32_t compute_id(Span<const uint8_t> content);
+
+	// Internal use
+	const ZSTD_CDict_s *get_compression_dictionary(int level) const;
+	const ZSTD_DDict_s *get_decompression_dictionary() const;
+
+private:
+	uint32_t _id;
+	StdVector<uint8_t> _content;
+	ZSTD_DDict_s *_ddict = nullptr;
+	// Compression dictionaries depend on the compression level, there are usually one or two.
+	mutable StdVector<std::pair<int, ZSTD_CDict_s *>> _cdicts;
+	Mutex _cdicts_mutex;
+};
+
+struct CompressionParams {
+	Compression compression = COMPRESSION_LZ4;
+	// Only used with Zstandard
+	int zstd_level = ZSTD_DEFAULT_LEVEL;
+	// Only used with Zstandard. Can be null.
+	std::shared_ptr<ZstdDictionary> zstd_dictionary;
 };
 
 bool compress(Span<const uint8_t> src, StdVector<uint8_t> &dst, Compression comp);
-bool decompress(Span<const uint8_t> src, StdVector<uint8_t> &dst);
+bool compress(Span<const uint8_t> src, StdVector<uint8_t> &dst, const CompressionParams &params);
+
+// If the data was compressed with a dictionary, it must be in `zstd_dictionaries`.
+bool decompress(
+		Span<const uint8_t> src,
+		StdVector<uint8_t> &dst,
+		Span<const std::shared_ptr<ZstdDictionary>> zstd_dictionaries = Span<const std::shared_ptr<ZstdDictionary>>()
+);
 
 } // namespace zylann::voxel::CompressedData
 
@@ -0,0 +1,15 @@
+#include "flush_stream_task.h"
+#include "../util/errors.h"
+#include "../util/profiling.h"
+
+namespace zylann::voxel {
+
+FlushStreamTask::FlushStreamTask(Ref<VoxelStream> p_stream) : _stream(p_stream) {}
+
+void FlushStreamTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(_stream.is_valid());
+	_stream->flush();
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,27 @@
+#ifndef VOXEL_FLUSH_STREAM_TASK_H
+#define VOXEL_FLUSH_STREAM_TASK_H
+
+#include "../util/tasks/threaded_task.h"
+#include "voxel_stream.h"
+
+namespace zylann::voxel {
+
+// Flushes a stream in the background, so blocks it cached when saving get written without the saving thread having
+// to wait for it. Should be pushed as an I/O task.
+class FlushStreamTask : public IThreadedTask {
+public:
+	FlushStreamTask(Ref<VoxelStream> p_stream);
+
+	const char *get_debug_name() const override {
+		return "FlushStream";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+
+private:
+	Ref<VoxelStream> _stream;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_FLUSH_STREAM_TASK_H
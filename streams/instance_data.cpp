@@ -2,6 +2,7 @@
 #include "../constants/voxel_constants.h"
 #include "../util/io/serialization.h"
 #include "../util/math/basis.h"
+#include "../util/math/constants.h"
 #include "../util/math/funcs.h"
 #include "../util/string/format.h"
 
@@ -22,10 +23,6 @@ const float InstanceBlockData::SIMPLE_11B_V1_SCALE_RANGE_MINIMUM = 0.01f;
 
 // TODO Unify with functions from VoxelBuffer?
 
-inline uint8_t norm_to_u8(float x) {
-	return math::clamp(static_cast<int>(128.f * x + 128.f), 0, 0xff);
-}
-
 inline float u8_to_norm(uint8_t v) {
 	return (static_cast<real_t>(v) - 0x7f) * zylann::voxel::constants::INV_0x7f;
 }
@@ -36,15 +33,6 @@ struct CompressedQuaternion4b {
 	uint8_t z;
 	uint8_t w;
 
-	static CompressedQuaternion4b from_quaternion(Quaternionf q) {
-		CompressedQuaternion4b c;
-		c.x = norm_to_u8(q.x);
-		c.y = norm_to_u8(q.y);
-		c.z = norm_to_u8(q.z);
-		c.w = norm_to_u8(q.w);
-		return c;
-	}
-
 	Quaternionf to_quaternion() const {
 		Quaternionf q;
 		q.x = u8_to_norm(x);
@@ -55,8 +43,170 @@ struct CompressedQuaternion4b {
 	}
 };
 
-bool serialize_instance_block_data(const InstanceBlockData &src, StdVector<uint8_t> &dst) {
-	const uint8_t instance_format = InstanceBlockData::FORMAT_SIMPLE_11B_V1;
+namespace {
+
+// Smallest three: the largest component can be deduced from the 3 others, and their range is smaller
+struct CompressedQuaternion3c10b {
+	static constexpr uint32_t COMPONENT_MASK = InstanceBlockData::COMPACT_V1_QUAT_COMPONENT_RESOLUTION - 1;
+
+	static uint32_t encode(Quaternionf q) {
+		q = math::normalized(q);
+		const float components[4] = { q.x, q.y, q.z, q.w };
+
+		unsigned int largest_index = 0;
+		for (unsigned int i = 1; i < 4; ++i) {
+			if (Math::abs(components[i]) > Math::abs(components[largest_index])) {
+				largest_index = i;
+			}
+		}
+		// q and -q are the same rotation, so we can flip the sign to always have a positive largest component
+		const float sign = components[largest_index] < 0.f ? -1.f : 1.f;
+
+		uint32_t packed = largest_index << 30;
+		int shift = 20;
+		for (unsigned int i = 0; i < 4; ++i) {
+			if (i == largest_index) {
+				continue;
+			}
+			// Other components are in [-1/sqrt(2), 1/sqrt(2)]
+			const float n = sign * components[i] * (0.5f * math::SQRT2_32) + 0.5f;
+			const uint32_t v = math::clamp(static_cast<int>(Math::round(n * COMPONENT_MASK)), 0, int(COMPONENT_MASK));
+			packed |= v << shift;
+			shift -= 10;
+		}
+		return packed;
+	}
+
+	static Quaternionf decode(uint32_t packed) {
+		const unsigned int largest_index = packed >> 30;
+		float components[4];
+		float sum_squared = 0.f;
+		int shift = 20;
+		for (unsigned int i = 0; i < 4; ++i) {
+			if (i == largest_index) {
+				continue;
+			}
+			const uint32_t v = (packed >> shift) & COMPONENT_MASK;
+			const float c = (static_cast<float>(v) / COMPONENT_MASK - 0.5f) * math::SQRT2_32;
+			components[i] = c;
+			sum_squared += c * c;
+			shift -= 10;
+		}
+		components[largest_index] = Math::sqrt(math::max(1.f - sum_squared, 0.f));
+		return math::normalized(Quaternionf(components[0], components[1], components[2], components[3]));
+	}
+};
+
+void serialize_layer_compact_v1(
+		const InstanceBlockData::LayerData &layer,
+		float position_range,
+		float scale_min,
+		float scale_max,
+		float max_position_error,
+		StdVector<uint8_t> &dst
+) {
+	// Quantization rounds to the nearest value, so the error is at most half a step
+	const bool use_8bit_positions = max_position_error > 0.f && 0.5f * position_range / 0xff <= max_position_error;
+	const unsigned int position_bytes = use_8bit_positions ? 1 : 2;
+	const float position_max = use_8bit_positions ? 0xff : 0xffff;
+	dst.push_back(position_bytes * 8);
+
+	const size_t instance_count = layer.instances.size();
+	const size_t begin = dst.size();
+	dst.resize(begin + instance_count * (3 * position_bytes + 1 + 4));
+	uint8_t *planes = dst.data() + begin;
+
+	const float pos_norm_scale = position_max / position_range;
+	const float scale_norm_scale = 0xff / (scale_max - scale_min);
+
+	// Each loop writes separate planes, which is easier to vectorize than writing one instance at a time
+	for (unsigned int axis = 0; axis < 3; ++axis) {
+		uint8_t *low_bytes = planes;
+		uint8_t *high_bytes = planes + instance_count;
+		for (size_t i = 0; i < instance_count; ++i) {
+			const float p = layer.instances[i].transform.origin[axis] * pos_norm_scale;
+			const uint32_t v = math::clamp(static_cast<int>(Math::round(p)), 0, static_cast<int>(position_max));
+			low_bytes[i] = v & 0xff;
+			if (position_bytes == 2) {
+				high_bytes[i] = v >> 8;
+			}
+		}
+		planes += position_bytes * instance_count;
+	}
+
+	for (size_t i = 0; i < instance_count; ++i) {
+		const float scale = layer.instances[i].transform.basis.get_scale_abs().y;
+		planes[i] = math::clamp(static_cast<int>(Math::round((scale - scale_min) * scale_norm_scale)), 0, 0xff);
+	}
+	planes += instance_count;
+
+	for (size_t i = 0; i < instance_count; ++i) {
+		const Quaternionf q = layer.instances[i].transform.basis.get_rotation_quaternion();
+		const uint32_t cq = CompressedQuaternion3c10b::encode(q);
+		planes[i] = cq & 0xff;
+		planes[i + instance_count] = (cq >> 8) & 0xff;
+		planes[i + 2 * instance_count] = (cq >> 16) & 0xff;
+		planes[i + 3 * instance_count] = cq >> 24;
+	}
+}
+
+bool deserialize_layer_compact_v1(InstanceBlockData::LayerData &layer, float position_range, MemoryReader &r) {
+	const unsigned int position_bits = r.get_8();
+	ZN_ASSERT_RETURN_V_MSG(
+			position_bits == 8 || position_bits == 16, false, format("Unexpected position bits: {}", position_bits)
+	);
+	const unsigned int position_bytes = position_bits / 8;
+	const float position_max = position_bytes == 1 ? 0xff : 0xffff;
+
+	const size_t instance_count = layer.instances.size();
+	const size_t size = instance_count * (3 * position_bytes + 1 + 4);
+	ZN_ASSERT_RETURN_V_MSG(r.pos + size <= r.data.size(), false, "Instance data is truncated");
+	const uint8_t *planes = r.data.data() + r.pos;
+	r.pos += size;
+
+	const float pos_scale = position_range / position_max;
+	const float scale_range = layer.scale_max - layer.scale_min;
+
+	for (unsigned int axis = 0; axis < 3; ++axis) {
+		const uint8_t *low_bytes = planes;
+		const uint8_t *high_bytes = planes + instance_count;
+		for (size_t i = 0; i < instance_count; ++i) {
+			uint32_t v = low_bytes[i];
+			if (position_bytes == 2) {
+				v |= static_cast<uint32_t>(high_bytes[i]) << 8;
+			}
+			layer.instances[i].transform.origin[axis] = static_cast<float>(v) * pos_scale;
+		}
+		planes += position_bytes * instance_count;
+	}
+
+	const uint8_t *scales = planes;
+	const uint8_t *rotations = planes + instance_count;
+
+	for (size_t i = 0; i < instance_count; ++i) {
+		const float s = (static_cast<float>(scales[i]) / 0xff) * scale_range + layer.scale_min;
+
+		const uint32_t cq = static_cast<uint32_t>(rotations[i]) | //
+				(static_cast<uint32_t>(rotations[i + instance_count]) << 8) | //
+				(static_cast<uint32_t>(rotations[i + 2 * instance_count]) << 16) | //
+				(static_cast<uint32_t>(rotations[i + 3 * instance_count]) << 24);
+		const Quaternionf q = CompressedQuaternion3c10b::decode(cq);
+
+		InstanceBlockData::InstanceData &instance = layer.instances[i];
+		instance.transform.basis = Basis3f(q).scaled(s);
+	}
+
+	return true;
+}
+
+} // namespace
+
+bool serialize_instance_block_data(
+		const InstanceBlockData &src,
+		StdVector<uint8_t> &dst,
+		const float max_position_error
+) {
+	const uint8_t instance_format = InstanceBlockData::FORMAT_COMPACT_V1;
 
 	// TODO Apparently big-endian is dead
 	// I chose it originally to match "network byte order",
@@ -72,7 +222,6 @@ bool serialize_instance_block_data(const InstanceBlockData &src, StdVector<uint8
 
 	// TODO Introduce a margin to position coordinates, stuff can spawn offset from the ground.
 	// Or just compute the ranges
-	const float pos_norm_scale = 1.f / position_range;
 
 	for (size_t i = 0; i < src.layers.size(); ++i) {
 		const InstanceBlockData::LayerData &layer = src.layers[i];
@@ -92,25 +241,7 @@ bool serialize_instance_block_data(const InstanceBlockData &src, StdVector<uint8
 		w.store_float(scale_max);
 		w.store_8(instance_format);
 
-		const float scale_norm_scale = 1.f / (scale_max - scale_min);
-
-		for (size_t j = 0; j < layer.instances.size(); ++j) {
-			const InstanceBlockData::InstanceData &instance = layer.instances[j];
-
-			w.store_16(static_cast<uint16_t>(pos_norm_scale * instance.transform.origin.x * 0xffff));
-			w.store_16(static_cast<uint16_t>(pos_norm_scale * instance.transform.origin.y * 0xffff));
-			w.store_16(static_cast<uint16_t>(pos_norm_scale * instance.transform.origin.z * 0xffff));
-
-			const float scale = instance.transform.basis.get_scale_abs().y;
-			w.store_8(static_cast<uint8_t>(scale_norm_scale * (scale - scale_min) * 0xff));
-
-			const Quaternionf q = instance.transform.basis.get_rotation_quaternion();
-			const CompressedQuaternion4b cq = CompressedQuaternion4b::from_quaternion(q);
-			w.store_8(cq.x);
-			w.store_8(cq.y);
-			w.store_8(cq.z);
-			w.store_8(cq.w);
-		}
+		serialize_layer_compact_v1(layer, position_range, scale_min, scale_max, max_position_error, dst);
 	}
 
 	w.store_32(TRAILING_MAGIC);
@@ -120,7 +251,6 @@ bool serialize_instance_block_data(const InstanceBlockData &src, StdVector<uint8
 
 bool deserialize_instance_block_data(InstanceBlockData &dst, Span<const uint8_t> src) {
 	const uint8_t expected_version = INSTANCE_BLOCK_FORMAT_VERSION_1;
-	const uint8_t expected_instance_format = InstanceBlockData::FORMAT_SIMPLE_11B_V1;
 
 	zylann::MemoryReader r(src, zylann::ENDIANNESS_LITTLE_ENDIAN);
 
@@ -150,7 +280,16 @@ bool deserialize_instance_block_data(InstanceBlockData &dst, Span<const uint8_t>
 		const float scale_range = layer.scale_max - layer.scale_min;
 
 		const uint8_t instance_format = r.get_8();
-		ZN_ASSERT_RETURN_V(instance_format == expected_instance_format, false);
+
+		if (instance_format == InstanceBlockData::FORMAT_COMPACT_V1) {
+			ZN_ASSERT_RETURN_V(deserialize_layer_compact_v1(layer, dst.position_range, r), false);
+			continue;
+		}
+		ZN_ASSERT_RETURN_V_MSG(
+				instance_format == InstanceBlockData::FORMAT_SIMPLE_11B_V1,
+				false,
+				format("Unexpected instance format: {}", instance_format)
+		);
 
 		for (size_t j = 0; j < layer.instances.size(); ++j) {
 			const float x = (static_cast<float>(r.get_16()) / 0xffff) * dst.position_range;
@@ -28,7 +28,24 @@ struct InstanceBlockData {
 		// - uint8_t y;
 		// - uint8_t z;
 		// - uint8_t w;
-		FORMAT_SIMPLE_11B_V1 = 0
+		FORMAT_SIMPLE_11B_V1 = 0,
+
+		// Components of all instances are stored one after the other rather than one instance after the other, and
+		// multi-byte values are split into planes of their bytes (first all low bytes, then all high bytes). This
+		// makes data easier to compress, since similar bytes end up next to each other.
+		//
+		// - uint8_t position_bits; 8 or 16
+		// - uint8_t or uint16_t x[instance_count];
+		// - uint8_t or uint16_t y[instance_count];
+		// - uint8_t or uint16_t z[instance_count];
+		//
+		// Scale is uniform and is lossy-compressed to 256 values
+		// - uint8_t scale[instance_count];
+		//
+		// Rotation is a "smallest three" quaternion: the index of its largest component in the 2 highest bits, then its
+		// 3 other components quantized to 10 bits each, with the sign making the largest component positive
+		// - uint32_t rotation[instance_count];
+		FORMAT_COMPACT_V1 = 1
 	};
 
 	static const int POSITION_RESOLUTION = 65536;
@@ -40,6 +57,8 @@ struct InstanceBlockData {
 	// Because scale is quantized we need its range, but it cannot be zero so it may be clamped to this.
 	static const float SIMPLE_11B_V1_SCALE_RANGE_MINIMUM;
 
+	static const int COMPACT_V1_QUAT_COMPONENT_RESOLUTION = 1024;
+
 	struct LayerData {
 		uint16_t id;
 		float scale_min;
@@ -56,7 +75,13 @@ struct InstanceBlockData {
 	}
 };
 
-bool serialize_instance_block_data(const InstanceBlockData &src, StdVector<uint8_t> &dst);
+// Positions are saved with 16 bits of precision, unless `max_position_error` allows to use 8 bits. It is a distance
+// along each axis, in the same unit as instance positions.
+bool serialize_instance_block_data(
+		const InstanceBlockData &src,
+		StdVector<uint8_t> &dst,
+		const float max_position_error = 0.f
+);
 bool deserialize_instance_block_data(InstanceBlockData &dst, Span<const uint8_t> src);
 
 } // namespace zylann::voxel
@@ -1,12 +1,40 @@
 #include "load_all_blocks_data_task.h"
 #include "../engine/voxel_engine.h"
 #include "../storage/voxel_data.h"
+#include "../util/containers/std_vector.h"
 #include "../util/io/log.h"
+#include "../util/math/funcs.h"
 #include "../util/profiling.h"
 #include "../util/string/format.h"
 
 namespace zylann::voxel {
 
+namespace {
+
+// More parts than threads, so threads finishing early can pick up remaining work, and progress is less coarse
+const unsigned int PARTS_PER_THREAD = 4;
+
+void output_blocks(VolumeID volume_id, VoxelStream::FullLoadingResult &result) {
+	VoxelEngine &engine = VoxelEngine::get_singleton();
+
+	for (auto it = result.blocks.begin(); it != result.blocks.end(); ++it) {
+		VoxelStream::FullLoadingResult::Block &rb = *it;
+
+		VoxelEngine::BlockDataOutput o;
+		o.voxels = rb.voxels;
+		o.instances = std::move(rb.instances_data);
+		o.position = rb.position;
+		o.lod_index = rb.lod;
+		o.dropped = false;
+		o.max_lod_hint = false;
+		o.initial_load = true;
+
+		engine.push_volume_data_output(volume_id, o);
+	}
+}
+
+} // namespace
+
 void LoadAllBlocksDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	ZN_PROFILE_SCOPE();
 
@@ -14,6 +42,41 @@ void LoadAllBlocksDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	Ref<VoxelStream> stream = stream_dependency->stream;
 	CRASH_COND(stream.is_null());
 
+	const unsigned int thread_count = math::max(VoxelEngine::get_singleton().get_thread_count(), 1u);
+	const unsigned int max_part_count = thread_count * PARTS_PER_THREAD;
+	StdVector<VoxelStream::FullLoadingPart> parts;
+
+	if (stream->get_load_all_blocks_parts(max_part_count, parts)) {
+		if (parts.size() == 0) {
+			ZN_PRINT_VERBOSE(format("No blocks to load for volume {}", volume_id));
+			return;
+		}
+
+		_split_in_parts = true;
+
+		std::shared_ptr<LoadAllBlocksPartTask::Progress> progress =
+				make_shared_instance<LoadAllBlocksPartTask::Progress>();
+		progress->part_count = parts.size();
+
+		StdVector<IThreadedTask *> tasks;
+		tasks.reserve(parts.size());
+		for (const VoxelStream::FullLoadingPart &part : parts) {
+			LoadAllBlocksPartTask *task = ZN_NEW(LoadAllBlocksPartTask);
+			task->volume_id = volume_id;
+			task->stream_dependency = stream_dependency;
+			task->data = data;
+			task->part = part;
+			task->progress = progress;
+			tasks.push_back(task);
+		}
+
+		// Parts don't run in serial like other I/O tasks, so they can be decompressed in parallel
+		VoxelEngine::get_singleton().push_async_tasks(to_span(tasks));
+
+		ZN_PRINT_VERBOSE(format("Loading all blocks for volume {} in {} parts", volume_id, parts.size()));
+		return;
+	}
+
 	stream->load_all_blocks(_result);
 
 	ZN_PRINT_VERBOSE(format("Loaded {} blocks for volume {}", _result.blocks.size(), volume_id));
@@ -28,29 +91,16 @@ bool LoadAllBlocksDataTask::is_cancelled() {
 }
 
 void LoadAllBlocksDataTask::apply_result() {
+	if (_split_in_parts) {
+		// Parts will apply their own results
+		return;
+	}
 	if (VoxelEngine::get_singleton().is_volume_valid(volume_id)) {
 		// TODO Comparing pointer may not be guaranteed
 		// The request response must match the dependency it would have been requested with.
 		// If it doesn't match, we are no longer interested in the result.
 		if (stream_dependency->valid) {
-			VoxelEngine::VolumeCallbacks callbacks = VoxelEngine::get_singleton().get_volume_callbacks(volume_id);
-			ERR_FAIL_COND(callbacks.data_output_callback == nullptr);
-
-			for (auto it = _result.blocks.begin(); it != _result.blocks.end(); ++it) {
-				VoxelStream::FullLoadingResult::Block &rb = *it;
-
-				VoxelEngine::BlockDataOutput o;
-				o.voxels = rb.voxels;
-				o.instances = std::move(rb.instances_data);
-				o.position = rb.position;
-				o.lod_index = rb.lod;
-				o.dropped = false;
-				o.max_lod_hint = false;
-				o.initial_load = true;
-
-				callbacks.data_output_callback(callbacks.data, o);
-			}
-
+			output_blocks(volume_id, _result);
 			data->set_full_load_completed(true);
 		}
 
@@ -60,4 +110,45 @@ void LoadAllBlocksDataTask::apply_result() {
 	}
 }
 
-} // namespace zylann::voxel
\ No newline at end of file
+void LoadAllBlocksPartTask::run(zylann::ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+
+	CRASH_COND(stream_dependency == nullptr);
+	Ref<VoxelStream> stream = stream_dependency->stream;
+	CRASH_COND(stream.is_null());
+
+	stream->load_all_blocks_part(part, _result);
+}
+
+TaskPriority LoadAllBlocksPartTask::get_priority() {
+	return TaskPriority();
+}
+
+bool LoadAllBlocksPartTask::is_cancelled() {
+	return !stream_dependency->valid;
+}
+
+void LoadAllBlocksPartTask::apply_result() {
+	if (VoxelEngine::get_singleton().is_volume_valid(volume_id)) {
+		if (stream_dependency->valid) {
+			// Blocks are merged as parts complete, instead of waiting for all of them
+			output_blocks(volume_id, _result);
+
+			Progress &p = *progress;
+			++p.completed_part_count;
+			p.block_count += _result.blocks.size();
+
+			if (p.completed_part_count == p.part_count) {
+				ZN_PRINT_VERBOSE(format("Loaded {} blocks for volume {}", p.block_count, volume_id));
+				data->set_full_load_completed(true);
+			} else {
+				data->set_full_load_progress(static_cast<float>(p.completed_part_count) / p.part_count);
+			}
+		}
+
+	} else {
+		ZN_PRINT_VERBOSE("Stream data request response came back but volume wasn't found");
+	}
+}
+
+} // namespace zylann::voxel
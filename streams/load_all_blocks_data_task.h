@@ -1,6 +1,7 @@
 #ifndef LOAD_ALL_BLOCKS_DATA_TASK_H
 #define LOAD_ALL_BLOCKS_DATA_TASK_H
 
+#include "../constants/voxel_constants.h"
 #include "../engine/ids.h"
 #include "../engine/streaming_dependency.h"
 #include "../util/tasks/threaded_task.h"
@@ -10,12 +11,50 @@ namespace zylann::voxel {
 
 class VoxelData;
 
+// Loads all blocks of a stream into a volume. If the stream supports it, the work is split into parts loaded by
+// `LoadAllBlocksPartTask`s, so decompression can run on multiple threads.
 class LoadAllBlocksDataTask : public IThreadedTask {
 public:
 	const char *get_debug_name() const override {
 		return "LoadAllBlocksData";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_STREAMING;
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+	TaskPriority get_priority() override;
+	bool is_cancelled() override;
+	void apply_result() override;
+
+	VolumeID volume_id;
+	std::shared_ptr<StreamingDependency> stream_dependency;
+	std::shared_ptr<VoxelData> data;
+
+private:
+	VoxelStream::FullLoadingResult _result;
+	// When loading was split into parts, results are applied by each part
+	bool _split_in_parts = false;
+};
+
+class LoadAllBlocksPartTask : public IThreadedTask {
+public:
+	// Shared between all parts of the same loading. Only accessed on the main thread.
+	struct Progress {
+		unsigned int part_count = 0;
+		unsigned int completed_part_count = 0;
+		unsigned int block_count = 0;
+	};
+
+	const char *get_debug_name() const override {
+		return "LoadAllBlocksPart";
+	}
+
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_STREAMING;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 	TaskPriority get_priority() override;
 	bool is_cancelled() override;
@@ -24,6 +63,8 @@ public:
 	VolumeID volume_id;
 	std::shared_ptr<StreamingDependency> stream_dependency;
 	std::shared_ptr<VoxelData> data;
+	VoxelStream::FullLoadingPart part;
+	std::shared_ptr<Progress> progress;
 
 private:
 	VoxelStream::FullLoadingResult _result;
@@ -30,10 +30,14 @@ LoadBlockDataTask::LoadBlockDataTask(VolumeID p_volume_id, Vector3i p_block_pos,
 		_cancellation_token(cancellation_token) {
 	//
 	++g_debug_load_block_tasks_count;
+	_batch_request_id = _stream_dependency->load_batcher.add_request(_position, _lod_index, _block_size);
 }
 
 LoadBlockDataTask::~LoadBlockDataTask() {
 	--g_debug_load_block_tasks_count;
+	_stream_dependency->load_batcher.remove_request(_batch_request_id);
+	// In case the task got cancelled before decoding
+	_stream_dependency->encoded_bytes_in_flight -= _encoded_voxels.size();
 }
 
 int LoadBlockDataTask::debug_get_running_count() {
@@ -48,23 +52,37 @@ void LoadBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	Ref<VoxelStream> stream = _stream_dependency->stream;
 	CRASH_COND(stream.is_null());
 
+	if (_decoding) {
+		run_decode_stage(*stream);
+		return;
+	}
+
 	ERR_FAIL_COND(_voxels != nullptr);
-	_voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
-	_voxels->create(_block_size, _block_size, _block_size);
 
-	// TODO We should consider batching this again, but it needs to be done carefully.
-	// Each task is one block, and priority depends on distance to closest viewer.
-	// If we batch blocks, we have to do it by distance too.
+	const bool encoded = stream->supports_encoded_voxel_blocks();
+	if (encoded && _stream_dependency->is_encoded_bytes_budget_exceeded()) {
+		// Wait for decoding to catch up, instead of piling up encoded voxels in memory
+		ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+		return;
+	}
+
+	// Each task is one block, and priority depends on distance to the closest viewer. Pending blocks closest to this
+	// one are loaded in the same call, so they are likely to be needed soon too. If this block was already loaded in
+	// the batch of another task, the result is just picked up.
 
 	// TODO Assign max_lod_hint when available
 
-	VoxelStream::VoxelQueryData voxel_query_data{ *_voxels, _position, _lod_index, VoxelStream::RESULT_ERROR };
-	stream->load_voxel_block(voxel_query_data);
+	VoxelStream::ResultCode result = VoxelStream::RESULT_ERROR;
+	_voxels = _stream_dependency->load_batcher.load(
+			**stream, _batch_request_id, result, encoded ? &_encoded_voxels : nullptr
+	);
+	ERR_FAIL_COND(_voxels == nullptr);
+	_stream_dependency->encoded_bytes_in_flight += _encoded_voxels.size();
 
-	if (voxel_query_data.result == VoxelStream::RESULT_ERROR) {
+	if (result == VoxelStream::RESULT_ERROR) {
 		ERR_PRINT("Error loading voxel block");
 
-	} else if (voxel_query_data.result == VoxelStream::RESULT_BLOCK_NOT_FOUND) {
+	} else if (result == VoxelStream::RESULT_BLOCK_NOT_FOUND) {
 		if (_generate_cache_data) {
 			Ref<VoxelGenerator> generator = _stream_dependency->generator;
 
@@ -107,13 +125,34 @@ void LoadBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 		if (instances_query.result == VoxelStream::RESULT_ERROR) {
 			ERR_PRINT("Error loading instance block");
 
-		} else if (voxel_query_data.result == VoxelStream::RESULT_BLOCK_FOUND) {
+		} else if (result == VoxelStream::RESULT_BLOCK_FOUND) {
 			_instances = std::move(instances_query.data);
 		}
 		// If not found, instances will return null,
 		// which means it can be generated by the instancer after the meshing process
 	}
 
+	if (_encoded_voxels.size() > 0) {
+		// Decoding voxels is CPU-heavy, it shouldn't hold up the thread doing I/O
+		_decoding = true;
+		ctx.status = ThreadedTaskContext::STATUS_TAKEN_OUT;
+		VoxelEngine::get_singleton().push_async_task(this);
+		return;
+	}
+
+	_has_run = true;
+}
+
+void LoadBlockDataTask::run_decode_stage(VoxelStream &stream) {
+	ZN_PROFILE_SCOPE();
+
+	if (!stream.decode_voxel_block(to_span_const(_encoded_voxels), *_voxels)) {
+		ERR_PRINT("Error decoding voxel block");
+	}
+
+	_stream_dependency->encoded_bytes_in_flight -= _encoded_voxels.size();
+	_encoded_voxels.clear();
+
 	_has_run = true;
 }
 
@@ -151,9 +190,7 @@ void LoadBlockDataTask::apply_result() {
 			o.initial_load = false;
 			o.type = VoxelEngine::BlockDataOutput::TYPE_LOADED;
 
-			VoxelEngine::VolumeCallbacks callbacks = VoxelEngine::get_singleton().get_volume_callbacks(_volume_id);
-			CRASH_COND(callbacks.data_output_callback == nullptr);
-			callbacks.data_output_callback(callbacks.data, o);
+			VoxelEngine::get_singleton().push_volume_data_output(_volume_id, o);
 		}
 
 	} else {
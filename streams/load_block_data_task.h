@@ -1,6 +1,7 @@
 #ifndef LOAD_BLOCK_DATA_TASK_H
 #define LOAD_BLOCK_DATA_TASK_H
 
+#include "../constants/voxel_constants.h"
 #include "../engine/ids.h"
 #include "../engine/priority_dependency.h"
 #include "../engine/streaming_dependency.h"
@@ -24,6 +25,10 @@ public:
 		return "LoadBlockData";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_STREAMING;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 	TaskPriority get_priority() override;
 	bool is_cancelled() override;
@@ -32,14 +37,20 @@ public:
 	static int debug_get_running_count();
 
 private:
+	void run_decode_stage(VoxelStream &stream);
+
 	PriorityDependency _priority_dependency;
 	std::shared_ptr<VoxelBuffer> _voxels;
+	// When the stream supports encoded voxels, they are loaded in an I/O thread and decoded in the general pool
+	StdVector<uint8_t> _encoded_voxels;
 	UniquePtr<InstanceBlockData> _instances;
 	Vector3i _position; // In data blocks of the specified lod
 	VolumeID _volume_id;
 	uint8_t _lod_index;
 	uint8_t _block_size;
+	uint32_t _batch_request_id;
 	bool _has_run = false;
+	bool _decoding = false;
 	bool _too_far = false;
 	bool _request_instances = false;
 	// bool _request_voxels = false;
@@ -1,8 +1,12 @@
 #include "region_file.h"
 #include "../../streams/voxel_block_serializer.h"
+#include "../../util/godot/classes/directory.h"
+#include "../../util/godot/classes/project_settings.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/godot/core/string.h"
 #include "../../util/io/log.h"
+#include "../../util/io/serialization.h"
+#include "../../util/math/morton.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "file_utils.h"
@@ -34,11 +38,11 @@ bool RegionFormat::validate() const {
 	ERR_FAIL_COND_V(block_size_po2 <= 0, false);
 
 	// Test worst case limits (this does not include arbitrary metadata, so it can't be 100% accurrate...)
+	const Vector3i block_size = Vector3iUtil::create(1 << block_size_po2);
 	size_t bytes_per_block = 0;
 	for (unsigned int i = 0; i < channel_depths.size(); ++i) {
-		bytes_per_block += VoxelBuffer::get_depth_bit_count(channel_depths[i]) / 8;
+		bytes_per_block += VoxelBuffer::get_size_in_bytes_for_volume(block_size, channel_depths[i]);
 	}
-	bytes_per_block *= Vector3iUtil::get_volume_u64(Vector3iUtil::create(1 << block_size_po2));
 	const size_t sectors_per_block = (bytes_per_block - 1) / sector_size + 1;
 	ERR_FAIL_COND_V(sectors_per_block > RegionBlockInfo::MAX_SECTOR_COUNT, false);
 	const size_t max_potential_sectors = Vector3iUtil::get_volume_u64(region_size) * sectors_per_block;
@@ -198,7 +202,7 @@ RegionFile::~RegionFile() {
 	close();
 }
 
-Error RegionFile::open(const String &fpath, bool create_if_not_found) {
+Error RegionFile::open(const String &fpath, bool create_if_not_found, const Header *known_header) {
 	close();
 
 	_file_path = fpath;
@@ -234,13 +238,20 @@ Error RegionFile::open(const String &fpath, bool create_if_not_found) {
 		}
 	} else {
 		CRASH_COND(f.is_null());
-		const Error header_error = load_header(**f);
-		if (header_error != OK) {
-			return header_error;
+		if (known_header != nullptr && known_header->version == FORMAT_VERSION) {
+			_header = *known_header;
+			_blocks_begin_offset = get_header_size_v3(_header.format);
+		} else {
+			const Error header_error = load_header(**f);
+			if (header_error != OK) {
+				return header_error;
+			}
 		}
 	}
 
 	_file_access = f;
+	_mapped_file_outdated = true;
+	_async_reader_outdated = true;
 
 	// Precalculate location of sectors and which block they contain.
 	// This will be useful to know when sectors get moved on insertion and removal
@@ -299,6 +310,8 @@ Error RegionFile::close() {
 		}
 		_file_access.unref();
 	}
+	_mapped_file.close();
+	_async_reader.close();
 	_sectors.clear();
 	return err;
 }
@@ -363,13 +376,24 @@ Error RegionFile::load_block(Vector3i position, VoxelBuffer &out_block) {
 	const unsigned int sector_index = block_info.get_sector_index();
 	const unsigned int block_begin = _blocks_begin_offset + sector_index * _header.format.sector_size;
 
+	if (_memory_mapped_reads_enabled) {
+		const MemoryMappedFile *mf = get_mapped_file();
+		if (mf != nullptr) {
+			const Error err = load_block_from_memory(mf->get_data(), block_begin, out_block);
+			ERR_FAIL_COND_V_MSG(err != OK, err, String("Failed to read block {0}").format(varray(position)));
+			return OK;
+		}
+	}
+
 	f.seek(block_begin);
 
 	unsigned int block_data_size = f.get_32();
 	CRASH_COND(f.eof_reached());
 
 	ERR_FAIL_COND_V_MSG(
-			!BlockSerializer::decompress_and_deserialize(f, block_data_size, out_block),
+			!BlockSerializer::decompress_and_deserialize(
+					f, block_data_size, out_block, to_span_const(_zstd_dictionaries)
+			),
 			ERR_PARSE_ERROR,
 			String("Failed to read block {0}").format(varray(position))
 	);
@@ -377,6 +401,209 @@ Error RegionFile::load_block(Vector3i position, VoxelBuffer &out_block) {
 	return OK;
 }
 
+void RegionFile::set_memory_mapped_reads_enabled(bool enabled) {
+	_memory_mapped_reads_enabled = enabled;
+	if (!enabled) {
+		_mapped_file.close();
+		_mapped_file_outdated = true;
+	}
+}
+
+void RegionFile::set_compression_params(const CompressedData::CompressionParams &params) {
+	_compression_params = params;
+}
+
+void RegionFile::set_zstd_dictionaries(
+		const StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> &dictionaries
+) {
+	_zstd_dictionaries = dictionaries;
+}
+
+const MemoryMappedFile *RegionFile::get_mapped_file() {
+	if (_mapped_file_outdated) {
+		ZN_PROFILE_SCOPE_NAMED("Map region file");
+		_mapped_file_outdated = false;
+		_mapped_file.close();
+		if (!MemoryMappedFile::is_supported()) {
+			return nullptr;
+		}
+		// Pending writes must reach the OS before the mapping can see them
+		_file_access->flush();
+		// Files inside exported packs can't be mapped, in which case we'll fallback on regular reads
+		const String os_path = ProjectSettings::get_singleton()->globalize_path(_file_path);
+		_mapped_file.open(zylann::godot::to_std_string(os_path).c_str());
+	}
+	return _mapped_file.is_open() ? &_mapped_file : nullptr;
+}
+
+Error RegionFile::load_block_from_memory(Span<const uint8_t> file_data, size_t block_begin, VoxelBuffer &out_block)
+		const {
+	ERR_FAIL_COND_V(block_begin + sizeof(uint32_t) > file_data.size(), ERR_FILE_CORRUPT);
+
+	// `FileAccess` uses little-endian by default
+	MemoryReader reader(file_data.sub(block_begin, sizeof(uint32_t)), ENDIANNESS_LITTLE_ENDIAN);
+	const uint32_t block_data_size = reader.get_32();
+
+	const size_t data_begin = block_begin + sizeof(uint32_t);
+	ERR_FAIL_COND_V(data_begin + block_data_size > file_data.size(), ERR_FILE_CORRUPT);
+
+	// Decompress straight from memory
+	ERR_FAIL_COND_V(
+			!BlockSerializer::decompress_and_deserialize(
+					file_data.sub(data_begin, block_data_size), out_block, to_span_const(_zstd_dictionaries)
+			),
+			ERR_PARSE_ERROR
+	);
+	return OK;
+}
+
+void RegionFile::set_async_reads_enabled(bool enabled) {
+	_async_reads_enabled = enabled;
+	if (!enabled) {
+		_async_reader.close();
+		_async_reader_outdated = true;
+	}
+}
+
+const AsyncFileReader *RegionFile::get_async_reader() {
+	if (_async_reader_outdated) {
+		_async_reader_outdated = false;
+		_async_reader.close();
+		if (!AsyncFileReader::is_supported()) {
+			return nullptr;
+		}
+		// Files inside exported packs can't be opened by the OS, in which case we'll fallback on regular reads
+		const String os_path = ProjectSettings::get_singleton()->globalize_path(_file_path);
+		_async_reader.open(zylann::godot::to_std_string(os_path).c_str());
+	}
+	return _async_reader.is_open() ? &_async_reader : nullptr;
+}
+
+void RegionFile::load_blocks(
+		Span<const Vector3i> positions,
+		Span<VoxelBuffer *const> out_blocks,
+		Span<Error> out_errors
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(positions.size() == out_blocks.size());
+	ZN_ASSERT_RETURN(positions.size() == out_errors.size());
+
+	if (_async_reads_enabled && _file_access.is_valid() && positions.size() > 1 &&
+		!(_memory_mapped_reads_enabled && get_mapped_file() != nullptr)) {
+		const AsyncFileReader *reader = get_async_reader();
+		if (reader != nullptr) {
+			load_blocks_async(*reader, positions, out_blocks, out_errors);
+			return;
+		}
+	}
+
+	for (unsigned int i = 0; i < positions.size(); ++i) {
+		out_errors[i] = load_block(positions[i], *out_blocks[i]);
+	}
+}
+
+void RegionFile::load_blocks_async(
+		const AsyncFileReader &reader,
+		Span<const Vector3i> positions,
+		Span<VoxelBuffer *const> out_blocks,
+		Span<Error> out_errors
+) {
+	ZN_PROFILE_SCOPE();
+
+	StdVector<AsyncFileReader::Request> requests;
+	// Index of the block each request is reading
+	StdVector<unsigned int> request_block_indices;
+	size_t total_size = 0;
+
+	for (unsigned int i = 0; i < positions.size(); ++i) {
+		const Vector3i position = positions[i];
+		if (!is_valid_block_position(position)) {
+			ZN_PRINT_ERROR("Invalid block position");
+			out_errors[i] = ERR_INVALID_PARAMETER;
+			continue;
+		}
+		const RegionBlockInfo &block_info = _header.blocks[get_block_index_in_header(position)];
+		if (block_info.data == 0) {
+			out_errors[i] = ERR_DOES_NOT_EXIST;
+			continue;
+		}
+
+		VoxelBuffer &out_block = *out_blocks[i];
+		for (unsigned int channel_index = 0; channel_index < _header.format.channel_depths.size(); ++channel_index) {
+			out_block.set_channel_depth(channel_index, _header.format.channel_depths[channel_index]);
+		}
+
+		// Blocks always occupy whole sectors, so we read them entirely. The exact size is at the beginning.
+		AsyncFileReader::Request request;
+		request.offset = _blocks_begin_offset + block_info.get_sector_index() * _header.format.sector_size;
+		request.size = block_info.get_sector_count() * _header.format.sector_size;
+		// Using the offset for now, the buffer is allocated once all sizes are known
+		request.buffer = nullptr;
+		requests.push_back(request);
+		request_block_indices.push_back(i);
+
+		total_size += request.size;
+	}
+
+	if (requests.size() == 0) {
+		return;
+	}
+
+	StdVector<uint8_t> buffer;
+	buffer.resize(total_size);
+	size_t buffer_offset = 0;
+	for (AsyncFileReader::Request &request : requests) {
+		request.buffer = buffer.data() + buffer_offset;
+		buffer_offset += request.size;
+	}
+
+	// Pending writes must reach the OS before another handle can see them
+	_file_access->flush();
+
+	struct Context {
+		const RegionFile *self;
+		Span<const AsyncFileReader::Request> requests;
+		Span<const unsigned int> request_block_indices;
+		Span<const Vector3i> positions;
+		Span<VoxelBuffer *const> out_blocks;
+		Span<Error> out_errors;
+	};
+
+	Context context;
+	context.self = this;
+	context.requests = to_span_const(requests);
+	context.request_block_indices = to_span_const(request_block_indices);
+	context.positions = positions;
+	context.out_blocks = out_blocks;
+	context.out_errors = out_errors;
+
+	// Blocks get decompressed while other reads are still in progress
+	reader.read_batch(
+			context.requests,
+			&context,
+			[](void *callback_data, unsigned int request_index, int64_t read_size) {
+				const Context &ctx = *static_cast<const Context *>(callback_data);
+				const unsigned int block_index = ctx.request_block_indices[request_index];
+				const Vector3i position = ctx.positions[block_index];
+				Error &err = ctx.out_errors[block_index];
+
+				if (read_size < 0) {
+					ERR_PRINT(String("Failed to read block {0}").format(varray(position)));
+					err = ERR_FILE_CANT_READ;
+					return;
+				}
+
+				const AsyncFileReader::Request &request = ctx.requests[request_index];
+				err = ctx.self->load_block_from_memory(
+						Span<const uint8_t>(request.buffer, read_size), 0, *ctx.out_blocks[block_index]
+				);
+				if (err != OK) {
+					ERR_PRINT(String("Failed to read block {0}").format(varray(position)));
+				}
+			}
+	);
+}
+
 Error RegionFile::save_block(Vector3i position, VoxelBuffer &block) {
 	ERR_FAIL_COND_V(_header.format.verify_block(block) == false, ERR_INVALID_PARAMETER);
 	ERR_FAIL_COND_V(!is_valid_block_position(position), ERR_INVALID_PARAMETER);
@@ -384,6 +611,8 @@ Error RegionFile::save_block(Vector3i position, VoxelBuffer &block) {
 	ERR_FAIL_COND_V(_file_access == nullptr, ERR_FILE_CANT_WRITE);
 	FileAccess &f = **_file_access;
 
+	_mapped_file_outdated = true;
+
 	// We should be allowed to migrate before write operations
 	if (_header.version != FORMAT_VERSION) {
 		ERR_FAIL_COND_V(migrate_to_latest(f) == false, ERR_UNAVAILABLE);
@@ -402,7 +631,7 @@ Error RegionFile::save_block(Vector3i position, VoxelBuffer &block) {
 		// Check position matches the sectors rule
 		CRASH_COND((block_offset - _blocks_begin_offset) % _header.format.sector_size != 0);
 
-		BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(block);
+		BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(block, _compression_params);
 		ERR_FAIL_COND_V(!res.success, ERR_INVALID_PARAMETER);
 		f.store_32(res.data.size());
 		const unsigned int written_size = sizeof(uint32_t) + res.data.size();
@@ -434,7 +663,7 @@ Error RegionFile::save_block(Vector3i position, VoxelBuffer &block) {
 		const int old_sector_count = block_info.get_sector_count();
 		CRASH_COND(old_sector_count < 1);
 
-		BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(block);
+		BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(block, _compression_params);
 		ERR_FAIL_COND_V(!res.success, ERR_INVALID_PARAMETER);
 		const StdVector<uint8_t> &data = res.data;
 		const size_t written_size = sizeof(uint32_t) + data.size();
@@ -584,6 +813,126 @@ void RegionFile::remove_sectors_from_block(Vector3i block_pos, unsigned int p_se
 	}
 }
 
+Error RegionFile::compact(bool recompress, uint64_t *out_saved_bytes) {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND_V(_file_access == nullptr, ERR_FILE_CANT_WRITE);
+	FileAccess &src = **_file_access;
+
+	// We should be allowed to migrate before write operations
+	if (_header.version != FORMAT_VERSION) {
+		ERR_FAIL_COND_V(migrate_to_latest(src) == false, ERR_UNAVAILABLE);
+	}
+	// The current file remains in use if compaction fails, so it must be up to date
+	if (_header_modified) {
+		ERR_FAIL_COND_V(!save_header(src), ERR_FILE_CANT_WRITE);
+	}
+
+	// Blocks close to each other in space end up close to each other in the file, so loading an area reads the file
+	// more sequentially
+	struct BlockRef {
+		uint32_t morton_index;
+		unsigned int header_index;
+	};
+	StdVector<BlockRef> blocks;
+	for (unsigned int i = 0; i < _header.blocks.size(); ++i) {
+		if (_header.blocks[i].data != 0) {
+			blocks.push_back(BlockRef{ math::encode_morton_3d(get_block_position_from_index(i)), i });
+		}
+	}
+	std::sort(blocks.begin(), blocks.end(), [](const BlockRef &a, const BlockRef &b) { //
+		return a.morton_index < b.morton_index;
+	});
+
+	// The new file is written next to the current one, which is only replaced once the new one is complete
+	const String temp_file_path = _file_path + ".tmp";
+	Error file_error;
+	Ref<FileAccess> dst_ref = zylann::godot::open_file(temp_file_path, FileAccess::WRITE_READ, file_error);
+	ERR_FAIL_COND_V_MSG(
+			file_error != OK, file_error, String("Failed to create file {0}").format(varray(temp_file_path))
+	);
+	FileAccess &dst = **dst_ref;
+
+	StdVector<RegionBlockInfo> new_block_infos;
+	new_block_infos.resize(_header.blocks.size());
+	// Written a first time to reserve space, and a second time when sectors are known
+	ERR_FAIL_COND_V(!save_header(dst, _header.version, _header.format, new_block_infos), ERR_FILE_CANT_WRITE);
+	ERR_FAIL_COND_V(dst.get_position() != _blocks_begin_offset, ERR_BUG);
+
+	StdVector<Vector3u16> new_sectors;
+	StdVector<uint8_t> data;
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+	if (recompress) {
+		voxels.create(Vector3iUtil::create(1 << _header.format.block_size_po2));
+	}
+
+	for (const BlockRef &block : blocks) {
+		const RegionBlockInfo block_info = _header.blocks[block.header_index];
+		const Vector3i position = get_block_position_from_index(block.header_index);
+
+		if (recompress) {
+			const Error load_error = load_block(position, voxels);
+			ERR_FAIL_COND_V(load_error != OK, load_error);
+			BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(voxels, _compression_params);
+			ERR_FAIL_COND_V(!res.success, ERR_INVALID_DATA);
+			data = std::move(res.data);
+
+		} else {
+			// Copy compressed data as-is
+			src.seek(_blocks_begin_offset + block_info.get_sector_index() * _header.format.sector_size);
+			const uint32_t data_size = src.get_32();
+			ERR_FAIL_COND_V(
+					data_size + sizeof(uint32_t) > block_info.get_sector_count() * _header.format.sector_size,
+					ERR_FILE_CORRUPT
+			);
+			data.resize(data_size);
+			ERR_FAIL_COND_V(zylann::godot::get_buffer(src, to_span(data)) != data_size, ERR_FILE_CORRUPT);
+		}
+
+		const uint32_t written_size = sizeof(uint32_t) + data.size();
+		const uint32_t sector_count = get_sector_count_from_bytes(written_size);
+		ERR_FAIL_COND_V(sector_count > RegionBlockInfo::MAX_SECTOR_COUNT, ERR_INVALID_DATA);
+
+		dst.store_32(data.size());
+		zylann::godot::store_buffer(dst, to_span(data));
+		pad_to_sector_size(dst);
+
+		RegionBlockInfo &new_block_info = new_block_infos[block.header_index];
+		new_block_info.set_sector_index(new_sectors.size());
+		new_block_info.set_sector_count(sector_count);
+		for (unsigned int i = 0; i < sector_count; ++i) {
+			new_sectors.push_back(Vector3u16(position));
+		}
+	}
+
+	ERR_FAIL_COND_V(!save_header(dst, _header.version, _header.format, new_block_infos), ERR_FILE_CANT_WRITE);
+	dst.flush();
+	const uint64_t new_size = _blocks_begin_offset + new_sectors.size() * _header.format.sector_size;
+	const uint64_t old_size = src.get_length();
+	dst_ref.unref();
+
+	// Replace the current file. It can't be open while doing this on some platforms.
+	_file_access.unref();
+	_mapped_file.close();
+	_async_reader.close();
+
+	Ref<DirAccess> da = zylann::godot::open_directory(_file_path.get_base_dir());
+	const Error rename_error = da.is_valid() ? da->rename(temp_file_path, _file_path) : ERR_CANT_OPEN;
+
+	// Reopen whichever file is now at the expected path, so the region remains usable even if renaming failed
+	const Error open_error = open(_file_path, false);
+	ERR_FAIL_COND_V_MSG(
+			rename_error != OK,
+			rename_error,
+			String("Failed to rename {0} to {1}").format(varray(temp_file_path, _file_path))
+	);
+	ERR_FAIL_COND_V(open_error != OK, open_error);
+
+	if (out_saved_bytes != nullptr) {
+		*out_saved_bytes = old_size > new_size ? old_size - new_size : 0;
+	}
+	return OK;
+}
+
 bool RegionFile::save_header(FileAccess &f) {
 	// We should be allowed to migrate before write operations.
 	if (_header.version != FORMAT_VERSION) {
@@ -621,6 +970,7 @@ bool RegionFile::migrate_from_v2_to_v3(FileAccess &f, RegionFormat &format) {
 
 bool RegionFile::migrate_to_latest(FileAccess &f) {
 	ERR_FAIL_COND_V(_file_path.is_empty(), false);
+	_mapped_file_outdated = true;
 
 	uint8_t version = _header.version;
 
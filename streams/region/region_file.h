@@ -5,8 +5,11 @@
 #include "../../util/containers/fixed_array.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/classes/file_access.h"
+#include "../../util/io/async_file_reader.h"
+#include "../../util/io/memory_mapped_file.h"
 #include "../../util/math/color8.h"
 #include "../../util/math/vector3i.h"
+#include "../compressed_data.h"
 
 namespace zylann::voxel {
 
@@ -68,14 +71,28 @@ static_assert(sizeof(RegionBlockInfo) == 4, "Data in this struct must have a con
 //
 // This is a stream implementation, where the file handle remains in use for read and write and only keeps a fraction
 // of data in memory.
+// Reads can optionally use a memory-mapped view of the file, so compressed blocks are decompressed directly from the
+// OS page cache instead of being copied first. Writes always go through the file handle.
+// Alternatively, reads of several blocks can be submitted to the OS all at once, see `load_blocks`.
 // It isn't thread-safe.
 //
 class RegionFile {
 public:
+	struct Header {
+		uint8_t version = -1;
+		RegionFormat format;
+		// Location and size of blocks, indexed by flat position.
+		// This table always has the same size,
+		// and the same index always corresponds to the same 3D position.
+		StdVector<RegionBlockInfo> blocks;
+	};
+
 	RegionFile();
 	~RegionFile();
 
-	Error open(const String &fpath, bool create_if_not_found);
+	// If `known_header` is provided, it is used instead of reading the header of the file, which must not have changed
+	// since that header was obtained with `get_header`. It is ignored if the file has to be created.
+	Error open(const String &fpath, bool create_if_not_found, const Header *known_header = nullptr);
 	Error close();
 	bool is_open() const;
 	void flush();
@@ -83,9 +100,43 @@ public:
 	bool set_format(const RegionFormat &format);
 	const RegionFormat &get_format() const;
 
+	// When enabled, blocks are read from a memory mapping of the file if the platform supports it. `FileAccess` is used
+	// as fallback, for example with files that are packed in exported games.
+	void set_memory_mapped_reads_enabled(bool enabled);
+
+	inline bool is_memory_mapped_reads_enabled() const {
+		return _memory_mapped_reads_enabled;
+	}
+
+	// When enabled, `load_blocks` submits reads of all requested blocks at once using asynchronous I/O, and
+	// decompresses them as they complete. Not used if reads are already memory-mapped.
+	void set_async_reads_enabled(bool enabled);
+
+	inline bool is_async_reads_enabled() const {
+		return _async_reads_enabled;
+	}
+
+	// Compression used when saving blocks. Blocks already in the file are read regardless of how they were compressed.
+	void set_compression_params(const CompressedData::CompressionParams &params);
+
+	// Dictionaries that blocks compressed with Zstd may refer to.
+	void set_zstd_dictionaries(const StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> &dictionaries);
+
 	Error load_block(Vector3i position, VoxelBuffer &out_block);
+	// Loads several blocks at once. Errors are reported per block, the same way as `load_block`.
+	void load_blocks(Span<const Vector3i> positions, Span<VoxelBuffer *const> out_blocks, Span<Error> out_errors);
 	Error save_block(Vector3i position, VoxelBuffer &block);
 
+	// Rewrites the file with blocks stored in Morton order of their positions and without unused sectors.
+	// If `recompress` is true, blocks are also decompressed and compressed again with current compression params.
+	// The file is written to a temporary path and replaces the current one only once complete.
+	Error compact(bool recompress, uint64_t *out_saved_bytes = nullptr);
+
+	// Up to date with changes made while the file is open, and still valid after closing it
+	const Header &get_header() const {
+		return _header;
+	}
+
 	unsigned int get_header_block_count() const;
 	bool has_block(Vector3i position) const;
 	bool has_block(unsigned int index) const;
@@ -105,18 +156,20 @@ private:
 	void pad_to_sector_size(FileAccess &f);
 	void remove_sectors_from_block(Vector3i block_pos, unsigned int p_sector_count);
 
+	const MemoryMappedFile *get_mapped_file();
+	Error load_block_from_memory(Span<const uint8_t> file_data, size_t block_begin, VoxelBuffer &out_block) const;
+
+	const AsyncFileReader *get_async_reader();
+	void load_blocks_async(
+			const AsyncFileReader &reader,
+			Span<const Vector3i> positions,
+			Span<VoxelBuffer *const> out_blocks,
+			Span<Error> out_errors
+	);
+
 	bool migrate_to_latest(FileAccess &f);
 	bool migrate_from_v2_to_v3(FileAccess &f, RegionFormat &format);
 
-	struct Header {
-		uint8_t version = -1;
-		RegionFormat format;
-		// Location and size of blocks, indexed by flat position.
-		// This table always has the same size,
-		// and the same index always corresponds to the same 3D position.
-		StdVector<RegionBlockInfo> blocks;
-	};
-
 	Ref<FileAccess> _file_access;
 	bool _header_modified = false;
 
@@ -137,6 +190,18 @@ private:
 	StdVector<Vector3u16> _sectors;
 	uint32_t _blocks_begin_offset;
 	String _file_path;
+
+	bool _memory_mapped_reads_enabled = false;
+	MemoryMappedFile _mapped_file;
+	// The mapping has to be re-created after writes, since the file may have grown or changed
+	bool _mapped_file_outdated = true;
+
+	bool _async_reads_enabled = false;
+	AsyncFileReader _async_reader;
+	bool _async_reader_outdated = true;
+
+	CompressedData::CompressionParams _compression_params;
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> _zstd_dictionaries;
 };
 
 } // namespace zylann::voxel
@@ -1,6 +1,7 @@
 #include "voxel_stream_region_files.h"
 #include "../../engine/voxel_engine.h"
 #include "../../util/godot/classes/directory.h"
+#include "../../util/godot/classes/file_access.h"
 #include "../../util/godot/classes/json.h"
 #include "../../util/godot/classes/time.h"
 #include "../../util/godot/core/array.h"
@@ -9,9 +10,12 @@
 #include "../../util/math/box3i.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
+#include "../flush_stream_task.h"
+#include "../voxel_block_serializer.h"
 #include "file_utils.h"
 
 #include <algorithm>
+#include <limits>
 
 namespace zylann::voxel {
 
@@ -23,6 +27,19 @@ const uint8_t FORMAT_VERSION_LEGACY_2 = 2;
 
 const uint8_t FORMAT_VERSION_LEGACY_1 = 1;
 const char *META_FILE_NAME = "meta.vxrm";
+const char *ZSTD_DICTIONARIES_DIR_NAME = "zstd_dictionaries";
+const char *ZSTD_DICTIONARY_FILE_EXTENSION = "zdict";
+
+// When blocks are cached, they get written once that many are waiting, or at least this often
+const unsigned int CACHE_MAX_DIRTY_BLOCKS = 64;
+const uint64_t CACHE_FLUSH_INTERVAL_MSEC = 5000;
+
+bool is_same_region_format(const RegionFormat &a, const RegionFormat &b) {
+	return a.block_size_po2 == b.block_size_po2 //
+			&& a.channel_depths == b.channel_depths //
+			&& a.region_size == b.region_size //
+			&& a.sector_size == b.sector_size;
+}
 
 } // namespace
 
@@ -60,6 +77,10 @@ VoxelStreamRegionFiles::VoxelStreamRegionFiles() {
 }
 
 VoxelStreamRegionFiles::~VoxelStreamRegionFiles() {
+	{
+		MutexLock lock(_mutex);
+		flush_cache_no_lock();
+	}
 	close_all_regions();
 }
 
@@ -82,6 +103,42 @@ void VoxelStreamRegionFiles::load_voxel_blocks(Span<VoxelStream::VoxelQueryData>
 	comparator.self = this;
 	get_sorted_indices(p_blocks, comparator, sorted_block_indices);
 
+	if (_cache.get_memory_budget() > 0) {
+		// Blocks saved recently may not have been written to region files yet
+		unsigned int remaining_count = 0;
+		for (const unsigned int bi : sorted_block_indices) {
+			VoxelStream::VoxelQueryData &q = p_blocks[bi];
+			if (q.lod_index < constants::MAX_LOD &&
+				_cache.load_voxel_block(q.position_in_blocks, q.lod_index, q.voxel_buffer) ==
+						VoxelStreamCache::VOXELS_FOUND) {
+				q.result = RESULT_BLOCK_FOUND;
+			} else {
+				sorted_block_indices[remaining_count] = bi;
+				++remaining_count;
+			}
+		}
+		sorted_block_indices.resize(remaining_count);
+	}
+
+	if (is_async_reads_enabled()) {
+		// Blocks of the same region are loaded together, so reads of their sectors can be submitted all at once
+		unsigned int group_begin = 0;
+		while (group_begin < sorted_block_indices.size()) {
+			const VoxelStream::VoxelQueryData &first = p_blocks[sorted_block_indices[group_begin]];
+			unsigned int group_end = group_begin + 1;
+			while (group_end < sorted_block_indices.size() &&
+				   !comparator(first, p_blocks[sorted_block_indices[group_end]])) {
+				++group_end;
+			}
+			_load_region_blocks(
+					p_blocks,
+					to_span_from_position_and_size(sorted_block_indices, group_begin, group_end - group_begin)
+			);
+			group_begin = group_end;
+		}
+		return;
+	}
+
 	for (unsigned int i = 0; i < sorted_block_indices.size(); ++i) {
 		const unsigned int bi = sorted_block_indices[i];
 		VoxelStream::VoxelQueryData &q = p_blocks[bi];
@@ -106,6 +163,16 @@ void VoxelStreamRegionFiles::load_voxel_blocks(Span<VoxelStream::VoxelQueryData>
 void VoxelStreamRegionFiles::save_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) {
 	ZN_PROFILE_SCOPE();
 
+	if (_cache.get_memory_budget() > 0) {
+		for (unsigned int i = 0; i < p_blocks.size(); ++i) {
+			VoxelStream::VoxelQueryData &q = p_blocks[i];
+			ZN_ASSERT_CONTINUE(q.lod_index < constants::MAX_LOD);
+			_cache.save_voxel_block(q.position_in_blocks, q.lod_index, q.voxel_buffer);
+		}
+		request_cache_flush_if_needed();
+		return;
+	}
+
 	// Had to copy input to sort it, as some areas in the module break if they get responses in different order
 	StdVector<unsigned int> sorted_block_indices;
 	BlockQueryComparator comparator;
@@ -119,6 +186,150 @@ void VoxelStreamRegionFiles::save_voxel_blocks(Span<VoxelStream::VoxelQueryData>
 	}
 }
 
+void VoxelStreamRegionFiles::load_all_blocks(FullLoadingResult &result) {
+	ZN_PROFILE_SCOPE();
+	StdVector<FullLoadingPart> parts;
+	ERR_FAIL_COND(!get_load_all_blocks_parts(1, parts));
+	for (const FullLoadingPart &part : parts) {
+		load_all_blocks_part(part, result);
+	}
+}
+
+bool VoxelStreamRegionFiles::get_load_all_blocks_parts(unsigned int max_count, StdVector<FullLoadingPart> &out_parts) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(max_count > 0, false);
+
+	MutexLock lock(_mutex);
+
+	if (_directory_path.is_empty()) {
+		return true;
+	}
+
+	if (!_meta_loaded) {
+		const zylann::godot::FileResult load_res = load_meta();
+		if (load_res != zylann::godot::FILE_OK) {
+			// No block was ever saved
+			return true;
+		}
+	}
+
+	// Parts read region files with their own handles, so headers of regions we have open must be up to date on disk
+	flush_cache_no_lock();
+	for (CachedRegion *cr : _region_cache) {
+		cr->region.flush();
+	}
+
+	StdVector<RegionLocation> regions;
+	ZN_ASSERT_RETURN_V(get_all_region_locations(regions), false);
+
+	// Parts are ranges of indices in the list of regions
+	const int64_t region_count = regions.size();
+	const int64_t regions_per_part = (region_count + max_count - 1) / max_count;
+	for (int64_t begin = 0; begin < region_count; begin += regions_per_part) {
+		out_parts.push_back(FullLoadingPart{ begin, math::min(begin + regions_per_part, region_count) });
+	}
+
+	return true;
+}
+
+void VoxelStreamRegionFiles::load_all_blocks_part(const FullLoadingPart &part, FullLoadingResult &result) {
+	ZN_PROFILE_SCOPE();
+
+	StdVector<RegionLocation> regions;
+	StdVector<String> region_file_paths;
+	RegionFormat region_format;
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries;
+	bool memory_mapped_reads_enabled;
+	bool async_reads_enabled;
+	{
+		MutexLock lock(_mutex);
+		ERR_FAIL_COND(!_meta_loaded);
+
+		StdVector<RegionLocation> all_regions;
+		ZN_ASSERT_RETURN(get_all_region_locations(all_regions));
+		ZN_ASSERT_RETURN(part.begin >= 0 && part.end <= static_cast<int64_t>(all_regions.size()));
+
+		for (int64_t i = part.begin; i < part.end; ++i) {
+			const RegionLocation location = all_regions[i];
+			regions.push_back(location);
+			region_file_paths.push_back(get_region_file_path(location.position, location.lod_index));
+		}
+
+		region_format = get_region_format();
+		zstd_dictionaries = _zstd_dictionaries;
+		memory_mapped_reads_enabled = _memory_mapped_reads_enabled;
+		async_reads_enabled = _async_reads_enabled;
+	}
+
+	// Regions are opened here rather than going through the cache, so other threads can load other parts at the same
+	// time without waiting for the stream's lock
+	const Vector3i block_size = Vector3iUtil::create(1 << region_format.block_size_po2);
+
+	StdVector<Vector3i> positions;
+	StdVector<std::shared_ptr<VoxelBuffer>> buffers;
+	StdVector<VoxelBuffer *> buffer_ptrs;
+	StdVector<Error> errors;
+
+	for (unsigned int region_index = 0; region_index < regions.size(); ++region_index) {
+		ZN_PROFILE_SCOPE_NAMED("Region");
+		const RegionLocation location = regions[region_index];
+
+		RegionFile region;
+		region.set_format(region_format);
+		region.set_memory_mapped_reads_enabled(memory_mapped_reads_enabled);
+		region.set_async_reads_enabled(async_reads_enabled);
+		region.set_zstd_dictionaries(zstd_dictionaries);
+
+		if (region.open(region_file_paths[region_index], false) != OK) {
+			continue;
+		}
+		if (!is_same_region_format(region.get_format(), region_format)) {
+			ERR_PRINT("Region file has unexpected format");
+			continue;
+		}
+
+		positions.clear();
+		buffers.clear();
+		buffer_ptrs.clear();
+
+		const unsigned int block_count = region.get_header_block_count();
+		for (unsigned int i = 0; i < block_count; ++i) {
+			if (!region.has_block(i)) {
+				continue;
+			}
+			std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+			voxels->create(block_size);
+			for (unsigned int channel_index = 0; channel_index < region_format.channel_depths.size(); ++channel_index) {
+				voxels->set_channel_depth(channel_index, region_format.channel_depths[channel_index]);
+			}
+			positions.push_back(region.get_block_position_from_index(i));
+			buffer_ptrs.push_back(voxels.get());
+			buffers.push_back(std::move(voxels));
+		}
+
+		errors.clear();
+		errors.resize(positions.size(), OK);
+		region.load_blocks(to_span_const(positions), to_span_const(buffer_ptrs), to_span(errors));
+
+		for (unsigned int i = 0; i < positions.size(); ++i) {
+			if (errors[i] != OK) {
+				ZN_PRINT_ERROR(format(
+						"Failed to load block {} from region {} lod {}",
+						positions[i],
+						location.position,
+						location.lod_index
+				));
+				continue;
+			}
+			FullLoadingResult::Block block;
+			block.voxels = std::move(buffers[i]);
+			block.position = positions[i] + location.position * region_format.region_size;
+			block.lod = location.lod_index;
+			result.blocks.push_back(std::move(block));
+		}
+	}
+}
+
 int VoxelStreamRegionFiles::get_used_channels_mask() const {
 	// Assuming all, since that stream can store anything.
 	return VoxelBuffer::ALL_CHANNELS_MASK;
@@ -156,14 +367,18 @@ VoxelStreamRegionFiles::EmergeResult VoxelStreamRegionFiles::_load_block(
 	}
 
 	const Vector3i region_pos = get_region_position_from_blocks(block_pos);
+	const Vector3i block_rpos = math::wrap(block_pos, region_size);
+
+	if (!may_contain_block_no_lock(region_pos, block_rpos, lod)) {
+		++_existence_index.skipped_loads;
+		return EMERGE_OK_FALLBACK;
+	}
 
 	CachedRegion *cache = open_region(region_pos, lod, false);
 	if (cache == nullptr || !cache->file_exists) {
 		return EMERGE_OK_FALLBACK;
 	}
 
-	const Vector3i block_rpos = math::wrap(block_pos, region_size);
-
 	const Error err = cache->region.load_block(block_rpos, out_buffer);
 	switch (err) {
 		case OK:
@@ -177,6 +392,98 @@ VoxelStreamRegionFiles::EmergeResult VoxelStreamRegionFiles::_load_block(
 	}
 }
 
+void VoxelStreamRegionFiles::_load_region_blocks(
+		Span<VoxelStream::VoxelQueryData> p_blocks,
+		Span<const unsigned int> indices
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(indices.size() > 0);
+
+	for (const unsigned int bi : indices) {
+		p_blocks[bi].result = RESULT_BLOCK_NOT_FOUND;
+	}
+
+	MutexLock lock(_mutex);
+
+	if (_directory_path.is_empty()) {
+		return;
+	}
+
+	if (!_meta_loaded) {
+		const zylann::godot::FileResult load_res = load_meta();
+		if (load_res != zylann::godot::FILE_OK) {
+			// No block was ever saved
+			return;
+		}
+	}
+
+	const Vector3i block_size = Vector3iUtil::create(1 << _meta.block_size_po2);
+	const Vector3i region_size = Vector3iUtil::create(1 << _meta.region_size_po2);
+
+	const VoxelStream::VoxelQueryData &first = p_blocks[indices[0]];
+	const int lod = first.lod_index;
+	if (lod >= _meta.lod_count) {
+		ZN_PRINT_ERROR("Invalid LOD index");
+		for (const unsigned int bi : indices) {
+			p_blocks[bi].result = RESULT_ERROR;
+		}
+		return;
+	}
+
+	const Vector3i region_pos = get_region_position_from_blocks(first.position_in_blocks);
+
+	StdVector<Vector3i> positions;
+	StdVector<VoxelBuffer *> buffers;
+	StdVector<unsigned int> query_indices;
+
+	for (const unsigned int bi : indices) {
+		VoxelStream::VoxelQueryData &q = p_blocks[bi];
+		if (q.voxel_buffer.get_size() != block_size) {
+			ZN_PRINT_ERROR("Block size mismatch");
+			q.result = RESULT_ERROR;
+			continue;
+		}
+		const Vector3i block_rpos = math::wrap(q.position_in_blocks, region_size);
+		if (!may_contain_block_no_lock(region_pos, block_rpos, lod)) {
+			++_existence_index.skipped_loads;
+			continue;
+		}
+		positions.push_back(block_rpos);
+		buffers.push_back(&q.voxel_buffer);
+		query_indices.push_back(bi);
+	}
+
+	if (positions.size() == 0) {
+		return;
+	}
+
+	CachedRegion *cache = open_region(region_pos, lod, false);
+	if (cache == nullptr || !cache->file_exists) {
+		return;
+	}
+
+	StdVector<Error> errors;
+	errors.resize(positions.size(), OK);
+	cache->region.load_blocks(to_span_const(positions), to_span_const(buffers), to_span(errors));
+
+	for (unsigned int i = 0; i < errors.size(); ++i) {
+		VoxelStream::VoxelQueryData &q = p_blocks[query_indices[i]];
+		switch (errors[i]) {
+			case OK:
+				q.result = RESULT_BLOCK_FOUND;
+				break;
+
+			case ERR_DOES_NOT_EXIST:
+				q.result = RESULT_BLOCK_NOT_FOUND;
+				break;
+
+			default:
+				q.result = RESULT_ERROR;
+				break;
+		}
+	}
+}
+
 void VoxelStreamRegionFiles::_save_block(VoxelBuffer &voxel_buffer, Vector3i block_pos, int lod) {
 	ZN_PROFILE_SCOPE();
 	using namespace zylann::godot;
@@ -221,6 +528,10 @@ void VoxelStreamRegionFiles::_save_block(VoxelBuffer &voxel_buffer, Vector3i blo
 	CachedRegion *cache = open_region(region_pos, lod, true);
 	ERR_FAIL_COND_MSG(cache == nullptr, "Could not save region file data");
 	ERR_FAIL_COND(cache->region.save_block(block_rpos, voxel_buffer) != OK);
+
+	// The region is in the index since it was opened
+	ExistenceIndex::Region &indexed_region = _existence_index.lods[lod].regions[region_pos];
+	indexed_region.blocks.set(Vector3iUtil::get_zxy_index(block_rpos, region_size));
 }
 
 String VoxelStreamRegionFiles::get_directory() const {
@@ -231,6 +542,7 @@ String VoxelStreamRegionFiles::get_directory() const {
 void VoxelStreamRegionFiles::set_directory(String dirpath) {
 	MutexLock lock(_mutex);
 	if (_directory_path != dirpath) {
+		flush_cache_no_lock();
 		close_all_regions();
 		_directory_path = dirpath.strip_edges();
 		_meta_loaded = false;
@@ -287,6 +599,15 @@ zylann::godot::FileResult VoxelStreamRegionFiles::save_meta() {
 	}
 	d["channel_depths"] = channel_depths;
 
+	if (_meta.zstd_dictionary_ids.size() > 0) {
+		Array zstd_dictionary_ids;
+		zstd_dictionary_ids.resize(_meta.zstd_dictionary_ids.size());
+		for (unsigned int i = 0; i < _meta.zstd_dictionary_ids.size(); ++i) {
+			zstd_dictionary_ids[i] = _meta.zstd_dictionary_ids[i];
+		}
+		d["zstd_dictionaries"] = zstd_dictionary_ids;
+	}
+
 	const String json_string = JSON::stringify(d, "\t", true);
 
 	// Make sure the directory exists
@@ -395,15 +716,95 @@ zylann::godot::FileResult VoxelStreamRegionFiles::load_meta() {
 		ERR_FAIL_COND_V(!depth_from_json_variant(channel_depths_data[i], meta.channel_depths[i]), FILE_INVALID_DATA);
 	}
 
+	// Optional, only present if dictionaries were trained
+	if (d.has("zstd_dictionaries")) {
+		Array zstd_dictionary_ids = d["zstd_dictionaries"];
+		for (int i = 0; i < zstd_dictionary_ids.size(); ++i) {
+			uint32_t id;
+			ERR_FAIL_COND_V(!u32_from_json_variant(zstd_dictionary_ids[i], id), FILE_INVALID_DATA);
+			meta.zstd_dictionary_ids.push_back(id);
+		}
+	}
+
 	ERR_FAIL_COND_V(!check_meta(meta), FILE_INVALID_DATA);
 
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries;
+	for (const uint32_t id : meta.zstd_dictionary_ids) {
+		std::shared_ptr<CompressedData::ZstdDictionary> dictionary = load_zstd_dictionary(id);
+		if (dictionary == nullptr) {
+			return FILE_INVALID_DATA;
+		}
+		zstd_dictionaries.push_back(dictionary);
+	}
+
 	_meta = meta;
+	_zstd_dictionaries = std::move(zstd_dictionaries);
 	_meta_loaded = true;
 	_meta_saved = true;
 
 	return FILE_OK;
 }
 
+String VoxelStreamRegionFiles::get_zstd_dictionary_file_path(uint32_t id) const {
+	return _directory_path.path_join(ZSTD_DICTIONARIES_DIR_NAME)
+			.path_join(String::num_uint64(id, 16) + "." + ZSTD_DICTIONARY_FILE_EXTENSION);
+}
+
+zylann::godot::FileResult VoxelStreamRegionFiles::save_zstd_dictionary(
+		const CompressedData::ZstdDictionary &dictionary
+) {
+	using namespace zylann::godot;
+
+	{
+		const String dir_path = _directory_path.path_join(ZSTD_DICTIONARIES_DIR_NAME);
+		const Error err = check_directory_created_with_file_locker(dir_path);
+		if (err != OK) {
+			ERR_PRINT("Could not save Zstd dictionary");
+			return FILE_CANT_OPEN;
+		}
+	}
+
+	const String fpath = get_zstd_dictionary_file_path(dictionary.get_id());
+	const CharString fpath_utf8 = fpath.utf8();
+
+	Error err;
+	VoxelFileLockerWrite file_wlock(fpath_utf8.get_data());
+	Ref<FileAccess> f = open_file(fpath, FileAccess::WRITE, err);
+	if (f.is_null()) {
+		ERR_PRINT(String("Could not save {0}").format(varray(fpath)));
+		return FILE_CANT_OPEN;
+	}
+
+	store_buffer(**f, dictionary.get_content());
+
+	return FILE_OK;
+}
+
+std::shared_ptr<CompressedData::ZstdDictionary> VoxelStreamRegionFiles::load_zstd_dictionary(uint32_t id) const {
+	using namespace zylann::godot;
+
+	const String fpath = get_zstd_dictionary_file_path(id);
+	const CharString fpath_utf8 = fpath.utf8();
+
+	StdVector<uint8_t> content;
+	{
+		Error err;
+		VoxelFileLockerRead file_rlock(fpath_utf8.get_data());
+		Ref<FileAccess> f = open_file(fpath, FileAccess::READ, err);
+		if (f.is_null()) {
+			ZN_PRINT_ERROR(format("Could not open Zstd dictionary {}", fpath));
+			return nullptr;
+		}
+		content.resize(f->get_length());
+		ERR_FAIL_COND_V(get_buffer(**f, to_span(content)) != content.size(), nullptr);
+	}
+
+	std::shared_ptr<CompressedData::ZstdDictionary> dictionary =
+			make_shared_instance<CompressedData::ZstdDictionary>(to_span(content));
+	ZN_ASSERT_RETURN_V_MSG(dictionary->get_id() == id, nullptr, format("Zstd dictionary {} is corrupted", fpath));
+	return dictionary;
+}
+
 bool VoxelStreamRegionFiles::check_meta(const Meta &meta) {
 	ERR_FAIL_COND_V(meta.block_size_po2 < 1 || meta.block_size_po2 > 8, false);
 	ERR_FAIL_COND_V(meta.region_size_po2 < 1 || meta.region_size_po2 > 8, false);
@@ -427,6 +828,9 @@ void VoxelStreamRegionFiles::close_all_regions() {
 		ZN_DELETE(cache);
 	}
 	_region_cache.clear();
+	// Files may be about to change in ways the index doesn't track, it will be rebuilt when needed
+	_existence_index.clear();
+	_region_header_cache.clear();
 }
 
 String VoxelStreamRegionFiles::get_region_file_path(const Vector3i &region_pos, unsigned int lod) const {
@@ -460,6 +864,7 @@ VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::open_region(
 
 	CachedRegion *cached_region = get_region_from_cache(region_pos, lod);
 	if (cached_region != nullptr) {
+		cached_region->last_used = ++_region_use_counter;
 		return cached_region;
 	}
 
@@ -474,25 +879,30 @@ VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::open_region(
 
 	// Configure format because we might have to create the file, and some old file versions don't embed format
 	{
-		RegionFormat format;
-		format.block_size_po2 = _meta.block_size_po2;
-		format.channel_depths = _meta.channel_depths;
-		// TODO Palette support
-		format.has_palette = false;
-		format.region_size = Vector3iUtil::create(1 << _meta.region_size_po2);
-		format.sector_size = _meta.sector_size;
-
-		cached_region->region.set_format(format);
+		cached_region->region.set_format(get_region_format());
+		cached_region->region.set_memory_mapped_reads_enabled(_memory_mapped_reads_enabled);
+		cached_region->region.set_async_reads_enabled(_async_reads_enabled);
+		cached_region->region.set_compression_params(get_compression_params());
+		cached_region->region.set_zstd_dictionaries(_zstd_dictionaries);
 		cached_region->position = region_pos;
 		cached_region->lod = lod;
 	}
 
-	const Error err = cached_region->region.open(fpath, create_if_not_found);
+	StdUnorderedMap<Vector3i, RegionHeaderCache::Entry> &cached_headers = _region_header_cache.lods[lod];
+	auto header_it = cached_headers.find(region_pos);
+	const bool has_cached_header = header_it != cached_headers.end();
+
+	const RegionFile::Header *cached_header = has_cached_header ? &header_it->second.header : nullptr;
+	const Error err = cached_region->region.open(fpath, create_if_not_found, cached_header);
+
+	if (has_cached_header) {
+		// The region now holds its header, it will be cached again when it gets closed
+		cached_headers.erase(header_it);
+		--_region_header_cache.count;
+	}
 
 	// Things we could do for optimization:
 	// - Cache the fact the file doesn't exist, so we won't need to do a system call to actually check it every time.
-	// - No need to read the header again when it has been read once,
-	//   we assume no other process will modify region files.
 
 	if (err != OK) {
 		ZN_DELETE(cached_region);
@@ -502,52 +912,155 @@ VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::open_region(
 			return nullptr;
 		} else {
 			// Does not exist, it was probably expected
+			_existence_index.lods[lod].regions.erase(region_pos);
 			return nullptr;
 		}
 	}
 
 	// Make sure it has correct format
-	{
-		const RegionFormat &format = cached_region->region.get_format();
-		if (format.block_size_po2 != _meta.block_size_po2 //
-				|| format.channel_depths != _meta.channel_depths //
-				|| format.region_size != Vector3iUtil::create(1 << _meta.region_size_po2) //
-				|| format.sector_size != _meta.sector_size) {
-			ERR_PRINT("Region file has unexpected format");
-			ZN_DELETE(cached_region);
-			return nullptr;
-		}
+	if (!is_same_region_format(cached_region->region.get_format(), get_region_format())) {
+		ERR_PRINT("Region file has unexpected format");
+		ZN_DELETE(cached_region);
+		return nullptr;
 	}
 
 	// TODO Debug check to make sure we did not already cache it
 	_region_cache.push_back(cached_region);
 
+	if (has_cached_header) {
+		++_region_header_cache.hits;
+	} else {
+		++_region_header_cache.misses;
+	}
+
 	cached_region->file_exists = true;
-	cached_region->last_opened = Time::get_singleton()->get_ticks_usec();
+	cached_region->last_used = ++_region_use_counter;
+	cached_region->file_lock = &VoxelEngine::get_singleton().get_file_locker().get_file(fpath.utf8().get_data());
+
+	update_existence_index_from_region(*cached_region);
 
 	return cached_region;
 }
 
-// TODO Get rid of to simplify?
+void VoxelStreamRegionFiles::update_existence_index_from_region(const CachedRegion &cached_region) {
+	ExistenceIndex::Region &indexed_region =
+			_existence_index.lods[cached_region.lod].regions[cached_region.position];
+	if (indexed_region.header_loaded) {
+		return;
+	}
+	const RegionFile &region = cached_region.region;
+	const unsigned int block_count = region.get_header_block_count();
+	indexed_region.blocks.resize_no_init(block_count);
+	indexed_region.blocks.fill(false);
+	// Header order is the same as ZXY indexing, see `RegionFile::get_block_index_in_header`
+	for (unsigned int i = 0; i < block_count; ++i) {
+		if (region.has_block(i)) {
+			indexed_region.blocks.set(i);
+		}
+	}
+	indexed_region.header_loaded = true;
+}
+
+bool VoxelStreamRegionFiles::may_contain_block_no_lock(Vector3i region_pos, Vector3i block_rpos, unsigned int lod) {
+	ZN_ASSERT_RETURN_V(lod < constants::MAX_LOD, true);
+	ExistenceIndex::Lod &indexed_lod = _existence_index.lods[lod];
+
+	if (!indexed_lod.listed) {
+		ZN_PROFILE_SCOPE_NAMED("List regions");
+		StdVector<Vector3i> positions;
+		if (!get_region_positions(lod, positions)) {
+			// Can't tell
+			return true;
+		}
+		for (const Vector3i pos : positions) {
+			// Inserts regions whose header wasn't read yet, keeps those already known
+			indexed_lod.regions[pos];
+		}
+		indexed_lod.listed = true;
+	}
+
+	auto it = indexed_lod.regions.find(region_pos);
+	if (it == indexed_lod.regions.end()) {
+		// No region file
+		return false;
+	}
+
+	const ExistenceIndex::Region &indexed_region = it->second;
+	if (!indexed_region.header_loaded) {
+		// The header has to be read first
+		return true;
+	}
+
+	const Vector3i region_size = Vector3iUtil::create(1 << _meta.region_size_po2);
+	return indexed_region.blocks.get(Vector3iUtil::get_zxy_index(block_rpos, region_size));
+}
+
+RegionFormat VoxelStreamRegionFiles::get_region_format() const {
+	RegionFormat format;
+	format.block_size_po2 = _meta.block_size_po2;
+	format.channel_depths = _meta.channel_depths;
+	// TODO Palette support
+	format.has_palette = false;
+	format.region_size = Vector3iUtil::create(1 << _meta.region_size_po2);
+	format.sector_size = _meta.sector_size;
+	return format;
+}
+
 void VoxelStreamRegionFiles::close_region(CachedRegion *region) {
-	region->region.close();
+	const Error err = region->region.close();
+	// If the header could not be written, the file no longer matches it
+	if (err == OK && region->file_exists) {
+		cache_region_header(*region);
+	}
+}
+
+void VoxelStreamRegionFiles::cache_region_header(const CachedRegion &cached_region) {
+	if (_max_cached_region_headers == 0) {
+		return;
+	}
+
+	StdUnorderedMap<Vector3i, RegionHeaderCache::Entry> &cached_headers =
+			_region_header_cache.lods[cached_region.lod];
+	auto insert_result = cached_headers.insert({ cached_region.position, RegionHeaderCache::Entry() });
+	if (insert_result.second) {
+		++_region_header_cache.count;
+	}
+	RegionHeaderCache::Entry &entry = insert_result.first->second;
+	entry.header = cached_region.region.get_header();
+	entry.last_used = cached_region.last_used;
+
+	// Remove least recently used headers
+	while (_region_header_cache.count > _max_cached_region_headers) {
+		StdUnorderedMap<Vector3i, RegionHeaderCache::Entry> *oldest_map = nullptr;
+		Vector3i oldest_position;
+		uint64_t oldest_last_used = std::numeric_limits<uint64_t>::max();
+
+		for (StdUnorderedMap<Vector3i, RegionHeaderCache::Entry> &map : _region_header_cache.lods) {
+			for (auto it = map.begin(); it != map.end(); ++it) {
+				if (it->second.last_used < oldest_last_used) {
+					oldest_last_used = it->second.last_used;
+					oldest_position = it->first;
+					oldest_map = &map;
+				}
+			}
+		}
+
+		ZN_ASSERT_RETURN(oldest_map != nullptr);
+		oldest_map->erase(oldest_position);
+		--_region_header_cache.count;
+	}
 }
 
 void VoxelStreamRegionFiles::close_oldest_region() {
-	// Close region assumed to be the least recently used
+	// Close the least recently used region
 
 	if (_region_cache.size() == 0) {
 		return;
 	}
 
-	int oldest_index = -1;
-	uint64_t oldest_time = 0;
-	const uint64_t now = Time::get_singleton()->get_ticks_usec();
-
-	for (unsigned int i = 0; i < _region_cache.size(); ++i) {
-		const CachedRegion *r = _region_cache[i];
-		const uint64_t time = now - r->last_opened;
-		if (time >= oldest_time) {
+	unsigned int oldest_index = 0;
+	for (unsigned int i = 1; i < _region_cache.size(); ++i) {
+		if (_region_cache[i]->last_used < _region_cache[oldest_index]->last_used) {
 			oldest_index = i;
 		}
 	}
@@ -573,6 +1086,53 @@ Vector3i convert_block_coordinates(Vector3i pos, Vector3i old_size, Vector3i new
 
 } // namespace
 
+bool VoxelStreamRegionFiles::get_region_positions(unsigned int lod_index, StdVector<Vector3i> &out_positions) const {
+	const String lod_folder = _directory_path.path_join("regions").path_join("lod") + String::num_int64(lod_index);
+	const String ext = String(".") + RegionFormat::FILE_EXTENSION;
+
+	Ref<DirAccess> da = open_directory(lod_folder);
+	if (da.is_null()) {
+		// No region was saved in this LOD
+		return true;
+	}
+
+	da->list_dir_begin();
+
+	while (true) {
+		String fname = da->get_next();
+		if (fname == "") {
+			break;
+		}
+		if (da->current_is_dir()) {
+			continue;
+		}
+		if (fname.ends_with(ext)) {
+			PackedStringArray parts = fname.split(".");
+			// r.x.y.z.ext
+			ERR_FAIL_COND_V_MSG(
+					parts.size() < 4, false, String("Found invalid region file: '{0}'").format(varray(fname))
+			);
+			out_positions.push_back(Vector3i(parts[1].to_int(), parts[2].to_int(), parts[3].to_int()));
+		}
+	}
+
+	da->list_dir_end();
+	return true;
+}
+
+bool VoxelStreamRegionFiles::get_all_region_locations(StdVector<RegionLocation> &out_locations) const {
+	for (unsigned int lod_index = 0; lod_index < _meta.lod_count; ++lod_index) {
+		StdVector<Vector3i> positions;
+		ZN_ASSERT_RETURN_V(get_region_positions(lod_index, positions), false);
+		// Directory listing order is not guaranteed, but callers can refer to regions by index
+		std::sort(positions.begin(), positions.end());
+		for (const Vector3i position : positions) {
+			out_locations.push_back(RegionLocation{ position, static_cast<uint8_t>(lod_index) });
+		}
+	}
+	return true;
+}
+
 void VoxelStreamRegionFiles::_convert_files(Meta new_meta) {
 	using namespace zylann::godot;
 
@@ -631,45 +1191,23 @@ void VoxelStreamRegionFiles::_convert_files(Meta new_meta) {
 	Meta old_meta = old_stream->_meta;
 
 	// Get list of all regions from the old stream
-	{
-		for (unsigned int lod_index = 0; lod_index < old_meta.lod_count; ++lod_index) {
-			const String lod_folder =
-					old_stream->_directory_path.path_join("regions").path_join("lod") + String::num_int64(lod_index);
-			const String ext = String(".") + RegionFormat::FILE_EXTENSION;
-
-			Ref<DirAccess> da = open_directory(lod_folder);
-			if (da.is_null()) {
-				continue;
-			}
-
-			da->list_dir_begin();
-
-			while (true) {
-				String fname = da->get_next();
-				if (fname == "") {
-					break;
-				}
-				if (da->current_is_dir()) {
-					continue;
-				}
-				if (fname.ends_with(ext)) {
-					PackedStringArray parts = fname.split(".");
-					// r.x.y.z.ext
-					ERR_FAIL_COND_MSG(
-							parts.size() < 4, String("Found invalid region file: '{0}'").format(varray(fname)));
-					PositionAndLod p;
-					p.position.x = parts[1].to_int();
-					p.position.y = parts[2].to_int();
-					p.position.z = parts[3].to_int();
-					p.lod_index = lod_index;
-					old_region_list.push_back(p);
-				}
-			}
-
-			da->list_dir_end();
+	for (unsigned int lod_index = 0; lod_index < old_meta.lod_count; ++lod_index) {
+		StdVector<Vector3i> positions;
+		ERR_FAIL_COND(!old_stream->get_region_positions(lod_index, positions));
+		for (const Vector3i position : positions) {
+			PositionAndLod p;
+			p.position = position;
+			p.lod_index = lod_index;
+			old_region_list.push_back(p);
 		}
 	}
 
+	// Dictionaries are still needed to read blocks saved with them
+	new_meta.zstd_dictionary_ids = old_meta.zstd_dictionary_ids;
+	for (const std::shared_ptr<CompressedData::ZstdDictionary> &dictionary : _zstd_dictionaries) {
+		ERR_FAIL_COND(save_zstd_dictionary(*dictionary) != FILE_OK);
+	}
+
 	_meta = new_meta;
 	ERR_FAIL_COND(save_meta() != FILE_OK);
 
@@ -898,6 +1436,7 @@ void VoxelStreamRegionFiles::convert_files(Dictionary d) {
 		MutexLock lock(_mutex);
 
 		ERR_FAIL_COND_MSG(!check_meta(meta), "Invalid setting");
+		flush_cache_no_lock();
 
 		if (!_meta_loaded) {
 			if (load_meta() != zylann::godot::FILE_OK) {
@@ -918,14 +1457,299 @@ void VoxelStreamRegionFiles::convert_files(Dictionary d) {
 	emit_changed();
 }
 
+bool VoxelStreamRegionFiles::compact_files(bool recompress) {
+	ZN_PROFILE_SCOPE();
+
+	StdVector<RegionLocation> regions;
+	{
+		MutexLock lock(_mutex);
+
+		ZN_ASSERT_RETURN_V(!_directory_path.is_empty(), false);
+		flush_cache_no_lock();
+		if (!_meta_loaded) {
+			if (load_meta() != zylann::godot::FILE_OK) {
+				// No block was ever saved
+				return true;
+			}
+		}
+
+		ZN_ASSERT_RETURN_V(get_all_region_locations(regions), false);
+	}
+
+	uint64_t total_saved_bytes = 0;
+	unsigned int failed_count = 0;
+
+	for (const RegionLocation location : regions) {
+		// Locking per region, so saving and loading can go on between them
+		MutexLock lock(_mutex);
+
+		CachedRegion *cache = open_region(location.position, location.lod_index, false);
+		if (cache == nullptr) {
+			// May have been removed since we listed it
+			continue;
+		}
+
+		ZN_ASSERT_CONTINUE(cache->file_lock != nullptr);
+		VoxelFileLockerWrite file_wlock(*cache->file_lock);
+
+		uint64_t saved_bytes = 0;
+		const Error err = cache->region.compact(recompress, &saved_bytes);
+		if (err != OK) {
+			const String fpath = get_region_file_path(location.position, location.lod_index);
+			ZN_PRINT_ERROR(format("Could not compact region file {}, error {}", fpath, static_cast<int>(err)));
+			++failed_count;
+			if (!cache->region.is_open()) {
+				// Don't keep a region we can't use
+				_region_cache.erase(std::find(_region_cache.begin(), _region_cache.end(), cache));
+				ZN_DELETE(cache);
+			}
+			continue;
+		}
+		total_saved_bytes += saved_bytes;
+	}
+
+	ZN_PRINT_VERBOSE(format("Compacted {} region files, saved {} bytes", regions.size(), total_saved_bytes));
+	return failed_count == 0;
+}
+
+bool VoxelStreamRegionFiles::is_memory_mapped_reads_enabled() const {
+	MutexLock lock(_mutex);
+	return _memory_mapped_reads_enabled;
+}
+
+void VoxelStreamRegionFiles::set_memory_mapped_reads_enabled(bool enabled) {
+	MutexLock lock(_mutex);
+	_memory_mapped_reads_enabled = enabled;
+	for (CachedRegion *cr : _region_cache) {
+		cr->region.set_memory_mapped_reads_enabled(enabled);
+	}
+}
+
+bool VoxelStreamRegionFiles::is_async_reads_enabled() const {
+	MutexLock lock(_mutex);
+	return _async_reads_enabled;
+}
+
+void VoxelStreamRegionFiles::set_async_reads_enabled(bool enabled) {
+	MutexLock lock(_mutex);
+	_async_reads_enabled = enabled;
+	for (CachedRegion *cr : _region_cache) {
+		cr->region.set_async_reads_enabled(enabled);
+	}
+}
+
+CompressedData::CompressionParams VoxelStreamRegionFiles::get_compression_params() const {
+	CompressedData::CompressionParams params;
+	if (_compression == COMPRESSION_ZSTD) {
+		params.compression = CompressedData::COMPRESSION_ZSTD;
+		params.zstd_level = _zstd_compression_level;
+		if (_zstd_dictionaries.size() > 0) {
+			params.zstd_dictionary = _zstd_dictionaries.back();
+		}
+	} else {
+		params.compression = CompressedData::COMPRESSION_LZ4;
+	}
+	return params;
+}
+
+void VoxelStreamRegionFiles::update_region_compression_params() {
+	const CompressedData::CompressionParams params = get_compression_params();
+	for (CachedRegion *cr : _region_cache) {
+		cr->region.set_compression_params(params);
+		cr->region.set_zstd_dictionaries(_zstd_dictionaries);
+	}
+}
+
+void VoxelStreamRegionFiles::set_compression(Compression compression) {
+	ZN_ASSERT_RETURN(compression >= 0 && compression < COMPRESSION_COUNT);
+	ZN_ASSERT_RETURN_MSG(
+			compression != COMPRESSION_ZSTD || CompressedData::is_zstd_supported(),
+			"Zstd compression is not available in this build"
+	);
+	MutexLock lock(_mutex);
+	_compression = compression;
+	update_region_compression_params();
+}
+
+VoxelStreamRegionFiles::Compression VoxelStreamRegionFiles::get_compression() const {
+	MutexLock lock(_mutex);
+	return _compression;
+}
+
+void VoxelStreamRegionFiles::set_zstd_compression_level(int level) {
+	MutexLock lock(_mutex);
+	_zstd_compression_level = math::clamp(level, CompressedData::ZSTD_MIN_LEVEL, CompressedData::ZSTD_MAX_LEVEL);
+	update_region_compression_params();
+}
+
+int VoxelStreamRegionFiles::get_zstd_compression_level() const {
+	MutexLock lock(_mutex);
+	return _zstd_compression_level;
+}
+
+bool VoxelStreamRegionFiles::train_zstd_dictionary(int sample_count, int max_size) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(sample_count > 0, false);
+	ZN_ASSERT_RETURN_V(max_size > 0, false);
+
+	MutexLock lock(_mutex);
+
+	ZN_ASSERT_RETURN_V(!_directory_path.is_empty(), false);
+	flush_cache_no_lock();
+	if (!_meta_loaded) {
+		ZN_ASSERT_RETURN_V_MSG(load_meta() == zylann::godot::FILE_OK, false, "No blocks to sample from");
+	}
+
+	StdVector<Vector3i> region_positions;
+	ZN_ASSERT_RETURN_V(get_region_positions(0, region_positions), false);
+
+	// Samples are uncompressed, since that's what the dictionary will be matched against
+	StdVector<StdVector<uint8_t>> samples;
+	const Vector3i block_size = Vector3iUtil::create(1 << _meta.block_size_po2);
+
+	for (const Vector3i region_pos : region_positions) {
+		CachedRegion *cache = open_region(region_pos, 0, false);
+		if (cache == nullptr) {
+			continue;
+		}
+		const unsigned int block_count = cache->region.get_header_block_count();
+		for (unsigned int i = 0; i < block_count && samples.size() < static_cast<unsigned int>(sample_count); ++i) {
+			if (!cache->region.has_block(i)) {
+				continue;
+			}
+			VoxelBuffer block(VoxelBuffer::ALLOCATOR_POOL);
+			block.create(block_size);
+			if (cache->region.load_block(cache->region.get_block_position_from_index(i), block) != OK) {
+				continue;
+			}
+			BlockSerializer::SerializeResult res = BlockSerializer::serialize(block);
+			ZN_ASSERT_CONTINUE(res.success);
+			samples.push_back(res.data);
+		}
+		if (samples.size() >= static_cast<unsigned int>(sample_count)) {
+			break;
+		}
+	}
+
+	std::shared_ptr<CompressedData::ZstdDictionary> dictionary =
+			CompressedData::ZstdDictionary::create_from_samples(to_span(samples), max_size);
+	ZN_ASSERT_RETURN_V(dictionary != nullptr, false);
+
+	ZN_PRINT_VERBOSE(format(
+			"Created Zstd dictionary {} of {} bytes from {} blocks",
+			dictionary->get_id(),
+			dictionary->get_content().size(),
+			samples.size()
+	));
+
+	if (std::find(_meta.zstd_dictionary_ids.begin(), _meta.zstd_dictionary_ids.end(), dictionary->get_id()) ==
+		_meta.zstd_dictionary_ids.end()) {
+		ZN_ASSERT_RETURN_V(save_zstd_dictionary(*dictionary) == zylann::godot::FILE_OK, false);
+		_meta.zstd_dictionary_ids.push_back(dictionary->get_id());
+		_zstd_dictionaries.push_back(dictionary);
+		ZN_ASSERT_RETURN_V(save_meta() == zylann::godot::FILE_OK, false);
+	}
+
+	update_region_compression_params();
+	return true;
+}
+
 void VoxelStreamRegionFiles::flush() {
 	ZN_PROFILE_SCOPE();
+	// Also done by background flushes
+	_cache.end_flush_request();
 	MutexLock lock(_mutex);
+	flush_cache_no_lock();
 	for (CachedRegion *cr : _region_cache) {
 		cr->region.flush();
 	}
 }
 
+void VoxelStreamRegionFiles::flush_cache_no_lock() {
+	if (_cache.get_indicative_block_count() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+	ZN_PRINT_VERBOSE(format("VoxelStreamRegionFiles: Flushing cache ({} blocks)", _cache.get_indicative_block_count()));
+	const auto save_func = [this](VoxelStreamCache::Block &block) { //
+		_save_block(block.voxels, block.position, block.lod);
+	};
+	_cache.flush(save_func, Time::get_singleton()->get_ticks_msec());
+}
+
+void VoxelStreamRegionFiles::request_cache_flush_if_needed() {
+	const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+	if (!_cache.is_flush_needed(CACHE_MAX_DIRTY_BLOCKS, now_msec, CACHE_FLUSH_INTERVAL_MSEC)) {
+		return;
+	}
+	// If saving goes faster than background flushes, we have to wait
+	if (_cache.is_flush_urgent(CACHE_MAX_DIRTY_BLOCKS)) {
+		MutexLock lock(_mutex);
+		flush_cache_no_lock();
+		return;
+	}
+	if (_cache.try_begin_flush_request()) {
+		VoxelEngine::get_singleton().push_async_io_task(ZN_NEW(FlushStreamTask(Ref<VoxelStream>(this))));
+	}
+}
+
+void VoxelStreamRegionFiles::set_cache_memory_budget_mb(int mb) {
+	ZN_ASSERT_RETURN(mb >= 0);
+	MutexLock lock(_mutex);
+	_cache.set_memory_budget(static_cast<uint64_t>(mb) * 1024 * 1024);
+	if (mb == 0) {
+		// Blocks will be saved directly from now on
+		flush_cache_no_lock();
+	}
+}
+
+int VoxelStreamRegionFiles::get_cache_memory_budget_mb() const {
+	return _cache.get_memory_budget() / (1024 * 1024);
+}
+
+void VoxelStreamRegionFiles::set_max_open_regions(int count) {
+	ZN_ASSERT_RETURN(count >= 1);
+	MutexLock lock(_mutex);
+	_max_open_regions = count;
+	while (_region_cache.size() > _max_open_regions) {
+		close_oldest_region();
+	}
+}
+
+int VoxelStreamRegionFiles::get_max_open_regions() const {
+	MutexLock lock(_mutex);
+	return _max_open_regions;
+}
+
+void VoxelStreamRegionFiles::set_max_cached_region_headers(int count) {
+	ZN_ASSERT_RETURN(count >= 0);
+	MutexLock lock(_mutex);
+	_max_cached_region_headers = count;
+	if (_max_cached_region_headers == 0) {
+		_region_header_cache.clear();
+	}
+	// Otherwise extra headers will be removed when the next region gets closed
+}
+
+int VoxelStreamRegionFiles::get_max_cached_region_headers() const {
+	MutexLock lock(_mutex);
+	return _max_cached_region_headers;
+}
+
+Dictionary VoxelStreamRegionFiles::get_statistics() const {
+	Dictionary d;
+	d["cache"] = _cache.get_stats().to_dictionary();
+	{
+		MutexLock lock(_mutex);
+		d["existence_index_skipped_loads"] = _existence_index.skipped_loads;
+		d["open_regions"] = static_cast<int64_t>(_region_cache.size());
+		d["cached_region_headers"] = _region_header_cache.count;
+		d["region_header_cache_hits"] = _region_header_cache.hits;
+		d["region_header_cache_misses"] = _region_header_cache.misses;
+	}
+	return d;
+}
+
 void VoxelStreamRegionFiles::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_directory", "directory"), &VoxelStreamRegionFiles::set_directory);
 	ClassDB::bind_method(D_METHOD("get_directory"), &VoxelStreamRegionFiles::get_directory);
@@ -942,14 +1766,101 @@ void VoxelStreamRegionFiles::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_sector_size"), &VoxelStreamRegionFiles::set_sector_size);
 
 	ClassDB::bind_method(D_METHOD("convert_files", "new_settings"), &VoxelStreamRegionFiles::convert_files);
+	ClassDB::bind_method(
+			D_METHOD("compact_files", "recompress"), &VoxelStreamRegionFiles::compact_files, DEFVAL(false)
+	);
+
+	ClassDB::bind_method(
+			D_METHOD("set_memory_mapped_reads_enabled", "enabled"),
+			&VoxelStreamRegionFiles::set_memory_mapped_reads_enabled
+	);
+	ClassDB::bind_method(
+			D_METHOD("is_memory_mapped_reads_enabled"), &VoxelStreamRegionFiles::is_memory_mapped_reads_enabled
+	);
+
+	ClassDB::bind_method(
+			D_METHOD("set_async_reads_enabled", "enabled"), &VoxelStreamRegionFiles::set_async_reads_enabled
+	);
+	ClassDB::bind_method(D_METHOD("is_async_reads_enabled"), &VoxelStreamRegionFiles::is_async_reads_enabled);
+
+	ClassDB::bind_method(D_METHOD("set_compression", "compression"), &VoxelStreamRegionFiles::set_compression);
+	ClassDB::bind_method(D_METHOD("get_compression"), &VoxelStreamRegionFiles::get_compression);
+
+	ClassDB::bind_method(
+			D_METHOD("set_zstd_compression_level", "level"), &VoxelStreamRegionFiles::set_zstd_compression_level
+	);
+	ClassDB::bind_method(D_METHOD("get_zstd_compression_level"), &VoxelStreamRegionFiles::get_zstd_compression_level);
+
+	ClassDB::bind_method(
+			D_METHOD("train_zstd_dictionary", "sample_count", "max_size"),
+			&VoxelStreamRegionFiles::train_zstd_dictionary,
+			DEFVAL(256),
+			DEFVAL(65536)
+	);
+
+	ClassDB::bind_method(
+			D_METHOD("set_cache_memory_budget_mb", "mb"), &VoxelStreamRegionFiles::set_cache_memory_budget_mb
+	);
+	ClassDB::bind_method(
+			D_METHOD("get_cache_memory_budget_mb"), &VoxelStreamRegionFiles::get_cache_memory_budget_mb
+	);
+
+	ClassDB::bind_method(D_METHOD("set_max_open_regions", "count"), &VoxelStreamRegionFiles::set_max_open_regions);
+	ClassDB::bind_method(D_METHOD("get_max_open_regions"), &VoxelStreamRegionFiles::get_max_open_regions);
+
+	ClassDB::bind_method(
+			D_METHOD("set_max_cached_region_headers", "count"), &VoxelStreamRegionFiles::set_max_cached_region_headers
+	);
+	ClassDB::bind_method(
+			D_METHOD("get_max_cached_region_headers"), &VoxelStreamRegionFiles::get_max_cached_region_headers
+	);
+
+	ClassDB::bind_method(D_METHOD("get_statistics"), &VoxelStreamRegionFiles::get_statistics);
 
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "directory", PROPERTY_HINT_DIR), "set_directory", "get_directory");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "memory_mapped_reads_enabled"),
+			"set_memory_mapped_reads_enabled",
+			"is_memory_mapped_reads_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "async_reads_enabled"), "set_async_reads_enabled", "is_async_reads_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "compression", PROPERTY_HINT_ENUM, "LZ4,Zstd"),
+			"set_compression",
+			"get_compression"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "zstd_compression_level", PROPERTY_HINT_RANGE, "1,22"),
+			"set_zstd_compression_level",
+			"get_zstd_compression_level"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "cache_memory_budget_mb", PROPERTY_HINT_RANGE, "0,4096,1,or_greater"),
+			"set_cache_memory_budget_mb",
+			"get_cache_memory_budget_mb"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "max_open_regions", PROPERTY_HINT_RANGE, "1,256,1,or_greater"),
+			"set_max_open_regions",
+			"get_max_open_regions"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "max_cached_region_headers", PROPERTY_HINT_RANGE, "0,4096,1,or_greater"),
+			"set_max_cached_region_headers",
+			"get_max_cached_region_headers"
+	);
 
 	ADD_GROUP("Dimensions", "");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "lod_count"), "set_lod_count", "get_lod_count");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "region_size_po2"), "set_region_size_po2", "get_region_size_po2");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "block_size_po2"), "set_block_size_po2", "get_block_size_po2");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "sector_size"), "set_sector_size", "get_sector_size");
+
+	BIND_ENUM_CONSTANT(COMPRESSION_LZ4);
+	BIND_ENUM_CONSTANT(COMPRESSION_ZSTD);
+	BIND_ENUM_CONSTANT(COMPRESSION_COUNT);
 }
 
 } // namespace zylann::voxel
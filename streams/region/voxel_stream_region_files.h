@@ -1,11 +1,15 @@
 #ifndef VOXEL_STREAM_REGION_H
 #define VOXEL_STREAM_REGION_H
 
+#include "../../util/containers/dynamic_bitset.h"
 #include "../../util/containers/fixed_array.h"
+#include "../../util/containers/std_unordered_map.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/file_utils.h"
+#include "../../util/io/file_locker.h"
 #include "../../util/thread/mutex.h"
 #include "../voxel_stream.h"
+#include "../voxel_stream_cache.h"
 #include "region_file.h"
 
 namespace zylann::voxel {
@@ -31,6 +35,13 @@ public:
 	void load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) override;
 	void save_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) override;
 
+	bool supports_loading_all_blocks() const override {
+		return true;
+	}
+	void load_all_blocks(FullLoadingResult &result) override;
+	bool get_load_all_blocks_parts(unsigned int max_count, StdVector<FullLoadingPart> &out_parts) override;
+	void load_all_blocks_part(const FullLoadingPart &part, FullLoadingResult &result) override;
+
 	int get_used_channels_mask() const override;
 
 	String get_directory() const;
@@ -52,6 +63,50 @@ public:
 
 	void convert_files(Dictionary d);
 
+	// Rewrites region files so their blocks are stored contiguously and without unused space left by blocks that
+	// changed size. Regions are processed one at a time, so the stream can still be used in the meantime.
+	bool compact_files(bool recompress);
+
+	bool is_memory_mapped_reads_enabled() const;
+	void set_memory_mapped_reads_enabled(bool enabled);
+
+	bool is_async_reads_enabled() const;
+	void set_async_reads_enabled(bool enabled);
+
+	enum Compression { //
+		COMPRESSION_LZ4 = 0,
+		COMPRESSION_ZSTD,
+		COMPRESSION_COUNT
+	};
+
+	void set_compression(Compression compression);
+	Compression get_compression() const;
+
+	void set_zstd_compression_level(int level);
+	int get_zstd_compression_level() const;
+
+	// Builds a Zstd dictionary from up to `sample_count` blocks already saved in LOD 0, and uses it to compress blocks
+	// saved from now on. Dictionaries are stored next to the meta file. Previous dictionaries are kept, because blocks
+	// that were compressed with them still need them.
+	bool train_zstd_dictionary(int sample_count, int max_size);
+
+	// When above 0, saved blocks are cached up to this amount of memory, and get written to region files in the
+	// background instead of while saving
+	void set_cache_memory_budget_mb(int mb);
+	int get_cache_memory_budget_mb() const;
+
+	// How many region files can be open at once. Reopening files is expensive, but operating systems limit how many
+	// files a process can have open.
+	void set_max_open_regions(int count);
+	int get_max_open_regions() const;
+
+	// How many headers of closed region files are kept in memory, so reopening them doesn't have to read them again
+	void set_max_cached_region_headers(int count);
+	int get_max_cached_region_headers() const;
+
+	// Cache usage, how many loads were answered by the existence index, and how often region headers had to be read
+	Dictionary get_statistics() const;
+
 	void flush() override;
 
 protected:
@@ -68,10 +123,29 @@ private:
 	};
 
 	EmergeResult _load_block(VoxelBuffer &out_buffer, Vector3i block_pos, int lod);
+	// All blocks must be in the same region
+	void _load_region_blocks(Span<VoxelStream::VoxelQueryData> p_blocks, Span<const unsigned int> indices);
 	void _save_block(VoxelBuffer &voxel_buffer, Vector3i block_pos, int lod);
+	// Writes blocks waiting in the cache to region files. The stream's mutex must be locked.
+	void flush_cache_no_lock();
+	// Flushes now or schedules a background flush, depending on how much was saved
+	void request_cache_flush_if_needed();
 
 	zylann::godot::FileResult save_meta();
 	zylann::godot::FileResult load_meta();
+	String get_zstd_dictionary_file_path(uint32_t id) const;
+	zylann::godot::FileResult save_zstd_dictionary(const CompressedData::ZstdDictionary &dictionary);
+	std::shared_ptr<CompressedData::ZstdDictionary> load_zstd_dictionary(uint32_t id) const;
+	CompressedData::CompressionParams get_compression_params() const;
+	void update_region_compression_params();
+	bool get_region_positions(unsigned int lod_index, StdVector<Vector3i> &out_positions) const;
+	struct RegionLocation {
+		Vector3i position;
+		uint8_t lod_index;
+	};
+	// Region files of all LODs, always in the same order
+	bool get_all_region_locations(StdVector<RegionLocation> &out_locations) const;
+	RegionFormat get_region_format() const;
 	Vector3i get_block_position_from_voxels(const Vector3i &origin_in_voxels) const;
 	Vector3i get_region_position_from_blocks(const Vector3i &block_position) const;
 	void close_all_regions();
@@ -80,6 +154,12 @@ private:
 	void close_region(CachedRegion *cache);
 	CachedRegion *get_region_from_cache(const Vector3i pos, int lod) const;
 	void close_oldest_region();
+	// Keeps the header of a region that was just closed. The stream's mutex must be locked.
+	void cache_region_header(const CachedRegion &cached_region);
+	// Returns false if the block is known to not be saved, so there is no need to open its region file.
+	// The stream's mutex must be locked.
+	bool may_contain_block_no_lock(Vector3i region_pos, Vector3i block_rpos, unsigned int lod);
+	void update_existence_index_from_region(const CachedRegion &cached_region);
 
 	struct Meta {
 		uint8_t version = -1;
@@ -88,6 +168,8 @@ private:
 		uint8_t region_size_po2 = 0; // How many blocks in one cubic region
 		FixedArray<VoxelBuffer::Depth, VoxelBuffer::MAX_CHANNELS> channel_depths;
 		uint32_t sector_size = 0; // Blocks are stored at offsets multiple of that size
+		// In the order they were created. The last one is used when saving with Zstd.
+		StdVector<uint32_t> zstd_dictionary_ids;
 	};
 
 	static bool check_meta(const Meta &meta);
@@ -122,21 +204,89 @@ private:
 		int lod = 0;
 		bool file_exists = false;
 		RegionFile region;
-		uint64_t last_opened = 0;
-		// uint64_t last_accessed;
+		// Lock of the file in the engine's FileLocker, kept so it doesn't have to be looked up by path again
+		FileLocker::File *file_lock = nullptr;
+		// Value of `_region_use_counter` when this region was last used
+		uint64_t last_used = 0;
 	};
 
 	String _directory_path;
 	Meta _meta;
 	bool _meta_loaded = false;
 	bool _meta_saved = false;
+	bool _memory_mapped_reads_enabled = false;
+	bool _async_reads_enabled = false;
+	Compression _compression = COMPRESSION_LZ4;
+	int _zstd_compression_level = CompressedData::ZSTD_DEFAULT_LEVEL;
+	// Loaded along with the meta file, matching `Meta::zstd_dictionary_ids`
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> _zstd_dictionaries;
 	StdVector<CachedRegion *> _region_cache;
-	// TODO Add memory caches to increase capacity.
 	unsigned int _max_open_regions = MIN(8, FOPEN_MAX);
+	// Incremented each time a region is used, to find which ones were least recently used
+	uint64_t _region_use_counter = 0;
+	// Only used when it has a memory budget. Otherwise blocks are saved directly.
+	VoxelStreamCache _cache;
+
+	// Tells which blocks were saved, so loading blocks that don't exist doesn't have to open region files, which is
+	// common when generator output isn't saved. The list of region files of a LOD is obtained the first time it is
+	// accessed, and blocks of a region are known once its header has been read. It takes one bit per block.
+	// Region files are assumed to not be modified by other processes.
+	struct ExistenceIndex {
+		struct Region {
+			// Indexed like blocks in the region header. Only valid if `header_loaded` is true.
+			DynamicBitset blocks;
+			bool header_loaded = false;
+		};
+		struct Lod {
+			// Regions missing from this map have no file. Only valid if `listed` is true.
+			StdUnorderedMap<Vector3i, Region> regions;
+			bool listed = false;
+		};
+		FixedArray<Lod, constants::MAX_LOD> lods;
+		uint64_t skipped_loads = 0;
+
+		void clear() {
+			for (unsigned int i = 0; i < lods.size(); ++i) {
+				lods[i].regions.clear();
+				lods[i].listed = false;
+			}
+		}
+	};
+
+	ExistenceIndex _existence_index;
+
+	// Headers of region files that were closed, so reopening them doesn't have to read them again. Like the existence
+	// index, this assumes region files are not modified by other processes. Regions that are open are not in there,
+	// since they hold the current version of their header. It is put back when they get closed.
+	struct RegionHeaderCache {
+		struct Entry {
+			RegionFile::Header header;
+			// Value of `_region_use_counter` when the region was last used
+			uint64_t last_used = 0;
+		};
+		FixedArray<StdUnorderedMap<Vector3i, Entry>, constants::MAX_LOD> lods;
+		unsigned int count = 0;
+		// Regions opened with a cached header
+		uint64_t hits = 0;
+		// Regions opened without a cached header
+		uint64_t misses = 0;
+
+		void clear() {
+			for (unsigned int i = 0; i < lods.size(); ++i) {
+				lods[i].clear();
+			}
+			count = 0;
+		}
+	};
+
+	RegionHeaderCache _region_header_cache;
+	unsigned int _max_cached_region_headers = 128;
 
 	Mutex _mutex;
 };
 
 } // namespace zylann::voxel
 
+VARIANT_ENUM_CAST(zylann::voxel::VoxelStreamRegionFiles::Compression);
+
 #endif // VOXEL_STREAM_REGION_H
@@ -2,17 +2,56 @@
 #include "../engine/voxel_engine.h"
 #include "../generators/generate_block_task.h"
 #include "../storage/voxel_buffer.h"
+#include "../storage/voxel_data.h"
 #include "../util/io/log.h"
+#include "../util/math/conv.h"
 #include "../util/profiling.h"
 #include "../util/string/format.h"
 #include "../util/tasks/async_dependency_tracker.h"
 
+#include <algorithm>
+
 namespace zylann::voxel {
 
 namespace {
+
 std::atomic_int g_debug_save_block_tasks_count = { 0 };
+std::atomic_uint64_t g_removed_unchanged_blocks = { 0 };
+std::atomic_uint64_t g_removed_unchanged_bytes = { 0 };
+
+// Tells if voxels are the same as what would be obtained if the block was not found in the stream
+bool is_same_as_generator_output(
+		const VoxelBuffer &voxels,
+		VoxelGenerator &generator,
+		const VoxelData &data,
+		Vector3i block_position,
+		uint8_t lod_index
+) {
+	ZN_PROFILE_SCOPE();
+
+	// Generators don't produce metadata
+	if (voxels.get_voxel_metadata().size() > 0 ||
+		voxels.get_block_metadata().get_type() != VoxelMetadata::TYPE_EMPTY) {
+		return false;
+	}
+
+	// Same steps as `GenerateBlockTask`
+	const int block_size = voxels.get_size().x;
+	const Vector3i origin_in_voxels = (block_position << lod_index) * block_size;
+
+	VoxelBuffer generated_voxels(VoxelBuffer::ALLOCATOR_POOL);
+	generated_voxels.create(voxels.get_size());
+	VoxelGenerator::VoxelQueryData query_data{ generated_voxels, origin_in_voxels, lod_index };
+	generator.generate_block_with_modifiers(query_data, data.get_modifiers());
+
+	// Uniform and non-uniform channels don't compare equal even with the same values
+	generated_voxels.compress_uniform_channels();
+
+	return voxels.equals(generated_voxels);
 }
 
+} // namespace
+
 SaveBlockDataTask::SaveBlockDataTask(
 		VolumeID p_volume_id,
 		Vector3i p_block_pos,
@@ -33,6 +72,10 @@ SaveBlockDataTask::SaveBlockDataTask(
 		_tracker(p_tracker) {
 	//
 	++g_debug_save_block_tasks_count;
+	if (_tracker != nullptr && _voxels != nullptr) {
+		_tracked_bytes = _voxels->get_channels_memory_usage();
+		_tracker->add_total_work(_tracked_bytes);
+	}
 }
 
 SaveBlockDataTask::SaveBlockDataTask(
@@ -59,12 +102,67 @@ SaveBlockDataTask::SaveBlockDataTask(
 
 SaveBlockDataTask::~SaveBlockDataTask() {
 	--g_debug_save_block_tasks_count;
+	if (_encoded_voxels.size() > 0) {
+		// The task got destroyed before writing
+		_stream_dependency->encoded_bytes_in_flight -= _encoded_voxels.size();
+	}
+}
+
+void SaveBlockDataTask::set_voxel_data(std::shared_ptr<VoxelData> data) {
+	_data = data;
+}
+
+void SaveBlockDataTask::set_save_priority(uint8_t priority) {
+	_save_priority = priority;
+}
+
+void SaveBlockDataTask::assign_save_priorities_by_viewer_distance(
+		Span<VoxelData::BlockToSave> blocks_to_save,
+		const Transform3D &volume_transform,
+		unsigned int block_size
+) {
+	ZN_PROFILE_SCOPE();
+
+	struct Item {
+		float distance_sq;
+		unsigned int index;
+	};
+	static thread_local StdVector<Item> tls_items;
+	tls_items.clear();
+
+	const VoxelEngine &engine = VoxelEngine::get_singleton();
+
+	for (unsigned int i = 0; i < blocks_to_save.size(); ++i) {
+		const VoxelData::BlockToSave &b = blocks_to_save[i];
+		const int lod_block_size = block_size << b.lod_index;
+		const Vector3 block_center = to_vec3(b.position * lod_block_size) + Vector3(0.5f, 0.5f, 0.5f) * lod_block_size;
+		tls_items.push_back({ engine.get_closest_viewer_distance_squared(volume_transform.xform(block_center)), i });
+	}
+
+	std::sort(tls_items.begin(), tls_items.end(), [](const Item &a, const Item &b) {
+		return a.distance_sq < b.distance_sq;
+	});
+
+	// Using ranks rather than distances, so priorities spread over the whole band regardless of how far blocks are
+	const uint64_t count = tls_items.size();
+	for (uint64_t rank = 0; rank < count; ++rank) {
+		blocks_to_save[tls_items[rank].index].save_priority =
+				TaskPriority::BAND_MAX - rank * TaskPriority::BAND_MAX / count;
+	}
 }
 
 int SaveBlockDataTask::debug_get_running_count() {
 	return g_debug_save_block_tasks_count;
 }
 
+uint64_t SaveBlockDataTask::get_total_removed_unchanged_blocks() {
+	return g_removed_unchanged_blocks;
+}
+
+uint64_t SaveBlockDataTask::get_total_removed_unchanged_bytes() {
+	return g_removed_unchanged_bytes;
+}
+
 void SaveBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	ZN_PROFILE_SCOPE();
 
@@ -72,24 +170,55 @@ void SaveBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 	Ref<VoxelStream> stream = _stream_dependency->stream;
 	ZN_ASSERT_RETURN_MSG(stream.is_valid(), "Save task was triggered without a stream, this is a bug");
 
+	if (_stage == STAGE_ENCODE) {
+		run_encode_stage(ctx, **stream);
+		return;
+	}
+
 	if (_save_voxels) {
-		if (_voxels == nullptr) {
+		if (_stage == STAGE_WRITE) {
+			// Voxels were prepared in the general pool, only I/O is left
+			if (_delete_voxels) {
+				stream->delete_voxel_block(_position, _lod);
+
+			} else if (_encoded_voxels.size() > 0) {
+				_stream_dependency->encoded_bytes_in_flight -= _encoded_voxels.size();
+				VoxelStream::EncodedVoxelQueryData q{
+					_encoded_voxels, nullptr, _position, _lod, VoxelStream::RESULT_ERROR
+				};
+				stream->save_encoded_voxel_blocks(Span<VoxelStream::EncodedVoxelQueryData>(&q, 1));
+				_encoded_voxels.clear();
+			}
+
+		} else if (_voxels == nullptr) {
 			if (_tracker != nullptr) {
 				_tracker->abort();
 			}
 			ZN_PRINT_ERROR("Voxels to save shouldn't be null");
 			return;
-		}
 
-		VoxelBuffer voxels_copy(VoxelBuffer::ALLOCATOR_POOL);
-		// Note, we are not locking voxels here. This is supposed to be done at the time this task is scheduled.
-		// If this is not a copy, it means the map it came from is getting unloaded anyways.
-		// TODO Optimization: is that copy necessary? It's possible it was already done while issuing the
-		// request
-		_voxels->copy_to(voxels_copy, true);
-		_voxels = nullptr;
-		VoxelStream::VoxelQueryData q{ voxels_copy, _position, _lod, VoxelStream::RESULT_ERROR };
-		stream->save_voxel_block(q);
+		} else if (stream->supports_encoded_voxel_blocks()) {
+			// Encoding voxels is CPU-heavy, it shouldn't hold up the thread doing I/O
+			_stage = STAGE_ENCODE;
+			ctx.status = ThreadedTaskContext::STATUS_TAKEN_OUT;
+			VoxelEngine::get_singleton().push_async_task(this);
+			return;
+
+		} else {
+			VoxelBuffer voxels_copy(VoxelBuffer::ALLOCATOR_POOL);
+			// Note, we are not locking voxels here. Voxels of blocks are copy-on-write, so they can't change while we
+			// reference them. A copy is still made because streams are allowed to modify what they save, and only
+			// one block at a time gets copied per thread.
+			_voxels->copy_to(voxels_copy, true);
+			_voxels = nullptr;
+
+			if (is_unchanged(voxels_copy, *stream)) {
+				stream->delete_voxel_block(_position, _lod);
+			} else {
+				VoxelStream::VoxelQueryData q{ voxels_copy, _position, _lod, VoxelStream::RESULT_ERROR };
+				stream->save_voxel_block(q);
+			}
+		}
 	}
 
 	if (_save_instances && stream->supports_instance_blocks()) {
@@ -113,14 +242,72 @@ void SaveBlockDataTask::run(zylann::ThreadedTaskContext &ctx) {
 			// This was the last task in a tracked group of saving tasks, we may flush now
 			stream->flush();
 		}
+		_tracker->post_work_done(_tracked_bytes);
 		_tracker->post_complete();
 	}
 
 	_has_run = true;
 }
 
+void SaveBlockDataTask::run_encode_stage(ThreadedTaskContext &ctx, VoxelStream &stream) {
+	ZN_PROFILE_SCOPE();
+
+	if (_stream_dependency->is_encoded_bytes_budget_exceeded()) {
+		// Wait for I/O to catch up, instead of piling up encoded voxels in memory
+		ctx.status = ThreadedTaskContext::STATUS_POSTPONED;
+		return;
+	}
+
+	VoxelBuffer voxels_copy(VoxelBuffer::ALLOCATOR_POOL);
+	// Same as when saving directly, voxels can't change while we reference them
+	_voxels->copy_to(voxels_copy, true);
+	_voxels = nullptr;
+
+	if (is_unchanged(voxels_copy, stream)) {
+		_delete_voxels = true;
+
+	} else if (stream.encode_voxel_block(voxels_copy, _encoded_voxels)) {
+		_stream_dependency->encoded_bytes_in_flight += _encoded_voxels.size();
+
+	} else {
+		ZN_PRINT_ERROR(format("Failed to encode block {} lod {}", _position, static_cast<int>(_lod)));
+		_encoded_voxels.clear();
+	}
+
+	// Go back to the I/O thread
+	_stage = STAGE_WRITE;
+	ctx.status = ThreadedTaskContext::STATUS_TAKEN_OUT;
+	VoxelEngine::get_singleton().push_async_io_task(this);
+}
+
+bool SaveBlockDataTask::is_unchanged(VoxelBuffer &voxels, const VoxelStream &stream) const {
+	Ref<VoxelGenerator> generator = _stream_dependency->generator;
+
+	if (_data == nullptr || generator.is_null() || !stream.is_unchanged_block_removal_enabled() ||
+		stream.get_save_generator_output() || !stream.supports_deleting_voxel_blocks()) {
+		return false;
+	}
+
+	voxels.compress_uniform_channels();
+
+	if (!is_same_as_generator_output(voxels, **generator, *_data, _position, _lod)) {
+		return false;
+	}
+
+	// Loading will fall back on the generator, which gives the same result without using storage
+	ZN_PRINT_VERBOSE(format(
+			"Block {} lod {} is identical to generator output, deleting it from the stream",
+			_position,
+			static_cast<int>(_lod)
+	));
+	++g_removed_unchanged_blocks;
+	g_removed_unchanged_bytes += voxels.get_channels_memory_usage();
+	return true;
+}
+
 TaskPriority SaveBlockDataTask::get_priority() {
 	TaskPriority p;
+	p.band0 = _save_priority;
 	p.band2 = constants::TASK_PRIORITY_SAVE_BAND2;
 	p.band3 = constants::TASK_PRIORITY_BAND3_DEFAULT;
 	return p;
@@ -144,9 +331,7 @@ void SaveBlockDataTask::apply_result() {
 			o.had_voxels = _save_voxels;
 			o.type = VoxelEngine::BlockDataOutput::TYPE_SAVED;
 
-			VoxelEngine::VolumeCallbacks callbacks = VoxelEngine::get_singleton().get_volume_callbacks(_volume_id);
-			CRASH_COND(callbacks.data_output_callback == nullptr);
-			callbacks.data_output_callback(callbacks.data, o);
+			VoxelEngine::get_singleton().push_volume_data_output(_volume_id, o);
 		}
 
 	} else {
@@ -1,8 +1,11 @@
 #ifndef SAVE_BLOCK_DATA_TASK_H
 #define SAVE_BLOCK_DATA_TASK_H
 
+#include "../constants/voxel_constants.h"
 #include "../engine/ids.h"
 #include "../engine/streaming_dependency.h"
+#include "../storage/voxel_data.h"
+#include "../util/math/transform_3d.h"
 #include "../util/memory/memory.h"
 #include "../util/tasks/threaded_task.h"
 
@@ -42,26 +45,69 @@ public:
 		return "SaveBlockData";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_STREAMING;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 	TaskPriority get_priority() override;
 	bool is_cancelled() override;
 	void apply_result() override;
 
+	// Optional. If the stream has `unchanged_block_removal_enabled`, voxels get compared with the output of the
+	// generator and modifiers of this data. Blocks that are identical get deleted from the stream instead of saved.
+	void set_voxel_data(std::shared_ptr<VoxelData> data);
+
+	// Optional. Saving tasks with a higher value run first.
+	void set_save_priority(uint8_t priority);
+
+	// Gives blocks closer to viewers a higher save priority. When a lot of blocks are saved at once, such as when the
+	// game quits, the most important ones are on disk first in case there isn't enough time to save all of them.
+	static void assign_save_priorities_by_viewer_distance(
+			Span<VoxelData::BlockToSave> blocks_to_save,
+			const Transform3D &volume_transform,
+			unsigned int block_size
+	);
+
 	static int debug_get_running_count();
 
+	// Blocks deleted from streams instead of being saved, because they were identical to generator output
+	static uint64_t get_total_removed_unchanged_blocks();
+	// Voxel memory those blocks were taking when they were about to be saved
+	static uint64_t get_total_removed_unchanged_bytes();
+
 private:
+	// Used when the stream supports encoded voxels, so they get encoded in the general pool
+	enum Stage : uint8_t {
+		STAGE_START,
+		STAGE_ENCODE,
+		STAGE_WRITE,
+	};
+
+	void run_encode_stage(ThreadedTaskContext &ctx, VoxelStream &stream);
+	// If the block can be deleted instead of saved, because it is identical to generator output
+	bool is_unchanged(VoxelBuffer &voxels, const VoxelStream &stream) const;
+
 	std::shared_ptr<VoxelBuffer> _voxels;
+	StdVector<uint8_t> _encoded_voxels;
 	UniquePtr<InstanceBlockData> _instances;
 	Vector3i _position; // In data blocks of the specified lod
 	VolumeID _volume_id;
 	uint8_t _lod;
+	uint8_t _save_priority = 0;
+	Stage _stage = STAGE_START;
 	bool _has_run = false;
+	bool _delete_voxels = false;
 	bool _save_instances = false;
 	bool _save_voxels = false;
 	bool _flush_on_last_tracked_task = false;
 	std::shared_ptr<StreamingDependency> _stream_dependency;
+	// Optional, used to compare voxels with generator output
+	std::shared_ptr<VoxelData> _data;
 	// Optional tracking, can be null
 	std::shared_ptr<AsyncDependencyTracker> _tracker;
+	// Bytes of voxels this task accounts for in the tracker
+	uint64_t _tracked_bytes = 0;
 };
 
 } // namespace voxel
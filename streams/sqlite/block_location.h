@@ -4,6 +4,7 @@
 #include "../../constants/voxel_constants.h"
 #include "../../util/containers/fixed_array.h"
 #include "../../util/math/box3i.h"
+#include "../../util/math/morton.h"
 #include "../../util/math/vector3i.h"
 #include "../../util/string/conv.h"
 #include <limits>
@@ -39,6 +40,10 @@ struct BlockLocation {
 		// Voxels: -268,435,456..268,435,455
 		// LODs: 24
 		FORMAT_BLOB80_X25_Y25_Z25_L5,
+		// Same range as FORMAT_INT64_X19_Y19_Z19_L7, but coordinates are interleaved in Morton order. Blocks close to
+		// each other get close keys, and each LOD is a contiguous range of keys, so areas can be loaded with range
+		// scans instead of individual lookups.
+		FORMAT_INT64_MORTON_X19_Y19_Z19_L7,
 		FORMAT_COUNT,
 	};
 
@@ -74,6 +79,23 @@ struct BlockLocation {
 		return b;
 	}
 
+	// Coordinates are offset to be positive, so keys sort in the same order as interleaved coordinates
+	static constexpr int MORTON_X19_Y19_Z19_L7_OFFSET = 1 << 18;
+
+	uint64_t encode_morton_x19_y19_z19_l7() const {
+		// lllllllm mmmmmmmm ... mmmmmmmm (57 bits of interleaved ZXY coordinates)
+		const uint64_t m = math::encode_morton_3d_u64(position + Vector3iUtil::create(MORTON_X19_Y19_Z19_L7_OFFSET));
+		return ((static_cast<uint64_t>(lod) & 0x7f) << 57) | (m & ((uint64_t(1) << 57) - 1));
+	}
+
+	static BlockLocation decode_morton_x19_y19_z19_l7(uint64_t id) {
+		BlockLocation b;
+		b.position = math::decode_morton_3d_u64(id & ((uint64_t(1) << 57) - 1)) -
+				Vector3iUtil::create(MORTON_X19_Y19_Z19_L7_OFFSET);
+		b.lod = ((id >> 57) & 0x7f);
+		return b;
+	}
+
 	std::string_view encode_string_csd(BlockLocationBuffer &buffer) const {
 		Span<uint8_t> s = to_span(buffer);
 		unsigned int pos = int32_to_string_base10(position.x, s);
@@ -181,6 +203,8 @@ struct BlockLocation {
 				return encode_x16_y16_z16_l16();
 			case FORMAT_INT64_X19_Y19_Z19_L7:
 				return encode_x19_y19_z19_l7();
+			case FORMAT_INT64_MORTON_X19_Y19_Z19_L7:
+				return encode_morton_x19_y19_z19_l7();
 			default:
 				ZN_CRASH_MSG("Invalid coordinate format");
 				return 0;
@@ -193,6 +217,8 @@ struct BlockLocation {
 				return decode_x16_y16_z16_l16(id);
 			case FORMAT_INT64_X19_Y19_Z19_L7:
 				return decode_x19_y19_z19_l7(id);
+			case FORMAT_INT64_MORTON_X19_Y19_Z19_L7:
+				return decode_morton_x19_y19_z19_l7(id);
 			default:
 				ZN_CRASH_MSG("Invalid coordinate format");
 				return BlockLocation();
@@ -204,6 +230,7 @@ struct BlockLocation {
 			case FORMAT_INT64_X16_Y16_Z16_L16:
 				return Box3i::from_min_max(Vector3iUtil::create(-(1 << 15)), Vector3iUtil::create((1 << 15) - 1));
 			case FORMAT_INT64_X19_Y19_Z19_L7:
+			case FORMAT_INT64_MORTON_X19_Y19_Z19_L7:
 				return Box3i::from_min_max(Vector3iUtil::create(-(1 << 18)), Vector3iUtil::create((1 << 18) - 1));
 			case FORMAT_STRING_CSD:
 				// In theory should be maximum an int32 can hold, but let's use the maximum extent we can get with the
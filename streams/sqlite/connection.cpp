@@ -1,7 +1,10 @@
 #include "connection.h"
 #include "../../thirdparty/sqlite/sqlite3.h"
+#include "../../util/hash_funcs.h"
 #include "../../util/profiling.h"
+#include "../../util/profiling_clock.h"
 #include "../../util/string/format.h"
+#include <algorithm>
 
 namespace zylann::voxel::sqlite {
 
@@ -17,6 +20,7 @@ inline CoordinateColumnType get_coordinate_column_type(BlockLocation::Coordinate
 	switch (cf) {
 		case BlockLocation::FORMAT_INT64_X16_Y16_Z16_L16:
 		case BlockLocation::FORMAT_INT64_X19_Y19_Z19_L7:
+		case BlockLocation::FORMAT_INT64_MORTON_X19_Y19_Z19_L7:
 			return COORDINATE_COLUMN_U64;
 		case BlockLocation::FORMAT_STRING_CSD:
 			return COORDINATE_COLUMN_STRING;
@@ -172,6 +176,70 @@ static void finalize(sqlite3_stmt *&s) {
 	}
 }
 
+// Repeats `item` `count` times, separated with commas, between `begin` and `end`
+StdString make_batch_sql(const char *begin, const char *item, unsigned int count, const char *end) {
+	StdString sql = begin;
+	for (unsigned int i = 0; i < count; ++i) {
+		if (i > 0) {
+			sql += ",";
+		}
+		sql += item;
+	}
+	sql += end;
+	return sql;
+}
+
+// Saves and loads can happen on different connections at the same time. Waiting a bit is preferable to failing.
+const int BUSY_TIMEOUT_MS = 5000;
+
+// Creates the table of blocks whose voxels are in `voxel_blobs` (such blocks have null `vb` in the blocks table), and
+// triggers keeping reference counts up to date. Saving voxels directly in the blocks table drops the reference.
+// Removing voxels has to remove the reference explicitely.
+bool create_block_blob_refs_table(sqlite3 *db) {
+	// Locations must have the same type as in the blocks table, otherwise comparing them can't use the index. That
+	// table may have been created with another coordinate format than the preferred one, so we get its type from it.
+	sqlite3_stmt *column_type_statement = nullptr;
+	if (!prepare(db, &column_type_statement, "SELECT type FROM pragma_table_info('blocks') WHERE name='loc'")) {
+		return false;
+	}
+	StdString sql = "CREATE TABLE IF NOT EXISTS block_blob_refs (loc ";
+	const int rc = sqlite3_step(column_type_statement);
+	if (rc == SQLITE_ROW) {
+		sql += reinterpret_cast<const char *>(sqlite3_column_text(column_type_statement, 0));
+	}
+	finalize(column_type_statement);
+	if (rc != SQLITE_ROW) {
+		ZN_PRINT_ERROR(format("Could not get the type of block locations: {}", sqlite3_errmsg(db)));
+		return false;
+	}
+	sql += " PRIMARY KEY, hash BLOB);"
+		   "CREATE TRIGGER IF NOT EXISTS voxel_blob_ref_added AFTER INSERT ON block_blob_refs BEGIN "
+		   "UPDATE voxel_blobs SET refcount=refcount+1 WHERE hash=new.hash; "
+		   "END;"
+		   "CREATE TRIGGER IF NOT EXISTS voxel_blob_ref_changed AFTER UPDATE OF hash ON block_blob_refs "
+		   "WHEN old.hash IS NOT new.hash BEGIN "
+		   "UPDATE voxel_blobs SET refcount=refcount+1 WHERE hash=new.hash; "
+		   "UPDATE voxel_blobs SET refcount=refcount-1 WHERE hash=old.hash; "
+		   "DELETE FROM voxel_blobs WHERE hash=old.hash AND refcount<=0; "
+		   "END;"
+		   "CREATE TRIGGER IF NOT EXISTS voxel_blob_ref_removed AFTER DELETE ON block_blob_refs BEGIN "
+		   "UPDATE voxel_blobs SET refcount=refcount-1 WHERE hash=old.hash; "
+		   "DELETE FROM voxel_blobs WHERE hash=old.hash AND refcount<=0; "
+		   "END;"
+		   "CREATE TRIGGER IF NOT EXISTS voxel_blob_ref_overwritten AFTER UPDATE OF vb ON blocks "
+		   "WHEN new.vb IS NOT NULL BEGIN "
+		   "DELETE FROM block_blob_refs WHERE loc=new.loc; "
+		   "END";
+
+	char *error_message = nullptr;
+	if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error_message) != SQLITE_OK) {
+		ZN_PRINT_ERROR(format("Failed to create table: {}", error_message));
+		sqlite3_free(error_message);
+		return false;
+	}
+	return true;
+}
+
 } // namespace
 
 Connection::Connection() {}
@@ -180,16 +248,22 @@ Connection::~Connection() {
 	close();
 }
 
-bool Connection::open(const char *fpath, const BlockLocation::CoordinateFormat preferred_coordinate_format) {
+bool Connection::open(
+		const char *fpath,
+		const BlockLocation::CoordinateFormat preferred_coordinate_format,
+		const bool read_only
+) {
 	ZN_PROFILE_SCOPE();
 	close();
 
-	int rc = sqlite3_open_v2(fpath, &_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+	const int open_flags = read_only ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+	int rc = sqlite3_open_v2(fpath, &_db, open_flags, nullptr);
 	if (rc != 0) {
 		ZN_PRINT_ERROR(format("Could not open database at path \"{}\": {}", fpath, sqlite3_errmsg(_db)));
 		close();
 		return false;
 	}
+	_read_only = read_only;
 
 	// Note, SQLite uses UTF-8 encoding by default. We rely on that.
 	// https://www.sqlite.org/c3ref/open.html
@@ -197,13 +271,35 @@ bool Connection::open(const char *fpath, const BlockLocation::CoordinateFormat p
 	sqlite3 *db = _db;
 	char *error_message = nullptr;
 
+	sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+
+	if (!read_only) {
+		// With WAL journaling, reading doesn't wait for writing and the other way around. The mode is stored in the
+		// database, so read-only connections use it too. It is not available on all filesystems, in which case SQLite
+		// keeps using the previous mode.
+		// When using WAL, database consistency is preserved without syncing on every commit, though the last commits
+		// might be lost on power failure.
+		rc = sqlite3_exec(db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL", nullptr, nullptr, &error_message);
+		if (rc != SQLITE_OK) {
+			ZN_PRINT_VERBOSE(format("Could not enable WAL journaling: {}", error_message));
+			sqlite3_free(error_message);
+			error_message = nullptr;
+		}
+	}
+
 	const CoordinateColumnType block_key_column_type = get_coordinate_column_type(preferred_coordinate_format);
 
 	// Create tables if they don't exist.
-	const char *tables[3] = {
+	// The dictionaries and deduplication tables were added without changing version, since older versions can ignore
+	// them. Older versions can't load deduplicated blocks, but saving over them keeps reference counts correct, because
+	// that is handled by triggers stored in the database.
+	const char *tables[5] = {
 		"CREATE TABLE IF NOT EXISTS meta (version INTEGER, block_size_po2 INTEGER, coordinate_format INTEGER)",
 		"",
-		"CREATE TABLE IF NOT EXISTS channels (idx INTEGER PRIMARY KEY, depth INTEGER)"
+		"CREATE TABLE IF NOT EXISTS channels (idx INTEGER PRIMARY KEY, depth INTEGER)",
+		"CREATE TABLE IF NOT EXISTS zstd_dictionaries (id INTEGER UNIQUE, content BLOB)",
+		// Voxel data shared by several blocks, identified by a hash of its content
+		"CREATE TABLE IF NOT EXISTS voxel_blobs (hash BLOB PRIMARY KEY, refcount INTEGER, data BLOB)"
 	};
 	switch (block_key_column_type) {
 		case COORDINATE_COLUMN_U64:
@@ -219,7 +315,8 @@ bool Connection::open(const char *fpath, const BlockLocation::CoordinateFormat p
 			ZN_CRASH_MSG("Invalid column type");
 			break;
 	}
-	for (size_t i = 0; i < 3; ++i) {
+	// Read-only connections can't create tables, they must already exist
+	for (size_t i = 0; i < 5 && !read_only; ++i) {
 		rc = sqlite3_exec(db, tables[i], nullptr, nullptr, &error_message);
 		if (rc != SQLITE_OK) {
 			ZN_PRINT_ERROR(format("Failed to create table: {}", error_message));
@@ -228,6 +325,10 @@ bool Connection::open(const char *fpath, const BlockLocation::CoordinateFormat p
 			return false;
 		}
 	}
+	if (!read_only && !create_block_blob_refs_table(db)) {
+		close();
+		return false;
+	}
 
 	if (!prepare(db, &_load_version_statement, "SELECT version FROM meta")) {
 		return false;
@@ -239,6 +340,69 @@ bool Connection::open(const char *fpath, const BlockLocation::CoordinateFormat p
 	}
 
 	// Prepare statements
+	// Voxels of a block are either in the blocks table, or shared in the blobs table
+	if (!prepare(
+				db,
+				&_get_voxel_block_statement,
+				"SELECT COALESCE(blocks.vb, voxel_blobs.data) FROM blocks "
+				"LEFT JOIN block_blob_refs ON block_blob_refs.loc=blocks.loc "
+				"LEFT JOIN voxel_blobs ON voxel_blobs.hash=block_blob_refs.hash "
+				"WHERE blocks.loc=:loc"
+		)) {
+		return false;
+	}
+	if (!prepare(db, &_get_instance_block_statement, "SELECT instances FROM blocks WHERE loc=:loc")) {
+		return false;
+	}
+	// Batches smaller than the statement bind the remaining parameters to null, which matches nothing
+	const StdString get_voxel_blocks_sql = make_batch_sql(
+			"SELECT blocks.loc, COALESCE(blocks.vb, voxel_blobs.data) FROM blocks "
+			"LEFT JOIN block_blob_refs ON block_blob_refs.loc=blocks.loc "
+			"LEFT JOIN voxel_blobs ON voxel_blobs.hash=block_blob_refs.hash "
+			"WHERE blocks.loc IN (",
+			"?",
+			LOAD_BATCH_SIZE,
+			")"
+	);
+	if (!prepare(db, &_get_voxel_blocks_statement, get_voxel_blocks_sql.c_str())) {
+		return false;
+	}
+	const StdString get_instance_blocks_sql =
+			make_batch_sql("SELECT loc, instances FROM blocks WHERE loc IN (", "?", LOAD_BATCH_SIZE, ")");
+	if (!prepare(db, &_get_instance_blocks_statement, get_instance_blocks_sql.c_str())) {
+		return false;
+	}
+	// Only useful with integer keys ordered in space, but they are cheap to prepare
+	if (!prepare(
+				db,
+				&_get_voxel_blocks_in_key_range_statement,
+				"SELECT blocks.loc, COALESCE(blocks.vb, voxel_blobs.data) FROM blocks "
+				"LEFT JOIN block_blob_refs ON block_blob_refs.loc=blocks.loc "
+				"LEFT JOIN voxel_blobs ON voxel_blobs.hash=block_blob_refs.hash "
+				"WHERE blocks.loc BETWEEN ? AND ?"
+		)) {
+		return false;
+	}
+	if (!prepare(
+				db,
+				&_get_instance_blocks_in_key_range_statement,
+				"SELECT loc, instances FROM blocks WHERE loc BETWEEN ? AND ?"
+		)) {
+		return false;
+	}
+	// Write transactions take the lock immediately. Otherwise two connections could both start reading, then wait
+	// for each other when trying to write.
+	if (!prepare(db, &_begin_statement, read_only ? "BEGIN" : "BEGIN IMMEDIATE")) {
+		return false;
+	}
+	if (!prepare(db, &_end_statement, "END")) {
+		return false;
+	}
+	if (!prepare(db, &_load_meta_statement, "SELECT * FROM meta")) {
+		return false;
+	}
+
+	// Write statements can be prepared on read-only connections, only executing them fails
 	if (!prepare(
 				db,
 				&_update_voxel_block_statement,
@@ -247,9 +411,6 @@ bool Connection::open(const char *fpath, const BlockLocation::CoordinateFormat p
 		)) {
 		return false;
 	}
-	if (!prepare(db, &_get_voxel_block_statement, "SELECT vb FROM blocks WHERE loc=:loc")) {
-		return false;
-	}
 	if (!prepare(
 				db,
 				&_update_instance_block_statement,
@@ -258,16 +419,36 @@ bool Connection::open(const char *fpath, const BlockLocation::CoordinateFormat p
 		)) {
 		return false;
 	}
-	if (!prepare(db, &_get_instance_block_statement, "SELECT instances FROM blocks WHERE loc=:loc")) {
+	if (!prepare(db, &_save_voxel_blob_statement, "INSERT OR IGNORE INTO voxel_blobs VALUES (:hash, 0, :data)")) {
+		return false;
+	}
+	if (!prepare(
+				db,
+				&_save_block_blob_ref_statement,
+				"INSERT INTO block_blob_refs VALUES (:loc, :hash) "
+				"ON CONFLICT(loc) DO UPDATE SET hash=excluded.hash"
+		)) {
 		return false;
 	}
-	if (!prepare(db, &_begin_statement, "BEGIN")) {
+	if (!prepare(db, &_remove_block_blob_ref_statement, "DELETE FROM block_blob_refs WHERE loc=:loc")) {
 		return false;
 	}
-	if (!prepare(db, &_end_statement, "END")) {
+	const StdString update_voxel_blocks_sql = make_batch_sql(
+			"INSERT INTO blocks VALUES ",
+			"(?, ?, null)",
+			SAVE_BATCH_SIZE,
+			" ON CONFLICT(loc) DO UPDATE SET vb=excluded.vb"
+	);
+	if (!prepare(db, &_update_voxel_blocks_statement, update_voxel_blocks_sql.c_str())) {
 		return false;
 	}
-	if (!prepare(db, &_load_meta_statement, "SELECT * FROM meta")) {
+	const StdString update_instance_blocks_sql = make_batch_sql(
+			"INSERT INTO blocks VALUES ",
+			"(?, null, ?)",
+			SAVE_BATCH_SIZE,
+			" ON CONFLICT(loc) DO UPDATE SET instances=excluded.instances"
+	);
+	if (!prepare(db, &_update_instance_blocks_statement, update_instance_blocks_sql.c_str())) {
 		return false;
 	}
 
@@ -297,16 +478,50 @@ bool Connection::open(const char *fpath, const BlockLocation::CoordinateFormat p
 		)) {
 		return false;
 	}
-	if (!prepare(db, &_load_all_blocks_statement, "SELECT * FROM blocks")) {
+	if (!prepare(
+				db,
+				&_load_all_blocks_statement,
+				"SELECT blocks.loc, COALESCE(blocks.vb, voxel_blobs.data), blocks.instances FROM blocks "
+				"LEFT JOIN block_blob_refs ON block_blob_refs.loc=blocks.loc "
+				"LEFT JOIN voxel_blobs ON voxel_blobs.hash=block_blob_refs.hash"
+		)) {
 		return false;
 	}
 	if (!prepare(db, &_load_all_block_keys_statement, "SELECT loc FROM blocks")) {
 		return false;
 	}
+	if (!prepare(db, &_load_all_block_rowids_statement, "SELECT rowid FROM blocks ORDER BY rowid")) {
+		return false;
+	}
+	if (!prepare(
+				db,
+				&_load_blocks_in_rowid_range_statement,
+				"SELECT blocks.loc, COALESCE(blocks.vb, voxel_blobs.data), blocks.instances FROM blocks "
+				"LEFT JOIN block_blob_refs ON block_blob_refs.loc=blocks.loc "
+				"LEFT JOIN voxel_blobs ON voxel_blobs.hash=block_blob_refs.hash "
+				"WHERE blocks.rowid BETWEEN ? AND ?"
+		)) {
+		return false;
+	}
+	if (!prepare(
+				db, &_save_zstd_dictionary_statement, "INSERT OR IGNORE INTO zstd_dictionaries VALUES (:id, :content)"
+		)) {
+		return false;
+	}
+	if (!prepare(
+				db, &_load_zstd_dictionaries_statement, "SELECT id, content FROM zstd_dictionaries ORDER BY rowid"
+		)) {
+		return false;
+	}
 
 	// Is the database setup?
 	Meta meta = load_meta();
 	if (meta.version == -1) {
+		if (read_only) {
+			ZN_PRINT_ERROR(format("Could not open database at path \"{}\" as read-only, it is not setup", fpath));
+			close();
+			return false;
+		}
 		// Setup database
 		meta.version = VERSION_LATEST;
 		// Defaults
@@ -357,14 +572,28 @@ void Connection::close() {
 	finalize(_get_voxel_block_statement);
 	finalize(_update_instance_block_statement);
 	finalize(_get_instance_block_statement);
+	finalize(_update_voxel_blocks_statement);
+	finalize(_save_voxel_blob_statement);
+	finalize(_save_block_blob_ref_statement);
+	finalize(_remove_block_blob_ref_statement);
+	finalize(_get_voxel_blocks_statement);
+	finalize(_update_instance_blocks_statement);
+	finalize(_get_instance_blocks_statement);
+	finalize(_get_voxel_blocks_in_key_range_statement);
+	finalize(_get_instance_blocks_in_key_range_statement);
 	finalize(_load_meta_statement);
 	finalize(_save_meta_statement);
 	finalize(_load_channels_statement);
 	finalize(_save_channel_statement);
 	finalize(_load_all_blocks_statement);
 	finalize(_load_all_block_keys_statement);
+	finalize(_load_all_block_rowids_statement);
+	finalize(_load_blocks_in_rowid_range_statement);
+	finalize(_save_zstd_dictionary_statement);
+	finalize(_load_zstd_dictionaries_statement);
 	sqlite3_close(_db);
 	_db = nullptr;
+	_read_only = false;
 	_opened_path.clear();
 }
 
@@ -405,8 +634,10 @@ bool Connection::end_transaction() {
 
 bool Connection::save_block(const BlockLocation loc, const Span<const uint8_t> block_data, const BlockType type) {
 	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V_MSG(!_read_only, false, "Can't save blocks with a read-only connection");
 
 	sqlite3 *db = _db;
+	const ProfilingClock profiling_clock;
 
 	sqlite3_stmt *update_block_statement;
 	switch (type) {
@@ -453,6 +684,247 @@ bool Connection::save_block(const BlockLocation loc, const Span<const uint8_t> b
 		return false;
 	}
 
+	// Voxels could also have been deduplicated
+	if (type == VOXELS && block_data.size() == 0 && !remove_block_blob_ref(loc)) {
+		return false;
+	}
+
+	_stats.blocks_saved += 1;
+	_stats.bytes_saved += block_data.size();
+	_stats.save_time_usec += profiling_clock.get_elapsed_microseconds();
+
+	return true;
+}
+
+bool Connection::save_blocks(
+		Span<const BlockLocation> locations,
+		Span<const Span<const uint8_t>> blocks_data,
+		const BlockType type
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(locations.size() == blocks_data.size(), false);
+	ZN_ASSERT_RETURN_V_MSG(!_read_only, false, "Can't save blocks with a read-only connection");
+
+	sqlite3_stmt *update_blocks_statement;
+	switch (type) {
+		case VOXELS:
+			update_blocks_statement = _update_voxel_blocks_statement;
+			break;
+		case INSTANCES:
+			update_blocks_statement = _update_instance_blocks_statement;
+			break;
+		default:
+			update_blocks_statement = nullptr;
+			CRASH_NOW();
+	}
+
+	// Full batches are saved with a multi-row statement, the rest is saved one by one
+	unsigned int begin = 0;
+	for (; begin + SAVE_BATCH_SIZE <= locations.size(); begin += SAVE_BATCH_SIZE) {
+		const ProfilingClock profiling_clock;
+		const Span<const Span<const uint8_t>> batch_data = blocks_data.sub(begin, SAVE_BATCH_SIZE);
+		if (!save_blocks_batch(locations.sub(begin, SAVE_BATCH_SIZE), batch_data, update_blocks_statement)) {
+			return false;
+		}
+		for (unsigned int i = 0; i < batch_data.size() && type == VOXELS; ++i) {
+			// Voxels could also have been deduplicated
+			if (batch_data[i].size() == 0 && !remove_block_blob_ref(locations[begin + i])) {
+				return false;
+			}
+		}
+		_stats.blocks_saved += SAVE_BATCH_SIZE;
+		for (const Span<const uint8_t> data : batch_data) {
+			_stats.bytes_saved += data.size();
+		}
+		_stats.save_time_usec += profiling_clock.get_elapsed_microseconds();
+	}
+
+	for (; begin < locations.size(); ++begin) {
+		if (!save_block(locations[begin], blocks_data[begin], type)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Connection::save_blocks_batch(
+		Span<const BlockLocation> locations,
+		Span<const Span<const uint8_t>> blocks_data,
+		sqlite3_stmt *statement
+) {
+	sqlite3 *db = _db;
+
+	int rc = sqlite3_reset(statement);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+
+	// Each binding holds the encoded location, which must remain valid until the statement is executed
+	FixedArray<BindBlockCoordinates, SAVE_BATCH_SIZE> block_coordinates_bindings;
+
+	for (unsigned int i = 0; i < locations.size(); ++i) {
+		const int loc_param_index = i * 2 + 1;
+		const int data_param_index = loc_param_index + 1;
+
+		BindBlockCoordinates &binding = block_coordinates_bindings[i];
+		if (!binding.bind(db, statement, loc_param_index, _meta.coordinate_format, locations[i])) {
+			return false;
+		}
+
+		const Span<const uint8_t> block_data = blocks_data[i];
+		if (block_data.size() == 0) {
+			rc = sqlite3_bind_null(statement, data_param_index);
+		} else {
+			// The data remains valid until the statement is executed, so SQLite doesn't need to copy it
+			rc = sqlite3_bind_blob(statement, data_param_index, block_data.data(), block_data.size(), SQLITE_STATIC);
+		}
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+	}
+
+	rc = sqlite3_step(statement);
+	if (rc != SQLITE_DONE) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+
+	return true;
+}
+
+bool Connection::save_deduplicated_voxel_blocks(
+		Span<const BlockLocation> locations,
+		Span<const Span<const uint8_t>> blocks_data
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(locations.size() == blocks_data.size(), false);
+
+	for (unsigned int i = 0; i < locations.size(); ++i) {
+		if (!save_deduplicated_voxel_block(locations[i], blocks_data[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Connection::save_deduplicated_voxel_block(const BlockLocation loc, const Span<const uint8_t> block_data) {
+	ZN_ASSERT_RETURN_V_MSG(!_read_only, false, "Can't save blocks with a read-only connection");
+
+	if (block_data.size() == 0) {
+		// Removing the block, nothing to share
+		return save_block(loc, block_data, VOXELS);
+	}
+
+	sqlite3 *db = _db;
+	const ProfilingClock profiling_clock;
+
+	uint64_t hash[2];
+	hash_murmur3_128(block_data, HASH_MURMUR3_SEED, hash);
+
+	// Only the first block having this content writes it
+	sqlite3_stmt *save_blob_statement = _save_voxel_blob_statement;
+
+	int rc = sqlite3_reset(save_blob_statement);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	// The data remains valid until the statement is executed, so SQLite doesn't need to copy it
+	rc = sqlite3_bind_blob(save_blob_statement, 1, hash, sizeof(hash), SQLITE_STATIC);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	rc = sqlite3_bind_blob(save_blob_statement, 2, block_data.data(), block_data.size(), SQLITE_STATIC);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	rc = sqlite3_step(save_blob_statement);
+	if (rc != SQLITE_DONE) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	const bool blob_reused = sqlite3_changes(db) == 0;
+
+	// The block row still has to exist, with its voxels coming from the blob.
+	// This doesn't drop the previous reference yet, so saving the same content again keeps the blob.
+	sqlite3_stmt *update_block_statement = _update_voxel_block_statement;
+
+	rc = sqlite3_reset(update_block_statement);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	BindBlockCoordinates block_coordinates_binding;
+	if (!block_coordinates_binding.bind(db, update_block_statement, 1, _meta.coordinate_format, loc)) {
+		return false;
+	}
+	rc = sqlite3_bind_null(update_block_statement, 2);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	rc = sqlite3_step(update_block_statement);
+	if (rc != SQLITE_DONE) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+
+	// Reference counts are updated by triggers
+	sqlite3_stmt *save_ref_statement = _save_block_blob_ref_statement;
+
+	rc = sqlite3_reset(save_ref_statement);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	if (!block_coordinates_binding.bind(db, save_ref_statement, 1, _meta.coordinate_format, loc)) {
+		return false;
+	}
+	rc = sqlite3_bind_blob(save_ref_statement, 2, hash, sizeof(hash), SQLITE_STATIC);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	rc = sqlite3_step(save_ref_statement);
+	if (rc != SQLITE_DONE) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+
+	_stats.blocks_saved += 1;
+	if (blob_reused) {
+		_stats.blobs_reused += 1;
+	} else {
+		_stats.bytes_saved += block_data.size();
+	}
+	_stats.save_time_usec += profiling_clock.get_elapsed_microseconds();
+
+	return true;
+}
+
+bool Connection::remove_block_blob_ref(const BlockLocation loc) {
+	sqlite3 *db = _db;
+	sqlite3_stmt *statement = _remove_block_blob_ref_statement;
+
+	int rc = sqlite3_reset(statement);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	BindBlockCoordinates block_coordinates_binding;
+	if (!block_coordinates_binding.bind(db, statement, 1, _meta.coordinate_format, loc)) {
+		return false;
+	}
+	rc = sqlite3_step(statement);
+	if (rc != SQLITE_DONE) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
 	return true;
 }
 
@@ -463,6 +935,8 @@ VoxelStream::ResultCode Connection::load_block(
 ) {
 	sqlite3 *db = _db;
 
+	const ProfilingClock profiling_clock;
+
 	sqlite3_stmt *get_block_statement;
 	switch (type) {
 		case VOXELS:
@@ -514,9 +988,307 @@ VoxelStream::ResultCode Connection::load_block(
 
 	ZN_ASSERT_RETURN_V(block_coordinates_binding.unbind(db, get_block_statement, 1), VoxelStream::RESULT_ERROR);
 
+	if (result == VoxelStream::RESULT_BLOCK_FOUND) {
+		_stats.blocks_loaded += 1;
+		_stats.bytes_loaded += out_block_data.size();
+	}
+	_stats.load_time_usec += profiling_clock.get_elapsed_microseconds();
+
 	return result;
 }
 
+bool Connection::load_blocks(
+		Span<const BlockLocation> locations,
+		const BlockType type,
+		void *callback_data,
+		void (*process_block_func)(void *callback_data, unsigned int location_index, Span<const uint8_t> data)
+) {
+	ZN_PROFILE_SCOPE();
+	CRASH_COND(process_block_func == nullptr);
+
+	sqlite3_stmt *get_blocks_statement;
+	switch (type) {
+		case VOXELS:
+			get_blocks_statement = _get_voxel_blocks_statement;
+			break;
+		case INSTANCES:
+			get_blocks_statement = _get_instance_blocks_statement;
+			break;
+		default:
+			get_blocks_statement = nullptr;
+			CRASH_NOW();
+	}
+
+	const ProfilingClock profiling_clock;
+	uint64_t bytes_loaded = 0;
+	uint64_t blocks_loaded = 0;
+	bool success = true;
+
+	if (_meta.coordinate_format == BlockLocation::FORMAT_INT64_MORTON_X19_Y19_Z19_L7) {
+		success = load_blocks_in_key_ranges(
+				locations, type, callback_data, process_block_func, bytes_loaded, blocks_loaded
+		);
+
+	} else {
+		for (unsigned int begin = 0; begin < locations.size(); begin += LOAD_BATCH_SIZE) {
+			const unsigned int count =
+					math::min(LOAD_BATCH_SIZE, static_cast<unsigned int>(locations.size() - begin));
+			if (!load_blocks_batch(
+						locations.sub(begin, count),
+						begin,
+						get_blocks_statement,
+						callback_data,
+						process_block_func,
+						bytes_loaded,
+						blocks_loaded
+				)) {
+				success = false;
+				break;
+			}
+		}
+	}
+
+	// Includes time spent in the callback, which is usually small compared to the query
+	_stats.blocks_loaded += blocks_loaded;
+	_stats.bytes_loaded += bytes_loaded;
+	_stats.load_time_usec += profiling_clock.get_elapsed_microseconds();
+
+	return success;
+}
+
+bool Connection::load_blocks_batch(
+		Span<const BlockLocation> locations,
+		unsigned int index_offset,
+		sqlite3_stmt *statement,
+		void *callback_data,
+		void (*process_block_func)(void *callback_data, unsigned int location_index, Span<const uint8_t> data),
+		uint64_t &out_bytes_loaded,
+		uint64_t &out_blocks_loaded
+) {
+	sqlite3 *db = _db;
+
+	int rc = sqlite3_reset(statement);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+
+	// Each binding holds the encoded location, which must remain valid until the query is done
+	FixedArray<BindBlockCoordinates, LOAD_BATCH_SIZE> block_coordinates_bindings;
+
+	for (unsigned int i = 0; i < LOAD_BATCH_SIZE; ++i) {
+		const int param_index = i + 1;
+		if (i < locations.size()) {
+			BindBlockCoordinates &binding = block_coordinates_bindings[i];
+			if (!binding.bind(db, statement, param_index, _meta.coordinate_format, locations[i])) {
+				return false;
+			}
+		} else {
+			rc = sqlite3_bind_null(statement, param_index);
+			if (rc != SQLITE_OK) {
+				ERR_PRINT(sqlite3_errmsg(db));
+				return false;
+			}
+		}
+	}
+
+	const CoordinateColumnType key_column_type = get_coordinate_column_type(_meta.coordinate_format);
+
+	while (true) {
+		rc = sqlite3_step(statement);
+		if (rc == SQLITE_ROW) {
+			BlockLocation location;
+			if (!read_block_location(_meta.coordinate_format, key_column_type, statement, 0, location)) {
+				continue;
+			}
+
+			const void *blob = sqlite3_column_blob(statement, 1);
+			const size_t blob_size = sqlite3_column_bytes(statement, 1);
+			if (blob_size == 0) {
+				// The row exists, but only has data of the other type
+				continue;
+			}
+			const Span<const uint8_t> data(static_cast<const uint8_t *>(blob), blob_size);
+
+			// Rows come in any order. The same location could also have been requested more than once.
+			for (unsigned int i = 0; i < locations.size(); ++i) {
+				const BlockLocation &requested_location = locations[i];
+				if (requested_location.position == location.position && requested_location.lod == location.lod) {
+					process_block_func(callback_data, index_offset + i, data);
+					out_bytes_loaded += blob_size;
+					++out_blocks_loaded;
+				}
+			}
+			continue;
+		}
+		if (rc != SQLITE_DONE) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+		break;
+	}
+
+	return true;
+}
+
+bool Connection::load_blocks_in_key_ranges(
+		Span<const BlockLocation> locations,
+		const BlockType type,
+		void *callback_data,
+		void (*process_block_func)(void *callback_data, unsigned int location_index, Span<const uint8_t> data),
+		uint64_t &out_bytes_loaded,
+		uint64_t &out_blocks_loaded
+) {
+	ZN_PROFILE_SCOPE();
+	sqlite3 *db = _db;
+
+	sqlite3_stmt *range_statement;
+	sqlite3_stmt *batch_statement;
+	switch (type) {
+		case VOXELS:
+			range_statement = _get_voxel_blocks_in_key_range_statement;
+			batch_statement = _get_voxel_blocks_statement;
+			break;
+		case INSTANCES:
+			range_statement = _get_instance_blocks_in_key_range_statement;
+			batch_statement = _get_instance_blocks_statement;
+			break;
+		default:
+			range_statement = nullptr;
+			batch_statement = nullptr;
+			CRASH_NOW();
+	}
+
+	struct KeyAndIndex {
+		uint64_t key;
+		unsigned int location_index;
+
+		inline bool operator<(const KeyAndIndex &other) const {
+			return key < other.key;
+		}
+	};
+
+	// Sorting keys makes locations close to each other in space adjacent, so clusters of them can be found
+	StdVector<KeyAndIndex> keys;
+	keys.reserve(locations.size());
+	for (unsigned int i = 0; i < locations.size(); ++i) {
+		keys.push_back(KeyAndIndex{ locations[i].encode_u64(_meta.coordinate_format), i });
+	}
+	std::sort(keys.begin(), keys.end());
+
+	// Locations that are not part of a dense enough cluster are loaded with regular batches
+	StdVector<BlockLocation> scattered_locations;
+	StdVector<unsigned int> scattered_location_indices;
+
+	unsigned int begin = 0;
+	while (begin < keys.size()) {
+		// Grow the range as long as it remains dense enough
+		unsigned int end = begin + 1;
+		while (end < keys.size()) {
+			const uint64_t span = keys[end].key - keys[begin].key + 1;
+			if (span > static_cast<uint64_t>(KEY_RANGE_MAX_SPAN_RATIO) * (end - begin + 1)) {
+				break;
+			}
+			++end;
+		}
+		const Span<const KeyAndIndex> range_keys = to_span(keys).sub(begin, end - begin);
+		begin = end;
+
+		if (range_keys.size() < KEY_RANGE_MIN_LOCATIONS) {
+			for (const KeyAndIndex &ki : range_keys) {
+				scattered_locations.push_back(locations[ki.location_index]);
+				scattered_location_indices.push_back(ki.location_index);
+			}
+			continue;
+		}
+
+		int rc = sqlite3_reset(range_statement);
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+		rc = sqlite3_bind_int64(range_statement, 1, range_keys[0].key);
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+		rc = sqlite3_bind_int64(range_statement, 2, range_keys[range_keys.size() - 1].key);
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+
+		++_stats.key_range_scans;
+
+		while (true) {
+			rc = sqlite3_step(range_statement);
+			if (rc == SQLITE_ROW) {
+				const uint64_t key = sqlite3_column_int64(range_statement, 0);
+
+				// The range can contain rows that were not requested
+				const KeyAndIndex *range_keys_end = range_keys.data() + range_keys.size();
+				const KeyAndIndex *it = std::lower_bound(range_keys.data(), range_keys_end, KeyAndIndex{ key, 0 });
+				if (it == range_keys_end || it->key != key) {
+					continue;
+				}
+
+				const void *blob = sqlite3_column_blob(range_statement, 1);
+				const size_t blob_size = sqlite3_column_bytes(range_statement, 1);
+				if (blob_size == 0) {
+					// The row exists, but only has data of the other type
+					continue;
+				}
+				const Span<const uint8_t> data(static_cast<const uint8_t *>(blob), blob_size);
+
+				// The same location could have been requested more than once
+				for (; it != range_keys_end && it->key == key; ++it) {
+					process_block_func(callback_data, it->location_index, data);
+					out_bytes_loaded += blob_size;
+					++out_blocks_loaded;
+				}
+				continue;
+			}
+			if (rc != SQLITE_DONE) {
+				ERR_PRINT(sqlite3_errmsg(db));
+				return false;
+			}
+			break;
+		}
+	}
+
+	// Batches report indices in the list of scattered locations, which have to be converted back
+	struct RemapContext {
+		void *callback_data;
+		void (*process_block_func)(void *callback_data, unsigned int location_index, Span<const uint8_t> data);
+		Span<const unsigned int> location_indices;
+
+		static void process_block(void *cb_data, unsigned int scattered_index, Span<const uint8_t> data) {
+			RemapContext *ctx = static_cast<RemapContext *>(cb_data);
+			ctx->process_block_func(ctx->callback_data, ctx->location_indices[scattered_index], data);
+		}
+	};
+
+	RemapContext remap_context{ callback_data, process_block_func, to_span(scattered_location_indices) };
+
+	for (unsigned int batch_begin = 0; batch_begin < scattered_locations.size(); batch_begin += LOAD_BATCH_SIZE) {
+		const unsigned int count =
+				math::min(LOAD_BATCH_SIZE, static_cast<unsigned int>(scattered_locations.size() - batch_begin));
+		if (!load_blocks_batch(
+					to_span(scattered_locations).sub(batch_begin, count),
+					batch_begin,
+					batch_statement,
+					&remap_context,
+					RemapContext::process_block,
+					out_bytes_loaded,
+					out_blocks_loaded
+			)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool Connection::load_all_blocks(
 		void *callback_data,
 		void (*process_block_func)(
@@ -529,35 +1301,127 @@ bool Connection::load_all_blocks(
 	ZN_PROFILE_SCOPE();
 	CRASH_COND(process_block_func == nullptr);
 
+	const int rc = sqlite3_reset(_load_all_blocks_statement);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(_db));
+		return false;
+	}
+
+	return load_block_rows(_load_all_blocks_statement, callback_data, process_block_func);
+}
+
+bool Connection::get_block_rowid_ranges(unsigned int max_count, StdVector<RowidRange> &out_ranges) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(max_count > 0, false);
+
 	sqlite3 *db = _db;
-	sqlite3_stmt *load_all_blocks_statement = _load_all_blocks_statement;
+	sqlite3_stmt *load_all_block_rowids_statement = _load_all_block_rowids_statement;
 
-	int rc;
+	int rc = sqlite3_reset(load_all_block_rowids_statement);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+
+	// Rowids can be spread very unevenly (with integer coordinate formats they are the locations), so ranges are
+	// made from the actual list rather than from the minimum and maximum
+	StdVector<int64_t> rowids;
+
+	while (true) {
+		rc = sqlite3_step(load_all_block_rowids_statement);
+
+		if (rc == SQLITE_ROW) {
+			rowids.push_back(sqlite3_column_int64(load_all_block_rowids_statement, 0));
+
+		} else if (rc == SQLITE_DONE) {
+			break;
+
+		} else {
+			ERR_PRINT(String("Unexpected SQLite return code: {0}; errmsg: {1}").format(rc, sqlite3_errmsg(db)));
+			return false;
+		}
+	}
+
+	const size_t rows_per_range = (rowids.size() + max_count - 1) / max_count;
+
+	for (size_t begin = 0; begin < rowids.size(); begin += rows_per_range) {
+		const size_t last = math::min(begin + rows_per_range, rowids.size()) - 1;
+		out_ranges.push_back(RowidRange{ rowids[begin], rowids[last] });
+	}
 
-	rc = sqlite3_reset(load_all_blocks_statement);
+	return true;
+}
+
+bool Connection::load_blocks_in_rowid_range(
+		const RowidRange range,
+		void *callback_data,
+		void (*process_block_func)(
+				void *callback_data,
+				BlockLocation location,
+				Span<const uint8_t> voxel_data,
+				Span<const uint8_t> instances_data
+		)
+) {
+	ZN_PROFILE_SCOPE();
+	CRASH_COND(process_block_func == nullptr);
+
+	sqlite3 *db = _db;
+	sqlite3_stmt *load_blocks_in_rowid_range_statement = _load_blocks_in_rowid_range_statement;
+
+	int rc = sqlite3_reset(load_blocks_in_rowid_range_statement);
 	if (rc != SQLITE_OK) {
 		ERR_PRINT(sqlite3_errmsg(db));
 		return false;
 	}
 
+	rc = sqlite3_bind_int64(load_blocks_in_rowid_range_statement, 1, range.first);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+	rc = sqlite3_bind_int64(load_blocks_in_rowid_range_statement, 2, range.last);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+		return false;
+	}
+
+	return load_block_rows(load_blocks_in_rowid_range_statement, callback_data, process_block_func);
+}
+
+bool Connection::load_block_rows(
+		sqlite3_stmt *statement,
+		void *callback_data,
+		void (*process_block_func)(
+				void *callback_data,
+				BlockLocation location,
+				Span<const uint8_t> voxel_data,
+				Span<const uint8_t> instances_data
+		)
+) {
+	sqlite3 *db = _db;
 	const CoordinateColumnType key_column_type = get_coordinate_column_type(_meta.coordinate_format);
 
+	ProfilingClock profiling_clock;
+	uint64_t blocks_loaded = 0;
+	uint64_t bytes_loaded = 0;
+
 	while (true) {
-		rc = sqlite3_step(load_all_blocks_statement);
+		const int rc = sqlite3_step(statement);
 
 		if (rc == SQLITE_ROW) {
 			ZN_PROFILE_SCOPE_NAMED("Row");
 
 			BlockLocation loc;
-			ZN_ASSERT_CONTINUE(
-					read_block_location(_meta.coordinate_format, key_column_type, load_all_blocks_statement, 0, loc)
-			);
+			ZN_ASSERT_CONTINUE(read_block_location(_meta.coordinate_format, key_column_type, statement, 0, loc));
+
+			const void *voxels_blob = sqlite3_column_blob(statement, 1);
+			const size_t voxels_blob_size = sqlite3_column_bytes(statement, 1);
 
-			const void *voxels_blob = sqlite3_column_blob(load_all_blocks_statement, 1);
-			const size_t voxels_blob_size = sqlite3_column_bytes(load_all_blocks_statement, 1);
+			const void *instances_blob = sqlite3_column_blob(statement, 2);
+			const size_t instances_blob_size = sqlite3_column_bytes(statement, 2);
 
-			const void *instances_blob = sqlite3_column_blob(load_all_blocks_statement, 2);
-			const size_t instances_blob_size = sqlite3_column_bytes(load_all_blocks_statement, 2);
+			++blocks_loaded;
+			bytes_loaded += voxels_blob_size + instances_blob_size;
 
 			// Using a function pointer because returning a big list of a copy of all the blobs can
 			// waste a lot of temporary memory
@@ -577,6 +1441,11 @@ bool Connection::load_all_blocks(
 		}
 	}
 
+	// Includes the time spent in the callback, which often decompresses data
+	_stats.blocks_loaded += blocks_loaded;
+	_stats.bytes_loaded += bytes_loaded;
+	_stats.load_time_usec += profiling_clock.get_elapsed_microseconds();
+
 	return true;
 }
 
@@ -627,6 +1496,75 @@ bool Connection::load_all_block_keys(
 	return true;
 }
 
+bool Connection::save_zstd_dictionary(uint32_t id, Span<const uint8_t> content) {
+	sqlite3 *db = _db;
+	sqlite3_stmt *save_zstd_dictionary_statement = _save_zstd_dictionary_statement;
+
+	int rc = sqlite3_reset(save_zstd_dictionary_statement);
+	if (rc != SQLITE_OK) {
+		ZN_PRINT_ERROR(sqlite3_errmsg(db));
+		return false;
+	}
+
+	rc = sqlite3_bind_int64(save_zstd_dictionary_statement, 1, id);
+	if (rc != SQLITE_OK) {
+		ZN_PRINT_ERROR(sqlite3_errmsg(db));
+		return false;
+	}
+	rc = sqlite3_bind_blob(save_zstd_dictionary_statement, 2, content.data(), content.size(), SQLITE_TRANSIENT);
+	if (rc != SQLITE_OK) {
+		ZN_PRINT_ERROR(sqlite3_errmsg(db));
+		return false;
+	}
+
+	rc = sqlite3_step(save_zstd_dictionary_statement);
+	if (rc != SQLITE_DONE) {
+		ZN_PRINT_ERROR(sqlite3_errmsg(db));
+		return false;
+	}
+
+	return true;
+}
+
+bool Connection::load_zstd_dictionaries(
+		void *callback_data,
+		void (*process_dictionary_func)(void *callback_data, uint32_t id, Span<const uint8_t> content)
+) {
+	ZN_ASSERT(process_dictionary_func != nullptr);
+
+	sqlite3 *db = _db;
+	sqlite3_stmt *load_zstd_dictionaries_statement = _load_zstd_dictionaries_statement;
+
+	int rc = sqlite3_reset(load_zstd_dictionaries_statement);
+	if (rc != SQLITE_OK) {
+		ZN_PRINT_ERROR(sqlite3_errmsg(db));
+		return false;
+	}
+
+	while (true) {
+		rc = sqlite3_step(load_zstd_dictionaries_statement);
+
+		if (rc == SQLITE_ROW) {
+			const uint32_t id = sqlite3_column_int64(load_zstd_dictionaries_statement, 0);
+			const void *blob = sqlite3_column_blob(load_zstd_dictionaries_statement, 1);
+			const size_t blob_size = sqlite3_column_bytes(load_zstd_dictionaries_statement, 1);
+
+			process_dictionary_func(
+					callback_data, id, Span<const uint8_t>(reinterpret_cast<const uint8_t *>(blob), blob_size)
+			);
+
+		} else if (rc == SQLITE_DONE) {
+			break;
+
+		} else {
+			ZN_PRINT_ERROR(format("Unexpected SQLite return code: {}; errmsg: {}", rc, sqlite3_errmsg(db)));
+			return false;
+		}
+	}
+
+	return true;
+}
+
 int Connection::load_version() {
 	sqlite3 *db = _db;
 	sqlite3_stmt *load_version_statement = _load_version_statement;
@@ -5,6 +5,7 @@
 #include "../../util/string/std_string.h"
 #include "../voxel_stream.h"
 #include "block_location.h"
+#include <atomic>
 
 struct sqlite3;
 struct sqlite3_stmt;
@@ -18,6 +19,17 @@ public:
 	static constexpr int VERSION_V1 = 1;
 	static constexpr int VERSION_LATEST = VERSION_V1;
 
+	// How many blocks are queried by a single statement in `load_blocks`
+	static constexpr unsigned int LOAD_BATCH_SIZE = 32;
+	// With coordinate formats ordered in space, locations whose keys are close are loaded with a single range scan
+	// instead of individual lookups, as long as the range contains at least that many requested locations...
+	static constexpr unsigned int KEY_RANGE_MIN_LOCATIONS = 4;
+	// ...and the range is not larger than that many times the number of requested locations in it. Other rows in the
+	// range are read for nothing, so this limits how many can be.
+	static constexpr unsigned int KEY_RANGE_MAX_SPAN_RATIO = 2;
+	// How many rows are written by a single statement in `save_blocks`
+	static constexpr unsigned int SAVE_BATCH_SIZE = 16;
+
 	struct Meta {
 		int version = -1;
 		int block_size_po2 = 0;
@@ -38,16 +50,41 @@ public:
 		INSTANCES
 	};
 
+	// Updated by the thread using the connection, may be read from any thread.
+	// Times only include time spent executing queries.
+	struct Stats {
+		std::atomic_uint64_t blocks_loaded = 0;
+		std::atomic_uint64_t bytes_loaded = 0;
+		std::atomic_uint64_t load_time_usec = 0;
+		std::atomic_uint64_t blocks_saved = 0;
+		std::atomic_uint64_t bytes_saved = 0;
+		std::atomic_uint64_t save_time_usec = 0;
+		// Deduplicated blocks whose content was already stored, so only a reference was written
+		std::atomic_uint64_t blobs_reused = 0;
+		// Queries loading a range of keys, which can return many of the requested blocks at once
+		std::atomic_uint64_t key_range_scans = 0;
+	};
+
 	Connection();
 	~Connection();
 
-	bool open(const char *fpath, const BlockLocation::CoordinateFormat preferred_coordinate_format);
+	// Databases are switched to WAL journaling when opened for writing, so read-only connections can load blocks
+	// while another connection is saving. A read-only connection requires the database to have been set up already.
+	bool open(
+			const char *fpath,
+			const BlockLocation::CoordinateFormat preferred_coordinate_format,
+			const bool read_only = false
+	);
 	void close();
 
 	bool is_open() const {
 		return _db != nullptr;
 	}
 
+	bool is_read_only() const {
+		return _read_only;
+	}
+
 	// Returns the file path from SQLite
 	const char *get_file_path() const;
 
@@ -62,12 +99,38 @@ public:
 
 	bool save_block(const BlockLocation loc, const Span<const uint8_t> block_data, const BlockType type);
 
+	// Saves many blocks using multi-row statements. Empty data removes the block.
+	bool save_blocks(
+			Span<const BlockLocation> locations,
+			Span<const Span<const uint8_t>> blocks_data,
+			const BlockType type
+	);
+
+	// Saves voxels of many blocks to the table of shared blobs, identified by a hash of their content. Blocks having
+	// the same content only store it once, and saving a content that is already stored only writes a reference to it.
+	// Empty data removes the block.
+	bool save_deduplicated_voxel_blocks(
+			Span<const BlockLocation> locations,
+			Span<const Span<const uint8_t>> blocks_data
+	);
+
 	VoxelStream::ResultCode load_block(
 			const BlockLocation loc,
 			StdVector<uint8_t> &out_block_data,
 			const BlockType type
 	);
 
+	// Loads many blocks using one query per `LOAD_BATCH_SIZE` locations. `process_block_func` is called for each block
+	// that was found, with the index of its location. Data is only valid during the call. Blocks that are not found
+	// are not reported. If the coordinate format is ordered in space, clusters of nearby locations are loaded with
+	// range scans instead.
+	bool load_blocks(
+			Span<const BlockLocation> locations,
+			const BlockType type,
+			void *callback_data,
+			void (*process_block_func)(void *callback_data, unsigned int location_index, Span<const uint8_t> data)
+	);
+
 	bool load_all_blocks(
 			void *callback_data,
 			void (*process_block_func)(
@@ -78,15 +141,49 @@ public:
 			)
 	);
 
+	// Inclusive range of rowids in the blocks table
+	struct RowidRange {
+		int64_t first;
+		int64_t last;
+	};
+
+	// Splits blocks into up to `max_count` ranges holding about the same number of blocks, which can be loaded
+	// separately with `load_blocks_in_rowid_range`, for example from different connections.
+	bool get_block_rowid_ranges(unsigned int max_count, StdVector<RowidRange> &out_ranges);
+
+	bool load_blocks_in_rowid_range(
+			const RowidRange range,
+			void *callback_data,
+			void (*process_block_func)(
+					void *callback_data,
+					BlockLocation location,
+					Span<const uint8_t> voxel_data,
+					Span<const uint8_t> instances_data
+			)
+	);
+
 	bool load_all_block_keys(
 			void *callback_data,
 			void (*process_block_func)(void *callback_data, BlockLocation location)
 	);
 
+	// Dictionaries are never removed, since blocks compressed with them would become unreadable
+	bool save_zstd_dictionary(uint32_t id, Span<const uint8_t> content);
+
+	// Dictionaries are given in the order they were saved
+	bool load_zstd_dictionaries(
+			void *callback_data,
+			void (*process_dictionary_func)(void *callback_data, uint32_t id, Span<const uint8_t> content)
+	);
+
 	const Meta &get_meta() const {
 		return _meta;
 	}
 
+	const Stats &get_stats() const {
+		return _stats;
+	}
+
 	void migrate_to_latest_version();
 
 private:
@@ -96,8 +193,46 @@ private:
 	bool migrate_to_next_version();
 	bool migrate_from_v0_to_v1();
 
+	bool save_deduplicated_voxel_block(const BlockLocation loc, const Span<const uint8_t> block_data);
+	bool remove_block_blob_ref(const BlockLocation loc);
+
+	bool save_blocks_batch(
+			Span<const BlockLocation> locations,
+			Span<const Span<const uint8_t>> blocks_data,
+			sqlite3_stmt *statement
+	);
+	bool load_blocks_batch(
+			Span<const BlockLocation> locations,
+			unsigned int index_offset,
+			sqlite3_stmt *statement,
+			void *callback_data,
+			void (*process_block_func)(void *callback_data, unsigned int location_index, Span<const uint8_t> data),
+			uint64_t &out_bytes_loaded,
+			uint64_t &out_blocks_loaded
+	);
+	bool load_blocks_in_key_ranges(
+			Span<const BlockLocation> locations,
+			const BlockType type,
+			void *callback_data,
+			void (*process_block_func)(void *callback_data, unsigned int location_index, Span<const uint8_t> data),
+			uint64_t &out_bytes_loaded,
+			uint64_t &out_blocks_loaded
+	);
+	bool load_block_rows(
+			sqlite3_stmt *statement,
+			void *callback_data,
+			void (*process_block_func)(
+					void *callback_data,
+					BlockLocation location,
+					Span<const uint8_t> voxel_data,
+					Span<const uint8_t> instances_data
+			)
+	);
+
 	StdString _opened_path;
 	Meta _meta;
+	Stats _stats;
+	bool _read_only = false;
 	sqlite3 *_db = nullptr;
 	sqlite3_stmt *_load_version_statement = nullptr;
 	sqlite3_stmt *_begin_statement = nullptr;
@@ -106,12 +241,25 @@ private:
 	sqlite3_stmt *_get_voxel_block_statement = nullptr;
 	sqlite3_stmt *_update_instance_block_statement = nullptr;
 	sqlite3_stmt *_get_instance_block_statement = nullptr;
+	sqlite3_stmt *_update_voxel_blocks_statement = nullptr;
+	sqlite3_stmt *_get_voxel_blocks_statement = nullptr;
+	sqlite3_stmt *_update_instance_blocks_statement = nullptr;
+	sqlite3_stmt *_save_voxel_blob_statement = nullptr;
+	sqlite3_stmt *_save_block_blob_ref_statement = nullptr;
+	sqlite3_stmt *_remove_block_blob_ref_statement = nullptr;
+	sqlite3_stmt *_get_instance_blocks_statement = nullptr;
+	sqlite3_stmt *_get_voxel_blocks_in_key_range_statement = nullptr;
+	sqlite3_stmt *_get_instance_blocks_in_key_range_statement = nullptr;
 	sqlite3_stmt *_load_meta_statement = nullptr;
 	sqlite3_stmt *_save_meta_statement = nullptr;
 	sqlite3_stmt *_load_channels_statement = nullptr;
 	sqlite3_stmt *_save_channel_statement = nullptr;
 	sqlite3_stmt *_load_all_blocks_statement = nullptr;
 	sqlite3_stmt *_load_all_block_keys_statement = nullptr;
+	sqlite3_stmt *_load_all_block_rowids_statement = nullptr;
+	sqlite3_stmt *_load_blocks_in_rowid_range_statement = nullptr;
+	sqlite3_stmt *_save_zstd_dictionary_statement = nullptr;
+	sqlite3_stmt *_load_zstd_dictionaries_statement = nullptr;
 };
 
 } // namespace zylann::voxel::sqlite
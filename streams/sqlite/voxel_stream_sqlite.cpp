@@ -1,10 +1,14 @@
 #include "voxel_stream_sqlite.h"
+#include "../../engine/voxel_engine.h"
 #include "../../util/godot/classes/project_settings.h"
+#include "../../util/godot/classes/time.h"
+#include "../../util/godot/core/array.h"
 #include "../../util/godot/core/string.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "../../util/string/std_string.h"
 #include "../compressed_data.h"
+#include "../flush_stream_task.h"
 #include "connection.h"
 
 #include <string_view>
@@ -15,6 +19,9 @@ namespace zylann::voxel {
 using namespace sqlite;
 
 namespace {
+// Cached blocks are written at least this often when the cache has a memory budget
+const uint64_t CACHE_FLUSH_INTERVAL_MSEC = 5000;
+
 StdVector<uint8_t> &get_tls_temp_block_data() {
 	thread_local StdVector<uint8_t> tls_temp_block_data;
 	return tls_temp_block_data;
@@ -44,12 +51,92 @@ bool validate_range(Vector3i pos, unsigned int lod_index, const Box3i coordinate
 	return true;
 }
 
+// Blocks to save in a single call, so they can use multi-row statements
+struct SaveBatch {
+	StdVector<BlockLocation> locations;
+	// Data of all blocks, one after the other
+	StdVector<uint8_t> data;
+	StdVector<size_t> data_ends;
+
+	void add(const BlockLocation location, Span<const uint8_t> block_data) {
+		locations.push_back(location);
+		data.insert(data.end(), block_data.begin(), block_data.end());
+		data_ends.push_back(data.size());
+	}
+
+	bool save(sqlite::Connection &con, const sqlite::Connection::BlockType type, const bool deduplicate = false) const {
+		StdVector<Span<const uint8_t>> blocks_data;
+		blocks_data.reserve(data_ends.size());
+		size_t begin = 0;
+		for (const size_t end : data_ends) {
+			blocks_data.push_back(to_span_from_position_and_size(data, begin, end - begin));
+			begin = end;
+		}
+		if (deduplicate) {
+			ZN_ASSERT_RETURN_V(type == sqlite::Connection::VOXELS, false);
+			return con.save_deduplicated_voxel_blocks(to_span(locations), to_span(blocks_data));
+		}
+		return con.save_blocks(to_span(locations), to_span(blocks_data), type);
+	}
+};
+
+// Turns rows of the database into blocks of a full loading result
+struct FullLoadingContext {
+	VoxelStream::FullLoadingResult &result;
+	Span<const std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries;
+
+	// Using local function instead of a lambda for quite stupid reason admittedly:
+	// Godot's clang-format does not allow to write function parameters in column,
+	// which makes the lambda break line length.
+	static void process_block_func(
+			void *callback_data,
+			const BlockLocation location,
+			Span<const uint8_t> voxel_data,
+			Span<const uint8_t> instances_data
+	) {
+		FullLoadingContext *ctx = reinterpret_cast<FullLoadingContext *>(callback_data);
+
+		if (voxel_data.size() == 0 && instances_data.size() == 0) {
+			ZN_PRINT_VERBOSE(format(
+					"Unexpected empty voxel data and instances data at {} lod {}", location.position, location.lod
+			));
+			return;
+		}
+
+		VoxelStream::FullLoadingResult::Block result_block;
+		result_block.position = location.position;
+		result_block.lod = location.lod;
+
+		if (voxel_data.size() > 0) {
+			std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+			ERR_FAIL_COND(!BlockSerializer::decompress_and_deserialize(voxel_data, *voxels, ctx->zstd_dictionaries));
+			result_block.voxels = voxels;
+		}
+
+		if (instances_data.size() > 0) {
+			StdVector<uint8_t> &temp_block_data = get_tls_temp_block_data();
+			if (!CompressedData::decompress(instances_data, temp_block_data)) {
+				ERR_PRINT("Failed to decompress instance block");
+				return;
+			}
+			result_block.instances_data = make_unique_instance<InstanceBlockData>();
+			if (!deserialize_instance_block_data(*result_block.instances_data, to_span_const(temp_block_data))) {
+				ERR_PRINT("Failed to deserialize instance block");
+				return;
+			}
+		}
+
+		ctx->result.blocks.push_back(std::move(result_block));
+	}
+};
+
 } // namespace
 
 VoxelStreamSQLite::VoxelStreamSQLite() {}
 
 VoxelStreamSQLite::~VoxelStreamSQLite() {
 	ZN_PRINT_VERBOSE("~VoxelStreamSQLite");
+	stop_writer_thread();
 	if (!_globalized_connection_path.empty() && _cache.get_indicative_block_count() > 0) {
 		ZN_PRINT_VERBOSE("~VoxelStreamSQLite flushy flushy");
 		flush_cache();
@@ -59,6 +146,10 @@ VoxelStreamSQLite::~VoxelStreamSQLite() {
 		delete *it;
 	}
 	_connection_pool.clear();
+	for (auto it = _read_connection_pool.begin(); it != _read_connection_pool.end(); ++it) {
+		delete *it;
+	}
+	_read_connection_pool.clear();
 	ZN_PRINT_VERBOSE("~VoxelStreamSQLite done");
 }
 
@@ -79,10 +170,21 @@ void VoxelStreamSQLite::set_database_path(String path) {
 		}
 	}
 	for (auto it = _connection_pool.begin(); it != _connection_pool.end(); ++it) {
-		delete *it;
+		delete_connection_no_lock(*it);
+	}
+	for (auto it = _read_connection_pool.begin(); it != _read_connection_pool.end(); ++it) {
+		delete_connection_no_lock(*it);
 	}
 	_block_keys_cache.clear();
 	_connection_pool.clear();
+	_read_connection_pool.clear();
+	_database_setup = false;
+
+	{
+		MutexLock compression_lock(_compression_mutex);
+		_zstd_dictionaries.clear();
+		_zstd_dictionaries_loaded = false;
+	}
 
 	_user_specified_connection_path = path;
 	// To support Godot shortcuts like `user://` and `res://` (though the latter won't work on exported builds)
@@ -109,12 +211,13 @@ void VoxelStreamSQLite::load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_bl
 
 	// Getting connection first to allow the key cache to load if enabled.
 	// This should be quick after the first call because the connection is cached.
-	sqlite::Connection *con = get_connection();
+	sqlite::Connection *con = get_connection(true);
 	ERR_FAIL_COND(con == nullptr);
 	const ScopeRecycle con_scope(this, con);
 
 	// Check the cache first
 	StdVector<unsigned int> blocks_to_load;
+	StdVector<uint8_t> &temp_encoded_voxels = get_tls_temp_block_data();
 	for (unsigned int i = 0; i < p_blocks.size(); ++i) {
 		VoxelStream::VoxelQueryData &q = p_blocks[i];
 		const Vector3i pos = q.position_in_blocks;
@@ -124,11 +227,24 @@ void VoxelStreamSQLite::load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_bl
 			continue;
 		}
 
-		if (_cache.load_voxel_block(pos, q.lod_index, q.voxel_buffer)) {
-			q.result = RESULT_BLOCK_FOUND;
-
-		} else {
-			blocks_to_load.push_back(i);
+		switch (_cache.load_voxel_block(pos, q.lod_index, q.voxel_buffer, temp_encoded_voxels)) {
+			case VoxelStreamCache::VOXELS_FOUND:
+				q.result = RESULT_BLOCK_FOUND;
+				break;
+			case VoxelStreamCache::VOXELS_FOUND_ENCODED:
+				if (decode_voxel_block(to_span_const(temp_encoded_voxels), q.voxel_buffer)) {
+					q.result = RESULT_BLOCK_FOUND;
+				} else {
+					ZN_PRINT_ERROR(format("Failed to read block {} lod {}", q.position_in_blocks, q.lod_index));
+					q.result = RESULT_ERROR;
+				}
+				break;
+			case VoxelStreamCache::VOXELS_DELETED:
+				q.result = RESULT_BLOCK_NOT_FOUND;
+				break;
+			default:
+				blocks_to_load.push_back(i);
+				break;
 		}
 	}
 
@@ -137,27 +253,49 @@ void VoxelStreamSQLite::load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_bl
 		return;
 	}
 
-	// TODO We should handle busy return codes
-	ERR_FAIL_COND(con->begin_transaction() == false);
+	const StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries = get_zstd_dictionaries();
 
-	for (unsigned int i = 0; i < blocks_to_load.size(); ++i) {
-		const unsigned int ri = blocks_to_load[i];
+	StdVector<BlockLocation> locations;
+	locations.reserve(blocks_to_load.size());
+	for (const unsigned int ri : blocks_to_load) {
 		VoxelStream::VoxelQueryData &q = p_blocks[ri];
-
 		BlockLocation loc;
 		loc.position = q.position_in_blocks;
 		loc.lod = q.lod_index;
+		locations.push_back(loc);
+		// Blocks that are found get reported below
+		q.result = RESULT_BLOCK_NOT_FOUND;
+	}
 
-		StdVector<uint8_t> &temp_block_data = get_tls_temp_block_data();
+	struct Context {
+		Span<VoxelStream::VoxelQueryData> blocks;
+		Span<const unsigned int> blocks_to_load;
+		Span<const std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries;
+
+		static void process_block_func(void *callback_data, unsigned int location_index, Span<const uint8_t> data) {
+			const Context *ctx = static_cast<const Context *>(callback_data);
+			VoxelStream::VoxelQueryData &q = ctx->blocks[ctx->blocks_to_load[location_index]];
+			if (BlockSerializer::decompress_and_deserialize(data, q.voxel_buffer, ctx->zstd_dictionaries)) {
+				q.result = RESULT_BLOCK_FOUND;
+			} else {
+				ZN_PRINT_ERROR(format("Failed to read block {} lod {}", q.position_in_blocks, q.lod_index));
+				q.result = RESULT_ERROR;
+			}
+		}
+	};
 
-		const ResultCode res = con->load_block(loc, temp_block_data, sqlite::Connection::VOXELS);
+	Context context;
+	context.blocks = p_blocks;
+	context.blocks_to_load = to_span(blocks_to_load);
+	context.zstd_dictionaries = to_span(zstd_dictionaries);
 
-		if (res == RESULT_BLOCK_FOUND) {
-			// TODO Not sure if we should actually expect non-null. There can be legit not found blocks.
-			BlockSerializer::decompress_and_deserialize(to_span_const(temp_block_data), q.voxel_buffer);
-		}
+	// TODO We should handle busy return codes
+	ERR_FAIL_COND(con->begin_transaction() == false);
 
-		q.result = res;
+	if (!con->load_blocks(to_span(locations), sqlite::Connection::VOXELS, &context, Context::process_block_func)) {
+		for (const unsigned int ri : blocks_to_load) {
+			p_blocks[ri].result = RESULT_ERROR;
+		}
 	}
 
 	ERR_FAIL_COND(con->end_transaction() == false);
@@ -187,10 +325,154 @@ void VoxelStreamSQLite::save_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_bl
 		}
 	}
 
-	// TODO We should consider using a serialized cache, and measure the threshold in bytes
-	if (_cache.get_indicative_block_count() >= CACHE_SIZE) {
-		flush_cache();
+	request_cache_flush_if_needed();
+}
+
+bool VoxelStreamSQLite::supports_encoded_voxel_blocks() const {
+	return true;
+}
+
+bool VoxelStreamSQLite::encode_voxel_block(const VoxelBuffer &voxels, StdVector<uint8_t> &out_data) const {
+	ZN_PROFILE_SCOPE();
+	BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(voxels, get_compression_params());
+	ZN_ASSERT_RETURN_V(res.success, false);
+	out_data = res.data;
+	return true;
+}
+
+bool VoxelStreamSQLite::decode_voxel_block(Span<const uint8_t> data, VoxelBuffer &out_voxels) const {
+	ZN_PROFILE_SCOPE();
+	const StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries = get_zstd_dictionaries();
+	return BlockSerializer::decompress_and_deserialize(data, out_voxels, to_span(zstd_dictionaries));
+}
+
+void VoxelStreamSQLite::load_encoded_voxel_blocks(Span<VoxelStream::EncodedVoxelQueryData> p_blocks) {
+	ZN_PROFILE_SCOPE();
+
+	sqlite::Connection *con = get_connection(true);
+	ERR_FAIL_COND(con == nullptr);
+	const ScopeRecycle con_scope(this, con);
+
+	// Check the cache first
+	StdVector<unsigned int> blocks_to_load;
+	for (unsigned int i = 0; i < p_blocks.size(); ++i) {
+		VoxelStream::EncodedVoxelQueryData &q = p_blocks[i];
+		ZN_ASSERT_CONTINUE(q.voxel_buffer != nullptr);
+		const Vector3i pos = q.position_in_blocks;
+		q.data.clear();
+
+		if (_block_keys_cache_enabled && !_block_keys_cache.contains(pos, q.lod_index)) {
+			q.result = RESULT_BLOCK_NOT_FOUND;
+			continue;
+		}
+
+		switch (_cache.load_voxel_block(pos, q.lod_index, *q.voxel_buffer, q.data)) {
+			case VoxelStreamCache::VOXELS_FOUND:
+			case VoxelStreamCache::VOXELS_FOUND_ENCODED:
+				q.result = RESULT_BLOCK_FOUND;
+				break;
+			case VoxelStreamCache::VOXELS_DELETED:
+				q.result = RESULT_BLOCK_NOT_FOUND;
+				break;
+			default:
+				blocks_to_load.push_back(i);
+				break;
+		}
+	}
+
+	if (blocks_to_load.size() == 0) {
+		return;
+	}
+
+	StdVector<BlockLocation> locations;
+	locations.reserve(blocks_to_load.size());
+	for (const unsigned int ri : blocks_to_load) {
+		VoxelStream::EncodedVoxelQueryData &q = p_blocks[ri];
+		BlockLocation loc;
+		loc.position = q.position_in_blocks;
+		loc.lod = q.lod_index;
+		locations.push_back(loc);
+		q.result = RESULT_BLOCK_NOT_FOUND;
 	}
+
+	struct Context {
+		Span<VoxelStream::EncodedVoxelQueryData> blocks;
+		Span<const unsigned int> blocks_to_load;
+
+		static void process_block_func(void *callback_data, unsigned int location_index, Span<const uint8_t> data) {
+			const Context *ctx = static_cast<const Context *>(callback_data);
+			VoxelStream::EncodedVoxelQueryData &q = ctx->blocks[ctx->blocks_to_load[location_index]];
+			// Decoding is left to the caller
+			q.data.assign(data.begin(), data.end());
+			q.result = RESULT_BLOCK_FOUND;
+		}
+	};
+
+	Context context;
+	context.blocks = p_blocks;
+	context.blocks_to_load = to_span(blocks_to_load);
+
+	ERR_FAIL_COND(con->begin_transaction() == false);
+
+	if (!con->load_blocks(to_span(locations), sqlite::Connection::VOXELS, &context, Context::process_block_func)) {
+		for (const unsigned int ri : blocks_to_load) {
+			p_blocks[ri].result = RESULT_ERROR;
+		}
+	}
+
+	ERR_FAIL_COND(con->end_transaction() == false);
+}
+
+void VoxelStreamSQLite::save_encoded_voxel_blocks(Span<VoxelStream::EncodedVoxelQueryData> p_blocks) {
+	sqlite::Connection *con = get_connection();
+	ZN_ASSERT_RETURN(con != nullptr);
+	const BlockLocation::CoordinateFormat coordinate_format = con->get_meta().coordinate_format;
+	recycle_connection(con);
+
+	const Box3i coordinate_range = BlockLocation::get_coordinate_range(coordinate_format);
+	const unsigned int lod_count = BlockLocation::get_lod_count(coordinate_format);
+
+	// Same as `save_voxel_blocks`, the cache holds bytes ready to be written so flushing doesn't have to encode them
+	for (unsigned int i = 0; i < p_blocks.size(); ++i) {
+		VoxelStream::EncodedVoxelQueryData &q = p_blocks[i];
+		const Vector3i pos = q.position_in_blocks;
+
+		if (!validate_range(pos, q.lod_index, coordinate_range, lod_count)) {
+			continue;
+		}
+
+		_cache.save_encoded_voxel_block(pos, q.lod_index, q.data);
+		if (_block_keys_cache_enabled) {
+			_block_keys_cache.add(pos, q.lod_index);
+		}
+	}
+
+	request_cache_flush_if_needed();
+}
+
+bool VoxelStreamSQLite::supports_deleting_voxel_blocks() const {
+	return true;
+}
+
+void VoxelStreamSQLite::delete_voxel_block(Vector3i position_in_blocks, uint8_t lod_index) {
+	sqlite::Connection *con = get_connection();
+	ZN_ASSERT_RETURN(con != nullptr);
+	const BlockLocation::CoordinateFormat coordinate_format = con->get_meta().coordinate_format;
+	recycle_connection(con);
+
+	if (!validate_range(
+				position_in_blocks,
+				lod_index,
+				BlockLocation::get_coordinate_range(coordinate_format),
+				BlockLocation::get_lod_count(coordinate_format)
+		)) {
+		return;
+	}
+
+	// The row will be removed from the database when the cache gets flushed
+	_cache.delete_voxel_block(position_in_blocks, lod_index);
+
+	request_cache_flush_if_needed();
 }
 
 bool VoxelStreamSQLite::supports_instance_blocks() const {
@@ -221,42 +503,57 @@ void VoxelStreamSQLite::load_instance_blocks(Span<VoxelStream::InstancesQueryDat
 		return;
 	}
 
-	sqlite::Connection *con = get_connection();
+	sqlite::Connection *con = get_connection(true);
 	ERR_FAIL_COND(con == nullptr);
 	const ScopeRecycle con_scope(this, con);
 
-	// TODO We should handle busy return codes
-	ERR_FAIL_COND(con->begin_transaction() == false);
-
-	for (unsigned int i = 0; i < blocks_to_load.size(); ++i) {
-		const unsigned int ri = blocks_to_load[i];
+	StdVector<BlockLocation> locations;
+	locations.reserve(blocks_to_load.size());
+	for (const unsigned int ri : blocks_to_load) {
 		VoxelStream::InstancesQueryData &q = out_blocks[ri];
-
 		BlockLocation loc;
 		loc.position = q.position_in_blocks;
 		loc.lod = q.lod_index;
+		locations.push_back(loc);
+		// Blocks that are found get reported below
+		q.result = RESULT_BLOCK_NOT_FOUND;
+	}
 
-		StdVector<uint8_t> &temp_compressed_block_data = get_tls_temp_compressed_block_data();
+	struct Context {
+		Span<VoxelStream::InstancesQueryData> blocks;
+		Span<const unsigned int> blocks_to_load;
 
-		const ResultCode res = con->load_block(loc, temp_compressed_block_data, sqlite::Connection::INSTANCES);
+		static void process_block_func(void *callback_data, unsigned int location_index, Span<const uint8_t> data) {
+			const Context *ctx = static_cast<const Context *>(callback_data);
+			VoxelStream::InstancesQueryData &q = ctx->blocks[ctx->blocks_to_load[location_index]];
 
-		if (res == RESULT_BLOCK_FOUND) {
 			StdVector<uint8_t> &temp_block_data = get_tls_temp_block_data();
-
-			if (!CompressedData::decompress(to_span_const(temp_compressed_block_data), temp_block_data)) {
+			if (!CompressedData::decompress(data, temp_block_data)) {
 				ERR_PRINT("Failed to decompress instance block");
 				q.result = RESULT_ERROR;
-				continue;
+				return;
 			}
 			q.data = make_unique_instance<InstanceBlockData>();
 			if (!deserialize_instance_block_data(*q.data, to_span_const(temp_block_data))) {
 				ERR_PRINT("Failed to deserialize instance block");
 				q.result = RESULT_ERROR;
-				continue;
+				return;
 			}
+			q.result = RESULT_BLOCK_FOUND;
 		}
+	};
+
+	Context context;
+	context.blocks = out_blocks;
+	context.blocks_to_load = to_span(blocks_to_load);
+
+	// TODO We should handle busy return codes
+	ERR_FAIL_COND(con->begin_transaction() == false);
 
-		q.result = res;
+	if (!con->load_blocks(to_span(locations), sqlite::Connection::INSTANCES, &context, Context::process_block_func)) {
+		for (const unsigned int ri : blocks_to_load) {
+			out_blocks[ri].result = RESULT_ERROR;
+		}
 	}
 
 	ERR_FAIL_COND(con->end_transaction() == false);
@@ -285,73 +582,51 @@ void VoxelStreamSQLite::save_instance_blocks(Span<VoxelStream::InstancesQueryDat
 		}
 	}
 
-	// TODO Optimization: we should consider using a serialized cache, and measure the threshold in bytes
-	if (_cache.get_indicative_block_count() >= CACHE_SIZE) {
-		flush_cache();
-	}
+	request_cache_flush_if_needed();
 }
 
 void VoxelStreamSQLite::load_all_blocks(FullLoadingResult &result) {
 	ZN_PROFILE_SCOPE();
 
-	sqlite::Connection *con = get_connection();
+	sqlite::Connection *con = get_connection(true);
 	ERR_FAIL_COND(con == nullptr);
 	const ScopeRecycle con_scope(this, con);
 
-	struct Context {
-		FullLoadingResult &result;
-	};
+	const StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries = get_zstd_dictionaries();
+	FullLoadingContext context{ result, to_span(zstd_dictionaries) };
+	const bool request_result = con->load_all_blocks(&context, FullLoadingContext::process_block_func);
+	ERR_FAIL_COND(request_result == false);
+}
 
-	// Using local function instead of a lambda for quite stupid reason admittedly:
-	// Godot's clang-format does not allow to write function parameters in column,
-	// which makes the lambda break line length.
-	struct L {
-		static void process_block_func(
-				void *callback_data,
-				const BlockLocation location,
-				Span<const uint8_t> voxel_data,
-				Span<const uint8_t> instances_data
-		) {
-			Context *ctx = reinterpret_cast<Context *>(callback_data);
+bool VoxelStreamSQLite::get_load_all_blocks_parts(unsigned int max_count, StdVector<FullLoadingPart> &out_parts) {
+	ZN_PROFILE_SCOPE();
 
-			if (voxel_data.size() == 0 && instances_data.size() == 0) {
-				ZN_PRINT_VERBOSE(format(
-						"Unexpected empty voxel data and instances data at {} lod {}", location.position, location.lod
-				));
-				return;
-			}
+	sqlite::Connection *con = get_connection(true);
+	ERR_FAIL_COND_V(con == nullptr, false);
+	const ScopeRecycle con_scope(this, con);
 
-			FullLoadingResult::Block result_block;
-			result_block.position = location.position;
-			result_block.lod = location.lod;
+	StdVector<sqlite::Connection::RowidRange> ranges;
+	ERR_FAIL_COND_V(con->get_block_rowid_ranges(max_count, ranges) == false, false);
 
-			if (voxel_data.size() > 0) {
-				std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
-				ERR_FAIL_COND(!BlockSerializer::decompress_and_deserialize(voxel_data, *voxels));
-				result_block.voxels = voxels;
-			}
+	for (const sqlite::Connection::RowidRange range : ranges) {
+		out_parts.push_back(FullLoadingPart{ range.first, range.last });
+	}
+	return true;
+}
 
-			if (instances_data.size() > 0) {
-				StdVector<uint8_t> &temp_block_data = get_tls_temp_block_data();
-				if (!CompressedData::decompress(instances_data, temp_block_data)) {
-					ERR_PRINT("Failed to decompress instance block");
-					return;
-				}
-				result_block.instances_data = make_unique_instance<InstanceBlockData>();
-				if (!deserialize_instance_block_data(*result_block.instances_data, to_span_const(temp_block_data))) {
-					ERR_PRINT("Failed to deserialize instance block");
-					return;
-				}
-			}
+void VoxelStreamSQLite::load_all_blocks_part(const FullLoadingPart &part, FullLoadingResult &result) {
+	ZN_PROFILE_SCOPE();
 
-			ctx->result.blocks.push_back(std::move(result_block));
-		}
-	};
+	// Each thread gets its own read-only connection, so parts can be loaded in parallel
+	sqlite::Connection *con = get_connection(true);
+	ERR_FAIL_COND(con == nullptr);
+	const ScopeRecycle con_scope(this, con);
 
-	// Had to suffix `_outer`,
-	// because otherwise GCC thinks it shadows a variable inside the local function/captureless lambda
-	Context ctx_outer{ result };
-	const bool request_result = con->load_all_blocks(&ctx_outer, L::process_block_func);
+	const StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries = get_zstd_dictionaries();
+	FullLoadingContext context{ result, to_span(zstd_dictionaries) };
+	const bool request_result = con->load_blocks_in_rowid_range(
+			sqlite::Connection::RowidRange{ part.begin, part.end }, &context, FullLoadingContext::process_block_func
+	);
 	ERR_FAIL_COND(request_result == false);
 }
 
@@ -361,6 +636,9 @@ int VoxelStreamSQLite::get_used_channels_mask() const {
 }
 
 void VoxelStreamSQLite::flush_cache() {
+	if (_cache.get_indicative_block_count() == 0) {
+		return;
+	}
 	sqlite::Connection *con = get_connection();
 	ERR_FAIL_COND(con == nullptr);
 	const ScopeRecycle con_scope(this, con);
@@ -368,15 +646,44 @@ void VoxelStreamSQLite::flush_cache() {
 }
 
 void VoxelStreamSQLite::flush() {
+	// Also done by background flushes
+	_cache.end_flush_request();
 	flush_cache();
 }
 
-// This function does not lock any mutex for internal use.
+void VoxelStreamSQLite::request_cache_flush_if_needed() {
+	const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+	const unsigned int max_blocks = _group_commit_max_blocks;
+	if (!_cache.is_flush_needed(max_blocks, now_msec, CACHE_FLUSH_INTERVAL_MSEC)) {
+		return;
+	}
+	// If saving goes faster than background flushes, we have to wait
+	if (_cache.is_flush_urgent(max_blocks)) {
+		flush_cache();
+		return;
+	}
+	if (_group_commit_latency_msec > 0) {
+		// Wake up the writer thread early
+		_writer_semaphore.post();
+		return;
+	}
+	// Without budget, we have to wait
+	if (_cache.get_memory_budget() == 0) {
+		flush_cache();
+		return;
+	}
+	if (_cache.try_begin_flush_request()) {
+		VoxelEngine::get_singleton().push_async_io_task(ZN_NEW(FlushStreamTask(Ref<VoxelStream>(this))));
+	}
+}
+
+// This function only locks the flush mutex, so it can be used while the connection mutex is locked.
 void VoxelStreamSQLite::flush_cache_to_connection(sqlite::Connection *p_connection) {
 	ZN_PROFILE_SCOPE();
 	ZN_PRINT_VERBOSE(format("VoxelStreamSQLite: Flushing cache ({} elements)", _cache.get_indicative_block_count()));
 
 	ERR_FAIL_COND(p_connection == nullptr);
+	MutexLock flush_lock(_cache_flush_mutex);
 	ERR_FAIL_COND(p_connection->begin_transaction() == false);
 
 	StdVector<uint8_t> &temp_data = get_tls_temp_block_data();
@@ -386,10 +693,24 @@ void VoxelStreamSQLite::flush_cache_to_connection(sqlite::Connection *p_connecti
 	const Box3i coordinate_range = BlockLocation::get_coordinate_range(coordinate_format);
 	const unsigned int lod_count = BlockLocation::get_lod_count(coordinate_format);
 
+	const CompressedData::CompressionParams compression_params = get_compression_params();
+	// Instances use the same compression, but without dictionary since those are trained on voxels
+	CompressedData::CompressionParams instances_compression_params = compression_params;
+	instances_compression_params.zstd_dictionary = nullptr;
+
+	// Blocks are gathered first so they can be written with fewer statements
+	SaveBatch voxels_batch;
+	SaveBatch instances_batch;
+
 	// TODO Needs better error rollback handling
-	_cache.flush([p_connection, &temp_data, &temp_compressed_data, coordinate_range, lod_count](
-						 VoxelStreamCache::Block &block
-				 ) {
+	const auto save_func = [&voxels_batch,
+							&instances_batch,
+							&temp_data,
+							&temp_compressed_data,
+							coordinate_range,
+							lod_count,
+							&compression_params,
+							&instances_compression_params](VoxelStreamCache::Block &block) {
 		ZN_ASSERT_RETURN(validate_range(block.position, block.lod, coordinate_range, lod_count));
 
 		BlockLocation loc;
@@ -397,62 +718,134 @@ void VoxelStreamSQLite::flush_cache_to_connection(sqlite::Connection *p_connecti
 		loc.lod = block.lod;
 
 		// Save voxels
-		if (block.has_voxels) {
+		if (block.voxels_dirty) {
 			if (block.voxels_deleted) {
-				p_connection->save_block(loc, Span<const uint8_t>(), sqlite::Connection::VOXELS);
+				voxels_batch.add(loc, Span<const uint8_t>());
+			} else if (block.encoded_voxels.size() > 0) {
+				voxels_batch.add(loc, to_span_const(block.encoded_voxels));
 			} else {
-				BlockSerializer::SerializeResult res = BlockSerializer::serialize_and_compress(block.voxels);
+				BlockSerializer::SerializeResult res =
+						BlockSerializer::serialize_and_compress(block.voxels, compression_params);
 				ERR_FAIL_COND(!res.success);
-				p_connection->save_block(loc, to_span(res.data), sqlite::Connection::VOXELS);
+				voxels_batch.add(loc, to_span(res.data));
 			}
 		}
 
 		// Save instances
-		temp_compressed_data.clear();
-		if (block.instances != nullptr) {
-			temp_data.clear();
+		if (block.instances_dirty) {
+			temp_compressed_data.clear();
+			if (block.instances != nullptr) {
+				temp_data.clear();
 
-			ERR_FAIL_COND(!serialize_instance_block_data(*block.instances, temp_data));
+				ERR_FAIL_COND(!serialize_instance_block_data(*block.instances, temp_data));
 
-			ERR_FAIL_COND(!CompressedData::compress(
-					to_span_const(temp_data), temp_compressed_data, CompressedData::COMPRESSION_NONE
-			));
+				ERR_FAIL_COND(!CompressedData::compress(
+						to_span_const(temp_data), temp_compressed_data, instances_compression_params
+				));
+			}
+			instances_batch.add(loc, to_span(temp_compressed_data));
 		}
-		p_connection->save_block(loc, to_span(temp_compressed_data), sqlite::Connection::INSTANCES);
 
 		// TODO Optimization: add a version of the query that can update both at once
-	});
+	};
+	_cache.flush(save_func, Time::get_singleton()->get_ticks_msec());
+
+	voxels_batch.save(*p_connection, sqlite::Connection::VOXELS, _deduplication_enabled);
+	instances_batch.save(*p_connection, sqlite::Connection::INSTANCES);
 
 	ERR_FAIL_COND(p_connection->end_transaction() == false);
+	++_commit_count;
+}
+
+// Must be called with the writer thread mutex locked
+void VoxelStreamSQLite::start_writer_thread() {
+	ZN_ASSERT_RETURN(!_writer_thread.is_started());
+	_writer_thread_stop = false;
+	_writer_thread.start(writer_thread_func, this, Thread::PRIORITY_LOW);
+}
+
+void VoxelStreamSQLite::stop_writer_thread() {
+	MutexLock mlock(_writer_thread_mutex);
+	if (!_writer_thread.is_started()) {
+		return;
+	}
+	_writer_thread_stop = true;
+	_writer_semaphore.post();
+	_writer_thread.wait_to_finish();
+	// Remaining blocks get written by whoever stopped the thread
 }
 
-Connection *VoxelStreamSQLite::get_connection() {
+void VoxelStreamSQLite::writer_thread_func(void *p_userdata) {
+	Thread::set_name("VoxelStreamSQLite writer");
+	VoxelStreamSQLite &self = *static_cast<VoxelStreamSQLite *>(p_userdata);
+
+	while (!self._writer_thread_stop) {
+		// Saved blocks wait at most one period, unless enough of them accumulate and wake us up sooner
+		self._writer_semaphore.wait_for_usec(uint64_t(self._group_commit_latency_msec) * 1000);
+		if (self._writer_thread_stop) {
+			break;
+		}
+		if (self._cache.get_stats().dirty_block_count > 0) {
+			self.flush_cache();
+		}
+	}
+}
+
+Connection *VoxelStreamSQLite::get_connection(bool read_only) {
 	StdString fpath;
 	CoordinateFormat preferred_coordinate_format;
+	bool database_setup;
 	{
 		MutexLock mlock(_connection_mutex);
 
 		if (_globalized_connection_path.empty()) {
 			return nullptr;
 		}
-		if (_connection_pool.size() != 0) {
-			sqlite::Connection *existing_connection = _connection_pool.back();
-			_connection_pool.pop_back();
+		StdVector<sqlite::Connection *> &pool = read_only ? _read_connection_pool : _connection_pool;
+		if (pool.size() != 0) {
+			sqlite::Connection *existing_connection = pool.back();
+			pool.pop_back();
 			return existing_connection;
 		}
 		// First connection we get since we set the database path
 		fpath = _globalized_connection_path;
 		preferred_coordinate_format = _preferred_coordinate_format;
+		database_setup = _database_setup;
 	}
 
 	if (fpath.empty()) {
 		return nullptr;
 	}
+
+	if (read_only && !database_setup) {
+		// Opening a writable connection creates the database if it doesn't exist yet, and enables WAL journaling
+		sqlite::Connection *write_con = get_connection(false);
+		if (write_con == nullptr) {
+			return nullptr;
+		}
+		recycle_connection(write_con);
+	}
+
 	sqlite::Connection *con = new sqlite::Connection();
-	if (!con->open(fpath.data(), to_internal_coordinate_format(preferred_coordinate_format))) {
+	if (!con->open(fpath.data(), to_internal_coordinate_format(preferred_coordinate_format), read_only)) {
 		delete con;
 		return nullptr;
 	}
+	{
+		MutexLock mlock(_connection_mutex);
+		_all_connections.push_back(con);
+		if (!read_only && fpath == _globalized_connection_path) {
+			_database_setup = true;
+		}
+	}
+	bool zstd_dictionaries_loaded;
+	{
+		MutexLock mlock(_compression_mutex);
+		zstd_dictionaries_loaded = _zstd_dictionaries_loaded;
+	}
+	if (!zstd_dictionaries_loaded) {
+		load_zstd_dictionaries(*con);
+	}
 	if (_block_keys_cache_enabled) {
 		RWLockWrite wlock(_block_keys_cache.rw_lock);
 		con->load_all_block_keys(&_block_keys_cache, [](void *ctx, BlockLocation loc) {
@@ -466,16 +859,136 @@ Connection *VoxelStreamSQLite::get_connection() {
 void VoxelStreamSQLite::recycle_connection(sqlite::Connection *con) {
 	const char *con_path = con->get_opened_file_path();
 	// Put back in the pool if the connection path didn't change
-	{
-		MutexLock mlock(_connection_mutex);
-		if (_globalized_connection_path == con_path) {
+	MutexLock mlock(_connection_mutex);
+	if (_globalized_connection_path == con_path) {
+		if (con->is_read_only()) {
+			_read_connection_pool.push_back(con);
+		} else {
 			_connection_pool.push_back(con);
-			return;
+		}
+		return;
+	}
+	delete_connection_no_lock(con);
+}
+
+void VoxelStreamSQLite::delete_connection_no_lock(sqlite::Connection *con) {
+	for (unsigned int i = 0; i < _all_connections.size(); ++i) {
+		if (_all_connections[i] == con) {
+			_all_connections[i] = _all_connections.back();
+			_all_connections.pop_back();
+			break;
 		}
 	}
 	delete con;
 }
 
+Dictionary VoxelStreamSQLite::get_statistics() const {
+	struct L {
+		static double get_rate(uint64_t amount, uint64_t time_usec) {
+			return time_usec > 0 ? static_cast<double>(amount) * 1000000.0 / static_cast<double>(time_usec) : 0.0;
+		}
+	};
+
+	Array connections;
+	uint64_t total_blocks_loaded = 0;
+	uint64_t total_blocks_saved = 0;
+	uint64_t total_bytes_loaded = 0;
+	uint64_t total_bytes_saved = 0;
+	uint64_t total_blobs_reused = 0;
+	uint64_t total_key_range_scans = 0;
+	{
+		MutexLock mlock(_connection_mutex);
+		for (const sqlite::Connection *con : _all_connections) {
+			const sqlite::Connection::Stats &stats = con->get_stats();
+			const uint64_t blocks_loaded = stats.blocks_loaded;
+			const uint64_t bytes_loaded = stats.bytes_loaded;
+			const uint64_t load_time_usec = stats.load_time_usec;
+			const uint64_t blocks_saved = stats.blocks_saved;
+			const uint64_t bytes_saved = stats.bytes_saved;
+			const uint64_t save_time_usec = stats.save_time_usec;
+			const uint64_t blobs_reused = stats.blobs_reused;
+			const uint64_t key_range_scans = stats.key_range_scans;
+
+			Dictionary d;
+			d["read_only"] = con->is_read_only();
+			d["blocks_loaded"] = blocks_loaded;
+			d["bytes_loaded"] = bytes_loaded;
+			d["load_time_usec"] = load_time_usec;
+			d["blocks_loaded_per_second"] = L::get_rate(blocks_loaded, load_time_usec);
+			d["bytes_loaded_per_second"] = L::get_rate(bytes_loaded, load_time_usec);
+			d["blocks_saved"] = blocks_saved;
+			d["bytes_saved"] = bytes_saved;
+			d["save_time_usec"] = save_time_usec;
+			d["blocks_saved_per_second"] = L::get_rate(blocks_saved, save_time_usec);
+			d["bytes_saved_per_second"] = L::get_rate(bytes_saved, save_time_usec);
+			d["blobs_reused"] = blobs_reused;
+			d["key_range_scans"] = key_range_scans;
+			connections.append(d);
+
+			total_blocks_loaded += blocks_loaded;
+			total_blocks_saved += blocks_saved;
+			total_bytes_loaded += bytes_loaded;
+			total_bytes_saved += bytes_saved;
+			total_blobs_reused += blobs_reused;
+			total_key_range_scans += key_range_scans;
+		}
+	}
+
+	Dictionary d;
+	d["connections"] = connections;
+	d["blocks_loaded"] = total_blocks_loaded;
+	d["bytes_loaded"] = total_bytes_loaded;
+	d["blocks_saved"] = total_blocks_saved;
+	d["bytes_saved"] = total_bytes_saved;
+	d["blobs_reused"] = total_blobs_reused;
+	d["key_range_scans"] = total_key_range_scans;
+	d["commits"] = _commit_count.load();
+	d["cache"] = _cache.get_stats().to_dictionary();
+	return d;
+}
+
+void VoxelStreamSQLite::set_cache_memory_budget_mb(int mb) {
+	ZN_ASSERT_RETURN(mb >= 0);
+	if (mb == 0 && _cache.get_memory_budget() > 0) {
+		// Let the cache go back to holding only blocks waiting to be saved
+		_cache.set_memory_budget(0);
+		flush_cache();
+		return;
+	}
+	_cache.set_memory_budget(static_cast<uint64_t>(mb) * 1024 * 1024);
+}
+
+int VoxelStreamSQLite::get_cache_memory_budget_mb() const {
+	return _cache.get_memory_budget() / (1024 * 1024);
+}
+
+void VoxelStreamSQLite::set_group_commit_max_blocks(int count) {
+	ZN_ASSERT_RETURN(count >= 1);
+	_group_commit_max_blocks = count;
+}
+
+int VoxelStreamSQLite::get_group_commit_max_blocks() const {
+	return _group_commit_max_blocks;
+}
+
+void VoxelStreamSQLite::set_group_commit_latency_msec(int msec) {
+	ZN_ASSERT_RETURN(msec >= 0);
+	_group_commit_latency_msec = msec;
+	if (msec > 0) {
+		MutexLock mlock(_writer_thread_mutex);
+		if (!_writer_thread.is_started()) {
+			start_writer_thread();
+		}
+	} else {
+		stop_writer_thread();
+		flush_cache();
+	}
+}
+
+int VoxelStreamSQLite::get_group_commit_latency_msec() const {
+	return _group_commit_latency_msec;
+}
+
 void VoxelStreamSQLite::set_key_cache_enabled(bool enable) {
 	_block_keys_cache_enabled = enable;
 }
@@ -484,6 +997,15 @@ bool VoxelStreamSQLite::is_key_cache_enabled() const {
 	return _block_keys_cache_enabled;
 }
 
+void VoxelStreamSQLite::set_deduplication_enabled(bool enable) {
+	// Blocks already saved are not affected, they are only deduplicated when saved again
+	_deduplication_enabled = enable;
+}
+
+bool VoxelStreamSQLite::is_deduplication_enabled() const {
+	return _deduplication_enabled;
+}
+
 Box3i VoxelStreamSQLite::get_supported_block_range() const {
 	// const Connection *con = get_connection();
 	// const CoordinateFormat format = con != nullptr ? con->get_meta().coordinate_format :
@@ -529,7 +1051,7 @@ bool VoxelStreamSQLite::copy_blocks_to_other_sqlite_stream(Ref<VoxelStreamSQLite
 	ZN_ASSERT_RETURN_V(dst_stream->get_database_path() != get_database_path(), false);
 
 	ZN_ASSERT_RETURN_V_MSG(
-			dst_stream->get_block_size_po2() != get_block_size_po2(),
+			dst_stream->get_block_size_po2() == get_block_size_po2(),
 			false,
 			"Copying between streams of different block sizes is not supported"
 	);
@@ -561,11 +1083,153 @@ bool VoxelStreamSQLite::copy_blocks_to_other_sqlite_stream(Ref<VoxelStreamSQLite
 	ZN_ASSERT_RETURN_V(context.dst_con != nullptr, false);
 	const ScopeRecycle dst_con_scope(dst_stream.ptr(), context.dst_con);
 
+	// Blocks may have been compressed with dictionaries, which must be copied too
+	const StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries = get_zstd_dictionaries();
+	for (const std::shared_ptr<CompressedData::ZstdDictionary> &dictionary : zstd_dictionaries) {
+		ZN_ASSERT_RETURN_V(
+				context.dst_con->save_zstd_dictionary(dictionary->get_id(), dictionary->get_content()), false
+		);
+	}
+	if (zstd_dictionaries.size() > 0) {
+		dst_stream->load_zstd_dictionaries(*context.dst_con);
+	}
+
+	// A single transaction is much faster than one per saved block
+	ZN_ASSERT_RETURN_V(context.dst_con->begin_transaction(), false);
 	const bool success = src_con->load_all_blocks(&context, Context::save);
+	ZN_ASSERT_RETURN_V(context.dst_con->end_transaction(), false);
 
 	return success;
 }
 
+void VoxelStreamSQLite::load_zstd_dictionaries(sqlite::Connection &con) {
+	ZN_PROFILE_SCOPE();
+
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> dictionaries;
+
+	struct L {
+		static void process_dictionary_func(void *callback_data, uint32_t id, Span<const uint8_t> content) {
+			StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> &dictionaries =
+					*static_cast<StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> *>(callback_data);
+			std::shared_ptr<CompressedData::ZstdDictionary> dictionary =
+					make_shared_instance<CompressedData::ZstdDictionary>(content);
+			ZN_ASSERT_RETURN_MSG(dictionary->get_id() == id, format("Zstd dictionary {} is corrupted", id));
+			dictionaries.push_back(dictionary);
+		}
+	};
+
+	ZN_ASSERT_RETURN(con.load_zstd_dictionaries(&dictionaries, L::process_dictionary_func));
+
+	MutexLock mlock(_compression_mutex);
+	_zstd_dictionaries = std::move(dictionaries);
+	_zstd_dictionaries_loaded = true;
+}
+
+StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> VoxelStreamSQLite::get_zstd_dictionaries() const {
+	MutexLock mlock(_compression_mutex);
+	return _zstd_dictionaries;
+}
+
+CompressedData::CompressionParams VoxelStreamSQLite::get_compression_params() const {
+	MutexLock mlock(_compression_mutex);
+	CompressedData::CompressionParams params;
+	if (_compression == COMPRESSION_ZSTD) {
+		params.compression = CompressedData::COMPRESSION_ZSTD;
+		params.zstd_level = _zstd_compression_level;
+		if (_zstd_dictionaries.size() > 0) {
+			params.zstd_dictionary = _zstd_dictionaries.back();
+		}
+	} else {
+		params.compression = CompressedData::COMPRESSION_LZ4;
+	}
+	return params;
+}
+
+void VoxelStreamSQLite::set_compression(Compression compression) {
+	ZN_ASSERT_RETURN(compression >= 0 && compression < COMPRESSION_COUNT);
+	ZN_ASSERT_RETURN_MSG(
+			compression != COMPRESSION_ZSTD || CompressedData::is_zstd_supported(),
+			"Zstd compression is not available in this build"
+	);
+	MutexLock mlock(_compression_mutex);
+	_compression = compression;
+}
+
+VoxelStreamSQLite::Compression VoxelStreamSQLite::get_compression() const {
+	MutexLock mlock(_compression_mutex);
+	return _compression;
+}
+
+void VoxelStreamSQLite::set_zstd_compression_level(int level) {
+	MutexLock mlock(_compression_mutex);
+	_zstd_compression_level = math::clamp(level, CompressedData::ZSTD_MIN_LEVEL, CompressedData::ZSTD_MAX_LEVEL);
+}
+
+int VoxelStreamSQLite::get_zstd_compression_level() const {
+	MutexLock mlock(_compression_mutex);
+	return _zstd_compression_level;
+}
+
+bool VoxelStreamSQLite::train_zstd_dictionary(int sample_count, int max_size) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(sample_count > 0, false);
+	ZN_ASSERT_RETURN_V(max_size > 0, false);
+
+	sqlite::Connection *con = get_connection();
+	ZN_ASSERT_RETURN_V(con != nullptr, false);
+	const ScopeRecycle con_scope(this, con);
+
+	// Include blocks that are still in the cache
+	flush_cache_to_connection(con);
+
+	struct Context {
+		StdVector<StdVector<uint8_t>> samples;
+		unsigned int max_sample_count;
+		Span<const std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries;
+
+		static void process_block_func(
+				void *callback_data,
+				BlockLocation location,
+				Span<const uint8_t> voxel_data,
+				Span<const uint8_t> instances_data
+		) {
+			Context *ctx = static_cast<Context *>(callback_data);
+			if (voxel_data.size() == 0 || ctx->samples.size() >= ctx->max_sample_count) {
+				return;
+			}
+			// Samples are uncompressed, since that's what the dictionary will be matched against
+			StdVector<uint8_t> sample;
+			ZN_ASSERT_RETURN(CompressedData::decompress(voxel_data, sample, ctx->zstd_dictionaries));
+			ctx->samples.push_back(std::move(sample));
+		}
+	};
+
+	const StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> zstd_dictionaries = get_zstd_dictionaries();
+
+	Context context;
+	context.max_sample_count = sample_count;
+	context.zstd_dictionaries = to_span(zstd_dictionaries);
+	// TODO Optimization: stop the query once we have enough samples
+	ZN_ASSERT_RETURN_V(con->load_all_blocks(&context, Context::process_block_func), false);
+
+	std::shared_ptr<CompressedData::ZstdDictionary> dictionary =
+			CompressedData::ZstdDictionary::create_from_samples(to_span(context.samples), max_size);
+	ZN_ASSERT_RETURN_V(dictionary != nullptr, false);
+
+	ZN_PRINT_VERBOSE(format(
+			"Created Zstd dictionary {} of {} bytes from {} blocks",
+			dictionary->get_id(),
+			dictionary->get_content().size(),
+			context.samples.size()
+	));
+
+	ZN_ASSERT_RETURN_V(con->save_zstd_dictionary(dictionary->get_id(), dictionary->get_content()), false);
+
+	// Reload so the order matches the database, in case that dictionary already existed
+	load_zstd_dictionaries(*con);
+	return true;
+}
+
 void VoxelStreamSQLite::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_database_path", "path"), &VoxelStreamSQLite::set_database_path);
 	ClassDB::bind_method(D_METHOD("get_database_path"), &VoxelStreamSQLite::get_database_path);
@@ -573,19 +1237,70 @@ void VoxelStreamSQLite::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_key_cache_enabled", "enabled"), &VoxelStreamSQLite::set_key_cache_enabled);
 	ClassDB::bind_method(D_METHOD("is_key_cache_enabled"), &VoxelStreamSQLite::is_key_cache_enabled);
 
+	ClassDB::bind_method(
+			D_METHOD("set_deduplication_enabled", "enabled"), &VoxelStreamSQLite::set_deduplication_enabled
+	);
+	ClassDB::bind_method(D_METHOD("is_deduplication_enabled"), &VoxelStreamSQLite::is_deduplication_enabled);
+
 	ClassDB::bind_method(
 			D_METHOD("set_preferred_coordinate_format", "format"), &VoxelStreamSQLite::set_preferred_coordinate_format
 	);
 	ClassDB::bind_method(
 			D_METHOD("get_preferred_coordinate_format"), &VoxelStreamSQLite::get_preferred_coordinate_format
 	);
+	ClassDB::bind_method(
+			D_METHOD("get_current_coordinate_format"), &VoxelStreamSQLite::get_current_coordinate_format
+	);
+	ClassDB::bind_method(
+			D_METHOD("copy_blocks_to_other_sqlite_stream", "dst_stream"),
+			&VoxelStreamSQLite::copy_blocks_to_other_sqlite_stream
+	);
 
 	BIND_ENUM_CONSTANT(COORDINATE_FORMAT_INT64_X16_Y16_Z16_L16);
 	BIND_ENUM_CONSTANT(COORDINATE_FORMAT_INT64_X19_Y19_Z19_L7);
 	BIND_ENUM_CONSTANT(COORDINATE_FORMAT_STRING_CSD);
 	BIND_ENUM_CONSTANT(COORDINATE_FORMAT_BLOB80_X25_Y25_Z25_L5);
+	BIND_ENUM_CONSTANT(COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7);
 	BIND_ENUM_CONSTANT(COORDINATE_FORMAT_COUNT);
 
+	ClassDB::bind_method(D_METHOD("set_compression", "compression"), &VoxelStreamSQLite::set_compression);
+	ClassDB::bind_method(D_METHOD("get_compression"), &VoxelStreamSQLite::get_compression);
+
+	ClassDB::bind_method(
+			D_METHOD("set_zstd_compression_level", "level"), &VoxelStreamSQLite::set_zstd_compression_level
+	);
+	ClassDB::bind_method(D_METHOD("get_zstd_compression_level"), &VoxelStreamSQLite::get_zstd_compression_level);
+
+	ClassDB::bind_method(
+			D_METHOD("train_zstd_dictionary", "sample_count", "max_size"),
+			&VoxelStreamSQLite::train_zstd_dictionary,
+			DEFVAL(256),
+			DEFVAL(65536)
+	);
+
+	ClassDB::bind_method(D_METHOD("get_statistics"), &VoxelStreamSQLite::get_statistics);
+
+	ClassDB::bind_method(
+			D_METHOD("set_cache_memory_budget_mb", "mb"), &VoxelStreamSQLite::set_cache_memory_budget_mb
+	);
+	ClassDB::bind_method(D_METHOD("get_cache_memory_budget_mb"), &VoxelStreamSQLite::get_cache_memory_budget_mb);
+
+	ClassDB::bind_method(
+			D_METHOD("set_group_commit_max_blocks", "count"), &VoxelStreamSQLite::set_group_commit_max_blocks
+	);
+	ClassDB::bind_method(D_METHOD("get_group_commit_max_blocks"), &VoxelStreamSQLite::get_group_commit_max_blocks);
+
+	ClassDB::bind_method(
+			D_METHOD("set_group_commit_latency_msec", "msec"), &VoxelStreamSQLite::set_group_commit_latency_msec
+	);
+	ClassDB::bind_method(
+			D_METHOD("get_group_commit_latency_msec"), &VoxelStreamSQLite::get_group_commit_latency_msec
+	);
+
+	BIND_ENUM_CONSTANT(COMPRESSION_LZ4);
+	BIND_ENUM_CONSTANT(COMPRESSION_ZSTD);
+	BIND_ENUM_CONSTANT(COMPRESSION_COUNT);
+
 	ADD_PROPERTY(
 			PropertyInfo(Variant::STRING, "database_path", PROPERTY_HINT_FILE), "set_database_path", "get_database_path"
 	);
@@ -600,6 +1315,37 @@ void VoxelStreamSQLite::_bind_methods() {
 			"set_database_path",
 			"get_database_path"
 	);
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "compression", PROPERTY_HINT_ENUM, "LZ4,Zstd"),
+			"set_compression",
+			"get_compression"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "zstd_compression_level", PROPERTY_HINT_RANGE, "1,22"),
+			"set_zstd_compression_level",
+			"get_zstd_compression_level"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "deduplication_enabled"),
+			"set_deduplication_enabled",
+			"is_deduplication_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "cache_memory_budget_mb", PROPERTY_HINT_RANGE, "0,4096,1,or_greater"),
+			"set_cache_memory_budget_mb",
+			"get_cache_memory_budget_mb"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "group_commit_max_blocks", PROPERTY_HINT_RANGE, "1,4096,1,or_greater"),
+			"set_group_commit_max_blocks",
+			"get_group_commit_max_blocks"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "group_commit_latency_msec", PROPERTY_HINT_RANGE, "0,60000,1,or_greater"),
+			"set_group_commit_latency_msec",
+			"get_group_commit_latency_msec"
+	);
 }
 
 } // namespace zylann::voxel
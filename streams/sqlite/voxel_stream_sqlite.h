@@ -1,10 +1,14 @@
 #ifndef VOXEL_STREAM_SQLITE_H
 #define VOXEL_STREAM_SQLITE_H
 
+#include "../../util/cache_stats.h"
 #include "../../util/containers/std_unordered_set.h"
 #include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/dictionary.h"
 #include "../../util/string/std_string.h"
 #include "../../util/thread/mutex.h"
+#include "../../util/thread/semaphore.h"
+#include "../../util/thread/thread.h"
 #include "../voxel_block_serializer.h"
 #include "../voxel_stream.h"
 #include "../voxel_stream_cache.h"
@@ -19,6 +23,7 @@ namespace zylann::voxel {
 class VoxelStreamSQLite : public VoxelStream {
 	GDCLASS(VoxelStreamSQLite, VoxelStream)
 public:
+	// Default amount of saved blocks that can wait before they get written to the database
 	static const unsigned int CACHE_SIZE = 64;
 
 	VoxelStreamSQLite();
@@ -37,6 +42,15 @@ public:
 	void load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) override;
 	void save_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) override;
 
+	bool supports_encoded_voxel_blocks() const override;
+	bool encode_voxel_block(const VoxelBuffer &voxels, StdVector<uint8_t> &out_data) const override;
+	bool decode_voxel_block(Span<const uint8_t> data, VoxelBuffer &out_voxels) const override;
+	void load_encoded_voxel_blocks(Span<VoxelStream::EncodedVoxelQueryData> p_blocks) override;
+	void save_encoded_voxel_blocks(Span<VoxelStream::EncodedVoxelQueryData> p_blocks) override;
+
+	bool supports_deleting_voxel_blocks() const override;
+	void delete_voxel_block(Vector3i position_in_blocks, uint8_t lod_index) override;
+
 	bool supports_instance_blocks() const override;
 	void load_instance_blocks(Span<VoxelStream::InstancesQueryData> out_blocks) override;
 	void save_instance_blocks(Span<VoxelStream::InstancesQueryData> p_blocks) override;
@@ -45,6 +59,8 @@ public:
 		return true;
 	}
 	void load_all_blocks(FullLoadingResult &result) override;
+	bool get_load_all_blocks_parts(unsigned int max_count, StdVector<FullLoadingPart> &out_parts) override;
+	void load_all_blocks_part(const FullLoadingPart &part, FullLoadingResult &result) override;
 
 	int get_used_channels_mask() const override;
 
@@ -55,6 +71,11 @@ public:
 	void set_key_cache_enabled(bool enable);
 	bool is_key_cache_enabled() const;
 
+	// When enabled, voxels of blocks are saved in a table of contents identified by their hash, so blocks having the
+	// same content only store it once. Useful when many blocks are identical, like copies of the same structure.
+	void set_deduplication_enabled(bool enable);
+	bool is_deduplication_enabled() const;
+
 	Box3i get_supported_block_range() const override;
 	int get_lod_count() const override;
 
@@ -63,6 +84,7 @@ public:
 		COORDINATE_FORMAT_INT64_X19_Y19_Z19_L7,
 		COORDINATE_FORMAT_STRING_CSD,
 		COORDINATE_FORMAT_BLOB80_X25_Y25_Z25_L5,
+		COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7,
 		COORDINATE_FORMAT_COUNT
 	};
 
@@ -73,21 +95,62 @@ public:
 
 	bool copy_blocks_to_other_sqlite_stream(Ref<VoxelStreamSQLite> dst_stream);
 
+	enum Compression { //
+		COMPRESSION_LZ4 = 0,
+		COMPRESSION_ZSTD,
+		COMPRESSION_COUNT
+	};
+
+	void set_compression(Compression compression);
+	Compression get_compression() const;
+
+	void set_zstd_compression_level(int level);
+	int get_zstd_compression_level() const;
+
+	// Builds a Zstd dictionary from up to `sample_count` blocks already saved in the database, and uses it to compress
+	// blocks saved from now on. Dictionaries are stored in the database. Previous dictionaries are kept, because blocks
+	// that were compressed with them still need them.
+	bool train_zstd_dictionary(int sample_count, int max_size);
+
+	// Throughput of each open connection to the database, and cache usage
+	Dictionary get_statistics() const;
+
+	// When above 0, saved blocks remain cached after being written, up to this amount of memory, and flushing is done
+	// in the background instead of while saving
+	void set_cache_memory_budget_mb(int mb);
+	int get_cache_memory_budget_mb() const;
+
+	// Saved blocks are written to the database in one transaction once this many are waiting
+	void set_group_commit_max_blocks(int count);
+	int get_group_commit_max_blocks() const;
+
+	// When above 0, a background thread writes saved blocks at most this long after they were saved, so saving
+	// doesn't wait for writes, and fewer transactions get committed
+	void set_group_commit_latency_msec(int msec);
+	int get_group_commit_latency_msec() const;
+
 private:
 	void rebuild_key_cache();
 
 	struct BlockKeysCache {
 		FixedArray<StdUnorderedSet<Vector3i>, constants::MAX_LOD> lods;
 		RWLock rw_lock;
+		int64_t key_count = 0;
+		mutable CacheStats stats{ "sqlite_block_keys" };
 
 		inline bool contains(Vector3i bpos, unsigned int lod_index) const {
 			const StdUnorderedSet<Vector3i> &keys = lods[lod_index];
 			RWLockRead rlock(rw_lock);
-			return keys.find(bpos) != keys.end();
+			const bool found = keys.find(bpos) != keys.end();
+			stats.add_hit_or_miss(found);
+			return found;
 		}
 
 		inline void add_no_lock(Vector3i bpos, unsigned int lod_index) {
-			lods[lod_index].insert(bpos);
+			if (lods[lod_index].insert(bpos).second) {
+				++key_count;
+				stats.set_entries(key_count);
+			}
 		}
 
 		inline void add(Vector3i bpos, unsigned int lod_index) {
@@ -100,6 +163,8 @@ private:
 			for (unsigned int i = 0; i < lods.size(); ++i) {
 				lods[i].clear();
 			}
+			key_count = 0;
+			stats.set_entries(0);
 		}
 
 		// inline size_t get_memory_usage() const {
@@ -126,8 +191,10 @@ private:
 	// Because of this, in our use case, it might be simpler to just leave SQLite in thread-safe mode,
 	// and synchronize ourselves.
 
-	sqlite::Connection *get_connection();
+	// Read-only connections are used for loading, so loads don't have to wait for saves to finish
+	sqlite::Connection *get_connection(bool read_only = false);
 	void recycle_connection(sqlite::Connection *con);
+	void delete_connection_no_lock(sqlite::Connection *con);
 
 	struct ScopeRecycle {
 		VoxelStreamSQLite *stream;
@@ -147,17 +214,43 @@ private:
 	};
 
 	void flush_cache_to_connection(sqlite::Connection *p_connection);
+	// Flushes now or schedules a background flush, depending on how much was saved
+	void request_cache_flush_if_needed();
+
+	void start_writer_thread();
+	void stop_writer_thread();
+	static void writer_thread_func(void *p_userdata);
+
+	void load_zstd_dictionaries(sqlite::Connection &con);
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> get_zstd_dictionaries() const;
+	CompressedData::CompressionParams get_compression_params() const;
 
 	static void _bind_methods();
 
 	String _user_specified_connection_path;
 	StdString _globalized_connection_path;
 	StdVector<sqlite::Connection *> _connection_pool;
-	Mutex _connection_mutex;
+	StdVector<sqlite::Connection *> _read_connection_pool;
+	// All connections, including those currently in use by other threads. Only used to report statistics.
+	StdVector<sqlite::Connection *> _all_connections;
+	// Read-only connections can only be opened once the database has been setup by a writable one
+	bool _database_setup = false;
+	mutable Mutex _connection_mutex;
 	// This cache stores blocks in memory, and gets flushed to the database when big enough.
 	// This is because save queries are more expensive.
 	// It also speeds up queries of blocks that were recently saved.
 	VoxelStreamCache _cache;
+	// Flushes are serialized, otherwise an older version of a block could be committed after a newer one
+	Mutex _cache_flush_mutex;
+	std::atomic_uint64_t _commit_count = { 0 };
+	std::atomic_uint32_t _group_commit_max_blocks = { CACHE_SIZE };
+	std::atomic_uint32_t _group_commit_latency_msec = { 0 };
+	// Flushes the cache periodically when group commit latency is above 0. Posting the semaphore wakes it up early.
+	Thread _writer_thread;
+	Semaphore _writer_semaphore;
+	std::atomic_bool _writer_thread_stop = { false };
+	// Protects starting and stopping the writer thread
+	Mutex _writer_thread_mutex;
 	// The current way we stream data is by querying every block location near each player, to know if there is data.
 	// Therefore testing if a block is present is the beginning of the most frequently executed code path.
 	// In configurations where only edited blocks get saved, very few blocks even get stored in the database,
@@ -166,13 +259,23 @@ private:
 	// such a cache can become quite large. In this case we could either allow turning it off, or use an octree.
 	BlockKeysCache _block_keys_cache;
 	bool _block_keys_cache_enabled = false;
+	bool _deduplication_enabled = false;
 	// Format that will be used when creating new databases. May not necessarily match the format actually used by
 	// existing databases.
 	CoordinateFormat _preferred_coordinate_format = COORDINATE_FORMAT_STRING_CSD;
+
+	// Separate from the connection mutex, because we need these while flushing the cache with it locked
+	Mutex _compression_mutex;
+	Compression _compression = COMPRESSION_LZ4;
+	int _zstd_compression_level = CompressedData::ZSTD_DEFAULT_LEVEL;
+	// Loaded from the database with the first connection. The last one is used when saving with Zstd.
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> _zstd_dictionaries;
+	bool _zstd_dictionaries_loaded = false;
 };
 
 } // namespace zylann::voxel
 
 VARIANT_ENUM_CAST(zylann::voxel::VoxelStreamSQLite::CoordinateFormat);
+VARIANT_ENUM_CAST(zylann::voxel::VoxelStreamSQLite::Compression);
 
 #endif // VOXEL_STREAM_SQLITE_H
@@ -3,6 +3,7 @@
 #include "../../util/godot/classes/file_access.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/io/log.h"
+#include "../../util/math/funcs.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 
@@ -121,6 +122,36 @@ void transpose(Vector3i sx, Vector3i sy, Vector3i sz, Vector3i &dx, Vector3i &dy
 	dz.z = sz.z;
 }
 
+// Voxels are read by batches, which is a lot faster than reading them one byte at a time
+Error parse_xyzi_voxels(FileAccess &f, uint32_t voxel_count, Vector3i size, Span<uint8_t> dst_color_indexes) {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND_V(dst_color_indexes.size() != Vector3iUtil::get_volume_u64(size), ERR_INVALID_PARAMETER);
+
+	static const uint32_t BATCH_VOXEL_COUNT = 16384;
+	static thread_local StdVector<uint8_t> batch;
+	batch.resize(BATCH_VOXEL_COUNT * 4);
+
+	uint32_t remaining_count = voxel_count;
+
+	while (remaining_count > 0) {
+		const uint32_t count = math::min(remaining_count, BATCH_VOXEL_COUNT);
+		Span<uint8_t> bytes = to_span(batch).sub(0, count * 4);
+		ERR_FAIL_COND_V(godot::get_buffer(f, bytes) != bytes.size(), ERR_PARSE_ERROR);
+
+		for (uint32_t i = 0; i < bytes.size(); i += 4) {
+			const Vector3i pos = magica_to_opengl(Vector3i(bytes[i], bytes[i + 1], bytes[i + 2]));
+			ERR_FAIL_COND_V(pos.x >= size.x, ERR_PARSE_ERROR);
+			ERR_FAIL_COND_V(pos.y >= size.y, ERR_PARSE_ERROR);
+			ERR_FAIL_COND_V(pos.z >= size.z, ERR_PARSE_ERROR);
+			dst_color_indexes[Vector3iUtil::get_zxy_index(pos, size)] = bytes[i + 3];
+		}
+
+		remaining_count -= count;
+	}
+
+	return OK;
+}
+
 Basis parse_basis(uint8_t data) {
 	// bits 0 and 1 are the index of the non-zero entry in the first row
 	const int xi = (data >> 0) & 0x03;
@@ -184,17 +215,18 @@ void Data::clear() {
 	_layers.clear();
 	_materials.clear();
 	_root_node_id = -1;
+	_file_path = String();
 }
 
-Error Data::load_from_file(String fpath) {
-	const Error err = _load_from_file(fpath);
+Error Data::load_from_file(String fpath, bool load_voxels) {
+	const Error err = _load_from_file(fpath, load_voxels);
 	if (err != OK) {
 		clear();
 	}
 	return err;
 }
 
-Error Data::_load_from_file(String fpath) {
+Error Data::_load_from_file(String fpath, bool load_voxels) {
 	ZN_PROFILE_SCOPE();
 	// https://github.com/ephtracy/voxel-model/blob/master/MagicaVoxel-file-format-vox.txt
 	// https://github.com/ephtracy/voxel-model/blob/master/MagicaVoxel-file-format-vox-extension.txt
@@ -220,6 +252,7 @@ Error Data::_load_from_file(String fpath) {
 	Vector3i last_size;
 
 	clear();
+	_file_path = fpath;
 
 	while (f.get_position() < file_length) {
 		char chunk_id[5] = { 0 };
@@ -242,22 +275,18 @@ Error Data::_load_from_file(String fpath) {
 
 		} else if (strcmp(chunk_id, "XYZI") == 0) {
 			UniquePtr<Model> model = make_unique_instance<Model>();
-			model->color_indexes.resize(last_size.x * last_size.y * last_size.z, 0);
 			model->size = last_size;
-
-			const uint32_t num_voxels = f.get_32();
-
-			for (uint32_t i = 0; i < num_voxels; ++i) {
-				Vector3i pos;
-				pos.x = f.get_8();
-				pos.y = f.get_8();
-				pos.z = f.get_8();
-				const uint32_t c = f.get_8();
-				pos = magica_to_opengl(pos);
-				ERR_FAIL_COND_V(pos.x >= model->size.x || pos.x < 0, ERR_PARSE_ERROR);
-				ERR_FAIL_COND_V(pos.y >= model->size.y || pos.y < 0, ERR_PARSE_ERROR);
-				ERR_FAIL_COND_V(pos.z >= model->size.z || pos.z < 0, ERR_PARSE_ERROR);
-				model->color_indexes[Vector3iUtil::get_zxy_index(pos, model->size)] = c;
+			model->voxel_count = f.get_32();
+			model->voxels_file_position = f.get_position();
+			ERR_FAIL_COND_V(model->voxel_count > (chunk_size - 4) / 4, ERR_PARSE_ERROR);
+
+			if (load_voxels) {
+				model->color_indexes.resize(Vector3iUtil::get_volume_u64(model->size), 0);
+				const Error voxels_err =
+						parse_xyzi_voxels(f, model->voxel_count, model->size, to_span(model->color_indexes));
+				ERR_FAIL_COND_V(voxels_err != OK, voxels_err);
+			} else {
+				f.seek(model->voxels_file_position + model->voxel_count * 4);
 			}
 
 			_models.push_back(std::move(model));
@@ -567,6 +596,31 @@ const Model &Data::get_model(unsigned int index) const {
 	return *model;
 }
 
+Error Data::load_model_color_indexes(unsigned int model_index, StdVector<uint8_t> &out_color_indexes) const {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_INDEX_V(model_index, _models.size(), ERR_INVALID_PARAMETER);
+	const Model &model = *_models[model_index];
+
+	out_color_indexes.clear();
+	out_color_indexes.resize(Vector3iUtil::get_volume_u64(model.size), 0);
+
+	if (model.color_indexes.size() > 0) {
+		// Already loaded
+		memcpy(out_color_indexes.data(), model.color_indexes.data(), out_color_indexes.size());
+		return OK;
+	}
+
+	Error open_err;
+	Ref<FileAccess> f_ref = godot::open_file(_file_path, FileAccess::READ, open_err);
+	if (f_ref == nullptr) {
+		return open_err;
+	}
+	FileAccess &f = **f_ref;
+	f.seek(model.voxels_file_position);
+
+	return parse_xyzi_voxels(f, model.voxel_count, model.size, to_span(out_color_indexes));
+}
+
 const Node *Data::get_node(int id) const {
 	auto it = _scene_graph.find(id);
 	CRASH_COND(it == _scene_graph.end());
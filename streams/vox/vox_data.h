@@ -18,10 +18,12 @@ namespace zylann::voxel::magica {
 
 struct Model {
 	Vector3i size;
-	// TODO Optimization: implement lazy loading/streaming to reduce intermediary memory allocations?
-	// Loading a full 256^3 model needs 16 megabytes, but a lot of areas might actually be uniform,
-	// and we might not need the actual model immediately
+	// Loading a full 256^3 model needs 16 megabytes, so this is left empty if the file was loaded without voxels.
+	// They can then be decoded on demand with `Data::load_model_color_indexes`.
 	StdVector<uint8_t> color_indexes;
+	// Where the voxels of the model start in the file, and how many there are
+	uint64_t voxels_file_position = 0;
+	uint32_t voxel_count = 0;
 };
 
 struct Node {
@@ -100,7 +102,13 @@ struct Material {
 class Data {
 public:
 	void clear();
-	Error load_from_file(String fpath);
+	// If `load_voxels` is false, only metadata is loaded, and voxels of each model are left empty. This is useful with
+	// large scenes that wouldn't fit in memory.
+	Error load_from_file(String fpath, bool load_voxels = true);
+
+	// Decodes voxels of a model from the file that was loaded, in ZXY order. Opens its own file access, so it can be
+	// called from multiple threads at once.
+	Error load_model_color_indexes(unsigned int model_index, StdVector<uint8_t> &out_color_indexes) const;
 
 	unsigned int get_model_count() const;
 	const Model &get_model(unsigned int index) const;
@@ -120,8 +128,9 @@ public:
 	}
 
 private:
-	Error _load_from_file(String fpath);
+	Error _load_from_file(String fpath, bool load_voxels);
 
+	String _file_path;
 	StdVector<UniquePtr<Model>> _models;
 	StdVector<UniquePtr<Layer>> _layers;
 	StdUnorderedMap<int, UniquePtr<Node>> _scene_graph;
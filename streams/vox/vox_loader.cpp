@@ -1,11 +1,183 @@
 #include "vox_loader.h"
+#include "../../engine/voxel_engine.h"
 #include "../../meshers/cubes/voxel_color_palette.h"
+#include "../../storage/funcs.h"
 #include "../../storage/voxel_buffer_gd.h"
+#include "../../util/containers/std_unordered_map.h"
 #include "../../util/dstack.h"
+#include "../../util/math/conv.h"
+#include "../../util/math/transform_3d.h"
+#include "../../util/profiling.h"
+#include "../../util/tasks/parallel_jobs.h"
+#include "../voxel_stream.h"
 #include "vox_data.h"
+#include <algorithm>
 
 namespace zylann::voxel {
 
+namespace {
+
+struct SceneModelInstance {
+	unsigned int model_index;
+	// Lowest corner position, after rotation
+	Vector3i position;
+	// Size after rotation
+	Vector3i size;
+	IntBasis basis;
+	bool rotated;
+};
+
+template <typename F>
+Error for_each_model_instance_in_scene_graph(
+		const magica::Data &data,
+		int node_id,
+		Transform3D transform,
+		int depth,
+		F f
+) {
+	ERR_FAIL_COND_V(depth > 10, ERR_INVALID_DATA);
+	const magica::Node *vox_node = data.get_node(node_id);
+
+	switch (vox_node->type) {
+		case magica::Node::TYPE_TRANSFORM: {
+			const magica::TransformNode *vox_transform_node =
+					reinterpret_cast<const magica::TransformNode *>(vox_node);
+			const Transform3D child_trans(
+					transform.basis * vox_transform_node->rotation.basis, transform.xform(vox_transform_node->position)
+			);
+			return for_each_model_instance_in_scene_graph(
+					data, vox_transform_node->child_node_id, child_trans, depth + 1, f
+			);
+		}
+
+		case magica::Node::TYPE_GROUP: {
+			const magica::GroupNode *vox_group_node = reinterpret_cast<const magica::GroupNode *>(vox_node);
+			for (const int child_node_id : vox_group_node->child_node_ids) {
+				const Error err = for_each_model_instance_in_scene_graph(data, child_node_id, transform, depth + 1, f);
+				ERR_FAIL_COND_V(err != OK, err);
+			}
+		} break;
+
+		case magica::Node::TYPE_SHAPE: {
+			const magica::ShapeNode *vox_shape_node = reinterpret_cast<const magica::ShapeNode *>(vox_node);
+			f(vox_shape_node->model_id, math::round_to_int(transform.origin), transform.basis);
+		} break;
+
+		default:
+			ERR_FAIL_V(ERR_INVALID_DATA);
+	}
+
+	return OK;
+}
+
+Error gather_scene_model_instances(const magica::Data &data, StdVector<SceneModelInstance> &out_instances) {
+	if (data.get_model_count() == 0) {
+		return OK;
+	}
+
+	auto add_instance = [&data, &out_instances](int model_index, Vector3i pivot, const Basis &basis) {
+		const magica::Model &model = data.get_model(model_index);
+		SceneModelInstance mi;
+		mi.model_index = model_index;
+		mi.rotated = basis != Basis();
+		mi.basis.x = to_vec3i(basis.get_column(Vector3::AXIS_X));
+		mi.basis.y = to_vec3i(basis.get_column(Vector3::AXIS_Y));
+		mi.basis.z = to_vec3i(basis.get_column(Vector3::AXIS_Z));
+		// Rotations only swap axes, so the size is the same as what `transform_3d_array_zxy` would return
+		mi.size = math::abs(mi.basis.x * model.size.x + mi.basis.y * model.size.y + mi.basis.z * model.size.z);
+		// Pivot is at the center in MagicaVoxel
+		mi.position = pivot - mi.size / 2;
+		out_instances.push_back(mi);
+	};
+
+	if (data.get_root_node_id() == -1) {
+		// No scene graph
+		add_instance(0, data.get_model(0).size / 2, Basis());
+		return OK;
+	}
+
+	return for_each_model_instance_in_scene_graph(data, data.get_root_node_id(), Transform3D(), 0, add_instance);
+}
+
+struct PartialBlock {
+	Vector3i position;
+	UniquePtr<VoxelBuffer> voxels;
+};
+
+template <typename T, typename FConvert>
+void split_into_blocks(
+		Span<const uint8_t> src_color_indexes,
+		Box3i src_box,
+		int block_size_po2,
+		VoxelBuffer::ChannelId channel,
+		VoxelBuffer::Depth depth,
+		FConvert convert,
+		StdVector<PartialBlock> &out_blocks
+) {
+	const int block_size = 1 << block_size_po2;
+	const Box3i blocks_box = src_box.downscaled(block_size);
+
+	blocks_box.for_each_cell_zxy([&](Vector3i bpos) {
+		const Vector3i block_origin = bpos << block_size_po2;
+		const Box3i box = Box3i(block_origin, Vector3iUtil::create(block_size)).clipped(src_box);
+
+		UniquePtr<VoxelBuffer> voxels = make_unique_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+		voxels->create(Vector3iUtil::create(block_size));
+		voxels->set_channel_depth(channel, depth);
+		voxels->decompress_channel(channel);
+
+		Span<uint8_t> dst_raw;
+		ZN_ASSERT_RETURN(voxels->get_channel_as_bytes(channel, dst_raw));
+		Span<T> dst = dst_raw.reinterpret_cast_to<T>();
+		bool empty = true;
+
+		const Vector3i max = box.position + box.size;
+		Vector3i pos;
+		for (pos.z = box.position.z; pos.z < max.z; ++pos.z) {
+			for (pos.x = box.position.x; pos.x < max.x; ++pos.x) {
+				unsigned int src_i = Vector3iUtil::get_zxy_index(
+						Vector3i(pos.x, box.position.y, pos.z) - src_box.position, src_box.size
+				);
+				unsigned int dst_i = Vector3iUtil::get_zxy_index(
+						Vector3i(pos.x, box.position.y, pos.z) - block_origin, Vector3iUtil::create(block_size)
+				);
+				for (pos.y = box.position.y; pos.y < max.y; ++pos.y) {
+					const uint8_t ci = src_color_indexes[src_i];
+					if (ci != 0) {
+						dst[dst_i] = convert(ci);
+						empty = false;
+					}
+					++src_i;
+					++dst_i;
+				}
+			}
+		}
+
+		if (!empty) {
+			out_blocks.push_back(PartialBlock{ bpos, std::move(voxels) });
+		}
+	});
+}
+
+// Non-empty voxels of `src` overwrite those of `dst`, like models placed later in a MagicaVoxel scene
+template <typename T>
+void merge_block(VoxelBuffer &dst, const VoxelBuffer &src, VoxelBuffer::ChannelId channel) {
+	Span<uint8_t> dst_raw;
+	Span<const uint8_t> src_raw;
+	ZN_ASSERT_RETURN(dst.get_channel_as_bytes(channel, dst_raw));
+	ZN_ASSERT_RETURN(src.get_channel_as_bytes_read_only(channel, src_raw));
+	Span<T> dst_values = dst_raw.reinterpret_cast_to<T>();
+	Span<const T> src_values = src_raw.reinterpret_cast_to<const T>();
+	for (unsigned int i = 0; i < dst_values.size(); ++i) {
+		const T v = src_values[i];
+		if (v != 0) {
+			dst_values[i] = v;
+		}
+	}
+}
+
+} // namespace
+
 int /*Error*/ VoxelVoxLoader::load_from_file(
 		String fpath,
 		Ref<godot::VoxelBuffer> p_voxels,
@@ -79,6 +251,171 @@ int /*Error*/ VoxelVoxLoader::load_from_file(
 	return load_err;
 }
 
+int /*Error*/ VoxelVoxLoader::load_scene_into_stream(
+		String fpath,
+		Ref<VoxelStream> stream,
+		Ref<VoxelColorPalette> palette,
+		godot::VoxelBuffer::ChannelId dst_channel
+) {
+	ZN_DSTACK();
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_INDEX_V(dst_channel, godot::VoxelBuffer::MAX_CHANNELS, ERR_INVALID_PARAMETER);
+	ERR_FAIL_COND_V(stream.is_null(), ERR_INVALID_PARAMETER);
+	const VoxelBuffer::ChannelId channel = static_cast<VoxelBuffer::ChannelId>(dst_channel);
+
+	// Only metadata is loaded upfront. Voxels of each model are decoded when converted, so memory usage doesn't depend
+	// on the size of the whole scene.
+	magica::Data data;
+	const Error load_err = data.load_from_file(fpath, false);
+	ERR_FAIL_COND_V(load_err != OK, load_err);
+
+	StdVector<SceneModelInstance> instances;
+	const Error graph_err = gather_scene_model_instances(data, instances);
+	ERR_FAIL_COND_V(graph_err != OK, graph_err);
+
+	const int block_size_po2 = stream->get_block_size_po2();
+	const int block_size = 1 << block_size_po2;
+
+	// Instances are converted in order of their lowest block along Z. Once every instance starting before a given
+	// block slice is converted, blocks below that slice are complete and can be saved, so only a front of blocks is
+	// kept in memory.
+	std::stable_sort(
+			instances.begin(),
+			instances.end(),
+			[block_size](const SceneModelInstance &a, const SceneModelInstance &b) {
+				return math::floordiv(a.position.z, block_size) < math::floordiv(b.position.z, block_size);
+			}
+	);
+
+	Span<const Color8> src_palette = to_span_const(data.get_palette());
+	const VoxelBuffer::Depth depth = palette.is_valid() ? VoxelBuffer::DEPTH_8_BIT : VoxelBuffer::DEPTH_16_BIT;
+
+	if (palette.is_valid()) {
+		for (unsigned int i = 0; i < src_palette.size(); ++i) {
+			palette->set_color8(i, src_palette[i]);
+		}
+	}
+
+	VoxelEngine &engine = VoxelEngine::get_singleton();
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = [](Span<IThreadedTask *> tasks) { //
+		VoxelEngine::get_singleton().push_async_tasks(tasks);
+	};
+	const unsigned int thread_count = engine.get_thread_count();
+	scheduler.max_helpers = thread_count > 0 ? thread_count - 1 : 0;
+
+	// Bounds how many decoded models are in memory at once
+	const unsigned int batch_size = math::max(thread_count, 1u) * 2;
+
+	StdUnorderedMap<Vector3i, UniquePtr<VoxelBuffer>> pending_blocks;
+	StdVector<StdVector<PartialBlock>> batch_blocks;
+	StdVector<Error> batch_errors;
+	StdVector<VoxelStream::VoxelQueryData> queries;
+	StdVector<Vector3i> saved_positions;
+
+	for (unsigned int batch_begin = 0; batch_begin < instances.size(); batch_begin += batch_size) {
+		const unsigned int batch_end = math::min(batch_begin + batch_size, static_cast<unsigned int>(instances.size()));
+		const unsigned int count = batch_end - batch_begin;
+
+		batch_blocks.clear();
+		batch_blocks.resize(count);
+		batch_errors.clear();
+		batch_errors.resize(count, OK);
+
+		run_parallel_jobs(count, scheduler, [&](uint32_t job_index) {
+			ZN_PROFILE_SCOPE_NAMED("Vox model conversion");
+			const SceneModelInstance &mi = instances[batch_begin + job_index];
+
+			StdVector<uint8_t> color_indexes;
+			const Error err = data.load_model_color_indexes(mi.model_index, color_indexes);
+			if (err != OK) {
+				batch_errors[job_index] = err;
+				return;
+			}
+
+			StdVector<uint8_t> rotated_color_indexes;
+			if (mi.rotated) {
+				rotated_color_indexes.resize(color_indexes.size());
+				transform_3d_array_zxy(
+						to_span_const(color_indexes),
+						to_span(rotated_color_indexes),
+						data.get_model(mi.model_index).size,
+						mi.basis
+				);
+				color_indexes.swap(rotated_color_indexes);
+			}
+
+			const Box3i src_box(mi.position, mi.size);
+
+			if (depth == VoxelBuffer::DEPTH_8_BIT) {
+				split_into_blocks<uint8_t>(
+						to_span_const(color_indexes),
+						src_box,
+						block_size_po2,
+						channel,
+						depth,
+						[](uint8_t ci) { return ci; },
+						batch_blocks[job_index]
+				);
+			} else {
+				split_into_blocks<uint16_t>(
+						to_span_const(color_indexes),
+						src_box,
+						block_size_po2,
+						channel,
+						depth,
+						[src_palette](uint8_t ci) { return src_palette[ci].to_u16(); },
+						batch_blocks[job_index]
+				);
+			}
+		});
+
+		for (const Error err : batch_errors) {
+			ERR_FAIL_COND_V(err != OK, err);
+		}
+
+		// Merged in scene order, so results don't depend on threads
+		for (StdVector<PartialBlock> &blocks : batch_blocks) {
+			for (PartialBlock &block : blocks) {
+				auto it = pending_blocks.find(block.position);
+				if (it == pending_blocks.end()) {
+					pending_blocks.insert(std::make_pair(block.position, std::move(block.voxels)));
+				} else if (depth == VoxelBuffer::DEPTH_8_BIT) {
+					merge_block<uint8_t>(*it->second, *block.voxels, channel);
+				} else {
+					merge_block<uint16_t>(*it->second, *block.voxels, channel);
+				}
+			}
+		}
+
+		// Save blocks no remaining instance can touch
+		const bool last_batch = batch_end == instances.size();
+		const int min_remaining_bz = last_batch ? 0 : math::floordiv(instances[batch_end].position.z, block_size);
+
+		queries.clear();
+		saved_positions.clear();
+		for (auto it = pending_blocks.begin(); it != pending_blocks.end(); ++it) {
+			if (last_batch || it->first.z < min_remaining_bz) {
+				VoxelBuffer &voxels = *it->second;
+				voxels.compress_uniform_channels();
+				queries.push_back(VoxelStream::VoxelQueryData{ voxels, it->first, 0, VoxelStream::RESULT_ERROR });
+				saved_positions.push_back(it->first);
+			}
+		}
+		if (queries.size() > 0) {
+			ZN_PROFILE_SCOPE_NAMED("Save blocks");
+			stream->save_voxel_blocks(to_span(queries));
+			for (const Vector3i bpos : saved_positions) {
+				pending_blocks.erase(bpos);
+			}
+		}
+	}
+
+	stream->flush();
+
+	return OK;
+}
+
 void VoxelVoxLoader::_bind_methods() {
 	ClassDB::bind_static_method(
 			VoxelVoxLoader::get_class_static(),
@@ -86,6 +423,12 @@ void VoxelVoxLoader::_bind_methods() {
 			&VoxelVoxLoader::load_from_file,
 			DEFVAL(godot::VoxelBuffer::CHANNEL_COLOR)
 	);
+	ClassDB::bind_static_method(
+			VoxelVoxLoader::get_class_static(),
+			D_METHOD("load_scene_into_stream", "fpath", "stream", "palette", "dst_channel"),
+			&VoxelVoxLoader::load_scene_into_stream,
+			DEFVAL(godot::VoxelBuffer::CHANNEL_COLOR)
+	);
 }
 
 } // namespace zylann::voxel
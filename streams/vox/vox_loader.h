@@ -7,6 +7,7 @@
 namespace zylann::voxel {
 
 class VoxelColorPalette;
+class VoxelStream;
 
 // Simple loader for MagicaVoxel
 class VoxelVoxLoader : public RefCounted {
@@ -20,7 +21,15 @@ public:
 			Ref<VoxelColorPalette> palette,
 			godot::VoxelBuffer::ChannelId dst_channel
 	);
-	// TODO Have chunked loading for better memory usage
+	// Converts every model instance of a scene into blocks saved into a stream, at LOD 0. Unlike `load_from_file`, the
+	// scene doesn't need to fit in memory: models are decoded from the file when needed, converted in parallel, and
+	// blocks are saved as soon as they are complete.
+	static int /*Error*/ load_scene_into_stream(
+			String fpath,
+			Ref<VoxelStream> stream,
+			Ref<VoxelColorPalette> palette,
+			godot::VoxelBuffer::ChannelId dst_channel
+	);
 	// TODO Saving
 
 private:
@@ -12,8 +12,11 @@
 #if defined(ZN_GODOT) || defined(ZN_GODOT_EXTENSION)
 #include "../storage/metadata/voxel_metadata_factory.h"
 #include "../storage/metadata/voxel_metadata_variant.h"
+#include "../util/godot/core/string.h"
 #endif
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 
 namespace zylann::voxel {
@@ -40,68 +43,6 @@ StdVector<uint8_t> &get_tls_compressed_data() {
 	return tls_compressed_data;
 }
 
-size_t get_metadata_size_in_bytes(const VoxelMetadata &meta) {
-	size_t size = 1; // Type
-	switch (meta.get_type()) {
-		case VoxelMetadata::TYPE_EMPTY:
-			break;
-		case VoxelMetadata::TYPE_U64:
-			size += sizeof(uint64_t);
-			break;
-		default:
-			if (meta.get_type() >= VoxelMetadata::TYPE_CUSTOM_BEGIN) {
-				const ICustomVoxelMetadata &custom = meta.get_custom();
-				size += custom.get_serialized_size();
-			} else {
-				ZN_PRINT_ERROR("Unknown metadata type");
-				return 0;
-			}
-	}
-	return size;
-}
-
-size_t get_metadata_size_in_bytes(const VoxelBuffer &buffer) {
-	size_t size = 0;
-
-	const FlatMapMoveOnly<Vector3i, VoxelMetadata> &voxel_metadata = buffer.get_voxel_metadata();
-	for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator it = voxel_metadata.begin();
-		 it != voxel_metadata.end();
-		 ++it) {
-		const Vector3i pos = it->key;
-
-		ERR_FAIL_COND_V_MSG(
-				pos.x < 0 || static_cast<uint32_t>(pos.x) >= VoxelBuffer::MAX_SIZE,
-				0,
-				"Invalid voxel metadata X position"
-		);
-		ERR_FAIL_COND_V_MSG(
-				pos.y < 0 || static_cast<uint32_t>(pos.y) >= VoxelBuffer::MAX_SIZE,
-				0,
-				"Invalid voxel metadata Y position"
-		);
-		ERR_FAIL_COND_V_MSG(
-				pos.z < 0 || static_cast<uint32_t>(pos.z) >= VoxelBuffer::MAX_SIZE,
-				0,
-				"Invalid voxel metadata Z position"
-		);
-
-		size += 3 * sizeof(uint16_t); // Positions are stored as 3 unsigned shorts
-		size += get_metadata_size_in_bytes(it->value);
-	}
-
-	// If no metadata is found at all, nothing is serialized, not even null.
-	// It spares 24 bytes (40 if real_t == double),
-	// and is backward compatible with saves made before introduction of metadata.
-
-	const VoxelMetadata &block_meta = buffer.get_block_metadata();
-
-	if (size != 0 || block_meta.get_type() != VoxelMetadata::TYPE_EMPTY) {
-		size += get_metadata_size_in_bytes(block_meta);
-	}
-
-	return size;
-}
-
 template <typename T>
 inline void write(uint8_t *&dst, T d) {
 	*(T *)dst = d;
@@ -115,7 +56,9 @@ inline T read(uint8_t *&src) {
 	return d;
 }
 
-void serialize_metadata(const VoxelMetadata &meta, MemoryWriterExistingBuffer &mw) {
+// Single metadata entry: type, followed by its payload. Block metadata still uses this encoding, and so did voxel
+// metadata before version 6.
+void serialize_metadata(const VoxelMetadata &meta, MemoryWriter &mw) {
 	const uint8_t type = meta.get_type();
 	switch (type) {
 		case VoxelMetadata::TYPE_EMPTY:
@@ -128,9 +71,7 @@ void serialize_metadata(const VoxelMetadata &meta, MemoryWriterExistingBuffer &m
 		default:
 			if (type >= VoxelMetadata::TYPE_CUSTOM_BEGIN) {
 				mw.store_8(type);
-				const size_t written_size = meta.get_custom().serialize(mw.data.data.sub(mw.data.pos));
-				ZN_ASSERT(mw.data.pos + written_size <= mw.data.data.size());
-				mw.data.pos += written_size;
+				meta.get_custom().serialize_append(mw.data);
 			} else {
 				ZN_PRINT_ERROR("Unknown metadata type");
 				mw.store_8(VoxelMetadata::TYPE_EMPTY);
@@ -139,32 +80,6 @@ void serialize_metadata(const VoxelMetadata &meta, MemoryWriterExistingBuffer &m
 	}
 }
 
-// The target buffer MUST have correct size. Recoverable errors must have been checked before.
-void serialize_metadata(Span<uint8_t> p_dst, const VoxelBuffer &buffer) {
-	ByteSpanWithPosition bs(p_dst, 0);
-	MemoryWriterExistingBuffer mw(bs, ENDIANNESS_LITTLE_ENDIAN);
-
-	const VoxelMetadata &block_meta = buffer.get_block_metadata();
-	serialize_metadata(block_meta, mw);
-
-	const FlatMapMoveOnly<Vector3i, VoxelMetadata> &voxel_metadata = buffer.get_voxel_metadata();
-	for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator it = voxel_metadata.begin();
-		 it != voxel_metadata.end();
-		 ++it) {
-		// Serializing key as ushort because it's more than enough for a 3D dense array
-		static_assert(
-				VoxelBuffer::MAX_SIZE <= std::numeric_limits<uint16_t>::max(),
-				"Maximum size exceeds serialization support"
-		);
-		const Vector3i pos = it->key;
-		mw.store_16(pos.x);
-		mw.store_16(pos.y);
-		mw.store_16(pos.z);
-
-		serialize_metadata(it->value, mw);
-	}
-}
-
 template <typename T>
 struct ClearOnExit {
 	T &container;
@@ -212,13 +127,21 @@ bool deserialize_metadata(VoxelMetadata &meta, MemoryReader &mr) {
 	}
 }
 
-bool deserialize_metadata(Span<const uint8_t> p_src, VoxelBuffer &buffer) {
+typedef FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair MetadataPair;
+
+StdVector<MetadataPair> &get_tls_metadata_pairs() {
+	thread_local StdVector<MetadataPair> tls_pairs;
+	return tls_pairs;
+}
+
+// Metadata section used before version 6: block metadata followed by positions and entries, interleaved.
+bool deserialize_metadata_legacy(Span<const uint8_t> p_src, VoxelBuffer &buffer) {
 	MemoryReader mr(p_src, ENDIANNESS_LITTLE_ENDIAN);
 
 	ZN_ASSERT_RETURN_V(deserialize_metadata(buffer.get_block_metadata(), mr), false);
 
-	typedef FlatMapMoveOnly<Vector3i, VoxelMetadata>::Pair Pair;
-	static thread_local StdVector<Pair> tls_pairs;
+	typedef MetadataPair Pair;
+	StdVector<Pair> &tls_pairs = get_tls_metadata_pairs();
 	// Clear when exiting scope (including cases of error) so we don't store dangling Variants
 	ClearOnExit<StdVector<Pair>> clear_tls_pairs{ tls_pairs };
 
@@ -248,7 +171,643 @@ bool deserialize_metadata(Span<const uint8_t> p_src, VoxelBuffer &buffer) {
 	return true;
 }
 
-size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
+// Metadata section since version 6:
+// - Block metadata, as a single entry
+// - Number of voxel metadata entries (u32)
+// - For each entry in increasing ZXY index order, the difference with the index of the previous entry (u16). The
+//   first one is relative to 0. Differences that don't fit are escaped with `PACKED_METADATA_LARGE_DELTA` followed by
+//   the difference as u32.
+// - For each entry, its tag (u8)
+// - Payloads grouped by tag, in increasing tag order then entry order.
+// Voxels with metadata tend to be sparse, positions are much smaller this way, and common values are stored without
+// going through generic Variant encoding.
+enum PackedMetadataTag : uint8_t {
+	PACKED_METADATA_EMPTY = 0,
+	PACKED_METADATA_U64,
+	// Custom type ID followed by bytes written by the custom type
+	PACKED_METADATA_CUSTOM,
+	PACKED_METADATA_VARIANT_BOOL,
+	PACKED_METADATA_VARIANT_INT,
+	PACKED_METADATA_VARIANT_FLOAT,
+	PACKED_METADATA_VARIANT_STRING,
+	PACKED_METADATA_VARIANT_VECTOR3I,
+	PACKED_METADATA_TAG_COUNT
+};
+
+const uint16_t PACKED_METADATA_LARGE_DELTA = 0xffff;
+
+struct PackedMetadataEntry {
+	uint32_t index;
+	PackedMetadataTag tag;
+	const VoxelMetadata *meta;
+};
+
+StdVector<PackedMetadataEntry> &get_tls_packed_metadata_entries() {
+	thread_local StdVector<PackedMetadataEntry> tls_entries;
+	return tls_entries;
+}
+
+PackedMetadataTag get_packed_metadata_tag(const VoxelMetadata &meta) {
+	const uint8_t type = meta.get_type();
+	switch (type) {
+		case VoxelMetadata::TYPE_EMPTY:
+			return PACKED_METADATA_EMPTY;
+		case VoxelMetadata::TYPE_U64:
+			return PACKED_METADATA_U64;
+		default:
+			break;
+	}
+	if (type < VoxelMetadata::TYPE_CUSTOM_BEGIN) {
+		ZN_PRINT_ERROR("Unknown metadata type");
+		return PACKED_METADATA_EMPTY;
+	}
+#if defined(ZN_GODOT) || defined(ZN_GODOT_EXTENSION)
+	if (type == godot::METADATA_TYPE_VARIANT) {
+		const Variant &v = static_cast<const godot::VoxelMetadataVariant &>(meta.get_custom()).data;
+		switch (v.get_type()) {
+			case Variant::BOOL:
+				return PACKED_METADATA_VARIANT_BOOL;
+			case Variant::INT:
+				return PACKED_METADATA_VARIANT_INT;
+			case Variant::FLOAT:
+				return PACKED_METADATA_VARIANT_FLOAT;
+			case Variant::STRING:
+				return PACKED_METADATA_VARIANT_STRING;
+			case Variant::VECTOR3I:
+				return PACKED_METADATA_VARIANT_VECTOR3I;
+			default:
+				break;
+		}
+	}
+#endif
+	return PACKED_METADATA_CUSTOM;
+}
+
+void serialize_packed_metadata_payload(const VoxelMetadata &meta, PackedMetadataTag tag, MemoryWriter &mw) {
+	switch (tag) {
+		case PACKED_METADATA_EMPTY:
+			break;
+		case PACKED_METADATA_U64:
+			mw.store_64(meta.get_u64());
+			break;
+		case PACKED_METADATA_CUSTOM:
+			// Same as a single entry
+			serialize_metadata(meta, mw);
+			break;
+#if defined(ZN_GODOT) || defined(ZN_GODOT_EXTENSION)
+		case PACKED_METADATA_VARIANT_BOOL: {
+			const bool b = godot::get_as_variant(meta);
+			mw.store_8(b ? 1 : 0);
+		} break;
+		case PACKED_METADATA_VARIANT_INT: {
+			const int64_t i = godot::get_as_variant(meta);
+			mw.store_64(i);
+		} break;
+		case PACKED_METADATA_VARIANT_FLOAT: {
+			const double d = godot::get_as_variant(meta);
+			uint64_t bits;
+			memcpy(&bits, &d, sizeof(bits));
+			mw.store_64(bits);
+		} break;
+		case PACKED_METADATA_VARIANT_STRING: {
+			const String gs = godot::get_as_variant(meta);
+			const StdString s = zylann::godot::to_std_string(gs);
+			mw.store_32(s.size());
+			mw.store_buffer(Span<const uint8_t>(reinterpret_cast<const uint8_t *>(s.data()), s.size()));
+		} break;
+		case PACKED_METADATA_VARIANT_VECTOR3I: {
+			const Vector3i v = godot::get_as_variant(meta);
+			mw.store_32(v.x);
+			mw.store_32(v.y);
+			mw.store_32(v.z);
+		} break;
+#endif
+		default:
+			ZN_CRASH_MSG("Unhandled metadata tag");
+	}
+}
+
+// Appends the metadata section of the buffer to `dst`. Nothing is appended if the buffer has no metadata.
+void serialize_packed_metadata(const VoxelBuffer &buffer, StdVector<uint8_t> &dst) {
+	const FlatMapMoveOnly<Vector3i, VoxelMetadata> &voxel_metadata = buffer.get_voxel_metadata();
+	const VoxelMetadata &block_meta = buffer.get_block_metadata();
+
+	// If no metadata is found at all, nothing is serialized, not even null.
+	// It is backward compatible with saves made before introduction of metadata.
+	if (voxel_metadata.size() == 0 && block_meta.get_type() == VoxelMetadata::TYPE_EMPTY) {
+		return;
+	}
+
+	const Vector3i buffer_size = buffer.get_size();
+
+	StdVector<PackedMetadataEntry> &entries = get_tls_packed_metadata_entries();
+	entries.clear();
+
+	for (FlatMapMoveOnly<Vector3i, VoxelMetadata>::ConstIterator it = voxel_metadata.begin();
+		 it != voxel_metadata.end();
+		 ++it) {
+		ZN_ASSERT_CONTINUE_MSG(
+				buffer.is_position_valid(it->key),
+				format("Invalid voxel metadata position {} for buffer of size {}", it->key, buffer_size)
+		);
+		entries.push_back(PackedMetadataEntry{
+				Vector3iUtil::get_zxy_index(it->key, buffer_size), get_packed_metadata_tag(it->value), &it->value
+		});
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const PackedMetadataEntry &a, const PackedMetadataEntry &b) {
+		return a.index < b.index;
+	});
+
+	MemoryWriter mw(dst, ENDIANNESS_LITTLE_ENDIAN);
+
+	serialize_metadata(block_meta, mw);
+
+	mw.store_32(entries.size());
+
+	uint32_t prev_index = 0;
+	for (const PackedMetadataEntry &entry : entries) {
+		const uint32_t delta = entry.index - prev_index;
+		if (delta >= PACKED_METADATA_LARGE_DELTA) {
+			mw.store_16(PACKED_METADATA_LARGE_DELTA);
+			mw.store_32(delta);
+		} else {
+			mw.store_16(delta);
+		}
+		prev_index = entry.index;
+	}
+
+	for (const PackedMetadataEntry &entry : entries) {
+		mw.store_8(entry.tag);
+	}
+
+	for (unsigned int tag = 0; tag < PACKED_METADATA_TAG_COUNT; ++tag) {
+		for (const PackedMetadataEntry &entry : entries) {
+			if (entry.tag == tag) {
+				serialize_packed_metadata_payload(*entry.meta, entry.tag, mw);
+			}
+		}
+	}
+
+	entries.clear();
+}
+
+inline bool has_remaining_bytes(const MemoryReader &mr, size_t count) {
+	return mr.pos + count <= mr.data.size();
+}
+
+bool deserialize_packed_metadata_payload(VoxelMetadata &meta, PackedMetadataTag tag, MemoryReader &mr) {
+	switch (tag) {
+		case PACKED_METADATA_EMPTY:
+			meta.clear();
+			return true;
+
+		case PACKED_METADATA_U64:
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, sizeof(uint64_t)), false);
+			meta.set_u64(mr.get_64());
+			return true;
+
+		case PACKED_METADATA_CUSTOM:
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, 1), false);
+			return deserialize_metadata(meta, mr);
+
+#if defined(ZN_GODOT) || defined(ZN_GODOT_EXTENSION)
+		case PACKED_METADATA_VARIANT_BOOL:
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, 1), false);
+			godot::set_as_variant(meta, mr.get_8() != 0);
+			return true;
+
+		case PACKED_METADATA_VARIANT_INT:
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, sizeof(int64_t)), false);
+			godot::set_as_variant(meta, static_cast<int64_t>(mr.get_64()));
+			return true;
+
+		case PACKED_METADATA_VARIANT_FLOAT: {
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, sizeof(double)), false);
+			const uint64_t bits = mr.get_64();
+			double d;
+			memcpy(&d, &bits, sizeof(d));
+			godot::set_as_variant(meta, d);
+			return true;
+		}
+
+		case PACKED_METADATA_VARIANT_STRING: {
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, sizeof(uint32_t)), false);
+			const uint32_t size = mr.get_32();
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, size), false);
+			const char *chars = reinterpret_cast<const char *>(mr.data.data() + mr.pos);
+			godot::set_as_variant(meta, zylann::godot::to_godot(std::string_view(chars, size)));
+			mr.pos += size;
+			return true;
+		}
+
+		case PACKED_METADATA_VARIANT_VECTOR3I: {
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, 3 * sizeof(int32_t)), false);
+			Vector3i v;
+			v.x = static_cast<int32_t>(mr.get_32());
+			v.y = static_cast<int32_t>(mr.get_32());
+			v.z = static_cast<int32_t>(mr.get_32());
+			godot::set_as_variant(meta, v);
+			return true;
+		}
+#endif
+
+		default:
+			ZN_PRINT_ERROR(format("Unsupported metadata tag {}", tag));
+			return false;
+	}
+}
+
+bool deserialize_packed_metadata(Span<const uint8_t> p_src, VoxelBuffer &buffer) {
+	MemoryReader mr(p_src, ENDIANNESS_LITTLE_ENDIAN);
+
+	ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, 1), false);
+	ZN_ASSERT_RETURN_V(deserialize_metadata(buffer.get_block_metadata(), mr), false);
+
+	ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, sizeof(uint32_t)), false);
+	const uint32_t count = mr.get_32();
+	// Each entry takes at least 3 bytes
+	ZN_ASSERT_RETURN_V(count <= (mr.data.size() - mr.pos) / 3, false);
+
+	const Vector3i buffer_size = buffer.get_size();
+	const uint64_t volume = Vector3iUtil::get_volume_u64(buffer_size);
+
+	StdVector<MetadataPair> &tls_pairs = get_tls_metadata_pairs();
+	// Clear when exiting scope (including cases of error) so we don't store dangling Variants
+	ClearOnExit<StdVector<MetadataPair>> clear_tls_pairs{ tls_pairs };
+	tls_pairs.resize(count);
+
+	uint64_t index = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, sizeof(uint16_t)), false);
+		uint32_t delta = mr.get_16();
+		if (delta == PACKED_METADATA_LARGE_DELTA) {
+			ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, sizeof(uint32_t)), false);
+			delta = mr.get_32();
+		}
+		index += delta;
+		ZN_ASSERT_RETURN_V_MSG(
+				index < volume,
+				false,
+				format("Invalid voxel metadata index {} for buffer of size {}", index, buffer_size)
+		);
+		tls_pairs[i].key = Vector3iUtil::from_zxy_index(static_cast<unsigned int>(index), buffer_size);
+	}
+
+	ZN_ASSERT_RETURN_V(has_remaining_bytes(mr, count), false);
+	Span<const uint8_t> tags = mr.data.sub(mr.pos, count);
+	mr.pos += count;
+
+	for (const uint8_t tag : tags) {
+		ZN_ASSERT_RETURN_V_MSG(tag < PACKED_METADATA_TAG_COUNT, false, format("Invalid metadata tag {}", tag));
+	}
+
+	for (unsigned int tag = 0; tag < PACKED_METADATA_TAG_COUNT; ++tag) {
+		for (uint32_t i = 0; i < count; ++i) {
+			if (tags[i] != tag) {
+				continue;
+			}
+			MetadataPair &p = tls_pairs[i];
+			ZN_ASSERT_RETURN_V_MSG(
+					deserialize_packed_metadata_payload(p.value, static_cast<PackedMetadataTag>(tag), mr),
+					false,
+					format("Failed to deserialize voxel metadata {}", p.key)
+			);
+		}
+	}
+
+	// Set all metadata at once, FlatMap is faster to initialize this way
+	buffer.clear_and_set_voxel_metadata(to_span(tls_pairs));
+
+	return true;
+}
+
+namespace {
+
+// How voxels of a channel are encoded in serialized blocks, stored in the 3 lowest bits of their format byte
+// (`fmt & 0x7`). The 4th bit is `CHANNEL_ENCODING_NARROWED_FLAG`, and the high nibble is the depth of the channel.
+// The first values match `VoxelBuffer::Compression`, since that is what versions prior to 5 were storing.
+// Encodings are chosen per channel when serializing, and only transform data before block compression.
+enum ChannelEncoding {
+	// Voxels as they are in memory
+	CHANNEL_ENCODING_RAW = 0,
+	// A single value for all voxels
+	CHANNEL_ENCODING_UNIFORM = 1,
+	// Differences between consecutive voxels in ZXY order, zigzag-encoded so small negative differences stay small,
+	// with the bytes of each value split into planes. Smooth SDF gradients then turn into long sequences of small
+	// bytes and zeroes, which LZ4 and Zstd compress much better than raw values.
+	CHANNEL_ENCODING_DELTA = 2,
+	// Runs of identical voxels in ZXY order. Stored as a run count, then all run lengths, then all run values.
+	CHANNEL_ENCODING_RLE = 3,
+	CHANNEL_ENCODING_COUNT
+};
+
+// Set on top of the encoding when all values of a 16-bit channel fit in 8 bits. They are then encoded as 8-bit
+// values, and widened back to the depth of the format byte when loading. Introduced in version 7.
+const uint8_t CHANNEL_ENCODING_NARROWED_FLAG = 0x8;
+
+const unsigned int RLE_MAX_RUN_LENGTH = std::numeric_limits<uint16_t>::max();
+const unsigned int RLE_HEADER_SIZE = sizeof(uint32_t);
+
+inline uint8_t zigzag_encode(int8_t v) {
+	return static_cast<uint8_t>((static_cast<uint8_t>(v) << 1) ^ static_cast<uint8_t>(v >> 7));
+}
+
+inline uint16_t zigzag_encode(int16_t v) {
+	return static_cast<uint16_t>((static_cast<uint16_t>(v) << 1) ^ static_cast<uint16_t>(v >> 15));
+}
+
+inline int8_t zigzag_decode(uint8_t v) {
+	return static_cast<int8_t>((v >> 1) ^ -(v & 1));
+}
+
+inline int16_t zigzag_decode(uint16_t v) {
+	return static_cast<int16_t>((v >> 1) ^ -(v & 1));
+}
+
+// Channel data is stored in native order in memory, like raw channels
+template <typename T>
+inline T load_value(const uint8_t *src, size_t i) {
+	T v;
+	memcpy(&v, src + i * sizeof(T), sizeof(T));
+	return v;
+}
+
+template <typename T>
+inline void store_value(uint8_t *dst, size_t i, T v) {
+	memcpy(dst + i * sizeof(T), &v, sizeof(T));
+}
+
+void encode_delta_8(Span<const uint8_t> src, Span<uint8_t> dst) {
+	uint8_t prev = 0;
+	for (size_t i = 0; i < src.size(); ++i) {
+		const uint8_t v = src[i];
+		dst[i] = zigzag_encode(static_cast<int8_t>(v - prev));
+		prev = v;
+	}
+}
+
+void decode_delta_8(Span<const uint8_t> src, Span<uint8_t> dst) {
+	uint8_t prev = 0;
+	for (size_t i = 0; i < dst.size(); ++i) {
+		prev += static_cast<uint8_t>(zigzag_decode(src[i]));
+		dst[i] = prev;
+	}
+}
+
+void encode_delta_16(Span<const uint8_t> src, Span<uint8_t> dst) {
+	const size_t count = src.size() / sizeof(uint16_t);
+	uint8_t *low_bytes = dst.data();
+	uint8_t *high_bytes = dst.data() + count;
+	uint16_t prev = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const uint16_t v = load_value<uint16_t>(src.data(), i);
+		const uint16_t d = zigzag_encode(static_cast<int16_t>(v - prev));
+		low_bytes[i] = d & 0xff;
+		high_bytes[i] = d >> 8;
+		prev = v;
+	}
+}
+
+void decode_delta_16(Span<const uint8_t> src, Span<uint8_t> dst) {
+	const size_t count = dst.size() / sizeof(uint16_t);
+	const uint8_t *low_bytes = src.data();
+	const uint8_t *high_bytes = src.data() + count;
+	uint16_t prev = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const uint16_t d = static_cast<uint16_t>(low_bytes[i]) | (static_cast<uint16_t>(high_bytes[i]) << 8);
+		prev += static_cast<uint16_t>(zigzag_decode(d));
+		store_value<uint16_t>(dst.data(), i, prev);
+	}
+}
+
+template <typename T>
+uint32_t count_runs(Span<const uint8_t> src) {
+	const size_t count = src.size() / sizeof(T);
+	if (count == 0) {
+		return 0;
+	}
+	uint32_t run_count = 1;
+	unsigned int run_length = 1;
+	T prev = load_value<T>(src.data(), 0);
+	for (size_t i = 1; i < count; ++i) {
+		const T v = load_value<T>(src.data(), i);
+		if (v != prev || run_length == RLE_MAX_RUN_LENGTH) {
+			++run_count;
+			run_length = 1;
+			prev = v;
+		} else {
+			++run_length;
+		}
+	}
+	return run_count;
+}
+
+inline size_t get_rle_size_in_bytes(uint32_t run_count, unsigned int value_size) {
+	return RLE_HEADER_SIZE + static_cast<size_t>(run_count) * (sizeof(uint16_t) + value_size);
+}
+
+template <typename T>
+void encode_rle(Span<const uint8_t> src, uint32_t run_count, Span<uint8_t> dst) {
+	const size_t count = src.size() / sizeof(T);
+	ZN_ASSERT(dst.size() == get_rle_size_in_bytes(run_count, sizeof(T)));
+	store_value<uint32_t>(dst.data(), 0, run_count);
+	uint8_t *lengths = dst.data() + RLE_HEADER_SIZE;
+	uint8_t *values = lengths + run_count * sizeof(uint16_t);
+
+	uint32_t run_index = 0;
+	uint16_t run_length = 1;
+	T prev = load_value<T>(src.data(), 0);
+	for (size_t i = 1; i < count; ++i) {
+		const T v = load_value<T>(src.data(), i);
+		if (v != prev || run_length == RLE_MAX_RUN_LENGTH) {
+			store_value<uint16_t>(lengths, run_index, run_length);
+			store_value<T>(values, run_index, prev);
+			++run_index;
+			run_length = 1;
+			prev = v;
+		} else {
+			++run_length;
+		}
+	}
+	store_value<uint16_t>(lengths, run_index, run_length);
+	store_value<T>(values, run_index, prev);
+	ZN_ASSERT(run_index + 1 == run_count);
+}
+
+// Returns how many bytes were read from `src`, or 0 if the data is invalid
+template <typename T>
+size_t decode_rle(Span<const uint8_t> src, Span<uint8_t> dst) {
+	ZN_ASSERT_RETURN_V(src.size() >= RLE_HEADER_SIZE, 0);
+	const uint32_t run_count = load_value<uint32_t>(src.data(), 0);
+	const size_t size_in_bytes = get_rle_size_in_bytes(run_count, sizeof(T));
+	ZN_ASSERT_RETURN_V(size_in_bytes <= src.size(), 0);
+
+	const uint8_t *lengths = src.data() + RLE_HEADER_SIZE;
+	const uint8_t *values = lengths + run_count * sizeof(uint16_t);
+	const size_t count = dst.size() / sizeof(T);
+	T *dst_values = reinterpret_cast<T *>(dst.data());
+
+	size_t i = 0;
+	for (uint32_t run_index = 0; run_index < run_count; ++run_index) {
+		const uint16_t run_length = load_value<uint16_t>(lengths, run_index);
+		ZN_ASSERT_RETURN_V(i + run_length <= count, 0);
+		const T v = load_value<T>(values, run_index);
+		std::fill(dst_values + i, dst_values + i + run_length, v);
+		i += run_length;
+	}
+	ZN_ASSERT_RETURN_V(i == count, 0);
+
+	return size_in_bytes;
+}
+
+struct ChannelEncodingChoice {
+	ChannelEncoding encoding;
+	size_t size_in_bytes;
+	uint32_t run_count;
+};
+
+// Picks how to encode voxels of a channel that isn't uniform
+ChannelEncodingChoice choose_channel_encoding(
+		unsigned int channel_index,
+		VoxelBuffer::Depth depth,
+		Span<const uint8_t> data
+) {
+	ChannelEncodingChoice choice{ CHANNEL_ENCODING_RAW, data.size(), 0 };
+
+	if (depth != VoxelBuffer::DEPTH_8_BIT && depth != VoxelBuffer::DEPTH_16_BIT) {
+		// Bit-packed depths are already small, and larger depths are usually floats
+		return choice;
+	}
+
+	if (channel_index == VoxelBuffer::CHANNEL_SDF) {
+		choice.encoding = CHANNEL_ENCODING_DELTA;
+		return choice;
+	}
+
+	// Other channels like types are usually made of large areas of the same value
+	const unsigned int value_size = VoxelBuffer::get_depth_byte_count(depth);
+	const uint32_t run_count =
+			depth == VoxelBuffer::DEPTH_8_BIT ? count_runs<uint8_t>(data) : count_runs<uint16_t>(data);
+	const size_t rle_size = get_rle_size_in_bytes(run_count, value_size);
+	if (rle_size < data.size()) {
+		choice.encoding = CHANNEL_ENCODING_RLE;
+		choice.size_in_bytes = rle_size;
+		choice.run_count = run_count;
+	}
+
+	return choice;
+}
+
+void encode_channel(
+		const ChannelEncodingChoice &choice,
+		VoxelBuffer::Depth depth,
+		Span<const uint8_t> src,
+		Span<uint8_t> dst
+) {
+	ZN_ASSERT(dst.size() == choice.size_in_bytes);
+	switch (choice.encoding) {
+		case CHANNEL_ENCODING_RAW:
+			memcpy(dst.data(), src.data(), src.size());
+			break;
+		case CHANNEL_ENCODING_DELTA:
+			if (depth == VoxelBuffer::DEPTH_8_BIT) {
+				encode_delta_8(src, dst);
+			} else {
+				encode_delta_16(src, dst);
+			}
+			break;
+		case CHANNEL_ENCODING_RLE:
+			if (depth == VoxelBuffer::DEPTH_8_BIT) {
+				encode_rle<uint8_t>(src, choice.run_count, dst);
+			} else {
+				encode_rle<uint16_t>(src, choice.run_count, dst);
+			}
+			break;
+		default:
+			ZN_CRASH_MSG("Unhandled channel encoding");
+	}
+}
+
+// Decodes voxels directly into the channel. Returns how many bytes were read from `src`, or 0 if it failed.
+size_t decode_channel(ChannelEncoding encoding, VoxelBuffer::Depth depth, Span<const uint8_t> src, Span<uint8_t> dst) {
+	switch (encoding) {
+		case CHANNEL_ENCODING_RAW:
+			ZN_ASSERT_RETURN_V_MSG(src.size() >= dst.size(), 0, "Unexpected end of data");
+			memcpy(dst.data(), src.data(), dst.size());
+			return dst.size();
+
+		case CHANNEL_ENCODING_DELTA:
+			ZN_ASSERT_RETURN_V_MSG(src.size() >= dst.size(), 0, "Unexpected end of data");
+			if (depth == VoxelBuffer::DEPTH_8_BIT) {
+				decode_delta_8(src, dst);
+			} else if (depth == VoxelBuffer::DEPTH_16_BIT) {
+				decode_delta_16(src, dst);
+			} else {
+				ZN_PRINT_ERROR("Delta encoding is only supported with 8-bit and 16-bit depths");
+				return 0;
+			}
+			return dst.size();
+
+		case CHANNEL_ENCODING_RLE:
+			if (depth == VoxelBuffer::DEPTH_8_BIT) {
+				return decode_rle<uint8_t>(src, dst);
+			} else if (depth == VoxelBuffer::DEPTH_16_BIT) {
+				return decode_rle<uint16_t>(src, dst);
+			}
+			ZN_PRINT_ERROR("Run-length encoding is only supported with 8-bit and 16-bit depths");
+			return 0;
+
+		default:
+			ZN_PRINT_ERROR("Unhandled channel encoding");
+			return 0;
+	}
+}
+
+StdVector<uint8_t> &get_tls_channel_tmp() {
+	thread_local StdVector<uint8_t> tls_channel_tmp;
+	return tls_channel_tmp;
+}
+
+StdVector<uint8_t> &get_tls_narrowed_channel_tmp() {
+	thread_local StdVector<uint8_t> tls_narrowed_channel_tmp;
+	return tls_narrowed_channel_tmp;
+}
+
+// Tells if all 16-bit values fit in 8 bits. Values are combined without branching so the compiler can vectorize it,
+// which matters because every non-uniform channel of every saved block goes through it.
+bool fits_in_8_bits(Span<const uint8_t> src) {
+	const size_t count = src.size() / sizeof(uint16_t);
+	uint16_t combined = 0;
+	for (size_t i = 0; i < count; ++i) {
+		combined |= load_value<uint16_t>(src.data(), i);
+	}
+	return combined <= std::numeric_limits<uint8_t>::max();
+}
+
+void narrow_16_to_8(Span<const uint8_t> src, Span<uint8_t> dst) {
+	for (size_t i = 0; i < dst.size(); ++i) {
+		dst[i] = static_cast<uint8_t>(load_value<uint16_t>(src.data(), i));
+	}
+}
+
+void widen_8_to_16(Span<const uint8_t> src, Span<uint8_t> dst) {
+	const size_t count = dst.size() / sizeof(uint16_t);
+	for (size_t i = 0; i < count; ++i) {
+		store_value<uint16_t>(dst.data(), i, src[i]);
+	}
+}
+
+// Channels that can be stored with 8-bit values. SDF is excluded because its 16-bit values are a fixed-point
+// representation, which almost never fits in 8 bits anyways.
+bool can_narrow_channel(unsigned int channel_index, VoxelBuffer::Depth depth) {
+	return depth == VoxelBuffer::DEPTH_16_BIT && channel_index != VoxelBuffer::CHANNEL_SDF;
+}
+
+} // namespace
+
+// Channels may be smaller once encoded, so this is an upper bound
+size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t metadata_size) {
 	// Version and size
 	size_t size = 1 * sizeof(uint8_t) + 3 * sizeof(uint16_t);
 
@@ -262,12 +821,15 @@ size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
 		size += 1;
 
 		switch (compression) {
-			case VoxelBuffer::COMPRESSION_NONE: {
+			case VoxelBuffer::COMPRESSION_NONE:
+			// Palettes are expanded
+			case VoxelBuffer::COMPRESSION_PALETTE: {
 				size += VoxelBuffer::get_size_in_bytes_for_volume(size_in_voxels, depth);
 			} break;
 
 			case VoxelBuffer::COMPRESSION_UNIFORM: {
-				size += VoxelBuffer::get_depth_bit_count(depth) >> 3;
+				// Bit-packed depths still use a whole byte
+				size += math::max(VoxelBuffer::get_depth_byte_count(depth), uint32_t(1));
 			} break;
 
 			default:
@@ -276,8 +838,6 @@ size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
 		}
 	}
 
-	metadata_size = get_metadata_size_in_bytes(buffer);
-
 	size_t metadata_size_with_header = 0;
 	if (metadata_size > 0) {
 		metadata_size_with_header = metadata_size + BLOCK_METADATA_HEADER_SIZE;
@@ -286,7 +846,7 @@ size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
 	return size + metadata_size_with_header + BLOCK_TRAILING_MAGIC_SIZE;
 }
 
-SerializeResult serialize(const VoxelBuffer &voxel_buffer) {
+SerializeResult serialize(const VoxelBuffer &voxel_buffer, bool narrow_channels) {
 	ZN_PROFILE_SCOPE();
 
 	StdVector<uint8_t> &dst_data = get_tls_data();
@@ -297,8 +857,11 @@ SerializeResult serialize(const VoxelBuffer &voxel_buffer) {
 	// Cannot serialize an empty block
 	ERR_FAIL_COND_V(Vector3iUtil::get_volume_u64(voxel_buffer.get_size()) == 0, SerializeResult(dst_data, false));
 
-	size_t expected_metadata_size = 0;
-	const size_t expected_data_size = get_size_in_bytes(voxel_buffer, expected_metadata_size);
+	// Metadata has more reasons to fail, so its section is built first. If a recoverable error occurs, the concerned
+	// entries are discarded.
+	serialize_packed_metadata(voxel_buffer, metadata_tmp);
+
+	size_t expected_data_size = get_size_in_bytes(voxel_buffer, metadata_tmp.size());
 	dst_data.reserve(expected_data_size);
 
 	MemoryWriter f(dst_data, ENDIANNESS_LITTLE_ENDIAN);
@@ -323,53 +886,77 @@ SerializeResult serialize(const VoxelBuffer &voxel_buffer) {
 	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
 		const VoxelBuffer::Compression compression = voxel_buffer.get_channel_compression(channel_index);
 		const VoxelBuffer::Depth depth = voxel_buffer.get_channel_depth(channel_index);
-		// Low nibble: compression (up to 16 values allowed)
-		// High nibble: depth (up to 16 values allowed)
-		const uint8_t fmt = static_cast<uint8_t>(compression) | (static_cast<uint8_t>(depth) << 4);
-		f.store_8(fmt);
 
-		switch (compression) {
-			case VoxelBuffer::COMPRESSION_NONE: {
-				Span<const uint8_t> data;
-				ERR_FAIL_COND_V(
-						!voxel_buffer.get_channel_as_bytes_read_only(channel_index, data),
-						SerializeResult(dst_data, false)
-				);
-				f.store_buffer(data);
-			} break;
+		if (compression == VoxelBuffer::COMPRESSION_UNIFORM) {
+			// Lowest 3 bits: encoding (up to 8 values allowed)
+			// 4th bit: narrowed flag, never set on uniform channels
+			// High nibble: depth (up to 16 values allowed)
+			f.store_8(static_cast<uint8_t>(CHANNEL_ENCODING_UNIFORM) | (static_cast<uint8_t>(depth) << 4));
+
+			const uint64_t v = voxel_buffer.get_voxel(Vector3i(), channel_index);
+			switch (depth) {
+				case VoxelBuffer::DEPTH_8_BIT:
+				case VoxelBuffer::DEPTH_1_BIT:
+				case VoxelBuffer::DEPTH_2_BIT:
+				case VoxelBuffer::DEPTH_4_BIT:
+					f.store_8(v);
+					break;
+				case VoxelBuffer::DEPTH_16_BIT:
+					f.store_16(v);
+					break;
+				case VoxelBuffer::DEPTH_32_BIT:
+					f.store_32(v);
+					break;
+				case VoxelBuffer::DEPTH_64_BIT:
+					f.store_64(v);
+					break;
+				default:
+					CRASH_NOW();
+			}
+			continue;
+		}
 
-			case VoxelBuffer::COMPRESSION_UNIFORM: {
-				const uint64_t v = voxel_buffer.get_voxel(Vector3i(), channel_index);
-				switch (depth) {
-					case VoxelBuffer::DEPTH_8_BIT:
-						f.store_8(v);
-						break;
-					case VoxelBuffer::DEPTH_16_BIT:
-						f.store_16(v);
-						break;
-					case VoxelBuffer::DEPTH_32_BIT:
-						f.store_32(v);
-						break;
-					case VoxelBuffer::DEPTH_64_BIT:
-						f.store_64(v);
-						break;
-					default:
-						CRASH_NOW();
-				}
-			} break;
+		Span<const uint8_t> data;
+		if (compression == VoxelBuffer::COMPRESSION_PALETTE) {
+			// Palettes are an in-memory format only, they are expanded and encoded like other channels.
+			StdVector<uint8_t> &channel_tmp = get_tls_channel_tmp();
+			channel_tmp.resize(VoxelBuffer::get_size_in_bytes_for_volume(voxel_buffer.get_size(), depth));
+			ERR_FAIL_COND_V(
+					!voxel_buffer.get_channel_decompressed(channel_index, to_span(channel_tmp)),
+					SerializeResult(dst_data, false)
+			);
+			data = to_span_const(channel_tmp);
+		} else {
+			ERR_FAIL_COND_V(
+					!voxel_buffer.get_channel_as_bytes_read_only(channel_index, data), SerializeResult(dst_data, false)
+			);
+		}
 
-			default:
-				CRASH_COND("Unhandled compression mode");
+		const size_t data_size = data.size();
+		uint8_t encoding_flags = 0;
+		VoxelBuffer::Depth encoded_depth = depth;
+
+		if (narrow_channels && can_narrow_channel(channel_index, depth) && fits_in_8_bits(data)) {
+			// The channel keeps its depth when loaded, only its stored values are smaller
+			StdVector<uint8_t> &narrowed_channel_tmp = get_tls_narrowed_channel_tmp();
+			narrowed_channel_tmp.resize(data.size() / sizeof(uint16_t));
+			narrow_16_to_8(data, to_span(narrowed_channel_tmp));
+			data = to_span_const(narrowed_channel_tmp);
+			encoding_flags = CHANNEL_ENCODING_NARROWED_FLAG;
+			encoded_depth = VoxelBuffer::DEPTH_8_BIT;
 		}
+
+		const ChannelEncodingChoice choice = choose_channel_encoding(channel_index, encoded_depth, data);
+		expected_data_size -= data_size - choice.size_in_bytes;
+
+		f.store_8(static_cast<uint8_t>(choice.encoding) | encoding_flags | (static_cast<uint8_t>(depth) << 4));
+		const size_t begin = dst_data.size();
+		dst_data.resize(begin + choice.size_in_bytes);
+		encode_channel(choice, encoded_depth, data, to_span(dst_data).sub(begin, choice.size_in_bytes));
 	}
 
-	// Metadata has more reasons to fail. If a recoverable error occurs prior to serializing,
-	// we just discard all metadata as if it was empty.
-	if (expected_metadata_size > 0) {
-		f.store_32(expected_metadata_size);
-		metadata_tmp.resize(expected_metadata_size);
-		// This function brings me joy. </irony>
-		serialize_metadata(to_span(metadata_tmp), voxel_buffer);
+	if (metadata_tmp.size() > 0) {
+		f.store_32(metadata_tmp.size());
 		f.store_buffer(to_span(metadata_tmp));
 	}
 
@@ -593,6 +1180,7 @@ bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 	MemoryReader f(p_data, ENDIANNESS_LITTLE_ENDIAN);
 
 	const uint8_t format_version = f.get_8();
+	bool legacy_metadata = false;
 
 	switch (format_version) {
 		case 2: {
@@ -607,6 +1195,17 @@ bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 			return deserialize(to_span(migrated_data), out_voxel_buffer);
 		} break;
 
+		case 4:
+			// Same layout, only channel encodings were extended in version 5
+		case 5:
+			// Same layout, only the metadata section changed in version 6
+			legacy_metadata = true;
+			break;
+
+		case 6:
+			// Same layout, only narrowed channels were added in version 7
+			break;
+
 		default:
 			ERR_FAIL_COND_V(format_version != BLOCK_FORMAT_VERSION, false);
 	}
@@ -619,10 +1218,11 @@ bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 
 	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
 		const uint8_t fmt = f.get_8();
-		const uint8_t compression_value = fmt & 0xf;
+		const bool narrowed = (fmt & CHANNEL_ENCODING_NARROWED_FLAG) != 0;
+		const uint8_t encoding_value = fmt & 0x7;
 		const uint8_t depth_value = (fmt >> 4) & 0xf;
 		ERR_FAIL_COND_V_MSG(
-				compression_value >= VoxelBuffer::COMPRESSION_COUNT,
+				encoding_value >= CHANNEL_ENCODING_COUNT,
 				false,
 				"At offset 0x" + String::num_int64(f.get_position() - 1, 16)
 		);
@@ -631,53 +1231,68 @@ bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 				false,
 				"At offset 0x" + String::num_int64(f.get_position() - 1, 16)
 		);
-		VoxelBuffer::Compression compression = (VoxelBuffer::Compression)compression_value;
-		VoxelBuffer::Depth depth = (VoxelBuffer::Depth)depth_value;
+		const ChannelEncoding encoding = static_cast<ChannelEncoding>(encoding_value);
+		const VoxelBuffer::Depth depth = static_cast<VoxelBuffer::Depth>(depth_value);
+		// Before version 7 that bit was part of the encoding, and no valid encoding used it
+		ERR_FAIL_COND_V_MSG(
+				narrowed && format_version < 7,
+				false,
+				"At offset 0x" + String::num_int64(f.get_position() - 1, 16)
+		);
+		ERR_FAIL_COND_V_MSG(
+				narrowed && (depth != VoxelBuffer::DEPTH_16_BIT || encoding == CHANNEL_ENCODING_UNIFORM),
+				false,
+				"At offset 0x" + String::num_int64(f.get_position() - 1, 16)
+		);
 
 		out_voxel_buffer.set_channel_depth(channel_index, depth);
 
-		switch (compression) {
-			case VoxelBuffer::COMPRESSION_NONE: {
-				out_voxel_buffer.decompress_channel(channel_index);
-
-				Span<uint8_t> buffer;
-				CRASH_COND(!out_voxel_buffer.get_channel_as_bytes(channel_index, buffer));
-
-				const size_t read_len = f.get_buffer(buffer);
-				if (read_len != buffer.size()) {
-					ERR_PRINT("Unexpected end of file");
-					return false;
-				}
+		if (encoding == CHANNEL_ENCODING_UNIFORM) {
+			uint64_t v;
+			switch (depth) {
+				case VoxelBuffer::DEPTH_8_BIT:
+				case VoxelBuffer::DEPTH_1_BIT:
+				case VoxelBuffer::DEPTH_2_BIT:
+				case VoxelBuffer::DEPTH_4_BIT:
+					v = f.get_8();
+					break;
+				case VoxelBuffer::DEPTH_16_BIT:
+					v = f.get_16();
+					break;
+				case VoxelBuffer::DEPTH_32_BIT:
+					v = f.get_32();
+					break;
+				case VoxelBuffer::DEPTH_64_BIT:
+					v = f.get_64();
+					break;
+				default:
+					// Fix uninitialized variable warning on Clang, even though it is not supposed to carry on after
+					// the switch
+					v = 0;
+					CRASH_NOW();
+			}
+			out_voxel_buffer.clear_channel(channel_index, v);
 
-			} break;
+		} else {
+			out_voxel_buffer.decompress_channel(channel_index);
 
-			case VoxelBuffer::COMPRESSION_UNIFORM: {
-				uint64_t v;
-				switch (out_voxel_buffer.get_channel_depth(channel_index)) {
-					case VoxelBuffer::DEPTH_8_BIT:
-						v = f.get_8();
-						break;
-					case VoxelBuffer::DEPTH_16_BIT:
-						v = f.get_16();
-						break;
-					case VoxelBuffer::DEPTH_32_BIT:
-						v = f.get_32();
-						break;
-					case VoxelBuffer::DEPTH_64_BIT:
-						v = f.get_64();
-						break;
-					default:
-						// Fix uninitialized variable warning on Clang, even though it is not supposed to carry on after
-						// the switch
-						v = 0;
-						CRASH_NOW();
-				}
-				out_voxel_buffer.clear_channel(channel_index, v);
-			} break;
+			Span<uint8_t> buffer;
+			CRASH_COND(!out_voxel_buffer.get_channel_as_bytes(channel_index, buffer));
 
-			default:
-				ERR_PRINT("Unhandled compression mode");
-				return false;
+			size_t read_size;
+			if (narrowed) {
+				StdVector<uint8_t> &narrowed_channel_tmp = get_tls_narrowed_channel_tmp();
+				narrowed_channel_tmp.resize(buffer.size() / sizeof(uint16_t));
+				read_size = decode_channel(
+						encoding, VoxelBuffer::DEPTH_8_BIT, f.data.sub(f.pos), to_span(narrowed_channel_tmp)
+				);
+				widen_8_to_16(to_span_const(narrowed_channel_tmp), buffer);
+			} else {
+				// Decoded straight into the channel, without a temporary buffer
+				read_size = decode_channel(encoding, depth, f.data.sub(f.pos), buffer);
+			}
+			ERR_FAIL_COND_V_MSG(read_size == 0, false, "At offset 0x" + String::num_int64(f.get_position(), 16));
+			f.pos += read_size;
 		}
 	}
 
@@ -686,7 +1301,11 @@ bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 		ERR_FAIL_COND_V(f.get_position() + metadata_size > p_data.size(), false);
 		metadata_tmp.resize(metadata_size);
 		f.get_buffer(to_span(metadata_tmp));
-		deserialize_metadata(to_span(metadata_tmp), out_voxel_buffer);
+		if (legacy_metadata) {
+			deserialize_metadata_legacy(to_span(metadata_tmp), out_voxel_buffer);
+		} else {
+			deserialize_packed_metadata(to_span(metadata_tmp), out_voxel_buffer);
+		}
 	}
 
 	// Failure at this indicates file corruption
@@ -696,17 +1315,53 @@ bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 	return true;
 }
 
+namespace {
+
+// Blocks with only uniform channels serialize to a handful of bytes, unless they have metadata
+const size_t UNCOMPRESSED_BLOCK_MAX_SIZE = 128;
+
+bool is_stored_uncompressed(const VoxelBuffer &voxel_buffer, size_t serialized_size) {
+	if (serialized_size > UNCOMPRESSED_BLOCK_MAX_SIZE) {
+		return false;
+	}
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		if (voxel_buffer.get_channel_compression(channel_index) != VoxelBuffer::COMPRESSION_UNIFORM) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
 SerializeResult serialize_and_compress(const VoxelBuffer &voxel_buffer) {
+	return serialize_and_compress(voxel_buffer, CompressedData::CompressionParams());
+}
+
+SerializeResult serialize_and_compress(
+		const VoxelBuffer &voxel_buffer,
+		const CompressedData::CompressionParams &compression_params
+) {
 	ZN_PROFILE_SCOPE();
 
 	StdVector<uint8_t> &compressed_data = get_tls_compressed_data();
 
-	SerializeResult res = serialize(voxel_buffer);
+	SerializeResult res = serialize(voxel_buffer, true);
 	ERR_FAIL_COND_V(!res.success, SerializeResult(compressed_data, false));
 	const StdVector<uint8_t> &data = res.data;
 
+	if (is_stored_uncompressed(voxel_buffer, data.size())) {
+		// Only a few bytes of uniform values, running LZ4 or Zstd on them both ways would cost more than it saves.
+		// The per-channel format bytes in the header are enough to load such blocks straight into uniform channels.
+		CompressedData::CompressionParams raw_params;
+		raw_params.compression = CompressedData::COMPRESSION_NONE;
+		res.success = CompressedData::compress(to_span(data), compressed_data, raw_params);
+		ERR_FAIL_COND_V(!res.success, SerializeResult(compressed_data, false));
+		return SerializeResult(compressed_data, true);
+	}
+
 	res.success = CompressedData::compress(
-			Span<const uint8_t>(data.data(), 0, data.size()), compressed_data, CompressedData::COMPRESSION_LZ4
+			Span<const uint8_t>(data.data(), 0, data.size()), compressed_data, compression_params
 	);
 	ERR_FAIL_COND_V(!res.success, SerializeResult(compressed_data, false));
 
@@ -714,17 +1369,39 @@ SerializeResult serialize_and_compress(const VoxelBuffer &voxel_buffer) {
 }
 
 bool decompress_and_deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
+	return decompress_and_deserialize(p_data, out_voxel_buffer, Span<const std::shared_ptr<ZstdDictionary>>());
+}
+
+bool decompress_and_deserialize(
+		Span<const uint8_t> p_data,
+		VoxelBuffer &out_voxel_buffer,
+		Span<const std::shared_ptr<ZstdDictionary>> zstd_dictionaries
+) {
 	ZN_PROFILE_SCOPE();
 
+	if (p_data.size() > 0 && p_data[0] == CompressedData::COMPRESSION_NONE) {
+		// Fast path, mostly taken by uniform blocks: no need to copy into a temporary buffer first
+		return deserialize(p_data.sub(1), out_voxel_buffer);
+	}
+
 	StdVector<uint8_t> &data = get_tls_data();
 
-	const bool res = CompressedData::decompress(p_data, data);
+	const bool res = CompressedData::decompress(p_data, data, zstd_dictionaries);
 	ERR_FAIL_COND_V(!res, false);
 
 	return deserialize(to_span_const(data), out_voxel_buffer);
 }
 
 bool decompress_and_deserialize(FileAccess &f, unsigned int size_to_read, VoxelBuffer &out_voxel_buffer) {
+	return decompress_and_deserialize(f, size_to_read, out_voxel_buffer, Span<const std::shared_ptr<ZstdDictionary>>());
+}
+
+bool decompress_and_deserialize(
+		FileAccess &f,
+		unsigned int size_to_read,
+		VoxelBuffer &out_voxel_buffer,
+		Span<const std::shared_ptr<ZstdDictionary>> zstd_dictionaries
+) {
 	ZN_PROFILE_SCOPE();
 
 #if defined(TOOLS_ENABLED) || defined(DEBUG_ENABLED)
@@ -739,7 +1416,7 @@ bool decompress_and_deserialize(FileAccess &f, unsigned int size_to_read, VoxelB
 	const unsigned int read_size = zylann::godot::get_buffer(f, to_span(compressed_data));
 	ERR_FAIL_COND_V(read_size != size_to_read, false);
 
-	return decompress_and_deserialize(to_span(compressed_data), out_voxel_buffer);
+	return decompress_and_deserialize(to_span(compressed_data), out_voxel_buffer, zstd_dictionaries);
 }
 
 } // namespace BlockSerializer
@@ -4,6 +4,7 @@
 #include "../util/containers/span.h"
 #include "../util/containers/std_vector.h"
 #include "../util/godot/macros.h"
+#include "compressed_data.h"
 
 #include <cstdint>
 
@@ -19,7 +20,7 @@ class VoxelBuffer;
 namespace BlockSerializer {
 
 // Latest version, used when serializing
-static const uint8_t BLOCK_FORMAT_VERSION = 4;
+static const uint8_t BLOCK_FORMAT_VERSION = 7;
 
 struct SerializeResult {
 	// The lifetime of the pointed object is only valid in the calling thread,
@@ -31,13 +32,37 @@ struct SerializeResult {
 	inline SerializeResult(const StdVector<uint8_t> &p_data, bool p_success) : data(p_data), success(p_success) {}
 };
 
-SerializeResult serialize(const VoxelBuffer &voxel_buffer);
+// When `narrow_channels` is true, 16-bit channels (other than SDF) whose values all fit in 8 bits are stored as 8-bit
+// values. They are widened back to 16 bits when deserialized, so this only makes serialized blocks smaller.
+SerializeResult serialize(const VoxelBuffer &voxel_buffer, bool narrow_channels = true);
 bool deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer);
 
+using CompressedData::ZstdDictionary;
+
+// Uses LZ4 compression by default. Blocks made only of uniform channels are small enough to be stored without
+// compression, which also lets them be deserialized without going through a temporary buffer.
 SerializeResult serialize_and_compress(const VoxelBuffer &voxel_buffer);
+SerializeResult serialize_and_compress(
+		const VoxelBuffer &voxel_buffer,
+		const CompressedData::CompressionParams &compression_params
+);
+
 bool decompress_and_deserialize(Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer);
 bool decompress_and_deserialize(FileAccess &f, unsigned int size_to_read, VoxelBuffer &out_voxel_buffer);
 
+// Blocks compressed with a Zstd dictionary need that dictionary to be in `zstd_dictionaries`.
+bool decompress_and_deserialize(
+		Span<const uint8_t> p_data,
+		VoxelBuffer &out_voxel_buffer,
+		Span<const std::shared_ptr<ZstdDictionary>> zstd_dictionaries
+);
+bool decompress_and_deserialize(
+		FileAccess &f,
+		unsigned int size_to_read,
+		VoxelBuffer &out_voxel_buffer,
+		Span<const std::shared_ptr<ZstdDictionary>> zstd_dictionaries
+);
+
 // Temporary thread-local buffers for internal use
 StdVector<uint8_t> &get_tls_data();
 StdVector<uint8_t> &get_tls_compressed_data();
@@ -31,6 +31,41 @@ void VoxelStream::save_voxel_blocks(Span<VoxelQueryData> p_blocks) {
 	}
 }
 
+bool VoxelStream::supports_encoded_voxel_blocks() const {
+	// Can be implemented in subclasses
+	return false;
+}
+
+bool VoxelStream::encode_voxel_block(const VoxelBuffer &voxels, StdVector<uint8_t> &out_data) const {
+	ZN_PRINT_ERROR(format("{} does not support `encode_voxel_block`", get_class()));
+	return false;
+}
+
+bool VoxelStream::decode_voxel_block(Span<const uint8_t> data, VoxelBuffer &out_voxels) const {
+	ZN_PRINT_ERROR(format("{} does not support `decode_voxel_block`", get_class()));
+	return false;
+}
+
+void VoxelStream::load_encoded_voxel_blocks(Span<EncodedVoxelQueryData> p_blocks) {
+	ZN_PRINT_ERROR(format("{} does not support `load_encoded_voxel_blocks`", get_class()));
+	for (EncodedVoxelQueryData &q : p_blocks) {
+		q.result = RESULT_ERROR;
+	}
+}
+
+void VoxelStream::save_encoded_voxel_blocks(Span<EncodedVoxelQueryData> p_blocks) {
+	ZN_PRINT_ERROR(format("{} does not support `save_encoded_voxel_blocks`", get_class()));
+}
+
+bool VoxelStream::supports_deleting_voxel_blocks() const {
+	// Can be implemented in subclasses
+	return false;
+}
+
+void VoxelStream::delete_voxel_block(Vector3i position_in_blocks, uint8_t lod_index) {
+	ZN_PRINT_ERROR(format("{} does not support `delete_voxel_block`", get_class()));
+}
+
 bool VoxelStream::supports_instance_blocks() const {
 	// Can be implemented in subclasses
 	return false;
@@ -51,6 +86,15 @@ void VoxelStream::load_all_blocks(FullLoadingResult &result) {
 	ZN_PRINT_ERROR(format("{} does not support `load_all_blocks`", get_class()));
 }
 
+bool VoxelStream::get_load_all_blocks_parts(unsigned int max_count, StdVector<FullLoadingPart> &out_parts) {
+	// Can be implemented in subclasses
+	return false;
+}
+
+void VoxelStream::load_all_blocks_part(const FullLoadingPart &part, FullLoadingResult &result) {
+	ZN_PRINT_ERROR(format("{} does not support `load_all_blocks_part`", get_class()));
+}
+
 int VoxelStream::get_used_channels_mask() const {
 	return 0;
 }
@@ -65,6 +109,16 @@ bool VoxelStream::get_save_generator_output() const {
 	return _parameters.save_generator_output;
 }
 
+void VoxelStream::set_unchanged_block_removal_enabled(bool enabled) {
+	RWLockWrite wlock(_parameters_lock);
+	_parameters.unchanged_block_removal_enabled = enabled;
+}
+
+bool VoxelStream::is_unchanged_block_removal_enabled() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.unchanged_block_removal_enabled;
+}
+
 int VoxelStream::get_block_size_po2() const {
 	return constants::DEFAULT_BLOCK_SIZE_PO2;
 }
@@ -127,6 +181,14 @@ void VoxelStream::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_save_generator_output", "enabled"), &VoxelStream::set_save_generator_output);
 	ClassDB::bind_method(D_METHOD("get_save_generator_output"), &VoxelStream::get_save_generator_output);
 
+	ClassDB::bind_method(
+			D_METHOD("set_unchanged_block_removal_enabled", "enabled"),
+			&VoxelStream::set_unchanged_block_removal_enabled
+	);
+	ClassDB::bind_method(
+			D_METHOD("is_unchanged_block_removal_enabled"), &VoxelStream::is_unchanged_block_removal_enabled
+	);
+
 	ClassDB::bind_method(D_METHOD("get_block_size"), &VoxelStream::_b_get_block_size);
 
 	ClassDB::bind_method(D_METHOD("flush"), &VoxelStream::flush);
@@ -136,6 +198,11 @@ void VoxelStream::_bind_methods() {
 			"set_save_generator_output",
 			"get_save_generator_output"
 	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "unchanged_block_removal_enabled"),
+			"set_unchanged_block_removal_enabled",
+			"is_unchanged_block_removal_enabled"
+	);
 
 	BIND_ENUM_CONSTANT(RESULT_ERROR);
 	BIND_ENUM_CONSTANT(RESULT_BLOCK_FOUND);
@@ -81,6 +81,38 @@ public:
 	// This function is recommended if you save to files, because you can batch their access.
 	virtual void save_voxel_blocks(Span<VoxelQueryData> p_blocks);
 
+	// Optional split of loading and saving into two steps: encoding voxels into bytes, which is CPU-heavy (compression
+	// for example), and moving these bytes from or to storage. When supported, the engine encodes and decodes in
+	// general-purpose threads, so I/O threads only have to move bytes.
+	virtual bool supports_encoded_voxel_blocks() const;
+
+	// Must be thread-safe and must not access storage, they can run in parallel with each other and with I/O.
+	virtual bool encode_voxel_block(const VoxelBuffer &voxels, StdVector<uint8_t> &out_data) const;
+	virtual bool decode_voxel_block(Span<const uint8_t> data, VoxelBuffer &out_voxels) const;
+
+	struct EncodedVoxelQueryData {
+		// Bytes obtained from `encode_voxel_block`. Streams may take ownership by swapping them.
+		StdVector<uint8_t> &data;
+		// Only used in load queries, null in save queries. If the stream has the block in decoded form already (in a
+		// cache for example), it may fill this buffer directly and leave `data` empty.
+		VoxelBuffer *voxel_buffer;
+		Vector3i position_in_blocks;
+		uint8_t lod_index;
+		ResultCode result;
+	};
+
+	// Same as `load_voxel_blocks`, but found blocks are returned encoded.
+	virtual void load_encoded_voxel_blocks(Span<EncodedVoxelQueryData> p_blocks);
+
+	// Same as `save_voxel_blocks`, with blocks encoded beforehand.
+	virtual void save_encoded_voxel_blocks(Span<EncodedVoxelQueryData> p_blocks);
+
+	// Tells if `delete_voxel_block` is implemented.
+	virtual bool supports_deleting_voxel_blocks() const;
+
+	// Removes voxels previously saved at the given position, so loading them will give `RESULT_BLOCK_NOT_FOUND`.
+	virtual void delete_voxel_block(Vector3i position_in_blocks, uint8_t lod_index);
+
 	// TODO Merge support functions into a single getter with Feature bitmask
 	virtual bool supports_instance_blocks() const;
 
@@ -104,6 +136,20 @@ public:
 
 	virtual void load_all_blocks(FullLoadingResult &result);
 
+	// Range of the stream's contents that can be loaded independently. Its contents only have meaning to the stream.
+	struct FullLoadingPart {
+		int64_t begin;
+		int64_t end;
+	};
+
+	// Optional alternative to `load_all_blocks`, splitting the process so it can use multiple threads. Fills
+	// `out_parts` with up to `max_count` parts, each of which can then be loaded with `load_all_blocks_part`, possibly
+	// at the same time from different threads. Returns false if not supported. Parts don't remain valid if the stream
+	// gets modified or reconfigured in the meantime.
+	virtual bool get_load_all_blocks_parts(unsigned int max_count, StdVector<FullLoadingPart> &out_parts);
+
+	virtual void load_all_blocks_part(const FullLoadingPart &part, FullLoadingResult &result);
+
 	// Tells which channels can be found in this stream.
 	// The simplest implementation is to return them all.
 	// One reason to specify which channels are available is to help the editor detect configuration issues,
@@ -126,6 +172,12 @@ public:
 	void set_save_generator_output(bool enabled);
 	bool get_save_generator_output() const;
 
+	// When blocks are saved, compare them with what the generator would produce. If they are identical, they are
+	// deleted from the stream instead of being written, since they will be generated again when loading.
+	// Only used if generator output is not saved and if the stream supports deleting blocks.
+	void set_unchanged_block_removal_enabled(bool enabled);
+	bool is_unchanged_block_removal_enabled() const;
+
 	// If the stream doesn't immediately write data to the filesystem (using a cache to batch I/Os for example), forces
 	// all pending data to be written.
 	// This should not be called frequently if performance is a concern, as it would require much more file I/Os. May be
@@ -144,6 +196,7 @@ private:
 
 	struct Parameters {
 		bool save_generator_output = false;
+		bool unchanged_block_removal_enabled = false;
 	};
 
 	Parameters _parameters;
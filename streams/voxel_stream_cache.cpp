@@ -1,8 +1,32 @@
 #include "voxel_stream_cache.h"
+#include "../util/containers/std_vector.h"
+#include <algorithm>
 
 namespace zylann::voxel {
 
-bool VoxelStreamCache::load_voxel_block(Vector3i position, uint8_t lod_index, VoxelBuffer &out_voxels) {
+VoxelStreamCache::VoxelsLoadResult VoxelStreamCache::load_voxel_block(
+		Vector3i position,
+		uint8_t lod_index,
+		VoxelBuffer &out_voxels
+) {
+	return load_voxel_block_internal(position, lod_index, out_voxels, nullptr);
+}
+
+VoxelStreamCache::VoxelsLoadResult VoxelStreamCache::load_voxel_block(
+		Vector3i position,
+		uint8_t lod_index,
+		VoxelBuffer &out_voxels,
+		StdVector<uint8_t> &out_encoded_voxels
+) {
+	return load_voxel_block_internal(position, lod_index, out_voxels, &out_encoded_voxels);
+}
+
+VoxelStreamCache::VoxelsLoadResult VoxelStreamCache::load_voxel_block_internal(
+		Vector3i position,
+		uint8_t lod_index,
+		VoxelBuffer &out_voxels,
+		StdVector<uint8_t> *out_encoded_voxels
+) {
 	const Lod &lod = _cache[lod_index];
 
 	RWLockRead rlock(lod.rw_lock);
@@ -11,50 +35,130 @@ bool VoxelStreamCache::load_voxel_block(Vector3i position, uint8_t lod_index, Vo
 
 	if (it == lod.blocks.end()) {
 		// Not in cache, will have to query
-		return false;
+		_cache_stats.add_miss();
+		return VOXELS_NOT_CACHED;
 
 	} else {
 		const Block &block = it->second;
+		if (block.voxels_deleted) {
+			// We know there is nothing to load, no need to query
+			_cache_stats.add_hit();
+			block.last_access.store(_access_time.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return VOXELS_DELETED;
+		}
 		if (!block.has_voxels) {
 			// Has a block in cache but there is no voxel data
-			return false;
+			_cache_stats.add_miss();
+			return VOXELS_NOT_CACHED;
 		}
 		// In cache, serve it
+		_cache_stats.add_hit();
+		block.last_access.store(_access_time.load(std::memory_order_relaxed), std::memory_order_relaxed);
 
+		if (block.encoded_voxels.size() > 0) {
+			ZN_ASSERT_RETURN_V_MSG(
+					out_encoded_voxels != nullptr, VOXELS_NOT_CACHED, "Voxels were saved encoded, can't load them"
+			);
+			*out_encoded_voxels = block.encoded_voxels;
+			return VOXELS_FOUND_ENCODED;
+		}
 
 		// Copying is required since the cache has ownership on its data,
 		// and the requests wants us to populate the buffer it provides
 		block.voxels.copy_to(out_voxels, true);
 
-		return true;
+		return VOXELS_FOUND;
 	}
 }
 
-void VoxelStreamCache::save_voxel_block(Vector3i position, uint8_t lod_index, VoxelBuffer &voxels) {
-	Lod &lod = _cache[lod_index];
-	RWLockWrite wlock(lod.rw_lock);
-	auto it = lod.blocks.find(position);
+VoxelStreamCache::Block &VoxelStreamCache::get_or_create_block_no_lock(
+		StdUnorderedMap<Vector3i, Block> &blocks,
+		Vector3i position,
+		uint8_t lod_index
+) {
+	// Constructed in place, blocks can't be moved
+	auto p = blocks.try_emplace(position);
+	Block &block = p.first->second;
+	if (p.second) {
+		block.position = position;
+		block.lod = lod_index;
+	}
+	return block;
+}
+
+void VoxelStreamCache::set_block_dirty_no_lock(Block &block) {
+	if (!block.is_dirty()) {
+		_dirty_memory_usage += block.memory_usage;
+		++_dirty_block_count;
+	}
+	block.last_access.store(_access_time.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
 
+void VoxelStreamCache::save_voxel_block(Vector3i position, uint8_t lod_index, VoxelBuffer &voxels) {
 	ZN_ASSERT_RETURN_MSG(
 			!Vector3iUtil::is_empty_size(voxels.get_size()), "Saving voxel buffer with empty size is not expected. Bug?"
 	);
 
-	if (it == lod.blocks.end()) {
-		// Not cached yet, create an entry
-		Block b;
-		b.position = position;
-		b.lod = lod_index;
-		// TODO Optimization: if we know the buffer is not shared, we could use move instead
-		voxels.copy_to(b.voxels, true);
-		b.has_voxels = true;
-		lod.blocks.insert(std::make_pair(position, std::move(b)));
-		++_count;
+	Lod &lod = _cache[lod_index];
+	RWLockWrite wlock(lod.rw_lock);
 
-	} else {
+	Block &block = get_or_create_block_no_lock(lod.blocks, position, lod_index);
+	set_block_dirty_no_lock(block);
+	block.voxels_dirty = true;
+	block.voxels_deleted = false;
+	block.encoded_voxels.clear();
+
+	if (block.has_voxels) {
 		// Cached already, overwrite
-		voxels.move_to(it->second.voxels);
-		it->second.has_voxels = true;
+		voxels.move_to(block.voxels);
+	} else {
+		// TODO Optimization: if we know the buffer is not shared, we could use move instead
+		voxels.copy_to(block.voxels, true);
+		block.has_voxels = true;
 	}
+
+	// The block is dirty at this point, so its memory counts as dirty too
+	const size_t memory_usage = block.voxels.get_channels_memory_usage();
+	_memory_usage += static_cast<uint64_t>(memory_usage) - block.memory_usage;
+	_dirty_memory_usage += static_cast<uint64_t>(memory_usage) - block.memory_usage;
+	block.memory_usage = memory_usage;
+}
+
+void VoxelStreamCache::save_encoded_voxel_block(Vector3i position, uint8_t lod_index, StdVector<uint8_t> &data) {
+	ZN_ASSERT_RETURN_MSG(data.size() > 0, "Saving empty encoded voxels is not expected. Bug?");
+
+	Lod &lod = _cache[lod_index];
+	RWLockWrite wlock(lod.rw_lock);
+
+	Block &block = get_or_create_block_no_lock(lod.blocks, position, lod_index);
+	set_block_dirty_no_lock(block);
+	block.voxels_dirty = true;
+	block.voxels_deleted = false;
+	block.has_voxels = true;
+	block.voxels.clear();
+	std::swap(block.encoded_voxels, data);
+
+	const size_t memory_usage = block.encoded_voxels.size();
+	_memory_usage += static_cast<uint64_t>(memory_usage) - block.memory_usage;
+	_dirty_memory_usage += static_cast<uint64_t>(memory_usage) - block.memory_usage;
+	block.memory_usage = memory_usage;
+}
+
+void VoxelStreamCache::delete_voxel_block(Vector3i position, uint8_t lod_index) {
+	Lod &lod = _cache[lod_index];
+	RWLockWrite wlock(lod.rw_lock);
+
+	Block &block = get_or_create_block_no_lock(lod.blocks, position, lod_index);
+	set_block_dirty_no_lock(block);
+	block.voxels_dirty = true;
+	block.voxels_deleted = true;
+	block.has_voxels = false;
+	block.voxels.clear();
+	block.encoded_voxels.clear();
+
+	_memory_usage -= block.memory_usage;
+	_dirty_memory_usage -= block.memory_usage;
+	block.memory_usage = 0;
 }
 
 bool VoxelStreamCache::load_instance_block(
@@ -66,13 +170,16 @@ bool VoxelStreamCache::load_instance_block(
 	lod.rw_lock.read_lock();
 	auto it = lod.blocks.find(position);
 
-	if (it == lod.blocks.end()) {
+	if (it == lod.blocks.end() || !it->second.has_instances) {
 		// Not in cache, will have to query
 		lod.rw_lock.read_unlock();
+		_cache_stats.add_miss();
 		return false;
 
 	} else {
 		// In cache, serve it
+		_cache_stats.add_hit();
+		it->second.last_access.store(_access_time.load(std::memory_order_relaxed), std::memory_order_relaxed);
 
 		if (it->second.instances == nullptr) {
 			out_instances = nullptr;
@@ -95,25 +202,137 @@ void VoxelStreamCache::save_instance_block(
 ) {
 	Lod &lod = _cache[lod_index];
 	RWLockWrite wlock(lod.rw_lock);
-	auto it = lod.blocks.find(position);
 
-	if (it == lod.blocks.end()) {
-		// Not cached yet, create an entry
-		Block b;
-		b.position = position;
-		b.lod = lod_index;
-		b.instances = std::move(instances);
-		lod.blocks.insert(std::make_pair(position, std::move(b)));
-		++_count;
+	Block &block = get_or_create_block_no_lock(lod.blocks, position, lod_index);
+	set_block_dirty_no_lock(block);
+	block.instances_dirty = true;
+	block.has_instances = true;
+	block.instances = std::move(instances);
+}
 
-	} else {
-		// Cached already, overwrite
-		it->second.instances = std::move(instances);
+unsigned int VoxelStreamCache::get_indicative_block_count() const {
+	return _dirty_block_count;
+}
+
+void VoxelStreamCache::set_memory_budget(uint64_t bytes) {
+	_memory_budget = bytes;
+}
+
+uint64_t VoxelStreamCache::get_memory_budget() const {
+	return _memory_budget;
+}
+
+bool VoxelStreamCache::is_flush_needed(
+		unsigned int max_dirty_blocks,
+		uint64_t now_msec,
+		uint64_t max_interval_msec
+) const {
+	const unsigned int dirty_block_count = _dirty_block_count;
+	if (dirty_block_count == 0) {
+		return false;
+	}
+	if (dirty_block_count >= max_dirty_blocks) {
+		return true;
+	}
+	const uint64_t budget = _memory_budget;
+	if (budget == 0) {
+		return false;
+	}
+	// Flushing before dirty blocks take the whole budget, so there is room left for clean ones
+	if (_dirty_memory_usage >= budget / 2) {
+		return true;
 	}
+	return now_msec >= _last_flush_time_msec + max_interval_msec;
 }
 
-unsigned int VoxelStreamCache::get_indicative_block_count() const {
-	return _count;
+bool VoxelStreamCache::is_flush_urgent(unsigned int max_dirty_blocks) const {
+	const uint64_t budget = _memory_budget;
+	return _dirty_block_count >= 4 * max_dirty_blocks || (budget > 0 && _dirty_memory_usage >= budget);
+}
+
+bool VoxelStreamCache::try_begin_flush_request() {
+	bool expected = false;
+	return _flush_requested.compare_exchange_strong(expected, true);
+}
+
+void VoxelStreamCache::end_flush_request() {
+	_flush_requested = false;
+}
+
+VoxelStreamCache::Stats VoxelStreamCache::get_stats() const {
+	Stats stats;
+	const CacheStats::Snapshot cache_stats = _cache_stats.get_snapshot();
+	stats.hits = cache_stats.hits;
+	stats.misses = cache_stats.misses;
+	stats.memory_usage = _memory_usage;
+	stats.dirty_memory_usage = _dirty_memory_usage;
+	stats.dirty_block_count = _dirty_block_count;
+	stats.evicted_block_count = _evicted_block_count;
+	return stats;
+}
+
+Dictionary VoxelStreamCache::Stats::to_dictionary() const {
+	Dictionary d;
+	d["hits"] = hits;
+	d["misses"] = misses;
+	d["memory_usage"] = memory_usage;
+	d["dirty_memory_usage"] = dirty_memory_usage;
+	d["dirty_block_count"] = dirty_block_count;
+	d["evicted_block_count"] = evicted_block_count;
+	return d;
+}
+
+void VoxelStreamCache::evict_clean_blocks() {
+	// Blocks accessed from now on will be considered more recent than all others
+	const uint32_t previous_time = _access_time.fetch_add(1, std::memory_order_relaxed);
+
+	const uint64_t budget = _memory_budget;
+	if (budget == 0 || _memory_usage <= budget) {
+		return;
+	}
+
+	struct EvictionCandidate {
+		Vector3i position;
+		uint32_t lod_index;
+		uint32_t last_access;
+	};
+
+	static thread_local StdVector<EvictionCandidate> tls_candidates;
+	StdVector<EvictionCandidate> &candidates = tls_candidates;
+	candidates.clear();
+
+	for (unsigned int lod_index = 0; lod_index < _cache.size(); ++lod_index) {
+		const Lod &lod = _cache[lod_index];
+		RWLockRead rlock(lod.rw_lock);
+		for (auto it = lod.blocks.begin(); it != lod.blocks.end(); ++it) {
+			const Block &block = it->second;
+			const uint32_t last_access = block.last_access.load(std::memory_order_relaxed);
+			if (!block.is_dirty() && last_access < previous_time) {
+				candidates.push_back(EvictionCandidate{ it->first, lod_index, last_access });
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const EvictionCandidate &a, const EvictionCandidate &b) {
+		return a.last_access < b.last_access;
+	});
+
+	for (const EvictionCandidate &candidate : candidates) {
+		if (_memory_usage <= budget) {
+			break;
+		}
+		Lod &lod = _cache[candidate.lod_index];
+		RWLockWrite wlock(lod.rw_lock);
+		auto it = lod.blocks.find(candidate.position);
+		// The block could have been saved again since we looked it up
+		if (it == lod.blocks.end() || it->second.is_dirty()) {
+			continue;
+		}
+		_memory_usage -= it->second.memory_usage;
+		lod.blocks.erase(it);
+		++_evicted_block_count;
+		_cache_stats.add_evictions(1);
+	}
 }
 
 } // namespace zylann::voxel
@@ -3,14 +3,21 @@
 
 #include "../storage/voxel_buffer.h"
 #include "../util/containers/std_unordered_map.h"
+#include "../util/cache_stats.h"
+#include "../util/containers/std_vector.h"
+#include "../util/godot/core/dictionary.h"
 #include "../util/memory/memory.h"
 #include "../util/thread/rw_lock.h"
 #include "instance_data.h"
+#include <atomic>
 
 namespace zylann::voxel {
 
 // In-memory database for voxel streams.
 // It allows to cache blocks so we can save to the filesystem later less frequently, or quickly reload recent blocks.
+// Saved blocks are "dirty" until flushed. When a memory budget is set, flushed blocks remain in the cache as "clean"
+// blocks, which get evicted starting from the least recently used when the budget is exceeded. Without budget, all
+// blocks are removed when flushing.
 class VoxelStreamCache {
 public:
 	struct Block {
@@ -18,46 +25,146 @@ public:
 		int lod;
 
 		// Absence of voxel data can mean two things:
-		// - Voxel data has been erased (use case not really implemented yet, but may happen in the future)
+		// - Voxel data has been erased (`voxels_deleted` is set)
 		// - Voxel data has never been saved over, so should be left untouched
 		bool has_voxels = false;
 		bool voxels_deleted = false;
+		// Same as `has_voxels`, but for instances. Null instances with this flag set means they were erased.
+		bool has_instances = false;
+
+		// What changed since the last flush
+		bool voxels_dirty = false;
+		bool instances_dirty = false;
 
 		VoxelBuffer voxels;
+		// If not empty, voxels were saved already encoded by the stream, and `voxels` is not used
+		StdVector<uint8_t> encoded_voxels;
 		UniquePtr<InstanceBlockData> instances;
 
+		// Bytes taken by voxels
+		size_t memory_usage = 0;
+		mutable std::atomic_uint32_t last_access = { 0 };
+
+		// Blocks are never moved once in the map, so they can hold atomics
 		Block() : voxels(VoxelBuffer::ALLOCATOR_POOL) {}
+
+		inline bool is_dirty() const {
+			return voxels_dirty || instances_dirty;
+		}
 	};
 
-	// Copies cached block into provided buffer
-	bool load_voxel_block(Vector3i position, uint8_t lod_index, VoxelBuffer &out_voxels);
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t memory_usage = 0;
+		uint64_t dirty_memory_usage = 0;
+		unsigned int dirty_block_count = 0;
+		unsigned int evicted_block_count = 0;
+
+		Dictionary to_dictionary() const;
+	};
+
+	enum VoxelsLoadResult {
+		// The cache doesn't know about these voxels, they have to be queried from the underlying storage
+		VOXELS_NOT_CACHED,
+		// Voxels were copied into the provided buffer
+		VOXELS_FOUND,
+		// Voxels were deleted, which may not have been flushed yet. Don't query the underlying storage.
+		VOXELS_DELETED,
+		// Voxels were saved encoded, their bytes were copied into the provided vector
+		VOXELS_FOUND_ENCODED
+	};
+
+	// Copies cached block into provided buffer. Can't be used if encoded voxels are saved into the cache.
+	VoxelsLoadResult load_voxel_block(Vector3i position, uint8_t lod_index, VoxelBuffer &out_voxels);
+
+	// Same as above, but voxels saved encoded are copied into `out_encoded_voxels` instead.
+	VoxelsLoadResult load_voxel_block(
+			Vector3i position,
+			uint8_t lod_index,
+			VoxelBuffer &out_voxels,
+			StdVector<uint8_t> &out_encoded_voxels
+	);
 
 	// Stores provided block into the cache. The cache will take ownership of the provided data.
 	void save_voxel_block(Vector3i position, uint8_t lod_index, VoxelBuffer &voxels);
 
+	// Stores voxels encoded by the stream. The cache will take ownership of the provided data.
+	void save_encoded_voxel_block(Vector3i position, uint8_t lod_index, StdVector<uint8_t> &data);
+
+	// Marks voxels of a block as deleted. The deletion will be passed on to the underlying storage when flushing.
+	void delete_voxel_block(Vector3i position, uint8_t lod_index);
+
 	// Copies cached data into the provided pointer. A new instance will be made if found.
 	bool load_instance_block(Vector3i position, uint8_t lod_index, UniquePtr<InstanceBlockData> &out_instances);
 
 	// Stores provided block into the cache. The cache will take ownership of the provided data.
 	void save_instance_block(Vector3i position, uint8_t lod_index, UniquePtr<InstanceBlockData> instances);
 
+	// How many dirty blocks are in the cache. Saving or flushing from other threads can change it at any time.
 	unsigned int get_indicative_block_count() const;
 
+	// When 0, flushing removes all blocks from the cache
+	void set_memory_budget(uint64_t bytes);
+	uint64_t get_memory_budget() const;
+
+	// Tells if enough was saved for flushing to be worth it, or if it has been too long since the last flush.
+	// Without memory budget, only the number of dirty blocks is considered.
+	bool is_flush_needed(unsigned int max_dirty_blocks, uint64_t now_msec, uint64_t max_interval_msec) const;
+
+	// Tells if saving must wait for a flush, when dirty blocks accumulate faster than they get flushed
+	bool is_flush_urgent(unsigned int max_dirty_blocks) const;
+
+	// Used by streams to avoid scheduling more than one background flush at a time.
+	// Returns true if the caller should schedule one.
+	bool try_begin_flush_request();
+	void end_flush_request();
+
+	Stats get_stats() const;
+
+	// Calls `save_func` on every dirty block. Dirty flags tell what has to be saved. Blocks then become clean.
 	template <typename F>
-	void flush(F save_func) {
-		_count = 0;
+	void flush(F save_func, uint64_t now_msec) {
+		const bool keep_clean_blocks = get_memory_budget() > 0;
 		for (unsigned int lod_index = 0; lod_index < _cache.size(); ++lod_index) {
 			Lod &lod = _cache[lod_index];
 			RWLockWrite wlock(lod.rw_lock);
 			for (auto it = lod.blocks.begin(); it != lod.blocks.end(); ++it) {
 				Block &block = it->second;
-				save_func(block);
+				if (block.is_dirty()) {
+					save_func(block);
+					block.voxels_dirty = false;
+					block.instances_dirty = false;
+					_dirty_memory_usage -= block.memory_usage;
+					--_dirty_block_count;
+				}
+			}
+			if (!keep_clean_blocks) {
+				for (auto it = lod.blocks.begin(); it != lod.blocks.end(); ++it) {
+					_memory_usage -= it->second.memory_usage;
+				}
+				lod.blocks.clear();
 			}
-			lod.blocks.clear();
 		}
+		_last_flush_time_msec = now_msec;
+		if (keep_clean_blocks) {
+			evict_clean_blocks();
+		}
+		_cache_stats.set_memory_usage(_memory_usage);
 	}
 
 private:
+	VoxelsLoadResult load_voxel_block_internal(
+			Vector3i position,
+			uint8_t lod_index,
+			VoxelBuffer &out_voxels,
+			StdVector<uint8_t> *out_encoded_voxels
+	);
+
+	Block &get_or_create_block_no_lock(StdUnorderedMap<Vector3i, Block> &blocks, Vector3i position, uint8_t lod_index);
+	void set_block_dirty_no_lock(Block &block);
+	void evict_clean_blocks();
+
 	struct Lod {
 		// Not using pointers for values, since unordered_map does not invalidate pointers to values
 		StdUnorderedMap<Vector3i, Block> blocks;
@@ -65,7 +172,15 @@ private:
 	};
 
 	FixedArray<Lod, constants::MAX_LOD> _cache;
-	unsigned int _count = 0;
+	std::atomic_uint64_t _memory_budget = { 0 };
+	std::atomic_uint64_t _last_flush_time_msec = { 0 };
+	std::atomic_uint32_t _access_time = { 0 };
+	std::atomic_uint32_t _dirty_block_count = { 0 };
+	std::atomic_uint64_t _memory_usage = { 0 };
+	std::atomic_uint64_t _dirty_memory_usage = { 0 };
+	std::atomic_uint32_t _evicted_block_count = { 0 };
+	CacheStats _cache_stats{ "stream_cache" };
+	std::atomic_bool _flush_requested = { false };
 };
 
 } // namespace zylann::voxel
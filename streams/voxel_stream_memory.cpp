@@ -45,6 +45,17 @@ void VoxelStreamMemory::save_voxel_block(VoxelQueryData &query_data) {
 	save_voxel_blocks(Span<VoxelQueryData>(&query_data, 1));
 }
 
+bool VoxelStreamMemory::supports_deleting_voxel_blocks() const {
+	return true;
+}
+
+void VoxelStreamMemory::delete_voxel_block(Vector3i position_in_blocks, uint8_t lod_index) {
+	ZN_ASSERT_RETURN(lod_index < _lods.size());
+	Lod &lod = _lods[lod_index];
+	MutexLock mlock(lod.mutex);
+	lod.voxel_blocks.erase(position_in_blocks);
+}
+
 bool VoxelStreamMemory::supports_instance_blocks() const {
 	return true;
 }
@@ -60,6 +71,7 @@ void VoxelStreamMemory::load_instance_blocks(Span<InstancesQueryData> out_blocks
 			q.result = VoxelStream::RESULT_BLOCK_NOT_FOUND;
 
 		} else {
+			q.result = VoxelStream::RESULT_BLOCK_FOUND;
 			// Copying is required since the cache has ownership on its data
 			q.data = make_unique_instance<InstanceBlockData>();
 			it->second.copy_to(*q.data);
@@ -24,6 +24,9 @@ public:
 	void load_voxel_block(VoxelQueryData &query_data) override;
 	void save_voxel_block(VoxelQueryData &query_data) override;
 
+	bool supports_deleting_voxel_blocks() const override;
+	void delete_voxel_block(Vector3i position_in_blocks, uint8_t lod_index) override;
+
 	bool supports_instance_blocks() const override;
 	void load_instance_blocks(Span<InstancesQueryData> out_blocks) override;
 	void save_instance_blocks(Span<InstancesQueryData> p_blocks) override;
@@ -1,17 +1,39 @@
 #include "voxel_stream_script.h"
 #include "../constants/voxel_string_names.h"
+#include "../engine/voxel_engine.h"
 #include "../storage/voxel_buffer_gd.h"
 #include "../util/godot/check_ref_ownership.h"
+#include "../util/godot/core/packed_arrays.h"
+#include "../util/math/conv.h"
+#include "../util/profiling.h"
 
 namespace zylann::voxel {
 
-void VoxelStreamScript::load_voxel_block(VoxelStream::VoxelQueryData &query_data) {
-	Variant output;
+namespace {
+
+Ref<godot::VoxelBuffer> create_load_wrapper(const VoxelBuffer &voxels) {
 	// Create a temporary wrapper so Godot can pass it to scripts
-	Ref<godot::VoxelBuffer> buffer_wrapper(memnew(
-			godot::VoxelBuffer(static_cast<godot::VoxelBuffer::Allocator>(query_data.voxel_buffer.get_allocator()))));
-	buffer_wrapper->get_buffer().copy_format(query_data.voxel_buffer);
-	buffer_wrapper->get_buffer().create(query_data.voxel_buffer.get_size());
+	Ref<godot::VoxelBuffer> buffer_wrapper(
+			memnew(godot::VoxelBuffer(static_cast<godot::VoxelBuffer::Allocator>(voxels.get_allocator())))
+	);
+	buffer_wrapper->get_buffer().copy_format(voxels);
+	buffer_wrapper->get_buffer().create(voxels.get_size());
+	return buffer_wrapper;
+}
+
+} // namespace
+
+void VoxelStreamScript::load_voxel_block(VoxelStream::VoxelQueryData &query_data) {
+	if (_load_batch_support != BATCH_UNSUPPORTED) {
+		BlockRequest request{ &query_data, false };
+		_load_combiner.process(request, [this](Span<BlockRequest *> requests) { load_voxel_block_batch(requests); });
+		if (request.handled) {
+			return;
+		}
+		// The script doesn't implement batches, fallback on single blocks
+	}
+
+	Ref<godot::VoxelBuffer> buffer_wrapper = create_load_wrapper(query_data.voxel_buffer);
 
 	query_data.result = RESULT_ERROR;
 
@@ -33,6 +55,14 @@ void VoxelStreamScript::load_voxel_block(VoxelStream::VoxelQueryData &query_data
 }
 
 void VoxelStreamScript::save_voxel_block(VoxelStream::VoxelQueryData &query_data) {
+	if (_save_batch_support != BATCH_UNSUPPORTED) {
+		BlockRequest request{ &query_data, false };
+		_save_combiner.process(request, [this](Span<BlockRequest *> requests) { save_voxel_block_batch(requests); });
+		if (request.handled) {
+			return;
+		}
+	}
+
 	// For now the callee can exceptionally take ownership of this wrapper, because we copy the data to it.
 	Ref<godot::VoxelBuffer> buffer_wrapper(memnew(
 			godot::VoxelBuffer(static_cast<godot::VoxelBuffer::Allocator>(query_data.voxel_buffer.get_allocator()))));
@@ -42,6 +72,145 @@ void VoxelStreamScript::save_voxel_block(VoxelStream::VoxelQueryData &query_data
 	}
 }
 
+void VoxelStreamScript::load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) {
+	// Already a batch, so it is passed directly without combining it with other threads
+	StdVector<BlockRequest> requests;
+	StdVector<BlockRequest *> request_ptrs;
+	requests.reserve(p_blocks.size());
+	for (VoxelStream::VoxelQueryData &q : p_blocks) {
+		requests.push_back(BlockRequest{ &q, false });
+	}
+	for (BlockRequest &request : requests) {
+		request_ptrs.push_back(&request);
+	}
+	if (_load_batch_support != BATCH_UNSUPPORTED) {
+		load_voxel_block_batch(to_span(request_ptrs));
+	}
+	for (BlockRequest &request : requests) {
+		if (!request.handled) {
+			load_voxel_block(*request.query);
+		}
+	}
+}
+
+void VoxelStreamScript::save_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) {
+	StdVector<BlockRequest> requests;
+	StdVector<BlockRequest *> request_ptrs;
+	requests.reserve(p_blocks.size());
+	for (VoxelStream::VoxelQueryData &q : p_blocks) {
+		requests.push_back(BlockRequest{ &q, false });
+	}
+	for (BlockRequest &request : requests) {
+		request_ptrs.push_back(&request);
+	}
+	if (_save_batch_support != BATCH_UNSUPPORTED) {
+		save_voxel_block_batch(to_span(request_ptrs));
+	}
+	for (BlockRequest &request : requests) {
+		if (!request.handled) {
+			save_voxel_block(*request.query);
+		}
+	}
+}
+
+void VoxelStreamScript::load_voxel_block_batch(Span<BlockRequest *> requests) {
+	ZN_PROFILE_SCOPE();
+
+	TypedArray<godot::VoxelBuffer> buffer_wrappers;
+	PackedVector3Array positions;
+	PackedInt32Array lods;
+	buffer_wrappers.resize(requests.size());
+	positions.resize(requests.size());
+	lods.resize(requests.size());
+
+	for (unsigned int i = 0; i < requests.size(); ++i) {
+		const VoxelStream::VoxelQueryData &q = *requests[i]->query;
+		buffer_wrappers[i] = create_load_wrapper(q.voxel_buffer);
+		positions.set(i, to_vec3(q.position_in_blocks));
+		lods.set(i, q.lod_index);
+	}
+
+	PackedInt32Array results;
+	if (!GDVIRTUAL_CALL(_load_voxel_blocks, buffer_wrappers, positions, lods, results)) {
+		// Requests are left for their threads to load one by one
+		_load_batch_support = BATCH_UNSUPPORTED;
+		return;
+	}
+	_load_batch_support = BATCH_SUPPORTED;
+	update_batch_concurrency();
+
+	if (results.size() != static_cast<int64_t>(requests.size())) {
+		ERR_PRINT_ONCE("VoxelStreamScript::_load_voxel_blocks must return one result per block");
+	}
+
+	for (unsigned int i = 0; i < requests.size(); ++i) {
+		BlockRequest &request = *requests[i];
+		VoxelStream::VoxelQueryData &q = *request.query;
+		request.handled = true;
+		q.result = RESULT_ERROR;
+
+		if (static_cast<int64_t>(i) >= results.size()) {
+			continue;
+		}
+		const int res = results[i];
+		ERR_CONTINUE(res < 0 || res >= _RESULT_COUNT);
+		if (res == RESULT_BLOCK_FOUND) {
+			Ref<godot::VoxelBuffer> buffer_wrapper = buffer_wrappers[i];
+			ERR_CONTINUE(buffer_wrapper.is_null());
+			// The thread owning the query is waiting for it, so we can write to its buffer
+			buffer_wrapper->get_buffer().move_to(q.voxel_buffer);
+		}
+		q.result = ResultCode(res);
+	}
+}
+
+void VoxelStreamScript::save_voxel_block_batch(Span<BlockRequest *> requests) {
+	ZN_PROFILE_SCOPE();
+
+	TypedArray<godot::VoxelBuffer> buffer_wrappers;
+	PackedVector3Array positions;
+	PackedInt32Array lods;
+	buffer_wrappers.resize(requests.size());
+	positions.resize(requests.size());
+	lods.resize(requests.size());
+
+	for (unsigned int i = 0; i < requests.size(); ++i) {
+		const VoxelStream::VoxelQueryData &q = *requests[i]->query;
+		// The callee can take ownership of these wrappers, because we copy the data to them
+		Ref<godot::VoxelBuffer> buffer_wrapper(
+				memnew(godot::VoxelBuffer(static_cast<godot::VoxelBuffer::Allocator>(q.voxel_buffer.get_allocator())))
+		);
+		q.voxel_buffer.copy_to(buffer_wrapper->get_buffer(), true);
+		buffer_wrappers[i] = buffer_wrapper;
+		positions.set(i, to_vec3(q.position_in_blocks));
+		lods.set(i, q.lod_index);
+	}
+
+	if (!GDVIRTUAL_CALL(_save_voxel_blocks, buffer_wrappers, positions, lods)) {
+		_save_batch_support = BATCH_UNSUPPORTED;
+		return;
+	}
+	_save_batch_support = BATCH_SUPPORTED;
+	update_batch_concurrency();
+
+	for (BlockRequest *request : requests) {
+		request->handled = true;
+	}
+}
+
+void VoxelStreamScript::update_batch_concurrency() {
+	if (_batch_concurrency_updated.exchange(true)) {
+		return;
+	}
+	bool thread_safe = false;
+	if (GDVIRTUAL_CALL(_is_thread_safe, thread_safe) && thread_safe) {
+		// Batches can run at the same time, but not on every thread, so requests still get combined
+		const unsigned int max_batches = math::max(VoxelEngine::get_singleton().get_thread_count() / 2, 1u);
+		_load_combiner.set_max_concurrent_batches(max_batches);
+		_save_combiner.set_max_concurrent_batches(max_batches);
+	}
+}
+
 int VoxelStreamScript::get_used_channels_mask() const {
 	int mask = 0;
 	if (!GDVIRTUAL_CALL(_get_used_channels_mask, mask)) {
@@ -54,6 +223,9 @@ void VoxelStreamScript::_bind_methods() {
 	// TODO Test if GDVIRTUAL can print errors properly when GDScript fails inside a different thread.
 	GDVIRTUAL_BIND(_load_voxel_block, "out_buffer", "position_in_blocks", "lod");
 	GDVIRTUAL_BIND(_save_voxel_block, "buffer", "position_in_blocks", "lod");
+	GDVIRTUAL_BIND(_load_voxel_blocks, "out_buffers", "positions_in_blocks", "lods");
+	GDVIRTUAL_BIND(_save_voxel_blocks, "buffers", "positions_in_blocks", "lods");
+	GDVIRTUAL_BIND(_is_thread_safe);
 	GDVIRTUAL_BIND(_get_used_channels_mask);
 }
 
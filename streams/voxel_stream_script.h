@@ -2,7 +2,10 @@
 #define VOXEL_STREAM_SCRIPT_H
 
 #include "../util/godot/core/gdvirtual.h"
+#include "../util/godot/core/typed_array.h"
+#include "../util/thread/request_combiner.h"
 #include "voxel_stream.h"
+#include <atomic>
 
 #ifdef ZN_GODOT_EXTENSION
 // GodotCpp wants the full definition of the class in GDVIRTUAL
@@ -14,21 +17,58 @@ namespace zylann::voxel {
 // Provides access to a source of paged voxel data, which may load and save.
 // Must be implemented in a multi-thread-safe way.
 // If you are looking for a more specialized API to generate voxels, use VoxelGenerator.
+// If the script implements `_load_voxel_blocks` and `_save_voxel_blocks`, blocks requested by concurrent threads are
+// combined into batches, so the cost of calling the script is amortized.
 class VoxelStreamScript : public VoxelStream {
 	GDCLASS(VoxelStreamScript, VoxelStream)
 public:
 	void load_voxel_block(VoxelStream::VoxelQueryData &q) override;
 	void save_voxel_block(VoxelStream::VoxelQueryData &q) override;
 
+	void load_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) override;
+	void save_voxel_blocks(Span<VoxelStream::VoxelQueryData> p_blocks) override;
+
 	int get_used_channels_mask() const override;
 
 protected:
 	// TODO Why is it unable to convert `Result` into `Variant` even though a cast is defined in voxel_stream.h???
 	GDVIRTUAL3R(int, _load_voxel_block, Ref<godot::VoxelBuffer>, Vector3i, int)
 	GDVIRTUAL3(_save_voxel_block, Ref<godot::VoxelBuffer>, Vector3i, int)
+	GDVIRTUAL3R(
+			PackedInt32Array,
+			_load_voxel_blocks,
+			TypedArray<godot::VoxelBuffer>,
+			PackedVector3Array,
+			PackedInt32Array
+	)
+	GDVIRTUAL3(_save_voxel_blocks, TypedArray<godot::VoxelBuffer>, PackedVector3Array, PackedInt32Array)
+	GDVIRTUAL0RC(bool, _is_thread_safe)
 	GDVIRTUAL0RC(int, _get_used_channels_mask) // I think `C` means `const`?
 
 	static void _bind_methods();
+
+private:
+	struct BlockRequest {
+		VoxelStream::VoxelQueryData *query;
+		bool handled;
+	};
+
+	// Requests are left unhandled if the script doesn't implement batches
+	void load_voxel_block_batch(Span<BlockRequest *> requests);
+	void save_voxel_block_batch(Span<BlockRequest *> requests);
+	void update_batch_concurrency();
+
+	enum BatchSupport : uint8_t { //
+		BATCH_SUPPORT_UNKNOWN,
+		BATCH_SUPPORTED,
+		BATCH_UNSUPPORTED
+	};
+
+	std::atomic<BatchSupport> _load_batch_support{ BATCH_SUPPORT_UNKNOWN };
+	std::atomic<BatchSupport> _save_batch_support{ BATCH_SUPPORT_UNKNOWN };
+	std::atomic_bool _batch_concurrency_updated{ false };
+	RequestCombiner<BlockRequest> _load_combiner;
+	RequestCombiner<BlockRequest> _save_combiner;
 };
 
 } // namespace zylann::voxel
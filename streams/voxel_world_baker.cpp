@@ -0,0 +1,273 @@
+#include "voxel_world_baker.h"
+#include "../constants/voxel_constants.h"
+#include "../engine/voxel_engine.h"
+#include "../generators/voxel_generator.h"
+#include "../storage/voxel_buffer.h"
+#include "../util/containers/std_vector.h"
+#include "../util/godot/core/string.h"
+#include "../util/math/conv.h"
+#include "../util/profiling.h"
+#include "../util/profiling_clock.h"
+#include "../util/string/format.h"
+#include "../util/tasks/parallel_jobs.h"
+#include "voxel_stream.h"
+#include <atomic>
+
+namespace zylann::voxel {
+
+namespace {
+
+// Saving blocks in groups amortizes the cost of stream transactions
+const unsigned int SAVE_BATCH_SIZE = 64;
+
+class SaveBatch {
+public:
+	SaveBatch(VoxelStream &stream) : _stream(stream) {}
+
+	~SaveBatch() {
+		flush();
+	}
+
+	void add(std::shared_ptr<VoxelBuffer> voxels, Vector3i position, uint8_t lod_index) {
+		_blocks.push_back(Block{ voxels, position, lod_index });
+		if (_blocks.size() >= SAVE_BATCH_SIZE) {
+			flush();
+		}
+	}
+
+	void flush() {
+		if (_blocks.size() == 0) {
+			return;
+		}
+		ZN_PROFILE_SCOPE_NAMED("Save blocks");
+		StdVector<VoxelStream::VoxelQueryData> queries;
+		queries.reserve(_blocks.size());
+		for (const Block &block : _blocks) {
+			VoxelStream::VoxelQueryData q{ *block.voxels, block.position, block.lod_index, VoxelStream::RESULT_ERROR };
+			queries.push_back(q);
+		}
+		_stream.save_voxel_blocks(to_span(queries));
+		_blocks.clear();
+	}
+
+private:
+	struct Block {
+		std::shared_ptr<VoxelBuffer> voxels;
+		Vector3i position;
+		uint8_t lod_index;
+	};
+
+	VoxelStream &_stream;
+	StdVector<Block> _blocks;
+};
+
+struct BakeContext {
+	VoxelGenerator &generator;
+	int block_size;
+	std::atomic_uint64_t generated_blocks = { 0 };
+	std::atomic_uint64_t downscaled_blocks = { 0 };
+};
+
+std::shared_ptr<VoxelBuffer> generate_block(BakeContext &ctx, Vector3i bpos, uint8_t lod_index) {
+	ZN_PROFILE_SCOPE();
+	std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+	voxels->create(Vector3iUtil::create(ctx.block_size));
+	VoxelGenerator::VoxelQueryData q{ *voxels, (bpos << lod_index) * ctx.block_size, lod_index };
+	ctx.generator.generate_block(q);
+	voxels->compress_uniform_channels();
+	++ctx.generated_blocks;
+	return voxels;
+}
+
+// Bakes a block and all its children down to LOD 0, which is generated. Parents are computed by downscaling their
+// children, like edited terrain, so at most 8 blocks per LOD are in memory at once.
+std::shared_ptr<VoxelBuffer> bake_block_with_mips(
+		BakeContext &ctx,
+		SaveBatch &save_batch,
+		Vector3i bpos,
+		uint8_t lod_index
+) {
+	if (lod_index == 0) {
+		std::shared_ptr<VoxelBuffer> voxels = generate_block(ctx, bpos, 0);
+		save_batch.add(voxels, bpos, 0);
+		return voxels;
+	}
+
+	std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+	voxels->create(Vector3iUtil::create(ctx.block_size));
+	const int half_bs = ctx.block_size / 2;
+
+	for (unsigned int octant_index = 0; octant_index < 8; ++octant_index) {
+		const Vector3i rel = Vector3iUtil::from_zxy_index(octant_index, Vector3i(2, 2, 2));
+		std::shared_ptr<VoxelBuffer> child = bake_block_with_mips(ctx, save_batch, bpos * 2 + rel, lod_index - 1);
+		if (octant_index == 0) {
+			voxels->copy_format(*child);
+		}
+		ZN_PROFILE_SCOPE_NAMED("Downscale");
+		child->downscale_to(*voxels, Vector3i(), child->get_size(), rel * half_bs);
+	}
+
+	voxels->compress_uniform_channels();
+	save_batch.add(voxels, bpos, lod_index);
+	++ctx.downscaled_blocks;
+	return voxels;
+}
+
+} // namespace
+
+void VoxelWorldBaker::set_generator(Ref<VoxelGenerator> generator) {
+	_generator = generator;
+}
+
+Ref<VoxelGenerator> VoxelWorldBaker::get_generator() const {
+	return _generator;
+}
+
+void VoxelWorldBaker::set_stream(Ref<VoxelStream> stream) {
+	_stream = stream;
+}
+
+Ref<VoxelStream> VoxelWorldBaker::get_stream() const {
+	return _stream;
+}
+
+void VoxelWorldBaker::set_lod_count(int count) {
+	ERR_FAIL_COND(count < 1 || count > static_cast<int>(constants::MAX_LOD));
+	_lod_count = count;
+}
+
+int VoxelWorldBaker::get_lod_count() const {
+	return _lod_count;
+}
+
+void VoxelWorldBaker::set_lod_mips_enabled(bool enabled) {
+	_lod_mips_enabled = enabled;
+}
+
+bool VoxelWorldBaker::is_lod_mips_enabled() const {
+	return _lod_mips_enabled;
+}
+
+int /*Error*/ VoxelWorldBaker::bake(Box3i voxel_box) {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND_V(_generator.is_null(), ERR_UNCONFIGURED);
+	ERR_FAIL_COND_V(_stream.is_null(), ERR_UNCONFIGURED);
+
+	_last_stats = Stats();
+	ProfilingClock profiling_clock;
+
+	const int block_size = 1 << _stream->get_block_size_po2();
+	const unsigned int lod_count = _lod_count;
+	ERR_FAIL_COND_V_MSG(
+			static_cast<int>(lod_count) > _stream->get_lod_count(),
+			ERR_INVALID_PARAMETER,
+			String("The stream only supports {0} LODs").format(varray(_stream->get_lod_count()))
+	);
+	const uint8_t last_lod_index = lod_count - 1;
+
+	// Each job covers the area of one block of the last LOD, so mips can be computed without sharing blocks between
+	// jobs
+	const Box3i job_box = voxel_box.downscaled(block_size << last_lod_index);
+	StdVector<Vector3i> job_positions;
+	job_box.for_each_cell_zxy([&job_positions](Vector3i pos) { job_positions.push_back(pos); });
+
+	VoxelEngine &engine = VoxelEngine::get_singleton();
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = [](Span<IThreadedTask *> tasks) { //
+		VoxelEngine::get_singleton().push_async_tasks(tasks);
+	};
+	const unsigned int thread_count = engine.get_thread_count();
+	scheduler.max_helpers = thread_count > 0 ? thread_count - 1 : 0;
+
+	BakeContext ctx{ **_generator, block_size };
+	VoxelStream &stream = **_stream;
+	const bool lod_mips_enabled = _lod_mips_enabled;
+
+	run_parallel_jobs(job_positions.size(), scheduler, [&](uint32_t job_index) {
+		ZN_PROFILE_SCOPE_NAMED("Bake job");
+		const Vector3i job_pos = job_positions[job_index];
+		SaveBatch save_batch(stream);
+
+		if (lod_mips_enabled) {
+			bake_block_with_mips(ctx, save_batch, job_pos, last_lod_index);
+			return;
+		}
+
+		for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+			const int job_size_in_blocks = 1 << (last_lod_index - lod_index);
+			const Box3i block_box =
+					voxel_box.downscaled(block_size << lod_index)
+							.clipped(Box3i(job_pos * job_size_in_blocks, Vector3iUtil::create(job_size_in_blocks)));
+
+			block_box.for_each_cell_zxy([&ctx, &save_batch, lod_index](Vector3i bpos) {
+				save_batch.add(generate_block(ctx, bpos, lod_index), bpos, lod_index);
+			});
+		}
+	});
+
+	stream.flush();
+
+	_last_stats.generated_blocks = ctx.generated_blocks;
+	_last_stats.downscaled_blocks = ctx.downscaled_blocks;
+	_last_stats.time_usec = profiling_clock.get_elapsed_microseconds();
+
+	ZN_PRINT_VERBOSE(format(
+			"Baked {} generated and {} downscaled blocks in {} ms",
+			_last_stats.generated_blocks,
+			_last_stats.downscaled_blocks,
+			_last_stats.time_usec / 1000
+	));
+
+	return OK;
+}
+
+int VoxelWorldBaker::_b_bake(AABB voxel_box) {
+	return bake(Box3i(math::round_to_int(voxel_box.position), math::round_to_int(voxel_box.size)));
+}
+
+Dictionary VoxelWorldBaker::_b_get_last_statistics() const {
+	const uint64_t block_count = _last_stats.generated_blocks + _last_stats.downscaled_blocks;
+	Dictionary d;
+	d["generated_blocks"] = _last_stats.generated_blocks;
+	d["downscaled_blocks"] = _last_stats.downscaled_blocks;
+	d["time_usec"] = _last_stats.time_usec;
+	d["blocks_per_second"] =
+			_last_stats.time_usec > 0 ? static_cast<double>(block_count) * 1000000.0 / _last_stats.time_usec : 0.0;
+	return d;
+}
+
+void VoxelWorldBaker::_bind_methods() {
+	using Self = VoxelWorldBaker;
+
+	ClassDB::bind_method(D_METHOD("set_generator", "generator"), &Self::set_generator);
+	ClassDB::bind_method(D_METHOD("get_generator"), &Self::get_generator);
+
+	ClassDB::bind_method(D_METHOD("set_stream", "stream"), &Self::set_stream);
+	ClassDB::bind_method(D_METHOD("get_stream"), &Self::get_stream);
+
+	ClassDB::bind_method(D_METHOD("set_lod_count", "count"), &Self::set_lod_count);
+	ClassDB::bind_method(D_METHOD("get_lod_count"), &Self::get_lod_count);
+
+	ClassDB::bind_method(D_METHOD("set_lod_mips_enabled", "enabled"), &Self::set_lod_mips_enabled);
+	ClassDB::bind_method(D_METHOD("is_lod_mips_enabled"), &Self::is_lod_mips_enabled);
+
+	ClassDB::bind_method(D_METHOD("bake", "voxel_box"), &Self::_b_bake);
+	ClassDB::bind_method(D_METHOD("get_last_statistics"), &Self::_b_get_last_statistics);
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::OBJECT, "generator", PROPERTY_HINT_RESOURCE_TYPE, VoxelGenerator::get_class_static()),
+			"set_generator",
+			"get_generator"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::OBJECT, "stream", PROPERTY_HINT_RESOURCE_TYPE, VoxelStream::get_class_static()),
+			"set_stream",
+			"get_stream"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "lod_count", PROPERTY_HINT_RANGE, "1,24,1"), "set_lod_count", "get_lod_count"
+	);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "lod_mips_enabled"), "set_lod_mips_enabled", "is_lod_mips_enabled");
+}
+
+} // namespace zylann::voxel
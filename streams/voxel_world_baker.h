@@ -0,0 +1,62 @@
+#ifndef VOXEL_WORLD_BAKER_H
+#define VOXEL_WORLD_BAKER_H
+
+#include "../util/godot/classes/ref_counted.h"
+#include "../util/godot/core/dictionary.h"
+#include "../util/math/box3i.h"
+
+namespace zylann::voxel {
+
+class VoxelGenerator;
+class VoxelStream;
+
+// Generates an area of a world and saves it into a stream without running a terrain, using all threads of the engine.
+// This is intended for offline use, such as preparing worlds at deploy time from a headless Godot instance, so the
+// game only has to load them.
+class VoxelWorldBaker : public RefCounted {
+	GDCLASS(VoxelWorldBaker, RefCounted)
+public:
+	struct Stats {
+		uint64_t generated_blocks = 0;
+		uint64_t downscaled_blocks = 0;
+		uint64_t time_usec = 0;
+	};
+
+	void set_generator(Ref<VoxelGenerator> generator);
+	Ref<VoxelGenerator> get_generator() const;
+
+	void set_stream(Ref<VoxelStream> stream);
+	Ref<VoxelStream> get_stream() const;
+
+	void set_lod_count(int count);
+	int get_lod_count() const;
+
+	// If enabled, blocks of LODs above 0 are computed by downscaling LOD 0 like edited terrain, instead of being
+	// generated directly. The baked box is then expanded to be aligned with blocks of the last LOD.
+	void set_lod_mips_enabled(bool enabled);
+	bool is_lod_mips_enabled() const;
+
+	// Blocks until the whole box is saved into the stream.
+	// TODO GDX: Can't bind functions returning a `godot::Error` enum
+	int /*Error*/ bake(Box3i voxel_box);
+
+	const Stats &get_last_stats() const {
+		return _last_stats;
+	}
+
+private:
+	int _b_bake(AABB voxel_box);
+	Dictionary _b_get_last_statistics() const;
+
+	static void _bind_methods();
+
+	Ref<VoxelGenerator> _generator;
+	Ref<VoxelStream> _stream;
+	uint8_t _lod_count = 1;
+	bool _lod_mips_enabled = false;
+	Stats _last_stats;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_WORLD_BAKER_H
@@ -4,6 +4,8 @@
 #include "../../storage/voxel_buffer.h"
 #include "../../storage/voxel_data.h"
 #include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/packed_arrays.h"
+#include "../../util/math/box3i.h"
 #include "../../util/profiling.h"
 #include "voxel_terrain.h"
 
@@ -186,20 +188,60 @@ bool intersects(Span<const AABB> aabbs, const AABB &box) {
 	return false;
 }
 
-void collect_boxes(VoxelTerrain &p_terrain, AABB query_box, uint32_t collision_nask, StdVector<AABB> &potential_boxes) {
-	ZN_PROFILE_SCOPE();
-	const VoxelData &voxels = p_terrain.get_storage();
+// Calls `f(position, value)` for every voxel of the box, reading each block of voxels under a single lock instead of
+// looking it up for every voxel
+template <typename F>
+void for_each_voxel_in_box(const VoxelData &voxels, const Box3i voxel_box, const unsigned int channel, F f) {
+	VoxelSingleValue defval;
+	defval.i = 0;
+	VoxelData::BlockReadAccess access;
+	const int block_size = voxels.get_block_size();
+
+	const Box3i blocks_box = voxel_box.downscaled(block_size);
+	const Vector3i blocks_end = blocks_box.position + blocks_box.size;
+	Vector3i bpos;
+
+	for (bpos.z = blocks_box.position.z; bpos.z < blocks_end.z; ++bpos.z) {
+		for (bpos.y = blocks_box.position.y; bpos.y < blocks_end.y; ++bpos.y) {
+			for (bpos.x = blocks_box.position.x; bpos.x < blocks_end.x; ++bpos.x) {
+				voxels.acquire_block_read_access(bpos * block_size, access);
+				const Box3i box_in_block = voxel_box.clipped(access.get_voxel_box());
+				box_in_block.for_each_cell([&access, &f, channel, defval](const Vector3i pos) {
+					f(pos, access.get_voxel(pos, channel, defval).i);
+				});
+			}
+		}
+	}
+}
+
+// Voxels touched by a box
+inline Box3i get_voxel_box(const AABB query_box) {
+	const Vector3 query_box_end = query_box.position + query_box.size;
 
 	const int min_x = int(Math::floor(query_box.position.x));
 	const int min_y = int(Math::floor(query_box.position.y));
 	const int min_z = int(Math::floor(query_box.position.z));
 
-	const Vector3 query_box_end = query_box.position + query_box.size;
 	const int max_x = int(Math::ceil(query_box_end.x));
 	const int max_y = int(Math::ceil(query_box_end.y));
 	const int max_z = int(Math::ceil(query_box_end.z));
 
-	Vector3i i(min_x, min_y, min_z);
+	return Box3i::from_min_max(Vector3i(min_x, min_y, min_z), Vector3i(max_x, max_y, max_z));
+}
+
+// Gathers collision boxes of the voxels found in the query box. If `out_cells` is provided, the position of the voxel
+// each box comes from is added to it, in the same order.
+void collect_boxes(
+		VoxelTerrain &p_terrain,
+		AABB query_box,
+		uint32_t collision_nask,
+		StdVector<AABB> &potential_boxes,
+		StdVector<Vector3i> *out_cells
+) {
+	ZN_PROFILE_SCOPE();
+	const VoxelData &voxels = p_terrain.get_storage();
+
+	const Box3i voxel_box = get_voxel_box(query_box);
 
 	Ref<VoxelMesherBlocky> mesher_blocky;
 	Ref<VoxelMesherCubes> mesher_cubes;
@@ -207,86 +249,96 @@ void collect_boxes(VoxelTerrain &p_terrain, AABB query_box, uint32_t collision_n
 	if (zylann::godot::try_get_as(p_terrain.get_mesher(), mesher_blocky)) {
 		Ref<VoxelBlockyLibraryBase> library_ref = mesher_blocky->get_library();
 		ERR_FAIL_COND_MSG(library_ref.is_null(), "VoxelMesherBlocky has no library assigned");
-		const int channel = VoxelBuffer::CHANNEL_TYPE;
-		VoxelSingleValue defval;
-		defval.i = 0;
 
 		const VoxelBlockyLibraryBase::BakedData &baked_data = library_ref->get_baked_data();
 
-		// TODO Optimization: read the whole box of voxels at once, querying individually is slower
-		for (i.z = min_z; i.z < max_z; ++i.z) {
-			for (i.y = min_y; i.y < max_y; ++i.y) {
-				for (i.x = min_x; i.x < max_x; ++i.x) {
-					const int type_id = voxels.get_voxel(i, channel, defval).i;
-
-					if (baked_data.has_model(type_id)) {
-						const VoxelBlockyModel::BakedData &model = baked_data.models[type_id];
+		for_each_voxel_in_box(
+				voxels,
+				voxel_box,
+				VoxelBuffer::CHANNEL_TYPE,
+				[&baked_data, &potential_boxes, out_cells, collision_nask](const Vector3i pos, const uint64_t type_id) {
+					if (!baked_data.has_model(type_id)) {
+						return;
+					}
+					const VoxelBlockyModel::BakedData &model = baked_data.models[type_id];
 
-						if ((model.box_collision_mask & collision_nask) == 0) {
-							continue;
-						}
+					if ((model.box_collision_mask & collision_nask) == 0) {
+						return;
+					}
 
-						for (const AABB &aabb : model.box_collision_aabbs) {
-							AABB world_box = aabb;
-							world_box.position += i;
-							potential_boxes.push_back(world_box);
+					for (const AABB &aabb : model.box_collision_aabbs) {
+						AABB world_box = aabb;
+						world_box.position += pos;
+						potential_boxes.push_back(world_box);
+						if (out_cells != nullptr) {
+							out_cells->push_back(pos);
 						}
 					}
 				}
-			}
-		}
+		);
 
 	} else if (zylann::godot::try_get_as(p_terrain.get_mesher(), mesher_cubes)) {
-		const int channel = VoxelBuffer::CHANNEL_COLOR;
-		VoxelSingleValue defval;
-		defval.i = 0;
-
-		// TODO Optimization: read the whole box of voxels at once, querying individually is slower
-		for (i.z = min_z; i.z < max_z; ++i.z) {
-			for (i.y = min_y; i.y < max_y; ++i.y) {
-				for (i.x = min_x; i.x < max_x; ++i.x) {
-					const int color_data = voxels.get_voxel(i, channel, defval).i;
+		for_each_voxel_in_box(
+				voxels,
+				voxel_box,
+				VoxelBuffer::CHANNEL_COLOR,
+				[&potential_boxes, out_cells](const Vector3i pos, const uint64_t color_data) {
 					if (color_data != 0) {
-						potential_boxes.push_back(AABB(i, Vector3(1, 1, 1)));
+						potential_boxes.push_back(AABB(pos, Vector3(1, 1, 1)));
+						if (out_cells != nullptr) {
+							out_cells->push_back(pos);
+						}
 					}
 				}
-			}
-		}
+		);
 	}
 }
 
-} // namespace
-
-Vector3 VoxelBoxMover::get_motion(Vector3 p_pos, Vector3 p_motion, AABB p_aabb, VoxelTerrain &p_terrain) {
-	ZN_PROFILE_SCOPE();
-	// The mesher is required to know how collisions should be processed
-	ERR_FAIL_COND_V(p_terrain.get_mesher().is_null(), Vector3());
-
-	// Transform to local in case the volume is transformed
-	const Transform3D to_world = p_terrain.get_global_transform();
-	const Transform3D to_local = to_world.affine_inverse();
-	const Vector3 pos = to_local.xform(p_pos);
-	const Vector3 motion = to_local.basis.xform(p_motion);
-	const AABB aabb = Transform3D(to_local.basis, Vector3()).xform(p_aabb);
+// Picks boxes previously collected over a larger area, as if `collect_boxes` had been called with the query box
+void filter_boxes(
+		Span<const AABB> boxes,
+		Span<const Vector3i> cells,
+		AABB query_box,
+		StdVector<AABB> &potential_boxes
+) {
+	const Box3i voxel_box = get_voxel_box(query_box);
+	for (unsigned int i = 0; i < boxes.size(); ++i) {
+		if (voxel_box.contains(cells[i])) {
+			potential_boxes.push_back(boxes[i]);
+		}
+	}
+}
 
-	const AABB box(aabb.position + pos, aabb.size);
+struct MotionParams {
+	bool step_climbing_enabled;
+	real_t max_step_height;
+};
+
+// Moves a box in local space of the terrain. `f_collect(query_box, out_boxes)` gathers potential collisions.
+template <typename FCollect>
+Vector3 get_motion_with_step_climbing(
+		const AABB box,
+		const Vector3 motion,
+		const MotionParams params,
+		StdVector<AABB> &potential_boxes,
+		FCollect f_collect,
+		bool &out_stepped_up
+) {
 	const AABB expanded_box = expand_with_vector(box, motion);
 
-	static thread_local StdVector<AABB> s_colliding_boxes;
-	StdVector<AABB> &potential_boxes = s_colliding_boxes;
 	potential_boxes.clear();
 
 	// Collect potential collisions with the terrain (broad phase)
 	// TODO If motion is really big, we may want something more optimal or reject it
-	collect_boxes(p_terrain, expanded_box, _collision_mask, potential_boxes);
+	f_collect(expanded_box, potential_boxes);
 
 	// Calculate collisions (narrow phase)
 	Vector3 slided_motion = zylann::voxel::get_motion(box, motion, to_span(potential_boxes));
 
 	// Minecraft-style stair climbing:
 	// If we were moving, changed horizontal direction due to collision, and resulting motion is about horizontal
-	_has_stepped_up = false;
-	if (_step_climbing_enabled &&
+	out_stepped_up = false;
+	if (params.step_climbing_enabled &&
 			// Movement is horizontal?
 			Math::abs(slided_motion.y) < 0.001 && Vector2(motion.x, motion.z).length_squared() > 0.0001 &&
 			// Motor movement isn't the same as resulting slided motion?
@@ -297,7 +349,7 @@ Vector3 VoxelBoxMover::get_motion(Vector3 p_pos, Vector3 p_motion, AABB p_aabb,
 		// Find out the height of the step
 		if (boxcast_down(to_span(potential_boxes), get_xz(expanded_box.position), get_xz(expanded_box.size), hit_y)) {
 			// If the step is up and not too high
-			if (hit_y > box.position.y && (hit_y - box.position.y) <= _max_step_height) {
+			if (hit_y > box.position.y && (hit_y - box.position.y) <= params.max_step_height) {
 				// Check if we would fit if we move the box above the step.
 				// Raise it slightly higher to avoid precision issues. Even if the final motion would move the box
 				// exactly on top of the stair, gameplay code could do some additional calculations with that motion
@@ -307,24 +359,172 @@ Vector3 VoxelBoxMover::get_motion(Vector3 p_pos, Vector3 p_motion, AABB p_aabb,
 						Vector3(box.position.x + motion.x, hit_y + epsilon, box.position.z + motion.z), box.size);
 
 				potential_boxes.clear();
-				collect_boxes(p_terrain, hyp_box, _collision_mask, potential_boxes);
+				f_collect(hyp_box, potential_boxes);
 
 				// If the box fits on top of the step
 				if (!intersects(to_span(potential_boxes), hyp_box)) {
 					// Change motion so that it brings the box on top of the step
 					slided_motion = hyp_box.position - box.position;
-					_has_stepped_up = true;
+					out_stepped_up = true;
 				}
 			}
 		}
 	}
 
+	return slided_motion;
+}
+
+} // namespace
+
+Vector3 VoxelBoxMover::get_motion(Vector3 p_pos, Vector3 p_motion, AABB p_aabb, VoxelTerrain &p_terrain) {
+	ZN_PROFILE_SCOPE();
+	// The mesher is required to know how collisions should be processed
+	ERR_FAIL_COND_V(p_terrain.get_mesher().is_null(), Vector3());
+
+	// Transform to local in case the volume is transformed
+	const Transform3D to_world = p_terrain.get_global_transform();
+	const Transform3D to_local = to_world.affine_inverse();
+	const Vector3 pos = to_local.xform(p_pos);
+	const Vector3 motion = to_local.basis.xform(p_motion);
+	const AABB aabb = Transform3D(to_local.basis, Vector3()).xform(p_aabb);
+
+	const AABB box(aabb.position + pos, aabb.size);
+
+	static thread_local StdVector<AABB> s_colliding_boxes;
+	StdVector<AABB> &potential_boxes = s_colliding_boxes;
+
+	const uint32_t collision_mask = _collision_mask;
+
+	const Vector3 slided_motion = get_motion_with_step_climbing(
+			box,
+			motion,
+			MotionParams{ _step_climbing_enabled, _max_step_height },
+			potential_boxes,
+			[&p_terrain, collision_mask](const AABB query_box, StdVector<AABB> &out_boxes) {
+				collect_boxes(p_terrain, query_box, collision_mask, out_boxes, nullptr);
+			},
+			_has_stepped_up
+	);
+
 	// Switch back to world
 	const Vector3 world_slided_motion = to_world.basis.xform(slided_motion);
 
 	return world_slided_motion;
 }
 
+void VoxelBoxMover::get_motions(
+		Span<const Vector3> p_positions,
+		Span<const Vector3> p_motions,
+		Span<const AABB> p_aabbs,
+		VoxelTerrain &p_terrain,
+		Span<Vector3> out_motions
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(p_motions.size() == p_positions.size());
+	ZN_ASSERT_RETURN(out_motions.size() == p_positions.size());
+	// Either one box per body, or one box shared by all bodies
+	ZN_ASSERT_RETURN(p_aabbs.size() == p_positions.size() || p_aabbs.size() == 1);
+
+	_has_stepped_up = false;
+
+	if (p_positions.size() == 0) {
+		return;
+	}
+
+	ERR_FAIL_COND(p_terrain.get_mesher().is_null());
+
+	const Transform3D to_world = p_terrain.get_global_transform();
+	const Transform3D to_local = to_world.affine_inverse();
+	const Transform3D to_local_basis(to_local.basis, Vector3());
+
+	const MotionParams params{ _step_climbing_enabled, _max_step_height };
+
+	// Stepping up may query boxes above the region the body moves through
+	const real_t step_margin = params.step_climbing_enabled ? params.max_step_height + 1.0 : 0.0;
+
+	static thread_local StdVector<AABB> s_local_boxes;
+	static thread_local StdVector<Vector3> s_local_motions;
+	StdVector<AABB> &local_boxes = s_local_boxes;
+	StdVector<Vector3> &local_motions = s_local_motions;
+	local_boxes.resize(p_positions.size());
+	local_motions.resize(p_positions.size());
+
+	// Find the region covered by all bodies, to gather potential collisions only once
+	AABB union_box;
+	uint64_t separate_volume = 0;
+
+	for (unsigned int i = 0; i < p_positions.size(); ++i) {
+		const AABB aabb = to_local_basis.xform(p_aabbs.size() == 1 ? p_aabbs[0] : p_aabbs[i]);
+		const AABB box(aabb.position + to_local.xform(p_positions[i]), aabb.size);
+		const Vector3 motion = to_local.basis.xform(p_motions[i]);
+		local_boxes[i] = box;
+		local_motions[i] = motion;
+
+		AABB query_box = expand_with_vector(box, motion);
+		query_box.size.y += step_margin;
+
+		separate_volume += Vector3iUtil::get_volume_u64(get_voxel_box(query_box).size);
+		if (i == 0) {
+			union_box = query_box;
+		} else {
+			union_box.merge_with(query_box);
+		}
+	}
+
+	const uint32_t collision_mask = _collision_mask;
+
+	static thread_local StdVector<AABB> s_potential_boxes;
+	StdVector<AABB> &potential_boxes = s_potential_boxes;
+
+	// When bodies are far apart, the region covering all of them is mostly empty space, and reading it would cost more
+	// than reading around each body separately
+	const uint64_t union_volume = Vector3iUtil::get_volume_u64(get_voxel_box(union_box).size);
+
+	if (union_volume > 2 * separate_volume) {
+		for (unsigned int i = 0; i < local_boxes.size(); ++i) {
+			bool stepped_up;
+			const Vector3 slided_motion = get_motion_with_step_climbing(
+					local_boxes[i],
+					local_motions[i],
+					params,
+					potential_boxes,
+					[&p_terrain, collision_mask](const AABB query_box, StdVector<AABB> &out_boxes) {
+						collect_boxes(p_terrain, query_box, collision_mask, out_boxes, nullptr);
+					},
+					stepped_up
+			);
+			_has_stepped_up |= stepped_up;
+			out_motions[i] = to_world.basis.xform(slided_motion);
+		}
+		return;
+	}
+
+	static thread_local StdVector<AABB> s_shared_boxes;
+	static thread_local StdVector<Vector3i> s_shared_cells;
+	StdVector<AABB> &shared_boxes = s_shared_boxes;
+	StdVector<Vector3i> &shared_cells = s_shared_cells;
+	shared_boxes.clear();
+	shared_cells.clear();
+
+	collect_boxes(p_terrain, union_box, collision_mask, shared_boxes, &shared_cells);
+
+	for (unsigned int i = 0; i < local_boxes.size(); ++i) {
+		bool stepped_up;
+		const Vector3 slided_motion = get_motion_with_step_climbing(
+				local_boxes[i],
+				local_motions[i],
+				params,
+				potential_boxes,
+				[&shared_boxes, &shared_cells](const AABB query_box, StdVector<AABB> &out_boxes) {
+					filter_boxes(to_span(shared_boxes), to_span(shared_cells), query_box, out_boxes);
+				},
+				stepped_up
+		);
+		_has_stepped_up |= stepped_up;
+		out_motions[i] = to_world.basis.xform(slided_motion);
+	}
+}
+
 void VoxelBoxMover::set_collision_mask(uint32_t mask) {
 	_collision_mask = mask;
 }
@@ -361,8 +561,61 @@ Vector3 VoxelBoxMover::_b_get_motion(Vector3 pos, Vector3 motion, AABB aabb, Obj
 	return get_motion(pos, motion, aabb, *terrain);
 }
 
+#if defined(ZN_GODOT)
+PackedVector3Array VoxelBoxMover::_b_get_motions(
+		PackedVector3Array positions,
+		PackedVector3Array motions,
+		Array aabbs,
+		Node *terrain_node
+) {
+#elif defined(ZN_GODOT_EXTENSION)
+PackedVector3Array VoxelBoxMover::_b_get_motions(
+		PackedVector3Array positions,
+		PackedVector3Array motions,
+		Array aabbs,
+		Object *terrain_node_o
+) {
+	Node *terrain_node = Object::cast_to<Node>(terrain_node_o);
+#endif
+	ERR_FAIL_COND_V(terrain_node == nullptr, PackedVector3Array());
+	VoxelTerrain *terrain = Object::cast_to<VoxelTerrain>(terrain_node);
+	ERR_FAIL_COND_V(terrain == nullptr, PackedVector3Array());
+	ERR_FAIL_COND_V_MSG(
+			motions.size() != positions.size(),
+			PackedVector3Array(),
+			"Expected as many motions as positions"
+	);
+	ERR_FAIL_COND_V_MSG(
+			aabbs.size() != positions.size() && aabbs.size() != 1,
+			PackedVector3Array(),
+			"Expected as many AABBs as positions, or a single AABB shared by all"
+	);
+
+	StdVector<AABB> aabbs_vec;
+	aabbs_vec.reserve(aabbs.size());
+	for (int i = 0; i < aabbs.size(); ++i) {
+		const Variant v = aabbs[i];
+		ERR_FAIL_COND_V(v.get_type() != Variant::AABB, PackedVector3Array());
+		aabbs_vec.push_back(v);
+	}
+
+	PackedVector3Array results;
+	results.resize(positions.size());
+	get_motions(
+			to_span(positions),
+			to_span(motions),
+			to_span(aabbs_vec),
+			*terrain,
+			Span<Vector3>(results.ptrw(), results.size())
+	);
+	return results;
+}
+
 void VoxelBoxMover::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_motion", "pos", "motion", "aabb", "terrain"), &VoxelBoxMover::_b_get_motion);
+	ClassDB::bind_method(
+			D_METHOD("get_motions", "positions", "motions", "aabbs", "terrain"), &VoxelBoxMover::_b_get_motions
+	);
 
 	ClassDB::bind_method(D_METHOD("set_collision_mask", "mask"), &VoxelBoxMover::set_collision_mask);
 	ClassDB::bind_method(D_METHOD("get_collision_mask"), &VoxelBoxMover::get_collision_mask);
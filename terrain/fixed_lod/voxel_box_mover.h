@@ -1,6 +1,7 @@
 #ifndef VOXEL_BOX_MOVER_H
 #define VOXEL_BOX_MOVER_H
 
+#include "../../util/containers/span.h"
 #include "../../util/godot/classes/ref_counted.h"
 #include "../../util/godot/macros.h"
 
@@ -16,6 +17,16 @@ class VoxelBoxMover : public RefCounted {
 public:
 	Vector3 get_motion(Vector3 pos, Vector3 motion, AABB aabb, VoxelTerrain &terrain);
 
+	// Same as `get_motion` for many bodies at once. Potential collisions are gathered once for the region covering all
+	// of them, unless they are too far apart. `aabbs` has one box per body, or a single box shared by all of them.
+	void get_motions(
+			Span<const Vector3> positions,
+			Span<const Vector3> motions,
+			Span<const AABB> aabbs,
+			VoxelTerrain &terrain,
+			Span<Vector3> out_motions
+	);
+
 	void set_collision_mask(uint32_t mask);
 	inline uint32_t get_collision_mask() const {
 		return _collision_mask;
@@ -32,9 +43,21 @@ public:
 private:
 #if defined(ZN_GODOT)
 	Vector3 _b_get_motion(Vector3 p_pos, Vector3 p_motion, AABB p_aabb, Node *p_terrain_node);
+	PackedVector3Array _b_get_motions(
+			PackedVector3Array p_positions,
+			PackedVector3Array p_motions,
+			Array p_aabbs,
+			Node *p_terrain_node
+	);
 #elif defined(ZN_GODOT_EXTENSION)
 	// TODO GDX: it seems binding a method taking a `Node*` fails to compile. It is supposed to be working.
 	Vector3 _b_get_motion(Vector3 p_pos, Vector3 p_motion, AABB p_aabb, Object *p_terrain_node_o);
+	PackedVector3Array _b_get_motions(
+			PackedVector3Array p_positions,
+			PackedVector3Array p_motions,
+			Array p_aabbs,
+			Object *p_terrain_node_o
+	);
 #endif
 
 	static void _bind_methods();
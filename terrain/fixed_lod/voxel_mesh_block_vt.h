@@ -2,6 +2,7 @@
 #define VOXEL_MESH_BLOCK_VT_H
 
 #include "../../util/godot/classes/material.h"
+#include "../occlusion_culling.h"
 #include "../voxel_mesh_block.h"
 
 namespace zylann::voxel {
@@ -19,18 +20,14 @@ public:
 	// `cast_shadow` mode per mesh surface. This might have an impact on performance.
 	zylann::godot::DirectMeshInstance shadow_occluder;
 
-	RefCount mesh_viewers;
-	RefCount collision_viewers;
-
-	// True if this block is in the update list of `VoxelTerrain`, so multiple edits done before it processes will not
-	// add it multiple times
-	bool is_in_update_list = false;
-
 	// Will be true if the block has ever been processed by meshing (regardless of there being a mesh or not).
 	// This is needed to know if the area is loaded, in terms of collisions. If the game uses voxels directly for
 	// collision, it may be a better idea to use `is_area_editable` and not use mesh blocks
 	bool is_loaded = false;
 
+	// See `occlusion_culling.h`
+	uint16_t side_connectivity = occlusion_culling::SIDE_CONNECTIVITY_ALL;
+
 	VoxelMeshBlockVT(const Vector3i bpos, unsigned int size) : VoxelMeshBlock(bpos) {
 		_position_in_voxels = bpos * size;
 	}
@@ -87,6 +84,32 @@ public:
 		}
 
 		VoxelMeshBlock::set_mesh(mesh, gi_mode, shadow_setting, render_layers_mask);
+
+		if (_occluded) {
+			// The mesh instance may have just been created
+			update_occluded_mesh_instance(shadow_setting);
+		}
+	}
+
+	void set_shadow_casting(RenderingServer::ShadowCastingSetting setting) {
+		VoxelMeshBlock::set_shadow_casting(setting);
+		if (_occluded) {
+			update_occluded_mesh_instance(setting);
+		}
+	}
+
+	// Occluded blocks are not drawn, but they still cast shadows if shadow casting is enabled, because occlusion is
+	// only calculated from the point of view of the camera.
+	void set_occluded(bool occluded, RenderingServer::ShadowCastingSetting shadow_setting) {
+		if (_occluded == occluded) {
+			return;
+		}
+		_occluded = occluded;
+		update_occluded_mesh_instance(shadow_setting);
+	}
+
+	bool is_occluded() const {
+		return _occluded;
 	}
 
 	void drop_mesh() {
@@ -135,12 +158,30 @@ public:
 	}
 
 protected:
+	void update_occluded_mesh_instance(RenderingServer::ShadowCastingSetting shadow_setting) {
+		if (!_mesh_instance.is_valid()) {
+			return;
+		}
+		if (shadow_setting == RenderingServer::SHADOW_CASTING_SETTING_OFF) {
+			_mesh_instance.set_visible(!_occluded);
+			_mesh_instance.set_cast_shadows_setting(shadow_setting);
+		} else {
+			_mesh_instance.set_visible(true);
+			_mesh_instance.set_cast_shadows_setting(
+					_occluded ? RenderingServer::SHADOW_CASTING_SETTING_SHADOWS_ONLY : shadow_setting
+			);
+		}
+	}
+
 	void _set_visible(bool visible) {
 		if (shadow_occluder.is_valid()) {
 			set_mesh_instance_visible(shadow_occluder, visible);
 		}
 		VoxelMeshBlock::_set_visible(visible);
 	}
+
+private:
+	bool _occluded = false;
 };
 
 } // namespace zylann::voxel
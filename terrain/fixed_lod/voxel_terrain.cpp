@@ -4,16 +4,14 @@
 #include "../../edition/voxel_tool_terrain.h"
 #include "../../engine/buffered_task_scheduler.h"
 #include "../../engine/voxel_engine.h"
+#include "../../engine/voxel_engine_gd.h"
 #include "../../engine/voxel_engine_updater.h"
-#include "../../generators/generate_block_task.h"
 #include "../../meshers/blocky/voxel_mesher_blocky.h"
-#include "../../meshers/mesh_block_task.h"
 #include "../../storage/voxel_buffer_gd.h"
 #include "../../storage/voxel_data.h"
-#include "../../streams/load_block_data_task.h"
 #include "../../streams/save_block_data_task.h"
-#include "../../util/containers/container_funcs.h"
 #include "../../util/godot/classes/base_material_3d.h" // For property hint in release mode in GDExtension...
+#include "../../util/godot/classes/camera_3d.h"
 #include "../../util/godot/classes/concave_polygon_shape_3d.h"
 #include "../../util/godot/classes/engine.h"
 #include "../../util/godot/classes/multiplayer_api.h"
@@ -21,18 +19,20 @@
 #include "../../util/godot/classes/scene_tree.h"
 #include "../../util/godot/classes/script.h"
 #include "../../util/godot/classes/shader_material.h"
+#include "../../util/godot/classes/viewport.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/godot/core/string.h"
 #include "../../util/macros.h"
 #include "../../util/math/conv.h"
+#include "../../util/memory/linear_allocator.h"
 #include "../../util/profiling.h"
-#include "../../util/profiling_clock.h"
 #include "../../util/string/format.h"
 #include "../../util/tasks/async_dependency_tracker.h"
 #include "../instancing/voxel_instancer.h"
 #include "../voxel_data_block_enter_info.h"
 #include "../voxel_save_completion_tracker.h"
 #include "voxel_terrain_multiplayer_synchronizer.h"
+#include "voxel_terrain_update_task.h"
 
 #ifdef TOOLS_ENABLED
 #include "../../meshers/transvoxel/voxel_mesher_transvoxel.h"
@@ -55,6 +55,7 @@ VoxelTerrain::VoxelTerrain() {
 
 	_streaming_dependency = make_shared_instance<StreamingDependency>();
 	_meshing_dependency = make_shared_instance<MeshingDependency>();
+	_update_data = make_shared_instance<VoxelTerrainUpdateData>();
 
 	struct ApplyMeshUpdateTask : public ITimeSpreadTask {
 		void run(TimeSpreadTaskContext &ctx) override {
@@ -65,9 +66,14 @@ VoxelTerrain::VoxelTerrain() {
 			}
 			self->apply_mesh_update(data);
 		}
+		float get_order_hint() const override {
+			return viewer_distance_squared;
+		}
 		VolumeID volume_id;
 		VoxelTerrain *self = nullptr;
 		VoxelEngine::BlockMeshOutput data;
+		// Meshes closer to viewers are applied first
+		float viewer_distance_squared = 0.f;
 	};
 
 	// Mesh updates are spread over frames by scheduling them in a task runner of VoxelEngine,
@@ -75,20 +81,30 @@ VoxelTerrain::VoxelTerrain() {
 	// because this kind of task scheduling would otherwise delay the update by 1 frame
 	VoxelEngine::VolumeCallbacks callbacks;
 	callbacks.data = this;
-	callbacks.mesh_output_callback = [](void *cb_data, VoxelEngine::BlockMeshOutput &ob) {
+	callbacks.mesh_outputs_callback = [](void *cb_data, Span<VoxelEngine::BlockMeshOutput> outputs) {
 		VoxelTerrain *self = reinterpret_cast<VoxelTerrain *>(cb_data);
-		ApplyMeshUpdateTask *task = ZN_NEW(ApplyMeshUpdateTask);
-		task->volume_id = self->_volume_id;
-		task->self = self;
-		task->data = std::move(ob);
-		VoxelEngine::get_singleton().push_main_thread_time_spread_task(task);
+		VoxelEngine &engine = VoxelEngine::get_singleton();
+		const Transform3D transform = self->get_global_transform();
+		const int block_size = self->get_mesh_block_size();
+		for (VoxelEngine::BlockMeshOutput &ob : outputs) {
+			ApplyMeshUpdateTask *task = ZN_NEW(ApplyMeshUpdateTask);
+			task->volume_id = self->_volume_id;
+			task->self = self;
+			const Vector3 block_center = to_vec3(ob.position * block_size) + Vector3(0.5f, 0.5f, 0.5f) * block_size;
+			task->viewer_distance_squared = engine.get_closest_viewer_distance_squared(transform.xform(block_center));
+			task->data = std::move(ob);
+			engine.push_main_thread_time_spread_task(task);
+		}
 	};
-	callbacks.data_output_callback = [](void *cb_data, VoxelEngine::BlockDataOutput &ob) {
+	callbacks.data_outputs_callback = [](void *cb_data, Span<VoxelEngine::BlockDataOutput> outputs) {
 		VoxelTerrain *self = reinterpret_cast<VoxelTerrain *>(cb_data);
-		self->apply_data_block_response(ob);
+		for (VoxelEngine::BlockDataOutput &ob : outputs) {
+			self->apply_data_block_response(ob);
+		}
 	};
 
 	_volume_id = VoxelEngine::get_singleton().add_volume(callbacks);
+	VoxelEngine::get_singleton().set_volume_voxel_data(_volume_id, _data);
 
 	// TODO Can't setup a default mesher anymore due to a Godot 4 warning...
 	// For ease of use in editor
@@ -126,6 +142,43 @@ bool VoxelTerrain::get_generator_use_gpu() const {
 	return _generator_use_gpu;
 }
 
+void VoxelTerrain::set_palette_compression_enabled(bool enabled) {
+	_data->set_palette_compression_enabled(enabled);
+}
+
+bool VoxelTerrain::is_palette_compression_enabled() const {
+	return _data->is_palette_compression_enabled();
+}
+
+void VoxelTerrain::set_occlusion_culling_enabled(bool enabled) {
+	if (_occlusion_culling_enabled == enabled) {
+		return;
+	}
+	_occlusion_culling_enabled = enabled;
+	if (enabled) {
+		_occlusion_culling_dirty = true;
+	} else {
+		clear_occlusion_culling();
+	}
+}
+
+bool VoxelTerrain::is_occlusion_culling_enabled() const {
+	return _occlusion_culling_enabled;
+}
+
+void VoxelTerrain::set_threaded_update_enabled(bool enabled) {
+	if (enabled != _threaded_update_enabled) {
+		if (_threaded_update_enabled) {
+			_update_data->wait_for_end_of_task();
+		}
+		_threaded_update_enabled = enabled;
+	}
+}
+
+bool VoxelTerrain::is_threaded_update_enabled() const {
+	return _threaded_update_enabled;
+}
+
 void VoxelTerrain::set_stream(Ref<VoxelStream> p_stream) {
 	if (p_stream == get_stream()) {
 		return;
@@ -226,14 +279,17 @@ void VoxelTerrain::set_mesh_block_size(unsigned int mesh_block_size) {
 		return;
 	}
 
+	_update_data->wait_for_end_of_task();
+
 	_mesh_block_size_po2 = po2;
 
 	// Unload all mesh blocks regardless of refcount
 	clear_mesh_map();
 
 	// Make paired viewers re-view the new meshable area
-	for (unsigned int i = 0; i < _paired_viewers.size(); ++i) {
-		PairedViewer &viewer = _paired_viewers[i];
+	StdVector<VoxelTerrainUpdateData::PairedViewer> &paired_viewers = _update_data->state.paired_viewers;
+	for (unsigned int i = 0; i < paired_viewers.size(); ++i) {
+		VoxelTerrainUpdateData::PairedViewer &viewer = paired_viewers[i];
 		// Resetting both because it's a re-initialization.
 		// We could also be doing that before or after their are shifted.
 		viewer.state.mesh_box = Box3i();
@@ -320,7 +376,7 @@ void VoxelTerrain::get_viewers_in_area(StdVector<ViewerID> &out_viewer_ids, Box3
 	const Box3i block_box = voxel_box.downscaled(get_data_block_size());
 
 	for (auto it = _paired_viewers.begin(); it != _paired_viewers.end(); ++it) {
-		const PairedViewer &viewer = *it;
+		const VoxelTerrainUpdateData::PairedViewer &viewer = *it;
 
 		if (viewer.state.data_box.intersects(block_box)) {
 			out_viewer_ids.push_back(viewer.id);
@@ -382,8 +438,10 @@ void VoxelTerrain::set_block_enter_notification_enabled(bool enable) {
 	_block_enter_notification_enabled = enable;
 
 	if (enable == false) {
-		for (auto it = _loading_blocks.begin(); it != _loading_blocks.end(); ++it) {
-			LoadingBlock &lb = it->second;
+		VoxelTerrainUpdateData::State &state = _update_data->state;
+		MutexLock mlock(state.loading_blocks_mutex);
+		for (auto it = state.loading_blocks.begin(); it != state.loading_blocks.end(); ++it) {
+			VoxelTerrainUpdateData::LoadingBlock &lb = it->second;
 			lb.viewers_to_notify.clear();
 		}
 	}
@@ -409,112 +467,14 @@ bool VoxelTerrain::is_automatic_loading_enabled() const {
 	return _automatic_loading_enabled;
 }
 
-void VoxelTerrain::try_schedule_mesh_update(VoxelMeshBlockVT &mesh_block) {
-	ZN_PROFILE_SCOPE();
-	if (mesh_block.is_in_update_list) {
-		// Already in the list
-		return;
-	}
-	if (mesh_block.mesh_viewers.get() == 0 && mesh_block.collision_viewers.get() == 0) {
-		// No viewers want mesh on this block (why even call this function then?)
-		return;
-	}
-
-	const int render_to_data_factor = get_mesh_block_size() / get_data_block_size();
-
-	const Box3i data_box =
-			Box3i(mesh_block.position * render_to_data_factor, Vector3iUtil::create(render_to_data_factor)).padded(1);
-
-	// If we get an empty box at this point, something is wrong with the caller
-	ZN_ASSERT_RETURN(!data_box.is_empty());
-
-	const bool data_available = _data->has_all_blocks_in_area(data_box, 0);
-
-	if (data_available) {
-		// Regardless of if the updater is updating the block already,
-		// the block could have been modified again so we schedule another update
-		mesh_block.is_in_update_list = true;
-		_blocks_pending_update.push_back(mesh_block.position);
-	}
-}
-
-void VoxelTerrain::view_mesh_block(Vector3i bpos, bool mesh_flag, bool collision_flag) {
-	if (mesh_flag == false && collision_flag == false) {
-		// Why even call the function?
-		return;
-	}
-
-	VoxelMeshBlockVT *block = _mesh_map.get_block(bpos);
-
-	if (block == nullptr) {
-		// Create if not found
-		block = ZN_NEW(VoxelMeshBlockVT(bpos, get_mesh_block_size()));
-		block->set_world(get_world_3d());
-		_mesh_map.set_block(bpos, block);
-	}
-	CRASH_COND(block == nullptr);
-
-	if (mesh_flag) {
-		block->mesh_viewers.add();
-	}
-	if (collision_flag) {
-		block->collision_viewers.add();
-	}
-
-	// This is needed in case a viewer wants to view meshes in places data blocks are already present.
-	// Before that, meshes were updated only when a data block was loaded or modified,
-	// so changing block size or viewer flags did not make meshes appear.
-	try_schedule_mesh_update(*block);
-
-	// TODO this logic schedules a mesh update even if there is a mesh already. It hides the fact that mixing up
-	// viewers with collisions and viewers without will not actually create colliders/meshes individually.
-
-	// TODO viewers with varying flags during the game is not supported at the moment.
-	// They have to be re-created, which may cause world re-load...
-}
-
-void VoxelTerrain::unview_mesh_block(Vector3i bpos, bool mesh_flag, bool collision_flag) {
-	VoxelMeshBlockVT *block = _mesh_map.get_block(bpos);
-	// Mesh blocks are created on first view call,
-	// so that would mean we unview one without viewing it in the first place
-	ERR_FAIL_COND(block == nullptr);
-
-	if (mesh_flag) {
-		block->mesh_viewers.remove();
-		if (block->mesh_viewers.get() == 0) {
-			// Mesh no longer required
-			block->drop_mesh();
-			block->set_visible(false);
-		}
-	}
-
-	if (collision_flag) {
-		block->collision_viewers.remove();
-		if (block->collision_viewers.get() == 0) {
-			// Collision no longer required
-			block->drop_collision();
-			block->set_collision_enabled(false);
-		}
-	}
-
-	if (block->mesh_viewers.get() == 0 && block->collision_viewers.get() == 0) {
-		unload_mesh_block(bpos);
-	}
-}
-
 void VoxelTerrain::unload_mesh_block(Vector3i bpos) {
-	StdVector<Vector3i> &blocks_pending_update = _blocks_pending_update;
-
 	bool was_loaded = false;
-	_mesh_map.remove_block(bpos, [&blocks_pending_update, &was_loaded](const VoxelMeshBlockVT &block) {
-		if (block.is_in_update_list) {
-			// That block was in the list of blocks to update later in the process loop, we'll need to unregister
-			// it. We expect that block to be in that list. If it isn't, something wrong happened with its state.
-			ERR_FAIL_COND(!unordered_remove_value(blocks_pending_update, block.position));
-		}
+	_mesh_map.remove_block(bpos, [&was_loaded](const VoxelMeshBlockVT &block) { //
 		was_loaded = block.is_loaded;
 	});
 
+	_occlusion_culling_dirty = true;
+
 	if (_instancer != nullptr) {
 		_instancer->on_mesh_block_exit(bpos, 0);
 	}
@@ -525,7 +485,7 @@ void VoxelTerrain::unload_mesh_block(Vector3i bpos) {
 	}
 }
 
-void VoxelTerrain::save_all_modified_blocks(bool with_copy, std::shared_ptr<AsyncDependencyTracker> tracker) {
+void VoxelTerrain::save_all_modified_blocks(std::shared_ptr<AsyncDependencyTracker> tracker) {
 	ZN_PROFILE_SCOPE();
 	Ref<VoxelStream> stream = get_stream();
 	ERR_FAIL_COND_MSG(stream.is_null(), "Attempting to save modified blocks, but there is no stream to save them to.");
@@ -533,7 +493,10 @@ void VoxelTerrain::save_all_modified_blocks(bool with_copy, std::shared_ptr<Asyn
 	BufferedTaskScheduler &task_scheduler = BufferedTaskScheduler::get_for_current_thread();
 
 	// That may cause a stutter, so should be used when the player won't notice
-	_data->consume_all_modifications(_blocks_to_save, with_copy);
+	_data->consume_all_modifications(_blocks_to_save);
+	SaveBlockDataTask::assign_save_priorities_by_viewer_distance(
+			to_span(_blocks_to_save), get_global_transform(), get_data_block_size()
+	);
 
 	if (stream.is_valid() && _instancer != nullptr && stream->supports_instance_blocks()) {
 		_instancer->save_all_modified_blocks(task_scheduler, tracker, true);
@@ -609,6 +572,34 @@ Dictionary VoxelTerrain::_b_get_statistics() const {
 	d["dropped_block_meshs"] = _stats.dropped_block_meshs;
 	d["updated_blocks"] = _stats.updated_blocks;
 
+	d["prefetched_blocks"] = _stats.prefetched_blocks;
+	d["prefetch_hits"] = _stats.prefetch_hits;
+	d["prefetch_misses"] = _stats.prefetch_misses;
+	d["prefetch_cancelled"] = _stats.prefetch_cancelled;
+
+	// Depth of this volume's share of the task queues, useful to compare with other volumes
+	{
+		VoxelTerrainUpdateData::State &state = _update_data->state;
+		MutexLock mlock(state.loading_blocks_mutex);
+		d["pending_block_loads"] = static_cast<int>(state.loading_blocks.size());
+	}
+
+	return d;
+}
+
+Dictionary VoxelTerrain::_b_get_memory_breakdown() const {
+	ZN_PROFILE_SCOPE();
+	uint64_t vertex_count = 0;
+	uint64_t index_count = 0;
+	_mesh_map.for_each_block([&vertex_count, &index_count](const VoxelMeshBlockVT &block) {
+		block.get_mesh_size(vertex_count, index_count);
+	});
+
+	Dictionary d;
+	d["voxel_data"] = godot::get_voxel_data_memory_breakdown(*_data);
+	d["mesh_blocks"] = _mesh_map.get_block_count();
+	d["mesh_vertices"] = ZN_SIZE_T_TO_VARIANT(vertex_count);
+	d["mesh_indices"] = ZN_SIZE_T_TO_VARIANT(index_count);
 	return d;
 }
 
@@ -635,20 +626,24 @@ void VoxelTerrain::stop_updater() {
 	// TODO We can still receive a few mesh delayed mesh updates after this. Is it a problem?
 	//_reception_buffers.mesh_output.clear();
 
-	for (const Vector3i bpos : _blocks_pending_update) {
-		VoxelMeshBlockVT *block = _mesh_map.get_block(bpos);
-		if (block != nullptr) {
-			block->is_in_update_list = false;
+	_update_data->wait_for_end_of_task();
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+
+	for (const Vector3i bpos : state.blocks_pending_update) {
+		auto it = state.mesh_blocks.find(bpos);
+		if (it != state.mesh_blocks.end()) {
+			it->second.is_in_update_list = false;
 		}
 	}
 
-	_blocks_pending_update.clear();
+	state.blocks_pending_update.clear();
 }
 
 void VoxelTerrain::remesh_all_blocks() {
-	_mesh_map.for_each_block([this](VoxelMeshBlockVT &block) { //
-		try_schedule_mesh_update(block);
-	});
+	// Scheduled by the next update
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+	MutexLock mlock(state.pending_inputs_mutex);
+	state.remesh_all_blocks = true;
 }
 
 // At the moment, this function is for client-side use case in multiplayer scenarios
@@ -657,7 +652,11 @@ void VoxelTerrain::generate_block_async(Vector3i block_position) {
 		// Already exists
 		return;
 	}
-	if (_loading_blocks.find(block_position) != _loading_blocks.end()) {
+
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+	MutexLock mlock(state.loading_blocks_mutex);
+
+	if (state.loading_blocks.find(block_position) != state.loading_blocks.end()) {
 		// Already loading
 		return;
 	}
@@ -666,13 +665,17 @@ void VoxelTerrain::generate_block_async(Vector3i block_position) {
 	// 	new_loading_block.viewers_to_notify.push_back(viewer_id);
 	// }
 
-	LoadingBlock new_loading_block;
+	VoxelTerrainUpdateData::LoadingBlock new_loading_block;
 	const Box3i block_box(_data->block_to_voxel(block_position), Vector3iUtil::create(_data->get_block_size()));
+	// Using the snapshot of paired viewers from the last completed update
 	for (size_t i = 0; i < _paired_viewers.size(); ++i) {
-		const PairedViewer &viewer = _paired_viewers[i];
+		const VoxelTerrainUpdateData::PairedViewer &viewer = _paired_viewers[i];
 		if (viewer.state.data_box.intersects(block_box)) {
 			new_loading_block.viewers.add();
 		}
+		if (viewer.state.prefetch_box.intersects(block_box)) {
+			new_loading_block.viewers.add();
+		}
 	}
 
 	if (new_loading_block.viewers.get() == 0) {
@@ -681,8 +684,8 @@ void VoxelTerrain::generate_block_async(Vector3i block_position) {
 
 	// Schedule a loading request
 	// TODO This could also end up loading from stream
-	_loading_blocks.insert({ block_position, new_loading_block });
-	_blocks_pending_load.push_back(block_position);
+	state.loading_blocks.insert({ block_position, new_loading_block });
+	state.blocks_pending_load.push_back(block_position);
 }
 
 void VoxelTerrain::start_streamer() {
@@ -695,10 +698,13 @@ void VoxelTerrain::stop_streamer() {
 	StreamingDependency::reset(_streaming_dependency, get_stream(), get_generator());
 	// VoxelEngine::get_singleton().set_volume_stream(_volume_id, Ref<VoxelStream>());
 	// VoxelEngine::get_singleton().set_volume_generator(_volume_id, Ref<VoxelGenerator>());
-	_loading_blocks.clear();
-	_blocks_pending_load.clear();
-	_quick_reloading_blocks.clear();
-	_unloaded_saving_blocks.clear();
+
+	_update_data->wait_for_end_of_task();
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+	state.loading_blocks.clear();
+	state.blocks_pending_load.clear();
+	state.quick_reloading_blocks.clear();
+	state.unloaded_saving_blocks.clear();
 }
 
 void VoxelTerrain::clear_mesh_map() {
@@ -719,11 +725,24 @@ void VoxelTerrain::clear_mesh_map() {
 	}
 
 	_mesh_map.clear();
+	_occlusion_culling_dirty = true;
+
+	_update_data->wait_for_end_of_task();
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+	state.mesh_blocks.clear();
+	state.blocks_pending_update.clear();
+	state.mesh_blocks_to_create.clear();
+	state.mesh_blocks_to_unload.clear();
+	state.mesh_blocks_to_drop_visuals.clear();
+	state.mesh_blocks_to_drop_collisions.clear();
 }
 
 void VoxelTerrain::reset_map() {
 	// Discard everything, to reload it all
 
+	_update_data->wait_for_end_of_task();
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+
 	_data->for_each_block_position([this](const Vector3i &bpos) { //
 		emit_data_block_unloaded(bpos);
 	});
@@ -731,12 +750,15 @@ void VoxelTerrain::reset_map() {
 
 	clear_mesh_map();
 
-	_loading_blocks.clear();
-	_blocks_pending_load.clear();
-	_blocks_pending_update.clear();
+	state.loading_blocks.clear();
+	state.blocks_pending_load.clear();
+	state.quick_reloading_blocks.clear();
+	state.unloaded_data_blocks.clear();
+	state.block_enter_notifications.clear();
 	_blocks_to_save.clear();
 
 	// No need to care about refcounts, we drop everything anyways. Will pair it back on next process.
+	state.paired_viewers.clear();
 	_paired_viewers.clear();
 
 	Ref<VoxelGenerator> generator = get_generator();
@@ -749,22 +771,15 @@ void VoxelTerrain::post_edit_voxel(Vector3i pos) {
 	post_edit_area(Box3i(pos, Vector3i(1, 1, 1)), true);
 }
 
-void VoxelTerrain::try_schedule_mesh_update_from_data(const Box3i &box_in_voxels) {
-	ZN_PROFILE_SCOPE();
+void VoxelTerrain::try_schedule_mesh_update_from_data(const Box3i &box_in_voxels, bool from_edit) {
 	if (_mesher.is_null()) {
 		// No mesher, can't do updates
 		return;
 	}
-	// We pad by 1 because neighbor blocks might be affected visually (for example, baked ambient occlusion)
-	const Box3i mesh_box = box_in_voxels.padded(1).downscaled(get_mesh_block_size());
-	mesh_box.for_each_cell([this](Vector3i pos) {
-		VoxelMeshBlockVT *block = _mesh_map.get_block(pos);
-		// There isn't necessarily a mesh block, if the edit happens in a boundary,
-		// or if it is done next to a viewer that doesn't need meshes
-		if (block != nullptr) {
-			try_schedule_mesh_update(*block);
-		}
-	});
+	// Mesh blocks are looked up and scheduled by the next update
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+	MutexLock mlock(state.pending_inputs_mutex);
+	state.areas_to_remesh.push_back(VoxelTerrainUpdateData::AreaToRemesh{ box_in_voxels, from_edit });
 }
 
 void VoxelTerrain::post_edit_area(Box3i box_in_voxels, bool update_mesh) {
@@ -778,14 +793,12 @@ void VoxelTerrain::post_edit_area(Box3i box_in_voxels, bool update_mesh) {
 	}
 
 	if (_multiplayer_synchronizer != nullptr && _multiplayer_synchronizer->is_server()) {
-		// TODO This is not efficient when the user does many individual modifications in a specific area.
-		// We would either have to batch modified areas somehow, or expose a transactional API to the user
-		// (begin(area), edit in area, end(area))
+		// Modifications are batched by the synchronizer and sent at the end of the frame
 		_multiplayer_synchronizer->send_area(box_in_voxels);
 	}
 
 	if (update_mesh) {
-		try_schedule_mesh_update_from_data(box_in_voxels);
+		try_schedule_mesh_update_from_data(box_in_voxels, true);
 
 		if (_instancer != nullptr) {
 			_instancer->on_area_edited(box_in_voxels);
@@ -885,158 +898,6 @@ void VoxelTerrain::_notification(int p_what) {
 	}
 }
 
-namespace {
-
-Vector3i get_block_center(Vector3i pos, int bs) {
-	return pos * bs + Vector3iUtil::create(bs / 2);
-}
-
-void init_sparse_grid_priority_dependency(
-		PriorityDependency &dep,
-		Vector3i block_position,
-		int block_size,
-		std::shared_ptr<PriorityDependency::ViewersData> &shared_viewers_data,
-		const Transform3D &volume_transform
-) {
-	const Vector3i voxel_pos = get_block_center(block_position, block_size);
-	const float block_radius = block_size / 2;
-	dep.shared = shared_viewers_data;
-	dep.world_position = to_vec3f(volume_transform.xform(voxel_pos));
-	const float transformed_block_radius =
-			volume_transform.basis.xform(Vector3(block_radius, block_radius, block_radius)).length();
-
-	// Distance beyond which no field of view can overlap the block.
-	// Doubling block radius to account for an extra margin of blocks,
-	// since they are used to provide neighbors when meshing
-	dep.drop_distance_squared =
-			math::squared(shared_viewers_data->highest_view_distance + 2.f * transformed_block_radius);
-}
-
-void request_block_load(
-		VolumeID volume_id,
-		std::shared_ptr<StreamingDependency> stream_dependency,
-		Vector3i block_pos,
-		std::shared_ptr<PriorityDependency::ViewersData> &shared_viewers_data,
-		const Transform3D volume_transform,
-		BufferedTaskScheduler &scheduler,
-		bool use_gpu,
-		const std::shared_ptr<VoxelData> &voxel_data
-) {
-	ZN_ASSERT(stream_dependency != nullptr);
-
-	if (use_gpu && (stream_dependency->generator.is_null() || !stream_dependency->generator->supports_shaders())) {
-		use_gpu = false;
-	}
-
-	const unsigned int data_block_size = voxel_data->get_block_size();
-
-	if (stream_dependency->stream.is_valid()) {
-		PriorityDependency priority_dependency;
-		init_sparse_grid_priority_dependency(
-				priority_dependency, block_pos, data_block_size, shared_viewers_data, volume_transform
-		);
-
-		const bool request_instances = false;
-		LoadBlockDataTask *task = ZN_NEW(LoadBlockDataTask(
-				volume_id,
-				block_pos,
-				0,
-				data_block_size,
-				request_instances,
-				stream_dependency,
-				priority_dependency,
-				true,
-				use_gpu,
-				voxel_data,
-				TaskCancellationToken()
-		));
-
-		scheduler.push_io_task(task);
-
-	} else {
-		// Directly generate the block without checking the stream
-		ERR_FAIL_COND(stream_dependency->generator.is_null());
-
-		VoxelGenerator::BlockTaskParams params;
-		params.volume_id = volume_id;
-		params.block_position = block_pos;
-		params.block_size = data_block_size;
-		params.stream_dependency = stream_dependency;
-		params.use_gpu = use_gpu;
-		params.data = voxel_data;
-
-		init_sparse_grid_priority_dependency(
-				params.priority_dependency, block_pos, data_block_size, shared_viewers_data, volume_transform
-		);
-
-		IThreadedTask *task = stream_dependency->generator->create_block_task(params);
-
-		scheduler.push_main_task(task);
-	}
-}
-
-} // namespace
-
-void VoxelTerrain::send_data_load_requests() {
-	ZN_PROFILE_SCOPE();
-
-	if (_blocks_pending_load.size() > 0) {
-		std::shared_ptr<PriorityDependency::ViewersData> shared_viewers_data =
-				VoxelEngine::get_singleton().get_shared_viewers_data_from_default_world();
-
-		const Transform3D volume_transform = get_global_transform();
-
-		BufferedTaskScheduler &scheduler = BufferedTaskScheduler::get_for_current_thread();
-
-		// Blocks to load
-		for (size_t i = 0; i < _blocks_pending_load.size(); ++i) {
-			const Vector3i block_pos = _blocks_pending_load[i];
-
-			auto saving_block_it = _unloaded_saving_blocks.find(block_pos);
-			const bool quick_reloading = saving_block_it != _unloaded_saving_blocks.end();
-
-			if (quick_reloading) {
-				ZN_PROFILE_SCOPE_NAMED("Quick reloading");
-				// The block is unloaded and currently waiting to be saved but we already want it back. This simulates a
-				// request and will complete on the next process.
-				// Ideally this shouldn't happen often. This is a corner case that occurs if the player moves fast
-				// back and forth or the task runner is overloaded.
-				std::shared_ptr<VoxelBuffer> voxel_data =
-						make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
-				// Duplicating to make sure the saving version doesn't get altered by possible upcoming modifications.
-				saving_block_it->second->copy_to(*voxel_data, true);
-				_quick_reloading_blocks.push_back(QuickReloadingBlock{ voxel_data, block_pos });
-				// Don't erase it just yet, we may only do this once we know it is saved
-				// _unloaded_saving_blocks.erase(saving_block_it);
-
-				// Notes:
-				// Could we change the design so that saving tasks actually save a box of VoxelData?
-				// To do that we would have to NOT remove data blocks of which refcount becomes 0. Instead, ownership
-				// would sort of be given to a saving task. That task would make a copy of modified chunks and only then
-				// remove them if they still have 0 viewers.
-				// If a viewer moves back into the area, it would simply find the chunks again and no loading would be
-				// needed. If those chunks get modified while saving is underway, it would still work fine as the saving
-				// task would lock the saved regions for reading (which is currently a problem already, because no
-				// locking actually occurs!).
-
-			} else {
-				request_block_load(
-						_volume_id,
-						_streaming_dependency,
-						block_pos,
-						shared_viewers_data,
-						volume_transform,
-						scheduler,
-						_generator_use_gpu,
-						_data
-				);
-			}
-		}
-		scheduler.flush();
-		_blocks_pending_load.clear();
-	}
-}
-
 void VoxelTerrain::consume_block_data_save_requests(
 		BufferedTaskScheduler &task_scheduler,
 		std::shared_ptr<AsyncDependencyTracker> saving_tracker,
@@ -1044,23 +905,15 @@ void VoxelTerrain::consume_block_data_save_requests(
 ) {
 	ZN_PROFILE_SCOPE();
 
-	// Blocks to save
-	if (get_stream().is_valid()) {
-		for (const VoxelData::BlockToSave &b : _blocks_to_save) {
-			ZN_PRINT_VERBOSE(format("Requesting save of block {}", b.position));
-
-			SaveBlockDataTask *task = ZN_NEW(SaveBlockDataTask(
-					_volume_id, b.position, 0, b.voxels, _streaming_dependency, saving_tracker, with_flush
-			));
-
-			// No priority data, saving doesn't need sorting.
-			task_scheduler.push_io_task(task);
-		}
-	} else {
-		if (_blocks_to_save.size() > 0) {
-			ZN_PRINT_VERBOSE(format("Not saving {} blocks because no stream is assigned", _blocks_to_save.size()));
-		}
-	}
+	VoxelTerrainUpdateTask::send_block_save_requests(
+			_volume_id,
+			to_span(_blocks_to_save),
+			_data,
+			_streaming_dependency,
+			task_scheduler,
+			saving_tracker,
+			with_flush
+	);
 
 	// print_line(String("Sending {0} block requests").format(varray(input.blocks_to_emerge.size())));
 	_blocks_to_save.clear();
@@ -1100,17 +953,6 @@ void VoxelTerrain::emit_mesh_block_exited(Vector3i bpos) {
 	emit_signal(VoxelStringNames::get_singleton().mesh_block_exited, bpos);
 }
 
-bool VoxelTerrain::try_get_paired_viewer_index(ViewerID id, size_t &out_i) const {
-	for (size_t i = 0; i < _paired_viewers.size(); ++i) {
-		const PairedViewer &p = _paired_viewers[i];
-		if (p.id == id) {
-			out_i = i;
-			return true;
-		}
-	}
-	return false;
-}
-
 // TODO It is unclear yet if this API will stay. I have a feeling it might consume a lot of CPU
 void VoxelTerrain::notify_data_block_enter(const VoxelDataBlock &block, Vector3i bpos, ViewerID viewer_id) {
 	if (!VoxelEngine::get_singleton().viewer_exists(viewer_id)) {
@@ -1133,7 +975,7 @@ void VoxelTerrain::notify_data_block_enter(const VoxelDataBlock &block, Vector3i
 
 	if (_multiplayer_synchronizer != nullptr && !Engine::get_singleton()->is_editor_hint() &&
 		network_peer_id != MultiplayerPeer::TARGET_PEER_SERVER && _multiplayer_synchronizer->is_server()) {
-		_multiplayer_synchronizer->send_block(network_peer_id, block, bpos);
+		_multiplayer_synchronizer->send_block(network_peer_id, bpos);
 	}
 }
 
@@ -1148,443 +990,199 @@ void VoxelTerrain::process() {
 		}
 	}
 
-	{
-		for (const QuickReloadingBlock &qrb : _quick_reloading_blocks) {
-			VoxelEngine::BlockDataOutput ob{
-				VoxelEngine::BlockDataOutput::TYPE_LOADED, //
-				qrb.voxels, //
-				// TODO This doesn't work with VoxelInstancer because it unloads based on meshes...
-				nullptr, //
-				qrb.position, //
-				0, // lod_index
-				false, // dropped
-				false, // max_lod_hint
-				false, // initial_load
-				false, // had_instances
-				true // had_voxels
-			};
-			apply_data_block_response(ob);
-		}
-		_quick_reloading_blocks.clear();
-	}
+	if (_update_data->task_is_complete) {
+		ZN_PROFILE_SCOPE_NAMED("Update");
 
-	process_viewers();
-	// process_received_data_blocks();
-	process_meshing();
+		apply_main_thread_update_tasks();
 
-#ifdef TOOLS_ENABLED
-	if (debug_is_draw_enabled() && is_visible_in_tree()) {
-		process_debug_draw();
-	}
-#endif
-}
-
-void VoxelTerrain::process_viewers() {
-	ProfilingClock profiling_clock;
-
-	// Ordered by ascending index in paired viewers list
-	StdVector<size_t> unpaired_viewer_indexes;
+		const bool can_load_blocks =
+				((_automatic_loading_enabled &&
+				  (_multiplayer_synchronizer == nullptr || _multiplayer_synchronizer->is_server())) &&
+				 (get_stream().is_valid() || get_generator().is_valid())) &&
+				(Engine::get_singleton()->is_editor_hint() == false || _run_stream_in_editor);
 
-	// Update viewers
-	{
-		// Our node doesn't have bounds yet, so for now viewers are always paired.
-		// TODO Update: the node has bounds now, need to change this
-
-		// Destroyed viewers
-		for (size_t i = 0; i < _paired_viewers.size(); ++i) {
-			PairedViewer &p = _paired_viewers[i];
-			if (!VoxelEngine::get_singleton().viewer_exists(p.id)) {
-				ZN_PRINT_VERBOSE(format("Detected destroyed viewer {} in VoxelTerrain", p.id));
-				// Interpret removal as nullified view distance so the same code handling loading of blocks
-				// will be used to unload those viewed by this viewer.
-				// We'll actually remove unpaired viewers in a second pass.
-				p.state.vertical_view_distance_voxels = 0;
-				p.state.horizontal_view_distance_voxels = 0;
-				// Also update boxes, they won't be updated since the viewer has been removed.
-				// Assign prev state, otherwise in some cases resetting boxes would make them equal to prev state,
-				// therefore causing no unload
-				p.prev_state = p.state;
-				p.state.data_box = Box3i();
-				p.state.mesh_box = Box3i();
-				unpaired_viewer_indexes.push_back(i);
-			}
+		// Blocks explicitly requested for saving
+		if (can_load_blocks && _blocks_to_save.size() > 0) {
+			BufferedTaskScheduler &task_scheduler = BufferedTaskScheduler::get_for_current_thread();
+			consume_block_data_save_requests(task_scheduler, nullptr, false);
+			task_scheduler.flush();
 		}
 
-		const Transform3D local_to_world_transform = get_global_transform();
-		const Transform3D world_to_local_transform = local_to_world_transform.affine_inverse();
-
-		// Note, this does not support non-uniform scaling
-		// TODO There is probably a better way to do this
-		const float view_distance_scale = world_to_local_transform.basis.xform(Vector3(1, 0, 0)).length();
-
-		const Box3i bounds_in_voxels = _data->get_bounds();
-
-		const Box3i bounds_in_data_blocks = bounds_in_voxels.downscaled(get_data_block_size());
-		const Box3i bounds_in_mesh_blocks = bounds_in_voxels.downscaled(get_mesh_block_size());
-
-		struct UpdatePairedViewer {
-			VoxelTerrain &self;
-			const Box3i bounds_in_data_blocks;
-			const Box3i bounds_in_mesh_blocks;
-			const Transform3D world_to_local_transform;
-			const float view_distance_scale;
-
-			inline void operator()(ViewerID viewer_id, const VoxelEngine::Viewer &viewer) {
-				size_t paired_viewer_index;
-				if (!self.try_get_paired_viewer_index(viewer_id, paired_viewer_index)) {
-					// New viewer
-					PairedViewer p;
-					p.id = viewer_id;
-					paired_viewer_index = self._paired_viewers.size();
-					self._paired_viewers.push_back(p);
-					ZN_PRINT_VERBOSE(format("Pairing viewer {} to VoxelTerrain", viewer_id));
-				}
-
-				PairedViewer &paired_viewer = self._paired_viewers[paired_viewer_index];
-				paired_viewer.prev_state = paired_viewer.state;
-				PairedViewer::State &state = paired_viewer.state;
-
-				const unsigned int view_distance_voxels_h = static_cast<unsigned int>(
-						static_cast<float>(viewer.view_distances.horizontal) * view_distance_scale
-				);
-				const unsigned int view_distance_voxels_v = static_cast<unsigned int>(
-						static_cast<float>(viewer.view_distances.vertical) * view_distance_scale
-				);
-
-				const Vector3 local_position = world_to_local_transform.xform(viewer.world_position);
-
-				state.horizontal_view_distance_voxels =
-						math::min(view_distance_voxels_h, self._max_view_distance_voxels);
-				state.vertical_view_distance_voxels = math::min(view_distance_voxels_v, self._max_view_distance_voxels);
-
-				state.local_position_voxels = math::floor_to_int(local_position);
-				state.requires_collisions = VoxelEngine::get_singleton().is_viewer_requiring_collisions(viewer_id);
-				state.requires_meshes =
-						VoxelEngine::get_singleton().is_viewer_requiring_visuals(viewer_id) && self._mesher.is_valid();
-
-				// Update data and mesh view boxes
-
-				const int data_block_size = self.get_data_block_size();
-				const int mesh_block_size = self.get_mesh_block_size();
-
-				int view_distance_data_blocks_h;
-				int view_distance_data_blocks_v;
-				Vector3i data_block_pos;
-
-				if (state.requires_meshes || state.requires_collisions) {
-					const int view_distance_mesh_blocks_h =
-							math::ceildiv(state.horizontal_view_distance_voxels, mesh_block_size);
-					const int view_distance_mesh_blocks_v =
-							math::ceildiv(state.vertical_view_distance_voxels, mesh_block_size);
-
-					const int render_to_data_factor = (mesh_block_size / data_block_size);
-					const Vector3i mesh_block_pos = math::floordiv(state.local_position_voxels, mesh_block_size);
-
-					// Adding one block of padding because meshing requires neighbors
-					view_distance_data_blocks_h = view_distance_mesh_blocks_h * render_to_data_factor + 1;
-					view_distance_data_blocks_v = view_distance_mesh_blocks_v * render_to_data_factor + 1;
-
-					data_block_pos = mesh_block_pos * render_to_data_factor;
-					state.mesh_box = Box3i::from_center_extents(
-											 mesh_block_pos,
-											 Vector3i(
-													 view_distance_mesh_blocks_h,
-													 view_distance_mesh_blocks_v,
-													 view_distance_mesh_blocks_h
-											 )
-					)
-											 .clipped(bounds_in_mesh_blocks);
-
-				} else {
-					view_distance_data_blocks_h = math::ceildiv(state.horizontal_view_distance_voxels, data_block_size);
-					view_distance_data_blocks_v = math::ceildiv(state.vertical_view_distance_voxels, data_block_size);
-
-					data_block_pos = math::floordiv(state.local_position_voxels, data_block_size);
-					state.mesh_box = Box3i();
-				}
-
-				state.data_box = Box3i::from_center_extents(
-										 data_block_pos,
-										 Vector3i(
-												 view_distance_data_blocks_h,
-												 view_distance_data_blocks_v,
-												 view_distance_data_blocks_h
-										 )
-				)
-										 .clipped(bounds_in_data_blocks);
-			}
-		};
-
-		// New viewers and updates. Removed viewers won't be iterated but are still paired until later.
-		UpdatePairedViewer u{
-			*this, bounds_in_data_blocks, bounds_in_mesh_blocks, world_to_local_transform, view_distance_scale
-		};
-		VoxelEngine::get_singleton().for_each_viewer(u);
-	}
-
-	const bool can_load_blocks = ((_automatic_loading_enabled &&
-								   (_multiplayer_synchronizer == nullptr || _multiplayer_synchronizer->is_server())) &&
-								  (get_stream().is_valid() || get_generator().is_valid())) &&
-			(Engine::get_singleton()->is_editor_hint() == false || _run_stream_in_editor);
-
-	// Find out which blocks need to appear and which need to be unloaded
-	{
-		ZN_PROFILE_SCOPE();
-
-		for (size_t i = 0; i < _paired_viewers.size(); ++i) {
-			const PairedViewer &viewer = _paired_viewers[i];
-
-			{
-				const Box3i &new_data_box = viewer.state.data_box;
-				const Box3i &prev_data_box = viewer.prev_state.data_box;
-
-				if (prev_data_box != new_data_box) {
-					process_viewer_data_box_change(viewer.id, prev_data_box, new_data_box, can_load_blocks);
-				}
-			}
+		// Settings
+		{
+			VoxelTerrainUpdateData::Settings &settings = _update_data->settings;
+			settings.mesh_block_size_po2 = _mesh_block_size_po2;
+			settings.max_view_distance_voxels = _max_view_distance_voxels;
+			settings.generate_collisions = _generate_collisions;
+			settings.has_mesher = _mesher.is_valid();
+			settings.can_load_blocks = can_load_blocks;
+			settings.can_save_blocks =
+					get_stream().is_valid() && (!Engine::get_singleton()->is_editor_hint() || _run_stream_in_editor);
+			settings.block_enter_notifications_enabled = _block_enter_notification_enabled ||
+					(_multiplayer_synchronizer != nullptr && _multiplayer_synchronizer->is_server());
+			settings.generator_use_gpu = _generator_use_gpu;
+			settings.task_priority = get_task_priority();
+		}
 
-			{
-				const Box3i &new_mesh_box = viewer.state.mesh_box;
-				const Box3i &prev_mesh_box = viewer.prev_state.mesh_box;
-
-				if (prev_mesh_box != new_mesh_box) {
-					ZN_PROFILE_SCOPE();
-
-					// TODO Any reason to unview old blocks before viewing new blocks?
-					// Because if a viewer is removed and another is added, it will reload the whole area even if their
-					// box is the same.
-
-					// Unview blocks that just fell out of range
-					prev_mesh_box.difference(new_mesh_box, [this, &viewer](Box3i out_of_range_box) {
-						out_of_range_box.for_each_cell([this, &viewer](Vector3i bpos) {
-							unview_mesh_block(
-									bpos, viewer.prev_state.requires_meshes, viewer.prev_state.requires_collisions
-							);
-						});
-					});
-
-					// View blocks that just entered the range
-					new_mesh_box.difference(prev_mesh_box, [this, &viewer](Box3i box_to_load) {
-						box_to_load.for_each_cell([this, &viewer](Vector3i bpos) {
-							// Load or update block
-							view_mesh_block(bpos, viewer.state.requires_meshes, viewer.state.requires_collisions);
-						});
-					});
-				}
+		// Copy viewers
+		{
+			VoxelTerrainUpdateData &update_data = *_update_data;
+			update_data.viewers.clear();
+			VoxelEngine::get_singleton().for_each_viewer(
+					[&update_data](ViewerID id, const VoxelEngine::Viewer &viewer) { //
+						update_data.viewers.push_back({ id, viewer });
+					}
+			);
+		}
 
-				// Blocks that remained within range of the viewer may need some changes too if viewer flags were
-				// modified. This operates on a DISTINCT set of blocks than the one above.
+		VoxelTerrainUpdateTask *task = ZN_NEW(VoxelTerrainUpdateTask(
+				_data,
+				_update_data,
+				_streaming_dependency,
+				_meshing_dependency,
+				VoxelEngine::get_singleton().get_shared_viewers_data_from_default_world(),
+				_volume_id,
+				get_global_transform()
+		));
 
-				if (viewer.state.requires_collisions != viewer.prev_state.requires_collisions) {
-					const Box3i box = new_mesh_box.clipped(prev_mesh_box);
-					if (viewer.state.requires_collisions) {
-						box.for_each_cell([this](Vector3i bpos) { //
-							view_mesh_block(bpos, false, true);
-						});
+		_update_data->task_is_complete = false;
 
-					} else {
-						box.for_each_cell([this](Vector3i bpos) { //
-							unview_mesh_block(bpos, false, true);
-						});
-					}
-				}
+		if (_threaded_update_enabled) {
+			VoxelEngine::get_singleton().push_async_task(task);
 
-				if (viewer.state.requires_meshes != viewer.prev_state.requires_meshes) {
-					const Box3i box = new_mesh_box.clipped(prev_mesh_box);
-					if (viewer.state.requires_meshes) {
-						box.for_each_cell([this](Vector3i bpos) { //
-							view_mesh_block(bpos, true, false);
-						});
-
-					} else {
-						box.for_each_cell([this](Vector3i bpos) { //
-							unview_mesh_block(bpos, true, false);
-						});
-					}
-				}
-			}
+		} else {
+			LinearAllocator temp_allocator;
+			ThreadedTaskContext ctx(0, TaskPriority(), temp_allocator);
+			task->run(ctx);
+			ZN_DELETE(task);
+			apply_main_thread_update_tasks();
 		}
 	}
 
-	_stats.time_detect_required_blocks = profiling_clock.restart();
-
-	// We no longer need unpaired viewers.
-	for (size_t i = 0; i < unpaired_viewer_indexes.size(); ++i) {
-		// Iterating backward so indexes of paired viewers that need removal will not change because of the removal
-		// itself
-		const size_t vi = unpaired_viewer_indexes[unpaired_viewer_indexes.size() - i - 1];
-		ZN_PRINT_VERBOSE(format("Unpairing viewer {} from VoxelTerrain", _paired_viewers[vi].id));
-		_paired_viewers[vi] = _paired_viewers.back();
-		_paired_viewers.pop_back();
+	if (_occlusion_culling_enabled) {
+		process_occlusion_culling();
 	}
 
-	// It's possible the user didn't set a stream yet, or it is turned off
-	if (can_load_blocks) {
-		send_data_load_requests();
-		BufferedTaskScheduler &task_scheduler = BufferedTaskScheduler::get_for_current_thread();
-		consume_block_data_save_requests(task_scheduler, nullptr, false);
-		task_scheduler.flush();
+#ifdef TOOLS_ENABLED
+	if (debug_is_draw_enabled() && is_visible_in_tree()) {
+		process_debug_draw();
 	}
-
-	_stats.time_request_blocks_to_load = profiling_clock.restart();
+#endif
 }
 
-void VoxelTerrain::process_viewer_data_box_change(
-		ViewerID viewer_id,
-		Box3i prev_data_box,
-		Box3i new_data_box,
-		bool can_load_blocks
-) {
+void VoxelTerrain::apply_main_thread_update_tasks() {
 	ZN_PROFILE_SCOPE();
-	ZN_ASSERT_RETURN(prev_data_box != new_data_box);
-
-	static thread_local StdVector<Vector3i> tls_missing_blocks;
-	static thread_local StdVector<Vector3i> tls_found_blocks_positions;
-
-	Ref<VoxelGenerator> generator = get_generator();
-	if (generator.is_valid()) {
-		generator->process_viewer_diff(viewer_id, new_data_box, prev_data_box);
+	// Dequeue outputs of the threadable part of the update for actions taking place on the main thread
+
+	CRASH_COND(_update_data->task_is_complete == false);
+
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+
+	for (const VoxelTerrainUpdateData::QuickReloadingBlock &qrb : state.quick_reloading_blocks) {
+		ZN_PROFILE_SCOPE_NAMED("Quick reload");
+		VoxelEngine::BlockDataOutput ob{
+			VoxelEngine::BlockDataOutput::TYPE_LOADED, //
+			qrb.voxels, //
+			// TODO This doesn't work with VoxelInstancer because it unloads based on meshes...
+			nullptr, //
+			qrb.position, //
+			0, // lod_index
+			false, // dropped
+			false, // max_lod_hint
+			false, // initial_load
+			false, // had_instances
+			true // had_voxels
+		};
+		apply_data_block_response(ob);
 	}
+	state.quick_reloading_blocks.clear();
 
-	// Unview blocks that just fell out of range
-	//
-	// TODO Any reason to unview old blocks before viewing new blocks?
-	// Because if a viewer is removed and another is added, it will reload the whole area even if their box is the same.
-	{
-		const bool may_save =
-				get_stream().is_valid() && (!Engine::get_singleton()->is_editor_hint() || _run_stream_in_editor);
-
-		tls_missing_blocks.clear();
-		tls_found_blocks_positions.clear();
-
-		const unsigned int to_save_index0 = _blocks_to_save.size();
-
-		// Decrement refcounts from loaded blocks, and unload them
-		prev_data_box.difference(new_data_box, [this, may_save](Box3i out_of_range_box) {
-			// ZN_PRINT_VERBOSE(format("Unview data box {}", out_of_range_box));
-			_data->unview_area(
-					out_of_range_box,
-					0,
-					&tls_found_blocks_positions,
-					&tls_missing_blocks,
-					may_save ? &_blocks_to_save : nullptr
-			);
-		});
+	// The same position can appear in several lists, if it was viewed and unviewed during the same update. Only the
+	// last state of the block matters, which is the one the update left in `state.mesh_blocks`.
 
-		// Temporarily store unloaded blocks in a map until saving completes
-		for (unsigned int i = to_save_index0; i < _blocks_to_save.size(); ++i) {
-			const VoxelData::BlockToSave &bts = _blocks_to_save[i];
-			_unloaded_saving_blocks[bts.position] = bts.voxels;
+	for (const Vector3i bpos : state.mesh_blocks_to_unload) {
+		if (state.mesh_blocks.find(bpos) == state.mesh_blocks.end()) {
+			unload_mesh_block(bpos);
 		}
+	}
+	state.mesh_blocks_to_unload.clear();
 
-		{
-			ZN_PROFILE_SCOPE_NAMED("Unload signals");
-			// Remove loading blocks (those were loaded and had their refcount reach zero)
-			for (const Vector3i bpos : tls_found_blocks_positions) {
-				emit_data_block_unloaded(bpos);
-				// TODO If they were loaded, why would they be in loading blocks?
-				// Probably in case we move so fast that blocks haven't even finished loading
-				_loading_blocks.erase(bpos);
-			}
+	for (const Vector3i bpos : state.mesh_blocks_to_drop_visuals) {
+		auto it = state.mesh_blocks.find(bpos);
+		if (it == state.mesh_blocks.end() || it->second.mesh_viewers.get() > 0) {
+			continue;
 		}
-
-		// Remove refcount from loading blocks, and cancel loading if it reaches zero
-		{
-			ZN_PROFILE_SCOPE_NAMED("Cancel missing blocks");
-			for (const Vector3i bpos : tls_missing_blocks) {
-				auto loading_block_it = _loading_blocks.find(bpos);
-				if (loading_block_it == _loading_blocks.end()) {
-					ZN_PRINT_VERBOSE("Request to unview a loading block that was never requested");
-					// Not expected, but fine I guess
-					return;
-				}
-
-				LoadingBlock &loading_block = loading_block_it->second;
-				loading_block.viewers.remove();
-
-				if (loading_block.viewers.get() == 0) {
-					// No longer want to load it
-					_loading_blocks.erase(loading_block_it);
-
-					// TODO Do we really need that vector after all?
-					for (size_t i = 0; i < _blocks_pending_load.size(); ++i) {
-						if (_blocks_pending_load[i] == bpos) {
-							_blocks_pending_load[i] = _blocks_pending_load.back();
-							_blocks_pending_load.pop_back();
-							break;
-						}
-					}
-				}
-			}
+		VoxelMeshBlockVT *block = _mesh_map.get_block(bpos);
+		if (block != nullptr) {
+			// Mesh no longer required
+			block->drop_mesh();
+			block->set_visible(false);
 		}
 	}
+	state.mesh_blocks_to_drop_visuals.clear();
 
-	// View blocks coming into range
-	if (can_load_blocks) {
-		const bool require_notifications =
-				(_block_enter_notification_enabled ||
-				 (_multiplayer_synchronizer != nullptr && _multiplayer_synchronizer->is_server())) &&
-				VoxelEngine::get_singleton().viewer_exists(viewer_id) && // Could be a destroyed viewer
-				VoxelEngine::get_singleton().is_viewer_requiring_data_block_notifications(viewer_id);
-
-		static thread_local StdVector<VoxelDataBlock> tls_found_blocks;
-
-		tls_missing_blocks.clear();
-		tls_found_blocks.clear();
-		tls_found_blocks_positions.clear();
-
-		new_data_box.difference(prev_data_box, [this](Box3i box_to_load) {
-			// ZN_PRINT_VERBOSE(format("View data box {}", box_to_load));
-			_data->view_area(box_to_load, 0, &tls_missing_blocks, &tls_found_blocks_positions, &tls_found_blocks);
-		});
-
-		// Schedule loading of missing blocks
-		{
-			ZN_PROFILE_SCOPE_NAMED("Gather missing blocks");
-			for (const Vector3i missing_bpos : tls_missing_blocks) {
-				auto loading_block_it = _loading_blocks.find(missing_bpos);
-
-				if (loading_block_it == _loading_blocks.end()) {
-					// First viewer to request it
-					LoadingBlock new_loading_block;
-					new_loading_block.viewers.add();
-
-					if (require_notifications) {
-						new_loading_block.viewers_to_notify.push_back(viewer_id);
-					}
-
-					_loading_blocks.insert({ missing_bpos, new_loading_block });
-					_blocks_pending_load.push_back(missing_bpos);
+	for (const Vector3i bpos : state.mesh_blocks_to_drop_collisions) {
+		auto it = state.mesh_blocks.find(bpos);
+		if (it == state.mesh_blocks.end() || it->second.collision_viewers.get() > 0) {
+			continue;
+		}
+		VoxelMeshBlockVT *block = _mesh_map.get_block(bpos);
+		if (block != nullptr) {
+			// Collision no longer required
+			block->drop_collision();
+			block->set_collision_enabled(false);
+		}
+	}
+	state.mesh_blocks_to_drop_collisions.clear();
 
-				} else {
-					// More viewers
-					LoadingBlock &loading_block = loading_block_it->second;
-					loading_block.viewers.add();
+	for (const Vector3i bpos : state.mesh_blocks_to_create) {
+		if (state.mesh_blocks.find(bpos) != state.mesh_blocks.end()) {
+			get_or_create_mesh_block(bpos);
+		}
+	}
+	state.mesh_blocks_to_create.clear();
 
-					if (require_notifications) {
-						loading_block.viewers_to_notify.push_back(viewer_id);
-					}
-				}
-			}
+	{
+		ZN_PROFILE_SCOPE_NAMED("Unload signals");
+		for (const Vector3i bpos : state.unloaded_data_blocks) {
+			emit_data_block_unloaded(bpos);
 		}
+		state.unloaded_data_blocks.clear();
+	}
 
-		if (require_notifications) {
-			ZN_PROFILE_SCOPE_NAMED("Enter notifications");
-			// Notifications for blocks that were already loaded
-			for (unsigned int i = 0; i < tls_found_blocks.size(); ++i) {
-				const Vector3i bpos = tls_found_blocks_positions[i];
-				const VoxelDataBlock &block = tls_found_blocks[i];
-				notify_data_block_enter(block, bpos, viewer_id);
-			}
+	{
+		ZN_PROFILE_SCOPE_NAMED("Enter notifications");
+		// Notifications for blocks that were already loaded
+		for (const VoxelTerrainUpdateData::BlockEnterNotification &n : state.block_enter_notifications) {
+			notify_data_block_enter(n.block, n.position, n.viewer_id);
 		}
+		// Holds refcounted stuff, don't keep it around
+		state.block_enter_notifications.clear();
+	}
 
-		// Make sure to clear this because it holds refcounted stuff. If we don't, it could crash on exit because the
-		// voxel engine deinitializes its stuff before thread_locals get destroyed
-		tls_found_blocks.clear();
+	// Snapshot used by functions of the node that need to know where viewers are, while the next update runs
+	_paired_viewers = state.paired_viewers;
+
+	const VoxelTerrainUpdateData::Stats &update_stats = state.stats;
+	_stats.time_detect_required_blocks = update_stats.time_detect_required_blocks;
+	_stats.time_request_blocks_to_load = update_stats.time_request_blocks_to_load;
+	_stats.time_request_blocks_to_update = update_stats.time_request_blocks_to_update;
+	_stats.prefetched_blocks = update_stats.prefetched_blocks;
+	_stats.prefetch_hits = update_stats.prefetch_hits;
+	_stats.prefetch_misses = update_stats.prefetch_misses;
+	_stats.prefetch_cancelled = update_stats.prefetch_cancelled;
+	_stats.dropped_block_meshs = 0;
+}
 
-		// TODO viewers with varying flags during the game is not supported at the moment.
-		// They have to be re-created, which may cause world re-load...
+VoxelMeshBlockVT *VoxelTerrain::get_or_create_mesh_block(Vector3i bpos) {
+	VoxelMeshBlockVT *block = _mesh_map.get_block(bpos);
+	if (block == nullptr) {
+		block = ZN_NEW(VoxelMeshBlockVT(bpos, get_mesh_block_size()));
+		block->set_world(get_world_3d());
+		_mesh_map.set_block(bpos, block);
+		_occlusion_culling_dirty = true;
 	}
+	return block;
 }
 
 void VoxelTerrain::apply_data_block_response(VoxelEngine::BlockDataOutput &ob) {
@@ -1601,7 +1199,9 @@ void VoxelTerrain::apply_data_block_response(VoxelEngine::BlockDataOutput &ob) {
 			// For that to be a problem, you'd have to edit a chunk, move away, move back in, edit it again, move away,
 			// and have the first save complete before the second.
 			// But we may consider adding version numbers, which requires adding block metadata
-			_unloaded_saving_blocks.erase(ob.position);
+			VoxelTerrainUpdateData::State &state = _update_data->state;
+			MutexLock mlock(state.unloaded_saving_blocks_mutex);
+			state.unloaded_saving_blocks.erase(ob.position);
 
 		} else if (ob.had_instances && _instancer != nullptr) {
 			_instancer->on_data_block_saved(ob.position, ob.lod_index);
@@ -1616,8 +1216,12 @@ void VoxelTerrain::apply_data_block_response(VoxelEngine::BlockDataOutput &ob) {
 
 	const Vector3i block_pos = ob.position;
 
+	// Loading blocks are also modified by the update task
+	VoxelTerrainUpdateData::State &state = _update_data->state;
+
 	if (ob.dropped) {
-		if (_loading_blocks.find(block_pos) == _loading_blocks.end()) {
+		MutexLock mlock(state.loading_blocks_mutex);
+		if (state.loading_blocks.find(block_pos) == state.loading_blocks.end()) {
 			// We are no longer expecting this block, ignore
 			return;
 		}
@@ -1634,15 +1238,16 @@ void VoxelTerrain::apply_data_block_response(VoxelEngine::BlockDataOutput &ob) {
 
 		++_stats.dropped_block_loads;
 
-		_blocks_pending_load.push_back(ob.position);
+		state.blocks_pending_load.push_back(ob.position);
 		return;
 	}
 
-	LoadingBlock loading_block;
+	VoxelTerrainUpdateData::LoadingBlock loading_block;
 	{
-		auto loading_block_it = _loading_blocks.find(block_pos);
+		MutexLock mlock(state.loading_blocks_mutex);
+		auto loading_block_it = state.loading_blocks.find(block_pos);
 
-		if (loading_block_it == _loading_blocks.end()) {
+		if (loading_block_it == state.loading_blocks.end()) {
 			// That block was not requested or is no longer needed, drop it.
 			++_stats.dropped_block_loads;
 			return;
@@ -1652,7 +1257,7 @@ void VoxelTerrain::apply_data_block_response(VoxelEngine::BlockDataOutput &ob) {
 		loading_block = std::move(loading_block_it->second);
 
 		// Now we got the block. If we still have to drop it, the cause will be an error.
-		_loading_blocks.erase(loading_block_it);
+		state.loading_blocks.erase(loading_block_it);
 	}
 
 	ZN_ASSERT_RETURN(ob.voxels != nullptr);
@@ -1732,10 +1337,13 @@ bool VoxelTerrain::try_set_block_data(Vector3i position, std::shared_ptr<VoxelBu
 	// Setup viewers count intersecting with this block
 	RefCount refcount;
 	for (unsigned int i = 0; i < _paired_viewers.size(); ++i) {
-		const PairedViewer &viewer = _paired_viewers[i];
+		const VoxelTerrainUpdateData::PairedViewer &viewer = _paired_viewers[i];
 		if (viewer.state.data_box.contains(position)) {
 			refcount.add();
 		}
+		if (viewer.state.prefetch_box.contains(position)) {
+			refcount.add();
+		}
 	}
 
 	if (refcount.get() == 0) {
@@ -1747,7 +1355,11 @@ bool VoxelTerrain::try_set_block_data(Vector3i position, std::shared_ptr<VoxelBu
 	}
 
 	// Cancel loading version if any
-	_loading_blocks.erase(position);
+	{
+		VoxelTerrainUpdateData::State &state = _update_data->state;
+		MutexLock mlock(state.loading_blocks_mutex);
+		state.loading_blocks.erase(position);
+	}
 
 	VoxelDataBlock block(voxel_data, 0);
 	// TODO How to set the `edited` flag? Does it matter in use cases for this function?
@@ -1772,110 +1384,25 @@ bool VoxelTerrain::has_data_block(Vector3i position) const {
 	return _data->has_block(position, 0);
 }
 
-void VoxelTerrain::process_meshing() {
-	ZN_PROFILE_SCOPE();
-	ProfilingClock profiling_clock;
-
-	_stats.dropped_block_meshs = 0;
-
-	// Send mesh updates
-
-	const Transform3D volume_transform = get_global_transform();
-	std::shared_ptr<PriorityDependency::ViewersData> shared_viewers_data =
-			VoxelEngine::get_singleton().get_shared_viewers_data_from_default_world();
-
-	// const int used_channels_mask = get_used_channels_mask();
-	const int mesh_to_data_factor = get_mesh_block_size() / get_data_block_size();
-
-	BufferedTaskScheduler &scheduler = BufferedTaskScheduler::get_for_current_thread();
-
-	for (size_t bi = 0; bi < _blocks_pending_update.size(); ++bi) {
-		ZN_PROFILE_SCOPE_NAMED("Block");
-		const Vector3i mesh_block_pos = _blocks_pending_update[bi];
-
-		VoxelMeshBlockVT *mesh_block = _mesh_map.get_block(mesh_block_pos);
-
-		// If we got here, it must have been because of scheduling an update
-		ZN_ASSERT_CONTINUE(mesh_block != nullptr);
-		ZN_ASSERT_CONTINUE(mesh_block->is_in_update_list);
-
-		// Pad by 1 because meshing requires neighbors
-		const Box3i data_box =
-				Box3i(mesh_block_pos * mesh_to_data_factor, Vector3iUtil::create(mesh_to_data_factor)).padded(1);
-
-#ifdef DEBUG_ENABLED
-		// We must have picked up a valid data block
-		{
-			const Vector3i anchor_pos = data_box.position + Vector3i(1, 1, 1);
-			ZN_ASSERT_CONTINUE(_data->has_block(anchor_pos, 0));
-		}
-#endif
-
-		// print_line(String("DDD request {0}").format(varray(mesh_request.render_block_position.to_vec3())));
-		// We'll allocate this quite often. If it becomes a problem, it should be easy to pool.
-		MeshBlockTask *task = ZN_NEW(MeshBlockTask);
-		task->volume_id = _volume_id;
-		task->mesh_block_position = mesh_block_pos;
-		task->lod_index = 0;
-		task->meshing_dependency = _meshing_dependency;
-		task->require_visual = mesh_block->mesh_viewers.get() > 0;
-		task->collision_hint = _generate_collisions && mesh_block->collision_viewers.get() > 0;
-		task->data = _data;
-
-		// This iteration order is specifically chosen to match VoxelEngine and threaded access
-		_data->get_blocks_with_voxel_data(data_box, 0, to_span(task->blocks));
-		task->blocks_count = Vector3iUtil::get_volume_u64(data_box.size);
-
-#ifdef DEBUG_ENABLED
-		{
-			unsigned int count = 0;
-			for (unsigned int i = 0; i < task->blocks_count; ++i) {
-				if (task->blocks[i] != nullptr) {
-					++count;
-				}
-			}
-			// Blocks that were in the list must have been scheduled because we have data for them!
-			if (count == 0) {
-				ZN_PRINT_ERROR("Unexpected empty block list in meshing block task");
-				ZN_DELETE(task);
-				continue;
-			}
-		}
-#endif
-
-		init_sparse_grid_priority_dependency(
-				task->priority_dependency,
-				task->mesh_block_position,
-				get_mesh_block_size(),
-				shared_viewers_data,
-				volume_transform
-		);
-
-		scheduler.push_main_task(task);
-
-		mesh_block->is_in_update_list = false;
-	}
-
-	scheduler.flush();
-
-	_blocks_pending_update.clear();
-
-	_stats.time_request_blocks_to_update = profiling_clock.restart();
-
-	// print_line(String("d:") + String::num(_dirty_blocks.size()) + String(", q:") +
-	// String::num(_block_update_queue.size()));
-}
-
 void VoxelTerrain::apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob) {
 	ZN_PROFILE_SCOPE();
 	// print_line(String("DDD receive {0}").format(varray(ob.position.to_vec3())));
 
-	VoxelMeshBlockVT *block = _mesh_map.get_block(ob.position);
-	if (block == nullptr) {
-		// print_line("- no longer loaded");
-		// That block is no longer loaded, drop the result
-		++_stats.dropped_block_meshs;
-		return;
+	// Viewer counts are owned by the update task, which can be running at the same time
+	bool visual_required;
+	bool collision_required;
+	{
+		VoxelTerrainUpdateData::State &state = _update_data->state;
+		RWLockRead rlock(state.mesh_blocks_lock);
+		auto it = state.mesh_blocks.find(ob.position);
+		if (it == state.mesh_blocks.end()) {
+			// print_line("- no longer loaded");
+			// That block is no longer loaded, drop the result
+			++_stats.dropped_block_meshs;
+			return;
+		}
+		visual_required = it->second.mesh_viewers.get() > 0;
+		collision_required = it->second.collision_viewers.get() > 0;
 	}
 
 	if (ob.type == VoxelEngine::BlockMeshOutput::TYPE_DROPPED) {
@@ -1892,6 +1419,9 @@ void VoxelTerrain::apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob) {
 		return;
 	}
 
+	// The block may not have been created yet if the update that viewed it is still running
+	VoxelMeshBlockVT *block = get_or_create_mesh_block(ob.position);
+
 	Ref<ArrayMesh> mesh;
 	Ref<Mesh> shadow_occluder_mesh;
 	StdVector<uint16_t> material_indices;
@@ -1960,9 +1490,14 @@ void VoxelTerrain::apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob) {
 		block->set_material_override(_material_override);
 	}
 
-	const bool gen_collisions = _generate_collisions && block->collision_viewers.get() > 0;
+	const bool gen_collisions = _generate_collisions && collision_required;
 	if (gen_collisions) {
-		Ref<Shape3D> collision_shape = make_collision_shape_from_mesher_output(ob.surfaces, **_mesher);
+		Ref<Shape3D> collision_shape;
+		if (ob.has_collision_shape_resource) {
+			collision_shape = ob.collision_shape;
+		} else {
+			collision_shape = make_collision_shape_from_mesher_output(ob.surfaces, **_mesher);
+		}
 
 		bool debug_collisions = false;
 		if (is_inside_tree()) {
@@ -1982,7 +1517,12 @@ void VoxelTerrain::apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob) {
 		block->set_collision_mask(_collision_mask);
 	}
 
-	block->set_visible(block->mesh_viewers.get() > 0);
+	if (block->side_connectivity != ob.surfaces.side_connectivity) {
+		block->side_connectivity = ob.surfaces.side_connectivity;
+		_occlusion_culling_dirty = true;
+	}
+
+	block->set_visible(visual_required);
 	block->set_collision_enabled(gen_collisions);
 	block->set_parent_visible(is_visible());
 	block->set_parent_transform(get_global_transform());
@@ -1996,6 +1536,96 @@ void VoxelTerrain::apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob) {
 	}
 }
 
+bool VoxelTerrain::get_camera_position(Vector3 &out_position) const {
+	if (!is_inside_tree()) {
+		return false;
+	}
+#ifdef TOOLS_ENABLED
+	if (Engine::get_singleton()->is_editor_hint()) {
+		// Falling back on the editor's camera
+		out_position = godot::VoxelEngine::get_singleton()->get_editor_camera_position();
+		return true;
+	}
+#endif
+	const Viewport *vp = get_viewport();
+	if (vp == nullptr) {
+		return false;
+	}
+	const Camera3D *camera = vp->get_camera_3d();
+	if (camera == nullptr) {
+		return false;
+	}
+	out_position = camera->get_global_transform().get_origin();
+	return true;
+}
+
+void VoxelTerrain::process_occlusion_culling() {
+	Vector3 camera_position;
+	if (!get_camera_position(camera_position)) {
+		return;
+	}
+
+	const Vector3 local_camera_position = get_global_transform().affine_inverse().xform(camera_position);
+	const Vector3i camera_block = floor_to_int(local_camera_position) >> get_mesh_block_size_pow2();
+
+	// Occlusion doesn't depend on where the camera looks, so it only changes when the camera moves to another block or
+	// when blocks change
+	if (!_occlusion_culling_dirty && camera_block == _occlusion_culling_camera_block) {
+		return;
+	}
+
+	ZN_PROFILE_SCOPE();
+
+	_occlusion_culling_dirty = false;
+	_occlusion_culling_camera_block = camera_block;
+
+	const int mesh_block_size = get_mesh_block_size();
+	const int max_distance_in_blocks = math::ceildiv(int(_max_view_distance_voxels), mesh_block_size) + 1;
+	const Box3i bounds = Box3i::from_center_extents(camera_block, Vector3iUtil::create(max_distance_in_blocks));
+
+	const VoxelMeshMap<VoxelMeshBlockVT> &mesh_map = _mesh_map;
+	StdUnorderedSet<Vector3i> &visible_blocks = _occlusion_culling_visible_blocks;
+
+	const bool found_camera_block = occlusion_culling::find_visible_blocks(
+			camera_block,
+			bounds,
+			[&mesh_map](const Vector3i bpos, uint16_t &out_connectivity) {
+				const VoxelMeshBlockVT *block = mesh_map.get_block(bpos);
+				if (block == nullptr) {
+					return false;
+				}
+				out_connectivity = block->side_connectivity;
+				return true;
+			},
+			[](const Vector3i) {},
+			_occlusion_culling_queue_positions,
+			_occlusion_culling_queue_states,
+			visible_blocks
+	);
+
+	if (!found_camera_block) {
+		// The camera is not in a loaded area, we can't tell what is hidden
+		clear_occlusion_culling();
+		return;
+	}
+
+	const RenderingServer::ShadowCastingSetting shadow_setting =
+			static_cast<RenderingServer::ShadowCastingSetting>(get_shadow_casting());
+
+	_mesh_map.for_each_block([&visible_blocks, shadow_setting](VoxelMeshBlockVT &block) {
+		block.set_occluded(visible_blocks.find(block.position) == visible_blocks.end(), shadow_setting);
+	});
+}
+
+void VoxelTerrain::clear_occlusion_culling() {
+	const RenderingServer::ShadowCastingSetting shadow_setting =
+			static_cast<RenderingServer::ShadowCastingSetting>(get_shadow_casting());
+	_mesh_map.for_each_block([shadow_setting](VoxelMeshBlockVT &block) { //
+		block.set_occluded(false, shadow_setting);
+	});
+	_occlusion_culling_dirty = true;
+}
+
 Ref<VoxelTool> VoxelTerrain::get_voxel_tool() {
 	Ref<VoxelTool> vt = memnew(VoxelToolTerrain(this));
 	const int used_channels_mask = get_used_channels_mask();
@@ -2032,6 +1662,7 @@ bool VoxelTerrain::is_stream_running_in_editor() const {
 }
 
 void VoxelTerrain::set_bounds(Box3i box) {
+	_update_data->wait_for_end_of_task();
 	Box3i bounds_in_voxels =
 			box.clipped(Box3i::from_center_extents(Vector3i(), Vector3iUtil::create(constants::MAX_VOLUME_EXTENT)));
 
@@ -2233,7 +1864,7 @@ Vector3i VoxelTerrain::_b_data_block_to_voxel(Vector3i pos) const {
 
 Ref<VoxelSaveCompletionTracker> VoxelTerrain::_b_save_modified_blocks() {
 	std::shared_ptr<AsyncDependencyTracker> tracker = make_shared_instance<AsyncDependencyTracker>();
-	save_all_modified_blocks(true, tracker);
+	save_all_modified_blocks(tracker);
 	ZN_ASSERT_RETURN_V(tracker != nullptr, Ref<VoxelSaveCompletionTracker>());
 	return VoxelSaveCompletionTracker::create(tracker);
 }
@@ -2343,6 +1974,7 @@ void VoxelTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_mesh_block_size", "size"), &Self::set_mesh_block_size);
 
 	ClassDB::bind_method(D_METHOD("get_statistics"), &Self::_b_get_statistics);
+	ClassDB::bind_method(D_METHOD("get_memory_breakdown"), &Self::_b_get_memory_breakdown);
 	ClassDB::bind_method(D_METHOD("get_voxel_tool"), &Self::get_voxel_tool);
 
 	ClassDB::bind_method(D_METHOD("save_modified_blocks"), &Self::_b_save_modified_blocks);
@@ -2357,6 +1989,17 @@ void VoxelTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_generator_use_gpu", "enable"), &Self::set_generator_use_gpu);
 	ClassDB::bind_method(D_METHOD("get_generator_use_gpu"), &Self::get_generator_use_gpu);
 
+	ClassDB::bind_method(
+			D_METHOD("set_palette_compression_enabled", "enabled"), &Self::set_palette_compression_enabled
+	);
+	ClassDB::bind_method(D_METHOD("is_palette_compression_enabled"), &Self::is_palette_compression_enabled);
+
+	ClassDB::bind_method(D_METHOD("set_occlusion_culling_enabled", "enabled"), &Self::set_occlusion_culling_enabled);
+	ClassDB::bind_method(D_METHOD("is_occlusion_culling_enabled"), &Self::is_occlusion_culling_enabled);
+
+	ClassDB::bind_method(D_METHOD("set_threaded_update_enabled", "enabled"), &Self::set_threaded_update_enabled);
+	ClassDB::bind_method(D_METHOD("is_threaded_update_enabled"), &Self::is_threaded_update_enabled);
+
 	// TODO Rename `_voxel_bounds`
 	ClassDB::bind_method(D_METHOD("set_bounds", "bounds"), &Self::_b_set_bounds);
 	ClassDB::bind_method(D_METHOD("get_bounds"), &Self::_b_get_bounds);
@@ -2454,6 +2097,21 @@ void VoxelTerrain::_bind_methods() {
 	);
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "mesh_block_size"), "set_mesh_block_size", "get_mesh_block_size");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_gpu_generation"), "set_generator_use_gpu", "get_generator_use_gpu");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "palette_compression_enabled"),
+			"set_palette_compression_enabled",
+			"is_palette_compression_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "occlusion_culling_enabled"),
+			"set_occlusion_culling_enabled",
+			"is_occlusion_culling_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "threaded_update_enabled"),
+			"set_threaded_update_enabled",
+			"is_threaded_update_enabled"
+	);
 
 	ADD_GROUP("Debug", "debug_");
 
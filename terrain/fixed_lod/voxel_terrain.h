@@ -5,6 +5,7 @@
 #include "../../engine/meshing_dependency.h"
 #include "../../storage/voxel_data.h"
 #include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/std_unordered_set.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/core/gdvirtual.h"
 #include "../../util/godot/memory.h"
@@ -14,6 +15,7 @@
 #include "../voxel_node.h"
 #include "voxel_mesh_block_vt.h"
 #include "voxel_terrain_multiplayer_synchronizer.h"
+#include "voxel_terrain_update_data.h"
 
 #ifdef TOOLS_ENABLED
 #include "../../util/godot/debug_renderer.h"
@@ -98,6 +100,15 @@ public:
 	void set_generator_use_gpu(bool enabled);
 	bool get_generator_use_gpu() const;
 
+	void set_palette_compression_enabled(bool enabled);
+	bool is_palette_compression_enabled() const;
+
+	void set_occlusion_culling_enabled(bool enabled);
+	bool is_occlusion_culling_enabled() const;
+
+	void set_threaded_update_enabled(bool enabled);
+	bool is_threaded_update_enabled() const;
+
 	VoxelData &get_storage() const {
 		ZN_ASSERT(_data != nullptr);
 		return *_data;
@@ -130,15 +141,7 @@ public:
 	// If the block is out of range of any viewer, it will be cancelled.
 	void generate_block_async(Vector3i block_position);
 
-	struct Stats {
-		int updated_blocks = 0;
-		int dropped_block_loads = 0;
-		int dropped_block_meshs = 0;
-		uint32_t time_detect_required_blocks = 0;
-		uint32_t time_request_blocks_to_load = 0;
-		uint32_t time_process_load_responses = 0;
-		uint32_t time_request_blocks_to_update = 0;
-	};
+	using Stats = VoxelTerrainUpdateData::Stats;
 
 	const Stats &get_stats() const;
 
@@ -197,15 +200,9 @@ protected:
 
 private:
 	void process();
-	void process_viewers();
-	void process_viewer_data_box_change(
-			ViewerID viewer_id,
-			Box3i prev_data_box,
-			Box3i new_data_box,
-			bool can_load_blocks
-	);
-	// void process_received_data_blocks();
-	void process_meshing();
+	void apply_main_thread_update_tasks();
+	void process_occlusion_culling();
+	void clear_occlusion_culling();
 	void apply_mesh_update(const VoxelEngine::BlockMeshOutput &ob);
 	void apply_data_block_response(VoxelEngine::BlockDataOutput &ob);
 
@@ -219,19 +216,12 @@ private:
 	void reset_map();
 	void clear_mesh_map();
 
-	// void view_data_block(Vector3i bpos, uint32_t viewer_id, bool require_notification);
-	void view_mesh_block(Vector3i bpos, bool mesh_flag, bool collision_flag);
-	// void unview_data_block(Vector3i bpos);
-	void unview_mesh_block(Vector3i bpos, bool mesh_flag, bool collision_flag);
-	// void unload_data_block(Vector3i bpos);
+	VoxelMeshBlockVT *get_or_create_mesh_block(Vector3i bpos);
 	void unload_mesh_block(Vector3i bpos);
-	// void make_data_block_dirty(Vector3i bpos);
-	void try_schedule_mesh_update(VoxelMeshBlockVT &block);
-	void try_schedule_mesh_update_from_data(const Box3i &box_in_voxels);
+	void try_schedule_mesh_update_from_data(const Box3i &box_in_voxels, bool from_edit = false);
 
-	void save_all_modified_blocks(bool with_copy, std::shared_ptr<AsyncDependencyTracker> tracker);
-	void get_viewer_pos_and_direction(Vector3 &out_pos, Vector3 &out_direction) const;
-	void send_data_load_requests();
+	void save_all_modified_blocks(std::shared_ptr<AsyncDependencyTracker> tracker);
+	bool get_camera_position(Vector3 &out_position) const;
 	void consume_block_data_save_requests(
 			BufferedTaskScheduler &task_scheduler,
 			std::shared_ptr<AsyncDependencyTracker> saving_tracker,
@@ -244,8 +234,6 @@ private:
 	void emit_mesh_block_entered(Vector3i bpos);
 	void emit_mesh_block_exited(Vector3i bpos);
 
-	bool try_get_paired_viewer_index(ViewerID id, size_t &out_i) const;
-
 	void notify_data_block_enter(const VoxelDataBlock &block, Vector3i bpos, ViewerID viewer_id);
 
 	bool is_area_meshed(const Box3i &box_in_voxels) const;
@@ -274,6 +262,7 @@ private:
 	AABB _b_get_bounds() const;
 	bool _b_try_set_block_data(Vector3i position, Ref<godot::VoxelBuffer> voxel_data);
 	Dictionary _b_get_statistics() const;
+	Dictionary _b_get_memory_breakdown() const;
 	PackedInt32Array _b_get_viewer_network_peer_ids_in_area(Vector3i area_origin, Vector3i area_size) const;
 	void _b_rpc_receive_block(PackedByteArray data);
 	void _b_rpc_receive_area(PackedByteArray data);
@@ -281,23 +270,8 @@ private:
 
 	VolumeID _volume_id;
 
-	// Paired viewers are VoxelViewers which intersect with the boundaries of the volume
-	struct PairedViewer {
-		struct State {
-			Vector3i local_position_voxels;
-			Box3i data_box; // In block coordinates
-			Box3i mesh_box;
-			int horizontal_view_distance_voxels = 0;
-			int vertical_view_distance_voxels = 0;
-			bool requires_collisions = false;
-			bool requires_meshes = false;
-		};
-		ViewerID id;
-		State state;
-		State prev_state;
-	};
-
-	StdVector<PairedViewer> _paired_viewers;
+	// Copy of the paired viewers of the last completed update, for use on the main thread
+	StdVector<VoxelTerrainUpdateData::PairedViewer> _paired_viewers;
 
 	// Voxel storage. Using a shared_ptr so threaded tasks can use it safely.
 	std::shared_ptr<VoxelData> _data;
@@ -311,33 +285,12 @@ private:
 	// TODO Terrains only need to handle the visible portion of voxels, which reduces the bounds blocks to handle.
 	// Therefore, could a simple grid be better to use than a hashmap?
 
-	struct LoadingBlock {
-		RefCount viewers;
-		// TODO Optimize allocations here
-		StdVector<ViewerID> viewers_to_notify;
-	};
-
-	// Blocks currently being loaded.
-	StdUnorderedMap<Vector3i, LoadingBlock> _loading_blocks;
-	// Blocks that should be loaded on the next process call.
-	// The order in that list does not matter.
-	StdVector<Vector3i> _blocks_pending_load;
-	// Block meshes that should be updated on the next process call.
-	// The order in that list does not matter.
-	StdVector<Vector3i> _blocks_pending_update;
 	// Blocks that should be saved on the next process call.
 	// The order in that list does not matter.
 	StdVector<VoxelData::BlockToSave> _blocks_to_save;
-	// Data blocks that have been unloaded and needed saving. They are temporarily stored here until saving completes,
-	// and is checked first before loading new blocks. This is in case players leave an area and come back to it faster
-	// than saving, because otherwise loading from stream would return an outdated version.
-	StdUnorderedMap<Vector3i, std::shared_ptr<VoxelBuffer>> _unloaded_saving_blocks;
-	// List of data blocks that will be used to simulate a loading response on the next process call.
-	struct QuickReloadingBlock {
-		std::shared_ptr<VoxelBuffer> voxels;
-		Vector3i position;
-	};
-	StdVector<QuickReloadingBlock> _quick_reloading_blocks;
+
+	// Data shared with the update task, which can run in a separate thread
+	std::shared_ptr<VoxelTerrainUpdateData> _update_data;
 
 	Ref<VoxelMesher> _mesher;
 
@@ -358,6 +311,18 @@ private:
 	bool _automatic_loading_enabled = true;
 	bool _generator_use_gpu = false;
 
+	bool _threaded_update_enabled = false;
+
+	// Hides mesh blocks that can't be seen from the camera, based on connectivity of their sides
+	bool _occlusion_culling_enabled = false;
+	// Set when mesh blocks or their connectivity changed, so occlusion has to be calculated again
+	bool _occlusion_culling_dirty = true;
+	Vector3i _occlusion_culling_camera_block;
+	// Kept around to reuse memory
+	StdVector<Vector3i> _occlusion_culling_queue_positions;
+	StdVector<uint16_t> _occlusion_culling_queue_states;
+	StdUnorderedSet<Vector3i> _occlusion_culling_visible_blocks;
+
 	Ref<Material> _material_override;
 
 	zylann::godot::ObjectUniquePtr<VoxelDataBlockEnterInfo> _data_block_enter_info_obj;
@@ -1,6 +1,7 @@
 #include "voxel_terrain_multiplayer_synchronizer.h"
 #include "../../constants/voxel_string_names.h"
 #include "../../storage/voxel_buffer.h"
+#include "../../streams/compressed_data.h"
 #include "../../streams/voxel_block_serializer.h"
 #include "../../util/containers/container_funcs.h"
 #include "../../util/godot/classes/multiplayer_api.h"
@@ -8,16 +9,216 @@
 #include "../../util/godot/classes/scene_tree.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/io/serialization.h"
+#include "../../util/math/conv.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "voxel_terrain.h"
 
+#include <algorithm>
+#include <limits>
+
 #ifdef TOOLS_ENABLED
 #include "../../util/godot/core/packed_arrays.h"
 #endif
 
 namespace zylann::voxel {
 
+namespace {
+
+enum AreaEncoding : uint8_t {
+	// Serialized and compressed voxels of the whole area
+	AREA_ENCODING_FULL = 0,
+	// Compressed runs of voxels that changed since the last version sent to peers
+	AREA_ENCODING_DELTA = 1
+};
+
+// Edits closer than this distance (in voxels) are sent as a single area
+const int EDIT_MERGE_DISTANCE = 4;
+const unsigned int SNAPSHOT_CLEANUP_INTERVAL_FRAMES = 64;
+// How many bytes of blocks can be sent at once after a peer didn't receive any for a while, in seconds of budget
+const float MAX_BLOCK_BYTES_BURST_SECONDS = 0.25f;
+// Client-side, edits waiting for a block to generate are applied anyways after this many frames
+const unsigned int GENERATING_BLOCK_TIMEOUT_FRAMES = 600;
+
+void store_vector3i(MemoryWriter &mw, Vector3i v) {
+	mw.store_32(v.x);
+	mw.store_32(v.y);
+	mw.store_32(v.z);
+}
+
+Vector3i get_vector3i(MemoryReader &mr) {
+	Vector3i v;
+	v.x = int32_t(mr.get_32());
+	v.y = int32_t(mr.get_32());
+	v.z = int32_t(mr.get_32());
+	return v;
+}
+
+void merge_nearby_boxes(StdVector<Box3i> &boxes, int distance) {
+	ZN_PROFILE_SCOPE();
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (unsigned int i = 0; i < boxes.size(); ++i) {
+			unsigned int j = i + 1;
+			while (j < boxes.size()) {
+				if (boxes[i].padded(distance).intersects(boxes[j])) {
+					boxes[i].merge_with(boxes[j]);
+					boxes[j] = boxes.back();
+					boxes.pop_back();
+					merged = true;
+				} else {
+					++j;
+				}
+			}
+		}
+	}
+}
+
+float get_closest_distance_squared(const StdVector<Vector3> &positions, Vector3i bpos, int block_size) {
+	const Vector3 block_center = to_vec3(bpos * block_size) + Vector3(0.5f, 0.5f, 0.5f) * block_size;
+	float closest_distance_squared = std::numeric_limits<float>::max();
+	for (const Vector3 &position : positions) {
+		closest_distance_squared = math::min(closest_distance_squared, position.distance_squared_to(block_center));
+	}
+	return closest_distance_squared;
+}
+
+StdVector<uint8_t> &get_tls_delta_data() {
+	static thread_local StdVector<uint8_t> tls_delta_data;
+	return tls_delta_data;
+}
+
+void write_u32_le(StdVector<uint8_t> &data, size_t pos, uint32_t v) {
+	for (unsigned int i = 0; i < sizeof(uint32_t); ++i) {
+		data[pos + i] = static_cast<uint8_t>(v >> (i * 8));
+	}
+}
+
+void store_value(StdVector<uint8_t> &data, uint64_t v, unsigned int byte_count) {
+	for (unsigned int i = 0; i < byte_count; ++i) {
+		data.push_back(static_cast<uint8_t>(v >> (i * 8)));
+	}
+}
+
+// Appends runs of unchanged and changed voxels of a channel, in ZXY order. Each run is the number of unchanged voxels
+// followed by the number of changed voxels and their values. Runs are not split by rows, so this is only efficient
+// when changes are clustered. Returns false and appends nothing if the channel didn't change.
+bool encode_channel_runs(
+		const VoxelBuffer &voxels,
+		const VoxelBuffer &old_voxels,
+		unsigned int channel_index,
+		StdVector<uint8_t> &data
+) {
+	const size_t begin = data.size();
+	const unsigned int byte_count = VoxelBuffer::get_depth_byte_count(voxels.get_channel_depth(channel_index));
+	data.push_back(byte_count);
+
+	const Vector3i size = voxels.get_size();
+	uint32_t unchanged_count = 0;
+	uint32_t changed_count = 0;
+	size_t run_begin = 0;
+	bool any_change = false;
+
+	MemoryWriter mw(data, ENDIANNESS_LITTLE_ENDIAN);
+
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				const uint64_t v = voxels.get_voxel(pos, channel_index);
+
+				if (v == old_voxels.get_voxel(pos, channel_index)) {
+					if (changed_count > 0) {
+						// Patch the run header now that its length is known
+						write_u32_le(data, run_begin + sizeof(uint32_t), changed_count);
+						changed_count = 0;
+						unchanged_count = 0;
+					}
+					++unchanged_count;
+
+				} else {
+					if (changed_count == 0) {
+						run_begin = data.size();
+						mw.store_32(unchanged_count);
+						mw.store_32(0);
+					}
+					store_value(data, v, byte_count);
+					++changed_count;
+					any_change = true;
+				}
+			}
+		}
+	}
+
+	if (!any_change) {
+		data.resize(begin);
+		return false;
+	}
+
+	if (changed_count > 0) {
+		write_u32_le(data, run_begin + sizeof(uint32_t), changed_count);
+	} else {
+		// Terminates the channel
+		mw.store_32(unchanged_count);
+		mw.store_32(0);
+	}
+	return true;
+}
+
+bool apply_area_delta(VoxelData &data, Box3i voxel_box, Span<const uint8_t> compressed_data) {
+	StdVector<uint8_t> &delta_data = get_tls_delta_data();
+	ZN_ASSERT_RETURN_V(CompressedData::decompress(compressed_data, delta_data), false);
+
+	MemoryReader mr(to_span(delta_data), ENDIANNESS_LITTLE_ENDIAN);
+	ZN_ASSERT_RETURN_V(delta_data.size() >= 1, false);
+	const uint8_t channels_mask = mr.get_8();
+
+	// Start from what we have, so voxels that didn't change are left as they are
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+	voxels.create(voxel_box.size);
+	data.copy(voxel_box.position, voxels, channels_mask);
+
+	const uint64_t volume = Vector3iUtil::get_volume_u64(voxel_box.size);
+
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		if ((channels_mask & (1 << channel_index)) == 0) {
+			continue;
+		}
+
+		ZN_ASSERT_RETURN_V(mr.pos < mr.data.size(), false);
+		const unsigned int byte_count = mr.get_8();
+		ZN_ASSERT_RETURN_V(byte_count <= sizeof(uint64_t), false);
+
+		uint64_t i = 0;
+		while (i < volume) {
+			ZN_ASSERT_RETURN_V(mr.pos + 2 * sizeof(uint32_t) <= mr.data.size(), false);
+			i += mr.get_32();
+			const uint32_t changed_count = mr.get_32();
+			if (changed_count == 0) {
+				break;
+			}
+			ZN_ASSERT_RETURN_V(i + changed_count <= volume, false);
+			ZN_ASSERT_RETURN_V(mr.pos + changed_count * byte_count <= mr.data.size(), false);
+
+			for (uint32_t j = 0; j < changed_count; ++j) {
+				uint64_t v = 0;
+				for (unsigned int b = 0; b < byte_count; ++b) {
+					v |= static_cast<uint64_t>(mr.get_8()) << (b * 8);
+				}
+				const Vector3i pos = Vector3iUtil::from_zxy_index(i, voxel_box.size);
+				voxels.set_voxel(v, pos.x, pos.y, pos.z, channel_index);
+				++i;
+			}
+		}
+	}
+
+	data.paste(voxel_box.position, voxels, channels_mask, false);
+	return true;
+}
+
+} // namespace
+
 VoxelTerrainMultiplayerSynchronizer::VoxelTerrainMultiplayerSynchronizer() {
 	Dictionary config;
 	config["rpc_mode"] = MultiplayerAPI::RPC_MODE_AUTHORITY;
@@ -44,78 +245,59 @@ bool VoxelTerrainMultiplayerSynchronizer::is_server() const {
 	return mp->is_server();
 }
 
-void VoxelTerrainMultiplayerSynchronizer::send_block(
-		int viewer_peer_id,
-		const VoxelDataBlock &data_block,
-		Vector3i bpos
-) {
-	ZN_PROFILE_SCOPE();
-
-	BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(data_block.get_voxels_const());
-	ZN_ASSERT_RETURN(result.success);
-
-	PackedByteArray message_data;
-	message_data.resize(4 * sizeof(int16_t) + result.data.size());
-
-	ByteSpanWithPosition mw_span(Span<uint8_t>(message_data.ptrw(), message_data.size()), 0);
-	MemoryWriterExistingBuffer mw(mw_span, ENDIANNESS_LITTLE_ENDIAN);
-
-	mw.store_16(bpos.x);
-	mw.store_16(bpos.y);
-	mw.store_16(bpos.z);
-	ZN_ASSERT_RETURN(result.data.size() <= 65535);
-	mw.store_16(result.data.size());
-	mw.store_buffer(to_span(result.data));
-
-	// print_line(String("Server: send block {0}").format(varray(bpos)));
-
-	// rpc_id(viewer_peer_id, VoxelStringNames::get_singleton().receive_block, data);
+void VoxelTerrainMultiplayerSynchronizer::send_block(int viewer_peer_id, Vector3i bpos) {
 	// Instead of sending it right away, defer it until the terrain finished processing. Sending individual blocks with
-	// the RPC system is too slow.
-	_deferred_block_messages_per_peer[viewer_peer_id].push_back(DeferredBlockMessage{ message_data });
+	// the RPC system is too slow. Serializing is also deferred, so edits made in the meantime are included.
+	_peers[viewer_peer_id].deferred_blocks.push_back(bpos);
 }
 
 // TODO Have a way to implement ghost edits?
-// If someone wants to spam edits to appear smooth on clients, this would have terrible impact on networking
-// performance. So perhaps the server needs to cluster edits that are close together, and send the area in batch.
-// Conversely, the client would have to apply the edit locally, while having a way to revert it if the server
-// isn't acknowledging it for some time.
+// The client would have to apply the edit locally, while having a way to revert it if the server isn't acknowledging
+// it for some time.
 
 void VoxelTerrainMultiplayerSynchronizer::send_area(Box3i voxel_box) {
-	ZN_PROFILE_SCOPE();
-	ZN_ASSERT_RETURN(_terrain != nullptr);
+	// Users can spam edits to make them appear smooth on clients, so they are clustered and sent once per frame
+	if (!voxel_box.is_empty()) {
+		_pending_edits.push_back(voxel_box);
+	}
+}
 
-	StdVector<ViewerID> viewers;
-	_terrain->get_viewers_in_area(viewers, voxel_box);
+void VoxelTerrainMultiplayerSynchronizer::set_max_block_bytes_per_second(int bytes) {
+	ZN_ASSERT_RETURN(bytes >= 0);
+	_max_block_bytes_per_second = bytes;
+}
 
-	// Not particularly efficient for single-voxel edits, but should scale ok with bigger boxes
-	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
-	voxels.create(voxel_box.size);
-	_terrain->get_storage().copy(voxel_box.position, voxels, 0xff);
+int VoxelTerrainMultiplayerSynchronizer::get_max_block_bytes_per_second() const {
+	return _max_block_bytes_per_second;
+}
 
-	BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxels);
-	ZN_ASSERT_RETURN(result.success);
+void VoxelTerrainMultiplayerSynchronizer::set_generated_block_stubs_enabled(bool enabled) {
+	_generated_block_stubs_enabled = enabled;
+}
 
-	PackedByteArray pba;
-	pba.resize(4 * sizeof(int32_t) + result.data.size());
+bool VoxelTerrainMultiplayerSynchronizer::is_generated_block_stubs_enabled() const {
+	return _generated_block_stubs_enabled;
+}
 
-	ByteSpanWithPosition mw_span(Span<uint8_t>(pba.ptrw(), pba.size()), 0);
-	MemoryWriterExistingBuffer mw(mw_span, ENDIANNESS_LITTLE_ENDIAN);
+int VoxelTerrainMultiplayerSynchronizer::get_pending_block_count(int peer_id) const {
+	auto it = _peers.find(peer_id);
+	if (it == _peers.end()) {
+		return 0;
+	}
+	return it->second.deferred_blocks.size();
+}
 
-	mw.store_32(voxel_box.position.x);
-	mw.store_32(voxel_box.position.y);
-	mw.store_32(voxel_box.position.z);
-	mw.store_32(result.data.size());
-	mw.store_buffer(to_span(result.data));
-	for (const ViewerID viewer_id : viewers) {
-		const int peer_id = VoxelEngine::get_singleton().get_viewer_network_peer_id(viewer_id);
-		// TODO Don't bother copying and serializing if no networked viewers are around?
-		if (peer_id != -1 && peer_id != MultiplayerPeer::TARGET_PEER_SERVER) {
-			rpc_id(peer_id, VoxelStringNames::get_singleton()._rpc_receive_area, pba);
-		}
+void VoxelTerrainMultiplayerSynchronizer::set_delta_compression_enabled(bool enabled) {
+	_delta_compression_enabled = enabled;
+	if (!enabled) {
+		_block_snapshots.clear();
 	}
 }
 
+bool VoxelTerrainMultiplayerSynchronizer::is_delta_compression_enabled() const {
+	return _delta_compression_enabled;
+}
+
 void VoxelTerrainMultiplayerSynchronizer::_notification(int p_what) {
 	if (p_what == NOTIFICATION_PARENTED) {
 		VoxelTerrain *terrain = Object::cast_to<VoxelTerrain>(get_parent());
@@ -129,59 +311,405 @@ void VoxelTerrainMultiplayerSynchronizer::_notification(int p_what) {
 			_terrain->set_multiplayer_synchronizer(nullptr);
 		}
 		_terrain = nullptr;
+		_pending_edits.clear();
+		_peers.clear();
+		_block_snapshots.clear();
+		_generating_blocks.clear();
+		_deferred_received_areas.clear();
 
 	} else if (p_what == NOTIFICATION_PROCESS) {
 		process();
 	}
 }
 
-// template <typename T, typename F>
-// inline void for_chunks(const StdVector<T> &vec, unsigned int chunk_size, F f) {
-// 	for (unsigned int i = 0; i < vec.size(); i += chunk_size) {
-// 		f(to_span_from_position_and_size(vec, i, i + chunk_size > vec.size() ? vec.size() - i : chunk_size));
-// 	}
-// }
-
 void VoxelTerrainMultiplayerSynchronizer::process() {
 	ZN_PROFILE_SCOPE();
 
-	for (auto it = _deferred_block_messages_per_peer.begin(); it != _deferred_block_messages_per_peer.end(); ++it) {
-		StdVector<DeferredBlockMessage> &messages = it->second;
+	if (_terrain == nullptr) {
+		return;
+	}
+
+	// Edits are sent first. Blocks sent afterwards contain them, and applying an edit on a block that already has it
+	// doesn't change anything.
+	process_edits();
+	process_blocks();
+	process_received_areas();
+
+	++_frame_index;
+	if ((_frame_index % SNAPSHOT_CLEANUP_INTERVAL_FRAMES) == 0) {
+		// Peers can't have blocks the server unloaded
+		const VoxelData &data = _terrain->get_storage();
+		for (auto it = _block_snapshots.begin(); it != _block_snapshots.end();) {
+			if (data.has_block(it->first, 0)) {
+				++it;
+			} else {
+				it = _block_snapshots.erase(it);
+			}
+		}
+	}
+}
+
+void VoxelTerrainMultiplayerSynchronizer::process_edits() {
+	if (_pending_edits.size() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	merge_nearby_boxes(_pending_edits, EDIT_MERGE_DISTANCE);
+
+	VoxelData &data = _terrain->get_storage();
+
+	// Each area is encoded once, regardless of how many peers need it
+	StdVector<StdVector<uint8_t>> encoded_areas;
+	StdUnorderedMap<int, StdVector<uint32_t>> areas_per_peer;
+	StdVector<ViewerID> viewers;
+	StdVector<int> peer_ids;
+	StdVector<uint8_t> delta_data;
+
+	for (const Box3i voxel_box : _pending_edits) {
+		viewers.clear();
+		_terrain->get_viewers_in_area(viewers, voxel_box);
+
+		peer_ids.clear();
+		for (const ViewerID viewer_id : viewers) {
+			const int peer_id = VoxelEngine::get_singleton().get_viewer_network_peer_id(viewer_id);
+			if (peer_id != -1 && peer_id != MultiplayerPeer::TARGET_PEER_SERVER &&
+				!contains(to_span_const(peer_ids), peer_id)) {
+				peer_ids.push_back(peer_id);
+			}
+		}
 
-		if (messages.size() == 0) {
+		if (peer_ids.size() == 0) {
+			// Nobody to send to, and snapshots would be outdated
+			update_snapshots(voxel_box, false);
 			continue;
 		}
 
-		PackedByteArray pba;
-		// Make one big fat message per frame per peer, because sending many is super-slow with Godot's ENet multiplayer
-		// integration. It calls flush() on every RPC and that takes a lot of time, and there is overhead caused by
-		// the high-level features...
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+		voxels.create(voxel_box.size);
+		data.copy(voxel_box.position, voxels, 0xff);
+
+		StdVector<uint8_t> area_data;
+		MemoryWriter mw(area_data, ENDIANNESS_LITTLE_ENDIAN);
+
+		if (_delta_compression_enabled && encode_area_delta(voxel_box, voxels, delta_data)) {
+			if (delta_data.size() == 0) {
+				// The edit didn't change anything
+				continue;
+			}
+			mw.store_8(AREA_ENCODING_DELTA);
+			store_vector3i(mw, voxel_box.position);
+			store_vector3i(mw, voxel_box.size);
+			mw.store_32(delta_data.size());
+			mw.store_buffer(to_span(delta_data));
+
+		} else {
+			BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxels);
+			ZN_ASSERT_CONTINUE(result.success);
+			mw.store_8(AREA_ENCODING_FULL);
+			store_vector3i(mw, voxel_box.position);
+			store_vector3i(mw, voxel_box.size);
+			mw.store_32(result.data.size());
+			mw.store_buffer(to_span(result.data));
+		}
+
+		update_snapshots(voxel_box, true);
+
+		const uint32_t area_index = encoded_areas.size();
+		encoded_areas.push_back(std::move(area_data));
+		for (const int peer_id : peer_ids) {
+			areas_per_peer[peer_id].push_back(area_index);
+		}
+	}
+
+	_pending_edits.clear();
 
-		unsigned int size = 0;
-		for (const DeferredBlockMessage &message : messages) {
-			size += message.data.size();
+	// One message per peer per frame
+	for (auto it = areas_per_peer.begin(); it != areas_per_peer.end(); ++it) {
+		const StdVector<uint32_t> &area_indices = it->second;
+
+		unsigned int size = sizeof(uint32_t);
+		for (const uint32_t area_index : area_indices) {
+			size += encoded_areas[area_index].size();
 		}
 
-		pba.resize(1 * sizeof(uint32_t) + size);
+		PackedByteArray pba;
+		pba.resize(size);
 
 		ByteSpanWithPosition mw_span(Span<uint8_t>(pba.ptrw(), pba.size()), 0);
 		MemoryWriterExistingBuffer mw(mw_span, ENDIANNESS_LITTLE_ENDIAN);
-		mw.store_32(messages.size());
-
-		for (const DeferredBlockMessage &message : messages) {
-			mw.store_buffer(Span<const uint8_t>(message.data.ptr(), message.data.size()));
+		mw.store_32(area_indices.size());
+		for (const uint32_t area_index : area_indices) {
+			mw.store_buffer(to_span(encoded_areas[area_index]));
 		}
 		ZN_ASSERT(mw.data.size() == mw.data.pos);
 
-		messages.clear();
+		const int peer_id = it->first;
+		ZN_PRINT_VERBOSE(format("Sending {} bytes of area data to peer {}", pba.size(), peer_id));
+		rpc_id(peer_id, VoxelStringNames::get_singleton()._rpc_receive_area, pba);
+	}
+}
+
+void VoxelTerrainMultiplayerSynchronizer::process_blocks() {
+	ZN_PROFILE_SCOPE();
+
+	StdUnorderedMap<int, StdVector<Vector3>> peer_positions;
+	if (_max_block_bytes_per_second > 0) {
+		// Only matters when blocks can't all be sent in the same frame
+		get_peer_positions(peer_positions);
+	}
+
+	VoxelData &data = _terrain->get_storage();
+	const int block_size = data.get_block_size();
+	const float delta_time = get_process_delta_time();
+
+	StdVector<uint8_t> blocks_data;
+
+	for (auto it = _peers.begin(); it != _peers.end();) {
+		PeerState &peer = it->second;
+		StdVector<Vector3i> &block_positions = peer.deferred_blocks;
+
+		if (block_positions.size() == 0) {
+			it = _peers.erase(it);
+			continue;
+		}
 
 		const int peer_id = it->first;
+		++it;
+
+		if (_max_block_bytes_per_second > 0) {
+			// Bursts are limited, so a peer that had nothing to receive for a while doesn't get flooded
+			peer.block_bytes_credit = math::min(
+					peer.block_bytes_credit + _max_block_bytes_per_second * delta_time,
+					_max_block_bytes_per_second * MAX_BLOCK_BYTES_BURST_SECONDS
+			);
+			if (peer.block_bytes_credit <= 0.f) {
+				continue;
+			}
+
+			auto positions_it = peer_positions.find(peer_id);
+			if (positions_it != peer_positions.end()) {
+				const StdVector<Vector3> &viewer_positions = positions_it->second;
+				// Furthest first, so the closest blocks are at the back and get sent first
+				std::sort(
+						block_positions.begin(),
+						block_positions.end(),
+						[&viewer_positions, block_size](const Vector3i &a, const Vector3i &b) {
+							return get_closest_distance_squared(viewer_positions, a, block_size) >
+									get_closest_distance_squared(viewer_positions, b, block_size);
+						}
+				);
+			}
+		}
+
+		blocks_data.clear();
+		MemoryWriter mw(blocks_data, ENDIANNESS_LITTLE_ENDIAN);
+		unsigned int block_count = 0;
+
+		while (block_positions.size() > 0) {
+			if (_max_block_bytes_per_second > 0 && peer.block_bytes_credit <= 0.f) {
+				// Remaining blocks will be sent in the next frames
+				break;
+			}
+
+			const Vector3i bpos = block_positions.back();
+			block_positions.pop_back();
+
+			std::shared_ptr<VoxelBuffer> voxels;
+			bool edited = true;
+			{
+				SpatialLock3D::Read srlock(data.get_spatial_lock(0), BoxBounds3i::from_position(bpos));
+				voxels = data.try_get_block_voxels(bpos, edited);
+				if (voxels == nullptr) {
+					// Unloaded in the meantime
+					continue;
+				}
+			}
+
+			// The client can generate blocks that were never edited. Uniform blocks are already tiny when serialized.
+			const bool stub = _generated_block_stubs_enabled && !edited;
+			Span<const uint8_t> block_data;
+
+			if (!stub || _delta_compression_enabled) {
+				BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(*voxels);
+				ZN_ASSERT_CONTINUE(result.success);
+				ZN_ASSERT_CONTINUE(result.data.size() <= 65535);
+
+				if (!stub) {
+					block_data = to_span(result.data);
+				}
+				if (_delta_compression_enabled) {
+					// Pending edits were sent before, so this is also the version other peers have
+					_block_snapshots[bpos] = result.data;
+				}
+			}
+
+			const size_t size_before = blocks_data.size();
+
+			mw.store_16(bpos.x);
+			mw.store_16(bpos.y);
+			mw.store_16(bpos.z);
+			// 0 means the client has to generate the block
+			mw.store_16(block_data.size());
+			mw.store_buffer(block_data);
+
+			++block_count;
+			peer.block_bytes_credit -= blocks_data.size() - size_before;
+
+			// print_line(String("Server: send block {0}").format(varray(bpos)));
+		}
+
+		if (block_count == 0) {
+			continue;
+		}
+
+		PackedByteArray pba;
+		// Make one big fat message per frame per peer, because sending many is super-slow with Godot's ENet multiplayer
+		// integration. It calls flush() on every RPC and that takes a lot of time, and there is overhead caused by
+		// the high-level features...
+		pba.resize(2 * sizeof(uint32_t) + blocks_data.size());
+
+		ByteSpanWithPosition mw_span(Span<uint8_t>(pba.ptrw(), pba.size()), 0);
+		MemoryWriterExistingBuffer pba_mw(mw_span, ENDIANNESS_LITTLE_ENDIAN);
+		pba_mw.store_32(block_count);
+		// Lets the client report progress
+		pba_mw.store_32(block_positions.size());
+		pba_mw.store_buffer(to_span(blocks_data));
+		ZN_ASSERT(pba_mw.data.size() == pba_mw.data.pos);
+
 		ZN_PRINT_VERBOSE(format("Sending {} bytes of block data to peer {}", pba.size(), peer_id));
 		// print_data_hex(Span<const uint8_t>(pba.ptr(), pba.size()));
 		rpc_id(peer_id, VoxelStringNames::get_singleton()._rpc_receive_blocks, pba);
 	}
 }
 
+void VoxelTerrainMultiplayerSynchronizer::get_peer_positions(
+		StdUnorderedMap<int, StdVector<Vector3>> &out_positions
+) const {
+	const Transform3D world_to_local = _terrain->get_global_transform().affine_inverse();
+
+	VoxelEngine::get_singleton().for_each_viewer([&out_positions, &world_to_local](
+														 ViewerID viewer_id, const VoxelEngine::Viewer &viewer
+												 ) {
+		if (viewer.network_peer_id != -1 && viewer.network_peer_id != MultiplayerPeer::TARGET_PEER_SERVER) {
+			out_positions[viewer.network_peer_id].push_back(world_to_local.xform(viewer.world_position));
+		}
+	});
+}
+
+void VoxelTerrainMultiplayerSynchronizer::update_snapshots(Box3i voxel_box, bool keep) {
+	if (_block_snapshots.size() == 0) {
+		return;
+	}
+
+	VoxelData &data = _terrain->get_storage();
+	const Box3i block_box = voxel_box.downscaled(data.get_block_size());
+
+	block_box.for_each_cell_zxy([this, &data, keep](Vector3i bpos) {
+		auto it = _block_snapshots.find(bpos);
+		if (it == _block_snapshots.end()) {
+			// No peer was sent this block
+			return;
+		}
+		if (!keep) {
+			_block_snapshots.erase(it);
+			return;
+		}
+
+		std::shared_ptr<VoxelBuffer> voxels;
+		{
+			SpatialLock3D::Read srlock(data.get_spatial_lock(0), BoxBounds3i::from_position(bpos));
+			voxels = data.try_get_block_voxels(bpos);
+		}
+		if (voxels == nullptr) {
+			_block_snapshots.erase(it);
+			return;
+		}
+
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(*voxels);
+		if (result.success) {
+			it->second = result.data;
+		} else {
+			_block_snapshots.erase(it);
+		}
+	});
+}
+
+bool VoxelTerrainMultiplayerSynchronizer::encode_area_delta(
+		Box3i voxel_box,
+		const VoxelBuffer &voxels,
+		StdVector<uint8_t> &out_data
+) const {
+	ZN_PROFILE_SCOPE();
+
+	const VoxelData &data = _terrain->get_storage();
+	const Box3i block_box = voxel_box.downscaled(data.get_block_size());
+
+	// Voxels as peers currently have them. Where blocks aren't loaded, peers don't have them either.
+	VoxelBuffer old_voxels(VoxelBuffer::ALLOCATOR_POOL);
+	voxels.copy_to(old_voxels, false);
+
+	VoxelBuffer block_voxels(VoxelBuffer::ALLOCATOR_POOL);
+	bool complete = true;
+
+	block_box.for_each_cell_zxy([&](Vector3i bpos) {
+		if (!complete) {
+			return;
+		}
+
+		auto it = _block_snapshots.find(bpos);
+		if (it == _block_snapshots.end()) {
+			if (data.has_block(bpos, 0)) {
+				// We don't know which version peers have
+				complete = false;
+			}
+			return;
+		}
+
+		if (!BlockSerializer::decompress_and_deserialize(to_span(it->second), block_voxels)) {
+			complete = false;
+			return;
+		}
+
+		const Vector3i block_origin = data.block_to_voxel(bpos);
+		const Box3i box = Box3i(block_origin, block_voxels.get_size()).clipped(voxel_box);
+		const Vector3i src_min = box.position - block_origin;
+		const Vector3i dst_min = box.position - voxel_box.position;
+
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			if (block_voxels.get_channel_depth(channel_index) != old_voxels.get_channel_depth(channel_index)) {
+				complete = false;
+				return;
+			}
+			old_voxels.copy_channel_from(block_voxels, src_min, src_min + box.size, dst_min, channel_index);
+		}
+	});
+
+	if (!complete) {
+		return false;
+	}
+
+	StdVector<uint8_t> &delta_data = get_tls_delta_data();
+	delta_data.clear();
+	// Placeholder for the mask of changed channels
+	delta_data.push_back(0);
+	uint8_t channels_mask = 0;
+
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		if (encode_channel_runs(voxels, old_voxels, channel_index, delta_data)) {
+			channels_mask |= (1 << channel_index);
+		}
+	}
+
+	out_data.clear();
+	if (channels_mask == 0) {
+		return true;
+	}
+	delta_data[0] = channels_mask;
+
+	return CompressedData::compress(to_span(delta_data), out_data, CompressedData::COMPRESSION_LZ4);
+}
+
 void VoxelTerrainMultiplayerSynchronizer::_b_receive_blocks(PackedByteArray message_data) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT_RETURN(_terrain != nullptr);
@@ -192,6 +720,7 @@ void VoxelTerrainMultiplayerSynchronizer::_b_receive_blocks(PackedByteArray mess
 	MemoryReader mr(Span<const uint8_t>(message_data.ptr(), message_data.size()), ENDIANNESS_LITTLE_ENDIAN);
 
 	const unsigned int block_count = mr.get_32();
+	const unsigned int remaining_count = mr.get_32();
 
 	for (unsigned int i = 0; i < block_count; ++i) {
 		Vector3i bpos;
@@ -203,6 +732,17 @@ void VoxelTerrainMultiplayerSynchronizer::_b_receive_blocks(PackedByteArray mess
 		const int voxel_data_size = mr.get_16();
 		// print_line(String("Client: receive block {0} data {1}").format(varray(bpos, voxel_data_size)));
 
+		if (voxel_data_size == 0) {
+			// The block was never edited on the server, generate it here
+			ZN_ASSERT_CONTINUE_MSG(
+					_terrain->get_generator().is_valid(),
+					"The server sent a block to generate, but there is no generator"
+			);
+			_terrain->generate_block_async(bpos);
+			_generating_blocks[bpos] = _frame_index;
+			continue;
+		}
+
 		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
 		ZN_ASSERT_RETURN(BlockSerializer::decompress_and_deserialize(mr.data.sub(mr.pos, voxel_data_size), voxels));
 
@@ -213,7 +753,11 @@ void VoxelTerrainMultiplayerSynchronizer::_b_receive_blocks(PackedByteArray mess
 
 		ZN_ASSERT_RETURN(_terrain != nullptr);
 		_terrain->try_set_block_data(bpos, voxels_p);
+		// If it was generating, the generated version will be dropped since the block now exists
+		_generating_blocks.erase(bpos);
 	}
+
+	emit_signal(VoxelStringNames::get_singleton().blocks_received, block_count, remaining_count);
 }
 
 void VoxelTerrainMultiplayerSynchronizer::_b_receive_area(PackedByteArray message_data) {
@@ -222,22 +766,105 @@ void VoxelTerrainMultiplayerSynchronizer::_b_receive_area(PackedByteArray messag
 
 	MemoryReader mr(Span<const uint8_t>(message_data.ptr(), message_data.size()), ENDIANNESS_LITTLE_ENDIAN);
 
-	Vector3i pos;
-	pos.x = int32_t(mr.get_32());
-	pos.y = int32_t(mr.get_32());
-	pos.z = int32_t(mr.get_32());
-	const int voxel_data_size = mr.get_32();
+	const unsigned int area_count = mr.get_32();
+
+	for (unsigned int i = 0; i < area_count; ++i) {
+		const uint8_t encoding = mr.get_8();
+		Box3i box;
+		box.position = get_vector3i(mr);
+		box.size = get_vector3i(mr);
+		const unsigned int data_size = mr.get_32();
+		ZN_ASSERT_RETURN(mr.pos + data_size <= mr.data.size());
+		ZN_ASSERT_RETURN(Vector3iUtil::is_valid_size(box.size));
+
+		const Span<const uint8_t> data = mr.data.sub(mr.pos, data_size);
+		mr.pos += data_size;
+
+		if (_deferred_received_areas.size() > 0 || is_generating_blocks_in_area(box)) {
+			// Applying it now would miss blocks that are still generating. Edits must be applied in order.
+			ReceivedArea area;
+			area.encoding = encoding;
+			area.box = box;
+			area.data.resize(data.size());
+			data.copy_to(to_span(area.data));
+			_deferred_received_areas.push_back(std::move(area));
+			continue;
+		}
 
-	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
-	ZN_ASSERT_RETURN(BlockSerializer::decompress_and_deserialize(mr.data.sub(mr.pos, voxel_data_size), voxels));
+		ZN_ASSERT_RETURN(apply_received_area(encoding, box, data));
+	}
+}
+
+bool VoxelTerrainMultiplayerSynchronizer::apply_received_area(
+		uint8_t encoding,
+		Box3i box,
+		Span<const uint8_t> area_data
+) {
+	VoxelData &data = _terrain->get_storage();
+
+	if (encoding == AREA_ENCODING_FULL) {
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_POOL);
+		ZN_ASSERT_RETURN_V(BlockSerializer::decompress_and_deserialize(area_data, voxels), false);
+		ZN_ASSERT_RETURN_V(voxels.get_size() == box.size, false);
+		data.paste(box.position, voxels, 0xff, false);
+
+	} else if (encoding == AREA_ENCODING_DELTA) {
+		ZN_ASSERT_RETURN_V(apply_area_delta(data, box, area_data), false);
+
+	} else {
+		ZN_PRINT_ERROR(format("Unknown area encoding {}", encoding));
+		return false;
+	}
 
-	_terrain->get_storage().paste(pos, voxels, 0xff, false);
 	_terrain->post_edit_area(
-			Box3i(pos, voxels.get_size()),
+			box,
 			// Don't bother for now, update mesh regardless. If necessary we would have to add a flag with the message
 			// to tell it's not actually changing voxels (if it's metadata changes), but might not be worth it
 			true
 	);
+	return true;
+}
+
+bool VoxelTerrainMultiplayerSynchronizer::is_generating_blocks_in_area(Box3i voxel_box) const {
+	if (_generating_blocks.size() == 0) {
+		return false;
+	}
+	const Box3i block_box = voxel_box.downscaled(_terrain->get_storage().get_block_size());
+	bool found = false;
+	block_box.for_each_cell_zxy([this, &found](Vector3i bpos) {
+		if (_generating_blocks.find(bpos) != _generating_blocks.end()) {
+			found = true;
+		}
+	});
+	return found;
+}
+
+void VoxelTerrainMultiplayerSynchronizer::process_received_areas() {
+	if (_generating_blocks.size() == 0 && _deferred_received_areas.size() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	for (auto it = _generating_blocks.begin(); it != _generating_blocks.end();) {
+		// If the block got cancelled (no longer in range of a viewer), it won't be generated
+		if (_terrain->has_data_block(it->first) || _frame_index - it->second > GENERATING_BLOCK_TIMEOUT_FRAMES) {
+			it = _generating_blocks.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	unsigned int applied_count = 0;
+	for (const ReceivedArea &area : _deferred_received_areas) {
+		if (is_generating_blocks_in_area(area.box)) {
+			break;
+		}
+		apply_received_area(area.encoding, area.box, to_span(area.data));
+		++applied_count;
+	}
+	_deferred_received_areas.erase(
+			_deferred_received_areas.begin(), _deferred_received_areas.begin() + applied_count
+	);
 }
 
 #ifdef TOOLS_ENABLED
@@ -286,6 +913,58 @@ void VoxelTerrainMultiplayerSynchronizer::_bind_methods() {
 			D_METHOD("_rpc_receive_blocks", "data"), &VoxelTerrainMultiplayerSynchronizer::_b_receive_blocks
 	);
 	ClassDB::bind_method(D_METHOD("_rpc_receive_area", "data"), &VoxelTerrainMultiplayerSynchronizer::_b_receive_area);
+
+	ClassDB::bind_method(
+			D_METHOD("set_max_block_bytes_per_second", "bytes"),
+			&VoxelTerrainMultiplayerSynchronizer::set_max_block_bytes_per_second
+	);
+	ClassDB::bind_method(
+			D_METHOD("get_max_block_bytes_per_second"),
+			&VoxelTerrainMultiplayerSynchronizer::get_max_block_bytes_per_second
+	);
+
+	ClassDB::bind_method(
+			D_METHOD("set_delta_compression_enabled", "enabled"),
+			&VoxelTerrainMultiplayerSynchronizer::set_delta_compression_enabled
+	);
+	ClassDB::bind_method(
+			D_METHOD("is_delta_compression_enabled"),
+			&VoxelTerrainMultiplayerSynchronizer::is_delta_compression_enabled
+	);
+
+	ClassDB::bind_method(
+			D_METHOD("set_generated_block_stubs_enabled", "enabled"),
+			&VoxelTerrainMultiplayerSynchronizer::set_generated_block_stubs_enabled
+	);
+	ClassDB::bind_method(
+			D_METHOD("is_generated_block_stubs_enabled"),
+			&VoxelTerrainMultiplayerSynchronizer::is_generated_block_stubs_enabled
+	);
+
+	ClassDB::bind_method(
+			D_METHOD("get_pending_block_count", "peer_id"),
+			&VoxelTerrainMultiplayerSynchronizer::get_pending_block_count
+	);
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "max_block_bytes_per_second", PROPERTY_HINT_RANGE, "0,10000000,1,or_greater"),
+			"set_max_block_bytes_per_second",
+			"get_max_block_bytes_per_second"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "delta_compression_enabled"),
+			"set_delta_compression_enabled",
+			"is_delta_compression_enabled"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "generated_block_stubs_enabled"),
+			"set_generated_block_stubs_enabled",
+			"is_generated_block_stubs_enabled"
+	);
+
+	ADD_SIGNAL(MethodInfo(
+			"blocks_received", PropertyInfo(Variant::INT, "count"), PropertyInfo(Variant::INT, "remaining_count")
+	));
 }
 
 } // namespace zylann::voxel
@@ -1,7 +1,7 @@
 #ifndef VOXEL_NETWORK_TERRAIN_SYNC_H
 #define VOXEL_NETWORK_TERRAIN_SYNC_H
 
-#include "../../storage/voxel_data_block.h"
+#include "../../util/containers/span.h"
 #include "../../util/containers/std_unordered_map.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/classes/node.h"
@@ -14,6 +14,7 @@
 namespace zylann::voxel {
 
 class VoxelTerrain;
+class VoxelBuffer;
 
 // Implements multiplayer replication for `VoxelTerrain`
 class VoxelTerrainMultiplayerSynchronizer : public Node {
@@ -23,9 +24,29 @@ public:
 
 	bool is_server() const;
 
-	void send_block(int viewer_peer_id, const VoxelDataBlock &data_block, Vector3i bpos);
+	// Queues a block to be sent to a peer. Blocks are serialized when they are actually sent, closest to the peer's
+	// viewers first.
+	void send_block(int viewer_peer_id, Vector3i bpos);
+	// Queues an edited area to be sent to peers around it. Edits of the same frame are merged before being sent.
 	void send_area(Box3i voxel_box);
 
+	// Limits how many bytes of blocks are sent to each peer per second. 0 means no limit.
+	void set_max_block_bytes_per_second(int bytes);
+	int get_max_block_bytes_per_second() const;
+
+	// When enabled, blocks that were never edited are sent without their voxels, and clients generate them. Clients
+	// must have the same generator as the server.
+	void set_generated_block_stubs_enabled(bool enabled);
+	bool is_generated_block_stubs_enabled() const;
+
+	// Server-side, how many blocks are waiting to be sent to a peer
+	int get_pending_block_count(int peer_id) const;
+
+	// When enabled, the server keeps a compressed copy of blocks as they were last sent, so edits can be sent as
+	// differences with that copy instead of full areas.
+	void set_delta_compression_enabled(bool enabled);
+	bool is_delta_compression_enabled() const;
+
 #ifdef TOOLS_ENABLED
 #if defined(ZN_GODOT)
 	PackedStringArray get_configuration_warnings() const override;
@@ -39,6 +60,21 @@ private:
 	void _notification(int p_what);
 
 	void process();
+	void process_edits();
+	void process_blocks();
+	void get_peer_positions(StdUnorderedMap<int, StdVector<Vector3>> &out_positions) const;
+	void update_snapshots(Box3i voxel_box, bool keep);
+	bool encode_area_delta(Box3i voxel_box, const VoxelBuffer &voxels, StdVector<uint8_t> &out_data) const;
+
+	struct ReceivedArea {
+		uint8_t encoding;
+		Box3i box;
+		StdVector<uint8_t> data;
+	};
+
+	void process_received_areas();
+	bool is_generating_blocks_in_area(Box3i voxel_box) const;
+	bool apply_received_area(uint8_t encoding, Box3i box, Span<const uint8_t> area_data);
 
 	void _b_receive_blocks(PackedByteArray message_data);
 	void _b_receive_area(PackedByteArray message_data);
@@ -47,12 +83,31 @@ private:
 
 	VoxelTerrain *_terrain = nullptr;
 	int _rpc_channel = 0;
-
-	struct DeferredBlockMessage {
-		PackedByteArray data;
+	unsigned int _max_block_bytes_per_second = 0;
+	bool _delta_compression_enabled = true;
+	bool _generated_block_stubs_enabled = false;
+	unsigned int _frame_index = 0;
+
+	// Server-side
+	struct PeerState {
+		// Block positions waiting to be sent
+		StdVector<Vector3i> deferred_blocks;
+		// How many bytes of blocks can be sent, when there is a limit
+		float block_bytes_credit = 0.f;
 	};
 
-	StdUnorderedMap<int, StdVector<DeferredBlockMessage>> _deferred_block_messages_per_peer;
+	StdUnorderedMap<int, PeerState> _peers;
+	// Areas edited since the last frame
+	StdVector<Box3i> _pending_edits;
+	// Compressed blocks as they were last sent to peers. All peers receive messages in order on a reliable channel,
+	// so the ones having a block got the same version of it, and edits can be encoded as differences with it.
+	StdUnorderedMap<Vector3i, StdVector<uint8_t>> _block_snapshots;
+
+	// Client-side
+	// Blocks the server told to generate locally, and the frame at which it did
+	StdUnorderedMap<Vector3i, unsigned int> _generating_blocks;
+	// Edits received while blocks they touch were still generating, applied in order once they are ready
+	StdVector<ReceivedArea> _deferred_received_areas;
 };
 
 } // namespace zylann::voxel
@@ -0,0 +1,170 @@
+#ifndef VOXEL_TERRAIN_UPDATE_DATA_H
+#define VOXEL_TERRAIN_UPDATE_DATA_H
+
+#include "../../constants/voxel_constants.h"
+#include "../../engine/ids.h"
+#include "../../engine/voxel_engine.h"
+#include "../../storage/voxel_data.h"
+#include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/box3i.h"
+#include "../../util/ref_count.h"
+#include "../../util/thread/mutex.h"
+#include "../../util/thread/rw_lock.h"
+
+#include <atomic>
+#include <memory>
+
+namespace zylann::voxel {
+
+// Settings and states needed for the multi-threaded part of the update loop of VoxelTerrain.
+// See `VoxelTerrainUpdateTask` for more info.
+struct VoxelTerrainUpdateData {
+	// Paired viewers are VoxelViewers which intersect with the boundaries of the volume
+	struct PairedViewer {
+		struct State {
+			Vector3i local_position_voxels;
+			Box3i data_box; // In block coordinates
+			// Data blocks around the predicted position of the viewer, loaded in advance. Empty if not moving.
+			Box3i prefetch_box;
+			Box3i mesh_box;
+			int horizontal_view_distance_voxels = 0;
+			int vertical_view_distance_voxels = 0;
+			bool requires_collisions = false;
+			bool requires_meshes = false;
+		};
+		ViewerID id;
+		State state;
+		State prev_state;
+	};
+
+	struct LoadingBlock {
+		RefCount viewers;
+		// TODO Optimize allocations here
+		StdVector<ViewerID> viewers_to_notify;
+	};
+
+	struct QuickReloadingBlock {
+		std::shared_ptr<VoxelBuffer> voxels;
+		Vector3i position;
+	};
+
+	// Part of a mesh block that doesn't require the main thread. Meshes and colliders are in `VoxelMeshBlockVT`.
+	struct MeshBlockState {
+		RefCount mesh_viewers;
+		RefCount collision_viewers;
+		// True if this block is in the update list, so multiple edits done before it processes will not add it
+		// multiple times
+		bool is_in_update_list = false;
+		// True if the pending update was requested because voxels were edited
+		bool is_update_from_edit = false;
+		// Incremented when a mesh task is sent for this block, so older tasks still in flight get superseded.
+		// See `MeshBlockTask::supersede_previous_tasks`.
+		std::shared_ptr<std::atomic_uint32_t> mesh_version;
+	};
+
+	struct AreaToRemesh {
+		Box3i voxel_box;
+		bool from_edit;
+	};
+
+	struct BlockEnterNotification {
+		VoxelDataBlock block;
+		Vector3i position;
+		ViewerID viewer_id;
+	};
+
+	struct Stats {
+		int updated_blocks = 0;
+		int dropped_block_loads = 0;
+		int dropped_block_meshs = 0;
+		uint32_t time_detect_required_blocks = 0;
+		uint32_t time_request_blocks_to_load = 0;
+		uint32_t time_process_load_responses = 0;
+		uint32_t time_request_blocks_to_update = 0;
+		// Blocks requested ahead of viewers based on their velocity
+		uint32_t prefetched_blocks = 0;
+		// Prefetched blocks that were already loaded when viewers got close enough to need them
+		uint32_t prefetch_hits = 0;
+		// Prefetched blocks that were still loading when viewers got close enough to need them
+		uint32_t prefetch_misses = 0;
+		// Prefetched blocks whose loading was cancelled because viewers took a different direction
+		uint32_t prefetch_cancelled = 0;
+	};
+
+	// These values don't change during the update task. They are copied from the node before each update.
+	struct Settings {
+		uint8_t mesh_block_size_po2 = constants::DEFAULT_BLOCK_SIZE_PO2;
+		unsigned int max_view_distance_voxels = 128;
+		bool generate_collisions = true;
+		bool has_mesher = false;
+		// Whether viewers cause blocks to load. Depends on the stream, generator, networking role and editor settings.
+		bool can_load_blocks = false;
+		// Whether unloaded blocks having modifications are sent to the stream
+		bool can_save_blocks = false;
+		// Whether viewers loading blocks require `_on_data_block_entered` or network notifications
+		bool block_enter_notifications_enabled = false;
+		bool generator_use_gpu = false;
+		// See `VoxelNode::set_task_priority`
+		int task_priority = 0;
+	};
+
+	// Data modified by the update task
+	struct State {
+		StdVector<PairedViewer> paired_viewers;
+
+		// Read by the main thread when meshes are received, which can happen while the update task runs
+		StdUnorderedMap<Vector3i, MeshBlockState> mesh_blocks;
+		RWLock mesh_blocks_lock;
+		// Block meshes that should be updated. The order in that list does not matter.
+		StdVector<Vector3i> blocks_pending_update;
+
+		// Blocks currently being loaded, and blocks that should be requested. Also accessed by the main thread when
+		// responses are received.
+		StdUnorderedMap<Vector3i, LoadingBlock> loading_blocks;
+		StdVector<Vector3i> blocks_pending_load;
+		BinaryMutex loading_blocks_mutex;
+
+		// Data blocks that have been unloaded and needed saving. They are temporarily stored here until saving
+		// completes, and is checked first before loading new blocks. This is in case players leave an area and come
+		// back to it faster than saving, because otherwise loading from stream would return an outdated version.
+		StdUnorderedMap<Vector3i, std::shared_ptr<VoxelBuffer>> unloaded_saving_blocks;
+		BinaryMutex unloaded_saving_blocks_mutex;
+
+		// Inputs written by the main thread, consumed by the next update
+		StdVector<AreaToRemesh> areas_to_remesh;
+		bool remesh_all_blocks = false;
+		BinaryMutex pending_inputs_mutex;
+
+		// Outputs of the update task, consumed by the main thread when the task is complete
+		StdVector<QuickReloadingBlock> quick_reloading_blocks;
+		StdVector<Vector3i> mesh_blocks_to_create;
+		StdVector<Vector3i> mesh_blocks_to_unload;
+		StdVector<Vector3i> mesh_blocks_to_drop_visuals;
+		StdVector<Vector3i> mesh_blocks_to_drop_collisions;
+		StdVector<Vector3i> unloaded_data_blocks;
+		StdVector<BlockEnterNotification> block_enter_notifications;
+
+		Stats stats;
+	};
+
+	// Set to true when the update task is finished
+	std::atomic_bool task_is_complete = { true };
+	// Will be locked as long as the update task is running.
+	BinaryMutex completion_mutex;
+
+	Settings settings;
+	State state;
+
+	// Copy of all viewers, since accessing them directly in VoxelEngine is not thread safe at the moment
+	StdVector<std::pair<ViewerID, VoxelEngine::Viewer>> viewers;
+
+	// After this call, no locking is necessary, as no other thread should be using the data.
+	void wait_for_end_of_task() {
+		MutexLock lock(completion_mutex);
+	}
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_TERRAIN_UPDATE_DATA_H
@@ -0,0 +1,1045 @@
+#include "voxel_terrain_update_task.h"
+#include "../../engine/buffered_task_scheduler.h"
+#include "../../engine/voxel_engine.h"
+#include "../../generators/generate_block_task.h"
+#include "../../meshers/mesh_block_task.h"
+#include "../../streams/load_block_data_task.h"
+#include "../../streams/save_block_data_task.h"
+#include "../../util/containers/container_funcs.h"
+#include "../../util/math/conv.h"
+#include "../../util/profiling.h"
+#include "../../util/profiling_clock.h"
+#include "../../util/string/format.h"
+
+namespace zylann::voxel {
+
+namespace {
+
+Vector3i get_block_center(Vector3i pos, int bs) {
+	return pos * bs + Vector3iUtil::create(bs / 2);
+}
+
+void init_sparse_grid_priority_dependency(
+		PriorityDependency &dep,
+		Vector3i block_position,
+		int block_size,
+		std::shared_ptr<PriorityDependency::ViewersData> &shared_viewers_data,
+		const Transform3D &volume_transform,
+		int volume_task_priority
+) {
+	const Vector3i voxel_pos = get_block_center(block_position, block_size);
+	const float block_radius = block_size / 2;
+	dep.shared = shared_viewers_data;
+	dep.set_volume_task_priority(volume_task_priority);
+	dep.world_position = to_vec3f(volume_transform.xform(voxel_pos));
+	const float transformed_block_radius =
+			volume_transform.basis.xform(Vector3(block_radius, block_radius, block_radius)).length();
+
+	// Distance beyond which no field of view can overlap the block.
+	// Doubling block radius to account for an extra margin of blocks,
+	// since they are used to provide neighbors when meshing
+	dep.drop_distance_squared =
+			math::squared(shared_viewers_data->highest_view_distance + 2.f * transformed_block_radius);
+}
+
+void request_block_load(
+		VolumeID volume_id,
+		std::shared_ptr<StreamingDependency> stream_dependency,
+		Vector3i block_pos,
+		std::shared_ptr<PriorityDependency::ViewersData> &shared_viewers_data,
+		const Transform3D volume_transform,
+		BufferedTaskScheduler &scheduler,
+		bool use_gpu,
+		const std::shared_ptr<VoxelData> &voxel_data,
+		int volume_task_priority
+) {
+	ZN_ASSERT(stream_dependency != nullptr);
+
+	if (use_gpu && (stream_dependency->generator.is_null() || !stream_dependency->generator->supports_shaders())) {
+		use_gpu = false;
+	}
+
+	const unsigned int data_block_size = voxel_data->get_block_size();
+
+	if (stream_dependency->stream.is_valid()) {
+		PriorityDependency priority_dependency;
+		init_sparse_grid_priority_dependency(
+				priority_dependency,
+				block_pos,
+				data_block_size,
+				shared_viewers_data,
+				volume_transform,
+				volume_task_priority
+		);
+
+		const bool request_instances = false;
+		LoadBlockDataTask *task = ZN_NEW(LoadBlockDataTask(
+				volume_id,
+				block_pos,
+				0,
+				data_block_size,
+				request_instances,
+				stream_dependency,
+				priority_dependency,
+				true,
+				use_gpu,
+				voxel_data,
+				TaskCancellationToken()
+		));
+
+		scheduler.push_io_task(task);
+
+	} else {
+		// Directly generate the block without checking the stream
+		ERR_FAIL_COND(stream_dependency->generator.is_null());
+
+		VoxelGenerator::BlockTaskParams params;
+		params.volume_id = volume_id;
+		params.block_position = block_pos;
+		params.block_size = data_block_size;
+		params.stream_dependency = stream_dependency;
+		params.use_gpu = use_gpu;
+		params.data = voxel_data;
+
+		init_sparse_grid_priority_dependency(
+				params.priority_dependency,
+				block_pos,
+				data_block_size,
+				shared_viewers_data,
+				volume_transform,
+				volume_task_priority
+		);
+
+		IThreadedTask *task = stream_dependency->generator->create_block_task(params);
+
+		scheduler.push_main_task(task);
+	}
+}
+
+struct UpdateContext {
+	VoxelTerrainUpdateData::State &state;
+	const VoxelTerrainUpdateData::Settings &settings;
+	VoxelData &data;
+	const int data_block_size;
+	const int mesh_block_size;
+};
+
+// Must be called with the mesh block map locked for writing
+void try_schedule_mesh_update(
+		UpdateContext &ctx,
+		VoxelTerrainUpdateData::MeshBlockState &mesh_block,
+		Vector3i bpos,
+		bool from_edit
+) {
+	if (mesh_block.is_in_update_list) {
+		// Already in the list
+		mesh_block.is_update_from_edit |= from_edit;
+		return;
+	}
+	if (mesh_block.mesh_viewers.get() == 0 && mesh_block.collision_viewers.get() == 0) {
+		// No viewers want mesh on this block (why even call this function then?)
+		return;
+	}
+
+	const int render_to_data_factor = ctx.mesh_block_size / ctx.data_block_size;
+
+	const Box3i data_box = Box3i(bpos * render_to_data_factor, Vector3iUtil::create(render_to_data_factor)).padded(1);
+
+	// If we get an empty box at this point, something is wrong with the caller
+	ZN_ASSERT_RETURN(!data_box.is_empty());
+
+	const bool data_available = ctx.data.has_all_blocks_in_area(data_box, 0);
+
+	if (data_available) {
+		// Regardless of if the updater is updating the block already,
+		// the block could have been modified again so we schedule another update
+		mesh_block.is_in_update_list = true;
+		mesh_block.is_update_from_edit = from_edit;
+		ctx.state.blocks_pending_update.push_back(bpos);
+	}
+}
+
+// Must be called with the mesh block map locked for writing
+void view_mesh_block(UpdateContext &ctx, Vector3i bpos, bool mesh_flag, bool collision_flag) {
+	if (mesh_flag == false && collision_flag == false) {
+		// Why even call the function?
+		return;
+	}
+
+	auto it = ctx.state.mesh_blocks.find(bpos);
+
+	if (it == ctx.state.mesh_blocks.end()) {
+		// Create if not found
+		it = ctx.state.mesh_blocks.insert({ bpos, VoxelTerrainUpdateData::MeshBlockState() }).first;
+		ctx.state.mesh_blocks_to_create.push_back(bpos);
+	}
+
+	VoxelTerrainUpdateData::MeshBlockState &block = it->second;
+
+	if (mesh_flag) {
+		block.mesh_viewers.add();
+	}
+	if (collision_flag) {
+		block.collision_viewers.add();
+	}
+
+	// This is needed in case a viewer wants to view meshes in places data blocks are already present.
+	// Before that, meshes were updated only when a data block was loaded or modified,
+	// so changing block size or viewer flags did not make meshes appear.
+	try_schedule_mesh_update(ctx, block, bpos, false);
+
+	// TODO this logic schedules a mesh update even if there is a mesh already. It hides the fact that mixing up
+	// viewers with collisions and viewers without will not actually create colliders/meshes individually.
+
+	// TODO viewers with varying flags during the game is not supported at the moment.
+	// They have to be re-created, which may cause world re-load...
+}
+
+// Must be called with the mesh block map locked for writing
+void unview_mesh_block(UpdateContext &ctx, Vector3i bpos, bool mesh_flag, bool collision_flag) {
+	auto it = ctx.state.mesh_blocks.find(bpos);
+	// Mesh blocks are created on first view call,
+	// so that would mean we unview one without viewing it in the first place
+	ZN_ASSERT_RETURN(it != ctx.state.mesh_blocks.end());
+
+	VoxelTerrainUpdateData::MeshBlockState &block = it->second;
+
+	if (mesh_flag) {
+		block.mesh_viewers.remove();
+		if (block.mesh_viewers.get() == 0) {
+			// Mesh no longer required
+			ctx.state.mesh_blocks_to_drop_visuals.push_back(bpos);
+		}
+	}
+
+	if (collision_flag) {
+		block.collision_viewers.remove();
+		if (block.collision_viewers.get() == 0) {
+			// Collision no longer required
+			ctx.state.mesh_blocks_to_drop_collisions.push_back(bpos);
+		}
+	}
+
+	if (block.mesh_viewers.get() == 0 && block.collision_viewers.get() == 0) {
+		if (block.is_in_update_list) {
+			// That block was in the list of blocks to update later in the process loop, we'll need to unregister
+			// it. We expect that block to be in that list. If it isn't, something wrong happened with its state.
+			ZN_ASSERT_RETURN(unordered_remove_value(ctx.state.blocks_pending_update, bpos));
+		}
+		ctx.state.mesh_blocks.erase(it);
+		ctx.state.mesh_blocks_to_unload.push_back(bpos);
+	}
+}
+
+void process_remesh_requests(UpdateContext &ctx) {
+	ZN_PROFILE_SCOPE();
+
+	static thread_local StdVector<VoxelTerrainUpdateData::AreaToRemesh> tls_areas;
+	StdVector<VoxelTerrainUpdateData::AreaToRemesh> &areas = tls_areas;
+	bool remesh_all_blocks;
+	{
+		MutexLock mlock(ctx.state.pending_inputs_mutex);
+		areas.swap(ctx.state.areas_to_remesh);
+		remesh_all_blocks = ctx.state.remesh_all_blocks;
+		ctx.state.remesh_all_blocks = false;
+	}
+
+	if (!ctx.settings.has_mesher) {
+		// No mesher, can't do updates
+		areas.clear();
+		return;
+	}
+
+	RWLockWrite wlock(ctx.state.mesh_blocks_lock);
+
+	if (remesh_all_blocks) {
+		for (auto it = ctx.state.mesh_blocks.begin(); it != ctx.state.mesh_blocks.end(); ++it) {
+			try_schedule_mesh_update(ctx, it->second, it->first, false);
+		}
+	}
+
+	for (const VoxelTerrainUpdateData::AreaToRemesh &area : areas) {
+		// We pad by 1 because neighbor blocks might be affected visually (for example, baked ambient occlusion)
+		const Box3i mesh_box = area.voxel_box.padded(1).downscaled(ctx.mesh_block_size);
+		mesh_box.for_each_cell([&ctx, &area](Vector3i pos) {
+			auto it = ctx.state.mesh_blocks.find(pos);
+			// There isn't necessarily a mesh block, if the edit happens in a boundary,
+			// or if it is done next to a viewer that doesn't need meshes
+			if (it != ctx.state.mesh_blocks.end()) {
+				try_schedule_mesh_update(ctx, it->second, pos, area.from_edit);
+			}
+		});
+	}
+
+	areas.clear();
+}
+
+bool has_viewer(Span<const std::pair<ViewerID, VoxelEngine::Viewer>> viewers, ViewerID id) {
+	for (const std::pair<ViewerID, VoxelEngine::Viewer> &p : viewers) {
+		if (p.first == id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void process_viewer_data_box_change(
+		UpdateContext &ctx,
+		ViewerID viewer_id,
+		// Null if the viewer was destroyed
+		const VoxelEngine::Viewer *viewer,
+		Box3i prev_data_box,
+		Box3i new_data_box,
+		// The box is a prefetch box instead of a data box. Each of them holds its own reference to blocks.
+		bool prefetch,
+		// Used to measure how well blocks entering the data box were prefetched
+		Box3i prev_prefetch_box,
+		VoxelGenerator *generator,
+		StdVector<VoxelData::BlockToSave> &blocks_to_save
+) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(prev_data_box != new_data_box);
+
+	static thread_local StdVector<Vector3i> tls_missing_blocks;
+	static thread_local StdVector<Vector3i> tls_found_blocks_positions;
+
+	VoxelTerrainUpdateData::State &state = ctx.state;
+	VoxelTerrainUpdateData::Stats &stats = state.stats;
+
+	if (generator != nullptr && !prefetch) {
+		generator->process_viewer_diff(viewer_id, new_data_box, prev_data_box);
+	}
+
+	// Unview blocks that just fell out of range
+	//
+	// TODO Any reason to unview old blocks before viewing new blocks?
+	// Because if a viewer is removed and another is added, it will reload the whole area even if their box is the same.
+	{
+		const bool may_save = ctx.settings.can_save_blocks;
+
+		tls_missing_blocks.clear();
+		tls_found_blocks_positions.clear();
+
+		const unsigned int to_save_index0 = blocks_to_save.size();
+
+		// Decrement refcounts from loaded blocks, and unload them
+		prev_data_box.difference(new_data_box, [&ctx, may_save, &blocks_to_save](Box3i out_of_range_box) {
+			// ZN_PRINT_VERBOSE(format("Unview data box {}", out_of_range_box));
+			ctx.data.unview_area(
+					out_of_range_box,
+					0,
+					&tls_found_blocks_positions,
+					&tls_missing_blocks,
+					may_save ? &blocks_to_save : nullptr
+			);
+		});
+
+		// Temporarily store unloaded blocks in a map until saving completes
+		if (to_save_index0 < blocks_to_save.size()) {
+			MutexLock mlock(state.unloaded_saving_blocks_mutex);
+			for (unsigned int i = to_save_index0; i < blocks_to_save.size(); ++i) {
+				const VoxelData::BlockToSave &bts = blocks_to_save[i];
+				state.unloaded_saving_blocks[bts.position] = bts.voxels;
+			}
+		}
+
+		MutexLock mlock(state.loading_blocks_mutex);
+
+		// Remove loading blocks (those were loaded and had their refcount reach zero)
+		for (const Vector3i bpos : tls_found_blocks_positions) {
+			// Signals are emitted on the main thread
+			state.unloaded_data_blocks.push_back(bpos);
+			// TODO If they were loaded, why would they be in loading blocks?
+			// Probably in case we move so fast that blocks haven't even finished loading
+			state.loading_blocks.erase(bpos);
+		}
+
+		// Remove refcount from loading blocks, and cancel loading if it reaches zero
+		{
+			ZN_PROFILE_SCOPE_NAMED("Cancel missing blocks");
+			for (const Vector3i bpos : tls_missing_blocks) {
+				auto loading_block_it = state.loading_blocks.find(bpos);
+				if (loading_block_it == state.loading_blocks.end()) {
+					ZN_PRINT_VERBOSE("Request to unview a loading block that was never requested");
+					// Not expected, but fine I guess
+					return;
+				}
+
+				VoxelTerrainUpdateData::LoadingBlock &loading_block = loading_block_it->second;
+				loading_block.viewers.remove();
+
+				if (loading_block.viewers.get() == 0) {
+					// No longer want to load it
+					state.loading_blocks.erase(loading_block_it);
+
+					if (prefetch) {
+						++stats.prefetch_cancelled;
+					}
+
+					// TODO Do we really need that vector after all?
+					unordered_remove_value(state.blocks_pending_load, bpos);
+				}
+			}
+		}
+	}
+
+	// View blocks coming into range
+	if (ctx.settings.can_load_blocks) {
+		const bool require_notifications = !prefetch && ctx.settings.block_enter_notifications_enabled &&
+				viewer != nullptr && // Could be a destroyed viewer
+				viewer->requires_data_block_notifications;
+
+		static thread_local StdVector<VoxelDataBlock> tls_found_blocks;
+
+		tls_missing_blocks.clear();
+		tls_found_blocks.clear();
+		tls_found_blocks_positions.clear();
+
+		new_data_box.difference(prev_data_box, [&ctx](Box3i box_to_load) {
+			// ZN_PRINT_VERBOSE(format("View data box {}", box_to_load));
+			ctx.data.view_area(box_to_load, 0, &tls_missing_blocks, &tls_found_blocks_positions, &tls_found_blocks);
+		});
+
+		if (!prev_prefetch_box.is_empty()) {
+			for (const Vector3i bpos : tls_found_blocks_positions) {
+				if (prev_prefetch_box.contains(bpos)) {
+					++stats.prefetch_hits;
+				}
+			}
+			for (const Vector3i bpos : tls_missing_blocks) {
+				if (prev_prefetch_box.contains(bpos)) {
+					++stats.prefetch_misses;
+				}
+			}
+		}
+
+		// Schedule loading of missing blocks
+		{
+			ZN_PROFILE_SCOPE_NAMED("Gather missing blocks");
+			MutexLock mlock(state.loading_blocks_mutex);
+
+			for (const Vector3i missing_bpos : tls_missing_blocks) {
+				auto loading_block_it = state.loading_blocks.find(missing_bpos);
+
+				if (loading_block_it == state.loading_blocks.end()) {
+					// First viewer to request it
+					VoxelTerrainUpdateData::LoadingBlock new_loading_block;
+					new_loading_block.viewers.add();
+
+					if (require_notifications) {
+						new_loading_block.viewers_to_notify.push_back(viewer_id);
+					}
+
+					state.loading_blocks.insert({ missing_bpos, new_loading_block });
+					state.blocks_pending_load.push_back(missing_bpos);
+
+					if (prefetch) {
+						++stats.prefetched_blocks;
+					}
+
+				} else {
+					// More viewers
+					VoxelTerrainUpdateData::LoadingBlock &loading_block = loading_block_it->second;
+					loading_block.viewers.add();
+
+					if (require_notifications) {
+						loading_block.viewers_to_notify.push_back(viewer_id);
+					}
+				}
+			}
+		}
+
+		if (require_notifications) {
+			// Notifications for blocks that were already loaded. They call scripts, so they are done on the main
+			// thread.
+			for (unsigned int i = 0; i < tls_found_blocks.size(); ++i) {
+				state.block_enter_notifications.push_back(
+						VoxelTerrainUpdateData::BlockEnterNotification{
+								tls_found_blocks[i], tls_found_blocks_positions[i], viewer_id }
+				);
+			}
+		}
+
+		// Make sure to clear this because it holds refcounted stuff. If we don't, it could crash on exit because the
+		// voxel engine deinitializes its stuff before thread_locals get destroyed
+		tls_found_blocks.clear();
+
+		// TODO viewers with varying flags during the game is not supported at the moment.
+		// They have to be re-created, which may cause world re-load...
+	}
+}
+
+void process_viewer_mesh_box_change(UpdateContext &ctx, const VoxelTerrainUpdateData::PairedViewer &viewer) {
+	const Box3i &new_mesh_box = viewer.state.mesh_box;
+	const Box3i &prev_mesh_box = viewer.prev_state.mesh_box;
+
+	if (prev_mesh_box != new_mesh_box) {
+		ZN_PROFILE_SCOPE();
+
+		// TODO Any reason to unview old blocks before viewing new blocks?
+		// Because if a viewer is removed and another is added, it will reload the whole area even if their
+		// box is the same.
+
+		// Unview blocks that just fell out of range
+		prev_mesh_box.difference(new_mesh_box, [&ctx, &viewer](Box3i out_of_range_box) {
+			out_of_range_box.for_each_cell([&ctx, &viewer](Vector3i bpos) {
+				unview_mesh_block(
+						ctx, bpos, viewer.prev_state.requires_meshes, viewer.prev_state.requires_collisions
+				);
+			});
+		});
+
+		// View blocks that just entered the range
+		new_mesh_box.difference(prev_mesh_box, [&ctx, &viewer](Box3i box_to_load) {
+			box_to_load.for_each_cell([&ctx, &viewer](Vector3i bpos) {
+				// Load or update block
+				view_mesh_block(ctx, bpos, viewer.state.requires_meshes, viewer.state.requires_collisions);
+			});
+		});
+	}
+
+	// Blocks that remained within range of the viewer may need some changes too if viewer flags were
+	// modified. This operates on a DISTINCT set of blocks than the one above.
+
+	if (viewer.state.requires_collisions != viewer.prev_state.requires_collisions) {
+		const Box3i box = new_mesh_box.clipped(prev_mesh_box);
+		if (viewer.state.requires_collisions) {
+			box.for_each_cell([&ctx](Vector3i bpos) { //
+				view_mesh_block(ctx, bpos, false, true);
+			});
+
+		} else {
+			box.for_each_cell([&ctx](Vector3i bpos) { //
+				unview_mesh_block(ctx, bpos, false, true);
+			});
+		}
+	}
+
+	if (viewer.state.requires_meshes != viewer.prev_state.requires_meshes) {
+		const Box3i box = new_mesh_box.clipped(prev_mesh_box);
+		if (viewer.state.requires_meshes) {
+			box.for_each_cell([&ctx](Vector3i bpos) { //
+				view_mesh_block(ctx, bpos, true, false);
+			});
+
+		} else {
+			box.for_each_cell([&ctx](Vector3i bpos) { //
+				unview_mesh_block(ctx, bpos, true, false);
+			});
+		}
+	}
+}
+
+void update_paired_viewer_state(
+		UpdateContext &ctx,
+		VoxelTerrainUpdateData::PairedViewer &paired_viewer,
+		const VoxelEngine::Viewer &viewer,
+		const Transform3D &world_to_local_transform,
+		float view_distance_scale,
+		Box3i bounds_in_data_blocks,
+		Box3i bounds_in_mesh_blocks
+) {
+	paired_viewer.prev_state = paired_viewer.state;
+	VoxelTerrainUpdateData::PairedViewer::State &state = paired_viewer.state;
+
+	const unsigned int view_distance_voxels_h =
+			static_cast<unsigned int>(static_cast<float>(viewer.view_distances.horizontal) * view_distance_scale);
+	const unsigned int view_distance_voxels_v =
+			static_cast<unsigned int>(static_cast<float>(viewer.view_distances.vertical) * view_distance_scale);
+
+	const Vector3 local_position = world_to_local_transform.xform(viewer.world_position);
+
+	state.horizontal_view_distance_voxels = math::min(view_distance_voxels_h, ctx.settings.max_view_distance_voxels);
+	state.vertical_view_distance_voxels = math::min(view_distance_voxels_v, ctx.settings.max_view_distance_voxels);
+
+	state.local_position_voxels = math::floor_to_int(local_position);
+	state.requires_collisions = viewer.require_collisions;
+	state.requires_meshes = viewer.require_visuals && ctx.settings.has_mesher;
+
+	// Update data and mesh view boxes
+
+	const int data_block_size = ctx.data_block_size;
+	const int mesh_block_size = ctx.mesh_block_size;
+
+	int view_distance_data_blocks_h;
+	int view_distance_data_blocks_v;
+	Vector3i data_block_pos;
+
+	if (state.requires_meshes || state.requires_collisions) {
+		const int view_distance_mesh_blocks_h = math::ceildiv(state.horizontal_view_distance_voxels, mesh_block_size);
+		const int view_distance_mesh_blocks_v = math::ceildiv(state.vertical_view_distance_voxels, mesh_block_size);
+
+		const int render_to_data_factor = (mesh_block_size / data_block_size);
+		const Vector3i mesh_block_pos = math::floordiv(state.local_position_voxels, mesh_block_size);
+
+		// Adding one block of padding because meshing requires neighbors
+		view_distance_data_blocks_h = view_distance_mesh_blocks_h * render_to_data_factor + 1;
+		view_distance_data_blocks_v = view_distance_mesh_blocks_v * render_to_data_factor + 1;
+
+		data_block_pos = mesh_block_pos * render_to_data_factor;
+		state.mesh_box =
+				Box3i::from_center_extents(
+						mesh_block_pos,
+						Vector3i(view_distance_mesh_blocks_h, view_distance_mesh_blocks_v, view_distance_mesh_blocks_h)
+				)
+						.clipped(bounds_in_mesh_blocks);
+
+	} else {
+		view_distance_data_blocks_h = math::ceildiv(state.horizontal_view_distance_voxels, data_block_size);
+		view_distance_data_blocks_v = math::ceildiv(state.vertical_view_distance_voxels, data_block_size);
+
+		data_block_pos = math::floordiv(state.local_position_voxels, data_block_size);
+		state.mesh_box = Box3i();
+	}
+
+	const Vector3i data_box_extents(
+			view_distance_data_blocks_h, view_distance_data_blocks_v, view_distance_data_blocks_h
+	);
+
+	state.data_box = Box3i::from_center_extents(data_block_pos, data_box_extents).clipped(bounds_in_data_blocks);
+
+	// Same box, moved to where the viewer is predicted to be. Blocks in it get loaded ahead of time, and
+	// if the viewer turns, the box moves away and loads that haven't completed get cancelled.
+	const Vector3 local_prefetch_offset = world_to_local_transform.basis.xform(viewer.get_prefetch_offset());
+	const Vector3i prefetch_block_offset =
+			math::floordiv(math::floor_to_int(local_position + local_prefetch_offset), data_block_size) -
+			math::floordiv(state.local_position_voxels, data_block_size);
+
+	if (prefetch_block_offset == Vector3i()) {
+		state.prefetch_box = Box3i();
+	} else {
+		state.prefetch_box = Box3i::from_center_extents(data_block_pos + prefetch_block_offset, data_box_extents)
+									 .clipped(bounds_in_data_blocks);
+	}
+}
+
+void process_viewers(
+		UpdateContext &ctx,
+		Span<const std::pair<ViewerID, VoxelEngine::Viewer>> viewers,
+		const Transform3D &volume_transform,
+		VoxelGenerator *generator,
+		StdVector<VoxelData::BlockToSave> &blocks_to_save
+) {
+	VoxelTerrainUpdateData::State &state = ctx.state;
+	StdVector<VoxelTerrainUpdateData::PairedViewer> &paired_viewers = state.paired_viewers;
+
+	// Ordered by ascending index in paired viewers list
+	StdVector<size_t> unpaired_viewer_indexes;
+
+	// Update viewers
+	{
+		// Our node doesn't have bounds yet, so for now viewers are always paired.
+		// TODO Update: the node has bounds now, need to change this
+
+		// Destroyed viewers
+		for (size_t i = 0; i < paired_viewers.size(); ++i) {
+			VoxelTerrainUpdateData::PairedViewer &p = paired_viewers[i];
+			if (!has_viewer(viewers, p.id)) {
+				ZN_PRINT_VERBOSE(format("Detected destroyed viewer {} in VoxelTerrain", p.id));
+				// Interpret removal as nullified view distance so the same code handling loading of blocks
+				// will be used to unload those viewed by this viewer.
+				// We'll actually remove unpaired viewers in a second pass.
+				p.state.vertical_view_distance_voxels = 0;
+				p.state.horizontal_view_distance_voxels = 0;
+				// Also update boxes, they won't be updated since the viewer has been removed.
+				// Assign prev state, otherwise in some cases resetting boxes would make them equal to prev state,
+				// therefore causing no unload
+				p.prev_state = p.state;
+				p.state.data_box = Box3i();
+				p.state.prefetch_box = Box3i();
+				p.state.mesh_box = Box3i();
+				unpaired_viewer_indexes.push_back(i);
+			}
+		}
+
+		const Transform3D world_to_local_transform = volume_transform.affine_inverse();
+
+		// Note, this does not support non-uniform scaling
+		// TODO There is probably a better way to do this
+		const float view_distance_scale = world_to_local_transform.basis.xform(Vector3(1, 0, 0)).length();
+
+		const Box3i bounds_in_voxels = ctx.data.get_bounds();
+
+		const Box3i bounds_in_data_blocks = bounds_in_voxels.downscaled(ctx.data_block_size);
+		const Box3i bounds_in_mesh_blocks = bounds_in_voxels.downscaled(ctx.mesh_block_size);
+
+		// New viewers and updates. Removed viewers won't be iterated but are still paired until later.
+		for (const std::pair<ViewerID, VoxelEngine::Viewer> &p : viewers) {
+			const ViewerID viewer_id = p.first;
+
+			size_t paired_viewer_index = paired_viewers.size();
+			for (size_t i = 0; i < paired_viewers.size(); ++i) {
+				if (paired_viewers[i].id == viewer_id) {
+					paired_viewer_index = i;
+					break;
+				}
+			}
+			if (paired_viewer_index == paired_viewers.size()) {
+				// New viewer
+				VoxelTerrainUpdateData::PairedViewer pv;
+				pv.id = viewer_id;
+				paired_viewers.push_back(pv);
+				ZN_PRINT_VERBOSE(format("Pairing viewer {} to VoxelTerrain", viewer_id));
+			}
+
+			update_paired_viewer_state(
+					ctx,
+					paired_viewers[paired_viewer_index],
+					p.second,
+					world_to_local_transform,
+					view_distance_scale,
+					bounds_in_data_blocks,
+					bounds_in_mesh_blocks
+			);
+		}
+	}
+
+	// Find out which blocks need to appear and which need to be unloaded
+	{
+		ZN_PROFILE_SCOPE();
+
+		for (size_t i = 0; i < paired_viewers.size(); ++i) {
+			const VoxelTerrainUpdateData::PairedViewer &paired_viewer = paired_viewers[i];
+
+			const VoxelEngine::Viewer *viewer = nullptr;
+			for (const std::pair<ViewerID, VoxelEngine::Viewer> &p : viewers) {
+				if (p.first == paired_viewer.id) {
+					viewer = &p.second;
+					break;
+				}
+			}
+
+			{
+				const Box3i &new_data_box = paired_viewer.state.data_box;
+				const Box3i &prev_data_box = paired_viewer.prev_state.data_box;
+
+				if (prev_data_box != new_data_box) {
+					process_viewer_data_box_change(
+							ctx,
+							paired_viewer.id,
+							viewer,
+							prev_data_box,
+							new_data_box,
+							false,
+							paired_viewer.prev_state.prefetch_box,
+							generator,
+							blocks_to_save
+					);
+				}
+			}
+
+			// Done after the data box, so blocks going from one box to the other don't get unloaded in between
+			{
+				const Box3i &new_prefetch_box = paired_viewer.state.prefetch_box;
+				const Box3i &prev_prefetch_box = paired_viewer.prev_state.prefetch_box;
+
+				if (prev_prefetch_box != new_prefetch_box) {
+					process_viewer_data_box_change(
+							ctx,
+							paired_viewer.id,
+							viewer,
+							prev_prefetch_box,
+							new_prefetch_box,
+							true,
+							Box3i(),
+							generator,
+							blocks_to_save
+					);
+				}
+			}
+
+			{
+				RWLockWrite wlock(state.mesh_blocks_lock);
+				process_viewer_mesh_box_change(ctx, paired_viewer);
+			}
+		}
+	}
+
+	// We no longer need unpaired viewers.
+	for (size_t i = 0; i < unpaired_viewer_indexes.size(); ++i) {
+		// Iterating backward so indexes of paired viewers that need removal will not change because of the removal
+		// itself
+		const size_t vi = unpaired_viewer_indexes[unpaired_viewer_indexes.size() - i - 1];
+		ZN_PRINT_VERBOSE(format("Unpairing viewer {} from VoxelTerrain", paired_viewers[vi].id));
+		paired_viewers[vi] = paired_viewers.back();
+		paired_viewers.pop_back();
+	}
+}
+
+void send_data_load_requests(
+		UpdateContext &ctx,
+		VolumeID volume_id,
+		std::shared_ptr<StreamingDependency> &streaming_dependency,
+		const std::shared_ptr<VoxelData> &data,
+		std::shared_ptr<PriorityDependency::ViewersData> &shared_viewers_data,
+		const Transform3D &volume_transform,
+		BufferedTaskScheduler &scheduler
+) {
+	ZN_PROFILE_SCOPE();
+
+	static thread_local StdVector<Vector3i> tls_blocks_to_load;
+	StdVector<Vector3i> &blocks_to_load = tls_blocks_to_load;
+	{
+		MutexLock mlock(ctx.state.loading_blocks_mutex);
+		blocks_to_load.swap(ctx.state.blocks_pending_load);
+	}
+
+	for (const Vector3i block_pos : blocks_to_load) {
+		std::shared_ptr<VoxelBuffer> saving_voxels;
+		{
+			MutexLock mlock(ctx.state.unloaded_saving_blocks_mutex);
+			auto saving_block_it = ctx.state.unloaded_saving_blocks.find(block_pos);
+			if (saving_block_it != ctx.state.unloaded_saving_blocks.end()) {
+				saving_voxels = saving_block_it->second;
+			}
+		}
+
+		if (saving_voxels != nullptr) {
+			ZN_PROFILE_SCOPE_NAMED("Quick reloading");
+			// The block is unloaded and currently waiting to be saved but we already want it back. This simulates a
+			// request and will complete on the next process.
+			// Ideally this shouldn't happen often. This is a corner case that occurs if the player moves fast
+			// back and forth or the task runner is overloaded.
+			std::shared_ptr<VoxelBuffer> voxel_data = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+			// Duplicating to make sure the saving version doesn't get altered by possible upcoming modifications.
+			saving_voxels->copy_to(*voxel_data, true);
+			ctx.state.quick_reloading_blocks.push_back(
+					VoxelTerrainUpdateData::QuickReloadingBlock{ voxel_data, block_pos }
+			);
+			// Don't erase it just yet, we may only do this once we know it is saved
+
+			// Notes:
+			// Could we change the design so that saving tasks actually save a box of VoxelData?
+			// To do that we would have to NOT remove data blocks of which refcount becomes 0. Instead, ownership
+			// would sort of be given to a saving task. That task would make a copy of modified chunks and only then
+			// remove them if they still have 0 viewers.
+			// If a viewer moves back into the area, it would simply find the chunks again and no loading would be
+			// needed. If those chunks get modified while saving is underway, it would still work fine as the saving
+			// task would lock the saved regions for reading (which is currently a problem already, because no
+			// locking actually occurs!).
+
+		} else {
+			request_block_load(
+					volume_id,
+					streaming_dependency,
+					block_pos,
+					shared_viewers_data,
+					volume_transform,
+					scheduler,
+					ctx.settings.generator_use_gpu,
+					data,
+					ctx.settings.task_priority
+			);
+		}
+	}
+
+	blocks_to_load.clear();
+}
+
+void send_mesh_requests(
+		UpdateContext &ctx,
+		VolumeID volume_id,
+		std::shared_ptr<MeshingDependency> &meshing_dependency,
+		const std::shared_ptr<VoxelData> &data,
+		std::shared_ptr<PriorityDependency::ViewersData> &shared_viewers_data,
+		const Transform3D &volume_transform,
+		BufferedTaskScheduler &scheduler
+) {
+	ZN_PROFILE_SCOPE();
+
+	VoxelTerrainUpdateData::State &state = ctx.state;
+	const int mesh_to_data_factor = ctx.mesh_block_size / ctx.data_block_size;
+
+	RWLockWrite wlock(state.mesh_blocks_lock);
+
+	for (size_t bi = 0; bi < state.blocks_pending_update.size(); ++bi) {
+		ZN_PROFILE_SCOPE_NAMED("Block");
+		const Vector3i mesh_block_pos = state.blocks_pending_update[bi];
+
+		auto mesh_block_it = state.mesh_blocks.find(mesh_block_pos);
+
+		// If we got here, it must have been because of scheduling an update
+		ZN_ASSERT_CONTINUE(mesh_block_it != state.mesh_blocks.end());
+		VoxelTerrainUpdateData::MeshBlockState &mesh_block = mesh_block_it->second;
+		ZN_ASSERT_CONTINUE(mesh_block.is_in_update_list);
+
+		// Pad by 1 because meshing requires neighbors
+		const Box3i data_box =
+				Box3i(mesh_block_pos * mesh_to_data_factor, Vector3iUtil::create(mesh_to_data_factor)).padded(1);
+
+#ifdef DEBUG_ENABLED
+		// We must have picked up a valid data block
+		{
+			const Vector3i anchor_pos = data_box.position + Vector3i(1, 1, 1);
+			ZN_ASSERT_CONTINUE(data->has_block(anchor_pos, 0));
+		}
+#endif
+
+		// We'll allocate this quite often. If it becomes a problem, it should be easy to pool.
+		MeshBlockTask *task = ZN_NEW(MeshBlockTask);
+		task->volume_id = volume_id;
+		task->mesh_block_position = mesh_block_pos;
+		task->lod_index = 0;
+		task->meshing_dependency = meshing_dependency;
+		task->require_visual = mesh_block.mesh_viewers.get() > 0;
+		task->collision_hint = ctx.settings.generate_collisions && mesh_block.collision_viewers.get() > 0;
+		task->edited = mesh_block.is_update_from_edit;
+		task->data = data;
+		task->supersede_previous_tasks(mesh_block.mesh_version);
+
+		// This iteration order is specifically chosen to match VoxelEngine and threaded access
+		data->get_blocks_with_voxel_data(data_box, 0, to_span(task->blocks));
+		task->blocks_count = Vector3iUtil::get_volume_u64(data_box.size);
+
+#ifdef DEBUG_ENABLED
+		{
+			unsigned int count = 0;
+			for (unsigned int i = 0; i < task->blocks_count; ++i) {
+				if (task->blocks[i] != nullptr) {
+					++count;
+				}
+			}
+			// Blocks that were in the list must have been scheduled because we have data for them!
+			if (count == 0) {
+				ZN_PRINT_ERROR("Unexpected empty block list in meshing block task");
+				ZN_DELETE(task);
+				continue;
+			}
+		}
+#endif
+
+		init_sparse_grid_priority_dependency(
+				task->priority_dependency,
+				task->mesh_block_position,
+				ctx.mesh_block_size,
+				shared_viewers_data,
+				volume_transform,
+				ctx.settings.task_priority
+		);
+
+		scheduler.push_main_task(task);
+
+		mesh_block.is_in_update_list = false;
+		mesh_block.is_update_from_edit = false;
+	}
+
+	state.blocks_pending_update.clear();
+}
+
+} // namespace
+
+void VoxelTerrainUpdateTask::send_block_save_requests(
+		VolumeID volume_id,
+		Span<const VoxelData::BlockToSave> blocks_to_save,
+		const std::shared_ptr<VoxelData> &data,
+		std::shared_ptr<StreamingDependency> &stream_dependency,
+		BufferedTaskScheduler &task_scheduler,
+		std::shared_ptr<AsyncDependencyTracker> tracker,
+		bool with_flush
+) {
+	if (stream_dependency->stream.is_null()) {
+		if (blocks_to_save.size() > 0) {
+			ZN_PRINT_VERBOSE(format("Not saving {} blocks because no stream is assigned", blocks_to_save.size()));
+		}
+		return;
+	}
+
+	for (const VoxelData::BlockToSave &b : blocks_to_save) {
+		ZN_PRINT_VERBOSE(format("Requesting save of block {}", b.position));
+
+		SaveBlockDataTask *task = ZN_NEW(
+				SaveBlockDataTask(volume_id, b.position, 0, b.voxels, stream_dependency, tracker, with_flush)
+		);
+		task->set_voxel_data(data);
+		task->set_save_priority(b.save_priority);
+
+		task_scheduler.push_io_task(task);
+	}
+}
+
+void VoxelTerrainUpdateTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+
+	struct SetCompleteOnScopeExit {
+		std::atomic_bool &_complete;
+		SetCompleteOnScopeExit(std::atomic_bool &b) : _complete(b) {}
+		~SetCompleteOnScopeExit() {
+			_complete = true;
+		}
+	};
+
+#ifdef DEV_ENABLED
+	CRASH_COND(_update_data == nullptr);
+	CRASH_COND(_data == nullptr);
+	CRASH_COND(_streaming_dependency == nullptr);
+	CRASH_COND(_meshing_dependency == nullptr);
+	CRASH_COND(_shared_viewers_data == nullptr);
+#endif
+
+	VoxelTerrainUpdateData &update_data = *_update_data;
+	VoxelTerrainUpdateData::State &state = update_data.state;
+	const VoxelTerrainUpdateData::Settings &settings = update_data.settings;
+
+#ifdef DEV_ENABLED
+	// Make sure the main thread has processed outputs of the last threaded update
+	CRASH_COND(state.quick_reloading_blocks.size() != 0);
+	CRASH_COND(state.mesh_blocks_to_create.size() != 0);
+	CRASH_COND(state.mesh_blocks_to_unload.size() != 0);
+	CRASH_COND(state.mesh_blocks_to_drop_visuals.size() != 0);
+	CRASH_COND(state.mesh_blocks_to_drop_collisions.size() != 0);
+	CRASH_COND(state.unloaded_data_blocks.size() != 0);
+	CRASH_COND(state.block_enter_notifications.size() != 0);
+#endif
+
+	SetCompleteOnScopeExit scoped_complete(update_data.task_is_complete);
+
+	CRASH_COND_MSG(update_data.task_is_complete, "Expected only one update task to run on a given volume");
+	MutexLock mutex_lock(update_data.completion_mutex);
+
+	UpdateContext uctx{
+		state, settings, *_data, static_cast<int>(_data->get_block_size()), 1 << settings.mesh_block_size_po2
+	};
+	ProfilingClock profiling_clock;
+
+	// Meshes to update after edits or loaded blocks, which were notified since the last update
+	process_remesh_requests(uctx);
+
+	static thread_local StdVector<VoxelData::BlockToSave> tls_blocks_to_save;
+	StdVector<VoxelData::BlockToSave> &blocks_to_save = tls_blocks_to_save;
+	blocks_to_save.clear();
+
+	process_viewers(
+			uctx,
+			to_span(update_data.viewers),
+			_volume_transform,
+			_streaming_dependency->generator.ptr(),
+			blocks_to_save
+	);
+
+	state.stats.time_detect_required_blocks = profiling_clock.restart();
+
+	BufferedTaskScheduler &task_scheduler = BufferedTaskScheduler::get_for_current_thread();
+
+	// It's possible the user didn't set a stream yet, or it is turned off
+	if (settings.can_load_blocks) {
+		send_data_load_requests(
+				uctx, _volume_id, _streaming_dependency, _data, _shared_viewers_data, _volume_transform, task_scheduler
+		);
+	}
+	send_block_save_requests(
+			_volume_id, to_span(blocks_to_save), _data, _streaming_dependency, task_scheduler, nullptr, false
+	);
+	blocks_to_save.clear();
+
+	state.stats.time_request_blocks_to_load = profiling_clock.restart();
+
+	send_mesh_requests(
+			uctx, _volume_id, _meshing_dependency, _data, _shared_viewers_data, _volume_transform, task_scheduler
+	);
+
+	task_scheduler.flush();
+
+	state.stats.time_request_blocks_to_update = profiling_clock.restart();
+}
+
+} // namespace zylann::voxel
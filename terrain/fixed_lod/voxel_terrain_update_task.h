@@ -0,0 +1,79 @@
+#ifndef VOXEL_TERRAIN_UPDATE_TASK_H
+#define VOXEL_TERRAIN_UPDATE_TASK_H
+
+#include "../../engine/ids.h"
+#include "../../engine/priority_dependency.h"
+#include "../../storage/voxel_data.h"
+#include "../../util/containers/span.h"
+#include "../../util/tasks/threaded_task.h"
+#include "voxel_terrain_update_data.h"
+
+namespace zylann {
+
+class AsyncDependencyTracker;
+
+namespace voxel {
+
+struct StreamingDependency;
+struct MeshingDependency;
+class BufferedTaskScheduler;
+
+// Runs the streaming part of the update loop of a VoxelTerrain: pairing viewers, finding which blocks enter or leave
+// their area, and sending load, save and meshing requests.
+// This part can run on another thread, so multiple terrains can update in parallel.
+// There must be only one running at once per terrain.
+//
+// IMPORTANT: The work done by this task must not involve any call to Godot's servers or scripts, directly or
+// indirectly. Mesh changes and signals are deferred to the main thread.
+//
+class VoxelTerrainUpdateTask : public IThreadedTask {
+public:
+	VoxelTerrainUpdateTask(
+			std::shared_ptr<VoxelData> p_data,
+			std::shared_ptr<VoxelTerrainUpdateData> p_update_data,
+			std::shared_ptr<StreamingDependency> p_streaming_dependency,
+			std::shared_ptr<MeshingDependency> p_meshing_dependency,
+			std::shared_ptr<PriorityDependency::ViewersData> p_shared_viewers_data,
+			VolumeID p_volume_id,
+			Transform3D p_volume_transform
+	) :
+			_data(p_data),
+			_update_data(p_update_data),
+			_streaming_dependency(p_streaming_dependency),
+			_meshing_dependency(p_meshing_dependency),
+			_shared_viewers_data(p_shared_viewers_data),
+			_volume_id(p_volume_id),
+			_volume_transform(p_volume_transform) {}
+
+	const char *get_debug_name() const override {
+		return "VoxelTerrainUpdate";
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+
+	// Functions also used outside of this task
+
+	static void send_block_save_requests(
+			VolumeID volume_id,
+			Span<const VoxelData::BlockToSave> blocks_to_save,
+			const std::shared_ptr<VoxelData> &data,
+			std::shared_ptr<StreamingDependency> &stream_dependency,
+			BufferedTaskScheduler &task_scheduler,
+			std::shared_ptr<AsyncDependencyTracker> tracker,
+			bool with_flush
+	);
+
+private:
+	std::shared_ptr<VoxelData> _data;
+	std::shared_ptr<VoxelTerrainUpdateData> _update_data;
+	std::shared_ptr<StreamingDependency> _streaming_dependency;
+	std::shared_ptr<MeshingDependency> _meshing_dependency;
+	std::shared_ptr<PriorityDependency::ViewersData> _shared_viewers_data;
+	VolumeID _volume_id;
+	Transform3D _volume_transform;
+};
+
+} // namespace voxel
+} // namespace zylann
+
+#endif // VOXEL_TERRAIN_UPDATE_TASK_H
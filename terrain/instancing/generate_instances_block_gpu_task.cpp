@@ -0,0 +1,188 @@
+#include "generate_instances_block_gpu_task.h"
+#include "../../engine/gpu/compute_shader.h"
+#include "../../engine/voxel_engine.h"
+#include "../../util/dstack.h"
+#include "../../util/godot/core/packed_arrays.h"
+#include "../../util/godot/direct_multimesh_instance.h"
+#include "../../util/math/funcs.h"
+#include "../../util/profiling.h"
+
+#include "../../util/godot/classes/rd_uniform.h"
+#include "../../util/godot/classes/rendering_device.h"
+
+using namespace zylann::godot;
+
+namespace zylann::voxel {
+
+namespace {
+
+// Must match the output layout of `instance_scatter.glsl`
+const unsigned int FLOATS_PER_CANDIDATE = 16;
+const unsigned int VALID_OFFSET = 12;
+
+const int LOCAL_GROUP_SIZE = 64;
+
+Ref<RDUniform> make_storage_buffer_uniform(RID rid, int binding) {
+	Ref<RDUniform> uniform;
+	uniform.instantiate();
+	uniform->set_uniform_type(RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER);
+	uniform->add_id(rid);
+	uniform->set_binding(binding);
+	return uniform;
+}
+
+} // namespace
+
+unsigned int GenerateInstancesBlockGPUTask::get_required_shared_output_buffer_size() const {
+	return params.candidate_count * FLOATS_PER_CANDIDATE * sizeof(float);
+}
+
+void GenerateInstancesBlockGPUTask::prepare(GPUTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_DSTACK();
+
+	ERR_FAIL_COND(mesh_vertices.size() == 0);
+	ERR_FAIL_COND(mesh_normals.size() != mesh_vertices.size());
+	ERR_FAIL_COND(params.candidate_count == 0);
+
+	const ComputeShader &shader = VoxelEngine::get_singleton().get_instance_scatter_compute_shader();
+	ERR_FAIL_COND(!shader.is_valid());
+
+	const int group_count = math::ceildiv(static_cast<int>(params.candidate_count), LOCAL_GROUP_SIZE);
+	// Vulkan guarantees at least this amount of groups
+	ERR_FAIL_COND_MSG(group_count > 65535, "Too many instance candidates to generate in a single dispatch");
+
+	RenderingDevice &rd = ctx.rendering_device;
+	GPUStorageBufferPool &storage_buffer_pool = ctx.storage_buffer_pool;
+
+	// Mesh
+
+	PackedByteArray mesh_vertices_pba;
+	copy_bytes_to<Vector4f>(mesh_vertices_pba, to_span(mesh_vertices));
+	_mesh_vertices_sb = storage_buffer_pool.allocate(mesh_vertices_pba);
+	ERR_FAIL_COND(_mesh_vertices_sb.is_null());
+
+	PackedByteArray mesh_normals_pba;
+	copy_bytes_to<Vector4f>(mesh_normals_pba, to_span(mesh_normals));
+	_mesh_normals_sb = storage_buffer_pool.allocate(mesh_normals_pba);
+	ERR_FAIL_COND(_mesh_normals_sb.is_null());
+
+	// Emitting from vertices doesn't need indices, but the binding must not be empty
+	if (mesh_indices.size() == 0) {
+		mesh_indices.push_back(0);
+	}
+	PackedByteArray mesh_indices_pba;
+	copy_bytes_to<int32_t>(mesh_indices_pba, to_span(mesh_indices));
+	_mesh_indices_sb = storage_buffer_pool.allocate(mesh_indices_pba);
+	ERR_FAIL_COND(_mesh_indices_sb.is_null());
+
+	// Params
+
+	static_assert(sizeof(VoxelInstanceGenerator::GPUParams) == 96);
+
+	VoxelInstanceGenerator::GPUParams task_params = params;
+	task_params.output_start = ctx.shared_output_buffer_begin / sizeof(float);
+
+	PackedByteArray params_pba;
+	copy_bytes_to(params_pba, task_params);
+	_params_sb = storage_buffer_pool.allocate(params_pba);
+	ERR_FAIL_COND(_params_sb.is_null());
+
+	// Uniforms
+
+	Array uniforms;
+	uniforms.resize(5);
+	uniforms[0] = make_storage_buffer_uniform(_mesh_vertices_sb.rid, 0);
+	uniforms[1] = make_storage_buffer_uniform(_mesh_normals_sb.rid, 1);
+	uniforms[2] = make_storage_buffer_uniform(_mesh_indices_sb.rid, 2);
+	uniforms[3] = make_storage_buffer_uniform(_params_sb.rid, 3);
+	uniforms[4] = make_storage_buffer_uniform(ctx.shared_output_buffer_rid, 4);
+
+	const RID shader_rid = shader.get_rid();
+	const RID uniform_set_rid = uniform_set_create(rd, uniforms, shader_rid, 0);
+
+	_pipeline_rid = rd.compute_pipeline_create(shader_rid);
+	ERR_FAIL_COND(!_pipeline_rid.is_valid());
+
+	// Dispatch
+
+	const int compute_list_id = rd.compute_list_begin();
+	rd.compute_list_bind_compute_pipeline(compute_list_id, _pipeline_rid);
+	rd.compute_list_bind_uniform_set(compute_list_id, uniform_set_rid, 0);
+	rd.compute_list_dispatch(compute_list_id, group_count, 1, 1);
+	rd.compute_list_end();
+}
+
+void GenerateInstancesBlockGPUTask::collect(GPUTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_DSTACK();
+
+	RenderingDevice &rd = ctx.rendering_device;
+	GPUStorageBufferPool &storage_buffer_pool = ctx.storage_buffer_pool;
+
+	// The pipeline is only created once everything else succeeded, otherwise the output contains garbage
+	if (_pipeline_rid.is_valid()) {
+		// Conversion is left to `finish`. The downloaded buffer is shared with other tasks of the batch, so we only
+		// keep a reference to it.
+		_output_data = ctx.downloaded_shared_output_data;
+		_output_begin = ctx.shared_output_buffer_begin;
+		_output_size = ctx.shared_output_buffer_size;
+
+		free_rendering_device_rid(rd, _pipeline_rid);
+	}
+
+	if (_mesh_vertices_sb.is_valid()) {
+		storage_buffer_pool.recycle(_mesh_vertices_sb);
+	}
+	if (_mesh_normals_sb.is_valid()) {
+		storage_buffer_pool.recycle(_mesh_normals_sb);
+	}
+	if (_mesh_indices_sb.is_valid()) {
+		storage_buffer_pool.recycle(_mesh_indices_sb);
+	}
+	if (_params_sb.is_valid()) {
+		storage_buffer_pool.recycle(_params_sb);
+	}
+}
+
+void GenerateInstancesBlockGPUTask::finish() {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(output_queue != nullptr);
+
+	if (_output_size > 0) {
+		Span<const float> output =
+				to_span(_output_data).sub(_output_begin, _output_size).reinterpret_cast_to<const float>();
+
+		// Edited transforms may already be in the list, generated ones are added after them
+		for (unsigned int candidate_index = 0; candidate_index < params.candidate_count; ++candidate_index) {
+			const float *src = &output[candidate_index * FLOATS_PER_CANDIDATE];
+			if (src[VALID_OFFSET] == 0.f) {
+				continue;
+			}
+			Transform3f t;
+			t.basis.rows[0] = Vector3f(src[0], src[1], src[2]);
+			t.basis.rows[1] = Vector3f(src[4], src[5], src[6]);
+			t.basis.rows[2] = Vector3f(src[8], src[9], src[10]);
+			t.origin = Vector3f(src[3], src[7], src[11]);
+			transforms.push_back(t);
+		}
+
+		_output_data = PackedByteArray();
+	}
+
+	// `finish` runs on the GPU task runner's thread, so the buffer is built here rather than on the main thread
+	PackedFloat32Array bulk_array;
+	DirectMultiMeshInstance::make_transform_3d_bulk_array(to_span_const(transforms), bulk_array);
+
+	MutexLock mlock(output_queue->mutex);
+	output_queue->results.push_back(InstanceLoadingTaskOutput());
+	InstanceLoadingTaskOutput &o = output_queue->results.back();
+	o.layer_id = layer_id;
+	o.edited_mask = edited_mask;
+	o.generated = true;
+	o.render_block_position = mesh_block_grid_position;
+	o.transforms = std::move(transforms);
+	o.multimesh_bulk_array = bulk_array;
+}
+
+} // namespace zylann::voxel
@@ -0,0 +1,60 @@
+#ifndef ZN_VOXEL_GENERATE_INSTANCES_BLOCK_GPU_TASK_H
+#define ZN_VOXEL_GENERATE_INSTANCES_BLOCK_GPU_TASK_H
+
+#include "../../engine/gpu/gpu_storage_buffer_pool.h"
+#include "../../engine/gpu/gpu_task_runner.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/packed_byte_array.h"
+#include "../../util/math/transform3f.h"
+#include "../../util/math/vector4f.h"
+#include "instancer_task_output_queue.h"
+#include "voxel_instance_generator.h"
+
+#include <memory>
+
+namespace zylann::voxel {
+
+// Scatters instances on a mesh block with a compute shader. Used instead of `GenerateInstancesBlockTask` when the
+// generator supports it.
+// Transforms are downloaded with the shared output buffer of the GPU task runner, and posted to the instancer the same
+// way as CPU results. They can't be written directly into MultiMesh buffers, because compute shaders run on a separate
+// rendering device.
+class GenerateInstancesBlockGPUTask : public IGPUTask {
+public:
+	// Using 4-component vectors to match alignment rules.
+	StdVector<Vector4f> mesh_vertices;
+	StdVector<Vector4f> mesh_normals;
+	StdVector<int32_t> mesh_indices;
+
+	VoxelInstanceGenerator::GPUParams params;
+
+	// Carried over to the output
+	Vector3i mesh_block_grid_position;
+	uint16_t layer_id;
+	uint8_t edited_mask;
+	// Can be pre-populated by edited transforms
+	StdVector<Transform3f> transforms;
+	std::shared_ptr<InstancerTaskOutputQueue> output_queue;
+
+	unsigned int get_required_shared_output_buffer_size() const override;
+
+	void prepare(GPUTaskContext &ctx) override;
+	void collect(GPUTaskContext &ctx) override;
+	void finish() override;
+
+private:
+	GPUStorageBuffer _mesh_vertices_sb;
+	GPUStorageBuffer _mesh_normals_sb;
+	GPUStorageBuffer _mesh_indices_sb;
+	GPUStorageBuffer _params_sb;
+	RID _pipeline_rid;
+
+	// Downloaded results, shared with other tasks of the same batch
+	PackedByteArray _output_data;
+	unsigned int _output_begin = 0;
+	unsigned int _output_size = 0;
+};
+
+} // namespace zylann::voxel
+
+#endif // ZN_VOXEL_GENERATE_INSTANCES_BLOCK_GPU_TASK_H
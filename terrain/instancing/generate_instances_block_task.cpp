@@ -1,9 +1,73 @@
 #include "generate_instances_block_task.h"
+#include "../../engine/voxel_engine.h"
 #include "../../util/godot/classes/array_mesh.h"
+#include "../../util/godot/core/packed_arrays.h"
+#include "../../util/godot/direct_multimesh_instance.h"
+#include "../../util/math/conv.h"
+#include "../../util/memory/memory.h"
 #include "../../util/profiling.h"
+#include "generate_instances_block_gpu_task.h"
 
 namespace zylann::voxel {
 
+bool GenerateInstancesBlockTask::run_on_gpu(
+		const PackedVector3Array &vertices,
+		const PackedVector3Array &normals,
+		uint8_t octant_mask
+) {
+	ZN_PROFILE_SCOPE();
+
+	const VoxelEngine &engine = VoxelEngine::get_singleton();
+	if (!engine.has_rendering_device() || !engine.get_instance_scatter_compute_shader().is_valid()) {
+		return false;
+	}
+	ERR_FAIL_COND_V(normals.size() != vertices.size(), false);
+
+	PackedInt32Array indices;
+	if (surface_arrays.size() > ArrayMesh::ARRAY_INDEX) {
+		indices = surface_arrays[ArrayMesh::ARRAY_INDEX];
+	}
+
+	GenerateInstancesBlockGPUTask *gpu_task = ZN_NEW(GenerateInstancesBlockGPUTask);
+
+	if (!generator->get_gpu_params(
+				gpu_task->params,
+				mesh_block_grid_position,
+				lod_index,
+				layer_id,
+				up_mode,
+				octant_mask,
+				mesh_block_size,
+				vertices.size(),
+				indices.size()
+		)) {
+		// Nothing to generate, the CPU path handles this quickly
+		ZN_DELETE(gpu_task);
+		return false;
+	}
+
+	gpu_task->mesh_vertices.resize(vertices.size());
+	gpu_task->mesh_normals.resize(normals.size());
+	for (int i = 0; i < vertices.size(); ++i) {
+		const Vector3f v = to_vec3f(vertices[i]);
+		const Vector3f n = to_vec3f(normals[i]);
+		gpu_task->mesh_vertices[i] = Vector4f(v.x, v.y, v.z, 0.f);
+		gpu_task->mesh_normals[i] = Vector4f(n.x, n.y, n.z, 0.f);
+	}
+
+	Span<const int32_t> indices_s = to_span(indices);
+	gpu_task->mesh_indices.assign(indices_s.data(), indices_s.data() + indices_s.size());
+
+	gpu_task->mesh_block_grid_position = mesh_block_grid_position;
+	gpu_task->layer_id = layer_id;
+	gpu_task->edited_mask = edited_mask;
+	gpu_task->transforms = std::move(transforms);
+	gpu_task->output_queue = output_queue;
+
+	VoxelEngine::get_singleton().push_gpu_task(gpu_task);
+	return true;
+}
+
 void GenerateInstancesBlockTask::run(ThreadedTaskContext &ctx) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT_RETURN(generator.is_valid());
@@ -20,6 +84,11 @@ void GenerateInstancesBlockTask::run(ThreadedTaskContext &ctx) {
 
 	const uint8_t gen_octant_mask = ~edited_mask;
 
+	if (generator->is_gpu_compatible() && run_on_gpu(vertices, normals, gen_octant_mask)) {
+		// Results will be posted by the GPU task
+		return;
+	}
+
 	generator->generate_transforms(
 			tls_generated_transforms,
 			mesh_block_grid_position,
@@ -35,14 +104,19 @@ void GenerateInstancesBlockTask::run(ThreadedTaskContext &ctx) {
 		transforms.push_back(t);
 	}
 
+	PackedFloat32Array bulk_array;
+	zylann::godot::DirectMultiMeshInstance::make_transform_3d_bulk_array(to_span_const(transforms), bulk_array);
+
 	{
 		MutexLock mlock(output_queue->mutex);
 		output_queue->results.push_back(InstanceLoadingTaskOutput());
 		InstanceLoadingTaskOutput &o = output_queue->results.back();
 		o.layer_id = layer_id;
 		o.edited_mask = edited_mask;
+		o.generated = true;
 		o.render_block_position = mesh_block_grid_position;
 		o.transforms = std::move(transforms);
+		o.multimesh_bulk_array = bulk_array;
 	}
 }
 
@@ -1,6 +1,7 @@
 #ifndef ZN_VOXEL_GENERATE_INSTANCES_BLOCK_TASK_H
 #define ZN_VOXEL_GENERATE_INSTANCES_BLOCK_TASK_H
 
+#include "../../constants/voxel_constants.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/tasks/threaded_task.h"
@@ -32,7 +33,15 @@ public:
 		return "GenerateInstancesBlock";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_INSTANCES;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
+
+private:
+	// Schedules generation on the GPU. Returns false if it can't be done, in which case the CPU must be used.
+	bool run_on_gpu(const PackedVector3Array &vertices, const PackedVector3Array &normals, uint8_t octant_mask);
 };
 
 } // namespace zylann::voxel
@@ -2,6 +2,7 @@
 #define VOXEL_INSTANCER_TASK_OUTPUT_QUEUE_H
 
 #include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/packed_arrays.h"
 #include "../../util/math/transform3f.h"
 #include "../../util/math/vector3i.h"
 #include "../../util/thread/mutex.h"
@@ -15,11 +16,27 @@ struct InstanceLoadingTaskOutput {
 	// Tells which parts of the block contain edited data (non-generated).
 	// When data chunks are half the size of render chunks, this is 8 bits in XYZ order.
 	uint8_t edited_mask;
+	// True if the parts of the block that aren't edited were filled by the generator
+	bool generated = false;
 	StdVector<Transform3f> transforms;
+	// MultiMesh buffer of `transforms`, built by the task so the main thread only has to upload it.
+	// Also built for scene items, for which it goes unused.
+	PackedFloat32Array multimesh_bulk_array;
+};
+
+struct MergedInstanceChunkOutput {
+	// Position in merged chunk coordinates
+	Vector3i chunk_position;
+	uint16_t layer_id;
+	// Matches `version` of the chunk if no block of it changed since the task was scheduled
+	uint32_t version;
+	// MultiMesh buffer of all instances in the chunk, relative to its origin
+	PackedFloat32Array bulk_array;
 };
 
 struct InstancerTaskOutputQueue {
 	StdVector<InstanceLoadingTaskOutput> results;
+	StdVector<MergedInstanceChunkOutput> merged_chunks;
 	Mutex mutex;
 };
 
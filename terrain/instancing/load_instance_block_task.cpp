@@ -4,6 +4,7 @@
 #include "../../util/containers/container_funcs.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/classes/array_mesh.h"
+#include "../../util/godot/direct_multimesh_instance.h"
 #include "../../util/math/box3i.h"
 #include "../../util/math/conv.h"
 #include "../../util/profiling.h"
@@ -93,16 +94,18 @@ void LoadInstanceChunkTask::run(ThreadedTaskContext &ctx) {
 				for (unsigned int query_index = 0; query_index < query_count; ++query_index) {
 					VoxelStream::InstancesQueryData &query = queries[query_index];
 					auto it = _quick_reload_cache->map.find(query.position_in_blocks);
+					_quick_reload_cache->stats.add_hit_or_miss(it != _quick_reload_cache->map.end());
 
 					if (it != _quick_reload_cache->map.end()) {
 						ZN_PROFILE_SCOPE_NAMED("Instance quick reload");
-						UniquePtr<InstanceBlockData> data;
-						if (it->second != nullptr) {
-							data = make_unique_instance<InstanceBlockData>();
-							it->second->copy_to(*data);
+						UniquePtr<InstanceBlockData> data = make_unique_instance<InstanceBlockData>();
+						if (deserialize_instance_block_data(*data, to_span_const(it->second))) {
+							query.result = VoxelStream::RESULT_BLOCK_FOUND;
+							query.data = std::move(data);
+						} else {
+							ZN_PRINT_ERROR("Failed to deserialize cached instance block");
+							query.result = VoxelStream::RESULT_ERROR;
 						}
-						query.result = VoxelStream::RESULT_BLOCK_FOUND;
-						query.data = std::move(data);
 
 					} else {
 						stream_queries[stream_queries_count] = std::move(query);
@@ -261,8 +264,11 @@ void LoadInstanceChunkTask::run(ThreadedTaskContext &ctx) {
 		o.edited_mask = layer.edited_mask;
 		o.render_block_position = _render_grid_position;
 		o.transforms = std::move(layer.transforms);
+		zylann::godot::DirectMultiMeshInstance::make_transform_3d_bulk_array(
+				to_span_const(o.transforms), o.multimesh_bulk_array
+		);
 		{
-			MutexLock(_output_queue->mutex);
+			MutexLock mlock(_output_queue->mutex);
 			_output_queue->results.push_back(std::move(o));
 		}
 	}
@@ -1,6 +1,7 @@
 #ifndef VOXEL_LOAD_INSTANCE_BLOCK_TASK_H
 #define VOXEL_LOAD_INSTANCE_BLOCK_TASK_H
 
+#include "../../constants/voxel_constants.h"
 #include "../../streams/voxel_stream.h"
 #include "../../util/godot/core/array.h"
 #include "../../util/math/vector3i.h"
@@ -35,6 +36,10 @@ public:
 		return "LoadInstanceChunk";
 	}
 
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_INSTANCES;
+	}
+
 	void run(ThreadedTaskContext &ctx) override;
 
 private:
@@ -0,0 +1,51 @@
+#include "merge_instance_chunk_task.h"
+#include "../../util/errors.h"
+#include "../../util/profiling.h"
+
+namespace zylann::voxel {
+
+void MergeInstanceChunkTask::run(ThreadedTaskContext &ctx) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN(output_queue != nullptr);
+
+	// 3 rows of basis and origin component, like `RenderingServer::multimesh_set_buffer` expects
+	const unsigned int floats_per_instance = 12;
+
+	unsigned int total_size = 0;
+	for (const Source &source : sources) {
+		total_size += source.bulk_array.size();
+	}
+
+	PackedFloat32Array bulk_array;
+	bulk_array.resize(total_size);
+	float *dst = bulk_array.ptrw();
+
+	for (const Source &source : sources) {
+		const float *src = source.bulk_array.ptr();
+		const unsigned int instance_count = source.bulk_array.size() / floats_per_instance;
+
+		for (unsigned int i = 0; i < instance_count; ++i) {
+			for (unsigned int j = 0; j < floats_per_instance; ++j) {
+				dst[j] = src[j];
+			}
+			dst[3] += source.offset.x;
+			dst[7] += source.offset.y;
+			dst[11] += source.offset.z;
+			src += floats_per_instance;
+			dst += floats_per_instance;
+		}
+	}
+
+	// Release references to block buffers early, they may be replaced on the main thread
+	sources.clear();
+
+	MutexLock mlock(output_queue->mutex);
+	output_queue->merged_chunks.push_back(MergedInstanceChunkOutput());
+	MergedInstanceChunkOutput &o = output_queue->merged_chunks.back();
+	o.chunk_position = chunk_position;
+	o.layer_id = layer_id;
+	o.version = version;
+	o.bulk_array = bulk_array;
+}
+
+} // namespace zylann::voxel
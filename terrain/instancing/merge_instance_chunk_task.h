@@ -0,0 +1,44 @@
+#ifndef VOXEL_MERGE_INSTANCE_CHUNK_TASK_H
+#define VOXEL_MERGE_INSTANCE_CHUNK_TASK_H
+
+#include "../../constants/voxel_constants.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/packed_arrays.h"
+#include "../../util/math/vector3f.h"
+#include "../../util/tasks/threaded_task.h"
+#include "instancer_task_output_queue.h"
+#include <memory>
+
+namespace zylann::voxel {
+
+// Concatenates the MultiMesh buffers of several instancer blocks into one, so they can be drawn with a single
+// MultiMesh at long distances.
+class MergeInstanceChunkTask : public IThreadedTask {
+public:
+	struct Source {
+		// MultiMesh buffer of a block, in `TRANSFORM_3D` format without colors or custom data
+		PackedFloat32Array bulk_array;
+		// Position of the block relative to the merged chunk
+		Vector3f offset;
+	};
+
+	StdVector<Source> sources;
+	Vector3i chunk_position;
+	uint16_t layer_id;
+	uint32_t version;
+	std::shared_ptr<InstancerTaskOutputQueue> output_queue;
+
+	const char *get_debug_name() const override {
+		return "MergeInstanceChunk";
+	}
+
+	uint8_t get_category() const override {
+		return constants::TASK_CATEGORY_INSTANCES;
+	}
+
+	void run(ThreadedTaskContext &ctx) override;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_MERGE_INSTANCE_CHUNK_TASK_H
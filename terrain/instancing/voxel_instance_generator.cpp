@@ -23,6 +23,54 @@ const float MAX_DENSITY = 10.f;
 // We expose a slider going below max density as it should not often be needed, but we allow greater if really necessary
 const char *DENSITY_HINT_STRING = "0.0, 1.0, 0.01, or_greater";
 
+// Removes candidates whose slope or height is out of the given ranges, preserving order.
+// Conditions are evaluated for all candidates first without branching, so the compiler can vectorize it, then kept
+// candidates are compacted.
+void filter_by_slope_and_height(
+		StdVector<Vector3f> &positions,
+		StdVector<Vector3f> &normals,
+		const Vector3f block_origin,
+		const UpMode up_mode,
+		const float normal_min_y,
+		const float normal_max_y,
+		const float min_height,
+		const float max_height
+) {
+	static thread_local StdVector<uint8_t> tls_keep;
+	StdVector<uint8_t> &keep = tls_keep;
+	keep.resize(positions.size());
+
+	// Comparisons are written such that NaNs (from degenerate normals) are kept, like when filters are not used
+	if (up_mode == UP_MODE_SPHERE) {
+		// Up is the direction away from the center of the planet, and height is the distance to it
+		for (size_t i = 0; i < positions.size(); ++i) {
+			const Vector3f world_pos = block_origin + positions[i];
+			const Vector3f normal = normals[i];
+			const float distance = math::length(world_pos);
+			const float ny = math::dot(normal, world_pos) / (math::length(normal) * distance);
+			keep[i] = !((ny < normal_min_y) | (ny > normal_max_y) | (distance < min_height) | (distance > max_height));
+		}
+	} else {
+		for (size_t i = 0; i < positions.size(); ++i) {
+			const Vector3f normal = normals[i];
+			const float ny = normal.y / math::length(normal);
+			const float y = block_origin.y + positions[i].y;
+			keep[i] = !((ny < normal_min_y) | (ny > normal_max_y) | (y < min_height) | (y > max_height));
+		}
+	}
+
+	size_t dst_index = 0;
+	for (size_t src_index = 0; src_index < positions.size(); ++src_index) {
+		if (keep[src_index] != 0) {
+			positions[dst_index] = positions[src_index];
+			normals[dst_index] = normals[src_index];
+			++dst_index;
+		}
+	}
+	positions.resize(dst_index);
+	normals.resize(dst_index);
+}
+
 } // namespace
 
 void VoxelInstanceGenerator::generate_transforms(
@@ -435,6 +483,40 @@ void VoxelInstanceGenerator::generate_transforms(
 		index_cache.clear();
 	}
 
+	const float vertical_alignment = _vertical_alignment;
+	const float scale_min = _min_scale;
+	const float scale_range = _max_scale - _min_scale;
+	const bool random_vertical_flip = _random_vertical_flip;
+	const float offset_along_normal = _offset_along_normal;
+	const float normal_min_y = _min_surface_normal_y;
+	const float normal_max_y = _max_surface_normal_y;
+	const bool slope_filter = normal_min_y != -1.f || normal_max_y != 1.f;
+	const bool height_filter =
+			_min_height != std::numeric_limits<float>::min() || _max_height != std::numeric_limits<float>::max();
+	const float min_height = _min_height;
+	const float max_height = _max_height;
+
+	const Vector3f fixed_look_axis = up_mode == UP_MODE_POSITIVE_Y ? Vector3f(1, 0, 0) : Vector3f(0, 1, 0);
+	const Vector3f fixed_look_axis_alternative = up_mode == UP_MODE_POSITIVE_Y ? Vector3f(0, 1, 0) : Vector3f(1, 0, 0);
+	const Vector3f mesh_block_origin = to_vec3f(grid_position * block_size);
+
+	// Filter out by slope and height.
+	// This is done before evaluating noise, so noise doesn't get evaluated for candidates that would be discarded
+	// anyways.
+	if (slope_filter || height_filter) {
+		ZN_PROFILE_SCOPE_NAMED("Slope and height filter");
+		filter_by_slope_and_height(
+				vertex_cache,
+				normal_cache,
+				mesh_block_origin,
+				up_mode,
+				slope_filter ? normal_min_y : -std::numeric_limits<float>::infinity(),
+				slope_filter ? normal_max_y : std::numeric_limits<float>::infinity(),
+				height_filter ? min_height : -std::numeric_limits<float>::infinity(),
+				height_filter ? max_height : std::numeric_limits<float>::infinity()
+		);
+	}
+
 	// Position of the block relative to the instancer node.
 	// Use full-precision here because we deal with potentially large coordinates
 	const Vector3 mesh_block_origin_d = grid_position * block_size;
@@ -449,180 +531,162 @@ void VoxelInstanceGenerator::generate_transforms(
 		noise_graph = _noise_graph;
 	}
 
-	// Filter out by noise graph
-	if (noise_graph.is_valid()) {
-		ZN_PROFILE_SCOPE_NAMED("Noise graph filter");
+	const bool use_noise = noise.is_valid() || noise_graph.is_valid();
 
-		StdVector<float> &out_buffer = g_noise_cache;
-		out_buffer.resize(vertex_cache.size());
+	StdVector<float> &noise_cache = g_noise_cache;
 
-		// Check noise graph validity
-		std::shared_ptr<pg::VoxelGraphFunction::CompiledGraph> compiled_graph = noise_graph->get_compiled_graph();
-		if (compiled_graph != nullptr) {
-			const int input_count = compiled_graph->runtime.get_input_count();
-			const int output_count = compiled_graph->runtime.get_output_count();
+	if (use_noise && vertex_cache.size() > 0) {
+		// Gather positions of all candidates first, so noise can be evaluated on all of them in one go
+		StdVector<float> &x_buffer = g_noise_graph_x_cache;
+		StdVector<float> &y_buffer = g_noise_graph_y_cache;
+		StdVector<float> &z_buffer = g_noise_graph_z_cache;
+		x_buffer.resize(vertex_cache.size());
+		y_buffer.resize(vertex_cache.size());
+		z_buffer.resize(vertex_cache.size());
 
-			bool valid = (output_count == 1);
+		for (size_t i = 0; i < vertex_cache.size(); ++i) {
+			const Vector3 &pos = to_vec3(vertex_cache[i]) + mesh_block_origin_d;
+			x_buffer[i] = pos.x;
+			y_buffer[i] = pos.y;
+			z_buffer[i] = pos.z;
+		}
 
-			switch (_noise_dimension) {
-				case DIMENSION_2D:
-					if (input_count != 2) {
-						valid = false;
-					}
-					break;
-				case DIMENSION_3D:
-					if (input_count != 3) {
-						valid = false;
-					}
-					break;
-				default:
-					ERR_FAIL();
-			}
+		noise_cache.resize(vertex_cache.size());
 
-			if (!valid) {
-				compiled_graph = nullptr;
-			}
-		}
+		// Evaluate noise graph
+		if (noise_graph.is_valid()) {
+			ZN_PROFILE_SCOPE_NAMED("Noise graph");
 
-		if (compiled_graph != nullptr) {
-			// Execute graph
+			// Check noise graph validity
+			std::shared_ptr<pg::VoxelGraphFunction::CompiledGraph> compiled_graph = noise_graph->get_compiled_graph();
+			if (compiled_graph != nullptr) {
+				const int input_count = compiled_graph->runtime.get_input_count();
+				const int output_count = compiled_graph->runtime.get_output_count();
 
-			StdVector<float> &x_buffer = g_noise_graph_x_cache;
-			StdVector<float> &z_buffer = g_noise_graph_z_cache;
-			x_buffer.resize(vertex_cache.size());
-			z_buffer.resize(vertex_cache.size());
+				bool valid = (output_count == 1);
 
-			FixedArray<Span<float>, 1> outputs;
-			outputs[0] = to_span(out_buffer);
+				switch (_noise_dimension) {
+					case DIMENSION_2D:
+						if (input_count != 2) {
+							valid = false;
+						}
+						break;
+					case DIMENSION_3D:
+						if (input_count != 3) {
+							valid = false;
+						}
+						break;
+					default:
+						ERR_FAIL();
+				}
 
-			switch (_noise_dimension) {
-				case DIMENSION_2D: {
-					for (size_t i = 0; i < vertex_cache.size(); ++i) {
-						const Vector3 &pos = to_vec3(vertex_cache[i]) + mesh_block_origin_d;
-						x_buffer[i] = pos.x;
-						z_buffer[i] = pos.z;
-					}
+				if (!valid) {
+					compiled_graph = nullptr;
+				}
+			}
 
-					FixedArray<Span<float>, 2> inputs;
-					inputs[0] = to_span(x_buffer);
-					inputs[1] = to_span(z_buffer);
+			if (compiled_graph != nullptr) {
+				// Execute graph on all positions at once. Noise nodes process whole buffers, with SIMD when they use
+				// FastNoise2.
 
-					noise_graph->execute(to_span(inputs), to_span(outputs));
-				} break;
+				FixedArray<Span<float>, 1> outputs;
+				outputs[0] = to_span(noise_cache);
 
-				case DIMENSION_3D: {
-					StdVector<float> &y_buffer = g_noise_graph_y_cache;
-					y_buffer.resize(vertex_cache.size());
-
-					for (size_t i = 0; i < vertex_cache.size(); ++i) {
-						const Vector3 &pos = to_vec3(vertex_cache[i]) + mesh_block_origin_d;
-						x_buffer[i] = pos.x;
-						y_buffer[i] = pos.y;
-						z_buffer[i] = pos.z;
-					}
+				switch (_noise_dimension) {
+					case DIMENSION_2D: {
+						FixedArray<Span<float>, 2> inputs;
+						inputs[0] = to_span(x_buffer);
+						inputs[1] = to_span(z_buffer);
 
-					FixedArray<Span<float>, 3> inputs;
-					inputs[0] = to_span(x_buffer);
-					inputs[1] = to_span(y_buffer);
-					inputs[2] = to_span(z_buffer);
+						noise_graph->execute(to_span(inputs), to_span(outputs));
+					} break;
 
-					noise_graph->execute(to_span(inputs), to_span(outputs));
-				} break;
+					case DIMENSION_3D: {
+						FixedArray<Span<float>, 3> inputs;
+						inputs[0] = to_span(x_buffer);
+						inputs[1] = to_span(y_buffer);
+						inputs[2] = to_span(z_buffer);
 
-				default:
-					ERR_FAIL();
-			}
+						noise_graph->execute(to_span(inputs), to_span(outputs));
+					} break;
 
-		} else {
-			// Error fallback
-			for (float &v : out_buffer) {
-				v = 0.f;
+					default:
+						ERR_FAIL();
+				}
+
+			} else {
+				// Error fallback
+				for (float &v : noise_cache) {
+					v = 0.f;
+				}
 			}
 		}
-	}
 
-	StdVector<float> &noise_cache = g_noise_cache;
+		// Legacy noise (noise graph is more versatile, but this remains for compatibility)
+		if (noise.is_valid()) {
+			ZN_PROFILE_SCOPE_NAMED("Noise");
 
-	// Legacy noise (noise graph is more versatile, but this remains for compatibility)
-	if (noise.is_valid()) {
-		noise_cache.resize(vertex_cache.size());
+			// `Noise` has no API to evaluate many positions at once, so the best we can do is to call it in a tight
+			// loop.
+			// Casting to float because Noise returns `real_t`, which is `double` in 64-bit float builds, but we don't
+			// need doubles for noise in this context...
+			Noise &noise_ref = **noise;
 
-		switch (_noise_dimension) {
-			case DIMENSION_2D: {
-				if (noise_graph.is_valid()) {
-					// Multiply output of noise graph
-					for (size_t i = 0; i < vertex_cache.size(); ++i) {
-						const Vector3 &pos = to_vec3(vertex_cache[i]) + mesh_block_origin_d;
-						// Casting to float because Noise returns `real_t`, which is `double` in 64-bit float builds,
-						// but we don't need doubles for noise in this context...
-						noise_cache[i] *= math::max(float(noise->get_noise_2d(pos.x, pos.z)), 0.f);
-					}
-				} else {
-					// Use noise directly
-					for (size_t i = 0; i < vertex_cache.size(); ++i) {
-						const Vector3 &pos = to_vec3(vertex_cache[i]) + mesh_block_origin_d;
-						noise_cache[i] = noise->get_noise_2d(pos.x, pos.z);
+			switch (_noise_dimension) {
+				case DIMENSION_2D: {
+					if (noise_graph.is_valid()) {
+						// Multiply output of noise graph
+						for (size_t i = 0; i < noise_cache.size(); ++i) {
+							noise_cache[i] *= math::max(float(noise_ref.get_noise_2d(x_buffer[i], z_buffer[i])), 0.f);
+						}
+					} else {
+						// Use noise directly
+						for (size_t i = 0; i < noise_cache.size(); ++i) {
+							noise_cache[i] = noise_ref.get_noise_2d(x_buffer[i], z_buffer[i]);
+						}
 					}
-				}
-			} break;
+				} break;
 
-			case DIMENSION_3D: {
-				if (noise_graph.is_valid()) {
-					for (size_t i = 0; i < vertex_cache.size(); ++i) {
-						const Vector3 &pos = to_vec3(vertex_cache[i]) + mesh_block_origin_d;
-						noise_cache[i] *= math::max(float(noise->get_noise_3d(pos.x, pos.y, pos.z)), 0.f);
-					}
-				} else {
-					for (size_t i = 0; i < vertex_cache.size(); ++i) {
-						const Vector3 &pos = to_vec3(vertex_cache[i]) + mesh_block_origin_d;
-						noise_cache[i] = noise->get_noise_3d(pos.x, pos.y, pos.z);
+				case DIMENSION_3D: {
+					if (noise_graph.is_valid()) {
+						for (size_t i = 0; i < noise_cache.size(); ++i) {
+							noise_cache[i] *= math::max(
+									float(noise_ref.get_noise_3d(x_buffer[i], y_buffer[i], z_buffer[i])), 0.f
+							);
+						}
+					} else {
+						for (size_t i = 0; i < noise_cache.size(); ++i) {
+							noise_cache[i] = noise_ref.get_noise_3d(x_buffer[i], y_buffer[i], z_buffer[i]);
+						}
 					}
-				}
-			} break;
+				} break;
 
-			default:
-				ERR_FAIL();
+				default:
+					ERR_FAIL();
+			}
 		}
-	}
 
-	const bool use_noise = noise.is_valid() || noise_graph.is_valid();
-
-	// Filter out by noise
-	if (use_noise) {
-		ZN_PROFILE_SCOPE_NAMED("Noise filter");
-
-		for (size_t i = 0; i < vertex_cache.size(); ++i) {
-			const float n = noise_cache[i];
-			if (n <= 0) {
-				unordered_remove(vertex_cache, i);
-				unordered_remove(normal_cache, i);
-				unordered_remove(noise_cache, i);
-				// We don't use the index cache after this... for now
-				// if (index_cache_used) {
-				// 	unordered_remove(index_cache, i);
-				// }
-				--i;
+		// Filter out by noise
+		{
+			ZN_PROFILE_SCOPE_NAMED("Noise filter");
+
+			// Compacting in place while preserving order
+			unsigned int dst_index = 0;
+			for (unsigned int src_index = 0; src_index < vertex_cache.size(); ++src_index) {
+				const float n = noise_cache[src_index];
+				if (n > 0) {
+					vertex_cache[dst_index] = vertex_cache[src_index];
+					normal_cache[dst_index] = normal_cache[src_index];
+					noise_cache[dst_index] = n;
+					++dst_index;
+				}
 			}
+			vertex_cache.resize(dst_index);
+			normal_cache.resize(dst_index);
+			noise_cache.resize(dst_index);
 		}
 	}
 
-	const float vertical_alignment = _vertical_alignment;
-	const float scale_min = _min_scale;
-	const float scale_range = _max_scale - _min_scale;
-	const bool random_vertical_flip = _random_vertical_flip;
-	const float offset_along_normal = _offset_along_normal;
-	const float normal_min_y = _min_surface_normal_y;
-	const float normal_max_y = _max_surface_normal_y;
-	const bool slope_filter = normal_min_y != -1.f || normal_max_y != 1.f;
-	const bool height_filter =
-			_min_height != std::numeric_limits<float>::min() || _max_height != std::numeric_limits<float>::max();
-	const float min_height = _min_height;
-	const float max_height = _max_height;
-
-	const Vector3f fixed_look_axis = up_mode == UP_MODE_POSITIVE_Y ? Vector3f(1, 0, 0) : Vector3f(0, 1, 0);
-	const Vector3f fixed_look_axis_alternative = up_mode == UP_MODE_POSITIVE_Y ? Vector3f(0, 1, 0) : Vector3f(1, 0, 0);
-	const Vector3f mesh_block_origin = to_vec3f(grid_position * block_size);
-
 	// Calculate orientations and scales
 	for (size_t vertex_index = 0; vertex_index < vertex_cache.size(); ++vertex_index) {
 		Transform3f t;
@@ -630,25 +694,16 @@ void VoxelInstanceGenerator::generate_transforms(
 
 		// Warning: sometimes mesh normals are not perfectly normalized.
 		// The cause is for meshing speed on CPU. It's normalized on GPU anyways.
-		Vector3f surface_normal = normal_cache[vertex_index];
+		const Vector3f surface_normal = normal_cache[vertex_index];
 
 		Vector3f axis_y;
 
-		bool surface_normal_is_normalized = false;
-		bool sphere_up_is_computed = false;
-		bool sphere_distance_is_computed = false;
-		float sphere_distance;
-
 		if (vertical_alignment == 0.f) {
-			surface_normal = math::normalized(surface_normal);
-			surface_normal_is_normalized = true;
-			axis_y = surface_normal;
+			axis_y = math::normalized(surface_normal);
 
 		} else {
 			if (up_mode == UP_MODE_SPHERE) {
-				global_up = math::normalized(mesh_block_origin + t.origin, sphere_distance);
-				sphere_up_is_computed = true;
-				sphere_distance_is_computed = true;
+				global_up = math::normalized(mesh_block_origin + t.origin);
 			}
 
 			if (vertical_alignment < 1.f) {
@@ -658,43 +713,6 @@ void VoxelInstanceGenerator::generate_transforms(
 				axis_y = global_up;
 			}
 		}
-
-		if (slope_filter) {
-			if (!surface_normal_is_normalized) {
-				surface_normal = math::normalized(surface_normal);
-			}
-
-			float ny = surface_normal.y;
-			if (up_mode == UP_MODE_SPHERE) {
-				if (!sphere_up_is_computed) {
-					global_up = math::normalized(mesh_block_origin + t.origin, sphere_distance);
-					sphere_up_is_computed = true;
-					sphere_distance_is_computed = true;
-				}
-				ny = math::dot(surface_normal, global_up);
-			}
-
-			if (ny < normal_min_y || ny > normal_max_y) {
-				// Discard
-				continue;
-			}
-		}
-
-		if (height_filter) {
-			float y = mesh_block_origin.y + t.origin.y;
-			if (up_mode == UP_MODE_SPHERE) {
-				if (!sphere_distance_is_computed) {
-					sphere_distance = math::length(mesh_block_origin + t.origin);
-					sphere_distance_is_computed = true;
-				}
-				y = sphere_distance;
-			}
-
-			if (y < min_height || y > max_height) {
-				continue;
-			}
-		}
-
 		t.origin += offset_along_normal * axis_y;
 
 		// Allows to use two faces of a single rock to create variety in the same layer
@@ -779,6 +797,100 @@ void VoxelInstanceGenerator::generate_transforms(
 	// }
 }
 
+bool VoxelInstanceGenerator::is_gpu_compatible() const {
+	if (!_use_gpu) {
+		return false;
+	}
+	// The accumulation done by this mode is sequential
+	if (_emit_mode == EMIT_FROM_FACES) {
+		return false;
+	}
+	// TODO Support material filtering, this requires uploading custom vertex attributes
+	if (_voxel_material_filter_enabled) {
+		return false;
+	}
+	// TODO Support noise graphs, they could be compiled to GLSL like generators
+	ShortLockScope slock(_ptr_settings_lock);
+	return _noise.is_null() && _noise_graph.is_null();
+}
+
+bool VoxelInstanceGenerator::get_gpu_params(
+		GPUParams &params,
+		Vector3i grid_position,
+		int lod_index,
+		int layer_id,
+		UpMode up_mode,
+		uint8_t octant_mask,
+		float block_size,
+		unsigned int vertex_count,
+		unsigned int index_count
+) const {
+	if (_density <= 0.f || vertex_count == 0) {
+		return false;
+	}
+
+	const unsigned int triangle_count = index_count / 3;
+
+	switch (_emit_mode) {
+		case EMIT_FROM_VERTICES:
+			params.candidate_count = vertex_count;
+			break;
+		case EMIT_FROM_FACES_FAST:
+			params.candidate_count = triangle_count > 0 ? static_cast<unsigned int>(_density * triangle_count) : 0;
+			break;
+		case EMIT_ONE_PER_TRIANGLE:
+			params.candidate_count = triangle_count;
+			break;
+		default:
+			ZN_PRINT_ERROR("Emit mode not supported on GPU");
+			return false;
+	}
+
+	if (params.candidate_count == 0) {
+		return false;
+	}
+
+	// Same as in `generate_transforms`
+	const float density = math::clamp(_density, 0.f, 1.f);
+
+	params.block_origin = to_vec3f(grid_position * block_size);
+	params.block_size = block_size;
+	params.emit_mode = _emit_mode;
+	params.triangle_count = triangle_count;
+	params.seed = Vector3iHasher::hash(grid_position) + layer_id;
+	params.octant_mask = octant_mask;
+	params.vertex_density = math::min(uint64_t(double(0xffffffff) * density), uint64_t(0xffffffff));
+	params.jitter = _jitter;
+	params.triangle_area_threshold = math::squared(1 << lod_index) * _triangle_area_threshold_lod0;
+	params.vertical_alignment = _vertical_alignment;
+	params.offset_along_normal = _offset_along_normal;
+	params.min_scale = _min_scale;
+	params.scale_range = _max_scale - _min_scale;
+	params.scale_distribution = _scale_distribution;
+	params.normal_min_y = _min_surface_normal_y;
+	params.normal_max_y = _max_surface_normal_y;
+	params.min_height = _min_height;
+	params.max_height = _max_height;
+	params.output_start = 0;
+	params.up_mode = up_mode;
+
+	params.flags = 0;
+	if (_random_vertical_flip) {
+		params.flags |= GPUParams::FLAG_RANDOM_VERTICAL_FLIP;
+	}
+	if (_random_rotation) {
+		params.flags |= GPUParams::FLAG_RANDOM_ROTATION;
+	}
+	if (_min_surface_normal_y != -1.f || _max_surface_normal_y != 1.f) {
+		params.flags |= GPUParams::FLAG_SLOPE_FILTER;
+	}
+	if (_min_height != std::numeric_limits<float>::min() || _max_height != std::numeric_limits<float>::max()) {
+		params.flags |= GPUParams::FLAG_HEIGHT_FILTER;
+	}
+
+	return true;
+}
+
 void VoxelInstanceGenerator::set_density(float density) {
 	density = math::clamp(density, 0.f, MAX_DENSITY);
 	if (density == _density) {
@@ -1094,6 +1206,18 @@ uint32_t VoxelInstanceGenerator::get_voxel_material_filter_mask() const {
 	return _voxel_material_filter_mask;
 }
 
+void VoxelInstanceGenerator::set_use_gpu(bool enabled) {
+	if (enabled == _use_gpu) {
+		return;
+	}
+	_use_gpu = enabled;
+	emit_changed();
+}
+
+bool VoxelInstanceGenerator::get_use_gpu() const {
+	return _use_gpu;
+}
+
 PackedInt32Array VoxelInstanceGenerator::_b_get_voxel_material_filter_array() const {
 	const unsigned int bit_count = sizeof(_voxel_material_filter_mask) * 8;
 	PackedInt32Array array;
@@ -1158,6 +1282,13 @@ void VoxelInstanceGenerator::get_configuration_warnings(PackedStringArray &warni
 									.format(varray(expected_output_count, output_count)));
 		}
 	}
+
+	if (_use_gpu && !is_gpu_compatible()) {
+		warnings.append(
+				"GPU generation is enabled, but it does not support the current settings so the CPU will be used. "
+				"Noise, voxel material filtering and the 'Faces' emit mode require the CPU."
+		);
+	}
 }
 
 void VoxelInstanceGenerator::_validate_property(PropertyInfo &p_property) const {
@@ -1275,6 +1406,9 @@ void VoxelInstanceGenerator::_bind_methods() {
 	);
 	ClassDB::bind_method(D_METHOD("get_voxel_texture_filter_array"), &Self::_b_get_voxel_material_filter_array);
 
+	ClassDB::bind_method(D_METHOD("set_use_gpu", "enabled"), &Self::set_use_gpu);
+	ClassDB::bind_method(D_METHOD("get_use_gpu"), &Self::get_use_gpu);
+
 	ADD_GROUP("Emission", "");
 
 	ADD_PROPERTY(
@@ -1394,6 +1528,10 @@ void VoxelInstanceGenerator::_bind_methods() {
 			"get_voxel_texture_filter_array"
 	);
 
+	ADD_GROUP("GPU", "");
+
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_gpu"), "set_use_gpu", "get_use_gpu");
+
 	BIND_ENUM_CONSTANT(EMIT_FROM_VERTICES);
 	BIND_ENUM_CONSTANT(EMIT_FROM_FACES_FAST);
 	BIND_ENUM_CONSTANT(EMIT_FROM_FACES);
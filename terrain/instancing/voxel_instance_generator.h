@@ -65,6 +65,56 @@ public:
 			float block_size
 	);
 
+	// Parameters of the instance scattering compute shader.
+	// Layout must match the `Params` buffer in `instance_scatter.glsl`.
+	struct GPUParams {
+		static constexpr uint32_t FLAG_RANDOM_VERTICAL_FLIP = 1;
+		static constexpr uint32_t FLAG_RANDOM_ROTATION = 2;
+		static constexpr uint32_t FLAG_SLOPE_FILTER = 4;
+		static constexpr uint32_t FLAG_HEIGHT_FILTER = 8;
+
+		Vector3f block_origin;
+		float block_size;
+		int32_t emit_mode;
+		uint32_t candidate_count;
+		uint32_t triangle_count;
+		uint32_t seed;
+		uint32_t octant_mask;
+		uint32_t vertex_density;
+		float jitter;
+		float triangle_area_threshold;
+		float vertical_alignment;
+		float offset_along_normal;
+		float min_scale;
+		float scale_range;
+		int32_t scale_distribution;
+		uint32_t flags;
+		float normal_min_y;
+		float normal_max_y;
+		float min_height;
+		float max_height;
+		uint32_t output_start;
+		int32_t up_mode;
+	};
+
+	// Tells if instances can be generated with a compute shader instead of `generate_transforms`. Not all features
+	// are supported on the GPU, in which case generation falls back to the CPU.
+	bool is_gpu_compatible() const;
+
+	// Gets parameters to generate instances with a compute shader, using the same inputs as `generate_transforms`.
+	// `output_start` is left to the caller. Returns false if there is nothing to generate.
+	bool get_gpu_params(
+			GPUParams &params,
+			Vector3i grid_position,
+			int lod_index,
+			int layer_id,
+			UpMode up_mode,
+			uint8_t octant_mask,
+			float block_size,
+			unsigned int vertex_count,
+			unsigned int index_count
+	) const;
+
 	void set_density(float d);
 	float get_density() const;
 
@@ -130,6 +180,9 @@ public:
 	void set_voxel_material_filter_mask(const uint32_t mask);
 	uint32_t get_voxel_material_filter_mask() const;
 
+	void set_use_gpu(bool enabled);
+	bool get_use_gpu() const;
+
 	static inline int get_octant_index(const Vector3f pos, float half_block_size) {
 		return get_octant_index(pos.x > half_block_size, pos.y > half_block_size, pos.z > half_block_size);
 	}
@@ -172,6 +225,7 @@ private:
 	float _noise_on_scale = 0.f;
 	bool _voxel_material_filter_enabled = false;
 	uint32_t _voxel_material_filter_mask = 1;
+	bool _use_gpu = false;
 
 	// TODO Protect noise and noise graph members from multithreaded access
 
@@ -5,6 +5,7 @@
 #include "../../util/godot/classes/node.h"
 #include "../../util/godot/classes/physics_body_3d.h"
 #include "../../util/godot/core/packed_arrays.h"
+#include "../../util/math/funcs.h"
 #include "voxel_instancer.h"
 
 namespace zylann::voxel {
@@ -504,6 +505,46 @@ void VoxelInstanceLibraryMultiMeshItem::set_hide_beyond_max_lod(bool enabled) {
 	_hide_beyond_max_lod = enabled;
 }
 
+void VoxelInstanceLibraryMultiMeshItem::set_merge_from_mesh_lod(int mesh_lod_index) {
+	ERR_FAIL_INDEX(mesh_lod_index, MAX_MESH_LODS);
+	if (mesh_lod_index == _merge_from_mesh_lod) {
+		return;
+	}
+	_merge_from_mesh_lod = mesh_lod_index;
+	notify_listeners(IInstanceLibraryItemListener::CHANGE_VISUAL);
+}
+
+int VoxelInstanceLibraryMultiMeshItem::get_merge_from_mesh_lod() const {
+	return _merge_from_mesh_lod;
+}
+
+void VoxelInstanceLibraryMultiMeshItem::set_merged_chunk_size(int size) {
+	ERR_FAIL_COND_MSG(size != 2 && size != 4, "Merged chunk size must be 2 or 4");
+	const unsigned int size_po2 = math::get_shift_from_power_of_two_32(size);
+	if (size_po2 == _merged_chunk_size_po2) {
+		return;
+	}
+	_merged_chunk_size_po2 = size_po2;
+	notify_listeners(IInstanceLibraryItemListener::CHANGE_VISUAL);
+}
+
+int VoxelInstanceLibraryMultiMeshItem::get_merged_chunk_size() const {
+	return 1 << _merged_chunk_size_po2;
+}
+
+void VoxelInstanceLibraryMultiMeshItem::set_collision_distance(float distance) {
+	distance = math::max(distance, 0.f);
+	if (distance == _collision_distance) {
+		return;
+	}
+	_collision_distance = distance;
+	notify_listeners(IInstanceLibraryItemListener::CHANGE_VISUAL);
+}
+
+float VoxelInstanceLibraryMultiMeshItem::get_collision_distance() const {
+	return _collision_distance;
+}
+
 const VoxelInstanceLibraryMultiMeshItem::Settings &VoxelInstanceLibraryMultiMeshItem::get_multimesh_settings() const {
 	if (_scene.is_valid()) {
 		return _scene_settings;
@@ -609,6 +650,15 @@ void VoxelInstanceLibraryMultiMeshItem::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_hide_beyond_max_lod", "enabled"), &Self::set_hide_beyond_max_lod);
 	ClassDB::bind_method(D_METHOD("get_hide_beyond_max_lod"), &Self::get_hide_beyond_max_lod);
 
+	ClassDB::bind_method(D_METHOD("set_merge_from_mesh_lod", "mesh_lod_index"), &Self::set_merge_from_mesh_lod);
+	ClassDB::bind_method(D_METHOD("get_merge_from_mesh_lod"), &Self::get_merge_from_mesh_lod);
+
+	ClassDB::bind_method(D_METHOD("set_merged_chunk_size", "size"), &Self::set_merged_chunk_size);
+	ClassDB::bind_method(D_METHOD("get_merged_chunk_size"), &Self::get_merged_chunk_size);
+
+	ClassDB::bind_method(D_METHOD("set_collision_distance", "distance"), &Self::set_collision_distance);
+	ClassDB::bind_method(D_METHOD("get_collision_distance"), &Self::get_collision_distance);
+
 	ClassDB::bind_method(D_METHOD("set_render_layer", "render_layer"), &Self::set_render_layer);
 	ClassDB::bind_method(D_METHOD("get_render_layer"), &Self::get_render_layer);
 
@@ -756,6 +806,25 @@ void VoxelInstanceLibraryMultiMeshItem::_bind_methods() {
 			PropertyInfo(Variant::BOOL, "hide_beyond_max_lod"), "set_hide_beyond_max_lod", "get_hide_beyond_max_lod"
 	);
 
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "merge_from_mesh_lod", PROPERTY_HINT_RANGE, "0,3,1"),
+			"set_merge_from_mesh_lod",
+			"get_merge_from_mesh_lod"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "merged_chunk_size", PROPERTY_HINT_ENUM, "2:2,4:4"),
+			"set_merged_chunk_size",
+			"get_merged_chunk_size"
+	);
+
+	ADD_GROUP("Collision", "");
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::FLOAT, "collision_distance", PROPERTY_HINT_RANGE, "0,1000,0.1,or_greater"),
+			"set_collision_distance",
+			"get_collision_distance"
+	);
+
 	BIND_CONSTANT(MAX_MESH_LODS);
 }
 
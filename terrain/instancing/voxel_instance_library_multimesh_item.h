@@ -98,6 +98,19 @@ public:
 	bool get_hide_beyond_max_lod() const;
 	void set_hide_beyond_max_lod(bool enabled);
 
+	void set_merge_from_mesh_lod(int mesh_lod_index);
+	int get_merge_from_mesh_lod() const;
+
+	void set_merged_chunk_size(int size);
+	int get_merged_chunk_size() const;
+
+	inline unsigned int get_merged_chunk_size_po2() const {
+		return _merged_chunk_size_po2;
+	}
+
+	void set_collision_distance(float distance);
+	float get_collision_distance() const;
+
 	// Internal
 
 	// If a scene is assigned to the item, returns settings converted from it.
@@ -196,6 +209,14 @@ private:
 	Ref<PackedScene> _scene;
 	// This may be used if the terrain has no LOD or the item is on its last LOD
 	bool _hide_beyond_max_lod = false;
+	// Blocks using this mesh LOD or higher are rendered with larger multimeshes covering several blocks, so there are
+	// fewer draw calls at long distances. 0 means blocks are never merged.
+	uint8_t _merge_from_mesh_lod = 0;
+	// Merged chunks cover 2x2x2 or 4x4x4 blocks
+	uint8_t _merged_chunk_size_po2 = 1;
+	// If greater than 0, collision bodies only exist for instances within this distance of viewers requiring
+	// collisions, instead of all instances
+	float _collision_distance = 0.f;
 	FixedArray<float, MAX_MESH_LODS> _mesh_lod_max_distance_ratios;
 };
 
@@ -1,4 +1,5 @@
 #include "voxel_instance_library_scene_item.h"
+#include "../../util/math/funcs.h"
 
 namespace zylann::voxel {
 
@@ -13,15 +14,52 @@ Ref<PackedScene> VoxelInstanceLibrarySceneItem::get_scene() const {
 	return _scene;
 }
 
+void VoxelInstanceLibrarySceneItem::set_pool_size(int size) {
+	_pool_size = math::max(size, 0);
+}
+
+int VoxelInstanceLibrarySceneItem::get_pool_size() const {
+	return _pool_size;
+}
+
+void VoxelInstanceLibrarySceneItem::set_pool_prewarm_count(int count) {
+	_pool_prewarm_count = math::max(count, 0);
+}
+
+int VoxelInstanceLibrarySceneItem::get_pool_prewarm_count() const {
+	return _pool_prewarm_count;
+}
+
 void VoxelInstanceLibrarySceneItem::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_scene", "scene"), &VoxelInstanceLibrarySceneItem::set_scene);
 	ClassDB::bind_method(D_METHOD("get_scene"), &VoxelInstanceLibrarySceneItem::get_scene);
 
+	ClassDB::bind_method(D_METHOD("set_pool_size", "size"), &VoxelInstanceLibrarySceneItem::set_pool_size);
+	ClassDB::bind_method(D_METHOD("get_pool_size"), &VoxelInstanceLibrarySceneItem::get_pool_size);
+
+	ClassDB::bind_method(
+			D_METHOD("set_pool_prewarm_count", "count"), &VoxelInstanceLibrarySceneItem::set_pool_prewarm_count
+	);
+	ClassDB::bind_method(D_METHOD("get_pool_prewarm_count"), &VoxelInstanceLibrarySceneItem::get_pool_prewarm_count);
+
 	ADD_PROPERTY(
 			PropertyInfo(Variant::OBJECT, "scene", PROPERTY_HINT_RESOURCE_TYPE, PackedScene::get_class_static()),
 			"set_scene",
 			"get_scene"
 	);
+
+	ADD_GROUP("Pooling", "pool_");
+
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "pool_size", PROPERTY_HINT_RANGE, "0,1024,1,or_greater"),
+			"set_pool_size",
+			"get_pool_size"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "pool_prewarm_count", PROPERTY_HINT_RANGE, "0,1024,1,or_greater"),
+			"set_pool_prewarm_count",
+			"get_pool_prewarm_count"
+	);
 }
 
 } // namespace zylann::voxel
@@ -12,10 +12,20 @@ public:
 	void set_scene(Ref<PackedScene> scene);
 	Ref<PackedScene> get_scene() const;
 
+	void set_pool_size(int size);
+	int get_pool_size() const;
+
+	void set_pool_prewarm_count(int count);
+	int get_pool_prewarm_count() const;
+
 private:
 	static void _bind_methods();
 
 	Ref<PackedScene> _scene;
+	// How many hidden instances can be kept for reuse when blocks unload
+	unsigned int _pool_size = 0;
+	// How many instances are created ahead of time, before blocks need them
+	unsigned int _pool_prewarm_count = 0;
 };
 
 } // namespace zylann::voxel
@@ -1,5 +1,7 @@
-#include "../../edition/voxel_tool.h"
 #include "../../engine/buffered_task_scheduler.h"
+#include "../../engine/voxel_engine.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_data.h"
 #include "../../streams/save_block_data_task.h"
 #include "../../util/containers/container_funcs.h"
 #include "../../util/dstack.h"
@@ -14,13 +16,16 @@
 #include "../../util/godot/classes/time.h"
 #include "../../util/godot/classes/viewport.h"
 #include "../../util/godot/core/array.h"
+#include "../../util/godot/object_weak_ref.h"
 #include "../../util/math/conv.h"
+#include "../../util/math/float4.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "../fixed_lod/voxel_terrain.h"
 #include "../variable_lod/voxel_lod_terrain.h"
 #include "instancer_quick_reloading_cache.h"
 #include "load_instance_block_task.h"
+#include "merge_instance_chunk_task.h"
 #include "voxel_instance_component.h"
 #include "voxel_instance_generator.h"
 #include "voxel_instance_library_multimesh_item.h"
@@ -36,6 +41,7 @@
 #include "../../util/godot/classes/multimesh_instance_3d.h"
 
 #include <algorithm>
+#include <limits>
 
 namespace zylann::voxel {
 
@@ -69,7 +75,9 @@ void VoxelInstancer::clear_blocks() {
 		Block &block = **it;
 		for (unsigned int i = 0; i < block.bodies.size(); ++i) {
 			VoxelInstancerRigidBody *body = block.bodies[i];
-			body->detach_and_destroy();
+			if (body != nullptr) {
+				body->detach_and_destroy();
+			}
 		}
 		for (unsigned int i = 0; i < block.scene_instances.size(); ++i) {
 			SceneInstance instance = block.scene_instances[i];
@@ -80,10 +88,14 @@ void VoxelInstancer::clear_blocks() {
 		}
 	}
 	_blocks.clear();
+	_block_mesh_lods.clear();
 	for (auto it = _layers.begin(); it != _layers.end(); ++it) {
 		Layer &layer = it->second;
 		layer.blocks.clear();
+		clear_merged_chunks(layer);
+		clear_body_pool(layer);
 	}
+	_dirty_merged_chunks.clear();
 	for (unsigned int lod_index = 0; lod_index < _lods.size(); ++lod_index) {
 		Lod &lod = _lods[lod_index];
 		lod.modified_blocks.clear();
@@ -104,6 +116,9 @@ void VoxelInstancer::clear_blocks_in_layer(int layer_id) {
 
 void VoxelInstancer::clear_layers() {
 	clear_blocks();
+	for (auto it = _layers.begin(); it != _layers.end(); ++it) {
+		clear_scene_pool(it->second);
+	}
 	for (unsigned int lod_index = 0; lod_index < _lods.size(); ++lod_index) {
 		Lod &lod = _lods[lod_index];
 		lod.layers.clear();
@@ -191,6 +206,27 @@ void VoxelInstancer::_notification(int p_what) {
 				const Transform3D block_transform(parent_transform.basis, parent_transform.xform(block_local_pos));
 				block.multimesh_instance.set_transform(block_transform);
 			}
+
+			for (auto layer_it = _layers.begin(); layer_it != _layers.end(); ++layer_it) {
+				Layer &layer = layer_it->second;
+				if (layer.merged_chunks.size() == 0) {
+					continue;
+				}
+				const VoxelInstanceLibraryMultiMeshItem *item =
+						Object::cast_to<VoxelInstanceLibraryMultiMeshItem>(_library->get_item_const(layer_it->first));
+				ERR_CONTINUE(item == nullptr);
+				const int chunk_size_po2 = base_block_size_po2 + layer.lod_index + item->get_merged_chunk_size_po2();
+
+				for (auto chunk_it = layer.merged_chunks.begin(); chunk_it != layer.merged_chunks.end(); ++chunk_it) {
+					MergedChunk &chunk = chunk_it->second;
+					if (chunk.multimesh_instance.is_valid()) {
+						const Vector3 chunk_local_pos(chunk_it->first << chunk_size_po2);
+						chunk.multimesh_instance.set_transform(
+								Transform3D(parent_transform.basis, parent_transform.xform(chunk_local_pos))
+						);
+					}
+				}
+			}
 		} break;
 
 		case NOTIFICATION_VISIBILITY_CHANGED:
@@ -210,10 +246,17 @@ void VoxelInstancer::_notification(int p_what) {
 
 void VoxelInstancer::process() {
 	process_task_results();
+	if (_scene_pool_prewarm_pending) {
+		schedule_scene_pool_prewarm();
+	}
 	if (_parent != nullptr) {
 		if (_library.is_valid() && _mesh_lod_distances[0] > 0.f) {
 			process_mesh_lods();
 		}
+		if (_library.is_valid()) {
+			process_merged_chunks();
+			process_collision_bodies();
+		}
 #ifdef TOOLS_ENABLED
 		if (_gizmos_enabled && is_visible_in_tree()) {
 			process_gizmos();
@@ -222,6 +265,28 @@ void VoxelInstancer::process() {
 	}
 }
 
+// Applies generated instances to a block of a scene layer, on the main thread, within the time budget of VoxelEngine
+struct VoxelInstancer::ApplyTaskOutputTask : public ITimeSpreadTask {
+	void run(TimeSpreadTaskContext &ctx) override {
+		VoxelInstancer *instancer = instancer_ref.get();
+		if (instancer == nullptr || !instancer->is_inside_tree()) {
+			// The instancer was destroyed or removed from the tree while the task was pending
+			return;
+		}
+		Ref<World3D> world = instancer->get_world_3d();
+		ZN_ASSERT_RETURN(world.is_valid());
+		instancer->apply_task_output(output, **world, instancer->get_global_transform());
+	}
+
+	float get_order_hint() const override {
+		return viewer_distance_squared;
+	}
+
+	zylann::godot::ObjectWeakRef<VoxelInstancer> instancer_ref;
+	InstanceLoadingTaskOutput output;
+	float viewer_distance_squared = 0.f;
+};
+
 void VoxelInstancer::process_task_results() {
 	ZN_PROFILE_SCOPE();
 	static thread_local StdVector<InstanceLoadingTaskOutput> tls_results;
@@ -246,74 +311,120 @@ void VoxelInstancer::process_task_results() {
 		return;
 	}
 
-	Ref<World3D> maybe_world = get_world_3d();
-	ZN_ASSERT_RETURN(maybe_world.is_valid());
-	World3D &world = **maybe_world;
-
 	const Transform3D parent_transform = get_global_transform();
-
-	const int data_block_size_base = (1 << _parent_mesh_block_size_po2);
 	const int mesh_block_size_base = (1 << _parent_mesh_block_size_po2);
-	const int render_to_data_factor = mesh_block_size_base / data_block_size_base;
 
 	for (InstanceLoadingTaskOutput &output : results) {
 		auto layer_it = _layers.find(output.layer_id);
 		if (layer_it == _layers.end()) {
 			// Layer was removed since?
-			ZN_PRINT_VERBOSE(
-					format("Processing async instance generator results, but the layer isn't present ({}).",
-						   static_cast<int>(output.layer_id))
-			);
 			continue;
 		}
-		Layer &layer = layer_it->second;
-
-		const VoxelInstanceLibraryItem *item = _library->get_item(output.layer_id);
-		ZN_ASSERT_CONTINUE_MSG(item != nullptr, "Item removed from library while it was loading?");
+		// Creating scene instances and uploading MultiMesh buffers can be slow, so it is spread over frames within
+		// the main thread time budget. Blocks closer to viewers get their instances first.
+		ApplyTaskOutputTask *task = ZN_NEW(ApplyTaskOutputTask);
+		task->instancer_ref.set(this);
+		const int mesh_block_size = mesh_block_size_base << layer_it->second.lod_index;
+		const Vector3 block_center =
+				to_vec3(output.render_block_position * mesh_block_size) + Vector3(0.5, 0.5, 0.5) * mesh_block_size;
+		task->viewer_distance_squared =
+				VoxelEngine::get_singleton().get_closest_viewer_distance_squared(parent_transform.xform(block_center));
+		task->output = std::move(output);
+		VoxelEngine::get_singleton().push_main_thread_time_spread_task(task);
+	}
 
-		auto block_it = layer.blocks.find(output.render_block_position);
-		if (block_it == layer.blocks.end()) {
-			// The block was removed while the generation process was running?
-			ZN_PRINT_VERBOSE("Processing async instance generator results, but the block was removed.");
-			continue;
-		}
+	results.clear();
+}
 
-		if (output.edited_mask != 0) {
-			Lod &lod = _lods[layer.lod_index];
-			const Vector3i minp = output.render_block_position * render_to_data_factor;
-			const Vector3i maxp = minp + Vector3iUtil::create(render_to_data_factor);
-			Vector3i bpos;
-			unsigned int i = 0;
-			for (bpos.z = minp.z; bpos.z < maxp.z; ++bpos.z) {
-				for (bpos.y = minp.y; bpos.y < maxp.y; ++bpos.y) {
-					for (bpos.x = minp.x; bpos.x < maxp.x; ++bpos.x) {
-						if ((output.edited_mask & (1 << i)) != 0) {
-							lod.edited_data_blocks.insert(bpos);
-						}
-						++i;
-					}
+void VoxelInstancer::mark_task_output_data_blocks(
+		Vector3i render_block_position,
+		unsigned int mesh_block_size_po2,
+		unsigned int data_block_size_po2,
+		uint8_t edited_mask,
+		bool save_generated,
+		StdUnorderedSet<Vector3i> &edited_data_blocks,
+		StdUnorderedSet<Vector3i> &modified_blocks
+) {
+	const int render_to_data_factor = 1 << (mesh_block_size_po2 - data_block_size_po2);
+	const Vector3i minp = render_block_position * render_to_data_factor;
+	const Vector3i maxp = minp + Vector3iUtil::create(render_to_data_factor);
+	Vector3i bpos;
+	unsigned int i = 0;
+	for (bpos.z = minp.z; bpos.z < maxp.z; ++bpos.z) {
+		for (bpos.y = minp.y; bpos.y < maxp.y; ++bpos.y) {
+			for (bpos.x = minp.x; bpos.x < maxp.x; ++bpos.x) {
+				if ((edited_mask & (1 << i)) != 0) {
+					edited_data_blocks.insert(bpos);
+				} else if (save_generated) {
+					modified_blocks.insert(bpos);
 				}
+				++i;
 			}
 		}
+	}
+}
 
-		const int mesh_block_size = mesh_block_size_base << layer.lod_index;
-		const Transform3D block_local_transform = Transform3D(Basis(), output.render_block_position * mesh_block_size);
-		const Transform3D block_global_transform = parent_transform * block_local_transform;
+void VoxelInstancer::apply_task_output(
+		InstanceLoadingTaskOutput &output,
+		World3D &world,
+		const Transform3D &parent_transform
+) {
+	const int mesh_block_size_base = (1 << _parent_mesh_block_size_po2);
 
-		update_block_from_transforms( //
-				block_it->second, //
-				to_span_const(output.transforms), //
-				output.render_block_position, //
-				layer, //
-				*item, //
-				output.layer_id, //
-				world, //
-				block_global_transform, //
-				block_local_transform.origin //
+	auto layer_it = _layers.find(output.layer_id);
+	if (layer_it == _layers.end()) {
+		// Layer was removed since?
+		ZN_PRINT_VERBOSE(
+				format("Processing async instance generator results, but the layer isn't present ({}).",
+					   static_cast<int>(output.layer_id))
 		);
+		return;
 	}
+	Layer &layer = layer_it->second;
 
-	results.clear();
+	const VoxelInstanceLibraryItem *item = _library->get_item(output.layer_id);
+	ZN_ASSERT_RETURN_MSG(item != nullptr, "Item removed from library while it was loading?");
+
+	auto block_it = layer.blocks.find(output.render_block_position);
+	if (block_it == layer.blocks.end()) {
+		// The block was removed while the generation process was running?
+		ZN_PRINT_VERBOSE("Processing async instance generator results, but the block was removed.");
+		return;
+	}
+
+	// Generated parts get saved like edited ones, so next time they load they will be taken from the stream instead
+	const bool save_generated = output.generated && _save_generated_instances && item->is_persistent() &&
+			_parent != nullptr && _parent->get_stream().is_valid();
+
+	if (output.edited_mask != 0 || save_generated) {
+		Lod &lod = _lods[layer.lod_index];
+		mark_task_output_data_blocks(
+				output.render_block_position,
+				_parent_mesh_block_size_po2,
+				_parent_data_block_size_po2,
+				output.edited_mask,
+				save_generated,
+				lod.edited_data_blocks,
+				lod.modified_blocks
+		);
+	}
+
+	const int mesh_block_size = mesh_block_size_base << layer.lod_index;
+	const Transform3D block_local_transform = Transform3D(Basis(), output.render_block_position * mesh_block_size);
+	const Transform3D block_global_transform = parent_transform * block_local_transform;
+
+	update_block_from_transforms( //
+			block_it->second, //
+			to_span_const(output.transforms), //
+			output.render_block_position, //
+			layer, //
+			*item, //
+			output.layer_id, //
+			world, //
+			block_global_transform, //
+			block_local_transform.origin, //
+			output.multimesh_bulk_array //
+	);
 }
 
 #ifdef TOOLS_ENABLED
@@ -427,8 +538,51 @@ Vector3 get_global_camera_position(const Node &node) {
 	return camera->get_global_position();
 }
 
+// Squared distances between a position and the positions stored in separate arrays, 4 positions at a time
+void get_distances_squared(
+		Span<const float> xs,
+		Span<const float> ys,
+		Span<const float> zs,
+		const Vector3f position,
+		Span<float> out_distances_squared
+) {
+	ZN_ASSERT(ys.size() == xs.size() && zs.size() == xs.size() && out_distances_squared.size() >= xs.size());
+
+	const math::Float4 px(position.x);
+	const math::Float4 py(position.y);
+	const math::Float4 pz(position.z);
+
+	unsigned int i = 0;
+	for (; i + math::Float4::SIZE <= xs.size(); i += math::Float4::SIZE) {
+		const math::Float4 dx = math::Float4::load(&xs[i]) - px;
+		const math::Float4 dy = math::Float4::load(&ys[i]) - py;
+		const math::Float4 dz = math::Float4::load(&zs[i]) - pz;
+		(dx * dx + dy * dy + dz * dz).store(&out_distances_squared[i]);
+	}
+	for (; i < xs.size(); ++i) {
+		out_distances_squared[i] = math::squared(xs[i] - position.x) + math::squared(ys[i] - position.y) +
+				math::squared(zs[i] - position.z);
+	}
+}
+
 } // namespace
 
+Vector3f VoxelInstancer::get_block_center(const Block &block) const {
+	const int block_size = 1 << (_parent_mesh_block_size_po2 + block.lod_index);
+	const int hs = block_size >> 1;
+	return to_vec3f(block.grid_position * block_size + Vector3i(hs, hs, hs));
+}
+
+void VoxelInstancer::reset_block_mesh_lods() {
+	for (unsigned int block_index = 0; block_index < _blocks.size(); ++block_index) {
+		const Vector3f center = get_block_center(*_blocks[block_index]);
+		_block_mesh_lods.center_xs[block_index] = center.x;
+		_block_mesh_lods.center_ys[block_index] = center.y;
+		_block_mesh_lods.center_zs[block_index] = center.z;
+		_block_mesh_lods.invalidate(block_index);
+	}
+}
+
 void VoxelInstancer::update_mesh_from_mesh_lod(
 		Block &block,
 		const VoxelInstanceLibraryMultiMeshItem::Settings &settings,
@@ -453,19 +607,215 @@ void VoxelInstancer::update_mesh_from_mesh_lod(
 	}
 }
 
+void VoxelInstancer::update_block_merging(Block &block, const VoxelInstanceLibraryMultiMeshItem &item) {
+	const unsigned int merge_from_mesh_lod = item.get_merge_from_mesh_lod();
+	const VoxelInstanceLibraryMultiMeshItem::Settings &settings = item.get_multimesh_settings();
+
+	// Blocks hidden beyond the last LOD are not merged
+	const bool merged = merge_from_mesh_lod > 0 && block.multimesh_instance.is_valid() &&
+			block.merge_bulk_array.size() > 0 && block.current_mesh_lod >= merge_from_mesh_lod &&
+			block.current_mesh_lod < settings.mesh_lod_count;
+
+	// The block gets hidden only once its chunk is ready, so instances don't disappear in the meantime
+	if (merged || block.merged) {
+		mark_merged_chunk_dirty(block, item.get_merged_chunk_size_po2());
+	}
+	block.merged = merged;
+}
+
+void VoxelInstancer::mark_merged_chunk_dirty(const Block &block, unsigned int chunk_size_po2) {
+	Layer &layer = get_layer(block.layer_id);
+	const Vector3i chunk_position = block.grid_position >> chunk_size_po2;
+	MergedChunk &chunk = layer.merged_chunks[chunk_position];
+	++chunk.version;
+	if (!chunk.dirty) {
+		chunk.dirty = true;
+		_dirty_merged_chunks.push_back(DirtyMergedChunk{ block.layer_id, chunk_position });
+	}
+}
+
+void VoxelInstancer::clear_merged_chunks(Layer &layer) {
+	// Destroying chunks also destroys their multimesh instances. Results of pending tasks will not find them.
+	layer.merged_chunks.clear();
+}
+
+void VoxelInstancer::process_merged_chunks() {
+	ZN_PROFILE_SCOPE();
+
+	const Transform3D parent_transform = get_global_transform();
+	const bool instancer_is_visible = is_visible_in_tree();
+	const int base_block_size_po2 = _parent_mesh_block_size_po2;
+
+	// Apply merged chunks
+
+	static thread_local StdVector<MergedInstanceChunkOutput> tls_outputs;
+	StdVector<MergedInstanceChunkOutput> &outputs = tls_outputs;
+	{
+		MutexLock mlock(_loading_results->mutex);
+		outputs.swap(_loading_results->merged_chunks);
+	}
+
+	for (MergedInstanceChunkOutput &output : outputs) {
+		auto layer_it = _layers.find(output.layer_id);
+		if (layer_it == _layers.end()) {
+			continue;
+		}
+		Layer &layer = layer_it->second;
+
+		auto chunk_it = layer.merged_chunks.find(output.chunk_position);
+		if (chunk_it == layer.merged_chunks.end() || chunk_it->second.version != output.version) {
+			// Removed or changed since the task was scheduled. A newer task will take care of it.
+			continue;
+		}
+		MergedChunk &chunk = chunk_it->second;
+
+		const VoxelInstanceLibraryMultiMeshItem *item =
+				Object::cast_to<VoxelInstanceLibraryMultiMeshItem>(_library->get_item_const(output.layer_id));
+		ERR_CONTINUE(item == nullptr);
+		const VoxelInstanceLibraryMultiMeshItem::Settings &settings = item->get_multimesh_settings();
+		ERR_CONTINUE(chunk.mesh_lod >= settings.mesh_lod_count);
+
+		Ref<MultiMesh> multimesh = chunk.multimesh_instance.get_multimesh();
+		if (multimesh.is_null()) {
+			multimesh.instantiate();
+			multimesh->set_transform_format(MultiMesh::TRANSFORM_3D);
+			multimesh->set_use_colors(false);
+			multimesh->set_use_custom_data(false);
+		}
+		multimesh->set_instance_count(output.bulk_array.size() / 12);
+		// Setting the mesh before the buffer, so Godot doesn't download the buffer back to compute the AABB
+		multimesh->set_mesh(settings.mesh_lods[chunk.mesh_lod]);
+		RenderingServer::get_singleton()->multimesh_set_buffer(multimesh->get_rid(), output.bulk_array);
+
+		const int chunk_size_po2 = base_block_size_po2 + layer.lod_index + item->get_merged_chunk_size_po2();
+		const Vector3 chunk_local_pos(output.chunk_position << chunk_size_po2);
+
+		if (!chunk.multimesh_instance.is_valid()) {
+			chunk.multimesh_instance.create();
+			chunk.multimesh_instance.set_world(*get_world_3d());
+		}
+		chunk.multimesh_instance.set_multimesh(multimesh);
+		chunk.multimesh_instance.set_transform(
+				Transform3D(parent_transform.basis, parent_transform.xform(chunk_local_pos))
+		);
+		chunk.multimesh_instance.set_render_layer(settings.render_layer);
+		chunk.multimesh_instance.set_material_override(settings.material_override);
+		chunk.multimesh_instance.set_cast_shadows_setting(settings.shadow_casting_setting);
+		chunk.multimesh_instance.set_gi_mode(settings.gi_mode);
+		chunk.multimesh_instance.set_visible(instancer_is_visible);
+
+		// Now the chunk draws them, hide merged blocks
+		const unsigned int chunk_size_in_blocks = 1 << item->get_merged_chunk_size_po2();
+		const Box3i blocks_box(
+				output.chunk_position * chunk_size_in_blocks, Vector3iUtil::create(chunk_size_in_blocks)
+		);
+		blocks_box.for_each_cell([this, &layer](Vector3i block_position) {
+			auto block_it = layer.blocks.find(block_position);
+			if (block_it == layer.blocks.end()) {
+				return;
+			}
+			Block &block = *_blocks[block_it->second];
+			if (block.merged) {
+				block.multimesh_instance.set_visible(false);
+			}
+		});
+	}
+
+	outputs.clear();
+
+	// Schedule merging of chunks that changed
+
+	if (_dirty_merged_chunks.size() == 0) {
+		return;
+	}
+
+	static thread_local StdVector<IThreadedTask *> tls_tasks;
+	StdVector<IThreadedTask *> &tasks = tls_tasks;
+	tasks.clear();
+
+	for (const DirtyMergedChunk &dirty_chunk : _dirty_merged_chunks) {
+		auto layer_it = _layers.find(dirty_chunk.layer_id);
+		if (layer_it == _layers.end()) {
+			continue;
+		}
+		Layer &layer = layer_it->second;
+
+		auto chunk_it = layer.merged_chunks.find(dirty_chunk.position);
+		if (chunk_it == layer.merged_chunks.end()) {
+			// Chunks were cleared since
+			continue;
+		}
+		MergedChunk &chunk = chunk_it->second;
+		chunk.dirty = false;
+
+		const VoxelInstanceLibraryMultiMeshItem *item =
+				Object::cast_to<VoxelInstanceLibraryMultiMeshItem>(_library->get_item_const(dirty_chunk.layer_id));
+		ERR_CONTINUE(item == nullptr);
+
+		MergeInstanceChunkTask *task = ZN_NEW(MergeInstanceChunkTask);
+
+		const unsigned int chunk_size_in_blocks = 1 << item->get_merged_chunk_size_po2();
+		const int block_size = 1 << (base_block_size_po2 + layer.lod_index);
+		const Vector3i chunk_origin_in_blocks = dirty_chunk.position * chunk_size_in_blocks;
+		const Box3i blocks_box(chunk_origin_in_blocks, Vector3iUtil::create(chunk_size_in_blocks));
+		unsigned int mesh_lod = std::numeric_limits<uint8_t>::max();
+
+		blocks_box.for_each_cell([this, &layer, task, &mesh_lod, chunk_origin_in_blocks, block_size](
+										 Vector3i block_position
+								 ) {
+			auto block_it = layer.blocks.find(block_position);
+			if (block_it == layer.blocks.end()) {
+				return;
+			}
+			const Block &block = *_blocks[block_it->second];
+			if (!block.merged) {
+				return;
+			}
+			MergeInstanceChunkTask::Source source;
+			source.bulk_array = block.merge_bulk_array;
+			source.offset = to_vec3f((block_position - chunk_origin_in_blocks) * block_size);
+			task->sources.push_back(source);
+			mesh_lod = math::min(mesh_lod, static_cast<unsigned int>(block.current_mesh_lod));
+		});
+
+		if (task->sources.size() == 0) {
+			// No block is merged anymore
+			ZN_DELETE(task);
+			layer.merged_chunks.erase(chunk_it);
+			continue;
+		}
+
+		chunk.mesh_lod = mesh_lod;
+
+		task->chunk_position = dirty_chunk.position;
+		task->layer_id = dirty_chunk.layer_id;
+		task->version = chunk.version;
+		task->output_queue = _loading_results;
+		tasks.push_back(task);
+	}
+
+	_dirty_merged_chunks.clear();
+
+	if (tasks.size() > 0) {
+		VoxelEngine::get_singleton().push_async_tasks(to_span(tasks));
+	}
+}
+
 void VoxelInstancer::update_mesh_lod_distances_from_parent() {
 	ZN_ASSERT_RETURN(_parent != nullptr);
 
 	VoxelLodTerrain *vlt = Object::cast_to<VoxelLodTerrain>(_parent);
 	if (vlt != nullptr) {
 		vlt->get_lod_distances(to_span(_mesh_lod_distances));
-		return;
+	} else {
+		VoxelTerrain *vt = Object::cast_to<VoxelTerrain>(_parent);
+		if (vt != nullptr) {
+			_mesh_lod_distances[0] = vt->get_max_view_distance();
+		}
 	}
 
-	VoxelTerrain *vt = Object::cast_to<VoxelTerrain>(_parent);
-	if (vt != nullptr) {
-		_mesh_lod_distances[0] = vt->get_max_view_distance();
-	}
+	// Ranges in which mesh LODs don't change depend on these distances
+	reset_block_mesh_lods();
 }
 
 void VoxelInstancer::process_mesh_lods() {
@@ -480,7 +830,6 @@ void VoxelInstancer::process_mesh_lods() {
 	const Vector3 cam_pos_local = gtrans.affine_inverse().xform(cam_pos_global);
 
 	ERR_FAIL_COND(_parent == nullptr);
-	const unsigned int block_size = 1 << _parent_mesh_block_size_po2;
 
 	const float hysteresis = 1.05;
 
@@ -489,23 +838,42 @@ void VoxelInstancer::process_mesh_lods() {
 
 	const bool instancer_is_visible = is_visible_in_tree();
 
+	const Vector3f cam_pos = to_vec3f(cam_pos_local);
+
 	// const unsigned int initial_mesh_lod_time_sliced_block_index = _mesh_lod_time_sliced_block_index;
 
+	// Iterate a portion of blocks, then check timing budget once after that
+	const unsigned int desired_portion_size = 256;
+	FixedArray<float, desired_portion_size> distances_squared;
+
 	while (_mesh_lod_time_sliced_block_index < _blocks.size()) {
-		// Iterate a portion of blocks, then check timing budget once after that
-		const unsigned int desired_portion_size = 64;
-		const unsigned int portion_end = math::min(
-				_mesh_lod_time_sliced_block_index + desired_portion_size, static_cast<unsigned int>(_blocks.size())
-		);
-		Span<UniquePtr<Block>> blocks_portion = to_span_from_position_and_size(
-				_blocks, _mesh_lod_time_sliced_block_index, portion_end - _mesh_lod_time_sliced_block_index
-		);
+		const unsigned int portion_begin = _mesh_lod_time_sliced_block_index;
+		const unsigned int portion_end =
+				math::min(portion_begin + desired_portion_size, static_cast<unsigned int>(_blocks.size()));
 		_mesh_lod_time_sliced_block_index = portion_end;
 
-		for (UniquePtr<Block> &block_ptr : blocks_portion) {
-			Block &block = *block_ptr;
+		const unsigned int portion_size = portion_end - portion_begin;
+		get_distances_squared(
+				to_span_from_position_and_size(_block_mesh_lods.center_xs, portion_begin, portion_size),
+				to_span_from_position_and_size(_block_mesh_lods.center_ys, portion_begin, portion_size),
+				to_span_from_position_and_size(_block_mesh_lods.center_zs, portion_begin, portion_size),
+				cam_pos,
+				to_span(distances_squared)
+		);
+
+		for (unsigned int block_index = portion_begin; block_index < portion_end; ++block_index) {
+			const float distance_squared = distances_squared[block_index - portion_begin];
+
+			// Most blocks keep the same mesh LOD from one frame to the next, and are skipped without being accessed
+			if (distance_squared >= _block_mesh_lods.min_distances_sq[block_index] &&
+				distance_squared <= _block_mesh_lods.max_distances_sq[block_index]) {
+				continue;
+			}
+
+			Block &block = *_blocks[block_index];
 			// Early exit for empty blocks (we only do this for multimeshes so no need to check other things)
 			if (!block.multimesh_instance.is_valid()) {
+				_block_mesh_lods.set_range_infinite(block_index);
 				continue;
 			}
 
@@ -516,6 +884,7 @@ void VoxelInstancer::process_mesh_lods() {
 					Object::cast_to<VoxelInstanceLibraryMultiMeshItem>(item_base);
 			if (item == nullptr) {
 				// Not a multimesh item
+				_block_mesh_lods.set_range_infinite(block_index);
 				continue;
 			}
 			const VoxelInstanceLibraryMultiMeshItem::Settings &settings = item->get_multimesh_settings();
@@ -525,8 +894,7 @@ void VoxelInstancer::process_mesh_lods() {
 			// only one mesh setup, yet be considered having LOD
 			if (extended_mesh_lod_count <= 1) {
 				// This block has no LOD
-				// TODO Optimization: would be nice to not need this conditional by iterating only item types that
-				// define lods
+				_block_mesh_lods.set_range_infinite(block_index);
 				continue;
 			}
 
@@ -535,17 +903,6 @@ void VoxelInstancer::process_mesh_lods() {
 			Span<const float> distance_ratios = item->get_mesh_lod_distance_ratios();
 			const float max_distance = _mesh_lod_distances[lod_index];
 
-			// #ifdef DEBUG_ENABLED
-			// 		ERR_FAIL_COND(mesh_lod_count < VoxelInstanceLibraryMultiMeshItem::MAX_MESH_LODS);
-			// #endif
-
-			// const Lod &lod = _lods[lod_index];
-
-			const int lod_block_size = block_size << lod_index;
-			const int hs = lod_block_size >> 1;
-			const Vector3 block_center_local(block.grid_position * lod_block_size + Vector3i(hs, hs, hs));
-			const float distance_squared = cam_pos_local.distance_squared_to(block_center_local);
-
 			// Compute current mesh LOD index (note, block.current_mesh_lod can totally be out of range due to eventual
 			// config changes, or even as a way to force an update. This will bring it back in range)
 			unsigned int current_mesh_lod = block.current_mesh_lod;
@@ -568,10 +925,20 @@ void VoxelInstancer::process_mesh_lods() {
 				--current_mesh_lod;
 			}
 
+			// Same thresholds as above, the block doesn't need to be checked again until it crosses one of them
+			_block_mesh_lods.set_range(
+					block_index,
+					current_mesh_lod > 0 ? math::squared(distance_ratios[current_mesh_lod - 1] * max_distance) : 0.f,
+					current_mesh_lod + 1 < extended_mesh_lod_count
+							? math::squared(distance_ratios[current_mesh_lod] * max_distance * hysteresis)
+							: std::numeric_limits<float>::max()
+			);
+
 			// Apply if it changed
 			if (block.current_mesh_lod != current_mesh_lod) {
 				block.current_mesh_lod = current_mesh_lod;
 				update_mesh_from_mesh_lod(block, settings, hide_beyond_max_lod, instancer_is_visible);
+				update_block_merging(block, *item);
 			}
 		}
 
@@ -591,6 +958,139 @@ void VoxelInstancer::process_mesh_lods() {
 	}
 }
 
+void VoxelInstancer::process_collision_bodies() {
+	ZN_PROFILE_SCOPE();
+	ERR_FAIL_COND(_library.is_null());
+
+	// Bodies are children of the instancer, so work in its local space
+	static thread_local StdVector<Vector3> tls_viewer_positions;
+	StdVector<Vector3> &viewer_positions = tls_viewer_positions;
+	viewer_positions.clear();
+	const Transform3D to_local = get_global_transform().affine_inverse();
+	VoxelEngine::get_singleton().for_each_viewer(
+			[&viewer_positions, &to_local](ViewerID id, const VoxelEngine::Viewer &viewer) {
+				if (viewer.require_collisions) {
+					viewer_positions.push_back(to_local.xform(viewer.world_position));
+				}
+			}
+	);
+
+	const uint64_t collision_update_time_budget_microseconds = 500;
+	const uint64_t time_up_time =
+			Time::get_singleton()->get_ticks_usec() + collision_update_time_budget_microseconds;
+
+	while (_collision_time_sliced_block_index < _blocks.size()) {
+		// Iterate a portion of blocks, then check timing budget once after that
+		const unsigned int desired_portion_size = 64;
+		const unsigned int portion_end = math::min(
+				_collision_time_sliced_block_index + desired_portion_size, static_cast<unsigned int>(_blocks.size())
+		);
+
+		for (unsigned int block_index = _collision_time_sliced_block_index; block_index < portion_end;
+			 ++block_index) {
+			Block &block = *_blocks[block_index];
+			// Early exit for blocks without collisions
+			if (block.bodies.size() == 0) {
+				continue;
+			}
+
+			const VoxelInstanceLibraryMultiMeshItem *item =
+					Object::cast_to<VoxelInstanceLibraryMultiMeshItem>(_library->get_item_const(block.layer_id));
+			if (item == nullptr || item->get_collision_distance() <= 0.f) {
+				// Bodies of this item are all created when the block loads
+				continue;
+			}
+
+			update_block_bodies_near_viewers(
+					block_index,
+					get_layer(block.layer_id),
+					item->get_multimesh_settings(),
+					item->get_collision_distance(),
+					to_span(viewer_positions)
+			);
+		}
+
+		_collision_time_sliced_block_index = portion_end;
+
+		if (Time::get_singleton()->get_ticks_usec() > time_up_time) {
+			break;
+		}
+	}
+
+	if (_collision_time_sliced_block_index >= _blocks.size()) {
+		_collision_time_sliced_block_index = 0;
+	}
+}
+
+void VoxelInstancer::update_block_bodies_near_viewers(
+		unsigned int block_index,
+		Layer &layer,
+		const VoxelInstanceLibraryMultiMeshItem::Settings &settings,
+		float collision_distance,
+		Span<const Vector3> viewer_positions
+) {
+	Block &block = *_blocks[block_index];
+	ZN_ASSERT_RETURN(block.body_transforms.size() == block.bodies.size());
+
+	// Bodies are released a bit further than where they get created, so they don't get recycled over and over when a
+	// viewer moves around the limit
+	const float hysteresis = 1.1f;
+	const float release_distance = collision_distance * hysteresis;
+
+	const int block_size_po2 = _parent_mesh_block_size_po2 + block.lod_index;
+	const Vector3 block_origin(block.grid_position << block_size_po2);
+	const AABB block_box(block_origin, Vector3(Vector3iUtil::create(1 << block_size_po2)));
+	const AABB near_box = block_box.grow(release_distance);
+
+	bool near_viewers = false;
+	for (const Vector3 viewer_pos : viewer_positions) {
+		if (near_box.has_point(viewer_pos)) {
+			near_viewers = true;
+			break;
+		}
+	}
+
+	if (!near_viewers) {
+		if (block.body_count > 0) {
+			for (VoxelInstancerRigidBody *&body : block.bodies) {
+				if (body != nullptr) {
+					release_body(layer, body);
+					body = nullptr;
+				}
+			}
+			block.body_count = 0;
+		}
+		return;
+	}
+
+	const float create_distance_sq = math::squared(collision_distance);
+	const float release_distance_sq = math::squared(release_distance);
+
+	for (unsigned int instance_index = 0; instance_index < block.bodies.size(); ++instance_index) {
+		const Vector3 instance_pos = to_vec3(block.body_transforms[instance_index].origin) + block_origin;
+
+		float closest_distance_sq = std::numeric_limits<float>::max();
+		for (const Vector3 viewer_pos : viewer_positions) {
+			closest_distance_sq = math::min(closest_distance_sq, float(viewer_pos.distance_squared_to(instance_pos)));
+		}
+
+		VoxelInstancerRigidBody *&body = block.bodies[instance_index];
+
+		if (body == nullptr) {
+			if (closest_distance_sq < create_distance_sq) {
+				const Transform3D local_transform = to_transform3(block.body_transforms[instance_index]);
+				const Transform3D body_transform(local_transform.basis, instance_pos);
+				body = create_body(layer, settings, block_index, instance_index, body_transform);
+				++block.body_count;
+			}
+		} else if (closest_distance_sq > release_distance_sq) {
+			release_body(layer, body);
+			body = nullptr;
+			--block.body_count;
+		}
+	}
+}
+
 // We need to do this ourselves because we don't use nodes for multimeshes
 void VoxelInstancer::update_visibility() {
 	if (!is_inside_tree()) {
@@ -618,7 +1118,18 @@ void VoxelInstancer::update_visibility() {
 				}
 			}
 
-			block.multimesh_instance.set_visible(instancer_is_visible && visible_with_lod);
+			// Merged blocks are drawn by their chunk
+			block.multimesh_instance.set_visible(instancer_is_visible && visible_with_lod && !block.merged);
+		}
+	}
+
+	for (auto layer_it = _layers.begin(); layer_it != _layers.end(); ++layer_it) {
+		Layer &layer = layer_it->second;
+		for (auto chunk_it = layer.merged_chunks.begin(); chunk_it != layer.merged_chunks.end(); ++chunk_it) {
+			MergedChunk &chunk = chunk_it->second;
+			if (chunk.multimesh_instance.is_valid()) {
+				chunk.multimesh_instance.set_visible(instancer_is_visible);
+			}
 		}
 	}
 }
@@ -630,6 +1141,15 @@ void VoxelInstancer::set_world(World3D *world) {
 			block.multimesh_instance.set_world(world);
 		}
 	}
+	for (auto layer_it = _layers.begin(); layer_it != _layers.end(); ++layer_it) {
+		Layer &layer = layer_it->second;
+		for (auto chunk_it = layer.merged_chunks.begin(); chunk_it != layer.merged_chunks.end(); ++chunk_it) {
+			MergedChunk &chunk = chunk_it->second;
+			if (chunk.multimesh_instance.is_valid()) {
+				chunk.multimesh_instance.set_world(world);
+			}
+		}
+	}
 }
 
 void VoxelInstancer::set_up_mode(UpMode mode) {
@@ -647,6 +1167,14 @@ VoxelInstancer::UpMode VoxelInstancer::get_up_mode() const {
 	return _up_mode;
 }
 
+void VoxelInstancer::set_save_generated_instances(bool enabled) {
+	_save_generated_instances = enabled;
+}
+
+bool VoxelInstancer::get_save_generated_instances() const {
+	return _save_generated_instances;
+}
+
 void VoxelInstancer::set_library(Ref<VoxelInstanceLibrary> library) {
 	if (library == _library) {
 		return;
@@ -669,6 +1197,7 @@ void VoxelInstancer::set_library(Ref<VoxelInstanceLibrary> library) {
 		});
 
 		_library->add_listener(this);
+		_scene_pool_prewarm_pending = true;
 	}
 
 	update_configuration_warnings();
@@ -837,7 +1366,8 @@ void VoxelInstancer::regenerate_layer(uint16_t layer_id, bool regenerate_blocks)
 				layer_id,
 				world,
 				block_transform,
-				block_local_transform.origin
+				block_local_transform.origin,
+				PackedFloat32Array()
 		);
 	}
 }
@@ -856,11 +1386,54 @@ void VoxelInstancer::update_layer_meshes(int layer_id) {
 	const VoxelInstanceLibraryMultiMeshItem::Settings &settings = item->get_multimesh_settings();
 	const unsigned int extended_mesh_lod_count = settings.mesh_lod_count + (hide_beyond_max_lod ? 1 : 0);
 
-	for (auto it = _blocks.begin(); it != _blocks.end(); ++it) {
-		Block &block = **it;
+	Layer &layer = get_layer(layer_id);
+
+	// Merging settings may have changed, so chunks get merged again from scratch
+	clear_merged_chunks(layer);
+	// Pooled bodies may use previous collision settings
+	clear_body_pool(layer);
+
+	const bool lazy_bodies = item->get_collision_distance() > 0.f;
+
+	for (unsigned int block_index = 0; block_index < _blocks.size(); ++block_index) {
+		Block &block = *_blocks[block_index];
 		if (block.layer_id != layer_id || !block.multimesh_instance.is_valid()) {
 			continue;
 		}
+
+		// Collision distance may have changed
+		if (block.bodies.size() > 0) {
+			const int block_size_po2 = _parent_mesh_block_size_po2 + block.lod_index;
+			const Vector3 block_origin(block.grid_position << block_size_po2);
+
+			if (lazy_bodies) {
+				if (block.body_transforms.size() != block.bodies.size()) {
+					// All instances had a body so far. Keep their transforms so they can be created again later.
+					block.body_transforms.resize(block.bodies.size());
+					for (unsigned int instance_index = 0; instance_index < block.bodies.size(); ++instance_index) {
+						const VoxelInstancerRigidBody *body = block.bodies[instance_index];
+						ZN_ASSERT_CONTINUE(body != nullptr);
+						Transform3D local_transform = body->get_transform();
+						local_transform.origin -= block_origin;
+						block.body_transforms[instance_index] = to_transform3f(local_transform);
+					}
+				}
+
+			} else if (block.body_count < block.bodies.size() && block.body_transforms.size() == block.bodies.size()) {
+				// All instances need a body now
+				for (unsigned int instance_index = 0; instance_index < block.bodies.size(); ++instance_index) {
+					VoxelInstancerRigidBody *&body = block.bodies[instance_index];
+					if (body == nullptr) {
+						const Transform3D local_transform = to_transform3(block.body_transforms[instance_index]);
+						const Transform3D body_transform(local_transform.basis, local_transform.origin + block_origin);
+						body = create_body(layer, settings, block_index, instance_index, body_transform);
+						++block.body_count;
+					}
+				}
+				block.body_transforms.clear();
+			}
+		}
+		block.merged = false;
 		block.multimesh_instance.set_render_layer(settings.render_layer);
 		block.multimesh_instance.set_material_override(settings.material_override);
 		block.multimesh_instance.set_cast_shadows_setting(settings.shadow_casting_setting);
@@ -868,6 +1441,22 @@ void VoxelInstancer::update_layer_meshes(int layer_id) {
 
 		block.current_mesh_lod = math::min(static_cast<unsigned int>(block.current_mesh_lod), extended_mesh_lod_count);
 		update_mesh_from_mesh_lod(block, settings, hide_beyond_max_lod, instancer_is_visible);
+		_block_mesh_lods.invalidate(block_index);
+
+		if (item->get_merge_from_mesh_lod() > 0) {
+			if (block.merge_bulk_array.size() == 0) {
+				// Merging got enabled, we need a copy of the instances
+				block.merge_bulk_array = RenderingServer::get_singleton()->multimesh_get_buffer(
+						block.multimesh_instance.get_multimesh()->get_rid()
+				);
+				const int visible_count =
+						zylann::godot::get_visible_instance_count(**block.multimesh_instance.get_multimesh());
+				block.merge_bulk_array.resize(visible_count * 12);
+			}
+			update_block_merging(block, *item);
+		} else {
+			block.merge_bulk_array = PackedFloat32Array();
+		}
 	}
 }
 
@@ -879,14 +1468,26 @@ void VoxelInstancer::update_layer_scenes(int layer_id) {
 	ERR_FAIL_COND(item == nullptr);
 	const int data_block_size_po2 = _parent_data_block_size_po2;
 
+	// Pooled instances use the previous scene
+	Layer &layer = get_layer(layer_id);
+	clear_scene_pool(layer);
+
 	for (unsigned int block_index = 0; block_index < _blocks.size(); ++block_index) {
 		Block &block = *_blocks[block_index];
+		if (block.layer_id != layer_id) {
+			continue;
+		}
 
 		for (unsigned int instance_index = 0; instance_index < block.scene_instances.size(); ++instance_index) {
 			SceneInstance prev_instance = block.scene_instances[instance_index];
 			ERR_CONTINUE(prev_instance.root == nullptr);
 			SceneInstance instance = create_scene_instance(
-					*item, instance_index, block_index, prev_instance.root->get_transform(), data_block_size_po2
+					*item,
+					layer,
+					instance_index,
+					block_index,
+					prev_instance.root->get_transform(),
+					data_block_size_po2
 			);
 			ERR_CONTINUE(instance.root == nullptr);
 			block.scene_instances[instance_index] = instance;
@@ -923,6 +1524,7 @@ void VoxelInstancer::on_library_item_changed(int item_id, IInstanceLibraryItemLi
 			if (is_inside_tree()) {
 				regenerate_layer(item_id, true);
 			}
+			_scene_pool_prewarm_pending = true;
 			update_configuration_warnings();
 		} break;
 
@@ -944,6 +1546,7 @@ void VoxelInstancer::on_library_item_changed(int item_id, IInstanceLibraryItemLi
 
 		case IInstanceLibraryItemListener::CHANGE_SCENE:
 			update_layer_scenes(item_id);
+			_scene_pool_prewarm_pending = true;
 			break;
 
 		case IInstanceLibraryItemListener::CHANGE_LOD_INDEX: {
@@ -991,9 +1594,9 @@ void VoxelInstancer::add_layer(int layer_id, int lod_index) {
 	);
 #endif
 
-	Layer layer;
+	// Constructed in place, because layers hold non-copyable objects
+	Layer &layer = _layers[layer_id];
 	layer.lod_index = lod_index;
-	_layers.insert({ layer_id, layer });
 
 	lod.layers.push_back(layer_id);
 }
@@ -1012,6 +1615,9 @@ void VoxelInstancer::remove_layer(int layer_id) {
 	}
 
 	clear_blocks_in_layer(layer_id);
+	clear_scene_pool(layer);
+	clear_body_pool(layer);
+	clear_merged_chunks(layer);
 
 	_layers.erase(layer_id);
 }
@@ -1027,35 +1633,57 @@ void VoxelInstancer::remove_block(unsigned int block_index) {
 	const Block &moved_block = *_blocks.back();
 
 	UniquePtr<Block> block = std::move(_blocks[block_index]);
-	{
-		Layer &layer = get_layer(block->layer_id);
-		layer.blocks.erase(block->grid_position);
+	Layer &layer = get_layer(block->layer_id);
+	layer.blocks.erase(block->grid_position);
+
+	if (block->merged && _library.is_valid()) {
+		const VoxelInstanceLibraryMultiMeshItem *item =
+				Object::cast_to<VoxelInstanceLibraryMultiMeshItem>(_library->get_item_const(block->layer_id));
+		if (item != nullptr) {
+			// The chunk no longer contains this block
+			mark_merged_chunk_dirty(*block, item->get_merged_chunk_size_po2());
+		}
 	}
 	_blocks[block_index] = std::move(_blocks.back());
 	_blocks.pop_back();
+	_block_mesh_lods.remove_at_swap(block_index);
 
 	// Destroy objects linked to the block
 
 	for (unsigned int i = 0; i < block->bodies.size(); ++i) {
 		VoxelInstancerRigidBody *body = block->bodies[i];
-		body->detach_and_destroy();
+		if (body != nullptr) {
+			release_body(layer, body);
+		}
 	}
 
-	for (unsigned int i = 0; i < block->scene_instances.size(); ++i) {
-		SceneInstance instance = block->scene_instances[i];
-		ERR_CONTINUE(instance.component == nullptr);
-		instance.component->detach();
-		ERR_CONTINUE(instance.root == nullptr);
-		instance.root->queue_free();
+	if (block->scene_instances.size() > 0) {
+		unsigned int pool_size = 0;
+		if (_library.is_valid()) {
+			Ref<VoxelInstanceLibraryItem> item = _library->get_item(block->layer_id);
+			const VoxelInstanceLibrarySceneItem *scene_item = Object::cast_to<VoxelInstanceLibrarySceneItem>(*item);
+			if (scene_item != nullptr) {
+				pool_size = scene_item->get_pool_size();
+			}
+		}
+		for (unsigned int i = 0; i < block->scene_instances.size(); ++i) {
+			release_scene_instance(layer, pool_size, block->scene_instances[i]);
+		}
 	}
 
 	// If the block we removed was also the last one, we don't enter here
 	if (block.get() != &moved_block) {
 		// Update the index of the moved block referenced in its layer
-		Layer &layer = get_layer(moved_block.layer_id);
-		auto it = layer.blocks.find(moved_block.grid_position);
-		CRASH_COND(it == layer.blocks.end());
+		Layer &moved_block_layer = get_layer(moved_block.layer_id);
+		auto it = moved_block_layer.blocks.find(moved_block.grid_position);
+		CRASH_COND(it == moved_block_layer.blocks.end());
 		it->second = block_index;
+
+		for (VoxelInstancerRigidBody *body : moved_block.bodies) {
+			if (body != nullptr) {
+				body->set_render_block_index(block_index);
+			}
+		}
 	}
 }
 
@@ -1157,8 +1785,35 @@ void VoxelInstancer::save_all_modified_blocks(
 	}
 }
 
+namespace {
+
+// Instantiates the scene of an item, and makes sure its root has a component
+bool instantiate_scene(
+		const VoxelInstanceLibrarySceneItem &scene_item,
+		Node3D *&out_root,
+		VoxelInstanceComponent *&out_component
+) {
+	Node *root = scene_item.get_scene()->instantiate();
+	ERR_FAIL_COND_V(root == nullptr, false);
+	out_root = Object::cast_to<Node3D>(root);
+	if (out_root == nullptr) {
+		memdelete(root);
+		ERR_FAIL_V_MSG(false, "Root of scene instance must be derived from Spatial");
+	}
+
+	out_component = VoxelInstanceComponent::find_in(out_root);
+	if (out_component == nullptr) {
+		out_component = memnew(VoxelInstanceComponent);
+		out_root->add_child(out_component);
+	}
+	return true;
+}
+
+} // namespace
+
 VoxelInstancer::SceneInstance VoxelInstancer::create_scene_instance(
 		const VoxelInstanceLibrarySceneItem &scene_item,
+		Layer &layer,
 		int instance_index,
 		unsigned int block_index,
 		Transform3D transform,
@@ -1174,15 +1829,19 @@ VoxelInstancer::SceneInstance VoxelInstancer::create_scene_instance(
 								   VoxelInstancer::get_class_static()),
 							get_path())
 	);
-	Node *root = scene_item.get_scene()->instantiate();
-	ERR_FAIL_COND_V(root == nullptr, instance);
-	instance.root = Object::cast_to<Node3D>(root);
-	ERR_FAIL_COND_V_MSG(instance.root == nullptr, instance, "Root of scene instance must be derived from Spatial");
 
-	instance.component = VoxelInstanceComponent::find_in(instance.root);
-	if (instance.component == nullptr) {
-		instance.component = memnew(VoxelInstanceComponent);
-		instance.root->add_child(instance.component);
+	const bool from_pool = layer.scene_pool.size() > 0;
+	PooledSceneInstance pooled;
+
+	if (from_pool) {
+		// Reusing a hidden instance is much cheaper than instantiating and adding a new one to the tree
+		pooled = layer.scene_pool.back();
+		layer.scene_pool.pop_back();
+		instance = pooled.instance;
+	} else {
+		if (!instantiate_scene(scene_item, instance.root, instance.component)) {
+			return SceneInstance();
+		}
 	}
 
 	instance.component->attach(this);
@@ -1192,12 +1851,206 @@ VoxelInstancer::SceneInstance VoxelInstancer::create_scene_instance(
 
 	instance.root->set_transform(transform);
 
-	// This is the SLOWEST part because Godot triggers all sorts of callbacks
-	add_child(instance.root);
+	if (from_pool) {
+		instance.root->set_process_mode(pooled.process_mode);
+		instance.root->set_visible(pooled.visible);
+	} else {
+		// This is the SLOWEST part because Godot triggers all sorts of callbacks
+		add_child(instance.root);
+	}
 
 	return instance;
 }
 
+void VoxelInstancer::release_scene_instance(Layer &layer, unsigned int pool_size, SceneInstance instance) {
+	ERR_FAIL_COND(instance.component == nullptr);
+	instance.component->detach();
+	ERR_FAIL_COND(instance.root == nullptr);
+
+	if (layer.scene_pool.size() >= pool_size) {
+		instance.root->queue_free();
+		return;
+	}
+
+	// Keep the node in the tree, but hidden and disabled. Disabling also removes physics bodies from the world.
+	PooledSceneInstance pooled;
+	pooled.instance = instance;
+	pooled.visible = instance.root->is_visible();
+	pooled.process_mode = instance.root->get_process_mode();
+	instance.root->set_visible(false);
+	instance.root->set_process_mode(Node::PROCESS_MODE_DISABLED);
+	layer.scene_pool.push_back(pooled);
+}
+
+void VoxelInstancer::clear_scene_pool(Layer &layer) {
+	for (const PooledSceneInstance &pooled : layer.scene_pool) {
+		ERR_CONTINUE(pooled.instance.root == nullptr);
+		pooled.instance.root->queue_free();
+	}
+	layer.scene_pool.clear();
+	++layer.scene_pool_version;
+}
+
+VoxelInstancerRigidBody *VoxelInstancer::create_body(
+		Layer &layer,
+		const VoxelInstanceLibraryMultiMeshItem::Settings &settings,
+		unsigned int block_index,
+		unsigned int instance_index,
+		const Transform3D &transform
+) {
+	VoxelInstancerRigidBody *body;
+	const bool from_pool = layer.body_pool.size() > 0;
+
+	if (from_pool) {
+		body = layer.body_pool.back();
+		layer.body_pool.pop_back();
+
+	} else {
+		// TODO Performance: removing nodes from the tree is slow. It causes framerate stalls.
+		// See https://github.com/godotengine/godot/issues/61929
+		// Instances with collisions can lead to the creation of thousands of nodes. While this works in
+		// practice, removal proved to be very slow. Not because of physics, but because of an issue in the
+		// node system itself. A possible workaround is to either use servers directly, or put nodes as
+		// children of more nodes acting as buckets.
+		body = memnew(VoxelInstancerRigidBody);
+		body->set_collision_layer(settings.collision_layer);
+		body->set_collision_mask(settings.collision_mask);
+
+		for (unsigned int i = 0; i < settings.collision_shapes.size(); ++i) {
+			const CollisionShapeInfo &shape_info = settings.collision_shapes[i];
+			CollisionShape3D *cs = memnew(CollisionShape3D);
+			cs->set_shape(shape_info.shape);
+			cs->set_transform(shape_info.transform);
+			body->add_child(cs);
+		}
+
+		for (const StringName &group_name : settings.group_names) {
+			body->add_to_group(group_name);
+		}
+	}
+
+	body->attach(this);
+	body->set_instance_index(instance_index);
+	body->set_render_block_index(block_index);
+	body->set_data_block_position(math::floor_to_int(transform.origin) >> _parent_data_block_size_po2);
+	body->set_transform(transform);
+
+	if (from_pool) {
+		body->set_process_mode(Node::PROCESS_MODE_INHERIT);
+	} else {
+		add_child(body);
+	}
+
+	return body;
+}
+
+void VoxelInstancer::release_body(Layer &layer, VoxelInstancerRigidBody *body) {
+	ZN_ASSERT_RETURN(body != nullptr);
+
+	// Bodies get released as viewers move, keep enough of them around to avoid adding and removing nodes all the time
+	const unsigned int max_pooled_bodies = 1024;
+
+	if (layer.body_pool.size() >= max_pooled_bodies) {
+		body->detach_and_destroy();
+		return;
+	}
+
+	// Keep the node in the tree, but disabled. This removes it from the physics world.
+	body->detach();
+	body->set_process_mode(Node::PROCESS_MODE_DISABLED);
+	layer.body_pool.push_back(body);
+}
+
+void VoxelInstancer::clear_body_pool(Layer &layer) {
+	for (VoxelInstancerRigidBody *body : layer.body_pool) {
+		body->queue_free();
+	}
+	layer.body_pool.clear();
+}
+
+// Creates one pooled scene instance, on the main thread, within the time budget of VoxelEngine
+struct VoxelInstancer::PrewarmScenePoolTask : public ITimeSpreadTask {
+	void run(TimeSpreadTaskContext &ctx) override {
+		VoxelInstancer *instancer = instancer_ref.get();
+		if (instancer == nullptr) {
+			// The instancer was destroyed while the task was pending
+			return;
+		}
+		instancer->prewarm_scene_pool(layer_id, pool_version);
+	}
+
+	zylann::godot::ObjectWeakRef<VoxelInstancer> instancer_ref;
+	int layer_id;
+	uint32_t pool_version;
+};
+
+void VoxelInstancer::schedule_scene_pool_prewarm() {
+	_scene_pool_prewarm_pending = false;
+	if (_library.is_null()) {
+		return;
+	}
+
+	for (auto it = _layers.begin(); it != _layers.end(); ++it) {
+		const int layer_id = it->first;
+		const Layer &layer = it->second;
+
+		Ref<VoxelInstanceLibraryItem> item = _library->get_item(layer_id);
+		const VoxelInstanceLibrarySceneItem *scene_item = Object::cast_to<VoxelInstanceLibrarySceneItem>(*item);
+		if (scene_item == nullptr || scene_item->get_scene().is_null()) {
+			continue;
+		}
+
+		const unsigned int prewarm_count =
+				math::min(scene_item->get_pool_prewarm_count(), scene_item->get_pool_size());
+
+		// One task per instance, so they get spread according to the time budget like other main thread tasks
+		for (unsigned int i = layer.scene_pool.size(); i < prewarm_count; ++i) {
+			PrewarmScenePoolTask *task = ZN_NEW(PrewarmScenePoolTask);
+			task->instancer_ref.set(this);
+			task->layer_id = layer_id;
+			task->pool_version = layer.scene_pool_version;
+			// Instances that are needed now are more important, so this has lower priority
+			VoxelEngine::get_singleton().push_main_thread_time_spread_task(task, TimeSpreadTaskRunner::PRIORITY_LOW);
+		}
+	}
+}
+
+void VoxelInstancer::prewarm_scene_pool(int layer_id, uint32_t pool_version) {
+	ZN_PROFILE_SCOPE();
+
+	auto layer_it = _layers.find(layer_id);
+	if (layer_it == _layers.end()) {
+		return;
+	}
+	Layer &layer = layer_it->second;
+	if (layer.scene_pool_version != pool_version || _library.is_null()) {
+		// The pool was cleared since this was scheduled
+		return;
+	}
+
+	Ref<VoxelInstanceLibraryItem> item = _library->get_item(layer_id);
+	const VoxelInstanceLibrarySceneItem *scene_item = Object::cast_to<VoxelInstanceLibrarySceneItem>(*item);
+	if (scene_item == nullptr || scene_item->get_scene().is_null()) {
+		return;
+	}
+	const unsigned int prewarm_count =
+			math::min(scene_item->get_pool_prewarm_count(), scene_item->get_pool_size());
+	if (layer.scene_pool.size() >= prewarm_count) {
+		return;
+	}
+
+	PooledSceneInstance pooled;
+	if (!instantiate_scene(*scene_item, pooled.instance.root, pooled.instance.component)) {
+		return;
+	}
+	pooled.visible = pooled.instance.root->is_visible();
+	pooled.process_mode = pooled.instance.root->get_process_mode();
+	pooled.instance.root->set_visible(false);
+	pooled.instance.root->set_process_mode(Node::PROCESS_MODE_DISABLED);
+	add_child(pooled.instance.root);
+	layer.scene_pool.push_back(pooled);
+}
+
 unsigned int VoxelInstancer::create_block(
 		Layer &layer,
 		uint16_t layer_id,
@@ -1211,6 +2064,7 @@ unsigned int VoxelInstancer::create_block(
 	block->grid_position = grid_position;
 	block->pending_instances = pending_instances;
 	const unsigned int block_index = _blocks.size();
+	_block_mesh_lods.push_back(get_block_center(*block));
 	_blocks.push_back(std::move(block));
 #ifdef DEBUG_ENABLED
 	// The block must not already exist
@@ -1229,7 +2083,8 @@ void VoxelInstancer::update_block_from_transforms( //
 		uint16_t layer_id, //
 		World3D &world, //
 		const Transform3D &block_global_transform, //
-		Vector3 block_local_position //
+		Vector3 block_local_position, //
+		const PackedFloat32Array &multimesh_bulk_array //
 ) {
 	ZN_PROFILE_SCOPE();
 
@@ -1255,6 +2110,7 @@ void VoxelInstancer::update_block_from_transforms( //
 				block.multimesh_instance.set_multimesh(Ref<MultiMesh>());
 				block.multimesh_instance.destroy();
 			}
+			block.instance_positions.clear();
 
 		} else {
 			Ref<MultiMesh> multimesh = block.multimesh_instance.get_multimesh();
@@ -1267,7 +2123,12 @@ void VoxelInstancer::update_block_from_transforms( //
 				multimesh->set_visible_instance_count(-1);
 			}
 			PackedFloat32Array bulk_array;
-			zylann::godot::DirectMultiMeshInstance::make_transform_3d_bulk_array(transforms, bulk_array);
+			if (multimesh_bulk_array.size() == static_cast<int>(transforms.size() * 12)) {
+				// Already built by a threaded task
+				bulk_array = multimesh_bulk_array;
+			} else {
+				zylann::godot::DirectMultiMeshInstance::make_transform_3d_bulk_array(transforms, bulk_array);
+			}
 			multimesh->set_instance_count(transforms.size());
 
 			// Setting the mesh BEFORE `multimesh_set_buffer` because otherwise Godot computes the AABB inside
@@ -1284,6 +2145,16 @@ void VoxelInstancer::update_block_from_transforms( //
 			// multimesh->set_as_bulk_array(bulk_array);
 			RenderingServer::get_singleton()->multimesh_set_buffer(multimesh->get_rid(), bulk_array);
 
+			block.instance_positions.resize(transforms.size());
+			for (unsigned int instance_index = 0; instance_index < transforms.size(); ++instance_index) {
+				block.instance_positions[instance_index] = transforms[instance_index].origin;
+			}
+
+			if (item->get_merge_from_mesh_lod() > 0) {
+				// Shares the same data, it only gets copied if one of them changes
+				block.merge_bulk_array = bulk_array;
+			}
+
 			if (!block.multimesh_instance.is_valid()) {
 				block.multimesh_instance.create();
 				block.multimesh_instance.set_visible(
@@ -1308,66 +2179,59 @@ void VoxelInstancer::update_block_from_transforms( //
 			}
 		}
 
+		if (transforms.size() == 0) {
+			block.merge_bulk_array = PackedFloat32Array();
+		}
+		update_block_merging(block, *item);
+		_block_mesh_lods.invalidate(block_index);
+
 		// Update bodies
 		Span<const CollisionShapeInfo> collision_shapes = to_span(settings.collision_shapes);
 		if (collision_shapes.size() > 0) {
 			ZN_PROFILE_SCOPE_NAMED("Update multimesh bodies");
 
-			const int data_block_size_po2 = _parent_data_block_size_po2;
+			// Remove old bodies
+			for (unsigned int instance_index = transforms.size(); instance_index < block.bodies.size();
+				 ++instance_index) {
+				VoxelInstancerRigidBody *body = block.bodies[instance_index];
+				if (body != nullptr) {
+					release_body(layer, body);
+					--block.body_count;
+				}
+			}
+
+			block.bodies.resize(transforms.size(), nullptr);
+
+			const bool lazy_bodies = item->get_collision_distance() > 0.f;
+
+			if (lazy_bodies) {
+				// Bodies get created later near viewers, keep what they need
+				block.body_transforms.resize(transforms.size());
+				for (unsigned int instance_index = 0; instance_index < transforms.size(); ++instance_index) {
+					block.body_transforms[instance_index] = transforms[instance_index];
+				}
+			} else {
+				block.body_transforms.clear();
+			}
 
-			// Add new bodies
 			for (unsigned int instance_index = 0; instance_index < transforms.size(); ++instance_index) {
+				VoxelInstancerRigidBody *body = block.bodies[instance_index];
+				if (body == nullptr && lazy_bodies) {
+					continue;
+				}
+
 				const Transform3D local_transform = to_transform3(transforms[instance_index]);
 				// Bodies are child nodes of the instancer, so we use local block coordinates
 				const Transform3D body_transform(local_transform.basis, local_transform.origin + block_local_position);
 
-				VoxelInstancerRigidBody *body;
-
-				if (instance_index < static_cast<unsigned int>(block.bodies.size())) {
-					body = block.bodies[instance_index];
-
+				if (body != nullptr) {
+					body->set_transform(body_transform);
 				} else {
-					// TODO Performance: removing nodes from the tree is slow. It causes framerate stalls.
-					// See https://github.com/godotengine/godot/issues/61929
-					// Instances with collisions can lead to the creation of thousands of nodes. While this works in
-					// practice, removal proved to be very slow. Not because of physics, but because of an issue in the
-					// node system itself. A possible workaround is to either use servers directly, or put nodes as
-					// children of more nodes acting as buckets.
-					body = memnew(VoxelInstancerRigidBody);
-					body->attach(this);
-					body->set_instance_index(instance_index);
-					body->set_render_block_index(block_index);
-					body->set_data_block_position(math::floor_to_int(body_transform.origin) >> data_block_size_po2);
-					body->set_collision_layer(settings.collision_layer);
-					body->set_collision_mask(settings.collision_mask);
-
-					for (unsigned int i = 0; i < collision_shapes.size(); ++i) {
-						const CollisionShapeInfo &shape_info = collision_shapes[i];
-						CollisionShape3D *cs = memnew(CollisionShape3D);
-						cs->set_shape(shape_info.shape);
-						cs->set_transform(shape_info.transform);
-						body->add_child(cs);
-					}
-
-					for (const StringName &group_name : settings.group_names) {
-						body->add_to_group(group_name);
-					}
-
-					add_child(body);
-					block.bodies.push_back(body);
+					block.bodies[instance_index] =
+							create_body(layer, settings, block_index, instance_index, body_transform);
+					++block.body_count;
 				}
-
-				body->set_transform(body_transform);
-			}
-
-			// Remove old bodies
-			for (unsigned int instance_index = transforms.size(); instance_index < block.bodies.size();
-				 ++instance_index) {
-				VoxelInstancerRigidBody *body = block.bodies[instance_index];
-				body->detach_and_destroy();
 			}
-
-			block.bodies.resize(transforms.size());
 		}
 	}
 
@@ -1393,13 +2257,16 @@ void VoxelInstancer::update_block_from_transforms( //
 
 			SceneInstance instance;
 
-			if (instance_index < static_cast<unsigned int>(block.bodies.size())) {
+			if (instance_index < static_cast<unsigned int>(block.scene_instances.size())) {
 				instance = block.scene_instances[instance_index];
 				instance.root->set_transform(body_transform);
+				instance.component->set_data_block_position(
+						math::floor_to_int(body_transform.origin) >> data_block_size_po2
+				);
 
 			} else {
 				instance = create_scene_instance(
-						*scene_item, instance_index, block_index, body_transform, data_block_size_po2
+						*scene_item, layer, instance_index, block_index, body_transform, data_block_size_po2
 				);
 				ERR_CONTINUE(instance.root == nullptr);
 				block.scene_instances.push_back(instance);
@@ -1411,11 +2278,7 @@ void VoxelInstancer::update_block_from_transforms( //
 		// Remove old instances
 		for (unsigned int instance_index = transforms.size(); instance_index < block.scene_instances.size();
 			 ++instance_index) {
-			SceneInstance instance = block.scene_instances[instance_index];
-			ERR_CONTINUE(instance.component == nullptr);
-			instance.component->detach();
-			ERR_CONTINUE(instance.root == nullptr);
-			instance.root->queue_free();
+			release_scene_instance(layer, scene_item->get_pool_size(), block.scene_instances[instance_index]);
 		}
 
 		block.scene_instances.resize(transforms.size());
@@ -1628,15 +2491,15 @@ SaveBlockDataTask *VoxelInstancer::save_block(
 	if (cache_while_saving) {
 		Lod &lod_mutable = _lods[lod_index];
 		// Keep data in memory in case it quickly gets reloaded
-		// TODO Making a pre-emptive copy isn't very efficient, we could keep a shared_ptr instead?
-		UniquePtr<InstanceBlockData> saving_cache = make_unique_instance<InstanceBlockData>();
-		block_data->copy_to(*saving_cache);
+		StdVector<uint8_t> saving_cache;
+		ZN_ASSERT(serialize_instance_block_data(*block_data, saving_cache));
 		if (lod_mutable.quick_reload_cache == nullptr) {
 			lod_mutable.quick_reload_cache = make_shared_instance<InstancerQuickReloadingCache>();
 		}
 		{
 			MutexLock mlock(lod_mutable.quick_reload_cache->mutex);
 			lod_mutable.quick_reload_cache->map[data_grid_pos] = std::move(saving_cache);
+			lod_mutable.quick_reload_cache->stats.set_entries(lod_mutable.quick_reload_cache->map.size());
 		}
 	}
 
@@ -1647,11 +2510,26 @@ SaveBlockDataTask *VoxelInstancer::save_block(
 	return task;
 }
 
+namespace {
+
+// Copies the SDF of an edited area the first time it is needed, so instances can be checked with direct lookups
+// instead of querying voxel data one by one. Blocks without instances in the area don't need it.
+const VoxelBuffer &get_area_sdf(const VoxelData &voxel_data, const Box3i voxel_box, VoxelBuffer &area_sdf) {
+	if (area_sdf.get_size() != voxel_box.size) {
+		ZN_PROFILE_SCOPE();
+		area_sdf.create(voxel_box.size);
+		voxel_data.copy(voxel_box.position, area_sdf, 1 << VoxelBuffer::CHANNEL_SDF);
+	}
+	return area_sdf;
+}
+
+} // namespace
+
 void VoxelInstancer::remove_floating_multimesh_instances(
 		Block &block,
-		const Transform3D &parent_transform,
 		Box3i p_voxel_box,
-		const VoxelTool &voxel_tool,
+		const VoxelData &voxel_data,
+		VoxelBuffer &area_sdf,
 		int block_size_po2
 ) {
 	if (!block.multimesh_instance.is_valid()) {
@@ -1663,27 +2541,42 @@ void VoxelInstancer::remove_floating_multimesh_instances(
 	ERR_FAIL_COND(multimesh.is_null());
 
 	const int initial_instance_count = zylann::godot::get_visible_instance_count(**multimesh);
+	ERR_FAIL_COND(initial_instance_count != static_cast<int>(block.instance_positions.size()));
 	int instance_count = initial_instance_count;
 
-	const Transform3D block_global_transform =
-			Transform3D(parent_transform.basis, parent_transform.xform(block.grid_position << block_size_po2));
+	// Find instances inside the edited area, from positions we keep locally.
+	// Since positions are floored to get voxel coordinates, comparing them against the integer bounds of the box is
+	// equivalent.
+	const Vector3i block_origin = block.grid_position << block_size_po2;
+	const Vector3f local_min = to_vec3f(p_voxel_box.position - block_origin);
+	const Vector3f local_max = to_vec3f(p_voxel_box.position + p_voxel_box.size - block_origin);
+
+	static thread_local StdVector<unsigned int> tls_candidates;
+	StdVector<unsigned int> &candidates = tls_candidates;
+	candidates.clear();
+
+	for (unsigned int instance_index = 0; instance_index < block.instance_positions.size(); ++instance_index) {
+		const Vector3f pos = block.instance_positions[instance_index];
+		if (pos.x >= local_min.x && pos.y >= local_min.y && pos.z >= local_min.z && pos.x < local_max.x &&
+			pos.y < local_max.y && pos.z < local_max.z) {
+			candidates.push_back(instance_index);
+		}
+	}
 
-	// Let's check all instances one by one
-	// Note: the fact we have to query VisualServer in and out is pretty bad though.
-	// - We probably have to sync with its thread in MT mode
-	// - A hashmap RID lookup is performed to check `RID_Owner::id_map`
-	for (int instance_index = 0; instance_index < instance_count; ++instance_index) {
-		// TODO Optimize: This is terrible in MT mode! Think about keeping a local copy...
-		const Transform3D mm_transform = multimesh->get_instance_transform(instance_index);
-		const Vector3i voxel_pos(math::floor_to_int(mm_transform.origin + block_global_transform.origin));
+	if (candidates.size() == 0) {
+		return;
+	}
 
-		if (!p_voxel_box.contains(voxel_pos)) {
-			continue;
-		}
+	const VoxelBuffer &sdf_buffer = get_area_sdf(voxel_data, p_voxel_box, area_sdf);
+
+	// Going backwards, so removing an instance only moves another one that was already checked or is outside the area
+	for (auto it = candidates.rbegin(); it != candidates.rend(); ++it) {
+		const unsigned int instance_index = *it;
+		const Vector3i voxel_pos =
+				math::floor_to_int(block.instance_positions[instance_index]) + block_origin - p_voxel_box.position;
 
-		// TODO Optimize: use a transaction instead of random single queries
 		// 1-voxel cheap check without interpolation
-		const float sdf = voxel_tool.get_voxel_f(voxel_pos);
+		const float sdf = sdf_buffer.get_voxel_f(voxel_pos, VoxelBuffer::CHANNEL_SDF);
 		if (sdf < -0.0001f) {
 			// Still enough ground
 			continue;
@@ -1699,82 +2592,77 @@ void VoxelInstancer::remove_floating_multimesh_instances(
 		// uploading the whole buffer. Therefore even if we had our own cache to improve performance on our side while
 		// avoiding the *need* for Godot to have its own cache, we get little to no benefit from the Godot side.
 		multimesh->set_instance_transform(instance_index, last_trans);
+		block.instance_positions[instance_index] = block.instance_positions[last_instance_index];
+		if (block.merge_bulk_array.size() > 0) {
+			float *bulk = block.merge_bulk_array.ptrw();
+			for (unsigned int i = 0; i < 12; ++i) {
+				bulk[instance_index * 12 + i] = bulk[last_instance_index * 12 + i];
+			}
+		}
 
 		// Remove the body if this block has some
 		// TODO In the case of bodies, we could use an overlap check
 		if (block.bodies.size() > 0) {
 			VoxelInstancerRigidBody *rb = block.bodies[instance_index];
-			// Detach so it won't try to update our instances, we already do it here
-			rb->detach_and_destroy();
+			if (rb != nullptr) {
+				// Detach so it won't try to update our instances, we already do it here
+				rb->detach_and_destroy();
+				--block.body_count;
+			}
 
 			VoxelInstancerRigidBody *moved_rb = block.bodies[last_instance_index];
-			if (moved_rb != rb) {
+			if (moved_rb != nullptr && instance_index != static_cast<unsigned int>(last_instance_index)) {
 				moved_rb->set_instance_index(instance_index);
-				block.bodies[instance_index] = moved_rb;
 			}
-		}
-
-		--instance_index;
+			block.bodies[instance_index] = moved_rb;
 
-		// DEBUG
-		// Ref<CubeMesh> cm;
-		// cm.instance();
-		// cm->set_size(Vector3(0.5, 0.5, 0.5));
-		// MeshInstance *mi = memnew(MeshInstance);
-		// mi->set_mesh(cm);
-		// mi->set_transform(get_global_transform() *
-		// 				  (Transform(Basis(), (block_pos << layer->lod_index).to_vec3()) * t));
-		// add_child(mi);
+			if (block.body_transforms.size() > 0) {
+				block.body_transforms[instance_index] = block.body_transforms[last_instance_index];
+			}
+		}
 	}
 
 	if (instance_count < initial_instance_count) {
 		// According to the docs, set_instance_count() resets the array so we only hide them instead
 		multimesh->set_visible_instance_count(instance_count);
+		block.instance_positions.resize(instance_count);
+		if (block.merge_bulk_array.size() > 0) {
+			block.merge_bulk_array.resize(instance_count * 12);
+		}
 
 		if (block.bodies.size() > 0) {
 			block.bodies.resize(instance_count);
 		}
-
-		// Array args;
-		// args.push_back(instance_count);
-		// args.push_back(initial_instance_count);
-		// args.push_back(block_pos.to_vec3());
-		// args.push_back(layer->lod_index);
-		// args.push_back(multimesh->get_instance_count());
-		// print_line(
-		// 		String("Hiding instances from {0} to {1}. P: {2}, lod: {3}, total: {4}").format(args));
+		if (block.body_transforms.size() > 0) {
+			block.body_transforms.resize(instance_count);
+		}
 	}
 }
 
 void VoxelInstancer::remove_floating_scene_instances(
 		Block &block,
-		const Transform3D &parent_transform,
 		Box3i p_voxel_box,
-		const VoxelTool &voxel_tool,
-		int block_size_po2
+		const VoxelData &voxel_data,
+		VoxelBuffer &area_sdf
 ) {
 	const unsigned int initial_instance_count = block.scene_instances.size();
 	unsigned int instance_count = initial_instance_count;
 
-	const Transform3D block_global_transform =
-			Transform3D(parent_transform.basis, parent_transform.xform(block.grid_position << block_size_po2));
-
-	// Let's check all instances one by one
-	// Note: the fact we have to query VisualServer in and out is pretty bad though.
-	// - We probably have to sync with its thread in MT mode
-	// - A hashmap RID lookup is performed to check `RID_Owner::id_map`
+	// Scene instances can move on their own, so we check their current position. They are children of the instancer,
+	// so their transform is already in voxel coordinates.
 	for (unsigned int instance_index = 0; instance_index < instance_count; ++instance_index) {
 		SceneInstance instance = block.scene_instances[instance_index];
 		ERR_CONTINUE(instance.root == nullptr);
 		const Transform3D scene_transform = instance.root->get_transform();
-		const Vector3i voxel_pos(math::floor_to_int(scene_transform.origin + block_global_transform.origin));
+		const Vector3i voxel_pos(math::floor_to_int(scene_transform.origin));
 
 		if (!p_voxel_box.contains(voxel_pos)) {
 			continue;
 		}
 
 		// 1-voxel cheap check without interpolation
-		const float sdf = voxel_tool.get_voxel_f(voxel_pos);
+		const float sdf = get_area_sdf(voxel_data, p_voxel_box, area_sdf)
+								  .get_voxel_f(voxel_pos - p_voxel_box.position, VoxelBuffer::CHANNEL_SDF);
 		if (sdf < -0.1f) {
 			// Still enough ground
 			continue;
@@ -1817,12 +2705,23 @@ void VoxelInstancer::on_area_edited(Box3i p_voxel_box) {
 	const int render_block_size = 1 << _parent_mesh_block_size_po2;
 	const int data_block_size = 1 << _parent_data_block_size_po2;
 
-	Ref<VoxelTool> maybe_voxel_tool = _parent->get_voxel_tool();
-	ERR_FAIL_COND(maybe_voxel_tool.is_null());
-	VoxelTool &voxel_tool = **maybe_voxel_tool;
-	voxel_tool.set_channel(VoxelBuffer::CHANNEL_SDF);
+	std::shared_ptr<VoxelData> voxel_data;
+	{
+		VoxelLodTerrain *vlt = Object::cast_to<VoxelLodTerrain>(_parent);
+		if (vlt != nullptr) {
+			voxel_data = vlt->get_storage_shared();
+		} else {
+			VoxelTerrain *vt = Object::cast_to<VoxelTerrain>(_parent);
+			if (vt != nullptr) {
+				voxel_data = vt->get_storage_shared();
+			}
+		}
+	}
+	ERR_FAIL_COND(voxel_data == nullptr);
+
+	// SDF of the edited area. Copied only if some instances are found inside it, and then shared by all blocks.
+	VoxelBuffer area_sdf(VoxelBuffer::ALLOCATOR_POOL);
 
-	const Transform3D parent_transform = get_global_transform();
 	const int base_block_size_po2 = _parent_mesh_block_size_po2;
 
 	for (unsigned int lod_index = 0; lod_index < _lods.size(); ++lod_index) {
@@ -1839,11 +2738,14 @@ void VoxelInstancer::on_area_edited(Box3i p_voxel_box) {
 			const Layer &layer = get_layer(*layer_it);
 			const StdVector<UniquePtr<Block>> &blocks = _blocks;
 			const int block_size_po2 = base_block_size_po2 + layer.lod_index;
+			const VoxelData &voxel_data_ref = *voxel_data;
+
+			const VoxelInstanceLibraryMultiMeshItem *multimesh_item =
+					Object::cast_to<VoxelInstanceLibraryMultiMeshItem>(_library->get_item_const(*layer_it));
 
 			render_blocks_box.for_each_cell(
-					[layer, &blocks, &voxel_tool, p_voxel_box, parent_transform, block_size_po2, &lod, data_blocks_box](
-							Vector3i block_pos
-					) {
+					[this, &layer, &blocks, &voxel_data_ref, &area_sdf, p_voxel_box, block_size_po2, &lod,
+					 data_blocks_box, multimesh_item](Vector3i block_pos) {
 						const auto block_it = layer.blocks.find(block_pos);
 						if (block_it == layer.blocks.end()) {
 							// No instancing block here
@@ -1853,13 +2755,14 @@ void VoxelInstancer::on_area_edited(Box3i p_voxel_box) {
 						Block &block = *blocks[block_it->second];
 
 						if (block.scene_instances.size() > 0) {
-							remove_floating_scene_instances(
-									block, parent_transform, p_voxel_box, voxel_tool, block_size_po2
-							);
+							remove_floating_scene_instances(block, p_voxel_box, voxel_data_ref, area_sdf);
 						} else {
 							remove_floating_multimesh_instances(
-									block, parent_transform, p_voxel_box, voxel_tool, block_size_po2
+									block, p_voxel_box, voxel_data_ref, area_sdf, block_size_po2
 							);
+							if (block.merged && multimesh_item != nullptr) {
+								mark_merged_chunk_dirty(block, multimesh_item->get_merged_chunk_size_po2());
+							}
 						}
 
 						// All instances have to be frozen as edited.
@@ -1898,17 +2801,46 @@ void VoxelInstancer::on_body_removed(
 		const Transform3D last_trans = multimesh->get_instance_transform(visible_count);
 		multimesh->set_instance_transform(instance_index, last_trans);
 		multimesh->set_visible_instance_count(visible_count);
+
+		if (visible_count < static_cast<int>(block.instance_positions.size())) {
+			block.instance_positions[instance_index] = block.instance_positions[visible_count];
+			block.instance_positions.resize(visible_count);
+		}
+
+		if (block.merge_bulk_array.size() > 0) {
+			float *bulk = block.merge_bulk_array.ptrw();
+			for (unsigned int i = 0; i < 12; ++i) {
+				bulk[instance_index * 12 + i] = bulk[visible_count * 12 + i];
+			}
+			block.merge_bulk_array.resize(visible_count * 12);
+		}
+		if (block.merged) {
+			const VoxelInstanceLibraryMultiMeshItem *item =
+					Object::cast_to<VoxelInstanceLibraryMultiMeshItem>(_library->get_item_const(block.layer_id));
+			if (item != nullptr) {
+				mark_merged_chunk_dirty(block, item->get_merged_chunk_size_po2());
+			}
+		}
 	}
 
 	// Unregister the body
-	unsigned int body_count = block.bodies.size();
-	const unsigned int last_instance_index = --body_count;
+	unsigned int instance_count = block.bodies.size();
+	const unsigned int last_instance_index = --instance_count;
 	VoxelInstancerRigidBody *moved_body = block.bodies[last_instance_index];
 	if (instance_index != last_instance_index) {
-		moved_body->set_instance_index(instance_index);
+		if (moved_body != nullptr) {
+			moved_body->set_instance_index(instance_index);
+		}
 		block.bodies[instance_index] = moved_body;
+		if (block.body_transforms.size() > 0) {
+			block.body_transforms[instance_index] = block.body_transforms[last_instance_index];
+		}
 	}
-	block.bodies.resize(body_count);
+	block.bodies.resize(instance_count);
+	if (block.body_transforms.size() > 0) {
+		block.body_transforms.resize(instance_count);
+	}
+	--block.body_count;
 
 	// Mark data block as modified
 	const Layer &layer = get_layer(block.layer_id);
@@ -1958,11 +2890,13 @@ void VoxelInstancer::on_data_block_saved(Vector3i data_grid_position, unsigned i
 	if (lod.quick_reload_cache != nullptr) {
 		MutexLock mlock(lod.quick_reload_cache->mutex);
 		lod.quick_reload_cache->map.erase(data_grid_position);
+		lod.quick_reload_cache->stats.set_entries(lod.quick_reload_cache->map.size());
 	}
 }
 
 void VoxelInstancer::set_mesh_block_size_po2(unsigned int p_mesh_block_size_po2) {
 	_parent_mesh_block_size_po2 = p_mesh_block_size_po2;
+	reset_block_mesh_lods();
 }
 
 void VoxelInstancer::set_data_block_size_po2(unsigned int p_data_block_size_po2) {
@@ -2182,6 +3116,11 @@ void VoxelInstancer::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_up_mode", "mode"), &VoxelInstancer::set_up_mode);
 	ClassDB::bind_method(D_METHOD("get_up_mode"), &VoxelInstancer::get_up_mode);
 
+	ClassDB::bind_method(
+			D_METHOD("set_save_generated_instances", "enabled"), &VoxelInstancer::set_save_generated_instances
+	);
+	ClassDB::bind_method(D_METHOD("get_save_generated_instances"), &VoxelInstancer::get_save_generated_instances);
+
 	ClassDB::bind_method(D_METHOD("debug_get_block_count"), &VoxelInstancer::debug_get_block_count);
 	ClassDB::bind_method(D_METHOD("debug_get_instance_counts"), &VoxelInstancer::_b_debug_get_instance_counts);
 	ClassDB::bind_method(D_METHOD("debug_dump_as_scene", "fpath"), &VoxelInstancer::debug_dump_as_scene);
@@ -2200,6 +3139,11 @@ void VoxelInstancer::_bind_methods() {
 	ADD_PROPERTY(
 			PropertyInfo(Variant::INT, "up_mode", PROPERTY_HINT_ENUM, "PositiveY,Sphere"), "set_up_mode", "get_up_mode"
 	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "save_generated_instances"),
+			"set_save_generated_instances",
+			"get_save_generated_instances"
+	);
 
 	BIND_CONSTANT(MAX_LOD);
 
@@ -3,6 +3,7 @@
 
 #include "../../constants/voxel_constants.h"
 #include "../../streams/instance_data.h"
+#include "../../util/containers/container_funcs.h"
 #include "../../util/containers/fixed_array.h"
 #include "../../util/containers/std_unordered_map.h"
 #include "../../util/containers/std_unordered_set.h"
@@ -10,6 +11,7 @@
 #include "../../util/godot/classes/node_3d.h"
 #include "../../util/godot/direct_multimesh_instance.h"
 #include "../../util/math/box3i.h"
+#include "../../util/math/vector3f.h"
 #include "../../util/memory/memory.h"
 #include "instance_library_item_listener.h"
 #include "up_mode.h"
@@ -34,13 +36,16 @@ class VoxelInstancerRigidBody;
 class VoxelInstanceComponent;
 class VoxelInstanceLibrary;
 class VoxelInstanceLibraryItem;
+class VoxelInstanceLibraryMultiMeshItem;
 class VoxelInstanceLibrarySceneItem;
-class VoxelTool;
+class VoxelBuffer;
+class VoxelData;
 class SaveBlockDataTask;
 class BufferedTaskScheduler;
 struct InstanceBlockData;
 struct InstancerQuickReloadingCache;
 struct InstancerTaskOutputQueue;
+struct InstanceLoadingTaskOutput;
 struct InstanceLibraryMultiMeshItemSettings;
 
 // Note: a large part of this node could be made generic to support the sole idea of instancing within octants?
@@ -71,6 +76,11 @@ public:
 	void set_library(Ref<VoxelInstanceLibrary> library);
 	Ref<VoxelInstanceLibrary> get_library() const;
 
+	// If enabled, generated instances of persistent items are saved to the stream like edited ones, so they are
+	// loaded instead of being generated again next time.
+	void set_save_generated_instances(bool enabled);
+	bool get_save_generated_instances() const;
+
 	// Actions
 
 	void save_all_modified_blocks(
@@ -103,6 +113,19 @@ public:
 
 	int get_library_item_id_from_render_block_index(unsigned render_block_index) const;
 
+	// Marks data blocks covered by the results of an instance loading task for a mesh block. Edited octants are
+	// remembered so they are not generated again. If `save_generated` is true, other octants are marked modified so
+	// they get saved.
+	static void mark_task_output_data_blocks(
+			Vector3i render_block_position,
+			unsigned int mesh_block_size_po2,
+			unsigned int data_block_size_po2,
+			uint8_t edited_mask,
+			bool save_generated,
+			StdUnorderedSet<Vector3i> &edited_data_blocks,
+			StdUnorderedSet<Vector3i> &modified_blocks
+	);
+
 	// Debug
 
 	int debug_get_block_count() const;
@@ -141,7 +164,10 @@ private:
 
 	void process();
 	void process_task_results();
+	void apply_task_output(InstanceLoadingTaskOutput &output, World3D &world, const Transform3D &parent_transform);
 	void process_mesh_lods();
+	void process_merged_chunks();
+	void process_collision_bodies();
 
 	void add_layer(int layer_id, int lod_index);
 	void remove_layer(int layer_id);
@@ -179,14 +205,51 @@ private:
 		Node3D *root = nullptr;
 	};
 
+	struct PooledSceneInstance {
+		SceneInstance instance;
+		// State of the root before it got pooled, restored when it gets reused
+		bool visible;
+		Node::ProcessMode process_mode;
+	};
+
 	SceneInstance create_scene_instance(
 			const VoxelInstanceLibrarySceneItem &scene_item,
+			Layer &layer,
 			int instance_index,
 			unsigned int block_index,
 			Transform3D transform,
 			int data_block_size_po2
 	);
 
+	// Detaches a scene instance from its block, and either keeps it hidden in the pool of the layer or frees it
+	void release_scene_instance(Layer &layer, unsigned int pool_size, SceneInstance instance);
+	void clear_scene_pool(Layer &layer);
+	void schedule_scene_pool_prewarm();
+	void prewarm_scene_pool(int layer_id, uint32_t pool_version);
+
+	// Gets a collision body from the pool of the layer or creates one, for a multimesh instance
+	VoxelInstancerRigidBody *create_body(
+			Layer &layer,
+			const InstanceLibraryMultiMeshItemSettings &settings,
+			unsigned int block_index,
+			unsigned int instance_index,
+			const Transform3D &transform
+	);
+	// Detaches a collision body from its block, and either keeps it disabled in the pool of the layer or frees it
+	void release_body(Layer &layer, VoxelInstancerRigidBody *body);
+	void clear_body_pool(Layer &layer);
+	// Creates or releases bodies of a block depending on how far its instances are from viewers
+	void update_block_bodies_near_viewers(
+			unsigned int block_index,
+			Layer &layer,
+			const InstanceLibraryMultiMeshItemSettings &settings,
+			float collision_distance,
+			Span<const Vector3> viewer_positions
+	);
+
+	struct ApplyTaskOutputTask;
+	struct PrewarmScenePoolTask;
+
 	void update_block_from_transforms(
 			int block_index,
 			Span<const Transform3f> transforms,
@@ -196,7 +259,9 @@ private:
 			uint16_t layer_id,
 			World3D &world,
 			const Transform3D &block_transform,
-			Vector3 block_local_position
+			Vector3 block_local_position,
+			// May be empty, in which case it is built from `transforms`
+			const PackedFloat32Array &multimesh_bulk_array
 	);
 
 	void on_library_item_changed(int item_id, IInstanceLibraryItemListener::ChangeType change) override;
@@ -205,18 +270,17 @@ private:
 
 	static void remove_floating_multimesh_instances(
 			Block &block,
-			const Transform3D &parent_transform,
 			Box3i p_voxel_box,
-			const VoxelTool &voxel_tool,
+			const VoxelData &voxel_data,
+			VoxelBuffer &area_sdf,
 			int block_size_po2
 	);
 
 	static void remove_floating_scene_instances(
 			Block &block,
-			const Transform3D &parent_transform,
 			Box3i p_voxel_box,
-			const VoxelTool &voxel_tool,
-			int block_size_po2
+			const VoxelData &voxel_data,
+			VoxelBuffer &area_sdf
 	);
 
 	static void update_mesh_from_mesh_lod(
@@ -226,6 +290,15 @@ private:
 			bool instancer_is_visible
 	);
 
+	// Decides if a block should be drawn as part of a merged chunk, after its mesh LOD or instances changed
+	void update_block_merging(Block &block, const VoxelInstanceLibraryMultiMeshItem &item);
+	void mark_merged_chunk_dirty(const Block &block, unsigned int chunk_size_po2);
+	void clear_merged_chunks(Layer &layer);
+
+	Vector3f get_block_center(const Block &block) const;
+	// Recomputes centers of blocks and makes the next mesh LOD pass evaluate all of them
+	void reset_block_mesh_lods();
+
 	Dictionary _b_debug_get_instance_counts() const;
 
 	static void _bind_methods();
@@ -245,19 +318,51 @@ private:
 		// Position in mesh block coordinate system
 		Vector3i grid_position;
 		zylann::godot::DirectMultiMeshInstance multimesh_instance;
+		// Positions of multimesh instances relative to the block, in the same order as in the multimesh. Kept on our
+		// side so edits can find which instances they affect without reading back transforms from the RenderingServer.
+		StdVector<Vector3f> instance_positions;
+		// If true, instances of this block are drawn by the merged chunk containing it
+		bool merged = false;
+		// Copy of the MultiMesh buffer, only kept if the item merges blocks at long distances
+		PackedFloat32Array merge_bulk_array;
 		// For physics we use nodes because it's easier to manage.
 		// Such instances may be less numerous.
 		// If the item associated to this block has no collisions, this will be empty.
 		// Indices in the vector correspond to index of the instance in multimesh.
+		// If the item has a collision distance, entries are null for instances far from viewers.
 		StdVector<VoxelInstancerRigidBody *> bodies;
+		// How many entries of `bodies` are not null
+		unsigned int body_count = 0;
+		// Transforms of instances relative to the block, so bodies can be created later. Only kept if the item has a
+		// collision distance.
+		StdVector<Transform3f> body_transforms;
 		StdVector<SceneInstance> scene_instances;
 	};
 
+	// Group of blocks far enough to be drawn with a single MultiMesh, which reduces draw calls
+	struct MergedChunk {
+		zylann::godot::DirectMultiMeshInstance multimesh_instance;
+		// Incremented every time one of the blocks changes, so results of outdated merging tasks can be dropped
+		uint32_t version = 0;
+		// Mesh LOD the chunk was last scheduled with. The most detailed one of its blocks is used.
+		uint8_t mesh_lod = 0;
+		// If true, the chunk is in the list of chunks to merge again
+		bool dirty = false;
+	};
+
 	struct Layer {
 		unsigned int lod_index;
 		// Blocks indexed by grid position.
 		// Keys follow the mesh block coordinate system.
 		StdUnorderedMap<Vector3i, unsigned int> blocks;
+		// Hidden scene instances that blocks can reuse, if the layer uses a scene item
+		StdVector<PooledSceneInstance> scene_pool;
+		// Incremented when pooled instances become outdated, so pending prewarm tasks stop adding them
+		uint32_t scene_pool_version = 0;
+		// Merged chunks indexed by position, in blocks divided by the merged chunk size of the item
+		StdUnorderedMap<Vector3i, MergedChunk> merged_chunks;
+		// Disabled collision bodies that blocks can reuse, if the layer uses a multimesh item with collision shapes
+		StdVector<VoxelInstancerRigidBody *> body_pool;
 	};
 
 	struct MeshLodDistances {
@@ -299,11 +404,68 @@ private:
 	};
 
 	UpMode _up_mode = UP_MODE_POSITIVE_Y;
+	bool _save_generated_instances = false;
 
 	FixedArray<Lod, MAX_LOD> _lods;
 
+	// Data read by the mesh LOD pass, stored contiguously at the same indices as `_blocks` so the pass doesn't have to
+	// visit blocks scattered in memory every frame. The mesh LOD of a block only needs to be evaluated again when its
+	// distance to the camera leaves the range in which that LOD doesn't change.
+	struct BlockMeshLodArrays {
+		// Centers of blocks, in the local space of the instancer
+		StdVector<float> center_xs;
+		StdVector<float> center_ys;
+		StdVector<float> center_zs;
+		// Range of squared distances to the camera in which the current mesh LOD of each block remains the same
+		StdVector<float> min_distances_sq;
+		StdVector<float> max_distances_sq;
+
+		void push_back(Vector3f center) {
+			center_xs.push_back(center.x);
+			center_ys.push_back(center.y);
+			center_zs.push_back(center.z);
+			min_distances_sq.push_back(0.f);
+			max_distances_sq.push_back(0.f);
+			invalidate(min_distances_sq.size() - 1);
+		}
+
+		// Moves the last block to the given index, like `remove_block` does with `_blocks`
+		void remove_at_swap(unsigned int i) {
+			unordered_remove(center_xs, i);
+			unordered_remove(center_ys, i);
+			unordered_remove(center_zs, i);
+			unordered_remove(min_distances_sq, i);
+			unordered_remove(max_distances_sq, i);
+		}
+
+		void clear() {
+			center_xs.clear();
+			center_ys.clear();
+			center_zs.clear();
+			min_distances_sq.clear();
+			max_distances_sq.clear();
+		}
+
+		// Makes the next pass evaluate the mesh LOD of the block, whatever its distance is
+		void invalidate(unsigned int i) {
+			min_distances_sq[i] = std::numeric_limits<float>::max();
+			max_distances_sq[i] = 0.f;
+		}
+
+		void set_range(unsigned int i, float min_distance_sq, float max_distance_sq) {
+			min_distances_sq[i] = min_distance_sq;
+			max_distances_sq[i] = max_distance_sq;
+		}
+
+		// Makes passes skip the block until it gets invalidated, for blocks without mesh LODs
+		void set_range_infinite(unsigned int i) {
+			set_range(i, 0.f, std::numeric_limits<float>::max());
+		}
+	};
+
 	// Does not have nulls. Indices matter.
 	StdVector<UniquePtr<Block>> _blocks;
+	BlockMeshLodArrays _block_mesh_lods;
 
 	// Each layer corresponds to a library item. Addresses of values in the map are expected to be stable.
 	StdUnorderedMap<int, Layer> _layers;
@@ -317,8 +479,18 @@ private:
 	// Vector3 _mesh_lod_last_update_camera_position;
 	// float _mesh_lod_update_camera_threshold_distance = 8.f;
 	unsigned int _mesh_lod_time_sliced_block_index = 0;
+	unsigned int _collision_time_sliced_block_index = 0;
 
 	std::shared_ptr<InstancerTaskOutputQueue> _loading_results;
+	// Set when scene pools may need instances created ahead of time
+	bool _scene_pool_prewarm_pending = false;
+
+	struct DirtyMergedChunk {
+		uint16_t layer_id;
+		Vector3i position;
+	};
+
+	StdVector<DirtyMergedChunk> _dirty_merged_chunks;
 
 #ifdef TOOLS_ENABLED
 	zylann::godot::DebugRenderer _debug_renderer;
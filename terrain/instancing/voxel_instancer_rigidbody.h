@@ -29,6 +29,11 @@ public:
 		_parent = parent;
 	}
 
+	// Stops notifying the instancer, for when the body gets pooled
+	void detach() {
+		_parent = nullptr;
+	}
+
 	void detach_and_destroy() {
 		_parent = nullptr;
 		queue_free();
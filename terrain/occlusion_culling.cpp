@@ -0,0 +1,117 @@
+#include "occlusion_culling.h"
+#include "../util/errors.h"
+#include "../util/profiling.h"
+
+namespace zylann::voxel::occlusion_culling {
+
+uint16_t get_side_connectivity_from_sides_mask(uint8_t sides_mask) {
+	uint16_t connectivity = 0;
+	for (unsigned int side0 = 0; side0 < Cube::SIDE_COUNT; ++side0) {
+		if ((sides_mask & (1 << side0)) == 0) {
+			continue;
+		}
+		for (unsigned int side1 = side0 + 1; side1 < Cube::SIDE_COUNT; ++side1) {
+			if ((sides_mask & (1 << side1)) != 0) {
+				connectivity |= (1 << get_side_pair_index(side0, side1));
+			}
+		}
+	}
+	return connectivity;
+}
+
+namespace {
+
+inline uint8_t get_touched_sides_mask(const Vector3i pos, const Vector3i size) {
+	uint8_t mask = 0;
+	if (pos.x == 0) {
+		mask |= (1 << Cube::SIDE_NEGATIVE_X);
+	}
+	if (pos.x == size.x - 1) {
+		mask |= (1 << Cube::SIDE_POSITIVE_X);
+	}
+	if (pos.y == 0) {
+		mask |= (1 << Cube::SIDE_NEGATIVE_Y);
+	}
+	if (pos.y == size.y - 1) {
+		mask |= (1 << Cube::SIDE_POSITIVE_Y);
+	}
+	if (pos.z == 0) {
+		mask |= (1 << Cube::SIDE_NEGATIVE_Z);
+	}
+	if (pos.z == size.z - 1) {
+		mask |= (1 << Cube::SIDE_POSITIVE_Z);
+	}
+	return mask;
+}
+
+} // namespace
+
+uint16_t compute_side_connectivity(Span<const uint8_t> opaque_voxels, const Vector3i size) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(Vector3iUtil::get_volume_u64(size) == opaque_voxels.size(), SIDE_CONNECTIVITY_ALL);
+
+	static thread_local StdVector<uint8_t> tls_visited;
+	static thread_local StdVector<Vector3i> tls_stack;
+
+	StdVector<uint8_t> &visited = tls_visited;
+	visited.clear();
+	visited.resize(opaque_voxels.size(), 0);
+
+	StdVector<Vector3i> &stack = tls_stack;
+
+	uint16_t connectivity = 0;
+
+	// Flood-fill each region of non-opaque voxels touching the sides of the block, and connect all sides it touches.
+	// Regions that don't touch any side can't be seen from outside, so they don't matter.
+	Vector3i start_pos;
+	for (start_pos.z = 0; start_pos.z < size.z; ++start_pos.z) {
+		for (start_pos.x = 0; start_pos.x < size.x; ++start_pos.x) {
+			for (start_pos.y = 0; start_pos.y < size.y; ++start_pos.y) {
+				const unsigned int start_index = Vector3iUtil::get_zxy_index(start_pos, size);
+				if (opaque_voxels[start_index] != 0 || visited[start_index] != 0) {
+					continue;
+				}
+				if (get_touched_sides_mask(start_pos, size) == 0) {
+					continue;
+				}
+
+				uint8_t sides_mask = 0;
+				visited[start_index] = 1;
+				stack.clear();
+				stack.push_back(start_pos);
+
+				while (stack.size() > 0) {
+					const Vector3i pos = stack.back();
+					stack.pop_back();
+
+					sides_mask |= get_touched_sides_mask(pos, size);
+
+					for (unsigned int side = 0; side < Cube::SIDE_COUNT; ++side) {
+						const Vector3i npos = pos + Cube::g_side_normals[side];
+						if (npos.x < 0 || npos.y < 0 || npos.z < 0 || npos.x >= size.x || npos.y >= size.y ||
+							npos.z >= size.z) {
+							continue;
+						}
+						const unsigned int nindex = Vector3iUtil::get_zxy_index(npos, size);
+						if (opaque_voxels[nindex] != 0 || visited[nindex] != 0) {
+							continue;
+						}
+						visited[nindex] = 1;
+						stack.push_back(npos);
+					}
+				}
+
+				connectivity |= get_side_connectivity_from_sides_mask(sides_mask);
+
+				if (connectivity == SIDE_CONNECTIVITY_ALL) {
+					// Can't be more connected
+					return connectivity;
+				}
+			}
+		}
+	}
+
+	return connectivity;
+}
+
+} // namespace zylann::voxel::occlusion_culling
@@ -0,0 +1,128 @@
+#ifndef VOXEL_OCCLUSION_CULLING_H
+#define VOXEL_OCCLUSION_CULLING_H
+
+#include "../constants/cube_tables.h"
+#include "../util/containers/span.h"
+#include "../util/containers/std_unordered_set.h"
+#include "../util/containers/std_vector.h"
+#include "../util/math/box3i.h"
+
+// Occlusion culling of blocks based on which of their sides can see each other through non-opaque voxels, similar to
+// what Minecraft calls "cave culling". Each block stores one bit per pair of sides. Then a breadth-first traversal
+// starting from the block containing the camera only goes through sides that are connected inside the block it came
+// from. Blocks that can't be reached are hidden.
+// This is conservative for the most part (it never hides blocks that could be seen through the connectivity graph),
+// but doesn't account for the view frustum or narrow openings, so most blocks above ground remain visible.
+namespace zylann::voxel::occlusion_culling {
+
+// Sides use the `Cube::SideAxis` convention
+static constexpr unsigned int SIDE_PAIR_COUNT = 15;
+// All sides of a block see each other. This is the default when connectivity is not known.
+static constexpr uint16_t SIDE_CONNECTIVITY_ALL = (1 << SIDE_PAIR_COUNT) - 1;
+
+inline unsigned int get_opposite_side(unsigned int side) {
+	// Sides of the same axis are next to each other in `Cube::SideAxis`
+	return side ^ 1;
+}
+
+inline unsigned int get_side_pair_index(unsigned int side0, unsigned int side1) {
+	if (side0 > side1) {
+		std::swap(side0, side1);
+	}
+	// Pairs are ordered like (0,1), (0,2)...(0,5), (1,2)...(4,5)
+	return side0 * Cube::SIDE_COUNT - (side0 * (side0 + 1)) / 2 + (side1 - side0 - 1);
+}
+
+inline bool are_sides_connected(uint16_t connectivity, unsigned int side0, unsigned int side1) {
+	// A side is always connected to itself, since a path could come back out the same way
+	return side0 == side1 || (connectivity & (1 << get_side_pair_index(side0, side1))) != 0;
+}
+
+// Gets the connectivity of a block where all sides in the given mask are connected with each other
+uint16_t get_side_connectivity_from_sides_mask(uint8_t sides_mask);
+
+// Calculates which sides of a block can see each other through voxels that are not opaque.
+// `opaque_voxels` has one element per voxel in ZXY order, which is non-zero if the voxel is opaque.
+uint16_t compute_side_connectivity(Span<const uint8_t> opaque_voxels, const Vector3i size);
+
+// Finds which blocks may be visible from a camera located in `origin_block`. Blocks outside of `bounds` are not
+// traversed.
+// `get_connectivity(Vector3i position, uint16_t &out_connectivity)` must return false if there is no block at the
+// given position, in which case traversal will not go through it.
+// `visit(Vector3i position)` is called once for each potentially visible block.
+// Returns false if there is no block at `origin_block`, in which case nothing can be assumed to be hidden.
+template <typename FGetConnectivity, typename FVisit>
+bool find_visible_blocks(
+		const Vector3i origin_block,
+		const Box3i bounds,
+		FGetConnectivity get_connectivity,
+		FVisit visit,
+		StdVector<Vector3i> &queue_positions,
+		StdVector<uint16_t> &queue_states,
+		StdUnorderedSet<Vector3i> &visited
+) {
+	// Each queued block stores the side it was entered from in the lower byte, and the directions taken so far to
+	// reach it in the upper byte. Paths never go back in a direction opposite to one they already took, otherwise they
+	// could wrap around walls and reach every block.
+	static constexpr uint16_t NO_ENTRY_SIDE = 0xff;
+
+	queue_positions.clear();
+	queue_states.clear();
+	visited.clear();
+
+	uint16_t origin_connectivity;
+	if (!get_connectivity(origin_block, origin_connectivity)) {
+		return false;
+	}
+
+	queue_positions.push_back(origin_block);
+	queue_states.push_back(NO_ENTRY_SIDE);
+	visited.insert(origin_block);
+	visit(origin_block);
+
+	for (unsigned int queue_index = 0; queue_index < queue_positions.size(); ++queue_index) {
+		const Vector3i position = queue_positions[queue_index];
+		const uint16_t state = queue_states[queue_index];
+		const unsigned int entry_side = state & 0xff;
+		const uint8_t directions = state >> 8;
+
+		uint16_t connectivity;
+		get_connectivity(position, connectivity);
+
+		for (unsigned int side = 0; side < Cube::SIDE_COUNT; ++side) {
+			const unsigned int opposite_side = get_opposite_side(side);
+
+			if ((directions & (1 << opposite_side)) != 0) {
+				continue;
+			}
+			if (entry_side != NO_ENTRY_SIDE && !are_sides_connected(connectivity, entry_side, side)) {
+				continue;
+			}
+
+			const Vector3i neighbor_position = position + Cube::g_side_normals[side];
+
+			if (!bounds.contains(neighbor_position)) {
+				continue;
+			}
+			if (visited.find(neighbor_position) != visited.end()) {
+				continue;
+			}
+			uint16_t neighbor_connectivity;
+			if (!get_connectivity(neighbor_position, neighbor_connectivity)) {
+				continue;
+			}
+
+			visited.insert(neighbor_position);
+			visit(neighbor_position);
+
+			queue_positions.push_back(neighbor_position);
+			queue_states.push_back(opposite_side | (uint16_t(directions | (1 << side)) << 8));
+		}
+	}
+
+	return true;
+}
+
+} // namespace zylann::voxel::occlusion_culling
+
+#endif // VOXEL_OCCLUSION_CULLING_H
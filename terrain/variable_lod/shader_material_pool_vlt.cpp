@@ -1,14 +1,40 @@
 #include "shader_material_pool_vlt.h"
 #include "../../constants/voxel_string_names.h"
+#include "../../util/godot/classes/shader.h"
 #include "../../util/godot/classes/texture_2d.h"
 #include "../../util/profiling.h"
 
 namespace zylann::voxel {
 
+void ShaderMaterialPoolVLT::set_template(Ref<ShaderMaterial> tpl) {
+	zylann::godot::ShaderMaterialPool::set_template(tpl);
+
+	_shared_material.unref();
+
+	if (tpl.is_valid()) {
+		Ref<Shader> shader = tpl->get_shader();
+		if (shader.is_valid() &&
+			zylann::godot::shader_has_instance_uniform(**shader, VoxelStringNames::get_singleton().u_transition_mask)) {
+			_shared_material = allocate();
+		}
+	}
+}
+
+Ref<ShaderMaterial> ShaderMaterialPoolVLT::allocate_for_block() {
+	if (_shared_material.is_valid()) {
+		return _shared_material;
+	}
+	return allocate();
+}
+
 void ShaderMaterialPoolVLT::recycle(Ref<ShaderMaterial> material) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT_RETURN(material.is_valid());
 
+	if (material == _shared_material) {
+		return;
+	}
+
 	const VoxelStringNames &sn = VoxelStringNames::get_singleton();
 
 	// Reset textures to avoid hoarding them in the pool
@@ -20,8 +46,11 @@ void ShaderMaterialPoolVLT::recycle(Ref<ShaderMaterial> material) {
 	material->set_shader_parameter(sn.u_voxel_cell_size, 0.f);
 	material->set_shader_parameter(sn.u_voxel_virtual_texture_fade, 0.f);
 
-	material->set_shader_parameter(sn.u_transition_mask, 0);
-	material->set_shader_parameter(sn.u_lod_fade, Vector2(0.0, 0.0));
+	// With instance uniforms, these are set on mesh instances instead
+	if (_shared_material.is_null()) {
+		material->set_shader_parameter(sn.u_transition_mask, 0);
+		material->set_shader_parameter(sn.u_lod_fade, Vector2(0.0, 0.0));
+	}
 
 	zylann::godot::ShaderMaterialPool::recycle(material);
 }
@@ -7,7 +7,28 @@ namespace zylann::voxel {
 
 class ShaderMaterialPoolVLT : public zylann::godot::ShaderMaterialPool {
 public:
+	void set_template(Ref<ShaderMaterial> tpl);
+
+	// If the shader declares `u_transition_mask` as an `instance uniform`, per-block parameters (transition mask, LOD
+	// fade, block transform and LOD info) are set on mesh instances instead of materials. Then all blocks can share
+	// the same material, unless they need one of their own for detail textures, which can't be per-instance.
+	inline bool is_using_instance_uniforms() const {
+		return _shared_material.is_valid();
+	}
+
+	// Only available when instance uniforms are used
+	inline Ref<ShaderMaterial> get_shared_material() const {
+		return _shared_material;
+	}
+
+	// Gets a material for a new block: the shared one if possible, otherwise a material from the pool
+	Ref<ShaderMaterial> allocate_for_block();
+
+	// The shared material is ignored
 	void recycle(Ref<ShaderMaterial> material);
+
+private:
+	Ref<ShaderMaterial> _shared_material;
 };
 
 } // namespace zylann::voxel
@@ -9,6 +9,7 @@
 #include "../../meshers/transvoxel/voxel_mesher_transvoxel.h"
 #include "../../storage/voxel_buffer_gd.h"
 #include "../../streams/load_all_blocks_data_task.h"
+#include "../../streams/save_block_data_task.h"
 #include "../../util/containers/container_funcs.h"
 #include "../../util/containers/std_unordered_set.h"
 #include "../../util/godot/classes/base_material_3d.h" // For property hint in release mode in GDExtension...
@@ -27,6 +28,7 @@
 #include "../../util/godot/core/string.h"
 #include "../../util/math/color.h"
 #include "../../util/math/conv.h"
+#include "../../util/memory/linear_allocator.h"
 #include "../../util/profiling.h"
 #include "../../util/profiling_clock.h"
 #include "../../util/string/format.h"
@@ -118,6 +120,8 @@ VoxelLodTerrain::VoxelLodTerrain() {
 	_streaming_dependency = make_shared_instance<StreamingDependency>();
 	_meshing_dependency = make_shared_instance<MeshingDependency>();
 
+	fill(_requested_lod_mesh_block_size_po2, uint8_t(0));
+
 	set_notify_transform(true);
 
 	// Doing this to setup the defaults
@@ -131,27 +135,42 @@ VoxelLodTerrain::VoxelLodTerrain() {
 	// because this kind of task scheduling would otherwise delay the update by 1 frame
 	VoxelEngine::VolumeCallbacks callbacks;
 	callbacks.data = this;
-	callbacks.mesh_output_callback = [](void *cb_data, VoxelEngine::BlockMeshOutput &ob) {
+	callbacks.mesh_outputs_callback = [](void *cb_data, Span<VoxelEngine::BlockMeshOutput> outputs) {
 		VoxelLodTerrain *self = reinterpret_cast<VoxelLodTerrain *>(cb_data);
-		ApplyMeshUpdateTask *task = ZN_NEW(ApplyMeshUpdateTask);
-		task->volume_id = self->get_volume_id();
-		task->self = self;
-		task->data = std::move(ob);
-		VoxelEngine::get_singleton().push_main_thread_time_spread_task(task);
-
-		// If two tasks are queued for the same mesh, cancel the old ones.
-		// This is for cases where creating the mesh is slower than the speed at which it is generated,
-		// which can cause a buildup that never seems to stop.
-		// This is at the expense of holes appearing until all tasks are done.
-		StdUnorderedMap<Vector3i, RefCount> &queued_tasks_in_lod = self->_queued_main_thread_mesh_updates[ob.lod];
-		auto p = queued_tasks_in_lod.insert({ ob.position, RefCount(1) });
-		if (!p.second) {
-			p.first->second.add();
+		VoxelEngine &engine = VoxelEngine::get_singleton();
+		const Transform3D transform = self->get_global_transform();
+
+		for (VoxelEngine::BlockMeshOutput &ob : outputs) {
+			// Read before the output is moved
+			const Vector3i position = ob.position;
+			const uint8_t lod_index = ob.lod;
+
+			ApplyMeshUpdateTask *task = ZN_NEW(ApplyMeshUpdateTask);
+			task->volume_id = self->get_volume_id();
+			task->self = self;
+			const int block_size = self->get_lod_mesh_block_size(lod_index) << lod_index;
+			const Vector3 block_center = to_vec3(position * block_size) + Vector3(0.5f, 0.5f, 0.5f) * block_size;
+			task->viewer_distance_squared = engine.get_closest_viewer_distance_squared(transform.xform(block_center));
+			task->data = std::move(ob);
+			engine.push_main_thread_time_spread_task(task);
+
+			// If two tasks are queued for the same mesh, cancel the old ones.
+			// This is for cases where creating the mesh is slower than the speed at which it is generated,
+			// which can cause a buildup that never seems to stop.
+			// This is at the expense of holes appearing until all tasks are done.
+			StdUnorderedMap<Vector3i, RefCount> &queued_tasks_in_lod =
+					self->_queued_main_thread_mesh_updates[lod_index];
+			auto p = queued_tasks_in_lod.insert({ position, RefCount(1) });
+			if (!p.second) {
+				p.first->second.add();
+			}
 		}
 	};
-	callbacks.data_output_callback = [](void *cb_data, VoxelEngine::BlockDataOutput &ob) {
+	callbacks.data_outputs_callback = [](void *cb_data, Span<VoxelEngine::BlockDataOutput> outputs) {
 		VoxelLodTerrain *self = reinterpret_cast<VoxelLodTerrain *>(cb_data);
-		self->apply_data_block_response(ob);
+		for (VoxelEngine::BlockDataOutput &ob : outputs) {
+			self->apply_data_block_response(ob);
+		}
 	};
 	callbacks.detail_texture_output_callback = [](void *cb_data, VoxelEngine::BlockDetailTextureOutput &ob) {
 		VoxelLodTerrain *self = reinterpret_cast<VoxelLodTerrain *>(cb_data);
@@ -159,6 +178,7 @@ VoxelLodTerrain::VoxelLodTerrain() {
 	};
 
 	_volume_id = VoxelEngine::get_singleton().add_volume(callbacks);
+	VoxelEngine::get_singleton().set_volume_voxel_data(_volume_id, _data);
 	// VoxelEngine::get_singleton().set_volume_octree_lod_distance(_volume_id, get_lod_distance());
 
 	// TODO Being able to set a LOD smaller than the stream is probably a bad idea,
@@ -172,6 +192,7 @@ VoxelLodTerrain::VoxelLodTerrain() {
 VoxelLodTerrain::~VoxelLodTerrain() {
 	ZN_PRINT_VERBOSE("Destroy VoxelLodTerrain");
 	abort_async_edits();
+	abort_pre_generations();
 	_streaming_dependency->valid = false;
 	_meshing_dependency->valid = false;
 	VoxelEngine::get_singleton().remove_volume(_volume_id);
@@ -218,8 +239,13 @@ void VoxelLodTerrain::set_material(Ref<Material> p_material) {
 
 	{
 		// Detect presence of lod_index usage in the shader
+		const StringName &u_voxel_lod_info = VoxelStringNames::get_singleton().u_voxel_lod_info;
 		Span<const StringName> uniforms = _shader_material_pool.get_cached_shader_uniforms();
-		_material_uses_lod_info = contains(uniforms, VoxelStringNames::get_singleton().u_voxel_lod_info);
+		_material_uses_lod_info = contains(uniforms, u_voxel_lod_info);
+		if (!_material_uses_lod_info && _shader_material_pool.is_using_instance_uniforms()) {
+			Ref<Shader> shader = _shader_material_pool.get_template()->get_shader();
+			_material_uses_lod_info = zylann::godot::shader_has_instance_uniform(**shader, u_voxel_lod_info);
+		}
 	}
 
 	// TODO Update when shader changes?
@@ -235,21 +261,24 @@ void VoxelLodTerrain::set_material(Ref<Material> p_material) {
 					// No visuals loaded (collision only?)
 					return;
 				}
-				Ref<ShaderMaterial> sm = _shader_material_pool.allocate();
 				Ref<ShaderMaterial> prev_material = block.get_shader_material();
-				if (prev_material.is_valid()) {
-					ZN_ASSERT_RETURN(sm.is_valid());
+				// Blocks with detail textures need their own material
+				const bool needs_own_material = prev_material.is_valid() &&
+						prev_material->get_shader_parameter(VoxelStringNames::get_singleton().u_voxel_cell_lookup) !=
+								Variant();
+				Ref<ShaderMaterial> sm = needs_own_material ? _shader_material_pool.allocate()
+															: _shader_material_pool.allocate_for_block();
+				ZN_ASSERT_RETURN(sm.is_valid());
+				if (prev_material.is_valid() && sm != _shader_material_pool.get_shared_material()) {
 					// Each block can have specific shader parameters so we have to keep them
 					copy_vlt_block_params(**prev_material, **sm);
 				}
+				block.set_shader_instance_uniforms_enabled(_shader_material_pool.is_using_instance_uniforms());
+				block.set_shader_material(sm);
 				// Do after copy, because otherwise it would be overwritten by default value
 				if (_material_uses_lod_info) {
-					sm->set_shader_parameter(
-							VoxelStringNames::get_singleton().u_voxel_lod_info,
-							encode_lod_info_for_shader_uniform(lod_index, lod_count)
-					);
+					block.set_shader_lod_info(encode_lod_info_for_shader_uniform(lod_index, lod_count));
 				}
-				block.set_shader_material(sm);
 			});
 		}
 
@@ -285,6 +314,100 @@ unsigned int VoxelLodTerrain::get_mesh_block_size() const {
 	return 1 << _update_data->settings.mesh_block_size_po2;
 }
 
+unsigned int VoxelLodTerrain::get_lod_mesh_block_size_pow2(unsigned int lod_index) const {
+	ZN_ASSERT_RETURN_V(lod_index < constants::MAX_LOD, get_mesh_block_size_pow2());
+	return _update_data->settings.get_lod_mesh_block_size_po2(lod_index);
+}
+
+unsigned int VoxelLodTerrain::get_lod_mesh_block_size(unsigned int lod_index) const {
+	return 1 << get_lod_mesh_block_size_pow2(lod_index);
+}
+
+void VoxelLodTerrain::set_lod_mesh_block_sizes(PackedInt32Array sizes) {
+	Span<const int32_t> sizes_s = to_span(sizes);
+	ERR_FAIL_COND_MSG(sizes_s.size() > constants::MAX_LOD, "Too many sizes");
+
+	for (unsigned int lod_index = 0; lod_index < _requested_lod_mesh_block_size_po2.size(); ++lod_index) {
+		uint8_t po2 = 0;
+		if (lod_index < sizes_s.size()) {
+			const int32_t size = sizes_s[lod_index];
+			if (size > 0) {
+				ERR_FAIL_COND_MSG(!math::is_power_of_two(size), "Mesh block sizes must be powers of two");
+				po2 = math::get_shift_from_power_of_two_32(size);
+			}
+		}
+		_requested_lod_mesh_block_size_po2[lod_index] = po2;
+	}
+
+	update_lod_mesh_block_sizes(are_lod_mesh_block_sizes_supported());
+	update_configuration_warnings();
+}
+
+PackedInt32Array VoxelLodTerrain::get_lod_mesh_block_sizes() const {
+	// Only return up to the last non-default size, so the property stays empty by default
+	unsigned int count = 0;
+	for (unsigned int lod_index = 0; lod_index < _requested_lod_mesh_block_size_po2.size(); ++lod_index) {
+		if (_requested_lod_mesh_block_size_po2[lod_index] != 0) {
+			count = lod_index + 1;
+		}
+	}
+	PackedInt32Array sizes;
+	sizes.resize(count);
+	for (unsigned int lod_index = 0; lod_index < count; ++lod_index) {
+		const uint8_t po2 = _requested_lod_mesh_block_size_po2[lod_index];
+		sizes.set(lod_index, po2 == 0 ? 0 : (1 << po2));
+	}
+	return sizes;
+}
+
+bool VoxelLodTerrain::are_lod_mesh_block_sizes_supported() const {
+	// Octree streaming assumes a fixed subdivision of mesh blocks, and the instancer assumes mesh blocks have the same
+	// size at every LOD
+	return _update_data->settings.streaming_system == VoxelLodTerrainUpdateData::STREAMING_SYSTEM_CLIPBOX &&
+			_instancer == nullptr;
+}
+
+void VoxelLodTerrain::update_lod_mesh_block_sizes(bool allow_non_uniform) {
+	const VoxelLodTerrainUpdateData::Settings &settings = _update_data->settings;
+
+	FixedArray<uint8_t, constants::MAX_LOD> sizes;
+	fill(sizes, uint8_t(settings.mesh_block_size_po2));
+
+	if (allow_non_uniform) {
+		const unsigned int data_block_size_po2 = get_data_block_size_pow2();
+		unsigned int prev_po2 = settings.mesh_block_size_po2;
+
+		for (unsigned int lod_index = 0; lod_index < sizes.size(); ++lod_index) {
+			unsigned int po2 = _requested_lod_mesh_block_size_po2[lod_index];
+			if (po2 == 0) {
+				po2 = prev_po2;
+			}
+			if (lod_index == 0) {
+				po2 = math::clamp(po2, data_block_size_po2, constants::MAX_LOD_MESH_BLOCK_SIZE_PO2);
+			} else {
+				// Sizes can't decrease, and can at most double from one LOD to the next, so a parent mesh block
+				// always covers either 2x2x2 or 4x4x4 child mesh blocks
+				po2 = math::clamp(po2, prev_po2, math::min(prev_po2 + 1, constants::MAX_LOD_MESH_BLOCK_SIZE_PO2));
+			}
+			sizes[lod_index] = po2;
+			prev_po2 = po2;
+		}
+	}
+
+	if (sizes == settings.lod_mesh_block_size_po2) {
+		return;
+	}
+
+	reset_mesh_maps();
+
+	//_update_data->wait_for_end_of_task(); // Done by reset_mesh_maps()
+	ZN_ASSERT(_update_data->task_is_complete);
+	_update_data->settings.lod_mesh_block_size_po2 = sizes;
+
+	// Larger blocks at the last LOD make the octree bigger
+	set_voxel_bounds(_data->get_bounds());
+}
+
 void VoxelLodTerrain::set_stream(Ref<VoxelStream> p_stream) {
 	if (p_stream == get_stream()) {
 		return;
@@ -373,7 +496,34 @@ void VoxelLodTerrain::_on_render_layers_mask_changed() {
 	}
 }
 
+Ref<ShaderMaterial> VoxelLodTerrain::copy_block_shader_material_for_fading(Ref<ShaderMaterial> block_material) {
+	if (block_material == _shader_material_pool.get_shared_material()) {
+		// Per-block parameters are on mesh instances, the material doesn't change
+		return block_material;
+	}
+	Ref<ShaderMaterial> material = _shader_material_pool.allocate();
+	ZN_ASSERT(material.is_valid());
+	zylann::godot::copy_shader_params(
+			**block_material, **material, _shader_material_pool.get_cached_shader_uniforms()
+	);
+	return material;
+}
+
+Ref<ShaderMaterial> VoxelLodTerrain::get_or_create_own_shader_material(VoxelMeshBlockVLT &block) {
+	Ref<ShaderMaterial> material = block.get_shader_material();
+	if (material.is_valid() && material == _shader_material_pool.get_shared_material()) {
+		// Detail textures can't be per-instance uniforms, so the block can't keep using the shared material
+		material = _shader_material_pool.allocate();
+		block.set_shader_material(material);
+	}
+	return material;
+}
+
 void VoxelLodTerrain::update_shader_material_pool_template() {
+	if (VoxelEngine::get_singleton().is_server_mode()) {
+		// Nothing is rendered, so the pool never gets a template and never allocates materials
+		return;
+	}
 	Ref<ShaderMaterial> shader_material = _material;
 	if (_material.is_null() && _mesher.is_valid()) {
 		shader_material = _mesher->get_default_lod_material();
@@ -410,6 +560,9 @@ void VoxelLodTerrain::_on_stream_params_changed() {
 	stop_streamer();
 	stop_updater();
 
+	// The generator may have changed, so detail textures must be rendered again
+	_update_data->detail_texture_tile_cache->clear();
+
 	Ref<VoxelStream> stream = get_stream();
 
 	if (stream.is_valid()) {
@@ -446,6 +599,9 @@ void VoxelLodTerrain::_on_stream_params_changed() {
 	_update_data->wait_for_end_of_task();
 	_update_data->state.octree_streaming.force_update_octrees_next_update = true;
 
+	// Heights may come from a different generator now
+	_horizon.clear();
+
 	// The whole map might change, so make all area dirty
 	const unsigned int lod_count = get_lod_count();
 	for (unsigned int i = 0; i < lod_count; ++i) {
@@ -492,6 +648,8 @@ void VoxelLodTerrain::set_mesh_block_size(unsigned int mesh_block_size) {
 		_instancer->set_mesh_block_size_po2(mesh_block_size);
 	}
 
+	update_lod_mesh_block_sizes(are_lod_mesh_block_sizes_supported());
+
 	// Update voxel bounds because block size change can affect octree size
 	set_voxel_bounds(_data->get_bounds());
 }
@@ -511,6 +669,10 @@ bool VoxelLodTerrain::is_full_load_mode_enabled() const {
 	return !_data->is_streaming_enabled();
 }
 
+float VoxelLodTerrain::get_full_load_progress() const {
+	return _data->get_full_load_progress();
+}
+
 void VoxelLodTerrain::set_threaded_update_enabled(bool enabled) {
 	if (enabled != _threaded_update_enabled) {
 		if (_threaded_update_enabled) {
@@ -546,19 +708,13 @@ void VoxelLodTerrain::set_mesh_block_visual_active(
 
 			_fading_blocks_per_lod[lod_index].erase(block.position);
 
-			Ref<ShaderMaterial> mat = block.get_shader_material();
-			if (mat.is_valid()) {
-				mat->set_shader_parameter(VoxelStringNames::get_singleton().u_lod_fade, Vector2(0.0, 0.0));
-			}
+			block.set_shader_lod_fade(Vector2(0.0, 0.0));
 
 		} else if (active && _lod_fade_duration > 0.f) {
 			// WHen LOD fade is enabled, it is possible that a block is disabled with a fade out, but later has to be
 			// enabled without a fade-in (because behind the camera for example). In this case we have to reset the
 			// parameter. Otherwise, it would be active but invisible due to still being faded out.
-			Ref<ShaderMaterial> mat = block.get_shader_material();
-			if (mat.is_valid()) {
-				mat->set_shader_parameter(VoxelStringNames::get_singleton().u_lod_fade, Vector2(0.0, 0.0));
-			}
+			block.set_shader_lod_fade(Vector2(0.0, 0.0));
 		}
 
 		return;
@@ -615,6 +771,8 @@ void VoxelLodTerrain::post_edit_modifiers(Box3i p_voxel_box) {
 	_data->clear_cached_blocks_in_voxel_area(p_voxel_box);
 	// Not sure if it is worth re-caching these blocks. We may see about that in the future if performance is an issue.
 
+	_update_data->detail_texture_tile_cache->invalidate_area(p_voxel_box);
+
 	MutexLock lock(_update_data->state.changed_generated_areas_mutex);
 	_update_data->state.changed_generated_areas.push_back(p_voxel_box);
 
@@ -625,7 +783,12 @@ void VoxelLodTerrain::post_edit_modifiers(Box3i p_voxel_box) {
 #endif
 }
 
-void VoxelLodTerrain::push_async_edit(IThreadedTask *task, Box3i box, std::shared_ptr<AsyncDependencyTracker> tracker) {
+void VoxelLodTerrain::push_async_edit(
+		IThreadedTask *task,
+		Box3i box,
+		std::shared_ptr<AsyncDependencyTracker> tracker,
+		uint32_t batch_id
+) {
 	CRASH_COND(task == nullptr);
 	CRASH_COND(tracker == nullptr);
 
@@ -633,12 +796,50 @@ void VoxelLodTerrain::push_async_edit(IThreadedTask *task, Box3i box, std::share
 	e.box = box;
 	e.task = task;
 	e.task_tracker = tracker;
+	e.batch_id = batch_id;
 
 	VoxelLodTerrainUpdateData::State &state = _update_data->state;
 	MutexLock lock(state.pending_async_edits_mutex);
 	state.pending_async_edits.push_back(e);
 }
 
+uint32_t VoxelLodTerrain::push_async_edit_op(UniquePtr<IAsyncEditOp> op) {
+	return _async_edit_queue.push(std::move(op));
+}
+
+void VoxelLodTerrain::flush_async_edit_queue() {
+	if (_async_edit_queue.is_empty()) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	StdVector<AsyncEditQueue::Group> groups;
+	const uint32_t batch_id = _async_edit_queue.flush(groups);
+
+	if (groups.size() == 0) {
+		// All edits were empty
+		emit_signal(VoxelStringNames::get_singleton().async_edit_batch_completed, batch_id);
+		return;
+	}
+
+	// Groups of a batch share the same tracker, so they all complete at the same time from the terrain's point of view
+	std::shared_ptr<AsyncDependencyTracker> tracker = make_shared_instance<AsyncDependencyTracker>(groups.size());
+
+	// Blocks edits need are generated on the GPU along with other blocks, if the shader is ready
+	bool use_gpu = false;
+	if (get_generator_use_gpu()) {
+		Ref<VoxelGenerator> generator = get_generator();
+		use_gpu = generator.is_valid() && generator->supports_shaders() &&
+				generator->get_block_rendering_shader() != nullptr;
+	}
+
+	for (AsyncEditQueue::Group &group : groups) {
+		const Box3i box = group.box;
+		AsyncEditGroupTask *task = ZN_NEW(AsyncEditGroupTask(std::move(group), _data, tracker, use_gpu));
+		push_async_edit(task, box, tracker, batch_id);
+	}
+}
+
 Ref<VoxelTool> VoxelLodTerrain::get_voxel_tool() {
 	VoxelToolLodTerrain *vt = memnew(VoxelToolLodTerrain(this));
 	// Set to most commonly used channel on this kind of terrain
@@ -714,6 +915,7 @@ void VoxelLodTerrain::start_streamer() {
 			ZN_ASSERT(_streaming_dependency != nullptr);
 
 			_data->set_full_load_completed(false);
+			_missing_lod_mips_checked = false;
 
 			LoadAllBlocksDataTask *task = ZN_NEW(LoadAllBlocksDataTask);
 			task->volume_id = _volume_id;
@@ -859,6 +1061,7 @@ void VoxelLodTerrain::reset_maps() {
 	_data->reset_maps();
 
 	abort_async_edits();
+	abort_pre_generations();
 
 	reset_mesh_maps();
 }
@@ -902,10 +1105,16 @@ void VoxelLodTerrain::reset_mesh_maps() {
 		lod.mesh_blocks_to_deactivate_collision.clear();
 		lod.mesh_blocks_to_unload.clear();
 		lod.mesh_blocks_to_update_transitions.clear();
+		lod.mesh_blocks_to_restore.clear();
+		lod.mesh_blocks_to_uncache.clear();
+		lod.recently_unloaded_mesh_blocks.clear();
 
 		_deferred_collision_updates_per_lod[lod_index].clear();
+		_deferred_mesh_optimizations_per_lod[lod_index].clear();
 	}
 
+	clear_recently_unloaded_mesh_blocks();
+
 	// Reset LOD octrees
 	LodOctree::NoDestroyAction nda;
 	for (StdMap<Vector3i, VoxelLodTerrainUpdateData::OctreeItem>::iterator it =
@@ -940,6 +1149,7 @@ bool VoxelLodTerrain::get_generate_collisions() const {
 void VoxelLodTerrain::set_collision_lod_count(int lod_count) {
 	ERR_FAIL_COND(lod_count < 0);
 	_collision_lod_count = static_cast<unsigned int>(math::min(lod_count, get_lod_count()));
+	_update_data->settings.collision_lod_count = _collision_lod_count;
 }
 
 int VoxelLodTerrain::get_collision_lod_count() const {
@@ -1012,7 +1222,7 @@ Vector3i VoxelLodTerrain::voxel_to_data_block_position(Vector3 vpos, int lod_ind
 Vector3i VoxelLodTerrain::voxel_to_mesh_block_position(Vector3 vpos, int lod_index) const {
 	ERR_FAIL_COND_V(lod_index < 0, Vector3i());
 	ERR_FAIL_COND_V(lod_index >= get_lod_count(), Vector3i());
-	const unsigned int mesh_block_size_po2 = _update_data->settings.mesh_block_size_po2;
+	const unsigned int mesh_block_size_po2 = get_lod_mesh_block_size_pow2(lod_index);
 	const Vector3i bpos = (math::floor_to_int(vpos) >> mesh_block_size_po2) >> lod_index;
 	return bpos;
 }
@@ -1073,6 +1283,9 @@ void VoxelLodTerrain::_notification(int p_what) {
 					block.set_world(world);
 				});
 			}
+			_horizon.set_world(world);
+			_horizon.set_transform(get_global_transform());
+			_horizon.set_visible(is_visible());
 #ifdef TOOLS_ENABLED
 			if (debug_is_draw_enabled()) {
 				_debug_renderer.set_world(is_visible_in_tree() ? world : nullptr);
@@ -1090,6 +1303,7 @@ void VoxelLodTerrain::_notification(int p_what) {
 					block.set_world(nullptr);
 				});
 			}
+			_horizon.set_world(nullptr);
 #ifdef TOOLS_ENABLED
 			_debug_renderer.set_world(nullptr);
 #endif
@@ -1105,6 +1319,7 @@ void VoxelLodTerrain::_notification(int p_what) {
 					block.set_parent_visible(visible);
 				});
 			}
+			_horizon.set_visible(visible);
 
 #ifdef TOOLS_ENABLED
 			if (debug_is_draw_enabled()) {
@@ -1137,6 +1352,8 @@ void VoxelLodTerrain::_notification(int p_what) {
 			for (FadingOutMesh &item : _fading_out_meshes) {
 				item.mesh_instance.set_transform(transform * Transform3D(Basis(), item.local_position));
 			}
+
+			_horizon.set_transform(transform);
 		} break;
 
 		default:
@@ -1206,6 +1423,17 @@ void VoxelLodTerrain::process(float delta) {
 	// TODO This could go into time spread tasks too
 	process_deferred_collision_updates(VoxelEngine::get_singleton().get_main_thread_time_budget_usec());
 
+	process_pre_generations();
+
+	if (_horizon_enabled) {
+		process_horizon();
+	}
+
+	if (!_missing_lod_mips_checked && is_full_load_mode_enabled() && _data->is_full_load_completed()) {
+		_missing_lod_mips_checked = true;
+		rebuild_missing_lod_mips();
+	}
+
 #ifdef TOOLS_ENABLED
 	if (debug_is_draw_enabled() && is_visible_in_tree()) {
 		update_gizmos();
@@ -1217,9 +1445,15 @@ void VoxelLodTerrain::process(float delta) {
 
 		apply_main_thread_update_tasks();
 
+		// Edits queued since the last update get scheduled by the next one
+		flush_async_edit_queue();
+
 		// Get viewer location in voxel space
 		const Vector3 viewer_pos = get_local_viewer_pos();
 
+		_update_data->settings.lod_distance_scale = VoxelEngine::get_singleton().get_lod_distance_scale();
+		_update_data->settings.task_priority = get_task_priority();
+
 		// Copy viewers
 		{
 			VoxelLodTerrainUpdateData &update_data = *_update_data;
@@ -1251,7 +1485,8 @@ void VoxelLodTerrain::process(float delta) {
 			VoxelEngine::get_singleton().push_async_task(task);
 
 		} else {
-			ThreadedTaskContext ctx(0, TaskPriority());
+			LinearAllocator temp_allocator;
+			ThreadedTaskContext ctx(0, TaskPriority(), temp_allocator);
 			task->run(ctx);
 			ZN_DELETE(task);
 			apply_main_thread_update_tasks();
@@ -1276,6 +1511,12 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 	const Transform3D volume_transform = get_global_transform();
 	const unsigned int lod_count = get_lod_count();
 
+	// Cached blocks can't be restored with instances, since those are generated from mesh arrays
+	const bool cache_unloaded_mesh_blocks = _update_data->settings.lod_hysteresis_cache_duration_msec > 0 &&
+			_update_data->settings.streaming_system == VoxelLodTerrainUpdateData::STREAMING_SYSTEM_CLIPBOX &&
+			_instancer == nullptr;
+	const uint64_t now_msec = get_ticks_msec();
+
 	// Apply quick reloads
 	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 		VoxelLodTerrainUpdateData::Lod &lod = _update_data->state.lods[lod_index];
@@ -1304,7 +1545,16 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 		VoxelMeshMap<VoxelMeshBlockVLT> &mesh_map = _mesh_maps_per_lod[lod_index];
 		StdUnorderedSet<const VoxelMeshBlockVLT *> activated_visual_blocks;
 
-		const int mesh_block_size = get_mesh_block_size() << lod_index;
+		const int mesh_block_size = get_lod_mesh_block_size(lod_index) << lod_index;
+
+		// Deactivations are applied after activations. So when a hidden block is in both lists, it would be shown and
+		// hidden again in the same frame, sending commands to RenderingServer for nothing.
+		StdUnorderedSet<Vector3i> deactivated_positions;
+		if (lod.mesh_blocks_to_activate_visuals.size() > 0) {
+			for (const Vector3i bpos : lod.mesh_blocks_to_deactivate_visuals) {
+				deactivated_positions.insert(bpos);
+			}
+		}
 
 		for (unsigned int i = 0; i < lod.mesh_blocks_to_activate_visuals.size(); ++i) {
 			const Vector3i bpos = lod.mesh_blocks_to_activate_visuals[i];
@@ -1314,6 +1564,9 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 				continue;
 			}
 			// ERR_CONTINUE(block == nullptr);
+			if (!block->visual_active && deactivated_positions.find(bpos) != deactivated_positions.end()) {
+				continue;
+			}
 			bool with_fading = false;
 			if (_lod_fade_duration > 0.f) {
 				const Vector3 block_center = volume_transform.xform(
@@ -1462,13 +1715,7 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 							// TODO Do we actually have to instantiate a material? We could just re-use the one from the
 							// block, since it gets removed and no change occurs in that material (contrary to
 							// transition mask changes)
-							item.shader_material = _shader_material_pool.allocate();
-							ZN_ASSERT(item.shader_material.is_valid());
-							zylann::godot::copy_shader_params(
-									**shader_material,
-									**item.shader_material,
-									_shader_material_pool.get_cached_shader_uniforms()
-							);
+							item.shader_material = copy_block_shader_material_for_fading(shader_material);
 
 							item.mesh_instance.create();
 							item.mesh_instance.set_mesh(mesh_block->get_mesh());
@@ -1477,6 +1724,10 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 									volume_transform * Transform3D(Basis(), item.local_position)
 							);
 							item.mesh_instance.set_material_override(item.shader_material);
+							if (mesh_block->is_using_shader_instance_uniforms()) {
+								mesh_block->copy_shader_instance_parameters(item.mesh_instance);
+								item.shader_instance_uniforms = true;
+							}
 							item.mesh_instance.set_world(*get_world_3d());
 							// TODO What if the terrain is hidden?
 							item.mesh_instance.set_visible(true);
@@ -1491,7 +1742,23 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 				fading_blocks_in_current_lod.erase(fading_block_it);
 			}
 
-			mesh_map.remove_block(bpos, BeforeUnloadMeshAction{ _shader_material_pool });
+			if (cache_unloaded_mesh_blocks) {
+				// Keep the block hidden for a while in case viewers need it again
+				RecentlyUnloadedMeshBlocks &cache = _recently_unloaded_mesh_blocks_per_lod[lod_index];
+				cache.blocks.remove_block(bpos, BeforeUnloadMeshAction{ _shader_material_pool });
+				VoxelMeshBlockVLT *block = mesh_map.take_block(bpos);
+				if (block != nullptr) {
+					set_mesh_block_visual_active(*block, false, false, lod_index);
+					block->set_collision_enabled(false);
+					cache.blocks.set_block(bpos, block);
+				}
+				cache.unload_times_msec[bpos] = now_msec;
+				_recently_unloaded_mesh_blocks_queue.push(
+						RecentlyUnloadedMeshBlockRecord{ bpos, static_cast<uint8_t>(lod_index), now_msec }
+				);
+			} else {
+				mesh_map.remove_block(bpos, BeforeUnloadMeshAction{ _shader_material_pool });
+			}
 
 			if (_instancer != nullptr) {
 				_instancer->on_mesh_block_exit(bpos, lod_index);
@@ -1548,13 +1815,7 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 						// Wayyyy too slow, initially because of https://github.com/godotengine/godot/issues/34741
 						// but also generally slow because of how `duplicate` is implemented
 						// item.shader_material = shader_material->duplicate(false);
-						item.shader_material = _shader_material_pool.allocate();
-						ZN_ASSERT(item.shader_material.is_valid());
-						zylann::godot::copy_shader_params(
-								**shader_material,
-								**item.shader_material,
-								_shader_material_pool.get_cached_shader_uniforms()
-						);
+						item.shader_material = copy_block_shader_material_for_fading(shader_material);
 
 						// item.shader_material->set_shader_param(
 						// 		VoxelStringNames::get_singleton().u_lod_fade, Vector2(item.progress, 0.f));
@@ -1564,6 +1825,11 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 						item.mesh_instance.set_gi_mode(get_gi_mode());
 						item.mesh_instance.set_transform(volume_transform * Transform3D(Basis(), item.local_position));
 						item.mesh_instance.set_material_override(item.shader_material);
+						if (block->is_using_shader_instance_uniforms()) {
+							// Copied before the transition mask changes
+							block->copy_shader_instance_parameters(item.mesh_instance);
+							item.shader_instance_uniforms = true;
+						}
 						item.mesh_instance.set_world(*get_world_3d());
 						item.mesh_instance.set_visible(true);
 
@@ -1584,36 +1850,233 @@ void VoxelLodTerrain::apply_main_thread_update_tasks() {
 		lod.mesh_blocks_to_unload.clear();
 		lod.mesh_blocks_to_update_transitions.clear();
 
+		// Restored after unloads, because a block can be unloaded and needed again during the same update
+		restore_recently_unloaded_mesh_blocks(lod_index);
+		uncache_recently_unloaded_mesh_blocks(lod_index);
+
+		schedule_deferred_mesh_optimizations(lod_index, now_msec);
+
 	} // for each lod
 
+	remove_expired_recently_unloaded_mesh_blocks(now_msec);
+
 	// Remove completed async edits
-	unordered_remove_if(state.running_async_edits, [this](VoxelLodTerrainUpdateData::RunningAsyncEdit &e) {
-		if (e.tracker->is_complete()) {
-			if (e.tracker->has_next_tasks()) {
-				ERR_PRINT("Completed async edit had next tasks?");
-			}
-			post_edit_area(
-					e.box,
-					// Assume the async edit modified voxels in a way it affects the mesh.
-					// Won't be the case if changed only metadata, but so far there is no use case for using an async
-					// edit to change metadata. Metadata is not even used often in smooth terrains (which
-					// VoxelLodTerrain is mostly for)
-					true
-			);
-			return true;
+	StdVector<uint32_t> completed_async_edit_batches;
+	unordered_remove_if(
+			state.running_async_edits,
+			[this, &completed_async_edit_batches](VoxelLodTerrainUpdateData::RunningAsyncEdit &e) {
+				if (e.tracker->is_complete()) {
+					if (e.tracker->has_next_tasks()) {
+						ERR_PRINT("Completed async edit had next tasks?");
+					}
+					post_edit_area(
+							e.box,
+							// Assume the async edit modified voxels in a way it affects the mesh.
+							// Won't be the case if changed only metadata, but so far there is no use case for using
+							// an async edit to change metadata. Metadata is not even used often in smooth terrains
+							// (which VoxelLodTerrain is mostly for)
+							true
+					);
+					// Groups of the same batch complete together
+					if (e.batch_id != 0 && !contains(to_span_const(completed_async_edit_batches), e.batch_id)) {
+						completed_async_edit_batches.push_back(e.batch_id);
+					}
+					return true;
 
-		} else if (e.tracker->is_aborted()) {
-			return true;
-		}
+				} else if (e.tracker->is_aborted()) {
+					return true;
+				}
 
-		return false;
-	});
+				return false;
+			}
+	);
+
+	for (const uint32_t batch_id : completed_async_edit_batches) {
+		emit_signal(VoxelStringNames::get_singleton().async_edit_batch_completed, batch_id);
+	}
 
 	_stats.blocked_lods = state.stats.blocked_lods;
+	_stats.updated_octrees = state.stats.updated_octrees;
+	_stats.checked_octree_nodes = state.stats.checked_octree_nodes;
 	_stats.time_detect_required_blocks = state.stats.time_detect_required_blocks;
 	_stats.time_io_requests = state.stats.time_io_requests;
 	_stats.time_mesh_requests = state.stats.time_mesh_requests;
 	_stats.time_update_task = state.stats.time_total;
+	_stats.prefetched_blocks = state.stats.prefetched_blocks;
+	_stats.prefetch_hits = state.stats.prefetch_hits;
+	_stats.prefetch_misses = state.stats.prefetch_misses;
+	_stats.prefetch_cancelled = state.stats.prefetch_cancelled;
+	_stats.thrashed_mesh_blocks = state.stats.thrashed_mesh_blocks;
+	_stats.restored_mesh_blocks = state.stats.restored_mesh_blocks;
+}
+
+void VoxelLodTerrain::schedule_deferred_mesh_optimizations(unsigned int lod_index, uint64_t now_msec) {
+	StdUnorderedMap<Vector3i, uint64_t> &deferred_optimizations = _deferred_mesh_optimizations_per_lod[lod_index];
+	if (deferred_optimizations.size() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	// Blocks changing often, like while sculpting, would get optimized for nothing
+	static const uint64_t DEFERRED_MESH_OPTIMIZATION_DELAY_MSEC = 2000;
+
+	VoxelLodTerrainUpdateData::Lod &lod = _update_data->state.lods[lod_index];
+
+	for (auto it = deferred_optimizations.begin(); it != deferred_optimizations.end();) {
+		if (now_msec < it->second + DEFERRED_MESH_OPTIMIZATION_DELAY_MSEC) {
+			++it;
+			continue;
+		}
+		auto state_it = lod.mesh_map_state.map.find(it->first);
+		if (state_it == lod.mesh_map_state.map.end()) {
+			// Unloaded
+			it = deferred_optimizations.erase(it);
+			continue;
+		}
+		VoxelLodTerrainUpdateData::MeshBlockState &mesh_block_state = state_it->second;
+		if (!mesh_block_state.visual_active) {
+			// Not worth it while hidden, it might not become visible again
+			++it;
+			continue;
+		}
+		if (mesh_block_state.state == VoxelLodTerrainUpdateData::MESH_UP_TO_DATE &&
+			mesh_block_state.update_list_index == -1) {
+			mesh_block_state.update_list_index = lod.mesh_blocks_pending_update.size();
+			mesh_block_state.state = VoxelLodTerrainUpdateData::MESH_UPDATE_NOT_SENT;
+			lod.mesh_blocks_pending_update.push_back(VoxelLodTerrainUpdateData::MeshToUpdate{
+					it->first, TaskCancellationToken(), mesh_block_state.mesh_viewers.get() > 0, false, true });
+		}
+		// Otherwise an update is pending already, it will be received without optimization again if needed
+		it = deferred_optimizations.erase(it);
+	}
+}
+
+void VoxelLodTerrain::restore_recently_unloaded_mesh_blocks(unsigned int lod_index) {
+	VoxelLodTerrainUpdateData::Lod &lod = _update_data->state.lods[lod_index];
+	if (lod.mesh_blocks_to_restore.size() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	VoxelMeshMap<VoxelMeshBlockVLT> &mesh_map = _mesh_maps_per_lod[lod_index];
+	RecentlyUnloadedMeshBlocks &cache = _recently_unloaded_mesh_blocks_per_lod[lod_index];
+	VoxelLodTerrainUpdateData::ClipboxStreamingState &cs = _update_data->state.clipbox_streaming;
+
+	for (const VoxelLodTerrainUpdateData::MeshBlockToRestore &rb : lod.mesh_blocks_to_restore) {
+		auto state_it = lod.mesh_map_state.map.find(rb.position);
+		if (state_it == lod.mesh_map_state.map.end()) {
+			continue;
+		}
+		VoxelLodTerrainUpdateData::MeshBlockState &mesh_block_state = state_it->second;
+
+		auto time_it = cache.unload_times_msec.find(rb.position);
+		if (time_it == cache.unload_times_msec.end()) {
+			// The block was not cached (or the cache got cleared), so it has to be meshed again
+			if (mesh_block_state.update_list_index == -1) {
+				TaskCancellationToken cancellation_token = TaskCancellationToken::create();
+				mesh_block_state.cancellation_token = cancellation_token;
+				mesh_block_state.update_list_index = lod.mesh_blocks_pending_update.size();
+				mesh_block_state.state = VoxelLodTerrainUpdateData::MESH_UPDATE_NOT_SENT;
+				lod.mesh_blocks_pending_update.push_back(VoxelLodTerrainUpdateData::MeshToUpdate{
+						rb.position, cancellation_token, mesh_block_state.mesh_viewers.get() > 0 });
+			}
+			continue;
+		}
+		cache.unload_times_msec.erase(time_it);
+
+		if (mesh_map.has_block(rb.position)) {
+			// A mesh was received in the meantime
+			cache.blocks.remove_block(rb.position, BeforeUnloadMeshAction{ _shader_material_pool });
+		} else {
+			// Can be null if there was no surface at this location
+			VoxelMeshBlockVLT *block = cache.blocks.take_block(rb.position);
+			if (block != nullptr) {
+				block->set_transition_mask(mesh_block_state.transition_mask);
+				mesh_map.set_block(rb.position, block);
+			}
+		}
+
+		// Same as when a mesh is received, so the streaming system can show it
+		const bool first_visual_load = rb.visual && mesh_block_state.mesh_viewers.get() > 0 &&
+				mesh_block_state.visual_loaded.exchange(true) == false;
+		const bool first_collision_load = rb.collision && mesh_block_state.collision_viewers.get() > 0 &&
+				mesh_block_state.collision_loaded.exchange(true) == false;
+
+		if (first_visual_load || first_collision_load) {
+			MutexLock mlock(cs.loaded_mesh_blocks_mutex);
+			cs.loaded_mesh_blocks.push_back(VoxelLodTerrainUpdateData::LoadedMeshBlockEvent{
+					rb.position, static_cast<uint8_t>(lod_index), first_visual_load, first_collision_load });
+		}
+	}
+
+	lod.mesh_blocks_to_restore.clear();
+}
+
+void VoxelLodTerrain::uncache_recently_unloaded_mesh_blocks(unsigned int lod_index) {
+	VoxelLodTerrainUpdateData::Lod &lod = _update_data->state.lods[lod_index];
+	if (lod.mesh_blocks_to_uncache.size() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	// These blocks were modified since they got unloaded, so they can't be restored anymore
+	RecentlyUnloadedMeshBlocks &cache = _recently_unloaded_mesh_blocks_per_lod[lod_index];
+	for (const Vector3i bpos : lod.mesh_blocks_to_uncache) {
+		cache.blocks.remove_block(bpos, BeforeUnloadMeshAction{ _shader_material_pool });
+		cache.unload_times_msec.erase(bpos);
+	}
+	lod.mesh_blocks_to_uncache.clear();
+}
+
+void VoxelLodTerrain::remove_expired_recently_unloaded_mesh_blocks(uint64_t now_msec) {
+	if (_recently_unloaded_mesh_blocks_queue.size() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	const uint32_t duration_msec = _update_data->settings.lod_hysteresis_cache_duration_msec;
+
+	unsigned int block_count = 0;
+	for (unsigned int lod_index = 0; lod_index < _recently_unloaded_mesh_blocks_per_lod.size(); ++lod_index) {
+		block_count += _recently_unloaded_mesh_blocks_per_lod[lod_index].blocks.get_block_count();
+	}
+
+	// Oldest blocks come first, so we can stop at the first one that can stay
+	while (_recently_unloaded_mesh_blocks_queue.size() > 0) {
+		const RecentlyUnloadedMeshBlockRecord record = _recently_unloaded_mesh_blocks_queue.front();
+
+		RecentlyUnloadedMeshBlocks &cache = _recently_unloaded_mesh_blocks_per_lod[record.lod_index];
+		auto it = cache.unload_times_msec.find(record.position);
+
+		if (it == cache.unload_times_msec.end() || it->second != record.time_msec) {
+			// Restored or removed since then
+			_recently_unloaded_mesh_blocks_queue.pop();
+			continue;
+		}
+
+		if (now_msec - record.time_msec < duration_msec && block_count <= _lod_hysteresis_cache_max_blocks) {
+			break;
+		}
+
+		if (cache.blocks.has_block(record.position)) {
+			cache.blocks.remove_block(record.position, BeforeUnloadMeshAction{ _shader_material_pool });
+			--block_count;
+		}
+		cache.unload_times_msec.erase(it);
+		_recently_unloaded_mesh_blocks_queue.pop();
+	}
+
+	_stats.cached_mesh_blocks = block_count;
+}
+
+void VoxelLodTerrain::clear_recently_unloaded_mesh_blocks() {
+	for (unsigned int lod_index = 0; lod_index < _recently_unloaded_mesh_blocks_per_lod.size(); ++lod_index) {
+		RecentlyUnloadedMeshBlocks &cache = _recently_unloaded_mesh_blocks_per_lod[lod_index];
+		cache.blocks.clear();
+		cache.unload_times_msec.clear();
+	}
+	_recently_unloaded_mesh_blocks_queue = StdQueue<RecentlyUnloadedMeshBlockRecord>();
+	_stats.cached_mesh_blocks = 0;
 }
 
 void VoxelLodTerrain::apply_data_block_response(VoxelEngine::BlockDataOutput &ob) {
@@ -1845,6 +2308,12 @@ void VoxelLodTerrain::apply_mesh_update(VoxelEngine::BlockMeshOutput &ob) {
 				ob.position, ob.lod, first_visual_load, first_collision_load });
 	}
 
+	if (ob.surfaces.optimization_deferred) {
+		_deferred_mesh_optimizations_per_lod[ob.lod][ob.position] = get_ticks_msec();
+	} else {
+		_deferred_mesh_optimizations_per_lod[ob.lod].erase(ob.position);
+	}
+
 	// -------- Part where we invoke Godot functions ---------
 	// This part is not fully threadable.
 
@@ -1906,7 +2375,7 @@ void VoxelLodTerrain::apply_mesh_update(VoxelEngine::BlockMeshOutput &ob) {
 
 	if (block == nullptr) {
 		// Create new block
-		block = ZN_NEW(VoxelMeshBlockVLT(ob.position, get_mesh_block_size(), ob.lod));
+		block = ZN_NEW(VoxelMeshBlockVLT(ob.position, get_lod_mesh_block_size(ob.lod), ob.lod));
 		mesh_map.set_block(ob.position, block);
 
 		block->set_world(get_world_3d());
@@ -1956,21 +2425,20 @@ void VoxelLodTerrain::apply_mesh_update(VoxelEngine::BlockMeshOutput &ob) {
 				// Due to a signal used to keep the inspector up to date, even though these
 				// material copies will never be seen in the inspector
 				// See https://github.com/godotengine/godot/issues/34741
-				Ref<ShaderMaterial> sm = _shader_material_pool.allocate();
+				// With instance uniforms, all blocks share the same material until they get detail textures
+				Ref<ShaderMaterial> sm = _shader_material_pool.allocate_for_block();
+
+				// Set individual shader material, because each block can have dynamic parameters,
+				// used to smooth seams without re-uploading meshes and allow to implement LOD fading
+				block->set_shader_instance_uniforms_enabled(_shader_material_pool.is_using_instance_uniforms());
+				block->set_shader_material(sm);
 
 				if (sm.is_valid() && _material_uses_lod_info) {
 					// This is mainly for debugging purposes
 					const int lod_count = get_lod_count();
-					sm->set_shader_parameter(
-							VoxelStringNames::get_singleton().u_voxel_lod_info,
-							encode_lod_info_for_shader_uniform(ob.lod, lod_count)
-					);
+					block->set_shader_lod_info(encode_lod_info_for_shader_uniform(ob.lod, lod_count));
 				}
 
-				// Set individual shader material, because each block can have dynamic parameters,
-				// used to smooth seams without re-uploading meshes and allow to implement LOD fading
-				block->set_shader_material(sm);
-
 			} else if (_material.is_valid()) {
 				assign_material_after_mesh = true;
 			}
@@ -2042,16 +2510,30 @@ void VoxelLodTerrain::apply_mesh_update(VoxelEngine::BlockMeshOutput &ob) {
 		if (_collision_update_delay == 0 ||
 			static_cast<int>(now - block->last_collider_update_time) > _collision_update_delay) {
 			ZN_ASSERT(_mesher.is_valid());
-			Ref<Shape3D> collision_shape = make_collision_shape_from_mesher_output(ob.surfaces, **_mesher);
+			Ref<Shape3D> collision_shape;
+			if (ob.has_collision_shape_resource) {
+				collision_shape = ob.collision_shape;
+			} else {
+				collision_shape = make_collision_shape_from_mesher_output(ob.surfaces, **_mesher);
+			}
 			set_block_collision_shape(*this, *block, collision_shape, now);
 			block->set_collision_enabled(collision_active);
 
 		} else {
 			if (block->deferred_collider_data == nullptr) {
 				_deferred_collision_updates_per_lod[ob.lod].push_back(ob.position);
-				block->deferred_collider_data = make_unique_instance<VoxelMesher::Output>();
+				block->deferred_collider_data = make_unique_instance<VoxelMeshBlockVLT::DeferredCollider>();
+			}
+			VoxelMeshBlockVLT::DeferredCollider &deferred_collider = *block->deferred_collider_data;
+			deferred_collider.has_shape = ob.has_collision_shape_resource;
+			if (ob.has_collision_shape_resource) {
+				// No need to keep surfaces, the shape is already built
+				deferred_collider.shape = ob.collision_shape;
+				deferred_collider.surfaces = VoxelMesher::Output();
+			} else {
+				deferred_collider.shape.unref();
+				deferred_collider.surfaces = std::move(ob.surfaces);
 			}
-			*block->deferred_collider_data = std::move(ob.surfaces);
 		}
 	}
 
@@ -2112,6 +2594,7 @@ void try_apply_parent_detail_texture_to_block(
 		unsigned int mesh_block_size,
 		const VoxelMeshBlockVLT &parent_block,
 		Vector3i parent_bpos,
+		unsigned int parent_shift,
 		const DetailRenderingSettings &detail_texture_settings
 ) {
 	//
@@ -2131,14 +2614,18 @@ void try_apply_parent_detail_texture_to_block(
 	const int cell_size = 1 << lod_index;
 	material.set_shader_parameter(sn.u_voxel_cell_size, cell_size);
 
-	material.set_shader_parameter(sn.u_voxel_block_size, mesh_block_size);
+	// Textures are laid out for the block that owns them, which may have a different size when mesh block sizes vary
+	// across LODs
+	const int owner_block_size = parent_material->get_shader_parameter(sn.u_voxel_block_size);
+	material.set_shader_parameter(sn.u_voxel_block_size, owner_block_size);
 
 	const Vector4 parent_offset_and_scale =
 			parent_material->get_shader_parameter(sn.u_voxel_virtual_texture_offset_scale);
 	const Vector3i parent_offset(parent_offset_and_scale.x, parent_offset_and_scale.y, parent_offset_and_scale.z);
 	const int fallback_level = parent_block.detail_texture_fallback_level + 1;
 
-	const Vector3i offset = parent_offset + (bpos - (parent_bpos * 2)) * (mesh_block_size >> fallback_level);
+	const Vector3i offset =
+			parent_offset + (bpos - (parent_bpos << parent_shift)) * (int(mesh_block_size) >> fallback_level);
 	const float scale = 1.f / float(1 << fallback_level);
 	material.set_shader_parameter(
 			sn.u_voxel_virtual_texture_offset_scale, Vector4(offset.x, offset.y, offset.z, scale)
@@ -2167,27 +2654,35 @@ void VoxelLodTerrain::try_apply_parent_detail_texture_to_block(
 	if (!material.is_valid()) {
 		return;
 	}
-	if (lod_index == static_cast<unsigned int>(get_lod_count())) {
+	if (lod_index + 1 >= static_cast<unsigned int>(get_lod_count())) {
 		return;
 	}
 
 	// Only looking up one level for now
 	const unsigned int parent_lod_index = lod_index + 1;
 	const VoxelMeshMap<VoxelMeshBlockVLT> &parent_map = _mesh_maps_per_lod[parent_lod_index];
-	const Vector3i parent_bpos = bpos >> 1;
+	const unsigned int parent_shift = _update_data->settings.get_parent_mesh_block_shift(lod_index);
+	const Vector3i parent_bpos = bpos >> parent_shift;
 	const VoxelMeshBlockVLT *parent_block = parent_map.get_block(parent_bpos);
 	if (parent_block == nullptr) {
 		return;
 	}
+	if (parent_block->get_shader_material() == _shader_material_pool.get_shared_material()) {
+		// The parent has no detail textures
+		return;
+	}
+
+	material = get_or_create_own_shader_material(block);
 
 	zylann::voxel::try_apply_parent_detail_texture_to_block(
 			block,
 			bpos,
 			lod_index,
 			**material,
-			get_mesh_block_size(),
+			get_lod_mesh_block_size(lod_index),
 			*parent_block,
 			parent_bpos,
+			parent_shift,
 			_update_data->settings.detail_texture_settings
 	);
 }
@@ -2209,7 +2704,7 @@ void VoxelLodTerrain::apply_detail_texture_update_to_block(
 		normalmap_textures = store_normalmap_data_to_textures(normalmap_images);
 	}
 
-	Ref<ShaderMaterial> material = block.get_shader_material();
+	Ref<ShaderMaterial> material = get_or_create_own_shader_material(block);
 	if (material.is_valid()) {
 		const VoxelStringNames &sn = VoxelStringNames::get_singleton();
 
@@ -2218,7 +2713,7 @@ void VoxelLodTerrain::apply_detail_texture_update_to_block(
 		material->set_shader_parameter(sn.u_voxel_cell_lookup, normalmap_textures.lookup);
 		const int cell_size = 1 << lod_index;
 		material->set_shader_parameter(sn.u_voxel_cell_size, cell_size);
-		material->set_shader_parameter(sn.u_voxel_block_size, get_mesh_block_size());
+		material->set_shader_parameter(sn.u_voxel_block_size, get_lod_mesh_block_size(lod_index));
 		material->set_shader_parameter(sn.u_voxel_virtual_texture_offset_scale, Vector4(0, 0, 0, 1));
 
 		if (!had_texture) {
@@ -2284,10 +2779,12 @@ void VoxelLodTerrain::process_deferred_collision_updates(uint32_t timeout_msec)
 			const uint64_t now = get_ticks_msec();
 
 			if (static_cast<int>(now - block->last_collider_update_time) > _collision_update_delay) {
+				const VoxelMeshBlockVLT::DeferredCollider &deferred_collider = *block->deferred_collider_data;
 				Ref<Shape3D> collision_shape;
-				if (_mesher.is_valid()) {
-					collision_shape =
-							make_collision_shape_from_mesher_output(*block->deferred_collider_data, **_mesher);
+				if (deferred_collider.has_shape) {
+					collision_shape = deferred_collider.shape;
+				} else if (_mesher.is_valid()) {
+					collision_shape = make_collision_shape_from_mesher_output(deferred_collider.surfaces, **_mesher);
 				}
 
 				set_block_collision_shape(*this, *block, collision_shape, now);
@@ -2315,6 +2812,7 @@ void VoxelLodTerrain::abort_async_edits() {
 	}
 	state.pending_async_edits.clear();
 	state.running_async_edits.clear();
+	_async_edit_queue.clear();
 	// Can't cancel edits which are already running on the thread pool,
 	// so the caller of this function must ensure none of them are running, or none will have an effect
 }
@@ -2368,9 +2866,14 @@ void VoxelLodTerrain::process_fading_blocks(float delta) {
 				_fading_out_meshes[i] = std::move(_fading_out_meshes.back());
 				_fading_out_meshes.pop_back();
 			} else {
-				item.shader_material->set_shader_parameter(
-						VoxelStringNames::get_singleton().u_lod_fade, Vector2(1.f - item.progress, 0.f)
-				);
+				const Vector2 lod_fade(1.f - item.progress, 0.f);
+				if (item.shader_instance_uniforms) {
+					item.mesh_instance.set_shader_instance_parameter(
+							VoxelStringNames::get_singleton().u_lod_fade, lod_fade
+					);
+				} else {
+					item.shader_material->set_shader_parameter(VoxelStringNames::get_singleton().u_lod_fade, lod_fade);
+				}
 				++i;
 			}
 		}
@@ -2441,7 +2944,17 @@ void VoxelLodTerrain::set_instancer(VoxelInstancer *instancer) {
 	if (_instancer != nullptr && instancer != nullptr) {
 		ERR_FAIL_COND_MSG(_instancer != nullptr, "No more than one VoxelInstancer per terrain");
 	}
-	_instancer = instancer;
+	if (instancer != nullptr) {
+		// Go back to uniform mesh block sizes before attaching, the instancer must not see blocks of other sizes
+		update_lod_mesh_block_sizes(false);
+		_instancer = instancer;
+		// Cached blocks already left the instancer, they would come back without instances
+		clear_recently_unloaded_mesh_blocks();
+	} else {
+		_instancer = nullptr;
+		update_lod_mesh_block_sizes(are_lod_mesh_block_sizes_supported());
+	}
+	update_configuration_warnings();
 }
 
 // This function is primarily intended for editor use cases at the moment.
@@ -2483,14 +2996,14 @@ void VoxelLodTerrain::get_meshed_block_positions_at_lod(int lod_index, StdVector
 	});
 }
 
-void VoxelLodTerrain::save_all_modified_blocks(bool with_copy, std::shared_ptr<AsyncDependencyTracker> tracker) {
+void VoxelLodTerrain::save_all_modified_blocks(std::shared_ptr<AsyncDependencyTracker> tracker) {
 	ZN_PROFILE_SCOPE();
 
 	// This is often called before quitting the game or forcing a global save.
 	// This could be part of the update task if async, but here we want it to be immediate.
 	_update_data->wait_for_end_of_task();
 
-	VoxelLodTerrainUpdateTask::flush_pending_lod_edits(_update_data->state, *_data, get_mesh_block_size());
+	VoxelLodTerrainUpdateTask::flush_pending_lod_edits(_update_data->state, _update_data->settings, *_data);
 
 	BufferedTaskScheduler &task_scheduler = BufferedTaskScheduler::get_for_current_thread();
 	StdVector<VoxelData::BlockToSave> blocks_to_save;
@@ -2498,7 +3011,10 @@ void VoxelLodTerrain::save_all_modified_blocks(bool with_copy, std::shared_ptr<A
 	Ref<VoxelStream> stream = get_stream();
 	if (stream.is_valid()) {
 		// That may cause a stutter, so should be used when the player won't notice
-		_data->consume_all_modifications(blocks_to_save, with_copy);
+		_data->consume_all_modifications(blocks_to_save);
+		SaveBlockDataTask::assign_save_priorities_by_viewer_distance(
+				to_span(blocks_to_save), get_global_transform(), get_data_block_size()
+		);
 
 		if (_instancer != nullptr && stream->supports_instance_blocks()) {
 			_instancer->save_all_modified_blocks(task_scheduler, tracker, true);
@@ -2509,6 +3025,7 @@ void VoxelLodTerrain::save_all_modified_blocks(bool with_copy, std::shared_ptr<A
 	VoxelLodTerrainUpdateTask::send_block_save_requests(
 			_volume_id,
 			to_span(blocks_to_save),
+			_data,
 			_streaming_dependency,
 			task_scheduler,
 			tracker,
@@ -2548,11 +3065,52 @@ Dictionary VoxelLodTerrain::_b_get_statistics() const {
 	d["time_mesh_requests"] = _stats.time_mesh_requests;
 	d["time_update_task"] = _stats.time_update_task;
 	d["blocked_lods"] = _stats.blocked_lods;
+	d["updated_octrees"] = _stats.updated_octrees;
+	d["checked_octree_nodes"] = _stats.checked_octree_nodes;
+	d["prefetched_blocks"] = _stats.prefetched_blocks;
+	d["prefetch_hits"] = _stats.prefetch_hits;
+	d["prefetch_misses"] = _stats.prefetch_misses;
+	d["prefetch_cancelled"] = _stats.prefetch_cancelled;
+	d["thrashed_mesh_blocks"] = _stats.thrashed_mesh_blocks;
+	d["restored_mesh_blocks"] = _stats.restored_mesh_blocks;
+	d["cached_mesh_blocks"] = _stats.cached_mesh_blocks;
 
 	// Process
 	d["dropped_block_loads"] = _stats.dropped_block_loads;
 	d["dropped_block_meshs"] = _stats.dropped_block_meshs;
 
+	// Depth of this volume's share of the task queues, useful to compare with other volumes
+	unsigned int pending_block_loads = 0;
+	const unsigned int lod_count = get_lod_count();
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		VoxelLodTerrainUpdateData::Lod &lod = _update_data->state.lods[lod_index];
+		MutexLock mlock(lod.loading_blocks_mutex);
+		pending_block_loads += lod.loading_blocks.size();
+	}
+	d["pending_block_loads"] = pending_block_loads;
+
+	return d;
+}
+
+Dictionary VoxelLodTerrain::_b_get_memory_breakdown() const {
+	ZN_PROFILE_SCOPE();
+	unsigned int mesh_block_count = 0;
+	uint64_t vertex_count = 0;
+	uint64_t index_count = 0;
+	const unsigned int lod_count = get_lod_count();
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		const VoxelMeshMap<VoxelMeshBlockVLT> &mesh_map = _mesh_maps_per_lod[lod_index];
+		mesh_block_count += mesh_map.get_block_count();
+		mesh_map.for_each_block([&vertex_count, &index_count](const VoxelMeshBlockVLT &block) {
+			block.get_mesh_size(vertex_count, index_count);
+		});
+	}
+
+	Dictionary d;
+	d["voxel_data"] = godot::get_voxel_data_memory_breakdown(*_data);
+	d["mesh_blocks"] = mesh_block_count;
+	d["mesh_vertices"] = ZN_SIZE_T_TO_VARIANT(vertex_count);
+	d["mesh_indices"] = ZN_SIZE_T_TO_VARIANT(index_count);
 	return d;
 }
 
@@ -2597,8 +3155,114 @@ void VoxelLodTerrain::remesh_all_blocks() {
 	}
 }
 
+uint32_t VoxelLodTerrain::pre_generate_box_async(Box3i voxel_box, bool save_to_stream) {
+	ZN_PROFILE_SCOPE();
+
+	std::shared_ptr<PreGenerateBoxTask::Progress> progress = make_shared_instance<PreGenerateBoxTask::Progress>();
+	progress->cancellation_token = TaskCancellationToken::create();
+
+	StdVector<IThreadedTask *> tasks;
+	PreGenerateBoxTask::create_tasks(_data, voxel_box, save_to_stream, progress, tasks);
+
+	const uint32_t id = _next_pre_generation_id;
+	++_next_pre_generation_id;
+	if (_next_pre_generation_id == 0) {
+		// Skip 0 on wrap-around, so it can't be mistaken for an invalid ID
+		_next_pre_generation_id = 1;
+	}
+
+	// Completion is reported from `process`, even if there were no blocks to generate, so it always happens after
+	// the caller got the ID
+	_running_pre_generations.push_back(RunningPreGeneration{ id, 0, progress });
+
+	VoxelEngine::get_singleton().push_async_tasks(to_span(tasks));
+
+	return id;
+}
+
+void VoxelLodTerrain::cancel_pre_generate_box(uint32_t request_id) {
+	for (RunningPreGeneration &pg : _running_pre_generations) {
+		if (pg.id == request_id) {
+			pg.progress->cancellation_token.cancel();
+			return;
+		}
+	}
+}
+
+void VoxelLodTerrain::process_pre_generations() {
+	if (_running_pre_generations.size() == 0) {
+		return;
+	}
+	ZN_PROFILE_SCOPE();
+
+	// Signals could start or cancel requests, so the list can't be iterated while they are emitted
+	struct Event {
+		uint32_t id;
+		uint32_t finished_task_count;
+		uint32_t task_count;
+		bool complete;
+		bool cancelled;
+	};
+	StdVector<Event> events;
+
+	unordered_remove_if(_running_pre_generations, [&events](RunningPreGeneration &pg) {
+		const PreGenerateBoxTask::Progress &progress = *pg.progress;
+		const uint32_t finished_task_count = progress.finished_task_count;
+		const bool complete = finished_task_count == progress.task_count;
+		if (finished_task_count != pg.reported_finished_task_count || complete) {
+			pg.reported_finished_task_count = finished_task_count;
+			const bool cancelled = progress.cancellation_token.is_cancelled();
+			events.push_back(Event{ pg.id, finished_task_count, progress.task_count, complete, cancelled });
+		}
+		return complete;
+	});
+
+	const VoxelStringNames &sn = VoxelStringNames::get_singleton();
+
+	for (const Event &e : events) {
+		if (e.task_count > 0) {
+			emit_signal(sn.pre_generate_box_progress, e.id, static_cast<float>(e.finished_task_count) / e.task_count);
+		}
+		if (e.complete) {
+			emit_signal(sn.pre_generate_box_completed, e.id, e.cancelled);
+		}
+	}
+}
+
+void VoxelLodTerrain::rebuild_missing_lod_mips() {
+	ZN_PROFILE_SCOPE();
+	// LOD mips are normally loaded from the stream like LOD0, so they don't have to be computed when the game starts.
+	// Some can be missing if the stream was written without them. The update task computes them in parallel, and
+	// they get saved with other modified blocks so it doesn't happen next time.
+	VoxelLodTerrainUpdateData::EditNotificationInputs &edit_notifications = _update_data->state.edit_notifications;
+	MutexLock lock(edit_notifications.mutex);
+	const size_t count_before = edit_notifications.edited_blocks_lod0.size();
+	_data->mark_lod0_blocks_with_missing_mips(edit_notifications.edited_blocks_lod0);
+	const size_t count = edit_notifications.edited_blocks_lod0.size() - count_before;
+	if (count == 0) {
+		return;
+	}
+	ZN_PRINT_VERBOSE(format("Rebuilding LOD mips of {} blocks missing them in volume {}", count, _volume_id));
+	// Meshes of these LODs may have been built from generated voxels in the meantime
+	const int data_block_size = _data->get_block_size();
+	for (size_t i = count_before; i < edit_notifications.edited_blocks_lod0.size(); ++i) {
+		const Vector3i bpos = edit_notifications.edited_blocks_lod0[i];
+		edit_notifications.edited_voxel_areas_lod0.push_back(
+				Box3i(bpos * data_block_size, Vector3iUtil::create(data_block_size))
+		);
+	}
+}
+
+void VoxelLodTerrain::abort_pre_generations() {
+	// Tasks keep a reference to the data, so they can finish on their own. No signal is emitted.
+	for (RunningPreGeneration &pg : _running_pre_generations) {
+		pg.progress->cancellation_token.cancel();
+	}
+	_running_pre_generations.clear();
+}
+
 bool VoxelLodTerrain::is_area_meshed(const Box3i &box_in_voxels, unsigned int lod_index) const {
-	const Box3i box_in_blocks = box_in_voxels.downscaled(1 << (get_mesh_block_size_pow2() + lod_index));
+	const Box3i box_in_blocks = box_in_voxels.downscaled(1 << (get_lod_mesh_block_size_pow2(lod_index) + lod_index));
 	// We have to check this separate map instead of the mesh map, because the mesh map will not contain blocks in areas
 	// that have no mesh (one reason is so it reduces the time it takes to update all mesh positions when the terrain is
 	// moved)
@@ -2624,6 +3288,7 @@ void VoxelLodTerrain::set_streaming_system(StreamingSystem v) {
 		return;
 	}
 	_update_data->settings.streaming_system = system;
+	update_lod_mesh_block_sizes(are_lod_mesh_block_sizes_supported());
 	_on_stream_params_changed();
 #ifdef TOOLS_ENABLED
 	notify_property_list_changed();
@@ -2635,7 +3300,7 @@ void VoxelLodTerrain::set_voxel_bounds(Box3i p_box) {
 	Box3i bounds_in_voxels =
 			p_box.clipped(Box3i::from_center_extents(Vector3i(), Vector3iUtil::create(constants::MAX_VOLUME_EXTENT)));
 
-	const int octree_size = get_mesh_block_size() << (get_lod_count() - 1);
+	const int octree_size = get_lod_mesh_block_size(get_lod_count() - 1) << (get_lod_count() - 1);
 
 	// Clamp smallest size
 	// TODO If mesh block size is set AFTER bounds, this will break when small bounds are used...
@@ -2683,6 +3348,104 @@ float VoxelLodTerrain::get_lod_fade_duration() const {
 	return _lod_fade_duration;
 }
 
+void VoxelLodTerrain::set_lod_hysteresis_margin(int margin_blocks) {
+	_update_data->settings.lod_hysteresis_margin = math::clamp(margin_blocks, 0, 8);
+}
+
+int VoxelLodTerrain::get_lod_hysteresis_margin() const {
+	return _update_data->settings.lod_hysteresis_margin;
+}
+
+void VoxelLodTerrain::set_lod_hysteresis_cache_duration(float seconds) {
+	const uint32_t duration_msec = static_cast<uint32_t>(math::clamp(seconds, 0.f, 10.f) * 1000.f);
+	_update_data->settings.lod_hysteresis_cache_duration_msec = duration_msec;
+	if (duration_msec == 0) {
+		clear_recently_unloaded_mesh_blocks();
+	}
+}
+
+float VoxelLodTerrain::get_lod_hysteresis_cache_duration() const {
+	return static_cast<float>(_update_data->settings.lod_hysteresis_cache_duration_msec) / 1000.f;
+}
+
+void VoxelLodTerrain::set_lod_hysteresis_cache_max_blocks(int max_blocks) {
+	ERR_FAIL_COND(max_blocks < 0);
+	_lod_hysteresis_cache_max_blocks = max_blocks;
+}
+
+int VoxelLodTerrain::get_lod_hysteresis_cache_max_blocks() const {
+	return _lod_hysteresis_cache_max_blocks;
+}
+
+void VoxelLodTerrain::set_horizon_enabled(bool enabled) {
+	if (enabled == _horizon_enabled) {
+		return;
+	}
+	_horizon_enabled = enabled;
+	if (!enabled) {
+		_horizon.clear();
+	}
+}
+
+bool VoxelLodTerrain::is_horizon_enabled() const {
+	return _horizon_enabled;
+}
+
+void VoxelLodTerrain::set_horizon_distance(int distance_in_voxels) {
+	ERR_FAIL_COND(distance_in_voxels <= 0);
+	_horizon_settings.distance = distance_in_voxels;
+}
+
+int VoxelLodTerrain::get_horizon_distance() const {
+	return _horizon_settings.distance;
+}
+
+void VoxelLodTerrain::set_horizon_resolution(int resolution) {
+	_horizon_settings.resolution = math::clamp(resolution, 2, 1024);
+}
+
+int VoxelLodTerrain::get_horizon_resolution() const {
+	return _horizon_settings.resolution;
+}
+
+void VoxelLodTerrain::set_horizon_min_height(float min_height) {
+	_horizon_settings.min_height = min_height;
+}
+
+float VoxelLodTerrain::get_horizon_min_height() const {
+	return _horizon_settings.min_height;
+}
+
+void VoxelLodTerrain::set_horizon_max_height(float max_height) {
+	_horizon_settings.max_height = max_height;
+}
+
+float VoxelLodTerrain::get_horizon_max_height() const {
+	return _horizon_settings.max_height;
+}
+
+void VoxelLodTerrain::set_horizon_material(Ref<Material> material) {
+	_horizon_material = material;
+	_horizon.set_material(material);
+}
+
+Ref<Material> VoxelLodTerrain::get_horizon_material() const {
+	return _horizon_material;
+}
+
+void VoxelLodTerrain::process_horizon() {
+	if (Engine::get_singleton()->is_editor_hint() && !_update_data->settings.run_stream_in_editor) {
+		return;
+	}
+	if (_horizon_settings.max_height <= _horizon_settings.min_height) {
+		return;
+	}
+	VoxelLodTerrainHorizon::Settings settings = _horizon_settings;
+	// Voxel blocks cover the inside
+	settings.inner_distance = get_view_distance();
+	_horizon.update(get_local_viewer_pos(), settings, get_generator());
+}
+
 void VoxelLodTerrain::set_normalmap_enabled(bool enable) {
 	_update_data->settings.detail_texture_settings.enabled = enable;
 }
@@ -2736,9 +3499,18 @@ bool VoxelLodTerrain::get_octahedral_normal_encoding() const {
 	return _update_data->settings.detail_texture_settings.octahedral_encoding_enabled;
 }
 
+void VoxelLodTerrain::set_normalmap_bc5_compression_enabled(bool enable) {
+	_update_data->settings.detail_texture_settings.bc5_compression_enabled = enable;
+}
+
+bool VoxelLodTerrain::is_normalmap_bc5_compression_enabled() const {
+	return _update_data->settings.detail_texture_settings.bc5_compression_enabled;
+}
+
 void VoxelLodTerrain::set_normalmap_generator_override(Ref<VoxelGenerator> generator_override) {
 	_update_data->wait_for_end_of_task();
 	_update_data->settings.detail_texture_generator_override = generator_override;
+	_update_data->detail_texture_tile_cache->clear();
 }
 
 Ref<VoxelGenerator> VoxelLodTerrain::get_normalmap_generator_override() const {
@@ -2773,6 +3545,23 @@ bool VoxelLodTerrain::get_generator_use_gpu() const {
 	return _update_data->settings.generator_use_gpu;
 }
 
+void VoxelLodTerrain::set_cache_generated_blocks(bool enabled) {
+	_update_data->settings.cache_generated_blocks = enabled;
+}
+
+bool VoxelLodTerrain::get_cache_generated_blocks() const {
+	return _update_data->settings.cache_generated_blocks;
+}
+
+void VoxelLodTerrain::set_cache_memory_budget_mb(int mb) {
+	ERR_FAIL_COND(mb < 0);
+	_data->set_cache_memory_budget(static_cast<uint64_t>(mb) * 1024 * 1024);
+}
+
+int VoxelLodTerrain::get_cache_memory_budget_mb() const {
+	return _data->get_cache_memory_budget() / (1024 * 1024);
+}
+
 #ifdef TOOLS_ENABLED
 
 void VoxelLodTerrain::get_configuration_warnings(PackedStringArray &warnings) const {
@@ -2792,6 +3581,14 @@ void VoxelLodTerrain::get_configuration_warnings(PackedStringArray &warnings) co
 
 	Ref<VoxelMesher> mesher = get_mesher();
 
+	if (get_lod_mesh_block_sizes().size() > 0 && !are_lod_mesh_block_sizes_supported()) {
+		warnings.append(
+				String("`lod_mesh_block_sizes` is set, but it is ignored when using octree streaming or a {0}. "
+					   "`mesh_block_size` will be used at every LOD.")
+						.format(varray(ZN_CLASS_NAME_C(VoxelInstancer)))
+		);
+	}
+
 	// Material
 	Ref<ShaderMaterial> shader_material = _material;
 	if (shader_material.is_valid() && shader_material->get_shader().is_null()) {
@@ -2831,7 +3628,10 @@ void VoxelLodTerrain::get_configuration_warnings(PackedStringArray &warnings) co
 			} else {
 				Ref<Shader> shader = shader_material->get_shader();
 				if (shader.is_valid()) {
-					if (!shader_has_uniform(**shader, VoxelStringNames::get_singleton().u_transition_mask)) {
+					const VoxelStringNames &sn = VoxelStringNames::get_singleton();
+					const bool instance_uniforms = shader_has_instance_uniform(**shader, sn.u_transition_mask);
+
+					if (!instance_uniforms && !shader_has_uniform(**shader, sn.u_transition_mask)) {
 						warnings.append(ZN_TTR("The current mesher ({0}) requires to use shader with specific "
 											   "uniforms. Missing: {1}")
 												.format(
@@ -2839,6 +3639,18 @@ void VoxelLodTerrain::get_configuration_warnings(PackedStringArray &warnings) co
 															   VoxelStringNames::get_singleton().u_transition_mask)
 												));
 					}
+
+					if (instance_uniforms) {
+						// Per-block parameters are all set as instance uniforms
+						const StringName per_block_uniforms[] = { sn.u_lod_fade, sn.u_block_local_transform };
+						for (const StringName &name : per_block_uniforms) {
+							if (shader_has_uniform(**shader, name)) {
+								warnings.append(String("The shader declares `{0}` as `instance uniform`, so `{1}` must "
+													   "be declared as `instance uniform` too.")
+														.format(varray(sn.u_transition_mask, name)));
+							}
+						}
+					}
 				}
 			}
 		}
@@ -2854,7 +3666,9 @@ void VoxelLodTerrain::get_configuration_warnings(PackedStringArray &warnings) co
 					warnings.append(String("Lod fading is enabled but the current material is missing a shader.")
 											.format(varray(ShaderMaterial::get_class_static())));
 				} else {
-					if (!shader_has_uniform(**shader, VoxelStringNames::get_singleton().u_lod_fade)) {
+					const StringName &u_lod_fade = VoxelStringNames::get_singleton().u_lod_fade;
+					if (!shader_has_uniform(**shader, u_lod_fade) &&
+						!shader_has_instance_uniform(**shader, u_lod_fade)) {
 						warnings.append(ZN_TTR("Lod fading is enabled but it requires to use a specific shader "
 											   "uniform. Missing: {0}")
 												.format(varray(VoxelStringNames::get_singleton().u_lod_fade)));
@@ -2927,7 +3741,7 @@ void VoxelLodTerrain::get_configuration_warnings(PackedStringArray &warnings) co
 
 Ref<VoxelSaveCompletionTracker> VoxelLodTerrain::_b_save_modified_blocks() {
 	std::shared_ptr<AsyncDependencyTracker> tracker = make_shared_instance<AsyncDependencyTracker>();
-	save_all_modified_blocks(true, tracker);
+	save_all_modified_blocks(tracker);
 	ZN_ASSERT_RETURN_V(tracker != nullptr, Ref<VoxelSaveCompletionTracker>());
 	return VoxelSaveCompletionTracker::create(tracker);
 }
@@ -2952,14 +3766,13 @@ Array VoxelLodTerrain::debug_raycast_mesh_block(Vector3 world_origin, Vector3 wo
 	const float step = 2.f;
 	float distance = 0.f;
 	const unsigned int lod_count = get_lod_count();
-	const unsigned int mesh_block_size_po2 = _update_data->settings.mesh_block_size_po2;
 
 	Array hits;
 	while (distance < max_distance && hits.size() == 0) {
 		const Vector3i posi = math::floor_to_int(pos);
 		for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 			const VoxelMeshMap<VoxelMeshBlockVLT> &mesh_map = _mesh_maps_per_lod[lod_index];
-			const Vector3i bpos = (posi << mesh_block_size_po2) >> lod_index;
+			const Vector3i bpos = posi >> (get_lod_mesh_block_size_pow2(lod_index) + lod_index);
 			const VoxelMeshBlockVLT *block = mesh_map.get_block(bpos);
 			if (block != nullptr && block->is_visible() && block->has_mesh()) {
 				Dictionary d;
@@ -3023,8 +3836,9 @@ Dictionary VoxelLodTerrain::debug_get_mesh_block_info(Vector3 fbpos, int lod_ind
 		{
 			const VoxelLodTerrainUpdateData::Lod &lod = _update_data->state.lods[lod_index];
 			RWLockRead rlock(lod.mesh_map_state.map_lock);
-			recomputed_transition_mask =
-					VoxelLodTerrainUpdateTask::get_transition_mask(_update_data->state, bpos, lod_index, lod_count);
+			recomputed_transition_mask = VoxelLodTerrainUpdateTask::get_transition_mask(
+					_update_data->state, _update_data->settings, bpos, lod_index, lod_count
+			);
 			auto it = lod.mesh_map_state.map.find(bpos);
 			if (it != lod.mesh_map_state.map.end()) {
 				mesh_state = it->second.state;
@@ -3302,9 +4116,10 @@ void VoxelLodTerrain::update_gizmos() {
 			for (auto mesh_it = lod.mesh_map_state.map.begin(); mesh_it != lod.mesh_map_state.map.end(); ++mesh_it) {
 				const VoxelLodTerrainUpdateData::MeshBlockState &ms = mesh_it->second;
 				if (ms.visual_active) {
-					const int size = mesh_block_size << lod_index;
+					const int lod_mesh_block_size = get_lod_mesh_block_size(lod_index);
+					const int size = lod_mesh_block_size << lod_index;
 					const Vector3i bpos = mesh_it->first;
-					const Vector3i voxel_pos = mesh_block_size * (bpos << lod_index);
+					const Vector3i voxel_pos = lod_mesh_block_size * (bpos << lod_index);
 					const Transform3D local_transform(Basis().scaled(Vector3(size, size, size)), voxel_pos);
 					const Transform3D t = parent_transform * local_transform;
 					// Squaring because lower lod indexes are more interesting to see, so we give them more contrast.
@@ -3320,7 +4135,7 @@ void VoxelLodTerrain::update_gizmos() {
 		for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 			const VoxelMeshMap<VoxelMeshBlockVLT> &mesh_map = _mesh_maps_per_lod[lod_index];
 
-			const int lod_block_size = mesh_block_size << lod_index;
+			const int lod_block_size = get_lod_mesh_block_size(lod_index) << lod_index;
 
 			mesh_map.for_each_block([lod_block_size, &parent_transform, &dr](const VoxelMeshBlockVLT &block) {
 				Color8 color;
@@ -3348,7 +4163,7 @@ void VoxelLodTerrain::update_gizmos() {
 		for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 			const VoxelMeshMap<VoxelMeshBlockVLT> &mesh_map = _mesh_maps_per_lod[lod_index];
 
-			const int lod_block_size = mesh_block_size << lod_index;
+			const int lod_block_size = get_lod_mesh_block_size(lod_index) << lod_index;
 
 			mesh_map.for_each_block([lod_block_size, &parent_transform, &dr](const VoxelMeshBlockVLT &block) {
 				Color8 color;
@@ -3377,7 +4192,7 @@ void VoxelLodTerrain::update_gizmos() {
 
 		for (const VoxelLodTerrainUpdateData::PairedViewer &paired_viewer : state.clipbox_streaming.paired_viewers) {
 			for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
-				const int lod_mesh_block_size = mesh_block_size << lod_index;
+				const int lod_mesh_block_size = get_lod_mesh_block_size(lod_index) << lod_index;
 				const Box3i box = paired_viewer.state.mesh_box_per_lod[lod_index];
 				const Transform3D lt(
 						Basis().scaled(to_vec3(box.size * lod_mesh_block_size)),
@@ -3414,9 +4229,9 @@ void VoxelLodTerrain::update_gizmos() {
 	for (unsigned int i = 0; i < _debug_mesh_update_items.size();) {
 		DebugMeshUpdateItem &item = _debug_mesh_update_items[i];
 
+		const int item_block_size = get_lod_mesh_block_size(item.lod) << item.lod;
 		const Transform3D local_transform(
-				Basis().scaled(to_vec3(Vector3iUtil::create(mesh_block_size << item.lod))),
-				to_vec3(item.position * (mesh_block_size << item.lod))
+				Basis().scaled(to_vec3(Vector3iUtil::create(item_block_size))), to_vec3(item.position * item_block_size)
 		);
 
 		const Transform3D t = parent_transform * local_transform;
@@ -3589,6 +4404,12 @@ bool VoxelLodTerrain::_b_is_area_meshed(AABB aabb, int lod_index) const {
 	return is_area_meshed(Box3i(aabb.position, aabb.size), lod_index);
 }
 
+int VoxelLodTerrain::_b_pre_generate_box_async(AABB voxel_box, bool save_to_stream) {
+	return pre_generate_box_async(
+			Box3i(math::round_to_int(voxel_box.position), math::round_to_int(voxel_box.size)), save_to_stream
+	);
+}
+
 void VoxelLodTerrain::_bind_methods() {
 	using Self = VoxelLodTerrain;
 
@@ -3630,6 +4451,37 @@ void VoxelLodTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_lod_fade_duration"), &Self::get_lod_fade_duration);
 	ClassDB::bind_method(D_METHOD("set_lod_fade_duration", "seconds"), &Self::set_lod_fade_duration);
 
+	ClassDB::bind_method(D_METHOD("get_lod_hysteresis_margin"), &Self::get_lod_hysteresis_margin);
+	ClassDB::bind_method(D_METHOD("set_lod_hysteresis_margin", "margin"), &Self::set_lod_hysteresis_margin);
+
+	ClassDB::bind_method(D_METHOD("get_lod_hysteresis_cache_duration"), &Self::get_lod_hysteresis_cache_duration);
+	ClassDB::bind_method(
+			D_METHOD("set_lod_hysteresis_cache_duration", "seconds"), &Self::set_lod_hysteresis_cache_duration
+	);
+
+	ClassDB::bind_method(D_METHOD("get_lod_hysteresis_cache_max_blocks"), &Self::get_lod_hysteresis_cache_max_blocks);
+	ClassDB::bind_method(
+			D_METHOD("set_lod_hysteresis_cache_max_blocks", "max_blocks"), &Self::set_lod_hysteresis_cache_max_blocks
+	);
+
+	ClassDB::bind_method(D_METHOD("set_horizon_enabled", "enabled"), &Self::set_horizon_enabled);
+	ClassDB::bind_method(D_METHOD("is_horizon_enabled"), &Self::is_horizon_enabled);
+
+	ClassDB::bind_method(D_METHOD("set_horizon_distance", "distance"), &Self::set_horizon_distance);
+	ClassDB::bind_method(D_METHOD("get_horizon_distance"), &Self::get_horizon_distance);
+
+	ClassDB::bind_method(D_METHOD("set_horizon_resolution", "resolution"), &Self::set_horizon_resolution);
+	ClassDB::bind_method(D_METHOD("get_horizon_resolution"), &Self::get_horizon_resolution);
+
+	ClassDB::bind_method(D_METHOD("set_horizon_min_height", "min_height"), &Self::set_horizon_min_height);
+	ClassDB::bind_method(D_METHOD("get_horizon_min_height"), &Self::get_horizon_min_height);
+
+	ClassDB::bind_method(D_METHOD("set_horizon_max_height", "max_height"), &Self::set_horizon_max_height);
+	ClassDB::bind_method(D_METHOD("get_horizon_max_height"), &Self::get_horizon_max_height);
+
+	ClassDB::bind_method(D_METHOD("set_horizon_material", "material"), &Self::set_horizon_material);
+	ClassDB::bind_method(D_METHOD("get_horizon_material"), &Self::get_horizon_material);
+
 	ClassDB::bind_method(D_METHOD("set_lod_count", "lod_count"), &Self::set_lod_count);
 	ClassDB::bind_method(D_METHOD("get_lod_count"), &Self::get_lod_count);
 
@@ -3656,6 +4508,11 @@ void VoxelLodTerrain::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD("is_area_meshed", "area_in_voxels", "lod_index"), &Self::_b_is_area_meshed);
 
+	ClassDB::bind_method(
+			D_METHOD("pre_generate_box_async", "voxel_box", "save_to_stream"), &Self::_b_pre_generate_box_async
+	);
+	ClassDB::bind_method(D_METHOD("cancel_pre_generate_box", "request_id"), &Self::cancel_pre_generate_box);
+
 	// Normalmaps
 
 	ClassDB::bind_method(D_METHOD("set_normalmap_enabled", "enabled"), &Self::set_normalmap_enabled);
@@ -3682,6 +4539,11 @@ void VoxelLodTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_octahedral_normal_encoding", "enabled"), &Self::set_octahedral_normal_encoding);
 	ClassDB::bind_method(D_METHOD("get_octahedral_normal_encoding"), &Self::get_octahedral_normal_encoding);
 
+	ClassDB::bind_method(
+			D_METHOD("set_normalmap_bc5_compression_enabled", "enabled"), &Self::set_normalmap_bc5_compression_enabled
+	);
+	ClassDB::bind_method(D_METHOD("is_normalmap_bc5_compression_enabled"), &Self::is_normalmap_bc5_compression_enabled);
+
 	ClassDB::bind_method(
 			D_METHOD("set_normalmap_generator_override", "generator_override"), &Self::set_normalmap_generator_override
 	);
@@ -3704,11 +4566,16 @@ void VoxelLodTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_mesh_block_size"), &Self::get_mesh_block_size);
 	ClassDB::bind_method(D_METHOD("set_mesh_block_size"), &Self::set_mesh_block_size);
 
+	ClassDB::bind_method(D_METHOD("get_lod_mesh_block_sizes"), &Self::get_lod_mesh_block_sizes);
+	ClassDB::bind_method(D_METHOD("set_lod_mesh_block_sizes", "sizes"), &Self::set_lod_mesh_block_sizes);
+	ClassDB::bind_method(D_METHOD("get_lod_mesh_block_size", "lod_index"), &Self::get_lod_mesh_block_size);
+
 	ClassDB::bind_method(D_METHOD("get_data_block_size"), &Self::get_data_block_size);
 	ClassDB::bind_method(D_METHOD("get_data_block_region_extent"), &Self::get_data_block_region_extent);
 
 	ClassDB::bind_method(D_METHOD("set_full_load_mode_enabled"), &Self::set_full_load_mode_enabled);
 	ClassDB::bind_method(D_METHOD("is_full_load_mode_enabled"), &Self::is_full_load_mode_enabled);
+	ClassDB::bind_method(D_METHOD("get_full_load_progress"), &Self::get_full_load_progress);
 
 	ClassDB::bind_method(D_METHOD("set_threaded_update_enabled", "enabled"), &Self::set_threaded_update_enabled);
 	ClassDB::bind_method(D_METHOD("is_threaded_update_enabled"), &Self::is_threaded_update_enabled);
@@ -3719,12 +4586,19 @@ void VoxelLodTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_generator_use_gpu", "enabled"), &Self::set_generator_use_gpu);
 	ClassDB::bind_method(D_METHOD("get_generator_use_gpu"), &Self::get_generator_use_gpu);
 
+	ClassDB::bind_method(D_METHOD("set_cache_generated_blocks", "enabled"), &Self::set_cache_generated_blocks);
+	ClassDB::bind_method(D_METHOD("get_cache_generated_blocks"), &Self::get_cache_generated_blocks);
+
+	ClassDB::bind_method(D_METHOD("set_cache_memory_budget_mb", "mb"), &Self::set_cache_memory_budget_mb);
+	ClassDB::bind_method(D_METHOD("get_cache_memory_budget_mb"), &Self::get_cache_memory_budget_mb);
+
 	ClassDB::bind_method(D_METHOD("set_streaming_system", "system"), &Self::set_streaming_system);
 	ClassDB::bind_method(D_METHOD("get_streaming_system"), &Self::get_streaming_system);
 
 	// Debug
 
 	ClassDB::bind_method(D_METHOD("get_statistics"), &Self::_b_get_statistics);
+	ClassDB::bind_method(D_METHOD("get_memory_breakdown"), &Self::_b_get_memory_breakdown);
 
 	ClassDB::bind_method(D_METHOD("debug_raycast_mesh_block", "origin", "dir"), &Self::debug_raycast_mesh_block);
 	ClassDB::bind_method(D_METHOD("debug_get_data_block_info", "block_pos", "lod"), &Self::debug_get_data_block_info);
@@ -3781,6 +4655,21 @@ void VoxelLodTerrain::_bind_methods() {
 			"get_secondary_lod_distance"
 	);
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "lod_fade_duration"), "set_lod_fade_duration", "get_lod_fade_duration");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "lod_hysteresis_margin", PROPERTY_HINT_RANGE, "0,8,1"),
+			"set_lod_hysteresis_margin",
+			"get_lod_hysteresis_margin"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::FLOAT, "lod_hysteresis_cache_duration", PROPERTY_HINT_RANGE, "0,10,0.01"),
+			"set_lod_hysteresis_cache_duration",
+			"get_lod_hysteresis_cache_duration"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "lod_hysteresis_cache_max_blocks", PROPERTY_HINT_RANGE, "0,4096,1,or_greater"),
+			"set_lod_hysteresis_cache_max_blocks",
+			"get_lod_hysteresis_cache_max_blocks"
+	);
 
 	ADD_GROUP("Material", "");
 	ADD_PROPERTY(
@@ -3796,6 +4685,38 @@ void VoxelLodTerrain::_bind_methods() {
 			"get_material"
 	);
 
+	ADD_GROUP("Horizon", "horizon_");
+
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "horizon_enabled"), "set_horizon_enabled", "is_horizon_enabled");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "horizon_distance"), "set_horizon_distance", "get_horizon_distance");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "horizon_resolution", PROPERTY_HINT_RANGE, "2,1024,1"),
+			"set_horizon_resolution",
+			"get_horizon_resolution"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::FLOAT, "horizon_min_height"),
+			"set_horizon_min_height",
+			"get_horizon_min_height"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::FLOAT, "horizon_max_height"),
+			"set_horizon_max_height",
+			"get_horizon_max_height"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(
+					Variant::OBJECT,
+					"horizon_material",
+					PROPERTY_HINT_RESOURCE_TYPE,
+					String("{0},{1}").format(
+							varray(BaseMaterial3D::get_class_static(), ShaderMaterial::get_class_static())
+					)
+			),
+			"set_horizon_material",
+			"get_horizon_material"
+	);
+
 	ADD_GROUP("Detail normalmaps", "normalmap_");
 
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "normalmap_enabled"), "set_normalmap_enabled", "is_normalmap_enabled");
@@ -3824,6 +4745,11 @@ void VoxelLodTerrain::_bind_methods() {
 			"set_octahedral_normal_encoding",
 			"get_octahedral_normal_encoding"
 	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "normalmap_bc5_compression_enabled"),
+			"set_normalmap_bc5_compression_enabled",
+			"is_normalmap_bc5_compression_enabled"
+	);
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "normalmap_use_gpu"), "set_normalmap_use_gpu", "get_normalmap_use_gpu");
 
 	ADD_GROUP("Collisions", "");
@@ -3860,6 +4786,11 @@ void VoxelLodTerrain::_bind_methods() {
 			"is_stream_running_in_editor"
 	);
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "mesh_block_size"), "set_mesh_block_size", "get_mesh_block_size");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::PACKED_INT32_ARRAY, "lod_mesh_block_sizes"),
+			"set_lod_mesh_block_sizes",
+			"get_lod_mesh_block_sizes"
+	);
 	ADD_PROPERTY(
 			PropertyInfo(Variant::BOOL, "full_load_mode_enabled"),
 			"set_full_load_mode_enabled",
@@ -3871,6 +4802,16 @@ void VoxelLodTerrain::_bind_methods() {
 			"is_threaded_update_enabled"
 	);
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_gpu_generation"), "set_generator_use_gpu", "get_generator_use_gpu");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::BOOL, "cache_generated_blocks"),
+			"set_cache_generated_blocks",
+			"get_cache_generated_blocks"
+	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "cache_memory_budget_mb", PROPERTY_HINT_RANGE, "0,65536,1,or_greater"),
+			"set_cache_memory_budget_mb",
+			"get_cache_memory_budget_mb"
+	);
 	ADD_PROPERTY(
 			PropertyInfo(Variant::INT, "streaming_system", PROPERTY_HINT_ENUM, "Octree (legacy),Clipbox"),
 			"set_streaming_system",
@@ -3912,6 +4853,23 @@ void VoxelLodTerrain::_bind_methods() {
 			"debug_set_draw_shadow_occluders",
 			"debug_get_draw_shadow_occluders"
 	);
+
+	ADD_SIGNAL(MethodInfo("async_edit_batch_completed", PropertyInfo(Variant::INT, "batch_id")));
+	ADD_SIGNAL(MethodInfo(
+			"floating_chunks_separated",
+			PropertyInfo(Variant::INT, "request_id"),
+			PropertyInfo(Variant::ARRAY, "bodies")
+	));
+	ADD_SIGNAL(MethodInfo(
+			"pre_generate_box_progress",
+			PropertyInfo(Variant::INT, "request_id"),
+			PropertyInfo(Variant::FLOAT, "progress")
+	));
+	ADD_SIGNAL(MethodInfo(
+			"pre_generate_box_completed",
+			PropertyInfo(Variant::INT, "request_id"),
+			PropertyInfo(Variant::BOOL, "cancelled")
+	));
 }
 
 } // namespace zylann::voxel
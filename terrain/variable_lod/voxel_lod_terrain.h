@@ -1,16 +1,21 @@
 #ifndef VOXEL_LOD_TERRAIN_HPP
 #define VOXEL_LOD_TERRAIN_HPP
 
+#include "../../edition/async_edit_queue.h"
 #include "../../engine/voxel_engine.h"
 #include "../../meshers/mesh_block_task.h"
+#include "../../storage/pre_generate_box_task.h"
 #include "../../storage/voxel_data.h"
 #include "../../util/containers/std_map.h"
+#include "../../util/containers/std_queue.h"
 #include "../../util/containers/std_unordered_map.h"
 #include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/packed_arrays.h"
 #include "../voxel_mesh_map.h"
 #include "../voxel_node.h"
 #include "lod_octree.h"
 #include "shader_material_pool_vlt.h"
+#include "voxel_lod_terrain_horizon.h"
 #include "voxel_lod_terrain_update_data.h"
 #include "voxel_mesh_block_vlt.h"
 
@@ -89,8 +94,22 @@ public:
 	unsigned int get_mesh_block_size() const;
 	void set_mesh_block_size(unsigned int mesh_block_size);
 
+	// Mesh block sizes can be configured per LOD, so far LODs can use fewer, bigger meshes. Only supported with clipbox
+	// streaming and without VoxelInstancer, other cases use `mesh_block_size` at every LOD.
+	// Sizes are given starting from LOD0. 0 or a missing value means the same size as the previous LOD (or
+	// `mesh_block_size` for LOD0). Sizes are adjusted so they don't decrease, and at most double from one LOD to the
+	// next.
+	void set_lod_mesh_block_sizes(PackedInt32Array sizes);
+	PackedInt32Array get_lod_mesh_block_sizes() const;
+
+	// Mesh block size effectively used at a given LOD
+	unsigned int get_lod_mesh_block_size_pow2(unsigned int lod_index) const;
+	unsigned int get_lod_mesh_block_size(unsigned int lod_index) const;
+
 	void set_full_load_mode_enabled(bool enabled);
 	bool is_full_load_mode_enabled() const;
+	// From 0 to 1, how much of the stream has been loaded when full load mode is enabled
+	float get_full_load_progress() const;
 
 	void set_threaded_update_enabled(bool enabled);
 	bool is_threaded_update_enabled() const;
@@ -101,6 +120,9 @@ public:
 	void set_octahedral_normal_encoding(bool enable);
 	bool get_octahedral_normal_encoding() const;
 
+	void set_normalmap_bc5_compression_enabled(bool enable);
+	bool is_normalmap_bc5_compression_enabled() const;
+
 	void set_normalmap_tile_resolution_min(int resolution);
 	int get_normalmap_tile_resolution_min() const;
 
@@ -125,14 +147,37 @@ public:
 	void set_generator_use_gpu(bool enabled);
 	bool get_generator_use_gpu() const;
 
+	void set_cache_generated_blocks(bool enabled);
+	bool get_cache_generated_blocks() const;
+
+	void set_cache_memory_budget_mb(int mb);
+	int get_cache_memory_budget_mb() const;
+
 	// These must be called after an edit
 	void post_edit_area(Box3i p_box, bool update_mesh);
 	void post_edit_modifiers(Box3i p_voxel_box);
 
 	// TODO This still sucks atm cuz the edit will still run on the main thread
-	void push_async_edit(IThreadedTask *task, Box3i box, std::shared_ptr<AsyncDependencyTracker> tracker);
+	void push_async_edit(
+			IThreadedTask *task,
+			Box3i box,
+			std::shared_ptr<AsyncDependencyTracker> tracker,
+			uint32_t batch_id = 0
+	);
 	void abort_async_edits();
 
+	// Queues an edit to be applied on a thread along with other edits made during the same frame. Returns the ID of
+	// the batch it is part of, which is passed to the `async_edit_batch_completed` signal once applied.
+	uint32_t push_async_edit_op(UniquePtr<IAsyncEditOp> op);
+	void flush_async_edit_queue();
+
+	// Generates blocks missing in a box on threads, at every LOD, without blocking. Progress is reported with the
+	// `pre_generate_box_progress` signal, and completion with `pre_generate_box_completed`. Returns an ID identifying
+	// the request in these signals.
+	uint32_t pre_generate_box_async(Box3i voxel_box, bool save_to_stream);
+	// Remaining blocks of the request won't be generated. Blocks already generated are kept.
+	void cancel_pre_generate_box(uint32_t request_id);
+
 	void set_voxel_bounds(Box3i p_box);
 
 	inline Box3i get_voxel_bounds() const {
@@ -146,6 +191,35 @@ public:
 	void set_lod_fade_duration(float seconds);
 	float get_lod_fade_duration() const;
 
+	void set_lod_hysteresis_margin(int margin_blocks);
+	int get_lod_hysteresis_margin() const;
+
+	void set_lod_hysteresis_cache_duration(float seconds);
+	float get_lod_hysteresis_cache_duration() const;
+
+	void set_lod_hysteresis_cache_max_blocks(int max_blocks);
+	int get_lod_hysteresis_cache_max_blocks() const;
+
+	// Horizon: heightmap mesh showing terrain beyond the area covered by voxel blocks
+
+	void set_horizon_enabled(bool enabled);
+	bool is_horizon_enabled() const;
+
+	void set_horizon_distance(int distance_in_voxels);
+	int get_horizon_distance() const;
+
+	void set_horizon_resolution(int resolution);
+	int get_horizon_resolution() const;
+
+	void set_horizon_min_height(float min_height);
+	float get_horizon_min_height() const;
+
+	void set_horizon_max_height(float max_height);
+	float get_horizon_max_height() const;
+
+	void set_horizon_material(Ref<Material> material);
+	Ref<Material> get_horizon_material() const;
+
 	enum ProcessCallback { //
 		PROCESS_CALLBACK_IDLE = 0,
 		PROCESS_CALLBACK_PHYSICS,
@@ -167,6 +241,10 @@ public:
 	struct Stats {
 		// Amount of octree nodes waiting for data. It should reach zero when everything is loaded.
 		uint32_t blocked_lods = 0;
+		// How many octrees were walked in the last update, because the viewer got close to a split or join distance
+		uint32_t updated_octrees = 0;
+		// How many octree nodes had their split or join distance checked in the last update
+		uint32_t checked_octree_nodes = 0;
 		// How many data blocks were rejected this frame (due to loading too late for example).
 		uint32_t dropped_block_loads = 0;
 		// How many mesh blocks were rejected this frame (due to loading too late for example).
@@ -180,6 +258,20 @@ public:
 		// Total time spent in the last update task, in microseconds.
 		// This only includes the threadable part, not the whole `process` function.
 		uint32_t time_update_task = 0;
+		// Data blocks requested ahead of viewers based on their velocity
+		uint32_t prefetched_blocks = 0;
+		// Prefetched blocks that were already loaded when viewers got close enough to need them
+		uint32_t prefetch_hits = 0;
+		// Prefetched blocks that were still loading when viewers got close enough to need them
+		uint32_t prefetch_misses = 0;
+		// Prefetched blocks whose loading was cancelled because viewers took a different direction
+		uint32_t prefetch_cancelled = 0;
+		// Mesh blocks that were loaded again shortly after being unloaded
+		uint32_t thrashed_mesh_blocks = 0;
+		// Mesh blocks that were shown again from the cache of recently unloaded blocks instead of being remeshed
+		uint32_t restored_mesh_blocks = 0;
+		// Mesh blocks currently kept in the cache of recently unloaded blocks
+		uint32_t cached_mesh_blocks = 0;
 	};
 
 	const Stats &get_stats() const;
@@ -300,6 +392,11 @@ private:
 	void stop_streamer();
 	void reset_maps();
 	void reset_mesh_maps();
+	void restore_recently_unloaded_mesh_blocks(unsigned int lod_index);
+	void schedule_deferred_mesh_optimizations(unsigned int lod_index, uint64_t now_msec);
+	void uncache_recently_unloaded_mesh_blocks(unsigned int lod_index);
+	void remove_expired_recently_unloaded_mesh_blocks(uint64_t now_msec);
+	void clear_recently_unloaded_mesh_blocks();
 
 	Vector3 get_local_viewer_pos() const;
 	void _set_lod_count(int p_lod_count);
@@ -308,11 +405,17 @@ private:
 	void _on_stream_params_changed();
 
 	void update_shader_material_pool_template();
+	Ref<ShaderMaterial> copy_block_shader_material_for_fading(Ref<ShaderMaterial> block_material);
+	Ref<ShaderMaterial> get_or_create_own_shader_material(VoxelMeshBlockVLT &block);
 
-	void save_all_modified_blocks(bool with_copy, std::shared_ptr<AsyncDependencyTracker> tracker);
+	void save_all_modified_blocks(std::shared_ptr<AsyncDependencyTracker> tracker);
 
 	void process_deferred_collision_updates(uint32_t timeout_msec);
 	void process_fading_blocks(float delta);
+	void process_pre_generations();
+	void process_horizon();
+	void rebuild_missing_lod_mips();
+	void abort_pre_generations();
 
 	struct LocalCameraInfo {
 		Vector3 position;
@@ -321,6 +424,9 @@ private:
 
 	LocalCameraInfo get_local_camera_info() const;
 
+	void update_lod_mesh_block_sizes(bool allow_non_uniform);
+	bool are_lod_mesh_block_sizes_supported() const;
+
 	Ref<VoxelSaveCompletionTracker> _b_save_modified_blocks();
 	void _b_set_voxel_bounds(AABB aabb);
 	AABB _b_get_voxel_bounds() const;
@@ -332,8 +438,10 @@ private:
 	int /*Error*/ _b_debug_dump_as_scene(String fpath, bool include_instancer) const;
 
 	bool _b_is_area_meshed(AABB aabb, int lod_index) const;
+	int _b_pre_generate_box_async(AABB voxel_box, bool save_to_stream);
 
 	Dictionary _b_get_statistics() const;
+	Dictionary _b_get_memory_breakdown() const;
 
 #ifdef TOOLS_ENABLED
 	void update_gizmos();
@@ -371,6 +479,8 @@ private:
 		Ref<ShaderMaterial> shader_material;
 		// Going from 1 to 0
 		float progress;
+		// If true, fading is set with a per-instance uniform, and the material may be shared with blocks
+		bool shader_instance_uniforms = false;
 	};
 
 	// These are "fire and forget"
@@ -383,12 +493,34 @@ private:
 	int _collision_update_delay = 0;
 	FixedArray<StdVector<Vector3i>, constants::MAX_LOD> _deferred_collision_updates_per_lod;
 
+	// Mesh blocks whose mesher skipped optimizations (see `VoxelMesherTransvoxel::set_mesh_optimization_deferred`),
+	// and when they were received. They are meshed again with optimizations if they don't change for a while.
+	FixedArray<StdUnorderedMap<Vector3i, uint64_t>, constants::MAX_LOD> _deferred_mesh_optimizations_per_lod;
+
 	float _lod_fade_duration = 0.f;
 	// Note, direct pointers to mesh blocks should be safe because these blocks are always destroyed from the same
 	// thread that updates fading blocks. If a mesh block is destroyed, these maps should be updated at the same time.
 	// TODO Optimization: use FlatMap? Need to check how many blocks get in there, probably not many
 	FixedArray<StdMap<Vector3i, VoxelMeshBlockVLT *>, constants::MAX_LOD> _fading_blocks_per_lod;
 
+	// Mesh blocks unloaded by clipbox streaming are kept hidden here for a short time, so they can be restored without
+	// remeshing if viewers need them again.
+	struct RecentlyUnloadedMeshBlocks {
+		// Time at which each position was unloaded, including positions that had no mesh
+		StdUnorderedMap<Vector3i, uint64_t> unload_times_msec;
+		VoxelMeshMap<VoxelMeshBlockVLT> blocks;
+	};
+	FixedArray<RecentlyUnloadedMeshBlocks, constants::MAX_LOD> _recently_unloaded_mesh_blocks_per_lod;
+	struct RecentlyUnloadedMeshBlockRecord {
+		Vector3i position;
+		uint8_t lod_index;
+		uint64_t time_msec;
+	};
+	// All LODs in order of unloading, to remove the oldest blocks first. Records of blocks restored or removed in the
+	// meantime are skipped when they come up.
+	StdQueue<RecentlyUnloadedMeshBlockRecord> _recently_unloaded_mesh_blocks_queue;
+	unsigned int _lod_hysteresis_cache_max_blocks = 256;
+
 	struct FadingDetailTexture {
 		Vector3i block_position;
 		uint32_t lod_index;
@@ -397,23 +529,52 @@ private:
 
 	StdVector<FadingDetailTexture> _fading_detail_textures;
 
+	bool _horizon_enabled = false;
+	// The inner distance is taken from the view distance when updating
+	VoxelLodTerrainHorizon::Settings _horizon_settings;
+	Ref<Material> _horizon_material;
+	VoxelLodTerrainHorizon _horizon;
+
 	VoxelInstancer *_instancer = nullptr;
 
 	Ref<VoxelMesher> _mesher;
 
+	// Mesh block sizes requested per LOD, as powers of two. 0 means the same as the previous LOD. Effective sizes are
+	// in `VoxelLodTerrainUpdateData::Settings`.
+	FixedArray<uint8_t, constants::MAX_LOD> _requested_lod_mesh_block_size_po2;
+
 	// Data stored with a shared pointer so it can be sent to asynchronous tasks
 	bool _threaded_update_enabled = false;
+	// In full load mode, whether loaded blocks were checked for missing LOD mips since loading started
+	bool _missing_lod_mips_checked = false;
 	std::shared_ptr<VoxelData> _data;
 	std::shared_ptr<VoxelLodTerrainUpdateData> _update_data;
 	std::shared_ptr<StreamingDependency> _streaming_dependency;
+	// Edits queued during the current frame. Only accessed on the main thread.
+	AsyncEditQueue _async_edit_queue;
+
+	struct RunningPreGeneration {
+		uint32_t id;
+		uint32_t reported_finished_task_count;
+		std::shared_ptr<PreGenerateBoxTask::Progress> progress;
+	};
+	// Only accessed on the main thread
+	StdVector<RunningPreGeneration> _running_pre_generations;
+	uint32_t _next_pre_generation_id = 1;
 	std::shared_ptr<MeshingDependency> _meshing_dependency;
 
 	struct ApplyMeshUpdateTask : public ITimeSpreadTask {
 		void run(TimeSpreadTaskContext &ctx) override;
 
+		float get_order_hint() const override {
+			return viewer_distance_squared;
+		}
+
 		VolumeID volume_id;
 		VoxelLodTerrain *self = nullptr;
 		VoxelEngine::BlockMeshOutput data;
+		// Meshes closer to viewers are applied first
+		float viewer_distance_squared = 0.f;
 	};
 
 	FixedArray<StdUnorderedMap<Vector3i, RefCount>, constants::MAX_LOD> _queued_main_thread_mesh_updates;
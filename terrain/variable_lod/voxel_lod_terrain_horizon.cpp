@@ -0,0 +1,358 @@
+#include "voxel_lod_terrain_horizon.h"
+#include "../../engine/voxel_engine.h"
+#include "../../meshers/mesh_block_task.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../util/godot/core/packed_arrays.h"
+#include "../../util/math/funcs.h"
+#include "../../util/math/vector2f.h"
+#include "../../util/memory/memory.h"
+#include "../../util/profiling.h"
+#include "../../util/tasks/threaded_task.h"
+
+namespace zylann::voxel {
+
+namespace {
+
+class HorizonUpdateTask : public IThreadedTask {
+public:
+	HorizonUpdateTask(
+			Ref<VoxelGenerator> p_generator,
+			std::shared_ptr<const VoxelLodTerrainHorizon::Heightmap> p_previous,
+			std::shared_ptr<VoxelLodTerrainHorizon::TaskOutput> p_output,
+			float p_inner_distance
+	) :
+			_generator(p_generator), _previous(p_previous), _output(p_output), _inner_distance(p_inner_distance) {}
+
+	const char *get_debug_name() const override {
+		return "HorizonUpdate";
+	}
+
+	void run(ThreadedTaskContext &ctx) override {
+		ZN_PROFILE_SCOPE();
+		ZN_ASSERT_RETURN(_generator.is_valid());
+		ZN_ASSERT_RETURN(_output != nullptr);
+		VoxelLodTerrainHorizon::Heightmap &heightmap = *_output->heightmap;
+		VoxelLodTerrainHorizon::update_heightmap(heightmap, _previous.get(), **_generator);
+		_output->surface = VoxelLodTerrainHorizon::build_mesh_arrays(heightmap, _inner_distance);
+		_output->complete = true;
+	}
+
+	TaskPriority get_priority() override {
+		// Distant scenery, anything else viewers are waiting on should come first
+		return TaskPriority(0, 0, 0, 0);
+	}
+
+private:
+	Ref<VoxelGenerator> _generator;
+	std::shared_ptr<const VoxelLodTerrainHorizon::Heightmap> _previous;
+	std::shared_ptr<VoxelLodTerrainHorizon::TaskOutput> _output;
+	float _inner_distance;
+};
+
+} // namespace
+
+void VoxelLodTerrainHorizon::update_heightmap(
+		Heightmap &heightmap,
+		const Heightmap *previous,
+		VoxelGenerator &generator
+) {
+	ZN_PROFILE_SCOPE();
+
+	const int vertex_count_per_side = heightmap.get_vertex_count_per_side();
+	heightmap.heights.resize(vertex_count_per_side * vertex_count_per_side);
+
+	const bool reuse_previous = previous != nullptr && heightmap.is_compatible(*previous);
+
+	// Columns whose height has to be found
+	StdVector<unsigned int> column_indices;
+	StdVector<float> positions_x;
+	StdVector<float> positions_z;
+
+	for (int z = 0; z < vertex_count_per_side; ++z) {
+		for (int x = 0; x < vertex_count_per_side; ++x) {
+			const unsigned int index = x + z * vertex_count_per_side;
+			const Vector2i cell = heightmap.origin_in_cells + Vector2i(x, z);
+
+			if (reuse_previous) {
+				const int previous_size = previous->get_vertex_count_per_side();
+				const Vector2i previous_cell = cell - previous->origin_in_cells;
+				if (previous_cell.x >= 0 && previous_cell.y >= 0 && previous_cell.x < previous_size &&
+					previous_cell.y < previous_size) {
+					heightmap.heights[index] = previous->heights[previous_cell.x + previous_cell.y * previous_size];
+					continue;
+				}
+			}
+
+			column_indices.push_back(index);
+			positions_x.push_back(cell.x * heightmap.cell_size);
+			positions_z.push_back(cell.y * heightmap.cell_size);
+		}
+	}
+
+	const unsigned int column_count = column_indices.size();
+	if (column_count == 0) {
+		return;
+	}
+
+	// Bisection along Y for all columns at once, so generators can process them in series. This assumes columns cross
+	// the surface once, like a heightmap. Caves and overhangs end up at one of their crossings.
+
+	const float precision = 0.5f;
+	unsigned int iteration_count = 0;
+	for (float range = heightmap.max_height - heightmap.min_height; range > precision; range *= 0.5f) {
+		++iteration_count;
+	}
+
+	StdVector<float> lows;
+	StdVector<float> highs;
+	StdVector<float> positions_y;
+	StdVector<float> sdf_values;
+	lows.resize(column_count, heightmap.min_height);
+	highs.resize(column_count, heightmap.max_height);
+	positions_y.resize(column_count);
+	sdf_values.resize(column_count);
+
+	Vector3f min_pos(positions_x[0], heightmap.min_height, positions_z[0]);
+	Vector3f max_pos = min_pos;
+	for (unsigned int i = 0; i < column_count; ++i) {
+		min_pos.x = math::min(min_pos.x, positions_x[i]);
+		min_pos.z = math::min(min_pos.z, positions_z[i]);
+		max_pos.x = math::max(max_pos.x, positions_x[i]);
+		max_pos.z = math::max(max_pos.z, positions_z[i]);
+	}
+
+	const bool use_series = generator.supports_series_generation();
+
+	for (unsigned int iteration = 0; iteration < iteration_count; ++iteration) {
+		min_pos.y = heightmap.max_height;
+		max_pos.y = heightmap.min_height;
+		for (unsigned int i = 0; i < column_count; ++i) {
+			const float y = 0.5f * (lows[i] + highs[i]);
+			positions_y[i] = y;
+			min_pos.y = math::min(min_pos.y, y);
+			max_pos.y = math::max(max_pos.y, y);
+		}
+
+		if (use_series) {
+			generator.generate_series(
+					to_span(positions_x),
+					to_span(positions_y),
+					to_span(positions_z),
+					VoxelBuffer::CHANNEL_SDF,
+					to_span(sdf_values),
+					min_pos,
+					max_pos
+			);
+		} else {
+			for (unsigned int i = 0; i < column_count; ++i) {
+				const Vector3i pos(
+						static_cast<int>(Math::round(positions_x[i])),
+						static_cast<int>(Math::round(positions_y[i])),
+						static_cast<int>(Math::round(positions_z[i]))
+				);
+				sdf_values[i] = generator.generate_single(pos, VoxelBuffer::CHANNEL_SDF).f;
+			}
+		}
+
+		for (unsigned int i = 0; i < column_count; ++i) {
+			if (sdf_values[i] < 0.f) {
+				// Below the surface
+				lows[i] = positions_y[i];
+			} else {
+				highs[i] = positions_y[i];
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < column_count; ++i) {
+		heightmap.heights[column_indices[i]] = 0.5f * (lows[i] + highs[i]);
+	}
+}
+
+Array VoxelLodTerrainHorizon::build_mesh_arrays(const Heightmap &heightmap, float inner_distance) {
+	ZN_PROFILE_SCOPE();
+
+	const int resolution = heightmap.resolution;
+	const int vertex_count_per_side = heightmap.get_vertex_count_per_side();
+	const float cell_size = heightmap.cell_size;
+	const unsigned int vertex_count = vertex_count_per_side * vertex_count_per_side;
+	ZN_ASSERT_RETURN_V(heightmap.heights.size() == vertex_count, Array());
+
+	const float half_extent = 0.5f * resolution * cell_size;
+	const Vector2f min_pos(heightmap.origin_in_cells.x * cell_size, heightmap.origin_in_cells.y * cell_size);
+	const Vector2f center = min_pos + Vector2f(half_extent, half_extent);
+
+	PackedInt32Array indices;
+	for (int z = 0; z < resolution; ++z) {
+		for (int x = 0; x < resolution; ++x) {
+			const Vector2f cell_min = min_pos + Vector2f(x, z) * cell_size;
+			const Vector2f cell_max = cell_min + Vector2f(cell_size, cell_size);
+			if (cell_min.x >= center.x - inner_distance && cell_max.x <= center.x + inner_distance &&
+				cell_min.y >= center.y - inner_distance && cell_max.y <= center.y + inner_distance) {
+				// Covered by voxel blocks
+				continue;
+			}
+			const int i00 = x + z * vertex_count_per_side;
+			const int i10 = i00 + 1;
+			const int i01 = i00 + vertex_count_per_side;
+			const int i11 = i01 + 1;
+			indices.push_back(i00);
+			indices.push_back(i10);
+			indices.push_back(i01);
+			indices.push_back(i10);
+			indices.push_back(i11);
+			indices.push_back(i01);
+		}
+	}
+
+	if (indices.size() == 0) {
+		return Array();
+	}
+
+	PackedVector3Array positions;
+	PackedVector3Array normals;
+	positions.resize(vertex_count);
+	normals.resize(positions.size());
+	Vector3 *positions_w = positions.ptrw();
+	Vector3 *normals_w = normals.ptrw();
+
+	const StdVector<float> &heights = heightmap.heights;
+
+	for (int z = 0; z < vertex_count_per_side; ++z) {
+		for (int x = 0; x < vertex_count_per_side; ++x) {
+			const int i = x + z * vertex_count_per_side;
+			positions_w[i] = Vector3(min_pos.x + x * cell_size, heights[i], min_pos.y + z * cell_size);
+
+			// Central differences, one-sided on borders
+			const int x0 = math::max(x - 1, 0);
+			const int x1 = math::min(x + 1, resolution);
+			const int z0 = math::max(z - 1, 0);
+			const int z1 = math::min(z + 1, resolution);
+			const float dx = (heights[x1 + z * vertex_count_per_side] - heights[x0 + z * vertex_count_per_side]) /
+					((x1 - x0) * cell_size);
+			const float dz = (heights[x + z1 * vertex_count_per_side] - heights[x + z0 * vertex_count_per_side]) /
+					((z1 - z0) * cell_size);
+			normals_w[i] = Vector3(-dx, 1.f, -dz).normalized();
+		}
+	}
+
+	Array arrays;
+	arrays.resize(Mesh::ARRAY_MAX);
+	arrays[Mesh::ARRAY_VERTEX] = positions;
+	arrays[Mesh::ARRAY_NORMAL] = normals;
+	arrays[Mesh::ARRAY_INDEX] = indices;
+	return arrays;
+}
+
+VoxelLodTerrainHorizon::VoxelLodTerrainHorizon() {}
+
+VoxelLodTerrainHorizon::~VoxelLodTerrainHorizon() {}
+
+void VoxelLodTerrainHorizon::update(
+		Vector3 viewer_local_position,
+		const Settings &settings,
+		Ref<VoxelGenerator> generator
+) {
+	ZN_PROFILE_SCOPE();
+
+	if (_pending_output != nullptr) {
+		if (!_pending_output->complete) {
+			return;
+		}
+		apply_task_output(*_pending_output);
+		_pending_output.reset();
+	}
+
+	if (generator.is_null()) {
+		return;
+	}
+	ZN_ASSERT_RETURN(settings.resolution > 0);
+	ZN_ASSERT_RETURN(settings.distance > 0);
+
+	// Snap to cells so vertices don't move with the viewer, only new columns appear
+	const float cell_size = 2.f * settings.distance / settings.resolution;
+	const int half_resolution = settings.resolution / 2;
+	const Vector2i origin_in_cells(
+			static_cast<int>(Math::floor(viewer_local_position.x / cell_size)) - half_resolution,
+			static_cast<int>(Math::floor(viewer_local_position.z / cell_size)) - half_resolution
+	);
+
+	if (_heightmap != nullptr && _settings == settings && _heightmap->origin_in_cells == origin_in_cells) {
+		return;
+	}
+	_settings = settings;
+
+	std::shared_ptr<Heightmap> heightmap = make_shared_instance<Heightmap>();
+	heightmap->origin_in_cells = origin_in_cells;
+	heightmap->cell_size = cell_size;
+	heightmap->resolution = settings.resolution;
+	heightmap->min_height = settings.min_height;
+	heightmap->max_height = settings.max_height;
+
+	std::shared_ptr<TaskOutput> output = make_shared_instance<TaskOutput>();
+	output->heightmap = heightmap;
+	_pending_output = output;
+
+	HorizonUpdateTask *task = ZN_NEW(HorizonUpdateTask(generator, _heightmap, output, settings.inner_distance));
+	VoxelEngine::get_singleton().push_async_task(task);
+}
+
+void VoxelLodTerrainHorizon::apply_task_output(TaskOutput &output) {
+	ZN_PROFILE_SCOPE();
+
+	_heightmap = output.heightmap;
+
+	Ref<ArrayMesh> mesh = build_mesh(output.surface);
+
+	if (!_mesh_instance.is_valid()) {
+		if (mesh.is_null()) {
+			return;
+		}
+		_mesh_instance.create();
+		_mesh_instance.set_world(_world);
+		_mesh_instance.set_transform(_transform);
+		_mesh_instance.set_material_override(_material);
+		_mesh_instance.set_visible(_visible);
+		// Shadows would hardly be visible at such distances
+		_mesh_instance.set_cast_shadows_setting(RenderingServer::SHADOW_CASTING_SETTING_OFF);
+	}
+
+	_mesh_instance.set_mesh(mesh);
+}
+
+void VoxelLodTerrainHorizon::clear() {
+	// The running task will complete into an output nobody reads
+	_pending_output.reset();
+	_heightmap.reset();
+	_mesh_instance.destroy();
+}
+
+void VoxelLodTerrainHorizon::set_world(World3D *world) {
+	_world = world;
+	if (_mesh_instance.is_valid()) {
+		_mesh_instance.set_world(world);
+	}
+}
+
+void VoxelLodTerrainHorizon::set_transform(Transform3D transform) {
+	_transform = transform;
+	if (_mesh_instance.is_valid()) {
+		_mesh_instance.set_transform(transform);
+	}
+}
+
+void VoxelLodTerrainHorizon::set_visible(bool visible) {
+	_visible = visible;
+	if (_mesh_instance.is_valid()) {
+		_mesh_instance.set_visible(visible);
+	}
+}
+
+void VoxelLodTerrainHorizon::set_material(Ref<Material> material) {
+	_material = material;
+	if (_mesh_instance.is_valid()) {
+		_mesh_instance.set_material_override(material);
+	}
+}
+
+} // namespace zylann::voxel
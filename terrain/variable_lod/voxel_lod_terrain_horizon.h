@@ -0,0 +1,115 @@
+#ifndef VOXEL_LOD_TERRAIN_HORIZON_H
+#define VOXEL_LOD_TERRAIN_HORIZON_H
+
+#include "../../generators/voxel_generator.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/classes/material.h"
+#include "../../util/godot/core/array.h"
+#include "../../util/godot/direct_mesh_instance.h"
+#include "../../util/math/transform_3d.h"
+#include "../../util/math/vector2i.h"
+#include "../../util/math/vector3.h"
+#include <atomic>
+#include <memory>
+
+namespace zylann::voxel {
+
+// Cheap representation of terrain beyond the area covered by voxel blocks of `VoxelLodTerrain`, so views can reach the
+// horizon without raising LOD count. It is a single heightmap mesh following the viewer, with a hole in the middle
+// where voxel blocks are. Heights are found by querying the generator on a thread, so edits are not represented.
+// When the viewer moves, heights of columns the previous heightmap already covered are reused.
+class VoxelLodTerrainHorizon {
+public:
+	struct Settings {
+		// Half-size of the area covered by the heightmap, in voxels
+		int distance = 16384;
+		// Number of cells along each side of the heightmap
+		int resolution = 128;
+		// Half-size of the area left empty in the middle, in voxels
+		int inner_distance = 512;
+		// Heights are searched within this range. Columns entirely inside or outside the ground get clamped to it.
+		float min_height = -512.f;
+		float max_height = 512.f;
+
+		inline bool operator==(const Settings &other) const {
+			return distance == other.distance && resolution == other.resolution &&
+					inner_distance == other.inner_distance && min_height == other.min_height &&
+					max_height == other.max_height;
+		}
+
+		inline bool operator!=(const Settings &other) const {
+			return !(*this == other);
+		}
+	};
+
+	struct Heightmap {
+		// Position of the first vertex, in cells
+		Vector2i origin_in_cells;
+		float cell_size = 1.f;
+		// Number of cells along each side. There is one more vertex.
+		unsigned int resolution = 0;
+		float min_height = 0.f;
+		float max_height = 0.f;
+		// Indexed by X + Z * (resolution + 1)
+		StdVector<float> heights;
+
+		inline unsigned int get_vertex_count_per_side() const {
+			return resolution + 1;
+		}
+
+		// Tells if heights of `other` can be reused for this heightmap where they overlap
+		inline bool is_compatible(const Heightmap &other) const {
+			return cell_size == other.cell_size && min_height == other.min_height && max_height == other.max_height;
+		}
+	};
+
+	// Finds heights of the surface in every column of the heightmap, where the generator's SDF crosses zero. Columns
+	// also found in `previous` are copied instead, if it is compatible. `previous` may be null.
+	static void update_heightmap(Heightmap &heightmap, const Heightmap *previous, VoxelGenerator &generator);
+
+	// Returns surface arrays (see `Mesh::ARRAY_MAX`) of a mesh following the heightmap, without cells fully inside the
+	// square of half-size `inner_distance` centered on it. Returns an empty array if there is no cell to draw.
+	static Array build_mesh_arrays(const Heightmap &heightmap, float inner_distance);
+
+	VoxelLodTerrainHorizon();
+	~VoxelLodTerrainHorizon();
+
+	// Applies results of the last update if it completed, and schedules a new one if the viewer moved to another
+	// cell or settings changed. Must be called from the main thread.
+	void update(Vector3 viewer_local_position, const Settings &settings, Ref<VoxelGenerator> generator);
+
+	// Removes the mesh. Results of updates still running will be dropped.
+	void clear();
+
+	void set_world(World3D *world);
+	void set_transform(Transform3D transform);
+	void set_visible(bool visible);
+	void set_material(Ref<Material> material);
+
+	// Written by an update task, read by the main thread once `complete` is true
+	struct TaskOutput {
+		std::atomic_bool complete = { false };
+		std::shared_ptr<Heightmap> heightmap;
+		Array surface;
+	};
+
+private:
+	void apply_task_output(TaskOutput &output);
+
+	Settings _settings;
+	// Heightmap of the current mesh, reused by the next update
+	std::shared_ptr<const Heightmap> _heightmap;
+	// Only one update runs at a time
+	std::shared_ptr<TaskOutput> _pending_output;
+
+	zylann::godot::DirectMeshInstance _mesh_instance;
+	// Kept so they can be applied when the mesh instance gets created
+	World3D *_world = nullptr;
+	Transform3D _transform;
+	Ref<Material> _material;
+	bool _visible = true;
+};
+
+} // namespace zylann::voxel
+
+#endif // VOXEL_LOD_TERRAIN_HORIZON_H
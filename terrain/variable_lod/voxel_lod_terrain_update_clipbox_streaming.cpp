@@ -1,9 +1,11 @@
 #include "voxel_lod_terrain_update_clipbox_streaming.h"
 #include "../../util/containers/std_unordered_set.h"
+#include "../../util/godot/classes/time.h"
 #include "../../util/math/conv.h"
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "voxel_lod_terrain_update_task.h"
+#include <algorithm>
 
 // #include <fstream>
 
@@ -54,7 +56,8 @@ Box3i get_base_box_in_chunks(
 		Vector3i viewer_position_voxels,
 		Vector3i distance_voxels,
 		int chunk_size,
-		bool make_even
+		// Min and max coordinates are rounded outwards to a multiple of this (partly required for subdivision rule)
+		int alignment
 ) {
 	// Get min and max positions
 	Vector3i minp = viewer_position_voxels - distance_voxels;
@@ -69,36 +72,40 @@ Box3i get_base_box_in_chunks(
 	minp = math::floordiv(minp, chunk_size);
 	maxp = math::ceildiv(maxp, chunk_size);
 
-	if (make_even) {
-		// Round to be even outwards (partly required for subdivision rule)
+	if (alignment > 1) {
 		// TODO Maybe there is a more clever way to do this
-		minp = math::floordiv(minp, 2) * 2;
-		maxp = math::ceildiv(maxp, 2) * 2;
+		minp = math::floordiv(minp, alignment) * alignment;
+		maxp = math::ceildiv(maxp, alignment) * alignment;
 	}
 
 	return Box3i::from_min_max(minp, maxp);
 }
 
 // Gets the smallest box a parent LOD must have in order to keep respecting the neighboring rule
-Box3i get_minimal_box_for_parent_lod(Box3i child_lod_box, bool make_even) {
+Box3i get_minimal_box_for_parent_lod(Box3i child_lod_box, unsigned int child_to_parent_shift, int parent_alignment) {
 	const int min_pad = 1;
-	// Note, subdivision rule enforces the child box position and size to be even, so it won't round to
-	// zero when converted to the parent LOD's coordinate system.
-	Box3i min_box = Box3i(child_lod_box.position >> 1, child_lod_box.size >> 1)
+	// Note, subdivision rule enforces the child box position and size to be aligned to the number of children per
+	// axis, so it won't round to zero when converted to the parent LOD's coordinate system.
+	Box3i min_box = Box3i(child_lod_box.position >> child_to_parent_shift, child_lod_box.size >> child_to_parent_shift)
 							// Enforce neighboring rule by padding boxes outwards by a minimum amount,
 							// so there is at least N chunks in the current LOD between LOD+1 and LOD-1
 							.padded(min_pad);
 
-	if (make_even) {
-		// Make sure it stays even to respect subdivision rule, rounding outwards
-		min_box = min_box.downscaled(2).scaled(2);
+	if (parent_alignment > 1) {
+		// Make sure it stays aligned to respect subdivision rule, rounding outwards
+		min_box = min_box.downscaled(parent_alignment).scaled(parent_alignment);
 	}
 
 	return min_box;
 }
 
-Box3i enforce_neighboring_rule(Box3i box, const Box3i &child_lod_box, bool make_even) {
-	const Box3i min_box = get_minimal_box_for_parent_lod(child_lod_box, make_even);
+Box3i enforce_neighboring_rule(
+		Box3i box,
+		const Box3i &child_lod_box,
+		unsigned int child_to_parent_shift,
+		int parent_alignment
+) {
+	const Box3i min_box = get_minimal_box_for_parent_lod(child_lod_box, child_to_parent_shift, parent_alignment);
 	box.merge_with(min_box);
 	return box;
 }
@@ -111,25 +118,28 @@ inline int get_lod_distance_in_mesh_chunks(float lod_distance_in_voxels, int mes
 Vector3i get_relative_lod_distance_in_chunks(
 		int lod_index,
 		int lod_count,
-		int lod0_distance_in_chunks,
+		// Distance covered by LOD0, in voxels. Must be a multiple of the size of LOD0 chunks.
+		int lod0_distance_voxels,
+		// Distance covered by each of the following LODs, in chunks of that LOD
 		int lodn_distance_in_chunks,
-		int lod_chunk_size,
+		// Size of chunks of the current LOD, in LOD0 voxels
+		int lod_chunk_size_po2,
 		Vector3i max_view_distance_voxels
 ) {
 	int ld;
 	if (lod_index == 0) {
 		// First LOD uses dedicated distance
-		ld = lod0_distance_in_chunks;
+		ld = lod0_distance_voxels >> lod_chunk_size_po2;
 	} else {
 		// Following LODs use another distance.
 		// The returned distance is relative to chunks of the current LOD so we divide LOD0 distance rather than
 		// multiplying LODN distance
-		ld = (lod0_distance_in_chunks >> lod_index) + lodn_distance_in_chunks;
+		ld = (lod0_distance_voxels >> lod_chunk_size_po2) + lodn_distance_in_chunks;
 	}
 	Vector3i ld3(ld, ld, ld);
 	if (lod_index == lod_count - 1) {
 		// Last LOD may extend all the way to max view distance if possible
-		ld3 = math::max(ld3, math::ceildiv(max_view_distance_voxels, Vector3iUtil::create(lod_chunk_size)));
+		ld3 = math::max(ld3, math::ceildiv(max_view_distance_voxels, Vector3iUtil::create(1 << lod_chunk_size_po2)));
 	}
 	return ld3;
 }
@@ -171,6 +181,9 @@ void process_viewers(
 			for (unsigned int lod_index = 0; lod_index < pv.state.mesh_box_per_lod.size(); ++lod_index) {
 				pv.state.mesh_box_per_lod[lod_index] = Box3i();
 			}
+			for (unsigned int lod_index = 0; lod_index < pv.state.prefetch_box_per_lod.size(); ++lod_index) {
+				pv.state.prefetch_box_per_lod[lod_index] = Box3i();
+			}
 
 			unpaired_viewers_to_remove.push_back(paired_viewer_index);
 		}
@@ -186,17 +199,29 @@ void process_viewers(
 
 	const int data_block_size = 1 << data_block_size_po2;
 
-	const int mesh_block_size = 1 << volume_settings.mesh_block_size_po2;
+	// Size of LOD0 mesh blocks. Following LODs may have bigger ones.
+	const int mesh_block_size = 1 << volume_settings.get_lod_mesh_block_size_po2(0);
 	const int mesh_to_data_factor = mesh_block_size / data_block_size;
 
-	const int lod0_distance_in_mesh_chunks =
-			get_lod_distance_in_mesh_chunks(volume_settings.lod_distance, mesh_block_size);
-	const int lodn_distance_in_mesh_chunks =
-			get_lod_distance_in_mesh_chunks(volume_settings.secondary_lod_distance, mesh_block_size);
+	const int lod_hysteresis_margin = static_cast<int>(volume_settings.lod_hysteresis_margin);
+
+	// Shrinking distances reduces the amount of blocks to load for every LOD, so blocks close to viewers don't wait
+	// behind far ones
+	const float lod0_distance = volume_settings.lod_distance * volume_settings.lod_distance_scale;
+	const float lodn_distance = volume_settings.secondary_lod_distance * volume_settings.lod_distance_scale;
+	const int lod0_distance_voxels = get_lod_distance_in_mesh_chunks(lod0_distance, mesh_block_size) * mesh_block_size;
+
+	// LODs with bigger mesh blocks span fewer of them
+	FixedArray<int, constants::MAX_LOD> lodn_distance_in_mesh_chunks_per_lod;
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		lodn_distance_in_mesh_chunks_per_lod[lod_index] = get_lod_distance_in_mesh_chunks(
+				lodn_distance, 1 << volume_settings.get_lod_mesh_block_size_po2(lod_index)
+		);
+	}
 
 	// Data chunks are driven by mesh chunks, because mesh needs data
-	const int lod0_distance_in_data_chunks = lod0_distance_in_mesh_chunks * mesh_to_data_factor;
-	const int lodn_distance_in_data_chunks = lodn_distance_in_mesh_chunks * mesh_to_data_factor;
+	const int lodn_distance_in_data_chunks =
+			get_lod_distance_in_mesh_chunks(lodn_distance, mesh_block_size) * mesh_to_data_factor;
 
 	// const Box3i volume_bounds_in_data_blocks = volume_bounds_in_voxels.downscaled(1 << data_block_size_po2);
 	// const Box3i volume_bounds_in_mesh_blocks = volume_bounds_in_voxels.downscaled(1 << mesh_block_size_po2);
@@ -263,15 +288,15 @@ void process_viewers(
 			// Meshes are required
 
 			for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
-				const int lod_mesh_block_size_po2 = volume_settings.mesh_block_size_po2 + lod_index;
+				const int lod_mesh_block_size_po2 = volume_settings.get_lod_mesh_block_size_po2(lod_index) + lod_index;
 				const int lod_mesh_block_size = 1 << lod_mesh_block_size_po2;
 
 				const Vector3i ld = get_relative_lod_distance_in_chunks(
 						lod_index,
 						lod_count,
-						lod0_distance_in_mesh_chunks,
-						lodn_distance_in_mesh_chunks,
-						lod_mesh_block_size,
+						lod0_distance_voxels,
+						lodn_distance_in_mesh_chunks_per_lod[lod_index],
+						lod_mesh_block_size_po2,
 						Vector3i(
 								paired_viewer.state.view_distance_voxels.horizontal,
 								paired_viewer.state.view_distance_voxels.vertical,
@@ -282,21 +307,35 @@ void process_viewers(
 				// Box3i new_mesh_box = get_lod_box_in_chunks(
 				// 		paired_viewer.state.local_position_voxels, ld, volume_settings.mesh_block_size_po2, lod_index);
 
-				// Make min and max coordinates even in child LODs, to respect subdivision rule.
-				// Root LOD doesn't need to respect that.
-				const bool even_coordinates_required = (lod_index != lod_count - 1);
+				// Make min and max coordinates multiples of the number of children per axis in child LODs, to respect
+				// subdivision rule. Root LOD doesn't need to respect that.
+				const int alignment =
+						lod_index != lod_count - 1 ? (1 << volume_settings.get_parent_mesh_block_shift(lod_index)) : 1;
 
 				Box3i new_mesh_box = get_base_box_in_chunks(
 						paired_viewer.state.local_position_voxels,
 						// Making sure that distance is a multiple of chunk size, for consistent box size
 						ld * lod_mesh_block_size,
 						lod_mesh_block_size,
-						even_coordinates_required
+						alignment
 				);
 
+				const Box3i &prev_mesh_box = paired_viewer.prev_state.mesh_box_per_lod[lod_index];
+				if (lod_hysteresis_margin > 0 && !prev_mesh_box.is_empty()) {
+					// Hysteresis: keep blocks of the previous box until they are further than the margin, so a viewer
+					// moving back and forth across a boundary doesn't repeatedly unload and reload the same blocks.
+					// The margin has to be aligned too.
+					const int margin = math::ceildiv(lod_hysteresis_margin, alignment) * alignment;
+					const Box3i kept_box = prev_mesh_box.clipped(new_mesh_box.padded(margin));
+					if (!kept_box.is_empty()) {
+						new_mesh_box.merge_with(kept_box);
+					}
+				}
+
 				if (lod_index > 0) {
 					const Box3i &child_box = paired_viewer.state.mesh_box_per_lod[lod_index - 1];
-					new_mesh_box = enforce_neighboring_rule(new_mesh_box, child_box, even_coordinates_required);
+					const unsigned int parent_shift = volume_settings.get_parent_mesh_block_shift(lod_index - 1);
+					new_mesh_box = enforce_neighboring_rule(new_mesh_box, child_box, parent_shift, alignment);
 				}
 
 				paired_viewer.state.mesh_box_per_lod[lod_index] = new_mesh_box;
@@ -304,7 +343,7 @@ void process_viewers(
 
 			// Clip all mesh boxes in a second pass, because `enforce_neighboring_rule` depends on the child LOD box
 			for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
-				const int lod_mesh_block_size_po2 = volume_settings.mesh_block_size_po2 + lod_index;
+				const int lod_mesh_block_size_po2 = volume_settings.get_lod_mesh_block_size_po2(lod_index) + lod_index;
 				const int lod_mesh_block_size = 1 << lod_mesh_block_size_po2;
 				const Box3i volume_bounds_in_mesh_blocks = volume_bounds_in_voxels.downscaled(lod_mesh_block_size);
 
@@ -340,9 +379,11 @@ void process_viewers(
 				// 				.clipped(volume_bounds_in_data_blocks);
 
 				const Box3i &mesh_box = paired_viewer.state.mesh_box_per_lod[lod_index];
+				const int lod_mesh_to_data_shift =
+						volume_settings.get_lod_mesh_block_size_po2(lod_index) - data_block_size_po2;
 
 				const Box3i data_box =
-						Box3i(mesh_box.position * mesh_to_data_factor, mesh_box.size * mesh_to_data_factor)
+						Box3i(mesh_box.position << lod_mesh_to_data_shift, mesh_box.size << lod_mesh_to_data_shift)
 								// To account for meshes requiring neighbor data chunks.
 								// It technically breaks the subdivision rule (where every parent block always has 8
 								// children), but it should only matter in areas where meshes must actually spawn
@@ -369,9 +410,9 @@ void process_viewers(
 				const Vector3i ld = get_relative_lod_distance_in_chunks(
 						lod_index,
 						lod_count,
-						lod0_distance_in_data_chunks,
+						lod0_distance_voxels,
 						lodn_distance_in_data_chunks,
-						lod_data_block_size,
+						lod_data_block_size_po2,
 						Vector3i(
 								paired_viewer.state.view_distance_voxels.horizontal,
 								paired_viewer.state.view_distance_voxels.vertical,
@@ -387,7 +428,7 @@ void process_viewers(
 								lod_data_block_size,
 								// Make min and max coordinates even in child LODs, to respect subdivision rule.
 								// Root LOD doesn't need to respect that,
-								lod_index != lod_count - 1
+								lod_index != lod_count - 1 ? 2 : 1
 						)
 								.clipped(volume_bounds_in_data_blocks);
 
@@ -398,6 +439,35 @@ void process_viewers(
 				paired_viewer.state.data_box_per_lod[lod_index] = new_data_box;
 			}
 		}
+
+		// Data boxes moved to where the viewer is predicted to be. Blocks in them get loaded ahead of time, and if the
+		// viewer turns, the boxes move away and loads that haven't completed get cancelled. Only lower LODs usually
+		// get one, since the predicted motion has to span at least one block.
+		const Vector3i prefetch_position_voxels = math::floor_to_int(
+				local_position + world_to_local_transform.basis.xform(viewer.get_prefetch_offset())
+		);
+
+		for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+			const int lod_data_block_size_po2 = data_block_size_po2 + lod_index;
+
+			const Vector3i prefetch_block_offset = (prefetch_position_voxels >> lod_data_block_size_po2) -
+					(paired_viewer.state.local_position_voxels >> lod_data_block_size_po2);
+
+			Box3i &prefetch_box = paired_viewer.state.prefetch_box_per_lod[lod_index];
+
+			if (prefetch_block_offset == Vector3i()) {
+				prefetch_box = Box3i();
+				continue;
+			}
+
+			const Box3i volume_bounds_in_data_blocks =
+					Box3i(volume_bounds_in_voxels.position >> lod_data_block_size_po2,
+						  volume_bounds_in_voxels.size >> lod_data_block_size_po2);
+
+			const Box3i &data_box = paired_viewer.state.data_box_per_lod[lod_index];
+			prefetch_box = Box3i(data_box.position + prefetch_block_offset, data_box.size)
+								   .clipped(volume_bounds_in_data_blocks);
+		}
 	}
 }
 
@@ -414,7 +484,8 @@ void remove_unpaired_viewers(
 	}
 }
 
-void add_loading_block(
+// Returns true if the block wasn't already loading
+bool add_loading_block(
 		VoxelLodTerrainUpdateData::Lod &lod,
 		Vector3i position,
 		uint8_t lod_index,
@@ -435,13 +506,17 @@ void add_loading_block(
 				new_loading_block.cancellation_token //
 		});
 
+		return true;
+
 	} else {
 		// Already loaded
 		it->second.viewers.add();
+		return false;
 	}
 }
 
-void unreference_data_block_from_loading_lists(
+// Returns true if the block no longer has to be loaded
+bool unreference_data_block_from_loading_lists(
 		StdUnorderedMap<Vector3i, VoxelLodTerrainUpdateData::LoadingDataBlock> &loading_blocks,
 		StdVector<VoxelLodTerrainUpdateData::BlockToLoad> &data_blocks_to_load,
 		Vector3i bpos,
@@ -451,7 +526,7 @@ void unreference_data_block_from_loading_lists(
 	if (loading_block_it == loading_blocks.end()) {
 		ZN_PRINT_VERBOSE("Request to unview a loading block that was never requested");
 		// Not expected, but fine I guess
-		return;
+		return false;
 	}
 
 	VoxelLodTerrainUpdateData::LoadingDataBlock &loading_block = loading_block_it->second;
@@ -478,6 +553,220 @@ void unreference_data_block_from_loading_lists(
 				break;
 			}
 		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void process_data_box_change(
+		VoxelLodTerrainUpdateData::Lod &lod,
+		VoxelData &data,
+		const int lod_index,
+		const Box3i prev_data_box,
+		const Box3i new_data_box,
+		// Used to measure how well blocks entering the data box were prefetched
+		const Box3i prev_prefetch_box,
+		// The box is a prefetch box instead of a data box. Each of them holds its own reference to blocks.
+		const bool prefetch,
+		const bool can_load,
+		StdVector<VoxelData::BlockToSave> *blocks_to_save,
+		StdVector<VoxelLodTerrainUpdateData::BlockToLoad> &data_blocks_to_load,
+		VoxelLodTerrainUpdateData::Stats &stats
+) {
+	static thread_local StdVector<Vector3i> tls_missing_blocks;
+	static thread_local StdVector<Vector3i> tls_found_blocks_positions;
+
+	// Detect blocks to load.
+	if (can_load) {
+		tls_missing_blocks.clear();
+		tls_found_blocks_positions.clear();
+
+		StdVector<Vector3i> *found_blocks_positions =
+				prev_prefetch_box.is_empty() ? nullptr : &tls_found_blocks_positions;
+
+		new_data_box.difference(prev_data_box, [&data, lod_index, found_blocks_positions](Box3i box_to_load) {
+			data.view_area(box_to_load, lod_index, &tls_missing_blocks, found_blocks_positions, nullptr);
+		});
+
+		for (const Vector3i bpos : tls_found_blocks_positions) {
+			if (prev_prefetch_box.contains(bpos)) {
+				++stats.prefetch_hits;
+			}
+		}
+
+		{
+			ZN_PROFILE_SCOPE_NAMED("Add loading blocks");
+			MutexLock mlock(lod.loading_blocks_mutex);
+			for (const Vector3i bpos : tls_missing_blocks) {
+				if (add_loading_block(lod, bpos, lod_index, data_blocks_to_load)) {
+					if (prefetch) {
+						++stats.prefetched_blocks;
+					}
+				} else if (prev_prefetch_box.contains(bpos)) {
+					++stats.prefetch_misses;
+				}
+			}
+		}
+	}
+
+	// Detect blocks to unload
+	{
+		tls_missing_blocks.clear();
+		tls_found_blocks_positions.clear();
+
+		const unsigned int to_save_index0 = blocks_to_save != nullptr ? blocks_to_save->size() : 0;
+
+		prev_data_box.difference(new_data_box, [&data, blocks_to_save, lod_index](Box3i box_to_remove) {
+			data.unview_area(
+					box_to_remove, lod_index, &tls_found_blocks_positions, &tls_missing_blocks, blocks_to_save
+			);
+		});
+
+		if (blocks_to_save != nullptr && blocks_to_save->size() > to_save_index0) {
+			add_unloaded_saving_blocks(lod, to_span(*blocks_to_save).sub(to_save_index0));
+		}
+
+		// Remove loading blocks regardless of refcount (those were loaded and had their refcount reach
+		// zero)
+		if (tls_found_blocks_positions.size() > 0) {
+			MutexLock mlock(lod.loading_blocks_mutex);
+			for (const Vector3i bpos : tls_found_blocks_positions) {
+				// emit_data_block_unloaded(bpos);
+
+				// TODO If they were loaded, why would they be in loading blocks?
+				// Maybe to make sure they are not in here regardless
+				lod.loading_blocks.erase(bpos);
+			}
+		}
+
+		// Remove refcount from loading blocks, and cancel loading if it reaches zero
+		if (tls_missing_blocks.size() > 0) {
+			MutexLock mlock(lod.loading_blocks_mutex);
+			for (const Vector3i bpos : tls_missing_blocks) {
+				const bool cancelled = unreference_data_block_from_loading_lists(
+						lod.loading_blocks, data_blocks_to_load, bpos, lod_index
+				);
+				if (cancelled && prefetch) {
+					++stats.prefetch_cancelled;
+				}
+			}
+		}
+	}
+}
+
+// Blocks to load and save found in data boxes of one LOD. Each LOD has its own lists so LODs can be processed on
+// different threads.
+struct LodDataBoxChanges {
+	StdVector<VoxelLodTerrainUpdateData::BlockToLoad> blocks_to_load;
+	StdVector<VoxelData::BlockToSave> blocks_to_save;
+	VoxelLodTerrainUpdateData::Stats stats;
+};
+
+inline Box3i get_bounds_in_data_blocks(const Box3i bounds_in_voxels, unsigned int lod_data_block_size_po2) {
+	// Should be correct as long as bounds size is a multiple of the biggest LOD chunk
+	return Box3i(
+			bounds_in_voxels.position >> lod_data_block_size_po2, bounds_in_voxels.size >> lod_data_block_size_po2
+	);
+}
+
+void process_lod_data_blocks_sliding_box(
+		VoxelLodTerrainUpdateData::State &state,
+		VoxelData &data,
+		const unsigned int lod_index,
+		const Box3i bounds_in_data_blocks,
+		const bool can_save,
+		const bool can_load,
+		LodDataBoxChanges &changes
+) {
+	ZN_PROFILE_SCOPE();
+
+	// Each LOD keeps a box of loaded blocks, and only some of the blocks will get polygonized.
+	// The player can edit them so changes can be propagated to lower lods.
+	VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
+	StdVector<VoxelData::BlockToSave> *blocks_to_save = can_save ? &changes.blocks_to_save : nullptr;
+
+	for (const VoxelLodTerrainUpdateData::PairedViewer &paired_viewer : state.clipbox_streaming.paired_viewers) {
+		const Box3i &new_data_box = paired_viewer.state.data_box_per_lod[lod_index];
+		const Box3i &prev_data_box = paired_viewer.prev_state.data_box_per_lod[lod_index];
+
+		if (!new_data_box.intersects(bounds_in_data_blocks) && !prev_data_box.intersects(bounds_in_data_blocks)) {
+			continue;
+		}
+
+		if (prev_data_box != new_data_box) {
+			process_data_box_change(
+					lod,
+					data,
+					lod_index,
+					prev_data_box,
+					new_data_box,
+					paired_viewer.prev_state.prefetch_box_per_lod[lod_index],
+					false,
+					can_load,
+					blocks_to_save,
+					changes.blocks_to_load,
+					changes.stats
+			);
+		}
+
+		// Done after the data box, so blocks going from one box to the other don't get unloaded in between
+		const Box3i &new_prefetch_box = paired_viewer.state.prefetch_box_per_lod[lod_index];
+		const Box3i &prev_prefetch_box = paired_viewer.prev_state.prefetch_box_per_lod[lod_index];
+
+		if (prev_prefetch_box != new_prefetch_box) {
+			process_data_box_change(
+					lod,
+					data,
+					lod_index,
+					prev_prefetch_box,
+					new_prefetch_box,
+					Box3i(),
+					true,
+					can_load,
+					blocks_to_save,
+					changes.blocks_to_load,
+					changes.stats
+			);
+		}
+
+		// Turned this off because I don't remember why I added it. Keeping it in case a bug occurs that could
+		// highlight why it was there.
+		// Was originally added in 17c6b1f557c5abc447cb62c200afcff1298fadff
+		// Perhaps that's in case there was updates pending in the list before we get here, so there needs to be
+		// some way of cancelling them? But with clipbox logic and multiple viewers, that no longer works
+#if 0
+		// TODO Why do we do this here? Sounds like it should be done in the mesh clipbox logic
+		{
+			ZN_PROFILE_SCOPE_NAMED("Cancel updates");
+			// Cancel mesh block updates that are not within the padded region
+			// (since neighbors are always required to remesh)
+
+			// TODO This might break at terrain borders
+			const Box3i padded_new_box = new_data_box.padded(-1);
+			Box3i mesh_box;
+			if (mesh_block_size > data_block_size) {
+				const int factor = mesh_block_size / data_block_size;
+				mesh_box = padded_new_box.downscaled_inner(factor);
+			} else {
+				mesh_box = padded_new_box;
+			}
+
+			unordered_remove_if(lod.mesh_blocks_pending_update,
+					[&lod, mesh_box](const VoxelLodTerrainUpdateData::MeshToUpdate &mtu) {
+						if (mesh_box.contains(mtu.position)) {
+							return false;
+						} else {
+							auto mesh_block_it = lod.mesh_map_state.map.find(mtu.position);
+							if (mesh_block_it != lod.mesh_map_state.map.end()) {
+								mesh_block_it->second.state = VoxelLodTerrainUpdateData::MESH_NEED_UPDATE;
+							}
+							return true;
+						}
+					});
+		}
+#endif
 	}
 }
 
@@ -489,7 +778,8 @@ void process_data_blocks_sliding_box(
 		StdVector<VoxelLodTerrainUpdateData::BlockToLoad> &data_blocks_to_load,
 		const VoxelLodTerrainUpdateData::Settings &settings,
 		int lod_count,
-		bool can_load
+		bool can_load,
+		const ParallelJobsScheduler &scheduler
 ) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT_RETURN_MSG(data.is_streaming_enabled(), "This function is not meant to run in full load mode");
@@ -497,41 +787,17 @@ void process_data_blocks_sliding_box(
 	const int data_block_size_po2 = data.get_block_size_po2();
 	const Box3i bounds_in_voxels = data.get_bounds();
 
-	// const int mesh_to_data_factor = mesh_block_size / data_block_size;
-
-	// const int lod_distance_in_mesh_chunks = get_lod_distance_in_mesh_chunks(settings.lod_distance, mesh_block_size);
-
-	// // Data chunks are driven by mesh chunks, because mesh needs data
-	// const int lod_distance_in_data_chunks = lod_distance_in_mesh_chunks * mesh_to_data_factor
-	// 		// To account for the fact meshes need neighbor data chunks
-	// 		+ 1;
-
-	static thread_local StdVector<Vector3i> tls_missing_blocks;
-	static thread_local StdVector<Vector3i> tls_found_blocks_positions;
+	// Find which LODs have boxes that changed
+	uint32_t changed_lods_mask = 0;
 
+	for (const VoxelLodTerrainUpdateData::PairedViewer &paired_viewer : state.clipbox_streaming.paired_viewers) {
 #ifdef DEV_ENABLED
-	Box3i debug_parent_box;
+		Box3i debug_parent_box;
 #endif
-
-	for (const VoxelLodTerrainUpdateData::PairedViewer &paired_viewer : state.clipbox_streaming.paired_viewers) {
 		// Iterating from big to small LOD so we can exit earlier if bounds don't intersect.
 		for (int lod_index = lod_count - 1; lod_index >= 0; --lod_index) {
-			ZN_PROFILE_SCOPE();
-			VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
-
-			// Each LOD keeps a box of loaded blocks, and only some of the blocks will get polygonized.
-			// The player can edit them so changes can be propagated to lower lods.
-
-			const unsigned int lod_data_block_size_po2 = data_block_size_po2 + lod_index;
-
-			// Should be correct as long as bounds size is a multiple of the biggest LOD chunk
 			const Box3i bounds_in_data_blocks =
-					Box3i(bounds_in_voxels.position >> lod_data_block_size_po2,
-						  bounds_in_voxels.size >> lod_data_block_size_po2);
-
-			// const Box3i new_data_box = get_lod_box_in_chunks(
-			// 		viewer_pos_in_lod0_voxels, lod_distance_in_data_chunks, data_block_size_po2, lod_index)
-			// 								   .clipped(bounds_in_data_blocks);
+					get_bounds_in_data_blocks(bounds_in_voxels, data_block_size_po2 + lod_index);
 
 			const Box3i &new_data_box = paired_viewer.state.data_box_per_lod[lod_index];
 			const Box3i &prev_data_box = paired_viewer.prev_state.data_box_per_lod[lod_index];
@@ -544,126 +810,72 @@ void process_data_blocks_sliding_box(
 			debug_parent_box = new_data_box;
 #endif
 
-			// const Box3i prev_data_box = get_lod_box_in_chunks(
-			// 		state.clipbox_streaming.viewer_pos_in_lod0_voxels_previous_update,
-			// 		state.clipbox_streaming.lod_distance_in_data_chunks_previous_update, data_block_size_po2, lod_index)
-			// 									.clipped(bounds_in_data_blocks);
-
 			if (!new_data_box.intersects(bounds_in_data_blocks) && !prev_data_box.intersects(bounds_in_data_blocks)) {
 				// If this box doesn't intersect either now or before, there is no chance a smaller one will
 				break;
 			}
 
-			if (prev_data_box != new_data_box) {
-				// Detect blocks to load.
-				if (can_load) {
-					tls_missing_blocks.clear();
-
-					new_data_box.difference(prev_data_box, [&data, lod_index](Box3i box_to_load) {
-						data.view_area(box_to_load, lod_index, &tls_missing_blocks, nullptr, nullptr);
-					});
-
-					{
-						ZN_PROFILE_SCOPE_NAMED("Add loading blocks");
-						MutexLock mlock(lod.loading_blocks_mutex);
-						for (const Vector3i bpos : tls_missing_blocks) {
-							add_loading_block(lod, bpos, lod_index, data_blocks_to_load);
-						}
-					}
-				}
-
-				// Detect blocks to unload
-				{
-					tls_missing_blocks.clear();
-					tls_found_blocks_positions.clear();
-
-					const unsigned int to_save_index0 = blocks_to_save != nullptr ? blocks_to_save->size() : 0;
-
-					prev_data_box.difference(new_data_box, [&data, blocks_to_save, lod_index](Box3i box_to_remove) {
-						data.unview_area(
-								box_to_remove,
-								lod_index,
-								&tls_found_blocks_positions,
-								&tls_missing_blocks,
-								blocks_to_save
-						);
-					});
-
-					if (blocks_to_save != nullptr && blocks_to_save->size() > to_save_index0) {
-						add_unloaded_saving_blocks(lod, to_span(*blocks_to_save).sub(to_save_index0));
-					}
-
-					// Remove loading blocks regardless of refcount (those were loaded and had their refcount reach
-					// zero)
-					if (tls_found_blocks_positions.size() > 0) {
-						MutexLock mlock(lod.loading_blocks_mutex);
-						for (const Vector3i bpos : tls_found_blocks_positions) {
-							// emit_data_block_unloaded(bpos);
-
-							// TODO If they were loaded, why would they be in loading blocks?
-							// Maybe to make sure they are not in here regardless
-							lod.loading_blocks.erase(bpos);
-						}
-					}
-
-					// Remove refcount from loading blocks, and cancel loading if it reaches zero
-					if (tls_missing_blocks.size() > 0) {
-						MutexLock mlock(lod.loading_blocks_mutex);
-						for (const Vector3i bpos : tls_missing_blocks) {
-							unreference_data_block_from_loading_lists(
-									lod.loading_blocks, data_blocks_to_load, bpos, lod_index
-							);
-						}
-					}
-				}
+			if (prev_data_box != new_data_box ||
+				paired_viewer.prev_state.prefetch_box_per_lod[lod_index] !=
+						paired_viewer.state.prefetch_box_per_lod[lod_index]) {
+				changed_lods_mask |= (1 << lod_index);
 			}
+		}
+	}
 
-			// Turned this off because I don't remember why I added it. Keeping it in case a bug occurs that could
-			// highlight why it was there.
-			// Was originally added in 17c6b1f557c5abc447cb62c200afcff1298fadff
-			// Perhaps that's in case there was updates pending in the list before we get here, so there needs to be
-			// some way of cancelling them? But with clipbox logic and multiple viewers, that no longer works
-#if 0
-			// TODO Why do we do this here? Sounds like it should be done in the mesh clipbox logic
-			{
-				ZN_PROFILE_SCOPE_NAMED("Cancel updates");
-				// Cancel mesh block updates that are not within the padded region
-				// (since neighbors are always required to remesh)
-
-				// TODO This might break at terrain borders
-				const Box3i padded_new_box = new_data_box.padded(-1);
-				Box3i mesh_box;
-				if (mesh_block_size > data_block_size) {
-					const int factor = mesh_block_size / data_block_size;
-					mesh_box = padded_new_box.downscaled_inner(factor);
-				} else {
-					mesh_box = padded_new_box;
-				}
+	if (changed_lods_mask == 0) {
+		return;
+	}
 
-				unordered_remove_if(lod.mesh_blocks_pending_update,
-						[&lod, mesh_box](const VoxelLodTerrainUpdateData::MeshToUpdate &mtu) {
-							if (mesh_box.contains(mtu.position)) {
-								return false;
-							} else {
-								auto mesh_block_it = lod.mesh_map_state.map.find(mtu.position);
-								if (mesh_block_it != lod.mesh_map_state.map.end()) {
-									mesh_block_it->second.state = VoxelLodTerrainUpdateData::MESH_NEED_UPDATE;
-								}
-								return true;
-							}
-						});
-			}
-#endif
+	FixedArray<uint8_t, constants::MAX_LOD> changed_lods;
+	unsigned int changed_lod_count = 0;
+	for (int lod_index = lod_count - 1; lod_index >= 0; --lod_index) {
+		if ((changed_lods_mask & (1 << lod_index)) != 0) {
+			changed_lods[changed_lod_count] = lod_index;
+			++changed_lod_count;
+		}
+	}
 
-		} // for each lod
-	} // for each viewer
+	// Data boxes of a LOD only reference blocks of that LOD, so LODs can be processed in parallel.
+	// Kept across updates to reuse their memory. Referenced from here, because jobs running on other threads would
+	// otherwise access their own instance.
+	static thread_local FixedArray<LodDataBoxChanges, constants::MAX_LOD> tls_changes_per_lod;
+	FixedArray<LodDataBoxChanges, constants::MAX_LOD> &changes_per_lod = tls_changes_per_lod;
+
+	run_parallel_jobs(changed_lod_count, scheduler, [&](const uint32_t job_index) {
+		const unsigned int lod_index = changed_lods[job_index];
+		LodDataBoxChanges &changes = changes_per_lod[lod_index];
+		changes.blocks_to_load.clear();
+		changes.blocks_to_save.clear();
+		changes.stats = VoxelLodTerrainUpdateData::Stats();
+
+		process_lod_data_blocks_sliding_box(
+				state,
+				data,
+				lod_index,
+				get_bounds_in_data_blocks(bounds_in_voxels, data_block_size_po2 + lod_index),
+				blocks_to_save != nullptr,
+				can_load,
+				changes
+		);
+	});
 
-	// state.clipbox_streaming.lod_distance_in_data_chunks_previous_update = lod_distance_in_data_chunks;
+	for (unsigned int job_index = 0; job_index < changed_lod_count; ++job_index) {
+		const LodDataBoxChanges &changes = changes_per_lod[changed_lods[job_index]];
+		append_array(data_blocks_to_load, changes.blocks_to_load);
+		if (blocks_to_save != nullptr) {
+			append_array(*blocks_to_save, changes.blocks_to_save);
+		}
+		state.stats.prefetched_blocks += changes.stats.prefetched_blocks;
+		state.stats.prefetch_hits += changes.stats.prefetch_hits;
+		state.stats.prefetch_misses += changes.stats.prefetch_misses;
+		state.stats.prefetch_cancelled += changes.stats.prefetch_cancelled;
+	}
 }
 
 // TODO Copypasta from octree streaming file
 VoxelLodTerrainUpdateData::MeshBlockState &insert_new(
-		StdUnorderedMap<Vector3i, VoxelLodTerrainUpdateData::MeshBlockState> &mesh_map,
+		Vector3iSparseGrid<VoxelLodTerrainUpdateData::MeshBlockState> &mesh_map,
 		Vector3i pos
 ) {
 #ifdef DEBUG_ENABLED
@@ -671,31 +883,29 @@ VoxelLodTerrainUpdateData::MeshBlockState &insert_new(
 	static VoxelLodTerrainUpdateData::MeshBlockState s_default;
 	ERR_FAIL_COND_V(mesh_map.find(pos) != mesh_map.end(), s_default);
 #endif
-	// C++ standard says if the element is not present, it will be default-constructed.
-	// So here is how to insert a default, non-movable struct into an unordered_map.
-	// https://stackoverflow.com/questions/22229773/map-unordered-map-with-non-movable-default-constructible-value-type
+	// If the element is not present, it gets default-constructed in place, which is required because
+	// `MeshBlockState` is not movable.
 	VoxelLodTerrainUpdateData::MeshBlockState &block = mesh_map[pos];
-
-	// This approach doesn't compile, had to workaround with the writing [] operator.
-	/*
-	auto p = lod.mesh_map_state.map.emplace(pos, VoxelLodTerrainUpdateData::MeshBlockState());
-	// We got here because the map didn't contain the element. If it did contain it already, that's a bug.
-	CRASH_COND(p.second == false);
-	*/
-
 	return block;
 }
 
-inline Vector3i get_relative_child_position(unsigned int child_index) {
+// Mesh blocks have 2x2x2 children when the parent shift is 1, or 4x4x4 if it is 2 (when the parent LOD has bigger
+// mesh blocks)
+inline unsigned int get_child_count(unsigned int parent_shift) {
+	return 1 << (3 * parent_shift);
+}
+
+inline Vector3i get_relative_child_position(unsigned int child_index, unsigned int parent_shift) {
+	const unsigned int mask = (1 << parent_shift) - 1;
 	return Vector3i( //
-			(child_index & 1), //
-			((child_index & 2) >> 1), //
-			((child_index & 4) >> 2)
+			(child_index & mask), //
+			((child_index >> parent_shift) & mask), //
+			((child_index >> (2 * parent_shift)) & mask)
 	);
 }
 
-inline Vector3i get_child_position(Vector3i parent_position, unsigned int child_index) {
-	return parent_position * 2 + get_relative_child_position(child_index);
+inline Vector3i get_child_position(Vector3i parent_position, unsigned int child_index, unsigned int parent_shift) {
+	return (parent_position << parent_shift) + get_relative_child_position(child_index, parent_shift);
 }
 
 // void hide_children_recursive(
@@ -746,6 +956,14 @@ inline void schedule_mesh_load(
 	// mesh_block.pending_update_has_visuals = require_visual;
 }
 
+// Mesh blocks loaded again within this time after being unloaded are counted as thrashing
+static constexpr uint32_t MESH_THRASH_DETECTION_DURATION_MSEC = 1000;
+
+struct RecentlyUnloadedMeshBlocksParams {
+	uint64_t now_msec;
+	uint32_t cache_duration_msec;
+};
+
 void view_mesh_box(
 		const Box3i box_to_add,
 		VoxelLodTerrainUpdateData::Lod &lod,
@@ -754,7 +972,9 @@ void view_mesh_box(
 		int mesh_to_data_factor,
 		const VoxelData &voxel_data,
 		bool require_visuals,
-		bool require_collisions
+		bool require_collisions,
+		const RecentlyUnloadedMeshBlocksParams &recently_unloaded_params,
+		uint32_t &thrashed_count
 ) {
 	ZN_PROFILE_SCOPE();
 
@@ -767,10 +987,15 @@ void view_mesh_box(
 							  lod_index, //
 							  require_visuals, //
 							  require_collisions, //
-							  bounds_in_data_blocks](Vector3i bpos) {
+							  bounds_in_data_blocks,
+							  &recently_unloaded_params,
+							  &thrashed_count](Vector3i bpos) {
 		VoxelLodTerrainUpdateData::MeshBlockState *mesh_block;
 		auto mesh_block_it = lod.mesh_map_state.map.find(bpos);
 
+		bool restore = false;
+		VoxelLodTerrainUpdateData::RecentlyUnloadedMeshBlock unloaded{ 0, false, false };
+
 		if (mesh_block_it == lod.mesh_map_state.map.end()) {
 			// RWLockWrite wlock(lod.mesh_map_state.map_lock);
 			mesh_block = &insert_new(lod.mesh_map_state.map, bpos);
@@ -781,6 +1006,19 @@ void view_mesh_box(
 			// 	schedule_mesh_load(lod.mesh_blocks_pending_update, bpos, *mesh_block, require_visuals);
 			// }
 
+			auto unloaded_it = lod.recently_unloaded_mesh_blocks.find(bpos);
+			if (unloaded_it != lod.recently_unloaded_mesh_blocks.end()) {
+				unloaded = unloaded_it->second;
+				lod.recently_unloaded_mesh_blocks.erase(unloaded_it);
+				++thrashed_count;
+
+				// The main thread still has the mesh if it was unloaded recently enough, so it can be restored
+				// instead of being built again, as long as it has what the viewer needs
+				restore = recently_unloaded_params.now_msec - unloaded.time_msec <
+								recently_unloaded_params.cache_duration_msec &&
+						(unloaded.visual || !require_visuals) && (unloaded.collision || !require_collisions);
+			}
+
 		} else {
 			mesh_block = &mesh_block_it->second;
 		}
@@ -797,7 +1035,13 @@ void view_mesh_box(
 			mesh_block->collision_viewers.add();
 		}
 
-		if (first_visuals || first_collision) {
+		if (restore) {
+			mesh_block->state = VoxelLodTerrainUpdateData::MESH_UP_TO_DATE;
+			lod.mesh_blocks_to_restore.push_back(
+					VoxelLodTerrainUpdateData::MeshBlockToRestore{ bpos, unloaded.visual, unloaded.collision }
+			);
+
+		} else if (first_visuals || first_collision) {
 			// TODO Optimize: don't schedule again if an update has been sent to the task system with the same options.
 			// Currently we only avoid that for requests in the list before they get sent to the task system.
 			// This could be a problem if many viewers with increasingly different options are spawned in the same area
@@ -879,19 +1123,26 @@ void view_mesh_box(
 	});
 }
 
+// Mesh blocks a viewer stopped viewing. Their parents may have to be shown, which involves two LODs, so it is done once
+// all LODs have been processed.
+struct UnviewedMeshBox {
+	Box3i box;
+	bool visual;
+	bool collision;
+};
+
 void unview_mesh_box(
 		const Box3i out_of_range_box,
 		VoxelLodTerrainUpdateData::Lod &lod,
-		unsigned int lod_index,
-		unsigned int lod_count,
-		VoxelLodTerrainUpdateData::State &state,
 		bool visual_flag,
-		bool collision_flag
+		bool collision_flag,
+		uint64_t now_msec,
+		StdVector<UnviewedMeshBox> &unviewed_boxes
 ) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT_RETURN(collision_flag || visual_flag);
 
-	out_of_range_box.for_each_cell([&lod, visual_flag, collision_flag](Vector3i bpos) {
+	out_of_range_box.for_each_cell([&lod, visual_flag, collision_flag, now_msec](Vector3i bpos) {
 		auto mesh_block_it = lod.mesh_map_state.map.find(bpos);
 
 		if (mesh_block_it != lod.mesh_map_state.map.end()) {
@@ -927,6 +1178,14 @@ void unview_mesh_box(
 				// loaded? That will trigger a reload, but if mesh load is fast, what if the main thread unloads the new
 				// mesh due to the old momentary unload? Very edge case, but keeping a note in case something weird
 				// happens in practice.
+
+				// Remember the block in case a viewer needs it again soon. Its mesh can only be restored if it was
+				// up to date.
+				const bool up_to_date = mesh_block.state == VoxelLodTerrainUpdateData::MESH_UP_TO_DATE;
+				lod.recently_unloaded_mesh_blocks[bpos] = VoxelLodTerrainUpdateData::RecentlyUnloadedMeshBlock{
+					now_msec, up_to_date && mesh_block.visual_loaded, up_to_date && mesh_block.collision_loaded
+				};
+
 				lod.mesh_map_state.map.erase(mesh_block_it);
 				lod.mesh_blocks_to_unload.push_back(bpos);
 
@@ -947,23 +1206,42 @@ void unview_mesh_box(
 		}
 	});
 
-	// Immediately show parent when children are removed.
-	// This is a cheap approach as the parent mesh will be available most of the time.
-	// However, at high speeds, if loading can't keep up, holes and overlaps will start happening in the
-	// opposite direction of movement.
+	unviewed_boxes.push_back(UnviewedMeshBox{ out_of_range_box, visual_flag, collision_flag });
+}
+
+// Immediately show parent when children are removed.
+// This is a cheap approach as the parent mesh will be available most of the time.
+// However, at high speeds, if loading can't keep up, holes and overlaps will start happening in the
+// opposite direction of movement.
+void show_parents_of_unviewed_mesh_box(
+		const UnviewedMeshBox &unviewed_box,
+		unsigned int lod_index,
+		unsigned int lod_count,
+		unsigned int parent_shift,
+		VoxelLodTerrainUpdateData::State &state
+) {
 	const unsigned int parent_lod_index = lod_index + 1;
 	if (parent_lod_index < lod_count) {
+		ZN_PROFILE_SCOPE();
+
+		const Box3i out_of_range_box = unviewed_box.box;
+		const bool visual_flag = unviewed_box.visual;
+		const bool collision_flag = unviewed_box.collision;
+
 		// Should always work without reaching zero size because non-max LODs are always
-		// multiple of 2 due to subdivision rules
-		const Box3i parent_box = Box3i(out_of_range_box.position >> 1, out_of_range_box.size >> 1);
+		// multiple of the number of children per axis due to subdivision rules
+		const Box3i parent_box =
+				Box3i(out_of_range_box.position >> parent_shift, out_of_range_box.size >> parent_shift);
 
+		VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
 		VoxelLodTerrainUpdateData::Lod &parent_lod = state.lods[parent_lod_index];
 
 		// Show parents when children are removed
 		parent_box.for_each_cell([&parent_lod, //
 								  &lod, //
 								  visual_flag, //
-								  collision_flag //
+								  collision_flag, //
+								  parent_shift //
 		](Vector3i bpos) {
 			auto mesh_it = parent_lod.mesh_map_state.map.find(bpos);
 
@@ -981,8 +1259,8 @@ void unview_mesh_box(
 					// In multi-viewer scenarios, the clipbox might have moved away from chunks of the
 					// child LOD, but another viewer could still reference them, so we should not merge
 					// them yet.
-					// This check assumes there is always 8 children or no children
-					const Vector3i child_bpos0 = bpos << 1;
+					// This check assumes there is always all children or no children
+					const Vector3i child_bpos0 = bpos << parent_shift;
 					auto child_mesh0_it = lod.mesh_map_state.map.find(child_bpos0);
 
 					if (child_mesh0_it == lod.mesh_map_state.map.end() ||
@@ -1001,7 +1279,7 @@ void unview_mesh_box(
 			}
 			if (collision_flag) {
 				if (!mesh_block.collision_active) {
-					const Vector3i child_bpos0 = bpos << 1;
+					const Vector3i child_bpos0 = bpos << parent_shift;
 					auto child_mesh0_it = lod.mesh_map_state.map.find(child_bpos0);
 
 					if (child_mesh0_it == lod.mesh_map_state.map.end() ||
@@ -1044,60 +1322,51 @@ inline bool requires_meshes(const VoxelLodTerrainUpdateData::PairedViewer::State
 	return viewer_state.requires_collisions || viewer_state.requires_visuals;
 }
 
-void process_viewer_mesh_blocks_sliding_box(
-		VoxelLodTerrainUpdateData::State &state,
-		int mesh_block_size_po2,
-		int lod_count,
-		const Box3i &volume_bounds_in_voxels,
+bool has_mesh_box_changes(
 		const VoxelLodTerrainUpdateData::PairedViewer &paired_viewer,
-		bool can_load,
-		bool is_full_load_mode,
-		int mesh_to_data_factor,
-		const VoxelData &data
+		const Box3i &new_mesh_box,
+		const Box3i &prev_mesh_box
 ) {
-	ZN_PROFILE_SCOPE();
+	if (prev_mesh_box != new_mesh_box) {
+		return true;
+	}
+	// Flags changes only affect blocks that were already in the box
+	return !Vector3iUtil::is_empty_size(prev_mesh_box.size) &&
+			(paired_viewer.state.requires_collisions != paired_viewer.prev_state.requires_collisions ||
+			 paired_viewer.state.requires_visuals != paired_viewer.prev_state.requires_visuals);
+}
 
-#ifdef DEV_ENABLED
-	Box3i debug_parent_box;
-#endif
+void process_lod_mesh_blocks_sliding_box(
+		VoxelLodTerrainUpdateData::State &state,
+		const unsigned int lod_index,
+		const Box3i bounds_in_mesh_blocks,
+		const bool can_load,
+		const bool is_full_load_mode,
+		const int mesh_to_data_factor,
+		const VoxelData &data,
+		const RecentlyUnloadedMeshBlocksParams &recently_unloaded_params,
+		uint32_t &thrashed_count,
+		StdVector<UnviewedMeshBox> &unviewed_boxes
+) {
+	ZN_PROFILE_SCOPE();
 
 	// TODO Optimize: when a viewer doesn't need visuals, we only need to build meshes for collisions up to a certain
 	// LOD (collision max LOD property). That would be an optimization for servers, NPCs and player hosts
 
-	// Iterating from big to small LOD so we can exit earlier if bounds don't intersect.
-	for (int lod_index = lod_count - 1; lod_index >= 0; --lod_index) {
-		ZN_PROFILE_SCOPE();
-		VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
-
-		const int lod_mesh_block_size_po2 = mesh_block_size_po2 + lod_index;
-		const int lod_mesh_block_size = 1 << lod_mesh_block_size_po2;
-		// const Vector3i viewer_block_pos_within_lod = math::floor_to_int(p_viewer_pos) >> block_size_po2;
-
-		const Box3i bounds_in_mesh_blocks = volume_bounds_in_voxels.downscaled(lod_mesh_block_size);
+	VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
 
-		// const Box3i new_mesh_box = get_lod_box_in_chunks(
-		// 		viewer_pos_in_lod0_voxels, lod_distance_in_mesh_chunks, mesh_block_size_po2, lod_index)
-		// 								   .clipped(bounds_in_mesh_blocks);
+	for (const VoxelLodTerrainUpdateData::PairedViewer &paired_viewer : state.clipbox_streaming.paired_viewers) {
+		// Only update around viewers that need meshes.
+		// Check previous state too in case we have to handle them changing
+		if (!requires_meshes(paired_viewer.state) && !requires_meshes(paired_viewer.prev_state)) {
+			continue;
+		}
 
 		const Box3i &new_mesh_box = paired_viewer.state.mesh_box_per_lod[lod_index];
 		const Box3i &prev_mesh_box = paired_viewer.prev_state.mesh_box_per_lod[lod_index];
 
-#ifdef DEV_ENABLED
-		if (lod_index + 1 != lod_count) {
-			const Box3i debug_parent_box_in_current_lod(debug_parent_box.position << 1, debug_parent_box.size << 1);
-			ZN_ASSERT(debug_parent_box_in_current_lod.contains(new_mesh_box));
-		}
-		debug_parent_box = new_mesh_box;
-#endif
-
-		// const Box3i prev_mesh_box = get_lod_box_in_chunks(
-		// 		state.clipbox_streaming.viewer_pos_in_lod0_voxels_previous_update,
-		// 		state.clipbox_streaming.lod_distance_in_mesh_chunks_previous_update, mesh_block_size_po2, lod_index)
-		// 									.clipped(bounds_in_mesh_blocks);
-
 		if (!new_mesh_box.intersects(bounds_in_mesh_blocks) && !prev_mesh_box.intersects(bounds_in_mesh_blocks)) {
-			// If this box doesn't intersect either now or before, there is no chance a smaller one will
-			break;
+			continue;
 		}
 
 		if (prev_mesh_box != new_mesh_box) {
@@ -1117,7 +1386,9 @@ void process_viewer_mesh_blocks_sliding_box(
 							mesh_to_data_factor,
 							data,
 							paired_viewer.state.requires_visuals,
-							paired_viewer.state.requires_collisions
+							paired_viewer.state.requires_collisions,
+							recently_unloaded_params,
+							thrashed_count
 					);
 				}
 			}
@@ -1131,12 +1402,11 @@ void process_viewer_mesh_blocks_sliding_box(
 					unview_mesh_box(
 							out_of_range_box,
 							lod,
-							lod_index,
-							lod_count,
-							state,
 							// Use previous state because old boxes were loaded because of them
 							paired_viewer.prev_state.requires_visuals,
-							paired_viewer.prev_state.requires_collisions
+							paired_viewer.prev_state.requires_collisions,
+							recently_unloaded_params.now_msec,
+							unviewed_boxes
 					);
 				}
 			}
@@ -1152,19 +1422,41 @@ void process_viewer_mesh_blocks_sliding_box(
 				const Box3i box = new_mesh_box.clipped(prev_mesh_box);
 				if (paired_viewer.state.requires_collisions) {
 					// Add refcount to just collisions
-					view_mesh_box(box, lod, lod_index, is_full_load_mode, mesh_to_data_factor, data, false, true);
+					view_mesh_box(
+							box,
+							lod,
+							lod_index,
+							is_full_load_mode,
+							mesh_to_data_factor,
+							data,
+							false,
+							true,
+							recently_unloaded_params,
+							thrashed_count
+					);
 				} else {
 					// Remove refcount to just collisions
-					unview_mesh_box(box, lod, lod_index, lod_count, state, false, true);
+					unview_mesh_box(box, lod, false, true, recently_unloaded_params.now_msec, unviewed_boxes);
 				}
 			}
 
 			if (paired_viewer.state.requires_visuals != paired_viewer.prev_state.requires_visuals) {
 				const Box3i box = new_mesh_box.clipped(prev_mesh_box);
 				if (paired_viewer.state.requires_visuals) {
-					view_mesh_box(box, lod, lod_index, is_full_load_mode, mesh_to_data_factor, data, true, false);
+					view_mesh_box(
+							box,
+							lod,
+							lod_index,
+							is_full_load_mode,
+							mesh_to_data_factor,
+							data,
+							true,
+							false,
+							recently_unloaded_params,
+							thrashed_count
+					);
 				} else {
-					unview_mesh_box(box, lod, lod_index, lod_count, state, true, false);
+					unview_mesh_box(box, lod, true, false, recently_unloaded_params.now_msec, unviewed_boxes);
 				}
 			}
 		}
@@ -1188,32 +1480,113 @@ void process_mesh_blocks_sliding_box(
 		bool is_full_load_mode,
 		bool can_load,
 		const VoxelData &data,
-		int data_block_size
+		int data_block_size,
+		uint64_t now_msec,
+		const ParallelJobsScheduler &scheduler
 ) {
 	ZN_PROFILE_SCOPE();
 
-	const int mesh_block_size_po2 = settings.mesh_block_size_po2;
-
 	// const int lod_distance_in_mesh_chunks = get_lod_distance_in_mesh_chunks(settings.lod_distance, mesh_block_size);
 
-	const int mesh_block_size = 1 << mesh_block_size_po2;
-	const int mesh_to_data_factor = mesh_block_size / data_block_size;
+	// Find which LODs have boxes that changed
+	uint32_t changed_lods_mask = 0;
 
 	for (const VoxelLodTerrainUpdateData::PairedViewer &paired_viewer : state.clipbox_streaming.paired_viewers) {
-		// Only update around viewers that need meshes.
-		// Check previous state too in case we have to handle them changing
-		if (requires_meshes(paired_viewer.state) || requires_meshes(paired_viewer.prev_state)) {
-			process_viewer_mesh_blocks_sliding_box(
-					state,
-					mesh_block_size_po2,
-					lod_count,
-					bounds_in_voxels,
-					paired_viewer,
-					can_load,
-					is_full_load_mode,
-					mesh_to_data_factor,
-					data
-			);
+		if (!requires_meshes(paired_viewer.state) && !requires_meshes(paired_viewer.prev_state)) {
+			continue;
+		}
+#ifdef DEV_ENABLED
+		Box3i debug_parent_box;
+#endif
+		// Iterating from big to small LOD so we can exit earlier if bounds don't intersect.
+		for (int lod_index = lod_count - 1; lod_index >= 0; --lod_index) {
+			const Box3i bounds_in_mesh_blocks =
+					bounds_in_voxels.downscaled(1 << (settings.get_lod_mesh_block_size_po2(lod_index) + lod_index));
+
+			const Box3i &new_mesh_box = paired_viewer.state.mesh_box_per_lod[lod_index];
+			const Box3i &prev_mesh_box = paired_viewer.prev_state.mesh_box_per_lod[lod_index];
+
+#ifdef DEV_ENABLED
+			if (lod_index + 1 != lod_count) {
+				const unsigned int parent_shift = settings.get_parent_mesh_block_shift(lod_index);
+				const Box3i debug_parent_box_in_current_lod(
+						debug_parent_box.position << parent_shift, debug_parent_box.size << parent_shift
+				);
+				ZN_ASSERT(debug_parent_box_in_current_lod.contains(new_mesh_box));
+			}
+			debug_parent_box = new_mesh_box;
+#endif
+
+			if (!new_mesh_box.intersects(bounds_in_mesh_blocks) && !prev_mesh_box.intersects(bounds_in_mesh_blocks)) {
+				// If this box doesn't intersect either now or before, there is no chance a smaller one will
+				break;
+			}
+
+			if (has_mesh_box_changes(paired_viewer, new_mesh_box, prev_mesh_box)) {
+				changed_lods_mask |= (1 << lod_index);
+			}
+		}
+	}
+
+	if (changed_lods_mask == 0) {
+		return;
+	}
+
+	FixedArray<uint8_t, constants::MAX_LOD> changed_lods;
+	unsigned int changed_lod_count = 0;
+	for (int lod_index = lod_count - 1; lod_index >= 0; --lod_index) {
+		if ((changed_lods_mask & (1 << lod_index)) != 0) {
+			changed_lods[changed_lod_count] = lod_index;
+			++changed_lod_count;
+		}
+	}
+
+	// Mesh boxes of a LOD only add or remove mesh blocks of that LOD, so LODs can be processed in parallel.
+	// Kept across updates to reuse their memory. Referenced from here, because jobs running on other threads would
+	// otherwise access their own instance.
+	static thread_local FixedArray<StdVector<UnviewedMeshBox>, constants::MAX_LOD> tls_unviewed_boxes_per_lod;
+	FixedArray<StdVector<UnviewedMeshBox>, constants::MAX_LOD> &unviewed_boxes_per_lod = tls_unviewed_boxes_per_lod;
+
+	RecentlyUnloadedMeshBlocksParams recently_unloaded_params;
+	recently_unloaded_params.now_msec = now_msec;
+	recently_unloaded_params.cache_duration_msec = settings.lod_hysteresis_cache_duration_msec;
+	FixedArray<uint32_t, constants::MAX_LOD> thrashed_count_per_lod;
+	fill(thrashed_count_per_lod, uint32_t(0));
+
+	run_parallel_jobs(changed_lod_count, scheduler, [&](const uint32_t job_index) {
+		const unsigned int lod_index = changed_lods[job_index];
+		StdVector<UnviewedMeshBox> &unviewed_boxes = unviewed_boxes_per_lod[lod_index];
+		unviewed_boxes.clear();
+
+		const unsigned int lod_mesh_block_size_po2 = settings.get_lod_mesh_block_size_po2(lod_index);
+
+		process_lod_mesh_blocks_sliding_box(
+				state,
+				lod_index,
+				bounds_in_voxels.downscaled(1 << (lod_mesh_block_size_po2 + lod_index)),
+				can_load,
+				is_full_load_mode,
+				(1 << lod_mesh_block_size_po2) / data_block_size,
+				data,
+				recently_unloaded_params,
+				thrashed_count_per_lod[lod_index],
+				unviewed_boxes
+		);
+	});
+
+	for (unsigned int job_index = 0; job_index < changed_lod_count; ++job_index) {
+		const unsigned int lod_index = changed_lods[job_index];
+		state.stats.thrashed_mesh_blocks += thrashed_count_per_lod[lod_index];
+		state.stats.restored_mesh_blocks += state.lods[lod_index].mesh_blocks_to_restore.size();
+	}
+
+	// Showing parents reads mesh blocks of the child LOD and modifies those of the parent LOD, so it can only be done
+	// once all LODs are up to date
+	for (unsigned int job_index = 0; job_index < changed_lod_count; ++job_index) {
+		const unsigned int lod_index = changed_lods[job_index];
+		const unsigned int parent_shift = settings.get_parent_mesh_block_shift(lod_index);
+		for (const UnviewedMeshBox &unviewed_box : unviewed_boxes_per_lod[lod_index]) {
+			show_parents_of_unviewed_mesh_box(unviewed_box, lod_index, lod_count, parent_shift, state);
 		}
 	}
 
@@ -1221,56 +1594,29 @@ void process_mesh_blocks_sliding_box(
 	// clipbox_streaming.lod_distance_in_mesh_chunks_previous_update = lod_distance_in_mesh_chunks;
 }
 
-void process_loaded_data_blocks_trigger_meshing(
+void trigger_meshing_around_loaded_data_blocks(
 		const VoxelData &data,
-		VoxelLodTerrainUpdateData::State &state,
-		const VoxelLodTerrainUpdateData::Settings &settings,
-		const Box3i bounds_in_voxels
+		VoxelLodTerrainUpdateData::Lod &lod,
+		const unsigned int lod_index,
+		Span<const VoxelLodTerrainUpdateData::BlockLocation> loaded_blocks,
+		const Box3i bounds_in_voxels,
+		const int data_to_mesh_shift
 ) {
 	ZN_PROFILE_SCOPE();
-	// This function should only be used when data streaming is on.
-	// When everything is loaded, there is also the assumption that blocks can be generated on the fly, so loading
-	// events come in sparsely for only edited areas. So it doesn't make much sense to trigger meshing in reaction to
-	// data loading.
-	ZN_ASSERT_RETURN(data.is_streaming_enabled());
-
-	const int mesh_block_size_po2 = settings.mesh_block_size_po2;
-
-	VoxelLodTerrainUpdateData::ClipboxStreamingState &clipbox_streaming = state.clipbox_streaming;
 
-	// Get list of data blocks that were loaded since the last update
-	static thread_local StdVector<VoxelLodTerrainUpdateData::BlockLocation> tls_loaded_blocks;
-	tls_loaded_blocks.clear();
-	{
-		MutexLock mlock(clipbox_streaming.loaded_data_blocks_mutex);
-		append_array(tls_loaded_blocks, clipbox_streaming.loaded_data_blocks);
-		clipbox_streaming.loaded_data_blocks.clear();
-	}
+	const int lod_data_block_size_po2 = data.get_block_size_po2() + lod_index;
+	const Box3i bounds_in_data_blocks = get_bounds_in_data_blocks(bounds_in_voxels, lod_data_block_size_po2);
 
 	// TODO Pool memory
-	FixedArray<StdUnorderedSet<Vector3i>, constants::MAX_LOD> checked_mesh_blocks_per_lod;
-
-	const int data_to_mesh_shift = mesh_block_size_po2 - data.get_block_size_po2();
+	StdUnorderedSet<Vector3i> checked_mesh_blocks;
 
-	for (VoxelLodTerrainUpdateData::BlockLocation bloc : tls_loaded_blocks) {
+	for (const VoxelLodTerrainUpdateData::BlockLocation bloc : loaded_blocks) {
 		// ZN_PROFILE_SCOPE_NAMED("Block");
 		// Multiple mesh blocks may be interested because of neighbor dependencies.
 
-		// We could group loaded blocks by LOD so we could compute a few things less times?
-		const int lod_data_block_size_po2 = data.get_block_size_po2() + bloc.lod;
-		const Box3i bounds_in_data_blocks = Box3i( //
-				bounds_in_voxels.position >> lod_data_block_size_po2, //
-				bounds_in_voxels.size >> lod_data_block_size_po2
-		);
-
 		const Box3i data_neighboring =
 				Box3i(bloc.position - Vector3i(1, 1, 1), Vector3i(3, 3, 3)).clipped(bounds_in_data_blocks);
 
-		StdUnorderedSet<Vector3i> &checked_mesh_blocks = checked_mesh_blocks_per_lod[bloc.lod];
-		VoxelLodTerrainUpdateData::Lod &lod = state.lods[bloc.lod];
-
-		const unsigned int lod_index = bloc.lod;
-
 		data_neighboring.for_each_cell([data_to_mesh_shift,
 										&checked_mesh_blocks,
 										&lod,
@@ -1327,6 +1673,69 @@ void process_loaded_data_blocks_trigger_meshing(
 	}
 }
 
+void process_loaded_data_blocks_trigger_meshing(
+		const VoxelData &data,
+		VoxelLodTerrainUpdateData::State &state,
+		const VoxelLodTerrainUpdateData::Settings &settings,
+		const Box3i bounds_in_voxels,
+		const ParallelJobsScheduler &scheduler
+) {
+	ZN_PROFILE_SCOPE();
+	// This function should only be used when data streaming is on.
+	// When everything is loaded, there is also the assumption that blocks can be generated on the fly, so loading
+	// events come in sparsely for only edited areas. So it doesn't make much sense to trigger meshing in reaction to
+	// data loading.
+	ZN_ASSERT_RETURN(data.is_streaming_enabled());
+
+	VoxelLodTerrainUpdateData::ClipboxStreamingState &clipbox_streaming = state.clipbox_streaming;
+
+	// Get list of data blocks that were loaded since the last update
+	static thread_local StdVector<VoxelLodTerrainUpdateData::BlockLocation> tls_loaded_blocks;
+	tls_loaded_blocks.clear();
+	{
+		MutexLock mlock(clipbox_streaming.loaded_data_blocks_mutex);
+		append_array(tls_loaded_blocks, clipbox_streaming.loaded_data_blocks);
+		clipbox_streaming.loaded_data_blocks.clear();
+	}
+
+	if (tls_loaded_blocks.size() == 0) {
+		return;
+	}
+
+	// Group blocks by LOD. Meshes to update are found only within the LOD of each block, so LODs can be processed in
+	// parallel.
+	std::stable_sort(
+			tls_loaded_blocks.begin(),
+			tls_loaded_blocks.end(),
+			[](const VoxelLodTerrainUpdateData::BlockLocation &a, const VoxelLodTerrainUpdateData::BlockLocation &b) {
+				return a.lod < b.lod;
+			}
+	);
+
+	FixedArray<Span<const VoxelLodTerrainUpdateData::BlockLocation>, constants::MAX_LOD> blocks_per_lod;
+	FixedArray<uint8_t, constants::MAX_LOD> lods;
+	unsigned int group_count = 0;
+	for (unsigned int begin = 0; begin < tls_loaded_blocks.size();) {
+		const uint8_t lod_index = tls_loaded_blocks[begin].lod;
+		unsigned int end = begin + 1;
+		while (end < tls_loaded_blocks.size() && tls_loaded_blocks[end].lod == lod_index) {
+			++end;
+		}
+		blocks_per_lod[group_count] = to_span_from_position_and_size(tls_loaded_blocks, begin, end - begin);
+		lods[group_count] = lod_index;
+		++group_count;
+		begin = end;
+	}
+
+	run_parallel_jobs(group_count, scheduler, [&](const uint32_t job_index) {
+		const unsigned int lod_index = lods[job_index];
+		const int data_to_mesh_shift = settings.get_lod_mesh_block_size_po2(lod_index) - data.get_block_size_po2();
+		trigger_meshing_around_loaded_data_blocks(
+				data, state.lods[lod_index], lod_index, blocks_per_lod[job_index], bounds_in_voxels, data_to_mesh_shift
+		);
+	});
+}
+
 // void debug_dump_mesh_maps(const VoxelLodTerrainUpdateData::State &state, unsigned int lod_count) {
 // 	std::ofstream ofs("ddd_meshmaps.json", std::ios::binary | std::ios::trunc);
 // 	ofs << "[";
@@ -1448,6 +1857,7 @@ void set_inactive(
 // This essentially runs octree subdivision logic, but only from a specific node and its descendants.
 void update_mesh_block_load(
 		VoxelLodTerrainUpdateData::State &state,
+		const VoxelLodTerrainUpdateData::Settings &settings,
 		Vector3i bpos,
 		unsigned int lod_index,
 		unsigned int lod_count,
@@ -1477,9 +1887,11 @@ void update_mesh_block_load(
 
 		if (lod_index > 0) {
 			const unsigned int child_lod_index = lod_index - 1;
-			for (unsigned int child_index = 0; child_index < 8; ++child_index) {
-				const Vector3i child_bpos = get_child_position(bpos, child_index);
-				update_mesh_block_load(state, child_bpos, child_lod_index, lod_count, feature_index);
+			const unsigned int child_shift = settings.get_parent_mesh_block_shift(child_lod_index);
+			const unsigned int child_count = get_child_count(child_shift);
+			for (unsigned int child_index = 0; child_index < child_count; ++child_index) {
+				const Vector3i child_bpos = get_child_position(bpos, child_index, child_shift);
+				update_mesh_block_load(state, settings, child_bpos, child_lod_index, lod_count, feature_index);
 			}
 		}
 
@@ -1487,7 +1899,9 @@ void update_mesh_block_load(
 		// Not root
 		// We'll have to consider siblings since we can't activate only one at a time, it has to be all or none
 
-		const Vector3i parent_bpos = bpos >> 1;
+		const unsigned int parent_shift = settings.get_parent_mesh_block_shift(lod_index);
+		const unsigned int sibling_count = get_child_count(parent_shift);
+		const Vector3i parent_bpos = bpos >> parent_shift;
 		VoxelLodTerrainUpdateData::Lod &parent_lod = state.lods[parent_lod_index];
 
 		auto parent_mesh_it = parent_lod.mesh_map_state.map.find(parent_bpos);
@@ -1507,12 +1921,12 @@ void update_mesh_block_load(
 
 			// Test if all siblings are loaded
 			// TODO This needs to be optimized. Store a cache in parent?
-			for (unsigned int sibling_index = 0; sibling_index < 8; ++sibling_index) {
-				const Vector3i sibling_bpos = get_child_position(parent_bpos, sibling_index);
+			for (unsigned int sibling_index = 0; sibling_index < sibling_count; ++sibling_index) {
+				const Vector3i sibling_bpos = get_child_position(parent_bpos, sibling_index, parent_shift);
 				auto sibling_it = lod.mesh_map_state.map.find(sibling_bpos);
 				if (sibling_it == lod.mesh_map_state.map.end()) {
 					// Finding this in the mesh map would be weird due to subdivision rules. We don't expect a sibling
-					// to be missing, because every mesh block always has 8 children.
+					// to be missing, because every mesh block always has all its children.
 					ZN_PRINT_ERROR("Didn't expect missing sibling");
 					all_siblings_loaded = false;
 					break;
@@ -1529,8 +1943,8 @@ void update_mesh_block_load(
 				set_inactive(parent_mesh_block, feature_index, parent_lod, parent_bpos);
 
 				// Show siblings
-				for (unsigned int sibling_index = 0; sibling_index < 8; ++sibling_index) {
-					const Vector3i sibling_bpos = get_child_position(parent_bpos, sibling_index);
+				for (unsigned int sibling_index = 0; sibling_index < sibling_count; ++sibling_index) {
+					const Vector3i sibling_bpos = get_child_position(parent_bpos, sibling_index, parent_shift);
 					auto sibling_it = lod.mesh_map_state.map.find(sibling_bpos);
 					VoxelLodTerrainUpdateData::MeshBlockState &sibling = sibling_it->second;
 					// TODO Optimize: if that sibling itself subdivides, it should not need to be made visible.
@@ -1540,9 +1954,13 @@ void update_mesh_block_load(
 					if (lod_index > 0) {
 						// Check if children are loaded too
 						const unsigned int child_lod_index = lod_index - 1;
-						for (unsigned int child_index = 0; child_index < 8; ++child_index) {
-							const Vector3i child_bpos = get_child_position(sibling_bpos, child_index);
-							update_mesh_block_load(state, child_bpos, child_lod_index, lod_count, feature_index);
+						const unsigned int child_shift = settings.get_parent_mesh_block_shift(child_lod_index);
+						const unsigned int child_count = get_child_count(child_shift);
+						for (unsigned int child_index = 0; child_index < child_count; ++child_index) {
+							const Vector3i child_bpos = get_child_position(sibling_bpos, child_index, child_shift);
+							update_mesh_block_load(
+									state, settings, child_bpos, child_lod_index, lod_count, feature_index
+							);
 						}
 					}
 				}
@@ -1553,6 +1971,7 @@ void update_mesh_block_load(
 
 void process_loaded_mesh_blocks_trigger_visibility_changes(
 		VoxelLodTerrainUpdateData::State &state,
+		const VoxelLodTerrainUpdateData::Settings &settings,
 		unsigned int lod_count
 ) {
 	ZN_PROFILE_SCOPE();
@@ -1573,11 +1992,11 @@ void process_loaded_mesh_blocks_trigger_visibility_changes(
 	for (const VoxelLodTerrainUpdateData::LoadedMeshBlockEvent event : tls_loaded_blocks) {
 		// TODO This isn't optimal. Cost of doing this is doubled if we want both visual and collision.
 		if (event.visual) {
-			update_mesh_block_load(state, event.position, event.lod_index, lod_count, MESH_VISUAL);
+			update_mesh_block_load(state, settings, event.position, event.lod_index, lod_count, MESH_VISUAL);
 		}
 		// TODO We should not need to run this at LODs that have no collision
 		if (event.collision) {
-			update_mesh_block_load(state, event.position, event.lod_index, lod_count, MESH_COLLIDER);
+			update_mesh_block_load(state, settings, event.position, event.lod_index, lod_count, MESH_COLLIDER);
 		}
 	}
 
@@ -1596,7 +2015,32 @@ void process_loaded_mesh_blocks_trigger_visibility_changes(
 		// also update masks incrementally somehow?). The initial reason this streaming system was added was to help
 		// with server-side performance. This feature is client-only, so it didn't need to be optimized too at the
 		// moment.
-		update_transition_masks(state, lods_to_update_transitions, lod_count, true);
+		update_transition_masks(state, settings, lods_to_update_transitions, lod_count, true);
+	}
+}
+
+void remove_expired_recently_unloaded_mesh_blocks(
+		VoxelLodTerrainUpdateData::State &state,
+		const VoxelLodTerrainUpdateData::Settings &settings,
+		unsigned int lod_count,
+		uint64_t now_msec
+) {
+	ZN_PROFILE_SCOPE();
+
+	const uint32_t duration_msec =
+			math::max(settings.lod_hysteresis_cache_duration_msec, MESH_THRASH_DETECTION_DURATION_MSEC);
+
+	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
+		StdUnorderedMap<Vector3i, VoxelLodTerrainUpdateData::RecentlyUnloadedMeshBlock> &recently_unloaded =
+				state.lods[lod_index].recently_unloaded_mesh_blocks;
+
+		for (auto it = recently_unloaded.begin(); it != recently_unloaded.end();) {
+			if (now_msec - it->second.time_msec >= duration_msec) {
+				it = recently_unloaded.erase(it);
+			} else {
+				++it;
+			}
+		}
 	}
 }
 
@@ -1611,7 +2055,8 @@ void process_clipbox_streaming(
 		StdVector<VoxelLodTerrainUpdateData::BlockToLoad> &data_blocks_to_load,
 		const VoxelLodTerrainUpdateData::Settings &settings,
 		bool can_load,
-		bool can_mesh
+		bool can_mesh,
+		const ParallelJobsScheduler &scheduler
 ) {
 	ZN_PROFILE_SCOPE();
 
@@ -1637,7 +2082,7 @@ void process_clipbox_streaming(
 
 	if (streaming_enabled) {
 		process_data_blocks_sliding_box(
-				state, data, data_blocks_to_save, data_blocks_to_load, settings, lod_count, can_load
+				state, data, data_blocks_to_save, data_blocks_to_load, settings, lod_count, can_load, scheduler
 		);
 	} else {
 		if (full_load_completed == false) {
@@ -1649,8 +2094,21 @@ void process_clipbox_streaming(
 		}
 	}
 
+	const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+
+	remove_expired_recently_unloaded_mesh_blocks(state, settings, lod_count, now_msec);
+
 	process_mesh_blocks_sliding_box(
-			state, settings, bounds_in_voxels, lod_count, !streaming_enabled, can_load, data, 1 << data_block_size_po2
+			state,
+			settings,
+			bounds_in_voxels,
+			lod_count,
+			!streaming_enabled,
+			can_load,
+			data,
+			1 << data_block_size_po2,
+			now_msec,
+			scheduler
 	);
 
 	// Removing paired viewers after box diffs because we interpret viewer removal as boxes becoming zero-size, so we
@@ -1660,10 +2118,10 @@ void process_clipbox_streaming(
 	if (streaming_enabled) {
 		// TODO Have an option to turn off meshing entirely (may be useful on servers if the game doesn't use mesh
 		// colliders)
-		process_loaded_data_blocks_trigger_meshing(data, state, settings, bounds_in_voxels);
+		process_loaded_data_blocks_trigger_meshing(data, state, settings, bounds_in_voxels, scheduler);
 	}
 
-	process_loaded_mesh_blocks_trigger_visibility_changes(state, lod_count);
+	process_loaded_mesh_blocks_trigger_visibility_changes(state, settings, lod_count);
 
 	// state.clipbox_streaming.viewer_pos_in_lod0_voxels_previous_update = viewer_pos_in_lod0_voxels;
 }
@@ -2,10 +2,13 @@
 #define VOXEL_LOD_TERRAIN_UPDATE_CLIPBOX_STREAMING_H
 
 #include "../../storage/voxel_data.h"
+#include "../../util/tasks/parallel_jobs.h"
 #include "voxel_lod_terrain_update_data.h"
 
 namespace zylann::voxel {
 
+// Box changes of each LOD are processed on separate threads if a scheduler is provided. Only consequences spanning
+// several LODs are applied afterwards from the calling thread.
 void process_clipbox_streaming(
 		VoxelLodTerrainUpdateData::State &state,
 		VoxelData &data,
@@ -15,7 +18,8 @@ void process_clipbox_streaming(
 		StdVector<VoxelLodTerrainUpdateData::BlockToLoad> &data_blocks_to_load,
 		const VoxelLodTerrainUpdateData::Settings &settings,
 		bool can_load,
-		bool can_mesh
+		bool can_mesh,
+		const ParallelJobsScheduler &scheduler
 );
 
 } // namespace zylann::voxel
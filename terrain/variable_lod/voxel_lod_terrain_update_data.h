@@ -3,12 +3,14 @@
 
 #include "../../constants/voxel_constants.h"
 #include "../../engine/detail_rendering/detail_rendering.h"
+#include "../../engine/detail_rendering/detail_texture_tile_cache.h"
 #include "../../generators/voxel_generator.h"
 #include "../../streams/voxel_stream.h"
 #include "../../util/containers/fixed_array.h"
 #include "../../util/containers/std_map.h"
 #include "../../util/containers/std_unordered_map.h"
 #include "../../util/containers/std_vector.h"
+#include "../../util/containers/vector3i_sparse_grid.h"
 #include "../../util/safe_ref_count.h"
 #include "../../util/tasks/cancellation_token.h"
 #include "../voxel_mesh_map.h"
@@ -65,21 +67,55 @@ struct VoxelLodTerrainUpdateData {
 		float lod_distance = 0.f;
 		// Distance between the end of LOD0 and the end of LOD1, carried over to other LODs
 		float secondary_lod_distance = 0.f;
+		// Multiplies LOD distances. Copied from `VoxelEngine` before each update, it goes below 1 while threads can't
+		// keep up with tasks. Only used by clipbox streaming.
+		float lod_distance_scale = 1.f;
+		// See `VoxelNode::set_task_priority`
+		int task_priority = 0;
 		unsigned int view_distance_voxels = 512;
 		StreamingSystem streaming_system = STREAMING_SYSTEM_LEGACY_OCTREE;
 		// bool full_load_mode = false;
 		bool run_stream_in_editor = true;
 		// If true, try to generate blocks and store them in the data map before posting mesh requests.
 		// If false, meshing will generate non-edited voxels on the fly instead.
-		// Not really exposed for now, will wait for it to be really needed. It might never be.
+		// Memory used by such blocks can be limited with `VoxelData::set_cache_memory_budget`.
 		bool cache_generated_blocks = false;
 		bool collision_enabled = true;
+		// If not 0, only LODs below this index get collisions
+		unsigned int collision_lod_count = 0;
+		// Mesh blocks only unload once they are this many blocks outside of the box of their LOD, so viewers moving
+		// back and forth across a boundary don't unload and reload them repeatedly. Only used by clipbox streaming.
+		unsigned int lod_hysteresis_margin = 1;
+		// How long unloaded mesh blocks are kept hidden so they can be shown again without remeshing if a viewer needs
+		// them shortly after. 0 disables this. Only used by clipbox streaming.
+		uint32_t lod_hysteresis_cache_duration_msec = 0;
 		bool detail_textures_use_gpu = false;
 		bool generator_use_gpu = false;
 		uint8_t detail_texture_generator_override_begin_lod_index = 0;
 		unsigned int mesh_block_size_po2 = 4;
+		// Mesh block size used at each LOD, as a power of two. Computed by the terrain from `mesh_block_size_po2` and
+		// per-LOD sizes. It never decreases with LOD index, and grows by at most one power of two between consecutive
+		// LODs, so a parent mesh block has either 2x2x2 or 4x4x4 children. Uniform when octree streaming is used.
+		FixedArray<uint8_t, constants::MAX_LOD> lod_mesh_block_size_po2;
 		DetailRenderingSettings detail_texture_settings;
 		Ref<VoxelGenerator> detail_texture_generator_override;
+
+		Settings() {
+			fill(lod_mesh_block_size_po2, uint8_t(4));
+		}
+
+		inline unsigned int get_lod_mesh_block_size_po2(unsigned int lod_index) const {
+			return lod_mesh_block_size_po2[lod_index];
+		}
+
+		// Mesh block coordinates of a LOD shifted right by this amount give the coordinates of their parent block in
+		// the next LOD.
+		inline unsigned int get_parent_mesh_block_shift(unsigned int lod_index) const {
+			if (lod_index + 1 >= lod_mesh_block_size_po2.size()) {
+				return 1;
+			}
+			return lod_mesh_block_size_po2[lod_index + 1] + 1 - lod_mesh_block_size_po2[lod_index];
+		}
 	};
 
 	enum MeshState {
@@ -114,6 +150,10 @@ struct VoxelLodTerrainUpdateData {
 		// will be cancelled
 		TaskCancellationToken cancellation_token;
 
+		// Incremented when a mesh task is sent for this block, so older tasks still in flight get superseded.
+		// See `MeshBlockTask::supersede_previous_tasks`.
+		std::shared_ptr<std::atomic_uint32_t> mesh_version;
+
 		// Index within the list of meshes to update during one update of the terrain. Used to avoid putting the same
 		// mesh more than once in the list, while allowing to change options after it's been added to the list. Should
 		// reset to -1 after each update (since the list is consumed)
@@ -147,7 +187,7 @@ struct VoxelLodTerrainUpdateData {
 	// It contains states used to determine when to actually load/unload meshes.
 	struct MeshMapState {
 		// Values in this map are expected to have stable addresses.
-		StdUnorderedMap<Vector3i, MeshBlockState> map;
+		Vector3iSparseGrid<MeshBlockState> map;
 		// Locked for writing when blocks get inserted or removed from the map.
 		// If you need to lock more than one Lod, always do so in increasing order, to avoid deadlocks.
 		// IMPORTANT:
@@ -168,6 +208,10 @@ struct VoxelLodTerrainUpdateData {
 		Vector3i position;
 		TaskCancellationToken cancellation_token;
 		bool require_visual = false;
+		// True if the update was requested because voxels were edited
+		bool edited = false;
+		// True if the update only aims at optimizing a mesh that was built without optimizations
+		bool optimization_pass = false;
 	};
 
 	struct QuickReloadingBlock {
@@ -175,6 +219,19 @@ struct VoxelLodTerrainUpdateData {
 		Vector3i position;
 	};
 
+	struct RecentlyUnloadedMeshBlock {
+		uint64_t time_msec;
+		// Whether visuals and collisions were up to date when the block got unloaded
+		bool visual;
+		bool collision;
+	};
+
+	struct MeshBlockToRestore {
+		Vector3i position;
+		bool visual;
+		bool collision;
+	};
+
 	// Each LOD works in a set of coordinates spanning 2x more voxels the higher their index is
 	struct Lod {
 		// Keeping track of asynchronously loading blocks so we don't try to redundantly load them
@@ -190,6 +247,11 @@ struct VoxelLodTerrainUpdateData {
 		// updates. It won't run while the threaded update runs so no locking is needed.
 		StdVector<QuickReloadingBlock> quick_reloading_blocks;
 
+		// Mesh blocks unloaded recently by clipbox streaming. Used to detect blocks reloading shortly after being
+		// unloaded, and to restore them from the cache of the main thread instead of meshing them again. Only accessed
+		// by the update task.
+		StdUnorderedMap<Vector3i, RecentlyUnloadedMeshBlock> recently_unloaded_mesh_blocks;
+
 		// These are relative to this LOD, in block coordinates
 		Vector3i last_viewer_data_block_pos;
 		int last_view_distance_data_blocks = 0;
@@ -211,6 +273,8 @@ struct VoxelLodTerrainUpdateData {
 		StdVector<Vector3i> mesh_blocks_to_deactivate_collision;
 		StdVector<Vector3i> mesh_blocks_to_drop_visual;
 		StdVector<Vector3i> mesh_blocks_to_drop_collision;
+		StdVector<MeshBlockToRestore> mesh_blocks_to_restore;
+		StdVector<Vector3i> mesh_blocks_to_uncache;
 
 		inline bool has_loading_block(const Vector3i &pos) const {
 			return loading_blocks.find(pos) != loading_blocks.end();
@@ -221,11 +285,14 @@ struct VoxelLodTerrainUpdateData {
 		IThreadedTask *task;
 		Box3i box;
 		std::shared_ptr<AsyncDependencyTracker> task_tracker;
+		// If not 0, completion of the edit is reported with the batch it is part of
+		uint32_t batch_id = 0;
 	};
 
 	struct RunningAsyncEdit {
 		std::shared_ptr<AsyncDependencyTracker> tracker;
 		Box3i box;
+		uint32_t batch_id;
 	};
 
 	struct Stats {
@@ -234,10 +301,30 @@ struct VoxelLodTerrainUpdateData {
 		uint32_t time_io_requests = 0;
 		uint32_t time_mesh_requests = 0;
 		uint32_t time_total = 0;
+		// Cumulated since the terrain started streaming
+		uint32_t prefetched_blocks = 0;
+		uint32_t prefetch_hits = 0;
+		uint32_t prefetch_misses = 0;
+		uint32_t prefetch_cancelled = 0;
+		uint32_t thrashed_mesh_blocks = 0;
+		uint32_t restored_mesh_blocks = 0;
+		uint32_t updated_octrees = 0;
+		uint32_t checked_octree_nodes = 0;
 	};
 
 	struct OctreeItem {
 		LodOctree octree;
+		// Terrain-local position of the viewer when the octree was last updated
+		Vector3 viewer_pos_previous_update;
+		// How far the viewer can move from `viewer_pos_previous_update` before any node of the octree may cross a
+		// split or join distance. Negative if the octree must be updated regardless.
+		float stable_distance = -1.f;
+		// Tells if nodes needed to split or join but could not due to pending dependencies
+		bool had_blocked_nodes = false;
+
+		inline void invalidate() {
+			stable_distance = -1.f;
+		}
 	};
 
 	struct OctreeStreamingState {
@@ -268,6 +355,8 @@ struct VoxelLodTerrainUpdateData {
 			// In block coordinates
 			FixedArray<Box3i, constants::MAX_LOD> data_box_per_lod;
 			FixedArray<Box3i, constants::MAX_LOD> mesh_box_per_lod;
+			// Data boxes around the predicted position of the viewer, loaded in advance. Empty if not moving.
+			FixedArray<Box3i, constants::MAX_LOD> prefetch_box_per_lod;
 
 			Distances view_distance_voxels;
 			bool requires_collisions = false;
@@ -345,6 +434,10 @@ struct VoxelLodTerrainUpdateData {
 	Settings settings;
 	State state;
 
+	// Detail texture tiles kept across remeshes. Shared with rendering tasks.
+	std::shared_ptr<DetailTextureTileCache> detail_texture_tile_cache =
+			make_shared_instance<DetailTextureTileCache>();
+
 	// Copy of all viewers, since accessing them directly in VoxelEngine is not thread safe at the moment
 	StdVector<std::pair<ViewerID, VoxelEngine::Viewer>> viewers;
 
@@ -3,6 +3,8 @@
 #include "voxel_lod_terrain_update_data.h"
 #include "voxel_lod_terrain_update_task.h"
 
+#include <limits>
+
 namespace zylann::voxel {
 
 namespace {
@@ -164,12 +166,20 @@ void process_unload_mesh_blocks_sliding_box(
 		if (prev_box != new_box) {
 			ZN_PROFILE_SCOPE_NAMED("Unload meshes");
 			RWLockWrite wlock(lod.mesh_map_state.map_lock);
-			prev_box.difference(new_box, [&lod](Box3i out_of_range_box) {
-				out_of_range_box.for_each_cell([&lod](Vector3i pos) {
+			StdMap<Vector3i, VoxelLodTerrainUpdateData::OctreeItem> &octrees = state.octree_streaming.lod_octrees;
+			const unsigned int octree_pos_shift = lod_count - 1 - lod_index;
+			prev_box.difference(new_box, [&lod, &octrees, octree_pos_shift](Box3i out_of_range_box) {
+				out_of_range_box.for_each_cell([&lod, &octrees, octree_pos_shift](Vector3i pos) {
 					// print_line(String("Immerge {0}").format(varray(pos.to_vec3())));
 					// unload_mesh_block(pos, lod_index);
 					lod.mesh_map_state.map.erase(pos);
 					lod.mesh_blocks_to_unload.push_back(pos);
+					// The octree owning that block may have to join nodes even if the viewer didn't cross any of
+					// their split distances
+					auto octree_it = octrees.find(pos >> octree_pos_shift);
+					if (octree_it != octrees.end()) {
+						octree_it->second.invalidate();
+					}
 				});
 			});
 		}
@@ -424,7 +434,7 @@ bool check_block_mesh_updated(
 }
 
 VoxelLodTerrainUpdateData::MeshBlockState &insert_new(
-		StdUnorderedMap<Vector3i, VoxelLodTerrainUpdateData::MeshBlockState> &mesh_map,
+		Vector3iSparseGrid<VoxelLodTerrainUpdateData::MeshBlockState> &mesh_map,
 		Vector3i pos
 ) {
 #ifdef DEBUG_ENABLED
@@ -432,18 +442,9 @@ VoxelLodTerrainUpdateData::MeshBlockState &insert_new(
 	static VoxelLodTerrainUpdateData::MeshBlockState s_default;
 	ERR_FAIL_COND_V(mesh_map.find(pos) != mesh_map.end(), s_default);
 #endif
-	// C++ standard says if the element is not present, it will be default-constructed.
-	// So here is how to insert a default, non-movable struct into an unordered_map.
-	// https://stackoverflow.com/questions/22229773/map-unordered-map-with-non-movable-default-constructible-value-type
+	// If the element is not present, it gets default-constructed in place, which is required because
+	// `MeshBlockState` is not movable.
 	VoxelLodTerrainUpdateData::MeshBlockState &block = mesh_map[pos];
-
-	// This approach doesn't compile, had to workaround with the writing [] operator.
-	/*
-	auto p = lod.mesh_map_state.map.emplace(pos, VoxelLodTerrainUpdateData::MeshBlockState());
-	// We got here because the map didn't contain the element. If it did contain it already, that's a bug.
-	CRASH_COND(p.second == false);
-	*/
-
 	return block;
 }
 
@@ -544,6 +545,8 @@ void process_octrees_fitting(
 	const float lod_distance_octree_space = settings.lod_distance / octree_leaf_node_size;
 
 	unsigned int blocked_octree_nodes = 0;
+	unsigned int updated_octrees = 0;
+	unsigned int checked_octree_nodes = 0;
 
 	// Off by one bit: second bit is LOD0, first bit is unused
 	uint32_t lods_to_update_transitions = 0;
@@ -552,6 +555,16 @@ void process_octrees_fitting(
 	for (auto octree_it = state.octree_streaming.lod_octrees.begin();
 		 octree_it != state.octree_streaming.lod_octrees.end();
 		 ++octree_it) {
+		VoxelLodTerrainUpdateData::OctreeItem &item = octree_it->second;
+
+		// Nodes only split or join when the viewer crosses their distance threshold. If the viewer did not move far
+		// enough to reach the closest one since the last update, walking the octree would not change anything.
+		if (!force_update_octrees && !item.had_blocked_nodes && item.stable_distance >= 0.f &&
+			p_viewer_pos.distance_squared_to(item.viewer_pos_previous_update) <
+					math::squared(item.stable_distance)) {
+			continue;
+		}
+
 		ZN_PROFILE_SCOPE();
 
 		struct OctreeActions {
@@ -564,6 +577,21 @@ void process_octrees_fitting(
 			float lod_distance_octree_space;
 			Vector3 viewer_pos_octree_space;
 			uint32_t &lods_to_update_transitions;
+			// Smallest difference between the distance of a checked node and its split distance, in octree space
+			float stable_distance;
+			unsigned int checked_count;
+
+			// Same as `LodOctree::is_below_split_distance`, but also tracks how far the viewer is from changing the
+			// result.
+			bool is_below_split_distance(Vector3i node_pos, int lod_index) {
+				const real_t lod_factor = 1 << lod_index;
+				const Vector3 center = lod_factor * (Vector3(node_pos) + Vector3(0.5, 0.5, 0.5));
+				const real_t split_distance = lod_distance_octree_space * lod_factor;
+				const real_t distance = center.distance_to(viewer_pos_octree_space);
+				stable_distance = math::min(stable_distance, static_cast<float>(math::abs(distance - split_distance)));
+				++checked_count;
+				return distance < split_distance;
+			}
 
 			void create_child(Vector3i node_pos, int lod_index, LodOctree::NodeData &node_data) {
 				VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
@@ -633,9 +661,7 @@ void process_octrees_fitting(
 
 			bool can_split(Vector3i node_pos, int lod_index, LodOctree::NodeData &node_data) {
 				ZN_PROFILE_SCOPE();
-				if (!LodOctree::is_below_split_distance(
-							node_pos, lod_index, viewer_pos_octree_space, lod_distance_octree_space
-					)) {
+				if (!is_below_split_distance(node_pos, lod_index)) {
 					return false;
 				}
 				const int child_lod_index = lod_index - 1;
@@ -671,9 +697,7 @@ void process_octrees_fitting(
 
 			bool can_join(Vector3i node_pos, int parent_lod_index) {
 				ZN_PROFILE_SCOPE();
-				if (LodOctree::is_below_split_distance(
-							node_pos, parent_lod_index, viewer_pos_octree_space, lod_distance_octree_space
-					)) {
+				if (is_below_split_distance(node_pos, parent_lod_index)) {
 					return false;
 				}
 				// Can only unsubdivide if the parent mesh is ready
@@ -714,19 +738,28 @@ void process_octrees_fitting(
 									  0,
 									  lod_distance_octree_space,
 									  relative_viewer_pos / octree_leaf_node_size,
-									  lods_to_update_transitions };
-		VoxelLodTerrainUpdateData::OctreeItem &item = octree_it->second;
+									  lods_to_update_transitions,
+									  std::numeric_limits<float>::max(),
+									  0 };
 		item.octree.update(octree_actions);
 
+		item.viewer_pos_previous_update = p_viewer_pos;
+		item.stable_distance = octree_actions.stable_distance * octree_leaf_node_size;
+		item.had_blocked_nodes = octree_actions.blocked_count > 0;
+
 		blocked_octree_nodes += octree_actions.blocked_count;
+		checked_octree_nodes += octree_actions.checked_count;
+		++updated_octrees;
 	}
 
 	// Ideally, this stat should stabilize to zero.
 	// If not, something in block management prevents LODs from properly show up and should be fixed.
 	state.stats.blocked_lods = blocked_octree_nodes;
+	state.stats.updated_octrees = updated_octrees;
+	state.stats.checked_octree_nodes = checked_octree_nodes;
 	state.octree_streaming.had_blocked_octree_nodes_previous_update = blocked_octree_nodes > 0;
 
-	update_transition_masks(state, lods_to_update_transitions, lod_count, false);
+	update_transition_masks(state, settings, lods_to_update_transitions, lod_count, false);
 }
 
 } // namespace
@@ -756,6 +789,8 @@ void process_octree_streaming(
 	process_octrees_sliding_box(state, viewer_pos, settings, data);
 
 	state.stats.blocked_lods = 0;
+	state.stats.updated_octrees = 0;
+	state.stats.checked_octree_nodes = 0;
 
 	// Find which blocks we need to load and see, within each octree
 	if (stream_enabled) {
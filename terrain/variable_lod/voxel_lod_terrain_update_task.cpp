@@ -33,12 +33,13 @@ void init_sparse_octree_priority_dependency( //
 		int data_block_size, //
 		std::shared_ptr<PriorityDependency::ViewersData> &shared_viewers_data, //
 		const Transform3D &volume_transform, //
-		float octree_lod_distance //
+		const VoxelLodTerrainUpdateData::Settings &settings //
 ) {
 	//
 	const Vector3i voxel_pos = get_block_center(block_position, data_block_size, lod);
 	const float block_radius = (data_block_size << lod) / 2;
 	dep.shared = shared_viewers_data;
+	dep.set_volume_task_priority(settings.task_priority);
 	dep.world_position = to_vec3f(volume_transform.xform(voxel_pos));
 	const float transformed_block_radius =
 			volume_transform.basis.xform(Vector3(block_radius, block_radius, block_radius)).length();
@@ -48,7 +49,7 @@ void init_sparse_octree_priority_dependency( //
 	// TODO Should `data_block_size` be used here? Should it be mesh_block_size instead?
 	dep.drop_distance_squared = math::squared(
 			2.f * transformed_block_radius *
-			VoxelEngine::get_octree_lod_block_region_extent(octree_lod_distance, data_block_size)
+			VoxelEngine::get_octree_lod_block_region_extent(settings.lod_distance, data_block_size)
 	);
 }
 
@@ -94,7 +95,7 @@ void request_block_generate( //
 			data_block_size,
 			shared_viewers_data,
 			volume_transform,
-			settings.lod_distance
+			settings
 	);
 
 	IThreadedTask *task = stream_dependency->generator->create_block_task(params);
@@ -146,7 +147,7 @@ void request_block_load( //
 				data_block_size,
 				shared_viewers_data,
 				volume_transform,
-				settings.lod_distance
+				settings
 		);
 
 		const bool request_instances = false;
@@ -224,6 +225,14 @@ void send_block_data_requests( //
 // This is used when streaming is enabled, yet the terrain has no stream and no generator (There can only be empty
 // blocks when moving around), or generating is configured to happen on the fly during meshing.
 // So we have to simulate a VoxelStream that returns empty blocks immediately.
+// When there is no stream, blocks that were never edited don't need a separate generation task before meshing: they
+// are considered loaded without voxels, so meshing tasks generate them directly into their padded buffer. If caching
+// is enabled, meshing tasks then store what they generated into the map. This saves a task round-trip, map locking
+// and a copy per block. GPU generation keeps using separate tasks when caching, since meshing tasks can't cache it.
+bool is_fused_generation_enabled(const VoxelLodTerrainUpdateData::Settings &settings, const VoxelData &data) {
+	return settings.cache_generated_blocks && !settings.generator_use_gpu && data.get_stream().is_null();
+}
+
 void apply_block_data_requests_as_empty( //
 		Span<const VoxelLodTerrainUpdateData::BlockToLoad> blocks_to_load, //
 		VoxelData &data, //
@@ -271,18 +280,20 @@ void request_voxel_block_save( //
 		std::shared_ptr<VoxelBuffer> &voxels, //
 		Vector3i block_pos, //
 		int lod_index, //
+		const std::shared_ptr<VoxelData> &data, //
 		std::shared_ptr<StreamingDependency> &stream_dependency, //
 		BufferedTaskScheduler &task_scheduler, //
 		std::shared_ptr<AsyncDependencyTracker> tracker, //
-		bool with_flush //
+		bool with_flush, //
+		uint8_t save_priority //
 ) {
 	CRASH_COND(stream_dependency == nullptr);
 	ERR_FAIL_COND(stream_dependency->stream.is_null());
 
 	SaveBlockDataTask *task =
 			ZN_NEW(SaveBlockDataTask(volume_id, block_pos, lod_index, voxels, stream_dependency, tracker, with_flush));
-
-	// No priority data, saving doesn't need sorting.
+	task->set_voxel_data(data);
+	task->set_save_priority(save_priority);
 
 	task_scheduler.push_io_task(task);
 }
@@ -295,6 +306,7 @@ void send_mesh_requests( //
 		std::shared_ptr<MeshingDependency> meshing_dependency, //
 		std::shared_ptr<PriorityDependency::ViewersData> &shared_viewers_data, //
 		const Transform3D &volume_transform, //
+		const std::shared_ptr<DetailTextureTileCache> &detail_texture_tile_cache, //
 		BufferedTaskScheduler &task_scheduler //
 ) {
 	ZN_PROFILE_SCOPE();
@@ -303,13 +315,15 @@ void send_mesh_requests( //
 	const VoxelData &data = *data_ptr;
 
 	const int data_block_size = data.get_block_size();
-	const int mesh_block_size = 1 << settings.mesh_block_size_po2;
-	const int render_to_data_factor = mesh_block_size / data_block_size;
 	const unsigned int lod_count = data.get_lod_count();
+	// See `is_fused_generation_enabled`
+	const bool cache_generated_blocks = is_fused_generation_enabled(settings, data);
 
 	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 		ZN_PROFILE_SCOPE();
 		VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
+		const int mesh_block_size = 1 << settings.get_lod_mesh_block_size_po2(lod_index);
+		const int render_to_data_factor = mesh_block_size / data_block_size;
 
 		for (unsigned int bi = 0; bi < lod.mesh_blocks_pending_update.size(); ++bi) {
 			ZN_PROFILE_SCOPE();
@@ -336,17 +350,26 @@ void send_mesh_requests( //
 			task->meshing_dependency = meshing_dependency;
 			task->data = data_ptr;
 			task->require_visual = mesh_to_update.require_visual;
-			task->collision_hint = settings.collision_enabled;
+			// Collision shapes may be built by the task, so don't ask for them on LODs that won't use them
+			task->collision_hint = settings.collision_enabled &&
+					(settings.collision_lod_count == 0 || lod_index < settings.collision_lod_count);
 			task->detail_texture_settings = settings.detail_texture_settings;
 			task->detail_texture_generator_override = settings.detail_texture_generator_override;
+			task->detail_texture_tile_cache = detail_texture_tile_cache;
 			task->detail_texture_generator_override_begin_lod_index =
 					settings.detail_texture_generator_override_begin_lod_index;
 			task->detail_texture_use_gpu = settings.detail_textures_use_gpu;
 			task->block_generation_use_gpu = settings.generator_use_gpu;
+			task->cache_generated_blocks = cache_generated_blocks;
 			task->cancellation_token = mesh_to_update.cancellation_token;
-
-			// Don't update a detail texture if one update is already processing
-			if (settings.detail_texture_settings.enabled &&
+			task->edited = mesh_to_update.edited;
+			task->defer_optimization = !mesh_to_update.optimization_pass;
+			task->optimization_pass = mesh_to_update.optimization_pass;
+			task->supersede_previous_tasks(mesh_block.mesh_version);
+
+			// Don't update a detail texture if one update is already processing.
+			// Optimization passes don't need one either, the voxels didn't change.
+			if (settings.detail_texture_settings.enabled && !mesh_to_update.optimization_pass &&
 				lod_index >= settings.detail_texture_settings.begin_lod_index &&
 				mesh_block.detail_texture_state != VoxelLodTerrainUpdateData::DETAIL_TEXTURE_PENDING) {
 				mesh_block.detail_texture_state = VoxelLodTerrainUpdateData::DETAIL_TEXTURE_PENDING;
@@ -373,7 +396,7 @@ void send_mesh_requests( //
 					mesh_block_size,
 					shared_viewers_data,
 					volume_transform,
-					settings.lod_distance
+					settings
 			);
 
 			task_scheduler.push_main_task(task);
@@ -531,7 +554,7 @@ void process_async_edits( //
 			boxes_to_preload.push_back(edit.box);
 			tasks_to_schedule.push_back(edit.task);
 			state.running_async_edits.push_back( //
-					VoxelLodTerrainUpdateData::RunningAsyncEdit{ edit.task_tracker, edit.box }
+					VoxelLodTerrainUpdateData::RunningAsyncEdit{ edit.task_tracker, edit.box, edit.batch_id }
 			);
 		}
 
@@ -554,13 +577,22 @@ void process_async_edits( //
 	}
 }
 
+// If a recently unloaded mesh block is affected by a change, it must not be restored as-is
+inline void invalidate_recently_unloaded_mesh_block(VoxelLodTerrainUpdateData::Lod &lod, Vector3i bpos) {
+	auto it = lod.recently_unloaded_mesh_blocks.find(bpos);
+	if (it != lod.recently_unloaded_mesh_blocks.end() && (it->second.visual || it->second.collision)) {
+		it->second.visual = false;
+		it->second.collision = false;
+		// Free it from the cache of the main thread early
+		lod.mesh_blocks_to_uncache.push_back(bpos);
+	}
+}
+
 void process_changed_generated_areas( //
 		VoxelLodTerrainUpdateData::State &state, //
 		const VoxelLodTerrainUpdateData::Settings &settings, //
 		unsigned int lod_count //
 ) {
-	const unsigned int mesh_block_size = 1 << settings.mesh_block_size_po2;
-
 	MutexLock lock(state.changed_generated_areas_mutex);
 	if (state.changed_generated_areas.size() == 0) {
 		return;
@@ -568,6 +600,7 @@ void process_changed_generated_areas( //
 
 	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 		VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
+		const unsigned int mesh_block_size = 1 << settings.get_lod_mesh_block_size_po2(lod_index);
 
 		for (auto box_it = state.changed_generated_areas.begin(); box_it != state.changed_generated_areas.end();
 			 ++box_it) {
@@ -587,6 +620,8 @@ void process_changed_generated_areas( //
 							lod.mesh_blocks_pending_update,
 							block_it->second.mesh_viewers.get() > 0
 					);
+				} else {
+					invalidate_recently_unloaded_mesh_block(lod, bpos);
 				}
 			});
 		}
@@ -595,11 +630,23 @@ void process_changed_generated_areas( //
 	state.changed_generated_areas.clear();
 }
 
+// Lets work of the update task be spread over the thread pool. The task waits for it before continuing.
+ParallelJobsScheduler get_thread_pool_scheduler() {
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = [](Span<IThreadedTask *> tasks) { //
+		VoxelEngine::get_singleton().push_async_tasks(tasks);
+	};
+	const unsigned int thread_count = VoxelEngine::get_singleton().get_thread_count();
+	scheduler.max_helpers = thread_count > 0 ? thread_count - 1 : 0;
+	return scheduler;
+}
+
 } // namespace
 
 void VoxelLodTerrainUpdateTask::send_block_save_requests( //
 		VolumeID volume_id, //
 		Span<VoxelData::BlockToSave> blocks_to_save, //
+		const std::shared_ptr<VoxelData> &data, //
 		std::shared_ptr<StreamingDependency> &stream_dependency, //
 		BufferedTaskScheduler &task_scheduler, //
 		std::shared_ptr<AsyncDependencyTracker> tracker, //
@@ -614,18 +661,20 @@ void VoxelLodTerrainUpdateTask::send_block_save_requests( //
 				b.voxels, //
 				b.position, //
 				b.lod_index, //
+				data, //
 				stream_dependency, //
 				task_scheduler, //
 				tracker, //
-				with_flush //
+				with_flush, //
+				b.save_priority //
 		);
 	}
 }
 
 void VoxelLodTerrainUpdateTask::flush_pending_lod_edits( //
 		VoxelLodTerrainUpdateData::State &state, //
-		VoxelData &data, //
-		const int mesh_block_size //
+		const VoxelLodTerrainUpdateData::Settings &settings, //
+		VoxelData &data //
 ) {
 	ZN_DSTACK();
 	ZN_PROFILE_SCOPE();
@@ -651,7 +700,9 @@ void VoxelLodTerrainUpdateTask::flush_pending_lod_edits( //
 
 	// Update all data LODs
 	// tls_updated_block_locations.clear();
-	data.update_lods(to_span(tls_modified_lod0_blocks), nullptr);
+	// Mips of distinct parent blocks are independent, so spread them over the thread pool. This task waits for them,
+	// since meshes are updated right after.
+	data.update_lods(to_span(tls_modified_lod0_blocks), nullptr, get_thread_pool_scheduler());
 
 	// Update affected meshes.
 	// TODO Optimize: trigger mesh updates at LOD0 earlier? There is a bit of latency due to doing all the mipping work
@@ -659,7 +710,7 @@ void VoxelLodTerrainUpdateTask::flush_pending_lod_edits( //
 	const unsigned int lod_count = data.get_lod_count();
 	for (unsigned int lod_index = 0; lod_index < lod_count; ++lod_index) {
 		VoxelLodTerrainUpdateData::Lod &lod = state.lods[lod_index];
-		const int mesh_block_size_at_lod = mesh_block_size << lod_index;
+		const int mesh_block_size_at_lod = 1 << (settings.get_lod_mesh_block_size_po2(lod_index) + lod_index);
 
 		for (const Box3i voxel_box : tls_modified_voxel_areas_lod0) {
 			// Padding is required for edits near chunk borders, which can affect multiple meshes despite only affecting
@@ -676,8 +727,11 @@ void VoxelLodTerrainUpdateTask::flush_pending_lod_edits( //
 							mesh_block_it->second, //
 							mesh_block_pos, //
 							lod.mesh_blocks_pending_update, //
-							mesh_block_it->second.mesh_viewers.get() > 0 //
+							mesh_block_it->second.mesh_viewers.get() > 0, //
+							true // edited
 					);
+				} else {
+					invalidate_recently_unloaded_mesh_block(lod, mesh_block_pos);
 				}
 			});
 		}
@@ -701,6 +755,7 @@ void VoxelLodTerrainUpdateTask::flush_pending_lod_edits( //
 
 uint8_t VoxelLodTerrainUpdateTask::get_transition_mask( //
 		const VoxelLodTerrainUpdateData::State &state, //
+		const VoxelLodTerrainUpdateData::Settings &settings, //
 		Vector3i block_pos, //
 		unsigned int lod_index, //
 		unsigned int lod_count //
@@ -737,8 +792,11 @@ uint8_t VoxelLodTerrainUpdateTask::get_transition_mask( //
 	}
 
 	{
-		const Vector3i lower_pos = block_pos >> 1;
-		const Vector3i upper_pos = block_pos << 1;
+		const unsigned int lower_shift = settings.get_parent_mesh_block_shift(lod_index);
+		const Vector3i lower_pos = block_pos >> lower_shift;
+		// Blocks of the upper LOD are children of this one
+		const unsigned int upper_shift = lod_index > 0 ? settings.get_parent_mesh_block_shift(lod_index - 1) : 1;
+		const Vector3i upper_pos = block_pos << upper_shift;
 
 		const VoxelLodTerrainUpdateData::Lod &lower_lod = state.lods[lod_index + 1];
 
@@ -752,7 +810,7 @@ uint8_t VoxelLodTerrainUpdateTask::get_transition_mask( //
 			}
 
 			const Vector3i side_normal = Cube::g_side_normals[dir];
-			const Vector3i lower_neighbor_pos = (block_pos + side_normal) >> 1;
+			const Vector3i lower_neighbor_pos = (block_pos + side_normal) >> lower_shift;
 
 			if (lower_neighbor_pos != lower_pos) {
 				auto lower_neighbor_block_it = lower_lod.mesh_map_state.map.find(lower_neighbor_pos);
@@ -767,14 +825,14 @@ uint8_t VoxelLodTerrainUpdateTask::get_transition_mask( //
 
 			if (lod_index > 0) {
 				// Check upper LOD neighbors.
-				// There are always 4 on each side, checking any is enough
+				// There are always 4 or 16 on each side, checking any is enough
 
 				Vector3i upper_neighbor_pos = upper_pos;
 				for (unsigned int i = 0; i < Vector3iUtil::AXIS_COUNT; ++i) {
 					if (side_normal[i] == -1) {
 						--upper_neighbor_pos[i];
 					} else if (side_normal[i] == 1) {
-						upper_neighbor_pos[i] += 2;
+						upper_neighbor_pos[i] += 1 << upper_shift;
 					}
 				}
 
@@ -795,6 +853,7 @@ uint8_t VoxelLodTerrainUpdateTask::get_transition_mask( //
 
 void update_transition_masks( //
 		VoxelLodTerrainUpdateData::State &state, //
+		const VoxelLodTerrainUpdateData::Settings &settings, //
 		uint32_t lods_to_update_transitions, //
 		unsigned int lod_count, //
 		// Currently needed to keep supporting the old octree streaming system, which doesn't support multiple viewers
@@ -829,8 +888,9 @@ void update_transition_masks( //
 				VoxelLodTerrainUpdateData::MeshBlockState &mesh_block = it->second;
 
 				if (mesh_block.visual_active && (!use_refcounts || mesh_block.mesh_viewers.get() > 0)) {
-					const uint8_t recomputed_mask =
-							VoxelLodTerrainUpdateTask::get_transition_mask(state, it->first, lod_index, lod_count);
+					const uint8_t recomputed_mask = VoxelLodTerrainUpdateTask::get_transition_mask(
+							state, settings, it->first, lod_index, lod_count
+					);
 
 					if (recomputed_mask != it->second.transition_mask) {
 						mesh_block.transition_mask = recomputed_mask;
@@ -851,8 +911,9 @@ void update_transition_masks( //
 			RWLockRead rlock(lod.mesh_map_state.map_lock);
 			for (auto it = lod.mesh_map_state.map.begin(); it != lod.mesh_map_state.map.end(); ++it) {
 				if (it->second.active) {
-					const uint8_t recomputed_mask =
-							VoxelLodTerrainUpdateTask::get_transition_mask(state, it->first, lod_index, lod_count);
+					const uint8_t recomputed_mask = VoxelLodTerrainUpdateTask::get_transition_mask(
+							state, settings, it->first, lod_index, lod_count
+					);
 					CRASH_COND(recomputed_mask != it->second.transition_mask);
 				}
 			}
@@ -918,6 +979,8 @@ void VoxelLodTerrainUpdateTask::run(ThreadedTaskContext &ctx) {
 		CRASH_COND(lod.mesh_blocks_to_deactivate_visuals.size() != 0);
 		CRASH_COND(lod.mesh_blocks_to_activate_collision.size() != 0);
 		CRASH_COND(lod.mesh_blocks_to_deactivate_collision.size() != 0);
+		CRASH_COND(lod.mesh_blocks_to_restore.size() != 0);
+		CRASH_COND(lod.mesh_blocks_to_uncache.size() != 0);
 	}
 #endif
 
@@ -930,7 +993,7 @@ void VoxelLodTerrainUpdateTask::run(ThreadedTaskContext &ctx) {
 	// These are deferred from edits so we can batch them.
 	// It has to happen first because blocks can be unloaded afterwards.
 	// This is also what causes meshes to update after edits.
-	flush_pending_lod_edits(state, data, 1 << settings.mesh_block_size_po2);
+	flush_pending_lod_edits(state, settings, data);
 
 	// Other mesh updates
 	process_changed_generated_areas(state, settings, lod_count);
@@ -964,11 +1027,15 @@ void VoxelLodTerrainUpdateTask::run(ThreadedTaskContext &ctx) {
 				data_blocks_to_load, //
 				settings, //
 				stream_enabled, //
-				_meshing_dependency->mesher.is_valid() //
+				_meshing_dependency->mesher.is_valid(), //
+				get_thread_pool_scheduler() //
 		);
 	}
 	state.stats.time_detect_required_blocks = profiling_clock.restart();
 
+	// Cached blocks are not needed to keep the terrain working, they can be generated again if needed
+	data.evict_cached_blocks(data_blocks_to_save);
+
 	BufferedTaskScheduler &task_scheduler = BufferedTaskScheduler::get_for_current_thread();
 
 	process_async_edits( //
@@ -992,7 +1059,11 @@ void VoxelLodTerrainUpdateTask::run(ThreadedTaskContext &ctx) {
 			// This part would still "work" without that check because `data_blocks_to_load` would be empty,
 			// but I added this for expliciteness
 			if (data.is_streaming_enabled()) {
-				if (stream.is_null() && !settings.cache_generated_blocks) {
+				// Blocks may be generated on the fly by meshing tasks, see `is_fused_generation_enabled`
+				const bool generate_on_the_fly =
+						!settings.cache_generated_blocks || is_fused_generation_enabled(settings, data);
+
+				if (stream.is_null() && generate_on_the_fly) {
 					// TODO Optimization: not ideal because a bit delayed. It requires a second update cycle for meshes
 					// to get requested. We could instead set those empty blocks right away instead of putting them in
 					// that list, but it's simpler code for now.
@@ -1018,6 +1089,7 @@ void VoxelLodTerrainUpdateTask::run(ThreadedTaskContext &ctx) {
 				send_block_save_requests( //
 						_volume_id, //
 						to_span(*data_blocks_to_save), //
+						_data, //
 						_streaming_dependency, //
 						task_scheduler, //
 						nullptr, //
@@ -1043,6 +1115,7 @@ void VoxelLodTerrainUpdateTask::run(ThreadedTaskContext &ctx) {
 				_meshing_dependency, //
 				_shared_viewers_data, //
 				_volume_transform, //
+				update_data.detail_texture_tile_cache, //
 				task_scheduler //
 		);
 	}
@@ -53,12 +53,13 @@ public:
 
 	static void flush_pending_lod_edits( //
 			VoxelLodTerrainUpdateData::State &state, //
-			VoxelData &data, //
-			const int mesh_block_size //
+			const VoxelLodTerrainUpdateData::Settings &settings, //
+			VoxelData &data //
 	);
 
 	static uint8_t get_transition_mask( //
 			const VoxelLodTerrainUpdateData::State &state, //
+			const VoxelLodTerrainUpdateData::Settings &settings, //
 			Vector3i block_pos, //
 			unsigned int lod_index, //
 			unsigned int lod_count //
@@ -69,25 +70,37 @@ public:
 			VoxelLodTerrainUpdateData::MeshBlockState &block, //
 			Vector3i bpos, //
 			StdVector<VoxelLodTerrainUpdateData::MeshToUpdate> &blocks_pending_update, //
-			bool require_visual //
+			bool require_visual, //
+			bool edited = false //
 	) {
 		if (block.state != VoxelLodTerrainUpdateData::MESH_UPDATE_NOT_SENT) {
 			if (block.visual_active || block.collision_active) {
 				// Schedule an update
 				block.state = VoxelLodTerrainUpdateData::MESH_UPDATE_NOT_SENT;
 				block.update_list_index = blocks_pending_update.size();
-				blocks_pending_update.push_back(
-						VoxelLodTerrainUpdateData::MeshToUpdate{ bpos, TaskCancellationToken(), require_visual });
+				blocks_pending_update.push_back(VoxelLodTerrainUpdateData::MeshToUpdate{
+						bpos, TaskCancellationToken(), require_visual, edited });
 			} else {
 				// Just mark it as needing update, so the visibility system will schedule its update when needed.
 				block.state = VoxelLodTerrainUpdateData::MESH_NEED_UPDATE;
 			}
+
+		} else if (edited && block.update_list_index >= 0 &&
+				   block.update_list_index < static_cast<int>(blocks_pending_update.size())) {
+			// Already pending, an edit makes it more urgent
+			VoxelLodTerrainUpdateData::MeshToUpdate &u = blocks_pending_update[block.update_list_index];
+			if (u.position == bpos) {
+				u.edited = true;
+				// Optimizing would delay the edit, it will be done later again
+				u.optimization_pass = false;
+			}
 		}
 	}
 
 	static void send_block_save_requests( //
 			VolumeID volume_id, //
 			Span<VoxelData::BlockToSave> blocks_to_save, //
+			const std::shared_ptr<VoxelData> &data, //
 			std::shared_ptr<StreamingDependency> &stream_dependency, //
 			BufferedTaskScheduler &task_scheduler, //
 			std::shared_ptr<AsyncDependencyTracker> tracker, //
@@ -107,6 +120,7 @@ private:
 
 void update_transition_masks( //
 		VoxelLodTerrainUpdateData::State &state, //
+		const VoxelLodTerrainUpdateData::Settings &settings, //
 		uint32_t lods_to_update_transitions, //
 		unsigned int lod_count, //
 		bool use_refcounts //
@@ -2,6 +2,7 @@
 #include "../../constants/voxel_string_names.h"
 #include "../../util/godot/classes/array_mesh.h"
 #include "../../util/godot/classes/mesh.h"
+#include "../../util/godot/shader_material_pool.h"
 #include "../../util/profiling.h"
 #include "../free_mesh_task.h"
 
@@ -9,6 +10,26 @@ using namespace zylann::godot;
 
 namespace zylann::voxel {
 
+namespace {
+
+uint8_t encode_transition_mask_for_shader(uint8_t m) {
+	// TODO Needs translation here, because Cube:: tables use slightly different order...
+	// We may get rid of this once cube tables respects -x+x-y+y-z+z order
+	uint8_t bits[Cube::SIDE_COUNT];
+	for (unsigned int dir = 0; dir < Cube::SIDE_COUNT; ++dir) {
+		bits[dir] = (m >> dir) & 1;
+	}
+	uint8_t tm = bits[Cube::SIDE_NEGATIVE_X];
+	tm |= bits[Cube::SIDE_POSITIVE_X] << 1;
+	tm |= bits[Cube::SIDE_NEGATIVE_Y] << 2;
+	tm |= bits[Cube::SIDE_POSITIVE_Y] << 3;
+	tm |= bits[Cube::SIDE_NEGATIVE_Z] << 4;
+	tm |= bits[Cube::SIDE_POSITIVE_Z] << 5;
+	return tm;
+}
+
+} // namespace
+
 VoxelMeshBlockVLT::VoxelMeshBlockVLT(const Vector3i bpos, unsigned int size, unsigned int p_lod_index) :
 		VoxelMeshBlock(bpos) {
 	_position_in_voxels = bpos * (size << p_lod_index);
@@ -93,6 +114,9 @@ void VoxelMeshBlockVLT::set_mesh(
 			_mesh_instance.set_cast_shadows_setting(shadow_casting);
 			_mesh_instance.set_render_layers_mask(render_layers_mask);
 			set_mesh_instance_visible(_mesh_instance, _visible && _parent_visible);
+			if (_shader_instance_uniforms_enabled) {
+				copy_shader_instance_parameters(_mesh_instance);
+			}
 		}
 
 		_mesh_instance.set_mesh(mesh);
@@ -141,6 +165,7 @@ void VoxelMeshBlockVLT::drop_visuals() {
 	fading_progress = 0.f;
 	visual_active = false;
 	_transition_mask = 0;
+	_shader_lod_fade = Vector2();
 }
 
 void VoxelMeshBlockVLT::set_gi_mode(GeometryInstance3D::GIMode mode) {
@@ -191,6 +216,9 @@ void VoxelMeshBlockVLT::set_transition_mesh(
 			mesh_instance.set_cast_shadows_setting(shadow_casting);
 			mesh_instance.set_render_layers_mask(render_layers_mask);
 			set_mesh_instance_visible(mesh_instance, _visible && _parent_visible && _is_transition_visible(side));
+			if (_shader_instance_uniforms_enabled) {
+				copy_shader_instance_parameters(mesh_instance);
+			}
 		}
 
 		mesh_instance.set_mesh(mesh);
@@ -252,13 +280,84 @@ void VoxelMeshBlockVLT::set_shader_material(Ref<ShaderMaterial> material) {
 	set_material_override_internal(material);
 
 	if (_shader_material.is_valid()) {
-		const Transform3D local_transform(Basis(), _position_in_voxels);
 		const VoxelStringNames &sn = VoxelStringNames::get_singleton();
-		_shader_material->set_shader_parameter(sn.u_block_local_transform, local_transform);
-		_shader_material->set_shader_parameter(sn.u_voxel_virtual_texture_offset_scale, Vector4(0, 0, 0, 1));
+		if (!_shader_instance_uniforms_enabled) {
+			// Otherwise they are set on mesh instances
+			const Transform3D local_transform(Basis(), _position_in_voxels);
+			set_shader_parameter_if_changed(**_shader_material, sn.u_block_local_transform, local_transform);
+			set_shader_parameter_if_changed(
+					**_shader_material, sn.u_transition_mask, encode_transition_mask_for_shader(_transition_mask)
+			);
+			set_shader_parameter_if_changed(**_shader_material, sn.u_lod_fade, _shader_lod_fade);
+			if (_shader_lod_info != 0) {
+				set_shader_parameter_if_changed(**_shader_material, sn.u_voxel_lod_info, _shader_lod_info);
+			}
+		}
+		set_shader_parameter_if_changed(
+				**_shader_material, sn.u_voxel_virtual_texture_offset_scale, Vector4(0, 0, 0, 1)
+		);
+	}
+}
+
+void VoxelMeshBlockVLT::set_shader_instance_uniforms_enabled(bool enabled) {
+	if (_shader_instance_uniforms_enabled == enabled) {
+		return;
+	}
+	_shader_instance_uniforms_enabled = enabled;
+	if (enabled) {
+		if (_mesh_instance.is_valid()) {
+			copy_shader_instance_parameters(_mesh_instance);
+		}
+		for (DirectMeshInstance &mi : _transition_mesh_instances) {
+			if (mi.is_valid()) {
+				copy_shader_instance_parameters(mi);
+			}
+		}
+	}
+}
+
+void VoxelMeshBlockVLT::copy_shader_instance_parameters(DirectMeshInstance &mi) const {
+	const VoxelStringNames &sn = VoxelStringNames::get_singleton();
+	mi.set_shader_instance_parameter(sn.u_transition_mask, encode_transition_mask_for_shader(_transition_mask));
+	mi.set_shader_instance_parameter(sn.u_lod_fade, _shader_lod_fade);
+	mi.set_shader_instance_parameter(sn.u_block_local_transform, Transform3D(Basis(), _position_in_voxels));
+	// Only set if the shader uses it (the value can't be zero otherwise)
+	if (_shader_lod_info != 0) {
+		mi.set_shader_instance_parameter(sn.u_voxel_lod_info, _shader_lod_info);
 	}
 }
 
+void VoxelMeshBlockVLT::set_per_block_shader_parameter(const StringName &name, const Variant &value) {
+	if (_shader_instance_uniforms_enabled) {
+		if (_mesh_instance.is_valid()) {
+			_mesh_instance.set_shader_instance_parameter(name, value);
+		}
+		for (DirectMeshInstance &mi : _transition_mesh_instances) {
+			if (mi.is_valid()) {
+				mi.set_shader_instance_parameter(name, value);
+			}
+		}
+	} else if (_shader_material.is_valid()) {
+		set_shader_parameter_if_changed(**_shader_material, name, value);
+	}
+}
+
+void VoxelMeshBlockVLT::set_shader_lod_fade(Vector2 p) {
+	if (_shader_instance_uniforms_enabled && p == _shader_lod_fade) {
+		return;
+	}
+	_shader_lod_fade = p;
+	set_per_block_shader_parameter(VoxelStringNames::get_singleton().u_lod_fade, p);
+}
+
+void VoxelMeshBlockVLT::set_shader_lod_info(int lod_info) {
+	if (_shader_instance_uniforms_enabled && lod_info == _shader_lod_info) {
+		return;
+	}
+	_shader_lod_info = lod_info;
+	set_per_block_shader_parameter(VoxelStringNames::get_singleton().u_voxel_lod_info, lod_info);
+}
+
 void VoxelMeshBlockVLT::set_material_override(Ref<Material> material) {
 #ifdef DEBUG_ENABLED
 	Ref<ShaderMaterial> sm = material;
@@ -301,23 +400,9 @@ void VoxelMeshBlockVLT::set_transition_mask(uint8_t m) {
 		return;
 	}
 	_transition_mask = m;
-	if (_shader_material.is_valid()) {
-		// TODO Needs translation here, because Cube:: tables use slightly different order...
-		// We may get rid of this once cube tables respects -x+x-y+y-z+z order
-		uint8_t bits[Cube::SIDE_COUNT];
-		for (unsigned int dir = 0; dir < Cube::SIDE_COUNT; ++dir) {
-			bits[dir] = (m >> dir) & 1;
-		}
-		uint8_t tm = bits[Cube::SIDE_NEGATIVE_X];
-		tm |= bits[Cube::SIDE_POSITIVE_X] << 1;
-		tm |= bits[Cube::SIDE_NEGATIVE_Y] << 2;
-		tm |= bits[Cube::SIDE_POSITIVE_Y] << 3;
-		tm |= bits[Cube::SIDE_NEGATIVE_Z] << 4;
-		tm |= bits[Cube::SIDE_POSITIVE_Z] << 5;
-
-		// TODO Godot 4: we may replace this with a per-instance parameter so we can lift material access limitation
-		_shader_material->set_shader_parameter(VoxelStringNames::get_singleton().u_transition_mask, tm);
-	}
+	set_per_block_shader_parameter(
+			VoxelStringNames::get_singleton().u_transition_mask, encode_transition_mask_for_shader(m)
+	);
 	for (int dir = 0; dir < Cube::SIDE_COUNT; ++dir) {
 		DirectMeshInstance &mi = _transition_mesh_instances[dir];
 		if (mi.is_valid() && (diff & (1 << dir))) {
@@ -418,9 +503,7 @@ bool VoxelMeshBlockVLT::update_fading(float speed) {
 			break;
 	}
 
-	if (_shader_material.is_valid()) {
-		_shader_material->set_shader_parameter(VoxelStringNames::get_singleton().u_lod_fade, p);
-	}
+	set_shader_lod_fade(p);
 
 	return finished;
 }
@@ -428,9 +511,7 @@ bool VoxelMeshBlockVLT::update_fading(float speed) {
 void VoxelMeshBlockVLT::clear_fading() {
 	fading_state = FADING_NONE;
 	fading_progress = 0.f;
-	if (_shader_material.is_valid()) {
-		_shader_material->set_shader_parameter(VoxelStringNames::get_singleton().u_lod_fade, Vector2(0.0, 0.0));
-	}
+	set_shader_lod_fade(Vector2(0.0, 0.0));
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -37,7 +37,14 @@ public:
 	uint8_t detail_texture_fallback_level = 0;
 
 	uint64_t last_collider_update_time = 0;
-	UniquePtr<VoxelMesher::Output> deferred_collider_data;
+
+	struct DeferredCollider {
+		// Collision data to build the shape from, if it was not already built in a thread
+		VoxelMesher::Output surfaces;
+		Ref<Shape3D> shape;
+		bool has_shape = false;
+	};
+	UniquePtr<DeferredCollider> deferred_collider_data;
 
 	VoxelMeshBlockVLT(const Vector3i bpos, unsigned int size, unsigned int p_lod_index);
 	~VoxelMeshBlockVLT();
@@ -88,6 +95,20 @@ public:
 		return _shader_material;
 	}
 
+	// When enabled, per-block shader parameters (transition mask, LOD fade, block transform and LOD info) are set as
+	// per-instance uniforms of mesh instances, instead of parameters of the block's material. This allows blocks to
+	// share the same material.
+	void set_shader_instance_uniforms_enabled(bool enabled);
+	inline bool is_using_shader_instance_uniforms() const {
+		return _shader_instance_uniforms_enabled;
+	}
+
+	void set_shader_lod_fade(Vector2 p);
+	void set_shader_lod_info(int lod_info);
+
+	// Copies per-block parameters to another mesh instance showing the same mesh, when instance uniforms are used
+	void copy_shader_instance_parameters(zylann::godot::DirectMeshInstance &mi) const;
+
 	// To be used only if the material override on the terrain is not a ShaderMaterial
 	void set_material_override(Ref<Material> material);
 
@@ -118,6 +139,7 @@ public:
 private:
 	void set_material_override_internal(Ref<Material> material);
 	void _set_visible(bool visible);
+	void set_per_block_shader_parameter(const StringName &name, const Variant &value);
 
 	inline bool _is_transition_visible(unsigned int side) const {
 		return _transition_mask & (1 << side);
@@ -128,6 +150,10 @@ private:
 	FixedArray<zylann::godot::DirectMeshInstance, Cube::SIDE_COUNT> _transition_mesh_instances;
 
 	uint8_t _transition_mask = 0;
+	bool _shader_instance_uniforms_enabled = false;
+	// Per-block parameters are cached, since mesh instances can be created after they are set
+	Vector2 _shader_lod_fade;
+	int _shader_lod_info = 0;
 
 	// See VoxelMesherBlocky.
 	// This unfortunately has to be a whole separate mesh instance because Godot doesn't support setting
@@ -10,6 +10,7 @@ namespace zylann::voxel {
 VoxelAStarGrid3DInternal::VoxelAStarGrid3DInternal() : _voxel_buffer(VoxelBuffer::ALLOCATOR_POOL) {}
 
 void VoxelAStarGrid3DInternal::init_cache() {
+	_grid_cache_region = get_region();
 	_grid_cache_size = math::ceildiv(get_region().size, Chunk::SIZE);
 	_grid_cache.resize(_grid_cache_size.x * _grid_cache_size.y * _grid_cache_size.z);
 	_grid_chunk_states.resize_no_init(_grid_cache.size());
@@ -33,9 +34,29 @@ void VoxelAStarGrid3DInternal::init_cache() {
 	// }
 }
 
+void VoxelAStarGrid3DInternal::clear_cache() {
+	_grid_cache.clear();
+	_grid_chunk_states.resize_no_init(0);
+	_grid_cache_size = Vector3i();
+	_grid_cache_region = Box3i();
+}
+
+void VoxelAStarGrid3DInternal::invalidate_cache(Box3i box) {
+	box = box.clipped(_grid_cache_region);
+	if (box.is_empty()) {
+		return;
+	}
+	const Vector3i min_pos = box.position - _grid_cache_region.position;
+	const Vector3i max_pos = min_pos + box.size - Vector3i(1, 1, 1);
+	const Box3i chunks_box = Box3i::from_min_max(min_pos >> Chunk::SIZE_PO2, (max_pos >> Chunk::SIZE_PO2) + 1);
+	chunks_box.for_each_cell_zxy([this](Vector3i cpos) {
+		_grid_chunk_states.set(Vector3iUtil::get_zxy_index(cpos, _grid_cache_size), false);
+	});
+}
+
 bool VoxelAStarGrid3DInternal::is_solid(Vector3i pos) {
 	// TODO We could align the cache with the voxel chunk grid to avoid more expensive copies across chunk borders
-	const Vector3i gpos = pos - get_region().position;
+	const Vector3i gpos = pos - _grid_cache_region.position;
 	const Vector3i cpos = gpos >> Chunk::SIZE_PO2;
 	const Vector3i rpos = gpos & Chunk::SIZE_MASK;
 
@@ -50,7 +71,7 @@ bool VoxelAStarGrid3DInternal::is_solid(Vector3i pos) {
 		ZN_ASSERT(data != nullptr);
 
 		const VoxelBuffer::ChannelId channel_index = VoxelBuffer::CHANNEL_TYPE;
-		const Vector3i copy_origin = (cpos << Chunk::SIZE_PO2) + get_region().position;
+		const Vector3i copy_origin = (cpos << Chunk::SIZE_PO2) + _grid_cache_region.position;
 		data->copy(copy_origin, _voxel_buffer, 1 << channel_index);
 
 		if (_voxel_buffer.get_channel_compression(channel_index) == VoxelBuffer::COMPRESSION_UNIFORM) {
@@ -89,10 +110,9 @@ bool VoxelAStarGrid3DInternal::is_solid(Vector3i pos) {
 					ZN_PRINT_ERROR("Unhandled channel depth");
 					break;
 			}
-
-			_grid_chunk_states.set(chunk_loc);
 		}
 
+		_grid_chunk_states.set(chunk_loc);
 		_grid_cache[chunk_loc] = chunk;
 	}
 
@@ -106,6 +126,10 @@ void VoxelAStarGrid3D::set_terrain(VoxelTerrain *node) {
 	// Can't modify the pathfinder while it is running in a different thread
 	ZN_ASSERT_RETURN(_is_running_async == false);
 	_path_finder.data = node->get_storage_shared();
+	_path_finder.clear_cache();
+	// Portals are found per data block
+	_hierarchy.set_cluster_size(_path_finder.data->get_block_size());
+	_hierarchy.clear();
 }
 
 TypedArray<Vector3i> VoxelAStarGrid3D::find_path(Vector3i from_position, Vector3i to_position) {
@@ -165,13 +189,48 @@ TypedArray<Vector3i> VoxelAStarGrid3D::find_path_internal(Vector3i from_position
 void VoxelAStarGrid3D::set_region(Box3i region) {
 	ZN_ASSERT_RETURN(_is_running_async == false);
 	_path_finder.set_region(region);
+	_hierarchy.set_region(region);
 }
 
 Box3i VoxelAStarGrid3D::get_region() {
 	return _path_finder.get_region();
 }
 
+TypedArray<Vector3i> VoxelAStarGrid3D::find_path_hierarchical(Vector3i from_position, Vector3i to_position) {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(_is_running_async == false, TypedArray<Vector3i>());
+#ifdef DEBUG_ENABLED
+	check_params(from_position, to_position);
+#endif
+	return find_path_hierarchical_internal(from_position, to_position);
+}
+
+TypedArray<Vector3i> VoxelAStarGrid3D::find_path_hierarchical_internal(Vector3i from_position, Vector3i to_position) {
+	// Unlike regular searches, voxels remain cached between queries
+	if (!_path_finder.has_cache_for_current_region()) {
+		_path_finder.init_cache();
+	}
+
+	StdVector<Vector3i> path;
+	_hierarchy.find_path(_path_finder, from_position, to_position, path);
+	return to_typed_array(to_span(path));
+}
+
+void VoxelAStarGrid3D::invalidate_area(Box3i box) {
+	ZN_ASSERT_RETURN(_is_running_async == false);
+	_path_finder.invalidate_cache(box);
+	_hierarchy.invalidate(box);
+}
+
 void VoxelAStarGrid3D::find_path_async(Vector3i from_position, Vector3i to_position) {
+	start_async_search(from_position, to_position, false);
+}
+
+void VoxelAStarGrid3D::find_path_hierarchical_async(Vector3i from_position, Vector3i to_position) {
+	start_async_search(from_position, to_position, true);
+}
+
+void VoxelAStarGrid3D::start_async_search(Vector3i from_position, Vector3i to_position, bool hierarchical) {
 	ZN_ASSERT_RETURN(_is_running_async == false);
 
 #ifdef DEBUG_ENABLED
@@ -185,10 +244,13 @@ void VoxelAStarGrid3D::find_path_async(Vector3i from_position, Vector3i to_posit
 		Ref<VoxelAStarGrid3D> astar;
 		Vector3i from_position;
 		Vector3i to_position;
+		bool hierarchical;
 
 		void run(ThreadedTaskContext &ctx) override {
 			ZN_ASSERT(astar.is_valid());
-			TypedArray<Vector3i> path = astar->find_path_internal(from_position, to_position);
+			TypedArray<Vector3i> path = hierarchical
+					? astar->find_path_hierarchical_internal(from_position, to_position)
+					: astar->find_path_internal(from_position, to_position);
 			astar->call_deferred(VoxelStringNames::get_singleton()._on_async_search_completed, path);
 		}
 
@@ -201,6 +263,7 @@ void VoxelAStarGrid3D::find_path_async(Vector3i from_position, Vector3i to_posit
 	task->astar = Ref<VoxelAStarGrid3D>(this);
 	task->from_position = from_position;
 	task->to_position = to_position;
+	task->hierarchical = hierarchical;
 
 	VoxelEngine::get_singleton().push_async_task(task);
 }
@@ -225,6 +288,10 @@ AABB VoxelAStarGrid3D::_b_get_region() {
 	return AABB(to_vec3(region.position), to_vec3(region.size));
 }
 
+void VoxelAStarGrid3D::_b_invalidate_area(AABB aabb) {
+	invalidate_area(Box3i::from_min_max(math::floor_to_int(aabb.position), math::ceil_to_int(aabb.get_end())));
+}
+
 // Intermediate method to enforce the signal to be emitted on the main thread
 void VoxelAStarGrid3D::_b_on_async_search_completed(TypedArray<Vector3i> path) {
 	_is_running_async = false;
@@ -243,6 +310,16 @@ void VoxelAStarGrid3D::_bind_methods() {
 	);
 	ClassDB::bind_method(D_METHOD("is_running_async"), &VoxelAStarGrid3D::is_running_async);
 
+	ClassDB::bind_method(
+			D_METHOD("find_path_hierarchical", "from_position", "to_position"),
+			&VoxelAStarGrid3D::find_path_hierarchical
+	);
+	ClassDB::bind_method(
+			D_METHOD("find_path_hierarchical_async", "from_position", "to_position"),
+			&VoxelAStarGrid3D::find_path_hierarchical_async
+	);
+	ClassDB::bind_method(D_METHOD("invalidate_area", "box"), &VoxelAStarGrid3D::_b_invalidate_area);
+
 	ClassDB::bind_method(D_METHOD("debug_get_visited_positions"), &VoxelAStarGrid3D::debug_get_visited_positions);
 
 	// Internal
@@ -6,6 +6,7 @@
 #include "../util/a_star_grid_3d.h"
 #include "../util/containers/dynamic_bitset.h"
 #include "../util/containers/std_vector.h"
+#include "../util/hierarchical_a_star_grid_3d.h"
 #include <atomic>
 
 namespace zylann::voxel {
@@ -22,6 +23,13 @@ public:
 	std::shared_ptr<VoxelData> data;
 
 	void init_cache();
+	void clear_cache();
+	// Voxels in the box will be read again next time they are needed
+	void invalidate_cache(Box3i box);
+
+	inline bool has_cache_for_current_region() const {
+		return _grid_cache.size() > 0 && _grid_cache_region == get_region();
+	}
 
 protected:
 	bool is_solid(Vector3i pos) override;
@@ -45,9 +53,11 @@ private:
 		}
 	};
 
-	// Cached 3D bitmap
+	// Cached 3D bitmap. The region may be changed after the cache is initialized, as long as it remains within the
+	// cached region.
 	StdVector<Chunk> _grid_cache;
 	Vector3i _grid_cache_size;
+	Box3i _grid_cache_region;
 
 	// Tracks which chunks are loaded
 	DynamicBitset _grid_chunk_states;
@@ -61,7 +71,8 @@ class VoxelAStarGrid3D : public RefCounted {
 	GDCLASS(VoxelAStarGrid3D, RefCounted)
 public:
 	// Bare bones at the moment. May need more configurations and customization.
-	// Also, it does not cache data between queries.
+	// Regular searches do not cache data between queries. Hierarchical searches cache voxels and a graph of portals
+	// between data blocks, which must be invalidated when voxels change.
 
 	void set_terrain(VoxelTerrain *node);
 
@@ -73,21 +84,29 @@ public:
 	void find_path_async(Vector3i from_position, Vector3i to_position);
 	bool is_running_async() const;
 
+	TypedArray<Vector3i> find_path_hierarchical(Vector3i from_position, Vector3i to_position);
+	void find_path_hierarchical_async(Vector3i from_position, Vector3i to_position);
+	void invalidate_area(Box3i box);
+
 	TypedArray<Vector3i> debug_get_visited_positions() const;
 
 private:
 	TypedArray<Vector3i> find_path_internal(Vector3i from_position, Vector3i to_position);
+	TypedArray<Vector3i> find_path_hierarchical_internal(Vector3i from_position, Vector3i to_position);
+	void start_async_search(Vector3i from_position, Vector3i to_position, bool hierarchical);
 #ifdef DEBUG_ENABLED
 	void check_params(Vector3i from_position, Vector3i to_position);
 #endif
 
 	void _b_set_region(AABB aabb);
 	AABB _b_get_region();
+	void _b_invalidate_area(AABB aabb);
 	void _b_on_async_search_completed(TypedArray<Vector3i> path);
 
 	static void _bind_methods();
 
 	VoxelAStarGrid3DInternal _path_finder;
+	HierarchicalAStarGrid3D _hierarchy;
 	std::atomic_bool _is_running_async = { false };
 };
 
@@ -1,5 +1,6 @@
 #include "voxel_mesh_block.h"
 #include "../constants/voxel_string_names.h"
+#include "../util/godot/classes/array_mesh.h"
 #include "../util/godot/classes/collision_shape_3d.h"
 #include "../util/godot/classes/concave_polygon_shape_3d.h"
 #include "../util/godot/classes/node_3d.h"
@@ -94,6 +95,19 @@ bool VoxelMeshBlock::has_mesh() const {
 	return _mesh_instance.get_mesh().is_valid();
 }
 
+void VoxelMeshBlock::get_mesh_size(uint64_t &out_vertex_count, uint64_t &out_index_count) const {
+	// Sizes are only exposed on `ArrayMesh` in the extension API
+	Ref<ArrayMesh> mesh = get_mesh();
+	if (mesh.is_null()) {
+		return;
+	}
+	const int surface_count = mesh->get_surface_count();
+	for (int surface_index = 0; surface_index < surface_count; ++surface_index) {
+		out_vertex_count += mesh->surface_get_array_len(surface_index);
+		out_index_count += mesh->surface_get_array_index_len(surface_index);
+	}
+}
+
 void VoxelMeshBlock::drop_mesh() {
 	if (_mesh_instance.is_valid()) {
 		_mesh_instance.destroy();
@@ -45,6 +45,9 @@ public:
 	bool has_mesh() const;
 	void drop_mesh();
 
+	// Adds how many vertices and indices the mesh has, to estimate how much memory it uses
+	void get_mesh_size(uint64_t &out_vertex_count, uint64_t &out_index_count) const;
+
 	// Note, GIMode is not stored per block, it is a shared option so we provide it in several functions.
 	// Call this function only if the mesh block already exists and has not changed mesh
 	void set_gi_mode(GeometryInstance3D::GIMode mode);
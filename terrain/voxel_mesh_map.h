@@ -2,13 +2,13 @@
 #define VOXEL_MESH_MAP_H
 
 #include "../engine/voxel_engine.h"
-#include "../util/containers/std_unordered_map.h"
-#include "../util/containers/std_vector.h"
+#include "../util/containers/vector3i_sparse_grid.h"
 #include "../util/macros.h"
 
 namespace zylann::voxel {
 
 // Stores meshes and colliders in an infinite sparse grid of chunks (aka blocks).
+// Blocks are referenced from a `Vector3iSparseGrid`, so neighbor lookups and iteration stay contiguous in memory.
 template <typename MeshBlock_T>
 class VoxelMeshMap {
 public:
@@ -27,34 +27,41 @@ public:
 		if (_last_accessed_block && _last_accessed_block->position == bpos) {
 			_last_accessed_block = nullptr;
 		}
-		auto it = _blocks_map.find(bpos);
-		if (it != _blocks_map.end()) {
-			const unsigned int i = it->second.index;
-#ifdef DEBUG_ENABLED
-			CRASH_COND(i >= _blocks.size());
-#endif
-			MeshBlock_T *block = _blocks[i];
+		auto it = _blocks.find(bpos);
+		if (it != _blocks.end()) {
+			MeshBlock_T *block = it->second;
 			ERR_FAIL_COND(block == nullptr);
 			pre_delete(*block);
 			queue_free_mesh_block(block);
-			remove_block_internal(it, i);
+			_blocks.erase(it);
+		}
+	}
+
+	// Removes a block from the map without freeing it, the caller becomes responsible for it.
+	// Returns null if there is no block at the given position.
+	MeshBlock_T *take_block(Vector3i bpos) {
+		if (_last_accessed_block && _last_accessed_block->position == bpos) {
+			_last_accessed_block = nullptr;
+		}
+		auto it = _blocks.find(bpos);
+		if (it == _blocks.end()) {
+			return nullptr;
 		}
+		MeshBlock_T *block = it->second;
+		_blocks.erase(it);
+		return block;
 	}
 
 	MeshBlock_T *get_block(Vector3i bpos) {
 		if (_last_accessed_block && _last_accessed_block->position == bpos) {
 			return _last_accessed_block;
 		}
-		auto it = _blocks_map.find(bpos);
-		if (it != _blocks_map.end()) {
+		auto it = _blocks.find(bpos);
+		if (it != _blocks.end()) {
 #ifdef DEBUG_ENABLED
-			const unsigned int i = it->second.index;
-			CRASH_COND(i >= _blocks.size());
-			MeshBlock_T *block = _blocks[i];
-			CRASH_COND(block == nullptr); // The map should not contain null blocks
-			CRASH_COND(it->second.block == nullptr);
+			CRASH_COND(it->second == nullptr); // The map should not contain null blocks
 #endif
-			_last_accessed_block = it->second.block;
+			_last_accessed_block = it->second;
 			return _last_accessed_block;
 		}
 		return nullptr;
@@ -64,18 +71,14 @@ public:
 		if (_last_accessed_block != nullptr && _last_accessed_block->position == bpos) {
 			return _last_accessed_block;
 		}
-		auto it = _blocks_map.find(bpos);
-		if (it != _blocks_map.end()) {
+		auto it = _blocks.find(bpos);
+		if (it != _blocks.end()) {
 #ifdef DEBUG_ENABLED
-			const unsigned int i = it->second.index;
-			CRASH_COND(i >= _blocks.size());
-			MeshBlock_T *block = _blocks[i];
-			CRASH_COND(block == nullptr); // The map should not contain null blocks
-			CRASH_COND(it->second.block == nullptr);
+			CRASH_COND(it->second == nullptr); // The map should not contain null blocks
 #endif
 			// This function can't cache _last_accessed_block, because it's const, so repeated accesses are hashing
 			// again...
-			return it->second.block;
+			return it->second;
 		}
 		return nullptr;
 	}
@@ -89,19 +92,17 @@ public:
 #ifdef DEBUG_ENABLED
 		CRASH_COND(has_block(bpos));
 #endif
-		unsigned int i = _blocks.size();
-		_blocks.push_back(block);
-		_blocks_map.insert({ bpos, { block, i } });
+		_blocks[bpos] = block;
 	}
 
 	bool has_block(Vector3i pos) const {
 		//(_last_accessed_block != nullptr && _last_accessed_block->pos == pos) ||
-		return _blocks_map.find(pos) != _blocks_map.end();
+		return _blocks.has(pos);
 	}
 
 	void clear() {
 		for (auto it = _blocks.begin(); it != _blocks.end(); ++it) {
-			MeshBlock_T *block = *it;
+			MeshBlock_T *block = it->second;
 			if (block == nullptr) {
 				ERR_PRINT("Unexpected nullptr in VoxelMap::clear()");
 			} else {
@@ -109,67 +110,42 @@ public:
 			}
 		}
 		_blocks.clear();
-		_blocks_map.clear();
 		_last_accessed_block = nullptr;
 	}
 
 	unsigned int get_block_count() const {
-#ifdef DEBUG_ENABLED
-		const unsigned int blocks_map_size = _blocks_map.size();
-		CRASH_COND(_blocks.size() != blocks_map_size);
-#endif
 		return _blocks.size();
 	}
 
 	template <typename Op_T>
 	inline void for_each_block(Op_T op) {
-		for (MeshBlock_T *block : _blocks) {
+		for (auto it = _blocks.begin(); it != _blocks.end(); ++it) {
 #ifdef DEV_ENABLED
-			CRASH_COND(block == nullptr);
+			CRASH_COND(it->second == nullptr);
 #endif
-			op(*block);
+			op(*it->second);
 		}
 	}
 
 	template <typename Op_T>
 	inline void for_each_block(Op_T op) const {
-		for (const MeshBlock_T *block : _blocks) {
+		for (auto it = _blocks.begin(); it != _blocks.end(); ++it) {
 #ifdef DEV_ENABLED
-			CRASH_COND(block == nullptr);
+			CRASH_COND(it->second == nullptr);
 #endif
-			op(*block);
+			op(static_cast<const MeshBlock_T &>(*it->second));
 		}
 	}
 
-private:
-	struct MapItem {
-		MeshBlock_T *block;
-		// Index of the block within the vector storage
-		unsigned int index;
-	};
-
-	void remove_block_internal(typename StdUnorderedMap<Vector3i, MapItem>::iterator rm_it, unsigned int index) {
-		// TODO `erase` can occasionally be very slow (milliseconds) if the map contains lots of items.
-		// This might be caused by internal rehashing/resizing.
-		// We should look for a faster container, or reduce the number of entries.
-
-		// This function assumes the block is already freed
-		_blocks_map.erase(rm_it);
-
-		MeshBlock_T *moved_block = _blocks.back();
-#ifdef DEBUG_ENABLED
-		CRASH_COND(index >= _blocks.size());
-#endif
-		_blocks[index] = moved_block;
-		_blocks.pop_back();
-
-		if (index < _blocks.size()) {
-			auto moved_block_index_it = _blocks_map.find(moved_block->position);
-			CRASH_COND(moved_block_index_it == _blocks_map.end());
-			moved_block_index_it->second.index = index;
-		}
+	// Executes a function on all blocks whose position is inside the given box.
+	template <typename Op_T>
+	inline void for_each_block_in_box(Box3i box, Op_T op) {
+		_blocks.for_each_in_box(box, [&op](typename Vector3iSparseGrid<MeshBlock_T *>::Item &item) { //
+			op(*item.second);
+		});
 	}
 
+private:
 	static void queue_free_mesh_block(MeshBlock_T *block) {
 		// We spread this out because of physics
 		// TODO Could it be enough to do both render and physic deallocation with the task in ~MeshBlock_T()?
@@ -186,11 +162,9 @@ private:
 	}
 
 private:
-	// Blocks stored with a spatial hash in all 3D directions.
-	StdUnorderedMap<Vector3i, MapItem> _blocks_map;
-	// Blocks are stored in a vector to allow faster iteration over all of them.
+	// Blocks stored in pages of a sparse grid, which also allows fast iteration over all of them.
 	// Use cases for this include updating the transform of the meshes
-	StdVector<MeshBlock_T *> _blocks;
+	Vector3iSparseGrid<MeshBlock_T *> _blocks;
 
 	// Voxel access will most frequently be in contiguous areas, so the same blocks are accessed.
 	// To prevent too much hashing, this reference is checked before.
@@ -1,4 +1,5 @@
 #include "voxel_node.h"
+#include "../constants/voxel_constants.h"
 #include "../edition/voxel_tool.h"
 #include "../generators/voxel_generator.h"
 #include "../meshers/blocky/voxel_mesher_blocky.h"
@@ -6,6 +7,7 @@
 #include "../streams/voxel_stream.h"
 #include "../util/godot/classes/script.h"
 #include "../util/godot/core/string.h"
+#include "../util/math/funcs.h"
 
 #ifdef TOOLS_ENABLED
 #include "../util/godot/core/packed_arrays.h"
@@ -212,6 +214,14 @@ int VoxelNode::get_render_layers_mask() const {
 	return _render_layers_mask;
 }
 
+void VoxelNode::set_task_priority(int priority) {
+	_task_priority = math::clamp(priority, constants::VOLUME_TASK_PRIORITY_MIN, constants::VOLUME_TASK_PRIORITY_MAX);
+}
+
+int VoxelNode::get_task_priority() const {
+	return _task_priority;
+}
+
 GeometryInstance3D::ShadowCastingSetting VoxelNode::get_shadow_casting() const {
 	return _shadow_casting;
 }
@@ -235,6 +245,9 @@ void VoxelNode::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_render_layers_mask", "mask"), &VoxelNode::set_render_layers_mask);
 	ClassDB::bind_method(D_METHOD("get_render_layers_mask"), &VoxelNode::get_render_layers_mask);
 
+	ClassDB::bind_method(D_METHOD("set_task_priority", "priority"), &VoxelNode::set_task_priority);
+	ClassDB::bind_method(D_METHOD("get_task_priority"), &VoxelNode::get_task_priority);
+
 	ADD_PROPERTY(
 			PropertyInfo(Variant::OBJECT, "stream", PROPERTY_HINT_RESOURCE_TYPE, VoxelStream::get_class_static()),
 			"set_stream",
@@ -265,6 +278,11 @@ void VoxelNode::_bind_methods() {
 			"set_render_layers_mask",
 			"get_render_layers_mask"
 	);
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "task_priority", PROPERTY_HINT_RANGE, "-10,10,1"),
+			"set_task_priority",
+			"get_task_priority"
+	);
 }
 
 } // namespace zylann::voxel
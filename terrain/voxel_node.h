@@ -38,6 +38,10 @@ public:
 	void set_render_layers_mask(int mask);
 	int get_render_layers_mask() const;
 
+	// When several volumes exist, tasks of those with higher priority run before tasks of the others
+	void set_task_priority(int priority);
+	int get_task_priority() const;
+
 	virtual void restart_stream();
 	virtual void remesh_all_blocks();
 
@@ -89,6 +93,7 @@ private:
 	GeometryInstance3D::GIMode _gi_mode = GeometryInstance3D::GI_MODE_DISABLED;
 	GeometryInstance3D::ShadowCastingSetting _shadow_casting = GeometryInstance3D::SHADOW_CASTING_SETTING_ON;
 	int _render_layers_mask = 1;
+	int _task_priority = 0;
 };
 
 } // namespace zylann::voxel
@@ -1,4 +1,8 @@
 #include "voxel_save_completion_tracker.h"
+#include "../util/godot/classes/time.h"
+#include "../util/math/funcs.h"
+#include "../util/profiling.h"
+#include "../util/thread/thread.h"
 
 namespace zylann::voxel {
 
@@ -29,11 +33,42 @@ int VoxelSaveCompletionTracker::get_remaining_tasks() const {
 	return _tracker->get_remaining_count();
 }
 
+int64_t VoxelSaveCompletionTracker::get_total_bytes() const {
+	ZN_ASSERT_RETURN_V(_tracker != nullptr, 0);
+	return _tracker->get_total_work();
+}
+
+int64_t VoxelSaveCompletionTracker::get_remaining_bytes() const {
+	ZN_ASSERT_RETURN_V(_tracker != nullptr, 0);
+	return _tracker->get_remaining_work();
+}
+
+bool VoxelSaveCompletionTracker::wait(int timeout_msec) const {
+	ZN_PROFILE_SCOPE();
+	ZN_ASSERT_RETURN_V(_tracker != nullptr, false);
+
+	const uint64_t timeout_usec = static_cast<uint64_t>(math::max(timeout_msec, 0)) * 1000;
+	const uint64_t deadline_usec = Time::get_singleton()->get_ticks_usec() + timeout_usec;
+
+	// Saving runs in the IO and general threads, which don't need the main thread to make progress
+	while (!_tracker->is_complete() && !_tracker->is_aborted()) {
+		if (Time::get_singleton()->get_ticks_usec() >= deadline_usec) {
+			return false;
+		}
+		Thread::sleep_usec(1000);
+	}
+
+	return _tracker->is_complete();
+}
+
 void VoxelSaveCompletionTracker::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("is_complete"), &VoxelSaveCompletionTracker::is_complete);
 	ClassDB::bind_method(D_METHOD("is_aborted"), &VoxelSaveCompletionTracker::is_aborted);
 	ClassDB::bind_method(D_METHOD("get_total_tasks"), &VoxelSaveCompletionTracker::get_total_tasks);
 	ClassDB::bind_method(D_METHOD("get_remaining_tasks"), &VoxelSaveCompletionTracker::get_remaining_tasks);
+	ClassDB::bind_method(D_METHOD("get_total_bytes"), &VoxelSaveCompletionTracker::get_total_bytes);
+	ClassDB::bind_method(D_METHOD("get_remaining_bytes"), &VoxelSaveCompletionTracker::get_remaining_bytes);
+	ClassDB::bind_method(D_METHOD("wait", "timeout_msec"), &VoxelSaveCompletionTracker::wait);
 }
 
 } // namespace zylann::voxel
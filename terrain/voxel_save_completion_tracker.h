@@ -18,6 +18,14 @@ public:
 	bool is_aborted() const;
 	int get_total_tasks() const;
 	int get_remaining_tasks() const;
+	// Voxel data to save, counted uncompressed. Saves of instances are not counted.
+	int64_t get_total_bytes() const;
+	int64_t get_remaining_bytes() const;
+
+	// Blocks the calling thread until saving is complete or aborted, or until the timeout elapsed. Returns `true` if
+	// saving is complete. Blocks closer to viewers are saved first, so this can be used to bound how long a game takes
+	// to quit.
+	bool wait(int timeout_msec) const;
 
 private:
 	static void _bind_methods();
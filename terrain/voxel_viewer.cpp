@@ -33,6 +33,42 @@ float VoxelViewer::get_view_distance_vertical_ratio() const {
 	return _view_distance_vertical_ratio;
 }
 
+void VoxelViewer::set_prefetch_time(float seconds) {
+	_prefetch_time = math::max(seconds, 0.f);
+	if (is_active()) {
+		VoxelEngine::get_singleton().set_viewer_prefetch_time(_viewer_id, _prefetch_time);
+	}
+}
+
+float VoxelViewer::get_prefetch_time() const {
+	return _prefetch_time;
+}
+
+void VoxelViewer::set_priority_view_angle(float degrees) {
+	_priority_view_angle = math::clamp(degrees, 0.f, VoxelEngine::Viewer::MAX_PRIORITY_VIEW_ANGLE_DEGREES);
+	if (is_active()) {
+		VoxelEngine::get_singleton().set_viewer_priority_view_angle(_viewer_id, _priority_view_angle);
+	}
+}
+
+float VoxelViewer::get_priority_view_angle() const {
+	return _priority_view_angle;
+}
+
+Vector3 VoxelViewer::get_velocity() const {
+	if (is_active()) {
+		return VoxelEngine::get_singleton().get_viewer_velocity(_viewer_id);
+	}
+	return Vector3();
+}
+
+void VoxelViewer::notify_teleport() {
+	if (is_active()) {
+		// Transform notifications can be deferred, so the new position is not necessarily synced yet
+		VoxelEngine::get_singleton().teleport_viewer(_viewer_id, get_global_transform().origin);
+	}
+}
+
 void VoxelViewer::set_requires_visuals(bool enabled) {
 	_requires_visuals = enabled;
 	if (is_active()) {
@@ -120,15 +156,23 @@ void VoxelViewer::sync_view_distances() {
 	VoxelEngine::get_singleton().set_viewer_distances(_viewer_id, distances);
 }
 
+void VoxelViewer::sync_transform() {
+	const Transform3D transform = get_global_transform();
+	VoxelEngine::get_singleton().set_viewer_position(_viewer_id, transform.origin);
+	// Nodes look towards -Z, like cameras
+	VoxelEngine::get_singleton().set_viewer_direction(_viewer_id, -transform.basis.get_column(Vector3::AXIS_Z));
+}
+
 void VoxelViewer::sync_all_parameters() {
 	sync_view_distances();
+	VoxelEngine::get_singleton().set_viewer_prefetch_time(_viewer_id, _prefetch_time);
+	VoxelEngine::get_singleton().set_viewer_priority_view_angle(_viewer_id, _priority_view_angle);
 	VoxelEngine::get_singleton().set_viewer_requires_visuals(_viewer_id, _requires_visuals);
 	VoxelEngine::get_singleton().set_viewer_requires_collisions(_viewer_id, _requires_collisions);
 	VoxelEngine::get_singleton().set_viewer_requires_data_block_notifications(
 			_viewer_id, _requires_data_block_notifications);
 	VoxelEngine::get_singleton().set_viewer_network_peer_id(_viewer_id, _network_peer_id);
-	const Vector3 pos = get_global_transform().origin;
-	VoxelEngine::get_singleton().set_viewer_position(_viewer_id, pos);
+	sync_transform();
 }
 
 void VoxelViewer::_notification(int p_what) {
@@ -153,8 +197,7 @@ void VoxelViewer::_notification(int p_what) {
 
 		case NOTIFICATION_TRANSFORM_CHANGED:
 			if (is_active()) {
-				const Vector3 pos = get_global_transform().origin;
-				VoxelEngine::get_singleton().set_viewer_position(_viewer_id, pos);
+				sync_transform();
 			}
 			break;
 
@@ -175,6 +218,15 @@ void VoxelViewer::_bind_methods() {
 			D_METHOD("set_view_distance_vertical_ratio", "ratio"), &VoxelViewer::set_view_distance_vertical_ratio);
 	ClassDB::bind_method(D_METHOD("get_view_distance_vertical_ratio"), &VoxelViewer::get_view_distance_vertical_ratio);
 
+	ClassDB::bind_method(D_METHOD("set_prefetch_time", "seconds"), &VoxelViewer::set_prefetch_time);
+	ClassDB::bind_method(D_METHOD("get_prefetch_time"), &VoxelViewer::get_prefetch_time);
+
+	ClassDB::bind_method(D_METHOD("set_priority_view_angle", "degrees"), &VoxelViewer::set_priority_view_angle);
+	ClassDB::bind_method(D_METHOD("get_priority_view_angle"), &VoxelViewer::get_priority_view_angle);
+
+	ClassDB::bind_method(D_METHOD("get_velocity"), &VoxelViewer::get_velocity);
+	ClassDB::bind_method(D_METHOD("notify_teleport"), &VoxelViewer::notify_teleport);
+
 	ClassDB::bind_method(D_METHOD("set_requires_visuals", "enabled"), &VoxelViewer::set_requires_visuals);
 	ClassDB::bind_method(D_METHOD("is_requiring_visuals"), &VoxelViewer::is_requiring_visuals);
 
@@ -195,6 +247,10 @@ void VoxelViewer::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "view_distance"), "set_view_distance", "get_view_distance");
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "view_distance_vertical_ratio"), "set_view_distance_vertical_ratio",
 			"get_view_distance_vertical_ratio");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "prefetch_time", PROPERTY_HINT_RANGE, "0.0,10.0,0.1,or_greater"),
+			"set_prefetch_time", "get_prefetch_time");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "priority_view_angle", PROPERTY_HINT_RANGE, "0.0,179.0,1.0"),
+			"set_priority_view_angle", "get_priority_view_angle");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "requires_visuals"), "set_requires_visuals", "is_requiring_visuals");
 	ADD_PROPERTY(
 			PropertyInfo(Variant::BOOL, "requires_collisions"), "set_requires_collisions", "is_requiring_collisions");
@@ -22,6 +22,21 @@ public:
 	void set_view_distance_vertical_ratio(float p_ratio);
 	float get_view_distance_vertical_ratio() const;
 
+	// How many seconds of movement ahead of the viewer should be loaded in advance, based on its velocity
+	void set_prefetch_time(float seconds);
+	float get_prefetch_time() const;
+
+	// Angle in degrees of a cone in front of the viewer, in which blocks get loaded and meshed first. 0 disables it.
+	void set_priority_view_angle(float degrees);
+	float get_priority_view_angle() const;
+
+	// Velocity estimated by the engine from the changes of position of the viewer.
+	Vector3 get_velocity() const;
+
+	// Tells the engine the viewer was just moved far away instantly, so work pending around its old location can be
+	// dropped at once.
+	void notify_teleport();
+
 	// TODO Have an option to run in editor, could be useful for testing?
 
 	void set_requires_visuals(bool enabled);
@@ -47,12 +62,15 @@ private:
 
 	void sync_all_parameters();
 	void sync_view_distances();
+	void sync_transform();
 
 	bool is_active() const;
 
 	ViewerID _viewer_id;
 	unsigned int _view_distance = 128;
 	float _view_distance_vertical_ratio = 1.f;
+	float _prefetch_time = 0.f;
+	float _priority_view_angle = 0.f;
 	bool _requires_visuals = true;
 	bool _requires_collisions = true;
 	bool _requires_data_block_notifications = false;
@@ -0,0 +1,178 @@
+#include "benchmarking.h"
+#include "../util/godot/classes/file_access.h"
+#include "../util/godot/classes/json.h"
+#include "../util/godot/core/array.h"
+#include "../util/godot/core/dictionary.h"
+#include "../util/godot/core/print_string.h"
+#include "../util/godot/macros.h"
+#include "../util/io/log.h"
+#include "../util/string/format.h"
+
+#include <algorithm>
+
+namespace zylann::testing {
+
+namespace {
+
+const int BASELINE_FORMAT_VERSION = 1;
+
+bool load_baseline(const String &path, Dictionary &out_benchmarks) {
+	String json_string;
+	{
+		Error err;
+		Ref<FileAccess> f = zylann::godot::open_file(path, FileAccess::READ, err);
+		if (f.is_null()) {
+			return false;
+		}
+		json_string = zylann::godot::get_as_text(**f);
+	}
+
+	Ref<JSON> json;
+	json.instantiate();
+	const Error json_err = json->parse(json_string);
+	if (json_err != OK) {
+		const String json_err_msg = json->get_error_message();
+		const int json_err_line = json->get_error_line();
+		ZN_PRINT_ERROR(format("Error when parsing {}: line {}: {}", path, json_err_line, json_err_msg));
+		return false;
+	}
+
+	const Dictionary d = json->get_data();
+	if (int(d.get("version", -1)) != BASELINE_FORMAT_VERSION) {
+		ZN_PRINT_ERROR(format("Benchmark baseline {} has an unsupported version", path));
+		return false;
+	}
+	out_benchmarks = d["benchmarks"];
+	return true;
+}
+
+// Relative change of a duration compared to the baseline, positive when slower
+float get_relative_change(uint64_t baseline_nsec, uint64_t nsec) {
+	if (baseline_nsec == 0) {
+		return 0.f;
+	}
+	return (static_cast<double>(nsec) - static_cast<double>(baseline_nsec)) / static_cast<double>(baseline_nsec);
+}
+
+} // namespace
+
+void BenchmarkSuite::add_result(const char *name, StdVector<uint64_t> &durations) {
+	ZN_ASSERT_RETURN(durations.size() > 0);
+
+	std::sort(durations.begin(), durations.end());
+	const size_t last = durations.size() - 1;
+
+	Result result;
+	result.name = name;
+	result.repetition_count = durations.size();
+	result.median_nsec = durations[last * 50 / 100];
+	result.p95_nsec = durations[last * 95 / 100];
+
+	print_line(format(
+			"Benchmark {}: median {} ns, p95 {} ns ({} repetitions)",
+			result.name,
+			result.median_nsec,
+			result.p95_nsec,
+			result.repetition_count
+	));
+
+	_results.push_back(result);
+}
+
+unsigned int BenchmarkSuite::compare_with_baseline() {
+	// One line that tools can pick from the output to track results over time
+	{
+		Array results_array;
+		for (const Result &result : _results) {
+			Dictionary d;
+			d["name"] = result.name;
+			d["median_nsec"] = ZN_SIZE_T_TO_VARIANT(result.median_nsec);
+			d["p95_nsec"] = ZN_SIZE_T_TO_VARIANT(result.p95_nsec);
+			results_array.append(d);
+		}
+		print_line(String("benchmark_json: ") + JSON::stringify(results_array));
+	}
+
+	if (_options.baseline_path.is_empty()) {
+		return 0;
+	}
+
+	Dictionary baseline;
+	if (!load_baseline(_options.baseline_path, baseline)) {
+		print_line(format("No benchmark baseline found at {}, creating it", _options.baseline_path));
+		save_baseline();
+		return 0;
+	}
+
+	unsigned int regression_count = 0;
+
+	for (const Result &result : _results) {
+		if (!baseline.has(result.name)) {
+			print_line(format("Benchmark {}: not in baseline", result.name));
+			continue;
+		}
+		const Dictionary expected = baseline[result.name];
+		const uint64_t baseline_median_nsec = static_cast<int64_t>(expected.get("median_nsec", 0));
+		const float change = get_relative_change(baseline_median_nsec, result.median_nsec);
+		const int change_percent = static_cast<int>(change * 100.f);
+
+		if (change > _options.tolerance) {
+			// Not a test failure, timings vary between machines and runs. It should be looked at though.
+			ZN_PRINT_ERROR(format(
+					"Benchmark {} regressed: median {} ns, baseline {} ns ({}%)",
+					result.name,
+					result.median_nsec,
+					baseline_median_nsec,
+					change_percent
+			));
+			++regression_count;
+		} else {
+			print_line(format(
+					"Benchmark {}: median {} ns, baseline {} ns ({}%)",
+					result.name,
+					result.median_nsec,
+					baseline_median_nsec,
+					change_percent
+			));
+		}
+	}
+
+	print_line(format(
+			"{} of {} benchmarks regressed by more than {}%",
+			regression_count,
+			_results.size(),
+			static_cast<int>(_options.tolerance * 100.f)
+	));
+
+	if (_options.update_baseline) {
+		save_baseline();
+	}
+
+	return regression_count;
+}
+
+bool BenchmarkSuite::save_baseline() const {
+	Dictionary benchmarks;
+	for (const Result &result : _results) {
+		Dictionary d;
+		d["median_nsec"] = ZN_SIZE_T_TO_VARIANT(result.median_nsec);
+		d["p95_nsec"] = ZN_SIZE_T_TO_VARIANT(result.p95_nsec);
+		d["repetitions"] = result.repetition_count;
+		benchmarks[result.name] = d;
+	}
+
+	Dictionary root;
+	root["version"] = BASELINE_FORMAT_VERSION;
+	root["benchmarks"] = benchmarks;
+
+	Error err;
+	Ref<FileAccess> f = zylann::godot::open_file(_options.baseline_path, FileAccess::WRITE, err);
+	if (f.is_null()) {
+		ZN_PRINT_ERROR(format("Could not save benchmark baseline {}", _options.baseline_path));
+		return false;
+	}
+	f->store_string(JSON::stringify(root, "\t", true));
+	return true;
+}
+
+} // namespace zylann::testing
@@ -0,0 +1,82 @@
+#ifndef ZN_TEST_BENCHMARKING_H
+#define ZN_TEST_BENCHMARKING_H
+
+#include "../util/containers/span.h"
+#include "../util/containers/std_vector.h"
+#include "../util/errors.h"
+#include "../util/godot/core/string.h"
+#include "../util/profiling_clock.h"
+
+namespace zylann::testing {
+
+// Times small pieces of code repeatedly, and compares results with those of a previous run saved as JSON, so
+// performance regressions can be noticed. Results are reported as a median and 95th percentile of repetitions, which
+// are less affected by outliers than an average.
+class BenchmarkSuite {
+public:
+	struct Options {
+		// JSON file results are compared with. If it doesn't exist, it gets created from the current results.
+		String baseline_path;
+		// How much slower a median can be compared to the baseline before it counts as a regression. 0.2 means 20%.
+		float tolerance = 0.2f;
+		// Overwrite the baseline with the current results after comparing them
+		bool update_baseline = false;
+		// Repetitions that are not measured, so caches and allocators get warm first
+		unsigned int warmup_count = 3;
+		unsigned int repetition_count = 21;
+	};
+
+	struct Result {
+		String name;
+		unsigned int repetition_count = 0;
+		uint64_t median_nsec = 0;
+		uint64_t p95_nsec = 0;
+	};
+
+	BenchmarkSuite(const Options &options) : _options(options) {}
+
+	// Calls `f` many times and records how long each call takes. Calls are timed in batches of `iteration_count`, to
+	// measure functions faster than the resolution of the clock.
+	template <typename F>
+	void run(const char *name, unsigned int iteration_count, F f) {
+		ZN_ASSERT_RETURN(iteration_count > 0);
+
+		for (unsigned int i = 0; i < _options.warmup_count; ++i) {
+			for (unsigned int j = 0; j < iteration_count; ++j) {
+				f();
+			}
+		}
+
+		StdVector<uint64_t> &durations = _durations;
+		durations.clear();
+		for (unsigned int i = 0; i < _options.repetition_count; ++i) {
+			ProfilingClock clock;
+			for (unsigned int j = 0; j < iteration_count; ++j) {
+				f();
+			}
+			durations.push_back(clock.get_elapsed_microseconds() * 1000 / iteration_count);
+		}
+
+		add_result(name, durations);
+	}
+
+	Span<const Result> get_results() const {
+		return to_span(_results);
+	}
+
+	// Compares results with the baseline, and saves it if it didn't exist or if asked to. Returns how many benchmarks
+	// regressed.
+	unsigned int compare_with_baseline();
+
+private:
+	void add_result(const char *name, StdVector<uint64_t> &durations);
+	bool save_baseline() const;
+
+	Options _options;
+	StdVector<Result> _results;
+	StdVector<uint64_t> _durations;
+};
+
+} // namespace zylann::testing
+
+#endif // ZN_TEST_BENCHMARKING_H
@@ -1,33 +1,62 @@
 #include "tests.h"
+#include "../util/godot/classes/os.h"
 #include "../util/profiling.h"
+#include "benchmarking.h"
 #include "testing.h"
 
+#include "util/test_aabb_tree.h"
+#include "util/test_adaptive_time_budget.h"
+#include "util/test_backlog_governor.h"
 #include "util/test_box3i.h"
+#include "util/test_cache_stats.h"
 #include "util/test_container_funcs.h"
 #include "util/test_expression_parser.h"
+#include "util/test_file_locker.h"
 #include "util/test_flat_map.h"
+#include "util/test_hierarchical_a_star_grid_3d.h"
 #include "util/test_island_finder.h"
+#include "util/test_latency_histogram.h"
+#include "util/test_linear_allocator.h"
 #include "util/test_math_funcs.h"
+#include "util/test_mpsc_queue.h"
 #include "util/test_noise.h"
+#include "util/test_profiling_tracer.h"
+#include "util/test_rect_packing.h"
+#include "util/test_request_combiner.h"
+#include "util/test_sharded_rw_lock.h"
 #include "util/test_slot_map.h"
 #include "util/test_spatial_lock.h"
 #include "util/test_string_funcs.h"
 #include "util/test_threaded_task_runner.h"
+#include "util/test_vector3i_hash_map.h"
+#include "util/test_vector3i_sparse_grid.h"
 
+#include "voxel/test_block_load_batcher.h"
 #include "voxel/test_block_serializer.h"
 #include "voxel/test_curve_range.h"
 #include "voxel/test_detail_rendering_gpu.h"
 #include "voxel/test_edition_funcs.h"
+#include "voxel/test_mesher_benchmark.h"
 #include "voxel/test_mesh_sdf.h"
+#include "voxel/test_occlusion_culling.h"
 #include "voxel/test_octree.h"
+#include "voxel/test_perf_kernels.h"
+#include "voxel/test_priority_dependency.h"
 #include "voxel/test_region_file.h"
 #include "voxel/test_storage_funcs.h"
+#include "voxel/test_stream_benchmark.h"
 #include "voxel/test_stream_sqlite.h"
 #include "voxel/test_voxel_buffer.h"
+#include "voxel/test_voxel_data.h"
 #include "voxel/test_voxel_data_map.h"
 #include "voxel/test_voxel_graph.h"
+#include "voxel/test_voxel_memory_pool.h"
 #include "voxel/test_voxel_instancer.h"
+#include "voxel/test_voxel_lod_terrain_horizon.h"
+#include "voxel/test_voxel_mesher_blocky.h"
 #include "voxel/test_voxel_mesher_cubes.h"
+#include "voxel/test_voxel_mesher_transvoxel.h"
+#include "voxel/test_voxel_terrain_update_task.h"
 
 #ifdef VOXEL_ENABLE_FAST_NOISE_2
 #include "fast_noise_2/test_fast_noise_2.h"
@@ -48,15 +77,18 @@ void run_voxel_tests() {
 	using namespace zylann::tests;
 
 	VOXEL_TEST(test_wrap);
+	VOXEL_TEST(test_morton_3d);
 	VOXEL_TEST(test_int32_to_string_base10);
 	VOXEL_TEST(test_string_base10_to_int32);
 	VOXEL_TEST(test_voxel_buffer_paste_masked);
 	VOXEL_TEST(test_image_range_grid);
+	VOXEL_TEST(test_tiled_image);
 	VOXEL_TEST(test_box3i_intersects);
 	VOXEL_TEST(test_box3i_for_inner_outline);
 	VOXEL_TEST(test_voxel_data_map_paste_fill);
 	VOXEL_TEST(test_voxel_data_map_paste_mask);
 	VOXEL_TEST(test_voxel_data_map_copy);
+	VOXEL_TEST(test_voxel_data_map_clipboard);
 	VOXEL_TEST(test_encode_weights_packed_u16);
 	VOXEL_TEST(test_copy_3d_region_zxy);
 	VOXEL_TEST(test_voxel_graph_invalid_connection);
@@ -73,6 +105,7 @@ void run_voxel_tests() {
 	VOXEL_TEST(test_voxel_graph_functions_autoconnect);
 	VOXEL_TEST(test_voxel_graph_functions_io_mismatch);
 	VOXEL_TEST(test_voxel_graph_functions_misc);
+	VOXEL_TEST(test_voxel_graph_functions_constant_folding);
 	VOXEL_TEST(test_voxel_graph_issue461);
 	VOXEL_TEST(test_voxel_graph_fuzzing);
 #ifdef VOXEL_ENABLE_FAST_NOISE_2
@@ -92,49 +125,201 @@ void run_voxel_tests() {
 	VOXEL_TEST(test_voxel_graph_non_square_image);
 	VOXEL_TEST(test_voxel_graph_empty_image);
 	VOXEL_TEST(test_voxel_graph_4_default_weights);
+	VOXEL_TEST(test_voxel_graph_xz_cache);
+	VOXEL_TEST(test_voxel_graph_adaptive_subdivision);
+	VOXEL_TEST(test_voxel_graph_sampled_profiling);
+	VOXEL_TEST(test_voxel_graph_buffer_data_reuse);
+	VOXEL_TEST(test_voxel_graph_generate_series_in_chunks);
+	VOXEL_TEST(test_voxel_graph_lod_detail_pruning);
+	VOXEL_TEST(test_voxel_graph_fused_modifiers);
+	VOXEL_TEST(test_voxel_graph_expression_bytecode);
 	VOXEL_TEST(test_island_finder);
+	VOXEL_TEST(test_island_finder_large);
 	VOXEL_TEST(test_unordered_remove_if);
 	VOXEL_TEST(test_instance_data_serialization);
+	VOXEL_TEST(test_instance_data_serialization_compact);
+	VOXEL_TEST(test_instance_data_deserialization_simple_11b);
+	VOXEL_TEST(test_instance_data_serialization_legacy);
+	VOXEL_TEST(test_instancer_save_generated_instances);
 	VOXEL_TEST(test_transform_3d_array_zxy);
 	VOXEL_TEST(test_octree_update);
 	VOXEL_TEST(test_octree_find_in_box);
+	VOXEL_TEST(test_occlusion_culling_side_connectivity);
+	VOXEL_TEST(test_occlusion_culling_find_visible_blocks);
 	VOXEL_TEST(test_get_curve_monotonic_sections);
 	VOXEL_TEST(test_voxel_buffer_create);
 	VOXEL_TEST(test_block_serializer);
 	VOXEL_TEST(test_block_serializer_stream_peer);
+	VOXEL_TEST(test_block_serializer_uniform_fast_path);
+	VOXEL_TEST(test_block_serializer_channel_encodings);
+	VOXEL_TEST(test_block_serializer_packed_metadata);
+	VOXEL_TEST(test_block_serializer_narrowed_channels);
+	VOXEL_TEST(test_block_load_batcher);
+#ifdef VOXEL_ZSTD_ENABLED
+	VOXEL_TEST(test_block_serializer_zstd);
+#endif
 	VOXEL_TEST(test_region_file);
 	VOXEL_TEST(test_voxel_stream_region_files);
+	VOXEL_TEST(test_voxel_stream_region_files_existence_index);
+	VOXEL_TEST(test_voxel_stream_region_files_header_cache);
 #ifdef VOXEL_ENABLE_FAST_NOISE_2
 	VOXEL_TEST(test_fast_noise_2_basic);
 	VOXEL_TEST(test_fast_noise_2_empty_encoded_node_tree);
 #endif
 	VOXEL_TEST(test_run_blocky_random_tick);
+	VOXEL_TEST(test_blocky_random_ticker);
 	VOXEL_TEST(test_flat_map);
+	VOXEL_TEST(test_flat_map_move_only);
 	VOXEL_TEST(test_expression_parser);
 	VOXEL_TEST(test_voxel_buffer_metadata);
+	VOXEL_TEST(test_voxel_buffer_metadata_in_area);
 	VOXEL_TEST(test_voxel_buffer_metadata_gd);
 	VOXEL_TEST(test_voxel_mesher_cubes);
+	VOXEL_TEST(test_voxel_mesher_blocky_greedy);
+	VOXEL_TEST(test_voxel_mesher_blocky_collision_greedy);
+	VOXEL_TEST(test_voxel_mesher_blocky_tall_column);
+	VOXEL_TEST(test_voxel_mesher_blocky_bake_model);
+	VOXEL_TEST(test_voxel_mesher_blocky_cubes_only);
+	VOXEL_TEST(test_voxel_mesher_transvoxel_crossing_cells);
+	VOXEL_TEST(test_voxel_mesher_transvoxel_lod_attributes);
+	VOXEL_TEST(test_voxel_mesher_transvoxel_palette_indices);
+	VOXEL_TEST(test_latency_histogram_buckets);
+	VOXEL_TEST(test_latency_histogram_percentiles);
+	VOXEL_TEST(test_cache_stats);
+	VOXEL_TEST(test_linear_allocator);
+	VOXEL_TEST(test_profiling_tracer);
+	VOXEL_TEST(test_adaptive_time_budget);
+	VOXEL_TEST(test_backlog_governor);
+	VOXEL_TEST(test_mpsc_queue);
+	VOXEL_TEST(test_pack_rectangles_skyline);
 	VOXEL_TEST(test_threaded_task_runner_misc);
+	VOXEL_TEST(test_threaded_task_runner_mixed_tasks);
+	VOXEL_TEST(test_threaded_task_runner_category_quotas);
 	VOXEL_TEST(test_threaded_task_runner_debug_names);
 	VOXEL_TEST(test_task_priority_values);
+	VOXEL_TEST(test_priority_dependency_view_cone);
+	VOXEL_TEST(test_priority_dependency_many_viewers);
+	VOXEL_TEST(test_priority_dependency_volume_task_priority);
+	VOXEL_TEST(test_voxel_lod_terrain_horizon);
+	VOXEL_TEST(test_voxel_terrain_update_task_moving_viewer);
 	VOXEL_TEST(test_voxel_mesh_sdf_issue463);
+	VOXEL_TEST(test_voxel_mesh_sdf_partitioned_parallel);
 	VOXEL_TEST(test_normalmap_render_gpu);
+	VOXEL_TEST(test_detail_rendering_bc5_compression);
 	VOXEL_TEST(test_slot_map);
+	VOXEL_TEST(test_aabb_tree);
+	VOXEL_TEST(test_hierarchical_a_star_grid_3d);
 	VOXEL_TEST(test_box_blur);
 	VOXEL_TEST(test_threaded_task_postponing);
+	VOXEL_TEST(test_parallel_jobs);
 	VOXEL_TEST(test_spatial_lock_misc);
+	VOXEL_TEST(test_spatial_lock_fairness);
+	VOXEL_TEST(test_spatial_lock_timeout);
 	VOXEL_TEST(test_spatial_lock_spam);
 	VOXEL_TEST(test_spatial_lock_dependent_map_chunks);
+	VOXEL_TEST(test_sharded_rw_lock_misc);
+	VOXEL_TEST(test_sharded_rw_lock_spam);
+	VOXEL_TEST(test_request_combiner);
+	VOXEL_TEST(test_file_locker);
 	VOXEL_TEST(test_discord_soakil_copypaste);
 	VOXEL_TEST(test_voxel_stream_sqlite_key_string_csd_encoding);
 	VOXEL_TEST(test_voxel_stream_sqlite_key_blob80_encoding);
+	VOXEL_TEST(test_voxel_stream_sqlite_key_morton_encoding);
 	VOXEL_TEST(test_voxel_stream_sqlite_basic);
 	VOXEL_TEST(test_voxel_stream_sqlite_coordinate_format);
+	VOXEL_TEST(test_voxel_stream_sqlite_cache_budget);
+	VOXEL_TEST(test_voxel_stream_sqlite_deduplication);
+	VOXEL_TEST(test_voxel_stream_sqlite_delete_block);
+	VOXEL_TEST(test_voxel_stream_sqlite_encoded_blocks);
+	VOXEL_TEST(test_voxel_stream_sqlite_group_commit);
+	VOXEL_TEST(test_voxel_stream_sqlite_key_ranges);
+	VOXEL_TEST(test_voxel_stream_sqlite_copy_to_other_coordinate_format);
 	VOXEL_TEST(test_sdf_hemisphere);
+	VOXEL_TEST(test_async_edit_queue_grouping);
+	VOXEL_TEST(test_async_edit_group_task_generates_missing_voxels);
+	VOXEL_TEST(test_raycast_nonzero_skips_blocks);
+	VOXEL_TEST(test_raycast_batch);
+	VOXEL_TEST(test_floating_chunks_cache);
+	VOXEL_TEST(test_floating_chunks_sync_async_match);
+	VOXEL_TEST(test_path_segment_binning);
 	VOXEL_TEST(test_fnl_range);
 	VOXEL_TEST(test_voxel_buffer_set_channel_bytes);
+	VOXEL_TEST(test_voxel_buffer_palette);
+	VOXEL_TEST(test_voxel_buffer_bulk_f);
+	VOXEL_TEST(test_voxel_buffer_bulk_i);
+	VOXEL_TEST(test_voxel_buffer_packed_depths);
+	VOXEL_TEST(test_voxel_buffer_downscale_type_majority);
+	VOXEL_TEST(test_vector3i_hash_map);
+	VOXEL_TEST(test_vector3i_hash_quality);
+	VOXEL_TEST(test_vector3i_sparse_grid);
+	VOXEL_TEST(test_voxel_memory_pool_threads);
+	VOXEL_TEST(test_voxel_memory_pool_arena);
+	VOXEL_TEST(test_voxel_memory_pool_arena_threads);
+	VOXEL_TEST(test_voxel_memory_pool_size_classes);
+	VOXEL_TEST(test_voxel_data_cache_eviction);
+	VOXEL_TEST(test_voxel_data_copy_on_write);
+	VOXEL_TEST(test_voxel_data_compaction);
+	VOXEL_TEST(test_voxel_data_cold_compression);
+	VOXEL_TEST(test_voxel_data_block_read_access);
+	VOXEL_TEST(test_voxel_data_palette_compression_shared_voxels);
+	VOXEL_TEST(test_voxel_data_save_snapshot);
+	VOXEL_TEST(test_voxel_data_missing_lod_mips);
+	VOXEL_TEST(test_voxel_data_memory_usage);
 
 	print_line("------------ Voxel tests end -------------");
 }
 
+#define VOXEL_PERF_TEST(fname)                                                                                         \
+	{                                                                                                                  \
+		print_line("Running " #fname);                                                                                 \
+		fname(suite);                                                                                                  \
+	}
+
+void run_voxel_perf_tests() {
+	print_line("------------ Voxel perf tests begin -------------");
+
+	using namespace zylann::tests;
+
+	testing::BenchmarkSuite::Options options;
+	const PackedStringArray command_line_arguments = zylann::godot::get_command_line_arguments();
+	for (int i = 0; i < command_line_arguments.size(); ++i) {
+		const String arg = command_line_arguments[i];
+		if (arg.begins_with("--voxel_perf_baseline=")) {
+			options.baseline_path = arg.get_slice("=", 1);
+		} else if (arg.begins_with("--voxel_perf_tolerance=")) {
+			options.tolerance = arg.get_slice("=", 1).to_float();
+		} else if (arg == "--voxel_perf_update_baseline") {
+			options.update_baseline = true;
+		}
+	}
+
+	testing::BenchmarkSuite suite(options);
+
+	VOXEL_PERF_TEST(test_perf_block_serializer);
+	VOXEL_PERF_TEST(test_perf_mesher_transvoxel);
+	VOXEL_PERF_TEST(test_voxel_mesher_transvoxel_regular_benchmark);
+	VOXEL_PERF_TEST(test_perf_mesher_blocky);
+	VOXEL_PERF_TEST(test_voxel_mesher_benchmark);
+	VOXEL_PERF_TEST(test_perf_graph_runtime);
+	VOXEL_PERF_TEST(test_voxel_graph_node_benchmark);
+	VOXEL_PERF_TEST(test_threaded_task_runner_perf);
+	VOXEL_PERF_TEST(test_threaded_task_runner_throughput);
+	VOXEL_PERF_TEST(test_voxel_data_map_benchmark);
+	VOXEL_PERF_TEST(test_vector3i_sparse_grid_benchmark);
+	VOXEL_PERF_TEST(test_vector3i_hash_lookup_benchmark);
+	VOXEL_PERF_TEST(test_island_finder_benchmark);
+	VOXEL_PERF_TEST(test_priority_dependency_many_viewers_benchmark);
+	VOXEL_PERF_TEST(test_voxel_buffer_bulk_f_benchmark);
+	VOXEL_PERF_TEST(test_box_blur_benchmark);
+	VOXEL_PERF_TEST(test_morton_layout_benchmark);
+	VOXEL_PERF_TEST(test_voxel_stream_benchmark);
+#ifdef VOXEL_ZSTD_ENABLED
+	VOXEL_PERF_TEST(test_block_serializer_compression_benchmark);
+#endif
+
+	suite.compare_with_baseline();
+
+	print_line("------------ Voxel perf tests end -------------");
+}
+
 } // namespace zylann::voxel::tests
@@ -3,6 +3,8 @@
 
 namespace zylann::voxel::tests {
 void run_voxel_tests();
+// Runs benchmarks of performance-sensitive code and compares them with a baseline
+void run_voxel_perf_tests();
 } // namespace zylann::voxel::tests
 
 namespace zylann::voxel::noise_tests {
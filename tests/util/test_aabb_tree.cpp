@@ -0,0 +1,108 @@
+#include "test_aabb_tree.h"
+#include "../../util/containers/std_unordered_set.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/aabb_tree.h"
+#include "../testing.h"
+#include <random>
+
+namespace zylann::tests {
+
+void test_aabb_tree() {
+	// Basic
+	{
+		AABBTree tree;
+		ZN_TEST_ASSERT(tree.get_leaf_count() == 0);
+		ZN_TEST_ASSERT(tree.get_height() == 0);
+
+		const uint32_t a = tree.add(AABB(Vector3(0, 0, 0), Vector3(1, 1, 1)), 10);
+		const uint32_t b = tree.add(AABB(Vector3(5, 0, 0), Vector3(1, 1, 1)), 20);
+		ZN_TEST_ASSERT(tree.get_leaf_count() == 2);
+		ZN_TEST_ASSERT(tree.get_data(a) == 10);
+		ZN_TEST_ASSERT(tree.get_data(b) == 20);
+
+		StdVector<uint32_t> found;
+		tree.query(AABB(Vector3(-1, -1, -1), Vector3(2, 2, 2)), [&found](uint32_t data) { found.push_back(data); });
+		ZN_TEST_ASSERT(found.size() == 1 && found[0] == 10);
+
+		// Move the first box next to the second one
+		tree.update(a, AABB(Vector3(5.5, 0, 0), Vector3(1, 1, 1)));
+		found.clear();
+		tree.query(AABB(Vector3(-1, -1, -1), Vector3(2, 2, 2)), [&found](uint32_t data) { found.push_back(data); });
+		ZN_TEST_ASSERT(found.size() == 0);
+		tree.query(AABB(Vector3(4, 0, 0), Vector3(2, 1, 1)), [&found](uint32_t data) { found.push_back(data); });
+		ZN_TEST_ASSERT(found.size() == 2);
+
+		tree.remove(b);
+		ZN_TEST_ASSERT(tree.get_leaf_count() == 1);
+		found.clear();
+		tree.query(AABB(Vector3(4, 0, 0), Vector3(2, 1, 1)), [&found](uint32_t data) { found.push_back(data); });
+		ZN_TEST_ASSERT(found.size() == 1 && found[0] == 10);
+	}
+	// Random operations compared against brute force
+	{
+		struct Item {
+			AABB aabb;
+			uint32_t leaf_id;
+			bool alive;
+		};
+
+		AABBTree tree;
+		StdVector<Item> items;
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> position(-100.f, 100.f);
+		std::uniform_real_distribution<float> size(0.5f, 10.f);
+
+		auto random_aabb = [&rng, &position, &size]() {
+			return AABB(
+					Vector3(position(rng), position(rng), position(rng)), Vector3(size(rng), size(rng), size(rng))
+			);
+		};
+
+		StdUnorderedSet<uint32_t> found;
+		StdUnorderedSet<uint32_t> expected;
+
+		for (unsigned int i = 0; i < 10000; ++i) {
+			const unsigned int op = rng() % 4;
+
+			if (op < 2 || items.size() == 0) {
+				const AABB aabb = random_aabb();
+				const uint32_t leaf_id = tree.add(aabb, items.size());
+				items.push_back(Item{ aabb, leaf_id, true });
+
+			} else {
+				Item &item = items[rng() % items.size()];
+				if (item.alive) {
+					if (op == 2) {
+						tree.remove(item.leaf_id);
+						item.alive = false;
+					} else {
+						item.aabb = random_aabb();
+						tree.update(item.leaf_id, item.aabb);
+					}
+				}
+			}
+
+			if (i % 50 == 0) {
+				const AABB query_aabb(Vector3(position(rng), position(rng), position(rng)), Vector3(30, 30, 30));
+
+				found.clear();
+				tree.query(query_aabb, [&found](uint32_t data) { found.insert(data); });
+
+				expected.clear();
+				for (unsigned int item_index = 0; item_index < items.size(); ++item_index) {
+					const Item &item = items[item_index];
+					if (item.alive && item.aabb.intersects(query_aabb)) {
+						expected.insert(item_index);
+					}
+				}
+
+				ZN_TEST_ASSERT(found == expected);
+			}
+		}
+
+		// Should remain balanced
+		ZN_TEST_ASSERT(tree.get_height() < 40);
+	}
+}
+
+} // namespace zylann::tests
@@ -0,0 +1,57 @@
+#include "test_adaptive_time_budget.h"
+#include "../../util/tasks/adaptive_time_budget.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_adaptive_time_budget() {
+	{
+		// Without target rate, the budget is fixed
+		AdaptiveTimeBudget budget;
+		budget.set_max_budget_usec(8000);
+		budget.update(100000);
+		ZN_TEST_ASSERT(budget.get_budget_usec() == 8000);
+		budget.update(1000);
+		ZN_TEST_ASSERT(budget.get_budget_usec() == 8000);
+	}
+	{
+		// At 144 FPS, the budget starts limited to a portion of the frame
+		AdaptiveTimeBudget budget;
+		budget.set_max_budget_usec(8000);
+		budget.set_target_fps(144);
+		const uint32_t upper_bound = (1000000 / 144) * AdaptiveTimeBudget::MAX_FRAME_RATIO;
+		ZN_TEST_ASSERT(budget.get_budget_usec() == upper_bound);
+
+		// Late frames shrink the budget, down to a minimum
+		budget.update(20000);
+		ZN_TEST_ASSERT(budget.get_budget_usec() < upper_bound);
+		for (unsigned int i = 0; i < 100; ++i) {
+			budget.update(20000);
+		}
+		ZN_TEST_ASSERT(budget.get_budget_usec() == AdaptiveTimeBudget::MIN_BUDGET_USEC);
+
+		// Frames on time grow it back, without exceeding the upper bound
+		budget.update(1000000 / 144);
+		ZN_TEST_ASSERT(
+				budget.get_budget_usec() ==
+				AdaptiveTimeBudget::MIN_BUDGET_USEC + AdaptiveTimeBudget::INCREASE_STEP_USEC
+		);
+		for (unsigned int i = 0; i < 100; ++i) {
+			budget.update(1000);
+		}
+		ZN_TEST_ASSERT(budget.get_budget_usec() == upper_bound);
+	}
+	{
+		// Low target rates allow budgets higher than the default
+		AdaptiveTimeBudget budget;
+		budget.set_max_budget_usec(8000);
+		budget.set_target_fps(20);
+		ZN_TEST_ASSERT(budget.get_budget_usec() == 8000);
+		for (unsigned int i = 0; i < 100; ++i) {
+			budget.update(30000);
+		}
+		ZN_TEST_ASSERT(budget.get_budget_usec() == 25000);
+	}
+}
+
+} // namespace zylann::tests
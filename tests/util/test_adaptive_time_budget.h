@@ -0,0 +1,10 @@
+#ifndef ZN_TESTS_ADAPTIVE_TIME_BUDGET_H
+#define ZN_TESTS_ADAPTIVE_TIME_BUDGET_H
+
+namespace zylann::tests {
+
+void test_adaptive_time_budget();
+
+} // namespace zylann::tests
+
+#endif // ZN_TESTS_ADAPTIVE_TIME_BUDGET_H
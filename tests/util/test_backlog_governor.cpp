@@ -0,0 +1,58 @@
+#include "test_backlog_governor.h"
+#include "../../util/tasks/backlog_governor.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_backlog_governor() {
+	{
+		// Disabled by default
+		BacklogGovernor governor;
+		governor.update(100000, 1000);
+		ZN_TEST_ASSERT(governor.get_scale() == 1.f);
+	}
+	{
+		BacklogGovernor governor;
+		governor.set_max_pending_tasks(1000);
+		uint64_t time_msec = 1000;
+
+		// Large backlogs shrink the scale, down to a minimum
+		governor.update(2000, time_msec);
+		ZN_TEST_ASSERT(governor.get_scale() < 1.f);
+		const float scale = governor.get_scale();
+
+		// Updates are not done more often than the period
+		governor.update(2000, time_msec + 1);
+		ZN_TEST_ASSERT(governor.get_scale() == scale);
+
+		for (unsigned int i = 0; i < 100; ++i) {
+			time_msec += BacklogGovernor::UPDATE_PERIOD_MSEC;
+			governor.update(2000, time_msec);
+		}
+		ZN_TEST_ASSERT(governor.get_scale() == BacklogGovernor::MIN_SCALE);
+
+		// Backlogs between both thresholds don't change it
+		time_msec += BacklogGovernor::UPDATE_PERIOD_MSEC;
+		governor.update(500, time_msec);
+		ZN_TEST_ASSERT(governor.get_scale() == BacklogGovernor::MIN_SCALE);
+
+		// Small backlogs restore it
+		time_msec += BacklogGovernor::UPDATE_PERIOD_MSEC;
+		governor.update(10, time_msec);
+		ZN_TEST_ASSERT(governor.get_scale() > BacklogGovernor::MIN_SCALE);
+		for (unsigned int i = 0; i < 100; ++i) {
+			time_msec += BacklogGovernor::UPDATE_PERIOD_MSEC;
+			governor.update(10, time_msec);
+		}
+		ZN_TEST_ASSERT(governor.get_scale() == 1.f);
+
+		// Disabling resets it
+		time_msec += BacklogGovernor::UPDATE_PERIOD_MSEC;
+		governor.update(2000, time_msec);
+		ZN_TEST_ASSERT(governor.get_scale() < 1.f);
+		governor.set_max_pending_tasks(0);
+		ZN_TEST_ASSERT(governor.get_scale() == 1.f);
+	}
+}
+
+} // namespace zylann::tests
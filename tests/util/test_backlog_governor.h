@@ -0,0 +1,10 @@
+#ifndef ZN_TESTS_BACKLOG_GOVERNOR_H
+#define ZN_TESTS_BACKLOG_GOVERNOR_H
+
+namespace zylann::tests {
+
+void test_backlog_governor();
+
+} // namespace zylann::tests
+
+#endif // ZN_TESTS_BACKLOG_GOVERNOR_H
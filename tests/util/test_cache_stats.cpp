@@ -0,0 +1,76 @@
+#include "test_cache_stats.h"
+#include "../../util/cache_stats.h"
+#include "../testing.h"
+
+#include <cstring>
+
+namespace zylann::tests {
+
+namespace {
+
+CacheStats::Snapshot get_registered_snapshot(const char *name) {
+	StdVector<CacheStats::Snapshot> snapshots;
+	CacheStats::get_all_snapshots(snapshots);
+	for (const CacheStats::Snapshot &snapshot : snapshots) {
+		if (std::strcmp(snapshot.name, name) == 0) {
+			return snapshot;
+		}
+	}
+	return CacheStats::Snapshot();
+}
+
+} // namespace
+
+void test_cache_stats() {
+	// Not a name used by actual caches, so their activity doesn't interfere
+	const char *name = "test_cache_stats";
+
+	{
+		CacheStats a(name);
+		a.add_hit();
+		a.add_hit();
+		a.add_miss();
+		a.add_evictions(3);
+		a.set_entries(10);
+		a.set_memory_usage(1000);
+
+		const CacheStats::Snapshot a_snapshot = a.get_snapshot();
+		ZN_TEST_ASSERT(a_snapshot.hits == 2);
+		ZN_TEST_ASSERT(a_snapshot.misses == 1);
+		ZN_TEST_ASSERT(a_snapshot.evictions == 3);
+
+		{
+			// Instances with the same name are summed
+			CacheStats b(name);
+			b.add_hit_or_miss(true);
+			b.add_hit_or_miss(false);
+			b.set_entries(5);
+			b.set_memory_usage(500);
+
+			const CacheStats::Snapshot snapshot = get_registered_snapshot(name);
+			ZN_TEST_ASSERT(snapshot.instance_count == 2);
+			ZN_TEST_ASSERT(snapshot.hits == 3);
+			ZN_TEST_ASSERT(snapshot.misses == 2);
+			ZN_TEST_ASSERT(snapshot.evictions == 3);
+			ZN_TEST_ASSERT(snapshot.entries == 15);
+			ZN_TEST_ASSERT(snapshot.memory_usage == 1500);
+			ZN_TEST_ASSERT(snapshot.get_hit_rate() > 0.59f && snapshot.get_hit_rate() < 0.61f);
+		}
+
+		// Counters of destroyed instances are kept, but not their size
+		const CacheStats::Snapshot snapshot = get_registered_snapshot(name);
+		ZN_TEST_ASSERT(snapshot.instance_count == 1);
+		ZN_TEST_ASSERT(snapshot.hits == 3);
+		ZN_TEST_ASSERT(snapshot.misses == 2);
+		ZN_TEST_ASSERT(snapshot.entries == 10);
+		ZN_TEST_ASSERT(snapshot.memory_usage == 1000);
+	}
+
+	const CacheStats::Snapshot snapshot = get_registered_snapshot(name);
+	ZN_TEST_ASSERT(snapshot.instance_count == 0);
+	ZN_TEST_ASSERT(snapshot.hits == 3);
+	ZN_TEST_ASSERT(snapshot.evictions == 3);
+	ZN_TEST_ASSERT(snapshot.entries == 0);
+}
+
+} // namespace zylann::tests
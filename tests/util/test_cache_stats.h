@@ -0,0 +1,10 @@
+#ifndef ZN_TESTS_CACHE_STATS_H
+#define ZN_TESTS_CACHE_STATS_H
+
+namespace zylann::tests {
+
+void test_cache_stats();
+
+} // namespace zylann::tests
+
+#endif // ZN_TESTS_CACHE_STATS_H
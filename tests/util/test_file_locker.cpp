@@ -0,0 +1,55 @@
+#include "test_file_locker.h"
+#include "../../util/io/file_locker.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_file_locker() {
+	FileLocker locker;
+
+	// The same path always gives the same lock, different paths give different locks
+	FileLocker::File &file_a = locker.get_file("a/region.vxr");
+	FileLocker::File &file_b = locker.get_file("b/region.vxr");
+	ZN_TEST_ASSERT(&file_a == &locker.get_file("a/region.vxr"));
+	ZN_TEST_ASSERT(&file_a != &file_b);
+
+	struct Context {
+		FileLocker *locker;
+		FileLocker::File *file;
+		bool could_lock;
+	};
+
+	// Locking by reference and by path are equivalent
+	locker.lock_write(file_a);
+	Context context{ &locker, &file_a, true };
+	Thread thread;
+	thread.start(
+			[](void *userdata) {
+				Context &context = *static_cast<Context *>(userdata);
+				context.could_lock = context.file->lock.read_try_lock();
+				if (context.could_lock) {
+					context.file->lock.read_unlock();
+				}
+			},
+			&context
+	);
+	thread.wait_to_finish();
+	ZN_TEST_ASSERT(context.could_lock == false);
+	locker.unlock("a/region.vxr");
+
+	// Another file is not affected
+	locker.lock_write(file_a);
+	locker.lock_read("b/region.vxr");
+	locker.unlock(file_b);
+	locker.unlock(file_a);
+
+	ZN_TEST_ASSERT(file_a.lock.write_try_lock());
+	file_a.lock.write_unlock();
+
+	const FileLocker::Stats stats = locker.get_stats();
+	ZN_TEST_ASSERT(stats.lookups >= 4);
+	ZN_TEST_ASSERT(stats.contended_locks == 0);
+}
+
+} // namespace zylann::tests
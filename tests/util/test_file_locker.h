@@ -0,0 +1,10 @@
+#ifndef ZN_TEST_FILE_LOCKER_H
+#define ZN_TEST_FILE_LOCKER_H
+
+namespace zylann::tests {
+
+void test_file_locker();
+
+} // namespace zylann::tests
+
+#endif // ZN_TEST_FILE_LOCKER_H
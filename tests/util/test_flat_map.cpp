@@ -2,6 +2,7 @@
 #include "../../util/containers/flat_map.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/core/random_pcg.h"
+#include "../../util/memory/memory.h"
 #include "../testing.h"
 
 namespace zylann::tests {
@@ -103,4 +104,79 @@ void test_flat_map() {
 	}
 }
 
+void test_flat_map_move_only() {
+	typedef FlatMapMoveOnly<int, UniquePtr<int>> Map;
+
+	StdVector<int> keys;
+	for (int i = 0; i < 100; ++i) {
+		keys.push_back(i * 3);
+	}
+	StdVector<int> shuffled_keys = keys;
+	RandomPCG rng;
+	rng.seed(131183);
+	for (size_t i = 0; i < shuffled_keys.size(); ++i) {
+		const size_t dst_i = rng.rand() % shuffled_keys.size();
+		std::swap(shuffled_keys[i], shuffled_keys[dst_i]);
+	}
+
+	struct L {
+		static bool validate_map(const Map &map, const StdVector<int> &sorted_keys) {
+			ZN_TEST_ASSERT_V(map.size() == sorted_keys.size(), false);
+			size_t i = 0;
+			for (Map::ConstIterator it = map.begin(); it != map.end(); ++it) {
+				ZN_TEST_ASSERT_V(it->key == sorted_keys[i], false);
+				ZN_TEST_ASSERT_V(it->value != nullptr && *it->value == 10 * it->key, false);
+				const UniquePtr<int> *value = map.find(sorted_keys[i]);
+				ZN_TEST_ASSERT_V(value != nullptr && value->get() == it->value.get(), false);
+				++i;
+			}
+			return true;
+		}
+	};
+
+	{
+		// Insert random items
+		Map map;
+		for (const int key : shuffled_keys) {
+			ZN_TEST_ASSERT(map.insert(key, make_unique_instance<int>(10 * key)));
+			ZN_TEST_ASSERT(!map.insert(key, make_unique_instance<int>(0)));
+		}
+		ZN_TEST_ASSERT(L::validate_map(map, keys));
+		ZN_TEST_ASSERT(!map.has(1));
+		ZN_TEST_ASSERT(map.find(-1) == nullptr);
+		ZN_TEST_ASSERT(map.lower_bound_index(1) == 1);
+		ZN_TEST_ASSERT(map.lower_bound_index(3, 5) == 5);
+		ZN_TEST_ASSERT(map.lower_bound_index(1000) == map.size());
+	}
+	{
+		// Init from collection
+		StdVector<Map::Pair> pairs;
+		for (const int key : shuffled_keys) {
+			pairs.push_back(Map::Pair(key, make_unique_instance<int>(10 * key)));
+		}
+		Map map;
+		map.clear_and_insert(to_span(pairs));
+		ZN_TEST_ASSERT(L::validate_map(map, keys));
+
+		// Replace
+		UniquePtr<int> &value = map.insert_or_assign(3, make_unique_instance<int>(30));
+		ZN_TEST_ASSERT(*value == 30);
+		ZN_TEST_ASSERT(map.size() == keys.size());
+
+		// Erase one and then many
+		ZN_TEST_ASSERT(map.erase(0));
+		ZN_TEST_ASSERT(!map.erase(0));
+		map.remove_if([](const int &key, const UniquePtr<int> &value) { //
+			return key % 2 == 0;
+		});
+		StdVector<int> remaining_keys;
+		for (const int key : keys) {
+			if (key % 2 != 0) {
+				remaining_keys.push_back(key);
+			}
+		}
+		ZN_TEST_ASSERT(L::validate_map(map, remaining_keys));
+	}
+}
+
 } // namespace zylann::tests
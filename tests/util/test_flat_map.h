@@ -4,6 +4,7 @@
 namespace zylann::tests {
 
 void test_flat_map();
+void test_flat_map_move_only();
 
 } // namespace zylann::tests
 
@@ -0,0 +1,123 @@
+#include "test_hierarchical_a_star_grid_3d.h"
+#include "../../util/containers/container_funcs.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/hierarchical_a_star_grid_3d.h"
+#include "../../util/math/conv.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+namespace {
+
+class TestGridPathfinder : public AStarGrid3D {
+public:
+	Vector3i size;
+	StdVector<uint8_t> solid;
+
+	void create(Vector3i p_size) {
+		size = p_size;
+		solid.clear();
+		solid.resize(Vector3iUtil::get_volume_u64(size), 0);
+	}
+
+	void set_solid(Box3i box, bool v) {
+		box.for_each_cell([this, v](Vector3i pos) { solid[Vector3iUtil::get_zxy_index(pos, size)] = v ? 1 : 0; });
+	}
+
+protected:
+	bool is_solid(Vector3i pos) override {
+		if (!Box3i(Vector3i(), size).contains(pos)) {
+			return false;
+		}
+		return solid[Vector3iUtil::get_zxy_index(pos, size)] != 0;
+	}
+};
+
+// Checks every step of the path can be done by an agent
+bool is_path_valid(TestGridPathfinder &pf, Span<const Vector3i> path, Vector3i from, Vector3i to) {
+	if (path.size() == 0 || path[0] != from) {
+		return false;
+	}
+	StdVector<Vector3i> neighbors;
+	for (unsigned int i = 0; i < path.size(); ++i) {
+		const Vector3i next = i + 1 < path.size() ? path[i + 1] : to;
+		neighbors.clear();
+		pf.get_reachable_neighbors(path[i], neighbors);
+		if (!contains(to_span_const(neighbors), next)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+float get_path_cost(Span<const Vector3i> path, Vector3i to) {
+	float cost = 0.f;
+	for (unsigned int i = 0; i < path.size(); ++i) {
+		const Vector3i next = i + 1 < path.size() ? path[i + 1] : to;
+		cost += math::length(to_vec3f(next - path[i]));
+	}
+	return cost;
+}
+
+} // namespace
+
+void test_hierarchical_a_star_grid_3d() {
+	const Box3i region(Vector3i(), Vector3i(48, 8, 48));
+
+	TestGridPathfinder pf;
+	pf.create(region.size);
+	pf.set_region(region);
+	// Ground
+	pf.set_solid(Box3i(Vector3i(0, 0, 0), Vector3i(48, 1, 48)), true);
+	// Wall too high to jump over, with an opening at the end
+	pf.set_solid(Box3i(Vector3i(20, 1, 0), Vector3i(1, 4, 40)), true);
+
+	HierarchicalAStarGrid3D hpa;
+	hpa.set_cluster_size(16);
+	hpa.set_region(region);
+
+	const Vector3i from(2, 1, 2);
+	const Vector3i to(40, 1, 2);
+
+	StdVector<Vector3i> path;
+	ZN_TEST_ASSERT(hpa.find_path(pf, from, to, path));
+	ZN_TEST_ASSERT(hpa.debug_get_dirty_cluster_count() == 0);
+	ZN_TEST_ASSERT(hpa.debug_get_portal_count() > 0);
+	// The region of the pathfinder is left untouched
+	ZN_TEST_ASSERT(pf.get_region() == region);
+	ZN_TEST_ASSERT(is_path_valid(pf, to_span(path), from, to));
+
+	// Compare with a regular search
+	pf.start(from, to);
+	while (pf.is_running()) {
+		pf.step();
+	}
+	StdVector<Vector3i> expected_path;
+	expected_path.insert(expected_path.end(), pf.get_path().begin(), pf.get_path().end());
+	ZN_TEST_ASSERT(expected_path.size() > 0);
+	const float expected_cost = get_path_cost(to_span(expected_path), to);
+	const float cost = get_path_cost(to_span(path), to);
+	// Hierarchical paths are not optimal, but should remain reasonable
+	ZN_TEST_ASSERT(cost < expected_cost * 1.5f);
+
+	// Short path within a cluster
+	ZN_TEST_ASSERT(hpa.find_path(pf, Vector3i(25, 1, 25), Vector3i(30, 1, 28), path));
+	ZN_TEST_ASSERT(is_path_valid(pf, to_span(path), Vector3i(25, 1, 25), Vector3i(30, 1, 28)));
+
+	// Close the opening, there is no path anymore
+	const Box3i opening(Vector3i(20, 1, 40), Vector3i(1, 4, 8));
+	pf.set_solid(opening, true);
+	hpa.invalidate(opening);
+	ZN_TEST_ASSERT(hpa.debug_get_dirty_cluster_count() > 0);
+	ZN_TEST_ASSERT(!hpa.find_path(pf, from, to, path));
+	ZN_TEST_ASSERT(path.size() == 0);
+
+	// Make a new one
+	const Box3i opening2(Vector3i(20, 1, 10), Vector3i(1, 4, 2));
+	pf.set_solid(opening2, false);
+	hpa.invalidate(opening2);
+	ZN_TEST_ASSERT(hpa.find_path(pf, from, to, path));
+	ZN_TEST_ASSERT(is_path_valid(pf, to_span(path), from, to));
+}
+
+} // namespace zylann::tests
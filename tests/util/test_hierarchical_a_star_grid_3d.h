@@ -0,0 +1,10 @@
+#ifndef ZN_TEST_HIERARCHICAL_A_STAR_GRID_3D_H
+#define ZN_TEST_HIERARCHICAL_A_STAR_GRID_3D_H
+
+namespace zylann::tests {
+
+void test_hierarchical_a_star_grid_3d();
+
+} // namespace zylann::tests
+
+#endif // ZN_TEST_HIERARCHICAL_A_STAR_GRID_3D_H
@@ -1,6 +1,8 @@
 #include "test_island_finder.h"
 #include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/random_pcg.h"
 #include "../../util/island_finder.h"
+#include "../benchmarking.h"
 #include "../testing.h"
 
 namespace zylann::tests {
@@ -86,4 +88,134 @@ void test_island_finder() {
 	ZN_TEST_ASSERT(label_count == 3);
 }
 
+namespace {
+
+// Reference labeling using flood fills started in ZXY order, which must give the same labels as `IslandFinder`
+unsigned int label_islands_flood_fill(const StdVector<uint8_t> &grid, Vector3i grid_size, StdVector<uint8_t> &output) {
+	output.clear();
+	output.resize(grid.size(), 0);
+	unsigned int count = 0;
+	StdVector<Vector3i> stack;
+
+	Vector3i pos;
+	for (pos.z = 0; pos.z < grid_size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < grid_size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < grid_size.y; ++pos.y) {
+				const unsigned int seed_index = Vector3iUtil::get_zxy_index(pos, grid_size);
+				if (grid[seed_index] == 0 || output[seed_index] != 0) {
+					continue;
+				}
+				++count;
+				output[seed_index] = count;
+				stack.push_back(pos);
+
+				while (stack.size() > 0) {
+					const Vector3i p = stack.back();
+					stack.pop_back();
+
+					for (unsigned int side = 0; side < Vector3iUtil::AXIS_COUNT * 2; ++side) {
+						Vector3i np = p;
+						np[side / 2] += (side & 1) == 0 ? -1 : 1;
+						if (!Box3i(Vector3i(), grid_size).contains(np)) {
+							continue;
+						}
+						const unsigned int ni = Vector3iUtil::get_zxy_index(np, grid_size);
+						if (grid[ni] != 0 && output[ni] == 0) {
+							output[ni] = count;
+							stack.push_back(np);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+// Random spheres, some of them overlapping, some touching edges of the grid
+void make_island_finder_large_grid(StdVector<uint8_t> &grid, const Vector3i grid_size) {
+	grid.clear();
+	grid.resize(Vector3iUtil::get_volume_u64(grid_size), 0);
+
+	RandomPCG rng;
+	rng.seed(131183);
+	for (unsigned int sphere_index = 0; sphere_index < 60; ++sphere_index) {
+		const Vector3i center(rng.rand(grid_size.x), rng.rand(grid_size.y), rng.rand(grid_size.z));
+		const int radius = 2 + rng.rand(6);
+
+		Vector3i pos;
+		for (pos.z = 0; pos.z < grid_size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < grid_size.x; ++pos.x) {
+				for (pos.y = 0; pos.y < grid_size.y; ++pos.y) {
+					const Vector3i d = pos - center;
+					if (d.x * d.x + d.y * d.y + d.z * d.z <= radius * radius) {
+						grid[Vector3iUtil::get_zxy_index(pos, grid_size)] = 1;
+					}
+				}
+			}
+		}
+	}
+}
+
+void scan_island_finder_grid(
+		IslandFinder &island_finder,
+		const StdVector<uint8_t> &grid,
+		const Vector3i grid_size,
+		StdVector<uint8_t> &output,
+		unsigned int &label_count
+) {
+	island_finder.scan_3d(
+			Box3i(Vector3i(), grid_size),
+			[&grid, grid_size](Vector3i pos) { //
+				return grid[Vector3iUtil::get_zxy_index(pos, grid_size)] != 0;
+			},
+			to_span(output),
+			&label_count
+	);
+}
+
+} // namespace
+
+void test_island_finder_large() {
+	const Vector3i grid_size(96, 80, 72);
+	StdVector<uint8_t> grid;
+	make_island_finder_large_grid(grid, grid_size);
+
+	StdVector<uint8_t> expected_output;
+	const unsigned int expected_count = label_islands_flood_fill(grid, grid_size, expected_output);
+	ZN_TEST_ASSERT(expected_count > 1);
+
+	StdVector<uint8_t> output;
+	output.resize(grid.size());
+	unsigned int label_count = 0;
+
+	IslandFinder island_finder;
+	// Scanning twice with the same finder, since it reuses its internal state
+	for (unsigned int i = 0; i < 2; ++i) {
+		scan_island_finder_grid(island_finder, grid, grid_size, output, label_count);
+
+		ZN_TEST_ASSERT(label_count == expected_count);
+		ZN_TEST_ASSERT(output == expected_output);
+	}
+}
+
+void test_island_finder_benchmark(testing::BenchmarkSuite &suite) {
+	const Vector3i grid_size(96, 80, 72);
+	StdVector<uint8_t> grid;
+	make_island_finder_large_grid(grid, grid_size);
+
+	StdVector<uint8_t> output;
+	output.resize(grid.size());
+	unsigned int label_count = 0;
+
+	IslandFinder island_finder;
+
+	suite.run("island_finder_scan_3d", 1, [&island_finder, &grid, grid_size, &output, &label_count]() {
+		scan_island_finder_grid(island_finder, grid, grid_size, output, label_count);
+	});
+
+	ZN_TEST_ASSERT(label_count > 1);
+}
+
 } // namespace zylann::tests
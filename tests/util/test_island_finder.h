@@ -1,9 +1,15 @@
 #ifndef ZN_TESTS_ISLAND_FINDER_H
 #define ZN_TESTS_ISLAND_FINDER_H
 
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
 namespace zylann::tests {
 
 void test_island_finder();
+void test_island_finder_large();
+void test_island_finder_benchmark(testing::BenchmarkSuite &suite);
 
 } // namespace zylann::tests
 
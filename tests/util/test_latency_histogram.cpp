@@ -0,0 +1,64 @@
+#include "test_latency_histogram.h"
+#include "../../util/latency_histogram.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_latency_histogram_buckets() {
+	// Small values are exact
+	for (uint64_t v = 0; v < LatencyHistogram::SUB_BUCKET_COUNT; ++v) {
+		ZN_TEST_ASSERT(LatencyHistogram::get_bucket_index(v) == v);
+		ZN_TEST_ASSERT(LatencyHistogram::get_bucket_max_value(v) == v);
+	}
+
+	// Every value must fall in a bucket that contains it, and buckets must be contiguous
+	uint64_t prev_bucket_max = 0;
+	for (unsigned int bucket_index = 0; bucket_index < LatencyHistogram::BUCKET_COUNT; ++bucket_index) {
+		const uint64_t bucket_max = LatencyHistogram::get_bucket_max_value(bucket_index);
+		if (bucket_index > 0) {
+			const uint64_t bucket_min = prev_bucket_max + 1;
+			ZN_TEST_ASSERT(bucket_max >= bucket_min);
+			ZN_TEST_ASSERT(LatencyHistogram::get_bucket_index(bucket_min) == bucket_index);
+		}
+		ZN_TEST_ASSERT(LatencyHistogram::get_bucket_index(bucket_max) == bucket_index);
+		prev_bucket_max = bucket_max;
+	}
+
+	// Huge values are clamped into the last bucket
+	ZN_TEST_ASSERT(LatencyHistogram::get_bucket_index(0xffffffffffffffff) == LatencyHistogram::BUCKET_COUNT - 1);
+}
+
+void test_latency_histogram_percentiles() {
+	LatencyHistogram histogram;
+
+	LatencyHistogram::Snapshot snapshot;
+	histogram.get_snapshot(snapshot);
+	ZN_TEST_ASSERT(snapshot.count == 0);
+	ZN_TEST_ASSERT(snapshot.get_percentile_usec(0.5f) == 0);
+	ZN_TEST_ASSERT(snapshot.get_mean_usec() == 0);
+
+	// 1 to 1000 microseconds
+	for (uint64_t v = 1; v <= 1000; ++v) {
+		histogram.add(v);
+	}
+
+	histogram.get_snapshot(snapshot);
+	ZN_TEST_ASSERT(snapshot.count == 1000);
+	ZN_TEST_ASSERT(snapshot.max_usec == 1000);
+	ZN_TEST_ASSERT(snapshot.get_mean_usec() == 500);
+
+	// Results are rounded up to the precision of buckets
+	const uint64_t p50 = snapshot.get_percentile_usec(0.5f);
+	ZN_TEST_ASSERT(p50 >= 500 && p50 <= 500 + 500 / LatencyHistogram::SUB_BUCKET_COUNT);
+	const uint64_t p99 = snapshot.get_percentile_usec(0.99f);
+	ZN_TEST_ASSERT(p99 >= 990 && p99 <= 1000);
+	ZN_TEST_ASSERT(snapshot.get_percentile_usec(1.f) == 1000);
+
+	histogram.reset();
+	histogram.get_snapshot(snapshot);
+	ZN_TEST_ASSERT(snapshot.count == 0);
+	ZN_TEST_ASSERT(snapshot.max_usec == 0);
+	ZN_TEST_ASSERT(snapshot.get_percentile_usec(0.9f) == 0);
+}
+
+} // namespace zylann::tests
@@ -0,0 +1,11 @@
+#ifndef ZN_TESTS_LATENCY_HISTOGRAM_H
+#define ZN_TESTS_LATENCY_HISTOGRAM_H
+
+namespace zylann::tests {
+
+void test_latency_histogram_buckets();
+void test_latency_histogram_percentiles();
+
+} // namespace zylann::tests
+
+#endif // ZN_TESTS_LATENCY_HISTOGRAM_H
@@ -0,0 +1,60 @@
+#include "test_linear_allocator.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/memory/linear_allocator.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_linear_allocator() {
+	LinearAllocator allocator(256);
+	ZN_TEST_ASSERT(allocator.get_capacity() == 0);
+
+	// Allocations are aligned
+	uint8_t *a = static_cast<uint8_t *>(allocator.allocate(3, 1));
+	double *b = static_cast<double *>(allocator.allocate(sizeof(double) * 4, alignof(double)));
+	ZN_TEST_ASSERT(a != nullptr);
+	ZN_TEST_ASSERT(reinterpret_cast<uintptr_t>(b) % alignof(double) == 0);
+	ZN_TEST_ASSERT(allocator.get_chunk_count() == 1);
+
+	// Freeing the last allocation makes its memory available again
+	const size_t used_size = allocator.get_used_size();
+	void *c = allocator.allocate(16, 8);
+	allocator.deallocate(c, 16);
+	ZN_TEST_ASSERT(allocator.get_used_size() == used_size);
+	ZN_TEST_ASSERT(allocator.allocate(16, 8) == c);
+
+	// Allocations larger than the default chunk size get a chunk fitting them
+	uint8_t *large = static_cast<uint8_t *>(allocator.allocate(1000, 16));
+	for (unsigned int i = 0; i < 1000; ++i) {
+		large[i] = i;
+	}
+	ZN_TEST_ASSERT(allocator.get_chunk_count() == 2);
+
+	// Standard containers can use it, and keep growing across chunks
+	{
+		StdVector<int, StdLinearAllocator<int>> values{ StdLinearAllocator<int>(allocator) };
+		for (int i = 0; i < 1000; ++i) {
+			values.push_back(i);
+		}
+		for (int i = 0; i < 1000; ++i) {
+			ZN_TEST_ASSERT(values[i] == i);
+		}
+	}
+	ZN_TEST_ASSERT(allocator.get_chunk_count() > 2);
+
+	// After reset, chunks are merged into one, large enough to hold all of what was used
+	const size_t capacity = allocator.get_capacity();
+	allocator.reset();
+	ZN_TEST_ASSERT(allocator.get_used_size() == 0);
+	ZN_TEST_ASSERT(allocator.get_chunk_count() == 1);
+	ZN_TEST_ASSERT(allocator.get_capacity() >= capacity);
+	allocator.allocate(capacity / 2, 1);
+	ZN_TEST_ASSERT(allocator.get_chunk_count() == 1);
+
+	// Using a lot of memory once doesn't keep it allocated
+	allocator.allocate(LinearAllocator::MAX_RETAINED_SIZE + 1, 1);
+	allocator.reset();
+	ZN_TEST_ASSERT(allocator.get_capacity() == 0);
+}
+
+} // namespace zylann::tests
@@ -1,5 +1,6 @@
 #include "test_math_funcs.h"
 #include "../../util/math/funcs.h"
+#include "../../util/math/morton.h"
 #include "../testing.h"
 
 namespace zylann::tests {
@@ -30,4 +31,33 @@ void test_wrap() {
 	}
 }
 
+void test_morton_3d() {
+	// Neighbors along Y are consecutive, like in ZXY order
+	ZN_TEST_ASSERT(math::encode_morton_3d(Vector3i(0, 1, 0)) == 1);
+	ZN_TEST_ASSERT(math::encode_morton_3d(Vector3i(1, 0, 0)) == 2);
+	ZN_TEST_ASSERT(math::encode_morton_3d(Vector3i(0, 0, 1)) == 4);
+	ZN_TEST_ASSERT(math::encode_morton_3d(Vector3i(1023, 1023, 1023)) == (1u << 30) - 1);
+
+	for (int i = 0; i < 1000; ++i) {
+		const Vector3i pos((i * 7) % 1024, (i * 131) % 1024, (i * 601) % 1024);
+		const uint32_t m = math::encode_morton_3d(pos);
+		ZN_TEST_ASSERT(math::decode_morton_3d(m) == pos);
+
+		const uint32_t x_delta = math::morton_spread_bits_3d(1) << 1;
+		const uint32_t y_delta_neg = math::morton_spread_bits_3d(-1);
+		if (pos.x < 1023) {
+			ZN_TEST_ASSERT(
+					math::add_morton_3d(m, x_delta, math::MORTON_MASK_X) ==
+					math::encode_morton_3d(pos + Vector3i(1, 0, 0))
+			);
+		}
+		if (pos.y > 0) {
+			ZN_TEST_ASSERT(
+					math::add_morton_3d(m, y_delta_neg, math::MORTON_MASK_Y) ==
+					math::encode_morton_3d(pos - Vector3i(0, 1, 0))
+			);
+		}
+	}
+}
+
 } // namespace zylann::tests
@@ -4,6 +4,7 @@
 namespace zylann::tests {
 
 void test_wrap();
+void test_morton_3d();
 
 } // namespace zylann::tests
 
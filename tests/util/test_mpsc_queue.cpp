@@ -0,0 +1,89 @@
+#include "test_mpsc_queue.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/mpsc_queue.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/math/funcs.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_mpsc_queue() {
+	// Threads push numbered items, alone or in batches, while the main thread takes them. Each thread's items must all
+	// be received exactly once, in the order they were pushed.
+
+	static const unsigned int THREAD_COUNT = 4;
+	static const unsigned int ITEMS_PER_THREAD = 20000;
+
+	struct Item {
+		uint32_t thread_index;
+		uint32_t number;
+	};
+
+	struct ThreadData {
+		MPSCQueue<Item> *queue = nullptr;
+		unsigned int thread_index = 0;
+	};
+
+	MPSCQueue<Item> queue;
+	ZN_TEST_ASSERT(queue.is_empty());
+
+	FixedArray<ThreadData, THREAD_COUNT> threads_data;
+	FixedArray<Thread, THREAD_COUNT> threads;
+
+	for (unsigned int thread_index = 0; thread_index < THREAD_COUNT; ++thread_index) {
+		ThreadData &td = threads_data[thread_index];
+		td.queue = &queue;
+		td.thread_index = thread_index;
+
+		threads[thread_index].start(
+				[](void *userdata) {
+					ThreadData &td = *static_cast<ThreadData *>(userdata);
+					uint32_t number = 0;
+					while (number < ITEMS_PER_THREAD) {
+						if ((number % 3) == 0) {
+							td.queue->push(Item{ td.thread_index, number });
+							++number;
+						} else {
+							const unsigned int count = math::min(number % 7 + 1, ITEMS_PER_THREAD - number);
+							const uint32_t first_number = number;
+							td.queue->push_n(count, [&td, first_number](unsigned int i) {
+								return Item{ td.thread_index, first_number + i };
+							});
+							number += count;
+						}
+					}
+				},
+				&td
+		);
+	}
+
+	FixedArray<uint32_t, THREAD_COUNT> next_numbers;
+	fill(next_numbers, uint32_t(0));
+	bool valid = true;
+	unsigned int received_count = 0;
+
+	while (received_count < THREAD_COUNT * ITEMS_PER_THREAD) {
+		received_count += queue.pop_all([&next_numbers, &valid](const Item &item) {
+			if (item.thread_index >= THREAD_COUNT || item.number != next_numbers[item.thread_index]) {
+				valid = false;
+				return;
+			}
+			++next_numbers[item.thread_index];
+		});
+	}
+
+	for (unsigned int thread_index = 0; thread_index < THREAD_COUNT; ++thread_index) {
+		threads[thread_index].wait_to_finish();
+	}
+
+	ZN_TEST_ASSERT(valid);
+	ZN_TEST_ASSERT(received_count == THREAD_COUNT * ITEMS_PER_THREAD);
+	ZN_TEST_ASSERT(queue.is_empty());
+	ZN_TEST_ASSERT(queue.pop_all([](const Item &item) {}) == 0);
+	for (unsigned int thread_index = 0; thread_index < THREAD_COUNT; ++thread_index) {
+		ZN_TEST_ASSERT(next_numbers[thread_index] == ITEMS_PER_THREAD);
+	}
+}
+
+} // namespace zylann::tests
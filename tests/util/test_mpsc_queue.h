@@ -0,0 +1,10 @@
+#ifndef ZN_TESTS_MPSC_QUEUE_H
+#define ZN_TESTS_MPSC_QUEUE_H
+
+namespace zylann::tests {
+
+void test_mpsc_queue();
+
+} // namespace zylann::tests
+
+#endif // ZN_TESTS_MPSC_QUEUE_H
@@ -0,0 +1,43 @@
+#include "test_profiling_tracer.h"
+#include "../../util/profiling_tracer.h"
+#include "../../util/string/std_string.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_profiling_tracer() {
+	const bool was_enabled = profiling_tracer::is_enabled();
+	profiling_tracer::set_enabled(false);
+	profiling_tracer::clear();
+
+	{
+		profiling_tracer::Scope scope("ZNTestNotRecorded");
+	}
+
+	profiling_tracer::set_enabled(true);
+	profiling_tracer::set_current_thread_name("ZNTestThread");
+	{
+		profiling_tracer::Scope scope("ZNTestOuter");
+		{
+			profiling_tracer::Scope scope2("ZNTest\"Quoted\"");
+		}
+		profiling_tracer::add_instant("ZNTestInstant");
+	}
+	profiling_tracer::set_enabled(false);
+
+	const StdString json = profiling_tracer::get_chrome_trace_json();
+	ZN_TEST_ASSERT(json.find("\"traceEvents\"") != StdString::npos);
+	ZN_TEST_ASSERT(json.find("ZNTestThread") != StdString::npos);
+	ZN_TEST_ASSERT(json.find("\"ZNTestOuter\",\"ph\":\"X\"") != StdString::npos);
+	ZN_TEST_ASSERT(json.find("\"ZNTest\\\"Quoted\\\"\"") != StdString::npos);
+	ZN_TEST_ASSERT(json.find("\"ZNTestInstant\",\"ph\":\"i\"") != StdString::npos);
+	ZN_TEST_ASSERT(json.find("ZNTestNotRecorded") == StdString::npos);
+
+	profiling_tracer::clear();
+	const StdString cleared_json = profiling_tracer::get_chrome_trace_json();
+	ZN_TEST_ASSERT(cleared_json.find("ZNTestOuter") == StdString::npos);
+
+	profiling_tracer::set_enabled(was_enabled);
+}
+
+} // namespace zylann::tests
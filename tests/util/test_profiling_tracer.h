@@ -0,0 +1,10 @@
+#ifndef ZN_TESTS_PROFILING_TRACER_H
+#define ZN_TESTS_PROFILING_TRACER_H
+
+namespace zylann::tests {
+
+void test_profiling_tracer();
+
+} // namespace zylann::tests
+
+#endif // ZN_TESTS_PROFILING_TRACER_H
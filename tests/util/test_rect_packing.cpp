@@ -0,0 +1,63 @@
+#include "test_rect_packing.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/math/box2i.h"
+#include "../../util/math/rect_packing.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_pack_rectangles_skyline() {
+	struct L {
+		static void test(Span<const Vector2i> sizes) {
+			StdVector<Vector2i> positions;
+			Vector2i atlas_size;
+			math::pack_rectangles_skyline(sizes, positions, atlas_size);
+
+			ZN_TEST_ASSERT(positions.size() == sizes.size());
+
+			const Box2i atlas_box(Vector2i(), atlas_size);
+			int64_t used_area = 0;
+
+			for (unsigned int i = 0; i < sizes.size(); ++i) {
+				const Box2i box(positions[i], sizes[i]);
+				ZN_TEST_ASSERT(atlas_box.contains(box));
+				used_area += Vector2iUtil::get_area(sizes[i]);
+
+				for (unsigned int j = i + 1; j < sizes.size(); ++j) {
+					const Box2i other_box(positions[j], sizes[j]);
+					ZN_TEST_ASSERT(!box.intersects(other_box));
+				}
+			}
+
+			// Not expecting optimal packing, but it should not waste most of the space
+			ZN_TEST_ASSERT(Vector2iUtil::get_area(atlas_size) <= 2 * used_area);
+		}
+	};
+
+	{
+		StdVector<Vector2i> sizes;
+		sizes.push_back(Vector2i(4, 4));
+		L::test(to_span(sizes));
+	}
+	{
+		// Same sizes, like quads of a flat wall
+		StdVector<Vector2i> sizes;
+		for (unsigned int i = 0; i < 50; ++i) {
+			sizes.push_back(Vector2i(3, 2));
+		}
+		L::test(to_span(sizes));
+	}
+	{
+		// Mix of thin and large quads, as greedy meshing produces
+		RandomPCG rng;
+		rng.seed(131183);
+		StdVector<Vector2i> sizes;
+		for (unsigned int i = 0; i < 300; ++i) {
+			sizes.push_back(Vector2i(1 + rng.rand() % 16, 1 + rng.rand() % 16));
+		}
+		L::test(to_span(sizes));
+	}
+}
+
+} // namespace zylann::tests
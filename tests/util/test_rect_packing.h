@@ -0,0 +1,10 @@
+#ifndef ZN_TESTS_RECT_PACKING_H
+#define ZN_TESTS_RECT_PACKING_H
+
+namespace zylann::tests {
+
+void test_pack_rectangles_skyline();
+
+} // namespace zylann::tests
+
+#endif // ZN_TESTS_RECT_PACKING_H
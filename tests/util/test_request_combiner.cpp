@@ -0,0 +1,89 @@
+#include "test_request_combiner.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/thread/request_combiner.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+#include <atomic>
+
+namespace zylann::tests {
+
+void test_request_combiner() {
+	// Threads submit many requests, which must all be processed exactly once, without exceeding the number of
+	// concurrent batches
+
+	static const unsigned int THREAD_COUNT = 8;
+	static const unsigned int REQUESTS_PER_THREAD = 2000;
+	static const unsigned int MAX_CONCURRENT_BATCHES = 2;
+
+	struct Request {
+		uint32_t input;
+		uint32_t output;
+	};
+
+	struct Context {
+		RequestCombiner<Request> combiner;
+		std::atomic_uint32_t running_batches{ 0 };
+		std::atomic_uint32_t max_running_batches{ 0 };
+		std::atomic_uint32_t batch_count{ 0 };
+		std::atomic_uint32_t processed_count{ 0 };
+	};
+
+	struct ThreadData {
+		Context *context = nullptr;
+		unsigned int thread_index = 0;
+		bool valid = true;
+	};
+
+	Context context;
+	context.combiner.set_max_concurrent_batches(MAX_CONCURRENT_BATCHES);
+
+	FixedArray<ThreadData, THREAD_COUNT> threads_data;
+	FixedArray<Thread, THREAD_COUNT> threads;
+
+	for (unsigned int thread_index = 0; thread_index < THREAD_COUNT; ++thread_index) {
+		ThreadData &td = threads_data[thread_index];
+		td.context = &context;
+		td.thread_index = thread_index;
+
+		threads[thread_index].start(
+				[](void *userdata) {
+					ThreadData &td = *static_cast<ThreadData *>(userdata);
+					Context &context = *td.context;
+
+					for (unsigned int i = 0; i < REQUESTS_PER_THREAD; ++i) {
+						Request request{ td.thread_index * REQUESTS_PER_THREAD + i, 0 };
+
+						context.combiner.process(request, [&context](Span<Request *> requests) {
+							const uint32_t running = ++context.running_batches;
+							uint32_t max_running = context.max_running_batches;
+							while (running > max_running &&
+								   !context.max_running_batches.compare_exchange_weak(max_running, running)) {
+							}
+							for (Request *r : requests) {
+								r->output = r->input * 2 + 1;
+							}
+							context.processed_count += requests.size();
+							++context.batch_count;
+							--context.running_batches;
+						});
+
+						if (request.output != request.input * 2 + 1) {
+							td.valid = false;
+						}
+					}
+				},
+				&td
+		);
+	}
+
+	for (unsigned int thread_index = 0; thread_index < THREAD_COUNT; ++thread_index) {
+		threads[thread_index].wait_to_finish();
+		ZN_TEST_ASSERT(threads_data[thread_index].valid);
+	}
+
+	ZN_TEST_ASSERT(context.processed_count == THREAD_COUNT * REQUESTS_PER_THREAD);
+	ZN_TEST_ASSERT(context.max_running_batches <= MAX_CONCURRENT_BATCHES);
+	ZN_TEST_ASSERT(context.batch_count <= context.processed_count);
+}
+
+} // namespace zylann::tests
@@ -0,0 +1,10 @@
+#ifndef ZN_TEST_REQUEST_COMBINER_H
+#define ZN_TEST_REQUEST_COMBINER_H
+
+namespace zylann::tests {
+
+void test_request_combiner();
+
+} // namespace zylann::tests
+
+#endif // ZN_TEST_REQUEST_COMBINER_H
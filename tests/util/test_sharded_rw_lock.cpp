@@ -0,0 +1,127 @@
+#include "test_sharded_rw_lock.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/thread/sharded_rw_lock.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+
+namespace zylann::tests {
+
+void test_sharded_rw_lock_misc() {
+	ShardedRWLock lock;
+
+	// Multiple readers are allowed, writers are not
+	lock.read_lock();
+	ZN_TEST_ASSERT(lock.write_try_lock() == false);
+
+	Thread thread;
+	thread.start(
+			[](void *userdata) {
+				ShardedRWLock &lock = *static_cast<ShardedRWLock *>(userdata);
+				ZN_TEST_ASSERT(lock.read_try_lock() == true);
+				lock.read_unlock();
+				ZN_TEST_ASSERT(lock.write_try_lock() == false);
+			},
+			&lock
+	);
+	thread.wait_to_finish();
+
+	lock.read_unlock();
+
+	// Readers are not allowed while a writer holds the lock
+	ZN_TEST_ASSERT(lock.write_try_lock() == true);
+	thread.start(
+			[](void *userdata) {
+				ShardedRWLock &lock = *static_cast<ShardedRWLock *>(userdata);
+				ZN_TEST_ASSERT(lock.read_try_lock() == false);
+				ZN_TEST_ASSERT(lock.write_try_lock() == false);
+			},
+			&lock
+	);
+	thread.wait_to_finish();
+	lock.write_unlock();
+
+	{
+		ShardedRWLockWrite wlock(lock);
+	}
+	{
+		ShardedRWLockRead rlock(lock);
+	}
+
+	const ShardedRWLock::Stats stats = lock.get_stats();
+	ZN_TEST_ASSERT(stats.read_locks == 3);
+	ZN_TEST_ASSERT(stats.write_locks == 2);
+}
+
+void test_sharded_rw_lock_spam() {
+	// Threads lock frequently, most of the time for reading. Readers check that a pair of values doesn't change while
+	// they hold the lock, and writers increment both.
+
+	static const unsigned int THREAD_COUNT = 8;
+	static const unsigned int ITERATIONS_PER_THREAD = 20000;
+	// One lock out of this amount is for writing
+	static const unsigned int WRITE_PERIOD = 50;
+
+	struct Context {
+		ShardedRWLock lock;
+		uint32_t a = 0;
+		uint32_t b = 0;
+	};
+
+	struct ThreadData {
+		Context *context = nullptr;
+		unsigned int thread_index = 0;
+		unsigned int writes = 0;
+		bool valid = true;
+	};
+
+	Context context;
+	FixedArray<ThreadData, THREAD_COUNT> threads_data;
+	FixedArray<Thread, THREAD_COUNT> threads;
+
+	for (unsigned int thread_index = 0; thread_index < THREAD_COUNT; ++thread_index) {
+		ThreadData &td = threads_data[thread_index];
+		td.context = &context;
+		td.thread_index = thread_index;
+
+		threads[thread_index].start(
+				[](void *userdata) {
+					ThreadData &td = *static_cast<ThreadData *>(userdata);
+					Context &context = *td.context;
+
+					for (unsigned int i = 0; i < ITERATIONS_PER_THREAD; ++i) {
+						if ((i + td.thread_index) % WRITE_PERIOD == 0) {
+							ShardedRWLockWrite wlock(context.lock);
+							++context.a;
+							++context.b;
+							++td.writes;
+						} else {
+							ShardedRWLockRead rlock(context.lock);
+							const uint32_t a = context.a;
+							const uint32_t b = context.b;
+							if (a != b) {
+								td.valid = false;
+							}
+						}
+					}
+				},
+				&td
+		);
+	}
+
+	unsigned int total_writes = 0;
+	for (unsigned int thread_index = 0; thread_index < THREAD_COUNT; ++thread_index) {
+		threads[thread_index].wait_to_finish();
+		const ThreadData &td = threads_data[thread_index];
+		ZN_TEST_ASSERT(td.valid);
+		total_writes += td.writes;
+	}
+
+	ZN_TEST_ASSERT(context.a == total_writes);
+	ZN_TEST_ASSERT(context.b == total_writes);
+
+	const ShardedRWLock::Stats stats = context.lock.get_stats();
+	ZN_TEST_ASSERT(stats.read_locks + stats.write_locks == THREAD_COUNT * ITERATIONS_PER_THREAD);
+	ZN_TEST_ASSERT(stats.write_locks == total_writes);
+}
+
+} // namespace zylann::tests
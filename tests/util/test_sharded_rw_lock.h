@@ -0,0 +1,11 @@
+#ifndef ZN_TEST_SHARDED_RW_LOCK_H
+#define ZN_TEST_SHARDED_RW_LOCK_H
+
+namespace zylann::tests {
+
+void test_sharded_rw_lock_misc();
+void test_sharded_rw_lock_spam();
+
+} // namespace zylann::tests
+
+#endif // ZN_TEST_SHARDED_RW_LOCK_H
@@ -67,6 +67,104 @@ void test_spatial_lock_misc() {
 	ZN_TEST_ASSERT(spatial_lock.get_locked_boxes_count() == 0);
 }
 
+namespace {
+
+void wait_for_waiters(const SpatialLock3D &spatial_lock, int count) {
+	while (spatial_lock.get_waiting_count() != count) {
+		Thread::sleep_usec(100);
+	}
+}
+
+} // namespace
+
+void test_spatial_lock_fairness() {
+	SpatialLock3D spatial_lock;
+
+	const BoxBounds3i box1 = BoxBounds3i::from_min_max_included(Vector3i(0, 0, 0), Vector3i(3, 3, 3));
+	spatial_lock.lock_read(box1);
+
+	// A writer waits for the main thread to unlock
+	Thread writer_thread;
+	writer_thread.start(
+			[](void *userdata) {
+				SpatialLock3D &spatial_lock = *static_cast<SpatialLock3D *>(userdata);
+				const BoxBounds3i box2 = BoxBounds3i::from_position(Vector3i(1, 1, 1));
+				spatial_lock.lock_write(box2);
+				spatial_lock.unlock_write(box2);
+			},
+			&spatial_lock
+	);
+
+	wait_for_waiters(spatial_lock, 1);
+
+	Thread reader_thread;
+	reader_thread.start(
+			[](void *userdata) {
+				SpatialLock3D &spatial_lock = *static_cast<SpatialLock3D *>(userdata);
+
+				// Reading is compatible with the main thread, but the writer was waiting first
+				const BoxBounds3i box3 = BoxBounds3i::from_min_max_included(Vector3i(0, 0, 0), Vector3i(2, 2, 2));
+				ZN_TEST_ASSERT(spatial_lock.try_lock_read(box3) == false);
+
+				// Boxes not overlapping the writer's box are not affected
+				const BoxBounds3i box4 = BoxBounds3i::from_position(Vector3i(3, 3, 3));
+				ZN_TEST_ASSERT(spatial_lock.try_lock_read(box4) == true);
+				spatial_lock.unlock_read(box4);
+			},
+			&spatial_lock
+	);
+	reader_thread.wait_to_finish();
+
+	// The writer gets its box when we unlock
+	spatial_lock.unlock_read(box1);
+	writer_thread.wait_to_finish();
+
+	ZN_TEST_ASSERT(spatial_lock.get_locked_boxes_count() == 0);
+	ZN_TEST_ASSERT(spatial_lock.get_waiting_count() == 0);
+
+	const SpatialLock3D::Stats stats = spatial_lock.get_stats();
+	ZN_TEST_ASSERT(stats.contended_locks == 1);
+	ZN_TEST_ASSERT(stats.wakeups == 1);
+	ZN_TEST_ASSERT(stats.write_locks == 1);
+	ZN_TEST_ASSERT(stats.read_locks == 2);
+}
+
+void test_spatial_lock_timeout() {
+	SpatialLock3D spatial_lock;
+
+	const BoxBounds3i box1 = BoxBounds3i::from_min_max_included(Vector3i(0, 0, 0), Vector3i(3, 3, 3));
+	spatial_lock.lock_write(box1);
+
+	Thread thread;
+	thread.start(
+			[](void *userdata) {
+				SpatialLock3D &spatial_lock = *static_cast<SpatialLock3D *>(userdata);
+				const BoxBounds3i box2 = BoxBounds3i::from_position(Vector3i(1, 1, 1));
+				ZN_TEST_ASSERT(spatial_lock.try_lock_read_for(box2, 1000) == false);
+				ZN_TEST_ASSERT(spatial_lock.get_waiting_count() == 0);
+
+				// Succeeds once the main thread unlocks
+				ZN_TEST_ASSERT(spatial_lock.try_lock_read_for(box2, 10'000'000) == true);
+				spatial_lock.unlock_read(box2);
+			},
+			&spatial_lock
+	);
+
+	// Wait until the thread timed out once and waits again
+	while (spatial_lock.get_stats().timeouts == 0) {
+		Thread::sleep_usec(100);
+	}
+	wait_for_waiters(spatial_lock, 1);
+
+	spatial_lock.unlock_write(box1);
+	thread.wait_to_finish();
+
+	ZN_TEST_ASSERT(spatial_lock.get_locked_boxes_count() == 0);
+	const SpatialLock3D::Stats stats = spatial_lock.get_stats();
+	ZN_TEST_ASSERT(stats.timeouts == 1);
+	ZN_TEST_ASSERT(stats.wakeups == 1);
+}
+
 void test_spatial_lock_spam() {
 	// Spawns many threads that will each lock random boxes in a limited area of a grid of numbers, very frequently.
 	// They either read data, in which case they check it doesn't change while they do so,
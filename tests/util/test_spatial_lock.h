@@ -4,6 +4,8 @@
 namespace zylann::tests {
 
 void test_spatial_lock_misc();
+void test_spatial_lock_fairness();
+void test_spatial_lock_timeout();
 void test_spatial_lock_spam();
 void test_spatial_lock_dependent_map_chunks();
 
@@ -9,7 +9,9 @@
 #include "../../util/profiling.h"
 #include "../../util/string/format.h"
 #include "../../util/string/std_stringstream.h"
+#include "../../util/tasks/parallel_jobs.h"
 #include "../../util/tasks/threaded_task_runner.h"
+#include "../benchmarking.h"
 #include "../testing.h"
 
 // #define VOXEL_TEST_TASK_POSTPONING_DUMP_EVENTS
@@ -143,6 +145,191 @@ void test_threaded_task_runner_misc() {
 	ZN_TEST_ASSERT(serial_counter->current_count == 0);
 }
 
+namespace {
+
+// Tiny tasks with random priorities, one in a few of them being serial, so that time is mostly spent scheduling them
+// rather than running them
+class MixedTask : public IThreadedTask {
+public:
+	std::atomic_uint32_t &run_count;
+	uint8_t priority_band;
+	bool completed = false;
+
+	MixedTask(std::atomic_uint32_t &p_run_count, uint8_t p_priority_band) :
+			run_count(p_run_count), priority_band(p_priority_band) {}
+
+	void run(ThreadedTaskContext &ctx) override {
+		++run_count;
+		completed = true;
+	}
+
+	void apply_result() override {
+		ZN_TEST_ASSERT(completed);
+	}
+
+	TaskPriority get_priority() override {
+		TaskPriority p;
+		p.band2 = priority_band;
+		return p;
+	}
+};
+
+void run_mixed_tasks(ThreadedTaskRunner &runner, unsigned int task_count, RandomPCG &rng) {
+	// One in this many tasks is serial
+	static const unsigned int serial_task_interval = 16;
+
+	std::atomic_uint32_t run_count = { 0 };
+
+	for (unsigned int i = 0; i < task_count; ++i) {
+		MixedTask *task = ZN_NEW(MixedTask(run_count, rng.rand(4)));
+		runner.enqueue(task, (i % serial_task_interval) == 0);
+	}
+
+	runner.wait_for_all_tasks();
+
+	unsigned int completed_count = 0;
+	runner.dequeue_completed_tasks([&completed_count](IThreadedTask *task) {
+		ZN_ASSERT(task != nullptr);
+		task->apply_result();
+		ZN_DELETE(task);
+		++completed_count;
+	});
+
+	ZN_TEST_ASSERT(run_count == task_count);
+	ZN_TEST_ASSERT(completed_count == task_count);
+}
+
+} // namespace
+
+void test_threaded_task_runner_mixed_tasks() {
+	const unsigned int thread_counts[] = { 1, 4, 8 };
+
+	for (const unsigned int thread_count : thread_counts) {
+		ThreadedTaskRunner runner;
+		runner.set_thread_count(thread_count);
+		runner.set_name("Test");
+
+		RandomPCG rng;
+		run_mixed_tasks(runner, 2'000, rng);
+	}
+}
+
+void test_threaded_task_runner_throughput(testing::BenchmarkSuite &suite) {
+	const unsigned int thread_counts[] = { 1, 4, 8 };
+
+	for (const unsigned int thread_count : thread_counts) {
+		ThreadedTaskRunner runner;
+		runner.set_thread_count(thread_count);
+		runner.set_name("Test");
+
+		RandomPCG rng;
+		suite.run(
+				format("threaded_task_runner_20000_mixed_tasks_{}_threads", thread_count).c_str(),
+				1,
+				[&runner, &rng]() { run_mixed_tasks(runner, 20'000, rng); }
+		);
+	}
+}
+
+void test_threaded_task_runner_perf(testing::BenchmarkSuite &suite) {
+	// Time to schedule, run and collect a batch of tiny tasks, which is mostly spent in the runner itself
+	static const unsigned int task_count = 1'000;
+
+	class TinyTask : public IThreadedTask {
+	public:
+		void run(ThreadedTaskContext &ctx) override {}
+	};
+
+	ThreadedTaskRunner runner;
+	runner.set_thread_count(4);
+	runner.set_name("Test");
+
+	suite.run("threaded_task_runner_1000_tasks", 1, [&runner]() {
+		for (unsigned int i = 0; i < task_count; ++i) {
+			runner.enqueue(ZN_NEW(TinyTask), false);
+		}
+		runner.wait_for_all_tasks();
+		runner.dequeue_completed_tasks([](IThreadedTask *task) {
+			task->apply_result();
+			ZN_DELETE(task);
+		});
+	});
+}
+
+void test_threaded_task_runner_category_quotas() {
+	static const uint32_t task_duration_usec = 20'000;
+
+	struct CategoryCounter {
+		std::atomic_uint32_t max_count = { 0 };
+		std::atomic_uint32_t current_count = { 0 };
+		std::atomic_uint32_t completed_count = { 0 };
+	};
+
+	class CategoryTask : public IThreadedTask {
+	public:
+		CategoryCounter &counter;
+		uint8_t category;
+
+		CategoryTask(CategoryCounter &p_counter, uint8_t p_category) : counter(p_counter), category(p_category) {}
+
+		void run(ThreadedTaskContext &ctx) override {
+			const uint32_t current_count = ++counter.current_count;
+			uint32_t prev_max = counter.max_count;
+			while (prev_max < current_count && !counter.max_count.compare_exchange_weak(prev_max, current_count)) {
+			}
+			Thread::sleep_usec(task_duration_usec);
+			--counter.current_count;
+			++counter.completed_count;
+		}
+
+		uint8_t get_category() const override {
+			return category;
+		}
+	};
+
+	const unsigned int test_thread_count = 4;
+	const uint8_t limited_category = 1;
+	const uint8_t reserving_category = 2;
+
+	ThreadedTaskRunner runner;
+	runner.set_thread_count(test_thread_count);
+	runner.set_name("Test");
+	runner.set_category_quota(limited_category, 0, 1);
+	runner.set_category_quota(reserving_category, 1, ThreadedTaskRunner::NO_THREAD_LIMIT);
+
+	CategoryCounter default_counter;
+	CategoryCounter limited_counter;
+	CategoryCounter reserving_counter;
+
+	const unsigned int task_count = 32;
+	for (unsigned int i = 0; i < task_count; ++i) {
+		runner.enqueue(ZN_NEW(CategoryTask(default_counter, 0)), false);
+		runner.enqueue(ZN_NEW(CategoryTask(limited_counter, limited_category)), false);
+	}
+
+	runner.wait_for_all_tasks();
+
+	unsigned int completed_count = 0;
+	runner.dequeue_completed_tasks([&completed_count](IThreadedTask *task) {
+		ZN_DELETE(task);
+		++completed_count;
+	});
+
+	ZN_TEST_ASSERT(completed_count == task_count * 2);
+	ZN_TEST_ASSERT(default_counter.completed_count == task_count);
+	ZN_TEST_ASSERT(limited_counter.completed_count == task_count);
+	ZN_TEST_ASSERT(limited_counter.max_count == 1);
+	// One thread is reserved for a category that had no tasks, so the others could use at most 3
+	ZN_TEST_ASSERT(default_counter.max_count + limited_counter.max_count <= test_thread_count);
+	ZN_TEST_ASSERT(default_counter.max_count <= test_thread_count - 1);
+
+	for (uint8_t category = 0; category < ThreadedTaskRunner::MAX_CATEGORIES; ++category) {
+		const ThreadedTaskRunner::CategoryStats stats = runner.get_category_stats(category);
+		ZN_TEST_ASSERT(stats.pending_tasks == 0);
+		ZN_TEST_ASSERT(stats.running_tasks == 0);
+	}
+}
+
 void test_threaded_task_runner_debug_names() {
 	class NamedTestTask1 : public IThreadedTask {
 	public:
@@ -224,8 +411,8 @@ void test_threaded_task_runner_debug_names() {
 		}
 
 		// Get debug task names
-		FixedArray<const char *, ThreadedTaskRunner::MAX_THREADS> active_task_names;
-		fill(active_task_names, (const char *)nullptr);
+		StdVector<const char *> active_task_names;
+		active_task_names.resize(test_thread_count, nullptr);
 		for (unsigned int i = 0; i < test_thread_count; ++i) {
 			active_task_names[i] = runner.get_thread_debug_task_name(i);
 		}
@@ -460,4 +647,80 @@ void test_threaded_task_postponing() {
 #endif
 }
 
+void test_parallel_jobs() {
+	struct L {
+		static ThreadedTaskRunner *&get_runner() {
+			static ThreadedTaskRunner *s_runner = nullptr;
+			return s_runner;
+		}
+		static void schedule_tasks(Span<IThreadedTask *> tasks) {
+			get_runner()->enqueue(tasks, false);
+		}
+		static void dequeue_tasks(ThreadedTaskRunner &runner) {
+			runner.dequeue_completed_tasks([](IThreadedTask *task) {
+				ZN_ASSERT(task != nullptr);
+				task->apply_result();
+				ZN_DELETE(task);
+			});
+		}
+	};
+
+	const unsigned int job_count = 1000;
+
+	struct Results {
+		FixedArray<std::atomic_uint32_t, job_count> run_counts;
+
+		void reset() {
+			for (std::atomic_uint32_t &c : run_counts) {
+				c = 0;
+			}
+		}
+
+		bool check() const {
+			for (const std::atomic_uint32_t &c : run_counts) {
+				if (c != 1) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	std::unique_ptr<Results> results = make_unique_instance<Results>();
+
+	// Without scheduler, jobs run on the calling thread
+	{
+		results->reset();
+		run_parallel_jobs(job_count, ParallelJobsScheduler(), [&results](uint32_t job_index) {
+			++results->run_counts[job_index];
+		});
+		ZN_TEST_ASSERT(results->check());
+	}
+
+	ThreadedTaskRunner runner;
+	runner.set_thread_count(4);
+	runner.set_name("Test");
+	L::get_runner() = &runner;
+
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = L::schedule_tasks;
+	scheduler.max_helpers = 3;
+
+	// Every job must run exactly once, and all of them must be done when the function returns
+	for (unsigned int iteration = 0; iteration < 10; ++iteration) {
+		results->reset();
+		std::atomic_uint32_t completed_count = { 0 };
+		run_parallel_jobs(job_count, scheduler, [&results, &completed_count](uint32_t job_index) {
+			++results->run_counts[job_index];
+			++completed_count;
+		});
+		ZN_TEST_ASSERT(completed_count == job_count);
+		ZN_TEST_ASSERT(results->check());
+	}
+
+	runner.wait_for_all_tasks();
+	L::dequeue_tasks(runner);
+	L::get_runner() = nullptr;
+}
+
 } // namespace zylann::tests
@@ -1,12 +1,21 @@
 #ifndef ZN_TEST_THREADED_TASK_RUNNER_H
 #define ZN_TEST_THREADED_TASK_RUNNER_H
 
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
 namespace zylann::tests {
 
 void test_threaded_task_runner_misc();
+void test_threaded_task_runner_mixed_tasks();
+void test_threaded_task_runner_throughput(testing::BenchmarkSuite &suite);
+void test_threaded_task_runner_perf(testing::BenchmarkSuite &suite);
+void test_threaded_task_runner_category_quotas();
 void test_threaded_task_runner_debug_names();
 void test_task_priority_values();
 void test_threaded_task_postponing();
+void test_parallel_jobs();
 
 } // namespace zylann::tests
 
@@ -0,0 +1,198 @@
+#include "test_vector3i_hash_map.h"
+#include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/containers/vector3i_hash_map.h"
+#include "../../util/string/format.h"
+#include "../benchmarking.h"
+#include "../testing.h"
+#include <cmath>
+#include <random>
+
+namespace zylann::tests {
+
+void test_vector3i_hash_map() {
+	// Basic operations
+	{
+		Vector3iHashMap<int> map;
+		ZN_TEST_ASSERT(map.is_empty());
+		ZN_TEST_ASSERT(map.find(Vector3i(1, 2, 3)) == nullptr);
+
+		map[Vector3i(1, 2, 3)] = 10;
+		map[Vector3i(-1, -2, -3)] = 20;
+		ZN_TEST_ASSERT(map.size() == 2);
+
+		int *v = map.find(Vector3i(1, 2, 3));
+		ZN_TEST_ASSERT(v != nullptr && *v == 10);
+		ZN_TEST_ASSERT(map.has(Vector3i(-1, -2, -3)));
+
+		ZN_TEST_ASSERT(map.erase(Vector3i(1, 2, 3)));
+		ZN_TEST_ASSERT(!map.erase(Vector3i(1, 2, 3)));
+		ZN_TEST_ASSERT(map.size() == 1);
+		ZN_TEST_ASSERT(!map.has(Vector3i(1, 2, 3)));
+
+		map.clear();
+		ZN_TEST_ASSERT(map.is_empty());
+		ZN_TEST_ASSERT(!map.has(Vector3i(-1, -2, -3)));
+	}
+	// Random operations compared against a reference map
+	{
+		Vector3iHashMap<int> map;
+		StdUnorderedMap<Vector3i, int> expected;
+		std::mt19937 rng(1234);
+		std::uniform_int_distribution<int> coord(-40, 40);
+
+		// Remember one element to check it does not move in memory
+		const Vector3i stable_key(1000, 1000, 1000);
+		map[stable_key] = -1;
+		const int *stable_ptr = map.find(stable_key);
+
+		for (unsigned int i = 0; i < 100000; ++i) {
+			const Vector3i key(coord(rng), coord(rng), coord(rng));
+			if (rng() % 3 == 0) {
+				ZN_TEST_ASSERT(map.erase(key) == (expected.erase(key) != 0));
+			} else {
+				const int value = rng();
+				map[key] = value;
+				expected[key] = value;
+			}
+		}
+
+		ZN_TEST_ASSERT(map.find(stable_key) == stable_ptr);
+		map.erase(stable_key);
+
+		ZN_TEST_ASSERT(map.size() == expected.size());
+		for (auto it = expected.begin(); it != expected.end(); ++it) {
+			const int *v = map.find(it->first);
+			ZN_TEST_ASSERT(v != nullptr);
+			ZN_TEST_ASSERT(*v == it->second);
+		}
+
+		unsigned int visited_count = 0;
+		map.for_each([&expected, &visited_count](const Vector3i key, const int value) {
+			auto it = expected.find(key);
+			ZN_TEST_ASSERT(it != expected.end());
+			ZN_TEST_ASSERT(it->second == value);
+			++visited_count;
+		});
+		ZN_TEST_ASSERT(visited_count == expected.size());
+	}
+}
+
+namespace {
+
+// Number of keys landing in a bucket already used by another key, in a table of power-of-two size indexed with lower
+// bits of the hash
+template <typename F>
+unsigned int count_bucket_collisions(Span<const Vector3i> keys, unsigned int bucket_count, F hash_func) {
+	StdVector<uint8_t> used_buckets;
+	used_buckets.resize(bucket_count, 0);
+	unsigned int collisions = 0;
+	for (const Vector3i key : keys) {
+		const unsigned int bucket_index = hash_func(key) & (bucket_count - 1);
+		if (used_buckets[bucket_index] != 0) {
+			++collisions;
+		}
+		used_buckets[bucket_index] = 1;
+	}
+	return collisions;
+}
+
+struct Djb2Vector3iHasher {
+	size_t operator()(const Vector3i &v) const {
+		return Vector3iHasher::hash(v);
+	}
+};
+
+template <typename THasher>
+void fill_lookup_map(StdUnorderedMap<Vector3i, int, THasher> &map, Span<const Vector3i> keys) {
+	for (unsigned int i = 0; i < keys.size(); ++i) {
+		map[keys[i]] = i;
+	}
+}
+
+template <typename THasher>
+int lookup_all(const StdUnorderedMap<Vector3i, int, THasher> &map, Span<const Vector3i> keys) {
+	int checksum = 0;
+	for (const Vector3i key : keys) {
+		auto it = map.find(key);
+		if (it != map.end()) {
+			checksum += it->second;
+		}
+	}
+	return checksum;
+}
+
+struct HashQualityKeySet {
+	const char *name;
+	Box3i box;
+};
+
+// Block positions like those found in terrains
+const HashQualityKeySet g_hash_quality_key_sets[] = {
+	{ "cube_around_origin", Box3i::from_min_max(Vector3i(-16, -16, -16), Vector3i(16, 16, 16)) },
+	{ "flat_area", Box3i::from_min_max(Vector3i(-64, -2, -64), Vector3i(64, 2, 64)) },
+	{ "far_from_origin", Box3i::from_min_max(Vector3i(1000, -4, -2000), Vector3i(1032, 4, -1968)) },
+	{ "small_cube", Box3i::from_min_max(Vector3i(-4, -4, -4), Vector3i(4, 4, 4)) },
+};
+
+} // namespace
+
+void test_vector3i_hash_quality() {
+	for (const HashQualityKeySet &key_set : g_hash_quality_key_sets) {
+		StdVector<Vector3i> keys;
+		key_set.box.for_each_cell_zxy([&keys](Vector3i pos) { keys.push_back(pos); });
+
+		unsigned int bucket_count = 1;
+		while (bucket_count < 2 * keys.size()) {
+			bucket_count <<= 1;
+		}
+
+		const unsigned int collisions = count_bucket_collisions(
+				to_span(keys), //
+				bucket_count, //
+				[](Vector3i key) { return std::hash<Vector3i>()(key); }
+		);
+
+		// Collisions we would get on average if hashes were random
+		const double n = keys.size();
+		const double m = bucket_count;
+		const double expected_collisions = n - m * (1.0 - std::exp(-n / m));
+
+		ZN_TEST_ASSERT(collisions < 1.25 * expected_collisions);
+
+		StdUnorderedMap<Vector3i, int, std::hash<Vector3i>> map;
+		fill_lookup_map(map, to_span(keys));
+		StdUnorderedMap<Vector3i, int, Djb2Vector3iHasher> djb2_map;
+		fill_lookup_map(djb2_map, to_span(keys));
+		ZN_TEST_ASSERT(lookup_all(map, to_span(keys)) == lookup_all(djb2_map, to_span(keys)));
+	}
+}
+
+// Compares lookups using the default Vector3i hash with the previous djb2-based one
+void test_vector3i_hash_lookup_benchmark(testing::BenchmarkSuite &suite) {
+	for (const HashQualityKeySet &key_set : g_hash_quality_key_sets) {
+		StdVector<Vector3i> keys;
+		key_set.box.for_each_cell_zxy([&keys](Vector3i pos) { keys.push_back(pos); });
+
+		StdUnorderedMap<Vector3i, int, std::hash<Vector3i>> map;
+		fill_lookup_map(map, to_span(keys));
+		StdUnorderedMap<Vector3i, int, Djb2Vector3iHasher> djb2_map;
+		fill_lookup_map(djb2_map, to_span(keys));
+
+		int checksum = 0;
+		int djb2_checksum = 0;
+
+		suite.run(format("vector3i_hash_lookup_{}", key_set.name).c_str(), 1, [&map, &keys, &checksum]() {
+			checksum = lookup_all(map, to_span(keys));
+		});
+		suite.run(
+				format("vector3i_hash_lookup_{}_djb2", key_set.name).c_str(),
+				1,
+				[&djb2_map, &keys, &djb2_checksum]() { djb2_checksum = lookup_all(djb2_map, to_span(keys)); }
+		);
+
+		ZN_TEST_ASSERT(checksum == djb2_checksum);
+	}
+}
+
+} // namespace zylann::tests
@@ -0,0 +1,16 @@
+#ifndef ZN_TEST_VECTOR3I_HASH_MAP_H
+#define ZN_TEST_VECTOR3I_HASH_MAP_H
+
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
+namespace zylann::tests {
+
+void test_vector3i_hash_map();
+void test_vector3i_hash_quality();
+void test_vector3i_hash_lookup_benchmark(testing::BenchmarkSuite &suite);
+
+} // namespace zylann::tests
+
+#endif // ZN_TEST_VECTOR3I_HASH_MAP_H
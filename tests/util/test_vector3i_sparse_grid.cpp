@@ -0,0 +1,217 @@
+#include "test_vector3i_sparse_grid.h"
+#include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/vector3i_hash_map.h"
+#include "../../util/containers/vector3i_sparse_grid.h"
+#include "../../util/io/log.h"
+#include "../../util/string/format.h"
+#include "../benchmarking.h"
+#include "../testing.h"
+#include <atomic>
+#include <random>
+
+namespace zylann::tests {
+
+void test_vector3i_sparse_grid() {
+	// Basic operations
+	{
+		Vector3iSparseGrid<int> grid;
+		ZN_TEST_ASSERT(grid.empty());
+		ZN_TEST_ASSERT(grid.find(Vector3i(1, 2, 3)) == grid.end());
+		ZN_TEST_ASSERT(grid.begin() == grid.end());
+
+		grid[Vector3i(1, 2, 3)] = 10;
+		grid[Vector3i(-1, -2, -3)] = 20;
+		ZN_TEST_ASSERT(grid.size() == 2);
+
+		auto it = grid.find(Vector3i(1, 2, 3));
+		ZN_TEST_ASSERT(it != grid.end());
+		ZN_TEST_ASSERT(it->first == Vector3i(1, 2, 3));
+		ZN_TEST_ASSERT(it->second == 10);
+		ZN_TEST_ASSERT(grid.has(Vector3i(-1, -2, -3)));
+
+		ZN_TEST_ASSERT(grid.erase(Vector3i(1, 2, 3)) == 1);
+		ZN_TEST_ASSERT(grid.erase(Vector3i(1, 2, 3)) == 0);
+		ZN_TEST_ASSERT(grid.size() == 1);
+		ZN_TEST_ASSERT(!grid.has(Vector3i(1, 2, 3)));
+
+		grid.erase(grid.find(Vector3i(-1, -2, -3)));
+		ZN_TEST_ASSERT(grid.empty());
+		ZN_TEST_ASSERT(grid.begin() == grid.end());
+	}
+	// Values that can't be moved are constructed in place and keep their address
+	{
+		Vector3iSparseGrid<std::atomic_int> grid;
+		std::atomic_int &value = grid[Vector3i(-5, 0, 5)];
+		value = 42;
+		for (int i = 0; i < 1000; ++i) {
+			grid[Vector3i(i, i, i)];
+		}
+		ZN_TEST_ASSERT(&grid.find(Vector3i(-5, 0, 5))->second == &value);
+		ZN_TEST_ASSERT(value == 42);
+	}
+	// Random operations compared against a reference map
+	{
+		Vector3iSparseGrid<int> grid;
+		StdUnorderedMap<Vector3i, int> expected;
+		std::mt19937 rng(1234);
+		std::uniform_int_distribution<int> coord(-40, 40);
+
+		for (unsigned int i = 0; i < 100000; ++i) {
+			const Vector3i key(coord(rng), coord(rng), coord(rng));
+			if (rng() % 3 == 0) {
+				ZN_TEST_ASSERT(grid.erase(key) == expected.erase(key));
+			} else {
+				const int value = rng();
+				grid[key] = value;
+				expected[key] = value;
+			}
+		}
+
+		ZN_TEST_ASSERT(grid.size() == expected.size());
+		for (auto it = expected.begin(); it != expected.end(); ++it) {
+			auto grid_it = grid.find(it->first);
+			ZN_TEST_ASSERT(grid_it != grid.end());
+			ZN_TEST_ASSERT(grid_it->second == it->second);
+		}
+
+		unsigned int visited_count = 0;
+		const Vector3iSparseGrid<int> &const_grid = grid;
+		for (auto it = const_grid.begin(); it != const_grid.end(); ++it) {
+			auto expected_it = expected.find(it->first);
+			ZN_TEST_ASSERT(expected_it != expected.end());
+			ZN_TEST_ASSERT(expected_it->second == it->second);
+			++visited_count;
+		}
+		ZN_TEST_ASSERT(visited_count == expected.size());
+
+		const Box3i box(Vector3i(-13, -7, 2), Vector3i(21, 9, 30));
+		unsigned int in_box_count = 0;
+		grid.for_each_in_box(box, [&box, &expected, &in_box_count](Vector3iSparseGrid<int>::Item &item) {
+			ZN_TEST_ASSERT(box.contains(item.first));
+			ZN_TEST_ASSERT(expected.find(item.first) != expected.end());
+			++in_box_count;
+		});
+		unsigned int expected_in_box_count = 0;
+		for (auto it = expected.begin(); it != expected.end(); ++it) {
+			if (box.contains(it->first)) {
+				++expected_in_box_count;
+			}
+		}
+		ZN_TEST_ASSERT(in_box_count == expected_in_box_count);
+
+		grid.clear();
+		ZN_TEST_ASSERT(grid.empty());
+		ZN_TEST_ASSERT(grid.begin() == grid.end());
+	}
+}
+
+namespace {
+
+// Runs access patterns of mesh block maps: looking up every block of a padded area in order, and visiting blocks
+// found in smaller areas, like edits or collision queries do. Returns a checksum of what was found.
+template <typename TMap, typename FFind, typename FForEachInBox>
+unsigned int run_grid_benchmark(
+		testing::BenchmarkSuite &suite,
+		const char *map_name,
+		TMap &map,
+		const Box3i box,
+		FFind find_func,
+		FForEachInBox for_each_in_box_func
+) {
+	unsigned int found_count = 0;
+	suite.run(format("sparse_grid_{}_lookup", map_name).c_str(), 1, [&map, box, &found_count, &find_func]() {
+		found_count = 0;
+		box.padded(1).for_each_cell_zxy([&map, &found_count, &find_func](const Vector3i bpos) {
+			if (find_func(map, bpos)) {
+				++found_count;
+			}
+		});
+	});
+
+	unsigned int area_count = 0;
+	suite.run(
+			format("sparse_grid_{}_area_iteration", map_name).c_str(),
+			1,
+			[&map, box, &area_count, &for_each_in_box_func]() {
+				area_count = 0;
+				std::mt19937 rng(1234);
+				std::uniform_int_distribution<int> x_dist(box.position.x, box.position.x + box.size.x - 1);
+				std::uniform_int_distribution<int> y_dist(box.position.y, box.position.y + box.size.y - 1);
+				std::uniform_int_distribution<int> z_dist(box.position.z, box.position.z + box.size.z - 1);
+				for (unsigned int i = 0; i < 20000; ++i) {
+					const Box3i area(Vector3i(x_dist(rng), y_dist(rng), z_dist(rng)), Vector3i(3, 3, 3));
+					for_each_in_box_func(map, area, [&area_count](int value) { area_count += value; });
+				}
+			}
+	);
+
+	return found_count + area_count;
+}
+
+} // namespace
+
+void test_vector3i_sparse_grid_benchmark(testing::BenchmarkSuite &suite) {
+	// 131072 blocks, with gaps so pages are not all full
+	const Box3i box(Vector3i(-32, -16, -32), Vector3i(64, 32, 64));
+
+	StdUnorderedMap<Vector3i, int> std_map;
+	Vector3iHashMap<int> hash_map;
+	Vector3iSparseGrid<int> grid;
+	box.for_each_cell_zxy([&std_map, &hash_map, &grid](const Vector3i bpos) {
+		if ((bpos.x + bpos.y + bpos.z) % 5 == 0) {
+			return;
+		}
+		std_map[bpos] = 1;
+		hash_map[bpos] = 1;
+		grid[bpos] = 1;
+	});
+
+	const unsigned int std_checksum = run_grid_benchmark(
+			suite,
+			"std_unordered_map",
+			std_map,
+			box,
+			[](const StdUnorderedMap<Vector3i, int> &map, Vector3i bpos) { return map.find(bpos) != map.end(); },
+			[](const StdUnorderedMap<Vector3i, int> &map, Box3i area, auto f) {
+				area.for_each_cell_zxy([&map, &f](Vector3i bpos) {
+					auto it = map.find(bpos);
+					if (it != map.end()) {
+						f(it->second);
+					}
+				});
+			}
+	);
+
+	const unsigned int hash_checksum = run_grid_benchmark(
+			suite,
+			"vector3i_hash_map",
+			hash_map,
+			box,
+			[](const Vector3iHashMap<int> &map, Vector3i bpos) { return map.has(bpos); },
+			[](const Vector3iHashMap<int> &map, Box3i area, auto f) {
+				area.for_each_cell_zxy([&map, &f](Vector3i bpos) {
+					const int *v = map.find(bpos);
+					if (v != nullptr) {
+						f(*v);
+					}
+				});
+			}
+	);
+
+	const unsigned int grid_checksum = run_grid_benchmark(
+			suite,
+			"vector3i_sparse_grid",
+			grid,
+			box,
+			[](const Vector3iSparseGrid<int> &map, Vector3i bpos) { return map.has(bpos); },
+			[](Vector3iSparseGrid<int> &map, Box3i area, auto f) {
+				map.for_each_in_box(area, [&f](Vector3iSparseGrid<int>::Item &item) { f(item.second); });
+			}
+	);
+
+	// All must have seen the same blocks
+	ZN_TEST_ASSERT(std_checksum == grid_checksum);
+	ZN_TEST_ASSERT(hash_checksum == grid_checksum);
+}
+
+} // namespace zylann::tests
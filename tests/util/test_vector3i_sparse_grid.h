@@ -0,0 +1,15 @@
+#ifndef ZN_TEST_VECTOR3I_SPARSE_GRID_H
+#define ZN_TEST_VECTOR3I_SPARSE_GRID_H
+
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
+namespace zylann::tests {
+
+void test_vector3i_sparse_grid();
+void test_vector3i_sparse_grid_benchmark(testing::BenchmarkSuite &suite);
+
+} // namespace zylann::tests
+
+#endif // ZN_TEST_VECTOR3I_SPARSE_GRID_H
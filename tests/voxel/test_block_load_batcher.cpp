@@ -0,0 +1,92 @@
+#include "test_block_load_batcher.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../streams/block_load_batcher.h"
+#include "../../streams/voxel_stream_memory.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+void test_block_load_batcher() {
+	const int block_size = 16;
+
+	Ref<VoxelStreamMemory> stream;
+	stream.instantiate();
+
+	// Save a row of blocks, each filled with a different value
+	const unsigned int saved_block_count = 8;
+	for (unsigned int i = 0; i < saved_block_count; ++i) {
+		VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+		voxels.create(Vector3iUtil::create(block_size));
+		voxels.fill(i + 1, 0);
+		VoxelStream::VoxelQueryData q{ voxels, Vector3i(i, 0, 0), 0, VoxelStream::RESULT_ERROR };
+		stream->save_voxel_block(q);
+	}
+
+	BlockLoadBatcher batcher;
+
+	StdVector<uint32_t> request_ids;
+	for (unsigned int i = 0; i < saved_block_count; ++i) {
+		request_ids.push_back(batcher.add_request(Vector3i(i, 0, 0), 0, block_size));
+	}
+	const uint32_t missing_request_id = batcher.add_request(Vector3i(saved_block_count, 0, 0), 0, block_size);
+	const uint32_t other_lod_request_id = batcher.add_request(Vector3i(1, 0, 0), 1, block_size);
+
+	// Loading the first block also loads the others
+	{
+		VoxelStream::ResultCode result = VoxelStream::RESULT_ERROR;
+		std::shared_ptr<VoxelBuffer> voxels = batcher.load(**stream, request_ids[0], result);
+		ZN_TEST_ASSERT(voxels != nullptr);
+		ZN_TEST_ASSERT(result == VoxelStream::RESULT_BLOCK_FOUND);
+		ZN_TEST_ASSERT(voxels->get_voxel(Vector3i(1, 2, 3), 0) == 1);
+		batcher.remove_request(request_ids[0]);
+	}
+
+	// Removing a request also drops its result
+	batcher.remove_request(request_ids[1]);
+
+	// Now remove blocks from the stream. Results must come from the batch, unless they were not part of it.
+	{
+		VoxelBuffer empty(VoxelBuffer::ALLOCATOR_DEFAULT);
+		empty.create(Vector3iUtil::create(block_size));
+		for (unsigned int i = 0; i < saved_block_count; ++i) {
+			VoxelStream::VoxelQueryData q{ empty, Vector3i(i, 0, 0), 0, VoxelStream::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		}
+	}
+
+	for (unsigned int i = 2; i < saved_block_count; ++i) {
+		VoxelStream::ResultCode result = VoxelStream::RESULT_ERROR;
+		std::shared_ptr<VoxelBuffer> voxels = batcher.load(**stream, request_ids[i], result);
+		ZN_TEST_ASSERT(voxels != nullptr);
+		ZN_TEST_ASSERT(result == VoxelStream::RESULT_BLOCK_FOUND);
+		ZN_TEST_ASSERT(voxels->get_voxel(Vector3i(1, 2, 3), 0) == i + 1);
+		batcher.remove_request(request_ids[i]);
+	}
+
+	{
+		VoxelStream::ResultCode result = VoxelStream::RESULT_ERROR;
+		std::shared_ptr<VoxelBuffer> voxels = batcher.load(**stream, missing_request_id, result);
+		ZN_TEST_ASSERT(voxels != nullptr);
+		ZN_TEST_ASSERT(result == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		batcher.remove_request(missing_request_id);
+	}
+
+	// Blocks of other LODs are not batched together
+	{
+		VoxelStream::ResultCode result = VoxelStream::RESULT_ERROR;
+		std::shared_ptr<VoxelBuffer> voxels = batcher.load(**stream, other_lod_request_id, result);
+		ZN_TEST_ASSERT(voxels != nullptr);
+		ZN_TEST_ASSERT(result == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		batcher.remove_request(other_lod_request_id);
+	}
+
+	// Removed requests can't be loaded
+	{
+		VoxelStream::ResultCode result = VoxelStream::RESULT_BLOCK_FOUND;
+		std::shared_ptr<VoxelBuffer> voxels = batcher.load(**stream, request_ids[1], result);
+		ZN_TEST_ASSERT(voxels == nullptr);
+		ZN_TEST_ASSERT(result == VoxelStream::RESULT_ERROR);
+	}
+}
+
+} // namespace zylann::voxel::tests
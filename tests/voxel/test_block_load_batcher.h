@@ -0,0 +1,10 @@
+#ifndef VOXEL_TESTS_BLOCK_LOAD_BATCHER_H
+#define VOXEL_TESTS_BLOCK_LOAD_BATCHER_H
+
+namespace zylann::voxel::tests {
+
+void test_block_load_batcher();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TESTS_BLOCK_LOAD_BATCHER_H
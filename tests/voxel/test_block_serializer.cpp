@@ -1,10 +1,17 @@
 #include "test_block_serializer.h"
+#include "../../storage/metadata/voxel_metadata_variant.h"
 #include "../../storage/voxel_buffer_gd.h"
 #include "../../streams/voxel_block_serializer.h"
 #include "../../streams/voxel_block_serializer_gd.h"
 #include "../../util/godot/classes/stream_peer_buffer.h"
+#include "../../util/io/serialization.h"
+#include "../../util/math/funcs.h"
+#include "../../util/string/format.h"
+#include "../benchmarking.h"
 #include "../testing.h"
 
+#include <cmath>
+
 namespace zylann::voxel::tests {
 
 void test_block_serializer() {
@@ -81,4 +88,530 @@ void test_block_serializer_stream_peer() {
 	ZN_TEST_ASSERT(voxel_buffer2->get_buffer().equals(voxel_buffer->get_buffer()));
 }
 
+namespace {
+
+// Blocks of a simple terrain, which are very similar to each other like in a real save
+void create_terrain_blocks(StdVector<VoxelBuffer> &blocks, unsigned int count) {
+	const Vector3i block_size = Vector3iUtil::create(16);
+	for (unsigned int block_index = 0; block_index < count; ++block_index) {
+		blocks.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_DEFAULT));
+		VoxelBuffer &vb = blocks.back();
+		vb.create(block_size);
+		vb.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+		vb.set_channel_depth(VoxelBuffer::CHANNEL_TYPE, VoxelBuffer::DEPTH_16_BIT);
+
+		const Vector3i origin = Vector3i(block_index % 8, 0, block_index / 8) * block_size;
+		Vector3i pos;
+		for (pos.z = 0; pos.z < block_size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < block_size.x; ++pos.x) {
+				const float gx = origin.x + pos.x;
+				const float gz = origin.z + pos.z;
+				const float height = 8.f + 4.f * std::sin(gx * 0.1f) * std::cos(gz * 0.13f);
+				for (pos.y = 0; pos.y < block_size.y; ++pos.y) {
+					const float sd = (origin.y + pos.y) - height;
+					vb.set_voxel_f(math::clamp(sd * 0.1f, -1.f, 1.f), pos, VoxelBuffer::CHANNEL_SDF);
+					vb.set_voxel(sd < -2.f ? 2 : 1, pos, VoxelBuffer::CHANNEL_TYPE);
+				}
+			}
+		}
+		vb.compress_uniform_channels();
+	}
+}
+
+} // namespace
+
+void test_block_serializer_zstd() {
+	StdVector<VoxelBuffer> blocks;
+	create_terrain_blocks(blocks, 16);
+
+	StdVector<StdVector<uint8_t>> samples;
+	for (const VoxelBuffer &vb : blocks) {
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb);
+		ZN_TEST_ASSERT(result.success);
+		samples.push_back(result.data);
+	}
+
+	std::shared_ptr<CompressedData::ZstdDictionary> dictionary =
+			CompressedData::ZstdDictionary::create_from_samples(to_span(samples), 16 * 1024);
+	ZN_TEST_ASSERT(dictionary != nullptr);
+	ZN_TEST_ASSERT(dictionary->get_id() != 0);
+	ZN_TEST_ASSERT(dictionary->get_content().size() <= 16 * 1024);
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> dictionaries;
+	dictionaries.push_back(dictionary);
+
+	const int levels[] = { CompressedData::ZSTD_MIN_LEVEL, CompressedData::ZSTD_DEFAULT_LEVEL, 9 };
+
+	for (const int level : levels) {
+		for (const bool use_dictionary : { false, true }) {
+			CompressedData::CompressionParams params;
+			params.compression = CompressedData::COMPRESSION_ZSTD;
+			params.zstd_level = level;
+			if (use_dictionary) {
+				params.zstd_dictionary = dictionary;
+			}
+
+			for (const VoxelBuffer &vb : blocks) {
+				BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(vb, params);
+				ZN_TEST_ASSERT(result.success);
+				const StdVector<uint8_t> data = result.data;
+				ZN_TEST_ASSERT(data.size() > 0);
+				ZN_TEST_ASSERT(data[0] == CompressedData::COMPRESSION_ZSTD);
+
+				VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+				ZN_TEST_ASSERT(BlockSerializer::decompress_and_deserialize(
+						to_span(data), deserialized_voxel_buffer, to_span(dictionaries)
+				));
+				ZN_TEST_ASSERT(vb.equals(deserialized_voxel_buffer));
+			}
+		}
+	}
+
+	// A dictionary loaded back from its content must be usable on data compressed with the original
+	{
+		CompressedData::CompressionParams params;
+		params.compression = CompressedData::COMPRESSION_ZSTD;
+		params.zstd_dictionary = dictionary;
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(blocks[3], params);
+		ZN_TEST_ASSERT(result.success);
+		const StdVector<uint8_t> data = result.data;
+
+		StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> reloaded_dictionaries;
+		reloaded_dictionaries.push_back(
+				make_shared_instance<CompressedData::ZstdDictionary>(dictionary->get_content())
+		);
+		ZN_TEST_ASSERT(reloaded_dictionaries[0]->get_id() == dictionary->get_id());
+
+		VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::decompress_and_deserialize(
+				to_span(data), deserialized_voxel_buffer, to_span(reloaded_dictionaries)
+		));
+		ZN_TEST_ASSERT(blocks[3].equals(deserialized_voxel_buffer));
+	}
+}
+
+void test_block_serializer_uniform_fast_path() {
+	VoxelBuffer voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+	voxel_buffer.create(Vector3iUtil::create(16));
+	voxel_buffer.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	voxel_buffer.clear_channel(VoxelBuffer::CHANNEL_TYPE, 3);
+	voxel_buffer.clear_channel_f(VoxelBuffer::CHANNEL_SDF, -1.f);
+
+	{
+		// Even if a slow compression is requested
+		CompressedData::CompressionParams params;
+		params.compression = CompressedData::COMPRESSION_ZSTD;
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxel_buffer, params);
+		ZN_TEST_ASSERT(result.success);
+		const StdVector<uint8_t> data = result.data;
+		// Uniform blocks are not worth compressing
+		ZN_TEST_ASSERT(data.size() > 0);
+		ZN_TEST_ASSERT(data[0] == CompressedData::COMPRESSION_NONE);
+
+		VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::decompress_and_deserialize(to_span(data), deserialized_voxel_buffer));
+		ZN_TEST_ASSERT(voxel_buffer.equals(deserialized_voxel_buffer));
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			ZN_TEST_ASSERT(
+					deserialized_voxel_buffer.get_channel_compression(channel_index) == VoxelBuffer::COMPRESSION_UNIFORM
+			);
+		}
+	}
+
+	// As soon as one channel has varying values, the requested compression is used
+	voxel_buffer.set_voxel(4, Vector3i(1, 2, 3), VoxelBuffer::CHANNEL_TYPE);
+	{
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxel_buffer);
+		ZN_TEST_ASSERT(result.success);
+		const StdVector<uint8_t> data = result.data;
+		ZN_TEST_ASSERT(data.size() > 0);
+		ZN_TEST_ASSERT(data[0] == CompressedData::COMPRESSION_LZ4);
+
+		VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::decompress_and_deserialize(to_span(data), deserialized_voxel_buffer));
+		ZN_TEST_ASSERT(voxel_buffer.equals(deserialized_voxel_buffer));
+	}
+}
+
+void test_block_serializer_channel_encodings() {
+	struct L {
+		static void check_round_trip(const VoxelBuffer &vb) {
+			BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb);
+			ZN_TEST_ASSERT(result.success);
+			const StdVector<uint8_t> data = result.data;
+			VoxelBuffer deserialized_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+			ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(data), deserialized_voxel_buffer));
+			// Palettes are not kept when deserializing, so compare values
+			for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+				ZN_TEST_ASSERT(
+						vb.get_channel_depth(channel_index) ==
+						deserialized_voxel_buffer.get_channel_depth(channel_index)
+				);
+				Vector3i pos;
+				for (pos.z = 0; pos.z < vb.get_size().z; ++pos.z) {
+					for (pos.x = 0; pos.x < vb.get_size().x; ++pos.x) {
+						for (pos.y = 0; pos.y < vb.get_size().y; ++pos.y) {
+							ZN_TEST_ASSERT(
+									vb.get_voxel(pos, channel_index) ==
+									deserialized_voxel_buffer.get_voxel(pos, channel_index)
+							);
+						}
+					}
+				}
+			}
+		}
+	};
+
+	const VoxelBuffer::Depth depths[] = { VoxelBuffer::DEPTH_8_BIT, VoxelBuffer::DEPTH_16_BIT };
+
+	for (const VoxelBuffer::Depth depth : depths) {
+		const uint64_t max_value = depth == VoxelBuffer::DEPTH_8_BIT ? 0xff : 0xffff;
+
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(Vector3i(16, 17, 18));
+		vb.set_channel_depth(VoxelBuffer::CHANNEL_TYPE, depth);
+		vb.set_channel_depth(VoxelBuffer::CHANNEL_SDF, depth);
+		vb.set_channel_depth(VoxelBuffer::CHANNEL_DATA5, depth);
+
+		// Types with long runs, SDF wrapping around in both directions, and noise which should be stored raw
+		Vector3i pos;
+		unsigned int i = 0;
+		for (pos.z = 0; pos.z < vb.get_size().z; ++pos.z) {
+			for (pos.x = 0; pos.x < vb.get_size().x; ++pos.x) {
+				for (pos.y = 0; pos.y < vb.get_size().y; ++pos.y) {
+					vb.set_voxel(pos.y < 8 ? 1 : max_value, pos, VoxelBuffer::CHANNEL_TYPE);
+					vb.set_voxel((pos.y * 37 - pos.x * 91) & max_value, pos, VoxelBuffer::CHANNEL_SDF);
+					vb.set_voxel((i * 2654435761u) & max_value, pos, VoxelBuffer::CHANNEL_DATA5);
+					++i;
+				}
+			}
+		}
+		L::check_round_trip(vb);
+
+		vb.compress_palette_channels();
+		ZN_TEST_ASSERT(vb.get_channel_compression(VoxelBuffer::CHANNEL_TYPE) == VoxelBuffer::COMPRESSION_PALETTE);
+		L::check_round_trip(vb);
+	}
+
+	// Type runs longer than what a single run can hold
+	{
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(Vector3iUtil::create(64));
+		vb.set_channel_depth(VoxelBuffer::CHANNEL_TYPE, VoxelBuffer::DEPTH_16_BIT);
+		vb.clear_channel(VoxelBuffer::CHANNEL_TYPE, 5);
+		vb.set_voxel(6, Vector3i(63, 63, 63), VoxelBuffer::CHANNEL_TYPE);
+		L::check_round_trip(vb);
+	}
+
+	// Blocks saved with version 4 can still be loaded
+	{
+		StdVector<uint8_t> data;
+		MemoryWriter mw(data, ENDIANNESS_LITTLE_ENDIAN);
+		mw.store_8(4);
+		mw.store_16(2);
+		mw.store_16(2);
+		mw.store_16(2);
+		// Raw 8-bit channel
+		mw.store_8(VoxelBuffer::COMPRESSION_NONE | (VoxelBuffer::DEPTH_8_BIT << 4));
+		for (unsigned int i = 0; i < 8; ++i) {
+			mw.store_8(i + 10);
+		}
+		for (unsigned int channel_index = 1; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			mw.store_8(VoxelBuffer::COMPRESSION_UNIFORM | (VoxelBuffer::DEPTH_8_BIT << 4));
+			mw.store_8(channel_index);
+		}
+		mw.store_32(0x900df00d);
+
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(data), vb));
+		ZN_TEST_ASSERT(vb.get_size() == Vector3i(2, 2, 2));
+		for (unsigned int i = 0; i < 8; ++i) {
+			ZN_TEST_ASSERT(vb.get_voxel(Vector3iUtil::from_zxy_index(i, vb.get_size()), 0) == i + 10);
+		}
+		for (unsigned int channel_index = 1; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			ZN_TEST_ASSERT(vb.get_channel_compression(channel_index) == VoxelBuffer::COMPRESSION_UNIFORM);
+			ZN_TEST_ASSERT(vb.get_voxel(Vector3i(1, 1, 1), channel_index) == channel_index);
+		}
+	}
+}
+
+void test_block_serializer_packed_metadata() {
+	VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	vb.create(Vector3iUtil::create(64));
+	vb.get_block_metadata().set_u64(77);
+
+	// Mix of types, with positions close to each other and far apart, so large index differences get escaped
+	StdVector<Vector3i> positions;
+	for (unsigned int i = 0; i < 200; ++i) {
+		positions.push_back(Vector3i((i * 7) % 64, (i * 13) % 64, (i * 29) % 64));
+	}
+	positions.push_back(Vector3i(0, 0, 0));
+	positions.push_back(Vector3i(63, 63, 63));
+
+	for (unsigned int i = 0; i < positions.size(); ++i) {
+		VoxelMetadata *meta = vb.get_or_create_voxel_metadata(positions[i]);
+		ZN_TEST_ASSERT(meta != nullptr);
+		switch (i % 7) {
+			case 0:
+				meta->set_u64(i * 1000);
+				break;
+			case 1:
+				meta->clear();
+				break;
+			case 2:
+				godot::set_as_variant(*meta, i % 2 == 0);
+				break;
+			case 3:
+				godot::set_as_variant(*meta, -static_cast<int64_t>(i) * 100000000);
+				break;
+			case 4:
+				godot::set_as_variant(*meta, i * 0.25);
+				break;
+			case 5:
+				godot::set_as_variant(*meta, String("Metadata {0}").format(varray(int64_t(i))));
+				break;
+			case 6:
+				godot::set_as_variant(*meta, Vector3i(i, -static_cast<int>(i), 3));
+				break;
+		}
+	}
+	{
+		// Goes through generic Variant encoding
+		VoxelMetadata *meta = vb.get_or_create_voxel_metadata(Vector3i(10, 20, 30));
+		ZN_TEST_ASSERT(meta != nullptr);
+		godot::set_as_variant(*meta, Vector3(1.5, 2.5, 3.5));
+	}
+
+	BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb);
+	ZN_TEST_ASSERT(result.success);
+	const StdVector<uint8_t> data = result.data;
+
+	VoxelBuffer rvb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(data), rvb));
+
+	ZN_TEST_ASSERT(rvb.get_block_metadata().get_type() == VoxelMetadata::TYPE_U64);
+	ZN_TEST_ASSERT(rvb.get_block_metadata().get_u64() == 77);
+
+	const FlatMapMoveOnly<Vector3i, VoxelMetadata> &vb_meta_map = vb.get_voxel_metadata();
+	const FlatMapMoveOnly<Vector3i, VoxelMetadata> &rvb_meta_map = rvb.get_voxel_metadata();
+	ZN_TEST_ASSERT(vb_meta_map.size() == rvb_meta_map.size());
+
+	for (auto it = vb_meta_map.begin(); it != vb_meta_map.end(); ++it) {
+		const VoxelMetadata *rmeta = rvb_meta_map.find(it->key);
+		ZN_TEST_ASSERT(rmeta != nullptr);
+		ZN_TEST_ASSERT(rmeta->get_type() == it->value.get_type());
+		const Variant v = godot::get_as_variant(it->value);
+		const Variant rv = godot::get_as_variant(*rmeta);
+		ZN_TEST_ASSERT(v.get_type() == rv.get_type());
+		ZN_TEST_ASSERT(v == rv);
+	}
+
+	// Blocks saved with version 5 still load their metadata
+	{
+		StdVector<uint8_t> v5_data;
+		MemoryWriter mw(v5_data, ENDIANNESS_LITTLE_ENDIAN);
+		mw.store_8(5);
+		mw.store_16(2);
+		mw.store_16(2);
+		mw.store_16(2);
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			mw.store_8(VoxelBuffer::COMPRESSION_UNIFORM | (VoxelBuffer::DEPTH_8_BIT << 4));
+			mw.store_8(0);
+		}
+		// Metadata size, block metadata, then position and entry
+		mw.store_32(16);
+		mw.store_8(VoxelMetadata::TYPE_EMPTY);
+		mw.store_16(1);
+		mw.store_16(0);
+		mw.store_16(1);
+		mw.store_8(VoxelMetadata::TYPE_U64);
+		mw.store_64(123456);
+		mw.store_32(0x900df00d);
+
+		VoxelBuffer v5_vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(v5_data), v5_vb));
+		const VoxelMetadata *meta = v5_vb.get_voxel_metadata(Vector3i(1, 0, 1));
+		ZN_TEST_ASSERT(meta != nullptr);
+		ZN_TEST_ASSERT(meta->get_type() == VoxelMetadata::TYPE_U64);
+		ZN_TEST_ASSERT(meta->get_u64() == 123456);
+	}
+}
+
+void test_block_serializer_narrowed_channels() {
+	VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	vb.create(Vector3i(16, 17, 18));
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_TYPE, VoxelBuffer::DEPTH_16_BIT);
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+
+	// A few type IDs below 256, with noise so the channel isn't stored as runs
+	Vector3i pos;
+	unsigned int i = 0;
+	for (pos.z = 0; pos.z < vb.get_size().z; ++pos.z) {
+		for (pos.x = 0; pos.x < vb.get_size().x; ++pos.x) {
+			for (pos.y = 0; pos.y < vb.get_size().y; ++pos.y) {
+				vb.set_voxel((i * 2654435761u) % 200, pos, VoxelBuffer::CHANNEL_TYPE);
+				vb.set_voxel((pos.y * 37) & 0xff, pos, VoxelBuffer::CHANNEL_SDF);
+				++i;
+			}
+		}
+	}
+
+	size_t wide_size;
+	{
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb, false);
+		ZN_TEST_ASSERT(result.success);
+		wide_size = result.data.size();
+	}
+
+	StdVector<uint8_t> data;
+	{
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb, true);
+		ZN_TEST_ASSERT(result.success);
+		data = result.data;
+	}
+	// Only the type channel gets narrowed, SDF keeps its 16-bit values
+	const size_t volume = Vector3iUtil::get_volume_u64(vb.get_size());
+	ZN_TEST_ASSERT(data.size() == wide_size - volume);
+
+	VoxelBuffer rvb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(data), rvb));
+	ZN_TEST_ASSERT(rvb.get_channel_depth(VoxelBuffer::CHANNEL_TYPE) == VoxelBuffer::DEPTH_16_BIT);
+	ZN_TEST_ASSERT(vb.equals(rvb));
+
+	// A single value above 255 keeps the channel wide
+	vb.set_voxel(256, Vector3i(3, 4, 5), VoxelBuffer::CHANNEL_TYPE);
+	{
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb, true);
+		ZN_TEST_ASSERT(result.success);
+		ZN_TEST_ASSERT(result.data.size() == wide_size);
+		data = result.data;
+	}
+	ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(data), rvb));
+	ZN_TEST_ASSERT(vb.equals(rvb));
+
+	// Blocks saved with version 6 can still be loaded
+	{
+		StdVector<uint8_t> v6_data;
+		MemoryWriter mw(v6_data, ENDIANNESS_LITTLE_ENDIAN);
+		mw.store_8(6);
+		mw.store_16(2);
+		mw.store_16(2);
+		mw.store_16(2);
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			mw.store_8(VoxelBuffer::COMPRESSION_UNIFORM | (VoxelBuffer::DEPTH_16_BIT << 4));
+			mw.store_16(300 + channel_index);
+		}
+		mw.store_32(0x900df00d);
+
+		VoxelBuffer v6_vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(v6_data), v6_vb));
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			ZN_TEST_ASSERT(v6_vb.get_voxel(Vector3i(1, 1, 1), channel_index) == 300 + channel_index);
+		}
+	}
+}
+
+void test_block_serializer_compression_benchmark(testing::BenchmarkSuite &suite) {
+	StdVector<VoxelBuffer> blocks;
+	create_terrain_blocks(blocks, 64);
+
+	StdVector<StdVector<uint8_t>> samples;
+	size_t uncompressed_size = 0;
+	for (const VoxelBuffer &vb : blocks) {
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb);
+		ZN_TEST_ASSERT(result.success);
+		samples.push_back(result.data);
+		uncompressed_size += result.data.size();
+	}
+
+	// Train on a subset, like a game would with blocks saved so far
+	std::shared_ptr<CompressedData::ZstdDictionary> dictionary = CompressedData::ZstdDictionary::create_from_samples(
+			to_span(samples).sub(0, samples.size() / 4), 64 * 1024
+	);
+	ZN_TEST_ASSERT(dictionary != nullptr);
+	StdVector<std::shared_ptr<CompressedData::ZstdDictionary>> dictionaries;
+	dictionaries.push_back(dictionary);
+
+	struct Config {
+		const char *name;
+		CompressedData::Compression compression;
+		int zstd_level;
+		bool use_dictionary;
+	};
+	const Config configs[] = {
+		{ "lz4", CompressedData::COMPRESSION_LZ4, 0, false },
+		{ "zstd_1", CompressedData::COMPRESSION_ZSTD, 1, false },
+		{ "zstd_3", CompressedData::COMPRESSION_ZSTD, 3, false },
+		{ "zstd_9", CompressedData::COMPRESSION_ZSTD, 9, false },
+		{ "zstd_1_dictionary", CompressedData::COMPRESSION_ZSTD, 1, true },
+		{ "zstd_3_dictionary", CompressedData::COMPRESSION_ZSTD, 3, true },
+	};
+
+	StdVector<StdVector<uint8_t>> compressed_blocks;
+	compressed_blocks.resize(samples.size());
+	StdVector<uint8_t> decompressed;
+
+	for (const Config &config : configs) {
+		CompressedData::CompressionParams params;
+		params.compression = config.compression;
+		params.zstd_level = config.zstd_level;
+		if (config.use_dictionary) {
+			params.zstd_dictionary = dictionary;
+		}
+
+		suite.run(
+				format("block_serializer_{}_compress", config.name).c_str(),
+				1,
+				[&samples, &compressed_blocks, &params]() {
+					for (unsigned int i = 0; i < samples.size(); ++i) {
+						ZN_TEST_ASSERT(CompressedData::compress(to_span(samples[i]), compressed_blocks[i], params));
+					}
+				}
+		);
+
+		suite.run(
+				format("block_serializer_{}_decompress", config.name).c_str(),
+				1,
+				[&compressed_blocks, &decompressed, &dictionaries]() {
+					for (unsigned int i = 0; i < compressed_blocks.size(); ++i) {
+						ZN_TEST_ASSERT(CompressedData::decompress(
+								to_span(compressed_blocks[i]), decompressed, to_span(dictionaries)
+						));
+					}
+				}
+		);
+
+		// Includes decoding channels into voxels, which is what streams do when loading
+		VoxelBuffer loaded_voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+		suite.run(
+				format("block_serializer_{}_load", config.name).c_str(),
+				1,
+				[&compressed_blocks, &loaded_voxels, &dictionaries]() {
+					for (unsigned int i = 0; i < compressed_blocks.size(); ++i) {
+						ZN_TEST_ASSERT(BlockSerializer::decompress_and_deserialize(
+								to_span(compressed_blocks[i]), loaded_voxels, to_span(dictionaries)
+						));
+					}
+				}
+		);
+
+		size_t compressed_size = 0;
+		for (unsigned int i = 0; i < compressed_blocks.size(); ++i) {
+			ZN_TEST_ASSERT(
+					CompressedData::decompress(to_span(compressed_blocks[i]), decompressed, to_span(dictionaries))
+			);
+			ZN_TEST_ASSERT(decompressed == samples[i]);
+			compressed_size += compressed_blocks[i].size();
+		}
+
+		print_line(format(
+				"{}: {} blocks, {} bytes -> {} bytes, ratio {}",
+				config.name,
+				samples.size(),
+				uncompressed_size,
+				compressed_size,
+				double(uncompressed_size) / double(compressed_size)
+		));
+	}
+}
+
 } // namespace zylann::voxel::tests
@@ -1,10 +1,20 @@
 #ifndef VOXEL_TESTS_BLOCK_SERIALIZER_H
 #define VOXEL_TESTS_BLOCK_SERIALIZER_H
 
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
 namespace zylann::voxel::tests {
 
 void test_block_serializer();
 void test_block_serializer_stream_peer();
+void test_block_serializer_zstd();
+void test_block_serializer_uniform_fast_path();
+void test_block_serializer_channel_encodings();
+void test_block_serializer_packed_metadata();
+void test_block_serializer_narrowed_channels();
+void test_block_serializer_compression_benchmark(testing::BenchmarkSuite &suite);
 
 } // namespace zylann::voxel::tests
 
@@ -1,3 +1,4 @@
+#include "../../engine/detail_rendering/detail_rendering.h"
 #include "../../engine/detail_rendering/render_detail_texture_gpu_task.h"
 #include "../../engine/detail_rendering/render_detail_texture_task.h"
 #include "../../engine/voxel_engine.h"
@@ -144,14 +145,16 @@ void test_normalmap_render_gpu() {
 			lod_index,
 			detail_texture_settings.octahedral_encoding_enabled,
 			math::deg_to_rad(float(detail_texture_settings.max_deviation_degrees)),
-			false
+			false,
+			nullptr
 	);
 
 	DetailImages images = store_normalmap_data_to_images(
 			detail_textures_data,
 			detail_texture_settings.tile_resolution_min,
 			nm_task.mesh_block_size,
-			detail_texture_settings.octahedral_encoding_enabled
+			detail_texture_settings.octahedral_encoding_enabled,
+			detail_texture_settings.bc5_compression_enabled
 	);
 	ZN_ASSERT(images.atlas.is_valid());
 	Ref<Image> cpu_atlas_image = images.atlas;
@@ -192,4 +195,72 @@ void test_normalmap_render_gpu() {
 	ZN_TEST_ASSERT(diff < 0.1);
 }
 
+void test_detail_rendering_bc5_compression() {
+	struct L {
+		static uint8_t decode_bc4(const uint8_t *block, unsigned int pixel_index) {
+			uint64_t indices = 0;
+			for (unsigned int i = 0; i < 6; ++i) {
+				indices |= uint64_t(block[2 + i]) << (i * 8);
+			}
+			const unsigned int index = (indices >> (pixel_index * 3)) & 0x7;
+			const int e0 = block[0];
+			const int e1 = block[1];
+			if (index == 0) {
+				return e0;
+			}
+			if (index == 1) {
+				return e1;
+			}
+			if (e0 > e1) {
+				return ((8 - index) * e0 + (index - 1) * e1) / 7;
+			}
+			if (index == 6) {
+				return 0;
+			}
+			if (index == 7) {
+				return 255;
+			}
+			return ((6 - index) * e0 + (index - 1) * e1) / 5;
+		}
+	};
+
+	const Vector2i size(8, 12);
+	StdVector<uint8_t> src;
+	src.resize(size.x * size.y * 2);
+	for (int y = 0; y < size.y; ++y) {
+		for (int x = 0; x < size.x; ++x) {
+			const unsigned int i = (x + y * size.x) * 2;
+			// Gradient in red, uniform blocks in green except one with noise
+			src[i] = x * 25 + y * 5;
+			src[i + 1] = (x < 4 && y < 4) ? ((x * 7919 + y * 104729) % 256) : 100 + (x / 4) * 10;
+		}
+	}
+
+	StdVector<uint8_t> dst;
+	dst.resize(size.x * size.y);
+	compress_rg8_to_bc5(to_span(src), size, to_span(dst));
+
+	const unsigned int blocks_x = size.x / 4;
+	for (int y = 0; y < size.y; ++y) {
+		for (int x = 0; x < size.x; ++x) {
+			const uint8_t *block = dst.data() + ((x / 4) + (y / 4) * blocks_x) * 16;
+			const unsigned int pixel_index = (x % 4) + (y % 4) * 4;
+			const unsigned int src_i = (x + y * size.x) * 2;
+
+			for (unsigned int channel = 0; channel < 2; ++channel) {
+				const uint8_t *channel_block = block + channel * 8;
+				const int range = channel_block[0] - channel_block[1];
+				ZN_TEST_ASSERT(range >= 0);
+				const int decoded = L::decode_bc4(channel_block, pixel_index);
+				const int expected = src[src_i + channel];
+				// Values are snapped to one of 8 evenly-spaced values between the min and max of the block
+				ZN_TEST_ASSERT(Math::abs(decoded - expected) <= range / 14 + 1);
+				if (range == 0) {
+					ZN_TEST_ASSERT(decoded == expected);
+				}
+			}
+		}
+	}
+}
+
 } // namespace zylann::voxel::tests
@@ -3,6 +3,7 @@
 
 namespace zylann::voxel::tests {
 void test_normalmap_render_gpu();
+void test_detail_rendering_bc5_compression();
 }
 
 #endif // VOXEL_TEST_NORMALMAP_RENDER_GPU_H
@@ -1,12 +1,23 @@
 #include "test_edition_funcs.h"
+#include "../../edition/async_edit_queue.h"
+#include "../../edition/blocky_random_ticker.h"
+#include "../../edition/floating_chunks.h"
 #include "../../edition/funcs.h"
+#include "../../edition/raycast.h"
+#include "../../edition/voxel_tool_buffer.h"
 #include "../../edition/voxel_tool_terrain.h"
 #include "../../generators/graph/voxel_generator_graph.h"
+#include "../../generators/simple/voxel_generator_flat.h"
 #include "../../meshers/blocky/voxel_blocky_library.h"
 #include "../../meshers/blocky/voxel_blocky_model_cube.h"
 #include "../../meshers/blocky/voxel_blocky_model_mesh.h"
+#include "../../storage/voxel_buffer_gd.h"
 #include "../../storage/voxel_data.h"
+#include "../../util/containers/std_unordered_set.h"
 #include "../../util/godot/classes/image.h"
+#include "../../util/memory/linear_allocator.h"
+#include "../../util/tasks/async_dependency_tracker.h"
+#include "../benchmarking.h"
 #include "../testing.h"
 #include "test_util.h"
 
@@ -134,9 +145,131 @@ void test_run_blocky_random_tick() {
 	}
 }
 
-void test_box_blur() {
-	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
-	voxels.create(64, 64, 64);
+void test_blocky_random_ticker() {
+	Ref<VoxelBlockyLibrary> library;
+	library.instantiate();
+
+	{
+		Ref<VoxelBlockyModelMesh> air;
+		air.instantiate();
+		library->add_model(air);
+	}
+
+	int non_tickable_id = -1;
+	{
+		Ref<VoxelBlockyModelCube> non_tickable;
+		non_tickable.instantiate();
+		non_tickable_id = library->add_model(non_tickable);
+	}
+
+	int tickable_id = -1;
+	{
+		Ref<VoxelBlockyModel> tickable;
+		tickable.instantiate();
+		tickable->set_random_tickable(true);
+		tickable_id = library->add_model(tickable);
+	}
+
+	library->bake();
+
+	VoxelData data;
+	const Vector3i block_size = Vector3iUtil::create(data.get_block_size());
+
+	auto add_block = [&data](Vector3i bpos, std::shared_ptr<VoxelBuffer> buffer) {
+		VoxelDataBlock block(buffer, 0);
+		ZN_TEST_ASSERT(data.try_set_block(bpos, block));
+	};
+
+	// Uniform air
+	{
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		add_block(Vector3i(0, 0, 0), buffer);
+	}
+	// Uniform tickable
+	const Vector3i tickable_block_pos(1, 0, 0);
+	{
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		buffer->fill(tickable_id, VoxelBuffer::CHANNEL_TYPE);
+		add_block(tickable_block_pos, buffer);
+	}
+	// Palette without tickable values
+	{
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		buffer->fill_area(non_tickable_id, Vector3i(), block_size / 2, VoxelBuffer::CHANNEL_TYPE);
+		buffer->compress_palette_channels();
+		add_block(Vector3i(2, 0, 0), buffer);
+	}
+	// Interleaving of all types
+	const Vector3i mixed_block_pos(3, 0, 0);
+	{
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		Box3i(Vector3i(), block_size).for_each_cell_zxy([&buffer](Vector3i pos) {
+			buffer->set_voxel((pos.x + pos.y + pos.z) % 3, pos, VoxelBuffer::CHANNEL_TYPE);
+		});
+		add_block(mixed_block_pos, buffer);
+	}
+
+	const unsigned int voxels_per_block = 50;
+
+	BlockyRandomTicker ticker;
+	ticker.set_seed(131183);
+
+	// Visiting all blocks at once
+	StdVector<BlockyRandomTicker::Hit> hits;
+	ticker.tick(data, **library, 100, voxels_per_block, ParallelJobsScheduler(), hits);
+
+	VoxelSingleValue defval;
+	defval.i = 0;
+
+	unsigned int tickable_block_hit_count = 0;
+	unsigned int mixed_block_hit_count = 0;
+	for (const BlockyRandomTicker::Hit &hit : hits) {
+		ZN_TEST_ASSERT(hit.value == static_cast<uint32_t>(tickable_id));
+		ZN_TEST_ASSERT(data.get_voxel(hit.position, VoxelBuffer::CHANNEL_TYPE, defval).i == hit.value);
+		const Vector3i bpos = data.voxel_to_block(hit.position);
+		if (bpos == tickable_block_pos) {
+			++tickable_block_hit_count;
+		} else {
+			ZN_TEST_ASSERT(bpos == mixed_block_pos);
+			++mixed_block_hit_count;
+		}
+	}
+	ZN_TEST_ASSERT(tickable_block_hit_count == voxels_per_block);
+	ZN_TEST_ASSERT(mixed_block_hit_count > 0 && mixed_block_hit_count < voxels_per_block);
+
+	// Visiting blocks one by one, over multiple calls
+	{
+		BlockyRandomTicker ticker2;
+		ticker2.set_seed(131183);
+		StdVector<BlockyRandomTicker::Hit> hits2;
+		for (unsigned int i = 0; i < 4; ++i) {
+			ticker2.tick(data, **library, 1, voxels_per_block, ParallelJobsScheduler(), hits2);
+		}
+		// Same seed, same blocks, so same results
+		ZN_TEST_ASSERT(hits2.size() == hits.size());
+		for (unsigned int i = 0; i < hits.size(); ++i) {
+			ZN_TEST_ASSERT(hits2[i].position == hits[i].position);
+		}
+	}
+
+	// The next pass picks different voxels
+	StdVector<BlockyRandomTicker::Hit> hits3;
+	ticker.tick(data, **library, 100, voxels_per_block, ParallelJobsScheduler(), hits3);
+	bool same = hits3.size() == hits.size();
+	for (unsigned int i = 0; i < hits.size() && same; ++i) {
+		same = hits3[i].position == hits[i].position;
+	}
+	ZN_TEST_ASSERT(!same);
+}
+
+namespace {
+
+void create_box_blur_test_buffer(VoxelBuffer &voxels, Vector3i size) {
+	voxels.create(size);
 
 	Vector3i pos;
 	for (pos.z = 0; pos.z < voxels.get_size().z; ++pos.z) {
@@ -147,6 +280,13 @@ void test_box_blur() {
 			}
 		}
 	}
+}
+
+} // namespace
+
+void test_box_blur() {
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	create_box_blur_test_buffer(voxels, Vector3i(64, 64, 64));
 
 	const int blur_radius = 3;
 	const Vector3f sphere_pos = to_vec3f(voxels.get_size()) / 2.f;
@@ -172,6 +312,49 @@ void test_box_blur() {
 	// L::save_image(voxels_blurred_2, 32 - blur_radius, "test_box_blur_blurred_2.png");
 
 	ZN_TEST_ASSERT(sd_equals_approx(voxels_blurred_1, voxels_blurred_2));
+
+	VoxelBuffer voxels_blurred_3(VoxelBuffer::ALLOCATOR_DEFAULT);
+	ops::box_blur_ring_buffer_ref(voxels, voxels_blurred_3, blur_radius, sphere_pos, sphere_radius);
+
+	ZN_TEST_ASSERT(sd_equals_approx(voxels_blurred_1, voxels_blurred_3));
+
+	// Sizes that are not multiples of SIMD width, and a sphere smaller than the buffer
+	VoxelBuffer voxels_odd(VoxelBuffer::ALLOCATOR_DEFAULT);
+	create_box_blur_test_buffer(voxels_odd, Vector3i(23, 19, 17));
+	const Vector3f odd_sphere_pos(7.f, 5.5f, 4.f);
+	const float odd_sphere_radius = 6.f;
+
+	VoxelBuffer voxels_odd_blurred_1(VoxelBuffer::ALLOCATOR_DEFAULT);
+	ops::box_blur_slow_ref(voxels_odd, voxels_odd_blurred_1, blur_radius, odd_sphere_pos, odd_sphere_radius);
+
+	VoxelBuffer voxels_odd_blurred_2(VoxelBuffer::ALLOCATOR_DEFAULT);
+	ops::box_blur(voxels_odd, voxels_odd_blurred_2, blur_radius, odd_sphere_pos, odd_sphere_radius);
+
+	ZN_TEST_ASSERT(sd_equals_approx(voxels_odd_blurred_1, voxels_odd_blurred_2));
+}
+
+void test_box_blur_benchmark(testing::BenchmarkSuite &suite) {
+	// Similar to what `VoxelTool::smooth_sphere` processes with a large radius
+	const int blur_radius = 8;
+	const float sphere_radius = 40.f;
+	const int buffer_size = 2 * static_cast<int>(sphere_radius) + 2 * blur_radius;
+
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	create_box_blur_test_buffer(voxels, Vector3iUtil::create(buffer_size));
+	const Vector3f sphere_pos = Vector3f(sphere_radius);
+
+	VoxelBuffer voxels_blurred_1(VoxelBuffer::ALLOCATOR_DEFAULT);
+	VoxelBuffer voxels_blurred_2(VoxelBuffer::ALLOCATOR_DEFAULT);
+
+	suite.run("box_blur_ring_buffer", 1, [&voxels, &voxels_blurred_1, sphere_pos, sphere_radius]() {
+		ops::box_blur_ring_buffer_ref(voxels, voxels_blurred_1, blur_radius, sphere_pos, sphere_radius);
+	});
+
+	suite.run("box_blur_separable", 1, [&voxels, &voxels_blurred_2, sphere_pos, sphere_radius]() {
+		ops::box_blur(voxels, voxels_blurred_2, blur_radius, sphere_pos, sphere_radius);
+	});
+
+	ZN_TEST_ASSERT(sd_equals_approx(voxels_blurred_1, voxels_blurred_2));
 }
 
 void test_discord_soakil_copypaste() {
@@ -359,4 +542,420 @@ void test_sdf_hemisphere() {
 	ZN_TEST_ASSERT(shape(Vector3f(2, 0, 0)) > 0);
 }
 
-} // namespace zylann::voxel::tests
\ No newline at end of file
+void test_async_edit_queue_grouping() {
+	struct L {
+		class TestOp : public IAsyncEditOp {
+		public:
+			TestOp(Box3i p_box) : box(p_box) {}
+
+			Box3i get_box() const override {
+				return box;
+			}
+
+			void apply(VoxelDataGrid &grid) override {}
+
+			Box3i box;
+		};
+
+		static void push(AsyncEditQueue &queue, Box3i box) {
+			queue.push(make_unique_instance<TestOp>(box));
+		}
+	};
+
+	AsyncEditQueue queue;
+	ZN_TEST_ASSERT(queue.is_empty());
+
+	L::push(queue, Box3i(Vector3i(0, 0, 0), Vector3i(4, 4, 4)));
+	// Close to the first one
+	L::push(queue, Box3i(Vector3i(6, 0, 0), Vector3i(4, 4, 4)));
+	// Far from the others
+	L::push(queue, Box3i(Vector3i(1000, 0, 0), Vector3i(4, 4, 4)));
+	// Empty, ignored
+	L::push(queue, Box3i(Vector3i(0, 0, 0), Vector3i(0, 0, 0)));
+	ZN_TEST_ASSERT(!queue.is_empty());
+
+	StdVector<AsyncEditQueue::Group> groups;
+	const uint32_t first_batch_id = queue.flush(groups);
+	ZN_TEST_ASSERT(queue.is_empty());
+	ZN_TEST_ASSERT(groups.size() == 2);
+	ZN_TEST_ASSERT(groups[0].ops.size() == 2);
+	ZN_TEST_ASSERT(groups[0].box == Box3i(Vector3i(0, 0, 0), Vector3i(10, 4, 4)));
+	ZN_TEST_ASSERT(groups[1].ops.size() == 1);
+
+	// Edits pushed after a flush are part of the next batch
+	L::push(queue, Box3i(Vector3i(0, 0, 0), Vector3i(4, 4, 4)));
+	groups.clear();
+	const uint32_t second_batch_id = queue.flush(groups);
+	ZN_TEST_ASSERT(second_batch_id != first_batch_id);
+	ZN_TEST_ASSERT(groups.size() == 1);
+}
+
+void test_async_edit_group_task_generates_missing_voxels() {
+	struct L {
+		class FillOp : public IAsyncEditOp {
+		public:
+			FillOp(Box3i p_box) : box(p_box) {}
+
+			Box3i get_box() const override {
+				return box;
+			}
+
+			void apply(VoxelDataGrid &grid) override {
+				grid.write_box_no_lock(box, VoxelBuffer::CHANNEL_TYPE, [](Vector3i pos, uint64_t v) { return 2; });
+			}
+
+			Box3i box;
+		};
+	};
+
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	// Ground made of voxels of type 1 below Y=8
+	Ref<VoxelGeneratorFlat> generator;
+	generator.instantiate();
+	generator->set_channel(channel);
+	generator->set_voxel_type(1);
+	generator->set_height(8);
+
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	data->set_lod_count(1);
+	data->set_streaming_enabled(true);
+	data->set_generator(generator);
+	const int block_size = data->get_block_size();
+
+	// Blocks are loaded without voxels, like terrains do when generated blocks are not cached
+	const Box3i blocks_box(Vector3i(0, 0, 0), Vector3i(2, 2, 1));
+	blocks_box.for_each_cell([&data](Vector3i bpos) { data->try_set_block(bpos, VoxelDataBlock(0)); });
+
+	// Edit crossing the two lower blocks, above the ground
+	const Box3i edit_box(Vector3i(4, 12, 0), Vector3i(block_size, 2, 2));
+	AsyncEditQueue::Group group;
+	group.box = edit_box;
+	group.ops.push_back(make_unique_instance<L::FillOp>(edit_box));
+
+	std::shared_ptr<AsyncDependencyTracker> tracker = make_shared_instance<AsyncDependencyTracker>(1);
+	AsyncEditGroupTask task(std::move(group), data, tracker, false);
+	LinearAllocator temp_allocator;
+	ThreadedTaskContext ctx(0, TaskPriority(), temp_allocator);
+	task.run(ctx);
+	ZN_TEST_ASSERT(tracker->is_complete());
+
+	for (int bx = 0; bx < 2; ++bx) {
+		std::shared_ptr<VoxelBuffer> voxels = data->try_get_block_voxels(Vector3i(bx, 0, 0));
+		ZN_TEST_ASSERT(voxels != nullptr);
+		// Edited
+		const int edit_x = bx == 0 ? 4 : 3;
+		ZN_TEST_ASSERT(voxels->get_voxel(Vector3i(edit_x, 12, 0), channel) == 2);
+		// Generated
+		ZN_TEST_ASSERT(voxels->get_voxel(Vector3i(edit_x, 2, 0), channel) == 1);
+		ZN_TEST_ASSERT(voxels->get_voxel(Vector3i(edit_x, 14, 0), channel) == 0);
+	}
+
+	// Blocks the edit doesn't touch are left as they were
+	ZN_TEST_ASSERT(data->try_get_block_voxels(Vector3i(0, 1, 0)) == nullptr);
+}
+
+void test_raycast_nonzero_skips_blocks() {
+	VoxelData voxel_data;
+	voxel_data.set_streaming_enabled(false);
+	voxel_data.set_full_load_completed(true);
+
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+	const Vector3i target_pos(40, 2, 3);
+	// The ray goes through a block with stored air voxels, then blocks without voxels, before reaching the target
+	ZN_TEST_ASSERT(voxel_data.try_set_voxel(0, Vector3i(5, 2, 3), channel));
+	ZN_TEST_ASSERT(voxel_data.try_set_voxel(1, target_pos, channel));
+
+	Ref<VoxelRaycastResult> res = raycast_nonzero(voxel_data, Vector3(0.5, 2.5, 3.5), Vector3(1, 0, 0), 100.f, channel);
+	ZN_TEST_ASSERT(res.is_valid());
+	ZN_TEST_ASSERT(res->position == target_pos);
+	ZN_TEST_ASSERT(res->previous_position == target_pos - Vector3i(1, 0, 0));
+	ZN_TEST_ASSERT(Math::is_equal_approx(res->distance_along_ray, 39.5f));
+
+	// Going the other way
+	res = raycast_nonzero(voxel_data, Vector3(60.5, 2.5, 3.5), Vector3(-1, 0, 0), 100.f, channel);
+	ZN_TEST_ASSERT(res.is_valid());
+	ZN_TEST_ASSERT(res->position == target_pos);
+
+	// Missing
+	res = raycast_nonzero(voxel_data, Vector3(0.5, 3.5, 3.5), Vector3(1, 0, 0), 100.f, channel);
+	ZN_TEST_ASSERT(res.is_null());
+}
+
+void test_raycast_batch() {
+	VoxelData voxel_data;
+	voxel_data.set_streaming_enabled(false);
+	voxel_data.set_full_load_completed(true);
+
+	ZN_TEST_ASSERT(voxel_data.try_set_voxel_f(-1.f, Vector3i(40, 2, 3), VoxelBuffer::CHANNEL_SDF));
+	ZN_TEST_ASSERT(voxel_data.try_set_voxel_f(-1.f, Vector3i(-20, 7, 3), VoxelBuffer::CHANNEL_SDF));
+
+	// Without mesher, raycasts use SDF
+	const Ref<VoxelMesher> mesher;
+	const Transform3D transform;
+
+	StdVector<Vector3> origins;
+	StdVector<Vector3> directions;
+	origins.push_back(Vector3(0, 2, 3));
+	directions.push_back(Vector3(1, 0, 0));
+	origins.push_back(Vector3(0, 2, 3));
+	directions.push_back(Vector3(0, 1, 0));
+	origins.push_back(Vector3(-20, 7, 30));
+	directions.push_back(Vector3(0, 0, -1));
+	origins.push_back(Vector3(60, 2, 3));
+	directions.push_back(Vector3(-1, 0, 0));
+
+	StdVector<RaycastHit> hits;
+	hits.resize(origins.size());
+	const float max_distance = 100.f;
+
+	raycast_generic_world_batch(
+			voxel_data,
+			mesher,
+			transform,
+			to_span(origins),
+			to_span(directions),
+			max_distance,
+			0xffffffff,
+			0,
+			to_span(hits)
+	);
+
+	unsigned int hit_count = 0;
+
+	// Results must be the same as casting rays one by one, in the same order as inputs
+	for (unsigned int i = 0; i < origins.size(); ++i) {
+		const RaycastHit &hit = hits[i];
+		Ref<VoxelRaycastResult> res = raycast_generic_world(
+				voxel_data, mesher, transform, origins[i], directions[i], max_distance, 0xffffffff, 0
+		);
+		if (res.is_null()) {
+			ZN_TEST_ASSERT(hit.distance_along_ray < 0.f);
+			continue;
+		}
+		++hit_count;
+		ZN_TEST_ASSERT(hit.position == res->position);
+		ZN_TEST_ASSERT(hit.previous_position == res->previous_position);
+		ZN_TEST_ASSERT(Math::is_equal_approx(hit.distance_along_ray, res->distance_along_ray));
+	}
+
+	ZN_TEST_ASSERT(hit_count == 3);
+	ZN_TEST_ASSERT(hits[1].distance_along_ray < 0.f);
+}
+
+void test_floating_chunks_cache() {
+	const Box3i region(Vector3i(10, 20, 30), Vector3i(8, 8, 8));
+
+	StdVector<uint8_t> solid;
+	solid.resize(Vector3iUtil::get_volume_u64(region.size), 0);
+
+	struct L {
+		static void set(StdVector<uint8_t> &solid, Vector3i size, Vector3i pos, uint8_t v) {
+			solid[Vector3iUtil::get_zxy_index(pos, size)] = v;
+		}
+
+		static void copy(Span<const uint8_t> solid, Vector3i size, Box3i box, StdVector<uint8_t> &out) {
+			out.clear();
+			box.for_each_cell_zxy([solid, size, &out](Vector3i pos) {
+				out.push_back(solid[Vector3iUtil::get_zxy_index(pos, size)]);
+			});
+		}
+	};
+
+	// Pillar attached to the floor
+	for (int y = 0; y < 7; ++y) {
+		L::set(solid, region.size, Vector3i(3, y, 3), 1);
+	}
+	// Floating blob
+	L::set(solid, region.size, Vector3i(5, 4, 5), 1);
+	L::set(solid, region.size, Vector3i(5, 5, 5), 1);
+
+	FloatingChunksCache cache;
+	ZN_TEST_ASSERT(!cache.is_valid());
+
+	StdVector<FloatingChunk> floating_chunks;
+	cache.rebuild(region, to_span(solid), floating_chunks);
+	ZN_TEST_ASSERT(cache.is_valid());
+	ZN_TEST_ASSERT(cache.get_region() == region);
+	ZN_TEST_ASSERT(cache.get_group_count() == 2);
+	ZN_TEST_ASSERT(floating_chunks.size() == 1);
+	ZN_TEST_ASSERT(floating_chunks[0].min_pos == Vector3i(5, 4, 5));
+	ZN_TEST_ASSERT(floating_chunks[0].max_pos == Vector3i(5, 5, 5));
+
+	// Remove the floating blob from the volume
+	cache.remove(floating_chunks[0]);
+	L::set(solid, region.size, Vector3i(5, 4, 5), 0);
+	L::set(solid, region.size, Vector3i(5, 5, 5), 0);
+	ZN_TEST_ASSERT(cache.get_group_count() == 1);
+
+	StdVector<uint8_t> update_solid;
+
+	// Editing away from the pillar doesn't make anything float
+	{
+		const Box3i edited_box(Vector3i(6, 1, 0), Vector3i(1, 1, 1));
+		L::set(solid, region.size, edited_box.position, 0);
+		const Box3i update_box = cache.get_update_box(edited_box);
+		L::copy(to_span(solid), region.size, update_box, update_solid);
+		floating_chunks.clear();
+		cache.update(edited_box, to_span(update_solid), floating_chunks);
+		ZN_TEST_ASSERT(floating_chunks.size() == 0);
+		ZN_TEST_ASSERT(cache.get_group_count() == 1);
+	}
+
+	// Cutting the pillar makes its top part float
+	{
+		const Box3i edited_box(Vector3i(3, 2, 3), Vector3i(1, 1, 1));
+		L::set(solid, region.size, edited_box.position, 0);
+		const Box3i update_box = cache.get_update_box(edited_box);
+		// The whole pillar has to be checked again
+		ZN_TEST_ASSERT(update_box.contains(Box3i(Vector3i(3, 0, 3), Vector3i(1, 7, 1))));
+		L::copy(to_span(solid), region.size, update_box, update_solid);
+		floating_chunks.clear();
+		cache.update(edited_box, to_span(update_solid), floating_chunks);
+		ZN_TEST_ASSERT(cache.get_group_count() == 2);
+		ZN_TEST_ASSERT(floating_chunks.size() == 1);
+		ZN_TEST_ASSERT(floating_chunks[0].min_pos == Vector3i(3, 3, 3));
+		ZN_TEST_ASSERT(floating_chunks[0].max_pos == Vector3i(3, 6, 3));
+
+		Span<const uint32_t> labels = cache.get_labels();
+		ZN_TEST_ASSERT(labels[Vector3iUtil::get_zxy_index(Vector3i(3, 2, 3), region.size)] == 0);
+		ZN_TEST_ASSERT(
+				labels[Vector3iUtil::get_zxy_index(Vector3i(3, 4, 3), region.size)] == floating_chunks[0].label
+		);
+		ZN_TEST_ASSERT(
+				labels[Vector3iUtil::get_zxy_index(Vector3i(3, 1, 3), region.size)] != floating_chunks[0].label
+		);
+	}
+
+	// Groups joined by an edit become one
+	{
+		FloatingChunksCache cache2;
+		StdVector<uint8_t> solid2;
+		solid2.resize(solid.size(), 0);
+		// U shape, where both branches are labelled separately until the scan reaches the bottom
+		for (int x = 1; x < 7; ++x) {
+			L::set(solid2, region.size, Vector3i(x, 3, 3), 1);
+		}
+		for (int y = 1; y < 3; ++y) {
+			L::set(solid2, region.size, Vector3i(1, y, 3), 1);
+			L::set(solid2, region.size, Vector3i(6, y, 3), 1);
+		}
+		floating_chunks.clear();
+		cache2.rebuild(region, to_span(solid2), floating_chunks);
+		ZN_TEST_ASSERT(cache2.get_group_count() == 1);
+		ZN_TEST_ASSERT(floating_chunks.size() == 1);
+		ZN_TEST_ASSERT(floating_chunks[0].min_pos == Vector3i(1, 1, 3));
+		ZN_TEST_ASSERT(floating_chunks[0].max_pos == Vector3i(6, 3, 3));
+	}
+}
+
+void test_floating_chunks_sync_async_match() {
+	// The synchronous version reads voxels through a VoxelTool, while the asynchronous version reads VoxelData on a
+	// thread. Given the same voxels, both must find the same groups and copy the same voxels.
+
+	std::shared_ptr<VoxelBuffer> source = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+	source->create(Vector3i(16, 16, 16));
+	source->fill_f(1.f, VoxelBuffer::CHANNEL_SDF);
+
+	struct L {
+		static void fill_solid(VoxelBuffer &vb, Box3i box) {
+			box.for_each_cell_zxy([&vb](Vector3i pos) { vb.set_voxel_f(-1.f, pos, VoxelBuffer::CHANNEL_SDF); });
+		}
+
+		static unsigned int count_solid(const VoxelBuffer &vb) {
+			unsigned int count = 0;
+			Box3i(Vector3i(), vb.get_size()).for_each_cell_zxy([&vb, &count](Vector3i pos) {
+				if (vb.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF) < 0.f) {
+					++count;
+				}
+			});
+			return count;
+		}
+
+		static bool sdf_equals(const VoxelBuffer &a, const VoxelBuffer &b) {
+			bool equal = true;
+			Box3i(Vector3i(), a.get_size()).for_each_cell_zxy([&a, &b, &equal](Vector3i pos) {
+				if (a.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF) != b.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF)) {
+					equal = false;
+				}
+			});
+			return equal;
+		}
+	};
+
+	// Pillar touching the bottom of the box, so it doesn't float
+	L::fill_solid(*source, Box3i(Vector3i(3, 2, 3), Vector3i(1, 8, 1)));
+	// Floating blobs
+	L::fill_solid(*source, Box3i(Vector3i(6, 6, 6), Vector3i(2, 2, 2)));
+	L::fill_solid(*source, Box3i(Vector3i(10, 5, 10), Vector3i(2, 1, 2)));
+
+	// Padding of the copied groups remains inside the source buffer
+	const Box3i world_box(Vector3i(2, 2, 2), Vector3i(12, 12, 12));
+
+	Ref<godot::VoxelBuffer> source_gd = godot::VoxelBuffer::create_shared(source);
+	Ref<VoxelToolBuffer> voxel_tool(memnew(VoxelToolBuffer(source_gd)));
+	StdVector<FloatingChunkVoxels> sync_chunks;
+	find_floating_chunks_voxels(**voxel_tool, world_box, sync_chunks);
+
+	VoxelData data;
+	data.paste(Vector3i(), *source, 1 << VoxelBuffer::CHANNEL_SDF, true);
+	StdVector<FloatingChunkVoxels> async_chunks;
+	find_floating_chunks_voxels(data, world_box, async_chunks);
+
+	ZN_TEST_ASSERT(sync_chunks.size() == 2);
+	ZN_TEST_ASSERT(async_chunks.size() == sync_chunks.size());
+
+	unsigned int solid_count = 0;
+
+	for (unsigned int i = 0; i < sync_chunks.size(); ++i) {
+		const FloatingChunkVoxels &sync_chunk = sync_chunks[i];
+		const FloatingChunkVoxels &async_chunk = async_chunks[i];
+		ZN_TEST_ASSERT(sync_chunk.world_pos == async_chunk.world_pos);
+		ZN_TEST_ASSERT(sync_chunk.voxels.get_size() == async_chunk.voxels.get_size());
+		ZN_TEST_ASSERT(L::sdf_equals(sync_chunk.voxels, async_chunk.voxels));
+		solid_count += L::count_solid(sync_chunk.voxels);
+	}
+
+	// Only voxels of the blobs were copied, not the pillar
+	ZN_TEST_ASSERT(solid_count == 8 + 4);
+}
+
+void test_path_segment_binning() {
+	// Long diagonal segment, whose bounding box covers a lot more blocks than the segment itself goes through
+	math::SdfRoundConePrecalc<float> cone;
+	cone.a = Vector3f(0, 0, 0);
+	cone.b = Vector3f(100, 100, 100);
+	cone.r1 = 3.f;
+	cone.r2 = 3.f;
+	cone.update();
+
+	const unsigned int block_size_po2 = 4;
+	const int block_size = 1 << block_size_po2;
+	const int margin = 2;
+	const Box3i clip_box(Vector3i(-1000, -1000, -1000), Vector3i(2000, 2000, 2000));
+
+	StdVector<ops::PathBlockSegment> bins;
+	ops::bin_path_segments_in_blocks(
+			Span<const math::SdfRoundConePrecalc<float>>(&cone, 1), margin, clip_box, block_size_po2, bins
+	);
+
+	const Box3i blocks_box =
+			ops::get_round_cone_int_bounds(cone.a, cone.b, cone.r1, cone.r2).padded(margin).downscaled(block_size);
+	ZN_TEST_ASSERT(bins.size() > 0);
+	ZN_TEST_ASSERT(bins.size() < Vector3iUtil::get_volume_u64(blocks_box.size) / 2);
+
+	// Every voxel affected by the segment must be in one of the binned blocks
+	StdUnorderedSet<Vector3i> binned_blocks;
+	for (const ops::PathBlockSegment &bin : bins) {
+		ZN_TEST_ASSERT(bin.segment_index == 0);
+		binned_blocks.insert(bin.block_position);
+	}
+	ZN_TEST_ASSERT(binned_blocks.size() == bins.size());
+
+	for (int i = 0; i <= 100; ++i) {
+		const Vector3i pos(i, i, i);
+		ZN_TEST_ASSERT(binned_blocks.find(pos >> block_size_po2) != binned_blocks.end());
+	}
+}
+
+} // namespace zylann::voxel::tests
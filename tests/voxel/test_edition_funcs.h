@@ -1,12 +1,25 @@
 #ifndef VOXEL_TEST_EDITION_FUNCS_H
 #define VOXEL_TEST_EDITION_FUNCS_H
 
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
 namespace zylann::voxel::tests {
 
 void test_run_blocky_random_tick();
+void test_blocky_random_ticker();
 void test_box_blur();
+void test_box_blur_benchmark(testing::BenchmarkSuite &suite);
 void test_discord_soakil_copypaste();
 void test_sdf_hemisphere();
+void test_async_edit_queue_grouping();
+void test_async_edit_group_task_generates_missing_voxels();
+void test_raycast_nonzero_skips_blocks();
+void test_raycast_batch();
+void test_floating_chunks_cache();
+void test_floating_chunks_sync_async_match();
+void test_path_segment_binning();
 
 } // namespace zylann::voxel::tests
 
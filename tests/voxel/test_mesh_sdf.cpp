@@ -1,5 +1,9 @@
 #include "test_mesh_sdf.h"
+#include "../../edition/mesh_sdf.h"
 #include "../../edition/voxel_mesh_sdf_gd.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/tasks/threaded_task_runner.h"
+#include "../testing.h"
 
 namespace zylann::voxel::tests {
 
@@ -30,4 +34,133 @@ void test_voxel_mesh_sdf_issue463() {
 	msdf->call("_set_data", d);
 }
 
+namespace {
+
+// Closed UV sphere, with a number of triangles that is not a multiple of 4
+void make_sphere_mesh(
+		float radius,
+		unsigned int rings,
+		unsigned int segments,
+		StdVector<Vector3> &vertices,
+		StdVector<int> &indices
+) {
+	// Poles
+	vertices.push_back(Vector3(0, radius, 0));
+	vertices.push_back(Vector3(0, -radius, 0));
+
+	for (unsigned int ring = 1; ring < rings; ++ring) {
+		const float a = Math_PI * float(ring) / float(rings);
+		for (unsigned int segment = 0; segment < segments; ++segment) {
+			const float b = Math_TAU * float(segment) / float(segments);
+			vertices.push_back(
+					Vector3(Math::sin(a) * Math::cos(b), Math::cos(a), Math::sin(a) * Math::sin(b)) * radius
+			);
+		}
+	}
+
+	struct L {
+		static int get_index(unsigned int ring, unsigned int segment, unsigned int segments) {
+			return 2 + (ring - 1) * segments + (segment % segments);
+		}
+	};
+
+	for (unsigned int segment = 0; segment < segments; ++segment) {
+		indices.push_back(0);
+		indices.push_back(L::get_index(1, segment + 1, segments));
+		indices.push_back(L::get_index(1, segment, segments));
+
+		indices.push_back(1);
+		indices.push_back(L::get_index(rings - 1, segment, segments));
+		indices.push_back(L::get_index(rings - 1, segment + 1, segments));
+	}
+
+	for (unsigned int ring = 1; ring < rings - 1; ++ring) {
+		for (unsigned int segment = 0; segment < segments; ++segment) {
+			const int i00 = L::get_index(ring, segment, segments);
+			const int i10 = L::get_index(ring, segment + 1, segments);
+			const int i01 = L::get_index(ring + 1, segment, segments);
+			const int i11 = L::get_index(ring + 1, segment + 1, segments);
+
+			indices.push_back(i00);
+			indices.push_back(i10);
+			indices.push_back(i11);
+
+			indices.push_back(i00);
+			indices.push_back(i11);
+			indices.push_back(i01);
+		}
+	}
+}
+
+} // namespace
+
+void test_voxel_mesh_sdf_partitioned_parallel() {
+	struct L {
+		static ThreadedTaskRunner *&get_runner() {
+			static ThreadedTaskRunner *s_runner = nullptr;
+			return s_runner;
+		}
+		static void schedule_tasks(Span<IThreadedTask *> tasks) {
+			get_runner()->enqueue(tasks, false);
+		}
+	};
+
+	StdVector<Vector3> vertices;
+	StdVector<int> indices;
+	make_sphere_mesh(10.f, 8, 11, vertices, indices);
+
+	StdVector<mesh_sdf::Triangle> triangles;
+	Vector3f mesh_min_pos;
+	Vector3f mesh_max_pos;
+	ZN_TEST_ASSERT(
+			mesh_sdf::prepare_triangles(
+					to_span_const(vertices), to_span_const(indices), triangles, mesh_min_pos, mesh_max_pos
+			)
+	);
+	ZN_TEST_ASSERT(triangles.size() % 4 != 0);
+
+	const Vector3f min_pos = mesh_min_pos - Vector3f(3.f);
+	const Vector3f max_pos = mesh_max_pos + Vector3f(3.f);
+	// Sizes along Y that are not multiples of 4 have cells processed without SIMD
+	const Vector3i res(17, 23, 19);
+	const unsigned int volume = Vector3iUtil::get_volume_u64(res);
+	const int subdiv = 8;
+
+	// References computed on the calling thread only
+	StdVector<float> naive_sdf;
+	naive_sdf.resize(volume);
+	mesh_sdf::generate_mesh_sdf_naive(to_span(naive_sdf), res, to_span(triangles), min_pos, max_pos);
+
+	StdVector<float> partitioned_sdf;
+	partitioned_sdf.resize(volume);
+	mesh_sdf::generate_mesh_sdf_partitioned(
+			to_span(partitioned_sdf), res, to_span(triangles), min_pos, max_pos, subdiv
+	);
+
+	ThreadedTaskRunner runner;
+	runner.set_thread_count(4);
+	runner.set_name("Test");
+	L::get_runner() = &runner;
+
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = L::schedule_tasks;
+	scheduler.max_helpers = 3;
+
+	// Splitting slices across threads must not change results
+	StdVector<float> parallel_sdf;
+	parallel_sdf.resize(volume);
+	mesh_sdf::generate_mesh_sdf_partitioned(
+			to_span(parallel_sdf), res, to_span(triangles), min_pos, max_pos, subdiv, scheduler
+	);
+	ZN_TEST_ASSERT(parallel_sdf == partitioned_sdf);
+
+	to_span(parallel_sdf).fill(0.f);
+	mesh_sdf::generate_mesh_sdf_naive(to_span(parallel_sdf), res, to_span(triangles), min_pos, max_pos, scheduler);
+	ZN_TEST_ASSERT(parallel_sdf == naive_sdf);
+
+	runner.wait_for_all_tasks();
+	runner.dequeue_completed_tasks([](IThreadedTask *task) { ZN_DELETE(task); });
+	L::get_runner() = nullptr;
+}
+
 } // namespace zylann::voxel::tests
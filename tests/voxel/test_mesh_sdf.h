@@ -4,6 +4,7 @@
 namespace zylann::voxel::tests {
 
 void test_voxel_mesh_sdf_issue463();
+void test_voxel_mesh_sdf_partitioned_parallel();
 
 } // namespace zylann::voxel::tests
 
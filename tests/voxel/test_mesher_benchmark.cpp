@@ -0,0 +1,362 @@
+#include "test_mesher_benchmark.h"
+#include "../../generators/graph/voxel_generator_graph.h"
+#include "../../meshers/blocky/voxel_blocky_library.h"
+#include "../../meshers/blocky/voxel_blocky_model_cube.h"
+#include "../../meshers/blocky/voxel_blocky_model_empty.h"
+#include "../../meshers/blocky/voxel_mesher_blocky.h"
+#include "../../meshers/cubes/voxel_mesher_cubes.h"
+#include "../../meshers/transvoxel/voxel_mesher_transvoxel.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../streams/region/voxel_stream_region_files.h"
+#include "../../streams/sqlite/voxel_stream_sqlite.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/core/array.h"
+#include "../../util/godot/classes/os.h"
+#include "../../util/math/color8.h"
+#include "../../util/math/funcs.h"
+#include "../../util/noise/fast_noise_lite/fast_noise_lite.h"
+#include "../../util/string/format.h"
+#include "../benchmarking.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+// When set, blocks are loaded from this save instead of being generated. It can be an SQLite database, or a directory
+// of region files.
+const char *CORPUS_SAVE_ENV_VAR = "VOXEL_MESHER_BENCHMARK_SAVE";
+
+const VoxelBuffer::ChannelId CORPUS_CHANNELS[] = {
+	VoxelBuffer::CHANNEL_TYPE, //
+	VoxelBuffer::CHANNEL_SDF, //
+	VoxelBuffer::CHANNEL_COLOR, //
+	VoxelBuffer::CHANNEL_INDICES, //
+	VoxelBuffer::CHANNEL_WEIGHTS
+};
+
+// Voxels of a region of the world. Blocks are meshed from the inside of it, so the border provides neighbor voxels.
+struct Corpus {
+	VoxelBuffer voxels;
+	int block_size = 16;
+	String source;
+
+	Corpus() : voxels(VoxelBuffer::ALLOCATOR_DEFAULT) {}
+};
+
+// Hilly terrain made of 2D noise.
+//
+//     X --- FastNoise2D
+//      \/            \
+//      /\             \
+//     Z ----------- y + 24 * n --- OutputSDF
+//                    /
+//     Y ------------
+//
+void generate_corpus_from_graph(Corpus &corpus, Vector3i size_in_blocks) {
+	Ref<VoxelGeneratorGraph> generator;
+	generator.instantiate();
+	{
+		VoxelGraphFunction &g = **generator->get_main_function();
+		const uint32_t in_x = g.create_node(VoxelGraphFunction::NODE_INPUT_X, Vector2());
+		const uint32_t in_y = g.create_node(VoxelGraphFunction::NODE_INPUT_Y, Vector2());
+		const uint32_t in_z = g.create_node(VoxelGraphFunction::NODE_INPUT_Z, Vector2());
+		const uint32_t out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		const uint32_t n_noise = g.create_node(VoxelGraphFunction::NODE_FAST_NOISE_2D, Vector2());
+		const uint32_t n_expr = g.create_node(VoxelGraphFunction::NODE_EXPRESSION, Vector2());
+
+		Ref<ZN_FastNoiseLite> noise;
+		noise.instantiate();
+		noise->set_period(128.f);
+		noise->set_fractal_octaves(4);
+		g.set_node_param(n_noise, 0, noise);
+
+		g.set_node_param(n_expr, 0, "y + 24 * n");
+		PackedStringArray var_names;
+		var_names.push_back("y");
+		var_names.push_back("n");
+		g.set_expression_node_inputs(n_expr, var_names);
+
+		g.add_connection(in_x, 0, n_noise, 0);
+		g.add_connection(in_z, 0, n_noise, 1);
+		g.add_connection(in_y, 0, n_expr, 0);
+		g.add_connection(n_noise, 0, n_expr, 1);
+		g.add_connection(n_expr, 0, out_sdf, 0);
+
+		const pg::CompilationResult result = generator->compile(false);
+		ZN_TEST_ASSERT_MSG(
+				result.success,
+				String("Failed to compile graph: {0}: {1}").format(varray(result.node_id, result.message))
+		);
+	}
+
+	VoxelBuffer &vb = corpus.voxels;
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_TYPE, VoxelBuffer::DEPTH_16_BIT);
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_COLOR, VoxelBuffer::DEPTH_16_BIT);
+	vb.create(size_in_blocks * corpus.block_size);
+
+	// Centered on the ground
+	const Vector3i origin = -vb.get_size() / 2;
+	generator->generate_block(VoxelGenerator::VoxelQueryData{ vb, origin, 0 });
+
+	// Graphs of blocky or colored terrains would output types directly, but they can also be derived from the same
+	// shape, so every mesher gets the same amount of surface
+	const Color8 grass(80, 160, 60, 255);
+	const Color8 stone(120, 120, 120, 255);
+	vb.decompress_channel(VoxelBuffer::CHANNEL_TYPE);
+	vb.decompress_channel(VoxelBuffer::CHANNEL_COLOR);
+	Vector3i pos;
+	for (pos.z = 0; pos.z < vb.get_size().z; ++pos.z) {
+		for (pos.x = 0; pos.x < vb.get_size().x; ++pos.x) {
+			for (pos.y = 0; pos.y < vb.get_size().y; ++pos.y) {
+				const float sd = vb.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+				if (sd < 0.f) {
+					const bool surface = sd > -3.f;
+					vb.set_voxel(surface ? 1 : 2, pos, VoxelBuffer::CHANNEL_TYPE);
+					vb.set_voxel((surface ? grass : stone).to_u16(), pos, VoxelBuffer::CHANNEL_COLOR);
+				}
+			}
+		}
+	}
+	vb.compress_uniform_channels();
+
+	corpus.source = "graph";
+}
+
+// Copies blocks found around the origin of a save
+bool load_corpus_from_save(Corpus &corpus, Vector3i size_in_blocks, const String &path) {
+	Ref<VoxelStream> stream;
+	if (path.get_extension() == "sqlite") {
+		Ref<VoxelStreamSQLite> sqlite_stream;
+		sqlite_stream.instantiate();
+		sqlite_stream->set_database_path(path);
+		stream = sqlite_stream;
+	} else {
+		Ref<VoxelStreamRegionFiles> region_stream;
+		region_stream.instantiate();
+		region_stream->set_directory(path);
+		stream = region_stream;
+	}
+
+	corpus.block_size = 1 << stream->get_block_size_po2();
+	const Vector3i origin_in_blocks = -size_in_blocks / 2;
+
+	VoxelBuffer &vb = corpus.voxels;
+	bool format_known = false;
+	unsigned int found_count = 0;
+
+	VoxelBuffer block(VoxelBuffer::ALLOCATOR_DEFAULT);
+	Vector3i rpos;
+	for (rpos.z = 0; rpos.z < size_in_blocks.z; ++rpos.z) {
+		for (rpos.x = 0; rpos.x < size_in_blocks.x; ++rpos.x) {
+			for (rpos.y = 0; rpos.y < size_in_blocks.y; ++rpos.y) {
+				block.create(Vector3iUtil::create(corpus.block_size));
+				VoxelStream::VoxelQueryData q{ block, origin_in_blocks + rpos, 0, VoxelStream::RESULT_ERROR };
+				stream->load_voxel_block(q);
+				if (q.result != VoxelStream::RESULT_BLOCK_FOUND) {
+					continue;
+				}
+				if (!format_known) {
+					vb.copy_format(block);
+					vb.create(size_in_blocks * corpus.block_size);
+					format_known = true;
+				}
+				for (const VoxelBuffer::ChannelId channel : CORPUS_CHANNELS) {
+					if (block.get_channel_depth(channel) == vb.get_channel_depth(channel)) {
+						vb.copy_channel_from(block, Vector3i(), block.get_size(), rpos * corpus.block_size, channel);
+					}
+				}
+				++found_count;
+			}
+		}
+	}
+
+	corpus.source = format("{} ({} blocks found)", path, found_count);
+	return found_count > 0;
+}
+
+struct MesherStats {
+	unsigned int block_count = 0;
+	unsigned int non_empty_block_count = 0;
+	uint64_t vertex_count = 0;
+	int64_t retained_memory = 0;
+};
+
+unsigned int get_vertex_count(const VoxelMesher::Output::Surface &surface) {
+	if (surface.arrays.size() <= Mesh::ARRAY_VERTEX) {
+		return 0;
+	}
+	const PackedVector3Array vertices = surface.arrays[Mesh::ARRAY_VERTEX];
+	return vertices.size();
+}
+
+unsigned int get_vertex_count(const VoxelMesher::Output &output) {
+	unsigned int count = 0;
+	for (const VoxelMesher::Output::Surface &surface : output.surfaces) {
+		count += get_vertex_count(surface);
+	}
+	for (const StdVector<VoxelMesher::Output::Surface> &surfaces : output.transition_surfaces) {
+		for (const VoxelMesher::Output::Surface &surface : surfaces) {
+			count += get_vertex_count(surface);
+		}
+	}
+	return count;
+}
+
+void run_mesher_benchmark(
+		testing::BenchmarkSuite &suite,
+		const char *name,
+		VoxelMesher &mesher,
+		const Corpus &corpus,
+		bool collision_hint,
+		bool lod_hint
+) {
+	const Vector3i min_padding = Vector3iUtil::create(mesher.get_minimum_padding());
+	const Vector3i max_padding = Vector3iUtil::create(mesher.get_maximum_padding());
+	const Vector3i size_in_blocks = corpus.voxels.get_size() / corpus.block_size;
+	const Vector3i block_size = Vector3iUtil::create(corpus.block_size);
+
+	// Padded copies of inner blocks, like the ones meshing tasks gather from the map
+	StdVector<VoxelBuffer> blocks;
+	StdVector<Vector3i> origins;
+	Vector3i bpos;
+	for (bpos.z = 1; bpos.z < size_in_blocks.z - 1; ++bpos.z) {
+		for (bpos.x = 1; bpos.x < size_in_blocks.x - 1; ++bpos.x) {
+			for (bpos.y = 1; bpos.y < size_in_blocks.y - 1; ++bpos.y) {
+				const Vector3i origin = bpos * corpus.block_size;
+				blocks.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_DEFAULT));
+				VoxelBuffer &vb = blocks.back();
+				vb.copy_format(corpus.voxels);
+				vb.create(block_size + min_padding + max_padding);
+				for (const VoxelBuffer::ChannelId channel : CORPUS_CHANNELS) {
+					vb.copy_channel_from(
+							corpus.voxels, origin - min_padding, origin + block_size + max_padding, Vector3i(), channel
+					);
+				}
+				vb.compress_uniform_channels();
+				origins.push_back(origin);
+			}
+		}
+	}
+
+	// Not measured, it lets meshers allocate their thread-local caches
+	MesherStats stats;
+	for (unsigned int block_index = 0; block_index < blocks.size(); ++block_index) {
+		VoxelMesher::Input input{
+			blocks[block_index], nullptr, origins[block_index], 0, collision_hint, lod_hint, false
+		};
+		VoxelMesher::Output output;
+		mesher.build(output, input);
+
+		const unsigned int vertex_count = get_vertex_count(output);
+		stats.vertex_count += vertex_count;
+		stats.non_empty_block_count += vertex_count > 0;
+		++stats.block_count;
+	}
+
+	const uint64_t memory_before = OS::get_singleton()->get_static_memory_usage();
+
+	suite.run(name, 1, [&mesher, &blocks, &origins, collision_hint, lod_hint]() {
+		for (unsigned int block_index = 0; block_index < blocks.size(); ++block_index) {
+			VoxelMesher::Input input{
+				blocks[block_index], nullptr, origins[block_index], 0, collision_hint, lod_hint, false
+			};
+			VoxelMesher::Output output;
+			mesher.build(output, input);
+		}
+	});
+
+	// Outputs are freed by then, so memory held after all passes was allocated by the mesher itself
+	stats.retained_memory = int64_t(OS::get_singleton()->get_static_memory_usage()) - memory_before;
+
+	print_line(format(
+			"{}: {} vertices/block ({} of {} blocks not empty), memory retained {} bytes",
+			name,
+			stats.non_empty_block_count > 0 ? stats.vertex_count / stats.non_empty_block_count : 0,
+			stats.non_empty_block_count,
+			stats.block_count,
+			stats.retained_memory
+	));
+}
+
+Ref<VoxelBlockyLibrary> make_terrain_library() {
+	Ref<VoxelBlockyLibrary> library;
+	library.instantiate();
+	{
+		Ref<VoxelBlockyModelEmpty> air;
+		air.instantiate();
+		library->add_model(air);
+	}
+	// Grass and stone. Textures repeat, so greedy meshing can merge faces.
+	for (unsigned int i = 0; i < 2; ++i) {
+		Ref<VoxelBlockyModelCube> cube;
+		cube.instantiate();
+		cube->set_atlas_size_in_tiles(Vector2i(1, 1));
+		library->add_model(cube);
+	}
+	library->bake();
+	return library;
+}
+
+} // namespace
+
+void test_voxel_mesher_benchmark(testing::BenchmarkSuite &suite) {
+	const Vector3i size_in_blocks(10, 6, 10);
+
+	Corpus corpus;
+	OS &os = *OS::get_singleton();
+	if (os.has_environment(CORPUS_SAVE_ENV_VAR)) {
+		const String path = os.get_environment(CORPUS_SAVE_ENV_VAR);
+		ZN_TEST_ASSERT_MSG(load_corpus_from_save(corpus, size_in_blocks, path), "No blocks found in the save");
+	} else {
+		generate_corpus_from_graph(corpus, size_in_blocks);
+	}
+
+	print_line(format(
+			"Mesher benchmark corpus: {}, {} blocks of {}^3 voxels",
+			corpus.source,
+			Vector3iUtil::get_volume_u64(size_in_blocks - Vector3i(2, 2, 2)),
+			corpus.block_size
+	));
+
+	{
+		Ref<VoxelMesherTransvoxel> mesher;
+		mesher.instantiate();
+		run_mesher_benchmark(suite, "mesher_corpus_transvoxel", **mesher, corpus, false, false);
+
+		mesher->set_texturing_mode(VoxelMesherTransvoxel::TEXTURES_BLEND_4_OVER_16);
+		run_mesher_benchmark(suite, "mesher_corpus_transvoxel_textures", **mesher, corpus, false, false);
+		mesher->set_texturing_mode(VoxelMesherTransvoxel::TEXTURES_NONE);
+
+		// Transitions are only generated for terrains using LOD
+		run_mesher_benchmark(suite, "mesher_corpus_transvoxel_lod_transitions", **mesher, corpus, false, true);
+
+		mesher->set_mesh_optimization_enabled(true);
+		run_mesher_benchmark(
+				suite, "mesher_corpus_transvoxel_lod_transitions_mesh_optimization", **mesher, corpus, false, true
+		);
+	}
+	{
+		Ref<VoxelMesherBlocky> mesher;
+		mesher.instantiate();
+		mesher->set_library(make_terrain_library());
+		run_mesher_benchmark(suite, "mesher_corpus_blocky", **mesher, corpus, false, false);
+		run_mesher_benchmark(suite, "mesher_corpus_blocky_collision", **mesher, corpus, true, false);
+
+		mesher->set_greedy_meshing_enabled(true);
+		mesher->set_collision_greedy_meshing_enabled(true);
+		run_mesher_benchmark(suite, "mesher_corpus_blocky_greedy_collision", **mesher, corpus, true, false);
+	}
+	{
+		Ref<VoxelMesherCubes> mesher;
+		mesher.instantiate();
+		mesher->set_color_mode(VoxelMesherCubes::COLOR_RAW);
+		run_mesher_benchmark(suite, "mesher_corpus_cubes_greedy", **mesher, corpus, false, false);
+
+		mesher->set_greedy_meshing_enabled(false);
+		run_mesher_benchmark(suite, "mesher_corpus_cubes", **mesher, corpus, false, false);
+	}
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,122 @@
+#include "test_occlusion_culling.h"
+#include "../../terrain/occlusion_culling.h"
+#include "../../util/containers/std_unordered_map.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+using namespace occlusion_culling;
+
+void test_occlusion_culling_side_connectivity() {
+	const Vector3i size(4, 4, 4);
+	StdVector<uint8_t> opaque_voxels;
+	opaque_voxels.resize(Vector3iUtil::get_volume_u64(size), 0);
+
+	// Empty
+	ZN_TEST_ASSERT(compute_side_connectivity(to_span(opaque_voxels), size) == SIDE_CONNECTIVITY_ALL);
+
+	// Full
+	opaque_voxels.assign(opaque_voxels.size(), 1);
+	ZN_TEST_ASSERT(compute_side_connectivity(to_span(opaque_voxels), size) == 0);
+
+	// Cavity not touching any side
+	opaque_voxels[Vector3iUtil::get_zxy_index(Vector3i(1, 1, 1), size)] = 0;
+	opaque_voxels[Vector3iUtil::get_zxy_index(Vector3i(2, 1, 1), size)] = 0;
+	ZN_TEST_ASSERT(compute_side_connectivity(to_span(opaque_voxels), size) == 0);
+
+	// Tunnel going through along X
+	opaque_voxels.assign(opaque_voxels.size(), 1);
+	for (int x = 0; x < size.x; ++x) {
+		opaque_voxels[Vector3iUtil::get_zxy_index(Vector3i(x, 1, 1), size)] = 0;
+	}
+	{
+		const uint16_t connectivity = compute_side_connectivity(to_span(opaque_voxels), size);
+		ZN_TEST_ASSERT(connectivity == (1 << get_side_pair_index(Cube::SIDE_NEGATIVE_X, Cube::SIDE_POSITIVE_X)));
+		ZN_TEST_ASSERT(are_sides_connected(connectivity, Cube::SIDE_POSITIVE_X, Cube::SIDE_NEGATIVE_X));
+		ZN_TEST_ASSERT(!are_sides_connected(connectivity, Cube::SIDE_POSITIVE_X, Cube::SIDE_POSITIVE_Y));
+	}
+
+	// Wall splitting the block along X
+	opaque_voxels.assign(opaque_voxels.size(), 0);
+	for (int z = 0; z < size.z; ++z) {
+		for (int y = 0; y < size.y; ++y) {
+			opaque_voxels[Vector3iUtil::get_zxy_index(Vector3i(1, y, z), size)] = 1;
+		}
+	}
+	{
+		const uint16_t connectivity = compute_side_connectivity(to_span(opaque_voxels), size);
+		ZN_TEST_ASSERT(!are_sides_connected(connectivity, Cube::SIDE_NEGATIVE_X, Cube::SIDE_POSITIVE_X));
+		ZN_TEST_ASSERT(are_sides_connected(connectivity, Cube::SIDE_NEGATIVE_X, Cube::SIDE_POSITIVE_Y));
+		ZN_TEST_ASSERT(are_sides_connected(connectivity, Cube::SIDE_POSITIVE_X, Cube::SIDE_NEGATIVE_Z));
+		ZN_TEST_ASSERT(are_sides_connected(connectivity, Cube::SIDE_NEGATIVE_Y, Cube::SIDE_POSITIVE_Y));
+	}
+
+	// All pair indices are distinct and fit in the mask
+	uint16_t all_pairs = 0;
+	for (unsigned int side0 = 0; side0 < Cube::SIDE_COUNT; ++side0) {
+		for (unsigned int side1 = side0 + 1; side1 < Cube::SIDE_COUNT; ++side1) {
+			const uint16_t bit = 1 << get_side_pair_index(side0, side1);
+			ZN_TEST_ASSERT((all_pairs & bit) == 0);
+			all_pairs |= bit;
+		}
+	}
+	ZN_TEST_ASSERT(all_pairs == SIDE_CONNECTIVITY_ALL);
+	ZN_TEST_ASSERT(get_side_connectivity_from_sides_mask(0b111111) == SIDE_CONNECTIVITY_ALL);
+}
+
+void test_occlusion_culling_find_visible_blocks() {
+	StdUnorderedMap<Vector3i, uint16_t> blocks;
+
+	// Open space with a solid layer at y=-1, on top of a cave at y=-2 that opens at x=2
+	for (int z = -2; z <= 2; ++z) {
+		for (int x = -2; x <= 2; ++x) {
+			blocks[Vector3i(x, 0, z)] = SIDE_CONNECTIVITY_ALL;
+			blocks[Vector3i(x, -1, z)] = 0;
+			blocks[Vector3i(x, -2, z)] = SIDE_CONNECTIVITY_ALL;
+		}
+	}
+
+	StdVector<Vector3i> queue_positions;
+	StdVector<uint16_t> queue_states;
+	StdUnorderedSet<Vector3i> visited;
+
+	const Box3i bounds = Box3i::from_center_extents(Vector3i(), Vector3i(3, 3, 3));
+
+	auto get_connectivity = [&blocks](const Vector3i bpos, uint16_t &out_connectivity) {
+		auto it = blocks.find(bpos);
+		if (it == blocks.end()) {
+			return false;
+		}
+		out_connectivity = it->second;
+		return true;
+	};
+
+	unsigned int visit_count = 0;
+	auto visit = [&visit_count](const Vector3i) { ++visit_count; };
+
+	ZN_TEST_ASSERT(find_visible_blocks(
+			Vector3i(), bounds, get_connectivity, visit, queue_positions, queue_states, visited
+	));
+	ZN_TEST_ASSERT(visit_count == visited.size());
+	// Surface and the solid layer under it are visible, the cave isn't
+	ZN_TEST_ASSERT(visited.find(Vector3i(2, 0, -2)) != visited.end());
+	ZN_TEST_ASSERT(visited.find(Vector3i(1, -1, 1)) != visited.end());
+	ZN_TEST_ASSERT(visited.find(Vector3i(0, -2, 0)) == visited.end());
+	ZN_TEST_ASSERT(visited.size() == 50);
+
+	// Open a hole down to the cave
+	blocks[Vector3i(2, -1, 0)] = SIDE_CONNECTIVITY_ALL;
+	ZN_TEST_ASSERT(find_visible_blocks(
+			Vector3i(), bounds, get_connectivity, visit, queue_positions, queue_states, visited
+	));
+	ZN_TEST_ASSERT(visited.find(Vector3i(2, -2, 0)) != visited.end());
+	// Parts of the cave that would require going back up or toward the camera are not reached
+	ZN_TEST_ASSERT(visited.find(Vector3i(-2, -2, 0)) == visited.end());
+
+	// Camera outside of loaded blocks
+	ZN_TEST_ASSERT(!find_visible_blocks(
+			Vector3i(10, 0, 0), bounds, get_connectivity, visit, queue_positions, queue_states, visited
+	));
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,11 @@
+#ifndef VOXEL_TEST_OCCLUSION_CULLING_H
+#define VOXEL_TEST_OCCLUSION_CULLING_H
+
+namespace zylann::voxel::tests {
+
+void test_occlusion_culling_side_connectivity();
+void test_occlusion_culling_find_visible_blocks();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_OCCLUSION_CULLING_H
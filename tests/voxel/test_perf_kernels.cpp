@@ -0,0 +1,167 @@
+#include "test_perf_kernels.h"
+#include "../../generators/graph/voxel_generator_graph.h"
+#include "../../meshers/blocky/voxel_blocky_library.h"
+#include "../../meshers/blocky/voxel_blocky_model_cube.h"
+#include "../../meshers/blocky/voxel_blocky_model_empty.h"
+#include "../../meshers/blocky/voxel_mesher_blocky.h"
+#include "../../meshers/transvoxel/voxel_mesher_transvoxel.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../streams/voxel_block_serializer.h"
+#include "../../util/godot/core/array.h"
+#include "../../util/math/funcs.h"
+#include "../../util/noise/fast_noise_lite/fast_noise_lite.h"
+#include "../benchmarking.h"
+#include "../testing.h"
+
+#include <cmath>
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+const int BLOCK_SIZE = 16;
+
+// Rolling hills crossing the block, with types derived from the same shape so every mesher gets a similar surface
+void make_hills_block(VoxelBuffer &vb, Vector3i size) {
+	vb.create(size);
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_TYPE, VoxelBuffer::DEPTH_16_BIT);
+	vb.decompress_channel(VoxelBuffer::CHANNEL_SDF);
+	vb.decompress_channel(VoxelBuffer::CHANNEL_TYPE);
+
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			const float height = 0.5f * size.y + 3.f * std::sin(pos.x * 0.4f) * std::cos(pos.z * 0.3f);
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				const float sd = pos.y - height;
+				vb.set_voxel_f(math::clamp(sd * 0.1f, -1.f, 1.f), pos, VoxelBuffer::CHANNEL_SDF);
+				if (sd < 0.f) {
+					vb.set_voxel(sd > -2.f ? 1 : 2, pos, VoxelBuffer::CHANNEL_TYPE);
+				}
+			}
+		}
+	}
+}
+
+void run_mesher(testing::BenchmarkSuite &suite, const char *name, VoxelMesher &mesher) {
+	const unsigned int padding = mesher.get_minimum_padding() + mesher.get_maximum_padding();
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	make_hills_block(voxels, Vector3iUtil::create(BLOCK_SIZE + padding));
+
+	suite.run(name, 10, [&mesher, &voxels]() {
+		VoxelMesher::Input input{ voxels, nullptr, Vector3i(), 0, false, false, false };
+		VoxelMesher::Output output;
+		mesher.build(output, input);
+	});
+}
+
+} // namespace
+
+void test_perf_block_serializer(testing::BenchmarkSuite &suite) {
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	make_hills_block(voxels, Vector3iUtil::create(BLOCK_SIZE));
+
+	StdVector<uint8_t> data;
+	{
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxels);
+		ZN_TEST_ASSERT(result.success);
+		data = result.data;
+	}
+
+	suite.run("block_serializer_serialize_and_compress", 50, [&voxels]() {
+		BlockSerializer::SerializeResult result = BlockSerializer::serialize_and_compress(voxels);
+		ZN_ASSERT(result.success);
+	});
+
+	VoxelBuffer out_voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	suite.run("block_serializer_decompress_and_deserialize", 50, [&data, &out_voxels]() {
+		const bool success = BlockSerializer::decompress_and_deserialize(to_span_const(data), out_voxels);
+		ZN_ASSERT(success);
+	});
+}
+
+void test_perf_mesher_transvoxel(testing::BenchmarkSuite &suite) {
+	Ref<VoxelMesherTransvoxel> mesher;
+	mesher.instantiate();
+	run_mesher(suite, "mesher_transvoxel", **mesher);
+}
+
+void test_perf_mesher_blocky(testing::BenchmarkSuite &suite) {
+	Ref<VoxelBlockyLibrary> library;
+	library.instantiate();
+	{
+		Ref<VoxelBlockyModelEmpty> air;
+		air.instantiate();
+		library->add_model(air);
+	}
+	for (unsigned int i = 0; i < 2; ++i) {
+		Ref<VoxelBlockyModelCube> cube;
+		cube.instantiate();
+		library->add_model(cube);
+	}
+	library->bake();
+
+	Ref<VoxelMesherBlocky> mesher;
+	mesher.instantiate();
+	mesher->set_library(library);
+	run_mesher(suite, "mesher_blocky", **mesher);
+}
+
+// Hilly terrain made of 2D noise.
+//
+//     X --- FastNoise2D
+//      \/            \
+//      /\             \
+//     Z ----------- y + 24 * n --- OutputSDF
+//                    /
+//     Y ------------
+//
+void test_perf_graph_runtime(testing::BenchmarkSuite &suite) {
+	Ref<VoxelGeneratorGraph> generator;
+	generator.instantiate();
+	{
+		VoxelGraphFunction &g = **generator->get_main_function();
+		const uint32_t in_x = g.create_node(VoxelGraphFunction::NODE_INPUT_X, Vector2());
+		const uint32_t in_y = g.create_node(VoxelGraphFunction::NODE_INPUT_Y, Vector2());
+		const uint32_t in_z = g.create_node(VoxelGraphFunction::NODE_INPUT_Z, Vector2());
+		const uint32_t out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		const uint32_t n_noise = g.create_node(VoxelGraphFunction::NODE_FAST_NOISE_2D, Vector2());
+		const uint32_t n_expr = g.create_node(VoxelGraphFunction::NODE_EXPRESSION, Vector2());
+
+		Ref<ZN_FastNoiseLite> noise;
+		noise.instantiate();
+		noise->set_period(128.f);
+		noise->set_fractal_octaves(4);
+		g.set_node_param(n_noise, 0, noise);
+
+		g.set_node_param(n_expr, 0, "y + 24 * n");
+		PackedStringArray var_names;
+		var_names.push_back("y");
+		var_names.push_back("n");
+		g.set_expression_node_inputs(n_expr, var_names);
+
+		g.add_connection(in_x, 0, n_noise, 0);
+		g.add_connection(in_z, 0, n_noise, 1);
+		g.add_connection(in_y, 0, n_expr, 0);
+		g.add_connection(n_noise, 0, n_expr, 1);
+		g.add_connection(n_expr, 0, out_sdf, 0);
+
+		const pg::CompilationResult result = generator->compile(false);
+		ZN_TEST_ASSERT_MSG(
+				result.success,
+				String("Failed to compile graph: {0}: {1}").format(varray(result.node_id, result.message))
+		);
+	}
+
+	VoxelBuffer voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	voxels.create(Vector3iUtil::create(BLOCK_SIZE));
+	// Blocks crossing the surface, so the graph can't skip them with range analysis
+	const Vector3i origin(0, -BLOCK_SIZE / 2, 0);
+
+	suite.run("graph_runtime_generate_block", 10, [&generator, &voxels, origin]() {
+		generator->generate_block(VoxelGenerator::VoxelQueryData{ voxels, origin, 0 });
+	});
+}
+
+} // namespace zylann::voxel::tests
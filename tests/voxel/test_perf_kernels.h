@@ -0,0 +1,17 @@
+#ifndef VOXEL_TEST_PERF_KERNELS_H
+#define VOXEL_TEST_PERF_KERNELS_H
+
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
+namespace zylann::voxel::tests {
+
+void test_perf_block_serializer(testing::BenchmarkSuite &suite);
+void test_perf_mesher_transvoxel(testing::BenchmarkSuite &suite);
+void test_perf_mesher_blocky(testing::BenchmarkSuite &suite);
+void test_perf_graph_runtime(testing::BenchmarkSuite &suite);
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_PERF_KERNELS_H
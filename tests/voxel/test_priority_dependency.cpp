@@ -0,0 +1,222 @@
+#include "test_priority_dependency.h"
+#include "../../engine/priority_dependency.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/math/funcs.h"
+#include "../../util/memory/memory.h"
+#include "../benchmarking.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+void test_priority_dependency_view_cone() {
+	std::shared_ptr<PriorityDependency::ViewersData> viewers_data =
+			make_shared_instance<PriorityDependency::ViewersData>();
+	viewers_data->viewers.resize(1);
+	viewers_data->view_cones.resize(1);
+	viewers_data->viewers[0] = Vector3f(0, 100, 0);
+	viewers_data->viewers_count = 1;
+
+	struct L {
+		static uint8_t get_band0(
+				const std::shared_ptr<PriorityDependency::ViewersData> &viewers_data,
+				const Vector3f position,
+				float &out_distance_sq
+		) {
+			PriorityDependency dep;
+			dep.shared = viewers_data;
+			dep.world_position = position;
+			dep.drop_distance_squared = 0.f;
+			return dep.evaluate(0, 0, &out_distance_sq).band0;
+		}
+	};
+
+	const Vector3f ahead(0, 100, -200);
+	const Vector3f behind(0, 100, 200);
+	const Vector3f aside(200, 100, 0);
+	const Vector3f below(0, -100, 0);
+	const Vector3f near_behind(0, 100, 20);
+	const Vector3f near_ahead(0, 100, -20);
+
+	float ahead_distance_sq;
+	float behind_distance_sq;
+	float distance_sq;
+
+	// Without view cone, only distance matters
+	ZN_TEST_ASSERT(
+			L::get_band0(viewers_data, ahead, ahead_distance_sq) ==
+			L::get_band0(viewers_data, behind, behind_distance_sq)
+	);
+	ZN_TEST_ASSERT(
+			L::get_band0(viewers_data, aside, distance_sq) == L::get_band0(viewers_data, below, distance_sq)
+	);
+
+	PriorityDependency::ViewCone &cone = viewers_data->view_cones[0];
+	cone.direction = Vector3f(0, 0, -1);
+	cone.cos_half_angle = Math::cos(math::deg_to_rad(45.f));
+
+	const uint8_t ahead_band0 = L::get_band0(viewers_data, ahead, ahead_distance_sq);
+	const uint8_t aside_band0 = L::get_band0(viewers_data, aside, distance_sq);
+	const uint8_t behind_band0 = L::get_band0(viewers_data, behind, behind_distance_sq);
+	const uint8_t below_band0 = L::get_band0(viewers_data, below, distance_sq);
+
+	ZN_TEST_ASSERT(ahead_band0 > aside_band0);
+	ZN_TEST_ASSERT(aside_band0 > behind_band0);
+	// Blocks deep below are assumed to be hidden by ground
+	ZN_TEST_ASSERT(aside_band0 > below_band0);
+
+	// The actual distance is still reported, so tasks don't get dropped because they are out of view
+	ZN_TEST_ASSERT(Math::is_equal_approx(ahead_distance_sq, behind_distance_sq));
+	ZN_TEST_ASSERT(Math::is_equal_approx(ahead_distance_sq, 200.f * 200.f));
+
+	// Blocks around the viewer are needed regardless of where it looks
+	ZN_TEST_ASSERT(
+			L::get_band0(viewers_data, near_ahead, distance_sq) == L::get_band0(viewers_data, near_behind, distance_sq)
+	);
+}
+
+namespace {
+
+// Viewers spread over a large world, like players of a multiplayer server
+struct ManyViewersSetup {
+	static constexpr unsigned int VIEWER_COUNT = 100;
+	static constexpr unsigned int VIEW_DISTANCE = 512;
+
+	// Viewers indexed with a grid
+	PriorityDependency dep;
+	// Same viewers without a grid, which checks all of them
+	PriorityDependency linear_dep;
+	// Tasks around viewers, and some far from all of them
+	StdVector<Vector3f> task_positions;
+
+	ManyViewersSetup() {
+		const float world_size = 8000.f;
+
+		RandomPCG rng;
+		rng.seed(131183);
+
+		std::shared_ptr<PriorityDependency::ViewersData> viewers_data =
+				make_shared_instance<PriorityDependency::ViewersData>();
+		viewers_data->set_capacity(VIEWER_COUNT);
+		for (unsigned int i = 0; i < VIEWER_COUNT; ++i) {
+			viewers_data->viewers[i] =
+					Vector3f(rng.randf() * world_size, rng.randf() * 200.f, rng.randf() * world_size);
+			// Some viewers look in a direction, others don't
+			if ((i % 2) == 0) {
+				PriorityDependency::ViewCone &cone = viewers_data->view_cones[i];
+				const float angle = rng.randf() * math::TAU_32;
+				cone.direction = Vector3f(Math::cos(angle), 0.f, Math::sin(angle));
+				cone.cos_half_angle = Math::cos(math::deg_to_rad(45.f));
+			}
+		}
+		viewers_data->viewers_count = VIEWER_COUNT;
+
+		std::shared_ptr<PriorityDependency::ViewersData> linear_viewers_data =
+				make_shared_instance<PriorityDependency::ViewersData>();
+		linear_viewers_data->set_capacity(VIEWER_COUNT);
+		linear_viewers_data->viewers = viewers_data->viewers;
+		linear_viewers_data->view_cones = viewers_data->view_cones;
+		linear_viewers_data->viewers_count = VIEWER_COUNT;
+
+		viewers_data->grids[0].build(
+				to_span(viewers_data->viewers), math::get_next_power_of_two_32_shift(VIEW_DISTANCE)
+		);
+
+		for (unsigned int i = 0; i < 10000; ++i) {
+			const Vector3f viewer_position = viewers_data->viewers[rng.rand(VIEWER_COUNT)];
+			const Vector3f offset(rng.randf() * 2.f - 1.f, rng.randf() * 2.f - 1.f, rng.randf() * 2.f - 1.f);
+			task_positions.push_back(viewer_position + offset * static_cast<float>(VIEW_DISTANCE));
+		}
+		for (unsigned int i = 0; i < 100; ++i) {
+			task_positions.push_back(
+					Vector3f(rng.randf() * 4.f - 2.f, rng.randf() - 0.5f, rng.randf() * 4.f - 2.f) * world_size * 4.f
+			);
+		}
+
+		dep.shared = viewers_data;
+		dep.drop_distance_squared = 0.f;
+
+		linear_dep.shared = linear_viewers_data;
+		linear_dep.drop_distance_squared = 0.f;
+	}
+};
+
+unsigned int evaluate_all_priorities(PriorityDependency &dep, Span<const Vector3f> task_positions) {
+	unsigned int checksum = 0;
+	for (const Vector3f position : task_positions) {
+		dep.world_position = position;
+		checksum += dep.evaluate(0, 0, nullptr).band0;
+	}
+	return checksum;
+}
+
+} // namespace
+
+void test_priority_dependency_many_viewers() {
+	ManyViewersSetup setup;
+
+	for (const Vector3f position : setup.task_positions) {
+		setup.dep.world_position = position;
+		setup.linear_dep.world_position = position;
+
+		float distance_sq;
+		float expected_distance_sq;
+		const TaskPriority priority = setup.dep.evaluate(0, 0, &distance_sq);
+		const TaskPriority expected_priority = setup.linear_dep.evaluate(0, 0, &expected_distance_sq);
+
+		ZN_TEST_ASSERT(priority.band0 == expected_priority.band0);
+		ZN_TEST_ASSERT(Math::is_equal_approx(distance_sq, expected_distance_sq));
+	}
+}
+
+void test_priority_dependency_many_viewers_benchmark(testing::BenchmarkSuite &suite) {
+	ManyViewersSetup setup;
+
+	unsigned int checksum = 0;
+	unsigned int linear_checksum = 0;
+
+	suite.run("priority_dependency_many_viewers_grid", 1, [&setup, &checksum]() {
+		checksum = evaluate_all_priorities(setup.dep, to_span(setup.task_positions));
+	});
+	suite.run("priority_dependency_many_viewers_linear", 1, [&setup, &linear_checksum]() {
+		linear_checksum = evaluate_all_priorities(setup.linear_dep, to_span(setup.task_positions));
+	});
+
+	ZN_TEST_ASSERT(checksum == linear_checksum);
+}
+
+void test_priority_dependency_volume_task_priority() {
+	std::shared_ptr<PriorityDependency::ViewersData> viewers_data =
+			make_shared_instance<PriorityDependency::ViewersData>();
+	viewers_data->viewers.resize(1);
+	viewers_data->view_cones.resize(1);
+	viewers_data->viewers[0] = Vector3f(0, 0, 0);
+	viewers_data->viewers_count = 1;
+
+	PriorityDependency near_dep;
+	near_dep.shared = viewers_data;
+	near_dep.world_position = Vector3f(10, 0, 0);
+	near_dep.drop_distance_squared = 0.f;
+
+	PriorityDependency far_dep = near_dep;
+	far_dep.world_position = Vector3f(1000, 0, 0);
+
+	float distance_sq;
+
+	// Same volume priority, closer tasks come first
+	ZN_TEST_ASSERT(near_dep.evaluate(0, 10, &distance_sq) > far_dep.evaluate(0, 10, &distance_sq));
+
+	// A volume with higher priority has its tasks run first, regardless of distance, LOD and task type
+	far_dep.set_volume_task_priority(1);
+	ZN_TEST_ASSERT(far_dep.evaluate(3, 0, &distance_sq) > near_dep.evaluate(0, 10, &distance_sq));
+
+	far_dep.set_volume_task_priority(-1);
+	ZN_TEST_ASSERT(far_dep.evaluate(0, 10, &distance_sq) < near_dep.evaluate(0, 10, &distance_sq));
+
+	// Out of range priorities don't wrap around
+	far_dep.set_volume_task_priority(-1000);
+	ZN_TEST_ASSERT(far_dep.band3 == 0);
+	far_dep.set_volume_task_priority(1000);
+	ZN_TEST_ASSERT(far_dep.band3 == TaskPriority::BAND_MAX);
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,17 @@
+#ifndef VOXEL_TEST_PRIORITY_DEPENDENCY_H
+#define VOXEL_TEST_PRIORITY_DEPENDENCY_H
+
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
+namespace zylann::voxel::tests {
+
+void test_priority_dependency_view_cone();
+void test_priority_dependency_many_viewers();
+void test_priority_dependency_many_viewers_benchmark(testing::BenchmarkSuite &suite);
+void test_priority_dependency_volume_task_priority();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_PRIORITY_DEPENDENCY_H
@@ -163,6 +163,86 @@ void test_region_file() {
 			ZN_TEST_ASSERT(load_error == OK);
 			ZN_TEST_ASSERT(it->second.voxels.equals(loaded_voxel_buffer));
 		}
+
+		// Read back with memory mapping. Also check the mapping sees writes done after it was created.
+		region_file.set_memory_mapped_reads_enabled(true);
+		for (int pass = 0; pass < 2; ++pass) {
+			for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+				VoxelBuffer loaded_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+				const Error load_error = region_file.load_block(it->first, loaded_voxel_buffer);
+				ZN_TEST_ASSERT(load_error == OK);
+				ZN_TEST_ASSERT(it->second.voxels.equals(loaded_voxel_buffer));
+			}
+			for (int i = 0; i < 20; ++i) {
+				const Vector3i pos = Vector3i( //
+						rng.rand() % uint32_t(region_size.x), //
+						rng.rand() % uint32_t(region_size.y), //
+						rng.rand() % uint32_t(region_size.z) //
+				);
+				generator.generate(voxel_buffer);
+				const Error save_error = region_file.save_block(pos, voxel_buffer);
+				ZN_TEST_ASSERT(save_error == OK);
+				buffers[pos].voxels = std::move(voxel_buffer);
+			}
+		}
+		region_file.set_memory_mapped_reads_enabled(false);
+
+		// Read back all blocks in one batch. Also check unsaved writes are seen.
+		region_file.set_async_reads_enabled(true);
+		for (int pass = 0; pass < 2; ++pass) {
+			StdVector<Vector3i> positions;
+			StdVector<VoxelBuffer> loaded_voxel_buffers;
+			for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+				positions.push_back(it->first);
+				loaded_voxel_buffers.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_DEFAULT));
+			}
+			StdVector<VoxelBuffer *> loaded_voxel_buffer_ptrs;
+			for (VoxelBuffer &vb : loaded_voxel_buffers) {
+				loaded_voxel_buffer_ptrs.push_back(&vb);
+			}
+			StdVector<Error> errors;
+			errors.resize(positions.size(), FAILED);
+
+			region_file.load_blocks(to_span_const(positions), to_span_const(loaded_voxel_buffer_ptrs), to_span(errors));
+
+			for (unsigned int i = 0; i < positions.size(); ++i) {
+				ZN_TEST_ASSERT(errors[i] == OK);
+				ZN_TEST_ASSERT(buffers[positions[i]].voxels.equals(loaded_voxel_buffers[i]));
+			}
+
+			for (int i = 0; i < 20; ++i) {
+				const Vector3i pos = Vector3i( //
+						rng.rand() % uint32_t(region_size.x), //
+						rng.rand() % uint32_t(region_size.y), //
+						rng.rand() % uint32_t(region_size.z) //
+				);
+				generator.generate(voxel_buffer);
+				const Error save_error = region_file.save_block(pos, voxel_buffer);
+				ZN_TEST_ASSERT(save_error == OK);
+				buffers[pos].voxels = std::move(voxel_buffer);
+			}
+		}
+		region_file.set_async_reads_enabled(false);
+
+		// Compact, with and without recompression. Blocks must remain the same.
+		for (int pass = 0; pass < 2; ++pass) {
+			const Error compact_error = region_file.compact(pass == 1);
+			ZN_TEST_ASSERT(compact_error == OK);
+			ZN_TEST_ASSERT(region_file.is_open());
+
+			for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+				ZN_TEST_ASSERT(region_file.has_block(it->first));
+				VoxelBuffer loaded_voxel_buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+				const Error load_error = region_file.load_block(it->first, loaded_voxel_buffer);
+				ZN_TEST_ASSERT(load_error == OK);
+				ZN_TEST_ASSERT(it->second.voxels.equals(loaded_voxel_buffer));
+			}
+		}
+
+		// Nothing left to remove after the file was compacted
+		uint64_t saved_bytes = 1;
+		ZN_TEST_ASSERT(region_file.compact(false, &saved_bytes) == OK);
+		ZN_TEST_ASSERT(saved_bytes == 0);
 	}
 }
 
@@ -198,6 +278,151 @@ void test_voxel_stream_region_files() {
 		VoxelStream::VoxelQueryData q{ buffer, Vector3(cycle / 16, 0, 0), 0, VoxelStream::RESULT_ERROR };
 		stream->save_voxel_block(q);
 	}
+
+	// Load everything back in parts, while regions are still open
+	StdVector<VoxelStream::FullLoadingPart> parts;
+	ZN_TEST_ASSERT(stream->get_load_all_blocks_parts(4, parts));
+	VoxelStream::FullLoadingResult result;
+	for (const VoxelStream::FullLoadingPart &part : parts) {
+		stream->load_all_blocks_part(part, result);
+	}
+	ZN_TEST_ASSERT(result.blocks.size() == 1000 / 16 + 1);
+	for (const VoxelStream::FullLoadingResult::Block &block : result.blocks) {
+		ZN_TEST_ASSERT(block.voxels != nullptr);
+		ZN_TEST_ASSERT(block.voxels->get_size() == Vector3iUtil::create(block_size));
+		ZN_TEST_ASSERT(block.position.x >= 0 && block.position.x <= 1000 / 16);
+	}
+}
+
+void test_voxel_stream_region_files_existence_index() {
+	const int block_size_po2 = 4;
+	const int block_size = 1 << block_size_po2;
+
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	struct L {
+		static VoxelStream::ResultCode load(VoxelStreamRegionFiles &stream, Vector3i bpos) {
+			VoxelBuffer buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+			buffer.create(Vector3iUtil::create(block_size));
+			VoxelStream::VoxelQueryData q{ buffer, bpos, 0, VoxelStream::RESULT_ERROR };
+			stream.load_voxel_block(q);
+			if (q.result == VoxelStream::RESULT_BLOCK_FOUND) {
+				ZN_TEST_ASSERT(buffer.get_voxel(Vector3i(1, 2, 3), 0) == static_cast<uint64_t>(bpos.x + 1));
+			}
+			return q.result;
+		}
+
+		static int64_t get_skipped_loads(const VoxelStreamRegionFiles &stream) {
+			const Dictionary stats = stream.get_statistics();
+			return stats["existence_index_skipped_loads"];
+		}
+	};
+
+	// Default region size is 16 blocks
+	{
+		Ref<VoxelStreamRegionFiles> stream;
+		stream.instantiate();
+		stream->set_block_size_po2(block_size_po2);
+		stream->set_directory(test_dir.get_path());
+
+		for (const int x : { 0, 3 }) {
+			VoxelBuffer buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+			buffer.create(Vector3iUtil::create(block_size));
+			buffer.set_voxel(x + 1, Vector3i(1, 2, 3), 0);
+			VoxelStream::VoxelQueryData q{ buffer, Vector3i(x, 0, 0), 0, VoxelStream::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		}
+
+		ZN_TEST_ASSERT(L::load(**stream, Vector3i(3, 0, 0)) == VoxelStream::RESULT_BLOCK_FOUND);
+		// Region file exists but not that block
+		ZN_TEST_ASSERT(L::load(**stream, Vector3i(1, 0, 0)) == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		ZN_TEST_ASSERT(L::get_skipped_loads(**stream) == 1);
+		// Region file doesn't exist
+		ZN_TEST_ASSERT(L::load(**stream, Vector3i(100, 0, 0)) == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		ZN_TEST_ASSERT(L::get_skipped_loads(**stream) == 2);
+
+		stream->flush();
+	}
+	{
+		// The index gets rebuilt from files
+		Ref<VoxelStreamRegionFiles> stream;
+		stream.instantiate();
+		stream->set_directory(test_dir.get_path());
+
+		ZN_TEST_ASSERT(L::load(**stream, Vector3i(100, 0, 0)) == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		ZN_TEST_ASSERT(L::get_skipped_loads(**stream) == 1);
+		// The header of the region has to be read first
+		ZN_TEST_ASSERT(L::load(**stream, Vector3i(1, 0, 0)) == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		ZN_TEST_ASSERT(L::get_skipped_loads(**stream) == 1);
+		ZN_TEST_ASSERT(L::load(**stream, Vector3i(2, 0, 0)) == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		ZN_TEST_ASSERT(L::get_skipped_loads(**stream) == 2);
+		ZN_TEST_ASSERT(L::load(**stream, Vector3i(0, 0, 0)) == VoxelStream::RESULT_BLOCK_FOUND);
+		ZN_TEST_ASSERT(L::load(**stream, Vector3i(3, 0, 0)) == VoxelStream::RESULT_BLOCK_FOUND);
+	}
+}
+
+void test_voxel_stream_region_files_header_cache() {
+	const int block_size_po2 = 4;
+	const int block_size = 1 << block_size_po2;
+	// Default region size is 16 blocks
+	const Vector3i region_b_offset(16, 0, 0);
+
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	struct L {
+		static void save(VoxelStreamRegionFiles &stream, Vector3i bpos) {
+			VoxelBuffer buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+			buffer.create(Vector3iUtil::create(block_size));
+			buffer.set_voxel(bpos.x + bpos.z + 1, Vector3i(1, 2, 3), 0);
+			VoxelStream::VoxelQueryData q{ buffer, bpos, 0, VoxelStream::RESULT_ERROR };
+			stream.save_voxel_block(q);
+		}
+
+		static void check_load(VoxelStreamRegionFiles &stream, Vector3i bpos) {
+			VoxelBuffer buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+			buffer.create(Vector3iUtil::create(block_size));
+			VoxelStream::VoxelQueryData q{ buffer, bpos, 0, VoxelStream::RESULT_ERROR };
+			stream.load_voxel_block(q);
+			ZN_TEST_ASSERT(q.result == VoxelStream::RESULT_BLOCK_FOUND);
+			ZN_TEST_ASSERT(buffer.get_voxel(Vector3i(1, 2, 3), 0) == static_cast<uint64_t>(bpos.x + bpos.z + 1));
+		}
+
+		static void check_stats(const VoxelStreamRegionFiles &stream, int64_t hits, int64_t misses) {
+			const Dictionary stats = stream.get_statistics();
+			ZN_TEST_ASSERT(int64_t(stats["open_regions"]) == 1);
+			ZN_TEST_ASSERT(int64_t(stats["region_header_cache_hits"]) == hits);
+			ZN_TEST_ASSERT(int64_t(stats["region_header_cache_misses"]) == misses);
+		}
+	};
+
+	Ref<VoxelStreamRegionFiles> stream;
+	stream.instantiate();
+	stream->set_block_size_po2(block_size_po2);
+	stream->set_directory(test_dir.get_path());
+	// Switching between two regions closes the other one each time
+	stream->set_max_open_regions(1);
+
+	L::save(**stream, Vector3i(0, 0, 0));
+	L::save(**stream, region_b_offset);
+	L::check_stats(**stream, 0, 2);
+
+	L::check_load(**stream, Vector3i(0, 0, 0));
+	L::check_stats(**stream, 1, 2);
+
+	// The header changes while the region is open, the cached one must be updated when it gets closed
+	L::save(**stream, Vector3i(0, 0, 1));
+	L::check_load(**stream, region_b_offset);
+	L::check_load(**stream, Vector3i(0, 0, 1));
+	L::check_load(**stream, Vector3i(0, 0, 0));
+	L::check_stats(**stream, 3, 2);
+
+	// Headers have to be read again without the cache
+	stream->set_max_cached_region_headers(0);
+	L::check_load(**stream, region_b_offset);
+	L::check_load(**stream, Vector3i(0, 0, 1));
+	L::check_stats(**stream, 3, 4);
 }
 
 } // namespace zylann::voxel::tests
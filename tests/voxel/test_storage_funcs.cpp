@@ -2,6 +2,8 @@
 #include "../../storage/funcs.h"
 #include "../../storage/materials_4i4w.h"
 #include "../../util/containers/std_vector.h"
+#include "../../util/io/log.h"
+#include "../benchmarking.h"
 #include "../testing.h"
 
 namespace zylann::voxel::tests {
@@ -215,4 +217,79 @@ void test_transform_3d_array_zxy() {
 	}
 }
 
+void test_morton_layout_benchmark(testing::BenchmarkSuite &suite) {
+	const unsigned int size_po2 = 5;
+	const int size = 1 << size_po2;
+	const unsigned int volume = Vector3iUtil::get_volume_u64(Vector3iUtil::create(size));
+
+	StdVector<int16_t> zxy_sdf;
+	zxy_sdf.resize(volume);
+	for (unsigned int i = 0; i < volume; ++i) {
+		zxy_sdf[i] = int(i * 2654435761u >> 20) - 2048;
+	}
+
+	StdVector<int16_t> morton_sdf;
+	morton_sdf.resize(volume);
+	copy_zxy_to_morton(to_span_const(zxy_sdf), to_span(morton_sdf), size_po2);
+
+	StdVector<int16_t> roundtrip_sdf;
+	roundtrip_sdf.resize(volume);
+	copy_morton_to_zxy(to_span_const(morton_sdf), to_span(roundtrip_sdf), size_po2);
+	ZN_TEST_ASSERT(roundtrip_sdf == zxy_sdf);
+
+	// Same access pattern as the Transvoxel mesher gathering the 8 corners of every cell, here counting cells crossed
+	// by the isosurface
+
+	unsigned int zxy_count = 0;
+	suite.run("morton_layout_cell_corners_zxy", 10, [&zxy_sdf, &zxy_count, size]() {
+		zxy_count = 0;
+		const unsigned int n010 = 1;
+		const unsigned int n100 = size;
+		const unsigned int n001 = size * size;
+		Vector3i pos;
+		for (pos.z = 0; pos.z < size - 1; ++pos.z) {
+			for (pos.x = 0; pos.x < size - 1; ++pos.x) {
+				unsigned int i = Vector3iUtil::get_zxy_index(pos.x, 0, pos.z, size, size);
+				for (pos.y = 0; pos.y < size - 1; ++pos.y, ++i) {
+					const int16_t *d = zxy_sdf.data();
+					const unsigned int signs = (d[i] < 0) + (d[i + n010] < 0) + (d[i + n100] < 0) +
+							(d[i + n100 + n010] < 0) + (d[i + n001] < 0) + (d[i + n001 + n010] < 0) +
+							(d[i + n001 + n100] < 0) + (d[i + n001 + n100 + n010] < 0);
+					zxy_count += (signs != 0 && signs != 8);
+				}
+			}
+		}
+	});
+
+	unsigned int morton_count = 0;
+	suite.run("morton_layout_cell_corners_morton", 10, [&morton_sdf, &morton_count, size]() {
+		morton_count = 0;
+		using namespace math;
+		const uint32_t dx = morton_spread_bits_3d(1) << 1;
+		const uint32_t dy = morton_spread_bits_3d(1);
+		const uint32_t dz = morton_spread_bits_3d(1) << 2;
+		Vector3i pos;
+		for (pos.z = 0; pos.z < size - 1; ++pos.z) {
+			for (pos.x = 0; pos.x < size - 1; ++pos.x) {
+				for (pos.y = 0; pos.y < size - 1; ++pos.y) {
+					const int16_t *d = morton_sdf.data();
+					const uint32_t i000 = encode_morton_3d(pos);
+					const uint32_t i010 = add_morton_3d(i000, dy, MORTON_MASK_Y);
+					const uint32_t i100 = add_morton_3d(i000, dx, MORTON_MASK_X);
+					const uint32_t i110 = add_morton_3d(i100, dy, MORTON_MASK_Y);
+					const uint32_t i001 = add_morton_3d(i000, dz, MORTON_MASK_Z);
+					const uint32_t i011 = add_morton_3d(i001, dy, MORTON_MASK_Y);
+					const uint32_t i101 = add_morton_3d(i001, dx, MORTON_MASK_X);
+					const uint32_t i111 = add_morton_3d(i101, dy, MORTON_MASK_Y);
+					const unsigned int signs = (d[i000] < 0) + (d[i010] < 0) + (d[i100] < 0) + (d[i110] < 0) +
+							(d[i001] < 0) + (d[i011] < 0) + (d[i101] < 0) + (d[i111] < 0);
+					morton_count += (signs != 0 && signs != 8);
+				}
+			}
+		}
+	});
+
+	ZN_TEST_ASSERT(zxy_count == morton_count);
+}
+
 } // namespace zylann::voxel::tests
@@ -1,11 +1,16 @@
 #ifndef VOXEL_TEST_STORAGE_FUNCS_H
 #define VOXEL_TEST_STORAGE_FUNCS_H
 
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
 namespace zylann::voxel::tests {
 
 void test_encode_weights_packed_u16();
 void test_copy_3d_region_zxy();
 void test_transform_3d_array_zxy();
+void test_morton_layout_benchmark(testing::BenchmarkSuite &suite);
 
 } // namespace zylann::voxel::tests
 
@@ -0,0 +1,465 @@
+#include "test_stream_benchmark.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../streams/compressed_data.h"
+#include "../../streams/region/voxel_stream_region_files.h"
+#include "../../streams/sqlite/voxel_stream_sqlite.h"
+#include "../../streams/voxel_stream_memory.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/godot/classes/directory.h"
+#include "../../util/godot/classes/file_access.h"
+#include "../../util/godot/classes/json.h"
+#include "../../util/godot/core/array.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/math/funcs.h"
+#include "../../util/profiling_clock.h"
+#include "../../util/string/format.h"
+#include "../../util/thread/thread.h"
+#include "../benchmarking.h"
+#include "../testing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+struct WorldParams {
+	int block_size_po2 = 4;
+	Vector3i size_in_blocks = Vector3i(8, 4, 8);
+	// Proportion of blocks modified by players. Edits make blocks non-uniform even far from the surface.
+	float edit_density = 0.25f;
+	uint64_t seed = 131183;
+};
+
+struct SyntheticWorld {
+	StdVector<Vector3i> positions;
+	StdVector<VoxelBuffer> blocks;
+};
+
+// Heightmap terrain, where blocks far above or below the surface are uniform unless they were edited
+void generate_synthetic_world(const WorldParams &params, SyntheticWorld &world) {
+	const int block_size = 1 << params.block_size_po2;
+	const float base_height = 0.4f * params.size_in_blocks.y * block_size;
+	const float amplitude = 0.75f * block_size;
+
+	RandomPCG rng;
+	rng.seed(params.seed);
+
+	StdVector<float> heights;
+	heights.resize(block_size * block_size);
+
+	Vector3i bpos;
+	for (bpos.z = 0; bpos.z < params.size_in_blocks.z; ++bpos.z) {
+		for (bpos.x = 0; bpos.x < params.size_in_blocks.x; ++bpos.x) {
+			const Vector3i column_origin = bpos * block_size;
+
+			float min_height = base_height + amplitude;
+			float max_height = base_height - amplitude;
+			for (int z = 0; z < block_size; ++z) {
+				for (int x = 0; x < block_size; ++x) {
+					const float gx = column_origin.x + x;
+					const float gz = column_origin.z + z;
+					const float h = base_height + amplitude * std::sin(gx * 0.05f) * std::cos(gz * 0.07f);
+					heights[x + z * block_size] = h;
+					min_height = math::min(min_height, h);
+					max_height = math::max(max_height, h);
+				}
+			}
+
+			for (bpos.y = 0; bpos.y < params.size_in_blocks.y; ++bpos.y) {
+				world.positions.push_back(bpos);
+				world.blocks.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_DEFAULT));
+				VoxelBuffer &vb = world.blocks.back();
+				vb.create(Vector3iUtil::create(block_size));
+				vb.set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+				vb.set_channel_depth(VoxelBuffer::CHANNEL_TYPE, VoxelBuffer::DEPTH_16_BIT);
+
+				const int origin_y = bpos.y * block_size;
+
+				if (origin_y > max_height + 2.f) {
+					vb.clear_channel_f(VoxelBuffer::CHANNEL_SDF, 1.f);
+					vb.clear_channel(VoxelBuffer::CHANNEL_TYPE, 0);
+
+				} else if (origin_y + block_size < min_height - 2.f) {
+					vb.clear_channel_f(VoxelBuffer::CHANNEL_SDF, -1.f);
+					vb.clear_channel(VoxelBuffer::CHANNEL_TYPE, 2);
+
+				} else {
+					Vector3i pos;
+					for (pos.z = 0; pos.z < block_size; ++pos.z) {
+						for (pos.x = 0; pos.x < block_size; ++pos.x) {
+							const float h = heights[pos.x + pos.z * block_size];
+							for (pos.y = 0; pos.y < block_size; ++pos.y) {
+								const float sd = (origin_y + pos.y) - h;
+								vb.set_voxel_f(math::clamp(sd * 0.1f, -1.f, 1.f), pos, VoxelBuffer::CHANNEL_SDF);
+								vb.set_voxel(sd < -2.f ? 2 : (sd < 0.f ? 1 : 0), pos, VoxelBuffer::CHANNEL_TYPE);
+							}
+						}
+					}
+				}
+
+				if (rng.randf() < params.edit_density) {
+					// A few boxes of another material, like placed blocks or dug tunnels
+					const unsigned int edit_count = 1 + rng.rand(3);
+					for (unsigned int i = 0; i < edit_count; ++i) {
+						const Vector3i min_pos(rng.rand(block_size), rng.rand(block_size), rng.rand(block_size));
+						const Vector3i max_pos = min_pos + Vector3iUtil::create(1 + rng.rand(block_size / 2));
+						// Clamped by the buffer
+						vb.fill_area(3, min_pos, max_pos, VoxelBuffer::CHANNEL_TYPE);
+					}
+				}
+
+				vb.compress_uniform_channels();
+			}
+		}
+	}
+}
+
+enum StreamType { //
+	STREAM_MEMORY,
+	STREAM_SQLITE,
+	STREAM_REGION_FILES,
+	STREAM_TYPE_COUNT
+};
+
+const char *get_stream_type_name(StreamType type) {
+	switch (type) {
+		case STREAM_MEMORY:
+			return "memory";
+		case STREAM_SQLITE:
+			return "sqlite";
+		case STREAM_REGION_FILES:
+			return "region_files";
+		default:
+			ZN_CRASH();
+			return "";
+	}
+}
+
+Ref<VoxelStream> create_stream(StreamType type, bool zstd, int block_size_po2, const String &directory) {
+	switch (type) {
+		case STREAM_MEMORY: {
+			Ref<VoxelStreamMemory> stream;
+			stream.instantiate();
+			return stream;
+		}
+		case STREAM_SQLITE: {
+			Ref<VoxelStreamSQLite> stream;
+			stream.instantiate();
+			stream->set_compression(zstd ? VoxelStreamSQLite::COMPRESSION_ZSTD : VoxelStreamSQLite::COMPRESSION_LZ4);
+			stream->set_database_path(directory.path_join("database.sqlite"));
+			return stream;
+		}
+		case STREAM_REGION_FILES: {
+			Ref<VoxelStreamRegionFiles> stream;
+			stream.instantiate();
+			stream->set_compression(
+					zstd ? VoxelStreamRegionFiles::COMPRESSION_ZSTD : VoxelStreamRegionFiles::COMPRESSION_LZ4
+			);
+			stream->set_block_size_po2(block_size_po2);
+			stream->set_directory(directory);
+			return stream;
+		}
+		default:
+			ZN_CRASH();
+			return Ref<VoxelStream>();
+	}
+}
+
+uint64_t get_directory_size(const String &directory_path) {
+	Ref<DirAccess> da = zylann::godot::open_directory(directory_path);
+	if (da.is_null()) {
+		return 0;
+	}
+	uint64_t size = 0;
+	da->list_dir_begin();
+	for (String fname = da->get_next(); fname != ""; fname = da->get_next()) {
+		const String fpath = directory_path.path_join(fname);
+		if (da->current_is_dir()) {
+			size += get_directory_size(fpath);
+		} else {
+			Error err;
+			Ref<FileAccess> f = zylann::godot::open_file(fpath, FileAccess::READ, err);
+			if (f.is_valid()) {
+				size += f->get_length();
+			}
+		}
+	}
+	da->list_dir_end();
+	return size;
+}
+
+static const unsigned int MAX_THREAD_COUNT = 16;
+
+struct PhaseThreadData {
+	VoxelStream *stream = nullptr;
+	const SyntheticWorld *world = nullptr;
+	unsigned int thread_index = 0;
+	unsigned int thread_count = 0;
+	unsigned int batch_size = 0;
+	bool save = false;
+	StdVector<uint64_t> batch_latencies_usec;
+	bool valid = true;
+};
+
+// Threads take batches of blocks in turns, like IO threads would take tasks from a queue
+void run_phase_thread(void *userdata) {
+	PhaseThreadData &td = *static_cast<PhaseThreadData *>(userdata);
+	const SyntheticWorld &world = *td.world;
+
+	StdVector<VoxelBuffer> buffers;
+	for (unsigned int i = 0; i < td.batch_size; ++i) {
+		buffers.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_DEFAULT));
+	}
+	StdVector<VoxelStream::VoxelQueryData> queries;
+
+	const unsigned int block_count = world.blocks.size();
+	const unsigned int stride = td.thread_count * td.batch_size;
+
+	for (unsigned int begin = td.thread_index * td.batch_size; begin < block_count; begin += stride) {
+		const unsigned int end = math::min(begin + td.batch_size, block_count);
+
+		queries.clear();
+		for (unsigned int i = begin; i < end; ++i) {
+			VoxelBuffer &vb = buffers[i - begin];
+			if (td.save) {
+				// Streams may take ownership of what they save
+				world.blocks[i].copy_to(vb, true);
+			}
+			queries.push_back(VoxelStream::VoxelQueryData{ vb, world.positions[i], 0, VoxelStream::RESULT_ERROR });
+		}
+
+		ProfilingClock clock;
+		if (td.save) {
+			td.stream->save_voxel_blocks(to_span(queries));
+		} else {
+			td.stream->load_voxel_blocks(to_span(queries));
+		}
+		td.batch_latencies_usec.push_back(clock.get_elapsed_microseconds());
+
+		if (!td.save) {
+			for (unsigned int i = begin; i < end; ++i) {
+				if (queries[i - begin].result != VoxelStream::RESULT_BLOCK_FOUND ||
+					!buffers[i - begin].equals(world.blocks[i])) {
+					td.valid = false;
+				}
+			}
+		}
+	}
+}
+
+struct PhaseResult {
+	uint64_t wall_usec = 0;
+	uint64_t cpu_usec = 0;
+	uint64_t p50_usec = 0;
+	uint64_t p90_usec = 0;
+	uint64_t p99_usec = 0;
+	unsigned int block_count = 0;
+	bool valid = true;
+
+	double get_blocks_per_second() const {
+		return double(block_count) / (double(math::max(wall_usec, uint64_t(1))) / 1000000.0);
+	}
+
+	double get_cpu_usec_per_block() const {
+		return double(cpu_usec) / double(math::max(block_count, 1u));
+	}
+
+	Dictionary to_dictionary() const {
+		Dictionary d;
+		d["wall_usec"] = wall_usec;
+		d["cpu_usec_per_block"] = get_cpu_usec_per_block();
+		d["blocks_per_second"] = get_blocks_per_second();
+		d["batch_p50_usec"] = p50_usec;
+		d["batch_p90_usec"] = p90_usec;
+		d["batch_p99_usec"] = p99_usec;
+		return d;
+	}
+};
+
+uint64_t get_percentile(const StdVector<uint64_t> &sorted_values, float p) {
+	if (sorted_values.size() == 0) {
+		return 0;
+	}
+	const size_t i = math::min(static_cast<size_t>(p * sorted_values.size()), sorted_values.size() - 1);
+	return sorted_values[i];
+}
+
+PhaseResult run_phase(
+		VoxelStream &stream,
+		const SyntheticWorld &world,
+		unsigned int thread_count,
+		unsigned int batch_size,
+		bool save
+) {
+	ZN_ASSERT(thread_count > 0 && thread_count <= MAX_THREAD_COUNT);
+
+	FixedArray<PhaseThreadData, MAX_THREAD_COUNT> threads_data;
+	FixedArray<Thread, MAX_THREAD_COUNT> threads;
+
+	// Process-wide, so it also accounts for work done by streams in threads of their own
+	const std::clock_t cpu_begin = std::clock();
+	ProfilingClock wall_clock;
+
+	for (unsigned int thread_index = 0; thread_index < thread_count; ++thread_index) {
+		PhaseThreadData &td = threads_data[thread_index];
+		td.stream = &stream;
+		td.world = &world;
+		td.thread_index = thread_index;
+		td.thread_count = thread_count;
+		td.batch_size = batch_size;
+		td.save = save;
+		threads[thread_index].start(run_phase_thread, &td);
+	}
+
+	PhaseResult result;
+	StdVector<uint64_t> latencies;
+
+	for (unsigned int thread_index = 0; thread_index < thread_count; ++thread_index) {
+		threads[thread_index].wait_to_finish();
+		const PhaseThreadData &td = threads_data[thread_index];
+		result.valid &= td.valid;
+		latencies.insert(latencies.end(), td.batch_latencies_usec.begin(), td.batch_latencies_usec.end());
+	}
+
+	if (save) {
+		// Saving isn't finished until everything is written
+		stream.flush();
+	}
+
+	result.wall_usec = wall_clock.get_elapsed_microseconds();
+	result.cpu_usec = static_cast<uint64_t>(std::clock() - cpu_begin) * 1000000 / CLOCKS_PER_SEC;
+	result.block_count = world.blocks.size();
+
+	std::sort(latencies.begin(), latencies.end());
+	result.p50_usec = get_percentile(latencies, 0.5f);
+	result.p90_usec = get_percentile(latencies, 0.9f);
+	result.p99_usec = get_percentile(latencies, 0.99f);
+
+	return result;
+}
+
+struct BenchmarkResult {
+	const char *stream_name = "";
+	const char *compression_name = "";
+	int block_size = 0;
+	float edit_density = 0.f;
+	unsigned int thread_count = 0;
+	unsigned int block_count = 0;
+	uint64_t file_size = 0;
+	PhaseResult save;
+	PhaseResult load;
+
+	Dictionary to_dictionary() const {
+		Dictionary d;
+		d["stream"] = stream_name;
+		d["compression"] = compression_name;
+		d["block_size"] = block_size;
+		d["edit_density"] = edit_density;
+		d["threads"] = thread_count;
+		d["blocks"] = block_count;
+		d["file_size"] = file_size;
+		d["save"] = save.to_dictionary();
+		d["load"] = load.to_dictionary();
+		return d;
+	}
+};
+
+} // namespace
+
+void test_voxel_stream_benchmark(testing::BenchmarkSuite &suite) {
+	// Kept small, since every phase is repeated many times. Increase sizes locally for more realistic numbers.
+	const int block_size_po2s[] = { 4, 5 };
+	const float edit_densities[] = { 0.25f };
+	const unsigned int thread_counts[] = { 1, 4, 16 };
+	const unsigned int batch_size = 8;
+
+	StdVector<BenchmarkResult> results;
+
+	for (const int block_size_po2 : block_size_po2s) {
+		for (const float edit_density : edit_densities) {
+			WorldParams world_params;
+			world_params.block_size_po2 = block_size_po2;
+			world_params.edit_density = edit_density;
+			SyntheticWorld world;
+			generate_synthetic_world(world_params, world);
+
+			for (unsigned int stream_type = 0; stream_type < STREAM_TYPE_COUNT; ++stream_type) {
+				for (const bool zstd : { false, true }) {
+					if (zstd && (stream_type == STREAM_MEMORY || !CompressedData::is_zstd_supported())) {
+						continue;
+					}
+
+					for (const unsigned int thread_count : thread_counts) {
+						BenchmarkResult result;
+						result.stream_name = get_stream_type_name(static_cast<StreamType>(stream_type));
+						result.compression_name = stream_type == STREAM_MEMORY ? "none" : (zstd ? "zstd" : "lz4");
+						result.block_size = 1 << block_size_po2;
+						result.edit_density = edit_density;
+						result.thread_count = thread_count;
+						result.block_count = world.blocks.size();
+
+						zylann::testing::TestDirectory test_dir;
+						ZN_TEST_ASSERT(test_dir.is_valid());
+						{
+							Ref<VoxelStream> stream = create_stream(
+									static_cast<StreamType>(stream_type), zstd, block_size_po2, test_dir.get_path()
+							);
+							const StdString name = format(
+									"voxel_stream_{}_{}_block_size_{}_{}_threads",
+									result.stream_name,
+									result.compression_name,
+									result.block_size,
+									thread_count
+							);
+							// Saving again overwrites the same blocks. Details are printed from the last repetition.
+							suite.run(format("{}_save", name).c_str(), 1, [&result, &stream, &world, thread_count]() {
+								result.save = run_phase(**stream, world, thread_count, batch_size, true);
+							});
+							suite.run(format("{}_load", name).c_str(), 1, [&result, &stream, &world, thread_count]() {
+								result.load = run_phase(**stream, world, thread_count, batch_size, false);
+								ZN_TEST_ASSERT(result.load.valid);
+							});
+						}
+						// Measured once the stream is closed, since databases may only be complete at this point
+						result.file_size = get_directory_size(test_dir.get_path());
+
+						print_line(format(
+								"Stream benchmark {} {}, block size {}, edit density {}, {} threads: "
+								"save {} blocks/s (p50 {}us, p99 {}us, {} CPU us/block), "
+								"load {} blocks/s (p50 {}us, p99 {}us, {} CPU us/block), {} bytes",
+								result.stream_name,
+								result.compression_name,
+								result.block_size,
+								result.edit_density,
+								result.thread_count,
+								result.save.get_blocks_per_second(),
+								result.save.p50_usec,
+								result.save.p99_usec,
+								result.save.get_cpu_usec_per_block(),
+								result.load.get_blocks_per_second(),
+								result.load.p50_usec,
+								result.load.p99_usec,
+								result.load.get_cpu_usec_per_block(),
+								result.file_size
+						));
+
+						results.push_back(result);
+					}
+				}
+			}
+		}
+	}
+
+	// One line that tools can pick from the output to track results over time
+	Array results_array;
+	for (const BenchmarkResult &result : results) {
+		results_array.append(result.to_dictionary());
+	}
+	print_line(String("stream_benchmark_json: ") + JSON::stringify(results_array));
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,14 @@
+#ifndef VOXEL_TESTS_STREAM_BENCHMARK_H
+#define VOXEL_TESTS_STREAM_BENCHMARK_H
+
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
+namespace zylann::voxel::tests {
+
+void test_voxel_stream_benchmark(testing::BenchmarkSuite &suite);
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TESTS_STREAM_BENCHMARK_H
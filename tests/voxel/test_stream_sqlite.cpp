@@ -88,6 +88,12 @@ void test_voxel_stream_sqlite_basic() {
 	test_voxel_stream_sqlite_basic(
 			true, VoxelStreamSQLite::COORDINATE_FORMAT_BLOB80_X25_Y25_Z25_L5, Vector3i(1, 2, -3)
 	);
+	test_voxel_stream_sqlite_basic(
+			false, VoxelStreamSQLite::COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7, Vector3i(1, 2, -3)
+	);
+	test_voxel_stream_sqlite_basic(
+			true, VoxelStreamSQLite::COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7, Vector3i(1, 2, -3)
+	);
 
 	// Extras with large coordinates
 	test_voxel_stream_sqlite_basic(
@@ -101,6 +107,11 @@ void test_voxel_stream_sqlite_basic() {
 			VoxelStreamSQLite::COORDINATE_FORMAT_BLOB80_X25_Y25_Z25_L5,
 			Vector3i(10'000'000, -11'000'000, 12'000'000)
 	);
+	test_voxel_stream_sqlite_basic(
+			false,
+			VoxelStreamSQLite::COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7,
+			Vector3i(100'000, 150'000, -200'000)
+	);
 }
 
 void test_voxel_stream_sqlite_coordinate_format(const VoxelStreamSQLite::CoordinateFormat coordinate_format) {
@@ -221,6 +232,57 @@ void test_voxel_stream_sqlite_coordinate_format(const VoxelStreamSQLite::Coordin
 
 		const uint64_t elapsed_us = pclock.get_elapsed_microseconds();
 		ZN_PRINT_VERBOSE(format("Reads time with coordinate format {}: {} us", coordinate_format, elapsed_us));
+
+		// Read them all again in a single batch, along with a location that was never saved
+		std::vector<VoxelBuffer> voxel_buffers;
+		voxel_buffers.reserve(blocks.size() + 1);
+		std::vector<VoxelStreamSQLite::VoxelQueryData> queries;
+		for (const BlockInfo &block : blocks) {
+			voxel_buffers.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_DEFAULT));
+			queries.push_back(VoxelStreamSQLite::VoxelQueryData{
+					voxel_buffers.back(), block.position, block.lod_index, VoxelStreamSQLite::RESULT_ERROR });
+		}
+		voxel_buffers.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_DEFAULT));
+		queries.push_back(VoxelStreamSQLite::VoxelQueryData{
+				voxel_buffers.back(), Vector3i(radius + 1, 0, 0), 0, VoxelStreamSQLite::RESULT_ERROR });
+
+		stream->load_voxel_blocks(to_span(queries));
+
+		for (unsigned int i = 0; i < blocks.size(); ++i) {
+			const VoxelStreamSQLite::VoxelQueryData &q = queries[i];
+			ZN_TEST_ASSERT(q.result == VoxelStreamSQLite::RESULT_BLOCK_FOUND);
+			const Vector3i size = q.voxel_buffer.get_size();
+			const unsigned int v = q.voxel_buffer.get_voxel(Vector3i(size.x / 2, 0, size.z / 2), 0);
+			ZN_TEST_ASSERT(v == blocks[i].id);
+		}
+		ZN_TEST_ASSERT(queries.back().result == VoxelStreamSQLite::RESULT_BLOCK_NOT_FOUND);
+
+		const Dictionary stats = stream->get_statistics();
+		ZN_TEST_ASSERT(int64_t(stats["blocks_loaded"]) == 2 * int64_t(blocks.size()));
+
+		// Load everything in parts, like full load mode does with multiple threads
+		StdVector<VoxelStream::FullLoadingPart> parts;
+		ZN_TEST_ASSERT(stream->get_load_all_blocks_parts(10, parts));
+		ZN_TEST_ASSERT(parts.size() > 1 && parts.size() <= 10);
+		VoxelStream::FullLoadingResult full_result;
+		for (const VoxelStream::FullLoadingPart &part : parts) {
+			stream->load_all_blocks_part(part, full_result);
+		}
+		ZN_TEST_ASSERT(full_result.blocks.size() == blocks.size());
+		// Blocks were shuffled
+		std::vector<unsigned int> block_index_from_id;
+		block_index_from_id.resize(blocks.size());
+		for (unsigned int i = 0; i < blocks.size(); ++i) {
+			block_index_from_id[blocks[i].id] = i;
+		}
+		for (const VoxelStream::FullLoadingResult::Block &loaded_block : full_result.blocks) {
+			ZN_TEST_ASSERT(loaded_block.voxels != nullptr);
+			const unsigned int id = loaded_block.voxels->get_voxel(Vector3i(0, 0, 0), 0);
+			ZN_TEST_ASSERT(id < blocks.size());
+			const BlockInfo &block = blocks[block_index_from_id[id]];
+			ZN_TEST_ASSERT(block.position == loaded_block.position);
+			ZN_TEST_ASSERT(block.lod_index == loaded_block.lod);
+		}
 	}
 }
 
@@ -229,6 +291,527 @@ void test_voxel_stream_sqlite_coordinate_format() {
 	test_voxel_stream_sqlite_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_INT64_X19_Y19_Z19_L7);
 	test_voxel_stream_sqlite_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_STRING_CSD);
 	test_voxel_stream_sqlite_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_BLOB80_X25_Y25_Z25_L5);
+	test_voxel_stream_sqlite_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7);
+}
+
+namespace {
+
+void make_key_range_test_block(VoxelBuffer &vb, Vector3i bpos) {
+	vb.create(Vector3iUtil::create(1 << constants::DEFAULT_BLOCK_SIZE_PO2));
+	// Coordinates are stored in voxels so loaded blocks can be checked
+	vb.set_voxel(bpos.x + 100, Vector3i(0, 0, 0), 0);
+	vb.set_voxel(bpos.y + 100, Vector3i(1, 0, 0), 0);
+	vb.set_voxel(bpos.z + 100, Vector3i(2, 0, 0), 0);
+}
+
+bool is_key_range_test_block(const VoxelBuffer &vb, Vector3i bpos) {
+	return vb.get_voxel(Vector3i(0, 0, 0), 0) == static_cast<uint64_t>(bpos.x + 100) &&
+			vb.get_voxel(Vector3i(1, 0, 0), 0) == static_cast<uint64_t>(bpos.y + 100) &&
+			vb.get_voxel(Vector3i(2, 0, 0), 0) == static_cast<uint64_t>(bpos.z + 100);
+}
+
+} // namespace
+
+void test_voxel_stream_sqlite_key_ranges() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const String database_path = test_dir.get_path().path_join("database.sqlite");
+	const Box3i saved_box(Vector3i(-4, -4, -4), Vector3i(8, 8, 8));
+
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_preferred_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7);
+		stream->set_database_path(database_path);
+
+		saved_box.for_each_cell_zxy([&stream](Vector3i bpos) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			make_key_range_test_block(vb, bpos);
+			VoxelStreamSQLite::VoxelQueryData q{ vb, bpos, 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		});
+		// Same positions in another LOD, which must not be returned by ranges of LOD 0
+		{
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			make_key_range_test_block(vb, Vector3i(50, 50, 50));
+			VoxelStreamSQLite::VoxelQueryData q{ vb, Vector3i(), 1, VoxelStreamSQLite::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		}
+		stream->flush();
+	}
+
+	// Reopen to avoid caching effects
+	Ref<VoxelStreamSQLite> stream;
+	stream.instantiate();
+	stream->set_database_path(database_path);
+
+	// Request a smaller box, so ranges also contain rows that were not requested
+	const Box3i requested_box(Vector3i(-3, -3, -3), Vector3i(6, 6, 6));
+	StdVector<Vector3i> positions;
+	requested_box.for_each_cell_zxy([&positions](Vector3i bpos) { positions.push_back(bpos); });
+	// Isolated locations, one of which was not saved
+	positions.push_back(Vector3i(-4, 3, -4));
+	positions.push_back(Vector3i(100, 0, 0));
+	// Requested twice
+	positions.push_back(Vector3i(0, 0, 0));
+
+	// Shuffle, locations are not expected to come in any order
+	RandomPCG rng;
+	rng.seed(131183);
+	for (unsigned int i = 0; i < positions.size(); ++i) {
+		const unsigned int j = rng.rand() % positions.size();
+		std::swap(positions[i], positions[j]);
+	}
+
+	std::vector<VoxelBuffer> voxel_buffers;
+	voxel_buffers.reserve(positions.size());
+	std::vector<VoxelStreamSQLite::VoxelQueryData> queries;
+	for (const Vector3i bpos : positions) {
+		voxel_buffers.push_back(VoxelBuffer(VoxelBuffer::ALLOCATOR_DEFAULT));
+		queries.push_back(
+				VoxelStreamSQLite::VoxelQueryData{ voxel_buffers.back(), bpos, 0, VoxelStreamSQLite::RESULT_ERROR }
+		);
+	}
+
+	stream->load_voxel_blocks(to_span(queries));
+
+	for (const VoxelStreamSQLite::VoxelQueryData &q : queries) {
+		if (saved_box.contains(q.position_in_blocks)) {
+			ZN_TEST_ASSERT(q.result == VoxelStreamSQLite::RESULT_BLOCK_FOUND);
+			ZN_TEST_ASSERT(is_key_range_test_block(q.voxel_buffer, q.position_in_blocks));
+		} else {
+			ZN_TEST_ASSERT(q.result == VoxelStreamSQLite::RESULT_BLOCK_NOT_FOUND);
+		}
+	}
+
+	const Dictionary stats = stream->get_statistics();
+	ZN_TEST_ASSERT(int64_t(stats["blocks_loaded"]) == int64_t(positions.size()) - 1);
+	// Far fewer queries than blocks
+	ZN_TEST_ASSERT(int64_t(stats["key_range_scans"]) > 0);
+	ZN_TEST_ASSERT(int64_t(stats["key_range_scans"]) < int64_t(positions.size()) / 8);
+}
+
+void test_voxel_stream_sqlite_copy_to_other_coordinate_format() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const String src_database_path = test_dir.get_path().path_join("src.sqlite");
+	const String dst_database_path = test_dir.get_path().path_join("dst.sqlite");
+	const Box3i box(Vector3i(-2, -2, -2), Vector3i(4, 4, 4));
+
+	{
+		Ref<VoxelStreamSQLite> src_stream;
+		src_stream.instantiate();
+		src_stream->set_preferred_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_INT64_X16_Y16_Z16_L16);
+		src_stream->set_database_path(src_database_path);
+
+		box.for_each_cell_zxy([&src_stream](Vector3i bpos) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			make_key_range_test_block(vb, bpos);
+			VoxelStreamSQLite::VoxelQueryData q{ vb, bpos, 0, VoxelStreamSQLite::RESULT_ERROR };
+			src_stream->save_voxel_block(q);
+		});
+		src_stream->flush();
+
+		Ref<VoxelStreamSQLite> dst_stream;
+		dst_stream.instantiate();
+		dst_stream->set_preferred_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7);
+		dst_stream->set_database_path(dst_database_path);
+
+		ZN_TEST_ASSERT(src_stream->copy_blocks_to_other_sqlite_stream(dst_stream));
+	}
+	{
+		// The existing format is used when reopening, regardless of the preferred one
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_preferred_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_STRING_CSD);
+		stream->set_database_path(dst_database_path);
+		ZN_TEST_ASSERT(
+				stream->get_current_coordinate_format() ==
+				VoxelStreamSQLite::COORDINATE_FORMAT_INT64_MORTON_X19_Y19_Z19_L7
+		);
+
+		box.for_each_cell_zxy([&stream](Vector3i bpos) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			VoxelStreamSQLite::VoxelQueryData q{ vb, bpos, 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream->load_voxel_block(q);
+			ZN_TEST_ASSERT(q.result == VoxelStreamSQLite::RESULT_BLOCK_FOUND);
+			ZN_TEST_ASSERT(is_key_range_test_block(vb, bpos));
+		});
+	}
+}
+
+void test_voxel_stream_sqlite_cache_budget() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const String database_path = test_dir.get_path().path_join("database.sqlite");
+	const unsigned int block_count = 300;
+	const Vector3i block_size = Vector3iUtil::create(1 << constants::DEFAULT_BLOCK_SIZE_PO2);
+
+	struct L {
+		static unsigned int get_block_value(unsigned int i) {
+			return i % 200;
+		}
+	};
+
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+		// Small enough for blocks to get evicted
+		stream->set_cache_memory_budget_mb(1);
+
+		for (unsigned int i = 0; i < block_count; ++i) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			vb.create(block_size);
+			vb.fill(L::get_block_value(i), 0);
+			// Not uniform, so the channel takes memory
+			vb.set_voxel(L::get_block_value(i + 1), Vector3i(1, 1, 1), 0);
+			VoxelStreamSQLite::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		}
+
+		stream->flush();
+
+		const Dictionary stats = stream->get_statistics();
+		const Dictionary cache_stats = stats["cache"];
+		ZN_TEST_ASSERT(int64_t(cache_stats["dirty_block_count"]) == 0);
+		ZN_TEST_ASSERT(int64_t(cache_stats["evicted_block_count"]) > 0);
+
+		// Some blocks come from the cache, others from the database
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		for (unsigned int i = 0; i < block_count; ++i) {
+			VoxelStreamSQLite::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream->load_voxel_block(q);
+			ZN_TEST_ASSERT(q.result == VoxelStreamSQLite::RESULT_BLOCK_FOUND);
+			ZN_TEST_ASSERT(vb.get_voxel(Vector3i(0, 0, 0), 0) == L::get_block_value(i));
+		}
+
+		const Dictionary stats2 = stream->get_statistics();
+		const Dictionary cache_stats2 = stats2["cache"];
+		ZN_TEST_ASSERT(int64_t(cache_stats2["hits"]) > 0);
+		ZN_TEST_ASSERT(int64_t(cache_stats2["hits"]) < int64_t(block_count));
+	}
+	// Everything must have been written
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		for (unsigned int i = 0; i < block_count; ++i) {
+			VoxelStreamSQLite::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream->load_voxel_block(q);
+			ZN_TEST_ASSERT(q.result == VoxelStreamSQLite::RESULT_BLOCK_FOUND);
+			ZN_TEST_ASSERT(vb.get_voxel(Vector3i(0, 0, 0), 0) == L::get_block_value(i));
+		}
+	}
+}
+
+void test_voxel_stream_sqlite_deduplication() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const String database_path = test_dir.get_path().path_join("database.sqlite");
+	const unsigned int block_count = 20;
+	const Vector3i block_size = Vector3iUtil::create(1 << constants::DEFAULT_BLOCK_SIZE_PO2);
+
+	struct L {
+		static void make_block(VoxelBuffer &vb, Vector3i block_size, unsigned int value) {
+			vb.create(block_size);
+			vb.fill(value, 0);
+			// Not uniform, so the block is compressed like most blocks with content
+			vb.set_voxel(value + 1, Vector3i(1, 2, 3), 0);
+		}
+		static unsigned int get_block_value(unsigned int i, bool edited) {
+			// Only two different contents, then one block gets a third one and another gets back the first one
+			if (edited && i == 3) {
+				return 10;
+			}
+			if (edited && i == 4) {
+				return 0;
+			}
+			return i % 2;
+		}
+	};
+
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+		stream->set_preferred_coordinate_format(VoxelStreamSQLite::COORDINATE_FORMAT_INT64_X16_Y16_Z16_L16);
+		stream->set_deduplication_enabled(true);
+
+		for (unsigned int i = 0; i < block_count; ++i) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			L::make_block(vb, block_size, L::get_block_value(i, false));
+			VoxelStreamSQLite::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		}
+		stream->flush();
+
+		// Only the first block of each content wrote it
+		const Dictionary stats = stream->get_statistics();
+		ZN_TEST_ASSERT(int64_t(stats["blocks_saved"]) == block_count);
+		ZN_TEST_ASSERT(int64_t(stats["blobs_reused"]) == block_count - 2);
+
+		for (unsigned int i = 3; i <= 4; ++i) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			L::make_block(vb, block_size, L::get_block_value(i, true));
+			VoxelStreamSQLite::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		}
+		stream->flush();
+
+		// Saving without deduplication replaces references
+		stream->set_deduplication_enabled(false);
+		{
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			L::make_block(vb, block_size, L::get_block_value(5, true));
+			VoxelStreamSQLite::VoxelQueryData q{ vb, Vector3i(5, 0, 0), 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		}
+		stream->flush();
+	}
+	// Reopen to avoid caching effects
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+
+		StdVector<VoxelBuffer> buffers;
+		StdVector<VoxelStreamSQLite::VoxelQueryData> queries;
+		buffers.reserve(block_count);
+		for (unsigned int i = 0; i < block_count; ++i) {
+			buffers.emplace_back(VoxelBuffer::ALLOCATOR_DEFAULT);
+		}
+		for (unsigned int i = 0; i < block_count; ++i) {
+			queries.push_back(
+					VoxelStreamSQLite::VoxelQueryData{ buffers[i], Vector3i(i, 0, 0), 0, VoxelStream::RESULT_ERROR }
+			);
+		}
+		stream->load_voxel_blocks(to_span(queries));
+
+		for (unsigned int i = 0; i < block_count; ++i) {
+			ZN_TEST_ASSERT(queries[i].result == VoxelStream::RESULT_BLOCK_FOUND);
+			VoxelBuffer expected(VoxelBuffer::ALLOCATOR_DEFAULT);
+			L::make_block(expected, block_size, L::get_block_value(i, true));
+			ZN_TEST_ASSERT(buffers[i].equals(expected));
+		}
+
+		// Loading everything also resolves references
+		VoxelStream::FullLoadingResult result;
+		stream->load_all_blocks(result);
+		ZN_TEST_ASSERT(result.blocks.size() == block_count);
+		for (const VoxelStream::FullLoadingResult::Block &block : result.blocks) {
+			ZN_TEST_ASSERT(block.voxels != nullptr);
+			const unsigned int i = block.position.x;
+			VoxelBuffer expected(VoxelBuffer::ALLOCATOR_DEFAULT);
+			L::make_block(expected, block_size, L::get_block_value(i, true));
+			ZN_TEST_ASSERT(block.voxels->equals(expected));
+		}
+	}
+}
+
+void test_voxel_stream_sqlite_delete_block() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const Vector3i block_size = Vector3iUtil::create(1 << constants::DEFAULT_BLOCK_SIZE_PO2);
+	const unsigned int block_count = 4;
+	const Vector3i deleted_position(1, 0, 0);
+
+	struct L {
+		static VoxelStream::ResultCode load(VoxelStreamSQLite &stream, Vector3i position) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			VoxelStreamSQLite::VoxelQueryData q{ vb, position, 0, VoxelStreamSQLite::RESULT_ERROR };
+			stream.load_voxel_block(q);
+			return q.result;
+		}
+	};
+
+	// With and without cache budget, since deleted blocks can remain in the cache after flushing
+	for (const int budget_mb : { 0, 1 }) {
+		const String database_path =
+				test_dir.get_path().path_join(budget_mb == 0 ? "database_no_cache.sqlite" : "database_cache.sqlite");
+
+		{
+			Ref<VoxelStreamSQLite> stream;
+			stream.instantiate();
+			stream->set_database_path(database_path);
+			stream->set_cache_memory_budget_mb(budget_mb);
+			ZN_TEST_ASSERT(stream->supports_deleting_voxel_blocks());
+
+			for (unsigned int i = 0; i < block_count; ++i) {
+				VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+				vb.create(block_size);
+				vb.fill(i + 1, 0);
+				VoxelStreamSQLite::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStreamSQLite::RESULT_ERROR };
+				stream->save_voxel_block(q);
+			}
+			stream->flush();
+
+			// The deletion is seen before it gets flushed, instead of loading the old block from the database
+			stream->delete_voxel_block(deleted_position, 0);
+			ZN_TEST_ASSERT(L::load(**stream, deleted_position) == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+
+			stream->flush();
+			ZN_TEST_ASSERT(L::load(**stream, deleted_position) == VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		}
+		{
+			Ref<VoxelStreamSQLite> stream;
+			stream.instantiate();
+			stream->set_database_path(database_path);
+
+			for (unsigned int i = 0; i < block_count; ++i) {
+				const Vector3i position(i, 0, 0);
+				const VoxelStream::ResultCode expected_result =
+						position == deleted_position ? VoxelStream::RESULT_BLOCK_NOT_FOUND
+													 : VoxelStream::RESULT_BLOCK_FOUND;
+				ZN_TEST_ASSERT(L::load(**stream, position) == expected_result);
+			}
+		}
+	}
+}
+
+void test_voxel_stream_sqlite_encoded_blocks() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const Vector3i block_size = Vector3iUtil::create(1 << constants::DEFAULT_BLOCK_SIZE_PO2);
+	const unsigned int block_count = 4;
+
+	struct L {
+		static void make_block(VoxelBuffer &vb, Vector3i size, unsigned int i) {
+			vb.create(size);
+			vb.fill(i + 1, 0);
+			vb.set_voxel(i + 2, Vector3i(1, 2, 3), 0);
+		}
+
+		static void check_loaded_encoded(VoxelStreamSQLite &stream, Vector3i block_size, unsigned int i) {
+			StdVector<uint8_t> data;
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			vb.create(block_size);
+			VoxelStream::EncodedVoxelQueryData q{ data, &vb, Vector3i(i, 0, 0), 0, VoxelStream::RESULT_ERROR };
+			stream.load_encoded_voxel_blocks(Span<VoxelStream::EncodedVoxelQueryData>(&q, 1));
+			ZN_TEST_ASSERT(q.result == VoxelStream::RESULT_BLOCK_FOUND);
+			// Blocks can be returned decoded already if the stream has them that way
+			if (data.size() > 0) {
+				ZN_TEST_ASSERT(stream.decode_voxel_block(to_span_const(data), vb));
+			}
+			VoxelBuffer expected(VoxelBuffer::ALLOCATOR_DEFAULT);
+			make_block(expected, block_size, i);
+			ZN_TEST_ASSERT(vb.equals(expected));
+		}
+
+		static void check_loaded(VoxelStreamSQLite &stream, Vector3i block_size, unsigned int i) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			vb.create(block_size);
+			VoxelStream::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStream::RESULT_ERROR };
+			stream.load_voxel_block(q);
+			ZN_TEST_ASSERT(q.result == VoxelStream::RESULT_BLOCK_FOUND);
+			VoxelBuffer expected(VoxelBuffer::ALLOCATOR_DEFAULT);
+			make_block(expected, block_size, i);
+			ZN_TEST_ASSERT(vb.equals(expected));
+		}
+	};
+
+	// With and without cache budget, since encoded blocks can remain in the cache after flushing
+	for (const int budget_mb : { 0, 1 }) {
+		const String database_path =
+				test_dir.get_path().path_join(budget_mb == 0 ? "database_no_cache.sqlite" : "database_cache.sqlite");
+
+		{
+			Ref<VoxelStreamSQLite> stream;
+			stream.instantiate();
+			stream->set_database_path(database_path);
+			stream->set_cache_memory_budget_mb(budget_mb);
+			ZN_TEST_ASSERT(stream->supports_encoded_voxel_blocks());
+
+			for (unsigned int i = 0; i < block_count; ++i) {
+				VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+				L::make_block(vb, block_size, i);
+				StdVector<uint8_t> data;
+				ZN_TEST_ASSERT(stream->encode_voxel_block(vb, data));
+				VoxelStream::EncodedVoxelQueryData q{ data, nullptr, Vector3i(i, 0, 0), 0, VoxelStream::RESULT_ERROR };
+				stream->save_encoded_voxel_blocks(Span<VoxelStream::EncodedVoxelQueryData>(&q, 1));
+			}
+
+			// Blocks saved encoded can be loaded both ways before being flushed
+			for (unsigned int i = 0; i < block_count; ++i) {
+				L::check_loaded(**stream, block_size, i);
+				L::check_loaded_encoded(**stream, block_size, i);
+			}
+
+			stream->flush();
+
+			for (unsigned int i = 0; i < block_count; ++i) {
+				L::check_loaded(**stream, block_size, i);
+				L::check_loaded_encoded(**stream, block_size, i);
+			}
+		}
+		{
+			Ref<VoxelStreamSQLite> stream;
+			stream.instantiate();
+			stream->set_database_path(database_path);
+
+			for (unsigned int i = 0; i < block_count; ++i) {
+				L::check_loaded(**stream, block_size, i);
+				L::check_loaded_encoded(**stream, block_size, i);
+			}
+		}
+	}
+}
+
+void test_voxel_stream_sqlite_group_commit() {
+	zylann::testing::TestDirectory test_dir;
+	ZN_TEST_ASSERT(test_dir.is_valid());
+
+	const String database_path = test_dir.get_path().path_join("database.sqlite");
+	const Vector3i block_size = Vector3iUtil::create(1 << constants::DEFAULT_BLOCK_SIZE_PO2);
+	const unsigned int block_count = 10;
+
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+		stream->set_group_commit_max_blocks(4);
+		stream->set_group_commit_latency_msec(1000);
+
+		// Saved one at a time, as separate tasks would
+		for (unsigned int i = 0; i < block_count; ++i) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			vb.create(block_size);
+			vb.set_voxel(i + 1, Vector3i(1, 2, 3), 0);
+			VoxelStream::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStream::RESULT_ERROR };
+			stream->save_voxel_block(q);
+		}
+
+		// Stops the writer thread and writes what remains
+		stream->set_group_commit_latency_msec(0);
+
+		const Dictionary stats = stream->get_statistics();
+		// Grouped, although timing can make groups smaller
+		ZN_TEST_ASSERT(int64_t(stats["commits"]) >= 1);
+		ZN_TEST_ASSERT(int64_t(stats["commits"]) <= int64_t(block_count));
+		ZN_TEST_ASSERT(int64_t(stats["blocks_saved"]) == int64_t(block_count));
+	}
+	{
+		Ref<VoxelStreamSQLite> stream;
+		stream.instantiate();
+		stream->set_database_path(database_path);
+
+		for (unsigned int i = 0; i < block_count; ++i) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			vb.create(block_size);
+			VoxelStream::VoxelQueryData q{ vb, Vector3i(i, 0, 0), 0, VoxelStream::RESULT_ERROR };
+			stream->load_voxel_block(q);
+			ZN_TEST_ASSERT(q.result == VoxelStream::RESULT_BLOCK_FOUND);
+			ZN_TEST_ASSERT(vb.get_voxel(Vector3i(1, 2, 3), 0) == i + 1);
+		}
+	}
 }
 
 void test_voxel_stream_sqlite_key_string_csd_encoding(Vector3i pos, uint8_t lod_index, std::string_view expected) {
@@ -251,6 +834,53 @@ void test_voxel_stream_sqlite_key_string_csd_encoding() {
 	test_voxel_stream_sqlite_key_string_csd_encoding(Vector3i(123, -456, 789), 20, "123,-456,789,20");
 }
 
+void test_voxel_stream_sqlite_key_morton_encoding() {
+	using namespace sqlite;
+
+	const BlockLocation::CoordinateFormat format = BlockLocation::FORMAT_INT64_MORTON_X19_Y19_Z19_L7;
+	const Box3i limits = BlockLocation::get_coordinate_range(format);
+	const uint8_t max_lod_index = BlockLocation::get_lod_count(format) - 1;
+	const Vector3i min_pos = limits.position;
+	const Vector3i max_pos = limits.position + limits.size - Vector3i(1, 1, 1);
+
+	const BlockLocation locations[] = {
+		{ Vector3i(0, 0, 0), 0 },
+		{ Vector3i(1, 0, 0), 1 },
+		{ Vector3i(-1, 4, -1), 2 },
+		{ Vector3i(6, -9, 21), 5 },
+		{ Vector3i(123, -456, 789), 20 },
+		{ min_pos, max_lod_index },
+		{ max_pos, max_lod_index },
+		{ Vector3i(min_pos.x, max_pos.y, min_pos.z), max_lod_index },
+		{ Vector3i(max_pos.x, min_pos.y, max_pos.z), 0 },
+	};
+	for (const BlockLocation &loc : locations) {
+		const uint64_t key = loc.encode_u64(format);
+		const BlockLocation loc2 = BlockLocation::decode_u64(key, format);
+		ZN_TEST_ASSERT(loc == loc2);
+		// Keys are stored in signed 64-bit integers, they must remain positive to keep their order
+		ZN_TEST_ASSERT(static_cast<int64_t>(key) >= 0);
+	}
+
+	// Each LOD is a separate range of keys
+	for (uint8_t lod_index = 0; lod_index < max_lod_index; ++lod_index) {
+		const BlockLocation last_of_lod{ max_pos, lod_index };
+		const BlockLocation first_of_next_lod{ min_pos, static_cast<uint8_t>(lod_index + 1) };
+		ZN_TEST_ASSERT(last_of_lod.encode_u64(format) < first_of_next_lod.encode_u64(format));
+	}
+
+	// Blocks of a cube aligned to its size have contiguous keys
+	const Box3i cube(Vector3i(-4, -4, -4), Vector3i(4, 4, 4));
+	uint64_t min_key = std::numeric_limits<uint64_t>::max();
+	uint64_t max_key = 0;
+	cube.for_each_cell_zxy([&min_key, &max_key, format](Vector3i bpos) {
+		const uint64_t key = BlockLocation{ bpos, 3 }.encode_u64(format);
+		min_key = math::min(min_key, key);
+		max_key = math::max(max_key, key);
+	});
+	ZN_TEST_ASSERT(max_key - min_key + 1 == Vector3iUtil::get_volume_u64(cube.size));
+}
+
 void test_voxel_stream_sqlite_key_blob80_encoding(Vector3i position, uint8_t lod_index) {
 	using namespace sqlite;
 
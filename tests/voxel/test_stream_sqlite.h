@@ -5,8 +5,16 @@ namespace zylann::voxel::tests {
 
 void test_voxel_stream_sqlite_basic();
 void test_voxel_stream_sqlite_coordinate_format();
+void test_voxel_stream_sqlite_cache_budget();
+void test_voxel_stream_sqlite_deduplication();
+void test_voxel_stream_sqlite_delete_block();
+void test_voxel_stream_sqlite_encoded_blocks();
+void test_voxel_stream_sqlite_group_commit();
+void test_voxel_stream_sqlite_key_ranges();
+void test_voxel_stream_sqlite_copy_to_other_coordinate_format();
 void test_voxel_stream_sqlite_key_string_csd_encoding();
 void test_voxel_stream_sqlite_key_blob80_encoding();
+void test_voxel_stream_sqlite_key_morton_encoding();
 
 } // namespace zylann::voxel::tests
 
@@ -3,7 +3,10 @@
 #include "../../storage/metadata/voxel_metadata_variant.h"
 #include "../../storage/voxel_buffer_gd.h"
 #include "../../streams/voxel_block_serializer.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/io/log.h"
 #include "../../util/string/std_stringstream.h"
+#include "../benchmarking.h"
 #include "../testing.h"
 #include <sstream>
 
@@ -149,6 +152,58 @@ void test_voxel_buffer_metadata() {
 	}
 }
 
+void test_voxel_buffer_metadata_in_area() {
+	VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	const Vector3i size(16, 16, 16);
+	vb.create(size);
+
+	RandomPCG rng;
+	rng.seed(131183);
+	for (unsigned int i = 0; i < 500; ++i) {
+		const Vector3i pos(rng.rand() % size.x, rng.rand() % size.y, rng.rand() % size.z);
+		VoxelMetadata *meta = vb.get_or_create_voxel_metadata(pos);
+		ZN_TEST_ASSERT(meta != nullptr);
+		meta->set_u64(Vector3iUtil::get_zxy_index(pos, size));
+	}
+
+	const Box3i boxes[] = {
+		Box3i(Vector3i(), size), //
+		Box3i(Vector3i(2, 3, 4), Vector3i(5, 6, 7)), //
+		Box3i(Vector3i(0, 7, 0), Vector3i(16, 1, 16)), //
+		Box3i(Vector3i(8, 8, 8), Vector3i(1, 1, 1)), //
+		Box3i(Vector3i(15, 0, 3), Vector3i(1, 16, 2)), //
+		Box3i(Vector3i(4, 4, 4), Vector3i(6, 0, 6)) //
+	};
+
+	for (const Box3i &box : boxes) {
+		// Expected results are obtained by testing every item
+		StdVector<Vector3i> expected_positions;
+		const FlatMapMoveOnly<Vector3i, VoxelMetadata> &map = vb.get_voxel_metadata();
+		for (auto it = map.begin(); it != map.end(); ++it) {
+			if (box.contains(it->key)) {
+				expected_positions.push_back(it->key);
+			}
+		}
+
+		StdVector<Vector3i> positions;
+		vb.for_each_voxel_metadata_in_area(box, [&positions, size](Vector3i pos, const VoxelMetadata &meta) {
+			ZN_TEST_ASSERT(meta.get_u64() == Vector3iUtil::get_zxy_index(pos, size));
+			positions.push_back(pos);
+		});
+
+		ZN_TEST_ASSERT(positions == expected_positions);
+	}
+
+	// Clearing uses the same kind of queries
+	const Box3i cleared_box(Vector3i(2, 3, 4), Vector3i(5, 6, 7));
+	vb.clear_voxel_metadata_in_area(cleared_box);
+	unsigned int remaining_count = 0;
+	vb.for_each_voxel_metadata_in_area(cleared_box, [&remaining_count](Vector3i pos, const VoxelMetadata &meta) {
+		++remaining_count;
+	});
+	ZN_TEST_ASSERT(remaining_count == 0);
+}
+
 void test_voxel_buffer_metadata_gd() {
 	// Basic get and set (Godot)
 	{
@@ -430,4 +485,468 @@ void test_voxel_buffer_set_channel_bytes() {
 	}
 }
 
+void test_voxel_buffer_palette() {
+	const Vector3i size(16, 18, 20);
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	// Reference buffer is never compressed
+	VoxelBuffer expected(VoxelBuffer::ALLOCATOR_DEFAULT);
+	expected.create(size);
+	expected.set_channel_depth(channel, VoxelBuffer::DEPTH_16_BIT);
+
+	VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	vb.create(size);
+	vb.set_channel_depth(channel, VoxelBuffer::DEPTH_16_BIT);
+
+	struct L {
+		static void check_same_voxels(const VoxelBuffer &a, const VoxelBuffer &b, unsigned int channel) {
+			Vector3i pos;
+			for (pos.z = 0; pos.z < a.get_size().z; ++pos.z) {
+				for (pos.x = 0; pos.x < a.get_size().x; ++pos.x) {
+					for (pos.y = 0; pos.y < a.get_size().y; ++pos.y) {
+						ZN_TEST_ASSERT(a.get_voxel(pos, channel) == b.get_voxel(pos, channel));
+					}
+				}
+			}
+		}
+	};
+
+	// Few distinct values
+	for (unsigned int i = 0; i < 1000; ++i) {
+		const Vector3i pos((i * 7) % size.x, (i * 13) % size.y, (i * 3) % size.z);
+		const uint64_t v = i % 3;
+		vb.set_voxel(v, pos, channel);
+		expected.set_voxel(v, pos, channel);
+	}
+	vb.compress_palette_channel(channel);
+	ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE);
+	L::check_same_voxels(vb, expected, channel);
+	ZN_TEST_ASSERT(vb.equals(expected));
+
+	// Adding values makes indices wider while still being compressed
+	for (unsigned int i = 0; i < 20; ++i) {
+		const Vector3i pos(i % size.x, (i * 5) % size.y, 1);
+		vb.set_voxel(100 + i, pos, channel);
+		expected.set_voxel(100 + i, pos, channel);
+	}
+	vb.fill_area(42, Vector3i(1, 2, 3), Vector3i(5, 6, 7), channel);
+	expected.fill_area(42, Vector3i(1, 2, 3), Vector3i(5, 6, 7), channel);
+	ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE);
+	L::check_same_voxels(vb, expected, channel);
+
+	// Reading into a dense buffer
+	{
+		StdVector<uint16_t> dense;
+		dense.resize(Vector3iUtil::get_volume_u64(size));
+		vb.copy_channel_to(to_span(dense), size, Vector3i(), Vector3i(), size, channel);
+		Span<const uint16_t> expected_data;
+		ZN_TEST_ASSERT(expected.get_channel_data_read_only(channel, expected_data));
+		for (unsigned int i = 0; i < dense.size(); ++i) {
+			ZN_TEST_ASSERT(dense[i] == expected_data[i]);
+		}
+	}
+
+	// Copying an area out of a palette
+	{
+		VoxelBuffer dst(VoxelBuffer::ALLOCATOR_DEFAULT);
+		dst.create(size);
+		dst.set_channel_depth(channel, VoxelBuffer::DEPTH_16_BIT);
+		dst.copy_channel_from(vb, Vector3i(2, 3, 4), Vector3i(10, 12, 14), Vector3i(1, 1, 1), channel);
+		Vector3i pos;
+		for (pos.z = 0; pos.z < 10; ++pos.z) {
+			for (pos.x = 0; pos.x < 8; ++pos.x) {
+				for (pos.y = 0; pos.y < 9; ++pos.y) {
+					ZN_TEST_ASSERT(
+							dst.get_voxel(pos + Vector3i(1, 1, 1), channel) ==
+							expected.get_voxel(pos + Vector3i(2, 3, 4), channel)
+					);
+				}
+			}
+		}
+	}
+
+	// Serialization stores raw voxels
+	{
+		BlockSerializer::SerializeResult sresult = BlockSerializer::serialize(vb);
+		ZN_TEST_ASSERT(sresult.success);
+		StdVector<uint8_t> bytes = sresult.data;
+		VoxelBuffer rvb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span(bytes), rvb));
+		ZN_TEST_ASSERT(rvb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
+		ZN_TEST_ASSERT(rvb.equals(expected));
+	}
+
+	// Raw access expands the palette
+	{
+		Span<uint16_t> data;
+		ZN_TEST_ASSERT(vb.get_channel_data(channel, data));
+		ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
+		L::check_same_voxels(vb, expected, channel);
+	}
+
+	// Too many distinct values
+	for (unsigned int i = 0; i < 2000; ++i) {
+		const Vector3i pos(i % size.x, (i / size.x) % size.y, (i * 11) % size.z);
+		vb.set_voxel(i, pos, channel);
+		expected.set_voxel(i, pos, channel);
+	}
+	vb.compress_palette_channel(channel);
+	ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
+	L::check_same_voxels(vb, expected, channel);
+
+	// Single value becomes uniform
+	vb.fill_area(5, Vector3i(), size, channel);
+	vb.compress_palette_channel(channel);
+	ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_UNIFORM);
+	ZN_TEST_ASSERT(vb.get_voxel(Vector3i(3, 4, 5), channel) == 5);
+}
+
+void test_voxel_buffer_bulk_f() {
+	const Vector3i size(16, 18, 20);
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_SDF;
+	const Box3i boxes[] = {
+		Box3i(Vector3i(), size), //
+		Box3i(Vector3i(1, 2, 3), Vector3i(5, 7, 9)), //
+		// Single slice, like generators produce
+		Box3i(Vector3i(2, 4, 1), Vector3i(10, 1, 12))
+	};
+
+	for (unsigned int depth = 0; depth < VoxelBuffer::DEPTH_COUNT; ++depth) {
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(size);
+		vb.set_channel_depth(channel, VoxelBuffer::Depth(depth));
+
+		StdVector<float> values;
+
+		// Uniform channel
+		values.resize(Vector3iUtil::get_volume_u64(size));
+		vb.get_channel_f(channel, to_span(values));
+		for (const float v : values) {
+			ZN_TEST_ASSERT(v == vb.get_voxel_f(Vector3i(), channel));
+		}
+
+		for (const Box3i box : boxes) {
+			values.resize(Vector3iUtil::get_volume_u64(box.size));
+			for (unsigned int i = 0; i < values.size(); ++i) {
+				values[i] = float(int(i % 41) - 20) * 0.25f;
+			}
+			vb.set_box_f(box, channel, to_span(values));
+
+			StdVector<float> read_values;
+			read_values.resize(values.size());
+			vb.get_box_f(box, channel, to_span(read_values));
+
+			// Bulk conversions must give the same results as converting voxels one by one
+			unsigned int i = 0;
+			Vector3i pos;
+			for (pos.z = box.position.z; pos.z < box.position.z + box.size.z; ++pos.z) {
+				for (pos.x = box.position.x; pos.x < box.position.x + box.size.x; ++pos.x) {
+					for (pos.y = box.position.y; pos.y < box.position.y + box.size.y; ++pos.y) {
+						VoxelBuffer expected(VoxelBuffer::ALLOCATOR_DEFAULT);
+						expected.create(Vector3i(1, 1, 1));
+						expected.set_channel_depth(channel, VoxelBuffer::Depth(depth));
+						expected.set_voxel_f(values[i], Vector3i(), channel);
+
+						ZN_TEST_ASSERT(vb.get_voxel(pos, channel) == expected.get_voxel(Vector3i(), channel));
+						ZN_TEST_ASSERT(read_values[i] == vb.get_voxel_f(pos, channel));
+						++i;
+					}
+				}
+			}
+		}
+
+		if (VoxelBuffer::is_bit_packed_depth(VoxelBuffer::Depth(depth))) {
+			// Palette compression is not used with bit-packed depths
+			continue;
+		}
+
+		// Palette-compressed channel
+		const Vector3i pos0(1, 2, 3);
+		const Vector3i pos1(4, 5, 6);
+		vb.clear_channel_f(channel, 1.f);
+		vb.set_voxel_f(-2.f, pos0, channel);
+		vb.set_voxel_f(3.f, pos1, channel);
+		vb.compress_palette_channel(channel);
+		ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE);
+		values.resize(Vector3iUtil::get_volume_u64(size));
+		vb.get_channel_f(channel, to_span(values));
+		ZN_TEST_ASSERT(values[Vector3iUtil::get_zxy_index(pos0, size)] == vb.get_voxel_f(pos0, channel));
+		ZN_TEST_ASSERT(values[Vector3iUtil::get_zxy_index(pos1, size)] == vb.get_voxel_f(pos1, channel));
+		ZN_TEST_ASSERT(values[0] == vb.get_voxel_f(Vector3i(), channel));
+	}
+}
+
+void test_voxel_buffer_bulk_i() {
+	const Vector3i size(16, 18, 20);
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+	const Box3i boxes[] = {
+		Box3i(Vector3i(), size), //
+		Box3i(Vector3i(1, 2, 3), Vector3i(5, 7, 9)), //
+		Box3i(Vector3i(2, 4, 1), Vector3i(10, 1, 12))
+	};
+
+	for (unsigned int depth = 0; depth < VoxelBuffer::DEPTH_COUNT; ++depth) {
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(size);
+		vb.set_channel_depth(channel, VoxelBuffer::Depth(depth));
+		vb.fill(1, channel);
+
+		StdVector<int32_t> values;
+
+		// Uniform channel
+		values.resize(Vector3iUtil::get_volume_u64(size));
+		vb.get_box(Box3i(Vector3i(), size), channel, to_span(values));
+		for (const int32_t v : values) {
+			ZN_TEST_ASSERT(v == 1);
+		}
+
+		for (const Box3i box : boxes) {
+			values.resize(Vector3iUtil::get_volume_u64(box.size));
+			for (unsigned int i = 0; i < values.size(); ++i) {
+				values[i] = i * 7919;
+			}
+			vb.set_box(box, channel, to_span(values));
+
+			StdVector<int32_t> read_values;
+			read_values.resize(values.size());
+			vb.get_box(box, channel, to_span(read_values));
+
+			// Bulk access must give the same results as accessing voxels one by one
+			unsigned int i = 0;
+			Vector3i pos;
+			for (pos.z = box.position.z; pos.z < box.position.z + box.size.z; ++pos.z) {
+				for (pos.x = box.position.x; pos.x < box.position.x + box.size.x; ++pos.x) {
+					for (pos.y = box.position.y; pos.y < box.position.y + box.size.y; ++pos.y) {
+						VoxelBuffer expected(VoxelBuffer::ALLOCATOR_DEFAULT);
+						expected.create(Vector3i(1, 1, 1));
+						expected.set_channel_depth(channel, VoxelBuffer::Depth(depth));
+						expected.set_voxel(values[i], Vector3i(), channel);
+
+						ZN_TEST_ASSERT(vb.get_voxel(pos, channel) == expected.get_voxel(Vector3i(), channel));
+						ZN_TEST_ASSERT(read_values[i] == static_cast<int32_t>(vb.get_voxel(pos, channel)));
+						++i;
+					}
+				}
+			}
+		}
+
+		if (VoxelBuffer::is_bit_packed_depth(VoxelBuffer::Depth(depth))) {
+			continue;
+		}
+
+		// Palette-compressed channel
+		const Vector3i pos0(1, 2, 3);
+		const Vector3i pos1(4, 5, 6);
+		vb.fill(1, channel);
+		vb.set_voxel(2, pos0, channel);
+		vb.set_voxel(3, pos1, channel);
+		vb.compress_palette_channel(channel);
+		ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE);
+		values.resize(Vector3iUtil::get_volume_u64(size));
+		vb.get_box(Box3i(Vector3i(), size), channel, to_span(values));
+		ZN_TEST_ASSERT(values[Vector3iUtil::get_zxy_index(pos0, size)] == 2);
+		ZN_TEST_ASSERT(values[Vector3iUtil::get_zxy_index(pos1, size)] == 3);
+		ZN_TEST_ASSERT(values[0] == 1);
+	}
+}
+
+void test_voxel_buffer_packed_depths() {
+	// Odd size so rows don't start on byte boundaries
+	const Vector3i size(5, 7, 9);
+	const uint64_t volume = Vector3iUtil::get_volume_u64(size);
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_DATA5;
+	const VoxelBuffer::Depth depths[] = {
+		VoxelBuffer::DEPTH_1_BIT, //
+		VoxelBuffer::DEPTH_2_BIT, //
+		VoxelBuffer::DEPTH_4_BIT //
+	};
+
+	for (const VoxelBuffer::Depth depth : depths) {
+		const unsigned int bits = VoxelBuffer::get_depth_bit_count(depth);
+		const uint64_t max_value = (1 << bits) - 1;
+
+		ZN_TEST_ASSERT(VoxelBuffer::is_bit_packed_depth(depth));
+		ZN_TEST_ASSERT(VoxelBuffer::get_size_in_bytes_for_volume(size, depth) == (volume * bits + 7) / 8);
+
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		vb.create(size);
+		vb.set_channel_depth(channel, depth);
+		ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_UNIFORM);
+
+		// Values wrap to the depth's range
+		auto expected_value = [max_value](Vector3i pos) { //
+			return uint64_t(pos.x * 3 + pos.y * 5 + pos.z * 7) % (max_value + 1);
+		};
+
+		{
+			// Setting voxels one by one must not affect neighbors sharing the same byte
+			Vector3i pos;
+			for (pos.z = 0; pos.z < size.z; ++pos.z) {
+				for (pos.x = 0; pos.x < size.x; ++pos.x) {
+					for (pos.y = 0; pos.y < size.y; ++pos.y) {
+						vb.set_voxel(expected_value(pos), pos, channel);
+					}
+				}
+			}
+			ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
+			for (pos.z = 0; pos.z < size.z; ++pos.z) {
+				for (pos.x = 0; pos.x < size.x; ++pos.x) {
+					for (pos.y = 0; pos.y < size.y; ++pos.y) {
+						ZN_TEST_ASSERT(vb.get_voxel(pos, channel) == expected_value(pos));
+					}
+				}
+			}
+			ZN_TEST_ASSERT(!vb.is_uniform(channel));
+		}
+		{
+			// Serialization round-trip
+			BlockSerializer::SerializeResult result = BlockSerializer::serialize(vb);
+			ZN_TEST_ASSERT(result.success);
+			VoxelBuffer vb2(VoxelBuffer::ALLOCATOR_DEFAULT);
+			ZN_TEST_ASSERT(BlockSerializer::deserialize(to_span_const(result.data), vb2));
+			ZN_TEST_ASSERT(vb2.get_channel_depth(channel) == depth);
+			ZN_TEST_ASSERT(vb.equals(vb2));
+		}
+		{
+			// Copy a region at an offset, so source and destination bits are not aligned the same way
+			VoxelBuffer vb2(VoxelBuffer::ALLOCATOR_DEFAULT);
+			vb2.create(size);
+			vb2.set_channel_depth(channel, depth);
+			const Vector3i src_min(1, 1, 1);
+			const Vector3i src_max(4, 6, 7);
+			const Vector3i dst_min(0, 1, 2);
+			vb2.copy_channel_from(vb, src_min, src_max, dst_min, channel);
+			Vector3i pos;
+			for (pos.z = 0; pos.z < size.z; ++pos.z) {
+				for (pos.x = 0; pos.x < size.x; ++pos.x) {
+					for (pos.y = 0; pos.y < size.y; ++pos.y) {
+						const Vector3i src_pos = pos - dst_min + src_min;
+						const bool inside = Box3i::from_min_max(src_min, src_max).contains(src_pos);
+						const uint64_t v = inside ? expected_value(src_pos) : 0;
+						ZN_TEST_ASSERT(vb2.get_voxel(pos, channel) == v);
+					}
+				}
+			}
+		}
+		{
+			// Filling an area must preserve voxels outside of it
+			const Vector3i min(1, 2, 3);
+			const Vector3i max(4, 6, 8);
+			vb.fill_area(max_value, min, max, channel);
+			Vector3i pos;
+			for (pos.z = 0; pos.z < size.z; ++pos.z) {
+				for (pos.x = 0; pos.x < size.x; ++pos.x) {
+					for (pos.y = 0; pos.y < size.y; ++pos.y) {
+						const bool inside = Box3i::from_min_max(min, max).contains(pos);
+						const uint64_t v = inside ? max_value : expected_value(pos);
+						ZN_TEST_ASSERT(vb.get_voxel(pos, channel) == v);
+					}
+				}
+			}
+		}
+		{
+			// Uniform detection
+			vb.fill_area(1, Vector3i(), size, channel);
+			ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
+			ZN_TEST_ASSERT(vb.is_uniform(channel));
+			vb.set_voxel(0, size - Vector3i(1, 1, 1), channel);
+			ZN_TEST_ASSERT(!vb.is_uniform(channel));
+			vb.set_voxel(1, size - Vector3i(1, 1, 1), channel);
+			vb.compress_uniform_channels();
+			ZN_TEST_ASSERT(vb.get_channel_compression(channel) == VoxelBuffer::COMPRESSION_UNIFORM);
+			ZN_TEST_ASSERT(vb.get_voxel(Vector3i(2, 3, 4), channel) == 1);
+		}
+		{
+			// Values out of range are clamped
+			vb.set_voxel_f(100.f, Vector3i(1, 2, 3), channel);
+			ZN_TEST_ASSERT(vb.get_voxel(Vector3i(1, 2, 3), channel) == max_value);
+			vb.set_voxel_f(-100.f, Vector3i(1, 2, 3), channel);
+			ZN_TEST_ASSERT(vb.get_voxel(Vector3i(1, 2, 3), channel) == 0);
+		}
+	}
+}
+
+void test_voxel_buffer_downscale_type_majority() {
+	VoxelBuffer src(VoxelBuffer::ALLOCATOR_DEFAULT);
+	src.create(Vector3i(4, 2, 2));
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	struct L {
+		static void fill_cell(VoxelBuffer &vb, int cell_x, const uint64_t *values, VoxelBuffer::ChannelId channel) {
+			for (unsigned int i = 0; i < 8; ++i) {
+				const Vector3i pos(cell_x * 2 + (i & 1), (i >> 1) & 1, (i >> 2) & 1);
+				vb.set_voxel(values[i], pos, channel);
+			}
+		}
+	};
+
+	// Half air, half solid: solid wins the tie, so thin floors don't disappear
+	const uint64_t cell0[8] = { 2, 2, 0, 0, 2, 2, 0, 0 };
+	// Mostly type 3, with a single voxel first in the cell that nearest-neighbor would have picked
+	const uint64_t cell1[8] = { 1, 3, 3, 3, 3, 3, 0, 0 };
+	L::fill_cell(src, 0, cell0, channel);
+	L::fill_cell(src, 1, cell1, channel);
+
+	// Other channels still use nearest-neighbor
+	src.set_voxel(7, Vector3i(2, 0, 0), VoxelBuffer::CHANNEL_DATA5);
+	src.set_voxel(9, Vector3i(3, 0, 0), VoxelBuffer::CHANNEL_DATA5);
+
+	VoxelBuffer dst(VoxelBuffer::ALLOCATOR_DEFAULT);
+	dst.create(Vector3i(2, 1, 1));
+	src.downscale_to(dst, Vector3i(), src.get_size(), Vector3i());
+
+	ZN_TEST_ASSERT(dst.get_voxel(Vector3i(0, 0, 0), channel) == 2);
+	ZN_TEST_ASSERT(dst.get_voxel(Vector3i(1, 0, 0), channel) == 3);
+	ZN_TEST_ASSERT(dst.get_voxel(Vector3i(1, 0, 0), VoxelBuffer::CHANNEL_DATA5) == 7);
+}
+
+void test_voxel_buffer_bulk_f_benchmark(testing::BenchmarkSuite &suite) {
+	const Vector3i size = Vector3iUtil::create(34);
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_SDF;
+
+	VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	vb.create(size);
+	vb.set_channel_depth(channel, VoxelBuffer::DEPTH_16_BIT);
+	vb.decompress_channel(channel);
+
+	StdVector<float> initial_values;
+	initial_values.resize(Vector3iUtil::get_volume_u64(size));
+	for (unsigned int i = 0; i < initial_values.size(); ++i) {
+		initial_values[i] = float(int(i % 101) - 50) * 0.1f;
+	}
+
+	StdVector<float> values = initial_values;
+	suite.run("voxel_buffer_sdf_per_voxel_round_trip", 10, [&vb, &values, size, channel]() {
+		unsigned int i = 0;
+		Vector3i pos;
+		for (pos.z = 0; pos.z < size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < size.x; ++pos.x) {
+				for (pos.y = 0; pos.y < size.y; ++pos.y) {
+					vb.set_voxel_f(values[i], pos, channel);
+					++i;
+				}
+			}
+		}
+		i = 0;
+		for (pos.z = 0; pos.z < size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < size.x; ++pos.x) {
+				for (pos.y = 0; pos.y < size.y; ++pos.y) {
+					values[i] = vb.get_voxel_f(pos, channel);
+					++i;
+				}
+			}
+		}
+	});
+	const StdVector<float> single_values = values;
+
+	values = initial_values;
+	suite.run("voxel_buffer_sdf_bulk_round_trip", 10, [&vb, &values, channel]() {
+		vb.set_channel_f(channel, to_span(values));
+		vb.get_channel_f(channel, to_span(values));
+	});
+
+	// Both must quantize values the same way
+	ZN_TEST_ASSERT(values == single_values);
+}
+
 } // namespace zylann::voxel::tests
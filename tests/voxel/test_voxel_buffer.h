@@ -1,13 +1,24 @@
 #ifndef VOXEL_TESTS_VOXEL_BUFFER_H
 #define VOXEL_TESTS_VOXEL_BUFFER_H
 
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
 namespace zylann::voxel::tests {
 
 void test_voxel_buffer_create();
 void test_voxel_buffer_metadata();
+void test_voxel_buffer_metadata_in_area();
 void test_voxel_buffer_metadata_gd();
 void test_voxel_buffer_paste_masked();
 void test_voxel_buffer_set_channel_bytes();
+void test_voxel_buffer_palette();
+void test_voxel_buffer_bulk_f();
+void test_voxel_buffer_bulk_i();
+void test_voxel_buffer_packed_depths();
+void test_voxel_buffer_downscale_type_majority();
+void test_voxel_buffer_bulk_f_benchmark(testing::BenchmarkSuite &suite);
 
 } // namespace zylann::voxel::tests
 
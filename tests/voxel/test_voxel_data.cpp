@@ -0,0 +1,434 @@
+#include "test_voxel_data.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_data.h"
+#include "../../storage/voxel_data_grid.h"
+#include "../../util/containers/std_vector.h"
+#include "../testing.h"
+#include <algorithm>
+
+namespace zylann::voxel::tests {
+
+void test_voxel_data_cache_eviction() {
+	VoxelData data;
+	const Vector3i block_size = Vector3iUtil::create(data.get_block_size());
+
+	auto create_block = [block_size](bool edited, bool modified) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		// Make sure the channel is allocated
+		buffer->set_voxel(1, 1, 2, 3, VoxelBuffer::CHANNEL_TYPE);
+		VoxelDataBlock block(buffer, 0);
+		block.set_edited(edited);
+		block.set_modified(modified);
+		return block;
+	};
+
+	const unsigned int cached_block_count = 8;
+	for (unsigned int i = 0; i < cached_block_count; ++i) {
+		ZN_TEST_ASSERT(data.try_set_block(Vector3i(i, 0, 0), create_block(false, false)));
+	}
+	// Edited blocks must never be evicted
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 1, 0), create_block(true, true)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(1, 1, 0), create_block(true, false)));
+	// Cached block with pending modifications, such as generator output to save
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 2, 0), create_block(false, true)));
+
+	const size_t block_memory_usage = data.try_get_block_voxels(Vector3i(0, 0, 0))->get_channels_memory_usage();
+	ZN_TEST_ASSERT(block_memory_usage > 0);
+
+	// No budget, nothing gets evicted
+	ZN_TEST_ASSERT(data.evict_cached_blocks(nullptr) == 0);
+
+	data.set_cache_memory_budget(3 * block_memory_usage);
+
+	// Access 3 blocks
+	{
+		StdVector<std::shared_ptr<VoxelBuffer>> buffers;
+		const Box3i box(Vector3i(5, 0, 0), Vector3i(3, 1, 1));
+		buffers.resize(Vector3iUtil::get_volume_u64(box.size));
+		data.get_blocks_with_voxel_data(box, 0, to_span(buffers));
+		for (const std::shared_ptr<VoxelBuffer> &buffer : buffers) {
+			ZN_TEST_ASSERT(buffer != nullptr);
+		}
+	}
+
+	// Least recently accessed blocks are evicted first. The modified block is kept because we don't provide a way to
+	// save it.
+	ZN_TEST_ASSERT(data.evict_cached_blocks(nullptr) == 5);
+	for (unsigned int i = 0; i < 5; ++i) {
+		const Vector3i bpos(i, 0, 0);
+		// Blocks remain loaded, only their cache is cleared
+		ZN_TEST_ASSERT(data.has_block(bpos, 0));
+		ZN_TEST_ASSERT(data.try_get_block_voxels(bpos) == nullptr);
+	}
+	for (unsigned int i = 5; i < cached_block_count; ++i) {
+		ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(i, 0, 0)) != nullptr);
+	}
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(0, 1, 0)) != nullptr);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(1, 1, 0)) != nullptr);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(0, 2, 0)) != nullptr);
+
+	// Still over budget due to the modified block, but remaining blocks were accessed by the checks above
+	ZN_TEST_ASSERT(data.evict_cached_blocks(nullptr) == 0);
+
+	// Modified cached blocks are given back for saving before being evicted
+	data.set_cache_memory_budget(1);
+	StdVector<VoxelData::BlockToSave> to_save;
+	ZN_TEST_ASSERT(data.evict_cached_blocks(&to_save) == 4);
+	ZN_TEST_ASSERT(to_save.size() == 1);
+	ZN_TEST_ASSERT(to_save[0].position == Vector3i(0, 2, 0));
+	ZN_TEST_ASSERT(to_save[0].voxels != nullptr);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(0, 2, 0)) == nullptr);
+
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(0, 1, 0)) != nullptr);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(1, 1, 0)) != nullptr);
+}
+
+void test_voxel_data_copy_on_write() {
+	VoxelData data;
+	const int block_size = data.get_block_size();
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+	buffer->create(Vector3iUtil::create(block_size));
+	buffer->set_voxel(1, Vector3i(), channel);
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(), VoxelDataBlock(buffer, 0)));
+	buffer.reset();
+
+	// Take a snapshot, like meshing tasks do
+	std::shared_ptr<VoxelBuffer> snapshot;
+	data.get_blocks_with_voxel_data(
+			Box3i(Vector3i(), Vector3i(1, 1, 1)), 0, Span<std::shared_ptr<VoxelBuffer>>(&snapshot, 1)
+	);
+	ZN_TEST_ASSERT(snapshot != nullptr);
+
+	// Editing a single voxel must not modify the snapshot
+	ZN_TEST_ASSERT(data.try_set_voxel(2, Vector3i(1, 0, 0), channel));
+	ZN_TEST_ASSERT(snapshot->get_voxel(Vector3i(1, 0, 0), channel) == 0);
+	ZN_TEST_ASSERT(snapshot->get_voxel(Vector3i(), channel) == 1);
+
+	std::shared_ptr<VoxelBuffer> current = data.try_get_block_voxels(Vector3i());
+	ZN_TEST_ASSERT(current != nullptr);
+	ZN_TEST_ASSERT(current != snapshot);
+	ZN_TEST_ASSERT(current->get_voxel(Vector3i(1, 0, 0), channel) == 2);
+	ZN_TEST_ASSERT(current->get_voxel(Vector3i(), channel) == 1);
+	snapshot = current;
+	current.reset();
+
+	// Same with edits done through a grid, like VoxelTool does
+	{
+		VoxelDataGrid grid;
+		data.get_blocks_grid(grid, Box3i(Vector3i(), Vector3iUtil::create(block_size)), 0);
+		grid.write_box(Box3i(Vector3i(), Vector3i(2, 1, 1)), channel, [](Vector3i pos, uint64_t v) { return 3; });
+	}
+	ZN_TEST_ASSERT(snapshot->get_voxel(Vector3i(), channel) == 1);
+	ZN_TEST_ASSERT(snapshot->get_voxel(Vector3i(1, 0, 0), channel) == 2);
+
+	current = data.try_get_block_voxels(Vector3i());
+	ZN_TEST_ASSERT(current->get_voxel(Vector3i(), channel) == 3);
+	ZN_TEST_ASSERT(current->get_voxel(Vector3i(1, 0, 0), channel) == 3);
+}
+
+void test_voxel_data_compaction() {
+	VoxelData data;
+	const Vector3i block_size = Vector3iUtil::create(data.get_block_size());
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	auto create_block = [block_size, channel](bool uniform) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		// Allocates the channel
+		buffer->set_voxel(1, Vector3i(), channel);
+		if (uniform) {
+			// As if an edit was undone
+			buffer->set_voxel(0, Vector3i(), channel);
+		}
+		return VoxelDataBlock(buffer, 0);
+	};
+
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 0, 0), create_block(true)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(1, 0, 0), create_block(true)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(2, 0, 0), create_block(false)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(3, 0, 0), create_block(true)));
+
+	const size_t block_memory_usage = data.try_get_block_voxels(Vector3i(0, 0, 0))->get_channels_memory_usage();
+	ZN_TEST_ASSERT(block_memory_usage > 0);
+
+	// Referenced by a task at the moment
+	std::shared_ptr<VoxelBuffer> snapshot = data.try_get_block_voxels(Vector3i(3, 0, 0));
+
+	// Work is spread over multiple calls
+	VoxelData::CompactionResult result = data.compact_blocks(3);
+	ZN_TEST_ASSERT(result.visited_blocks == 3);
+	ZN_TEST_ASSERT(!result.pass_completed);
+	unsigned int compacted_blocks = result.compacted_blocks;
+	uint64_t reclaimed_bytes = result.reclaimed_bytes;
+
+	result = data.compact_blocks(100);
+	ZN_TEST_ASSERT(result.visited_blocks == 1);
+	ZN_TEST_ASSERT(result.pass_completed);
+	compacted_blocks += result.compacted_blocks;
+	reclaimed_bytes += result.reclaimed_bytes;
+
+	ZN_TEST_ASSERT(compacted_blocks == 2);
+	ZN_TEST_ASSERT(reclaimed_bytes == 2 * block_memory_usage);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(0, 0, 0))->get_channel_compression(channel) ==
+			VoxelBuffer::COMPRESSION_UNIFORM);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(1, 0, 0))->get_channel_compression(channel) ==
+			VoxelBuffer::COMPRESSION_UNIFORM);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(2, 0, 0))->get_voxel(Vector3i(), channel) == 1);
+
+	// The shared block was left alone, and gets compacted in the next pass
+	ZN_TEST_ASSERT(snapshot->get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
+	snapshot.reset();
+
+	result = data.compact_blocks(100);
+	ZN_TEST_ASSERT(result.visited_blocks == 4);
+	ZN_TEST_ASSERT(result.pass_completed);
+	ZN_TEST_ASSERT(result.compacted_blocks == 1);
+	ZN_TEST_ASSERT(result.reclaimed_bytes == block_memory_usage);
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(3, 0, 0))->get_channel_compression(channel) ==
+			VoxelBuffer::COMPRESSION_UNIFORM);
+}
+
+void test_voxel_data_cold_compression() {
+	VoxelData data;
+	const Vector3i block_size = Vector3iUtil::create(data.get_block_size());
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	auto create_block = [block_size, channel]() {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		// Not uniform, but compresses well
+		for (int y = 0; y < block_size.y / 2; ++y) {
+			buffer->set_voxel(1, Vector3i(0, y, 0), channel);
+		}
+		return VoxelDataBlock(buffer, 0);
+	};
+
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 0, 0), create_block()));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(1, 0, 0), create_block()));
+
+	const uint32_t cold_delay_msec = 1000;
+
+	// Nothing was loaded long enough ago
+	VoxelData::CompactionResult result = data.compact_blocks(100, cold_delay_msec, 0);
+	ZN_TEST_ASSERT(result.pass_completed);
+	ZN_TEST_ASSERT(result.cold_compressed_blocks == 0);
+
+	// Accessed after the previous pass
+	ZN_TEST_ASSERT(data.try_get_block_voxels(Vector3i(1, 0, 0)) != nullptr);
+
+	result = data.compact_blocks(100, cold_delay_msec, cold_delay_msec);
+	ZN_TEST_ASSERT(result.pass_completed);
+	ZN_TEST_ASSERT(result.cold_compressed_blocks == 1);
+	ZN_TEST_ASSERT(result.reclaimed_bytes > 0);
+
+	VoxelData::MemoryUsage usage = data.get_memory_usage();
+	ZN_TEST_ASSERT(usage.blocks_with_voxels == 2);
+	ZN_TEST_ASSERT(usage.compressed_blocks == 1);
+	ZN_TEST_ASSERT(usage.compressed_bytes > 0);
+
+	// Accessing the cold block decompresses it
+	const uint64_t decompressions_before = VoxelDataBlock::get_total_voxels_decompressions();
+	std::shared_ptr<VoxelBuffer> voxels = data.try_get_block_voxels(Vector3i(0, 0, 0));
+	ZN_TEST_ASSERT(voxels != nullptr);
+	ZN_TEST_ASSERT(VoxelDataBlock::get_total_voxels_decompressions() == decompressions_before + 1);
+	ZN_TEST_ASSERT(voxels->get_voxel(Vector3i(0, 1, 0), channel) == 1);
+	ZN_TEST_ASSERT(voxels->get_voxel(Vector3i(1, 1, 0), channel) == 0);
+
+	usage = data.get_memory_usage();
+	ZN_TEST_ASSERT(usage.compressed_blocks == 0);
+}
+
+void test_voxel_data_block_read_access() {
+	VoxelData data;
+	const int block_size = data.get_block_size();
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+	buffer->create(Vector3iUtil::create(block_size));
+	buffer->set_voxel(1, Vector3i(2, 3, 4), channel);
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(1, 0, 0), VoxelDataBlock(buffer, 0)));
+	buffer.reset();
+
+	VoxelSingleValue defval;
+	defval.i = 42;
+
+	VoxelData::BlockReadAccess access;
+	ZN_TEST_ASSERT(!access.is_valid());
+
+	data.acquire_block_read_access(Vector3i(block_size + 5, 6, 7), access);
+	ZN_TEST_ASSERT(access.is_valid());
+	ZN_TEST_ASSERT(access.get_state() == VoxelData::BlockReadAccess::STATE_STORED);
+	ZN_TEST_ASSERT(access.get_voxel_box() == Box3i(Vector3i(block_size, 0, 0), Vector3iUtil::create(block_size)));
+	ZN_TEST_ASSERT(access.get_voxel(Vector3i(block_size + 2, 3, 4), channel, defval).i == 1);
+	ZN_TEST_ASSERT(access.get_voxel(Vector3i(block_size, 0, 0), channel, defval).i == 0);
+
+	// Streaming is enabled, so a missing block is not loaded
+	data.acquire_block_read_access(Vector3i(-1, 0, 0), access);
+	ZN_TEST_ASSERT(access.get_state() == VoxelData::BlockReadAccess::STATE_NOT_LOADED);
+	ZN_TEST_ASSERT(access.get_voxel(Vector3i(-1, 0, 0), channel, defval).i == defval.i);
+
+	access.release();
+	ZN_TEST_ASSERT(!access.is_valid());
+
+	// The block must have been unlocked, otherwise this would block forever
+	ZN_TEST_ASSERT(data.try_set_voxel(2, Vector3i(block_size + 2, 3, 4), channel));
+	ZN_TEST_ASSERT(data.get_voxel(Vector3i(block_size + 2, 3, 4), channel, defval).i == 2);
+}
+
+void test_voxel_data_palette_compression_shared_voxels() {
+	VoxelData data;
+	data.set_palette_compression_enabled(true);
+	const int block_size = data.get_block_size();
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	auto create_buffer = [block_size, channel]() {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(Vector3iUtil::create(block_size));
+		buffer->set_channel_depth(channel, VoxelBuffer::DEPTH_16_BIT);
+		buffer->fill_area(2, Vector3i(), Vector3iUtil::create(block_size / 2), channel);
+		return buffer;
+	};
+
+	// The caller still holds the buffer, it must not be modified
+	std::shared_ptr<VoxelBuffer> held_buffer = create_buffer();
+	ZN_TEST_ASSERT(held_buffer->get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 0, 0), VoxelDataBlock(held_buffer, 0)));
+	ZN_TEST_ASSERT(held_buffer->get_channel_compression(channel) == VoxelBuffer::COMPRESSION_NONE);
+
+	std::shared_ptr<VoxelBuffer> stored_buffer = data.try_get_block_voxels(Vector3i(0, 0, 0));
+	ZN_TEST_ASSERT(stored_buffer != nullptr);
+	ZN_TEST_ASSERT(stored_buffer != held_buffer);
+	ZN_TEST_ASSERT(stored_buffer->get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE);
+	ZN_TEST_ASSERT(stored_buffer->equals(*held_buffer));
+	stored_buffer.reset();
+
+	// Nothing else references the buffer, it can be compressed in place
+	VoxelDataBlock block(0);
+	{
+		std::shared_ptr<VoxelBuffer> buffer = create_buffer();
+		block.set_voxels(buffer);
+	}
+	const VoxelBuffer *block_buffer = &block.get_voxels_const();
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(1, 0, 0), block));
+	ZN_TEST_ASSERT(block_buffer->get_channel_compression(channel) == VoxelBuffer::COMPRESSION_PALETTE);
+	stored_buffer = data.try_get_block_voxels(Vector3i(1, 0, 0));
+	ZN_TEST_ASSERT(stored_buffer.get() == block_buffer);
+	ZN_TEST_ASSERT(stored_buffer->equals(*held_buffer));
+}
+
+void test_voxel_data_save_snapshot() {
+	VoxelData data;
+	const int block_size = data.get_block_size();
+	const VoxelBuffer::ChannelId channel = VoxelBuffer::CHANNEL_TYPE;
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(Vector3iUtil::create(block_size));
+		ZN_TEST_ASSERT(data.try_set_block(Vector3i(i, 0, 0), VoxelDataBlock(buffer, 0)));
+	}
+
+	ZN_TEST_ASSERT(data.try_set_voxel(1, Vector3i(), channel));
+	data.mark_area_modified(Box3i(Vector3i(), Vector3i(1, 1, 1)), nullptr, false);
+
+	StdVector<VoxelData::BlockToSave> to_save;
+	data.consume_all_modifications(to_save);
+	ZN_TEST_ASSERT(to_save.size() == 1);
+	ZN_TEST_ASSERT(to_save[0].position == Vector3i());
+	// Saved data is not copied upfront
+	ZN_TEST_ASSERT(to_save[0].voxels == data.try_get_block_voxels(Vector3i()));
+
+	// Edits made while saving must not affect what is being saved
+	ZN_TEST_ASSERT(data.try_set_voxel(2, Vector3i(), channel));
+	ZN_TEST_ASSERT(to_save[0].voxels->get_voxel(Vector3i(), channel) == 1);
+	VoxelSingleValue defval;
+	defval.i = 0;
+	ZN_TEST_ASSERT(data.get_voxel(Vector3i(), channel, defval).i == 2);
+
+	// Modifications were consumed
+	to_save.clear();
+	data.consume_all_modifications(to_save);
+	ZN_TEST_ASSERT(to_save.size() == 0);
+}
+
+void test_voxel_data_missing_lod_mips() {
+	VoxelData data;
+	data.set_lod_count(3);
+	const Vector3i block_size = Vector3iUtil::create(data.get_block_size());
+
+	auto create_block = [block_size](unsigned int lod_index, bool edited) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		VoxelDataBlock block(buffer, lod_index);
+		block.set_edited(edited);
+		return block;
+	};
+
+	// All mips present
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 0, 0), create_block(0, true)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 0, 0), create_block(1, true)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 0, 0), create_block(2, true)));
+	// Not edited, so its mips don't matter
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(2, 0, 0), create_block(0, false)));
+	// Missing LOD1 and LOD2
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(4, 0, 0), create_block(0, true)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(5, 0, 0), create_block(0, true)));
+	// Missing LOD2 only
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(8, 0, 0), create_block(0, true)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(4, 0, 0), create_block(1, true)));
+
+	StdVector<Vector3i> positions;
+	data.mark_lod0_blocks_with_missing_mips(positions);
+	std::sort(positions.begin(), positions.end(), [](Vector3i a, Vector3i b) { return a.x < b.x; });
+	ZN_TEST_ASSERT(positions.size() == 3);
+	ZN_TEST_ASSERT(positions[0] == Vector3i(4, 0, 0));
+	ZN_TEST_ASSERT(positions[1] == Vector3i(5, 0, 0));
+	ZN_TEST_ASSERT(positions[2] == Vector3i(8, 0, 0));
+
+	// Blocks already pending LOD updates are not returned again
+	positions.clear();
+	data.mark_lod0_blocks_with_missing_mips(positions);
+	ZN_TEST_ASSERT(positions.size() == 0);
+}
+
+void test_voxel_data_memory_usage() {
+	VoxelData data;
+	data.set_lod_count(2);
+	const Vector3i block_size = Vector3iUtil::create(data.get_block_size());
+
+	auto create_block = [block_size](unsigned int lod_index, bool with_sdf) {
+		std::shared_ptr<VoxelBuffer> buffer = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer->create(block_size);
+		// Allocates channels
+		buffer->set_voxel(1, Vector3i(), VoxelBuffer::CHANNEL_TYPE);
+		if (with_sdf) {
+			buffer->set_voxel_f(0.5f, Vector3i(), VoxelBuffer::CHANNEL_SDF);
+		}
+		return VoxelDataBlock(buffer, lod_index);
+	};
+
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 0, 0), create_block(0, false)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(1, 0, 0), create_block(0, true)));
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(0, 0, 0), create_block(1, true)));
+	// Block without voxels
+	ZN_TEST_ASSERT(data.try_set_block(Vector3i(2, 0, 0), VoxelDataBlock(0)));
+
+	const std::shared_ptr<VoxelBuffer> voxels = data.try_get_block_voxels(Vector3i(1, 0, 0));
+	ZN_TEST_ASSERT(voxels != nullptr);
+	const size_t type_bytes = voxels->get_channel_memory_usage(VoxelBuffer::CHANNEL_TYPE);
+	const size_t sdf_bytes = voxels->get_channel_memory_usage(VoxelBuffer::CHANNEL_SDF);
+	ZN_TEST_ASSERT(type_bytes > 0);
+	ZN_TEST_ASSERT(sdf_bytes > 0);
+	ZN_TEST_ASSERT(type_bytes + sdf_bytes == voxels->get_channels_memory_usage());
+
+	const VoxelData::MemoryUsage usage = data.get_memory_usage();
+	ZN_TEST_ASSERT(usage.block_count == 4);
+	ZN_TEST_ASSERT(usage.blocks_with_voxels == 3);
+	ZN_TEST_ASSERT(usage.channel_bytes[VoxelBuffer::CHANNEL_TYPE] == 3 * type_bytes);
+	ZN_TEST_ASSERT(usage.channel_bytes[VoxelBuffer::CHANNEL_SDF] == 2 * sdf_bytes);
+	ZN_TEST_ASSERT(usage.channel_bytes[VoxelBuffer::CHANNEL_COLOR] == 0);
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,18 @@
+#ifndef VOXEL_TEST_VOXEL_DATA_H
+#define VOXEL_TEST_VOXEL_DATA_H
+
+namespace zylann::voxel::tests {
+
+void test_voxel_data_cache_eviction();
+void test_voxel_data_copy_on_write();
+void test_voxel_data_compaction();
+void test_voxel_data_cold_compression();
+void test_voxel_data_block_read_access();
+void test_voxel_data_palette_compression_shared_voxels();
+void test_voxel_data_save_snapshot();
+void test_voxel_data_missing_lod_mips();
+void test_voxel_data_memory_usage();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_VOXEL_DATA_H
@@ -1,6 +1,12 @@
 #include "test_voxel_data_map.h"
 #include "../../storage/voxel_buffer.h"
+#include "../../storage/voxel_clipboard.h"
 #include "../../storage/voxel_data_map.h"
+#include "../../util/containers/std_unordered_map.h"
+#include "../../util/containers/vector3i_hash_map.h"
+#include "../../util/io/log.h"
+#include "../../util/string/format.h"
+#include "../benchmarking.h"
 #include "../testing.h"
 
 namespace zylann::voxel::tests {
@@ -162,4 +168,160 @@ void test_voxel_data_map_copy() {
 	ZN_TEST_ASSERT(buffer.equals(buffer2));
 }
 
+void test_voxel_data_map_clipboard() {
+	static const int voxel_value = 1;
+	static const int masked_value = 2;
+	static const int channel = VoxelBuffer::CHANNEL_TYPE;
+
+	VoxelDataMap map;
+	map.create(0);
+	const int block_size = map.get_block_size();
+
+	// Not aligned with blocks, so the clipboard has partial chunks on its edges. It is large enough to fully cover
+	// some blocks too.
+	const Box3i box(Vector3i(10, 10, 10), Vector3iUtil::create(3 * block_size));
+
+	VoxelBuffer buffer(VoxelBuffer::ALLOCATOR_DEFAULT);
+	buffer.create(box.size);
+	// Mix values so chunks aren't all uniform, with a region of the mask value
+	for (int z = 0; z < buffer.get_size().z; ++z) {
+		for (int x = 0; x < buffer.get_size().x; ++x) {
+			for (int y = 0; y < buffer.get_size().y; ++y) {
+				if (y < block_size) {
+					buffer.set_voxel(masked_value, x, y, z, channel);
+				} else if (((x + y + z) % 3) == 0) {
+					buffer.set_voxel(voxel_value, x, y, z, channel);
+				}
+			}
+		}
+	}
+	map.paste(box.position, buffer, (1 << channel), true);
+
+	VoxelClipboard clipboard;
+	map.copy_to_clipboard(box, clipboard, (1 << channel), nullptr, nullptr);
+	ZN_TEST_ASSERT(clipboard.size == box.size);
+	ZN_TEST_ASSERT(clipboard.chunks.size() == 4 * 4 * 4);
+
+	// Paste aligned with blocks, then at an offset
+	const Vector3i dst_positions[] = { Vector3i(64, 0, 0), Vector3i(-37, 5, 3) };
+
+	for (const Vector3i dst_pos : dst_positions) {
+		VoxelDataMap map2;
+		map2.create(0);
+		map2.paste_clipboard(dst_pos, clipboard, (1 << channel), false, 0, 0, true);
+
+		VoxelBuffer buffer2(VoxelBuffer::ALLOCATOR_DEFAULT);
+		buffer2.create(box.size);
+		map2.copy(dst_pos, buffer2, (1 << channel));
+		ZN_TEST_ASSERT(buffer.equals(buffer2));
+	}
+
+	// Masked paste leaves voxels where the clipboard has the mask value
+	{
+		VoxelDataMap map2;
+		map2.create(0);
+		map2.paste_clipboard(Vector3i(), clipboard, (1 << channel), true, channel, masked_value, true);
+
+		bool is_match = true;
+		Box3i(Vector3i(), box.size).for_each_cell([&map2, &buffer, &is_match](const Vector3i &pos) {
+			const int src_v = buffer.get_voxel(pos, channel);
+			const int expected = src_v == masked_value ? 0 : src_v;
+			if (map2.get_voxel(pos, channel) != expected) {
+				is_match = false;
+			}
+		});
+		ZN_TEST_ASSERT(is_match);
+	}
+}
+
+namespace {
+
+// Runs the same access patterns as `VoxelDataMap` does: filling an area, looking up neighbors, iterating all blocks
+template <typename TMap, typename FFind, typename FForEach>
+void run_block_map_benchmark(
+		testing::BenchmarkSuite &suite,
+		const char *map_name,
+		TMap &map,
+		const Box3i box,
+		FFind find_func,
+		FForEach for_each_func
+) {
+	const unsigned int block_count = Vector3iUtil::get_volume_u64(box.size);
+
+	suite.run(format("voxel_data_map_{}_insertion_and_removal", map_name).c_str(), 1, [&map, box]() {
+		box.for_each_cell_zxy([&map](const Vector3i bpos) { //
+			map[bpos] = VoxelDataBlock(0);
+		});
+		box.for_each_cell_zxy([&map](const Vector3i bpos) { //
+			map.erase(bpos);
+		});
+	});
+
+	box.for_each_cell_zxy([&map](const Vector3i bpos) { //
+		map[bpos] = VoxelDataBlock(0);
+	});
+
+	unsigned int found_count = 0;
+	suite.run(format("voxel_data_map_{}_lookup", map_name).c_str(), 1, [&map, box, &found_count, &find_func]() {
+		found_count = 0;
+		box.padded(1).for_each_cell_zxy([&map, &found_count, &find_func](const Vector3i bpos) {
+			if (find_func(map, bpos)) {
+				++found_count;
+			}
+		});
+	});
+
+	unsigned int iterated_count = 0;
+	suite.run(format("voxel_data_map_{}_iteration", map_name).c_str(), 1, [&map, &iterated_count, &for_each_func]() {
+		iterated_count = 0;
+		for_each_func(map, [&iterated_count](const Vector3i bpos, const VoxelDataBlock &block) {
+			if (!block.has_voxels()) {
+				++iterated_count;
+			}
+		});
+	});
+
+	// Every block must have been seen
+	ZN_TEST_ASSERT(found_count == block_count);
+	ZN_TEST_ASSERT(iterated_count == block_count);
+
+	box.for_each_cell_zxy([&map](const Vector3i bpos) { //
+		map.erase(bpos);
+	});
+	ZN_TEST_ASSERT(map.size() == 0);
+}
+
+} // namespace
+
+void test_voxel_data_map_benchmark(testing::BenchmarkSuite &suite) {
+	// 131072 blocks
+	const Box3i box(Vector3i(-32, -16, -32), Vector3i(64, 32, 64));
+
+	StdUnorderedMap<Vector3i, VoxelDataBlock> std_map;
+	run_block_map_benchmark(
+			suite,
+			"std_unordered_map",
+			std_map,
+			box,
+			[](const StdUnorderedMap<Vector3i, VoxelDataBlock> &map, Vector3i bpos) {
+				return map.find(bpos) != map.end();
+			},
+			[](const StdUnorderedMap<Vector3i, VoxelDataBlock> &map, auto f) {
+				for (auto it = map.begin(); it != map.end(); ++it) {
+					f(it->first, it->second);
+				}
+			}
+	);
+
+	Vector3iHashMap<VoxelDataBlock> hash_map;
+	run_block_map_benchmark(
+			suite,
+			"vector3i_hash_map",
+			hash_map,
+			box,
+			[](const Vector3iHashMap<VoxelDataBlock> &map, Vector3i bpos) { return map.has(bpos); },
+			[](const Vector3iHashMap<VoxelDataBlock> &map, auto f) { map.for_each(f); }
+	);
+}
+
 } // namespace zylann::voxel::tests
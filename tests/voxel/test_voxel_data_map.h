@@ -1,11 +1,17 @@
 #ifndef VOXEL_TEST_VOXEL_DATA_MAP_H
 #define VOXEL_TEST_VOXEL_DATA_MAP_H
 
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
 namespace zylann::voxel::tests {
 
 void test_voxel_data_map_paste_fill();
 void test_voxel_data_map_paste_mask();
 void test_voxel_data_map_copy();
+void test_voxel_data_map_clipboard();
+void test_voxel_data_map_benchmark(testing::BenchmarkSuite &suite);
 
 } // namespace zylann::voxel::tests
 
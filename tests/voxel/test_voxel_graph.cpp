@@ -1,20 +1,29 @@
 #include "test_voxel_graph.h"
+#include "../../generators/generate_series_task.h"
+#include "../../generators/graph/expression_bytecode.h"
 #include "../../generators/graph/image_range_grid.h"
 #include "../../generators/graph/node_type_db.h"
 #include "../../generators/graph/range_utility.h"
+#include "../../generators/graph/tiled_image.h"
 #include "../../generators/graph/voxel_generator_graph.h"
+#include "../../modifiers/voxel_modifier_sphere.h"
+#include "../../modifiers/voxel_modifier_stack.h"
 #include "../../storage/materials_4i4w.h"
 #include "../../storage/voxel_buffer.h"
 #include "../../util/containers/container_funcs.h"
 #include "../../util/containers/std_vector.h"
 #include "../../util/godot/classes/fast_noise_lite.h"
 #include "../../util/godot/classes/image.h"
+#include "../../util/godot/core/array.h"
 #include "../../util/godot/core/random_pcg.h"
+#include "../../util/io/log.h"
 #include "../../util/math/conv.h"
 #include "../../util/math/sdf.h"
 #include "../../util/noise/fast_noise_lite/fast_noise_lite.h"
 #include "../../util/string/format.h"
 #include "../../util/string/std_string.h"
+#include "../../util/tasks/threaded_task_runner.h"
+#include "../benchmarking.h"
 #include "../testing.h"
 #include "test_util.h"
 #include <sstream>
@@ -1134,6 +1143,89 @@ void test_voxel_graph_functions_misc() {
 	}
 }
 
+void test_voxel_graph_functions_constant_folding() {
+	Ref<VoxelGraphFunction> func;
+	func.instantiate();
+	{
+		//
+		//  X ------------ Mul --- OutSDF
+		//                /
+		//  InCustom --- Sin
+		//
+		VoxelGraphFunction &g = **func;
+		const uint32_t n_x = g.create_node(VoxelGraphFunction::NODE_INPUT_X, Vector2());
+		const uint32_t n_in_custom = g.create_node(VoxelGraphFunction::NODE_CUSTOM_INPUT, Vector2());
+		const uint32_t n_sin = g.create_node(VoxelGraphFunction::NODE_SIN, Vector2());
+		const uint32_t n_mul = g.create_node(VoxelGraphFunction::NODE_MULTIPLY, Vector2());
+		const uint32_t n_out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		g.set_node_name(n_in_custom, "scale");
+		g.add_connection(n_in_custom, 0, n_sin, 0);
+		g.add_connection(n_x, 0, n_mul, 0);
+		g.add_connection(n_sin, 0, n_mul, 1);
+		g.add_connection(n_mul, 0, n_out_sdf, 0);
+		g.auto_pick_inputs_and_outputs();
+	}
+
+	unsigned int func_x_input_index = 0;
+	unsigned int func_scale_input_index = 0;
+	{
+		Span<const VoxelGraphFunction::Port> inputs = func->get_input_definitions();
+		ZN_TEST_ASSERT(inputs.size() == 2);
+		for (unsigned int i = 0; i < inputs.size(); ++i) {
+			if (inputs[i].type == VoxelGraphFunction::NODE_CUSTOM_INPUT) {
+				func_scale_input_index = i;
+			} else {
+				func_x_input_index = i;
+			}
+		}
+	}
+
+	const float scale = 0.5f;
+
+	Ref<VoxelGeneratorGraph> generator;
+	generator.instantiate();
+	{
+		// The same constant is given to both function instances, once with a constant node and once with a default
+		// input value.
+		//
+		//  Constant --- Func1
+		//            /       \
+		//         X           Add --- OutSDF
+		//            \       /
+		//             Func2
+		//
+		VoxelGraphFunction &g = **generator->get_main_function();
+		const uint32_t n_x = g.create_node(VoxelGraphFunction::NODE_INPUT_X, Vector2());
+		const uint32_t n_constant = g.create_node(VoxelGraphFunction::NODE_CONSTANT, Vector2());
+		const uint32_t n_f1 = g.create_function_node(func, Vector2());
+		const uint32_t n_f2 = g.create_function_node(func, Vector2());
+		const uint32_t n_add = g.create_node(VoxelGraphFunction::NODE_ADD, Vector2());
+		const uint32_t n_out = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		g.set_node_param(n_constant, 0, scale);
+		g.set_node_default_input(n_f2, func_scale_input_index, scale);
+		g.add_connection(n_constant, 0, n_f1, func_scale_input_index);
+		g.add_connection(n_x, 0, n_f1, func_x_input_index);
+		g.add_connection(n_x, 0, n_f2, func_x_input_index);
+		g.add_connection(n_f1, 0, n_add, 0);
+		g.add_connection(n_f2, 0, n_add, 1);
+		g.add_connection(n_add, 0, n_out, 0);
+	}
+
+	const pg::CompilationResult result = generator->compile(false);
+	ZN_TEST_ASSERT_MSG(
+			result.success, String("Failed to compile graph: {0}: {1}").format(varray(result.node_id, result.message))
+	);
+	// Sin, Mul, Sin, Mul, Add, OutSDF
+	ZN_TEST_ASSERT(result.operation_count_before_optimization == 6);
+	// Sin is folded in both instances, which makes Mul nodes identical so they get merged: Mul, Add, OutSDF
+	ZN_TEST_ASSERT(result.operation_count == 3);
+
+	const Vector3i pos(7, 2, 3);
+	const float sd = generator->generate_single(pos, VoxelBuffer::CHANNEL_SDF).f;
+	const float expected = 2.f * float(pos.x) * Math::sin(scale);
+	ZN_TEST_ASSERT(Math::is_equal_approx(sd, expected));
+}
+
 void test_voxel_graph_issue461() {
 	Ref<VoxelGeneratorGraph> generator;
 	generator.instantiate();
@@ -2159,6 +2251,89 @@ void test_image_range_grid() {
 	);
 }
 
+void test_tiled_image() {
+	// Size is not a power of two and not a multiple of tiles
+	Ref<Image> image_ref = Image::create_empty(37, 21, false, Image::FORMAT_RF);
+	Image &image = **image_ref;
+
+	RandomPCG rng;
+	rng.seed(131183);
+	for (int y = 0; y < image.get_height(); ++y) {
+		for (int x = 0; x < image.get_width(); ++x) {
+			const float h = rng.randf();
+			image.set_pixel(x, y, Color(h, h, h));
+		}
+	}
+
+	struct L {
+		static float get_pixel_repeat(const Image &im, const int x, const int y) {
+			return im.get_pixel(math::wrap(x, im.get_width()), math::wrap(y, im.get_height())).r;
+		}
+		// Sampling the image directly, as the Image node used to
+		static float get_pixel_repeat_linear(const Image &im, const float x, const float y) {
+			const int x0 = int(Math::floor(x));
+			const int y0 = int(Math::floor(y));
+			const float xf = x - x0;
+			const float yf = y - y0;
+			const float h00 = get_pixel_repeat(im, x0, y0);
+			const float h10 = get_pixel_repeat(im, x0 + 1, y0);
+			const float h01 = get_pixel_repeat(im, x0, y0 + 1);
+			const float h11 = get_pixel_repeat(im, x0 + 1, y0 + 1);
+			return Math::lerp(Math::lerp(h00, h10, xf), Math::lerp(h01, h11, xf), yf);
+		}
+	};
+
+	zylann::TiledImage tiled_image;
+	tiled_image.generate(image, true);
+
+	// 37x21, 18x10, 9x5, 4x2, 2x1, 1x1
+	ZN_TEST_ASSERT(tiled_image.get_mip_count() == 6);
+	ZN_TEST_ASSERT(!tiled_image.is_memory_mapped());
+
+	// Pixels of the first mip are exactly those of the image, repeating out of bounds
+	for (int y = -image.get_height(); y < 2 * image.get_height(); ++y) {
+		for (int x = -image.get_width(); x < 2 * image.get_width(); ++x) {
+			ZN_TEST_ASSERT(tiled_image.get_pixel_repeat(0, x, y) == L::get_pixel_repeat(image, x, y));
+		}
+	}
+
+	// Next mips are averages
+	{
+		const float expected = 0.25f *
+				(L::get_pixel_repeat(image, 6, 4) + L::get_pixel_repeat(image, 7, 4) +
+				 L::get_pixel_repeat(image, 6, 5) + L::get_pixel_repeat(image, 7, 5));
+		ZN_TEST_ASSERT(Math::is_equal_approx(tiled_image.get_pixel_repeat(1, 3, 2), expected));
+	}
+
+	// Mips are chosen so their pixels are not larger than the step between samples
+	ZN_TEST_ASSERT(tiled_image.get_mip_for_step(0.5f) == 0);
+	ZN_TEST_ASSERT(tiled_image.get_mip_for_step(1.f) == 0);
+	ZN_TEST_ASSERT(tiled_image.get_mip_for_step(4.f) == 1);
+	ZN_TEST_ASSERT(tiled_image.get_mip_for_step(5.f) == 2);
+	ZN_TEST_ASSERT(tiled_image.get_mip_for_step(1000.f) == 5);
+
+	// Series of samples give the same results as single samples. On the first mip, they also match the image.
+	StdVector<float> xs;
+	StdVector<float> ys;
+	for (unsigned int i = 0; i < 103; ++i) {
+		xs.push_back(-100.f + 200.f * rng.randf());
+		ys.push_back(-100.f + 200.f * rng.randf());
+	}
+	StdVector<float> results;
+	results.resize(xs.size());
+
+	for (unsigned int mip_index = 0; mip_index < tiled_image.get_mip_count(); ++mip_index) {
+		tiled_image.get_pixels_repeat_linear(mip_index, to_span(xs), to_span(ys), to_span(results));
+
+		for (unsigned int i = 0; i < xs.size(); ++i) {
+			ZN_TEST_ASSERT(results[i] == tiled_image.get_pixel_repeat_linear(mip_index, xs[i], ys[i]));
+			if (mip_index == 0) {
+				ZN_TEST_ASSERT(results[i] == L::get_pixel_repeat_linear(image, xs[i], ys[i]));
+			}
+		}
+	}
+}
+
 void test_voxel_graph_many_subdivisions() {
 	Ref<VoxelGeneratorGraph> generator;
 	generator.instantiate();
@@ -2358,4 +2533,658 @@ void test_voxel_graph_empty_image() {
 	ZN_TEST_ASSERT(result.success == false);
 }
 
+void test_voxel_graph_xz_cache() {
+	// Blocks stacked vertically share results of the heightmap part of the graph. They must be the same as if it was
+	// computed for every block.
+	struct L {
+		static Ref<VoxelGeneratorGraph> create_graph(bool use_xz_cache) {
+			Ref<VoxelGeneratorGraph> generator;
+			generator.instantiate();
+			VoxelGraphFunction &g = **generator->get_main_function();
+
+			// sdf = y - (10 * sin(0.1 * x) + 10 * sin(0.1 * z))
+
+			const uint32_t n_x = g.create_node(VoxelGraphFunction::NODE_INPUT_X, Vector2());
+			const uint32_t n_y = g.create_node(VoxelGraphFunction::NODE_INPUT_Y, Vector2());
+			const uint32_t n_z = g.create_node(VoxelGraphFunction::NODE_INPUT_Z, Vector2());
+			const uint32_t n_mul_x = g.create_node(VoxelGraphFunction::NODE_MULTIPLY, Vector2());
+			const uint32_t n_mul_z = g.create_node(VoxelGraphFunction::NODE_MULTIPLY, Vector2());
+			const uint32_t n_sin_x = g.create_node(VoxelGraphFunction::NODE_SIN, Vector2());
+			const uint32_t n_sin_z = g.create_node(VoxelGraphFunction::NODE_SIN, Vector2());
+			const uint32_t n_add = g.create_node(VoxelGraphFunction::NODE_ADD, Vector2());
+			const uint32_t n_amp = g.create_node(VoxelGraphFunction::NODE_MULTIPLY, Vector2());
+			const uint32_t n_sub = g.create_node(VoxelGraphFunction::NODE_SUBTRACT, Vector2());
+			const uint32_t n_out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+
+			g.set_node_default_input(n_mul_x, 1, 0.1f);
+			g.set_node_default_input(n_mul_z, 1, 0.1f);
+			g.set_node_default_input(n_amp, 1, 10.f);
+
+			g.add_connection(n_x, 0, n_mul_x, 0);
+			g.add_connection(n_z, 0, n_mul_z, 0);
+			g.add_connection(n_mul_x, 0, n_sin_x, 0);
+			g.add_connection(n_mul_z, 0, n_sin_z, 0);
+			g.add_connection(n_sin_x, 0, n_add, 0);
+			g.add_connection(n_sin_z, 0, n_add, 1);
+			g.add_connection(n_add, 0, n_amp, 0);
+			g.add_connection(n_y, 0, n_sub, 0);
+			g.add_connection(n_amp, 0, n_sub, 1);
+			g.add_connection(n_sub, 0, n_out_sdf, 0);
+
+			generator->set_use_xz_caching(use_xz_cache);
+			const CompilationResult result = generator->compile(false);
+			ZN_TEST_ASSERT(result.success);
+			return generator;
+		}
+	};
+
+	Ref<VoxelGeneratorGraph> generator_cached = L::create_graph(true);
+	Ref<VoxelGeneratorGraph> generator_uncached = L::create_graph(false);
+
+	const Vector3i block_size(16, 16, 16);
+
+	for (int lod_index = 0; lod_index < 2; ++lod_index) {
+		for (int by = -2; by < 2; ++by) {
+			const Vector3i origin = Vector3i(-8, by * block_size.y, 24) << lod_index;
+
+			VoxelBuffer block1(VoxelBuffer::ALLOCATOR_DEFAULT);
+			block1.create(block_size);
+			generator_cached->generate_block(VoxelGenerator::VoxelQueryData{ block1, origin, uint32_t(lod_index) });
+
+			VoxelBuffer block2(VoxelBuffer::ALLOCATOR_DEFAULT);
+			block2.create(block_size);
+			generator_uncached->generate_block(VoxelGenerator::VoxelQueryData{ block2, origin, uint32_t(lod_index) });
+
+			ZN_TEST_ASSERT(block1.equals(block2));
+		}
+	}
+
+	// Blocks crossing the surface after the first one of each column must have reused cached results
+	const pg::XZCache::Stats stats = generator_cached->get_xz_cache_stats();
+	ZN_TEST_ASSERT(stats.hits > 0);
+	ZN_TEST_ASSERT(stats.entry_count == 2);
+}
+
+void test_voxel_graph_adaptive_subdivision() {
+	// Subdividing areas crossing the surface must clip more voxels, without changing results near the surface
+	struct L {
+		static Ref<VoxelGeneratorGraph> create_graph(bool use_adaptive_subdivision) {
+			Ref<VoxelGeneratorGraph> generator;
+			generator.instantiate();
+			VoxelGraphFunction &g = **generator->get_main_function();
+			// sdf = y
+			const uint32_t n_y = g.create_node(VoxelGraphFunction::NODE_INPUT_Y, Vector2());
+			const uint32_t n_out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+			g.add_connection(n_y, 0, n_out_sdf, 0);
+			generator->set_subdivision_size(16);
+			generator->set_use_adaptive_subdivision(use_adaptive_subdivision);
+			const CompilationResult result = generator->compile(false);
+			ZN_TEST_ASSERT(result.success);
+			return generator;
+		}
+	};
+
+	Ref<VoxelGeneratorGraph> generator_adaptive = L::create_graph(true);
+	Ref<VoxelGeneratorGraph> generator_fixed = L::create_graph(false);
+
+	// The surface crosses all sections of the block, so none of them can be clipped as a whole
+	const Vector3i block_size(32, 32, 32);
+	const Vector3i origin(0, -16, 0);
+
+	VoxelBuffer block_adaptive(VoxelBuffer::ALLOCATOR_DEFAULT);
+	block_adaptive.create(block_size);
+	generator_adaptive->generate_block(VoxelGenerator::VoxelQueryData{ block_adaptive, origin, 0 });
+
+	VoxelBuffer block_fixed(VoxelBuffer::ALLOCATOR_DEFAULT);
+	block_fixed.create(block_size);
+	generator_fixed->generate_block(VoxelGenerator::VoxelQueryData{ block_fixed, origin, 0 });
+
+	const float clip_threshold = generator_adaptive->get_sdf_clip_threshold();
+	Vector3i pos;
+	for (pos.z = 0; pos.z < block_size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < block_size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < block_size.y; ++pos.y) {
+				const float sd_adaptive = block_adaptive.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+				const float sd_fixed = block_fixed.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+				ZN_TEST_ASSERT((sd_adaptive > 0.f) == (sd_fixed > 0.f));
+				if (Math::abs(sd_fixed) <= clip_threshold) {
+					ZN_TEST_ASSERT(Math::is_equal_approx(sd_adaptive, sd_fixed, 0.01f));
+				}
+			}
+		}
+	}
+
+	const VoxelGeneratorGraph::RangeAnalysisStats stats_fixed = generator_fixed->get_range_analysis_stats();
+	ZN_TEST_ASSERT(stats_fixed.analyzed_boxes == 8);
+	ZN_TEST_ASSERT(stats_fixed.clipped_voxels == 0);
+	ZN_TEST_ASSERT(stats_fixed.computed_voxels == uint64_t(Vector3iUtil::get_volume_u64(block_size)));
+
+	// Only layers of 4 voxels on each side of the surface need to be computed
+	const VoxelGeneratorGraph::RangeAnalysisStats stats_adaptive = generator_adaptive->get_range_analysis_stats();
+	ZN_TEST_ASSERT(stats_adaptive.computed_voxels == uint64_t(block_size.x * block_size.z * 8));
+	ZN_TEST_ASSERT(
+			stats_adaptive.clipped_voxels + stats_adaptive.computed_voxels ==
+			uint64_t(Vector3iUtil::get_volume_u64(block_size))
+	);
+
+	generator_adaptive->reset_range_analysis_stats();
+	ZN_TEST_ASSERT(generator_adaptive->get_range_analysis_stats().analyzed_boxes == 0);
+}
+
+void test_voxel_graph_sampled_profiling() {
+	Ref<VoxelGeneratorGraph> generator;
+	generator.instantiate();
+	{
+		VoxelGraphFunction &g = **generator->get_main_function();
+		// sdf = y
+		const uint32_t n_y = g.create_node(VoxelGraphFunction::NODE_INPUT_Y, Vector2());
+		const uint32_t n_out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		g.add_connection(n_y, 0, n_out_sdf, 0);
+	}
+	generator->set_profiling_sample_rate(0.25f);
+	const CompilationResult result = generator->compile(false);
+	ZN_TEST_ASSERT(result.success);
+
+	// The surface crosses the block, so voxels have to be computed
+	const Vector3i block_size(16, 16, 16);
+	const Vector3i origin(0, -8, 0);
+
+	for (unsigned int i = 0; i < 8; ++i) {
+		VoxelBuffer block(VoxelBuffer::ALLOCATOR_DEFAULT);
+		block.create(block_size);
+		generator->generate_block(VoxelGenerator::VoxelQueryData{ block, origin, 0 });
+	}
+
+	Dictionary results = generator->get_sampled_profiling_results();
+	ZN_TEST_ASSERT(int64_t(results["sampled_blocks"]) == 2);
+	ZN_TEST_ASSERT(int64_t(results["sampled_voxels"]) > 0);
+	const Array nodes = results["nodes"];
+	ZN_TEST_ASSERT(nodes.size() > 0);
+	for (int i = 0; i < nodes.size(); ++i) {
+		const Dictionary node_d = nodes[i];
+		ZN_TEST_ASSERT(node_d.has("node_id"));
+		ZN_TEST_ASSERT(node_d.has("microseconds"));
+	}
+
+	generator->reset_sampled_profiling_results();
+	results = generator->get_sampled_profiling_results();
+	ZN_TEST_ASSERT(int64_t(results["sampled_blocks"]) == 0);
+
+	// Turned off
+	generator->set_profiling_sample_rate(0.f);
+	VoxelBuffer block(VoxelBuffer::ALLOCATOR_DEFAULT);
+	block.create(block_size);
+	generator->generate_block(VoxelGenerator::VoxelQueryData{ block, origin, 0 });
+	results = generator->get_sampled_profiling_results();
+	ZN_TEST_ASSERT(int64_t(results["sampled_blocks"]) == 0);
+}
+
+void test_voxel_graph_buffer_data_reuse() {
+	// out = x + 1 + 1 + 1 ...
+	// Each addition has its own constant buffer and its own output, but few of them are live at the same time.
+	const unsigned int add_count = 40;
+
+	Ref<VoxelGraphFunction> function;
+	function.instantiate();
+	{
+		const uint32_t n_x = function->create_node(VoxelGraphFunction::NODE_INPUT_X, Vector2());
+		const uint32_t n_out_sd = function->create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		uint32_t prev_node_id = n_x;
+		for (unsigned int i = 0; i < add_count; ++i) {
+			const uint32_t n_add = function->create_node(VoxelGraphFunction::NODE_ADD, Vector2());
+			function->add_connection(prev_node_id, 0, n_add, 0);
+			function->set_node_default_input(n_add, 1, 1.f);
+			prev_node_id = n_add;
+		}
+		function->add_connection(prev_node_id, 0, n_out_sd, 0);
+		function->auto_pick_inputs_and_outputs();
+	}
+
+	pg::Runtime runtime_debug;
+	ZN_TEST_ASSERT(runtime_debug.compile(**function, true).success);
+	ZN_TEST_ASSERT(runtime_debug.get_buffer_data_count() >= add_count);
+
+	pg::Runtime runtime;
+	ZN_TEST_ASSERT(runtime.compile(**function, false).success);
+	ZN_TEST_ASSERT(runtime.get_buffer_count() >= add_count);
+	// One for the shared constant, two for intermediate results and one for the output
+	ZN_TEST_ASSERT(runtime.get_buffer_data_count() <= 4);
+
+	const unsigned int buffer_size = 16;
+	StdVector<float> x_buffer;
+	x_buffer.resize(buffer_size);
+	for (unsigned int i = 0; i < buffer_size; ++i) {
+		x_buffer[i] = i;
+	}
+	Span<float> inputs[1] = { to_span(x_buffer) };
+
+	pg::Runtime::State state;
+	runtime.prepare_state(state, buffer_size, false);
+	runtime.generate_set(state, Span<Span<float>>(inputs, 1), false, nullptr);
+
+	const pg::Runtime::Buffer &out_buffer = state.get_buffer(runtime.get_output_info(0).buffer_address);
+	for (unsigned int i = 0; i < buffer_size; ++i) {
+		ZN_TEST_ASSERT(out_buffer.data[i] == x_buffer[i] + float(add_count));
+	}
+}
+
+void test_voxel_graph_generate_series_in_chunks() {
+	struct L {
+		static ThreadedTaskRunner *&get_runner() {
+			static ThreadedTaskRunner *s_runner = nullptr;
+			return s_runner;
+		}
+		static void schedule_tasks(Span<IThreadedTask *> tasks) {
+			get_runner()->enqueue(tasks, false);
+		}
+	};
+
+	Ref<VoxelGeneratorGraph> generator;
+	generator.instantiate();
+	load_graph_with_sphere_on_plane(**generator->get_main_function(), 6.f);
+	ZN_TEST_ASSERT(generator->compile(false).success);
+
+	// More than one chunk, with the last one partially filled
+	const unsigned int count = 3 * GENERATE_SERIES_CHUNK_SIZE + 123;
+	StdVector<float> x_buffer;
+	StdVector<float> y_buffer;
+	StdVector<float> z_buffer;
+	x_buffer.resize(count);
+	y_buffer.resize(count);
+	z_buffer.resize(count);
+	RandomPCG rng;
+	rng.seed(131183);
+	for (unsigned int i = 0; i < count; ++i) {
+		x_buffer[i] = 100.f * rng.randf() - 50.f;
+		y_buffer[i] = 100.f * rng.randf() - 50.f;
+		z_buffer[i] = 100.f * rng.randf() - 50.f;
+	}
+
+	StdVector<float> expected_values;
+	expected_values.resize(count);
+	// Reference results are obtained in a single call
+	generator->generate_series(
+			to_span_const(x_buffer),
+			to_span_const(y_buffer),
+			to_span_const(z_buffer),
+			VoxelBuffer::CHANNEL_SDF,
+			to_span(expected_values),
+			Vector3f(-50.f),
+			Vector3f(50.f)
+	);
+
+	StdVector<float> values;
+	values.resize(count);
+
+	// Without scheduler, chunks run on the calling thread
+	generate_series_in_chunks(
+			**generator,
+			to_span_const(x_buffer),
+			to_span_const(y_buffer),
+			to_span_const(z_buffer),
+			VoxelBuffer::CHANNEL_SDF,
+			to_span(values),
+			ParallelJobsScheduler()
+	);
+	ZN_TEST_ASSERT(values == expected_values);
+
+	ThreadedTaskRunner runner;
+	runner.set_thread_count(4);
+	runner.set_name("Test");
+	L::get_runner() = &runner;
+
+	ParallelJobsScheduler scheduler;
+	scheduler.schedule_tasks = L::schedule_tasks;
+	scheduler.max_helpers = 3;
+
+	to_span(values).fill(0.f);
+	generate_series_in_chunks(
+			**generator,
+			to_span_const(x_buffer),
+			to_span_const(y_buffer),
+			to_span_const(z_buffer),
+			VoxelBuffer::CHANNEL_SDF,
+			to_span(values),
+			scheduler
+	);
+	ZN_TEST_ASSERT(values == expected_values);
+
+	runner.wait_for_all_tasks();
+	runner.dequeue_completed_tasks([](IThreadedTask *task) { ZN_DELETE(task); });
+	L::get_runner() = nullptr;
+}
+
+void test_voxel_graph_lod_detail_pruning() {
+	// Octaves too fine for a LOD should be skipped, leaving the rest of the noise unchanged
+	struct L {
+		static Ref<VoxelGeneratorGraph> create_graph(bool use_lod_detail_pruning) {
+			Ref<VoxelGeneratorGraph> generator;
+			generator.instantiate();
+			VoxelGraphFunction &g = **generator->get_main_function();
+
+			//  FastNoise3D --- OutSDF
+
+			const uint32_t n_out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+			const uint32_t n_noise = g.create_node(VoxelGraphFunction::NODE_FAST_NOISE_3D, Vector2());
+
+			Ref<ZN_FastNoiseLite> noise;
+			noise.instantiate();
+			noise->set_period(64.f);
+			noise->set_fractal_type(ZN_FastNoiseLite::FRACTAL_FBM);
+			noise->set_fractal_octaves(6);
+			noise->set_fractal_lacunarity(2.f);
+			noise->set_fractal_gain(0.5f);
+			g.set_node_param(n_noise, 0, noise);
+
+			g.add_connection(n_noise, 0, n_out_sdf, 0);
+
+			generator->set_use_lod_detail_pruning(use_lod_detail_pruning);
+			const CompilationResult result = generator->compile(false);
+			ZN_TEST_ASSERT(result.success);
+			return generator;
+		}
+
+		static void generate(VoxelGeneratorGraph &generator, VoxelBuffer &vb, Vector3i origin, uint32_t lod_index) {
+			vb.create(Vector3i(16, 16, 16));
+			VoxelGenerator::VoxelQueryData query{ vb, origin, lod_index };
+			query.min_feature_size = VoxelGenerator::get_min_feature_size_for_lod(lod_index);
+			generator.generate_block(query);
+		}
+	};
+
+	Ref<VoxelGeneratorGraph> generator_pruned = L::create_graph(true);
+	Ref<VoxelGeneratorGraph> generator_full = L::create_graph(false);
+
+	// LOD 0 gets all details
+	{
+		VoxelBuffer vb_pruned(VoxelBuffer::ALLOCATOR_DEFAULT);
+		VoxelBuffer vb_full(VoxelBuffer::ALLOCATOR_DEFAULT);
+		L::generate(**generator_pruned, vb_pruned, Vector3i(-8, -8, -8), 0);
+		L::generate(**generator_full, vb_full, Vector3i(-8, -8, -8), 0);
+		ZN_TEST_ASSERT(vb_pruned.equals(vb_full));
+	}
+
+	// At LOD 3, voxels are 8 units apart, so octaves with a period under 16 get skipped. Only 3 of the 6 octaves
+	// remain, and the result should only differ by the amplitude of the skipped ones.
+	{
+		const uint32_t lod_index = 3;
+		const Vector3i origin = Vector3i(-8, -8, -8) << lod_index;
+		VoxelBuffer vb_pruned(VoxelBuffer::ALLOCATOR_DEFAULT);
+		VoxelBuffer vb_full(VoxelBuffer::ALLOCATOR_DEFAULT);
+		L::generate(**generator_pruned, vb_pruned, origin, lod_index);
+		L::generate(**generator_full, vb_full, origin, lod_index);
+		ZN_TEST_ASSERT(!vb_pruned.equals(vb_full));
+
+		// Amplitudes are 1, 1/2, 1/4... divided by their sum
+		const float max_difference = (0.125f + 0.0625f + 0.03125f) / 1.96875f;
+
+		const Vector3i size = vb_full.get_size();
+		Vector3i pos;
+		for (pos.z = 0; pos.z < size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < size.x; ++pos.x) {
+				for (pos.y = 0; pos.y < size.y; ++pos.y) {
+					const float sd_pruned = vb_pruned.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+					const float sd_full = vb_full.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+					ZN_TEST_ASSERT(Math::abs(sd_pruned - sd_full) < max_difference + 0.01f);
+				}
+			}
+		}
+	}
+}
+
+void test_voxel_graph_fused_modifiers() {
+	Ref<VoxelGeneratorGraph> generator;
+	generator.instantiate();
+	{
+		VoxelGraphFunction &g = **generator->get_main_function();
+
+		//  Y --- OutSDF
+
+		const uint32_t n_in_y = g.create_node(VoxelGraphFunction::NODE_INPUT_Y, Vector2());
+		const uint32_t n_out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		g.add_connection(n_in_y, 0, n_out_sdf, 0);
+
+		const CompilationResult result = generator->compile(false);
+		ZN_TEST_ASSERT(result.success);
+	}
+
+	// A sphere of matter floating above the ground, in a block range analysis would otherwise find to be only air
+	VoxelModifierStack modifiers;
+	{
+		const uint32_t id = modifiers.allocate_id();
+		VoxelModifierSphere *sphere = modifiers.add_modifier<VoxelModifierSphere>(id);
+		sphere->set_radius(4.f);
+		sphere->set_operation(VoxelModifierSdf::OP_ADD);
+		sphere->set_transform(Transform3D(Basis(), Vector3(8, 24, 8)));
+		modifiers.update_modifier_aabb(id);
+	}
+
+	const Vector3i origin(0, 16, 0);
+
+	VoxelBuffer fused_voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	fused_voxels.create(Vector3i(16, 16, 16));
+	const VoxelGenerator::Result result = generator->generate_block_with_modifiers(
+			VoxelGenerator::VoxelQueryData{ fused_voxels, origin, 0 }, modifiers
+	);
+	ZN_TEST_ASSERT(result.modifiers_applied);
+
+	// Modifiers applied after generation, like generators that don't support applying them
+	VoxelBuffer separate_voxels(VoxelBuffer::ALLOCATOR_DEFAULT);
+	separate_voxels.create(Vector3i(16, 16, 16));
+	generator->generate_block(VoxelGenerator::VoxelQueryData{ separate_voxels, origin, 0 });
+	modifiers.apply(separate_voxels, AABB(origin, separate_voxels.get_size()));
+
+	ZN_TEST_ASSERT(fused_voxels.get_voxel_f(Vector3i(8, 8, 8), VoxelBuffer::CHANNEL_SDF) < 0.f);
+	ZN_TEST_ASSERT(fused_voxels.get_voxel_f(Vector3i(1, 1, 1), VoxelBuffer::CHANNEL_SDF) > 0.f);
+
+	const Vector3i size = fused_voxels.get_size();
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				const float sd_fused = fused_voxels.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+				const float sd_separate = separate_voxels.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+				ZN_TEST_ASSERT(Math::abs(sd_fused - sd_separate) < 0.01f);
+			}
+		}
+	}
+}
+
+void test_voxel_graph_expression_bytecode() {
+	// Uses every instruction, so the expression runs as a single operation instead of being expanded into nodes
+	const char *code = "sin(x) * 2 + floor(y) - abs(z) / (x * x + 1) + sqrt(x * x) + fract(y) + stepify(z, 0.25) "
+					   "+ wrap(x, 3) + clamp(y, 0.5, 1) + lerp(x, y, 0.3) + min(x, z) * max(y, 2 + 3) + z ^ 3 "
+					   "+ abs(y) ^ 0.5";
+
+	struct L {
+		static float evaluate(float x, float y, float z) {
+			return Math::sin(x) * 2.f + Math::floor(y) - Math::abs(z) / (x * x + 1.f) + Math::sqrt(x * x) +
+					(y - Math::floor(y)) + math::snappedf(z, 0.25f) + math::wrapf(x, 3.f) + math::clamp(y, 0.5f, 1.f) +
+					Math::lerp(x, y, 0.3f) + math::min(x, z) * math::max(y, 5.f) + z * z * z +
+					Math::pow(Math::abs(y), 0.5f);
+		}
+
+		static bool is_close(float a, float b) {
+			return Math::abs(a - b) <= 0.0001f * (1.f + Math::abs(b));
+		}
+	};
+
+	{
+		const ExpressionParser::Result parse_result =
+				ExpressionParser::parse(code, pg::NodeTypeDB::get_singleton().get_expression_parser_functions());
+		ZN_TEST_ASSERT(parse_result.error.id == ExpressionParser::ERROR_NONE);
+		ZN_TEST_ASSERT(parse_result.root != nullptr);
+
+		FixedArray<std::string_view, 3> input_names;
+		input_names[0] = "x";
+		input_names[1] = "y";
+		input_names[2] = "z";
+		pg::ExpressionBytecode bytecode;
+		ZN_TEST_ASSERT(pg::compile_expression_bytecode(*parse_result.root, to_span(input_names), bytecode));
+		ZN_TEST_ASSERT(bytecode.inputs_count == 3);
+		ZN_TEST_ASSERT(bytecode.instructions.size() > 20);
+		// Temporaries are re-used
+		ZN_TEST_ASSERT(bytecode.temporaries_count < 5);
+
+		// Not a multiple of the chunk size or SIMD width, so partial chunks are processed too
+		const unsigned int value_count = 101;
+		StdVector<float> xs;
+		StdVector<float> ys;
+		StdVector<float> zs;
+		RandomPCG rng;
+		for (unsigned int i = 0; i < value_count; ++i) {
+			xs.push_back(rng.randf() * 10.f - 5.f);
+			ys.push_back(rng.randf() * 10.f - 5.f);
+			zs.push_back(rng.randf() * 10.f - 5.f);
+		}
+		FixedArray<const float *, 3> inputs;
+		inputs[0] = xs.data();
+		inputs[1] = ys.data();
+		inputs[2] = zs.data();
+		StdVector<float> outputs;
+		outputs.resize(value_count);
+		bytecode.run(to_span(inputs), outputs.data(), value_count);
+
+		FixedArray<math::Interval, 3> input_ranges;
+		fill(input_ranges, math::Interval(-5.f, 5.f));
+		const math::Interval output_range = bytecode.analyze_range(to_span(input_ranges));
+
+		for (unsigned int i = 0; i < value_count; ++i) {
+			const float expected = L::evaluate(xs[i], ys[i], zs[i]);
+			ZN_TEST_ASSERT(L::is_close(outputs[i], expected));
+			ZN_TEST_ASSERT(output_range.contains(outputs[i]));
+		}
+	}
+	{
+		// Same expression in a graph
+		Ref<VoxelGeneratorGraph> generator;
+		generator.instantiate();
+		VoxelGraphFunction &g = **generator->get_main_function();
+		const uint32_t in_x = g.create_node(VoxelGraphFunction::NODE_INPUT_X, Vector2());
+		const uint32_t in_y = g.create_node(VoxelGraphFunction::NODE_INPUT_Y, Vector2());
+		const uint32_t in_z = g.create_node(VoxelGraphFunction::NODE_INPUT_Z, Vector2());
+		const uint32_t out_sdf = g.create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+		const uint32_t n_expression = g.create_node(VoxelGraphFunction::NODE_EXPRESSION, Vector2());
+		g.set_node_param(n_expression, 0, code);
+		PackedStringArray var_names;
+		var_names.push_back("x");
+		var_names.push_back("y");
+		var_names.push_back("z");
+		g.set_expression_node_inputs(n_expression, var_names);
+		g.add_connection(in_x, 0, n_expression, 0);
+		g.add_connection(in_y, 0, n_expression, 1);
+		g.add_connection(in_z, 0, n_expression, 2);
+		g.add_connection(n_expression, 0, out_sdf, 0);
+
+		const pg::CompilationResult result = generator->compile(false);
+		ZN_TEST_ASSERT_MSG(
+				result.success,
+				String("Failed to compile graph: {0}: {1}").format(varray(result.node_id, result.message))
+		);
+		// Expression, then output
+		ZN_TEST_ASSERT(result.operation_count == 2);
+
+		FixedArray<Vector3i, 3> positions;
+		positions[0] = Vector3i(1, 2, 3);
+		positions[1] = Vector3i(-4, 0, 2);
+		positions[2] = Vector3i(3, -1, -5);
+		for (const Vector3i pos : positions) {
+			const float sd = generator->generate_single(pos, VoxelBuffer::CHANNEL_SDF).f;
+			ZN_TEST_ASSERT(L::is_close(sd, L::evaluate(pos.x, pos.y, pos.z)));
+		}
+	}
+}
+
+void test_voxel_graph_node_benchmark(testing::BenchmarkSuite &suite) {
+	// Measures how long common nodes take to process voxels, to compare vectorized kernels with scalar ones.
+	// Each node gets its inputs from X, Y and Z, in that order.
+	struct NodeConfig {
+		VoxelGraphFunction::NodeTypeID type_id;
+		// Parameter 0 is set when positive
+		float param0;
+	};
+	const NodeConfig configs[] = {
+		{ VoxelGraphFunction::NODE_SIN, -1.f }, // Not vectorized, for reference
+		{ VoxelGraphFunction::NODE_ADD, -1.f },
+		{ VoxelGraphFunction::NODE_MULTIPLY, -1.f },
+		{ VoxelGraphFunction::NODE_MIN, -1.f },
+		{ VoxelGraphFunction::NODE_MAX, -1.f },
+		{ VoxelGraphFunction::NODE_CLAMP_C, -1.f },
+		{ VoxelGraphFunction::NODE_MIX, -1.f },
+		{ VoxelGraphFunction::NODE_REMAP, -1.f },
+		{ VoxelGraphFunction::NODE_SMOOTHSTEP, -1.f },
+		{ VoxelGraphFunction::NODE_SDF_SMOOTH_UNION, 2.f },
+	};
+
+	const Vector3i block_size(16, 16, 16);
+	const unsigned int volume = Vector3iUtil::get_volume_u64(block_size);
+
+	StdVector<float> x_buffer;
+	StdVector<float> y_buffer;
+	StdVector<float> z_buffer;
+	StdVector<float> out_buffer;
+
+	x_buffer.resize(volume);
+	y_buffer.resize(volume);
+	z_buffer.resize(volume);
+	out_buffer.resize(volume);
+
+	{
+		unsigned int i = 0;
+		for (int z = 0; z < block_size.z; ++z) {
+			for (int x = 0; x < block_size.x; ++x) {
+				for (int y = 0; y < block_size.y; ++y) {
+					// Small values so ratios, clamps and smooth operations don't all saturate
+					x_buffer[i] = 0.1f * x;
+					y_buffer[i] = 0.1f * y;
+					z_buffer[i] = 0.1f * z;
+					++i;
+				}
+			}
+		}
+	}
+
+	const NodeTypeDB &type_db = NodeTypeDB::get_singleton();
+
+	for (const NodeConfig &config : configs) {
+		Ref<VoxelGraphFunction> function;
+		function.instantiate();
+
+		const uint32_t n_inputs[3] = {
+			function->create_node(VoxelGraphFunction::NODE_INPUT_X, Vector2()),
+			function->create_node(VoxelGraphFunction::NODE_INPUT_Y, Vector2()),
+			function->create_node(VoxelGraphFunction::NODE_INPUT_Z, Vector2()),
+		};
+		const uint32_t n_node = function->create_node(config.type_id, Vector2());
+		const uint32_t n_out_sd = function->create_node(VoxelGraphFunction::NODE_OUTPUT_SDF, Vector2());
+
+		const NodeType &type = type_db.get_type(config.type_id);
+		for (unsigned int i = 0; i < type.inputs.size(); ++i) {
+			function->add_connection(n_inputs[i], 0, n_node, i);
+		}
+		function->add_connection(n_node, 0, n_out_sd, 0);
+		if (config.param0 > 0.f) {
+			function->set_node_param(n_node, 0, config.param0);
+		}
+
+		function->auto_pick_inputs_and_outputs();
+		const CompilationResult result = function->compile(false);
+		ZN_TEST_ASSERT(result.success);
+
+		// The order of inputs depends on which nodes use them
+		const unsigned int input_count = function->get_input_definitions().size();
+		ZN_TEST_ASSERT(input_count <= 3);
+		Span<float> inputs[3] = { to_span(x_buffer), to_span(y_buffer), to_span(z_buffer) };
+		Span<float> outputs = to_span(out_buffer);
+
+		suite.run(
+				format("graph_node_{}", type.name.to_snake_case()).c_str(),
+				100,
+				[&function, &inputs, input_count, &outputs]() {
+					function->execute(Span<Span<float>>(inputs, input_count), Span<Span<float>>(&outputs, 1));
+				}
+		);
+	}
+}
+
 } // namespace zylann::voxel::tests
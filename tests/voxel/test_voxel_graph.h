@@ -1,6 +1,10 @@
 #ifndef VOXEL_TEST_VOXEL_GRAPH_H
 #define VOXEL_TEST_VOXEL_GRAPH_H
 
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
 namespace zylann::voxel::tests {
 
 void test_voxel_graph_invalid_connection();
@@ -17,6 +21,7 @@ void test_voxel_graph_functions_nested_pass_through();
 void test_voxel_graph_functions_autoconnect();
 void test_voxel_graph_functions_io_mismatch();
 void test_voxel_graph_functions_misc();
+void test_voxel_graph_functions_constant_folding();
 void test_voxel_graph_issue461();
 void test_voxel_graph_fuzzing();
 #ifdef VOXEL_ENABLE_FAST_NOISE_2
@@ -33,10 +38,20 @@ void test_voxel_graph_function_execute();
 void test_voxel_graph_image();
 void test_voxel_graph_many_weight_outputs();
 void test_image_range_grid();
+void test_tiled_image();
 void test_voxel_graph_many_subdivisions();
 void test_voxel_graph_non_square_image();
 void test_voxel_graph_4_default_weights();
 void test_voxel_graph_empty_image();
+void test_voxel_graph_xz_cache();
+void test_voxel_graph_adaptive_subdivision();
+void test_voxel_graph_sampled_profiling();
+void test_voxel_graph_buffer_data_reuse();
+void test_voxel_graph_generate_series_in_chunks();
+void test_voxel_graph_lod_detail_pruning();
+void test_voxel_graph_fused_modifiers();
+void test_voxel_graph_expression_bytecode();
+void test_voxel_graph_node_benchmark(testing::BenchmarkSuite &suite);
 
 } // namespace zylann::voxel::tests
 
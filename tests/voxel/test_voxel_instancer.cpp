@@ -1,6 +1,14 @@
 #include "test_voxel_instancer.h"
 #include "../../streams/instance_data.h"
+#include "../../streams/voxel_stream_memory.h"
+#include "../../terrain/instancing/load_instance_block_task.h"
+#include "../../terrain/instancing/voxel_instance_library_multimesh_item.h"
+#include "../../terrain/instancing/voxel_instancer.h"
+#include "../../util/godot/classes/array_mesh.h"
+#include "../../util/godot/core/random_pcg.h"
+#include "../../util/io/serialization.h"
 #include "../../util/math/conv.h"
+#include "../../util/memory/linear_allocator.h"
 #include "../testing.h"
 
 namespace zylann::voxel::tests {
@@ -108,7 +116,11 @@ void test_instance_data_serialization() {
 			// Had to normalize here because Godot doesn't want to give you a Quat if the basis is scaled (even
 			// uniformly)
 			const Quaternion src_rot = src_basis.orthonormalized().get_quaternion();
-			const Quaternion dst_rot = dst_basis.orthonormalized().get_quaternion();
+			Quaternion dst_rot = dst_basis.orthonormalized().get_quaternion();
+			// q and -q represent the same rotation
+			if (src_rot.dot(dst_rot) < 0.f) {
+				dst_rot = -dst_rot;
+			}
 			const float rot_dx = Math::abs(src_rot.x - dst_rot.x);
 			const float rot_dy = Math::abs(src_rot.y - dst_rot.y);
 			const float rot_dz = Math::abs(src_rot.z - dst_rot.z);
@@ -121,4 +133,379 @@ void test_instance_data_serialization() {
 	}
 }
 
+void test_instance_data_serialization_compact() {
+	const unsigned int instance_count = 1000;
+	const float max_position_error = 0.05f;
+
+	InstanceBlockData src_data;
+	src_data.position_range = 16;
+	{
+		RandomPCG rng;
+		rng.seed(131183);
+
+		InstanceBlockData::LayerData layer;
+		layer.id = 7;
+		layer.scale_min = 0.5f;
+		layer.scale_max = 2.f;
+		for (unsigned int i = 0; i < instance_count; ++i) {
+			const Vector3 position(rng.randf() * 16.f, rng.randf() * 16.f, rng.randf() * 16.f);
+			const Vector3 axis = Vector3(rng.randf() - 0.5f, rng.randf() - 0.5f, rng.randf() - 0.5f).normalized();
+			const float scale = 0.5f + rng.randf() * 1.5f;
+			InstanceBlockData::InstanceData d;
+			d.transform = to_transform3f(Transform3D(
+					Basis(axis, rng.randf() * Math_TAU).scaled(Vector3(scale, scale, scale)), position
+			));
+			layer.instances.push_back(d);
+		}
+		src_data.layers.push_back(layer);
+	}
+
+	StdVector<uint8_t> serialized_data;
+	ZN_TEST_ASSERT(serialize_instance_block_data(src_data, serialized_data, max_position_error));
+
+	// The error allows 8-bit positions, so each instance takes 3 bytes of position, 1 of scale and 4 of rotation.
+	// Block header, layer header, position bits and trailing magic come in addition.
+	ZN_TEST_ASSERT(serialized_data.size() == 6 + 13 + 1 + instance_count * 8 + 4);
+
+	InstanceBlockData dst_data;
+	ZN_TEST_ASSERT(deserialize_instance_block_data(dst_data, to_span_const(serialized_data)));
+	ZN_TEST_ASSERT(dst_data.layers.size() == 1);
+
+	const InstanceBlockData::LayerData &src_layer = src_data.layers[0];
+	const InstanceBlockData::LayerData &dst_layer = dst_data.layers[0];
+	ZN_TEST_ASSERT(dst_layer.id == src_layer.id);
+	ZN_TEST_ASSERT(dst_layer.instances.size() == instance_count);
+
+	const float scale_error = 0.5f * (src_layer.scale_max - src_layer.scale_min) / 0xff + 0.001f;
+	// Smallest three quaternions with 10-bit components are precise to about a quarter of a degree
+	const float max_rotation_angle = math::deg_to_rad(0.5f);
+
+	for (unsigned int i = 0; i < instance_count; ++i) {
+		const Transform3f &src_transform = src_layer.instances[i].transform;
+		const Transform3f &dst_transform = dst_layer.instances[i].transform;
+
+		for (unsigned int axis = 0; axis < 3; ++axis) {
+			ZN_TEST_ASSERT(Math::abs(src_transform.origin[axis] - dst_transform.origin[axis]) <= max_position_error);
+		}
+
+		const Basis src_basis = to_basis3(src_transform.basis);
+		const Basis dst_basis = to_basis3(dst_transform.basis);
+		ZN_TEST_ASSERT(Math::abs(src_basis.get_scale().y - dst_basis.get_scale().y) <= scale_error);
+
+		const Quaternion src_rot = src_basis.orthonormalized().get_quaternion();
+		const Quaternion dst_rot = dst_basis.orthonormalized().get_quaternion();
+		// Compares regardless of sign, since q and -q represent the same rotation
+		const real_t dot = Math::abs(src_rot.dot(dst_rot));
+		ZN_TEST_ASSERT(2.f * Math::acos(math::min(dot, real_t(1))) <= max_rotation_angle);
+	}
+}
+
+void test_instance_data_deserialization_simple_11b() {
+	// Data saved before the compact format was added
+	StdVector<uint8_t> data;
+	{
+		MemoryWriter w(data, ENDIANNESS_LITTLE_ENDIAN);
+		w.store_8(1); // Version
+		w.store_8(1); // Layer count
+		w.store_float(10.f); // Position range
+
+		w.store_16(3); // Layer ID
+		w.store_16(1); // Instance count
+		w.store_float(1.f); // Scale min
+		w.store_float(2.f); // Scale max
+		w.store_8(InstanceBlockData::FORMAT_SIMPLE_11B_V1);
+
+		w.store_16(0x8000);
+		w.store_16(0);
+		w.store_16(0xffff);
+		w.store_8(0xff); // Scale
+		// Identity rotation
+		w.store_8(0x7f);
+		w.store_8(0x7f);
+		w.store_8(0x7f);
+		w.store_8(0xff);
+
+		w.store_32(0x900df00d);
+	}
+
+	InstanceBlockData dst_data;
+	ZN_TEST_ASSERT(deserialize_instance_block_data(dst_data, to_span_const(data)));
+	ZN_TEST_ASSERT(dst_data.layers.size() == 1);
+	const InstanceBlockData::LayerData &layer = dst_data.layers[0];
+	ZN_TEST_ASSERT(layer.id == 3);
+	ZN_TEST_ASSERT(layer.instances.size() == 1);
+
+	const Transform3D transform = to_transform3(layer.instances[0].transform);
+	ZN_TEST_ASSERT(transform.origin.distance_to(Vector3(5, 0, 10)) < 0.001f);
+	ZN_TEST_ASSERT(transform.basis.is_equal_approx(Basis().scaled(Vector3(2, 2, 2))));
+}
+
+void test_instance_data_serialization_legacy() {
+	struct L {
+		// Same as `serialize_instance_block_data` did before the compact format existed. All layers used format 0,
+		// taking 11 bytes per instance. Version 0 was the same, but big-endian.
+		static void serialize_simple_11b(const InstanceBlockData &src, uint8_t version, StdVector<uint8_t> &dst) {
+			MemoryWriter w(dst, version == 0 ? ENDIANNESS_BIG_ENDIAN : ENDIANNESS_LITTLE_ENDIAN);
+			w.store_8(version);
+			w.store_8(src.layers.size());
+			w.store_float(src.position_range);
+
+			const float pos_norm_scale = 1.f / src.position_range;
+
+			for (const InstanceBlockData::LayerData &layer : src.layers) {
+				w.store_16(layer.id);
+				w.store_16(layer.instances.size());
+				w.store_float(layer.scale_min);
+				w.store_float(layer.scale_max);
+				w.store_8(InstanceBlockData::FORMAT_SIMPLE_11B_V1);
+
+				const float scale_norm_scale = 1.f / (layer.scale_max - layer.scale_min);
+
+				for (const InstanceBlockData::InstanceData &instance : layer.instances) {
+					w.store_16(static_cast<uint16_t>(pos_norm_scale * instance.transform.origin.x * 0xffff));
+					w.store_16(static_cast<uint16_t>(pos_norm_scale * instance.transform.origin.y * 0xffff));
+					w.store_16(static_cast<uint16_t>(pos_norm_scale * instance.transform.origin.z * 0xffff));
+
+					const float scale = instance.transform.basis.get_scale_abs().y;
+					w.store_8(static_cast<uint8_t>(scale_norm_scale * (scale - layer.scale_min) * 0xff));
+
+					const Quaternionf q = instance.transform.basis.get_rotation_quaternion();
+					w.store_8(norm_to_u8(q.x));
+					w.store_8(norm_to_u8(q.y));
+					w.store_8(norm_to_u8(q.z));
+					w.store_8(norm_to_u8(q.w));
+				}
+			}
+
+			w.store_32(0x900df00d);
+		}
+
+		static uint8_t norm_to_u8(float x) {
+			return math::clamp(static_cast<int>(128.f * x + 128.f), 0, 0xff);
+		}
+
+		static void check_instances(
+				const InstanceBlockData &expected,
+				const InstanceBlockData &actual,
+				const float position_error,
+				const float max_rotation_angle
+		) {
+			ZN_TEST_ASSERT(actual.position_range == expected.position_range);
+			ZN_TEST_ASSERT(actual.layers.size() == expected.layers.size());
+
+			for (unsigned int layer_index = 0; layer_index < expected.layers.size(); ++layer_index) {
+				const InstanceBlockData::LayerData &expected_layer = expected.layers[layer_index];
+				const InstanceBlockData::LayerData &actual_layer = actual.layers[layer_index];
+				ZN_TEST_ASSERT(actual_layer.id == expected_layer.id);
+				ZN_TEST_ASSERT(actual_layer.scale_min == expected_layer.scale_min);
+				ZN_TEST_ASSERT(actual_layer.scale_max == expected_layer.scale_max);
+				ZN_TEST_ASSERT(actual_layer.instances.size() == expected_layer.instances.size());
+
+				// Scales were truncated to 8 bits, and may be rounded when saved again
+				const float scale_error = 2.f * (expected_layer.scale_max - expected_layer.scale_min) / 0xff;
+
+				for (unsigned int i = 0; i < expected_layer.instances.size(); ++i) {
+					const Transform3f &expected_transform = expected_layer.instances[i].transform;
+					const Transform3f &actual_transform = actual_layer.instances[i].transform;
+
+					for (unsigned int axis = 0; axis < 3; ++axis) {
+						ZN_TEST_ASSERT(
+								Math::abs(expected_transform.origin[axis] - actual_transform.origin[axis]) <=
+								position_error
+						);
+					}
+
+					const Basis expected_basis = to_basis3(expected_transform.basis);
+					const Basis actual_basis = to_basis3(actual_transform.basis);
+					ZN_TEST_ASSERT(Math::abs(expected_basis.get_scale().y - actual_basis.get_scale().y) <= scale_error);
+
+					const Quaternion expected_rot = expected_basis.orthonormalized().get_quaternion();
+					const Quaternion actual_rot = actual_basis.orthonormalized().get_quaternion();
+					// Compares regardless of sign, since q and -q represent the same rotation
+					const real_t dot = Math::abs(expected_rot.dot(actual_rot));
+					ZN_TEST_ASSERT(2.f * Math::acos(math::min(dot, real_t(1))) <= max_rotation_angle);
+				}
+			}
+		}
+	};
+
+	InstanceBlockData src_data;
+	src_data.position_range = 16;
+	{
+		RandomPCG rng;
+		rng.seed(131183);
+
+		for (unsigned int layer_index = 0; layer_index < 2; ++layer_index) {
+			InstanceBlockData::LayerData layer;
+			layer.id = 1 + layer_index;
+			layer.scale_min = 0.5f;
+			layer.scale_max = 2.f;
+			for (unsigned int i = 0; i < 100; ++i) {
+				const Vector3 position(rng.randf() * 16.f, rng.randf() * 16.f, rng.randf() * 16.f);
+				const Vector3 axis = Vector3(rng.randf() - 0.5f, rng.randf() - 0.5f, rng.randf() - 0.5f).normalized();
+				const float scale = 0.5f + rng.randf() * 1.5f;
+				InstanceBlockData::InstanceData d;
+				d.transform = to_transform3f(Transform3D(
+						Basis(axis, rng.randf() * Math_TAU).scaled(Vector3(scale, scale, scale)), position
+				));
+				layer.instances.push_back(d);
+			}
+			src_data.layers.push_back(layer);
+		}
+	}
+
+	// Positions were truncated to 16 bits
+	const float legacy_position_error = 2.f * src_data.position_range / 0xffff;
+	// 8-bit quaternion components were decoded with a different scale than they were encoded with
+	const float legacy_max_rotation_angle = math::deg_to_rad(5.f);
+
+	for (uint8_t version = 0; version < 2; ++version) {
+		StdVector<uint8_t> legacy_data;
+		L::serialize_simple_11b(src_data, version, legacy_data);
+		ZN_TEST_ASSERT(legacy_data.size() == 6 + 2 * (13 + 100 * 11) + 4);
+
+		InstanceBlockData loaded_data;
+		ZN_TEST_ASSERT(deserialize_instance_block_data(loaded_data, to_span_const(legacy_data)));
+		L::check_instances(src_data, loaded_data, legacy_position_error, legacy_max_rotation_angle);
+
+		// Saving again uses the compact format, which must keep what was loaded from legacy data
+		StdVector<uint8_t> compact_data;
+		ZN_TEST_ASSERT(serialize_instance_block_data(loaded_data, compact_data));
+		ZN_TEST_ASSERT(compact_data.size() == 6 + 2 * (13 + 1 + 100 * 11) + 4);
+
+		InstanceBlockData reloaded_data;
+		ZN_TEST_ASSERT(deserialize_instance_block_data(reloaded_data, to_span_const(compact_data)));
+		L::check_instances(loaded_data, reloaded_data, src_data.position_range / 0xffff, math::deg_to_rad(0.5f));
+	}
+}
+
+void test_instancer_save_generated_instances() {
+	// Mesh blocks twice as large as data blocks, so each of them covers 8 data blocks
+	const unsigned int mesh_block_size_po2 = 5;
+	const unsigned int data_block_size_po2 = 4;
+	const Vector3i render_block_position(1, -1, 2);
+	const Vector3i data_block_position0 = render_block_position * 2;
+	const int layer_id = 1;
+	// First octant was edited, the others were generated
+	const uint8_t edited_mask = 0b00000001;
+
+	{
+		// Without saving generated instances, only edited parts are tracked
+		StdUnorderedSet<Vector3i> edited_data_blocks;
+		StdUnorderedSet<Vector3i> modified_blocks;
+		VoxelInstancer::mark_task_output_data_blocks(
+				render_block_position,
+				mesh_block_size_po2,
+				data_block_size_po2,
+				edited_mask,
+				false,
+				edited_data_blocks,
+				modified_blocks
+		);
+		ZN_TEST_ASSERT(edited_data_blocks.size() == 1);
+		ZN_TEST_ASSERT(modified_blocks.size() == 0);
+	}
+
+	StdUnorderedSet<Vector3i> edited_data_blocks;
+	StdUnorderedSet<Vector3i> modified_blocks;
+	VoxelInstancer::mark_task_output_data_blocks(
+			render_block_position,
+			mesh_block_size_po2,
+			data_block_size_po2,
+			edited_mask,
+			true,
+			edited_data_blocks,
+			modified_blocks
+	);
+	ZN_TEST_ASSERT(edited_data_blocks.size() == 1);
+	ZN_TEST_ASSERT(edited_data_blocks.find(data_block_position0) != edited_data_blocks.end());
+	// Generated parts are marked modified so they get saved
+	ZN_TEST_ASSERT(modified_blocks.size() == 7);
+	ZN_TEST_ASSERT(modified_blocks.find(data_block_position0) == modified_blocks.end());
+	ZN_TEST_ASSERT(modified_blocks.find(data_block_position0 + Vector3i(1, 1, 1)) != modified_blocks.end());
+
+	// Save one instance in each of the marked blocks, like the instancer would when they unload
+	Ref<VoxelStreamMemory> stream;
+	stream.instantiate();
+	{
+		StdVector<Vector3i> saved_positions;
+		for (const Vector3i pos : edited_data_blocks) {
+			saved_positions.push_back(pos);
+		}
+		for (const Vector3i pos : modified_blocks) {
+			saved_positions.push_back(pos);
+		}
+		for (const Vector3i pos : saved_positions) {
+			InstanceBlockData::LayerData layer;
+			layer.id = layer_id;
+			layer.scale_min = 1.f;
+			layer.scale_max = 1.f;
+			InstanceBlockData::InstanceData instance;
+			instance.transform = to_transform3f(Transform3D(Basis(), Vector3(8, 8, 8)));
+			layer.instances.push_back(instance);
+
+			VoxelStream::InstancesQueryData query;
+			query.lod_index = 0;
+			query.position_in_blocks = pos;
+			query.data = make_unique_instance<InstanceBlockData>();
+			query.data->position_range = 1 << data_block_size_po2;
+			query.data->layers.push_back(layer);
+			stream->save_instance_blocks(Span<VoxelStream::InstancesQueryData>(&query, 1));
+		}
+	}
+
+	// Reload the block, with a library that would generate instances in parts that were not saved
+	Ref<VoxelInstanceLibrary> library;
+	library.instantiate();
+	{
+		Ref<VoxelInstanceGenerator> generator;
+		generator.instantiate();
+		Ref<VoxelInstanceLibraryMultiMeshItem> item;
+		item.instantiate();
+		item->set_generator(generator);
+		item->set_persistent(true);
+		library->add_item(layer_id, item);
+	}
+
+	Array mesh_arrays;
+	mesh_arrays.resize(ArrayMesh::ARRAY_MAX);
+	{
+		PackedVector3Array vertices;
+		vertices.push_back(Vector3(0, 16, 0));
+		vertices.push_back(Vector3(32, 16, 0));
+		vertices.push_back(Vector3(0, 16, 32));
+		PackedVector3Array normals;
+		for (int i = 0; i < vertices.size(); ++i) {
+			normals.push_back(Vector3(0, 1, 0));
+		}
+		mesh_arrays[ArrayMesh::ARRAY_VERTEX] = vertices;
+		mesh_arrays[ArrayMesh::ARRAY_NORMAL] = normals;
+	}
+
+	std::shared_ptr<InstancerTaskOutputQueue> output_queue = make_shared_instance<InstancerTaskOutputQueue>();
+
+	LoadInstanceChunkTask task(
+			output_queue,
+			stream,
+			nullptr,
+			library,
+			mesh_arrays,
+			render_block_position,
+			0,
+			1 << mesh_block_size_po2,
+			1 << data_block_size_po2,
+			UP_MODE_POSITIVE_Y
+	);
+	LinearAllocator temp_allocator;
+	ThreadedTaskContext ctx(0, TaskPriority(), temp_allocator);
+	task.run(ctx);
+
+	// If any part had to be generated, the layer would have been handed to a generation task instead of being output
+	ZN_TEST_ASSERT(output_queue->results.size() == 1);
+	const InstanceLoadingTaskOutput &output = output_queue->results[0];
+	ZN_TEST_ASSERT(output.layer_id == layer_id);
+	ZN_TEST_ASSERT(output.edited_mask == 0xff);
+	ZN_TEST_ASSERT(output.transforms.size() == 8);
+}
+
 } // namespace zylann::voxel::tests
@@ -4,6 +4,10 @@
 namespace zylann::voxel::tests {
 
 void test_instance_data_serialization();
+void test_instance_data_serialization_compact();
+void test_instance_data_deserialization_simple_11b();
+void test_instance_data_serialization_legacy();
+void test_instancer_save_generated_instances();
 
 } // namespace zylann::voxel::tests
 
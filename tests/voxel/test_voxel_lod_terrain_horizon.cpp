@@ -0,0 +1,77 @@
+#include "test_voxel_lod_terrain_horizon.h"
+#include "../../generators/simple/voxel_generator_flat.h"
+#include "../../terrain/variable_lod/voxel_lod_terrain_horizon.h"
+#include "../../util/godot/classes/mesh.h"
+#include "../../util/godot/core/packed_arrays.h"
+#include "../../util/math/funcs.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+void test_voxel_lod_terrain_horizon() {
+	const float ground_height = 10.3f;
+
+	Ref<VoxelGeneratorFlat> generator;
+	generator.instantiate();
+	generator->set_height(ground_height);
+
+	VoxelLodTerrainHorizon::Heightmap heightmap;
+	heightmap.origin_in_cells = Vector2i(-4, -4);
+	heightmap.cell_size = 8.f;
+	heightmap.resolution = 8;
+	heightmap.min_height = -64.f;
+	heightmap.max_height = 64.f;
+
+	VoxelLodTerrainHorizon::update_heightmap(heightmap, nullptr, **generator);
+
+	const unsigned int vertex_count_per_side = heightmap.get_vertex_count_per_side();
+	ZN_TEST_ASSERT(heightmap.heights.size() == vertex_count_per_side * vertex_count_per_side);
+	for (const float h : heightmap.heights) {
+		ZN_TEST_ASSERT(Math::abs(h - ground_height) < 1.f);
+	}
+
+	// Heights of columns found in the previous heightmap should be copied instead of searched
+	{
+		VoxelLodTerrainHorizon::Heightmap previous = heightmap;
+		for (float &h : previous.heights) {
+			h = 1000.f;
+		}
+
+		VoxelLodTerrainHorizon::Heightmap moved = heightmap;
+		moved.origin_in_cells = Vector2i(-3, -4);
+		VoxelLodTerrainHorizon::update_heightmap(moved, &previous, **generator);
+
+		for (unsigned int z = 0; z < vertex_count_per_side; ++z) {
+			for (unsigned int x = 0; x < vertex_count_per_side; ++x) {
+				const float h = moved.heights[x + z * vertex_count_per_side];
+				if (x + 1 < vertex_count_per_side) {
+					ZN_TEST_ASSERT(h == 1000.f);
+				} else {
+					ZN_TEST_ASSERT(Math::abs(h - ground_height) < 1.f);
+				}
+			}
+		}
+	}
+
+	// The mesh has a hole of 4x4 cells in the middle
+	{
+		const Array arrays = VoxelLodTerrainHorizon::build_mesh_arrays(heightmap, 16.f);
+		ZN_TEST_ASSERT(arrays.size() == Mesh::ARRAY_MAX);
+
+		const PackedInt32Array indices = arrays[Mesh::ARRAY_INDEX];
+		ZN_TEST_ASSERT(indices.size() == (8 * 8 - 4 * 4) * 6);
+
+		const PackedVector3Array normals = arrays[Mesh::ARRAY_NORMAL];
+		for (int i = 0; i < normals.size(); ++i) {
+			ZN_TEST_ASSERT(normals[i].y > 0.99f);
+		}
+	}
+
+	// Nothing to draw if voxel blocks cover the whole heightmap
+	{
+		const Array arrays = VoxelLodTerrainHorizon::build_mesh_arrays(heightmap, 1000.f);
+		ZN_TEST_ASSERT(arrays.size() == 0);
+	}
+}
+
+} // namespace zylann::voxel::tests
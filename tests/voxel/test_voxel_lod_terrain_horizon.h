@@ -0,0 +1,10 @@
+#ifndef VOXEL_TEST_VOXEL_LOD_TERRAIN_HORIZON_H
+#define VOXEL_TEST_VOXEL_LOD_TERRAIN_HORIZON_H
+
+namespace zylann::voxel::tests {
+
+void test_voxel_lod_terrain_horizon();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_VOXEL_LOD_TERRAIN_HORIZON_H
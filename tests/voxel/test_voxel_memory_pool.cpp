@@ -0,0 +1,210 @@
+#include "test_voxel_memory_pool.h"
+#include "../../storage/voxel_memory_pool.h"
+#include "../../util/containers/fixed_array.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/thread/thread.h"
+#include "../testing.h"
+
+#include <cstring>
+#include <random>
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+void test_voxel_memory_pool_threads_common(bool arena_enabled) {
+	// Many threads allocate, fill, check and recycle blocks of various sizes at the same time. Some blocks are recycled
+	// by a different thread than the one that allocated them.
+
+	struct Allocation {
+		uint8_t *block;
+		size_t size;
+		uint8_t value;
+	};
+
+	struct ThreadData {
+		VoxelMemoryPool *pool;
+		unsigned int seed;
+		// Blocks left allocated by the thread when it finishes
+		StdVector<Allocation> remaining;
+	};
+
+	static const unsigned int THREAD_COUNT = 4;
+	static const unsigned int ITERATION_COUNT = 10000;
+
+	VoxelMemoryPool pool;
+	pool.set_arena_enabled(arena_enabled);
+
+	FixedArray<ThreadData, THREAD_COUNT> thread_data;
+	FixedArray<Thread, THREAD_COUNT> threads;
+
+	for (unsigned int i = 0; i < threads.size(); ++i) {
+		ThreadData &td = thread_data[i];
+		td.pool = &pool;
+		td.seed = 131 + i;
+
+		threads[i].start(
+				[](void *userdata) {
+					ThreadData &td = *static_cast<ThreadData *>(userdata);
+					std::mt19937 rng(td.seed);
+					StdVector<Allocation> allocations;
+
+					auto check_and_recycle = [&td](const Allocation &a) {
+						for (size_t i = 0; i < a.size; ++i) {
+							ZN_TEST_ASSERT(a.block[i] == a.value);
+						}
+						td.pool->recycle(a.block, a.size);
+					};
+
+					for (unsigned int it = 0; it < ITERATION_COUNT; ++it) {
+						if (allocations.size() > 0 && (rng() % 2 == 0 || allocations.size() > 100)) {
+							const unsigned int i = rng() % allocations.size();
+							check_and_recycle(allocations[i]);
+							allocations[i] = allocations.back();
+							allocations.pop_back();
+						} else {
+							Allocation a;
+							// Sizes up to 512 Kb, including some that are not cached per thread
+							a.size = size_t(1) << (rng() % 20);
+							if (rng() % 4 == 0) {
+								a.size += rng() % a.size;
+							}
+							a.value = rng();
+							a.block = td.pool->allocate(a.size);
+							ZN_TEST_ASSERT(a.block != nullptr);
+							memset(a.block, a.value, a.size);
+							allocations.push_back(a);
+						}
+					}
+
+					td.remaining = std::move(allocations);
+				},
+				&td
+		);
+	}
+
+	for (unsigned int i = 0; i < threads.size(); ++i) {
+		threads[i].wait_to_finish();
+	}
+
+	ZN_TEST_ASSERT(pool.debug_get_used_blocks() > 0);
+
+	// Recycle what's left from the main thread
+	for (const ThreadData &td : thread_data) {
+		for (const Allocation &a : td.remaining) {
+			for (size_t i = 0; i < a.size; ++i) {
+				ZN_TEST_ASSERT(a.block[i] == a.value);
+			}
+			pool.recycle(a.block, a.size);
+		}
+	}
+
+	ZN_TEST_ASSERT(pool.debug_get_used_blocks() == 0);
+	ZN_TEST_ASSERT(pool.debug_get_used_memory() == 0);
+
+	// Blocks cached by threads must have been given back when they exited
+	pool.clear_unused_blocks();
+	ZN_TEST_ASSERT(pool.debug_get_total_memory() == 0);
+	ZN_TEST_ASSERT(pool.get_arena_stats().slab_count == 0);
+}
+
+} // namespace
+
+void test_voxel_memory_pool_threads() {
+	test_voxel_memory_pool_threads_common(false);
+}
+
+void test_voxel_memory_pool_arena_threads() {
+	if (!virtual_memory::is_supported()) {
+		return;
+	}
+	test_voxel_memory_pool_threads_common(true);
+}
+
+void test_voxel_memory_pool_arena() {
+	if (!virtual_memory::is_supported()) {
+		return;
+	}
+
+	VoxelMemoryPool pool;
+	pool.set_arena_enabled(true);
+	ZN_TEST_ASSERT(pool.is_arena_enabled());
+
+	// More blocks than a slab can hold
+	const size_t block_size = 4096;
+	const size_t blocks_per_slab = virtual_memory::LARGE_PAGE_SIZE / block_size;
+	const unsigned int block_count = blocks_per_slab + blocks_per_slab / 2;
+
+	StdVector<uint8_t *> blocks;
+	for (unsigned int i = 0; i < block_count; ++i) {
+		uint8_t *block = pool.allocate(block_size);
+		ZN_TEST_ASSERT(block != nullptr);
+		memset(block, i & 0xff, block_size);
+		blocks.push_back(block);
+	}
+
+	{
+		const VoxelMemoryPool::ArenaStats stats = pool.get_arena_stats();
+		ZN_TEST_ASSERT(stats.slab_count == 2);
+		ZN_TEST_ASSERT(stats.reserved_bytes == 2 * virtual_memory::LARGE_PAGE_SIZE);
+		// Some blocks may have been taken ahead by the thread cache
+		ZN_TEST_ASSERT(stats.used_bytes >= block_count * block_size);
+		ZN_TEST_ASSERT(stats.empty_slab_count == 0);
+		ZN_TEST_ASSERT(pool.debug_get_total_memory() == stats.reserved_bytes);
+	}
+
+	// Blocks must not overlap
+	for (unsigned int i = 0; i < blocks.size(); ++i) {
+		for (size_t j = 0; j < block_size; ++j) {
+			ZN_TEST_ASSERT(blocks[i][j] == (i & 0xff));
+		}
+	}
+
+	// Recycled blocks get reused without creating more slabs
+	pool.recycle(blocks[0], block_size);
+	blocks[0] = pool.allocate(block_size);
+	ZN_TEST_ASSERT(blocks[0] != nullptr);
+	ZN_TEST_ASSERT(pool.get_arena_stats().slab_count == 2);
+
+	// Other sizes use other slabs
+	uint8_t *small_block = pool.allocate(100);
+	ZN_TEST_ASSERT(small_block != nullptr);
+	ZN_TEST_ASSERT(pool.get_arena_stats().slab_count == 3);
+	pool.recycle(small_block, 100);
+
+	for (uint8_t *block : blocks) {
+		pool.recycle(block, block_size);
+	}
+	ZN_TEST_ASSERT(pool.debug_get_used_blocks() == 0);
+
+	// Empty slabs are given back
+	pool.clear_unused_blocks();
+	const VoxelMemoryPool::ArenaStats stats = pool.get_arena_stats();
+	ZN_TEST_ASSERT(stats.slab_count == 0);
+	ZN_TEST_ASSERT(stats.used_bytes == 0);
+	ZN_TEST_ASSERT(pool.debug_get_total_memory() == 0);
+}
+
+void test_voxel_memory_pool_size_classes() {
+	size_t prev_block_size = 0;
+	for (size_t size = 1; size <= 1024 * 1024; ++size) {
+		const size_t block_size = VoxelMemoryPool::get_pooled_block_size(size);
+		ZN_TEST_ASSERT(block_size >= size);
+		ZN_TEST_ASSERT(block_size >= prev_block_size);
+		if (size > 64) {
+			// Less than a quarter is wasted, and blocks remain aligned
+			ZN_TEST_ASSERT(block_size - size < size / 4 + 1);
+			ZN_TEST_ASSERT(block_size % 16 == 0);
+		}
+		prev_block_size = block_size;
+	}
+	// Padded buffers used for meshing
+	ZN_TEST_ASSERT(VoxelMemoryPool::get_pooled_block_size(18 * 18 * 18 * 2) == 12 * 1024);
+	ZN_TEST_ASSERT(VoxelMemoryPool::get_pooled_block_size(34 * 34 * 34 * 2) == 80 * 1024);
+	// Powers of two are not rounded
+	ZN_TEST_ASSERT(VoxelMemoryPool::get_pooled_block_size(16 * 16 * 16) == 16 * 16 * 16);
+	// Not pooled
+	ZN_TEST_ASSERT(VoxelMemoryPool::get_pooled_block_size(3 * 1024 * 1024) == 3 * 1024 * 1024);
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,13 @@
+#ifndef VOXEL_TEST_VOXEL_MEMORY_POOL_H
+#define VOXEL_TEST_VOXEL_MEMORY_POOL_H
+
+namespace zylann::voxel::tests {
+
+void test_voxel_memory_pool_threads();
+void test_voxel_memory_pool_arena();
+void test_voxel_memory_pool_arena_threads();
+void test_voxel_memory_pool_size_classes();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_VOXEL_MEMORY_POOL_H
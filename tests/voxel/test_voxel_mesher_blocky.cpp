@@ -0,0 +1,349 @@
+#include "test_voxel_mesher_blocky.h"
+#include "../../meshers/blocky/voxel_blocky_library.h"
+#include "../../meshers/blocky/voxel_blocky_model_cube.h"
+#include "../../meshers/blocky/voxel_blocky_model_empty.h"
+#include "../../meshers/blocky/voxel_blocky_model_mesh.h"
+#include "../../meshers/blocky/voxel_mesher_blocky.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../util/godot/classes/array_mesh.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+Ref<VoxelBlockyLibrary> make_cube_library(Vector2i atlas_size_in_tiles) {
+	Ref<VoxelBlockyLibrary> library;
+	library.instantiate();
+	{
+		Ref<VoxelBlockyModelEmpty> air;
+		air.instantiate();
+		library->add_model(air);
+	}
+	{
+		Ref<VoxelBlockyModelCube> cube;
+		cube.instantiate();
+		cube->set_atlas_size_in_tiles(atlas_size_in_tiles);
+		library->add_model(cube);
+	}
+	library->bake();
+	return library;
+}
+
+VoxelMesher::Output build_slab(
+		Vector2i atlas_size_in_tiles,
+		bool greedy_meshing,
+		bool collision_greedy_meshing = false
+) {
+	Ref<VoxelMesherBlocky> mesher;
+	mesher.instantiate();
+	mesher->set_library(make_cube_library(atlas_size_in_tiles));
+	mesher->set_greedy_meshing_enabled(greedy_meshing);
+	mesher->set_collision_greedy_meshing_enabled(collision_greedy_meshing);
+
+	// Slab of 3x1x2 cubes
+	VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	vb.create(8, 8, 8);
+	for (int z = 3; z < 5; ++z) {
+		for (int x = 2; x < 5; ++x) {
+			vb.set_voxel(1, Vector3i(x, 3, z), VoxelBuffer::CHANNEL_TYPE);
+		}
+	}
+
+	VoxelMesher::Input input{ vb, nullptr, Vector3i(), 0, true };
+	VoxelMesher::Output output;
+	mesher->build(output, input);
+	return output;
+}
+
+} // namespace
+
+void test_voxel_mesher_blocky_greedy() {
+	{
+		const VoxelMesher::Output output = build_slab(Vector2i(1, 1), true);
+		ZN_TEST_ASSERT(output.surfaces.size() == 1);
+
+		const PackedVector3Array vertices = output.surfaces[0].arrays[Mesh::ARRAY_VERTEX];
+		const PackedVector2Array uvs = output.surfaces[0].arrays[Mesh::ARRAY_TEX_UV];
+		const PackedInt32Array indices = output.surfaces[0].arrays[Mesh::ARRAY_INDEX];
+
+		// Each side of the slab is a single quad
+		ZN_TEST_ASSERT(vertices.size() == 6 * 4);
+		ZN_TEST_ASSERT(indices.size() == 6 * 6);
+		ZN_TEST_ASSERT(uvs.size() == vertices.size());
+
+		// The texture repeats once per voxel
+		for (int quad_index = 0; quad_index < 6; ++quad_index) {
+			AABB position_box(vertices[quad_index * 4], Vector3());
+			Rect2 uv_rect(uvs[quad_index * 4], Vector2());
+			for (int i = 1; i < 4; ++i) {
+				position_box.expand_to(vertices[quad_index * 4 + i]);
+				uv_rect.expand_to(uvs[quad_index * 4 + i]);
+			}
+			// One of the axes is flat
+			const Vector3 ps = position_box.size;
+			const real_t quad_area = ps.x * ps.y + ps.y * ps.z + ps.z * ps.x;
+			ZN_TEST_ASSERT(Math::is_equal_approx(quad_area, uv_rect.size.x * uv_rect.size.y));
+			ZN_TEST_ASSERT(quad_area > 1.5);
+		}
+	}
+	{
+		// Greedy meshing is disabled, all 22 visible faces are separate
+		const VoxelMesher::Output output = build_slab(Vector2i(1, 1), false);
+		ZN_TEST_ASSERT(output.surfaces.size() == 1);
+		const PackedVector3Array vertices = output.surfaces[0].arrays[Mesh::ARRAY_VERTEX];
+		ZN_TEST_ASSERT(vertices.size() == 22 * 4);
+	}
+	{
+		// Tiles of an atlas can't repeat, faces are not merged
+		const VoxelMesher::Output output = build_slab(Vector2i(16, 16), true);
+		ZN_TEST_ASSERT(output.surfaces.size() == 1);
+		const PackedVector3Array vertices = output.surfaces[0].arrays[Mesh::ARRAY_VERTEX];
+		ZN_TEST_ASSERT(vertices.size() == 22 * 4);
+	}
+}
+
+void test_voxel_mesher_blocky_collision_greedy() {
+	struct L {
+		static void check_slab_collision(const VoxelMesher::Output::CollisionSurface &cs) {
+			// Slab of 3x1x2 cubes, with padding of 1
+			const Vector3f center(2.5f, 2.5f, 3.f);
+			float area = 0.f;
+			ZN_TEST_ASSERT(cs.indices.size() % 3 == 0);
+			for (unsigned int i = 0; i < cs.indices.size(); i += 3) {
+				const Vector3f a = cs.positions[cs.indices[i]];
+				const Vector3f b = cs.positions[cs.indices[i + 1]];
+				const Vector3f c = cs.positions[cs.indices[i + 2]];
+				const Vector3f n = math::cross(b - a, c - a);
+				area += 0.5f * math::length(n);
+				// Triangles must face outwards, with the same winding as the visual mesh
+				const Vector3f centroid = (a + b + c) / 3.f;
+				ZN_TEST_ASSERT(math::dot(n, centroid - center) < 0.f);
+			}
+			ZN_TEST_ASSERT(Math::is_equal_approx(area, 22.f));
+		}
+	};
+	{
+		// Tiles of an atlas can't repeat, so visual faces are not merged, but collision faces are
+		const VoxelMesher::Output output = build_slab(Vector2i(16, 16), false, true);
+		ZN_TEST_ASSERT(output.surfaces.size() == 1);
+		const PackedVector3Array vertices = output.surfaces[0].arrays[Mesh::ARRAY_VERTEX];
+		ZN_TEST_ASSERT(vertices.size() == 22 * 4);
+		ZN_TEST_ASSERT(output.collision_surface.positions.size() == 6 * 4);
+		ZN_TEST_ASSERT(output.collision_surface.indices.size() == 6 * 6);
+		L::check_slab_collision(output.collision_surface);
+	}
+	{
+		// Combined with visual greedy meshing, collision faces are not added twice
+		const VoxelMesher::Output output = build_slab(Vector2i(1, 1), true, true);
+		ZN_TEST_ASSERT(output.collision_surface.positions.size() == 6 * 4);
+		L::check_slab_collision(output.collision_surface);
+	}
+	{
+		// Collision follows visual faces by default
+		const VoxelMesher::Output output = build_slab(Vector2i(16, 16), false, false);
+		ZN_TEST_ASSERT(output.collision_surface.positions.size() == 22 * 4);
+		L::check_slab_collision(output.collision_surface);
+	}
+}
+
+void test_voxel_mesher_blocky_tall_column() {
+	// Visible sides are found from bitmasks of 64 voxels along Y. Check neighbors are found across them.
+	const int height = 150;
+
+	Ref<VoxelMesherBlocky> mesher;
+	mesher.instantiate();
+	mesher->set_library(make_cube_library(Vector2i(16, 16)));
+
+	VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	vb.create(3, height, 3);
+	for (int y = 1; y < height - 1; ++y) {
+		vb.set_voxel(1, Vector3i(1, y, 1), VoxelBuffer::CHANNEL_TYPE);
+	}
+
+	VoxelMesher::Input input{ vb, nullptr, Vector3i(), 0, false };
+	VoxelMesher::Output output;
+	mesher->build(output, input);
+
+	ZN_TEST_ASSERT(output.surfaces.size() == 1);
+	const PackedVector3Array vertices = output.surfaces[0].arrays[Mesh::ARRAY_VERTEX];
+	// 4 sides per cube, plus top and bottom of the column
+	const int inner_height = height - 2;
+	ZN_TEST_ASSERT(vertices.size() == (4 * inner_height + 2) * 4);
+}
+
+void test_voxel_mesher_blocky_bake_model() {
+	struct L {
+		static Ref<VoxelBlockyLibrary> make_library(Ref<VoxelBlockyModelCube> &out_cube) {
+			Ref<VoxelBlockyLibrary> library;
+			library.instantiate();
+			Ref<VoxelBlockyModelEmpty> air;
+			air.instantiate();
+			library->add_model(air);
+			out_cube.instantiate();
+			library->add_model(out_cube);
+			library->bake();
+			return library;
+		}
+	};
+
+	Ref<VoxelBlockyModelCube> cube;
+	Ref<VoxelBlockyLibrary> library = L::make_library(cube);
+	{
+		const VoxelBlockyLibraryBase::BakedData &baked_data = library->get_baked_data();
+		ZN_TEST_ASSERT(baked_data.models.size() == 2);
+		ZN_TEST_ASSERT((baked_data.models[1].model.full_sides_mask & (1 << Cube::SIDE_POSITIVE_Y)) != 0);
+	}
+
+	// Turn the cube into a slab, its top side no longer occludes neighbors
+	cube->set_height(0.5f);
+	library->bake_model(1);
+
+	Ref<VoxelBlockyModelCube> expected_cube;
+	Ref<VoxelBlockyLibrary> expected_library = L::make_library(expected_cube);
+	expected_cube->set_height(0.5f);
+	expected_library->bake();
+
+	const VoxelBlockyLibraryBase::BakedData &baked_data = library->get_baked_data();
+	const VoxelBlockyLibraryBase::BakedData &expected_baked_data = expected_library->get_baked_data();
+
+	ZN_TEST_ASSERT(baked_data.models.size() == expected_baked_data.models.size());
+	ZN_TEST_ASSERT(baked_data.side_pattern_count == expected_baked_data.side_pattern_count);
+	ZN_TEST_ASSERT(baked_data.indexed_materials_count == expected_baked_data.indexed_materials_count);
+
+	for (unsigned int i = 0; i < baked_data.models.size(); ++i) {
+		const VoxelBlockyModel::BakedData::Model &model = baked_data.models[i].model;
+		const VoxelBlockyModel::BakedData::Model &expected_model = expected_baked_data.models[i].model;
+		ZN_TEST_ASSERT(model.full_sides_mask == expected_model.full_sides_mask);
+		ZN_TEST_ASSERT(model.empty_sides_mask == expected_model.empty_sides_mask);
+		ZN_TEST_ASSERT(model.side_pattern_indices == expected_model.side_pattern_indices);
+	}
+
+	ZN_TEST_ASSERT((baked_data.models[1].model.full_sides_mask & (1 << Cube::SIDE_POSITIVE_Y)) == 0);
+}
+
+void test_voxel_mesher_blocky_cubes_only() {
+	struct L {
+		static Ref<VoxelBlockyLibrary> make_library(bool with_inner_geometry) {
+			Ref<VoxelBlockyLibrary> library;
+			library.instantiate();
+			{
+				Ref<VoxelBlockyModelEmpty> air;
+				air.instantiate();
+				library->add_model(air);
+			}
+			{
+				Ref<VoxelBlockyModelCube> cube;
+				cube.instantiate();
+				cube->set_atlas_size_in_tiles(Vector2i(16, 16));
+				library->add_model(cube);
+			}
+			{
+				Ref<VoxelBlockyModelCube> slab;
+				slab.instantiate();
+				slab->set_atlas_size_in_tiles(Vector2i(16, 16));
+				slab->set_height(0.5f);
+				library->add_model(slab);
+			}
+			if (with_inner_geometry) {
+				// Single triangle floating in the middle of the voxel
+				PackedVector3Array vertices;
+				vertices.push_back(Vector3(0.25, 0.5, 0.25));
+				vertices.push_back(Vector3(0.75, 0.5, 0.25));
+				vertices.push_back(Vector3(0.25, 0.5, 0.75));
+				PackedVector3Array normals;
+				normals.resize(vertices.size());
+				normals.fill(Vector3(0, 1, 0));
+				PackedVector2Array uvs;
+				uvs.resize(vertices.size());
+				uvs.fill(Vector2());
+				PackedInt32Array indices;
+				indices.push_back(0);
+				indices.push_back(1);
+				indices.push_back(2);
+
+				Array arrays;
+				arrays.resize(Mesh::ARRAY_MAX);
+				arrays[Mesh::ARRAY_VERTEX] = vertices;
+				arrays[Mesh::ARRAY_NORMAL] = normals;
+				arrays[Mesh::ARRAY_TEX_UV] = uvs;
+				arrays[Mesh::ARRAY_INDEX] = indices;
+
+				Ref<ArrayMesh> mesh;
+				mesh.instantiate();
+				mesh->add_surface_from_arrays(Mesh::PRIMITIVE_TRIANGLES, arrays);
+
+				Ref<VoxelBlockyModelMesh> model;
+				model.instantiate();
+				model->set_mesh(mesh);
+				library->add_model(model);
+			}
+			library->bake();
+			return library;
+		}
+
+		static VoxelMesher::Output build(Ref<VoxelBlockyLibrary> library, bool occlusion) {
+			Ref<VoxelMesherBlocky> mesher;
+			mesher.instantiate();
+			mesher->set_library(library);
+			mesher->set_occlusion_enabled(occlusion);
+
+			// Steps of cubes and slabs, so some sides get occlusion and some don't
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			vb.create(8, 8, 8);
+			for (int z = 1; z < 7; ++z) {
+				for (int x = 1; x < 7; ++x) {
+					const int height = 1 + (x + z) % 3;
+					for (int y = 1; y <= height; ++y) {
+						const int model_id = (y == height && ((x + z) % 2) == 0) ? 2 : 1;
+						vb.set_voxel(model_id, Vector3i(x, y, z), VoxelBuffer::CHANNEL_TYPE);
+					}
+				}
+			}
+
+			VoxelMesher::Input input{ vb, nullptr, Vector3i(), 0, false };
+			VoxelMesher::Output output;
+			mesher->build(output, input);
+			return output;
+		}
+	};
+
+	Ref<VoxelBlockyLibrary> cubes_library = L::make_library(false);
+	Ref<VoxelBlockyLibrary> mixed_library = L::make_library(true);
+	ZN_TEST_ASSERT(cubes_library->get_baked_data().cubes_only);
+	ZN_TEST_ASSERT(!mixed_library->get_baked_data().cubes_only);
+
+	// The same voxels must produce the same meshes whether the fast path is used or not
+	for (const bool occlusion : { false, true }) {
+		const VoxelMesher::Output fast_output = L::build(cubes_library, occlusion);
+		const VoxelMesher::Output general_output = L::build(mixed_library, occlusion);
+
+		ZN_TEST_ASSERT(fast_output.surfaces.size() == 1);
+		ZN_TEST_ASSERT(fast_output.surfaces.size() == general_output.surfaces.size());
+
+		const Array &fast_arrays = fast_output.surfaces[0].arrays;
+		const Array &general_arrays = general_output.surfaces[0].arrays;
+
+		const PackedVector3Array vertices = fast_arrays[Mesh::ARRAY_VERTEX];
+		ZN_TEST_ASSERT(vertices.size() > 0);
+		ZN_TEST_ASSERT(vertices == PackedVector3Array(general_arrays[Mesh::ARRAY_VERTEX]));
+		ZN_TEST_ASSERT(
+				PackedVector3Array(fast_arrays[Mesh::ARRAY_NORMAL]) ==
+				PackedVector3Array(general_arrays[Mesh::ARRAY_NORMAL])
+		);
+		ZN_TEST_ASSERT(
+				PackedVector2Array(fast_arrays[Mesh::ARRAY_TEX_UV]) ==
+				PackedVector2Array(general_arrays[Mesh::ARRAY_TEX_UV])
+		);
+		ZN_TEST_ASSERT(
+				PackedColorArray(fast_arrays[Mesh::ARRAY_COLOR]) == PackedColorArray(general_arrays[Mesh::ARRAY_COLOR])
+		);
+		ZN_TEST_ASSERT(
+				PackedInt32Array(fast_arrays[Mesh::ARRAY_INDEX]) == PackedInt32Array(general_arrays[Mesh::ARRAY_INDEX])
+		);
+		ZN_TEST_ASSERT(fast_output.collision_surface.positions == general_output.collision_surface.positions);
+		ZN_TEST_ASSERT(fast_output.collision_surface.indices == general_output.collision_surface.indices);
+	}
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,14 @@
+#ifndef VOXEL_TESTS_VOXEL_MESHER_BLOCKY_H
+#define VOXEL_TESTS_VOXEL_MESHER_BLOCKY_H
+
+namespace zylann::voxel::tests {
+
+void test_voxel_mesher_blocky_greedy();
+void test_voxel_mesher_blocky_collision_greedy();
+void test_voxel_mesher_blocky_tall_column();
+void test_voxel_mesher_blocky_bake_model();
+void test_voxel_mesher_blocky_cubes_only();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TESTS_VOXEL_MESHER_BLOCKY_H
@@ -0,0 +1,285 @@
+#include "test_voxel_mesher_transvoxel.h"
+#include "../../meshers/transvoxel/transvoxel.h"
+#include "../../storage/materials_4i4w.h"
+#include "../../storage/voxel_buffer.h"
+#include "../../util/containers/std_vector.h"
+#include "../../util/io/log.h"
+#include "../../util/math/conv.h"
+#include "../../util/math/funcs.h"
+#include "../../util/string/format.h"
+#include "../benchmarking.h"
+#include "../testing.h"
+
+#include <cmath>
+
+namespace zylann::voxel::tests {
+
+namespace {
+
+// Wavy ball crossing the borders of the block, with the padding required by Transvoxel around it
+void make_wavy_ball_block(VoxelBuffer &vb, int block_size, VoxelBuffer::Depth depth) {
+	const Vector3i size = Vector3iUtil::create(block_size + transvoxel::MIN_PADDING + transvoxel::MAX_PADDING);
+	vb.create(size);
+	vb.set_channel_depth(VoxelBuffer::CHANNEL_SDF, depth);
+	vb.decompress_channel(VoxelBuffer::CHANNEL_SDF);
+
+	const Vector3f center = Vector3f(0.5f * block_size);
+	const float radius = 0.6f * block_size;
+
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				const Vector3f p = to_vec3f(pos);
+				const float bumps = 1.5f * std::sin(p.x * 0.7f) * std::cos(p.z * 0.5f) + std::sin(p.y * 0.9f);
+				const float sd = math::distance(p, center) - radius + bumps;
+				vb.set_voxel_f(math::clamp(sd * 0.1f, -1.f, 1.f), pos, VoxelBuffer::CHANNEL_SDF);
+			}
+		}
+	}
+}
+
+// Counts cells the mesher should triangulate, by checking each of them independently
+unsigned int count_triangulated_cells(const VoxelBuffer &vb) {
+	const Vector3i min_pos = Vector3iUtil::create(transvoxel::MIN_PADDING);
+	const Vector3i max_pos = vb.get_size() - Vector3iUtil::create(transvoxel::MAX_PADDING);
+	unsigned int count = 0;
+
+	Vector3i pos;
+	for (pos.z = min_pos.z; pos.z < max_pos.z; ++pos.z) {
+		for (pos.x = min_pos.x; pos.x < max_pos.x; ++pos.x) {
+			for (pos.y = min_pos.y; pos.y < max_pos.y; ++pos.y) {
+				unsigned int above_count = 0;
+				unsigned int below_count = 0;
+				for (unsigned int i = 0; i < 8; ++i) {
+					const Vector3i corner = pos + Vector3i(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+					const float sd = vb.get_voxel_f(corner, VoxelBuffer::CHANNEL_SDF);
+					above_count += sd > 0.f;
+					below_count += sd < 0.f;
+				}
+				// Same conditions as the mesher: corners must not be all on the same side of the isolevel, and the
+				// case code (signs of corners below zero) must not be empty or full
+				if (above_count != 0 && above_count != 8 && below_count != 0 && below_count != 8) {
+					++count;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+} // namespace
+
+void test_voxel_mesher_transvoxel_crossing_cells() {
+	const VoxelBuffer::Depth depths[] = { //
+		VoxelBuffer::DEPTH_8_BIT, VoxelBuffer::DEPTH_16_BIT, VoxelBuffer::DEPTH_32_BIT
+	};
+	// 20 cells don't fill the last region of bricks, and 40 cells along Y span more than one row of cells tested at once
+	const int block_sizes[] = { 16, 20, 32, 40 };
+
+	for (const VoxelBuffer::Depth depth : depths) {
+		for (const int block_size : block_sizes) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			make_wavy_ball_block(vb, block_size, depth);
+
+			transvoxel::Cache cache;
+			transvoxel::MeshArrays arrays;
+			StdVector<transvoxel::CellInfo> cell_infos;
+			transvoxel::build_regular_mesh(
+					vb,
+					VoxelBuffer::CHANNEL_SDF,
+					0,
+					true,
+					transvoxel::TEXTURES_NONE,
+					cache,
+					arrays,
+					&cell_infos,
+					0.02f,
+					false
+			);
+
+			ZN_TEST_ASSERT(arrays.indices.size() > 0);
+			ZN_TEST_ASSERT(cell_infos.size() == count_triangulated_cells(vb));
+
+			// Cells are visited in memory order
+			for (unsigned int i = 1; i < cell_infos.size(); ++i) {
+				const Vector3i prev = cell_infos[i - 1].position;
+				const Vector3i pos = cell_infos[i].position;
+				const bool ordered = prev.z < pos.z ||
+						(prev.z == pos.z && (prev.x < pos.x || (prev.x == pos.x && prev.y < pos.y)));
+				ZN_TEST_ASSERT(ordered);
+			}
+		}
+	}
+}
+
+void test_voxel_mesher_transvoxel_regular_benchmark(testing::BenchmarkSuite &suite) {
+	const VoxelBuffer::Depth depths[] = { //
+		VoxelBuffer::DEPTH_8_BIT, VoxelBuffer::DEPTH_16_BIT, VoxelBuffer::DEPTH_32_BIT
+	};
+	const int block_sizes[] = { 16, 32 };
+
+	for (const int block_size : block_sizes) {
+		for (const VoxelBuffer::Depth depth : depths) {
+			VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+			make_wavy_ball_block(vb, block_size, depth);
+
+			transvoxel::Cache cache;
+			transvoxel::MeshArrays arrays;
+
+			for (const bool lod_attributes : { false, true }) {
+				const StdString name = format(
+						"transvoxel_regular_{}_cells_{}_bit{}",
+						block_size,
+						VoxelBuffer::get_depth_bit_count(depth),
+						lod_attributes ? "_lod_attributes" : ""
+				);
+				suite.run(name.c_str(), 10, [&vb, lod_attributes, &cache, &arrays]() {
+					transvoxel::build_regular_mesh(
+							vb,
+							VoxelBuffer::CHANNEL_SDF,
+							0,
+							lod_attributes,
+							transvoxel::TEXTURES_NONE,
+							cache,
+							arrays,
+							nullptr,
+							0.02f,
+							false
+					);
+				});
+
+				ZN_TEST_ASSERT(arrays.indices.size() > 0);
+			}
+		}
+	}
+}
+
+void test_voxel_mesher_transvoxel_lod_attributes() {
+	const VoxelBuffer::Depth depths[] = { //
+		VoxelBuffer::DEPTH_8_BIT, VoxelBuffer::DEPTH_16_BIT, VoxelBuffer::DEPTH_32_BIT
+	};
+
+	for (const VoxelBuffer::Depth depth : depths) {
+		VoxelBuffer vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+		make_wavy_ball_block(vb, 16, depth);
+
+		transvoxel::Cache cache;
+		transvoxel::MeshArrays with_attributes;
+		transvoxel::MeshArrays without_attributes;
+		transvoxel::build_regular_mesh(
+				vb,
+				VoxelBuffer::CHANNEL_SDF,
+				1,
+				true,
+				transvoxel::TEXTURES_NONE,
+				cache,
+				with_attributes,
+				nullptr,
+				0.02f,
+				false
+		);
+		transvoxel::build_regular_mesh(
+				vb,
+				VoxelBuffer::CHANNEL_SDF,
+				1,
+				false,
+				transvoxel::TEXTURES_NONE,
+				cache,
+				without_attributes,
+				nullptr,
+				0.02f,
+				false
+		);
+
+		// Geometry must not depend on LOD attributes
+		ZN_TEST_ASSERT(with_attributes.indices.size() > 0);
+		ZN_TEST_ASSERT(with_attributes.indices == without_attributes.indices);
+		ZN_TEST_ASSERT(with_attributes.vertices == without_attributes.vertices);
+		ZN_TEST_ASSERT(with_attributes.normals == without_attributes.normals);
+		ZN_TEST_ASSERT(with_attributes.lod_data.size() == without_attributes.lod_data.size());
+
+		bool found_border_vertex = false;
+		for (unsigned int i = 0; i < with_attributes.lod_data.size(); ++i) {
+			const transvoxel::LodAttrib &a = with_attributes.lod_data[i];
+			const transvoxel::LodAttrib &b = without_attributes.lod_data[i];
+			if (a.cell_border_mask != 0) {
+				found_border_vertex = true;
+			}
+			ZN_TEST_ASSERT(b.cell_border_mask == 0);
+			ZN_TEST_ASSERT(b.vertex_border_mask == 0);
+			ZN_TEST_ASSERT(b.secondary_position == Vector3f());
+		}
+		ZN_TEST_ASSERT(found_border_vertex);
+	}
+}
+
+void test_voxel_mesher_transvoxel_palette_indices() {
+	VoxelBuffer dense_vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	make_wavy_ball_block(dense_vb, 16, VoxelBuffer::DEPTH_16_BIT);
+
+	// A few materials in layers, so the indices channel is neither uniform nor too varied for a palette
+	dense_vb.set_channel_depth(VoxelBuffer::CHANNEL_INDICES, VoxelBuffer::DEPTH_16_BIT);
+	dense_vb.set_channel_depth(VoxelBuffer::CHANNEL_WEIGHTS, VoxelBuffer::DEPTH_16_BIT);
+	dense_vb.decompress_channel(VoxelBuffer::CHANNEL_INDICES);
+	dense_vb.fill(encode_weights_to_packed_u16_lossy(255, 0, 0, 0), VoxelBuffer::CHANNEL_WEIGHTS);
+	const Vector3i size = dense_vb.get_size();
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				const uint8_t layer = pos.y / 6;
+				dense_vb.set_voxel(
+						encode_indices_to_packed_u16(layer, layer + 1, layer + 2, layer + 3),
+						pos,
+						VoxelBuffer::CHANNEL_INDICES
+				);
+			}
+		}
+	}
+
+	VoxelBuffer palette_vb(VoxelBuffer::ALLOCATOR_DEFAULT);
+	dense_vb.copy_to(palette_vb, true);
+	palette_vb.compress_palette_channel(VoxelBuffer::CHANNEL_INDICES);
+	ZN_TEST_ASSERT(
+			palette_vb.get_channel_compression(VoxelBuffer::CHANNEL_INDICES) == VoxelBuffer::COMPRESSION_PALETTE
+	);
+
+	transvoxel::Cache cache;
+	transvoxel::MeshArrays dense_arrays;
+	transvoxel::MeshArrays palette_arrays;
+	transvoxel::build_regular_mesh(
+			dense_vb,
+			VoxelBuffer::CHANNEL_SDF,
+			0,
+			false,
+			transvoxel::TEXTURES_BLEND_4_OVER_16,
+			cache,
+			dense_arrays,
+			nullptr,
+			0.02f,
+			false
+	);
+	transvoxel::build_regular_mesh(
+			palette_vb,
+			VoxelBuffer::CHANNEL_SDF,
+			0,
+			false,
+			transvoxel::TEXTURES_BLEND_4_OVER_16,
+			cache,
+			palette_arrays,
+			nullptr,
+			0.02f,
+			false
+	);
+
+	ZN_TEST_ASSERT(dense_arrays.indices.size() > 0);
+	ZN_TEST_ASSERT(dense_arrays.indices == palette_arrays.indices);
+	ZN_TEST_ASSERT(dense_arrays.texturing_data.size() == palette_arrays.texturing_data.size());
+	for (unsigned int i = 0; i < dense_arrays.texturing_data.size(); ++i) {
+		ZN_TEST_ASSERT(dense_arrays.texturing_data[i] == palette_arrays.texturing_data[i]);
+	}
+}
+
+} // namespace zylann::voxel::tests
@@ -0,0 +1,17 @@
+#ifndef VOXEL_TESTS_VOXEL_MESHER_TRANSVOXEL_H
+#define VOXEL_TESTS_VOXEL_MESHER_TRANSVOXEL_H
+
+namespace zylann::testing {
+class BenchmarkSuite;
+}
+
+namespace zylann::voxel::tests {
+
+void test_voxel_mesher_transvoxel_crossing_cells();
+void test_voxel_mesher_transvoxel_regular_benchmark(testing::BenchmarkSuite &suite);
+void test_voxel_mesher_transvoxel_lod_attributes();
+void test_voxel_mesher_transvoxel_palette_indices();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TESTS_VOXEL_MESHER_TRANSVOXEL_H
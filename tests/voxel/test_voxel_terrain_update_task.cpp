@@ -0,0 +1,191 @@
+#include "test_voxel_terrain_update_task.h"
+#include "../../engine/meshing_dependency.h"
+#include "../../engine/streaming_dependency.h"
+#include "../../generators/simple/voxel_generator_flat.h"
+#include "../../terrain/fixed_lod/voxel_terrain_update_task.h"
+#include "../../util/memory/linear_allocator.h"
+#include "../../util/memory/memory.h"
+#include "../testing.h"
+
+namespace zylann::voxel::tests {
+
+void test_voxel_terrain_update_task_moving_viewer() {
+	// With a view distance of 2 mesh blocks, mesh boxes are 5x5x5 blocks, and data boxes are 7x7x7 blocks because
+	// meshing requires neighbors
+	const unsigned int view_distance = 32;
+	const int mesh_box_side = 5;
+	const int data_box_side = 7;
+
+	std::shared_ptr<VoxelData> data = make_shared_instance<VoxelData>();
+	const int block_size = data->get_block_size();
+
+	std::shared_ptr<VoxelTerrainUpdateData> update_data = make_shared_instance<VoxelTerrainUpdateData>();
+	VoxelTerrainUpdateData::Settings &settings = update_data->settings;
+	settings.mesh_block_size_po2 = data->get_block_size_po2();
+	settings.has_mesher = true;
+	settings.can_load_blocks = true;
+	settings.can_save_blocks = false;
+	VoxelTerrainUpdateData::State &state = update_data->state;
+
+	Ref<VoxelGeneratorFlat> generator;
+	generator.instantiate();
+	std::shared_ptr<StreamingDependency> streaming_dependency;
+	StreamingDependency::reset(streaming_dependency, Ref<VoxelStream>(), generator);
+	// The task may send generation and meshing requests, but this test simulates their results, so actual results
+	// are ignored
+	streaming_dependency->valid = false;
+
+	std::shared_ptr<MeshingDependency> meshing_dependency;
+	MeshingDependency::reset(meshing_dependency, Ref<VoxelMesher>(), generator);
+	meshing_dependency->valid = false;
+
+	std::shared_ptr<PriorityDependency::ViewersData> viewers_data =
+			make_shared_instance<PriorityDependency::ViewersData>();
+
+	ViewerID viewer_id;
+	viewer_id.index = 1;
+	VoxelEngine::Viewer viewer;
+	viewer.view_distances.horizontal = view_distance;
+	viewer.view_distances.vertical = view_distance;
+	viewer.require_visuals = true;
+	viewer.require_collisions = true;
+
+	struct L {
+		static void run_update(
+				std::shared_ptr<VoxelData> data,
+				std::shared_ptr<VoxelTerrainUpdateData> update_data,
+				std::shared_ptr<StreamingDependency> streaming_dependency,
+				std::shared_ptr<MeshingDependency> meshing_dependency,
+				std::shared_ptr<PriorityDependency::ViewersData> viewers_data
+		) {
+			VoxelTerrainUpdateTask task(
+					data,
+					update_data,
+					streaming_dependency,
+					meshing_dependency,
+					viewers_data,
+					VolumeID(),
+					Transform3D()
+			);
+			update_data->task_is_complete = false;
+			LinearAllocator temp_allocator;
+			ThreadedTaskContext ctx(0, TaskPriority(), temp_allocator);
+			task.run(ctx);
+			ZN_TEST_ASSERT(update_data->task_is_complete);
+		}
+
+		// Does what the main thread does with outputs of the task
+		static void consume_outputs(VoxelTerrainUpdateData::State &state) {
+			state.quick_reloading_blocks.clear();
+			state.mesh_blocks_to_create.clear();
+			state.mesh_blocks_to_unload.clear();
+			state.mesh_blocks_to_drop_visuals.clear();
+			state.mesh_blocks_to_drop_collisions.clear();
+			state.unloaded_data_blocks.clear();
+			state.block_enter_notifications.clear();
+		}
+
+		// Simulates responses to all loading requests, like `VoxelTerrain::apply_data_block_response`
+		static void complete_loading_blocks(VoxelData &data, VoxelTerrainUpdateData::State &state) {
+			for (auto it = state.loading_blocks.begin(); it != state.loading_blocks.end(); ++it) {
+				std::shared_ptr<VoxelBuffer> voxels = make_shared_instance<VoxelBuffer>(VoxelBuffer::ALLOCATOR_POOL);
+				voxels->create(Vector3iUtil::create(data.get_block_size()));
+				VoxelDataBlock block(voxels, 0);
+				block.viewers = it->second.viewers;
+				ZN_TEST_ASSERT(data.try_set_block(it->first, block));
+			}
+			state.loading_blocks.clear();
+		}
+
+		static bool all_x_equal(Span<const Vector3i> positions, int x) {
+			for (const Vector3i pos : positions) {
+				if (pos.x != x) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	const int data_box_volume = data_box_side * data_box_side * data_box_side;
+	const int mesh_box_volume = mesh_box_side * mesh_box_side * mesh_box_side;
+	const int data_box_face = data_box_side * data_box_side;
+	const int mesh_box_face = mesh_box_side * mesh_box_side;
+
+	// Viewer appears in the first block
+	viewer.world_position = Vector3(8, 8, 8);
+	update_data->viewers.push_back({ viewer_id, viewer });
+	L::run_update(data, update_data, streaming_dependency, meshing_dependency, viewers_data);
+
+	ZN_TEST_ASSERT(state.paired_viewers.size() == 1);
+	ZN_TEST_ASSERT(state.paired_viewers[0].state.data_box.size == Vector3iUtil::create(data_box_side));
+	ZN_TEST_ASSERT(state.paired_viewers[0].state.mesh_box.size == Vector3iUtil::create(mesh_box_side));
+	// All blocks are requested, and pending requests were sent
+	ZN_TEST_ASSERT(state.loading_blocks.size() == static_cast<size_t>(data_box_volume));
+	ZN_TEST_ASSERT(state.blocks_pending_load.size() == 0);
+	ZN_TEST_ASSERT(state.mesh_blocks.size() == static_cast<size_t>(mesh_box_volume));
+	ZN_TEST_ASSERT(state.mesh_blocks_to_create.size() == static_cast<size_t>(mesh_box_volume));
+	ZN_TEST_ASSERT(state.mesh_blocks_to_unload.size() == 0);
+	ZN_TEST_ASSERT(state.unloaded_data_blocks.size() == 0);
+	L::consume_outputs(state);
+
+	L::complete_loading_blocks(*data, state);
+	ZN_TEST_ASSERT(data->has_block(Vector3i(-3, 0, 0), 0));
+
+	// Viewer moves by one block along X
+	viewer.world_position = Vector3(8 + block_size, 8, 8);
+	update_data->viewers[0].second = viewer;
+	L::run_update(data, update_data, streaming_dependency, meshing_dependency, viewers_data);
+
+	// One slice of data blocks is unloaded behind, one is requested ahead
+	ZN_TEST_ASSERT(state.unloaded_data_blocks.size() == static_cast<size_t>(data_box_face));
+	ZN_TEST_ASSERT(L::all_x_equal(to_span(state.unloaded_data_blocks), -3));
+	ZN_TEST_ASSERT(!data->has_block(Vector3i(-3, 0, 0), 0));
+	ZN_TEST_ASSERT(data->has_block(Vector3i(-2, 0, 0), 0));
+	ZN_TEST_ASSERT(state.loading_blocks.size() == static_cast<size_t>(data_box_face));
+	for (auto it = state.loading_blocks.begin(); it != state.loading_blocks.end(); ++it) {
+		ZN_TEST_ASSERT(it->first.x == 4);
+		ZN_TEST_ASSERT(it->second.viewers.get() == 1);
+	}
+	// Same for mesh blocks
+	ZN_TEST_ASSERT(state.mesh_blocks.size() == static_cast<size_t>(mesh_box_volume));
+	ZN_TEST_ASSERT(state.mesh_blocks_to_unload.size() == static_cast<size_t>(mesh_box_face));
+	ZN_TEST_ASSERT(L::all_x_equal(to_span(state.mesh_blocks_to_unload), -2));
+	ZN_TEST_ASSERT(state.mesh_blocks_to_drop_visuals.size() == static_cast<size_t>(mesh_box_face));
+	ZN_TEST_ASSERT(state.mesh_blocks_to_drop_collisions.size() == static_cast<size_t>(mesh_box_face));
+	ZN_TEST_ASSERT(state.mesh_blocks_to_create.size() == static_cast<size_t>(mesh_box_face));
+	ZN_TEST_ASSERT(L::all_x_equal(to_span(state.mesh_blocks_to_create), 3));
+	L::consume_outputs(state);
+
+	// Viewer goes back before the slice ahead finished loading
+	viewer.world_position = Vector3(8, 8, 8);
+	update_data->viewers[0].second = viewer;
+	L::run_update(data, update_data, streaming_dependency, meshing_dependency, viewers_data);
+
+	// Loading ahead is cancelled, and the slice behind is requested again
+	ZN_TEST_ASSERT(state.loading_blocks.size() == static_cast<size_t>(data_box_face));
+	for (auto it = state.loading_blocks.begin(); it != state.loading_blocks.end(); ++it) {
+		ZN_TEST_ASSERT(it->first.x == -3);
+	}
+	// Blocks that were not loaded yet are not reported as unloaded
+	ZN_TEST_ASSERT(state.unloaded_data_blocks.size() == 0);
+	ZN_TEST_ASSERT(state.mesh_blocks_to_unload.size() == static_cast<size_t>(mesh_box_face));
+	ZN_TEST_ASSERT(L::all_x_equal(to_span(state.mesh_blocks_to_unload), 3));
+	ZN_TEST_ASSERT(state.mesh_blocks_to_create.size() == static_cast<size_t>(mesh_box_face));
+	ZN_TEST_ASSERT(L::all_x_equal(to_span(state.mesh_blocks_to_create), -2));
+	L::consume_outputs(state);
+
+	// Viewer is removed, everything it was viewing gets unloaded
+	update_data->viewers.clear();
+	L::run_update(data, update_data, streaming_dependency, meshing_dependency, viewers_data);
+
+	ZN_TEST_ASSERT(state.paired_viewers.size() == 0);
+	ZN_TEST_ASSERT(state.loading_blocks.size() == 0);
+	ZN_TEST_ASSERT(state.unloaded_data_blocks.size() == static_cast<size_t>(data_box_volume - data_box_face));
+	ZN_TEST_ASSERT(state.mesh_blocks.size() == 0);
+	ZN_TEST_ASSERT(state.mesh_blocks_to_unload.size() == static_cast<size_t>(mesh_box_volume));
+	ZN_TEST_ASSERT(!data->has_block(Vector3i(0, 0, 0), 0));
+	L::consume_outputs(state);
+}
+
+} // namespace zylann::voxel::tests
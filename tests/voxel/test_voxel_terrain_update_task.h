@@ -0,0 +1,10 @@
+#ifndef VOXEL_TEST_VOXEL_TERRAIN_UPDATE_TASK_H
+#define VOXEL_TEST_VOXEL_TERRAIN_UPDATE_TASK_H
+
+namespace zylann::voxel::tests {
+
+void test_voxel_terrain_update_task_moving_viewer();
+
+} // namespace zylann::voxel::tests
+
+#endif // VOXEL_TEST_VOXEL_TERRAIN_UPDATE_TASK_H
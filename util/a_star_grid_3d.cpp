@@ -8,6 +8,7 @@ namespace zylann {
 
 AStarGrid3D::AStarGrid3D() {
 	_open_list.sorter.compare.pool = &_points_pool;
+	update_fitting_offset();
 }
 
 void AStarGrid3D::set_region(Box3i region) {
@@ -17,6 +18,15 @@ void AStarGrid3D::set_region(Box3i region) {
 void AStarGrid3D::set_agent_size(Vector3f size) {
 	ZN_ASSERT_RETURN(math::is_valid_size(size));
 	_agent_size = size;
+	update_fitting_offset();
+}
+
+void AStarGrid3D::update_fitting_offset() {
+	_fitting_offset = Vector3f( //
+			(int(_agent_size.x) & 1) == 1 ? 0.5f : 0.f, //
+			(int(_agent_size.y) & 1) == 1 ? 0.5f : 0.f, //
+			(int(_agent_size.z) & 1) == 1 ? 0.5f : 0.f
+	);
 }
 
 void AStarGrid3D::set_max_fall_height(int h) {
@@ -40,12 +50,6 @@ void AStarGrid3D::start(Vector3i from_position, Vector3i target_position) {
 
 	_target_position = target_position;
 
-	_fitting_offset = Vector3f( //
-			(int(_agent_size.x) & 1) == 1 ? 0.5f : 0.f, //
-			(int(_agent_size.y) & 1) == 1 ? 0.5f : 0.f, //
-			(int(_agent_size.z) & 1) == 1 ? 0.5f : 0.f
-	);
-
 	if (!_region.contains(from_position)) {
 		return;
 	}
@@ -278,6 +282,14 @@ void AStarGrid3D::get_neighbor_positions(Vector3i pos, StdVector<Vector3i> &out_
 	}
 }
 
+void AStarGrid3D::get_reachable_neighbors(Vector3i pos, StdVector<Vector3i> &out_positions) {
+	get_neighbor_positions(pos, out_positions);
+}
+
+bool AStarGrid3D::is_passable(Vector3i pos) {
+	return _region.contains(pos) && fits(to_vec3f(pos) + Vector3f(0.5f) + _fitting_offset, _agent_size * 0.5f);
+}
+
 void AStarGrid3D::reconstruct_path(uint32_t end_point_index) {
 	ZN_PROFILE_SCOPE();
 
@@ -45,6 +45,12 @@ public:
 	void debug_get_visited_points(StdVector<Vector3i> &out_positions) const;
 	bool debug_get_next_step_point(Vector3i &out_pos) const;
 
+	// Gets positions an agent at `pos` can move to in one step, within the current region. This is what the search
+	// uses to expand points, exposed for algorithms built on top of it.
+	void get_reachable_neighbors(Vector3i pos, StdVector<Vector3i> &out_positions);
+	// Tests if the agent fits in the cell at `pos`, within the current region.
+	bool is_passable(Vector3i pos);
+
 protected:
 	virtual bool is_solid(Vector3i pos);
 
@@ -54,6 +60,7 @@ private:
 	void get_neighbor_positions(Vector3i pos, StdVector<Vector3i> &out_positions);
 	bool is_ground_close_enough(Vector3i pos);
 	bool fits(Vector3f pos, Vector3f agent_extents);
+	void update_fitting_offset();
 
 	struct Point {
 		static const uint32_t NO_CAME_FROM = std::numeric_limits<uint32_t>::max();
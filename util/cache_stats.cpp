@@ -0,0 +1,150 @@
+#include "cache_stats.h"
+#include "containers/container_funcs.h"
+#include "errors.h"
+#include "memory/memory.h"
+#include "profiling.h"
+#include "string/std_string.h"
+#include "thread/mutex.h"
+
+#include <cstring>
+
+namespace zylann {
+
+namespace {
+
+struct Group {
+	const char *name;
+	StdVector<const CacheStats *> instances;
+	// Counters of instances that were destroyed
+	CacheStats::Snapshot retired;
+#ifdef ZN_PROFILER_ENABLED
+	// Plot names must remain valid, so groups are never destroyed
+	StdString hit_rate_plot_name;
+	StdString entries_plot_name;
+	StdString memory_plot_name;
+	uint64_t plotted_hits = 0;
+	uint64_t plotted_misses = 0;
+#endif
+};
+
+struct Registry {
+	StdVector<UniquePtr<Group>> groups;
+	BinaryMutex mutex;
+
+	Group &get_or_create_group_no_lock(const char *name) {
+		for (UniquePtr<Group> &group : groups) {
+			if (group->name == name || std::strcmp(group->name, name) == 0) {
+				return *group;
+			}
+		}
+		groups.push_back(make_unique_instance<Group>());
+		Group &group = *groups.back();
+		group.name = name;
+		group.retired.name = name;
+#ifdef ZN_PROFILER_ENABLED
+		group.hit_rate_plot_name = StdString("Cache ") + name + " hit rate (%)";
+		group.entries_plot_name = StdString("Cache ") + name + " entries";
+		group.memory_plot_name = StdString("Cache ") + name + " memory";
+#endif
+		return group;
+	}
+
+	CacheStats::Snapshot get_snapshot_no_lock(const Group &group) const {
+		CacheStats::Snapshot snapshot = group.retired;
+		for (const CacheStats *instance : group.instances) {
+			snapshot.add(instance->get_snapshot());
+		}
+		return snapshot;
+	}
+};
+
+// Not a global variable, so caches can register during static initialization
+Registry &get_registry() {
+	static Registry s_registry;
+	return s_registry;
+}
+
+} // namespace
+
+void CacheStats::Snapshot::add(const Snapshot &other) {
+	instance_count += other.instance_count;
+	hits += other.hits;
+	misses += other.misses;
+	evictions += other.evictions;
+	entries += other.entries;
+	memory_usage += other.memory_usage;
+}
+
+float CacheStats::Snapshot::get_hit_rate() const {
+	const uint64_t lookups = hits + misses;
+	return lookups > 0 ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.f;
+}
+
+CacheStats::CacheStats(const char *name) : _name(name) {
+	ZN_ASSERT(name != nullptr);
+	Registry &registry = get_registry();
+	MutexLock mlock(registry.mutex);
+	registry.get_or_create_group_no_lock(name).instances.push_back(this);
+}
+
+CacheStats::~CacheStats() {
+	Registry &registry = get_registry();
+	MutexLock mlock(registry.mutex);
+	Group &group = registry.get_or_create_group_no_lock(_name);
+	Snapshot snapshot = get_snapshot();
+	// Sizes are current values, they don't add up over time
+	snapshot.instance_count = 0;
+	snapshot.entries = 0;
+	snapshot.memory_usage = 0;
+	group.retired.add(snapshot);
+	unordered_remove_value(group.instances, static_cast<const CacheStats *>(this));
+}
+
+unsigned int CacheStats::assign_thread_slot_index() {
+	// Threads get slots in turn, so up to `SLOT_COUNT` threads never share one
+	static std::atomic_uint32_t s_next_slot_index = { 0 };
+	return s_next_slot_index.fetch_add(1, std::memory_order_relaxed) % SLOT_COUNT;
+}
+
+CacheStats::Snapshot CacheStats::get_snapshot() const {
+	Snapshot snapshot;
+	snapshot.name = _name;
+	snapshot.instance_count = 1;
+	for (const Slot &slot : _slots) {
+		snapshot.hits += slot.hits.load(std::memory_order_relaxed);
+		snapshot.misses += slot.misses.load(std::memory_order_relaxed);
+		snapshot.evictions += slot.evictions.load(std::memory_order_relaxed);
+	}
+	snapshot.entries = _entries.load(std::memory_order_relaxed);
+	snapshot.memory_usage = _memory_usage.load(std::memory_order_relaxed);
+	return snapshot;
+}
+
+void CacheStats::get_all_snapshots(StdVector<Snapshot> &out_snapshots) {
+	Registry &registry = get_registry();
+	MutexLock mlock(registry.mutex);
+	for (const UniquePtr<Group> &group : registry.groups) {
+		out_snapshots.push_back(registry.get_snapshot_no_lock(*group));
+	}
+}
+
+void CacheStats::plot_all() {
+#ifdef ZN_PROFILER_ENABLED
+	Registry &registry = get_registry();
+	MutexLock mlock(registry.mutex);
+	for (UniquePtr<Group> &group : registry.groups) {
+		const Snapshot snapshot = registry.get_snapshot_no_lock(*group);
+		const uint64_t hits = snapshot.hits - group->plotted_hits;
+		const uint64_t misses = snapshot.misses - group->plotted_misses;
+		if (hits + misses > 0) {
+			ZN_PROFILE_PLOT(group->hit_rate_plot_name.c_str(), int64_t(hits * 100 / (hits + misses)));
+		}
+		group->plotted_hits = snapshot.hits;
+		group->plotted_misses = snapshot.misses;
+		ZN_PROFILE_PLOT(group->entries_plot_name.c_str(), snapshot.entries);
+		ZN_PROFILE_PLOT(group->memory_plot_name.c_str(), snapshot.memory_usage);
+	}
+#endif
+}
+
+} // namespace zylann
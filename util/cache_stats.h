@@ -0,0 +1,102 @@
+#ifndef ZN_CACHE_STATS_H
+#define ZN_CACHE_STATS_H
+
+#include "containers/fixed_array.h"
+#include "containers/std_vector.h"
+#include <atomic>
+#include <cstdint>
+
+namespace zylann {
+
+// Counters of a cache, so caches of different systems can all report how well they perform in the same way.
+// Instances register themselves under a name in a global registry, from which counters of all caches can be queried.
+// Several instances can use the same name (one per stream for example), in which case their counters are summed.
+// Counting is cheap: each thread increments counters in its own slot, so threads using the same cache don't keep
+// modifying the same cache line.
+class CacheStats {
+public:
+	struct Snapshot {
+		// Name the cache was registered with
+		const char *name = nullptr;
+		// Live instances registered with that name
+		unsigned int instance_count = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		// Current amount of entries and memory they use, if the cache reports them
+		int64_t entries = 0;
+		int64_t memory_usage = 0;
+
+		void add(const Snapshot &other);
+
+		// Proportion of lookups that were hits, between 0 and 1
+		float get_hit_rate() const;
+	};
+
+	// The name must be a static string
+	CacheStats(const char *name);
+	~CacheStats();
+
+	CacheStats(const CacheStats &) = delete;
+	CacheStats &operator=(const CacheStats &) = delete;
+
+	inline void add_hit() {
+		get_thread_slot().hits.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void add_miss() {
+		get_thread_slot().misses.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void add_hit_or_miss(bool hit) {
+		Slot &slot = get_thread_slot();
+		(hit ? slot.hits : slot.misses).fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void add_evictions(uint64_t count) {
+		get_thread_slot().evictions.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	inline void set_entries(int64_t count) {
+		_entries.store(count, std::memory_order_relaxed);
+	}
+
+	inline void set_memory_usage(int64_t bytes) {
+		_memory_usage.store(bytes, std::memory_order_relaxed);
+	}
+
+	// Counters are approximate while the cache is in use, they are meant for profiling
+	Snapshot get_snapshot() const;
+
+	// Gets counters of all registered caches, summed by name. Counters of instances that got destroyed are kept.
+	static void get_all_snapshots(StdVector<Snapshot> &out_snapshots);
+
+	// Sends hit rates since the previous call and sizes of all caches to the profiler
+	static void plot_all();
+
+private:
+	static const unsigned int SLOT_COUNT = 16;
+	static const unsigned int CACHE_LINE_SIZE = 64;
+
+	struct alignas(CACHE_LINE_SIZE) Slot {
+		std::atomic_uint64_t hits = { 0 };
+		std::atomic_uint64_t misses = { 0 };
+		std::atomic_uint64_t evictions = { 0 };
+	};
+
+	inline Slot &get_thread_slot() {
+		static thread_local unsigned int tls_slot_index = assign_thread_slot_index();
+		return _slots[tls_slot_index];
+	}
+
+	static unsigned int assign_thread_slot_index();
+
+	const char *_name;
+	FixedArray<Slot, SLOT_COUNT> _slots;
+	std::atomic_int64_t _entries = { 0 };
+	std::atomic_int64_t _memory_usage = { 0 };
+};
+
+} // namespace zylann
+
+#endif // ZN_CACHE_STATS_H
@@ -2,6 +2,7 @@
 #define ZN_DYNAMIC_BITSET_H
 
 #include "../errors.h"
+#include "../math/funcs.h"
 #include "std_vector.h"
 #include <cstdint>
 
@@ -57,7 +58,74 @@ public:
 		}
 	}
 
+	// Functions below process 64 bits at once
+
+	// Returns how many bits are set
+	unsigned int count() const {
+		if (_bits.size() == 0) {
+			return 0;
+		}
+		const unsigned int last_word_index = _bits.size() - 1;
+		unsigned int n = 0;
+		for (unsigned int i = 0; i < last_word_index; ++i) {
+			n += math::get_bit_count(_bits[i]);
+		}
+		// Padding bits are not counted
+		n += math::get_bit_count(_bits[last_word_index] & get_last_word_mask());
+		return n;
+	}
+
+	// Returns the index of the first set bit at or after `from`, or `size()` if there is none
+	unsigned int find_next_set(unsigned int from) const {
+		return find_next(from, 0);
+	}
+
+	// Returns the index of the first unset bit at or after `from`, or `size()` if there is none
+	unsigned int find_next_unset(unsigned int from) const {
+		return find_next(from, ~uint64_t(0));
+	}
+
+	// Both bitsets must have the same size
+	void bitwise_and(const DynamicBitset &other) {
+		ZN_ASSERT_RETURN(other._size == _size);
+		for (unsigned int i = 0; i < _bits.size(); ++i) {
+			_bits[i] &= other._bits[i];
+		}
+	}
+
+	// Both bitsets must have the same size
+	void bitwise_or(const DynamicBitset &other) {
+		ZN_ASSERT_RETURN(other._size == _size);
+		for (unsigned int i = 0; i < _bits.size(); ++i) {
+			_bits[i] |= other._bits[i];
+		}
+	}
+
 private:
+	inline uint64_t get_last_word_mask() const {
+		const unsigned int used_bits = _size & 63;
+		return used_bits == 0 ? ~uint64_t(0) : (uint64_t(1) << used_bits) - 1;
+	}
+
+	// Searches bits that are set after being XORed with `flip`
+	unsigned int find_next(unsigned int from, uint64_t flip) const {
+		if (from >= _size) {
+			return _size;
+		}
+		unsigned int word_index = from >> 6;
+		// Ignore bits before `from`
+		uint64_t word = (_bits[word_index] ^ flip) & (~uint64_t(0) << (from & 63));
+		while (word == 0) {
+			++word_index;
+			if (word_index == _bits.size()) {
+				return _size;
+			}
+			word = _bits[word_index] ^ flip;
+		}
+		// Padding bits can be found in the last word
+		return math::min((word_index << 6) + math::get_lowest_bit_index(word), _size);
+	}
+
 	StdVector<uint64_t> _bits;
 	unsigned int _size = 0;
 };
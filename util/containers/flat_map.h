@@ -211,10 +211,13 @@ private:
 // 	}
 // }
 
-// Specialization of FlatMap where `T` is not copyable, only movable
+// Specialization of FlatMap where `T` is not copyable, only movable.
+// Keys and values are stored in separate arrays: searches only go through keys, which are packed together and take
+// fewer cache lines than if they were interleaved with values.
 template <typename K, typename T, typename KComp = FlatMapDefaultComparator<K>>
 class FlatMapMoveOnly {
 public:
+	// Used to initialize the map with many items at once
 	struct Pair {
 		K key;
 		T value;
@@ -224,11 +227,6 @@ public:
 			return KComp::less_than(key, other.key);
 		}
 
-		// For std::lower_bound
-		inline bool operator<(const K &other_key) const {
-			return KComp::less_than(key, other_key);
-		}
-
 		Pair() {}
 
 		Pair(const K &p_key, T &&p_value) {
@@ -250,145 +248,179 @@ public:
 	// If the key already exists, the item is not inserted and returns false.
 	// If insertion was successful, returns true.
 	bool insert(K key, T &&value) {
-		typename StdVector<Pair>::const_iterator it = std::lower_bound(_items.begin(), _items.end(), key);
-		if (it != _items.end() && it->key == key) {
+		const size_t i = lower_bound_index(key);
+		if (i < _keys.size() && _keys[i] == key) {
 			// Item already exists
 			return false;
 		}
-		_items.insert(it, std::move(Pair(key, std::move(value))));
+		_keys.insert(_keys.begin() + i, key);
+		_values.insert(_values.begin() + i, std::move(value));
 		return true;
 	}
 
 	// If the key already exists, the item will replace the previous value.
 	T &insert_or_assign(K key, T &&value) {
-		typename StdVector<Pair>::iterator it = std::lower_bound(_items.begin(), _items.end(), key);
-		if (it != _items.end() && it->key == key) {
+		const size_t i = lower_bound_index(key);
+		if (i < _keys.size() && _keys[i] == key) {
 			// Item already exists, assign it
-			it->value = std::move(value);
+			_values[i] = std::move(value);
 		} else {
 			// Item doesnt exist, insert it
-			it = _items.insert(it, std::move(Pair(key, std::move(value))));
+			_keys.insert(_keys.begin() + i, key);
+			_values.insert(_values.begin() + i, std::move(value));
 		}
-		return it->value;
+		return _values[i];
 	}
 
 	// Initialize from a collection if items.
-	// Faster than doing individual insertion of each item.
+	// Faster than doing individual insertion of each item. Items are moved out of the given span.
 	void clear_and_insert(Span<Pair> pairs) {
 		clear();
-		_items.resize(pairs.size());
+		std::sort(pairs.data(), pairs.data() + pairs.size());
+		_keys.reserve(pairs.size());
+		_values.reserve(pairs.size());
 		for (size_t i = 0; i < pairs.size(); ++i) {
-			_items[i] = std::move(pairs[i]);
+			_keys.push_back(pairs[i].key);
+			_values.push_back(std::move(pairs[i].value));
 		}
-		std::sort(_items.begin(), _items.end());
 	}
 
 	const T *find(K key) const {
-		typename StdVector<Pair>::const_iterator it = std::lower_bound(_items.begin(), _items.end(), key);
-		if (it != _items.end() && it->key == key) {
-			return &it->value;
+		const size_t i = lower_bound_index(key);
+		if (i < _keys.size() && _keys[i] == key) {
+			return &_values[i];
 		}
 		return nullptr;
 	}
 
 	T *find(K key) {
-		typename StdVector<Pair>::iterator it = std::lower_bound(_items.begin(), _items.end(), key);
-		if (it != _items.end() && it->key == key) {
-			return &it->value;
+		const size_t i = lower_bound_index(key);
+		if (i < _keys.size() && _keys[i] == key) {
+			return &_values[i];
 		}
 		return nullptr;
 	}
 
 	bool has(K key) const {
-		// Using std::binary_search is very annoying.
-		// First, we don't want to pass a Pair because it would require constructing a T.
-		// Using just the key as the "value" to search doesn't compile because Pair only has comparison with K as second
-		// argument.
-		// Specifying a comparison lambda is also not viable because both arguments need to be convertible to K.
-		// Making it work would require passing a struct with two operators() with arguments in both orders...
-		// return std::binary_search(_items.cbegin(), _items.cend(), key);
-
-		typename StdVector<Pair>::const_iterator it = std::lower_bound(_items.begin(), _items.end(), key);
-		return it != _items.end() && it->key == key;
+		const size_t i = lower_bound_index(key);
+		return i < _keys.size() && _keys[i] == key;
 	}
 
 	bool erase(K key) {
-		typename StdVector<Pair>::iterator it = std::lower_bound(_items.begin(), _items.end(), key);
-		if (it != _items.end() && it->key == key) {
-			_items.erase(it);
+		const size_t i = lower_bound_index(key);
+		if (i < _keys.size() && _keys[i] == key) {
+			_keys.erase(_keys.begin() + i);
+			_values.erase(_values.begin() + i);
 			return true;
 		}
 		return false;
 	}
 
+	// Gets the index of the first item whose key is not less than `key`, searching from index `begin`.
+	// Returns `size()` if there is no such item.
+	inline size_t lower_bound_index(K key, size_t begin = 0) const {
+		return std::lower_bound(_keys.begin() + begin, _keys.end(), key, KComp::less_than) - _keys.begin();
+	}
+
+	inline const K &get_key(size_t i) const {
+		return _keys[i];
+	}
+
+	inline const T &get_value(size_t i) const {
+		return _values[i];
+	}
+
+	inline Span<const K> get_keys() const {
+		return to_span(_keys);
+	}
+
 	inline size_t size() const {
-		return _items.size();
+		return _keys.size();
 	}
 
 	void clear() {
-		_items.clear();
+		_keys.clear();
+		_values.clear();
 	}
 
-	// `bool predicate(FlatMap<K, T>::Pair)`
+	// `bool predicate(const K &key, const T &value)`
 	template <typename F>
 	inline void remove_if(F predicate) {
-		_items.erase(std::remove_if(_items.begin(), _items.end(), predicate), _items.end());
-	}
-
-	void operator=(const FlatMap<K, T> &other) {
-		_items = other._items;
+		size_t dst = 0;
+		for (size_t src = 0; src < _keys.size(); ++src) {
+			if (predicate(static_cast<const K &>(_keys[src]), static_cast<const T &>(_values[src]))) {
+				continue;
+			}
+			if (dst != src) {
+				_keys[dst] = _keys[src];
+				_values[dst] = std::move(_values[src]);
+			}
+			++dst;
+		}
+		_keys.erase(_keys.begin() + dst, _keys.end());
+		_values.erase(_values.begin() + dst, _values.end());
 	}
 
-	bool operator==(const FlatMap<K, T> &other) const {
-		return _items == other._items;
-	}
+	struct ConstPairRef {
+		const K &key;
+		const T &value;
+	};
 
 	class ConstIterator {
 	public:
-		ConstIterator(const Pair *p) : _current(p) {}
+		// Allows using `->` on an iterator, even though there is no pair stored anywhere to point to
+		struct ArrowProxy {
+			ConstPairRef ref;
 
-		inline const Pair &operator*() {
+			inline const ConstPairRef *operator->() const {
+				return &ref;
+			}
+		};
+
+		ConstIterator(const FlatMapMoveOnly *map, size_t i) : _map(map), _index(i) {}
+
+		inline ConstPairRef operator*() const {
 #ifdef DEBUG_ENABLED
-			ZN_ASSERT(_current != nullptr);
+			ZN_ASSERT(_index < _map->size());
 #endif
-			return *_current;
+			return ConstPairRef{ _map->_keys[_index], _map->_values[_index] };
 		}
 
-		inline const Pair *operator->() {
-#ifdef DEBUG_ENABLED
-			ZN_ASSERT(_current != nullptr);
-#endif
-			return _current;
+		inline ArrowProxy operator->() const {
+			return ArrowProxy{ **this };
 		}
 
 		inline ConstIterator &operator++() {
-			++_current;
+			++_index;
 			return *this;
 		}
 
 		inline bool operator==(const ConstIterator other) const {
-			return _current == other._current;
+			return _index == other._index;
 		}
 
 		inline bool operator!=(const ConstIterator other) const {
-			return _current != other._current;
+			return _index != other._index;
 		}
 
 	private:
-		const Pair *_current;
+		const FlatMapMoveOnly *_map;
+		size_t _index;
 	};
 
 	inline ConstIterator begin() const {
-		return ConstIterator(_items.empty() ? nullptr : &_items[0]);
+		return ConstIterator(this, 0);
 	}
 
 	inline ConstIterator end() const {
-		return ConstIterator(_items.empty() ? nullptr : (&_items[0] + _items.size()));
+		return ConstIterator(this, _keys.size());
 	}
 
 private:
-	// Sorted by key
-	StdVector<Pair> _items;
+	// Sorted
+	StdVector<K> _keys;
+	// In the same order as keys
+	StdVector<T> _values;
 };
 
 } // namespace zylann
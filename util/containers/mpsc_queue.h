@@ -0,0 +1,118 @@
+#ifndef ZN_MPSC_QUEUE_H
+#define ZN_MPSC_QUEUE_H
+
+#include "../errors.h"
+#include "../memory/memory.h"
+#include "span.h"
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+namespace zylann {
+
+// Queue that many threads can push items into without locking, from which items are taken all at once.
+// Items are pushed in batches, each allocated in one piece and linked into a list with a compare-and-swap. Consumers
+// detach the whole list with a single exchange, so there can be more than one of them too, each getting different
+// items. Order is preserved within batches, and between batches pushed by the same thread.
+template <typename T>
+class MPSCQueue {
+public:
+	static_assert(std::is_trivially_copyable_v<T>, "Items are copied into raw memory");
+
+	MPSCQueue() {}
+
+	MPSCQueue(const MPSCQueue &) = delete;
+	MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+	~MPSCQueue() {
+		free_batches(_head.exchange(nullptr, std::memory_order_acquire));
+	}
+
+	void push(const T &item) {
+		push_n(1, [&item](unsigned int i) { return item; });
+	}
+
+	void push(Span<const T> items) {
+		push_n(items.size(), [&items](unsigned int i) { return items[i]; });
+	}
+
+	// Pushes `count` items obtained from `get_item(index)` as a single batch
+	template <typename F>
+	void push_n(unsigned int count, F get_item) {
+		if (count == 0) {
+			return;
+		}
+		Batch *batch = static_cast<Batch *>(ZN_ALLOC(sizeof(Batch) + count * sizeof(T)));
+		ZN_ASSERT(batch != nullptr);
+		batch->count = count;
+		T *items = batch->get_items();
+		for (unsigned int i = 0; i < count; ++i) {
+			new (items + i) T(get_item(i));
+		}
+
+		batch->next = _head.load(std::memory_order_relaxed);
+		while (!_head.compare_exchange_weak(batch->next, batch, std::memory_order_release, std::memory_order_relaxed)) {
+		}
+	}
+
+	// Takes all items currently in the queue, and calls `f(item)` on each of them in the order they were pushed.
+	// Returns how many items were taken.
+	template <typename F>
+	unsigned int pop_all(F f) {
+		Batch *batch = _head.exchange(nullptr, std::memory_order_acquire);
+		if (batch == nullptr) {
+			return 0;
+		}
+
+		// The list goes from the last pushed batch to the first, reverse it
+		Batch *first = nullptr;
+		while (batch != nullptr) {
+			Batch *next = batch->next;
+			batch->next = first;
+			first = batch;
+			batch = next;
+		}
+
+		unsigned int count = 0;
+		for (batch = first; batch != nullptr; batch = batch->next) {
+			const T *items = batch->get_items();
+			for (unsigned int i = 0; i < batch->count; ++i) {
+				f(items[i]);
+			}
+			count += batch->count;
+		}
+
+		free_batches(first);
+		return count;
+	}
+
+	// May be outdated as soon as it returns if other threads use the queue
+	bool is_empty() const {
+		return _head.load(std::memory_order_relaxed) == nullptr;
+	}
+
+private:
+	// Aligned so items placed after it are aligned too
+	struct alignas(alignof(T) > alignof(void *) ? alignof(T) : alignof(void *)) Batch {
+		Batch *next;
+		unsigned int count;
+
+		inline T *get_items() {
+			return reinterpret_cast<T *>(this + 1);
+		}
+	};
+
+	static void free_batches(Batch *batch) {
+		while (batch != nullptr) {
+			Batch *next = batch->next;
+			ZN_FREE(batch);
+			batch = next;
+		}
+	}
+
+	std::atomic<Batch *> _head = { nullptr };
+};
+
+} // namespace zylann
+
+#endif // ZN_MPSC_QUEUE_H
@@ -0,0 +1,312 @@
+#ifndef ZN_VECTOR3I_HASH_MAP_H
+#define ZN_VECTOR3I_HASH_MAP_H
+
+#include "../errors.h"
+#include "../hash_funcs.h"
+#include "../math/funcs.h"
+#include "../math/vector3i.h"
+#include "../memory/memory.h"
+#include "fixed_array.h"
+#include "std_vector.h"
+#include <cstdint>
+
+namespace zylann {
+
+// Hashmap specialized for 3D integer coordinates, such as block positions.
+// Uses open addressing with Robin Hood probing over a flat table and multiplicative hashing, so lookups touch very few
+// cache lines. Values are stored separately in fixed-size chunks, so pointers to values remain valid when inserting or
+// removing other elements (only the table gets reallocated when growing). Iteration goes through chunks linearly.
+template <typename TValue>
+class Vector3iHashMap {
+public:
+	Vector3iHashMap() {}
+
+	Vector3iHashMap(Vector3iHashMap &&other) {
+		move_from(other);
+	}
+
+	Vector3iHashMap &operator=(Vector3iHashMap &&other) {
+		if (this != &other) {
+			clear_chunks();
+			move_from(other);
+		}
+		return *this;
+	}
+
+	Vector3iHashMap(const Vector3iHashMap &) = delete;
+	Vector3iHashMap &operator=(const Vector3iHashMap &) = delete;
+
+	~Vector3iHashMap() {
+		clear_chunks();
+	}
+
+	TValue *find(const Vector3i key) {
+		const uint32_t i = find_slot(key);
+		if (i == NO_SLOT) {
+			return nullptr;
+		}
+		return &get_value(_slots[i].value_index);
+	}
+
+	const TValue *find(const Vector3i key) const {
+		const uint32_t i = find_slot(key);
+		if (i == NO_SLOT) {
+			return nullptr;
+		}
+		return &get_value(_slots[i].value_index);
+	}
+
+	inline bool has(const Vector3i key) const {
+		return find_slot(key) != NO_SLOT;
+	}
+
+	// Gets the value associated to a key, inserting a default-constructed one if it doesn't exist
+	TValue &get_or_insert(const Vector3i key) {
+		const uint32_t i = find_slot(key);
+		if (i != NO_SLOT) {
+			return get_value(_slots[i].value_index);
+		}
+		return get_value(insert_new(key));
+	}
+
+	inline TValue &operator[](const Vector3i key) {
+		return get_or_insert(key);
+	}
+
+	// Removes the value associated to a key. Returns false if no value was found.
+	bool erase(const Vector3i key) {
+		uint32_t i = find_slot(key);
+		if (i == NO_SLOT) {
+			return false;
+		}
+
+		release_value(_slots[i].value_index);
+
+		// Backward-shift deletion: move following elements of the cluster one step closer to their ideal slot, so
+		// we don't need tombstones
+		const uint32_t mask = _slots.size() - 1;
+		uint32_t next = (i + 1) & mask;
+		while (_slots[next].distance > 1) {
+			_slots[i] = _slots[next];
+			--_slots[i].distance;
+			i = next;
+			next = (next + 1) & mask;
+		}
+		_slots[i].distance = 0;
+
+		--_count;
+		return true;
+	}
+
+	void clear() {
+		clear_chunks();
+		_slots.clear();
+		_free_value_indices.clear();
+		_value_count = 0;
+		_count = 0;
+	}
+
+	inline unsigned int size() const {
+		return _count;
+	}
+
+	inline bool is_empty() const {
+		return _count == 0;
+	}
+
+	// f(Vector3i key, TValue &value)
+	template <typename F>
+	void for_each(F f) {
+		for (Chunk *chunk : _chunks) {
+			uint64_t used = chunk->used_mask;
+			while (used != 0) {
+				const unsigned int i = math::get_lowest_bit_index(used);
+				f(chunk->keys[i], chunk->values[i]);
+				used &= used - 1;
+			}
+		}
+	}
+
+	// f(Vector3i key, const TValue &value)
+	template <typename F>
+	void for_each(F f) const {
+		for (const Chunk *chunk : _chunks) {
+			uint64_t used = chunk->used_mask;
+			while (used != 0) {
+				const unsigned int i = math::get_lowest_bit_index(used);
+				f(chunk->keys[i], static_cast<const TValue &>(chunk->values[i]));
+				used &= used - 1;
+			}
+		}
+	}
+
+	static inline uint64_t get_hash(const Vector3i key) {
+		// The table index is taken from the upper bits, which depend on all bits of all coordinates, so neighboring
+		// positions get spread out.
+		return hash_coordinates_3d_64(key.x, key.y, key.z);
+	}
+
+private:
+	static const uint32_t NO_SLOT = 0xffffffff;
+	static const unsigned int CHUNK_SIZE = 64;
+	static const unsigned int MIN_SLOT_COUNT = 64;
+
+	struct Slot {
+		Vector3i key;
+		uint32_t value_index;
+		// 0 means the slot is empty. Otherwise, the distance to the ideal slot of the key, plus one.
+		uint32_t distance = 0;
+	};
+
+	struct Chunk {
+		FixedArray<TValue, CHUNK_SIZE> values;
+		FixedArray<Vector3i, CHUNK_SIZE> keys;
+		// Which values are in use
+		uint64_t used_mask = 0;
+	};
+
+	inline uint32_t get_slot_index(const Vector3i key) const {
+		return get_hash(key) >> _hash_shift;
+	}
+
+	uint32_t find_slot(const Vector3i key) const {
+		if (_count == 0) {
+			return NO_SLOT;
+		}
+		const uint32_t mask = _slots.size() - 1;
+		uint32_t i = get_slot_index(key);
+		uint32_t distance = 1;
+		while (true) {
+			const Slot &slot = _slots[i];
+			// With Robin Hood probing, the key can't be further than an element closer to its own ideal slot
+			if (slot.distance < distance) {
+				return NO_SLOT;
+			}
+			if (slot.key == key) {
+				return i;
+			}
+			i = (i + 1) & mask;
+			++distance;
+		}
+	}
+
+	// Inserts a key known to be absent. Returns the index of its value.
+	uint32_t insert_new(const Vector3i key) {
+		// Keep load factor below 3/4
+		if ((_count + 1) * 4 > _slots.size() * 3) {
+			grow();
+		}
+		const uint32_t value_index = allocate_value(key);
+		insert_slot(key, value_index);
+		++_count;
+		return value_index;
+	}
+
+	void insert_slot(Vector3i key, uint32_t value_index) {
+		const uint32_t mask = _slots.size() - 1;
+		uint32_t i = get_slot_index(key);
+		Slot incoming;
+		incoming.key = key;
+		incoming.value_index = value_index;
+		incoming.distance = 1;
+		while (true) {
+			Slot &slot = _slots[i];
+			if (slot.distance == 0) {
+				slot = incoming;
+				return;
+			}
+			if (slot.distance < incoming.distance) {
+				// Take from the rich: the existing element is closer to its ideal slot, so it moves instead
+				std::swap(slot, incoming);
+			}
+			i = (i + 1) & mask;
+			++incoming.distance;
+		}
+	}
+
+	void grow() {
+		StdVector<Slot> old_slots;
+		old_slots.swap(_slots);
+		_slots.resize(old_slots.size() == 0 ? MIN_SLOT_COUNT : old_slots.size() * 2);
+		_hash_shift = 64 - math::get_shift_from_power_of_two_32(_slots.size());
+		for (const Slot &slot : old_slots) {
+			if (slot.distance != 0) {
+				insert_slot(slot.key, slot.value_index);
+			}
+		}
+	}
+
+	inline TValue &get_value(uint32_t value_index) {
+		return _chunks[value_index / CHUNK_SIZE]->values[value_index % CHUNK_SIZE];
+	}
+
+	inline const TValue &get_value(uint32_t value_index) const {
+		return _chunks[value_index / CHUNK_SIZE]->values[value_index % CHUNK_SIZE];
+	}
+
+	uint32_t allocate_value(const Vector3i key) {
+		uint32_t value_index;
+		if (_free_value_indices.size() > 0) {
+			value_index = _free_value_indices.back();
+			_free_value_indices.pop_back();
+		} else {
+			value_index = _value_count;
+			++_value_count;
+			if (value_index / CHUNK_SIZE == _chunks.size()) {
+				_chunks.push_back(ZN_NEW(Chunk));
+			}
+		}
+		Chunk &chunk = *_chunks[value_index / CHUNK_SIZE];
+		const unsigned int i = value_index % CHUNK_SIZE;
+		chunk.keys[i] = key;
+		chunk.used_mask |= (uint64_t(1) << i);
+		return value_index;
+	}
+
+	void release_value(uint32_t value_index) {
+		Chunk &chunk = *_chunks[value_index / CHUNK_SIZE];
+		const unsigned int i = value_index % CHUNK_SIZE;
+#ifdef DEBUG_ENABLED
+		ZN_ASSERT((chunk.used_mask & (uint64_t(1) << i)) != 0);
+#endif
+		// Reset so resources held by the value get released now rather than when the slot is reused
+		chunk.values[i] = TValue();
+		chunk.used_mask &= ~(uint64_t(1) << i);
+		_free_value_indices.push_back(value_index);
+	}
+
+	void clear_chunks() {
+		for (Chunk *chunk : _chunks) {
+			ZN_DELETE(chunk);
+		}
+		_chunks.clear();
+	}
+
+	void move_from(Vector3iHashMap &other) {
+		_slots = std::move(other._slots);
+		_chunks = std::move(other._chunks);
+		_free_value_indices = std::move(other._free_value_indices);
+		_value_count = other._value_count;
+		_count = other._count;
+		_hash_shift = other._hash_shift;
+		other._slots.clear();
+		other._chunks.clear();
+		other._free_value_indices.clear();
+		other._value_count = 0;
+		other._count = 0;
+	}
+
+	StdVector<Slot> _slots;
+	StdVector<Chunk *> _chunks;
+	StdVector<uint32_t> _free_value_indices;
+	// How many value slots have been handed out in chunks, including freed ones
+	uint32_t _value_count = 0;
+	// How many elements are in the map
+	uint32_t _count = 0;
+	// Shift applied to hashes to obtain a slot index, such that only upper bits are used
+	uint32_t _hash_shift = 64;
+};
+
+} // namespace zylann
+
+#endif // ZN_VECTOR3I_HASH_MAP_H
@@ -0,0 +1,298 @@
+#ifndef ZN_VECTOR3I_SPARSE_GRID_H
+#define ZN_VECTOR3I_SPARSE_GRID_H
+
+#include "../errors.h"
+#include "../math/box3i.h"
+#include "../math/vector3i.h"
+#include "../memory/memory.h"
+#include "fixed_array.h"
+#include "std_vector.h"
+#include "vector3i_hash_map.h"
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace zylann {
+
+// Sparse grid specialized for 3D integer coordinates, such as block positions.
+// Cells are grouped in pages of 4x4x4, which are only allocated when they contain at least one element. Pages are
+// found with a hashmap, so a lookup costs one hash of the page position followed by an index within the page. Cells of
+// the same page are contiguous in memory, so neighbor lookups and iterating over areas touch few cache lines, and
+// iterating all elements goes through pages linearly.
+// Elements are constructed in place and never move, so pointers to them remain valid until they are removed, and they
+// don't need to be copyable or movable.
+// The API follows `std::unordered_map`, so it can replace it in code using iterators.
+template <typename T>
+class Vector3iSparseGrid {
+public:
+	static constexpr unsigned int PAGE_SIZE_PO2 = 2;
+	static constexpr int PAGE_SIZE = 1 << PAGE_SIZE_PO2;
+	// Occupancy of a page must fit in 64 bits
+	static constexpr unsigned int PAGE_CELL_COUNT = PAGE_SIZE * PAGE_SIZE * PAGE_SIZE;
+
+	struct Item {
+		const Vector3i first;
+		T second;
+
+		Item(const Vector3i key) : first(key), second() {}
+	};
+
+private:
+	struct Page {
+		struct alignas(Item) Cell {
+			uint8_t data[sizeof(Item)];
+		};
+
+		FixedArray<Cell, PAGE_CELL_COUNT> cells;
+		// Which cells contain an element
+		uint64_t used_mask = 0;
+		// Position of the page, in pages
+		Vector3i position;
+		// Index of the page within `_pages`
+		uint32_t index;
+
+		inline Item &get_item(unsigned int i) {
+			return *std::launder(reinterpret_cast<Item *>(&cells[i]));
+		}
+	};
+
+public:
+	template <typename TItem, typename TPages>
+	class IteratorBase {
+	public:
+		IteratorBase(TPages *pages, uint32_t page_index, unsigned int cell_index) :
+				_pages(pages), _page_index(page_index), _cell_index(cell_index) {}
+
+		inline TItem &operator*() const {
+			return (*_pages)[_page_index]->get_item(_cell_index);
+		}
+
+		inline TItem *operator->() const {
+			return &(*_pages)[_page_index]->get_item(_cell_index);
+		}
+
+		IteratorBase &operator++() {
+			// Look for the next element in the same page, then move to the next page. Pages are never empty.
+			const uint64_t next_mask = (*_pages)[_page_index]->used_mask & ~((uint64_t(2) << _cell_index) - 1);
+			if (next_mask != 0) {
+				_cell_index = math::get_lowest_bit_index(next_mask);
+			} else {
+				++_page_index;
+				_cell_index = _page_index < _pages->size() ? get_first_cell_index(*(*_pages)[_page_index]) : 0;
+			}
+			return *this;
+		}
+
+		inline bool operator==(const IteratorBase &other) const {
+			return _page_index == other._page_index && _cell_index == other._cell_index;
+		}
+
+		inline bool operator!=(const IteratorBase &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		friend class Vector3iSparseGrid;
+
+		TPages *_pages;
+		uint32_t _page_index;
+		unsigned int _cell_index;
+	};
+
+	using Iterator = IteratorBase<Item, StdVector<Page *>>;
+	using ConstIterator = IteratorBase<const Item, const StdVector<Page *>>;
+
+	Vector3iSparseGrid() {}
+
+	Vector3iSparseGrid(const Vector3iSparseGrid &) = delete;
+	Vector3iSparseGrid &operator=(const Vector3iSparseGrid &) = delete;
+
+	~Vector3iSparseGrid() {
+		clear();
+	}
+
+	Iterator find(const Vector3i key) {
+		const Page *page = get_page(key);
+		if (page != nullptr) {
+			const unsigned int cell_index = get_cell_index(key);
+			if ((page->used_mask & (uint64_t(1) << cell_index)) != 0) {
+				return Iterator(&_pages, page->index, cell_index);
+			}
+		}
+		return end();
+	}
+
+	ConstIterator find(const Vector3i key) const {
+		const Page *page = get_page(key);
+		if (page != nullptr) {
+			const unsigned int cell_index = get_cell_index(key);
+			if ((page->used_mask & (uint64_t(1) << cell_index)) != 0) {
+				return ConstIterator(&_pages, page->index, cell_index);
+			}
+		}
+		return end();
+	}
+
+	inline bool has(const Vector3i key) const {
+		const Page *page = get_page(key);
+		return page != nullptr && (page->used_mask & (uint64_t(1) << get_cell_index(key))) != 0;
+	}
+
+	// Gets the value associated to a key, inserting a default-constructed one if it doesn't exist
+	T &operator[](const Vector3i key) {
+		Page *page = get_page(key);
+		if (page == nullptr) {
+			page = create_page(key >> PAGE_SIZE_PO2);
+		}
+		const unsigned int cell_index = get_cell_index(key);
+		const uint64_t bit = uint64_t(1) << cell_index;
+		if ((page->used_mask & bit) == 0) {
+			::new (&page->cells[cell_index]) Item(key);
+			page->used_mask |= bit;
+			++_count;
+		}
+		return page->get_item(cell_index).second;
+	}
+
+	// Removes the value associated to a key. Returns how many values were removed (0 or 1).
+	unsigned int erase(const Vector3i key) {
+		Page *page = get_page(key);
+		if (page == nullptr) {
+			return 0;
+		}
+		const unsigned int cell_index = get_cell_index(key);
+		if ((page->used_mask & (uint64_t(1) << cell_index)) == 0) {
+			return 0;
+		}
+		erase_cell(*page, cell_index);
+		return 1;
+	}
+
+	// Removes the value pointed by an iterator. Iterators to other elements may be invalidated.
+	void erase(Iterator it) {
+		ZN_ASSERT_RETURN(it._page_index < _pages.size());
+		Page &page = *_pages[it._page_index];
+		ZN_ASSERT_RETURN((page.used_mask & (uint64_t(1) << it._cell_index)) != 0);
+		erase_cell(page, it._cell_index);
+	}
+
+	void clear() {
+		for (Page *page : _pages) {
+			uint64_t used = page->used_mask;
+			while (used != 0) {
+				std::destroy_at(&page->get_item(math::get_lowest_bit_index(used)));
+				used &= used - 1;
+			}
+			ZN_DELETE(page);
+		}
+		_pages.clear();
+		_page_map.clear();
+		_count = 0;
+	}
+
+	inline unsigned int size() const {
+		return _count;
+	}
+
+	inline bool empty() const {
+		return _count == 0;
+	}
+
+	Iterator begin() {
+		return Iterator(&_pages, 0, _pages.size() > 0 ? get_first_cell_index(*_pages[0]) : 0);
+	}
+
+	Iterator end() {
+		return Iterator(&_pages, _pages.size(), 0);
+	}
+
+	ConstIterator begin() const {
+		return ConstIterator(&_pages, 0, _pages.size() > 0 ? get_first_cell_index(*_pages[0]) : 0);
+	}
+
+	ConstIterator end() const {
+		return ConstIterator(&_pages, _pages.size(), 0);
+	}
+
+	// Executes a function on all elements whose key is inside the given box. Pages are visited one by one, so this is
+	// faster than looking up every cell of the box when it is large or sparsely populated.
+	// f(Item &item)
+	template <typename F>
+	void for_each_in_box(const Box3i box, F f) {
+		const Box3i pages_box = box.downscaled(PAGE_SIZE);
+		const Vector3i box_end = box.position + box.size;
+		pages_box.for_each_cell_zxy([this, &box, &box_end, &f](const Vector3i page_position) {
+			Page *const *page_ptr = _page_map.find(page_position);
+			if (page_ptr == nullptr) {
+				return;
+			}
+			Page &page = **page_ptr;
+			// Only go through cells of the page that are inside the box
+			const Vector3i page_origin = page_position * PAGE_SIZE;
+			const Vector3i min_pos = math::max(box.position - page_origin, Vector3i());
+			const Vector3i max_pos = math::min(box_end - page_origin, Vector3iUtil::create(PAGE_SIZE));
+			Vector3i pos;
+			for (pos.z = min_pos.z; pos.z < max_pos.z; ++pos.z) {
+				for (pos.x = min_pos.x; pos.x < max_pos.x; ++pos.x) {
+					for (pos.y = min_pos.y; pos.y < max_pos.y; ++pos.y) {
+						const unsigned int cell_index = get_cell_index(pos);
+						if ((page.used_mask & (uint64_t(1) << cell_index)) != 0) {
+							f(page.get_item(cell_index));
+						}
+					}
+				}
+			}
+		});
+	}
+
+private:
+	static inline unsigned int get_cell_index(const Vector3i key) {
+		const unsigned int mask = PAGE_SIZE - 1;
+		return (key.y & mask) | ((key.x & mask) << PAGE_SIZE_PO2) | ((key.z & mask) << (2 * PAGE_SIZE_PO2));
+	}
+
+	static inline unsigned int get_first_cell_index(const Page &page) {
+		return math::get_lowest_bit_index(page.used_mask);
+	}
+
+	inline Page *get_page(const Vector3i key) const {
+		Page *const *page_ptr = _page_map.find(key >> PAGE_SIZE_PO2);
+		return page_ptr != nullptr ? *page_ptr : nullptr;
+	}
+
+	Page *create_page(const Vector3i page_position) {
+		Page *page = ZN_NEW(Page);
+		page->position = page_position;
+		page->index = _pages.size();
+		_pages.push_back(page);
+		_page_map[page_position] = page;
+		return page;
+	}
+
+	void erase_cell(Page &page, unsigned int cell_index) {
+		std::destroy_at(&page.get_item(cell_index));
+		page.used_mask &= ~(uint64_t(1) << cell_index);
+		--_count;
+
+		if (page.used_mask == 0) {
+			// Free empty pages, so memory doesn't grow as elements get added and removed in different areas
+			const uint32_t index = page.index;
+			_page_map.erase(page.position);
+			Page *last_page = _pages.back();
+			_pages[index] = last_page;
+			last_page->index = index;
+			_pages.pop_back();
+			ZN_DELETE(&page);
+		}
+	}
+
+	Vector3iHashMap<Page *> _page_map;
+	// Pages are also stored in a vector for faster iteration
+	StdVector<Page *> _pages;
+	// How many elements are in the grid
+	unsigned int _count = 0;
+};
+
+} // namespace zylann
+
+#endif // ZN_VECTOR3I_SPARSE_GRID_H
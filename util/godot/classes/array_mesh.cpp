@@ -1,11 +1,412 @@
 #include "array_mesh.h"
 #include "../../containers/std_map.h"
 #include "../../containers/std_unordered_map.h"
+#include "../../containers/fixed_array.h"
 #include "../../containers/std_vector.h"
+#include "../../io/log.h"
+#include "../../math/funcs.h"
+#include "../../profiling.h"
+#include "../../string/format.h"
+#include "../../thread/mutex.h"
 #include "../core/packed_arrays.h"
+#include "../core/version.h"
+#include "rendering_server.h"
+#include <cstring>
 
 namespace zylann::godot {
 
+// Godot 4.1 lays out surface data differently, and GodotCpp doesn't expose what is needed to bypass the generic
+// encoder
+#if defined(ZN_GODOT) && !(GODOT_VERSION_MAJOR == 4 && GODOT_VERSION_MINOR <= 1)
+#define ZN_GODOT_DIRECT_SURFACE_ENCODING
+#endif
+
+#ifdef ZN_GODOT_DIRECT_SURFACE_ENCODING
+
+namespace {
+
+struct SurfaceLayout {
+	unsigned int vertex_count = 0;
+	unsigned int index_count = 0;
+	// Normals and tangents are stored after all positions in the vertex buffer
+	unsigned int normal_stride = 0;
+	unsigned int attrib_stride = 0;
+	unsigned int index_size = 0;
+	unsigned int offsets[Mesh::ARRAY_MAX] = {};
+	// Uniquely identifies the way the surface gets encoded
+	uint64_t key = 0;
+};
+
+inline unsigned int get_custom_format(int64_t flags, unsigned int custom_index) {
+	return (flags >>
+			(RenderingServer::ARRAY_FORMAT_CUSTOM_BASE + RenderingServer::ARRAY_FORMAT_CUSTOM_BITS * custom_index)) &
+			RenderingServer::ARRAY_FORMAT_CUSTOM_MASK;
+}
+
+int get_packed_array_size(const Variant &v) {
+	switch (v.get_type()) {
+		case Variant::PACKED_VECTOR3_ARRAY:
+			return PackedVector3Array(v).size();
+		case Variant::PACKED_VECTOR2_ARRAY:
+			return PackedVector2Array(v).size();
+		case Variant::PACKED_FLOAT32_ARRAY:
+			return PackedFloat32Array(v).size();
+		case Variant::PACKED_COLOR_ARRAY:
+			return PackedColorArray(v).size();
+		default:
+			return -1;
+	}
+}
+
+// Returns false if the surface uses features the direct encoder doesn't support
+bool get_surface_layout(const Array &arrays, Mesh::PrimitiveType primitive, int64_t flags, SurfaceLayout &layout) {
+	const int64_t custom_flags_mask = ((int64_t(1) << (4 * RenderingServer::ARRAY_FORMAT_CUSTOM_BITS)) - 1)
+			<< RenderingServer::ARRAY_FORMAT_CUSTOM_BASE;
+	if ((flags & ~custom_flags_mask) != 0) {
+		// Compression, 2D vertices...
+		return false;
+	}
+	if (arrays.size() != Mesh::ARRAY_MAX) {
+		return false;
+	}
+
+	const Variant &vertices_v = arrays[Mesh::ARRAY_VERTEX];
+	if (vertices_v.get_type() != Variant::PACKED_VECTOR3_ARRAY) {
+		return false;
+	}
+	const PackedVector3Array vertices = vertices_v;
+	if (vertices.size() == 0) {
+		return false;
+	}
+	layout.vertex_count = vertices.size();
+
+	uint64_t present_arrays_mask = 1 << Mesh::ARRAY_VERTEX;
+
+	for (unsigned int array_index = Mesh::ARRAY_NORMAL; array_index < Mesh::ARRAY_MAX; ++array_index) {
+		const Variant &v = arrays[array_index];
+		if (v.get_type() == Variant::NIL) {
+			continue;
+		}
+
+		Variant::Type expected_type;
+		unsigned int expected_size = layout.vertex_count;
+		unsigned int element_size;
+
+		switch (array_index) {
+			case Mesh::ARRAY_NORMAL:
+				expected_type = Variant::PACKED_VECTOR3_ARRAY;
+				element_size = 4;
+				break;
+			case Mesh::ARRAY_TANGENT:
+				expected_type = Variant::PACKED_FLOAT32_ARRAY;
+				expected_size = 4 * layout.vertex_count;
+				element_size = 4;
+				break;
+			case Mesh::ARRAY_COLOR:
+				expected_type = Variant::PACKED_COLOR_ARRAY;
+				element_size = 4;
+				break;
+			case Mesh::ARRAY_TEX_UV:
+			case Mesh::ARRAY_TEX_UV2:
+				expected_type = Variant::PACKED_VECTOR2_ARRAY;
+				element_size = 2 * sizeof(float);
+				break;
+			case Mesh::ARRAY_CUSTOM0:
+			case Mesh::ARRAY_CUSTOM1:
+			case Mesh::ARRAY_CUSTOM2:
+			case Mesh::ARRAY_CUSTOM3: {
+				const unsigned int custom_format = get_custom_format(flags, array_index - Mesh::ARRAY_CUSTOM0);
+				if (custom_format < RenderingServer::ARRAY_CUSTOM_R_FLOAT ||
+					custom_format > RenderingServer::ARRAY_CUSTOM_RGBA_FLOAT) {
+					return false;
+				}
+				const unsigned int component_count = custom_format - RenderingServer::ARRAY_CUSTOM_R_FLOAT + 1;
+				expected_type = Variant::PACKED_FLOAT32_ARRAY;
+				expected_size = component_count * layout.vertex_count;
+				element_size = component_count * sizeof(float);
+			} break;
+			case Mesh::ARRAY_INDEX: {
+				if (v.get_type() != Variant::PACKED_INT32_ARRAY) {
+					return false;
+				}
+				const PackedInt32Array indices = v;
+				layout.index_count = indices.size();
+				// Godot uses 16-bit indices when all vertices can be addressed with them
+				layout.index_size = layout.vertex_count <= (1 << 16) ? 2 : 4;
+				present_arrays_mask |= 1 << array_index;
+				continue;
+			}
+			default:
+				// Bones and weights
+				return false;
+		}
+
+		if (v.get_type() != expected_type) {
+			return false;
+		}
+		if (get_packed_array_size(v) != int(expected_size)) {
+			// Let Godot report the error
+			return false;
+		}
+
+		if (array_index == Mesh::ARRAY_NORMAL || array_index == Mesh::ARRAY_TANGENT) {
+			layout.offsets[array_index] = layout.normal_stride;
+			layout.normal_stride += element_size;
+		} else {
+			layout.offsets[array_index] = layout.attrib_stride;
+			layout.attrib_stride += element_size;
+		}
+
+		present_arrays_mask |= 1 << array_index;
+	}
+
+	const uint64_t position_region_size = uint64_t(3 * sizeof(float)) * layout.vertex_count;
+	layout.offsets[Mesh::ARRAY_NORMAL] += position_region_size;
+	layout.offsets[Mesh::ARRAY_TANGENT] += position_region_size;
+
+	layout.key = present_arrays_mask | (uint64_t(layout.index_size == 2) << Mesh::ARRAY_MAX) |
+			(uint64_t(primitive) << (Mesh::ARRAY_MAX + 1)) | (uint64_t(flags) << (Mesh::ARRAY_MAX + 4));
+
+	return true;
+}
+
+void encode_surface(
+		const Array &arrays,
+		Mesh::PrimitiveType primitive,
+		const SurfaceLayout &layout,
+		uint64_t format,
+		RenderingServer::SurfaceData &sd
+) {
+	ZN_PROFILE_SCOPE();
+
+	const unsigned int vertex_count = layout.vertex_count;
+
+	sd.format = format;
+	sd.primitive = RenderingServer::PrimitiveType(primitive);
+	sd.vertex_count = vertex_count;
+	sd.index_count = layout.index_count;
+
+	sd.vertex_data.resize((3 * sizeof(float) + layout.normal_stride) * vertex_count);
+	sd.attribute_data.resize(layout.attrib_stride * vertex_count);
+	sd.index_data.resize(layout.index_size * layout.index_count);
+
+	uint8_t *vertex_data = sd.vertex_data.ptrw();
+	uint8_t *attrib_data = sd.attribute_data.ptrw();
+
+	{
+		const PackedVector3Array vertices = arrays[Mesh::ARRAY_VERTEX];
+		const Vector3 *src = vertices.ptr();
+		// Same as Godot, so AABBs are identical
+		const Vector3 small_size(CMP_EPSILON, CMP_EPSILON, CMP_EPSILON);
+		AABB aabb(src[0], small_size);
+		for (unsigned int i = 0; i < vertex_count; ++i) {
+			const float v[3] = { float(src[i].x), float(src[i].y), float(src[i].z) };
+			memcpy(vertex_data + i * sizeof(v), v, sizeof(v));
+			aabb.expand_to(src[i]);
+		}
+		sd.aabb = aabb;
+	}
+
+	for (unsigned int array_index = Mesh::ARRAY_NORMAL; array_index < Mesh::ARRAY_INDEX; ++array_index) {
+		const Variant &v = arrays[array_index];
+		if (v.get_type() == Variant::NIL) {
+			continue;
+		}
+
+		switch (array_index) {
+			case Mesh::ARRAY_NORMAL: {
+				const PackedVector3Array normals = v;
+				const Vector3 *src = normals.ptr();
+				uint8_t *dst = vertex_data + layout.offsets[array_index];
+				for (unsigned int i = 0; i < vertex_count; ++i) {
+					const Vector2 e = src[i].octahedron_encode();
+					const uint16_t n[2] = { uint16_t(math::clamp(e.x * 65535, real_t(0), real_t(65535))),
+											uint16_t(math::clamp(e.y * 65535, real_t(0), real_t(65535))) };
+					memcpy(dst + i * layout.normal_stride, n, sizeof(n));
+				}
+			} break;
+
+			case Mesh::ARRAY_TANGENT: {
+				const PackedFloat32Array tangents = v;
+				const float *src = tangents.ptr();
+				uint8_t *dst = vertex_data + layout.offsets[array_index];
+				for (unsigned int i = 0; i < vertex_count; ++i) {
+					const float *t = src + 4 * i;
+					const Vector2 e = Vector3(t[0], t[1], t[2]).octahedron_tangent_encode(t[3]);
+					uint16_t n[2] = { uint16_t(math::clamp(e.x * 65535, real_t(0), real_t(65535))),
+									  uint16_t(math::clamp(e.y * 65535, real_t(0), real_t(65535))) };
+					// Godot sanitizes this case, (0, 1) and (1, 1) decode to the same tangent
+					if (n[0] == 0 && n[1] == 65535) {
+						n[0] = 65535;
+					}
+					memcpy(dst + i * layout.normal_stride, n, sizeof(n));
+				}
+			} break;
+
+			case Mesh::ARRAY_COLOR: {
+				const PackedColorArray colors = v;
+				const Color *src = colors.ptr();
+				uint8_t *dst = attrib_data + layout.offsets[array_index];
+				for (unsigned int i = 0; i < vertex_count; ++i) {
+					const Color c = src[i];
+					const uint8_t c8[4] = { uint8_t(math::clamp(c.r * 255.0, 0.0, 255.0)),
+											uint8_t(math::clamp(c.g * 255.0, 0.0, 255.0)),
+											uint8_t(math::clamp(c.b * 255.0, 0.0, 255.0)),
+											uint8_t(math::clamp(c.a * 255.0, 0.0, 255.0)) };
+					memcpy(dst + i * layout.attrib_stride, c8, sizeof(c8));
+				}
+			} break;
+
+			case Mesh::ARRAY_TEX_UV:
+			case Mesh::ARRAY_TEX_UV2: {
+				const PackedVector2Array uvs = v;
+				const Vector2 *src = uvs.ptr();
+				uint8_t *dst = attrib_data + layout.offsets[array_index];
+				for (unsigned int i = 0; i < vertex_count; ++i) {
+					const float uv[2] = { float(src[i].x), float(src[i].y) };
+					memcpy(dst + i * layout.attrib_stride, uv, sizeof(uv));
+				}
+			} break;
+
+			case Mesh::ARRAY_CUSTOM0:
+			case Mesh::ARRAY_CUSTOM1:
+			case Mesh::ARRAY_CUSTOM2:
+			case Mesh::ARRAY_CUSTOM3: {
+				const PackedFloat32Array custom = v;
+				const float *src = custom.ptr();
+				const unsigned int component_count = custom.size() / vertex_count;
+				uint8_t *dst = attrib_data + layout.offsets[array_index];
+				for (unsigned int i = 0; i < vertex_count; ++i) {
+					memcpy(dst + i * layout.attrib_stride, src + i * component_count, component_count * sizeof(float));
+				}
+			} break;
+
+			default:
+				break;
+		}
+	}
+
+	if (layout.index_count > 0) {
+		const PackedInt32Array indices = arrays[Mesh::ARRAY_INDEX];
+		const int32_t *src = indices.ptr();
+		uint8_t *dst = sd.index_data.ptrw();
+		if (layout.index_size == 2) {
+			for (unsigned int i = 0; i < layout.index_count; ++i) {
+				const uint16_t index = src[i];
+				memcpy(dst + i * sizeof(index), &index, sizeof(index));
+			}
+		} else {
+			memcpy(dst, src, layout.index_count * sizeof(int32_t));
+		}
+	}
+}
+
+bool is_same_bytes(const Vector<uint8_t> &a, const Vector<uint8_t> &b) {
+	return a.size() == b.size() && (a.size() == 0 || memcmp(a.ptr(), b.ptr(), a.size()) == 0);
+}
+
+bool is_same_surface_data(const RenderingServer::SurfaceData &a, const RenderingServer::SurfaceData &b) {
+	return a.format == b.format && a.primitive == b.primitive && a.vertex_count == b.vertex_count &&
+			a.index_count == b.index_count && a.aabb == b.aabb && a.uv_scale == b.uv_scale &&
+			is_same_bytes(a.vertex_data, b.vertex_data) && is_same_bytes(a.attribute_data, b.attribute_data) &&
+			is_same_bytes(a.index_data, b.index_data) && is_same_bytes(a.skin_data, b.skin_data) &&
+			a.blend_shape_data.size() == 0 && b.blend_shape_data.size() == 0 && a.lods.size() == 0 &&
+			b.lods.size() == 0 && a.bone_aabbs.size() == 0 && b.bone_aabbs.size() == 0;
+}
+
+// Results of comparing the direct encoder with Godot's, for each kind of surface encountered so far. Projects only
+// use a few of them, so a small table is enough. Kinds that don't fit keep using Godot's encoder.
+struct CheckedEncoding {
+	uint64_t key = 0;
+	uint64_t format = 0;
+	bool matches_godot = false;
+};
+
+BinaryMutex g_checked_encodings_mutex;
+FixedArray<CheckedEncoding, 32> g_checked_encodings;
+unsigned int g_checked_encodings_count = 0;
+
+} // namespace
+
+void add_surface_from_arrays(ArrayMesh &mesh, Mesh::PrimitiveType primitive, const Array &arrays, int64_t flags) {
+	ZN_PROFILE_SCOPE();
+
+	SurfaceLayout layout;
+	if (!get_surface_layout(arrays, primitive, flags, layout)) {
+		mesh.add_surface_from_arrays(primitive, arrays, Array(), Dictionary(), flags);
+		return;
+	}
+
+	CheckedEncoding checked_encoding;
+	bool checked = false;
+	{
+		MutexLock mlock(g_checked_encodings_mutex);
+		for (unsigned int i = 0; i < g_checked_encodings_count; ++i) {
+			if (g_checked_encodings[i].key == layout.key) {
+				checked_encoding = g_checked_encodings[i];
+				checked = true;
+				break;
+			}
+		}
+	}
+
+	RenderingServer::SurfaceData sd;
+
+	if (!checked) {
+		// First time this kind of surface is encountered: encode it both ways and check if results are the same
+		const Error err = RenderingServer::get_singleton()->mesh_create_surface_data_from_arrays(
+				&sd, RenderingServer::PrimitiveType(primitive), arrays, Array(), Dictionary(), flags
+		);
+		ERR_FAIL_COND(err != OK);
+
+		RenderingServer::SurfaceData direct_sd;
+		encode_surface(arrays, primitive, layout, sd.format, direct_sd);
+		const bool matches_godot = is_same_surface_data(sd, direct_sd);
+		if (!matches_godot) {
+			ZN_PRINT_VERBOSE(format("Direct surface encoding differs from Godot for format {}", sd.format));
+		}
+
+		MutexLock mlock(g_checked_encodings_mutex);
+		// Another thread could have checked it in the meantime, it would have found the same result
+		if (g_checked_encodings_count < g_checked_encodings.size()) {
+			g_checked_encodings[g_checked_encodings_count] = CheckedEncoding{ layout.key, sd.format, matches_godot };
+			++g_checked_encodings_count;
+		}
+
+	} else if (checked_encoding.matches_godot) {
+		encode_surface(arrays, primitive, layout, checked_encoding.format, sd);
+
+	} else {
+		mesh.add_surface_from_arrays(primitive, arrays, Array(), Dictionary(), flags);
+		return;
+	}
+
+	// Same as what `ArrayMesh::add_surface_from_arrays` does after encoding
+	mesh.add_surface(
+			sd.format,
+			Mesh::PrimitiveType(sd.primitive),
+			sd.vertex_data,
+			sd.attribute_data,
+			sd.skin_data,
+			sd.vertex_count,
+			sd.index_data,
+			sd.index_count,
+			sd.aabb,
+			sd.blend_shape_data,
+			sd.bone_aabbs,
+			sd.lods,
+			sd.uv_scale
+	);
+}
+
+#else
+
+void add_surface_from_arrays(ArrayMesh &mesh, Mesh::PrimitiveType primitive, const Array &arrays, int64_t flags) {
+	mesh.add_surface_from_arrays(primitive, arrays, Array(), Dictionary(), flags);
+}
+
+#endif // ZN_GODOT_DIRECT_SURFACE_ENCODING
+
 #ifdef TOOLS_ENABLED
 
 Array generate_debug_seams_wireframe_surface(const ArrayMesh &src_mesh, int surface_index) {
@@ -25,6 +25,12 @@ inline bool is_mesh_empty(const ArrayMesh &mesh) {
 	return false;
 }
 
+// Same as `ArrayMesh::add_surface_from_arrays`, without blend shapes and LODs. Surfaces made of simple
+// uncompressed formats, like those voxel meshers produce, are encoded directly into the buffers Godot keeps,
+// instead of going through Godot's generic encoder. Each combination of arrays and flags is first checked to give
+// the same result as Godot, otherwise Godot's encoder keeps being used for it.
+void add_surface_from_arrays(ArrayMesh &mesh, Mesh::PrimitiveType primitive, const Array &arrays, int64_t flags);
+
 #ifdef TOOLS_ENABLED
 
 // Generates a wireframe-mesh that highlights edges of a triangle-mesh where vertices are not shared.
@@ -1,4 +1,5 @@
 #include "mesh.h"
+#include "../core/version.h"
 
 namespace zylann::godot {
 
@@ -54,4 +55,12 @@ void offset_surface(Array &surface, Vector3 offset) {
 	surface[Mesh::ARRAY_VERTEX] = positions;
 }
 
+uint32_t get_compressed_attributes_mesh_flag() {
+#if GODOT_VERSION_MAJOR == 4 && GODOT_VERSION_MINOR <= 1
+	return 0;
+#else
+	return Mesh::ARRAY_FLAG_COMPRESS_ATTRIBUTES;
+#endif
+}
+
 } // namespace zylann::godot
@@ -22,6 +22,12 @@ void offset_vec3_array(PackedVector3Array &array, Vector3 offset);
 void scale_surface(Array &surface, float scale);
 void offset_surface(Array &surface, Vector3 offset);
 
+// Gets the flag telling Godot to store vertex positions, normals and tangents of a new mesh surface in a compact
+// format: positions are 16-bit normalized within the bounds of the surface, normals and tangents are
+// octahedral-encoded. Godot decodes them before vertex shaders run. Returns 0 if the version of Godot doesn't support
+// it.
+uint32_t get_compressed_attributes_mesh_flag();
+
 } // namespace zylann::godot
 
 #endif // ZN_GODOT_MESH_H
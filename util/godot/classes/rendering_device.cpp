@@ -189,4 +189,15 @@ Error update_storage_buffer(
 #endif
 }
 
+void compute_list_set_push_constant(RenderingDevice &rd, int64_t compute_list_id, Span<const uint8_t> data) {
+#if defined(ZN_GODOT)
+	rd.compute_list_set_push_constant(compute_list_id, data.data(), data.size());
+#elif defined(ZN_GODOT_EXTENSION)
+	PackedByteArray pba;
+	pba.resize(data.size());
+	memcpy(pba.ptrw(), data.data(), data.size());
+	rd.compute_list_set_push_constant(compute_list_id, pba, data.size());
+#endif
+}
+
 } // namespace zylann::godot
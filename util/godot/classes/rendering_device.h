@@ -8,6 +8,7 @@
 using namespace godot;
 #endif
 
+#include "../../containers/span.h"
 #include "../macros.h"
 #include "rd_shader_spirv.h"
 
@@ -37,6 +38,8 @@ Error update_storage_buffer(
 		unsigned int size,
 		const PackedByteArray &pba
 );
+// Size of the data must match the push constant block declared in the shader of the bound pipeline
+void compute_list_set_push_constant(RenderingDevice &rd, int64_t compute_list_id, Span<const uint8_t> data);
 
 } // namespace zylann::godot
 
@@ -1,9 +1,68 @@
 #include "shader.h"
 #include "../../containers/std_vector.h"
+#include "../core/string.h"
 #include "rendering_server.h"
 
 namespace zylann::godot {
 
+namespace {
+
+inline bool is_identifier_char(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline bool is_space_char(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+} // namespace
+
+bool shader_has_instance_uniform(const Shader &shader, const StringName &uniform_name) {
+	// Instance uniforms are not listed by `get_shader_parameter_list`, so we look for them in the code.
+	// Declarations look like `instance uniform <precision>? <type> <name> (: <hints>)? (= <default>)?;`
+	const StdString code = to_std_string(shader.get_code());
+	const StdString name = to_std_string(String(uniform_name));
+	const std::string_view keyword = "instance";
+
+	size_t pos = 0;
+	while ((pos = code.find(keyword, pos)) != StdString::npos) {
+		const bool starts_token = pos == 0 || !is_identifier_char(code[pos - 1]);
+		pos += keyword.size();
+		if (!starts_token) {
+			continue;
+		}
+
+		// Read the words following the keyword, the uniform name being the last one before a delimiter
+		std::string_view first_word;
+		std::string_view last_word;
+		unsigned int word_count = 0;
+		while (pos < code.size()) {
+			while (pos < code.size() && is_space_char(code[pos])) {
+				++pos;
+			}
+			const size_t word_begin = pos;
+			while (pos < code.size() && is_identifier_char(code[pos])) {
+				++pos;
+			}
+			if (pos == word_begin) {
+				break;
+			}
+			last_word = std::string_view(code.data() + word_begin, pos - word_begin);
+			if (word_count == 0) {
+				first_word = last_word;
+			}
+			++word_count;
+		}
+
+		// At least `uniform`, the type and the name
+		if (word_count >= 3 && first_word == "uniform" && last_word == name) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 #ifdef TOOLS_ENABLED
 
 // TODO Cannot use `Shader.has_uniform()` because it is unreliable.
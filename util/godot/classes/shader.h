@@ -8,6 +8,14 @@
 using namespace godot;
 #endif
 
+namespace zylann::godot {
+
+// Tells if the shader code declares a uniform with the `instance` qualifier (per-instance uniform). These are not part
+// of material parameters. Uniforms declared in included files are not found.
+bool shader_has_instance_uniform(const Shader &shader, const StringName &uniform_name);
+
+} // namespace zylann::godot
+
 #ifdef TOOLS_ENABLED
 
 #include "../../containers/span.h"
@@ -13,9 +13,11 @@ DirectMeshInstance::DirectMeshInstance() {
 DirectMeshInstance::DirectMeshInstance(DirectMeshInstance &&src) {
 	_mesh_instance = src._mesh_instance;
 	_mesh = src._mesh;
+	_state = src._state;
 
 	src._mesh_instance = RID();
 	src._mesh = Ref<Mesh>();
+	src._state = State();
 }
 
 DirectMeshInstance::~DirectMeshInstance() {
@@ -31,6 +33,7 @@ void DirectMeshInstance::create() {
 	RenderingServer &vs = *RenderingServer::get_singleton();
 	_mesh_instance = vs.instance_create();
 	vs.instance_set_visible(_mesh_instance, true); // TODO Is it needed?
+	_state = State();
 }
 
 void DirectMeshInstance::destroy() {
@@ -41,23 +44,29 @@ void DirectMeshInstance::destroy() {
 		_mesh_instance = RID();
 	}
 	_mesh.unref();
+	_state = State();
 }
 
 void DirectMeshInstance::set_world(World3D *world) {
 	ERR_FAIL_COND(!_mesh_instance.is_valid());
-	RenderingServer &vs = *RenderingServer::get_singleton();
-	if (world != nullptr) {
-		vs.instance_set_scenario(_mesh_instance, world->get_scenario());
-	} else {
-		vs.instance_set_scenario(_mesh_instance, RID());
+	const RID scenario = world != nullptr ? world->get_scenario() : RID();
+	if (scenario == _state.scenario) {
+		return;
 	}
+	RenderingServer &vs = *RenderingServer::get_singleton();
+	vs.instance_set_scenario(_mesh_instance, scenario);
+	_state.scenario = scenario;
 }
 
 void DirectMeshInstance::set_transform(Transform3D world_transform) {
 	ZN_PROFILE_SCOPE();
 	ERR_FAIL_COND(!_mesh_instance.is_valid());
+	if (world_transform == _state.transform) {
+		return;
+	}
 	RenderingServer &vs = *RenderingServer::get_singleton();
 	vs.instance_set_transform(_mesh_instance, world_transform);
+	_state.transform = world_transform;
 }
 
 void DirectMeshInstance::set_mesh(Ref<Mesh> mesh) {
@@ -75,24 +84,33 @@ void DirectMeshInstance::set_mesh(Ref<Mesh> mesh) {
 
 void DirectMeshInstance::set_material_override(Ref<Material> material) {
 	ERR_FAIL_COND(!_mesh_instance.is_valid());
-	RenderingServer &vs = *RenderingServer::get_singleton();
-	if (material.is_valid()) {
-		vs.instance_geometry_set_material_override(_mesh_instance, material->get_rid());
-	} else {
-		vs.instance_geometry_set_material_override(_mesh_instance, RID());
+	const RID material_rid = material.is_valid() ? material->get_rid() : RID();
+	if (material_rid == _state.material_override) {
+		return;
 	}
+	RenderingServer &vs = *RenderingServer::get_singleton();
+	vs.instance_geometry_set_material_override(_mesh_instance, material_rid);
+	_state.material_override = material_rid;
 }
 
 void DirectMeshInstance::set_visible(bool visible) {
 	ERR_FAIL_COND(!_mesh_instance.is_valid());
+	if (visible == _state.visible) {
+		return;
+	}
 	RenderingServer &vs = *RenderingServer::get_singleton();
 	vs.instance_set_visible(_mesh_instance, visible);
+	_state.visible = visible;
 }
 
 void DirectMeshInstance::set_cast_shadows_setting(RenderingServer::ShadowCastingSetting mode) {
 	ERR_FAIL_COND(!_mesh_instance.is_valid());
+	if (mode == _state.shadow_casting) {
+		return;
+	}
 	RenderingServer &vs = *RenderingServer::get_singleton();
 	vs.instance_geometry_set_cast_shadows_setting(_mesh_instance, mode);
+	_state.shadow_casting = mode;
 }
 
 void DirectMeshInstance::set_shader_instance_parameter(StringName key, Variant value) {
@@ -115,8 +133,12 @@ void DirectMeshInstance::set_gi_mode(GeometryInstance3D::GIMode mode) {
 
 void DirectMeshInstance::set_render_layers_mask(int mask) {
 	ERR_FAIL_COND(!_mesh_instance.is_valid());
+	if (mask == _state.render_layers_mask) {
+		return;
+	}
 	RenderingServer &vs = *RenderingServer::get_singleton();
 	vs.instance_set_layer_mask(_mesh_instance, mask);
+	_state.render_layers_mask = mask;
 }
 
 void DirectMeshInstance::operator=(DirectMeshInstance &&src) {
@@ -128,9 +150,11 @@ void DirectMeshInstance::operator=(DirectMeshInstance &&src) {
 
 	_mesh_instance = src._mesh_instance;
 	_mesh = src._mesh;
+	_state = src._state;
 
 	src._mesh_instance = RID();
 	src._mesh.unref();
+	src._state = State();
 }
 
 } // namespace zylann::godot
@@ -11,7 +11,9 @@ ZN_GODOT_FORWARD_DECLARE(class World3D);
 
 namespace zylann::godot {
 
-// Thin wrapper around VisualServer mesh instance API
+// Thin wrapper around VisualServer mesh instance API.
+// It remembers the state last sent to RenderingServer, so setting the same value again doesn't queue another command.
+// That happens a lot when many blocks get shown, hidden or moved in the same frame.
 class DirectMeshInstance : public NonCopyable {
 public:
 	DirectMeshInstance();
@@ -39,8 +41,19 @@ public:
 	void operator=(DirectMeshInstance &&src);
 
 private:
+	// Defaults match those of a newly created instance in RenderingServer
+	struct State {
+		RID scenario;
+		RID material_override;
+		Transform3D transform;
+		RenderingServer::ShadowCastingSetting shadow_casting = RenderingServer::SHADOW_CASTING_SETTING_ON;
+		int render_layers_mask = 1;
+		bool visible = true;
+	};
+
 	RID _mesh_instance;
 	Ref<Mesh> _mesh;
+	State _state;
 };
 
 } // namespace zylann::godot
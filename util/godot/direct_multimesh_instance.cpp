@@ -20,6 +20,7 @@ void DirectMultiMeshInstance::create() {
 	RenderingServer &vs = *RenderingServer::get_singleton();
 	_multimesh_instance = vs.instance_create();
 	vs.instance_set_visible(_multimesh_instance, true); // TODO Is it needed?
+	_visible = true;
 }
 
 void DirectMultiMeshInstance::destroy() {
@@ -29,6 +30,7 @@ void DirectMultiMeshInstance::destroy() {
 		_multimesh_instance = RID();
 		_multimesh.unref();
 	}
+	_visible = true;
 }
 
 void DirectMultiMeshInstance::set_world(World3D *world) {
@@ -67,8 +69,12 @@ void DirectMultiMeshInstance::set_transform(Transform3D world_transform) {
 
 void DirectMultiMeshInstance::set_visible(bool visible) {
 	ERR_FAIL_COND(!_multimesh_instance.is_valid());
+	if (visible == _visible) {
+		return;
+	}
 	RenderingServer &vs = *RenderingServer::get_singleton();
 	vs.instance_set_visible(_multimesh_instance, visible);
+	_visible = visible;
 }
 
 void DirectMultiMeshInstance::set_material_override(Ref<Material> material) {
@@ -60,6 +60,8 @@ public:
 private:
 	RID _multimesh_instance;
 	Ref<MultiMesh> _multimesh;
+	// Last state sent to RenderingServer, so setting the same state again doesn't send anything
+	bool _visible = true;
 };
 
 } // namespace zylann::godot
@@ -73,8 +73,16 @@ void copy_shader_params(const ShaderMaterial &src, ShaderMaterial &dst, Span<con
 	// }
 	for (unsigned int i = 0; i < params.size(); ++i) {
 		const StringName &name = params[i];
-		dst.set_shader_parameter(name, src.get_shader_parameter(name));
+		// Pooled materials often already have the same values
+		set_shader_parameter_if_changed(dst, name, src.get_shader_parameter(name));
 	}
 }
 
+void set_shader_parameter_if_changed(ShaderMaterial &material, const StringName &name, const Variant &value) {
+	if (material.get_shader_parameter(name) == value) {
+		return;
+	}
+	material.set_shader_parameter(name, value);
+}
+
 } // namespace zylann::godot
@@ -34,6 +34,10 @@ private:
 
 void copy_shader_params(const ShaderMaterial &src, ShaderMaterial &dst, Span<const StringName> params);
 
+// Every parameter write sends a command to RenderingServer, even if the value doesn't change. This skips it when the
+// material already has the same value.
+void set_shader_parameter_if_changed(ShaderMaterial &material, const StringName &name, const Variant &value);
+
 } // namespace zylann::godot
 
 #endif // ZN_SHADER_MATERIAL_POOL_H
@@ -1,8 +1,10 @@
 #ifndef ZN_HASH_FUNCS_H
 #define ZN_HASH_FUNCS_H
 
+#include "containers/span.h"
 #include "math/funcs.h"
 #include <cstdint>
+#include <cstring>
 
 namespace zylann {
 
@@ -43,6 +45,116 @@ inline uint32_t hash_fmix32(uint32_t h) {
 	return h;
 }
 
+inline uint64_t hash_fmix64(uint64_t k) {
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+
+	return k;
+}
+
+// Hash of 3D integer coordinates, such as block positions. Each coordinate is multiplied by a different large odd
+// constant, so upper bits depend on all bits of all coordinates, and the multiplies don't depend on each other.
+// Tables using power-of-two sizes should take their index from the upper bits.
+inline uint64_t hash_coordinates_3d_64(int32_t x, int32_t y, int32_t z) {
+	return (static_cast<uint64_t>(static_cast<uint32_t>(x)) * 0x9e3779b97f4a7c15ull) ^
+			(static_cast<uint64_t>(static_cast<uint32_t>(y)) * 0xc2b2ae3d27d4eb4full) ^
+			(static_cast<uint64_t>(static_cast<uint32_t>(z)) * 0x165667b19e3779f9ull);
+}
+
+// Same as `hash_coordinates_3d_64`, with upper bits folded into lower bits, for tables taking their index from lower
+// bits or from a modulo.
+inline uint64_t hash_coordinates_3d_folded_64(int32_t x, int32_t y, int32_t z) {
+	const uint64_t h = hash_coordinates_3d_64(x, y, z);
+	return h ^ (h >> 32);
+}
+
+// Murmurhash3 x64 128-bit version. Suitable to identify contents, but not meant to resist deliberate collisions.
+// Results depend on endianness.
+inline void hash_murmur3_128(Span<const uint8_t> data, uint64_t seed, uint64_t out_hash[2]) {
+	struct L {
+		static inline uint64_t rotl64(uint64_t x, int8_t r) {
+			return (x << r) | (x >> (64 - r));
+		}
+	};
+
+	const size_t block_count = data.size() / 16;
+	const uint64_t c1 = 0x87c37b91114253d5ULL;
+	const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+	uint64_t h1 = seed;
+	uint64_t h2 = seed;
+
+	for (size_t i = 0; i < block_count; ++i) {
+		uint64_t k1;
+		uint64_t k2;
+		// memcpy because data is not necessarily aligned
+		memcpy(&k1, data.data() + i * 16, sizeof(k1));
+		memcpy(&k2, data.data() + i * 16 + 8, sizeof(k2));
+
+		k1 *= c1;
+		k1 = L::rotl64(k1, 31);
+		k1 *= c2;
+		h1 ^= k1;
+
+		h1 = L::rotl64(h1, 27);
+		h1 += h2;
+		h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= c2;
+		k2 = L::rotl64(k2, 33);
+		k2 *= c1;
+		h2 ^= k2;
+
+		h2 = L::rotl64(h2, 31);
+		h2 += h1;
+		h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	const uint8_t *tail = data.data() + block_count * 16;
+	const size_t tail_size = data.size() & 15;
+
+	uint64_t k1 = 0;
+	uint64_t k2 = 0;
+
+	for (size_t i = tail_size; i > 8; --i) {
+		k2 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 9) * 8);
+	}
+	if (tail_size > 8) {
+		k2 *= c2;
+		k2 = L::rotl64(k2, 33);
+		k2 *= c1;
+		h2 ^= k2;
+	}
+
+	for (size_t i = math::min<size_t>(tail_size, 8); i > 0; --i) {
+		k1 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 1) * 8);
+	}
+	if (tail_size > 0) {
+		k1 *= c1;
+		k1 = L::rotl64(k1, 31);
+		k1 *= c2;
+		h1 ^= k1;
+	}
+
+	h1 ^= data.size();
+	h2 ^= data.size();
+
+	h1 += h2;
+	h2 += h1;
+
+	h1 = hash_fmix64(h1);
+	h2 = hash_fmix64(h2);
+
+	h1 += h2;
+	h2 += h1;
+
+	out_hash[0] = h1;
+	out_hash[1] = h2;
+}
+
 } // namespace zylann
 
 #endif // ZN_HASH_FUNCS_H
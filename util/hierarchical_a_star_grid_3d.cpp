@@ -0,0 +1,619 @@
+#include "hierarchical_a_star_grid_3d.h"
+#include "containers/container_funcs.h"
+#include "containers/std_unordered_map.h"
+#include "math/conv.h"
+#include "profiling.h"
+#include <algorithm>
+
+namespace zylann {
+
+namespace {
+
+const Vector3i g_axis_directions[3] = { Vector3i(1, 0, 0), Vector3i(0, 1, 0), Vector3i(0, 0, 1) };
+
+// Runs a full search with the pathfinder, restricted to the given box. If a path is found, its positions are
+// appended to `out_path` if not null, excluding `to`.
+bool find_local_path(
+		AStarGrid3D &pathfinder,
+		Box3i box,
+		Vector3i from,
+		Vector3i to,
+		float &out_cost,
+		StdVector<Vector3i> *out_path
+) {
+	if (from == to) {
+		out_cost = 0.f;
+		return true;
+	}
+
+	pathfinder.set_region(box);
+	pathfinder.start(from, to);
+	while (pathfinder.is_running()) {
+		pathfinder.step();
+	}
+
+	Span<const Vector3i> path = pathfinder.get_path();
+	if (path.size() == 0) {
+		return false;
+	}
+
+	float cost = 0.f;
+	for (unsigned int i = 1; i < path.size(); ++i) {
+		cost += math::length(to_vec3f(path[i] - path[i - 1]));
+	}
+	cost += math::length(to_vec3f(to - path[path.size() - 1]));
+	out_cost = cost;
+
+	if (out_path != nullptr) {
+		out_path->insert(out_path->end(), path.begin(), path.end());
+	}
+	return true;
+}
+
+// Finds moves from cells of `src_box` to cells of `dst_box`. Boxes must be neighbors along `axis`.
+void find_transitions(
+		AStarGrid3D &pathfinder,
+		Box3i src_box,
+		Box3i dst_box,
+		unsigned int axis,
+		StdVector<Vector3i> &neighbors,
+		StdVector<HierarchicalAStarGrid3D::Transition> &out_transitions
+) {
+	// Only the face of the source box touching the destination box
+	Box3i face = src_box;
+	if (src_box.position[axis] < dst_box.position[axis]) {
+		face.position[axis] += face.size[axis] - 1;
+	}
+	face.size[axis] = 1;
+
+	face.for_each_cell([&pathfinder, &dst_box, &neighbors, &out_transitions](Vector3i pos) {
+		if (!pathfinder.is_passable(pos)) {
+			return;
+		}
+		neighbors.clear();
+		pathfinder.get_reachable_neighbors(pos, neighbors);
+		for (const Vector3i npos : neighbors) {
+			if (dst_box.contains(npos)) {
+				out_transitions.push_back({ pos, npos, math::length(to_vec3f(npos - pos)) });
+			}
+		}
+	});
+}
+
+inline bool are_adjacent(Vector3i a, Vector3i b) {
+	const Vector3i d = b - a;
+	return Math::abs(d.x) <= 1 && Math::abs(d.y) <= 1 && Math::abs(d.z) <= 1;
+}
+
+// Groups transitions starting from adjacent cells, and keeps only one of them per group, near its center.
+void group_transitions(
+		Span<const HierarchicalAStarGrid3D::Transition> transitions,
+		StdVector<HierarchicalAStarGrid3D::Transition> &out_portals
+) {
+	StdVector<uint8_t> visited;
+	visited.resize(transitions.size(), 0);
+	StdVector<unsigned int> group;
+	StdVector<unsigned int> stack;
+
+	for (unsigned int i = 0; i < transitions.size(); ++i) {
+		if (visited[i] != 0) {
+			continue;
+		}
+
+		group.clear();
+		stack.push_back(i);
+		visited[i] = 1;
+
+		while (stack.size() > 0) {
+			const unsigned int j = stack.back();
+			stack.pop_back();
+			group.push_back(j);
+
+			for (unsigned int k = 0; k < transitions.size(); ++k) {
+				if (visited[k] == 0 && are_adjacent(transitions[j].from, transitions[k].from)) {
+					visited[k] = 1;
+					stack.push_back(k);
+				}
+			}
+		}
+
+		Vector3f center;
+		for (const unsigned int j : group) {
+			center += to_vec3f(transitions[j].from);
+		}
+		center /= static_cast<float>(group.size());
+
+		unsigned int best = group[0];
+		float best_distance_squared = math::distance_squared(to_vec3f(transitions[best].from), center);
+		for (const unsigned int j : group) {
+			const float d = math::distance_squared(to_vec3f(transitions[j].from), center);
+			if (d < best_distance_squared) {
+				best_distance_squared = d;
+				best = j;
+			}
+		}
+
+		out_portals.push_back(transitions[best]);
+	}
+}
+
+float evaluate_heuristic(Vector3i pos, Vector3i target_pos) {
+	// Same as AStarGrid3D
+	const Vector3i diff = target_pos - pos;
+	return Math::abs(diff.x) + Math::abs(diff.y) + Math::abs(diff.z);
+}
+
+// Local searches modify the region of the pathfinder
+struct ScopedRegionRestore {
+	AStarGrid3D &pathfinder;
+	const Box3i region;
+
+	ScopedRegionRestore(AStarGrid3D &p_pathfinder) : pathfinder(p_pathfinder), region(p_pathfinder.get_region()) {}
+
+	~ScopedRegionRestore() {
+		pathfinder.set_region(region);
+	}
+};
+
+} // namespace
+
+void HierarchicalAStarGrid3D::set_region(Box3i region) {
+	if (region == _region) {
+		return;
+	}
+	_region = region;
+	resize_clusters();
+}
+
+void HierarchicalAStarGrid3D::set_cluster_size(int size) {
+	ZN_ASSERT_RETURN(size > 0);
+	if (size == _cluster_size) {
+		return;
+	}
+	_cluster_size = size;
+	resize_clusters();
+}
+
+void HierarchicalAStarGrid3D::clear() {
+	resize_clusters();
+}
+
+void HierarchicalAStarGrid3D::resize_clusters() {
+	_clusters_size = math::ceildiv(_region.size, _cluster_size);
+	_clusters.clear();
+	_clusters.resize(Vector3iUtil::get_volume_u64(_clusters_size));
+	_dirty_clusters.clear();
+	for (unsigned int i = 0; i < _clusters.size(); ++i) {
+		_dirty_clusters.push_back(i);
+	}
+}
+
+void HierarchicalAStarGrid3D::invalidate(Box3i box) {
+	// Walkability of cells around voxels can change too, especially above them
+	box = box.padded(1);
+	box.size.y += _vertical_margin;
+	box = box.clipped(_region);
+	if (box.is_empty()) {
+		return;
+	}
+
+	const Box3i cbox = Box3i::from_min_max(
+			get_cluster_position(box.position), get_cluster_position(box.position + box.size - Vector3i(1, 1, 1)) + 1
+	);
+
+	cbox.for_each_cell([this](Vector3i cpos) {
+		const unsigned int ci = get_cluster_index(cpos);
+		Cluster &cluster = _clusters[ci];
+		if (!cluster.dirty) {
+			cluster.dirty = true;
+			_dirty_clusters.push_back(ci);
+		}
+	});
+}
+
+Box3i HierarchicalAStarGrid3D::get_cluster_box(Vector3i cpos) const {
+	return Box3i(_region.position + cpos * _cluster_size, Vector3iUtil::create(_cluster_size)).clipped(_region);
+}
+
+Box3i HierarchicalAStarGrid3D::get_local_search_box(Vector3i cpos) const {
+	// Searches may go a bit outside of the cluster, because agents need ground below them and room above them
+	Box3i box = get_cluster_box(cpos).padded(1);
+	box.position.y -= _vertical_margin;
+	box.size.y += _vertical_margin;
+	return box.clipped(_region);
+}
+
+Vector3i HierarchicalAStarGrid3D::get_cluster_position(Vector3i pos) const {
+	const Vector3i rpos = pos - _region.position;
+	return Vector3i(rpos.x / _cluster_size, rpos.y / _cluster_size, rpos.z / _cluster_size);
+}
+
+unsigned int HierarchicalAStarGrid3D::get_cluster_index(Vector3i cpos) const {
+	return Vector3iUtil::get_zxy_index(cpos, _clusters_size);
+}
+
+const HierarchicalAStarGrid3D::Node *HierarchicalAStarGrid3D::find_node(Vector3i pos) const {
+	const Cluster &cluster = _clusters[get_cluster_index(get_cluster_position(pos))];
+	for (const Node &node : cluster.nodes) {
+		if (node.position == pos) {
+			return &node;
+		}
+	}
+	return nullptr;
+}
+
+void HierarchicalAStarGrid3D::update_boundary(AStarGrid3D &pathfinder, Vector3i cpos, unsigned int axis) {
+	StdVector<Transition> &portals = _clusters[get_cluster_index(cpos)].boundaries[axis];
+	portals.clear();
+
+	const Vector3i npos = cpos + g_axis_directions[axis];
+	if (npos[axis] >= _clusters_size[axis]) {
+		return;
+	}
+
+	const Box3i box = get_cluster_box(cpos);
+	const Box3i nbox = get_cluster_box(npos);
+
+	StdVector<Vector3i> neighbors;
+	StdVector<Transition> transitions;
+
+	// Moves are not always reversible (falling), so both directions are looked at separately
+	find_transitions(pathfinder, box, nbox, axis, neighbors, transitions);
+	group_transitions(to_span(transitions), portals);
+
+	transitions.clear();
+	find_transitions(pathfinder, nbox, box, axis, neighbors, transitions);
+	group_transitions(to_span(transitions), portals);
+}
+
+bool HierarchicalAStarGrid3D::update_nodes(Vector3i cpos) {
+	Cluster &cluster = _clusters[get_cluster_index(cpos)];
+
+	StdVector<Vector3i> positions;
+
+	auto add_positions = [this, cpos, &positions](Span<const Transition> portals) {
+		for (const Transition &t : portals) {
+			if (get_cluster_position(t.from) == cpos) {
+				positions.push_back(t.from);
+			}
+			if (get_cluster_position(t.to) == cpos) {
+				positions.push_back(t.to);
+			}
+		}
+	};
+
+	for (unsigned int axis = 0; axis < 3; ++axis) {
+		add_positions(to_span(cluster.boundaries[axis]));
+		const Vector3i ppos = cpos - g_axis_directions[axis];
+		if (ppos[axis] >= 0) {
+			add_positions(to_span(_clusters[get_cluster_index(ppos)].boundaries[axis]));
+		}
+	}
+
+	std::sort(positions.begin(), positions.end());
+	positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+	bool same_nodes = positions.size() == cluster.nodes.size();
+	for (unsigned int i = 0; i < positions.size() && same_nodes; ++i) {
+		same_nodes = positions[i] == cluster.nodes[i].position;
+	}
+
+	if (same_nodes) {
+		// Keep edges within the cluster, transitions will be added again
+		for (Node &node : cluster.nodes) {
+			unordered_remove_if(node.edges, [this, cpos](const Edge &edge) { //
+				return get_cluster_position(edge.to) != cpos;
+			});
+		}
+		return false;
+	}
+
+	cluster.nodes.clear();
+	cluster.nodes.resize(positions.size());
+	for (unsigned int i = 0; i < positions.size(); ++i) {
+		cluster.nodes[i].position = positions[i];
+	}
+	return true;
+}
+
+void HierarchicalAStarGrid3D::update_edges(AStarGrid3D &pathfinder, Vector3i cpos, bool nodes_changed) {
+	Cluster &cluster = _clusters[get_cluster_index(cpos)];
+
+	if (nodes_changed || cluster.dirty) {
+		ZN_PROFILE_SCOPE_NAMED("Intra-cluster edges");
+		const Box3i box = get_local_search_box(cpos);
+
+		for (Node &node : cluster.nodes) {
+			node.edges.clear();
+		}
+
+		for (Node &src : cluster.nodes) {
+			for (const Node &dst : cluster.nodes) {
+				if (&src == &dst) {
+					continue;
+				}
+				float cost;
+				if (find_local_path(pathfinder, box, src.position, dst.position, cost, nullptr)) {
+					src.edges.push_back({ dst.position, cost });
+				}
+			}
+		}
+	}
+
+	auto add_transitions = [&cluster, cpos, this](Span<const Transition> portals) {
+		for (const Transition &t : portals) {
+			if (get_cluster_position(t.from) != cpos) {
+				continue;
+			}
+			for (Node &node : cluster.nodes) {
+				if (node.position == t.from) {
+					node.edges.push_back({ t.to, t.cost });
+					break;
+				}
+			}
+		}
+	};
+
+	for (unsigned int axis = 0; axis < 3; ++axis) {
+		add_transitions(to_span(cluster.boundaries[axis]));
+		const Vector3i ppos = cpos - g_axis_directions[axis];
+		if (ppos[axis] >= 0) {
+			add_transitions(to_span(_clusters[get_cluster_index(ppos)].boundaries[axis]));
+		}
+	}
+}
+
+void HierarchicalAStarGrid3D::update(AStarGrid3D &pathfinder) {
+	if (_dirty_clusters.size() == 0) {
+		return;
+	}
+
+	ZN_PROFILE_SCOPE();
+
+	ScopedRegionRestore region_restore(pathfinder);
+	pathfinder.set_region(_region);
+
+	_vertical_margin = pathfinder.get_max_fall_height() + static_cast<int>(Math::ceil(pathfinder.get_agent_size().y));
+
+	// Clusters whose portals or edges may change
+	StdVector<Vector3i> affected_clusters;
+
+	{
+		ZN_PROFILE_SCOPE_NAMED("Boundaries");
+
+		for (const uint32_t ci : _dirty_clusters) {
+			const Vector3i cpos = Vector3iUtil::from_zxy_index(ci, _clusters_size);
+			affected_clusters.push_back(cpos);
+
+			for (unsigned int axis = 0; axis < 3; ++axis) {
+				// Each cluster owns boundaries with its neighbors in positive directions
+				update_boundary(pathfinder, cpos, axis);
+
+				const Vector3i npos = cpos + g_axis_directions[axis];
+				if (npos[axis] < _clusters_size[axis]) {
+					affected_clusters.push_back(npos);
+				}
+
+				const Vector3i ppos = cpos - g_axis_directions[axis];
+				if (ppos[axis] >= 0) {
+					affected_clusters.push_back(ppos);
+					const Cluster &pcluster = _clusters[get_cluster_index(ppos)];
+					if (!pcluster.dirty) {
+						// Otherwise it gets updated in its own iteration
+						update_boundary(pathfinder, ppos, axis);
+					}
+				}
+			}
+		}
+	}
+
+	std::sort(affected_clusters.begin(), affected_clusters.end());
+	affected_clusters.erase(
+			std::unique(affected_clusters.begin(), affected_clusters.end()), affected_clusters.end()
+	);
+
+	// Nodes of all affected clusters must be known before adding transitions between them
+	StdVector<uint8_t> nodes_changed;
+	nodes_changed.resize(affected_clusters.size());
+	for (unsigned int i = 0; i < affected_clusters.size(); ++i) {
+		nodes_changed[i] = update_nodes(affected_clusters[i]);
+	}
+
+	for (unsigned int i = 0; i < affected_clusters.size(); ++i) {
+		update_edges(pathfinder, affected_clusters[i], nodes_changed[i] != 0);
+	}
+
+	for (const uint32_t ci : _dirty_clusters) {
+		_clusters[ci].dirty = false;
+	}
+	_dirty_clusters.clear();
+}
+
+bool HierarchicalAStarGrid3D::find_path(
+		AStarGrid3D &pathfinder,
+		Vector3i from_position,
+		Vector3i to_position,
+		StdVector<Vector3i> &out_path
+) {
+	ZN_PROFILE_SCOPE();
+
+	out_path.clear();
+
+	if (!_region.contains(from_position) || !_region.contains(to_position)) {
+		return false;
+	}
+	if (from_position == to_position) {
+		return true;
+	}
+
+	update(pathfinder);
+
+	ScopedRegionRestore region_restore(pathfinder);
+
+	const Vector3i from_cpos = get_cluster_position(from_position);
+	const Vector3i to_cpos = get_cluster_position(to_position);
+	const Box3i from_box = get_local_search_box(from_cpos);
+	const Box3i to_box = get_local_search_box(to_cpos);
+
+	float cost;
+
+	if (from_cpos == to_cpos) {
+		// Short paths don't need the graph. If none is found, a path going through other clusters might still exist.
+		if (find_local_path(pathfinder, from_box, from_position, to_position, cost, &out_path)) {
+			return true;
+		}
+	}
+
+	// Connect the start and the destination to the graph
+
+	const Cluster &from_cluster = _clusters[get_cluster_index(from_cpos)];
+	const Cluster &to_cluster = _clusters[get_cluster_index(to_cpos)];
+
+	StdVector<Edge> start_edges;
+	for (const Node &node : from_cluster.nodes) {
+		if (find_local_path(pathfinder, from_box, from_position, node.position, cost, nullptr)) {
+			start_edges.push_back({ node.position, cost });
+		}
+	}
+	if (start_edges.size() == 0) {
+		return false;
+	}
+
+	StdUnorderedMap<Vector3i, float> goal_costs;
+	for (const Node &node : to_cluster.nodes) {
+		if (find_local_path(pathfinder, to_box, node.position, to_position, cost, nullptr)) {
+			goal_costs.insert({ node.position, cost });
+		}
+	}
+	if (goal_costs.size() == 0) {
+		return false;
+	}
+
+	// Search the graph. Since it is small compared to the voxel grid, this is a simple A* with lazy removal from the
+	// open list.
+
+	struct Point {
+		float gscore;
+		Vector3i came_from;
+		bool closed;
+	};
+
+	struct OpenItem {
+		float fscore;
+		Vector3i position;
+
+		inline bool operator<(const OpenItem &other) const {
+			// Lowest score first
+			return fscore > other.fscore;
+		}
+	};
+
+	StdUnorderedMap<Vector3i, Point> points;
+	StdVector<OpenItem> open_list;
+
+	points.insert({ from_position, Point{ 0.f, from_position, false } });
+	open_list.push_back({ evaluate_heuristic(from_position, to_position), from_position });
+
+	const float max_cost = pathfinder.get_max_path_cost();
+	bool found = false;
+
+	while (open_list.size() > 0) {
+		std::pop_heap(open_list.begin(), open_list.end());
+		const Vector3i pos = open_list.back().position;
+		open_list.pop_back();
+
+		Point &point = points[pos];
+		if (point.closed) {
+			continue;
+		}
+		point.closed = true;
+
+		if (pos == to_position) {
+			found = true;
+			break;
+		}
+
+		const float gscore = point.gscore;
+
+		auto visit = [&points, &open_list, pos, gscore, max_cost, to_position](Vector3i npos, float edge_cost) {
+			const float tentative_gscore = gscore + edge_cost;
+			if (tentative_gscore >= max_cost) {
+				return;
+			}
+			auto it = points.find(npos);
+			if (it == points.end()) {
+				points.insert({ npos, Point{ tentative_gscore, pos, false } });
+			} else {
+				Point &npoint = it->second;
+				// Same epsilon as AStarGrid3D
+				if (npoint.closed || tentative_gscore + 0.001f >= npoint.gscore) {
+					return;
+				}
+				npoint.gscore = tentative_gscore;
+				npoint.came_from = pos;
+			}
+			open_list.push_back({ tentative_gscore + evaluate_heuristic(npos, to_position), npos });
+			std::push_heap(open_list.begin(), open_list.end());
+		};
+
+		if (pos == from_position) {
+			for (const Edge &edge : start_edges) {
+				visit(edge.to, edge.cost);
+			}
+		}
+
+		const Node *node = find_node(pos);
+		if (node != nullptr) {
+			for (const Edge &edge : node->edges) {
+				visit(edge.to, edge.cost);
+			}
+		}
+
+		auto goal_it = goal_costs.find(pos);
+		if (goal_it != goal_costs.end()) {
+			visit(to_position, goal_it->second);
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	StdVector<Vector3i> abstract_path;
+	for (Vector3i pos = to_position; pos != from_position; pos = points[pos].came_from) {
+		abstract_path.push_back(pos);
+	}
+	abstract_path.push_back(from_position);
+	std::reverse(abstract_path.begin(), abstract_path.end());
+
+	// Refine into voxel steps
+
+	for (unsigned int i = 0; i + 1 < abstract_path.size(); ++i) {
+		const Vector3i a = abstract_path[i];
+		const Vector3i b = abstract_path[i + 1];
+		const Vector3i a_cpos = get_cluster_position(a);
+
+		if (a_cpos != get_cluster_position(b)) {
+			// Transition between neighbor cells
+			out_path.push_back(a);
+
+		} else if (!find_local_path(pathfinder, get_local_search_box(a_cpos), a, b, cost, &out_path)) {
+			// Shouldn't happen since the same search was done when building the graph
+			ZN_PRINT_ERROR("Could not refine hierarchical path");
+			out_path.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+unsigned int HierarchicalAStarGrid3D::debug_get_portal_count() const {
+	unsigned int count = 0;
+	for (const Cluster &cluster : _clusters) {
+		count += cluster.nodes.size();
+	}
+	return count;
+}
+
+} // namespace zylann
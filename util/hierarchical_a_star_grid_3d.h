@@ -0,0 +1,107 @@
+#ifndef ZN_HIERARCHICAL_A_STAR_GRID_3D_H
+#define ZN_HIERARCHICAL_A_STAR_GRID_3D_H
+
+#include "a_star_grid_3d.h"
+#include "containers/fixed_array.h"
+
+namespace zylann {
+
+// Hierarchical pathfinding (HPA*) on top of AStarGrid3D, to find long paths without visiting every voxel between
+// their ends.
+//
+// The region is divided into clusters. Transitions between neighboring clusters are found along their shared faces,
+// and contiguous transitions are grouped into a single portal. Portals of the same cluster are then connected with
+// local searches. The resulting graph is cached, and only clusters touching invalidated areas get rebuilt.
+//
+// Searches first find a path in that graph, then refine each of its steps with a local search. Paths are usually
+// close to optimal, but not always optimal. Diagonal moves across edges or corners of clusters are not considered as
+// transitions.
+//
+// This class doesn't know about voxels: walkability and local searches are done with a pathfinder given to the
+// functions that need it. That pathfinder's region is modified in the process, and restored afterwards.
+class HierarchicalAStarGrid3D {
+public:
+	// Clears the graph
+	void set_region(Box3i region);
+	const Box3i &get_region() const {
+		return _region;
+	}
+
+	// Clears the graph
+	void set_cluster_size(int size);
+	int get_cluster_size() const {
+		return _cluster_size;
+	}
+
+	// Marks clusters touching the box to be rebuilt before the next search. Must be called when voxels change.
+	void invalidate(Box3i box);
+	void clear();
+
+	// Rebuilds clusters that need it. Done automatically by `find_path`, but may be called ahead of time.
+	void update(AStarGrid3D &pathfinder);
+
+	// Returns true if a path was found. Like AStarGrid3D, the path starts with `from_position` and ends just before
+	// `to_position`.
+	bool find_path(
+			AStarGrid3D &pathfinder,
+			Vector3i from_position,
+			Vector3i to_position,
+			StdVector<Vector3i> &out_path
+	);
+
+	// Debug
+
+	unsigned int debug_get_portal_count() const;
+	unsigned int debug_get_dirty_cluster_count() const {
+		return _dirty_clusters.size();
+	}
+
+	// Move from a cell of a cluster to a cell of a neighbor cluster
+	struct Transition {
+		Vector3i from;
+		Vector3i to;
+		float cost;
+	};
+
+private:
+	struct Edge {
+		Vector3i to;
+		float cost;
+	};
+
+	struct Node {
+		Vector3i position;
+		// Edges to nodes of the same cluster, and transitions to nodes of neighbor clusters
+		StdVector<Edge> edges;
+	};
+
+	struct Cluster {
+		StdVector<Node> nodes;
+		// Portals with the next cluster along each axis, in both directions
+		FixedArray<StdVector<Transition>, 3> boundaries;
+		bool dirty = true;
+	};
+
+	void resize_clusters();
+	Box3i get_cluster_box(Vector3i cpos) const;
+	Box3i get_local_search_box(Vector3i cpos) const;
+	Vector3i get_cluster_position(Vector3i pos) const;
+	unsigned int get_cluster_index(Vector3i cpos) const;
+	const Node *find_node(Vector3i pos) const;
+
+	void update_boundary(AStarGrid3D &pathfinder, Vector3i cpos, unsigned int axis);
+	bool update_nodes(Vector3i cpos);
+	void update_edges(AStarGrid3D &pathfinder, Vector3i cpos, bool nodes_changed);
+
+	Box3i _region;
+	int _cluster_size = 16;
+	// How far above changed voxels walkability can change, depending on the last pathfinder used
+	int _vertical_margin = 4;
+	Vector3i _clusters_size;
+	StdVector<Cluster> _clusters;
+	StdVector<uint32_t> _dirty_clusters;
+};
+
+} // namespace zylann
+
+#endif // ZN_HIERARCHICAL_A_STAR_GRID_3D_H
@@ -0,0 +1,475 @@
+#include "async_file_reader.h"
+#include "../containers/std_vector.h"
+#include "../errors.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define ZN_ASYNC_FILE_READER_WINDOWS
+
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#define ZN_ASYNC_FILE_READER_POSIX
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define ZN_ASYNC_FILE_READER_IO_URING
+#endif
+#endif
+
+#endif
+
+namespace zylann {
+
+AsyncFileReader::~AsyncFileReader() {
+	close();
+}
+
+#if defined(ZN_ASYNC_FILE_READER_WINDOWS)
+
+namespace {
+// How many reads can be in flight at once
+const unsigned int MAX_PENDING_READS = 64;
+} // namespace
+
+bool AsyncFileReader::is_supported() {
+	return true;
+}
+
+bool AsyncFileReader::open(const char *path) {
+	close();
+
+	const int wide_length = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+	if (wide_length <= 0) {
+		return false;
+	}
+	StdVector<wchar_t> wide_path;
+	wide_path.resize(wide_length);
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, wide_path.data(), wide_length);
+
+	// Other handles must still be able to write to the file
+	HANDLE file = CreateFileW(
+			wide_path.data(),
+			GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+			nullptr
+	);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	HANDLE port = CreateIoCompletionPort(file, nullptr, 0, 1);
+	if (port == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	_file_handle = file;
+	_completion_port = port;
+	return true;
+}
+
+void AsyncFileReader::close() {
+	if (_file_handle == nullptr) {
+		return;
+	}
+	CloseHandle(_completion_port);
+	CloseHandle(_file_handle);
+	_completion_port = nullptr;
+	_file_handle = nullptr;
+}
+
+bool AsyncFileReader::is_open() const {
+	return _file_handle != nullptr;
+}
+
+void AsyncFileReader::read_batch(Span<const Request> requests, void *callback_data, CompletionFunc callback) const {
+	ZN_ASSERT_RETURN(is_open());
+
+	StdVector<OVERLAPPED> overlapped;
+	overlapped.resize(requests.size());
+
+	unsigned int next_request = 0;
+	unsigned int pending_count = 0;
+	unsigned int completed_count = 0;
+
+	while (completed_count < requests.size()) {
+		while (next_request < requests.size() && pending_count < MAX_PENDING_READS) {
+			const unsigned int request_index = next_request;
+			++next_request;
+
+			const Request &request = requests[request_index];
+			OVERLAPPED &ov = overlapped[request_index];
+			ZeroMemory(&ov, sizeof(OVERLAPPED));
+			ov.Offset = static_cast<DWORD>(request.offset);
+			ov.OffsetHigh = static_cast<DWORD>(request.offset >> 32);
+
+			// Even when the read completes immediately, a completion packet gets queued
+			if (ReadFile(_file_handle, request.buffer, request.size, nullptr, &ov)) {
+				++pending_count;
+			} else {
+				const DWORD error = GetLastError();
+				if (error == ERROR_IO_PENDING) {
+					++pending_count;
+				} else {
+					// No completion packet will come for this one
+					callback(callback_data, request_index, error == ERROR_HANDLE_EOF ? 0 : -1);
+					++completed_count;
+				}
+			}
+		}
+
+		if (pending_count == 0) {
+			continue;
+		}
+
+		DWORD read_size = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED *ov = nullptr;
+		const BOOL success = GetQueuedCompletionStatus(_completion_port, &read_size, &key, &ov, INFINITE);
+		if (ov == nullptr) {
+			// The port itself failed, there is no way to know which reads are done
+			ZN_PRINT_ERROR("Failed to wait for file reads");
+			return;
+		}
+
+		const unsigned int request_index = ov - overlapped.data();
+		int64_t result = read_size;
+		if (!success) {
+			result = GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+		}
+		--pending_count;
+		++completed_count;
+		callback(callback_data, request_index, result);
+	}
+}
+
+#elif defined(ZN_ASYNC_FILE_READER_POSIX)
+
+namespace {
+
+int64_t read_range(int fd, const AsyncFileReader::Request &request) {
+	uint32_t read_size = 0;
+	while (read_size < request.size) {
+		const ssize_t n = pread(fd, request.buffer + read_size, request.size - read_size, request.offset + read_size);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (n == 0) {
+			// End of file
+			break;
+		}
+		read_size += n;
+	}
+	return read_size;
+}
+
+void read_batch_sequential(
+		int fd,
+		Span<const AsyncFileReader::Request> requests,
+		void *callback_data,
+		AsyncFileReader::CompletionFunc callback
+) {
+	for (unsigned int i = 0; i < requests.size(); ++i) {
+		callback(callback_data, i, read_range(fd, requests[i]));
+	}
+}
+
+#ifdef ZN_ASYNC_FILE_READER_IO_URING
+
+// Minimal io_uring wrapper using system calls directly, so we don't depend on liburing.
+// One ring is created per thread the first time it reads a batch, and lives as long as the thread.
+class IoUring {
+public:
+	// How many reads can be in flight at once. The completion queue is twice as large by default, so it can't overflow.
+	static const unsigned int ENTRIES = 64;
+
+	~IoUring() {
+		destroy();
+	}
+
+	// Returns null if io_uring can't be used, for example on old kernels or when it is blocked in a sandbox.
+	static IoUring *get_for_current_thread() {
+		thread_local IoUring tls_ring;
+		if (!tls_ring._init_attempted) {
+			tls_ring._init_attempted = true;
+			tls_ring.init();
+		}
+		return tls_ring._fd != -1 ? &tls_ring : nullptr;
+	}
+
+	// Returns false if the ring stopped working. In that case, requests that didn't complete are not reported.
+	bool read_batch(
+			int file_fd,
+			Span<const AsyncFileReader::Request> requests,
+			void *callback_data,
+			AsyncFileReader::CompletionFunc callback,
+			StdVector<bool> &completed
+	) {
+		// READV is used instead of READ because it is available on older kernels
+		StdVector<iovec> iovecs;
+		iovecs.resize(requests.size());
+
+		unsigned int next_request = 0;
+		// Submitted entries the kernel hasn't consumed yet
+		unsigned int queued_count = 0;
+		unsigned int in_flight_count = 0;
+		unsigned int completed_count = 0;
+
+		while (completed_count < requests.size()) {
+			unsigned int sq_tail = *_sq_tail;
+			while (next_request < requests.size() && queued_count + in_flight_count < _sq_entries) {
+				const unsigned int request_index = next_request;
+				++next_request;
+
+				const AsyncFileReader::Request &request = requests[request_index];
+				iovec &iov = iovecs[request_index];
+				iov.iov_base = request.buffer;
+				iov.iov_len = request.size;
+
+				const unsigned int sqe_index = sq_tail & *_sq_mask;
+				io_uring_sqe &sqe = _sqes[sqe_index];
+				memset(&sqe, 0, sizeof(io_uring_sqe));
+				sqe.opcode = IORING_OP_READV;
+				sqe.fd = file_fd;
+				sqe.off = request.offset;
+				sqe.addr = reinterpret_cast<uint64_t>(&iov);
+				sqe.len = 1;
+				sqe.user_data = request_index;
+				_sq_array[sqe_index] = sqe_index;
+
+				++sq_tail;
+				++queued_count;
+			}
+			// Entries must be filled before the kernel can see the new tail
+			__atomic_store_n(_sq_tail, sq_tail, __ATOMIC_RELEASE);
+
+			const long submitted =
+					syscall(__NR_io_uring_enter, _fd, queued_count, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+			if (submitted < 0) {
+				if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+					return false;
+				}
+			} else {
+				queued_count -= submitted;
+				in_flight_count += submitted;
+			}
+
+			unsigned int cq_head = *_cq_head;
+			const unsigned int cq_tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+			while (cq_head != cq_tail) {
+				const io_uring_cqe &cqe = _cqes[cq_head & *_cq_mask];
+				const unsigned int request_index = cqe.user_data;
+				const int64_t result = cqe.res;
+				++cq_head;
+				// Free the slot before running the callback, which may take a while
+				__atomic_store_n(_cq_head, cq_head, __ATOMIC_RELEASE);
+
+				--in_flight_count;
+				++completed_count;
+				completed[request_index] = true;
+				callback(callback_data, request_index, result < 0 ? -1 : result);
+			}
+		}
+
+		return true;
+	}
+
+	void destroy() {
+		if (_fd == -1) {
+			return;
+		}
+		munmap(_sqes, _sqes_map_size);
+		if (_cq_map != _sq_map) {
+			munmap(_cq_map, _cq_map_size);
+		}
+		munmap(_sq_map, _sq_map_size);
+		::close(_fd);
+		_fd = -1;
+	}
+
+private:
+	void init() {
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		const long fd = syscall(__NR_io_uring_setup, ENTRIES, &params);
+		if (fd < 0) {
+			return;
+		}
+		_fd = fd;
+		_sq_entries = params.sq_entries;
+
+		_sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+		_cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single_map) {
+			_sq_map_size = _sq_map_size > _cq_map_size ? _sq_map_size : _cq_map_size;
+			_cq_map_size = _sq_map_size;
+		}
+
+		const int ring_fd = _fd;
+		auto map_ring = [ring_fd](size_t size, off_t offset) {
+			return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+		};
+
+		_sq_map = map_ring(_sq_map_size, IORING_OFF_SQ_RING);
+		if (_sq_map == MAP_FAILED) {
+			::close(_fd);
+			_fd = -1;
+			return;
+		}
+
+		if (single_map) {
+			_cq_map = _sq_map;
+		} else {
+			_cq_map = map_ring(_cq_map_size, IORING_OFF_CQ_RING);
+			if (_cq_map == MAP_FAILED) {
+				munmap(_sq_map, _sq_map_size);
+				::close(_fd);
+				_fd = -1;
+				return;
+			}
+		}
+
+		_sqes_map_size = params.sq_entries * sizeof(io_uring_sqe);
+		void *sqes = map_ring(_sqes_map_size, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED) {
+			if (_cq_map != _sq_map) {
+				munmap(_cq_map, _cq_map_size);
+			}
+			munmap(_sq_map, _sq_map_size);
+			::close(_fd);
+			_fd = -1;
+			return;
+		}
+		_sqes = static_cast<io_uring_sqe *>(sqes);
+
+		uint8_t *sq = static_cast<uint8_t *>(_sq_map);
+		_sq_tail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+		_sq_mask = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+		_sq_array = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+
+		uint8_t *cq = static_cast<uint8_t *>(_cq_map);
+		_cq_head = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+		_cq_tail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+		_cq_mask = reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+		_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+	}
+
+	int _fd = -1;
+	bool _init_attempted = false;
+	unsigned int _sq_entries = 0;
+
+	void *_sq_map = nullptr;
+	size_t _sq_map_size = 0;
+	void *_cq_map = nullptr;
+	size_t _cq_map_size = 0;
+	io_uring_sqe *_sqes = nullptr;
+	size_t _sqes_map_size = 0;
+
+	unsigned int *_sq_tail = nullptr;
+	unsigned int *_sq_mask = nullptr;
+	unsigned int *_sq_array = nullptr;
+
+	unsigned int *_cq_head = nullptr;
+	unsigned int *_cq_tail = nullptr;
+	unsigned int *_cq_mask = nullptr;
+	io_uring_cqe *_cqes = nullptr;
+};
+
+#endif // ZN_ASYNC_FILE_READER_IO_URING
+
+} // namespace
+
+bool AsyncFileReader::is_supported() {
+	return true;
+}
+
+bool AsyncFileReader::open(const char *path) {
+	close();
+	_fd = ::open(path, O_RDONLY);
+	return _fd != -1;
+}
+
+void AsyncFileReader::close() {
+	if (_fd == -1) {
+		return;
+	}
+	::close(_fd);
+	_fd = -1;
+}
+
+bool AsyncFileReader::is_open() const {
+	return _fd != -1;
+}
+
+void AsyncFileReader::read_batch(Span<const Request> requests, void *callback_data, CompletionFunc callback) const {
+	ZN_ASSERT_RETURN(is_open());
+
+#ifdef ZN_ASYNC_FILE_READER_IO_URING
+	// A single read doesn't benefit from the ring
+	if (requests.size() > 1) {
+		IoUring *ring = IoUring::get_for_current_thread();
+		if (ring != nullptr) {
+			StdVector<bool> completed;
+			completed.resize(requests.size(), false);
+			if (ring->read_batch(_fd, requests, callback_data, callback, completed)) {
+				return;
+			}
+			ZN_PRINT_ERROR("io_uring stopped working, falling back on regular reads");
+			// Destroying the ring cancels reads still in flight
+			ring->destroy();
+			for (unsigned int i = 0; i < requests.size(); ++i) {
+				if (!completed[i]) {
+					callback(callback_data, i, read_range(_fd, requests[i]));
+				}
+			}
+			return;
+		}
+	}
+#endif
+
+	read_batch_sequential(_fd, requests, callback_data, callback);
+}
+
+#else
+
+bool AsyncFileReader::is_supported() {
+	return false;
+}
+
+bool AsyncFileReader::open(const char *path) {
+	return false;
+}
+
+void AsyncFileReader::close() {}
+
+bool AsyncFileReader::is_open() const {
+	return false;
+}
+
+void AsyncFileReader::read_batch(Span<const Request> requests, void *callback_data, CompletionFunc callback) const {
+	ZN_PRINT_ERROR("Not supported on this platform");
+}
+
+#endif
+
+} // namespace zylann
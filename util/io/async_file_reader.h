@@ -0,0 +1,56 @@
+#ifndef ZN_ASYNC_FILE_READER_H
+#define ZN_ASYNC_FILE_READER_H
+
+#include "../containers/span.h"
+#include <cstdint>
+
+namespace zylann {
+
+// Reads many ranges of a file in one go. Where the platform allows it, all reads of a batch are submitted to the OS at
+// once (io_uring on Linux, overlapped I/O on Windows), so fast storage can serve them in parallel without needing more
+// threads. Each read is reported as soon as it completes, which lets the caller process results while others are still
+// in flight. Completion order is not the order of requests.
+// Other POSIX platforms, or Linux kernels without io_uring, fall back on reading ranges one after the other.
+// A reader may be used by one thread at a time.
+class AsyncFileReader {
+public:
+	struct Request {
+		uint64_t offset;
+		// Must hold at least `size` bytes, and remain valid until the batch is done.
+		uint8_t *buffer;
+		uint32_t size;
+	};
+
+	// Called once per request, on the thread that called `read_batch`. `read_size` is the number of bytes actually
+	// read, which can be less than requested at the end of the file. It is negative if the read failed.
+	typedef void (*CompletionFunc)(void *callback_data, unsigned int request_index, int64_t read_size);
+
+	AsyncFileReader() {}
+	~AsyncFileReader();
+
+	AsyncFileReader(const AsyncFileReader &) = delete;
+	AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+	static bool is_supported();
+
+	// `path` is an OS path encoded in UTF-8, not a Godot path.
+	bool open(const char *path);
+	void close();
+
+	bool is_open() const;
+
+	// Returns once all requests have completed.
+	void read_batch(Span<const Request> requests, void *callback_data, CompletionFunc callback) const;
+
+private:
+#ifdef _WIN32
+	void *_file_handle = nullptr;
+	void *_completion_port = nullptr;
+#else
+	int _fd = -1;
+#endif
+};
+
+} // namespace zylann
+
+#endif // ZN_ASYNC_FILE_READER_H
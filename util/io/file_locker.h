@@ -1,80 +1,127 @@
 #ifndef ZN_FILE_LOCKER_H
 #define ZN_FILE_LOCKER_H
 
+#include "../containers/fixed_array.h"
 #include "../containers/std_unordered_map.h"
 #include "../errors.h"
 #include "../string/std_string.h"
 #include "../thread/mutex.h"
 #include "../thread/rw_lock.h"
+#include <atomic>
+#include <cstdint>
 
 namespace zylann {
 
 // Performs software locking on paths,
 // so that multiple threads (controlled by this module) wanting to access the same file will lock a shared mutex.
+// Paths are spread over several maps by hash, each with its own mutex, so threads accessing different files rarely
+// wait for each other just to find their lock.
 class FileLocker {
 public:
+	struct File {
+		RWLock lock;
+		bool read_only;
+	};
+
+	struct Stats {
+		uint64_t lookups = 0;
+		// How many times finding the lock of a path had to wait for another thread
+		uint64_t contended_lookups = 0;
+		// How many times locking a file had to wait for another thread using the same file
+		uint64_t contended_locks = 0;
+	};
+
+	// Gets the lock associated to a path. The returned reference remains valid as long as the locker exists, so it can
+	// be kept to lock the same file again without looking it up.
+	File &get_file(const StdString &fpath) {
+		Shard &shard = _shards[std::hash<StdString>()(fpath) % SHARD_COUNT];
+		_lookups.fetch_add(1, std::memory_order_relaxed);
+		if (!shard.mutex.try_lock()) {
+			_contended_lookups.fetch_add(1, std::memory_order_relaxed);
+			shard.mutex.lock();
+		}
+		// Get or create.
+		// Note, we never remove entries from the map, and unordered_map does not invalidate pointers to values
+		File &file = shard.files[fpath];
+		shard.mutex.unlock();
+		return file;
+	}
+
 	void lock_read(const StdString &fpath) {
-		lock(fpath, true);
+		lock_read(get_file(fpath));
 	}
 
 	void lock_write(const StdString &fpath) {
-		lock(fpath, false);
+		lock_write(get_file(fpath));
 	}
 
 	void unlock(const StdString &fpath) {
-		unlock_internal(fpath);
+		File *fp = find_file(fpath);
+		ZN_ASSERT_RETURN(fp != nullptr);
+		unlock(*fp);
 	}
 
-private:
-	struct File {
-		RWLock lock;
-		bool read_only;
-	};
-
-	void lock(const StdString &fpath, bool read_only) {
-		File *fp = nullptr;
-		{
-			MutexLock lock(_files_mutex);
-			// Get or create.
-			// Note, we never remove entries from the map
-			fp = &_files[fpath];
+	void lock_read(File &file) {
+		if (!file.lock.read_try_lock()) {
+			_contended_locks.fetch_add(1, std::memory_order_relaxed);
+			file.lock.read_lock();
 		}
+		// The read lock was acquired. It means nobody is writing.
+		file.read_only = true;
+	}
 
-		if (read_only) {
-			fp->lock.read_lock();
-			// The read lock was acquired. It means nobody is writing.
-			fp->read_only = true;
-
-		} else {
-			fp->lock.write_lock();
-			// The write lock was acquired. It means only one thread is writing.
-			fp->read_only = false;
+	void lock_write(File &file) {
+		if (!file.lock.write_try_lock()) {
+			_contended_locks.fetch_add(1, std::memory_order_relaxed);
+			file.lock.write_lock();
 		}
+		// The write lock was acquired. It means only one thread is writing.
+		file.read_only = false;
 	}
 
-	void unlock_internal(const StdString &fpath) {
-		File *fp = nullptr;
-		{
-			MutexLock lock(_files_mutex);
-			auto it = _files.find(fpath);
-			if (it != _files.end()) {
-				fp = &it->second;
-			}
-		}
-		ZN_ASSERT_RETURN(fp != nullptr);
+	void unlock(File &file) {
 		// TODO FileAccess::reopen can have been called, nullifying my efforts to enforce thread sync :|
 		// So for now please don't do that
 
-		if (fp->read_only) {
-			fp->lock.read_unlock();
+		if (file.read_only) {
+			file.lock.read_unlock();
 		} else {
-			fp->lock.write_unlock();
+			file.lock.write_unlock();
 		}
 	}
 
+	// Statistics are approximate when the locker is in use, they are meant for profiling.
+	Stats get_stats() const {
+		Stats stats;
+		stats.lookups = _lookups.load(std::memory_order_relaxed);
+		stats.contended_lookups = _contended_lookups.load(std::memory_order_relaxed);
+		stats.contended_locks = _contended_locks.load(std::memory_order_relaxed);
+		return stats;
+	}
+
 private:
-	Mutex _files_mutex;
-	StdUnorderedMap<StdString, File> _files;
+	File *find_file(const StdString &fpath) {
+		Shard &shard = _shards[std::hash<StdString>()(fpath) % SHARD_COUNT];
+		MutexLock lock(shard.mutex);
+		auto it = shard.files.find(fpath);
+		if (it != shard.files.end()) {
+			return &it->second;
+		}
+		return nullptr;
+	}
+
+	static const unsigned int SHARD_COUNT = 16;
+
+	struct Shard {
+		Mutex mutex;
+		StdUnorderedMap<StdString, File> files;
+	};
+
+	FixedArray<Shard, SHARD_COUNT> _shards;
+
+	std::atomic_uint64_t _lookups = { 0 };
+	std::atomic_uint64_t _contended_lookups = { 0 };
+	std::atomic_uint64_t _contended_locks = { 0 };
 };
 
 } // namespace zylann
@@ -0,0 +1,155 @@
+#include "memory_mapped_file.h"
+#include "../containers/std_vector.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define ZN_MEMORY_MAPPED_FILE_WINDOWS
+
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ZN_MEMORY_MAPPED_FILE_POSIX
+#endif
+
+namespace zylann {
+
+MemoryMappedFile::~MemoryMappedFile() {
+	close();
+}
+
+#if defined(ZN_MEMORY_MAPPED_FILE_WINDOWS)
+
+bool MemoryMappedFile::is_supported() {
+	return true;
+}
+
+bool MemoryMappedFile::open(const char *path) {
+	close();
+
+	const int wide_length = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+	if (wide_length <= 0) {
+		return false;
+	}
+	StdVector<wchar_t> wide_path;
+	wide_path.resize(wide_length);
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, wide_path.data(), wide_length);
+
+	// Other handles must still be able to write to the file
+	HANDLE file = CreateFileW(
+			wide_path.data(),
+			GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL,
+			nullptr
+	);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		// Empty files can't be mapped
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	_file_handle = file;
+	_mapping_handle = mapping;
+	_data = static_cast<const uint8_t *>(data);
+	_size = file_size.QuadPart;
+	return true;
+}
+
+void MemoryMappedFile::close() {
+	if (_data == nullptr) {
+		return;
+	}
+	UnmapViewOfFile(_data);
+	CloseHandle(_mapping_handle);
+	CloseHandle(_file_handle);
+	_data = nullptr;
+	_size = 0;
+	_mapping_handle = nullptr;
+	_file_handle = nullptr;
+}
+
+#elif defined(ZN_MEMORY_MAPPED_FILE_POSIX)
+
+bool MemoryMappedFile::is_supported() {
+	return true;
+}
+
+bool MemoryMappedFile::open(const char *path) {
+	close();
+
+	const int fd = ::open(path, O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		// Empty files can't be mapped
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping remains valid after closing the descriptor
+	::close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	_data = static_cast<const uint8_t *>(data);
+	_size = st.st_size;
+	return true;
+}
+
+void MemoryMappedFile::close() {
+	if (_data == nullptr) {
+		return;
+	}
+	munmap(const_cast<uint8_t *>(_data), _size);
+	_data = nullptr;
+	_size = 0;
+}
+
+#else
+
+bool MemoryMappedFile::is_supported() {
+	return false;
+}
+
+bool MemoryMappedFile::open(const char *path) {
+	return false;
+}
+
+void MemoryMappedFile::close() {}
+
+#endif
+
+} // namespace zylann
@@ -0,0 +1,46 @@
+#ifndef ZN_MEMORY_MAPPED_FILE_H
+#define ZN_MEMORY_MAPPED_FILE_H
+
+#include "../containers/span.h"
+#include <cstdint>
+
+namespace zylann {
+
+// Read-only view of a whole file mapped in memory. Reading from it goes straight through the OS page cache, without
+// copying into buffers first.
+// The mapping doesn't follow changes in the file's size. If the file gets written to, it should be re-opened.
+// Not available on all platforms, in which case `open` fails.
+class MemoryMappedFile {
+public:
+	MemoryMappedFile() {}
+	~MemoryMappedFile();
+
+	MemoryMappedFile(const MemoryMappedFile &) = delete;
+	MemoryMappedFile &operator=(const MemoryMappedFile &) = delete;
+
+	static bool is_supported();
+
+	// `path` is an OS path encoded in UTF-8, not a Godot path.
+	bool open(const char *path);
+	void close();
+
+	inline bool is_open() const {
+		return _data != nullptr;
+	}
+
+	inline Span<const uint8_t> get_data() const {
+		return Span<const uint8_t>(_data, _size);
+	}
+
+private:
+	const uint8_t *_data = nullptr;
+	size_t _size = 0;
+#ifdef _WIN32
+	void *_file_handle = nullptr;
+	void *_mapping_handle = nullptr;
+#endif
+};
+
+} // namespace zylann
+
+#endif // ZN_MEMORY_MAPPED_FILE_H
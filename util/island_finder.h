@@ -1,19 +1,21 @@
 #ifndef ISLAND_FINDER_H
 #define ISLAND_FINDER_H
 
-#include "containers/fixed_array.h"
+#include "containers/dynamic_bitset.h"
 #include "containers/span.h"
+#include "containers/std_vector.h"
 #include "math/box3i.h"
 
 namespace zylann {
 
 // Scans a grid of binary values and returns another grid
 // where all contiguous islands are labelled with a unique ID.
-// It is based on a two-pass version of Connected-Component-Labeling.
+// It is based on a run-based version of Connected-Component-Labeling.
 //
-// In the first pass we scan the grid to identify connected chunks by giving them temporary IDs,
-// and marking equivalent ones if two chunks touch.
-// In the second pass, we replace IDs with consecutive ones starting from 1, which are more convenient to use.
+// First, the grid is packed into a bitset, and contiguous runs of set bits are extracted along Y. Searching runs
+// processes 64 cells at once, so the cost mostly depends on the number of runs rather than the number of cells.
+// Then, runs of neighbor columns that overlap are merged with a union-find, and each group gets an ID.
+// IDs are consecutive, start from 1, and are given in the order islands are first found in ZXY order.
 //
 // See https://en.wikipedia.org/wiki/Connected-component_labeling
 //
@@ -27,189 +29,162 @@ public:
 		CRASH_COND(output.size() != volume);
 		memset(output.data(), 0, volume * sizeof(uint8_t));
 
-		memset(_equivalences.data(), 0, MAX_ISLANDS * sizeof(uint8_t));
-
-		int top_label = 0;
-		int left_label = 0;
-		int back_label = 0;
-		int next_unique_label = 1;
-
-		Vector3i pos;
-		for (pos.z = 0; pos.z < box.size.z; ++pos.z) {
-			for (pos.x = 0; pos.x < box.size.x; ++pos.x) {
-				// TODO I initially wrote this algorithm in ZYX order, but translated to ZXY when porting to C++.
-				// `left` means `top`, and `top` means `left`.
-				left_label = 0;
-
-				for (pos.y = 0; pos.y < box.size.y; ++pos.y) {
-					int label = 0;
-
-					if (volume_predicate_func(box.position + pos)) {
-						if (pos.z > 0) {
-							back_label =
-									output[Vector3iUtil::get_zxy_index(Vector3i(pos.x, pos.y, pos.z - 1), box.size)];
-						} else {
-							back_label = 0;
+		_mask.resize_no_init(volume);
+		_mask.fill(false);
+
+		{
+			unsigned int i = 0;
+			Vector3i pos;
+			for (pos.z = 0; pos.z < box.size.z; ++pos.z) {
+				for (pos.x = 0; pos.x < box.size.x; ++pos.x) {
+					for (pos.y = 0; pos.y < box.size.y; ++pos.y) {
+						if (volume_predicate_func(box.position + pos)) {
+							_mask.set(i);
 						}
+						++i;
+					}
+				}
+			}
+		}
 
-						if (pos.x > 0) {
-							top_label =
-									output[Vector3iUtil::get_zxy_index(Vector3i(pos.x - 1, pos.y, pos.z), box.size)];
-						} else {
-							top_label = 0;
-						}
+		// Columns are indexed by X + Z * size.x, and span a contiguous range of the grid
+		const unsigned int columns_count = box.size.x * box.size.z;
+		const unsigned int column_size = box.size.y;
 
-						// TODO This soup of ifs is the first that worked for me, but there must be a way to simplify
-
-						if (left_label == 0 && top_label == 0 && back_label == 0) {
-							// TODO Make the algorithm return instead, it's hard for the caller to handle it otherwise
-							CRASH_COND(next_unique_label >= MAX_ISLANDS);
-							_equivalences[next_unique_label] = 0;
-							label = next_unique_label;
-							++next_unique_label;
-
-						} else if (left_label == 0 && top_label == 0) {
-							label = back_label;
-
-						} else if (left_label == 0 && back_label == 0) {
-							label = top_label;
-
-						} else if (top_label == 0 && back_label == 0) {
-							label = left_label;
-
-						} else if (left_label == 0 || //
-								   (top_label != 0 && back_label != 0 &&
-									(left_label == top_label || left_label == back_label))) {
-							if (top_label == back_label) {
-								label = back_label;
-
-							} else if (top_label < back_label) {
-								label = top_label;
-								add_equivalence(back_label, top_label);
-
-							} else {
-								label = back_label;
-								add_equivalence(top_label, back_label);
-							}
-
-						} else if (top_label == 0 || //
-								   (left_label != 0 && back_label != 0 &&
-									(top_label == left_label || top_label == back_label))) {
-							if (left_label == back_label) {
-								label = back_label;
-
-							} else if (left_label < back_label) {
-								label = left_label;
-								add_equivalence(back_label, left_label);
-
-							} else {
-								label = back_label;
-								add_equivalence(left_label, back_label);
-							}
-
-						} else if (back_label == 0 || //
-								   (left_label != 0 && top_label != 0 &&
-									(back_label == left_label || back_label == top_label))) {
-							if (left_label == top_label) {
-								label = top_label;
-
-							} else if (left_label < top_label) {
-								label = left_label;
-								add_equivalence(top_label, left_label);
-
-							} else {
-								label = top_label;
-								add_equivalence(left_label, top_label);
-							}
-
-						} else {
-							int a[3] = { left_label, top_label, back_label };
-							SortArray<int> sa;
-							sa.sort(a, 3);
-							label = a[0];
-							add_equivalence(a[1], a[0]);
-							add_equivalence(a[2], a[1]);
-						}
+		extract_runs(columns_count, column_size);
 
-						output[Vector3iUtil::get_zxy_index(pos, box.size)] = label;
-					}
+		_parents.resize(_runs.size());
+		for (unsigned int i = 0; i < _parents.size(); ++i) {
+			_parents[i] = i;
+		}
 
-					left_label = label;
+		for (int z = 0; z < box.size.z; ++z) {
+			for (int x = 0; x < box.size.x; ++x) {
+				const unsigned int column_index = x + z * box.size.x;
+				if (x > 0) {
+					unite_overlapping_runs(column_index, column_index - 1);
+				}
+				if (z > 0) {
+					unite_overlapping_runs(column_index, column_index - box.size.x);
 				}
 			}
 		}
 
-		flatten_equivalences();
-		int count = compact_labels(next_unique_label);
+		// Roots always come first in their group, so labels follow the order islands are found
+		unsigned int count = 0;
+		_run_labels.resize(_runs.size());
+		for (unsigned int run_index = 0; run_index < _runs.size(); ++run_index) {
+			const unsigned int root = find_root(run_index);
+			if (root == run_index) {
+				// TODO Make the algorithm return instead, it's hard for the caller to handle it otherwise
+				CRASH_COND(count + 1 >= MAX_ISLANDS);
+				++count;
+				_run_labels[run_index] = count;
+			} else {
+				_run_labels[run_index] = _run_labels[root];
+			}
+		}
+
+		for (unsigned int column_index = 0; column_index < columns_count; ++column_index) {
+			const unsigned int column_begin = column_index * column_size;
+			for (unsigned int run_index = _column_run_begins[column_index];
+				 run_index < _column_run_begins[column_index + 1];
+				 ++run_index) {
+				const Run run = _runs[run_index];
+				memset(output.data() + column_begin + run.begin, _run_labels[run_index], run.end - run.begin);
+			}
+		}
 
 		if (out_count != nullptr) {
 			*out_count = count;
 		}
+	}
 
-		for (unsigned int i = 0; i < output.size(); ++i) {
-			uint8_t &c = output[i];
-			uint8_t e = _equivalences[c];
-			if (e != 0) {
-				c = e;
+private:
+	// Range of contiguous set cells within a column
+	struct Run {
+		unsigned int begin;
+		unsigned int end;
+	};
+
+	void extract_runs(unsigned int columns_count, unsigned int column_size) {
+		_runs.clear();
+		_column_run_begins.resize(columns_count + 1);
+
+		for (unsigned int column_index = 0; column_index < columns_count; ++column_index) {
+			_column_run_begins[column_index] = _runs.size();
+
+			const unsigned int column_begin = column_index * column_size;
+			const unsigned int column_end = column_begin + column_size;
+			unsigned int i = column_begin;
+
+			while (true) {
+				const unsigned int run_begin = _mask.find_next_set(i);
+				if (run_begin >= column_end) {
+					break;
+				}
+				const unsigned int run_end = math::min(_mask.find_next_unset(run_begin), column_end);
+				_runs.push_back(Run{ run_begin - column_begin, run_end - column_begin });
+				i = run_end;
 			}
 		}
+
+		_column_run_begins[columns_count] = _runs.size();
 	}
 
-private:
-	void add_equivalence(int upper, int lower) {
-		CRASH_COND(upper <= lower);
-		int prev_lower = _equivalences[upper];
+	// Both columns have their runs sorted, so overlaps can be found in a single pass over them
+	void unite_overlapping_runs(unsigned int column_a, unsigned int column_b) {
+		unsigned int ia = _column_run_begins[column_a];
+		unsigned int ib = _column_run_begins[column_b];
+		const unsigned int ia_end = _column_run_begins[column_a + 1];
+		const unsigned int ib_end = _column_run_begins[column_b + 1];
 
-		if (prev_lower == 0) {
-			_equivalences[upper] = lower;
+		while (ia < ia_end && ib < ib_end) {
+			const Run a = _runs[ia];
+			const Run b = _runs[ib];
 
-		} else if (prev_lower > lower) {
-			_equivalences[upper] = lower;
-			add_equivalence(prev_lower, lower);
+			if (a.begin < b.end && b.begin < a.end) {
+				unite(ia, ib);
+			}
 
-		} else if (prev_lower < lower) {
-			add_equivalence(lower, prev_lower);
+			if (a.end < b.end) {
+				++ia;
+			} else if (b.end < a.end) {
+				++ib;
+			} else {
+				++ia;
+				++ib;
+			}
 		}
 	}
 
-	// Makes sure equivalences go straight to the label without transitive links
-	void flatten_equivalences() {
-		for (int i = 1; i < MAX_ISLANDS; ++i) {
-			int e = _equivalences[i];
-			if (e == 0) {
-				continue;
-			}
-			int e2 = _equivalences[e];
-			while (e2 != 0) {
-				e = e2;
-				e2 = _equivalences[e];
-			}
-			_equivalences[i] = e;
+	unsigned int find_root(unsigned int i) {
+		while (_parents[i] != i) {
+			// Path halving
+			_parents[i] = _parents[_parents[i]];
+			i = _parents[i];
 		}
+		return i;
 	}
 
-	// Make sure labels obtained from equivalences are sequential and start from 1.
-	// Returns total label count.
-	int compact_labels(int equivalences_count) {
-		int next_label = 1;
-		for (int i = 1; i < equivalences_count; ++i) {
-			const int e = _equivalences[i];
-			if (e == 0) {
-				// That label has no equivalent, give it an index
-				_equivalences[i] = next_label;
-				next_label += 1;
-			} else {
-				// That label has an equivalent, give it that index instead
-				int e2 = _equivalences[e];
-				_equivalences[i] = e2;
-			}
+	void unite(unsigned int a, unsigned int b) {
+		const unsigned int root_a = find_root(a);
+		const unsigned int root_b = find_root(b);
+		// The root of a group is always its first run
+		if (root_a < root_b) {
+			_parents[root_b] = root_a;
+		} else if (root_b < root_a) {
+			_parents[root_a] = root_b;
 		}
-		// We started from 1, but end with what would have been the next ID, so we subtract 1 to obtain the count
-		return next_label - 1;
 	}
 
-private:
-	FixedArray<uint8_t, MAX_ISLANDS> _equivalences;
+	// Buffers kept between scans to avoid re-allocating
+	DynamicBitset _mask;
+	StdVector<Run> _runs;
+	// Index of the first run of each column, with one more element so the end of the last column is known
+	StdVector<unsigned int> _column_run_begins;
+	StdVector<unsigned int> _parents;
+	StdVector<uint8_t> _run_labels;
 };
 
 } // namespace zylann
@@ -0,0 +1,78 @@
+#include "latency_histogram.h"
+
+namespace zylann {
+
+LatencyHistogram::LatencyHistogram() {
+	reset();
+}
+
+unsigned int LatencyHistogram::get_bucket_index(uint64_t usec) {
+	if (usec < SUB_BUCKET_COUNT) {
+		// Exact values
+		return usec;
+	}
+	const uint64_t max_value = (uint64_t(1) << MAX_VALUE_BITS) - 1;
+	if (usec > max_value) {
+		usec = max_value;
+	}
+	unsigned int msb = SUB_BUCKET_BITS;
+	while ((usec >> (msb + 1)) != 0) {
+		++msb;
+	}
+	const unsigned int shift = msb - SUB_BUCKET_BITS;
+	const unsigned int sub_bucket = (usec >> shift) & (SUB_BUCKET_COUNT - 1);
+	return (shift + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t LatencyHistogram::get_bucket_max_value(unsigned int bucket_index) {
+	if (bucket_index < SUB_BUCKET_COUNT) {
+		return bucket_index;
+	}
+	const unsigned int shift = bucket_index / SUB_BUCKET_COUNT - 1;
+	const unsigned int sub_bucket = bucket_index % SUB_BUCKET_COUNT;
+	const uint64_t min_value = uint64_t(SUB_BUCKET_COUNT + sub_bucket) << shift;
+	return min_value + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::get_snapshot(Snapshot &out_snapshot) const {
+	for (unsigned int i = 0; i < _buckets.size(); ++i) {
+		out_snapshot.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+	}
+	out_snapshot.count = _count.load(std::memory_order_relaxed);
+	out_snapshot.sum_usec = _sum_usec.load(std::memory_order_relaxed);
+	out_snapshot.max_usec = _max_usec.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset() {
+	for (std::atomic_uint32_t &bucket : _buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	_count.store(0, std::memory_order_relaxed);
+	_sum_usec.store(0, std::memory_order_relaxed);
+	_max_usec.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Snapshot::get_percentile_usec(float ratio) const {
+	// Buckets are summed rather than using `count`, which may be slightly off if values were being recorded while
+	// taking the snapshot
+	uint64_t total = 0;
+	for (const uint32_t bucket_count : buckets) {
+		total += bucket_count;
+	}
+	if (total == 0) {
+		return 0;
+	}
+	const uint64_t target = ratio <= 0.f ? 1 : ratio >= 1.f ? total : uint64_t(ratio * float(total) + 0.5f);
+	uint64_t accumulated = 0;
+	for (unsigned int i = 0; i < buckets.size(); ++i) {
+		accumulated += buckets[i];
+		if (accumulated >= target && accumulated > 0) {
+			// Don't report more than what was actually recorded
+			const uint64_t v = get_bucket_max_value(i);
+			return v < max_usec || max_usec == 0 ? v : max_usec;
+		}
+	}
+	return max_usec;
+}
+
+} // namespace zylann
@@ -0,0 +1,71 @@
+#ifndef ZN_LATENCY_HISTOGRAM_H
+#define ZN_LATENCY_HISTOGRAM_H
+
+#include "containers/fixed_array.h"
+#include <atomic>
+#include <cstdint>
+
+namespace zylann {
+
+// Distribution of durations in microseconds, which can be recorded from multiple threads without locking.
+// Buckets grow exponentially, each power of two being split in a few linear sub-buckets (similar to HDR histograms),
+// so the precision of a reported value is relative to its magnitude (about 12%).
+class LatencyHistogram {
+public:
+	static const unsigned int SUB_BUCKET_BITS = 3;
+	static const unsigned int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+	// Values above are clamped. That's about 12 days.
+	static const unsigned int MAX_VALUE_BITS = 40;
+	static const unsigned int BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+	struct Snapshot {
+		uint64_t count = 0;
+		uint64_t sum_usec = 0;
+		uint64_t max_usec = 0;
+		FixedArray<uint32_t, BUCKET_COUNT> buckets;
+
+		Snapshot() {
+			fill(buckets, uint32_t(0));
+		}
+
+		uint64_t get_mean_usec() const {
+			return count > 0 ? sum_usec / count : 0;
+		}
+
+		// Returns the smallest value at or under which the given ratio of recorded values fall, rounded up to the
+		// precision of buckets. `ratio` ranges from 0 to 1, so 0.99 gives the 99th percentile.
+		uint64_t get_percentile_usec(float ratio) const;
+	};
+
+	LatencyHistogram();
+
+	// Can be called from any thread
+	inline void add(uint64_t usec) {
+		_buckets[get_bucket_index(usec)].fetch_add(1, std::memory_order_relaxed);
+		_count.fetch_add(1, std::memory_order_relaxed);
+		_sum_usec.fetch_add(usec, std::memory_order_relaxed);
+		uint64_t prev_max = _max_usec.load(std::memory_order_relaxed);
+		while (usec > prev_max && !_max_usec.compare_exchange_weak(prev_max, usec, std::memory_order_relaxed)) {
+		}
+	}
+
+	// Values recorded while this runs may be partially taken into account
+	void get_snapshot(Snapshot &out_snapshot) const;
+
+	// Values recorded while this runs may be partially cleared
+	void reset();
+
+	static unsigned int get_bucket_index(uint64_t usec);
+	// Largest value falling into the given bucket
+	static uint64_t get_bucket_max_value(unsigned int bucket_index);
+
+private:
+	FixedArray<std::atomic_uint32_t, BUCKET_COUNT> _buckets;
+	std::atomic_uint64_t _count;
+	std::atomic_uint64_t _sum_usec;
+	std::atomic_uint64_t _max_usec;
+};
+
+} // namespace zylann
+
+#endif // ZN_LATENCY_HISTOGRAM_H
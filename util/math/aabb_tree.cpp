@@ -0,0 +1,309 @@
+#include "aabb_tree.h"
+#include "funcs.h"
+
+namespace zylann {
+
+namespace {
+
+// Half of the surface area, used as cost heuristic
+inline real_t get_cost(const AABB &aabb) {
+	const Vector3 s = aabb.size;
+	return s.x * s.y + s.y * s.z + s.z * s.x;
+}
+
+inline AABB merged(const AABB &a, const AABB &b) {
+	AABB m = a;
+	m.merge_with(b);
+	return m;
+}
+
+} // namespace
+
+uint32_t AABBTree::allocate_node() {
+	if (_free_list == NULL_NODE) {
+		_nodes.push_back(Node());
+		_nodes.back().height = 0;
+		return _nodes.size() - 1;
+	}
+	const uint32_t node_id = _free_list;
+	Node &node = _nodes[node_id];
+	_free_list = node.parent;
+	node = Node();
+	node.height = 0;
+	return node_id;
+}
+
+void AABBTree::free_node(uint32_t node_id) {
+	Node &node = _nodes[node_id];
+	node.parent = _free_list;
+	node.height = -1;
+	_free_list = node_id;
+}
+
+uint32_t AABBTree::add(const AABB &aabb, uint32_t data) {
+	const uint32_t leaf_id = allocate_node();
+	Node &leaf = _nodes[leaf_id];
+	leaf.aabb = aabb;
+	leaf.data = data;
+	insert_leaf(leaf_id);
+	++_leaf_count;
+	return leaf_id;
+}
+
+void AABBTree::remove(uint32_t leaf_id) {
+	ZN_ASSERT_RETURN(leaf_id < _nodes.size());
+	ZN_ASSERT_RETURN(_nodes[leaf_id].height == 0);
+	remove_leaf(leaf_id);
+	free_node(leaf_id);
+	--_leaf_count;
+}
+
+void AABBTree::update(uint32_t leaf_id, const AABB &aabb) {
+	ZN_ASSERT_RETURN(leaf_id < _nodes.size());
+	Node &leaf = _nodes[leaf_id];
+	ZN_ASSERT_RETURN(leaf.height == 0);
+	if (leaf.aabb == aabb) {
+		return;
+	}
+	remove_leaf(leaf_id);
+	leaf.aabb = aabb;
+	insert_leaf(leaf_id);
+}
+
+void AABBTree::clear() {
+	_nodes.clear();
+	_root = NULL_NODE;
+	_free_list = NULL_NODE;
+	_leaf_count = 0;
+}
+
+unsigned int AABBTree::get_height() const {
+	if (_root == NULL_NODE) {
+		return 0;
+	}
+	return _nodes[_root].height + 1;
+}
+
+void AABBTree::insert_leaf(uint32_t leaf_id) {
+	if (_root == NULL_NODE) {
+		_root = leaf_id;
+		_nodes[leaf_id].parent = NULL_NODE;
+		return;
+	}
+
+	const AABB leaf_aabb = _nodes[leaf_id].aabb;
+
+	// Find the best sibling, by descending into the child that increases total surface the least
+	uint32_t sibling_id = _root;
+	while (!_nodes[sibling_id].is_leaf()) {
+		const Node &node = _nodes[sibling_id];
+
+		const real_t area = get_cost(node.aabb);
+		const real_t combined_area = get_cost(merged(node.aabb, leaf_aabb));
+
+		// Cost of creating a new parent for this node and the new leaf
+		const real_t cost = 2 * combined_area;
+		// Minimum cost of pushing the leaf further down the tree
+		const real_t inheritance_cost = 2 * (combined_area - area);
+
+		const Node &child1 = _nodes[node.child1];
+		const Node &child2 = _nodes[node.child2];
+
+		real_t cost1 = get_cost(merged(child1.aabb, leaf_aabb)) + inheritance_cost;
+		if (!child1.is_leaf()) {
+			cost1 -= get_cost(child1.aabb);
+		}
+		real_t cost2 = get_cost(merged(child2.aabb, leaf_aabb)) + inheritance_cost;
+		if (!child2.is_leaf()) {
+			cost2 -= get_cost(child2.aabb);
+		}
+
+		if (cost < cost1 && cost < cost2) {
+			break;
+		}
+
+		sibling_id = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	// Create a new parent
+	const uint32_t old_parent_id = _nodes[sibling_id].parent;
+	const uint32_t new_parent_id = allocate_node();
+	// Don't keep references before that, allocation may have resized the vector
+	Node &new_parent = _nodes[new_parent_id];
+	Node &sibling = _nodes[sibling_id];
+	new_parent.parent = old_parent_id;
+	new_parent.aabb = merged(sibling.aabb, leaf_aabb);
+	new_parent.height = sibling.height + 1;
+	new_parent.child1 = sibling_id;
+	new_parent.child2 = leaf_id;
+	sibling.parent = new_parent_id;
+	_nodes[leaf_id].parent = new_parent_id;
+
+	if (old_parent_id != NULL_NODE) {
+		Node &old_parent = _nodes[old_parent_id];
+		if (old_parent.child1 == sibling_id) {
+			old_parent.child1 = new_parent_id;
+		} else {
+			old_parent.child2 = new_parent_id;
+		}
+	} else {
+		_root = new_parent_id;
+	}
+
+	refit_ancestors(_nodes[leaf_id].parent);
+}
+
+void AABBTree::remove_leaf(uint32_t leaf_id) {
+	if (leaf_id == _root) {
+		_root = NULL_NODE;
+		return;
+	}
+
+	const uint32_t parent_id = _nodes[leaf_id].parent;
+	const Node &parent = _nodes[parent_id];
+	const uint32_t grand_parent_id = parent.parent;
+	const uint32_t sibling_id = parent.child1 == leaf_id ? parent.child2 : parent.child1;
+
+	if (grand_parent_id != NULL_NODE) {
+		// Replace the parent with the sibling
+		Node &grand_parent = _nodes[grand_parent_id];
+		if (grand_parent.child1 == parent_id) {
+			grand_parent.child1 = sibling_id;
+		} else {
+			grand_parent.child2 = sibling_id;
+		}
+		_nodes[sibling_id].parent = grand_parent_id;
+		free_node(parent_id);
+		refit_ancestors(grand_parent_id);
+
+	} else {
+		_root = sibling_id;
+		_nodes[sibling_id].parent = NULL_NODE;
+		free_node(parent_id);
+	}
+}
+
+void AABBTree::refit_ancestors(uint32_t node_id) {
+	while (node_id != NULL_NODE) {
+		node_id = balance(node_id);
+
+		Node &node = _nodes[node_id];
+		const Node &child1 = _nodes[node.child1];
+		const Node &child2 = _nodes[node.child2];
+		node.height = 1 + math::max(child1.height, child2.height);
+		node.aabb = merged(child1.aabb, child2.aabb);
+
+		node_id = node.parent;
+	}
+}
+
+// Performs a left or right rotation if node A is imbalanced. Returns the new root of the subtree.
+uint32_t AABBTree::balance(uint32_t a_id) {
+	Node &a = _nodes[a_id];
+	if (a.is_leaf() || a.height < 2) {
+		return a_id;
+	}
+
+	const uint32_t b_id = a.child1;
+	const uint32_t c_id = a.child2;
+	Node &b = _nodes[b_id];
+	Node &c = _nodes[c_id];
+
+	const int32_t balance = c.height - b.height;
+
+	// Rotate C up
+	if (balance > 1) {
+		const uint32_t f_id = c.child1;
+		const uint32_t g_id = c.child2;
+		Node &f = _nodes[f_id];
+		Node &g = _nodes[g_id];
+
+		// Swap A and C
+		c.child1 = a_id;
+		c.parent = a.parent;
+		a.parent = c_id;
+
+		// A's old parent should point to C
+		if (c.parent != NULL_NODE) {
+			Node &c_parent = _nodes[c.parent];
+			if (c_parent.child1 == a_id) {
+				c_parent.child1 = c_id;
+			} else {
+				c_parent.child2 = c_id;
+			}
+		} else {
+			_root = c_id;
+		}
+
+		// Rotate
+		if (f.height > g.height) {
+			c.child2 = f_id;
+			a.child2 = g_id;
+			g.parent = a_id;
+			a.aabb = merged(b.aabb, g.aabb);
+			c.aabb = merged(a.aabb, f.aabb);
+			a.height = 1 + math::max(b.height, g.height);
+			c.height = 1 + math::max(a.height, f.height);
+		} else {
+			c.child2 = g_id;
+			a.child2 = f_id;
+			f.parent = a_id;
+			a.aabb = merged(b.aabb, f.aabb);
+			c.aabb = merged(a.aabb, g.aabb);
+			a.height = 1 + math::max(b.height, f.height);
+			c.height = 1 + math::max(a.height, g.height);
+		}
+
+		return c_id;
+	}
+
+	// Rotate B up
+	if (balance < -1) {
+		const uint32_t d_id = b.child1;
+		const uint32_t e_id = b.child2;
+		Node &d = _nodes[d_id];
+		Node &e = _nodes[e_id];
+
+		// Swap A and B
+		b.child1 = a_id;
+		b.parent = a.parent;
+		a.parent = b_id;
+
+		// A's old parent should point to B
+		if (b.parent != NULL_NODE) {
+			Node &b_parent = _nodes[b.parent];
+			if (b_parent.child1 == a_id) {
+				b_parent.child1 = b_id;
+			} else {
+				b_parent.child2 = b_id;
+			}
+		} else {
+			_root = b_id;
+		}
+
+		// Rotate
+		if (d.height > e.height) {
+			b.child2 = d_id;
+			a.child1 = e_id;
+			e.parent = a_id;
+			a.aabb = merged(c.aabb, e.aabb);
+			b.aabb = merged(a.aabb, d.aabb);
+			a.height = 1 + math::max(c.height, e.height);
+			b.height = 1 + math::max(a.height, d.height);
+		} else {
+			b.child2 = e_id;
+			a.child1 = d_id;
+			d.parent = a_id;
+			a.aabb = merged(c.aabb, d.aabb);
+			b.aabb = merged(a.aabb, e.aabb);
+			a.height = 1 + math::max(c.height, d.height);
+			b.height = 1 + math::max(a.height, e.height);
+		}
+
+		return b_id;
+	}
+
+	return a_id;
+}
+
+} // namespace zylann
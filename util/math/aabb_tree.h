@@ -0,0 +1,103 @@
+#ifndef ZN_AABB_TREE_H
+#define ZN_AABB_TREE_H
+
+#include "../containers/std_vector.h"
+#include "../errors.h"
+#include "transform_3d.h"
+
+namespace zylann {
+
+// Dynamic bounding volume hierarchy, used to quickly find which boxes intersect an area among many others.
+// Each leaf holds a box and a user-provided value. Leaves can be added, removed and moved at any time, and the tree
+// is kept balanced with rotations, similar to Box2D's dynamic tree.
+class AABBTree {
+public:
+	static const uint32_t NULL_NODE = 0xffffffff;
+
+	// Returns the ID of the new leaf
+	uint32_t add(const AABB &aabb, uint32_t data);
+	void remove(uint32_t leaf_id);
+	// Updates the box of a leaf after it moved or changed size
+	void update(uint32_t leaf_id, const AABB &aabb);
+	void clear();
+
+	inline const AABB &get_aabb(uint32_t leaf_id) const {
+		ZN_ASSERT(leaf_id < _nodes.size());
+		return _nodes[leaf_id].aabb;
+	}
+
+	inline uint32_t get_data(uint32_t leaf_id) const {
+		ZN_ASSERT(leaf_id < _nodes.size());
+		return _nodes[leaf_id].data;
+	}
+
+	inline unsigned int get_leaf_count() const {
+		return _leaf_count;
+	}
+
+	// Height of the tree, 0 if empty. Mostly for debugging.
+	unsigned int get_height() const;
+
+	// Calls `f(uint32_t data)` for each leaf intersecting the given box. Order is unspecified.
+	template <typename F>
+	void query(const AABB &aabb, F f) const {
+		if (_root == NULL_NODE) {
+			return;
+		}
+
+		static thread_local StdVector<uint32_t> tls_stack;
+		StdVector<uint32_t> &stack = tls_stack;
+		// Nested queries use the end of the stack
+		const size_t stack_begin = stack.size();
+		stack.push_back(_root);
+
+		while (stack.size() > stack_begin) {
+			const uint32_t node_id = stack.back();
+			stack.pop_back();
+
+			const Node &node = _nodes[node_id];
+			if (!node.aabb.intersects(aabb)) {
+				continue;
+			}
+
+			if (node.is_leaf()) {
+				f(node.data);
+			} else {
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+
+private:
+	struct Node {
+		AABB aabb;
+		// When the node is in the free list, this is the next free node
+		uint32_t parent = NULL_NODE;
+		uint32_t child1 = NULL_NODE;
+		uint32_t child2 = NULL_NODE;
+		// Leaves have height 0. Free nodes have height -1.
+		int32_t height = -1;
+		uint32_t data = 0;
+
+		inline bool is_leaf() const {
+			return child1 == NULL_NODE;
+		}
+	};
+
+	uint32_t allocate_node();
+	void free_node(uint32_t node_id);
+	void insert_leaf(uint32_t leaf_id);
+	void remove_leaf(uint32_t leaf_id);
+	uint32_t balance(uint32_t node_id);
+	void refit_ancestors(uint32_t node_id);
+
+	StdVector<Node> _nodes;
+	uint32_t _root = NULL_NODE;
+	uint32_t _free_list = NULL_NODE;
+	unsigned int _leaf_count = 0;
+};
+
+} // namespace zylann
+
+#endif // ZN_AABB_TREE_H
@@ -12,6 +12,7 @@ static constexpr float PI_32 = 3.1415926535897932384626433833;
 static constexpr double PI_64 = 3.1415926535897932384626433833;
 
 static const float INV_TAU_32 = 1.f / math::TAU_32;
+static const float SQRT2_32 = 1.41421356237;
 static const float SQRT3_32 = 1.73205080757;
 
 enum Axis { AXIS_X = 0, AXIS_Y = 1, AXIS_Z = 2 };
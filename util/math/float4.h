@@ -0,0 +1,212 @@
+#ifndef ZN_MATH_FLOAT4_H
+#define ZN_MATH_FLOAT4_H
+
+#include <cstdint>
+
+// SSE2 is always available on x86-64, and NEON on ARM64, so they can be used without checking CPU features at runtime
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZN_FLOAT4_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define ZN_FLOAT4_NEON
+#include <arm_neon.h>
+#endif
+
+namespace zylann::math {
+
+// Pack of 4 floats processed with SIMD instructions when the target supports them, falling back on scalar code
+// otherwise. Functions are defined so they give the exact same results as their scalar versions in `funcs.h` (no fused
+// operations, same handling of NaNs), which allows generic code to be written once for both `float` and `Float4`.
+struct Float4 {
+	static const unsigned int SIZE = 4;
+
+#if defined(ZN_FLOAT4_SSE2)
+	__m128 v;
+#elif defined(ZN_FLOAT4_NEON)
+	float32x4_t v;
+#else
+	float v[SIZE];
+#endif
+
+	Float4() {}
+
+	// Broadcasts the value to all lanes. Implicit so scalars can be mixed with packs in expressions.
+	Float4(float x) {
+#if defined(ZN_FLOAT4_SSE2)
+		v = _mm_set1_ps(x);
+#elif defined(ZN_FLOAT4_NEON)
+		v = vdupq_n_f32(x);
+#else
+		for (unsigned int i = 0; i < SIZE; ++i) {
+			v[i] = x;
+		}
+#endif
+	}
+
+	// Pointers don't need to be aligned
+	static inline Float4 load(const float *src) {
+		Float4 r;
+#if defined(ZN_FLOAT4_SSE2)
+		r.v = _mm_loadu_ps(src);
+#elif defined(ZN_FLOAT4_NEON)
+		r.v = vld1q_f32(src);
+#else
+		for (unsigned int i = 0; i < SIZE; ++i) {
+			r.v[i] = src[i];
+		}
+#endif
+		return r;
+	}
+
+	inline void store(float *dst) const {
+#if defined(ZN_FLOAT4_SSE2)
+		_mm_storeu_ps(dst, v);
+#elif defined(ZN_FLOAT4_NEON)
+		vst1q_f32(dst, v);
+#else
+		for (unsigned int i = 0; i < SIZE; ++i) {
+			dst[i] = v[i];
+		}
+#endif
+	}
+};
+
+#if defined(ZN_FLOAT4_SSE2)
+
+inline Float4 make_float4(__m128 v) {
+	Float4 r;
+	r.v = v;
+	return r;
+}
+
+inline Float4 operator+(const Float4 a, const Float4 b) {
+	return make_float4(_mm_add_ps(a.v, b.v));
+}
+
+inline Float4 operator-(const Float4 a, const Float4 b) {
+	return make_float4(_mm_sub_ps(a.v, b.v));
+}
+
+inline Float4 operator*(const Float4 a, const Float4 b) {
+	return make_float4(_mm_mul_ps(a.v, b.v));
+}
+
+inline Float4 operator/(const Float4 a, const Float4 b) {
+	return make_float4(_mm_div_ps(a.v, b.v));
+}
+
+// Same as `a < b ? a : b`, which is exactly what `minps` does
+inline Float4 min(const Float4 a, const Float4 b) {
+	return make_float4(_mm_min_ps(a.v, b.v));
+}
+
+// Same as `a > b ? a : b`, which is exactly what `maxps` does
+inline Float4 max(const Float4 a, const Float4 b) {
+	return make_float4(_mm_max_ps(a.v, b.v));
+}
+
+// Same as `a < b ? if_less : otherwise`, per lane
+inline Float4 select_less(const Float4 a, const Float4 b, const Float4 if_less, const Float4 otherwise) {
+	const __m128 mask = _mm_cmplt_ps(a.v, b.v);
+	return make_float4(_mm_or_ps(_mm_and_ps(mask, if_less.v), _mm_andnot_ps(mask, otherwise.v)));
+}
+
+#elif defined(ZN_FLOAT4_NEON)
+
+inline Float4 make_float4(float32x4_t v) {
+	Float4 r;
+	r.v = v;
+	return r;
+}
+
+inline Float4 operator+(const Float4 a, const Float4 b) {
+	return make_float4(vaddq_f32(a.v, b.v));
+}
+
+inline Float4 operator-(const Float4 a, const Float4 b) {
+	return make_float4(vsubq_f32(a.v, b.v));
+}
+
+inline Float4 operator*(const Float4 a, const Float4 b) {
+	return make_float4(vmulq_f32(a.v, b.v));
+}
+
+inline Float4 operator/(const Float4 a, const Float4 b) {
+	return make_float4(vdivq_f32(a.v, b.v));
+}
+
+// `vminq_f32` propagates NaNs, unlike the scalar version, so a comparison is used instead
+inline Float4 min(const Float4 a, const Float4 b) {
+	return make_float4(vbslq_f32(vcltq_f32(a.v, b.v), a.v, b.v));
+}
+
+inline Float4 max(const Float4 a, const Float4 b) {
+	return make_float4(vbslq_f32(vcgtq_f32(a.v, b.v), a.v, b.v));
+}
+
+inline Float4 select_less(const Float4 a, const Float4 b, const Float4 if_less, const Float4 otherwise) {
+	return make_float4(vbslq_f32(vcltq_f32(a.v, b.v), if_less.v, otherwise.v));
+}
+
+#else
+
+template <typename F>
+inline Float4 float4_per_lane(const Float4 a, const Float4 b, F f) {
+	Float4 r;
+	for (unsigned int i = 0; i < Float4::SIZE; ++i) {
+		r.v[i] = f(a.v[i], b.v[i]);
+	}
+	return r;
+}
+
+inline Float4 operator+(const Float4 a, const Float4 b) {
+	return float4_per_lane(a, b, [](float x, float y) { return x + y; });
+}
+
+inline Float4 operator-(const Float4 a, const Float4 b) {
+	return float4_per_lane(a, b, [](float x, float y) { return x - y; });
+}
+
+inline Float4 operator*(const Float4 a, const Float4 b) {
+	return float4_per_lane(a, b, [](float x, float y) { return x * y; });
+}
+
+inline Float4 operator/(const Float4 a, const Float4 b) {
+	return float4_per_lane(a, b, [](float x, float y) { return x / y; });
+}
+
+inline Float4 min(const Float4 a, const Float4 b) {
+	return float4_per_lane(a, b, [](float x, float y) { return x < y ? x : y; });
+}
+
+inline Float4 max(const Float4 a, const Float4 b) {
+	return float4_per_lane(a, b, [](float x, float y) { return x > y ? x : y; });
+}
+
+inline Float4 select_less(const Float4 a, const Float4 b, const Float4 if_less, const Float4 otherwise) {
+	Float4 r;
+	for (unsigned int i = 0; i < Float4::SIZE; ++i) {
+		r.v[i] = a.v[i] < b.v[i] ? if_less.v[i] : otherwise.v[i];
+	}
+	return r;
+}
+
+#endif
+
+inline Float4 clamp(const Float4 x, const Float4 min_value, const Float4 max_value) {
+	return min(max(x, min_value), max_value);
+}
+
+// Same as `math::sign_nonzero`
+inline Float4 sign_nonzero(const Float4 x) {
+	return select_less(x, 0.f, -1.f, 1.f);
+}
+
+// Same formula as `Math::lerp`
+inline Float4 lerp(const Float4 a, const Float4 b, const Float4 t) {
+	return a + (b - a) * t;
+}
+
+} // namespace zylann::math
+
+#endif // ZN_MATH_FLOAT4_H
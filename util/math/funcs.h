@@ -12,6 +12,7 @@ using namespace godot;
 
 #include "constants.h"
 #include <cmath>
+#include <cstdint>
 #include <type_traits>
 
 namespace zylann::math {
@@ -273,6 +274,38 @@ inline unsigned int get_next_power_of_two_32_shift(unsigned int num) {
 	return 0;
 }
 
+// Returns the index of the lowest bit set in `v`, which must not be zero.
+inline unsigned int get_lowest_bit_index(uint64_t v) {
+#ifdef DEBUG_ENABLED
+	ZN_ASSERT(v != 0);
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(v);
+#else
+	unsigned int i = 0;
+	while ((v & 1) == 0) {
+		v >>= 1;
+		++i;
+	}
+	return i;
+#endif
+}
+
+// Returns how many bits are set in `v`.
+inline unsigned int get_bit_count(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(v);
+#else
+	unsigned int count = 0;
+	while (v != 0) {
+		// Clears the lowest bit set
+		v &= v - 1;
+		++count;
+	}
+	return count;
+#endif
+}
+
 // If the provided address `a` is not aligned to the number of bytes specified in `align`,
 // returns the next aligned address. `align` must be a power of two.
 inline size_t alignup(size_t a, size_t align) {
@@ -0,0 +1,105 @@
+#ifndef ZN_MATH_MORTON_H
+#define ZN_MATH_MORTON_H
+
+#include "vector3i.h"
+#include <cstdint>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace zylann::math {
+
+// Morton (Z-order) indexing of 3D grids. Interleaving coordinate bits keeps voxels close to each other in all axes
+// close in memory too, unlike linear layouts where neighbors along two of the axes are a whole row or slice away.
+// Coordinates must be positive and use up to 10 bits each.
+// Bits are interleaved in the same order as the ZXY convention used in the rest of the module: Y is the least
+// significant, then X, then Z.
+
+static const uint32_t MORTON_MASK_Y = 0x09249249;
+static const uint32_t MORTON_MASK_X = MORTON_MASK_Y << 1;
+static const uint32_t MORTON_MASK_Z = MORTON_MASK_Y << 2;
+
+// Spreads the 10 lower bits of `v` so there are 2 zero bits between each of them
+inline uint32_t morton_spread_bits_3d(uint32_t v) {
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Inverse of `morton_spread_bits_3d`
+inline uint32_t morton_compact_bits_3d(uint32_t v) {
+	v &= 0x09249249;
+	v = (v | (v >> 2)) & 0x030c30c3;
+	v = (v | (v >> 4)) & 0x0300f00f;
+	v = (v | (v >> 8)) & 0x030000ff;
+	v = (v | (v >> 16)) & 0x000003ff;
+	return v;
+}
+
+inline uint32_t encode_morton_3d(Vector3i pos) {
+#if defined(__BMI2__)
+	return _pdep_u32(pos.y, MORTON_MASK_Y) | _pdep_u32(pos.x, MORTON_MASK_X) | _pdep_u32(pos.z, MORTON_MASK_Z);
+#else
+	return morton_spread_bits_3d(pos.y) | (morton_spread_bits_3d(pos.x) << 1) | (morton_spread_bits_3d(pos.z) << 2);
+#endif
+}
+
+inline Vector3i decode_morton_3d(uint32_t i) {
+#if defined(__BMI2__)
+	return Vector3i(_pext_u32(i, MORTON_MASK_X), _pext_u32(i, MORTON_MASK_Y), _pext_u32(i, MORTON_MASK_Z));
+#else
+	return Vector3i(morton_compact_bits_3d(i >> 1), morton_compact_bits_3d(i), morton_compact_bits_3d(i >> 2));
+#endif
+}
+
+// 64-bit variants, for coordinates using up to 21 bits each
+
+// Spreads the 21 lower bits of `v` so there are 2 zero bits between each of them
+inline uint64_t morton_spread_bits_3d_u64(uint64_t v) {
+	v &= 0x1fffff;
+	v = (v | (v << 32)) & 0x001f00000000ffff;
+	v = (v | (v << 16)) & 0x001f0000ff0000ff;
+	v = (v | (v << 8)) & 0x100f00f00f00f00f;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3;
+	v = (v | (v << 2)) & 0x1249249249249249;
+	return v;
+}
+
+// Inverse of `morton_spread_bits_3d_u64`
+inline uint64_t morton_compact_bits_3d_u64(uint64_t v) {
+	v &= 0x1249249249249249;
+	v = (v | (v >> 2)) & 0x10c30c30c30c30c3;
+	v = (v | (v >> 4)) & 0x100f00f00f00f00f;
+	v = (v | (v >> 8)) & 0x001f0000ff0000ff;
+	v = (v | (v >> 16)) & 0x001f00000000ffff;
+	v = (v | (v >> 32)) & 0x00000000001fffff;
+	return v;
+}
+
+inline uint64_t encode_morton_3d_u64(Vector3i pos) {
+	return morton_spread_bits_3d_u64(static_cast<uint32_t>(pos.y)) |
+			(morton_spread_bits_3d_u64(static_cast<uint32_t>(pos.x)) << 1) |
+			(morton_spread_bits_3d_u64(static_cast<uint32_t>(pos.z)) << 2);
+}
+
+inline Vector3i decode_morton_3d_u64(uint64_t i) {
+	return Vector3i(
+			morton_compact_bits_3d_u64(i >> 1), morton_compact_bits_3d_u64(i), morton_compact_bits_3d_u64(i >> 2)
+	);
+}
+
+// Offsets a Morton index along one axis without decoding it. `axis_mask` is one of the `MORTON_MASK_*` constants, and
+// `encoded_delta` is the delta spread along that axis. Negative deltas work when spreading their 10-bit two's
+// complement, for example `morton_spread_bits_3d(-1)` decrements.
+inline uint32_t add_morton_3d(uint32_t i, uint32_t encoded_delta, uint32_t axis_mask) {
+	// Setting bits of other axes makes carries propagate across them
+	return (((i | ~axis_mask) + (encoded_delta & axis_mask)) & axis_mask) | (i & ~axis_mask);
+}
+
+} // namespace zylann::math
+
+#endif // ZN_MATH_MORTON_H
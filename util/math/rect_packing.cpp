@@ -0,0 +1,148 @@
+#include "rect_packing.h"
+#include "../profiling.h"
+#include "funcs.h"
+#include <algorithm>
+#include <cmath>
+
+namespace zylann::math {
+
+namespace {
+
+// Horizontal part of the top outline of rectangles placed so far
+struct SkylineSegment {
+	int x;
+	int y;
+	int width;
+};
+
+// Finds the height at which a rectangle of the given width can be placed with its left side on the segment at
+// `begin_index`. Returns false if it would exceed the width of the area.
+bool get_skyline_fit_y(
+		Span<const SkylineSegment> skyline,
+		unsigned int begin_index,
+		int width,
+		int area_width,
+		int &out_y
+) {
+	const int x = skyline[begin_index].x;
+	if (x + width > area_width) {
+		return false;
+	}
+	int y = 0;
+	for (unsigned int i = begin_index; i < skyline.size() && skyline[i].x < x + width; ++i) {
+		y = max(y, skyline[i].y);
+	}
+	out_y = y;
+	return true;
+}
+
+void add_skyline_level(StdVector<SkylineSegment> &skyline, unsigned int index, Vector2i pos, Vector2i size) {
+	skyline.insert(skyline.begin() + index, SkylineSegment{ pos.x, pos.y + size.y, size.x });
+
+	const int end_x = pos.x + size.x;
+
+	// Shrink or remove segments now under the new one
+	for (unsigned int i = index + 1; i < skyline.size();) {
+		SkylineSegment &s = skyline[i];
+		if (s.x >= end_x) {
+			break;
+		}
+		const int shrink = end_x - s.x;
+		if (shrink < s.width) {
+			s.x += shrink;
+			s.width -= shrink;
+			break;
+		}
+		skyline.erase(skyline.begin() + i);
+	}
+
+	// Merge neighbors at the same height
+	for (unsigned int i = 0; i + 1 < skyline.size();) {
+		if (skyline[i].y == skyline[i + 1].y) {
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		} else {
+			++i;
+		}
+	}
+}
+
+} // namespace
+
+void pack_rectangles_skyline(Span<const Vector2i> sizes, StdVector<Vector2i> &out_positions, Vector2i &out_size) {
+	ZN_PROFILE_SCOPE();
+
+	out_positions.resize(sizes.size());
+	out_size = Vector2i();
+
+	if (sizes.size() == 0) {
+		return;
+	}
+
+	int64_t total_area = 0;
+	int max_width = 0;
+	for (const Vector2i size : sizes) {
+		ZN_ASSERT_RETURN(size.x >= 0 && size.y >= 0);
+		total_area += int64_t(size.x) * int64_t(size.y);
+		max_width = max(max_width, size.x);
+	}
+
+	// Packing is never perfect, leave a bit of room so the result isn't much taller than wide
+	const int area_width = max(max_width, static_cast<int>(std::ceil(std::sqrt(double(total_area) * 1.1))));
+
+	// Placing taller rectangles first leaves fewer holes
+	StdVector<unsigned int> order;
+	order.resize(sizes.size());
+	for (unsigned int i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&sizes](unsigned int a, unsigned int b) {
+		const Vector2i sa = sizes[a];
+		const Vector2i sb = sizes[b];
+		if (sa.y != sb.y) {
+			return sa.y > sb.y;
+		}
+		if (sa.x != sb.x) {
+			return sa.x > sb.x;
+		}
+		return a < b;
+	});
+
+	StdVector<SkylineSegment> skyline;
+	skyline.push_back(SkylineSegment{ 0, 0, area_width });
+
+	for (const unsigned int rect_index : order) {
+		const Vector2i size = sizes[rect_index];
+
+		// Bottom-left: pick the spot where the top of the rectangle is lowest, then leftmost
+		unsigned int best_index = 0;
+		int best_y = 0;
+		int best_top = -1;
+
+		for (unsigned int i = 0; i < skyline.size(); ++i) {
+			int y;
+			if (!get_skyline_fit_y(to_span(skyline), i, size.x, area_width, y)) {
+				continue;
+			}
+			if (best_top == -1 || y + size.y < best_top) {
+				best_index = i;
+				best_y = y;
+				best_top = y + size.y;
+			}
+		}
+
+		// Should not happen because the area is at least as wide as the widest rectangle
+		ZN_ASSERT_RETURN(best_top != -1);
+
+		const Vector2i pos(skyline[best_index].x, best_y);
+		out_positions[rect_index] = pos;
+		out_size.x = max(out_size.x, pos.x + size.x);
+		out_size.y = max(out_size.y, pos.y + size.y);
+
+		if (size.x > 0) {
+			add_skyline_level(skyline, best_index, pos, size);
+		}
+	}
+}
+
+} // namespace zylann::math
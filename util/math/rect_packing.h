@@ -0,0 +1,19 @@
+#ifndef ZN_MATH_RECT_PACKING_H
+#define ZN_MATH_RECT_PACKING_H
+
+#include "../containers/span.h"
+#include "../containers/std_vector.h"
+#include "vector2i.h"
+
+namespace zylann::math {
+
+// Packs rectangles into an area as small as possible without overlap, using a skyline bottom-left heuristic. The width
+// of the area is chosen so it ends up roughly square. Outputs the position of each rectangle, in the same order as
+// `sizes`, and the size of the area containing all of them.
+// This is much faster than exhaustive approaches like Godot's `Geometry2D::make_atlas`, at the cost of leaving a bit
+// more empty space.
+void pack_rectangles_skyline(Span<const Vector2i> sizes, StdVector<Vector2i> &out_positions, Vector2i &out_size);
+
+} // namespace zylann::math
+
+#endif // ZN_MATH_RECT_PACKING_H
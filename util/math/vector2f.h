@@ -17,6 +17,10 @@ inline Vector2f floor(const Vector2f a) {
 	return Vector2f(Math::floor(a.x), Math::floor(a.y));
 }
 
+inline Vector2f round(const Vector2f a) {
+	return Vector2f(Math::round(a.x), Math::round(a.y));
+}
+
 inline Vector2f lerp(const Vector2f a, const Vector2f b, const float t) {
 	return Vector2f(Math::lerp(a.x, b.x, t), Math::lerp(a.y, b.y, t));
 }
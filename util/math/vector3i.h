@@ -197,7 +197,9 @@ inline Vector3i operator%(const Vector3i &a, int b) {
 
 ZN_GODOT_NAMESPACE_END
 
-// For Godot
+// For Godot.
+// Results of this one are also used as seeds for procedural placement, so it must not change. Hash tables should use
+// `std::hash<Vector3i>` instead, which clusters a lot less with neighboring positions.
 struct Vector3iHasher {
 	static inline uint32_t hash(const Vector3i &v) {
 		uint32_t hash = zylann::hash_djb2_one_32(v.x);
@@ -217,7 +219,7 @@ namespace std {
 template <>
 struct hash<Vector3i> {
 	size_t operator()(const Vector3i &v) const {
-		return Vector3iHasher::hash(v);
+		return zylann::hash_coordinates_3d_folded_64(v.x, v.y, v.z);
 	}
 };
 } // namespace std
@@ -0,0 +1,104 @@
+#include "linear_allocator.h"
+#include "../math/funcs.h"
+#include "memory.h"
+
+namespace zylann {
+
+namespace {
+
+inline uint8_t *align_up(uint8_t *p, size_t alignment) {
+	const uintptr_t a = reinterpret_cast<uintptr_t>(p);
+	return reinterpret_cast<uint8_t *>((a + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+}
+
+// Keeps the start of chunk memory aligned for any fundamental type
+constexpr size_t CHUNK_HEADER_SIZE = (sizeof(void *) + sizeof(size_t) + alignof(std::max_align_t) - 1) &
+		~(alignof(std::max_align_t) - 1);
+
+} // namespace
+
+LinearAllocator::LinearAllocator(size_t default_chunk_size) : _default_chunk_size(default_chunk_size) {}
+
+LinearAllocator::~LinearAllocator() {
+	free_chunks();
+}
+
+void *LinearAllocator::allocate(size_t size, size_t alignment) {
+	ZN_ASSERT(math::is_power_of_two(alignment));
+
+	uint8_t *p = align_up(_top, alignment);
+	if (_current_chunk == nullptr || p + size > _end) {
+		push_chunk(size + alignment);
+		p = align_up(_top, alignment);
+	}
+
+	uint8_t *new_top = p + size;
+	_used_size += new_top - _top;
+	_top = new_top;
+	return p;
+}
+
+void LinearAllocator::deallocate(void *p, size_t size) {
+	uint8_t *p8 = static_cast<uint8_t *>(p);
+	if (p8 + size == _top) {
+		// Alignment padding before it stays used, it is small
+		_used_size -= size;
+		_top = p8;
+	}
+}
+
+void LinearAllocator::reset() {
+	if (_current_chunk == nullptr) {
+		return;
+	}
+	if (_current_chunk->previous != nullptr || _capacity > MAX_RETAINED_SIZE) {
+		// Several chunks were needed, or too much memory was used
+		const size_t capacity = _capacity;
+		free_chunks();
+		if (capacity <= MAX_RETAINED_SIZE) {
+			// Allocate a single chunk that can hold all of what was used
+			push_chunk(capacity);
+		}
+	} else {
+		_top = reinterpret_cast<uint8_t *>(_current_chunk) + CHUNK_HEADER_SIZE;
+	}
+	_used_size = 0;
+}
+
+unsigned int LinearAllocator::get_chunk_count() const {
+	unsigned int count = 0;
+	for (const Chunk *chunk = _current_chunk; chunk != nullptr; chunk = chunk->previous) {
+		++count;
+	}
+	return count;
+}
+
+void LinearAllocator::push_chunk(size_t min_size) {
+	const size_t size = CHUNK_HEADER_SIZE + math::max(min_size, _default_chunk_size);
+	uint8_t *mem = static_cast<uint8_t *>(ZN_ALLOC(size));
+	ZN_ASSERT(mem != nullptr);
+
+	Chunk *chunk = reinterpret_cast<Chunk *>(mem);
+	chunk->previous = _current_chunk;
+	chunk->size = size;
+	_current_chunk = chunk;
+	_capacity += size;
+
+	_top = mem + CHUNK_HEADER_SIZE;
+	_end = mem + size;
+}
+
+void LinearAllocator::free_chunks() {
+	Chunk *chunk = _current_chunk;
+	while (chunk != nullptr) {
+		Chunk *previous = chunk->previous;
+		ZN_FREE(chunk);
+		chunk = previous;
+	}
+	_current_chunk = nullptr;
+	_top = nullptr;
+	_end = nullptr;
+	_capacity = 0;
+}
+
+} // namespace zylann
@@ -0,0 +1,104 @@
+#ifndef ZN_LINEAR_ALLOCATOR_H
+#define ZN_LINEAR_ALLOCATOR_H
+
+#include "../errors.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace zylann {
+
+// Allocates memory by moving an offset forward in large chunks, and frees everything at once when reset. Allocating
+// is very cheap and doesn't lock, but memory is not freed individually (except the last allocation). Intended for
+// temporary data used by a single thread, such as during the execution of a task.
+// Not thread-safe.
+class LinearAllocator {
+public:
+	static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+	// When resetting, memory is kept for next uses up to this size. Beyond, it is freed, so a rare task needing a lot
+	// of temporary memory doesn't keep it allocated forever.
+	static const size_t MAX_RETAINED_SIZE = 4 * 1024 * 1024;
+
+	LinearAllocator(size_t default_chunk_size = DEFAULT_CHUNK_SIZE);
+	~LinearAllocator();
+
+	LinearAllocator(const LinearAllocator &) = delete;
+	LinearAllocator &operator=(const LinearAllocator &) = delete;
+
+	// Alignment must be a power of two. Never returns null.
+	void *allocate(size_t size, size_t alignment);
+
+	// Only gives memory back if it was the last allocation, which often happens with short-lived temporaries.
+	// Otherwise it is freed on the next reset.
+	void deallocate(void *p, size_t size);
+
+	// Frees all allocations. If more than one chunk was used, they are replaced with a single chunk large enough for
+	// all of them, so next uses of similar size don't need more allocations.
+	void reset();
+
+	// Bytes allocated since the last reset, including padding for alignment
+	size_t get_used_size() const {
+		return _used_size;
+	}
+
+	// Bytes currently allocated from the heap
+	size_t get_capacity() const {
+		return _capacity;
+	}
+
+	unsigned int get_chunk_count() const;
+
+private:
+	struct Chunk {
+		Chunk *previous;
+		size_t size;
+	};
+
+	void push_chunk(size_t min_size);
+	void free_chunks();
+
+	Chunk *_current_chunk = nullptr;
+	// Start and end of free memory in the current chunk
+	uint8_t *_top = nullptr;
+	uint8_t *_end = nullptr;
+	size_t _default_chunk_size;
+	size_t _used_size = 0;
+	size_t _capacity = 0;
+};
+
+// Adapter allowing standard containers to use a `LinearAllocator`, like `StdVector<T, StdLinearAllocator<T>>`. The
+// allocator must outlive containers using it.
+template <class T>
+struct StdLinearAllocator {
+	typedef T value_type;
+
+	LinearAllocator *allocator;
+
+	StdLinearAllocator(LinearAllocator &p_allocator) : allocator(&p_allocator) {}
+
+	template <class U>
+	constexpr StdLinearAllocator(const StdLinearAllocator<U> &other) noexcept : allocator(other.allocator) {}
+
+	[[nodiscard]] T *allocate(std::size_t n) {
+		ZN_ASSERT(n <= std::numeric_limits<std::size_t>::max() / sizeof(T));
+		return static_cast<T *>(allocator->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *p, std::size_t n) noexcept {
+		allocator->deallocate(p, n * sizeof(T));
+	}
+};
+
+template <class T, class U>
+bool operator==(const StdLinearAllocator<T> &a, const StdLinearAllocator<U> &b) {
+	return a.allocator == b.allocator;
+}
+
+template <class T, class U>
+bool operator!=(const StdLinearAllocator<T> &a, const StdLinearAllocator<U> &b) {
+	return a.allocator != b.allocator;
+}
+
+} // namespace zylann
+
+#endif // ZN_LINEAR_ALLOCATOR_H
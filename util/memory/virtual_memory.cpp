@@ -0,0 +1,130 @@
+#include "virtual_memory.h"
+#include "../errors.h"
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define ZN_VIRTUAL_MEMORY_WINDOWS
+
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#include <sys/mman.h>
+#define ZN_VIRTUAL_MEMORY_POSIX
+#endif
+
+namespace zylann::virtual_memory {
+
+#if defined(ZN_VIRTUAL_MEMORY_WINDOWS)
+
+bool is_supported() {
+	return true;
+}
+
+void *allocate_aligned_pages(size_t size, size_t alignment, bool &out_large_pages) {
+	ZN_ASSERT_RETURN_V(size % LARGE_PAGE_SIZE == 0, nullptr);
+	ZN_ASSERT_RETURN_V(alignment % LARGE_PAGE_SIZE == 0, nullptr);
+
+	const size_t os_large_page_size = GetLargePageMinimum();
+	// Large page allocations are only aligned to the large page size
+	if (os_large_page_size != 0 && alignment == os_large_page_size && size % os_large_page_size == 0) {
+		// Only works if the process has the "Lock pages in memory" privilege, which is rarely the case
+		void *ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (ptr != nullptr) {
+			out_large_pages = true;
+			return ptr;
+		}
+	}
+
+	out_large_pages = false;
+
+	// Windows can't release part of a reservation, so we find an aligned address within a larger reservation, release
+	// it and reserve again exactly there. Another thread could take that range in between, so we retry a few times.
+	for (unsigned int attempt = 0; attempt < 8; ++attempt) {
+		void *reserved = VirtualAlloc(nullptr, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+		if (reserved == nullptr) {
+			return nullptr;
+		}
+		const uintptr_t aligned = (reinterpret_cast<uintptr_t>(reserved) + alignment - 1) & ~(alignment - 1);
+		VirtualFree(reserved, 0, MEM_RELEASE);
+		void *ptr = VirtualAlloc(reinterpret_cast<void *>(aligned), size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (ptr != nullptr) {
+			return ptr;
+		}
+	}
+	return nullptr;
+}
+
+void free_aligned_pages(void *ptr, size_t size) {
+	ZN_ASSERT_RETURN(ptr != nullptr);
+	VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+#elif defined(ZN_VIRTUAL_MEMORY_POSIX)
+
+bool is_supported() {
+	return true;
+}
+
+void *allocate_aligned_pages(size_t size, size_t alignment, bool &out_large_pages) {
+	ZN_ASSERT_RETURN_V(size % LARGE_PAGE_SIZE == 0, nullptr);
+	ZN_ASSERT_RETURN_V(alignment % LARGE_PAGE_SIZE == 0, nullptr);
+
+	// Map more than needed, then unmap the parts before and after the aligned range
+	const size_t mapped_size = size + alignment;
+	void *mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapped == MAP_FAILED) {
+		return nullptr;
+	}
+
+	const uintptr_t begin = reinterpret_cast<uintptr_t>(mapped);
+	const uintptr_t aligned = (begin + alignment - 1) & ~(alignment - 1);
+	const size_t head_size = aligned - begin;
+	const size_t tail_size = mapped_size - head_size - size;
+	if (head_size > 0) {
+		munmap(mapped, head_size);
+	}
+	if (tail_size > 0) {
+		munmap(reinterpret_cast<void *>(aligned + size), tail_size);
+	}
+
+	void *ptr = reinterpret_cast<void *>(aligned);
+
+#ifdef MADV_HUGEPAGE
+	// Transparent huge pages. Pages get merged lazily by the kernel, if it is enabled on the system.
+	out_large_pages = madvise(ptr, size, MADV_HUGEPAGE) == 0;
+#else
+	out_large_pages = false;
+#endif
+
+	return ptr;
+}
+
+void free_aligned_pages(void *ptr, size_t size) {
+	ZN_ASSERT_RETURN(ptr != nullptr);
+	munmap(ptr, size);
+}
+
+#else
+
+bool is_supported() {
+	return false;
+}
+
+void *allocate_aligned_pages(size_t size, size_t alignment, bool &out_large_pages) {
+	out_large_pages = false;
+	return nullptr;
+}
+
+void free_aligned_pages(void *ptr, size_t size) {
+	ZN_PRINT_ERROR("Not supported on this platform");
+}
+
+#endif
+
+} // namespace zylann::virtual_memory
@@ -0,0 +1,25 @@
+#ifndef ZN_VIRTUAL_MEMORY_H
+#define ZN_VIRTUAL_MEMORY_H
+
+#include <cstddef>
+
+namespace zylann::virtual_memory {
+
+// Size of large pages we try to use. 1GB pages exist on some platforms, but they can only be obtained from memory
+// reserved by the system administrator, so we don't request them.
+static const size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Tells if pages can be obtained directly from the OS on this platform. If not, `allocate_aligned_pages` always fails.
+bool is_supported();
+
+// Obtains committed memory from the OS, whose address is a multiple of `alignment`. `size` and `alignment` must be
+// multiples of `LARGE_PAGE_SIZE`. The OS is asked to back it with large pages, though it may not honor it:
+// `out_large_pages` tells if the request was accepted. Returns `nullptr` on failure.
+void *allocate_aligned_pages(size_t size, size_t alignment, bool &out_large_pages);
+
+// Gives back memory obtained with `allocate_aligned_pages` to the OS. `size` must be the same as the one requested.
+void free_aligned_pages(void *ptr, size_t size);
+
+} // namespace zylann::virtual_memory
+
+#endif // ZN_VIRTUAL_MEMORY_H
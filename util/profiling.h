@@ -17,17 +17,28 @@
 
 #else
 
-#define ZN_PROFILE_SCOPE()
+// Without Tracy, scopes are recorded by the built-in tracer, which does nothing unless enabled at runtime.
+// See `profiling_tracer.h`.
+
+#include "profiling_tracer.h"
+
+#define ZN_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ZN_PROFILE_CONCAT(a, b) ZN_PROFILE_CONCAT_IMPL(a, b)
+
+#define ZN_PROFILE_SCOPE()                                                                                             \
+	const zylann::profiling_tracer::Scope ZN_PROFILE_CONCAT(zn_profile_scope_, __LINE__)(__FUNCTION__)
 // Name must be static const char* (usually string litteral)
-#define ZN_PROFILE_SCOPE_NAMED(name)
-#define ZN_PROFILE_MARK_FRAME()
+#define ZN_PROFILE_SCOPE_NAMED(name)                                                                                   \
+	const zylann::profiling_tracer::Scope ZN_PROFILE_CONCAT(zn_profile_scope_, __LINE__)(name)
+#define ZN_PROFILE_MARK_FRAME() zylann::profiling_tracer::add_instant("Frame")
 #define ZN_PROFILE_PLOT(name, number)
-#define ZN_PROFILE_MESSAGE(message)
+// Message must be static const char* (usually string litteral)
+#define ZN_PROFILE_MESSAGE(message) zylann::profiling_tracer::add_instant(message)
 // Name must be const char*. An internal copy will be made so it can be temporary.
 // Size does not include the terminating character.
 #define ZN_PROFILE_MESSAGE_DYN(message, size)
 // Name must be const char*. An internal copy will be made so it can be temporary.
-#define ZN_PROFILE_SET_THREAD_NAME(name)
+#define ZN_PROFILE_SET_THREAD_NAME(name) zylann::profiling_tracer::set_current_thread_name(name)
 
 #endif
 
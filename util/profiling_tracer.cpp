@@ -0,0 +1,209 @@
+#include "profiling_tracer.h"
+#include "containers/std_vector.h"
+#include "memory/memory.h"
+#include "string/std_stringstream.h"
+#include "thread/mutex.h"
+
+#include <chrono>
+#include <sstream>
+
+namespace zylann::profiling_tracer {
+
+namespace detail {
+std::atomic_bool g_enabled = { false };
+} // namespace detail
+
+namespace {
+
+// Duration used to mark instant events
+const uint64_t INSTANT_DURATION = 0xffffffffffffffff;
+
+struct Event {
+	const char *name;
+	uint64_t begin_time_usec;
+	uint64_t duration_usec;
+};
+
+struct ThreadEvents {
+	// Only written by the thread owning the buffer
+	StdVector<Event> events;
+	// Total amount of events written so far. The ring buffer index is this value modulo its size.
+	std::atomic_uint32_t write_count = { 0 };
+	uint32_t thread_id = 0;
+	StdString thread_name;
+	Mutex thread_name_mutex;
+	// When the thread ends, its events are kept until cleared
+	std::atomic_bool thread_exited = { false };
+};
+
+struct Registry {
+	StdVector<UniquePtr<ThreadEvents>> threads;
+	Mutex mutex;
+	uint32_t next_thread_id = 1;
+};
+
+Registry &get_registry() {
+	// Never destroyed, threads may still record while static destructors run
+	static Registry *s_registry = ZN_NEW(Registry);
+	return *s_registry;
+}
+
+// Releases the buffer of a thread when it exits
+struct ThreadEventsHandle {
+	ThreadEvents *events = nullptr;
+	// Kept until the buffer gets created
+	StdString thread_name;
+
+	~ThreadEventsHandle() {
+		if (events != nullptr) {
+			events->thread_exited.store(true, std::memory_order_release);
+		}
+	}
+};
+
+thread_local ThreadEventsHandle tls_thread_events;
+
+ThreadEvents &get_thread_events() {
+	ThreadEventsHandle &handle = tls_thread_events;
+	if (handle.events == nullptr) {
+		// Allocated on first use, so threads that never record while enabled don't use memory
+		UniquePtr<ThreadEvents> events = make_unique_instance<ThreadEvents>();
+		events->events.resize(EVENTS_PER_THREAD);
+		events->thread_name = handle.thread_name;
+		handle.events = events.get();
+		Registry &registry = get_registry();
+		MutexLock mlock(registry.mutex);
+		events->thread_id = registry.next_thread_id;
+		++registry.next_thread_id;
+		registry.threads.push_back(std::move(events));
+	}
+	return *handle.events;
+}
+
+void add_event(const char *name, uint64_t begin_time_usec, uint64_t duration_usec) {
+	ThreadEvents &te = get_thread_events();
+	const uint32_t index = te.write_count.load(std::memory_order_relaxed);
+	te.events[index % te.events.size()] = Event{ name, begin_time_usec, duration_usec };
+	te.write_count.store(index + 1, std::memory_order_release);
+}
+
+void write_json_string(StdStringStream &ss, const char *s) {
+	ss << '"';
+	for (; *s != '\0'; ++s) {
+		const char c = *s;
+		if (c == '"' || c == '\\') {
+			ss << '\\' << c;
+		} else if (c >= 0 && c < 0x20) {
+			// Control characters are not expected in names
+			ss << ' ';
+		} else {
+			ss << c;
+		}
+	}
+	ss << '"';
+}
+
+} // namespace
+
+namespace detail {
+
+uint64_t get_time_usec() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+				   std::chrono::steady_clock::now().time_since_epoch()
+	)
+			.count();
+}
+
+void add_scope(const char *name, uint64_t begin_time_usec, uint64_t end_time_usec) {
+	add_event(name, begin_time_usec, end_time_usec - begin_time_usec);
+}
+
+} // namespace detail
+
+void set_enabled(bool enabled) {
+	detail::g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void add_instant(const char *name) {
+	if (is_enabled()) {
+		add_event(name, detail::get_time_usec(), INSTANT_DURATION);
+	}
+}
+
+void set_current_thread_name(const char *name) {
+	// Names are always kept, because threads are usually named before recording gets enabled
+	ThreadEventsHandle &handle = tls_thread_events;
+	handle.thread_name = name;
+	if (handle.events != nullptr) {
+		MutexLock mlock(handle.events->thread_name_mutex);
+		handle.events->thread_name = name;
+	}
+}
+
+void clear() {
+	Registry &registry = get_registry();
+	MutexLock mlock(registry.mutex);
+	for (unsigned int i = 0; i < registry.threads.size();) {
+		ThreadEvents &te = *registry.threads[i];
+		if (te.thread_exited.load(std::memory_order_acquire)) {
+			registry.threads[i] = std::move(registry.threads.back());
+			registry.threads.pop_back();
+			continue;
+		}
+		// Not thread-safe with the owning thread, though at worst a few events get lost or remain
+		te.write_count.store(0, std::memory_order_relaxed);
+		++i;
+	}
+}
+
+StdString get_chrome_trace_json() {
+	StdStringStream ss;
+	ss << "{\"traceEvents\":[";
+	bool first = true;
+
+	Registry &registry = get_registry();
+	MutexLock mlock(registry.mutex);
+
+	for (const UniquePtr<ThreadEvents> &te_ptr : registry.threads) {
+		const ThreadEvents &te = *te_ptr;
+
+		{
+			MutexLock tnlock(te.thread_name_mutex);
+			if (!te.thread_name.empty()) {
+				if (!first) {
+					ss << ',';
+				}
+				first = false;
+				ss << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << te.thread_id
+				   << ",\"args\":{\"name\":";
+				write_json_string(ss, te.thread_name.c_str());
+				ss << "}}";
+			}
+		}
+
+		const uint32_t write_count = te.write_count.load(std::memory_order_acquire);
+		const uint32_t capacity = te.events.size();
+		const uint32_t begin_index = write_count > capacity ? write_count - capacity : 0;
+
+		for (uint32_t i = begin_index; i < write_count; ++i) {
+			const Event &event = te.events[i % capacity];
+			if (!first) {
+				ss << ',';
+			}
+			first = false;
+			ss << "{\"name\":";
+			write_json_string(ss, event.name);
+			if (event.duration_usec == INSTANT_DURATION) {
+				ss << ",\"ph\":\"i\",\"s\":\"t\"";
+			} else {
+				ss << ",\"ph\":\"X\",\"dur\":" << event.duration_usec;
+			}
+			ss << ",\"ts\":" << event.begin_time_usec << ",\"pid\":0,\"tid\":" << te.thread_id << '}';
+		}
+	}
+
+	ss << "]}";
+	return ss.str();
+}
+
+} // namespace zylann::profiling_tracer
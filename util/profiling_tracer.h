@@ -0,0 +1,64 @@
+#ifndef ZN_PROFILING_TRACER_H
+#define ZN_PROFILING_TRACER_H
+
+#include "string/std_string.h"
+#include <atomic>
+#include <cstdint>
+
+namespace zylann {
+
+// Lightweight timeline recorder used by profiling macros when Tracy is not available, so timelines can still be
+// obtained from builds shipped to players. It is compiled in but disabled by default, in which case each profiled scope
+// only costs a branch.
+// Each thread records its scopes in its own ring buffer, so only the most recent events are kept.
+namespace profiling_tracer {
+
+// Events recorded per thread before the oldest ones start being overwritten
+static const unsigned int EVENTS_PER_THREAD = 32768;
+
+namespace detail {
+extern std::atomic_bool g_enabled;
+uint64_t get_time_usec();
+void add_scope(const char *name, uint64_t begin_time_usec, uint64_t end_time_usec);
+} // namespace detail
+
+inline bool is_enabled() {
+	return detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+// Can be called from any thread. Scopes that started before enabling are not recorded.
+void set_enabled(bool enabled);
+
+// Name must be static const char* (usually string litteral)
+void add_instant(const char *name);
+
+// An internal copy will be made so it can be temporary
+void set_current_thread_name(const char *name);
+
+// Removes all recorded events
+void clear();
+
+// Gets recorded events in Chrome trace event format, which can be opened in `chrome://tracing` or Perfetto.
+// Threads keep recording while this runs, so it is preferable to disable recording first.
+StdString get_chrome_trace_json();
+
+class Scope {
+public:
+	// Name must be static const char* (usually string litteral)
+	inline Scope(const char *name) : _name(name), _begin_time_usec(is_enabled() ? detail::get_time_usec() : 0) {}
+
+	inline ~Scope() {
+		if (_begin_time_usec != 0) {
+			detail::add_scope(_name, _begin_time_usec, detail::get_time_usec());
+		}
+	}
+
+private:
+	const char *_name;
+	const uint64_t _begin_time_usec;
+};
+
+} // namespace profiling_tracer
+} // namespace zylann
+
+#endif // ZN_PROFILING_TRACER_H
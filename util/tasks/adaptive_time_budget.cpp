@@ -0,0 +1,42 @@
+#include "adaptive_time_budget.h"
+#include "../math/funcs.h"
+
+namespace zylann {
+
+void AdaptiveTimeBudget::set_max_budget_usec(uint32_t usec) {
+	_max_budget_usec = usec;
+	_budget_usec = math::min(usec, get_upper_bound_usec());
+}
+
+void AdaptiveTimeBudget::set_target_fps(uint32_t fps) {
+	_target_frame_time_usec = fps > 0 ? 1000000 / fps : 0;
+	_budget_usec = math::min(_max_budget_usec, get_upper_bound_usec());
+}
+
+uint32_t AdaptiveTimeBudget::get_upper_bound_usec() const {
+	if (_target_frame_time_usec == 0) {
+		return _max_budget_usec;
+	}
+	return static_cast<uint32_t>(_target_frame_time_usec * MAX_FRAME_RATIO);
+}
+
+void AdaptiveTimeBudget::update(uint64_t frame_time_usec) {
+	if (_target_frame_time_usec == 0) {
+		_budget_usec = _max_budget_usec;
+		return;
+	}
+
+	const uint32_t upper_bound = get_upper_bound_usec();
+	// The lower bound can't be above the upper bound with very high target rates
+	const uint32_t lower_bound = math::min(MIN_BUDGET_USEC, upper_bound);
+
+	if (frame_time_usec > static_cast<uint64_t>(_target_frame_time_usec * LATE_FRAME_TOLERANCE)) {
+		_budget_usec = math::max(static_cast<uint32_t>(_budget_usec * DECREASE_FACTOR), lower_bound);
+	} else {
+		// Frames are often capped by V-Sync, so being on time doesn't tell how much time is left. Growing slowly
+		// probes for it, and late frames will shrink the budget again.
+		_budget_usec = math::min(_budget_usec + INCREASE_STEP_USEC, upper_bound);
+	}
+}
+
+} // namespace zylann
@@ -0,0 +1,46 @@
+#ifndef ZYLANN_ADAPTIVE_TIME_BUDGET_H
+#define ZYLANN_ADAPTIVE_TIME_BUDGET_H
+
+#include <cstdint>
+
+namespace zylann {
+
+// Time budget given to work spread over frames, adjusted from measured frame durations so frames stay within a target
+// rate. Shrinks quickly when frames are too long, and grows slowly when they are fast enough.
+// Without a target rate, the budget stays at its maximum.
+class AdaptiveTimeBudget {
+public:
+	static constexpr uint32_t MIN_BUDGET_USEC = 1000;
+	static constexpr uint32_t INCREASE_STEP_USEC = 250;
+	// Portion of the target frame duration the budget can use at most
+	static constexpr float MAX_FRAME_RATIO = 0.5f;
+	// Frames longer than the target by less than this ratio are not considered late, because frame durations jitter
+	static constexpr float LATE_FRAME_TOLERANCE = 1.1f;
+	static constexpr float DECREASE_FACTOR = 0.75f;
+
+	// Budget used without target rate. With a target rate, it is the initial budget.
+	void set_max_budget_usec(uint32_t usec);
+
+	// 0 disables adaptation.
+	// When set, the budget can go up to a portion of the target frame duration, even above the maximum budget, so
+	// throughput is not left unused when the target rate is low (like on servers).
+	void set_target_fps(uint32_t fps);
+
+	// Call once per frame with the duration of the previous frame
+	void update(uint64_t frame_time_usec);
+
+	inline uint32_t get_budget_usec() const {
+		return _budget_usec;
+	}
+
+private:
+	uint32_t get_upper_bound_usec() const;
+
+	uint32_t _max_budget_usec = 8000;
+	uint32_t _target_frame_time_usec = 0;
+	uint32_t _budget_usec = 8000;
+};
+
+} // namespace zylann
+
+#endif // ZYLANN_ADAPTIVE_TIME_BUDGET_H
@@ -4,6 +4,7 @@
 #include "../containers/span.h"
 #include "../containers/std_vector.h"
 #include <atomic>
+#include <cstdint>
 
 namespace zylann {
 
@@ -60,8 +61,30 @@ public:
 		return _next_tasks.size() > 0;
 	}
 
+	// Optional amount of work represented by tracked tasks (bytes to save for example), to report progress more finely
+	// than with the count of tasks. Tasks add their amount before being scheduled, and post it once done.
+	void add_total_work(uint64_t amount) {
+		_total_work += amount;
+	}
+
+	void post_work_done(uint64_t amount) {
+		_done_work += amount;
+	}
+
+	uint64_t get_total_work() const {
+		return _total_work;
+	}
+
+	uint64_t get_remaining_work() const {
+		const uint64_t total = _total_work;
+		const uint64_t done = _done_work;
+		return done < total ? total - done : 0;
+	}
+
 private:
 	std::atomic_int _count;
+	std::atomic_uint64_t _total_work = { 0 };
+	std::atomic_uint64_t _done_work = { 0 };
 	std::atomic_bool _aborted;
 	std::atomic_bool _tasks_have_started;
 	bool _count_was_set = false;
@@ -0,0 +1,30 @@
+#include "backlog_governor.h"
+#include "../math/funcs.h"
+
+namespace zylann {
+
+void BacklogGovernor::set_max_pending_tasks(uint32_t count) {
+	_max_pending_tasks = count;
+	if (count == 0) {
+		_scale = 1.f;
+	}
+}
+
+void BacklogGovernor::update(uint32_t pending_tasks, uint64_t now_msec) {
+	if (_max_pending_tasks == 0) {
+		return;
+	}
+	if (now_msec - _last_update_time_msec < UPDATE_PERIOD_MSEC) {
+		return;
+	}
+	_last_update_time_msec = now_msec;
+
+	if (pending_tasks > _max_pending_tasks) {
+		_scale = math::max(_scale - DECREASE_STEP, MIN_SCALE);
+
+	} else if (pending_tasks < static_cast<uint32_t>(_max_pending_tasks * LOW_BACKLOG_RATIO)) {
+		_scale = math::min(_scale + INCREASE_STEP, 1.f);
+	}
+}
+
+} // namespace zylann
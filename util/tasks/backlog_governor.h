@@ -0,0 +1,43 @@
+#ifndef ZYLANN_BACKLOG_GOVERNOR_H
+#define ZYLANN_BACKLOG_GOVERNOR_H
+
+#include <cstdint>
+
+namespace zylann {
+
+// Scale to apply to streaming distances, lowered while more tasks are pending than threads can keep up with, so work
+// close to viewers doesn't wait behind far away blocks. It is restored progressively once the backlog is gone.
+// Two thresholds are used so the scale doesn't oscillate around a single value.
+class BacklogGovernor {
+public:
+	static constexpr float MIN_SCALE = 0.5f;
+	static constexpr float DECREASE_STEP = 0.1f;
+	static constexpr float INCREASE_STEP = 0.05f;
+	// Changing distances causes tasks to be cancelled or scheduled, so the backlog needs some time to reflect it
+	static constexpr uint32_t UPDATE_PERIOD_MSEC = 250;
+	// Backlog under which distances grow back, as a ratio of the maximum
+	static constexpr float LOW_BACKLOG_RATIO = 0.25f;
+
+	// Pending tasks above which distances shrink. 0 disables the governor.
+	void set_max_pending_tasks(uint32_t count);
+
+	inline uint32_t get_max_pending_tasks() const {
+		return _max_pending_tasks;
+	}
+
+	// Call every frame with the current amount of pending tasks
+	void update(uint32_t pending_tasks, uint64_t now_msec);
+
+	inline float get_scale() const {
+		return _scale;
+	}
+
+private:
+	uint32_t _max_pending_tasks = 0;
+	uint64_t _last_update_time_msec = 0;
+	float _scale = 1.f;
+};
+
+} // namespace zylann
+
+#endif // ZYLANN_BACKLOG_GOVERNOR_H
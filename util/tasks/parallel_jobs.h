@@ -0,0 +1,110 @@
+#ifndef ZN_PARALLEL_JOBS_H
+#define ZN_PARALLEL_JOBS_H
+
+#include "../containers/fixed_array.h"
+#include "../containers/span.h"
+#include "../math/funcs.h"
+#include "../memory/memory.h"
+#include "threaded_task.h"
+#include <atomic>
+#include <memory>
+
+namespace zylann {
+
+// Optional access to a thread pool, used to spread jobs over multiple threads.
+struct ParallelJobsScheduler {
+	typedef void (*ScheduleTasksCallback)(Span<IThreadedTask *> tasks);
+
+	ScheduleTasksCallback schedule_tasks = nullptr;
+	// How many tasks can be scheduled at most to help the calling thread
+	unsigned int max_helpers = 0;
+
+	inline bool is_valid() const {
+		return schedule_tasks != nullptr && max_helpers > 0;
+	}
+};
+
+namespace parallel_jobs_detail {
+
+struct State {
+	std::atomic_uint32_t next_job_index = { 0 };
+	std::atomic_uint32_t completed_job_count = { 0 };
+	uint32_t job_count = 0;
+	void (*run_job)(void *context, uint32_t job_index) = nullptr;
+	void *context = nullptr;
+
+	// Runs jobs until none are left to pick.
+	// The context is only accessed after picking a job, so threads coming too late never touch it.
+	void work() {
+		while (true) {
+			const uint32_t job_index = next_job_index.fetch_add(1, std::memory_order_relaxed);
+			if (job_index >= job_count) {
+				return;
+			}
+			run_job(context, job_index);
+			completed_job_count.fetch_add(1, std::memory_order_release);
+		}
+	}
+};
+
+class HelperTask : public IThreadedTask {
+public:
+	HelperTask(std::shared_ptr<State> p_state) : _state(p_state) {}
+
+	const char *get_debug_name() const override {
+		return "ParallelJobsHelper";
+	}
+
+	void run(ThreadedTaskContext &ctx) override {
+		_state->work();
+	}
+
+private:
+	std::shared_ptr<State> _state;
+};
+
+static const unsigned int MAX_HELPERS = 32;
+
+} // namespace parallel_jobs_detail
+
+// Runs `f(job_index)` for every index in [0, job_count), and returns when all jobs are done.
+// The calling thread takes part in the work. Helper tasks may be scheduled to run other jobs in parallel, but the
+// calling thread never waits for them to start: jobs they didn't pick in time are run by the calling thread, and
+// helpers starting late have nothing left to do. So this can be called from a task of the same thread pool.
+// Jobs must be independent of each other.
+template <typename F>
+void run_parallel_jobs(uint32_t job_count, const ParallelJobsScheduler &scheduler, F f) {
+	using namespace parallel_jobs_detail;
+
+	if (job_count < 2 || !scheduler.is_valid()) {
+		for (uint32_t job_index = 0; job_index < job_count; ++job_index) {
+			f(job_index);
+		}
+		return;
+	}
+
+	std::shared_ptr<State> state = make_shared_instance<State>();
+	state->job_count = job_count;
+	state->context = &f;
+	state->run_job = [](void *context, uint32_t job_index) { //
+		(*static_cast<F *>(context))(job_index);
+	};
+
+	const unsigned int helper_count = math::min(math::min(scheduler.max_helpers, job_count - 1), MAX_HELPERS);
+	FixedArray<IThreadedTask *, MAX_HELPERS> helpers;
+	for (unsigned int i = 0; i < helper_count; ++i) {
+		helpers[i] = ZN_NEW(HelperTask(state));
+	}
+	scheduler.schedule_tasks(Span<IThreadedTask *>(helpers.data(), helper_count));
+
+	state->work();
+
+	// Remaining jobs are being run by helpers that picked them
+	while (state->completed_job_count.load(std::memory_order_acquire) < job_count) {
+		; // Continue.
+	}
+}
+
+} // namespace zylann
+
+#endif // ZN_PARALLEL_JOBS_H
@@ -6,6 +6,8 @@
 
 namespace zylann {
 
+class LinearAllocator;
+
 struct ThreadedTaskContext {
 	enum Status : uint8_t {
 		// The task is complete and will be put in the list of completed tasks by the TaskRunner. It will be deleted
@@ -15,7 +17,9 @@ struct ThreadedTaskContext {
 		STATUS_POSTPONED = 1,
 		// The task is not complete and will be re-scheduled by another custom task.
 		// The TaskRunner will simply drop its pointer and won't put it in the list of completed tasks.
-		// Initially added so we can schedule task B from task A, and have B re-schedule A to use results computed in A
+		// Initially added so we can schedule task B from task A, and have B re-schedule A to use results computed in A.
+		// This is also how a task can wait for another without polling: it registers itself somewhere the other task
+		// will find it, and gets scheduled again when that task finishes, instead of using `STATUS_POSTPONED`.
 		STATUS_TAKEN_OUT = 2
 	};
 
@@ -26,16 +30,20 @@ struct ThreadedTaskContext {
 	Status status;
 	// Cached priority of the current task. May be useful to copy if the current task spawns other related tasks.
 	const TaskPriority task_priority;
+	// Allocator for temporary memory, owned by the current thread. Everything allocated from it is freed at once after
+	// the task returns from `run`, so it must not be kept beyond that, even if the task gets postponed.
+	LinearAllocator &temp_allocator;
 	// If this is set to a non-null task, it will run right after the current one on the same thread.
 	// By doing so, ownership is given to ThreadedTaskRunner. These tasks must not have been owned by the runner
 	// already. Priority of such tasks is not relevant.
 	// IThreadedTask *next_immediate_task;
 
-	ThreadedTaskContext(uint8_t p_thread_index, TaskPriority p_priority) :
+	ThreadedTaskContext(uint8_t p_thread_index, TaskPriority p_priority, LinearAllocator &p_temp_allocator) :
 			thread_index(p_thread_index),
 			// By default, if the task does not set this status, it will be considered complete after run
 			status(STATUS_COMPLETE),
-			task_priority(p_priority) {}
+			task_priority(p_priority),
+			temp_allocator(p_temp_allocator) {}
 
 	// To allow scheduling tasks from within tasks, without having to pass it in or use a global
 	// ThreadedTaskRunner &runner;
@@ -67,6 +75,12 @@ public:
 		return false;
 	}
 
+	// Gets which category the task belongs to, so the runner can limit or reserve threads for it.
+	// Must be lower than `ThreadedTaskRunner::MAX_CATEGORIES`, and must not change while the task is scheduled.
+	virtual uint8_t get_category() const {
+		return 0;
+	}
+
 	// Gets the name of the task for debug purposes. The returned name's lifetime must span the execution of the engine
 	// (usually a string literal).
 	virtual const char *get_debug_name() const {
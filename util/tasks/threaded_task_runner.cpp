@@ -3,6 +3,9 @@
 #include "../godot/classes/time.h"
 #include "../profiling.h"
 #include "../string/format.h"
+#include "../thread/cpu_affinity.h"
+
+#include <algorithm>
 
 namespace zylann {
 
@@ -12,16 +15,16 @@ ThreadedTaskRunner::~ThreadedTaskRunner() {
 	destroy_all_threads();
 
 	// We don't have ownership over tasks, so it's an error to destroy the pool without handling them
-	if (_staged_tasks.size() != 0) {
+	if (!_staged_tasks.is_empty()) {
 		ZN_PRINT_ERROR("There are staged tasks remaining!");
 	}
-	if (_tasks.size() != 0) {
-		ZN_PRINT_ERROR("There are tasks remaining!");
+	if (_serial_tasks.size() != 0) {
+		ZN_PRINT_ERROR("There are serial tasks remaining!");
 	}
 	if (_spinning_tasks.size() != 0) {
 		ZN_PRINT_ERROR("There are spinning tasks remaining!");
 	}
-	if (_completed_tasks.size() != 0) {
+	if (!_completed_tasks.is_empty()) {
 		ZN_PRINT_ERROR("There are completed tasks remaining!");
 	}
 }
@@ -44,16 +47,28 @@ void ThreadedTaskRunner::destroy_all_threads() {
 	// So we can only choose to stop ALL threads, and then start them again if we want to adjust their count.
 	// Also, it shouldn't drop tasks. Any tasks the thread was working on should still complete normally.
 	for (size_t i = 0; i < _thread_count; ++i) {
-		ThreadData &d = _threads[i];
+		ThreadData &d = *_threads[i];
 		d.stop = true;
 	}
 	for (size_t i = 0; i < _thread_count; ++i) {
 		_tasks_semaphore.post();
 	}
 	for (size_t i = 0; i < _thread_count; ++i) {
-		ThreadData &d = _threads[i];
+		ThreadData &d = *_threads[i];
 		d.wait_to_finish_and_reset();
 	}
+	// Give back tasks threads didn't get to run, so they are not lost if threads get started again
+	size_t returned_count = 0;
+	for (size_t i = 0; i < _thread_count; ++i) {
+		ThreadData &d = *_threads[i];
+		_staged_tasks.push(to_span_const(d.tasks));
+		returned_count += d.tasks.size();
+		d.tasks.clear();
+		d.task_count = 0;
+	}
+	for (size_t i = 0; i < returned_count; ++i) {
+		_tasks_semaphore.post();
+	}
 }
 
 #ifdef ZN_THREADED_TASK_RUNNER_CHECK_DUPLICATE_TASKS
@@ -86,36 +101,59 @@ void ThreadedTaskRunner::set_name(const char *name) {
 }
 
 void ThreadedTaskRunner::set_thread_count(uint32_t count) {
-	if (count > MAX_THREADS) {
-		count = MAX_THREADS;
-	}
 	destroy_all_threads();
-	for (uint32_t i = _thread_count; i < count; ++i) {
-		ThreadData &d = _threads[i];
+	// Threads are all stopped at this point, so they can't be accessing the list.
+	// Tasks of removed threads have been given back to the staging list.
+	if (count < _threads.size()) {
+		_threads.resize(count);
+	}
+	while (_threads.size() < count) {
+		_threads.push_back(make_unique_instance<ThreadData>());
+	}
+	const unsigned int numa_node_count = _numa_affinity_enabled ? cpu_affinity::get_numa_node_count() : 1;
+	for (uint32_t i = 0; i < count; ++i) {
+		ThreadData &d = *_threads[i];
+		// Spread threads evenly across nodes
+		d.numa_node = i % numa_node_count;
 		create_thread(d, i);
 	}
 	_thread_count = count;
 }
 
+void ThreadedTaskRunner::set_numa_affinity_enabled(bool enabled) {
+	_numa_affinity_enabled = enabled;
+}
+
 void ThreadedTaskRunner::set_priority_update_period(uint32_t milliseconds) {
 	_priority_update_period_ms = milliseconds;
 }
 
+void ThreadedTaskRunner::set_lazy_priority_updates(bool enabled) {
+	_lazy_priority_updates = enabled;
+}
+
+void ThreadedTaskRunner::invalidate_priorities() {
+	++_priority_epoch;
+}
+
+void ThreadedTaskRunner::force_priority_update() {
+	_forced_priority_epoch = ++_priority_epoch;
+}
+
 void ThreadedTaskRunner::enqueue(IThreadedTask *task, bool serial) {
 	ZN_PROFILE_SCOPE();
 	ZN_ASSERT(task != nullptr);
 	TaskItem t;
 	t.task = task;
 	t.is_serial = serial;
-	{
-		MutexLock lock(_staged_tasks_mutex);
-		_staged_tasks.push_back(t);
-		++_debug_received_tasks;
-
+	t.category = get_task_category(*task);
+	t.enqueue_time_usec = Time::get_singleton()->get_ticks_usec();
+	++_categories[t.category].pending_count;
 #ifdef ZN_THREADED_TASK_RUNNER_CHECK_DUPLICATE_TASKS
-		debug_add_owned_task(task);
+	debug_add_owned_task(task);
 #endif
-	}
+	++_debug_received_tasks;
+	_staged_tasks.push(t);
 	// TODO Do I need to post a certain amount of times?
 	// I feel like this causes the semaphore to be passed too many times when tasks become empty
 	_tasks_semaphore.post();
@@ -127,23 +165,21 @@ void ThreadedTaskRunner::enqueue(Span<IThreadedTask *> new_tasks, bool serial) {
 		ZN_ASSERT(new_tasks[i] != nullptr);
 	}
 #endif
-	{
-		MutexLock lock(_staged_tasks_mutex);
-		const size_t dst_begin = _staged_tasks.size();
-		_staged_tasks.resize(_staged_tasks.size() + new_tasks.size());
-		for (size_t i = 0; i < new_tasks.size(); ++i) {
-			IThreadedTask *new_task = new_tasks[i];
-			TaskItem t;
-			t.task = new_task;
-			t.is_serial = serial;
-			_staged_tasks[dst_begin + i] = t;
-
+	const uint64_t now_usec = Time::get_singleton()->get_ticks_usec();
+	_debug_received_tasks += new_tasks.size();
+	_staged_tasks.push_n(new_tasks.size(), [this, new_tasks, serial, now_usec](unsigned int i) {
+		IThreadedTask *new_task = new_tasks[i];
+		TaskItem t;
+		t.task = new_task;
+		t.is_serial = serial;
+		t.category = get_task_category(*new_task);
+		t.enqueue_time_usec = now_usec;
+		++_categories[t.category].pending_count;
 #ifdef ZN_THREADED_TASK_RUNNER_CHECK_DUPLICATE_TASKS
-			debug_add_owned_task(new_task);
+		debug_add_owned_task(new_task);
 #endif
-		}
-		_debug_received_tasks += new_tasks.size();
-	}
+		return t;
+	});
 	// TODO Do I need to post a certain amount of times?
 	// Should it be the number of threads instead of number of tasks?
 	for (size_t i = 0; i < new_tasks.size(); ++i) {
@@ -151,6 +187,84 @@ void ThreadedTaskRunner::enqueue(Span<IThreadedTask *> new_tasks, bool serial) {
 	}
 }
 
+void ThreadedTaskRunner::set_category_quota(uint8_t category, uint32_t min_threads, uint32_t max_threads) {
+	ZN_ASSERT_RETURN(category < MAX_CATEGORIES);
+	CategoryData &c = _categories[category];
+	c.min_threads = min_threads;
+	c.max_threads = max_threads;
+	bool has_quotas = false;
+	for (const CategoryData &cd : _categories) {
+		if (cd.min_threads > 0 || cd.max_threads != NO_THREAD_LIMIT) {
+			has_quotas = true;
+			break;
+		}
+	}
+	_has_category_quotas = has_quotas;
+}
+
+ThreadedTaskRunner::CategoryStats ThreadedTaskRunner::get_category_stats(uint8_t category) const {
+	ZN_ASSERT_RETURN_V(category < MAX_CATEGORIES, CategoryStats());
+	const CategoryData &c = _categories[category];
+	CategoryStats stats;
+	stats.pending_tasks = c.pending_count.load(std::memory_order_relaxed);
+	stats.running_tasks = c.running_count.load(std::memory_order_relaxed);
+	return stats;
+}
+
+uint8_t ThreadedTaskRunner::get_task_category(const IThreadedTask &task) {
+	const uint8_t category = task.get_category();
+	ZN_ASSERT_RETURN_V_MSG(category < MAX_CATEGORIES, 0, format("Task category {} is out of range", category));
+	return category;
+}
+
+void ThreadedTaskRunner::get_category_latencies(
+		uint8_t category,
+		LatencyHistogram::Snapshot &out_wait_times,
+		LatencyHistogram::Snapshot &out_run_times
+) const {
+	ZN_ASSERT_RETURN(category < MAX_CATEGORIES);
+	const CategoryData &c = _categories[category];
+	c.wait_times.get_snapshot(out_wait_times);
+	c.run_times.get_snapshot(out_run_times);
+}
+
+void ThreadedTaskRunner::reset_category_latencies() {
+	for (CategoryData &c : _categories) {
+		c.wait_times.reset();
+		c.run_times.reset();
+	}
+}
+
+bool ThreadedTaskRunner::try_start_category(uint8_t category) {
+	CategoryData &c = _categories[category];
+	// Counted first and reverted if it exceeds quotas. When threads do this at the same time, at least one of them sees
+	// the others, so quotas can't be exceeded.
+	const uint32_t running_count = ++c.running_count;
+	if (!_has_category_quotas) {
+		return true;
+	}
+	if (running_count > c.max_threads) {
+		--c.running_count;
+		return false;
+	}
+	// Threads reserved by other categories must remain available for them
+	uint32_t total_running_count = 0;
+	uint32_t reserved_count = 0;
+	for (unsigned int i = 0; i < _categories.size(); ++i) {
+		const CategoryData &other = _categories[i];
+		const uint32_t other_running_count = other.running_count.load();
+		total_running_count += other_running_count;
+		if (i != category && other.min_threads > other_running_count) {
+			reserved_count += other.min_threads - other_running_count;
+		}
+	}
+	if (total_running_count + reserved_count > _thread_count) {
+		--c.running_count;
+		return false;
+	}
+	return true;
+}
+
 void ThreadedTaskRunner::thread_func_static(void *p_data) {
 	ThreadData &data = *static_cast<ThreadData *>(p_data);
 	ThreadedTaskRunner &pool = *data.pool;
@@ -163,19 +277,213 @@ void ThreadedTaskRunner::thread_func_static(void *p_data) {
 #endif
 	}
 
+	if (pool._numa_affinity_enabled) {
+		if (!cpu_affinity::pin_current_thread_to_numa_node(data.numa_node)) {
+			ZN_PRINT_VERBOSE(format("Could not pin thread {} to NUMA node {}", data.index, data.numa_node));
+		}
+	}
+
 	pool.thread_func(data);
 }
 
+namespace {
+
+struct TaskItemComparator {
+	template <typename TaskItem>
+	inline bool operator()(const TaskItem &a, const TaskItem &b) const {
+		// Max-heap, tasks with highest priority come first
+		return a.cached_priority < b.cached_priority;
+	}
+};
+
+} // namespace
+
+void ThreadedTaskRunner::update_priorities(StdVector<TaskItem> &tasks, StdVector<IThreadedTask *> &cancelled_tasks) {
+	ZN_PROFILE_SCOPE();
+
+	// The point to keep updating after tasks have been inserted is in case there are lots of pending tasks, which can
+	// take more than a few seconds to be processed. A player can move fast and the priority location can change. Some
+	// tasks can even become irrelevant before they are run, so we may remove them from the list so they don't slow
+	// down the process.
+	for (unsigned int i = 0; i < tasks.size();) {
+		TaskItem &item = tasks[i];
+		item.cached_priority = item.task->get_priority();
+
+		if (item.task->is_cancelled()) {
+			cancelled_tasks.push_back(item.task);
+			tasks[i] = tasks.back();
+			tasks.pop_back();
+			continue;
+		}
+
+		++i;
+	}
+
+	std::make_heap(tasks.begin(), tasks.end(), TaskItemComparator());
+}
+
+void ThreadedTaskRunner::push_tasks(StdVector<TaskItem> &tasks, Span<const TaskItem> new_tasks) {
+	if (new_tasks.size() > tasks.size()) {
+		// Cheaper to rebuild the whole heap
+		tasks.insert(tasks.end(), new_tasks.begin(), new_tasks.end());
+		std::make_heap(tasks.begin(), tasks.end(), TaskItemComparator());
+	} else {
+		for (const TaskItem &item : new_tasks) {
+			tasks.push_back(item);
+			std::push_heap(tasks.begin(), tasks.end(), TaskItemComparator());
+		}
+	}
+}
+
+bool ThreadedTaskRunner::pop_best_task(
+		StdVector<TaskItem> &tasks,
+		TaskItem &out_item,
+		StdVector<IThreadedTask *> &cancelled_tasks,
+		bool &out_blocked_by_quota
+) {
+	// Priorities cached in the heap may be outdated. Rather than updating all of them, only the one at the top is
+	// checked. If it went down below the next one, it is put back in the heap with its new priority.
+	// Limited so tasks with constantly changing priority can't keep us here.
+	const unsigned int max_reinsertions = 8;
+	unsigned int reinsertion_count = 0;
+	// Tasks whose category can't get more threads at the moment are set aside, and we look at the next ones.
+	// Also limited, in case lots of such tasks are queued.
+	const unsigned int max_skipped = 32;
+	static thread_local StdVector<TaskItem> tls_skipped_tasks;
+	StdVector<TaskItem> &skipped_tasks = tls_skipped_tasks;
+	bool found = false;
+
+	while (tasks.size() > 0) {
+		std::pop_heap(tasks.begin(), tasks.end(), TaskItemComparator());
+		TaskItem item = tasks.back();
+		tasks.pop_back();
+
+		if (item.task->is_cancelled()) {
+			cancelled_tasks.push_back(item.task);
+			continue;
+		}
+
+		const TaskPriority priority = item.task->get_priority();
+		item.cached_priority = priority;
+
+		if (reinsertion_count < max_reinsertions && tasks.size() > 0 && priority < tasks.front().cached_priority) {
+			tasks.push_back(item);
+			std::push_heap(tasks.begin(), tasks.end(), TaskItemComparator());
+			++reinsertion_count;
+			continue;
+		}
+
+		if (!try_start_category(item.category)) {
+			skipped_tasks.push_back(item);
+			out_blocked_by_quota = true;
+			if (skipped_tasks.size() >= max_skipped) {
+				break;
+			}
+			continue;
+		}
+
+		out_item = item;
+		found = true;
+		break;
+	}
+
+	if (skipped_tasks.size() > 0) {
+		push_tasks(tasks, to_span_const(skipped_tasks));
+		skipped_tasks.clear();
+	}
+
+	return found;
+}
+
+bool ThreadedTaskRunner::is_priority_update_due(uint64_t last_time_ms, uint32_t last_epoch, uint64_t now_ms) const {
+	// Compared with a signed difference so it still works when epochs wrap around
+	const int32_t forced_epoch_delta =
+			static_cast<int32_t>(_forced_priority_epoch.load(std::memory_order_relaxed) - last_epoch);
+	if (forced_epoch_delta > 0) {
+		return true;
+	}
+	if (now_ms - last_time_ms <= _priority_update_period_ms) {
+		return false;
+	}
+	if (_lazy_priority_updates) {
+		return _priority_epoch.load(std::memory_order_relaxed) != last_epoch;
+	}
+	return true;
+}
+
+bool ThreadedTaskRunner::try_steal_tasks(ThreadData &thief) {
+	ZN_PROFILE_SCOPE();
+
+	// Steal from the thread with the most tasks. Counts may be outdated by the time we lock, that's fine.
+	// Threads of the same NUMA node are preferred, since tasks they stole may have created data in local memory.
+	// Not using `_thread_count` because it is set after threads are started. The list doesn't change while threads run.
+	ThreadData *victim = nullptr;
+	uint32_t victim_task_count = 0;
+	ThreadData *remote_victim = nullptr;
+	uint32_t remote_victim_task_count = 0;
+	for (UniquePtr<ThreadData> &dp : _threads) {
+		ThreadData &d = *dp;
+		const uint32_t task_count = d.task_count.load(std::memory_order_relaxed);
+		if (&d == &thief) {
+			continue;
+		}
+		if (d.numa_node == thief.numa_node) {
+			if (task_count > victim_task_count) {
+				victim = &d;
+				victim_task_count = task_count;
+			}
+		} else if (task_count > remote_victim_task_count) {
+			remote_victim = &d;
+			remote_victim_task_count = task_count;
+		}
+	}
+	if (victim == nullptr) {
+		victim = remote_victim;
+	}
+	if (victim == nullptr) {
+		return false;
+	}
+
+	static thread_local StdVector<TaskItem> tls_stolen_tasks;
+	StdVector<TaskItem> &stolen_tasks = tls_stolen_tasks;
+	stolen_tasks.clear();
+	{
+		MutexLock lock(victim->tasks_mutex);
+		StdVector<TaskItem> &victim_tasks = victim->tasks;
+		// Take half of the tasks from the end of the heap. What remains is still a valid heap, and keeps the highest
+		// priority task.
+		const size_t count = victim_tasks.size() / 2;
+		stolen_tasks.insert(stolen_tasks.end(), victim_tasks.end() - count, victim_tasks.end());
+		victim_tasks.resize(victim_tasks.size() - count);
+		victim->task_count = victim_tasks.size();
+	}
+	if (stolen_tasks.size() == 0) {
+		return false;
+	}
+	{
+		MutexLock lock(thief.tasks_mutex);
+		// Our own tasks are expected to be empty at this point, but new ones could have been staged in the meantime
+		push_tasks(thief.tasks, to_span_const(stolen_tasks));
+		thief.task_count = thief.tasks.size();
+	}
+	stolen_tasks.clear();
+	return true;
+}
+
 void ThreadedTaskRunner::thread_func(ThreadData &data) {
 	data.debug_state = STATE_RUNNING;
 
 	StdVector<TaskItem> tasks;
+	StdVector<TaskItem> staged_tasks;
+	StdVector<TaskItem> staged_serial_tasks;
 	StdVector<TaskItem> postponed_tasks;
 	StdVector<IThreadedTask *> cancelled_tasks;
+	StdVector<IThreadedTask *> completed_tasks;
 
 	while (!data.stop) {
 		bool is_running_serial_task = false;
-		bool task_queue_was_empty = false;
+		bool serial_tasks_pending = false;
+		bool blocked_by_quota = false;
 		{
 			ZN_PROFILE_SCOPE_NAMED("Task pickup");
 
@@ -184,128 +492,131 @@ void ThreadedTaskRunner::thread_func(ThreadData &data) {
 			ZN_ASSERT(tasks.size() == 0);
 
 			// Pick a postponed task if any.
-			// We will still run a task from the main prioritized queue as well so postponed tasks will not
-			// monopolize execution.
+			// We will still run a task from our queue as well so postponed tasks will not monopolize execution.
 			//
 			// TODO What if postponed tasks remain while one big task is locking what they need to access?
 			// Those postponed tasks will sort of spinlock with no sleeping. Is that a bad thing?
 			{
 				MutexLock lock2(_spinning_tasks_mutex);
 				if (_spinning_tasks.size() > 0) {
-					tasks.push_back(_spinning_tasks.front());
+					const TaskItem &item = _spinning_tasks.front();
+					// Not subject to quotas, it was already allowed to run before
+					++_categories[item.category].running_count;
+					tasks.push_back(item);
 					_spinning_tasks.pop();
 				}
 			}
 
-			{
-				// TODO When tasks are very short and there are a lot of tasks, one thread can monopolize this mutex.
-				//
-				MutexLock lock(_tasks_mutex);
-
-				// Move tasks from the staging queue.
-				// Lock with minimal risk of blocking the main thread, it should be very short.
-				if (_staged_tasks_mutex.try_lock()) {
-					append_array(_tasks, _staged_tasks);
-					_staged_tasks.clear();
-					_staged_tasks_mutex.unlock();
+			// Move tasks from the staging queue
+			_staged_tasks.pop_all([&staged_tasks](const TaskItem &item) { staged_tasks.push_back(item); });
+
+			if (staged_tasks.size() > 0) {
+				// Evaluate priorities before locking, they are needed to insert tasks in the heaps
+				for (unsigned int i = 0; i < staged_tasks.size();) {
+					TaskItem &item = staged_tasks[i];
+					if (item.is_serial) {
+						staged_serial_tasks.push_back(item);
+						staged_tasks[i] = staged_tasks.back();
+						staged_tasks.pop_back();
+						continue;
+					}
+					item.cached_priority = item.task->get_priority();
+					++i;
 				}
-
-				// Pick best tasks from the prioritized queue
-				if (_tasks.size() != 0) {
-					// Sort periodically.
-					// The point to keep sorting after tasks have been inserted is in case there are lots of pending
-					// tasks, which can take more than a few seconds to be processed. A player can move fast and the
-					// priority location can change. Some tasks can even become irrelevant before they are run,so we
-					// may remove them from the list so they don't slow down the process.
-					const uint64_t now = Time::get_singleton()->get_ticks_msec();
-					if (now - _last_priority_update_time_ms > _priority_update_period_ms) {
-						ZN_PROFILE_SCOPE_NAMED("Sorting");
-
-						{
-							ZN_PROFILE_SCOPE_NAMED("Update priorities");
-							for (unsigned int i = 0; i < _tasks.size();) {
-								TaskItem &item = _tasks[i];
-								item.cached_priority = item.task->get_priority();
-
-								if (item.task->is_cancelled()) {
-									cancelled_tasks.push_back(item.task);
-									_tasks[i] = _tasks.back();
-									_tasks.pop_back();
-									continue;
-								}
-
-								++i;
-							}
-						}
-
-						struct TaskComparator {
-							inline bool operator()(const TaskItem &a, const TaskItem &b) const {
-								// Tasks with highest priority come last (easier pop back)
-								return a.cached_priority < b.cached_priority;
-							}
-						};
-						SortArray<TaskItem, TaskComparator> sorter;
-						sorter.sort(_tasks.data(), _tasks.size());
-
-						_last_priority_update_time_ms = Time::get_singleton()->get_ticks_msec();
+				if (staged_tasks.size() > 0) {
+					MutexLock lock(data.tasks_mutex);
+					push_tasks(data.tasks, to_span_const(staged_tasks));
+					data.task_count = data.tasks.size();
+				}
+				if (staged_serial_tasks.size() > 0) {
+					for (TaskItem &item : staged_serial_tasks) {
+						item.cached_priority = item.task->get_priority();
 					}
+					MutexLock lock(_serial_tasks_mutex);
+					push_tasks(_serial_tasks, to_span_const(staged_serial_tasks));
+				}
+				staged_tasks.clear();
+				staged_serial_tasks.clear();
+			}
 
-					// Pick task with highest priority if possible
-					// for (int i = int(_tasks.size()) - 1; i >= 0; --i) {
-					for (unsigned int i = _tasks.size(); i-- > 0;) {
-						const TaskItem item = _tasks[i];
-						// Serial tasks are a bit annoying in that regard...
-						// We could make the save/load tasks accept more than one work, which is the best way to do
-						// serial work, but in some cases it's harder to know in advance...
-						if (item.is_serial && _is_serial_task_running) {
-							// Try previous task
-							continue;
-						}
+			const uint64_t now = Time::get_singleton()->get_ticks_msec();
 
+			// Pick a serial task if none is running.
+			// Serial tasks are a bit annoying in that regard...
+			// We could make the save/load tasks accept more than one work, which is the best way to do serial work, but
+			// in some cases it's harder to know in advance...
+			{
+				MutexLock lock(_serial_tasks_mutex);
+				// This must be the only place `_is_serial_task_running` can be set to `true`, and is guarded by mutex.
+				if (!_is_serial_task_running && _serial_tasks.size() > 0) {
+					if (is_priority_update_due(
+								_last_serial_priority_update_time_ms, _last_serial_priority_epoch, now
+						)) {
+						_last_serial_priority_epoch = _priority_epoch.load(std::memory_order_relaxed);
+						update_priorities(_serial_tasks, cancelled_tasks);
+						_last_serial_priority_update_time_ms = now;
+					}
+					TaskItem item;
+					if (pop_best_task(_serial_tasks, item, cancelled_tasks, blocked_by_quota)) {
 						tasks.push_back(item);
-						// We don't just pop the last item because of serial task handling. But ordered removal should
-						// be fast enough since serial tasks aren't common.
-						_tasks.erase(_tasks.begin() + i);
-						break;
+						// Write to member var so all threads can check this
+						_is_serial_task_running = true;
+						// Write to thread-local variable so we know it is the current thread
+						is_running_serial_task = true;
 					}
+				}
+				serial_tasks_pending = _serial_tasks.size() > 0;
+			}
 
-				} // For each task to pick
-
-				// If we picked up a serial task, we must set the shared boolean to `true`.
-				// More than one serial task can be in the list of tasks the current thread picks up,
-				// so we update the boolean after picking them all.
-				// This must be the only place it can be set to `true`, and is guarded by mutex.
-				if (_is_serial_task_running == false) { // Only an optimization, this doesnt actually do thread-safety
-					for (unsigned int i = 0; i < tasks.size(); ++i) {
-						if (tasks[i].is_serial) {
-							// Write to member var so all threads can check this
-							_is_serial_task_running = true;
-							// Write to thread-local variable so we know it is the current thread
-							is_running_serial_task = true;
-							break;
+			// Pick our task with highest priority, or steal some if we have none
+			if (!is_running_serial_task) {
+				for (unsigned int attempt = 0; attempt < 2; ++attempt) {
+					bool picked = false;
+					{
+						MutexLock lock(data.tasks_mutex);
+						if (data.tasks.size() > 0) {
+							if (is_priority_update_due(
+										data.last_priority_update_time_ms, data.last_priority_epoch, now
+								)) {
+								data.last_priority_epoch = _priority_epoch.load(std::memory_order_relaxed);
+								update_priorities(data.tasks, cancelled_tasks);
+								data.last_priority_update_time_ms = now;
+							}
+							TaskItem item;
+							if (pop_best_task(data.tasks, item, cancelled_tasks, blocked_by_quota)) {
+								tasks.push_back(item);
+								picked = true;
+							}
+							data.task_count = data.tasks.size();
 						}
 					}
+					if (picked || !try_steal_tasks(data)) {
+						break;
+					}
 				}
+			}
 
-				task_queue_was_empty = _tasks.size() == 0;
-
-			} // Tasks queue mutex lock
+			for (const TaskItem &item : tasks) {
+				--_categories[item.category].pending_count;
+			}
 		}
 
 		if (cancelled_tasks.size() > 0) {
-			MutexLock lock(_completed_tasks_mutex);
-			const size_t count = cancelled_tasks.size();
-			append_array(_completed_tasks, cancelled_tasks);
-			_debug_completed_tasks += count;
+			// Done before handing them back, after which they may get destroyed
+			for (IThreadedTask *task : cancelled_tasks) {
+				--_categories[get_task_category(*task)].pending_count;
+			}
+			_debug_completed_tasks += cancelled_tasks.size();
+			_completed_tasks.push(to_span_const(cancelled_tasks));
 			cancelled_tasks.clear();
 		}
 
 		// print_line(String("Processing {0} tasks").format(varray(tasks.size())));
 
 		if (tasks.empty()) {
-			if (task_queue_was_empty) {
-				// The task queue is empty, will wait until more tasks are posted.
-				// If a task is posted between the moment we last checked the queue and now,
+			if (!serial_tasks_pending && !blocked_by_quota) {
+				// There are no tasks we could pick or steal, will wait until more tasks are posted.
+				// If a task is posted between the moment we last checked the queues and now,
 				// the semaphore will have one count to decrement and we'll not stop here.
 
 				data.debug_state = STATE_WAITING;
@@ -316,8 +627,9 @@ void ThreadedTaskRunner::thread_func(ThreadData &data) {
 				data.waiting = false;
 
 			} else {
-				// The current thread was not allowed to pick tasks currently in the queue (they could be serial and one
-				// is already running). So we'll wait for a very short time before retrying.
+				// The current thread was not allowed to pick serial tasks because one is already running, or tasks
+				// remaining belong to categories that reached their thread quota. So we'll wait for a very short time
+				// before retrying.
 				// (alternative would be to post the semaphore after each serial task?)
 				Thread::sleep_usec(1000);
 			}
@@ -330,9 +642,18 @@ void ThreadedTaskRunner::thread_func(ThreadData &data) {
 				TaskItem &item = tasks[i];
 
 				if (!item.task->is_cancelled()) {
-					ThreadedTaskContext ctx(data.index, item.cached_priority);
+					CategoryData &category = _categories[item.category];
+					const uint64_t begin_time_usec = Time::get_singleton()->get_ticks_usec();
+					if (item.enqueue_time_usec != 0) {
+						category.wait_times.add(begin_time_usec - item.enqueue_time_usec);
+						item.enqueue_time_usec = 0;
+					}
+
+					ThreadedTaskContext ctx(data.index, item.cached_priority, data.temp_allocator);
 					data.debug_running_task_name = item.task->get_debug_name();
 					item.task->run(ctx);
+					data.temp_allocator.reset();
+					category.run_times.add(Time::get_singleton()->get_ticks_usec() - begin_time_usec);
 #ifdef ZN_THREADED_TASK_RUNNER_CHECK_DUPLICATE_TASKS
 					if (ctx.status == ThreadedTaskContext::STATUS_TAKEN_OUT) {
 						debug_remove_owned_task(item.task);
@@ -363,38 +684,63 @@ void ThreadedTaskRunner::thread_func(ThreadData &data) {
 				_is_serial_task_running = false;
 			}
 
-			{
-				MutexLock lock(_completed_tasks_mutex);
-				for (size_t i = 0; i < tasks.size(); ++i) {
-					const TaskItem &item = tasks[i];
-					switch (item.status) {
-						case ThreadedTaskContext::STATUS_COMPLETE:
-							_completed_tasks.push_back(item.task);
-							++_debug_completed_tasks;
-							break;
-
-						case ThreadedTaskContext::STATUS_POSTPONED:
-							postponed_tasks.push_back(item);
-							break;
-
-						case ThreadedTaskContext::STATUS_TAKEN_OUT:
-							// Drop task pointer, its ownership may have been passed to another task
-							++_debug_taken_out_tasks;
-							break;
-
-						default:
-							ZN_PRINT_ERROR("Unknown task status");
-							break;
-					}
+			for (const TaskItem &item : tasks) {
+				CategoryData &category = _categories[item.category];
+				--category.running_count;
+				if (item.status == ThreadedTaskContext::STATUS_POSTPONED) {
+					++category.pending_count;
+				}
+			}
+
+			for (size_t i = 0; i < tasks.size(); ++i) {
+				const TaskItem &item = tasks[i];
+				switch (item.status) {
+					case ThreadedTaskContext::STATUS_COMPLETE:
+						completed_tasks.push_back(item.task);
+						break;
+
+					case ThreadedTaskContext::STATUS_POSTPONED:
+						postponed_tasks.push_back(item);
+						break;
+
+					case ThreadedTaskContext::STATUS_TAKEN_OUT:
+						// Drop task pointer, its ownership may have been passed to another task
+						++_debug_taken_out_tasks;
+						break;
+
+					default:
+						ZN_PRINT_ERROR("Unknown task status");
+						break;
 				}
 			}
 
+			if (completed_tasks.size() > 0) {
+				_debug_completed_tasks += completed_tasks.size();
+				_completed_tasks.push(to_span_const(completed_tasks));
+				completed_tasks.clear();
+			}
+
 			tasks.clear();
 
 			{
 				MutexLock lock(_spinning_tasks_mutex);
 				for (const TaskItem &item : postponed_tasks) {
-					_spinning_tasks.push(item);
+					if (!item.is_serial) {
+						_spinning_tasks.push(item);
+					}
+				}
+			}
+			if (postponed_tasks.size() > 0) {
+				// Postponed serial tasks go back to their own list, so they still run one at a time
+				for (const TaskItem &item : postponed_tasks) {
+					if (item.is_serial) {
+						staged_serial_tasks.push_back(item);
+					}
+				}
+				if (staged_serial_tasks.size() > 0) {
+					MutexLock lock(_serial_tasks_mutex);
+					push_tasks(_serial_tasks, to_span_const(staged_serial_tasks));
+					staged_serial_tasks.clear();
 				}
 			}
 
@@ -415,19 +761,23 @@ void ThreadedTaskRunner::wait_for_all_tasks() {
 	while (true) {
 		// TODO this is not really precise, because running tasks can schedule more tasks. Not sure if we need it?
 		// Waiting for all threads to be in waiting state is a more definitive solution.
-		bool any_staged_tasks = false;
-		{
-			MutexLock lock3(_staged_tasks_mutex);
-			any_staged_tasks = _staged_tasks.size() > 0;
-		}
-		if (!any_staged_tasks) {
-			MutexLock lock(_tasks_mutex);
-			if (_tasks.size() == 0) {
-				MutexLock lock2(_spinning_tasks_mutex);
-				if (_spinning_tasks.size() == 0) {
+		if (_staged_tasks.is_empty()) {
+			bool any_thread_tasks = false;
+			for (const UniquePtr<ThreadData> &t : _threads) {
+				if (t->task_count.load(std::memory_order_relaxed) > 0) {
+					any_thread_tasks = true;
 					break;
 				}
 			}
+			if (!any_thread_tasks) {
+				MutexLock lock(_serial_tasks_mutex);
+				if (_serial_tasks.size() == 0) {
+					MutexLock lock2(_spinning_tasks_mutex);
+					if (_spinning_tasks.size() == 0) {
+						break;
+					}
+				}
+			}
 		}
 
 		Thread::sleep_usec(2000);
@@ -446,7 +796,7 @@ void ThreadedTaskRunner::wait_for_all_tasks() {
 	while (any_working_thread) {
 		any_working_thread = false;
 		for (size_t i = 0; i < _thread_count; ++i) {
-			const ThreadData &t = _threads[i];
+			const ThreadData &t = *_threads[i];
 			if (t.waiting == false) {
 				any_working_thread = true;
 				break;
@@ -467,20 +817,15 @@ void ThreadedTaskRunner::wait_for_all_tasks() {
 // Thought it wasnt worth locking for debugging.
 
 ThreadedTaskRunner::State ThreadedTaskRunner::get_thread_debug_state(uint32_t i) const {
-	return _threads[i].debug_state;
+	return _threads[i]->debug_state;
 }
 
 const char *ThreadedTaskRunner::get_thread_debug_task_name(unsigned int thread_index) const {
-	return _threads[thread_index].debug_running_task_name;
+	return _threads[thread_index]->debug_running_task_name;
 }
 
 unsigned int ThreadedTaskRunner::get_debug_remaining_tasks() const {
 	return _debug_received_tasks - _debug_completed_tasks - _debug_taken_out_tasks;
 }
 
-StdVector<IThreadedTask *> &ThreadedTaskRunner::get_completed_tasks_temp_tls() {
-	static thread_local StdVector<IThreadedTask *> tls_temp;
-	return tls_temp;
-}
-
 } // namespace zylann
@@ -3,9 +3,13 @@
 
 #include "../containers/container_funcs.h"
 #include "../containers/fixed_array.h"
+#include "../containers/mpsc_queue.h"
 #include "../containers/span.h"
 #include "../containers/std_queue.h"
 #include "../containers/std_vector.h"
+#include "../latency_histogram.h"
+#include "../memory/linear_allocator.h"
+#include "../memory/memory.h"
 #include "../profiling.h"
 #include "../string/std_string.h"
 #include "../thread/mutex.h"
@@ -24,10 +28,14 @@
 
 namespace zylann {
 
-// Generic thread pool that performs batches of tasks based on dynamic priority
+// Generic thread pool that performs batches of tasks based on dynamic priority.
+// Each thread owns a queue of tasks, and steals from others when it runs out of work. Priority is approximated: each
+// thread keeps its tasks in a heap and runs the highest priority one first, and steals from the most loaded thread.
 class ThreadedTaskRunner {
 public:
-	static const uint32_t MAX_THREADS = 16;
+	// See `IThreadedTask::get_category`
+	static const unsigned int MAX_CATEGORIES = 8;
+	static const uint32_t NO_THREAD_LIMIT = 0xffffffff;
 
 	enum State { //
 		STATE_RUNNING = 0,
@@ -43,19 +51,63 @@ public:
 	// Must be called before configuring thread count.
 	void set_name(const char *name);
 
-	// TODO Add ability to change it while running without skipping tasks
-	// Can't be changed after tasks have been queued
+	// Stops all threads and starts them again with the new count. Tasks that were not picked yet are kept.
 	void set_thread_count(uint32_t count);
 	uint32_t get_thread_count() const {
 		return _thread_count;
 	}
 
+	// When enabled, threads are spread across NUMA nodes and each of them only runs on CPUs of its node.
+	// When running out of tasks, threads steal from other threads of their node first.
+	// Takes effect next time the thread count is set.
+	void set_numa_affinity_enabled(bool enabled);
+
 	// TODO Add ability to change it while running
 	// Task priorities can change over time, but computing them too often with many tasks can be expensive,
 	// so they are cached. This sets how often task priorities will be polled.
 	// Can't be changed after tasks have been queued.
 	void set_priority_update_period(uint32_t milliseconds);
 
+	// When enabled, cached priorities of all pending tasks are only updated after `invalidate_priorities()` was called
+	// (still no more often than the update period). Otherwise they are updated every period.
+	// In both cases, the priority of a task is checked again right before it gets picked.
+	void set_lazy_priority_updates(bool enabled);
+
+	// Tells the runner priorities of pending tasks may have changed significantly, for example when viewers moved.
+	// Can be called from any thread.
+	void invalidate_priorities();
+
+	// Same as `invalidate_priorities()`, but pending tasks are updated next time threads pick one, without waiting for
+	// the update period. Tasks that got cancelled are then removed from all queues at once. This is expensive when
+	// lots of tasks are pending, so it should only be used after sudden changes, like viewers teleporting.
+	// Can be called from any thread.
+	void force_priority_update();
+
+	// Limits how many threads can run tasks of a category at the same time (`max_threads`), and how many threads are
+	// kept available for that category (`min_threads`) by not letting other categories use them.
+	// By default categories have no minimum and no maximum.
+	// Should be set before tasks are queued.
+	void set_category_quota(uint8_t category, uint32_t min_threads, uint32_t max_threads);
+
+	struct CategoryStats {
+		// Tasks waiting to run, including postponed ones
+		uint32_t pending_tasks = 0;
+		uint32_t running_tasks = 0;
+	};
+
+	CategoryStats get_category_stats(uint8_t category) const;
+
+	// Gets the distributions of how long tasks of a category waited in queues before running the first time, and how
+	// long each of their runs took.
+	void get_category_latencies(
+			uint8_t category,
+			LatencyHistogram::Snapshot &out_wait_times,
+			LatencyHistogram::Snapshot &out_run_times
+	) const;
+
+	// Clears latencies recorded so far, so they can be sampled over periods of time
+	void reset_category_latencies();
+
 	// TODO Expect tasks to be unique ptrs?
 
 	// Schedules a task.
@@ -71,22 +123,12 @@ public:
 	template <typename F>
 	void dequeue_completed_tasks(F f) {
 		ZN_PROFILE_SCOPE();
-		StdVector<IThreadedTask *> &temp = get_completed_tasks_temp_tls();
-		ZN_ASSERT(temp.size() == 0);
-		{
-			MutexLock lock(_completed_tasks_mutex);
-			append_array(temp, _completed_tasks);
-			_completed_tasks.clear();
-			// std::move doesn't guarantee preservation of vector capacity
-			// temp = std::move(_completed_tasks);
-		}
-		for (IThreadedTask *task : temp) {
+		_completed_tasks.pop_all([this, &f](IThreadedTask *task) {
 #ifdef ZN_THREADED_TASK_RUNNER_CHECK_DUPLICATE_TASKS
 			debug_remove_owned_task(task);
 #endif
 			f(task);
-		}
-		temp.clear();
+		});
 	}
 
 	// Blocks and wait for all tasks to finish (assuming no more are getting added!)
@@ -97,13 +139,14 @@ public:
 	unsigned int get_debug_remaining_tasks() const;
 
 private:
-	static StdVector<IThreadedTask *> &get_completed_tasks_temp_tls();
-
 	struct TaskItem {
 		IThreadedTask *task = nullptr;
 		TaskPriority cached_priority;
 		bool is_serial = false;
+		uint8_t category = 0;
 		ThreadedTaskContext::Status status = ThreadedTaskContext::STATUS_COMPLETE;
+		// Cleared when the task first runs, so postponed tasks don't count waiting time more than once
+		uint64_t enqueue_time_usec = 0;
 	};
 
 	struct ThreadData {
@@ -116,6 +159,18 @@ private:
 		StdString name;
 		std::atomic<const char *> debug_running_task_name = { nullptr };
 
+		// Parallel tasks owned by this thread, as a max-heap of cached priorities.
+		// Other threads lock it only when they steal tasks, so it is rarely contended.
+		StdVector<TaskItem> tasks;
+		Mutex tasks_mutex;
+		// Same as `tasks.size()`, but can be read without locking, to find which thread to steal from
+		std::atomic_uint32_t task_count = { 0 };
+		uint64_t last_priority_update_time_ms = 0;
+		uint32_t last_priority_epoch = 0;
+		uint32_t numa_node = 0;
+		// Temporary memory given to tasks, reset after each of them
+		LinearAllocator temp_allocator;
+
 		void wait_to_finish_and_reset() {
 			thread.wait_to_finish();
 			pool = nullptr;
@@ -130,6 +185,20 @@ private:
 	static void thread_func_static(void *p_data);
 	void thread_func(ThreadData &data);
 
+	static void update_priorities(StdVector<TaskItem> &tasks, StdVector<IThreadedTask *> &cancelled_tasks);
+	static void push_tasks(StdVector<TaskItem> &tasks, Span<const TaskItem> new_tasks);
+	bool pop_best_task(
+			StdVector<TaskItem> &tasks,
+			TaskItem &out_item,
+			StdVector<IThreadedTask *> &cancelled_tasks,
+			bool &out_blocked_by_quota
+	);
+	static uint8_t get_task_category(const IThreadedTask &task);
+	// Counts one more running task of the category if quotas allow it
+	bool try_start_category(uint8_t category);
+	bool is_priority_update_due(uint64_t last_time_ms, uint32_t last_epoch, uint64_t now_ms) const;
+	bool try_steal_tasks(ThreadData &thief);
+
 	void create_thread(ThreadData &d, uint32_t i);
 	void destroy_all_threads();
 
@@ -138,40 +207,59 @@ private:
 	void debug_remove_owned_task(IThreadedTask *task);
 #endif
 
-	FixedArray<ThreadData, MAX_THREADS> _threads;
+	// Pointers because thread data must not move while threads run
+	StdVector<UniquePtr<ThreadData>> _threads;
 	uint32_t _thread_count = 0;
+	bool _numa_affinity_enabled = false;
 
-	// Scheduled tasks are put here first. They will be moved to the main waiting queue by the next available thread.
-	// This is because the main waiting queue can be locked for longer due to dynamic priority sorting.
-	StdVector<TaskItem> _staged_tasks;
-	Mutex _staged_tasks_mutex;
-
-	// Main waiting list. Tasks are picked from it by priority. Priority can also change while tasks are in this list,
-	// so we can't use a simple queue or sort at insertion. Every available thread has to find it and potentially update
-	// it every once in a while.
-	StdVector<TaskItem> _tasks;
-	Mutex _tasks_mutex;
+	// Scheduled tasks are put here first. They will be moved to the queue of the next available thread.
+	// This is because thread queues can be locked for longer due to dynamic priority sorting.
+	// Lock-free, so threads scheduling tasks never wait on each other or on workers.
+	MPSCQueue<TaskItem> _staged_tasks;
 	Semaphore _tasks_semaphore;
 
+	// Serial tasks have their own waiting list, shared by all threads since only one of them can run at a time.
+	// Kept as a heap like thread queues.
+	StdVector<TaskItem> _serial_tasks;
+	Mutex _serial_tasks_mutex;
+	uint64_t _last_serial_priority_update_time_ms = 0;
+	uint32_t _last_serial_priority_epoch = 0;
+
 	// Ongoing tasks that may take more than one iteration
 	StdQueue<TaskItem> _spinning_tasks;
 	Mutex _spinning_tasks_mutex;
 
-	StdVector<IThreadedTask *> _completed_tasks;
-	Mutex _completed_tasks_mutex;
+	// Lock-free, so workers don't wait on each other after each task
+	MPSCQueue<IThreadedTask *> _completed_tasks;
+
+	struct CategoryData {
+		uint32_t min_threads = 0;
+		uint32_t max_threads = NO_THREAD_LIMIT;
+		std::atomic_uint32_t pending_count = { 0 };
+		std::atomic_uint32_t running_count = { 0 };
+		LatencyHistogram wait_times;
+		LatencyHistogram run_times;
+	};
+
+	FixedArray<CategoryData, MAX_CATEGORIES> _categories;
+	// Quotas are not checked at all when none are set
+	bool _has_category_quotas = false;
 
 	uint32_t _priority_update_period_ms = 32;
-	uint64_t _last_priority_update_time_ms = 0;
+	bool _lazy_priority_updates = false;
+	std::atomic_uint32_t _priority_epoch = { 0 };
+	// Epoch at which priorities must be updated regardless of the update period
+	std::atomic_uint32_t _forced_priority_epoch = { 0 };
 
-	// This boolean is also guarded with `_tasks_mutex`.
+	// This boolean is also guarded with `_serial_tasks_mutex`.
 	// Tasks marked as "serial" must be executed by only one thread at a time.
 	bool _is_serial_task_running = false;
 
 	StdString _name;
 
-	unsigned int _debug_received_tasks = 0;
-	unsigned int _debug_completed_tasks = 0;
-	unsigned int _debug_taken_out_tasks = 0;
+	std::atomic_uint32_t _debug_received_tasks = { 0 };
+	std::atomic_uint32_t _debug_completed_tasks = { 0 };
+	std::atomic_uint32_t _debug_taken_out_tasks = { 0 };
 
 #ifdef ZN_THREADED_TASK_RUNNER_CHECK_DUPLICATE_TASKS
 	StdUnorderedMap<IThreadedTask *, StdString> _debug_owned_tasks;
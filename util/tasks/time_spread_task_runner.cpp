@@ -4,27 +4,52 @@
 #include "../memory/memory.h"
 #include "../profiling.h"
 
+#include <algorithm>
+
 namespace zylann {
 
 TimeSpreadTaskRunner::~TimeSpreadTaskRunner() {
 	flush();
 }
 
+namespace {
+
+struct TaskItemComparator {
+	template <typename TaskItem>
+	inline bool operator()(const TaskItem &a, const TaskItem &b) const {
+		// `std` heaps put the greatest item first, we want the lowest hint first
+		if (a.order_hint != b.order_hint) {
+			return a.order_hint > b.order_hint;
+		}
+		// Sequence numbers may wrap around after a very long time, at worst a few tasks run in a different order
+		return a.sequence_number > b.sequence_number;
+	}
+};
+
+} // namespace
+
+void TimeSpreadTaskRunner::push_to_queue(StdVector<TaskItem> &tasks, ITimeSpreadTask *task, uint32_t sequence_number) {
+	tasks.push_back(TaskItem{ task, task->get_order_hint(), sequence_number });
+	std::push_heap(tasks.begin(), tasks.end(), TaskItemComparator());
+}
+
 void TimeSpreadTaskRunner::push(ITimeSpreadTask *task, Priority priority) {
 	Queue &queue = _queues[priority];
 	MutexLock lock(queue.tasks_mutex);
-	queue.tasks.push(task);
+	push_to_queue(queue.tasks, task, queue.next_sequence_number);
+	++queue.next_sequence_number;
 }
 
 void TimeSpreadTaskRunner::push(Span<ITimeSpreadTask *> tasks, Priority priority) {
 	Queue &queue = _queues[priority];
 	MutexLock lock(queue.tasks_mutex);
 	for (unsigned int i = 0; i < tasks.size(); ++i) {
-		queue.tasks.push(tasks[i]);
+		push_to_queue(queue.tasks, tasks[i], queue.next_sequence_number);
+		++queue.next_sequence_number;
 	}
 }
 
-void TimeSpreadTaskRunner::process(uint64_t time_budget_usec) {
+uint64_t TimeSpreadTaskRunner::process(uint64_t time_budget_usec) {
 	ZN_PROFILE_SCOPE();
 	const Time &time = *Time::get_singleton();
 
@@ -34,6 +59,7 @@ void TimeSpreadTaskRunner::process(uint64_t time_budget_usec) {
 	}
 
 	const uint64_t time_before = time.get_ticks_usec();
+	uint64_t time_spent = 0;
 
 	// Do at least one task
 	do {
@@ -45,8 +71,9 @@ void TimeSpreadTaskRunner::process(uint64_t time_budget_usec) {
 			Queue &queue = _queues[queue_index];
 			MutexLock lock(queue.tasks_mutex);
 			if (queue.tasks.size() != 0) {
-				task = queue.tasks.front();
-				queue.tasks.pop();
+				std::pop_heap(queue.tasks.begin(), queue.tasks.end(), TaskItemComparator());
+				task = queue.tasks.back().task;
+				queue.tasks.pop_back();
 				break;
 			}
 		}
@@ -65,7 +92,9 @@ void TimeSpreadTaskRunner::process(uint64_t time_budget_usec) {
 			ZN_DELETE(task);
 		}
 
-	} while (time.get_ticks_usec() - time_before < time_budget_usec);
+		time_spent = time.get_ticks_usec() - time_before;
+
+	} while (time_spent < time_budget_usec);
 
 	// Push postponed task back into queues
 	for (unsigned int queue_index = 0; queue_index < tls_postponed_tasks.size(); ++queue_index) {
@@ -75,6 +104,8 @@ void TimeSpreadTaskRunner::process(uint64_t time_budget_usec) {
 			tasks.clear();
 		}
 	}
+
+	return time_spent;
 }
 
 void TimeSpreadTaskRunner::flush() {
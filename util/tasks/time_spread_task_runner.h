@@ -3,7 +3,7 @@
 
 #include "../containers/fixed_array.h"
 #include "../containers/span.h"
-#include "../containers/std_queue.h"
+#include "../containers/std_vector.h"
 #include "../thread/mutex.h"
 #include <cstdint>
 
@@ -20,6 +20,12 @@ class ITimeSpreadTask {
 public:
 	virtual ~ITimeSpreadTask() {}
 	virtual void run(TimeSpreadTaskContext &ctx) = 0;
+
+	// Among tasks of the same priority, those with lower values run first, for example the distance to the closest
+	// viewer. Tasks with equal values run in the order they were pushed. Evaluated once when the task is pushed.
+	virtual float get_order_hint() const {
+		return 0.f;
+	}
 };
 
 // Runs tasks in the caller thread, within a time budget per call. Kind of like coroutines.
@@ -37,13 +43,24 @@ public:
 	void push(ITimeSpreadTask *task, Priority priority = PRIORITY_NORMAL);
 	void push(Span<ITimeSpreadTask *> tasks, Priority priority = PRIORITY_NORMAL);
 
-	void process(uint64_t time_budget_usec);
+	// Runs tasks until the time budget is exceeded, and at least one. Returns how much time was spent.
+	uint64_t process(uint64_t time_budget_usec);
 	void flush();
 	unsigned int get_pending_count() const;
 
 private:
+	struct TaskItem {
+		ITimeSpreadTask *task;
+		float order_hint;
+		uint32_t sequence_number;
+	};
+
+	static void push_to_queue(StdVector<TaskItem> &tasks, ITimeSpreadTask *task, uint32_t sequence_number);
+
 	struct Queue {
-		StdQueue<ITimeSpreadTask *> tasks;
+		// Min-heap of order hints
+		StdVector<TaskItem> tasks;
+		uint32_t next_sequence_number = 0;
 		// TODO Optimization: naive thread safety. Should be enough for now.
 		BinaryMutex tasks_mutex;
 	};
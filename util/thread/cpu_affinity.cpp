@@ -0,0 +1,133 @@
+#include "cpu_affinity.h"
+#include "../containers/std_vector.h"
+#include "../errors.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define ZN_CPU_AFFINITY_WINDOWS
+
+#elif defined(__linux__) && !defined(__ANDROID__)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <cstdio>
+#define ZN_CPU_AFFINITY_LINUX
+#endif
+
+namespace zylann::cpu_affinity {
+
+#if defined(ZN_CPU_AFFINITY_WINDOWS)
+
+unsigned int get_numa_node_count() {
+	ULONG highest_node = 0;
+	if (!GetNumaHighestNodeNumber(&highest_node)) {
+		return 1;
+	}
+	return highest_node + 1;
+}
+
+bool pin_current_thread_to_numa_node(unsigned int node_index) {
+	GROUP_AFFINITY affinity;
+	ZeroMemory(&affinity, sizeof(affinity));
+	if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node_index), &affinity)) {
+		return false;
+	}
+	if (affinity.Mask == 0) {
+		// Node without processors
+		return false;
+	}
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+#elif defined(ZN_CPU_AFFINITY_LINUX)
+
+namespace {
+
+// Parses a CPU list file from sysfs, formatted like `0-15,32-47`
+bool read_cpu_list(const char *path, StdVector<unsigned int> &out_cpus) {
+	FILE *f = fopen(path, "r");
+	if (f == nullptr) {
+		return false;
+	}
+	unsigned int first;
+	while (fscanf(f, "%u", &first) == 1) {
+		unsigned int last = first;
+		int c = fgetc(f);
+		if (c == '-') {
+			if (fscanf(f, "%u", &last) != 1) {
+				break;
+			}
+			c = fgetc(f);
+		}
+		for (unsigned int cpu = first; cpu <= last; ++cpu) {
+			out_cpus.push_back(cpu);
+		}
+		if (c != ',') {
+			break;
+		}
+	}
+	fclose(f);
+	return out_cpus.size() > 0;
+}
+
+// Nodes are assumed to be numbered contiguously, which is the case unless CPUs were hot-unplugged
+const StdVector<StdVector<unsigned int>> &get_numa_node_cpus() {
+	static const StdVector<StdVector<unsigned int>> s_nodes = []() {
+		StdVector<StdVector<unsigned int>> nodes;
+		for (unsigned int node_index = 0;; ++node_index) {
+			char path[64];
+			snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node_index);
+			StdVector<unsigned int> cpus;
+			if (!read_cpu_list(path, cpus)) {
+				break;
+			}
+			nodes.push_back(std::move(cpus));
+		}
+		return nodes;
+	}();
+	return s_nodes;
+}
+
+} // namespace
+
+unsigned int get_numa_node_count() {
+	const size_t count = get_numa_node_cpus().size();
+	return count > 0 ? count : 1;
+}
+
+bool pin_current_thread_to_numa_node(unsigned int node_index) {
+	const StdVector<StdVector<unsigned int>> &nodes = get_numa_node_cpus();
+	if (node_index >= nodes.size()) {
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const unsigned int cpu : nodes[node_index]) {
+		if (cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &set);
+		}
+	}
+	// 0 means the calling thread
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#else
+
+unsigned int get_numa_node_count() {
+	return 1;
+}
+
+bool pin_current_thread_to_numa_node(unsigned int node_index) {
+	return false;
+}
+
+#endif
+
+} // namespace zylann::cpu_affinity
@@ -0,0 +1,16 @@
+#ifndef ZN_CPU_AFFINITY_H
+#define ZN_CPU_AFFINITY_H
+
+namespace zylann::cpu_affinity {
+
+// Gets how many NUMA nodes the machine has. Returns 1 if it has only one, or if the platform can't tell.
+unsigned int get_numa_node_count();
+
+// Restricts the calling thread to run on the CPUs of the given NUMA node. On Linux, memory pages are allocated on the
+// node of the thread that first touches them, so data created by that thread also ends up local to it.
+// Returns false if the platform doesn't support it.
+bool pin_current_thread_to_numa_node(unsigned int node_index);
+
+} // namespace zylann::cpu_affinity
+
+#endif // ZN_CPU_AFFINITY_H
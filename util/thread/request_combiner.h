@@ -0,0 +1,88 @@
+#ifndef ZN_REQUEST_COMBINER_H
+#define ZN_REQUEST_COMBINER_H
+
+#include "../containers/span.h"
+#include "../containers/std_vector.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+namespace zylann {
+
+// Lets threads submitting requests concurrently have them processed in batches, without any thread dedicated to it.
+// A thread finding fewer batches running than allowed processes every queued request, including those of other
+// threads, which wait until theirs are done. While a batch runs, new requests accumulate, so batches get larger as
+// contention increases, and a single thread never waits.
+// This is useful when each call has a high fixed cost, such as calling into a script.
+template <typename TRequest>
+class RequestCombiner {
+public:
+	void set_max_concurrent_batches(unsigned int count) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_max_concurrent_batches = count > 0 ? count : 1;
+		// Waiting threads may now be allowed to start a batch
+		_condition.notify_all();
+	}
+
+	void set_max_batch_size(unsigned int size) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_max_batch_size = size > 0 ? size : 1;
+	}
+
+	// Returns once `request` has been processed, either by this thread or another one.
+	// `f(Span<TRequest *> requests)` is called without any lock held.
+	template <typename F>
+	void process(TRequest &request, F f) {
+		Pending pending{ &request, false };
+		StdVector<Pending *> batch;
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_queue.push_back(&pending);
+
+		while (!pending.done) {
+			if (_running_batch_count >= _max_concurrent_batches || _queue.size() == 0) {
+				_condition.wait(lock);
+				continue;
+			}
+
+			// Take requests in the order they were queued
+			const unsigned int count = std::min(static_cast<unsigned int>(_queue.size()), _max_batch_size);
+			batch.assign(_queue.begin(), _queue.begin() + count);
+			_queue.erase(_queue.begin(), _queue.begin() + count);
+			++_running_batch_count;
+			lock.unlock();
+
+			StdVector<TRequest *> requests;
+			requests.reserve(batch.size());
+			for (Pending *p : batch) {
+				requests.push_back(p->request);
+			}
+			f(to_span(requests));
+
+			lock.lock();
+			for (Pending *p : batch) {
+				p->done = true;
+			}
+			--_running_batch_count;
+			_condition.notify_all();
+		}
+	}
+
+private:
+	struct Pending {
+		TRequest *request;
+		bool done;
+	};
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	// Requests are owned by the waiting threads that submitted them
+	StdVector<Pending *> _queue;
+	unsigned int _running_batch_count = 0;
+	unsigned int _max_concurrent_batches = 1;
+	unsigned int _max_batch_size = 64;
+};
+
+} // namespace zylann
+
+#endif // ZN_REQUEST_COMBINER_H
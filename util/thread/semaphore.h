@@ -1,7 +1,9 @@
 #ifndef ZN_SEMAPHORE_H
 #define ZN_SEMAPHORE_H
 
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 
 namespace zylann {
@@ -22,6 +24,17 @@ public:
 		--_count;
 	}
 
+	// Returns false if the semaphore was not posted before the given amount of microseconds
+	inline bool wait_for_usec(uint64_t usec) const {
+		std::unique_lock<decltype(_mutex)> lock(_mutex);
+		// Handles spurious wake-ups
+		if (!_condition.wait_for(lock, std::chrono::microseconds(usec), [this]() { return _count != 0; })) {
+			return false;
+		}
+		--_count;
+		return true;
+	}
+
 	inline bool try_wait() const {
 		std::lock_guard<decltype(_mutex)> lock(_mutex);
 		if (_count != 0) {
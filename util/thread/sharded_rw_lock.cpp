@@ -0,0 +1,116 @@
+#include "sharded_rw_lock.h"
+#include "../profiling.h"
+
+#include <chrono>
+#include <thread>
+
+namespace zylann {
+
+namespace {
+
+inline uint64_t get_time_usec() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+				   std::chrono::steady_clock::now().time_since_epoch()
+	)
+			.count();
+}
+
+} // namespace
+
+unsigned int ShardedRWLock::assign_thread_slot_index() {
+	// Threads get slots in turn, so up to `SLOT_COUNT` threads never share one
+	static std::atomic_uint32_t s_next_slot_index = { 0 };
+	return s_next_slot_index.fetch_add(1, std::memory_order_relaxed) % SLOT_COUNT;
+}
+
+void ShardedRWLock::read_lock_contended(ReaderSlot &slot) const {
+	ZN_PROFILE_SCOPE();
+	const uint64_t time_before = get_time_usec();
+
+	do {
+		// Back off so the writer can proceed, then wait until it is done
+		slot.readers.fetch_sub(1, std::memory_order_seq_cst);
+		{
+			MutexLock lock(_writer_mutex);
+		}
+		slot.readers.fetch_add(1, std::memory_order_seq_cst);
+	} while (_writer.load(std::memory_order_seq_cst));
+
+	_contended_locks.fetch_add(1, std::memory_order_relaxed);
+	_wait_time_usec.fetch_add(get_time_usec() - time_before, std::memory_order_relaxed);
+}
+
+void ShardedRWLock::write_lock() {
+	_write_locks.fetch_add(1, std::memory_order_relaxed);
+
+	if (!_writer_mutex.try_lock()) {
+		ZN_PROFILE_SCOPE_NAMED("Wait for writer");
+		const uint64_t time_before = get_time_usec();
+		_writer_mutex.lock();
+		_contended_locks.fetch_add(1, std::memory_order_relaxed);
+		_wait_time_usec.fetch_add(get_time_usec() - time_before, std::memory_order_relaxed);
+	}
+
+	// New readers will now wait for us
+	_writer.store(true, std::memory_order_seq_cst);
+
+	wait_for_readers();
+}
+
+void ShardedRWLock::write_unlock() {
+	_writer.store(false, std::memory_order_seq_cst);
+	_writer_mutex.unlock();
+}
+
+bool ShardedRWLock::write_try_lock() {
+	if (!_writer_mutex.try_lock()) {
+		return false;
+	}
+	_writer.store(true, std::memory_order_seq_cst);
+	for (const ReaderSlot &slot : _slots) {
+		if (slot.readers.load(std::memory_order_seq_cst) != 0) {
+			write_unlock();
+			return false;
+		}
+	}
+	_write_locks.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void ShardedRWLock::wait_for_readers() {
+	// Readers already holding the lock have to finish. Read locks are usually short, so we don't need to sleep.
+	bool contended = false;
+	uint64_t time_before = 0;
+
+	for (const ReaderSlot &slot : _slots) {
+		if (slot.readers.load(std::memory_order_seq_cst) == 0) {
+			continue;
+		}
+		if (!contended) {
+			contended = true;
+			time_before = get_time_usec();
+		}
+		ZN_PROFILE_SCOPE_NAMED("Wait for readers");
+		while (slot.readers.load(std::memory_order_seq_cst) != 0) {
+			std::this_thread::yield();
+		}
+	}
+
+	if (contended) {
+		_contended_locks.fetch_add(1, std::memory_order_relaxed);
+		_wait_time_usec.fetch_add(get_time_usec() - time_before, std::memory_order_relaxed);
+	}
+}
+
+ShardedRWLock::Stats ShardedRWLock::get_stats() const {
+	Stats stats;
+	for (const ReaderSlot &slot : _slots) {
+		stats.read_locks += slot.read_locks.load(std::memory_order_relaxed);
+	}
+	stats.write_locks = _write_locks.load(std::memory_order_relaxed);
+	stats.contended_locks = _contended_locks.load(std::memory_order_relaxed);
+	stats.wait_time_usec = _wait_time_usec.load(std::memory_order_relaxed);
+	return stats;
+}
+
+} // namespace zylann
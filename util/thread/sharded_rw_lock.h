@@ -0,0 +1,131 @@
+#ifndef ZN_SHARDED_RW_LOCK_H
+#define ZN_SHARDED_RW_LOCK_H
+
+#include "../containers/fixed_array.h"
+#include "mutex.h"
+#include <atomic>
+#include <cstdint>
+
+namespace zylann {
+
+// Reader-writer lock optimized for frequent reads and rare writes.
+// A regular RWLock keeps a single reader count, so every read lock from any thread modifies the same cache line, which
+// then bounces between cores. Here, readers are counted in separate slots, and each thread always uses the same slot.
+// Readers only touch their own slot unless a writer is present. Writers are more expensive: they have to wait for every
+// slot to be empty.
+// Writers are preferred: new readers wait while a writer is waiting or holding the lock.
+// WARNING: cannot be locked twice by the same thread, it is undefined behavior.
+class ShardedRWLock {
+public:
+	struct Stats {
+		uint64_t read_locks = 0;
+		uint64_t write_locks = 0;
+		// How many times a lock had to wait for another thread
+		uint64_t contended_locks = 0;
+		// Total time spent waiting in contended locks
+		uint64_t wait_time_usec = 0;
+
+		void add(const Stats &other) {
+			read_locks += other.read_locks;
+			write_locks += other.write_locks;
+			contended_locks += other.contended_locks;
+			wait_time_usec += other.wait_time_usec;
+		}
+	};
+
+	inline void read_lock() const {
+		ReaderSlot &slot = _slots[get_thread_slot_index()];
+		slot.read_locks.fetch_add(1, std::memory_order_relaxed);
+		// Sequentially consistent, to make sure a writer always sees either our reader count or we see its flag
+		slot.readers.fetch_add(1, std::memory_order_seq_cst);
+		if (_writer.load(std::memory_order_seq_cst)) {
+			read_lock_contended(slot);
+		}
+	}
+
+	inline void read_unlock() const {
+		_slots[get_thread_slot_index()].readers.fetch_sub(1, std::memory_order_release);
+	}
+
+	// Attempt to lock for reading, returns `true` on success, `false` means it can't lock.
+	bool read_try_lock() const {
+		ReaderSlot &slot = _slots[get_thread_slot_index()];
+		slot.readers.fetch_add(1, std::memory_order_seq_cst);
+		if (_writer.load(std::memory_order_seq_cst)) {
+			slot.readers.fetch_sub(1, std::memory_order_release);
+			return false;
+		}
+		slot.read_locks.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Lock for writing, block if locked by someone else
+	void write_lock();
+	void write_unlock();
+
+	// Attempt to lock for writing, returns `true` on success, `false` means it can't lock.
+	bool write_try_lock();
+
+	// Statistics are approximate when the lock is in use, they are meant for profiling.
+	Stats get_stats() const;
+
+private:
+	static const unsigned int SLOT_COUNT = 16;
+	static const unsigned int CACHE_LINE_SIZE = 64;
+
+	struct ReaderSlot {
+		std::atomic_uint64_t read_locks = { 0 };
+		std::atomic_uint32_t readers = { 0 };
+		// Keep slots on separate cache lines
+		uint8_t padding[CACHE_LINE_SIZE - sizeof(std::atomic_uint64_t) - sizeof(std::atomic_uint32_t)];
+	};
+
+	static inline unsigned int get_thread_slot_index() {
+		static thread_local unsigned int tls_slot_index = assign_thread_slot_index();
+		return tls_slot_index;
+	}
+
+	static unsigned int assign_thread_slot_index();
+
+	void read_lock_contended(ReaderSlot &slot) const;
+	void wait_for_readers();
+
+	mutable FixedArray<ReaderSlot, SLOT_COUNT> _slots;
+	std::atomic_bool _writer = { false };
+	// Held by the writer. Readers wait on it when a writer is present.
+	BinaryMutex _writer_mutex;
+
+	std::atomic_uint64_t _write_locks = { 0 };
+	mutable std::atomic_uint64_t _contended_locks = { 0 };
+	mutable std::atomic_uint64_t _wait_time_usec = { 0 };
+};
+
+class ShardedRWLockRead {
+public:
+	ShardedRWLockRead(const ShardedRWLock &p_lock) : _lock(p_lock) {
+		_lock.read_lock();
+	}
+	~ShardedRWLockRead() {
+		_lock.read_unlock();
+	}
+
+private:
+	const ShardedRWLock &_lock;
+};
+
+class ShardedRWLockWrite {
+public:
+	ShardedRWLockWrite(ShardedRWLock &p_lock) : _lock(p_lock) {
+		_lock.write_lock();
+	}
+	~ShardedRWLockWrite() {
+		_lock.write_unlock();
+	}
+
+private:
+	ShardedRWLock &_lock;
+};
+
+} // namespace zylann
+
+#endif // ZN_SHARDED_RW_LOCK_H
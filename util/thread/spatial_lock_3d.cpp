@@ -1,13 +1,142 @@
 #include "spatial_lock_3d.h"
 #include "../io/log.h"
+#include "../profiling.h"
 #include "../string/format.h"
 
+#include <chrono>
+
 namespace zylann {
 
+namespace {
+
+inline uint64_t get_time_usec() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+				   std::chrono::steady_clock::now().time_since_epoch()
+	)
+			.count();
+}
+
+} // namespace
+
 SpatialLock3D::SpatialLock3D() {
 	_boxes.reserve(8);
 }
 
+bool SpatialLock3D::lock(const BoxBounds3i &bounds, Mode mode, int64_t timeout_usec) {
+	Box box;
+	box.bounds = bounds;
+	box.mode = mode;
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+	box.thread_id = Thread::get_caller_id();
+#endif
+
+	{
+		ShortLockScope slock(_boxes_mutex);
+		if (can_lock(box, _waiters.size())) {
+			add_box(box);
+			return true;
+		}
+	}
+	if (timeout_usec == 0) {
+		return false;
+	}
+
+	// Only created when we have to wait, it is not free
+	Waiter waiter;
+	waiter.box = box;
+
+	{
+		ShortLockScope slock(_boxes_mutex);
+		// Things may have changed in the meantime
+		if (can_lock(box, _waiters.size())) {
+			add_box(box);
+			return true;
+		}
+		_waiters.push_back(&waiter);
+	}
+
+	ZN_PROFILE_SCOPE_NAMED("Wait for spatial lock");
+	_contended_locks.fetch_add(1, std::memory_order_relaxed);
+	const uint64_t time_before = get_time_usec();
+
+	bool locked = true;
+
+	if (timeout_usec < 0) {
+		waiter.semaphore.wait();
+
+	} else if (!waiter.semaphore.wait_for_usec(timeout_usec)) {
+		ShortLockScope slock(_boxes_mutex);
+
+		// We could have been given the box right after the timeout
+		if (!waiter.granted) {
+			for (unsigned int i = 0; i < _waiters.size(); ++i) {
+				if (_waiters[i] == &waiter) {
+					_waiters.erase(_waiters.begin() + i);
+					break;
+				}
+			}
+			_timeouts.fetch_add(1, std::memory_order_relaxed);
+			// Waiters that were queued after us might have been waiting only because of us
+			wake_waiters(bounds);
+			locked = false;
+		}
+	}
+
+	_wait_time_usec.fetch_add(get_time_usec() - time_before, std::memory_order_relaxed);
+	return locked;
+}
+
+void SpatialLock3D::unlock(const BoxBounds3i &box, Mode mode) {
+	ShortLockScope slock(_boxes_mutex);
+	remove_box(box, mode);
+	// Tell waiting threads that they might be able to lock their box now.
+	wake_waiters(box);
+}
+
+bool SpatialLock3D::can_lock(const Box &box, unsigned int earlier_waiters_count) const {
+	for (unsigned int i = 0; i < _boxes.size(); ++i) {
+		const Box &existing_box = _boxes[i];
+
+#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
+		// Each thread can lock only one box at a time, otherwise there can be deadlocks depending on the order of
+		// locks. For example:
+		// - Thread 1 locks A
+		// - Thread 2 locks B
+		// - Thread 1 locks B, but blocks because it is already locked
+		// - Thread 2 locks A, but blocks because it is already locked:
+		//   This is a deadlock.
+		// Note: this is not true if threads only lock for reading, but if we didn't ever write we'd not use locks.
+		// Note: this is also not true if threads use `try_lock` instead!
+		ZN_ASSERT_RETURN_V_MSG(
+				existing_box.thread_id != box.thread_id, false, "Locking two areas from the same threads is not allowed"
+		);
+#endif
+
+		if (conflicts(existing_box.bounds, existing_box.mode, box.bounds, box.mode)) {
+			return false;
+		}
+	}
+
+	// Don't overtake threads that were waiting before
+	for (unsigned int i = 0; i < earlier_waiters_count; ++i) {
+		const Box &waiting_box = _waiters[i]->box;
+		if (conflicts(waiting_box.bounds, waiting_box.mode, box.bounds, box.mode)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void SpatialLock3D::add_box(const Box &box) {
+	_boxes.push_back(box);
+	if (box.mode == MODE_READ) {
+		_read_locks.fetch_add(1, std::memory_order_relaxed);
+	} else {
+		_write_locks.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
 void SpatialLock3D::remove_box(const BoxBounds3i &box, Mode mode) {
 #ifdef ZN_SPATIAL_LOCK_3D_CHECKS
 	const Thread::ID thread_id = Thread::get_caller_id();
@@ -30,4 +159,36 @@ void SpatialLock3D::remove_box(const BoxBounds3i &box, Mode mode) {
 	ZN_PRINT_ERROR(format("Could not find box to remove {} with mode {}", box, mode));
 }
 
+void SpatialLock3D::wake_waiters(const BoxBounds3i &changed_box) {
+	// Must be called with `_boxes_mutex` locked.
+	// Only waiters overlapping the box that changed can be affected. Others are still blocked by the same boxes.
+	unsigned int i = 0;
+	while (i < _waiters.size()) {
+		Waiter &waiter = *_waiters[i];
+
+		if (waiter.box.bounds.intersects(changed_box) && can_lock(waiter.box, i)) {
+			add_box(waiter.box);
+			waiter.granted = true;
+			_waiters.erase(_waiters.begin() + i);
+			_wakeups.fetch_add(1, std::memory_order_relaxed);
+			// Posted while `_boxes_mutex` is locked, because a waiter that timed out checks `granted` under that
+			// mutex before going away with its semaphore
+			waiter.semaphore.post();
+		} else {
+			++i;
+		}
+	}
+}
+
+SpatialLock3D::Stats SpatialLock3D::get_stats() const {
+	Stats stats;
+	stats.read_locks = _read_locks.load(std::memory_order_relaxed);
+	stats.write_locks = _write_locks.load(std::memory_order_relaxed);
+	stats.contended_locks = _contended_locks.load(std::memory_order_relaxed);
+	stats.wait_time_usec = _wait_time_usec.load(std::memory_order_relaxed);
+	stats.wakeups = _wakeups.load(std::memory_order_relaxed);
+	stats.timeouts = _timeouts.load(std::memory_order_relaxed);
+	return stats;
+}
+
 } // namespace zylann
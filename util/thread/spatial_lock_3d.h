@@ -7,6 +7,8 @@
 #include "semaphore.h"
 #include "short_lock.h"
 #include "thread.h"
+#include <atomic>
+#include <cstdint>
 
 #ifdef TOOLS_ENABLED
 #define ZN_SPATIAL_LOCK_3D_CHECKS
@@ -39,58 +41,64 @@ public:
 #endif
 	};
 
+	struct Stats {
+		uint64_t read_locks = 0;
+		uint64_t write_locks = 0;
+		// How many times a lock had to wait for another thread
+		uint64_t contended_locks = 0;
+		// Total time spent waiting in contended locks
+		uint64_t wait_time_usec = 0;
+		// How many times a waiting thread was given its box
+		uint64_t wakeups = 0;
+		// How many timed locks gave up
+		uint64_t timeouts = 0;
+
+		void add(const Stats &other) {
+			read_locks += other.read_locks;
+			write_locks += other.write_locks;
+			contended_locks += other.contended_locks;
+			wait_time_usec += other.wait_time_usec;
+			wakeups += other.wakeups;
+			timeouts += other.timeouts;
+		}
+	};
+
 	SpatialLock3D();
 
 	~SpatialLock3D() {
 		ZN_ASSERT_RETURN(_boxes.size() == 0);
+		ZN_ASSERT_RETURN(_waiters.size() == 0);
 	}
 
-	bool try_lock_read(const BoxBounds3i &box) {
-		_boxes_mutex.lock();
-		if (can_lock_for_read(box)) {
-			_boxes.push_back(Box{ box, MODE_READ,
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-					Thread::get_caller_id()
-#endif
-			});
-			_boxes_mutex.unlock();
-			return true;
-		} else {
-			_boxes_mutex.unlock();
-			return false;
-		}
+	// Attempts to lock without waiting. Fails if the box overlaps a locked box, or a box another thread is waiting
+	// for (so waiting threads don't get starved).
+	inline bool try_lock_read(const BoxBounds3i &box) {
+		return lock(box, MODE_READ, 0);
 	}
 
-	void lock_read(const BoxBounds3i &box) {
-		while (try_lock_read(box) == false) {
-			_semaphore.wait();
-		}
+	inline void lock_read(const BoxBounds3i &box) {
+		lock(box, MODE_READ, -1);
+	}
+
+	// Waits at most the given amount of microseconds. Returns false if it could not lock in time.
+	inline bool try_lock_read_for(const BoxBounds3i &box, uint32_t timeout_usec) {
+		return lock(box, MODE_READ, timeout_usec);
 	}
 
 	inline void unlock_read(const BoxBounds3i &box) {
 		unlock(box, MODE_READ);
 	}
 
-	bool try_lock_write(const BoxBounds3i &box) {
-		_boxes_mutex.lock();
-		if (can_lock_for_write(box)) {
-			_boxes.push_back(Box{ box, MODE_WRITE,
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-					Thread::get_caller_id()
-#endif
-			});
-			_boxes_mutex.unlock();
-			return true;
-		} else {
-			_boxes_mutex.unlock();
-			return false;
-		}
+	inline bool try_lock_write(const BoxBounds3i &box) {
+		return lock(box, MODE_WRITE, 0);
 	}
 
-	void lock_write(const BoxBounds3i &box) {
-		while (try_lock_write(box) == false) {
-			_semaphore.wait();
-		}
+	inline void lock_write(const BoxBounds3i &box) {
+		lock(box, MODE_WRITE, -1);
+	}
+
+	inline bool try_lock_write_for(const BoxBounds3i &box, uint32_t timeout_usec) {
+		return lock(box, MODE_WRITE, timeout_usec);
 	}
 
 	inline void unlock_write(const BoxBounds3i &box) {
@@ -102,6 +110,14 @@ public:
 		return _boxes.size();
 	}
 
+	inline int get_waiting_count() const {
+		ShortLockScope rlock(_boxes_mutex);
+		return _waiters.size();
+	}
+
+	// Statistics are approximate when the lock is in use, they are meant for profiling.
+	Stats get_stats() const;
+
 	// Scoped helpers
 
 	struct Read {
@@ -127,75 +143,47 @@ public:
 	};
 
 private:
-	bool can_lock_for_read(const BoxBounds3i &box) {
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-		const Thread::ID thread_id = Thread::get_caller_id();
-#endif
+	// A thread waiting for its box. It lives on the stack of that thread.
+	struct Waiter {
+		Box box;
+		// Set when the box was locked on behalf of the waiting thread
+		bool granted = false;
+		Semaphore semaphore;
+	};
 
-		for (unsigned int i = 0; i < _boxes.size(); ++i) {
-			const Box &existing_box = _boxes[i];
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-			// Each thread can lock only one box at a time, otherwise there can be deadlocks depending on the order of
-			// locks. For example:
-			// - Thread 1 locks A
-			// - Thread 2 locks B
-			// - Thread 1 locks B, but blocks because it is already locked
-			// - Thread 2 locks A, but blocks because it is already locked:
-			//   This is a deadlock.
-			// Note: this is not true if threads only lock for reading, but if we didn't ever write we'd not use locks.
-			// Note: this is also not true if threads use `try_lock` instead!
-			ZN_ASSERT_RETURN_V_MSG(existing_box.thread_id != thread_id, false,
-					"Locking two areas from the same threads is not allowed");
-#endif
-			if (existing_box.bounds.intersects(box) && existing_box.mode == MODE_WRITE) {
-				return false;
-				break;
-			}
-		}
-		return true;
+	static inline bool conflicts(const BoxBounds3i &a, Mode a_mode, const BoxBounds3i &b, Mode b_mode) {
+		return (a_mode == MODE_WRITE || b_mode == MODE_WRITE) && a.intersects(b);
 	}
 
-	bool can_lock_for_write(const BoxBounds3i &box) {
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-		const Thread::ID thread_id = Thread::get_caller_id();
-#endif
-
-		for (unsigned int i = 0; i < _boxes.size(); ++i) {
-			const Box &existing_box = _boxes[i];
-
-#ifdef ZN_SPATIAL_LOCK_3D_CHECKS
-			ZN_ASSERT_RETURN_V_MSG(existing_box.thread_id != thread_id, false,
-					"Locking two areas from the same threads is not allowed");
-#endif
-			if (existing_box.bounds.intersects(box)) {
-				return false;
-				break;
-			}
-		}
-		return true;
-	}
+	// Negative timeout waits indefinitely
+	bool lock(const BoxBounds3i &box, Mode mode, int64_t timeout_usec);
+	void unlock(const BoxBounds3i &box, Mode mode);
 
+	bool can_lock(const Box &box, unsigned int earlier_waiters_count) const;
+	void add_box(const Box &box);
 	void remove_box(const BoxBounds3i &box, Mode mode);
-
-	void unlock(const BoxBounds3i &box, Mode mode) {
-		_boxes_mutex.lock();
-		remove_box(box, mode);
-		_boxes_mutex.unlock();
-		// Tell eventual waiting threads that they might be able to lock their box now.
-		_semaphore.post();
-	}
+	void wake_waiters(const BoxBounds3i &changed_box);
 
 	// List of boxes currently locked.
 	// In practice, each thread can lock up to 1 box at once (maybe a few more in rare cases that would allow it), so
 	// there won't be many boxes to store.
 	StdVector<Box> _boxes;
+	// Threads waiting for a box, in the order they started waiting. When a box is unlocked, only waiters overlapping
+	// it are checked, and those that can lock are given their box directly, instead of waking up every thread to
+	// let them retry. A waiter can't get its box before earlier waiters it conflicts with, so large write boxes are
+	// not starved by a stream of smaller reads.
+	StdVector<Waiter *> _waiters;
 	// This mutex is supposed to be locked for very small periods of time, just to lookup, add or remove boxes.
 	// So we lock it even in `try_*` methods. The long-period locking states are the boxes themselves.
 	// Also it is not a recursive mutex for performance. Do not lock it again once you successfully locked it.
 	mutable ShortLock _boxes_mutex;
-	// This semaphore is waited for when a lock fails. It is posted everytime a box is unlocked, so any thread
-	// waiting for it may retry locking their box.
-	Semaphore _semaphore;
+
+	std::atomic_uint64_t _read_locks = { 0 };
+	std::atomic_uint64_t _write_locks = { 0 };
+	std::atomic_uint64_t _contended_locks = { 0 };
+	std::atomic_uint64_t _wait_time_usec = { 0 };
+	std::atomic_uint64_t _wakeups = { 0 };
+	std::atomic_uint64_t _timeouts = { 0 };
 };
 
 } // namespace zylann